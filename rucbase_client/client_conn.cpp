@@ -0,0 +1,130 @@
+#include "client_conn.h"
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "common/result_format.h"
+
+int init_unix_sock(const char *unix_sock_path) {
+    int sockfd = socket(PF_UNIX, SOCK_STREAM, 0);
+    if (sockfd < 0) {
+        fprintf(stderr, "failed to create unix socket. %s", strerror(errno));
+        return -1;
+    }
+
+    struct sockaddr_un sockaddr;
+    memset(&sockaddr, 0, sizeof(sockaddr));
+    sockaddr.sun_family = PF_UNIX;
+    snprintf(sockaddr.sun_path, sizeof(sockaddr.sun_path), "%s", unix_sock_path);
+
+    if (connect(sockfd, (struct sockaddr *)&sockaddr, sizeof(sockaddr)) < 0) {
+        fprintf(stderr, "failed to connect to server. unix socket path '%s'. error %s", sockaddr.sun_path,
+                strerror(errno));
+        close(sockfd);
+        return -1;
+    }
+    return sockfd;
+}
+
+int init_tcp_sock(const char *server_host, int server_port) {
+    struct hostent *host;
+    struct sockaddr_in serv_addr;
+
+    if ((host = gethostbyname(server_host)) == NULL) {
+        fprintf(stderr, "gethostbyname failed. errmsg=%d:%s\n", errno, strerror(errno));
+        return -1;
+    }
+
+    int sockfd;
+    if ((sockfd = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
+        fprintf(stderr, "create socket error. errmsg=%d:%s\n", errno, strerror(errno));
+        return -1;
+    }
+
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_port = htons(server_port);
+    serv_addr.sin_addr = *((struct in_addr *)host->h_addr);
+    bzero(&(serv_addr.sin_zero), 8);
+
+    if (connect(sockfd, (struct sockaddr *)&serv_addr, sizeof(struct sockaddr)) == -1) {
+        fprintf(stderr, "Failed to connect. errmsg=%d:%s\n", errno, strerror(errno));
+        close(sockfd);
+        return -1;
+    }
+    return sockfd;
+}
+
+bool ResponseReader::read_exact(char *out, size_t len) {
+    while (len > 0) {
+        if (pos_ == len_ && !fill()) {
+            return false;
+        }
+        size_t n = std::min(len, len_ - pos_);
+        memcpy(out, buf_ + pos_, n);
+        pos_ += n;
+        out += n;
+        len -= n;
+    }
+    return true;
+}
+
+bool ResponseReader::read_text(std::string *response) {
+    while (true) {
+        if (pos_ == len_ && !fill()) {
+            return false;
+        }
+        const char *begin = buf_ + pos_;
+        const char *nul = static_cast<const char *>(memchr(begin, '\0', len_ - pos_));
+        if (nul != nullptr) {
+            response->append(begin, nul - begin);
+            pos_ += nul - begin + 1;
+            return true;
+        }
+        response->append(begin, len_ - pos_);
+        pos_ = len_;
+    }
+}
+
+bool ResponseReader::fill() {
+    ssize_t n = recv(sockfd_, buf_, MAX_MEM_BUFFER_SIZE, 0);
+    if (n < 0) {
+        fprintf(stderr, "Connection was broken: %s\n", strerror(errno));
+        return false;
+    } else if (n == 0) {
+        printf("Connection has been closed\n");
+        return false;
+    }
+    pos_ = 0;
+    len_ = n;
+    return true;
+}
+
+bool send_request(int sockfd, const std::string &request) {
+    if (write(sockfd, request.c_str(), request.length() + 1) == -1) {
+        std::cerr << "send error: " << errno << ":" << strerror(errno) << " \n" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool negotiate_binary_result(int sockfd, ResponseReader *reader, bool *binary_result) {
+    if (!send_request(sockfd, RESULT_BINARY_REQUEST)) {
+        return false;
+    }
+    std::string response;
+    if (!reader->read_text(&response)) {
+        return false;
+    }
+    *binary_result = response == RESULT_BINARY_ACK;
+    return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#define MAX_MEM_BUFFER_SIZE 8192
+#define PORT_DEFAULT 8765
+
+/* 连接服务端的Unix域套接字或TCP端口，失败时输出原因并返回-1，rucbase_client、rmdb_loadgen和rmdb_crashbench共用 */
+int init_unix_sock(const char *unix_sock_path);
+
+int init_tcp_sock(const char *server_host, int server_port);
+
+/**
+ * @brief 从连接读取响应，一次recv可能读到下一个响应的开头，多读的数据留给下一次读取
+ */
+class ResponseReader {
+    int sockfd_;
+    char buf_[MAX_MEM_BUFFER_SIZE];
+    size_t pos_ = 0;
+    size_t len_ = 0;
+
+   public:
+    explicit ResponseReader(int sockfd) : sockfd_(sockfd) {}
+
+    bool read_exact(char *out, size_t len);
+
+    /**
+     * @brief 读取以'\0'结尾的文本响应，服务端把较大的结果分成多块发送
+     */
+    bool read_text(std::string *response);
+
+   private:
+    bool fill();
+};
+
+/**
+ * @brief 发送以'\0'结尾的请求
+ */
+bool send_request(int sockfd, const std::string &request);
+
+/**
+ * @brief 请求服务端使用二进制结果格式，不支持的服务端返回错误信息，此时继续使用文本格式
+ */
+bool negotiate_binary_result(int sockfd, ResponseReader *reader, bool *binary_result);
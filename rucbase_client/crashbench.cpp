@@ -0,0 +1,521 @@
+/**
+ * rmdb_crashbench：测量持久化的代价，用于选择检查点间隔和组提交等待时间（RMDB_LOG_GROUP_COMMIT_TIMEOUT_US）。
+ * 由本工具启动和杀掉服务端进程，依次：
+ * 1. 删除并重新创建数据库，-w给出负载时先用rmdb_loadgen -l导入该负载的数据，作为恢复时需要扫描和重做的背景数据；
+ * 2. 分别在不等待组提交和等待-g微秒的组提交下运行-d秒的校验事务，报告每秒提交数、每个事务的日志字节数，
+ *    正常关闭后重启，报告重启后第一条查询返回的时间；
+ * 3. 进行-R轮故障测试：每轮一边运行校验事务（以及rmdb_loadgen的背景负载），一边在随机时刻杀掉服务端，
+ *    重启后报告analyze、redo、undo各阶段的耗时和第一条查询返回的时间，并与客户端记录的参考状态比对检查原子性和持久性。
+ * 每个校验连接独占crash_account中的几行，一个事务把这几行的版本号都改为下一个版本，并在crash_history中插入一行，
+ * 恢复后这几行的版本号必须相同，等于最后一个确认提交的版本，或者等于连接断开时正在提交的版本
+ */
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "client_conn.h"
+
+#define ACCOUNT_SLOTS 4             // 每个校验连接独占的crash_account行数
+#define SERVER_START_TIMEOUT 120    // 等待服务端完成恢复、开始监听的秒数
+#define SERVER_LOG_NAME "crashbench_server.log"     // 服务端的标准输出和标准错误
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    const char *server_path = "../../build/bin/rmdb";   // 在rucbase_client/build下运行时服务端的位置
+    const char *loadgen_path = "./rmdb_loadgen";
+    const char *db_name = "crashbench_db";
+    const char *unix_socket_path = "/tmp/rmdb_crashbench.sock";
+    int connections = 4;            // 校验事务的连接数
+    int duration = 5;               // 每种组提交设置下测量吞吐量的秒数
+    int rounds = 5;                 // 故障测试的轮数
+    int max_kill_ms = 3000;         // 每轮在[max_kill_ms / 10, max_kill_ms]毫秒内的随机时刻杀掉服务端
+    int group_commit_us = 200;      // 打开组提交时的等待微秒数，故障测试也使用这一设置
+    int checkpoint_ms = 0;          // 检查点间隔，0表示使用服务端的默认值
+    std::string workload;           // 交给rmdb_loadgen的负载，为空时不使用背景负载
+    int records = 10000;            // YCSB负载的初始记录数
+    bool crash_command = false;     // 用crash命令代替SIGKILL
+    unsigned seed = 2024;
+};
+
+double ms_since(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+/* 一条语句的执行结果，lost表示连接断开，服务端已经退出 */
+enum class Outcome { OK, ABORT, ERROR, LOST };
+
+/**
+ * @brief 一个使用文本结果格式的连接。与rmdb_loadgen不同，连接断开是预期中的，只返回LOST
+ */
+class Connection {
+    int sockfd_;
+    ResponseReader reader_;
+
+   public:
+    explicit Connection(int sockfd) : sockfd_(sockfd), reader_(sockfd) {}
+
+    ~Connection() { close(sockfd_); }
+
+    Outcome execute(const std::string &sql, std::string *response = nullptr) {
+        std::string local;
+        std::string *out = response != nullptr ? response : &local;
+        out->clear();
+        if (!send_request(sockfd_, sql) || !reader_.read_text(out)) {
+            return Outcome::LOST;
+        }
+        if (out->compare(0, 5, "abort") == 0) {
+            return Outcome::ABORT;
+        }
+        if (out->compare(0, 5, "Error") == 0 || out->compare(0, 7, "failure") == 0) {
+            return Outcome::ERROR;
+        }
+        return Outcome::OK;
+    }
+};
+
+/**
+ * @brief 取出文本格式结果中的所有记录，不含表头
+ */
+std::vector<std::vector<std::string>> result_rows(const std::string &response) {
+    std::vector<std::vector<std::string>> rows;
+    bool header = true;
+    size_t line = 0;
+    while (line < response.size()) {
+        size_t end = response.find('\n', line);
+        if (end == std::string::npos) end = response.size();
+        if (response[line] == '|') {
+            std::vector<std::string> cells;
+            for (size_t pos = line + 1; pos < end;) {
+                size_t bar = response.find('|', pos);
+                if (bar == std::string::npos || bar > end) break;
+                std::string cell = response.substr(pos, bar - pos);
+                size_t first = cell.find_first_not_of(' ');
+                size_t last = cell.find_last_not_of(' ');
+                cells.push_back(first == std::string::npos ? "" : cell.substr(first, last - first + 1));
+                pos = bar + 1;
+            }
+            if (!header) rows.push_back(std::move(cells));
+            header = false;
+        }
+        line = end + 1;
+    }
+    return rows;
+}
+
+/**
+ * @brief show metrics的计数表中名为name的一项。show metrics输出多张表，其余表头也会作为记录返回，按第一列的名字查找即可
+ */
+double metric(Connection *conn, const std::string &name) {
+    std::string response;
+    if (conn->execute("show metrics;", &response) != Outcome::OK) return 0;
+    for (auto &row : result_rows(response)) {
+        if (row.size() == 2 && row[0] == name) return atof(row[1].c_str());
+    }
+    return 0;
+}
+
+/**
+ * @brief 由本工具启动的服务端进程，标准输出和标准错误追加到SERVER_LOG_NAME中
+ */
+class ServerProcess {
+    const Options &opts_;
+    pid_t pid_ = -1;
+
+   public:
+    explicit ServerProcess(const Options &opts) : opts_(opts) {}
+
+    ~ServerProcess() {
+        if (pid_ > 0) kill_now();
+    }
+
+    /**
+     * @brief 启动服务端并等待它完成恢复、接受连接，env为额外设置的环境变量
+     * @return 第一个连接，服务端启动失败时为空
+     */
+    std::unique_ptr<Connection> start(const std::map<std::string, std::string> &env) {
+        // 上次被杀掉时留下的socket文件在服务端开始监听之前一直存在，先删除，文件出现即说明已经开始监听
+        unlink(opts_.unix_socket_path);
+        pid_ = fork();
+        if (pid_ == 0) {
+            for (auto &[name, value] : env) {
+                setenv(name.c_str(), value.c_str(), 1);
+            }
+            setenv("RMDB_UNIX_SOCKET", opts_.unix_socket_path, 1);
+            int fd = open(SERVER_LOG_NAME, O_WRONLY | O_CREAT | O_APPEND, 0644);
+            if (fd >= 0) {
+                dup2(fd, STDOUT_FILENO);
+                dup2(fd, STDERR_FILENO);
+                close(fd);
+            }
+            execl(opts_.server_path, opts_.server_path, opts_.db_name, nullptr);
+            _exit(127);
+        }
+        if (pid_ < 0) {
+            perror("fork");
+            return nullptr;
+        }
+        auto deadline = Clock::now() + std::chrono::seconds(SERVER_START_TIMEOUT);
+        while (Clock::now() < deadline) {
+            int status;
+            if (waitpid(pid_, &status, WNOHANG) == pid_) {
+                fprintf(stderr, "server exited during startup, see %s\n", SERVER_LOG_NAME);
+                pid_ = -1;
+                return nullptr;
+            }
+            if (access(opts_.unix_socket_path, F_OK) == 0) {
+                int sockfd = init_unix_sock(opts_.unix_socket_path);
+                if (sockfd >= 0) return std::make_unique<Connection>(sockfd);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        fprintf(stderr, "server did not start in %d s\n", SERVER_START_TIMEOUT);
+        kill_now();
+        return nullptr;
+    }
+
+    /* 模拟断电：SIGKILL不给服务端任何机会写回缓冲池或日志 */
+    void kill_now() {
+        kill(pid_, SIGKILL);
+        waitpid(pid_, nullptr, 0);
+        pid_ = -1;
+    }
+
+    /* 与SIGKILL不同，crash命令调用exit(1)之前会写完output.txt */
+    void crash(Connection *conn) {
+        conn->execute("crash");
+        waitpid(pid_, nullptr, 0);
+        pid_ = -1;
+    }
+
+    /* 与Ctrl+C相同，服务端写回所有脏页后退出 */
+    bool stop() {
+        kill(pid_, SIGINT);
+        int status;
+        waitpid(pid_, &status, 0);
+        pid_ = -1;
+        return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+};
+
+/**
+ * @brief 客户端记录的参考状态：每个校验连接最后一个确认提交的版本，以及连接断开时已经发出commit、结果未知的版本
+ */
+struct Reference {
+    std::vector<int> acked;
+    std::vector<char> in_doubt;     // 不用vector<bool>，各连接的线程并发修改各自的元素
+
+    explicit Reference(int clients) : acked(clients, 0), in_doubt(clients, false) {}
+};
+
+/**
+ * @brief 校验事务：把连接c的所有行改为下一个版本，并在crash_history中记下这个版本
+ */
+Outcome run_txn(Connection *conn, int c, Reference *ref) {
+    int version = ref->acked[c] + 1;
+    std::string cs = std::to_string(c), vs = std::to_string(version);
+    Outcome outcome = conn->execute("begin;");
+    for (int slot = 0; slot < ACCOUNT_SLOTS && outcome == Outcome::OK; slot++) {
+        outcome = conn->execute("update crash_account set ver = " + vs + " where c_id = " + cs +
+                                " and slot = " + std::to_string(slot) + ";");
+    }
+    if (outcome == Outcome::OK) {
+        outcome = conn->execute("insert into crash_history values (" + cs + ", " + vs + ");");
+    }
+    if (outcome == Outcome::OK) {
+        outcome = conn->execute("commit;");
+        if (outcome == Outcome::OK) {
+            ref->acked[c] = version;
+        } else if (outcome == Outcome::LOST) {
+            ref->in_doubt[c] = true;
+        }
+    } else if (outcome == Outcome::ERROR) {
+        conn->execute("abort;");
+    }
+    return outcome;
+}
+
+/**
+ * @brief 由opts.connections个连接并发运行校验事务，直到deadline或者服务端退出
+ * @return 提交的事务数
+ */
+uint64_t run_clients(const Options &opts, Reference *ref, Clock::time_point deadline) {
+    std::atomic<uint64_t> commits{0};
+    std::vector<std::thread> clients;
+    for (int c = 0; c < opts.connections; c++) {
+        clients.emplace_back([&, c] {
+            int sockfd = init_unix_sock(opts.unix_socket_path);
+            if (sockfd < 0) return;
+            Connection conn(sockfd);
+            while (Clock::now() < deadline) {
+                Outcome outcome = run_txn(&conn, c, ref);
+                if (outcome == Outcome::LOST) break;
+                if (outcome == Outcome::OK) commits++;
+            }
+        });
+    }
+    for (auto &t : clients) t.join();
+    return commits;
+}
+
+/**
+ * @brief 比对恢复后的数据与参考状态，结果未知的版本按实际是否提交更新参考状态
+ * @return 不一致的连接数
+ */
+int verify(Connection *conn, Reference *ref) {
+    std::string response;
+    if (conn->execute("select c_id, slot, ver from crash_account;", &response) != Outcome::OK) {
+        fprintf(stderr, "failed to read crash_account: %s\n", response.c_str());
+        return static_cast<int>(ref->acked.size());
+    }
+    std::vector<std::vector<int>> versions(ref->acked.size());
+    for (auto &row : result_rows(response)) {
+        size_t c = static_cast<size_t>(atoi(row[0].c_str()));
+        if (row.size() == 3 && c < versions.size()) versions[c].push_back(atoi(row[2].c_str()));
+    }
+    int failures = 0;
+    for (size_t c = 0; c < versions.size(); c++) {
+        auto &v = versions[c];
+        int expect = ref->acked[c];
+        bool atomic = v.size() == ACCOUNT_SLOTS && std::count(v.begin(), v.end(), v[0]) == ACCOUNT_SLOTS;
+        bool durable = atomic && (v[0] == expect || (ref->in_doubt[c] && v[0] == expect + 1));
+        if (durable) {
+            conn->execute("select count(*) as n from crash_history where c_id = " + std::to_string(c) + ";", &response);
+            auto rows = result_rows(response);
+            durable = !rows.empty() && !rows[0].empty() && atoi(rows[0][0].c_str()) == v[0];
+        }
+        if (!durable) {
+            fprintf(stderr, "client %zu: expect version %d%s, recovered", c, expect, ref->in_doubt[c] ? " or next" : "");
+            for (int ver : v) fprintf(stderr, " %d", ver);
+            fprintf(stderr, "\n");
+            failures++;
+            continue;
+        }
+        ref->acked[c] = v[0];
+        ref->in_doubt[c] = false;
+    }
+    return failures;
+}
+
+/**
+ * @brief 运行rmdb_loadgen，args为除连接参数以外的参数
+ */
+pid_t spawn_loadgen(const Options &opts, std::vector<std::string> args) {
+    args.insert(args.begin(), {opts.loadgen_path, "-s", opts.unix_socket_path, "-w", opts.workload, "-n",
+                               std::to_string(opts.records)});
+    pid_t pid = fork();
+    if (pid == 0) {
+        int fd = open("/dev/null", O_WRONLY);
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        std::vector<char *> argv;
+        for (auto &arg : args) argv.push_back(arg.data());
+        argv.push_back(nullptr);
+        execv(opts.loadgen_path, argv.data());
+        _exit(127);
+    }
+    return pid;
+}
+
+/**
+ * @brief 重新创建数据库和校验事务使用的表，需要时导入背景负载的数据
+ */
+bool setup(const Options &opts, ServerProcess *server) {
+    std::filesystem::remove_all(opts.db_name);
+    auto conn = server->start({});
+    if (conn == nullptr) return false;
+    if (!opts.workload.empty()) {
+        int status;
+        waitpid(spawn_loadgen(opts, {"-l", "-d", "1"}), &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "failed to load workload %s with %s\n", opts.workload.c_str(), opts.loadgen_path);
+            return false;
+        }
+    }
+    std::vector<std::string> stmts = {"create table crash_account (c_id int, slot int, ver int);",
+                                      "create index crash_account(c_id, slot);",
+                                      "create table crash_history (c_id int, ver int);"};
+    for (int c = 0; c < opts.connections; c++) {
+        for (int slot = 0; slot < ACCOUNT_SLOTS; slot++) {
+            stmts.push_back("insert into crash_account values (" + std::to_string(c) + ", " + std::to_string(slot) +
+                            ", 0);");
+        }
+    }
+    for (auto &stmt : stmts) {
+        if (conn->execute(stmt) != Outcome::OK) {
+            fprintf(stderr, "failed to execute: %s\n", stmt.c_str());
+            return false;
+        }
+    }
+    return server->stop();
+}
+
+std::map<std::string, std::string> server_env(const Options &opts, bool group_commit) {
+    std::map<std::string, std::string> env;
+    if (group_commit) env["RMDB_LOG_GROUP_COMMIT_TIMEOUT_US"] = std::to_string(opts.group_commit_us);
+    if (opts.checkpoint_ms > 0) env["RMDB_CHECKPOINT_INTERVAL_MS"] = std::to_string(opts.checkpoint_ms);
+    return env;
+}
+
+void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-b server_binary] [-L loadgen_binary] [-D db_name] [-s unix_socket] [-c connections]\n"
+            "          [-d seconds] [-R rounds] [-K max_kill_ms] [-g group_commit_us] [-k checkpoint_ms]\n"
+            "          [-w a|b|c|d|e|f|tpcc] [-n ycsb_records] [-S seed] [-C]\n",
+            prog);
+}
+
+int main(int argc, char *argv[]) {
+    Options opts;
+    int opt;
+    while ((opt = getopt(argc, argv, "b:L:D:s:c:d:R:K:g:k:w:n:S:C")) > 0) {
+        switch (opt) {
+            case 'b':
+                opts.server_path = optarg;
+                break;
+            case 'L':
+                opts.loadgen_path = optarg;
+                break;
+            case 'D':
+                opts.db_name = optarg;
+                break;
+            case 's':
+                opts.unix_socket_path = optarg;
+                break;
+            case 'c':
+                opts.connections = std::max(1, atoi(optarg));
+                break;
+            case 'd':
+                opts.duration = std::max(1, atoi(optarg));
+                break;
+            case 'R':
+                opts.rounds = std::max(0, atoi(optarg));
+                break;
+            case 'K':
+                opts.max_kill_ms = std::max(10, atoi(optarg));
+                break;
+            case 'g':
+                opts.group_commit_us = std::max(1, atoi(optarg));
+                break;
+            case 'k':
+                opts.checkpoint_ms = std::max(0, atoi(optarg));
+                break;
+            case 'w':
+                opts.workload = optarg;
+                break;
+            case 'n':
+                opts.records = std::max(1, atoi(optarg));
+                break;
+            case 'S':
+                opts.seed = static_cast<unsigned>(atoi(optarg));
+                break;
+            case 'C':
+                opts.crash_command = true;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    // 连接断开时向已关闭的socket写入不应终止本进程
+    signal(SIGPIPE, SIG_IGN);
+    ServerProcess server(opts);
+    if (!setup(opts, &server)) {
+        fprintf(stderr, "setup failed\n");
+        return 1;
+    }
+    Reference ref(opts.connections);
+    int failures = 0;
+
+    printf("%-14s %12s %14s %16s\n", "group commit", "commits/s", "log bytes/txn", "first query(ms)");
+    for (bool group_commit : {false, true}) {
+        auto start = Clock::now();
+        auto conn = server.start(server_env(opts, group_commit));
+        if (conn == nullptr) return 1;
+        failures += verify(conn.get(), &ref);
+        double first_query_ms = ms_since(start);
+        double log_bytes = metric(conn.get(), "log bytes");
+        auto run_start = Clock::now();
+        uint64_t commits = run_clients(opts, &ref, run_start + std::chrono::seconds(opts.duration));
+        double seconds = ms_since(run_start) / 1000;
+        log_bytes = metric(conn.get(), "log bytes") - log_bytes;
+        std::string name = group_commit ? "on(" + std::to_string(opts.group_commit_us) + "us)" : "off";
+        printf("%-14s %12.1f %14.1f %16.1f\n", name.c_str(), commits / seconds, commits == 0 ? 0 : log_bytes / commits,
+               first_query_ms);
+        conn.reset();
+        if (!server.stop()) {
+            fprintf(stderr, "server did not shut down cleanly\n");
+            failures++;
+        }
+    }
+
+    printf("\n%-6s %10s %10s %12s %10s %10s %16s %8s\n", "round", "kill(ms)", "commits", "analyze(ms)", "redo(ms)",
+           "undo(ms)", "first query(ms)", "verify");
+    std::mt19937 rng(opts.seed);
+    double total_recovery_ms = 0, max_recovery_ms = 0, total_first_query_ms = 0;
+    for (int round = 1; round <= opts.rounds + 1; round++) {
+        auto start = Clock::now();
+        auto conn = server.start(server_env(opts, true));
+        if (conn == nullptr) return 1;
+        int round_failures = verify(conn.get(), &ref);
+        double first_query_ms = ms_since(start);
+        failures += round_failures;
+        double analyze_ms = metric(conn.get(), "rec analyze(ms)");
+        double redo_ms = metric(conn.get(), "rec redo(ms)");
+        double undo_ms = metric(conn.get(), "rec undo(ms)");
+        // 第一轮之前的重启是正常关闭之后的，不计入恢复时间，最后一次重启只用于检查最后一轮
+        if (round > 1) {
+            double recovery_ms = analyze_ms + redo_ms + undo_ms;
+            total_recovery_ms += recovery_ms;
+            max_recovery_ms = std::max(max_recovery_ms, recovery_ms);
+            total_first_query_ms += first_query_ms;
+            printf("%10.1f %10.1f %10.1f %16.1f %8s\n", analyze_ms, redo_ms, undo_ms, first_query_ms,
+                   round_failures == 0 ? "ok" : "FAILED");
+        }
+        if (round > opts.rounds) {
+            conn.reset();
+            server.stop();
+            break;
+        }
+
+        int kill_ms = std::uniform_int_distribution<int>(opts.max_kill_ms / 10, opts.max_kill_ms)(rng);
+        pid_t loadgen = opts.workload.empty() ? -1 : spawn_loadgen(opts, {"-d", "3600"});
+        std::atomic<uint64_t> commits{0};
+        std::thread clients([&] { commits = run_clients(opts, &ref, Clock::time_point::max()); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(kill_ms));
+        if (opts.crash_command) {
+            server.crash(conn.get());
+        } else {
+            server.kill_now();
+        }
+        clients.join();
+        if (loadgen > 0) waitpid(loadgen, nullptr, 0);
+        printf("%-6d %10d %10lu ", round, kill_ms, commits.load());
+        fflush(stdout);
+    }
+    if (opts.rounds > 0) {
+        printf("recovery avg %.1f ms, max %.1f ms, first query avg %.1f ms\n", total_recovery_ms / opts.rounds,
+               max_recovery_ms, total_first_query_ms / opts.rounds);
+    }
+    if (failures > 0) {
+        printf("%d verification failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
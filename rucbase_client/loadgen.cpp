@@ -0,0 +1,632 @@
+/**
+ * rmdb_loadgen：用N个并发连接向运行中的服务端施加负载，统计吞吐量、延迟分位数和回滚率，用于容量规划和发布前的验证。
+ * 负载包括YCSB A-F（不同的读写比例和key分布）以及TPC-C-lite的new-order/payment事务。
+ * -l先删除并重新创建负载使用的表、导入初始数据，之后按-d给出的秒数运行负载
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "client_conn.h"
+
+#define LOAD_BATCH_SIZE 8192        // 导入数据时合并成一个请求的语句总长度上限
+#define YCSB_FIELD_LEN 100          // usertable每个字段的长度
+#define YCSB_MAX_SCAN_LEN 100       // YCSB E范围扫描的最大长度
+#define ZIPFIAN_CONSTANT 0.99
+#define TPCC_DISTRICTS 10           // 每个仓库的地区数
+#define TPCC_CUSTOMERS 300          // 每个地区的顾客数
+#define TPCC_ITEMS 1000             // 商品数，每个仓库对每个商品有一条库存
+#define TPCC_MIN_ORDER_LINES 5
+#define TPCC_MAX_ORDER_LINES 15
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    const char *unix_socket_path = nullptr;
+    const char *server_host = "127.0.0.1";
+    int server_port = PORT_DEFAULT;
+    int connections = 8;
+    int duration = 10;              // 运行负载的秒数
+    std::string workload = "a";     // a-f为YCSB负载，tpcc为TPC-C-lite
+    int records = 10000;            // YCSB的初始记录数
+    int warehouses = 1;             // TPC-C-lite的仓库数
+    int new_order_percent = 50;     // TPC-C-lite中new-order事务的比例，其余为payment
+    bool load = false;
+};
+
+/* 一条语句的执行结果：abort表示服务端回滚了事务，error表示语句执行失败 */
+enum class Outcome { OK, ABORT, ERROR };
+
+/**
+ * @brief 一个使用文本结果格式的连接，逐条发送语句并等待响应
+ */
+class Connection {
+    int sockfd_;
+    ResponseReader reader_;
+
+   public:
+    explicit Connection(int sockfd) : sockfd_(sockfd), reader_(sockfd) {}
+
+    ~Connection() {
+        if (sockfd_ >= 0) {
+            close(sockfd_);
+        }
+    }
+
+    static std::unique_ptr<Connection> open(const Options &opts) {
+        int sockfd = opts.unix_socket_path != nullptr ? init_unix_sock(opts.unix_socket_path)
+                                                      : init_tcp_sock(opts.server_host, opts.server_port);
+        return sockfd < 0 ? nullptr : std::make_unique<Connection>(sockfd);
+    }
+
+    /**
+     * @brief 执行请求，连接断开时退出进程，负载的统计结果已经没有意义
+     */
+    Outcome execute(const std::string &sql, std::string *response = nullptr) {
+        std::string local;
+        std::string *out = response != nullptr ? response : &local;
+        out->clear();
+        if (!send_request(sockfd_, sql) || !reader_.read_text(out)) {
+            exit(1);
+        }
+        if (out->compare(0, 5, "abort") == 0) {
+            return Outcome::ABORT;
+        }
+        if (out->compare(0, 5, "Error") == 0 || out->compare(0, 7, "failure") == 0) {
+            return Outcome::ERROR;
+        }
+        return Outcome::OK;
+    }
+};
+
+/**
+ * @brief 取出文本格式结果中第一行记录的各个字段，没有记录时返回空
+ */
+std::vector<std::string> first_row(const std::string &response) {
+    std::vector<std::string> cells;
+    size_t line = 0;
+    int rows = 0;
+    while (line < response.size()) {
+        size_t end = response.find('\n', line);
+        if (end == std::string::npos) end = response.size();
+        // 第一行以'|'开头的是表头，第二行为第一条记录
+        if (response[line] == '|' && rows++ == 1) {
+            for (size_t pos = line + 1; pos < end;) {
+                size_t bar = response.find('|', pos);
+                if (bar == std::string::npos || bar > end) break;
+                std::string cell = response.substr(pos, bar - pos);
+                size_t first = cell.find_first_not_of(' ');
+                size_t last = cell.find_last_not_of(' ');
+                cells.push_back(first == std::string::npos ? "" : cell.substr(first, last - first + 1));
+                pos = bar + 1;
+            }
+            return cells;
+        }
+        line = end + 1;
+    }
+    return cells;
+}
+
+/**
+ * @brief 执行一个事务中的语句，失败时事务结束：abort时服务端已经回滚，error时由客户端回滚
+ */
+class TxnRunner {
+    Connection *conn_;
+    Outcome outcome_ = Outcome::OK;
+
+   public:
+    explicit TxnRunner(Connection *conn) : conn_(conn) {}
+
+    bool ok() const { return outcome_ == Outcome::OK; }
+
+    Outcome outcome() const { return outcome_; }
+
+    bool run(const std::string &sql, std::string *response = nullptr) {
+        if (!ok()) return false;
+        outcome_ = conn_->execute(sql, response);
+        if (outcome_ == Outcome::ERROR) {
+            conn_->execute("abort;");
+        }
+        return ok();
+    }
+
+    /**
+     * @brief 读取结果的第一行，没有结果时事务按失败处理
+     */
+    bool read_row(const std::string &sql, size_t num_cols, std::vector<std::string> *row) {
+        std::string response;
+        if (!run(sql, &response)) return false;
+        *row = first_row(response);
+        if (row->size() < num_cols) {
+            outcome_ = Outcome::ERROR;
+            conn_->execute("abort;");
+            return false;
+        }
+        return true;
+    }
+
+    bool read(const std::string &sql, size_t col, std::string *value) {
+        std::vector<std::string> row;
+        if (!read_row(sql, col + 1, &row)) return false;
+        *value = row[col];
+        return true;
+    }
+
+    Outcome commit() { return run("commit;") ? Outcome::OK : outcome_; }
+};
+
+/**
+ * @brief YCSB的Zipfian分布，生成[0, items)中的整数，0最热（Gray等人的算法）
+ */
+class ZipfianGenerator {
+    uint64_t items_;
+    double theta_;
+    double alpha_;
+    double zetan_;
+    double eta_;
+
+   public:
+    explicit ZipfianGenerator(uint64_t items, double theta = ZIPFIAN_CONSTANT) : items_(items), theta_(theta) {
+        double zeta2 = zeta(2);
+        zetan_ = zeta(items_);
+        alpha_ = 1.0 / (1.0 - theta_);
+        eta_ = (1 - std::pow(2.0 / items_, 1 - theta_)) / (1 - zeta2 / zetan_);
+    }
+
+    uint64_t next(std::mt19937_64 &rng) const {
+        double u = std::uniform_real_distribution<double>(0, 1)(rng);
+        double uz = u * zetan_;
+        if (uz < 1.0) return 0;
+        if (uz < 1.0 + std::pow(0.5, theta_)) return 1;
+        return std::min<uint64_t>(items_ - 1, static_cast<uint64_t>(items_ * std::pow(eta_ * u - eta_ + 1, alpha_)));
+    }
+
+   private:
+    double zeta(uint64_t n) const {
+        double sum = 0;
+        for (uint64_t i = 0; i < n; i++) {
+            sum += 1 / std::pow(i + 1, theta_);
+        }
+        return sum;
+    }
+};
+
+/* 打散Zipfian生成的key，使热点分布在整个key空间中 */
+uint64_t fnv_hash(uint64_t value) {
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (int i = 0; i < 8; i++) {
+        hash ^= value & 0xff;
+        hash *= 1099511628211ull;
+        value >>= 8;
+    }
+    return hash;
+}
+
+/* 一种操作的统计信息，每个连接一份，结束时合并 */
+struct OpStats {
+    uint64_t count = 0;
+    uint64_t aborts = 0;
+    uint64_t errors = 0;
+    std::vector<double> latencies_us;   // 成功的操作的延迟
+
+    void record(Outcome outcome, Clock::time_point start) {
+        count++;
+        if (outcome == Outcome::ABORT) {
+            aborts++;
+        } else if (outcome == Outcome::ERROR) {
+            errors++;
+        } else {
+            latencies_us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        }
+    }
+
+    void merge(const OpStats &other) {
+        count += other.count;
+        aborts += other.aborts;
+        errors += other.errors;
+        latencies_us.insert(latencies_us.end(), other.latencies_us.begin(), other.latencies_us.end());
+    }
+};
+
+using StatsMap = std::map<std::string, OpStats>;
+
+/**
+ * @brief 一种负载：load导入初始数据，run由每个连接的线程反复调用，执行一次操作并记录统计信息
+ */
+class Workload {
+   public:
+    virtual ~Workload() = default;
+
+    virtual std::vector<std::string> schema() const = 0;
+
+    // 导入数据的语句，由第part个连接执行，共parts个连接
+    virtual std::vector<std::string> load_statements(int part, int parts) const = 0;
+
+    virtual void run(Connection *conn, std::mt19937_64 &rng, StatsMap *stats) = 0;
+};
+
+/* YCSB A-F各操作的比例和key的分布 */
+struct YcsbMix {
+    double read, update, insert, scan, rmw;
+    bool latest;        // D读取最近插入的记录，其余为打散的Zipfian分布
+};
+
+class YcsbWorkload : public Workload {
+    YcsbMix mix_;
+    int records_;
+    ZipfianGenerator zipf_;
+    std::atomic<int64_t> next_key_;     // 下一条插入的记录的key
+    std::string field_;
+
+   public:
+    YcsbWorkload(const YcsbMix &mix, int records)
+        : mix_(mix), records_(records), zipf_(records), next_key_(records), field_(YCSB_FIELD_LEN, 'x') {}
+
+    std::vector<std::string> schema() const override {
+        return {"create table usertable (ycsb_key int, field0 char(" + std::to_string(YCSB_FIELD_LEN) + "), field1 char(" +
+                    std::to_string(YCSB_FIELD_LEN) + "));",
+                "create index usertable(ycsb_key);"};
+    }
+
+    std::vector<std::string> load_statements(int part, int parts) const override {
+        std::vector<std::string> stmts;
+        for (int key = part; key < records_; key += parts) {
+            stmts.push_back(insert_sql(key));
+        }
+        return stmts;
+    }
+
+    void run(Connection *conn, std::mt19937_64 &rng, StatsMap *stats) override {
+        double p = std::uniform_real_distribution<double>(0, 1)(rng);
+        auto start = Clock::now();
+        if ((p -= mix_.read) < 0) {
+            (*stats)["read"].record(conn->execute(read_sql(choose_key(rng))), start);
+        } else if ((p -= mix_.update) < 0) {
+            (*stats)["update"].record(conn->execute(update_sql(choose_key(rng))), start);
+        } else if ((p -= mix_.insert) < 0) {
+            (*stats)["insert"].record(conn->execute(insert_sql(next_key_.fetch_add(1))), start);
+        } else if ((p -= mix_.scan) < 0) {
+            int64_t key = choose_key(rng);
+            int len = std::uniform_int_distribution<int>(1, YCSB_MAX_SCAN_LEN)(rng);
+            (*stats)["scan"].record(conn->execute("select * from usertable where ycsb_key >= " + std::to_string(key) +
+                                                  " and ycsb_key < " + std::to_string(key + len) + ";"),
+                                    start);
+        } else {
+            int64_t key = choose_key(rng);
+            TxnRunner txn(conn);
+            std::string value;
+            txn.run("begin;") && txn.read(read_sql(key), 1, &value) && txn.run(update_sql(key));
+            (*stats)["read_modify_write"].record(txn.ok() ? txn.commit() : txn.outcome(), start);
+        }
+    }
+
+   private:
+    int64_t choose_key(std::mt19937_64 &rng) const {
+        if (mix_.latest) {
+            int64_t last = next_key_.load(std::memory_order_relaxed) - 1;
+            return std::max<int64_t>(0, last - static_cast<int64_t>(zipf_.next(rng)));
+        }
+        return static_cast<int64_t>(fnv_hash(zipf_.next(rng)) % records_);
+    }
+
+    std::string insert_sql(int64_t key) const {
+        return "insert into usertable values (" + std::to_string(key) + ", '" + field_ + "', '" + field_ + "');";
+    }
+
+    static std::string read_sql(int64_t key) {
+        return "select * from usertable where ycsb_key = " + std::to_string(key) + ";";
+    }
+
+    std::string update_sql(int64_t key) const {
+        return "update usertable set field0 = '" + field_ + "' where ycsb_key = " + std::to_string(key) + ";";
+    }
+};
+
+/**
+ * TPC-C-lite：只保留new-order和payment两种事务以及它们访问的表，省略字符串等与并发控制无关的字段。
+ * new-order读取并递增地区的订单号，更新每个商品的库存并插入订单和订单明细；payment更新仓库、地区和顾客的金额
+ */
+class TpccWorkload : public Workload {
+    int warehouses_;
+    int new_order_percent_;
+
+   public:
+    TpccWorkload(int warehouses, int new_order_percent)
+        : warehouses_(warehouses), new_order_percent_(new_order_percent) {}
+
+    std::vector<std::string> schema() const override {
+        return {"create table warehouse (w_id int, w_ytd float);",
+                "create table district (d_w_id int, d_id int, d_next_o_id int, d_ytd float);",
+                "create table customer (c_w_id int, c_d_id int, c_id int, c_balance float, c_payment_cnt int);",
+                "create table item (i_id int, i_price float);",
+                "create table stock (s_w_id int, s_i_id int, s_quantity int);",
+                "create table orders (o_w_id int, o_d_id int, o_id int, o_c_id int, o_ol_cnt int);",
+                "create table order_line (ol_w_id int, ol_d_id int, ol_o_id int, ol_number int, ol_i_id int, "
+                "ol_quantity int);",
+                "create index warehouse(w_id);",
+                "create index district(d_w_id, d_id);",
+                "create index customer(c_w_id, c_d_id, c_id);",
+                "create index item(i_id);",
+                "create index stock(s_w_id, s_i_id);",
+                "create index orders(o_w_id, o_d_id, o_id);",
+                "create index order_line(ol_w_id, ol_d_id, ol_o_id, ol_number);"};
+    }
+
+    std::vector<std::string> load_statements(int part, int parts) const override {
+        std::vector<std::string> stmts;
+        if (part == 0) {
+            for (int i = 1; i <= TPCC_ITEMS; i++) {
+                stmts.push_back("insert into item values (" + std::to_string(i) + ", " + std::to_string(i % 100 + 1) +
+                                ".0);");
+            }
+        }
+        for (int w = 1 + part; w <= warehouses_; w += parts) {
+            std::string ws = std::to_string(w);
+            stmts.push_back("insert into warehouse values (" + ws + ", 0.0);");
+            for (int d = 1; d <= TPCC_DISTRICTS; d++) {
+                std::string ds = std::to_string(d);
+                stmts.push_back("insert into district values (" + ws + ", " + ds + ", 1, 0.0);");
+                for (int c = 1; c <= TPCC_CUSTOMERS; c++) {
+                    stmts.push_back("insert into customer values (" + ws + ", " + ds + ", " + std::to_string(c) +
+                                    ", 0.0, 0);");
+                }
+            }
+            for (int i = 1; i <= TPCC_ITEMS; i++) {
+                stmts.push_back("insert into stock values (" + ws + ", " + std::to_string(i) + ", 100);");
+            }
+        }
+        return stmts;
+    }
+
+    void run(Connection *conn, std::mt19937_64 &rng, StatsMap *stats) override {
+        int w = std::uniform_int_distribution<int>(1, warehouses_)(rng);
+        int d = std::uniform_int_distribution<int>(1, TPCC_DISTRICTS)(rng);
+        int c = std::uniform_int_distribution<int>(1, TPCC_CUSTOMERS)(rng);
+        auto start = Clock::now();
+        if (std::uniform_int_distribution<int>(0, 99)(rng) < new_order_percent_) {
+            (*stats)["new_order"].record(new_order(conn, rng, w, d, c), start);
+        } else {
+            double amount = std::uniform_int_distribution<int>(100, 500000)(rng) / 100.0;
+            (*stats)["payment"].record(payment(conn, w, d, c, amount), start);
+        }
+    }
+
+   private:
+    static std::string key(const std::string &col, int value) { return col + " = " + std::to_string(value); }
+
+    Outcome new_order(Connection *conn, std::mt19937_64 &rng, int w, int d, int c) {
+        std::string district = " where " + key("d_w_id", w) + " and " + key("d_id", d) + ";";
+        TxnRunner txn(conn);
+        std::string next_o_id;
+        if (!(txn.run("begin;") && txn.read("select d_next_o_id from district" + district, 0, &next_o_id))) {
+            return txn.outcome();
+        }
+        int o_id = atoi(next_o_id.c_str());
+        int ol_cnt = std::uniform_int_distribution<int>(TPCC_MIN_ORDER_LINES, TPCC_MAX_ORDER_LINES)(rng);
+        std::string ws = std::to_string(w), ds = std::to_string(d), os = std::to_string(o_id);
+        txn.run("update district set d_next_o_id = " + std::to_string(o_id + 1) + district);
+        txn.run("insert into orders values (" + ws + ", " + ds + ", " + os + ", " + std::to_string(c) + ", " +
+                std::to_string(ol_cnt) + ");");
+        for (int n = 1; n <= ol_cnt && txn.ok(); n++) {
+            int i = std::uniform_int_distribution<int>(1, TPCC_ITEMS)(rng);
+            int qty = std::uniform_int_distribution<int>(1, 10)(rng);
+            std::string stock = " where " + key("s_w_id", w) + " and " + key("s_i_id", i) + ";";
+            std::string price, quantity;
+            if (!(txn.read("select i_price from item where " + key("i_id", i) + ";", 0, &price) &&
+                  txn.read("select s_quantity from stock" + stock, 0, &quantity))) {
+                break;
+            }
+            int s_quantity = atoi(quantity.c_str()) - qty;
+            if (s_quantity < 10) s_quantity += 91;
+            txn.run("update stock set s_quantity = " + std::to_string(s_quantity) + stock);
+            txn.run("insert into order_line values (" + ws + ", " + ds + ", " + os + ", " + std::to_string(n) + ", " +
+                    std::to_string(i) + ", " + std::to_string(qty) + ");");
+        }
+        return txn.ok() ? txn.commit() : txn.outcome();
+    }
+
+    Outcome payment(Connection *conn, int w, int d, int c, double amount) {
+        std::string warehouse = " where " + key("w_id", w) + ";";
+        std::string district = " where " + key("d_w_id", w) + " and " + key("d_id", d) + ";";
+        std::string customer = " where " + key("c_w_id", w) + " and " + key("c_d_id", d) + " and " + key("c_id", c) + ";";
+        TxnRunner txn(conn);
+        std::string w_ytd, d_ytd;
+        std::vector<std::string> cust;
+        if (txn.run("begin;") && txn.read("select w_ytd from warehouse" + warehouse, 0, &w_ytd)) {
+            txn.run("update warehouse set w_ytd = " + std::to_string(atof(w_ytd.c_str()) + amount) + warehouse);
+        }
+        if (txn.read("select d_ytd from district" + district, 0, &d_ytd)) {
+            txn.run("update district set d_ytd = " + std::to_string(atof(d_ytd.c_str()) + amount) + district);
+        }
+        if (txn.read_row("select c_balance, c_payment_cnt from customer" + customer, 2, &cust)) {
+            txn.run("update customer set c_balance = " + std::to_string(atof(cust[0].c_str()) - amount) +
+                    ", c_payment_cnt = " + std::to_string(atoi(cust[1].c_str()) + 1) + customer);
+        }
+        return txn.ok() ? txn.commit() : txn.outcome();
+    }
+};
+
+std::unique_ptr<Workload> make_workload(const Options &opts) {
+    static const std::map<std::string, YcsbMix> mixes = {
+        {"a", {0.5, 0.5, 0, 0, 0, false}},  {"b", {0.95, 0.05, 0, 0, 0, false}}, {"c", {1, 0, 0, 0, 0, false}},
+        {"d", {0.95, 0, 0.05, 0, 0, true}}, {"e", {0, 0, 0.05, 0.95, 0, false}}, {"f", {0.5, 0, 0, 0, 0.5, false}}};
+    if (opts.workload == "tpcc") {
+        return std::make_unique<TpccWorkload>(opts.warehouses, opts.new_order_percent);
+    }
+    auto it = mixes.find(opts.workload);
+    return it == mixes.end() ? nullptr : std::make_unique<YcsbWorkload>(it->second, opts.records);
+}
+
+/**
+ * @brief 重新创建负载使用的表，再由所有连接并行导入初始数据，多条语句合并成一个请求
+ */
+bool load(const Options &opts, Workload *workload) {
+    auto conn = Connection::open(opts);
+    if (conn == nullptr) return false;
+    for (auto &stmt : workload->schema()) {
+        if (stmt.compare(0, 12, "create table") == 0) {
+            std::string table = stmt.substr(13, stmt.find(' ', 13) - 13);
+            conn->execute("drop table " + table + ";");
+        }
+        if (conn->execute(stmt) != Outcome::OK) {
+            fprintf(stderr, "failed to execute: %s\n", stmt.c_str());
+            return false;
+        }
+    }
+    std::atomic<bool> ok{true};
+    std::vector<std::thread> loaders;
+    for (int part = 0; part < opts.connections; part++) {
+        loaders.emplace_back([&, part] {
+            auto loader = Connection::open(opts);
+            if (loader == nullptr) {
+                ok = false;
+                return;
+            }
+            // 一个请求中各条语句的结果连接在一起返回，任何一条失败都算导入失败
+            auto flush = [&](std::string &request) {
+                std::string response;
+                loader->execute(request, &response);
+                if (response.find("abort") != std::string::npos || response.find("Error") != std::string::npos) {
+                    ok = false;
+                }
+                request.clear();
+            };
+            std::string request;
+            for (auto &stmt : workload->load_statements(part, opts.connections)) {
+                if (request.size() + stmt.size() > LOAD_BATCH_SIZE) {
+                    flush(request);
+                }
+                request += stmt;
+            }
+            if (!request.empty()) {
+                flush(request);
+            }
+        });
+    }
+    for (auto &t : loaders) t.join();
+    return ok;
+}
+
+void print_stats(const std::string &name, OpStats &stats, double seconds) {
+    std::sort(stats.latencies_us.begin(), stats.latencies_us.end());
+    auto pct = [&](double q) {
+        if (stats.latencies_us.empty()) return 0.0;
+        return stats.latencies_us[static_cast<size_t>(q * (stats.latencies_us.size() - 1))] / 1000;
+    };
+    uint64_t committed = stats.count - stats.aborts - stats.errors;
+    printf("%-18s %10lu %12.1f %8.2f %8.2f %9.3f %9.3f %9.3f %9.3f\n", name.c_str(), stats.count, committed / seconds,
+           stats.count == 0 ? 0.0 : 100.0 * stats.aborts / stats.count,
+           stats.count == 0 ? 0.0 : 100.0 * stats.errors / stats.count, pct(0.5), pct(0.95), pct(0.99), pct(1));
+}
+
+void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-h host] [-p port] [-s unix_socket] [-c connections] [-d seconds] [-w a|b|c|d|e|f|tpcc]\n"
+            "          [-n ycsb_records] [-W tpcc_warehouses] [-r tpcc_new_order_percent] [-l]\n",
+            prog);
+}
+
+int main(int argc, char *argv[]) {
+    Options opts;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:h:p:c:d:w:n:W:r:l")) > 0) {
+        switch (opt) {
+            case 's':
+                opts.unix_socket_path = optarg;
+                break;
+            case 'h':
+                opts.server_host = optarg;
+                break;
+            case 'p':
+                opts.server_port = atoi(optarg);
+                break;
+            case 'c':
+                opts.connections = std::max(1, atoi(optarg));
+                break;
+            case 'd':
+                opts.duration = std::max(1, atoi(optarg));
+                break;
+            case 'w':
+                opts.workload = optarg;
+                break;
+            case 'n':
+                opts.records = std::max(1, atoi(optarg));
+                break;
+            case 'W':
+                opts.warehouses = std::max(1, atoi(optarg));
+                break;
+            case 'r':
+                opts.new_order_percent = std::clamp(atoi(optarg), 0, 100);
+                break;
+            case 'l':
+                opts.load = true;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    auto workload = make_workload(opts);
+    if (workload == nullptr) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (opts.load) {
+        auto start = Clock::now();
+        if (!load(opts, workload.get())) {
+            fprintf(stderr, "failed to load data\n");
+            return 1;
+        }
+        printf("loaded in %.1f s\n", std::chrono::duration<double>(Clock::now() - start).count());
+    }
+
+    std::vector<StatsMap> stats(opts.connections);
+    std::vector<std::unique_ptr<Connection>> conns;
+    for (int i = 0; i < opts.connections; i++) {
+        conns.push_back(Connection::open(opts));
+        if (conns.back() == nullptr) return 1;
+    }
+    auto start = Clock::now();
+    auto deadline = start + std::chrono::seconds(opts.duration);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < opts.connections; i++) {
+        workers.emplace_back([&, i] {
+            std::mt19937_64 rng(i * 7919 + 1);
+            while (Clock::now() < deadline) {
+                workload->run(conns[i].get(), rng, &stats[i]);
+            }
+        });
+    }
+    for (auto &t : workers) t.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    StatsMap merged;
+    OpStats total;
+    for (auto &per_conn : stats) {
+        for (auto &[name, op] : per_conn) {
+            merged[name].merge(op);
+            total.merge(op);
+        }
+    }
+    printf("workload %s, %d connections, %.1f s\n", opts.workload.c_str(), opts.connections, seconds);
+    printf("%-18s %10s %12s %8s %8s %9s %9s %9s %9s\n", "op", "count", "ops/s", "abort%", "error%", "p50(ms)",
+           "p95(ms)", "p99(ms)", "max(ms)");
+    for (auto &[name, op] : merged) {
+        print_stats(name, op, seconds);
+    }
+    print_stats("total", total, seconds);
+    return 0;
+}
@@ -9,63 +9,214 @@
 #include <termios.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <vector>
 
-#define MAX_MEM_BUFFER_SIZE 8192
-#define PORT_DEFAULT 8765
+#include "client_conn.h"
+#include "common/result_format.h"
+
+#define BATCH_REQUEST_SIZE 8192  // 批量模式下合并成一个请求的语句总长度上限
+#define PIPELINE_DEPTH 8         // 批量模式下已发送但还没有读取响应的请求数上限
 
 bool is_exit_command(std::string &cmd) { return cmd == "exit" || cmd == "exit;" || cmd == "bye" || cmd == "bye;"; }
 
-int init_unix_sock(const char *unix_sock_path) {
-    int sockfd = socket(PF_UNIX, SOCK_STREAM, 0);
-    if (sockfd < 0) {
-        fprintf(stderr, "failed to create unix socket. %s", strerror(errno));
-        return -1;
+/**
+ * @brief 把服务端二进制格式的结果还原为与服务端文本格式相同的表格
+ */
+class ResultRenderer {
+    static constexpr size_t COL_WIDTH = 16;
+    std::vector<ResultColType> types_;
+    std::string out_;
+
+   public:
+    /**
+     * @brief 处理一个二进制帧中的所有消息，把生成的表格写到标准输出
+     */
+    bool render(const char *msg, const char *end) {
+        out_.clear();
+        while (msg < end) {
+            char tag = *msg++;
+            if (tag == RESULT_MSG_HEADER) {
+                uint16_t num_cols = get<uint16_t>(msg);
+                types_.clear();
+                std::vector<std::string> captions;
+                for (uint16_t i = 0; i < num_cols; i++) {
+                    types_.push_back(static_cast<ResultColType>(*msg++));
+                    get<uint16_t>(msg);  // 字段长度，表格输出不需要
+                    uint8_t name_len = static_cast<uint8_t>(*msg++);
+                    captions.emplace_back(msg, name_len);
+                    msg += name_len;
+                }
+                separator();
+                row(captions);
+                separator();
+            } else if (tag == RESULT_MSG_ROW) {
+                std::vector<std::string> cells;
+                for (auto type : types_) {
+                    if (type == RESULT_COL_INT) {
+                        cells.push_back(std::to_string(get<int32_t>(msg)));
+                    } else if (type == RESULT_COL_FLOAT) {
+                        cells.push_back(std::to_string(get<float>(msg)));
+                    } else {
+                        uint16_t len = get<uint16_t>(msg);
+                        cells.emplace_back(msg, len);
+                        msg += len;
+                    }
+                }
+                row(cells);
+            } else if (tag == RESULT_MSG_COUNT) {
+                separator();
+                out_ += "Total record(s): " + std::to_string(get<uint64_t>(msg)) + '\n';
+            } else {
+                fprintf(stderr, "Unexpected result message from server\n");
+                return false;
+            }
+        }
+        fwrite(out_.data(), 1, out_.size(), stdout);
+        return true;
     }
 
-    struct sockaddr_un sockaddr;
-    memset(&sockaddr, 0, sizeof(sockaddr));
-    sockaddr.sun_family = PF_UNIX;
-    snprintf(sockaddr.sun_path, sizeof(sockaddr.sun_path), "%s", unix_sock_path);
+   private:
+    template <typename T>
+    static T get(const char *&msg) {
+        T value;
+        memcpy(&value, msg, sizeof(T));
+        msg += sizeof(T);
+        return value;
+    }
 
-    if (connect(sockfd, (struct sockaddr *)&sockaddr, sizeof(sockaddr)) < 0) {
-        fprintf(stderr, "failed to connect to server. unix socket path '%s'. error %s", sockaddr.sun_path,
-                strerror(errno));
-        close(sockfd);
-        return -1;
+    void separator() {
+        for (size_t i = 0; i < types_.size(); i++) {
+            out_ += '+';
+            out_.append(COL_WIDTH + 2, '-');
+        }
+        out_ += "+\n";
     }
-    return sockfd;
-}
 
-int init_tcp_sock(const char *server_host, int server_port) {
-    struct hostent *host;
-    struct sockaddr_in serv_addr;
+    void row(const std::vector<std::string> &cells) {
+        for (auto col : cells) {
+            if (col.size() > COL_WIDTH) {
+                col = col.substr(0, COL_WIDTH - 3) + "...";
+            }
+            out_ += "| ";
+            out_.append(COL_WIDTH - col.size(), ' ');
+            out_ += col;
+            out_ += ' ';
+        }
+        out_ += "|\n";
+    }
+};
 
-    if ((host = gethostbyname(server_host)) == NULL) {
-        fprintf(stderr, "gethostbyname failed. errmsg=%d:%s\n", errno, strerror(errno));
-        return -1;
+/**
+ * @brief 接收二进制结果格式的响应，逐帧输出直到最后一帧
+ */
+bool recv_frame_response(ResponseReader *reader, ResultRenderer *renderer) {
+    std::vector<char> payload;
+    bool last = false;
+    while (!last) {
+        char header[RESULT_FRAME_HEADER_SIZE];
+        if (!reader->read_exact(header, sizeof(header))) {
+            return false;
+        }
+        uint32_t len;
+        ResultFrameKind kind;
+        decode_frame_header(header, &len, &kind, &last);
+        payload.resize(len);
+        if (!reader->read_exact(payload.data(), len)) {
+            return false;
+        }
+        if (kind == RESULT_FRAME_TEXT) {
+            fwrite(payload.data(), 1, len, stdout);
+        } else if (!renderer->render(payload.data(), payload.data() + len)) {
+            return false;
+        }
     }
+    return true;
+}
 
-    int sockfd;
-    if ((sockfd = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
-        fprintf(stderr, "create socket error. errmsg=%d:%s\n", errno, strerror(errno));
-        return -1;
+/**
+ * @brief 接收一个响应并输出到标准输出
+ */
+bool recv_response(ResponseReader *reader, bool binary_result, ResultRenderer *renderer) {
+    bool ok;
+    if (binary_result) {
+        ok = recv_frame_response(reader, renderer);
+    } else {
+        std::string response;
+        ok = reader->read_text(&response);
+        fwrite(response.data(), 1, response.size(), stdout);
     }
+    fflush(stdout);
+    return ok;
+}
 
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_port = htons(server_port);
-    serv_addr.sin_addr = *((struct in_addr *)host->h_addr);
-    bzero(&(serv_addr.sin_zero), 8);
+/**
+ * @brief 把脚本按';'拆成语句，字符串和注释中的';'不作为分隔符，最后一条语句可以没有';'
+ */
+std::vector<std::string> split_statements(const std::string &script) {
+    std::vector<std::string> stmts;
+    size_t start = 0;
+    size_t i = 0;
+    while (i < script.size()) {
+        if (script[i] == '\'') {
+            size_t end = script.find('\'', i + 1);
+            i = end == std::string::npos ? script.size() : end + 1;
+        } else if (script.compare(i, 2, "--") == 0) {
+            size_t end = script.find('\n', i);
+            i = end == std::string::npos ? script.size() : end + 1;
+        } else if (script.compare(i, 2, "/*") == 0) {
+            size_t end = script.find("*/", i + 2);
+            i = end == std::string::npos ? script.size() : end + 2;
+        } else if (script[i] == ';') {
+            i++;
+            stmts.push_back(script.substr(start, i - start));
+            start = i;
+        } else {
+            i++;
+        }
+    }
+    if (script.find_first_not_of(" \t\r\n", start) != std::string::npos) {
+        stmts.push_back(script.substr(start));
+    }
+    return stmts;
+}
 
-    if (connect(sockfd, (struct sockaddr *)&serv_addr, sizeof(struct sockaddr)) == -1) {
-        fprintf(stderr, "Failed to connect. errmsg=%d:%s\n", errno, strerror(errno));
-        close(sockfd);
-        return -1;
+/**
+ * @brief 批量执行脚本中的语句：多条语句合并成一个请求，并且不等响应连续发送多个请求，响应按顺序读取。
+ * 未读取响应的请求数不超过PIPELINE_DEPTH，避免双方都阻塞在发送上
+ */
+bool run_batch(int sockfd, ResponseReader *reader, bool binary_result, ResultRenderer *renderer,
+               const std::string &script) {
+    std::vector<std::string> requests;
+    for (auto &stmt : split_statements(script)) {
+        std::string trimmed = stmt.substr(stmt.find_first_not_of(" \t\r\n"));
+        trimmed.erase(trimmed.find_last_not_of(" \t\r\n") + 1);
+        if (is_exit_command(trimmed)) {
+            break;
+        }
+        if (requests.empty() || requests.back().size() + stmt.size() > BATCH_REQUEST_SIZE) {
+            requests.emplace_back();
+        }
+        requests.back() += stmt;
     }
-    return sockfd;
+    size_t sent = 0;
+    for (size_t received = 0; received < requests.size(); received++) {
+        while (sent < requests.size() && sent - received < PIPELINE_DEPTH) {
+            if (!send_request(sockfd, requests[sent++])) {
+                return false;
+            }
+        }
+        if (!recv_response(reader, binary_result, renderer)) {
+            return false;
+        }
+    }
+    return true;
 }
 
 int main(int argc, char *argv[]) {
@@ -78,10 +229,20 @@ int main(int argc, char *argv[]) {
     const char *unix_socket_path = nullptr;
     const char *server_host = "127.0.0.1";  // 127.0.0.1 192.168.31.25
     int server_port = PORT_DEFAULT;
+    bool text_result = false;
+    const char *batch_file = nullptr;
     int opt;
 
-    while ((opt = getopt(argc, argv, "s:h:p:")) > 0) {
+    while ((opt = getopt(argc, argv, "s:h:p:tf:")) > 0) {
         switch (opt) {
+            case 'f':
+                // 批量执行文件中的语句，"-"表示标准输入
+                batch_file = optarg;
+                break;
+            case 't':
+                // 使用服务端生成的文本表格，不协商二进制结果格式
+                text_result = true;
+                break;
             case 's':
                 unix_socket_path = optarg;
                 break;
@@ -111,7 +272,30 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    char recv_buf[MAX_MEM_BUFFER_SIZE];
+    ResponseReader reader(sockfd);
+    bool binary_result = false;
+    if (!text_result && !negotiate_binary_result(sockfd, &reader, &binary_result)) {
+        close(sockfd);
+        return 1;
+    }
+    ResultRenderer renderer;
+
+    if (batch_file != nullptr) {
+        std::ifstream file;
+        if (strcmp(batch_file, "-") != 0) {
+            file.open(batch_file);
+            if (!file) {
+                fprintf(stderr, "failed to open %s\n", batch_file);
+                close(sockfd);
+                return 1;
+            }
+        }
+        std::istream &in = file.is_open() ? file : std::cin;
+        std::string script((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        bool ok = run_batch(sockfd, &reader, binary_result, &renderer, script);
+        close(sockfd);
+        return ok ? 0 : 1;
+    }
 
     while (1) {
         char *line_read = readline("Rucbase> ");
@@ -134,22 +318,9 @@ int main(int argc, char *argv[]) {
                 std::cerr << "send error: " << errno << ":" << strerror(errno) << " \n" << std::endl;
                 exit(1);
             }
-            int len = recv(sockfd, recv_buf, MAX_MEM_BUFFER_SIZE, 0);
-            if (len < 0) {
-                fprintf(stderr, "Connection was broken: %s\n", strerror(errno));
-                break;
-            } else if (len == 0) {
-                printf("Connection has been closed\n");
+            bool ok = recv_response(&reader, binary_result, &renderer);
+            if (!ok) {
                 break;
-            } else {
-                for (int i = 0; i <= len; i++) {
-                    if (recv_buf[i] == '\0') {
-                        break;
-                    } else {
-                        printf("%c", recv_buf[i]);
-                    }
-                }
-                memset(recv_buf, 0, MAX_MEM_BUFFER_SIZE);
             }
         }
     }
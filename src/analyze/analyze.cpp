@@ -3,15 +3,36 @@
 /**
  * @description: 分析器，进行语义分析和查询重写，需要检查不符合语义规定的部分
  * @param {shared_ptr<ast::TreeNode>} parse parser生成的结果集
+ * @param {bool} allow_params 是否允许参数占位符，只有PREPARE中的语句可以使用
  * @return {shared_ptr<Query>} Query 
  */
-std::shared_ptr<Query> Analyze::do_analyze(std::shared_ptr<ast::TreeNode> parse)
+std::shared_ptr<Query> Analyze::do_analyze(std::shared_ptr<ast::TreeNode> parse, bool allow_params)
 {
+    if (auto x = std::dynamic_pointer_cast<ast::ExplainStmt>(parse)) {
+        // explain的语句按原样分析，优化器为它生成计划之后再加上explain节点
+        std::shared_ptr<Query> query = do_analyze(x->stmt, allow_params);
+        query->parse = std::move(parse);
+        return query;
+    }
+    if (auto x = std::dynamic_pointer_cast<ast::CreateMatView>(parse)) {
+        // 物化视图的定义按select语句分析，视图的内容是完整的结果，不能排序或截断，也不能引用其他物化视图
+        if (x->select->has_sort || x->select->limit >= 0) {
+            throw InvalidViewError("ORDER BY and LIMIT are not allowed in the definition");
+        }
+        std::shared_ptr<Query> query = do_analyze(x->select, allow_params);
+        for (auto &tab : query->referenced_tables()) {
+            if (sm_manager_->db_.get_table(tab).view.is_view()) {
+                throw InvalidViewError("the definition cannot use materialized view " + tab);
+            }
+        }
+        query->parse = std::move(parse);
+        return query;
+    }
     std::shared_ptr<Query> query = std::make_shared<Query>();
     if (auto x = std::dynamic_pointer_cast<ast::SelectStmt>(parse))
     {
         // 处理表名
-        query->tables = std::move(x->tabs);
+        query->tables = x->tabs;
         // 检查表是否存在
         for (auto tbl : query->tables) {
             if(!sm_manager_->db_.is_table(tbl)) {
@@ -19,29 +40,46 @@ std::shared_ptr<Query> Analyze::do_analyze(std::shared_ptr<ast::TreeNode> parse)
             }
         }
 
-        // 处理target list，再target list中添加上表名，例如 a.id
-        for (auto &sv_sel_col : x->cols) {
-            TabCol sel_col = {.tab_name = sv_sel_col->tab_name, .col_name = sv_sel_col->col_name};
-            query->cols.push_back(sel_col);
-        }
+        // 处理target list，再target list中添加上表名，例如 a.id；聚合函数用它的输出列名表示
         // auto all_cols = get_all_cols(query->tables);
         std::vector<ColMeta> all_cols;
         get_all_cols(query->tables, all_cols);
+        for (auto &sv_sel_col : x->cols) {
+            if (auto sv_agg = std::dynamic_pointer_cast<ast::AggCol>(sv_sel_col)) {
+                query->cols.push_back(get_aggregate(sv_agg, all_cols, query.get()));
+                continue;
+            }
+            TabCol sel_col = {.tab_name = sv_sel_col->tab_name, .col_name = sv_sel_col->col_name};
+            // infer table name from column name
+            query->cols.push_back(check_column(all_cols, sel_col));  // 列元数据校验
+        }
         if (query->cols.empty()) {
             // select all columns
             for (auto &col : all_cols) {
                 TabCol sel_col = {.tab_name = col.tab_name, .col_name = col.name};
                 query->cols.push_back(sel_col);
             }
-        } else {
-            // infer table name from column name
+        }
+        // 处理group by，有分组或聚合时，聚合函数之外的列都必须是分组列
+        for (auto &sv_group_col : x->groupby) {
+            TabCol group_col = {.tab_name = sv_group_col->tab_name, .col_name = sv_group_col->col_name};
+            query->group_cols.push_back(check_column(all_cols, group_col));
+        }
+        if (!query->aggs.empty() || !query->group_cols.empty()) {
             for (auto &sel_col : query->cols) {
-                sel_col = check_column(all_cols, sel_col);  // 列元数据校验
+                if (sel_col.tab_name.empty()) continue;
+                bool grouped = std::any_of(query->group_cols.begin(), query->group_cols.end(), [&](const TabCol &col) {
+                    return col.tab_name == sel_col.tab_name && col.col_name == sel_col.col_name;
+                });
+                if (!grouped) {
+                    throw GroupByError(sel_col.tab_name + '.' + sel_col.col_name);
+                }
             }
         }
         //处理where条件
-        get_clause(x->conds, query->conds);
+        get_clause(x->conds, query->conds, &query->sublinks);
         check_clause(query->tables, query->conds);
+        check_sublinks(query->tables, query->sublinks, allow_params);
     } else if (auto x = std::dynamic_pointer_cast<ast::UpdateStmt>(parse)) {
         // 处理 update 的set 值
         for (auto &sv_set_clause : x->set_clauses) {
@@ -49,10 +87,17 @@ std::shared_ptr<Query> Analyze::do_analyze(std::shared_ptr<ast::TreeNode> parse)
                                     .rhs = convert_sv_value(sv_set_clause->val)};
             query->set_clauses.push_back(set_clause);
         }
+        check_writable(x->tab_name);
         TabMeta &tab = sm_manager_->db_.get_table(x->tab_name);
         for (auto &set_clause : query->set_clauses) {
             auto lhs_col = tab.get_col(set_clause.lhs.col_name);
-            if (lhs_col->type != set_clause.rhs.type) {
+            // 修改分区键需要把记录移到另一个分区，不支持
+            if (tab.partition.is_partitioned() && lhs_col->name == tab.partition.col.name) {
+                throw InvalidPartitionError("cannot update partition key " + lhs_col->name);
+            }
+            // 参数的类型在执行时检查
+            if (set_clause.rhs.is_param()) continue;
+            if (!is_compatible_type(lhs_col->type, set_clause.rhs.type)) {
                 throw IncompatibleTypeError(coltype2str(lhs_col->type), coltype2str(set_clause.rhs.type));
             }
             set_clause.rhs.init_raw(lhs_col->len);
@@ -61,21 +106,64 @@ std::shared_ptr<Query> Analyze::do_analyze(std::shared_ptr<ast::TreeNode> parse)
         get_clause(x->conds, query->conds);
         check_clause({x->tab_name}, query->conds);
     } else if (auto x = std::dynamic_pointer_cast<ast::DeleteStmt>(parse)) {
+        check_writable(x->tab_name);
         //处理where条件
         get_clause(x->conds, query->conds);
         check_clause({x->tab_name}, query->conds);        
     } else if (auto x = std::dynamic_pointer_cast<ast::InsertStmt>(parse)) {
+        check_writable(x->tab_name);
         // 处理insert 的values值
         for (auto &sv_val : x->vals) {
             query->values.push_back(convert_sv_value(sv_val));
         }
+    } else if (auto x = std::dynamic_pointer_cast<ast::LoadData>(parse)) {
+        check_writable(x->tab_name);
+    } else if (auto x = std::dynamic_pointer_cast<ast::RefreshMatView>(parse)) {
+        if (!sm_manager_->db_.get_table(x->tab_name).view.is_view()) {
+            throw InvalidViewError(x->tab_name + " is not a materialized view");
+        }
+    } else if (auto x = std::dynamic_pointer_cast<ast::ExecuteStmt>(parse)) {
+        // execute的参数值，类型在绑定到预编译语句时检查
+        for (auto &sv_val : x->vals) {
+            query->values.push_back(convert_sv_value(sv_val));
+        }
     } else {
         // do nothing
     }
+    int num_params = 0;
+    number_params(query.get(), num_params);
+    query->num_params = num_params;
+    if (query->num_params > 0 && !allow_params) {
+        throw UnexpectedParamError();
+    }
     query->parse = std::move(parse);
     return query;
 }
 
+/**
+ * @brief 按参数在语句中出现的顺序为参数占位符编号：update的set子句在where条件之前，insert只有values，
+ * 子查询中的参数按子查询在where中的位置编号
+ */
+void Analyze::number_params(Query *query, int &idx) {
+    auto number = [&](Value &val) {
+        if (val.is_param()) val.param_idx = idx++;
+    };
+    for (auto &set_clause : query->set_clauses) number(set_clause.rhs);
+    for (size_t i = 0; i <= query->conds.size(); i++) {
+        for (auto &sublink : query->sublinks) {
+            if (sublink.cond_pos == i) number_params(sublink.query.get(), idx);
+        }
+        if (i < query->conds.size() && query->conds[i].is_rhs_val) number(query->conds[i].rhs_val);
+    }
+    for (auto &val : query->values) number(val);
+}
+
+/* 物化视图只能由视图维护和REFRESH修改，insert/update/delete/load data不能以它为目标 */
+void Analyze::check_writable(const std::string &tab_name) {
+    if (sm_manager_->db_.is_table(tab_name) && sm_manager_->db_.get_table(tab_name).view.is_view()) {
+        throw ViewNotWritableError(tab_name);
+    }
+}
 
 TabCol Analyze::check_column(const std::vector<ColMeta> &all_cols, TabCol target) {
     if (target.tab_name.empty()) {
@@ -94,15 +182,50 @@ TabCol Analyze::check_column(const std::vector<ColMeta> &all_cols, TabCol target
         }
         target.tab_name = tab_name;
     } else {
-        // Make sure target column exists
-        if (!(sm_manager_->db_.is_table(target.tab_name) &&
-              sm_manager_->db_.get_table(target.tab_name).is_col(target.col_name))) {
+        // Make sure target column exists，只能引用当前语句扫描的表，子查询中引用外层查询的字段也会在这里报错
+        bool found = std::any_of(all_cols.begin(), all_cols.end(), [&](const ColMeta &col) {
+            return col.tab_name == target.tab_name && col.name == target.col_name;
+        });
+        if (!found) {
             throw ColumnNotFoundError(target.tab_name + '.' + target.col_name);
         }
     }
     return target;
 }
 
+/**
+ * @brief 检查select列表中的一个聚合函数并加入query->aggs，相同的聚合函数只加入一次
+ *
+ * @return 聚合结果在投影列中的表示：表名为空，列名为聚合函数的输出列名
+ */
+TabCol Analyze::get_aggregate(const std::shared_ptr<ast::AggCol> &sv_agg, const std::vector<ColMeta> &all_cols,
+                              Query *query) {
+    static const std::map<ast::SvAggType, std::pair<AggType, std::string>> m = {
+        {ast::SV_AGG_COUNT, {AGG_COUNT, "COUNT"}}, {ast::SV_AGG_SUM, {AGG_SUM, "SUM"}},
+        {ast::SV_AGG_MIN, {AGG_MIN, "MIN"}},       {ast::SV_AGG_MAX, {AGG_MAX, "MAX"}},
+        {ast::SV_AGG_AVG, {AGG_AVG, "AVG"}},
+    };
+    auto &func = m.at(sv_agg->agg_type);
+    AggItem agg;
+    agg.type = func.first;
+    agg.col = {.tab_name = sv_agg->tab_name, .col_name = sv_agg->col_name};
+    std::string arg = sv_agg->tab_name.empty() ? sv_agg->col_name : sv_agg->tab_name + '.' + sv_agg->col_name;
+    agg.name = func.second + '(' + arg + ')';
+    if (agg.col.col_name != "*") {
+        agg.col = check_column(all_cols, agg.col);
+        ColType type = sm_manager_->db_.get_table(agg.col.tab_name).get_col(agg.col.col_name)->type;
+        if ((agg.type == AGG_SUM || agg.type == AGG_AVG) && is_string_type(type)) {
+            throw IncompatibleTypeError(coltype2str(type), func.second);
+        }
+    }
+    bool seen = std::any_of(query->aggs.begin(), query->aggs.end(),
+                            [&](const AggItem &item) { return item.name == agg.name; });
+    if (!seen) {
+        query->aggs.push_back(agg);
+    }
+    return {.tab_name = "", .col_name = agg.name};
+}
+
 void Analyze::get_all_cols(const std::vector<std::string> &tab_names, std::vector<ColMeta> &all_cols) {
     for (auto &sel_tab_name : tab_names) {
         // 这里db_不能写成get_db(), 注意要传指针
@@ -111,9 +234,30 @@ void Analyze::get_all_cols(const std::vector<std::string> &tab_names, std::vecto
     }
 }
 
-void Analyze::get_clause(const std::vector<std::shared_ptr<ast::BinaryExpr>> &sv_conds, std::vector<Condition> &conds) {
+/**
+ * @brief 把where条件转换为Condition；子查询条件加入sublinks，由check_sublinks分析子查询，
+ * sublinks为空时语句不支持子查询
+ */
+void Analyze::get_clause(const std::vector<std::shared_ptr<ast::BinaryExpr>> &sv_conds, std::vector<Condition> &conds,
+                         std::vector<SubLink> *sublinks) {
     conds.clear();
     for (auto &expr : sv_conds) {
+        if (auto subquery = std::dynamic_pointer_cast<ast::SubqueryExpr>(expr->rhs)) {
+            if (sublinks == nullptr) {
+                throw UnsupportedSubqueryError();
+            }
+            SubLink sublink;
+            sublink.is_exists = expr->op == ast::SV_OP_EXISTS || expr->op == ast::SV_OP_NOT_EXISTS;
+            sublink.negated = expr->op == ast::SV_OP_NOT_IN || expr->op == ast::SV_OP_NOT_EXISTS;
+            if (expr->lhs != nullptr) {
+                sublink.lhs_col = {.tab_name = expr->lhs->tab_name, .col_name = expr->lhs->col_name};
+            }
+            sublink.query = std::make_shared<Query>();
+            sublink.query->parse = subquery->stmt;
+            sublink.cond_pos = conds.size();
+            sublinks->push_back(std::move(sublink));
+            continue;
+        }
         Condition cond;
         cond.lhs_col = {.tab_name = expr->lhs->tab_name, .col_name = expr->lhs->col_name};
         cond.op = convert_sv_comp_op(expr->op);
@@ -143,7 +287,10 @@ void Analyze::check_clause(const std::vector<std::string> &tab_names, std::vecto
         auto lhs_col = lhs_tab.get_col(cond.lhs_col.col_name);
         ColType lhs_type = lhs_col->type;
         ColType rhs_type;
-        if (cond.is_rhs_val) {
+        if (cond.is_rhs_val && cond.rhs_val.is_param()) {
+            // 参数在执行时按左侧字段的类型检查并生成raw
+            continue;
+        } else if (cond.is_rhs_val) {
             cond.rhs_val.init_raw(lhs_col->len);
             rhs_type = cond.rhs_val.type;
         } else {
@@ -151,13 +298,53 @@ void Analyze::check_clause(const std::vector<std::string> &tab_names, std::vecto
             auto rhs_col = rhs_tab.get_col(cond.rhs_col.col_name);
             rhs_type = rhs_col->type;
         }
-        if (lhs_type != rhs_type) {
+        if (!is_compatible_type(lhs_type, rhs_type)) {
             throw IncompatibleTypeError(coltype2str(lhs_type), coltype2str(rhs_type));
         }
     }
 }
 
 
+/**
+ * @brief 分析where条件中的子查询。子查询按独立的select语句分析，只能引用它自己FROM中的表（不相关子查询）；
+ * IN的子查询只能选取一列，类型需要与左侧字段兼容
+ */
+void Analyze::check_sublinks(const std::vector<std::string> &tab_names, std::vector<SubLink> &sublinks,
+                             bool allow_params) {
+    std::vector<ColMeta> all_cols;
+    get_all_cols(tab_names, all_cols);
+    for (auto &sublink : sublinks) {
+        sublink.query = do_analyze(sublink.query->parse, allow_params);
+        if (sublink.is_exists) continue;
+        sublink.lhs_col = check_column(all_cols, sublink.lhs_col);
+        if (sublink.query->cols.size() != 1) {
+            throw SubqueryColumnError();
+        }
+        ColType lhs_type =
+            sm_manager_->db_.get_table(sublink.lhs_col.tab_name).get_col(sublink.lhs_col.col_name)->type;
+        ColType rhs_type = output_type(*sublink.query, sublink.query->cols[0]);
+        if (!is_compatible_type(lhs_type, rhs_type)) {
+            throw IncompatibleTypeError(coltype2str(lhs_type), coltype2str(rhs_type));
+        }
+    }
+}
+
+/**
+ * @brief 投影列col的类型：COUNT为整数，AVG为浮点数，其他聚合函数与参数字段相同
+ */
+ColType Analyze::output_type(const Query &query, const TabCol &col) {
+    if (col.tab_name.empty()) {
+        for (auto &agg : query.aggs) {
+            if (agg.name != col.col_name) continue;
+            if (agg.type == AGG_COUNT) return TYPE_INT;
+            if (agg.type == AGG_AVG) return TYPE_FLOAT;
+            return sm_manager_->db_.get_table(agg.col.tab_name).get_col(agg.col.col_name)->type;
+        }
+        throw InternalError("Unexpected aggregate column " + col.col_name);
+    }
+    return sm_manager_->db_.get_table(col.tab_name).get_col(col.col_name)->type;
+}
+
 Value Analyze::convert_sv_value(const std::shared_ptr<ast::Value> &sv_val) {
     Value val;
     if (auto int_lit = std::dynamic_pointer_cast<ast::IntLit>(sv_val)) {
@@ -166,6 +353,10 @@ Value Analyze::convert_sv_value(const std::shared_ptr<ast::Value> &sv_val) {
         val.set_float(float_lit->val);
     } else if (auto str_lit = std::dynamic_pointer_cast<ast::StringLit>(sv_val)) {
         val.set_str(str_lit->val);
+    } else if (std::dynamic_pointer_cast<ast::Placeholder>(sv_val)) {
+        // 先标记为参数，语义分析结束后由number_params按出现顺序编号
+        val.type = TYPE_INT;
+        val.param_idx = 0;
     } else {
         throw InternalError("Unexpected sv value type");
     }
@@ -10,6 +10,7 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <memory>
@@ -20,23 +21,57 @@ See the Mulan PSL v2 for more details. */
 #include "system/sm.h"
 #include "common/common.h"
 
+class Query;
+
+/**
+ * @brief where条件中的不相关子查询：IN/NOT IN把左侧字段与子查询唯一的输出列比较，
+ * EXISTS/NOT EXISTS只判断子查询是否有结果；优化器把它们转换为半连接和反连接
+ */
+struct SubLink {
+    bool is_exists;                 // EXISTS/NOT EXISTS，否则为IN/NOT IN
+    bool negated;                   // NOT IN/NOT EXISTS
+    TabCol lhs_col;                 // IN左侧的字段
+    std::shared_ptr<Query> query;   // 子查询
+    size_t cond_pos;                // 在where中出现在第几个普通条件之前，用于按出现顺序为参数编号
+};
+
 class Query{
     public:
     std::shared_ptr<ast::TreeNode> parse;
     // TODO jointree
     // where条件
     std::vector<Condition> conds;
-    // 投影列
+    // where条件中的子查询
+    std::vector<SubLink> sublinks;
+    // 投影列，聚合函数的表名为空、列名为其输出列名
     std::vector<TabCol> cols;
+    // GROUP BY的分组列
+    std::vector<TabCol> group_cols;
+    // select列表中的聚合函数，相同的聚合函数只出现一次
+    std::vector<AggItem> aggs;
     // 表名
     std::vector<std::string> tables;
     // update 的set 值
     std::vector<SetClause> set_clauses;
-    //insert 的values值
+    //insert 的values值，execute语句的参数值
     std::vector<Value> values;
+    // 预编译语句中参数占位符的个数
+    int num_params = 0;
 
     Query(){}
 
+    /* 语句引用的全部表，包括where条件中子查询引用的表，按第一次出现的顺序排列 */
+    std::vector<std::string> referenced_tables() const {
+        std::vector<std::string> tabs;
+        auto add = [&](const std::string &tab) {
+            if (std::find(tabs.begin(), tabs.end(), tab) == tabs.end()) tabs.push_back(tab);
+        };
+        for (auto &tab : tables) add(tab);
+        for (auto &sublink : sublinks) {
+            for (auto &tab : sublink.query->referenced_tables()) add(tab);
+        }
+        return tabs;
+    }
 };
 
 class Analyze
@@ -47,14 +82,20 @@ public:
     Analyze(SmManager *sm_manager) : sm_manager_(sm_manager){}
     ~Analyze(){}
 
-    std::shared_ptr<Query> do_analyze(std::shared_ptr<ast::TreeNode> root);
+    std::shared_ptr<Query> do_analyze(std::shared_ptr<ast::TreeNode> root, bool allow_params = false);
 
 private:
     TabCol check_column(const std::vector<ColMeta> &all_cols, TabCol target);
+    TabCol get_aggregate(const std::shared_ptr<ast::AggCol> &sv_agg, const std::vector<ColMeta> &all_cols, Query *query);
     void get_all_cols(const std::vector<std::string> &tab_names, std::vector<ColMeta> &all_cols);
-    void get_clause(const std::vector<std::shared_ptr<ast::BinaryExpr>> &sv_conds, std::vector<Condition> &conds);
+    void get_clause(const std::vector<std::shared_ptr<ast::BinaryExpr>> &sv_conds, std::vector<Condition> &conds,
+                    std::vector<SubLink> *sublinks = nullptr);
     void check_clause(const std::vector<std::string> &tab_names, std::vector<Condition> &conds);
+    void check_sublinks(const std::vector<std::string> &tab_names, std::vector<SubLink> &sublinks, bool allow_params);
+    ColType output_type(const Query &query, const TabCol &col);
     Value convert_sv_value(const std::shared_ptr<ast::Value> &sv_val);
     CompOp convert_sv_comp_op(ast::SvCompOp op);
+    void number_params(Query *query, int &idx);
+    void check_writable(const std::string &tab_name);
 };
 
@@ -0,0 +1,108 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "common/config.h"
+#include "common/memory_tracker.h"
+#include "errors.h"
+
+/**
+ * @description: 查询执行期间使用的内存池。内存从大块中顺序分配，不单独释放，
+ *              通过rewind()一次性释放某个位置之后分配的全部内存，已经申请的块保留下来供之后的分配复用，
+ *              析构时才归还给系统。每个客户端请求的Context拥有一个Arena，只由执行该请求的线程使用，因此不加锁。
+ *              设置了记账器时新申请的块计入记账器，超过内存限制时抛出MemoryLimitError
+ */
+class Arena {
+   public:
+    /* 分配位置，rewind()到该位置时释放之后分配的内存 */
+    struct Mark {
+        int block_no;
+        char *cur;
+    };
+
+    explicit Arena(size_t block_size = ARENA_BLOCK_SIZE) : block_size_(block_size) {}
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    ~Arena() {
+        if (tracker_ != nullptr) tracker_->release(get_reserved_bytes());
+    }
+
+    /* 之后申请的块计入tracker，只能在申请第一个块之前设置 */
+    void set_tracker(MemoryTracker *tracker) { tracker_ = tracker; }
+
+    /* 分配size字节的内存，按alignof(std::max_align_t)对齐，内存的内容未初始化 */
+    char *allocate(size_t size) {
+        size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        if (static_cast<size_t>(end_ - cur_) < size) {
+            next_block(size);
+        }
+        char *ptr = cur_;
+        cur_ += size;
+        return ptr;
+    }
+
+    Mark mark() const { return Mark{block_no_, cur_}; }
+
+    /* 释放mark之后分配的全部内存 */
+    void rewind(const Mark &mark) {
+        block_no_ = mark.block_no;
+        cur_ = mark.cur;
+        end_ = block_no_ < 0 ? nullptr : blocks_[block_no_].data.get() + blocks_[block_no_].size;
+    }
+
+    /* 释放全部已分配的内存 */
+    void reset() { rewind(Mark{-1, nullptr}); }
+
+    /* 已经向系统申请的内存总量 */
+    size_t get_reserved_bytes() const {
+        size_t total = 0;
+        for (auto &block : blocks_) {
+            total += block.size;
+        }
+        return total;
+    }
+
+   private:
+    static constexpr size_t ALIGNMENT = alignof(std::max_align_t);
+
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    /* 移动到下一个能容纳size字节的块，之后的块都放不下时申请新块；超过块大小的分配单独占用一个块 */
+    void next_block(size_t size) {
+        int next = block_no_ + 1;
+        if (next >= static_cast<int>(blocks_.size()) || blocks_[next].size < size) {
+            size_t block_size = size > block_size_ ? size : block_size_;
+            if (tracker_ != nullptr && !tracker_->try_consume(block_size)) {
+                throw MemoryLimitError(block_size);
+            }
+            blocks_.insert(blocks_.begin() + next, Block{std::unique_ptr<char[]>(new char[block_size]), block_size});
+        }
+        block_no_ = next;
+        cur_ = blocks_[next].data.get();
+        end_ = cur_ + blocks_[next].size;
+    }
+
+    size_t block_size_;
+    MemoryTracker *tracker_ = nullptr;
+    std::vector<Block> blocks_;
+    int block_no_ = -1;         // 当前分配所在的块，-1表示还没有分配
+    char *cur_ = nullptr;       // 当前块中下一次分配的位置
+    char *end_ = nullptr;       // 当前块的末尾
+};
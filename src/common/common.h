@@ -26,6 +26,10 @@ struct TabCol {
     friend bool operator<(const TabCol &x, const TabCol &y) {
         return std::make_pair(x.tab_name, x.col_name) < std::make_pair(y.tab_name, y.col_name);
     }
+
+    friend bool operator==(const TabCol &x, const TabCol &y) {
+        return x.tab_name == y.tab_name && x.col_name == y.col_name;
+    }
 };
 
 struct Value {
@@ -38,6 +42,10 @@ struct Value {
 
     std::shared_ptr<RmRecord> raw;  // raw record buffer
 
+    int param_idx = -1;  // 预编译语句中参数占位符的序号，-1表示常量
+
+    bool is_param() const { return param_idx >= 0; }
+
     void set_int(int int_val_) {
         type = TYPE_INT;
         int_val = int_val_;
@@ -85,4 +93,11 @@ struct Condition {
 struct SetClause {
     TabCol lhs;
     Value rhs;
-};
\ No newline at end of file
+};
+enum AggType { AGG_COUNT, AGG_SUM, AGG_MIN, AGG_MAX, AGG_AVG };
+
+struct AggItem {
+    AggType type;
+    TabCol col;         // aggregated column, col_name is "*" for COUNT(*)
+    std::string name;   // output column name, e.g. "SUM(score)"
+};
@@ -32,11 +32,99 @@ static constexpr int INVALID_TXN_ID = -1;                                     //
 static constexpr int INVALID_TIMESTAMP = -1;                                  // invalid transaction timestamp
 static constexpr int INVALID_LSN = -1;                                        // invalid log sequence number
 static constexpr int HEADER_PAGE_ID = 0;                                      // the header page id
-static constexpr int PAGE_SIZE = 4096;                                        // size of a data page in byte  4KB
+static constexpr int PAGE_SIZE = 4096;                                        // default and minimum page size in byte  4KB
+static constexpr int MAX_PAGE_SIZE = 1024 * 1024;                             // largest page size a database may choose  1MB
 static constexpr int BUFFER_POOL_SIZE = 65536;                                // size of buffer pool 256MB
 // static constexpr int BUFFER_POOL_SIZE = 262144;                                // size of buffer pool 1GB
+static constexpr int BUFFER_POOL_SHARDS = 16;                                 // default number of buffer pool shards
+static constexpr int MIN_FRAMES_PER_SHARD = 64;                               // minimum frames in one buffer pool shard
+static constexpr int NUMA_NODES = 0;                                          // NUMA nodes the buffer pool shards are spread over, 0 uses every node
+static constexpr int NUMA_EXTENT_PAGES = 64;                                  // consecutive pages of a file cached on the same node, one parallel scan morsel
+static constexpr int PAGE_CLEANER_INTERVAL_MS = 50;                           // page cleaner wake-up interval
+static constexpr int PAGE_CLEANER_CLEAN_PERCENT = 20;                         // share of frames kept clean by page cleaner
+static constexpr int PAGE_CLEANER_BATCH_SIZE = 256;                           // max pages written per shard per round
+static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;                     // frame arena is backed by 2MB huge pages
+static constexpr bool ENABLE_DIRECT_IO = false;                               // open data files with O_DIRECT
+static constexpr int PAGE_EXTENT_SIZE = 64;                                   // pages preallocated at once when a file grows
+static constexpr int COMPRESSED_PAGE_UNIT = 512;                              // compressed pages use slots of whole 512-byte units
+static constexpr int READ_AHEAD_PAGES = 32;                                   // pages requested by one sequential read-ahead
+static constexpr int PREFETCH_QUEUE_SIZE = 64;                                // max pending read-ahead requests
+static constexpr int POOL_WARM_UP_BATCH_PAGES = 32;                           // longest run of consecutive pages one warm-up read loads
+static constexpr bool POOL_WARM_UP = true;                                    // reload the pages resident at the last shutdown or checkpoint on startup
+static constexpr int SCAN_RING_SIZE = 256;                                    // frames recycled by one large sequential scan
+static constexpr int SCAN_RING_THRESHOLD = 4;                                 // scans over pool_size/4 pages use a scan ring
+static constexpr int RM_FSM_PARTITIONS = 4;                                 // free space map partitions, threads prefer their own
+static constexpr int LOAD_DATA_BATCH_SIZE = 4096;                             // records parsed before one bulk insert by LOAD DATA
+static constexpr int MAX_PARTITIONS = 1024;                                   // partitions a table may be split into by PARTITION BY
+static constexpr size_t EXEC_BATCH_SIZE = 1024;                               // tuples passed between executors by one NextBatch() call
+static constexpr size_t EXEC_NLJ_CACHE_SIZE = 64 * 1024 * 1024;               // bytes of the inner input a nested loop join keeps in memory
+static constexpr size_t EXEC_NLJ_BLOCK_SIZE = 16 * 1024 * 1024;               // bytes of outer tuples joined per scan of an uncached inner input
+static constexpr size_t EXEC_HASH_JOIN_MEM_SIZE = 64 * 1024 * 1024;           // build input a hash join keeps in memory before it spills partitions
+static constexpr int EXEC_HASH_JOIN_FANOUT = 32;                              // partitions written by one pass of a spilling hash join
+static constexpr int EXEC_HASH_JOIN_MAX_DEPTH = 3;                            // partitioning passes before a hash join builds an oversized partition anyway
+static constexpr size_t EXEC_RUNTIME_FILTER_MAX_ROWS = 1 << 22;               // build rows above which a hash join pushes no Bloom filter to its probe side
+static constexpr size_t EXEC_RUNTIME_FILTER_BITS_PER_KEY = 16;                // Bloom filter bits per build row of a runtime join filter
+static constexpr bool EXEC_PUSH_PIPELINE = true;                              // run select plans of projected hash joins as fused push pipelines
+static constexpr size_t EXEC_PIPELINE_MAX_JOINS = 4;                          // hash joins fused into one pipeline; deeper join chains use executors
+static constexpr size_t EXEC_AGG_MEM_SIZE = 64 * 1024 * 1024;                 // bytes of groups a hash aggregate keeps in memory before it spills new groups
+static constexpr int EXEC_WORKER_THREADS = 0;                                 // threads of the shared intra-query worker pool, 0 uses the hardware thread count
+static constexpr int EXEC_MORSEL_PAGES = 64;                                  // pages a parallel scan hands to one worker task
+static constexpr int EXEC_PARALLEL_SCAN_MIN_PAGES = 512;                      // tables with fewer pages are scanned by the client thread alone
+static constexpr size_t EXEC_DML_INDEX_BATCH = 4096;                          // rows whose index changes UPDATE/DELETE sort and apply together
+static constexpr size_t EXEC_SORT_MEM_SIZE = 64 * 1024 * 1024;                // bytes of (sort key, tuple) entries ORDER BY sorts in memory per run
+static constexpr size_t EXEC_SORT_READ_SIZE = 1024 * 1024;                    // bytes read from one sorted run at a time while merging
+static constexpr size_t EXEC_SORT_MIN_CHUNK = 1024 * 1024;                    // smallest block of entries a parallel sort hands to one worker task
+static constexpr size_t MATVIEW_MAX_INCREMENTAL_GROUPS = 256;                 // changed groups above which commit-time view maintenance recomputes the whole view
+static constexpr int SERVER_WORKER_THREADS = 16;                              // threads executing client requests, independent of the connection count
+static constexpr int SERVER_LISTEN_BACKLOG = 1024;                            // pending connections the listening socket queues
+static constexpr int SERVER_EPOLL_EVENTS = 256;                               // socket events the server event loop takes per epoll_wait
+static constexpr int SERVER_FRAGMENT_WAIT_MS = 5;                             // how long an unterminated first request waits for more data
+static constexpr size_t SERVER_LOG_QUEUE_SIZE = 10000;                        // server log messages queued for the writer thread before new ones are dropped
+static constexpr bool RESULT_STREAMING = true;                                // select results are sent in BUFFER_LENGTH chunks instead of truncated
+static constexpr size_t RESULT_CACHE_SIZE = 0;                                // bytes of select results cached across sessions, 0 disables the result cache
+static constexpr size_t OUTPUT_LOG_CHUNK_SIZE = 64 * 1024;                    // bytes of output.txt text one statement buffers before queueing it
+static constexpr int OUTPUT_LOG_FLUSH_MS = 10;                                // longest delay before queued output.txt text is written
+static constexpr size_t SLOW_QUERY_THRESHOLD_MS = 1000;                       // statements running longer are written to the slow query log, 0 disables it
+static constexpr size_t ARENA_BLOCK_SIZE = 64 * 1024;                         // block size of the per-query tuple arena
+static constexpr size_t MEMORY_LIMIT = 0;                                     // bytes all tracked memory may use, buffer pool included; 0 is unlimited
+static constexpr size_t EXEC_QUERY_MEM_LIMIT = 0;                             // bytes of arena and operator memory one statement may use; 0 is unlimited
+static constexpr size_t MEMORY_RESERVE_CHUNK = 1024 * 1024;                   // granularity at which spilling operators reserve memory from the trackers
+static constexpr double IX_BULK_FILL_FACTOR = 0.9;                            // node fill factor of bottom-up index builds
+static constexpr size_t IX_SORT_RUN_SIZE = 64 * 1024 * 1024;                  // bytes of index entries the build sort keeps in memory before spilling runs
+static constexpr int IX_ONLINE_CATCHUP_ROUNDS = 8;                            // delta merges of an online index build before it blocks DML to switch live
+static constexpr size_t IX_ONLINE_SWITCH_DELTA = 1024;                        // catch-up ends once one merge applies at most this many changes
+static constexpr int IX_PREFIX_COMPRESS_MIN_LEN = 8;                         // shortest memcmp-ordered index key stored prefix-compressed in leaves
+static constexpr int IX_HASH_MAX_DEPTH = 18;                                 // max global depth of the directory of an extendible hash index
+static constexpr int IX_RESIDENT_LEVELS = 2;                                 // top levels of each open B+ tree kept pinned in the buffer pool
+static constexpr int IX_RESIDENT_POOL_SHARE = 32;                             // resident nodes of one index take at most 1/32 of the buffer pool
+static constexpr int IX_PROBE_GROUP_SIZE = 16;                                // lookups one thread interleaves while probing an unordered key batch
+static constexpr int IX_LSM_MEMTABLE_ENTRIES = 16384;                         // entries an LSM index buffers in its memtable before flushing a sorted run
+static constexpr int IX_LSM_COMPACT_RUNS = 4;                                 // sorted runs of an LSM index at which its background thread merges runs
+static constexpr int IX_LSM_MAX_RUNS = 32;                                    // sorted runs an LSM index keeps at most; flushing merges first when reached
+static constexpr int IX_LSM_BLOOM_BITS_PER_KEY = 10;                          // Bloom filter bits per distinct key of an LSM sorted run
+static constexpr int LOCK_TABLE_PARTITIONS = 64;                               // lock table partitions, each with its own latch
+static constexpr int TXN_TABLE_PARTITIONS = 64;                               // transaction table partitions, each with its own latch
+static constexpr int TXN_POOL_SIZE = 16;                                      // finished transaction objects a thread keeps for reuse
+static constexpr size_t TXN_POOL_MAX_WRITES = 4096;                           // transactions that wrote more records are freed instead of reused
+static constexpr int LOCK_WAIT_TIMEOUT_MS = 1000;                              // longest a blocked lock request waits before its transaction aborts
+static constexpr size_t LOCK_ESCALATION_THRESHOLD = 5000;                     // row locks a transaction holds on one table before they are escalated to a table lock
+static constexpr int PREDICATE_LOCK_MAX_TUPLES = 1024;                         // written tuples a transaction records per table before it conflicts with every scan of the table
+static constexpr bool READ_ONLY_SNAPSHOT = true;                              // single-statement selects read a snapshot without locks, writers keep undo versions for them
 static constexpr int LOG_BUFFER_SIZE = (1024 * PAGE_SIZE);                    // size of a log buffer in byte
+static constexpr size_t LOG_GROUP_COMMIT_TIMEOUT_US = 0;                     // how long the log flusher waits after the first committer for others to join the flush
+static constexpr int CHECKPOINT_INTERVAL_MS = 30000;                          // fuzzy checkpoint interval, bounds the log replayed after a crash; 0 disables
+static constexpr int REDO_THREADS = 4;                                        // recovery redo workers, each replays the log records of the pages hashed to it
+static constexpr int REPLICATION_PORT = 0;                                    // port the primary ships its persisted log to replicas on; 0 disables
+static constexpr int REPLICATION_HEARTBEAT_MS = 1000;                         // an idle primary sends a heartbeat this often, replicas reconnect after 3 missed
 static constexpr int BUCKET_SIZE = 50;                                        // size of extendible hash bucket
+static constexpr int STATS_HLL_PRECISION = 12;                                // ANALYZE estimates distinct values with 2^12 HyperLogLog registers
+static constexpr int STATS_HISTOGRAM_BUCKETS = 32;                            // buckets of the equi-depth histogram of each column
+static constexpr int STATS_SAMPLE_ROWS = 30000;                               // rows sampled by ANALYZE to build the histograms
+static constexpr double COST_SEQ_PAGE = 1.0;                                  // optimizer cost of reading one page sequentially, the unit of all costs
+static constexpr double COST_RANDOM_PAGE = 4.0;                               // optimizer cost of reading one page at a random position
+static constexpr double COST_CPU_TUPLE = 0.01;                                // optimizer cost of producing, hashing or copying one tuple
+static constexpr double COST_CPU_OPERATOR = 0.0025;                           // optimizer cost of evaluating one predicate on one tuple or pair
+static constexpr int OPT_DP_MAX_TABLES = 8;                                   // joins of more tables are ordered greedily instead of by dynamic programming
 
 using frame_id_t = int32_t;  // frame id type, 帧页ID, 页在BufferPool中的存储单元称为帧,一帧对应一页
 using page_id_t = int32_t;   // page id type , 页ID
@@ -46,10 +134,47 @@ using slot_offset_t = size_t;  // slot offset type
 using oid_t = uint16_t;
 using timestamp_t = int32_t;  // timestamp type, used for transaction concurrency
 
-// log file
+// log file, and the master record pointing at the last checkpoint
 static const std::string LOG_FILE_NAME = "db.log";
+static const std::string LOG_MASTER_FILE_NAME = "db.log.master";
 
-// replacer
+// server log level, one of "DEBUG", "INFO", "WARN", "ERROR", "OFF"; per-request messages are DEBUG
+static const std::string SERVER_LOG_LEVEL = "INFO";
+
+// unix domain socket the server listens on besides TCP, for clients on the same host; "OFF" disables it
+static const std::string SERVER_UNIX_SOCKET = "/tmp/rmdb.sock";
+
+// primary a replica streams the log from, as "host:port"; "OFF" runs a standalone server or a primary
+static const std::string REPLICA_OF = "OFF";
+static const std::string REPLICA_STATE_FILE_NAME = "db.replica";              // replica's position in the primary's log
+
+// replacer, one of "LRU", "CLOCK", "LRU-K", "ARC"
 static const std::string REPLACER_TYPE = "LRU";
+static constexpr int LRUK_REPLACER_K = 2;                                     // K of the LRU-K replacer
+
+// lock conflict handling, one of "NO_WAIT", "WAIT_DIE", "WOUND_WAIT", "DETECTION"
+static const std::string LOCK_WAIT_POLICY = "NO_WAIT";
+
+// default isolation level of transactions, "SERIALIZABLE", "REPEATABLE_READ" or "READ_COMMITTED";
+// REPEATABLE_READ transactions read a snapshot taken when they begin, READ_COMMITTED transactions
+// one taken when each statement begins, neither takes read locks
+static const std::string ISOLATION_LEVEL = "SERIALIZABLE";
+
+// concurrency control, "2PL" or "OCC"; OCC transactions take no locks, read a snapshot taken when they
+// begin, claim the records they modify and validate the predicates they scanned at commit
+static const std::string CONCURRENCY_MODE = "2PL";
+
+// asynchronous I/O backend, one of "sync", "io_uring"
+static const std::string IO_BACKEND = "sync";
+static constexpr int ASYNC_IO_QUEUE_DEPTH = 64;                               // max in-flight requests per AsyncIo
+
+// temp files of spilling operators and external sorts
+static const std::string TEMP_DIR = ".";                                      // directory of temp files, the database directory by default
+static constexpr size_t TEMP_BLOCK_SIZE = 128 * 1024;                         // bytes per sequential read or write of a temp file
+static constexpr int TEMP_IO_BUFFERS = 2;                                     // blocks per temp file, one filled or drained while the others are in flight
 
-static const std::string DB_META_NAME = "db.meta";
+static const std::string DB_META_NAME = "db.meta";                           // text catalog of older versions
+static const std::string SLOW_QUERY_LOG_NAME = "slow_query.log";             // slow statements with their counters and plans
+static const std::string CATALOG_FILE_NAME = "db.catalog";                   // binary catalog, one entry per change
+static const std::string POOL_DUMP_FILE_NAME = "db.pool";                    // resident pages of the buffer pool in eviction order
+static constexpr size_t CATALOG_COMPACT_BYTES = 64 * 1024;                   // compact once dead entries exceed this and the live ones
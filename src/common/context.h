@@ -10,29 +10,156 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <unistd.h>
+
+#include <cerrno>
+#include <string>
+#include <vector>
+
+#include "common/arena.h"
+#include "common/query_stats.h"
+#include "common/result_format.h"
 #include "transaction/transaction.h"
 #include "transaction/concurrency/lock_manager.h"
 #include "recovery/log_manager.h"
 
 // class TransactionManager;
+class PlanCache;
 
 // used for data_send
 static int const_offset = -1;
 
+// 结果缓存记录的一块结果：发送时的帧类型和内容
+struct ResultChunk {
+    ResultFrameKind kind;
+    std::string data;
+};
+
+// 一条语句发送给客户端的全部结果（按发送时的分块）以及写入output.txt的文本
+struct ResultCapture {
+    std::vector<ResultChunk> chunks;
+    std::string output;
+};
+
 class Context {
 public:
     Context (LockManager *lock_mgr, LogManager *log_mgr, 
-            Transaction *txn, char *data_send = nullptr, int *offset = &const_offset)
+            Transaction *txn, char *data_send = nullptr, int *offset = &const_offset, int client_fd = -1)
         : lock_mgr_(lock_mgr), log_mgr_(log_mgr), txn_(txn),
-          data_send_(data_send), offset_(offset) {
+          data_send_(data_send), offset_(offset), client_fd_(client_fd) {
             ellipsis_ = false;
+            mem_tracker_.set_limit(EXEC_QUERY_MEM_LIMIT);
+            arena_.set_tracker(&mem_tracker_);
           }
 
+    /**
+     * @brief 流式返回结果时把data_send_中已经生成的结果发送给客户端并清空缓冲区，socket阻塞写使结果的生成速度
+     * 不超过客户端的接收速度；不发送结束符'\0'，请求结束时由finish_send发送最后一块结果和结束符。
+     * 二进制结果格式下发送的是一个不带结束标记的帧
+     *
+     * @return 是否可以继续向data_send_写入结果，没有客户端连接或者发送失败时返回false
+     */
+    bool flush_send() {
+        if (client_fd_ < 0 || data_send_ == nullptr) return false;
+        if (binary_result_) {
+            char frame[RESULT_FRAME_HEADER_SIZE];
+            encode_frame_header(frame, *offset_, send_kind_, false);
+            if (!send_all(frame, sizeof(frame))) return false;
+        }
+        if (!send_all(data_send_, *offset_)) return false;
+        if (capture_ != nullptr) capture_->chunks.push_back({send_kind_, std::string(data_send_, *offset_)});
+        *offset_ = 0;
+        return true;
+    }
+
+    /**
+     * @brief 二进制结果格式下把buf作为一个不带结束标记的帧直接发送，用于放不进data_send_的消息
+     */
+    bool send_frame(const char *buf, size_t len) {
+        if (client_fd_ < 0) return false;
+        char frame[RESULT_FRAME_HEADER_SIZE];
+        encode_frame_header(frame, len, send_kind_, false);
+        if (!send_all(frame, sizeof(frame)) || !send_all(buf, len)) return false;
+        if (capture_ != nullptr) capture_->chunks.push_back({send_kind_, std::string(buf, len)});
+        return true;
+    }
+
+    /**
+     * @brief 结束记录一条语句的结果：data_send_中还没有发送的部分作为最后一块
+     */
+    void finish_capture() {
+        if (capture_ == nullptr) return;
+        capture_->chunks.push_back({send_kind_, std::string(data_send_, *offset_)});
+        capture_ = nullptr;
+    }
+
+    /**
+     * @brief 按记录时的分块重新发送一条语句的结果，最后一块放入data_send_，与执行语句时一样由finish_send发送
+     *
+     * @return 发送是否成功，失败说明客户端已经断开
+     */
+    bool replay(const std::vector<ResultChunk> &chunks) {
+        for (size_t i = 0; i + 1 < chunks.size(); i++) {
+            send_kind_ = chunks[i].kind;
+            const std::string &data = chunks[i].data;
+            bool sent = binary_result_ ? send_frame(data.data(), data.size()) : send_all(data.data(), data.size());
+            if (!sent) return false;
+        }
+        const ResultChunk &last = chunks.back();
+        send_kind_ = last.kind;
+        memcpy(data_send_, last.data.data(), last.data.size());
+        *offset_ = static_cast<int>(last.data.size());
+        return true;
+    }
+
+    /**
+     * @brief 请求结束时发送data_send_中剩余的结果：文本格式以'\0'结尾，二进制结果格式作为该响应的最后一帧发送
+     *
+     * @return 发送是否成功，失败说明客户端已经断开
+     */
+    bool finish_send() {
+        if (client_fd_ < 0) return false;
+        if (binary_result_) {
+            char frame[RESULT_FRAME_HEADER_SIZE];
+            encode_frame_header(frame, *offset_, send_kind_, true);
+            return send_all(frame, sizeof(frame)) && send_all(data_send_, *offset_);
+        }
+        // 流式发送过的缓冲区中残留着上一块结果，需要重新写入结束符
+        data_send_[*offset_] = '\0';
+        return send_all(data_send_, *offset_ + 1);
+    }
+
     // TransactionManager *txn_mgr_;
     LockManager *lock_mgr_;
     LogManager *log_mgr_;
     Transaction *txn_;
     char *data_send_;
     int *offset_;
+    int client_fd_;     // 流式返回结果的客户端socket，-1表示结果只能放在data_send_中，超出部分被截断
+    bool binary_result_ = false;                    // 客户端是否协商了二进制结果格式
+    ResultFrameKind send_kind_ = RESULT_FRAME_TEXT; // data_send_中当前内容的帧类型
+    PlanCache *plan_cache_ = nullptr;               // 客户端连接的预编译语句
+    ResultCapture *capture_ = nullptr;              // 不为空时记录发送给客户端的每一块结果，用于结果缓存
+    const char *sql_ = nullptr;                     // 当前执行的语句的文本
     bool ellipsis_;
+    QueryStats stats_;  // 本条语句的各阶段耗时和性能计数，语句结束时写入慢查询日志
+    // 本次请求的arena_和溢出算子占用的内存，计入EXECUTOR子系统；声明在arena_之前，arena_先析构并归还内存
+    MemoryTracker mem_tracker_{&MemoryTracker::subsystem(MemoryTracker::EXECUTOR)};
+    Arena arena_;       // 本次请求执行期间算子输出的元组，请求结束时随Context一起释放
+
+private:
+    bool send_all(const char *buf, size_t len) {
+        size_t sent = 0;
+        while (sent < len) {
+            ssize_t n = write(client_fd_, buf + sent, len - sent);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                // 客户端已经断开，不再发送后续结果
+                client_fd_ = -1;
+                return false;
+            }
+            sent += n;
+        }
+        return true;
+    }
 };
\ No newline at end of file
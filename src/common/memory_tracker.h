@@ -0,0 +1,144 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+#include "common/config.h"
+
+/**
+ * @brief 内存记账：记录一个使用者占用的字节数及其峰值，每次申请同时计入上级。
+ * 全局记账器是根结点，下面按子系统各有一个记账器，每条语句的记账器位于EXECUTOR之下。
+ * 申请的内存使本级或任一上级超过限制时try_consume失败且不记账，调用者据此溢出到磁盘或者让语句失败；
+ * consume用于不能失败的申请（如锁表、缓冲池），它们照常记账，使之后可以失败的申请更早失败。限制为0表示不限制
+ */
+class MemoryTracker {
+   public:
+    enum Subsystem { BUFFER_POOL, LOCK_TABLE, TXN_TABLE, EXECUTOR, LOG_BUFFER, NUM_SUBSYSTEMS };
+
+    explicit MemoryTracker(MemoryTracker *parent = nullptr, size_t limit = 0) : parent_(parent), limit_(limit) {}
+
+    MemoryTracker(const MemoryTracker &) = delete;
+    MemoryTracker &operator=(const MemoryTracker &) = delete;
+
+    // 没有归还的内存随记账器一起从上级中扣除，语句中途失败时算子可能来不及归还
+    ~MemoryTracker() {
+        size_t used = used_.load(std::memory_order_relaxed);
+        if (parent_ != nullptr && used > 0) parent_->release(used);
+    }
+
+    bool try_consume(size_t bytes) {
+        size_t used = used_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        size_t limit = limit_.load(std::memory_order_relaxed);
+        if ((limit != 0 && used > limit) || (parent_ != nullptr && !parent_->try_consume(bytes))) {
+            used_.fetch_sub(bytes, std::memory_order_relaxed);
+            return false;
+        }
+        update_peak(used);
+        return true;
+    }
+
+    void consume(size_t bytes) {
+        update_peak(used_.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+        if (parent_ != nullptr) parent_->consume(bytes);
+    }
+
+    void release(size_t bytes) {
+        used_.fetch_sub(bytes, std::memory_order_relaxed);
+        if (parent_ != nullptr) parent_->release(bytes);
+    }
+
+    size_t used() const { return used_.load(std::memory_order_relaxed); }
+
+    size_t peak() const { return peak_.load(std::memory_order_relaxed); }
+
+    size_t limit() const { return limit_.load(std::memory_order_relaxed); }
+
+    void set_limit(size_t limit) { limit_.store(limit, std::memory_order_relaxed); }
+
+    /* 进程内所有内存的根记账器，限制为MEMORY_LIMIT，启动时可以修改 */
+    static MemoryTracker &global() {
+        static MemoryTracker tracker(nullptr, MEMORY_LIMIT);
+        return tracker;
+    }
+
+    static MemoryTracker &subsystem(Subsystem subsystem) {
+        static MemoryTracker trackers[NUM_SUBSYSTEMS] = {
+            MemoryTracker(&global()), MemoryTracker(&global()), MemoryTracker(&global()),
+            MemoryTracker(&global()), MemoryTracker(&global())};
+        return trackers[subsystem];
+    }
+
+    static const char *subsystem_name(Subsystem subsystem) {
+        static const char *names[NUM_SUBSYSTEMS] = {"buffer pool", "lock table", "txn table", "executor",
+                                                    "log buffer"};
+        return names[subsystem];
+    }
+
+   private:
+    void update_peak(size_t used) {
+        size_t peak = peak_.load(std::memory_order_relaxed);
+        while (used > peak && !peak_.compare_exchange_weak(peak, used, std::memory_order_relaxed)) {
+        }
+    }
+
+    MemoryTracker *parent_;
+    std::atomic<size_t> used_{0};
+    std::atomic<size_t> peak_{0};
+    std::atomic<size_t> limit_;
+};
+
+/**
+ * @brief 算子持有的一段预留内存：按MEMORY_RESERVE_CHUNK取整向记账器申请，算子内存的增长只在跨过已预留的大小时
+ * 才访问记账器；析构或release时全部归还。记账器为空（算子没有上下文）时不记账也不限制
+ */
+class MemoryReservation {
+   public:
+    explicit MemoryReservation(MemoryTracker *tracker = nullptr) : tracker_(tracker) {}
+
+    MemoryReservation(const MemoryReservation &) = delete;
+    MemoryReservation &operator=(const MemoryReservation &) = delete;
+
+    ~MemoryReservation() { release(); }
+
+    void set_tracker(MemoryTracker *tracker) {
+        release();
+        tracker_ = tracker;
+    }
+
+    /* 使预留的内存不少于bytes字节，超过限制时返回false，已预留的部分保持不变 */
+    bool reserve(size_t bytes) {
+        if (bytes <= reserved_ || tracker_ == nullptr) return true;
+        size_t delta = (bytes - reserved_ + MEMORY_RESERVE_CHUNK - 1) / MEMORY_RESERVE_CHUNK * MEMORY_RESERVE_CHUNK;
+        if (!tracker_->try_consume(delta)) return false;
+        reserved_ += delta;
+        return true;
+    }
+
+    /* 不检查限制地使预留的内存不少于bytes字节，用于无法再溢出的情况 */
+    void force(size_t bytes) {
+        if (bytes <= reserved_ || tracker_ == nullptr) return;
+        tracker_->consume(bytes - reserved_);
+        reserved_ = bytes;
+    }
+
+    void release() {
+        if (reserved_ > 0) tracker_->release(reserved_);
+        reserved_ = 0;
+    }
+
+    size_t reserved() const { return reserved_; }
+
+   private:
+    MemoryTracker *tracker_;
+    size_t reserved_ = 0;
+};
@@ -0,0 +1,176 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief 延迟直方图：值按2的幂分段，每段再等分为SUB_BUCKETS个桶（HDR直方图的布局），
+ * 任意大小的值的相对误差不超过1/SUB_BUCKETS；记录一个值只需几次不加锁的原子加
+ */
+class LatencyHistogram {
+   public:
+    static constexpr int SUB_BUCKET_BITS = 5;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr int NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    void record(uint64_t value) {
+        buckets_[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+        uint64_t max = max_.load(std::memory_order_relaxed);
+        while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+    double mean() const {
+        uint64_t n = count();
+        return n == 0 ? 0 : static_cast<double>(sum_.load(std::memory_order_relaxed)) / n;
+    }
+
+    /**
+     * @brief 值从小到大排在第percent%的值，返回所在桶的中点，没有记录时返回0
+     */
+    uint64_t percentile(double percent) const {
+        uint64_t n = count();
+        if (n == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(percent / 100 * n);
+        if (rank >= n) rank = n - 1;
+        uint64_t seen = 0;
+        for (int b = 0; b < NUM_BUCKETS; ++b) {
+            seen += buckets_[b].load(std::memory_order_relaxed);
+            if (seen > rank) {
+                // 记录与读取并发时桶的总数可能略多于count_，取到的中点不超过已经记录的最大值
+                uint64_t mid = lower_bound(b) + (bucket_width(b) - 1) / 2;
+                return mid < max() ? mid : max();
+            }
+        }
+        return max();
+    }
+
+   private:
+    static int bucket_of(uint64_t value) {
+        if (value < static_cast<uint64_t>(SUB_BUCKETS)) return static_cast<int>(value);
+        int shift = 63 - __builtin_clzll(value) - SUB_BUCKET_BITS;
+        return (shift + 1) * SUB_BUCKETS + static_cast<int>((value >> shift) - SUB_BUCKETS);
+    }
+
+    static uint64_t lower_bound(int bucket) {
+        if (bucket < SUB_BUCKETS) return bucket;
+        int shift = bucket / SUB_BUCKETS - 1;
+        return static_cast<uint64_t>(bucket % SUB_BUCKETS + SUB_BUCKETS) << shift;
+    }
+
+    static uint64_t bucket_width(int bucket) { return bucket < SUB_BUCKETS ? 1 : 1ULL << (bucket / SUB_BUCKETS - 1); }
+
+    std::atomic<uint64_t> buckets_[NUM_BUCKETS] = {};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+/**
+ * @brief 进程内唯一的指标注册表：按语句类型统计的语句数和延迟、提交延迟、加锁等待时间和刷日志延迟，
+ * 事务回滚次数、写入的日志量、启动时故障恢复的耗时以及复制的状态。延迟的单位均为纳秒，由show metrics输出
+ */
+class Metrics {
+   public:
+    enum StatementType { SELECT, INSERT, UPDATE, DELETE, DDL, UTILITY, NUM_STATEMENT_TYPES };
+
+    enum Histogram {
+        COMMIT_LATENCY,     // 写事务提交的耗时，包括等待日志持久化
+        LOCK_WAIT,          // 加锁请求因为冲突而等待的时间，不冲突的请求不记录
+        LOG_FLUSH_LATENCY,  // 一次写日志文件加fdatasync的耗时
+        NUM_HISTOGRAMS
+    };
+
+    enum Counter {
+        TXN_ABORTS,         // 回滚的事务数
+        LOCK_ABORTS,        // 加锁失败导致事务回滚的次数
+        LOG_BYTES,          // 写入日志文件的字节数
+        NUM_COUNTERS
+    };
+
+    enum ReplicationRole { STANDALONE, PRIMARY, REPLICA };
+
+    /* 复制的状态由主库的日志发送线程或备库的回放线程设置，故障恢复的耗时在启动时设置 */
+    enum Gauge {
+        REPLICATION_ROLE,           // 本进程在复制中的角色，取值为ReplicationRole
+        REPLICAS,                   // 主库：连接着的备库数；备库：是否连接着主库
+        REPLICATED_LSN,             // 主库：各备库确认的日志号中最小的；备库：回放到的主库日志号
+        PRIMARY_LSN,                // 主库持久化到的日志号，备库上为最近一次从主库得知的
+        REPLICA_BEHIND_SINCE_US,    // 备库：回放到的日志在主库上发送的时间（微秒），已经追上主库时为0
+        RECOVERY_ANALYZE_US,        // 启动时故障恢复各阶段的耗时（微秒）
+        RECOVERY_REDO_US,
+        RECOVERY_UNDO_US,
+        NUM_GAUGES
+    };
+
+    static Metrics &instance() {
+        static Metrics metrics;
+        return metrics;
+    }
+
+    LatencyHistogram &statement(StatementType type) { return statements_[type]; }
+
+    LatencyHistogram &histogram(Histogram histogram) { return histograms_[histogram]; }
+
+    void add(Counter counter, uint64_t n = 1) { counters_[counter].fetch_add(n, std::memory_order_relaxed); }
+
+    uint64_t get(Counter counter) const { return counters_[counter].load(std::memory_order_relaxed); }
+
+    void set(Gauge gauge, int64_t value) { gauges_[gauge].store(value, std::memory_order_relaxed); }
+
+    int64_t get(Gauge gauge) const { return gauges_[gauge].load(std::memory_order_relaxed); }
+
+    // 进程启动以来的秒数，用于计算每秒的语句数
+    double uptime_seconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    }
+
+    static const char *statement_name(StatementType type) {
+        static const char *names[NUM_STATEMENT_TYPES] = {"select", "insert", "update", "delete", "ddl", "utility"};
+        return names[type];
+    }
+
+   private:
+    Metrics() : start_(std::chrono::steady_clock::now()) {}
+
+    std::chrono::steady_clock::time_point start_;
+    LatencyHistogram statements_[NUM_STATEMENT_TYPES];
+    LatencyHistogram histograms_[NUM_HISTOGRAMS];
+    std::atomic<uint64_t> counters_[NUM_COUNTERS] = {};
+    std::atomic<int64_t> gauges_[NUM_GAUGES] = {};
+};
+
+/**
+ * @brief 析构时把构造以来经过的纳秒数记入直方图
+ */
+class LatencyTimer {
+   public:
+    explicit LatencyTimer(LatencyHistogram &histogram)
+        : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+
+    ~LatencyTimer() {
+        auto elapsed = std::chrono::steady_clock::now() - start_;
+        histogram_.record(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+
+   private:
+    LatencyHistogram &histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
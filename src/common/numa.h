@@ -0,0 +1,123 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief 本机的NUMA拓扑，启动时从/sys/devices/system/node读取一次；读不到时（非NUMA的机器、容器中没有挂载sysfs）
+ * 视为只有一个包含所有CPU的节点。节点按编号顺序从0开始编号，与操作系统的节点号不一定相同。
+ * 绑定内存直接使用mbind系统调用，不依赖libnuma
+ */
+class NumaTopology {
+   public:
+    static const NumaTopology &instance() {
+        static NumaTopology topology;
+        return topology;
+    }
+
+    size_t num_nodes() const { return nodes_.size(); }
+
+    const std::vector<int> &node_cpus(size_t node) const { return nodes_[node].cpus; }
+
+    /* 当前线程所在CPU的节点，不能确定时返回0 */
+    size_t current_node() const {
+        int cpu = sched_getcpu();
+        return cpu >= 0 && static_cast<size_t>(cpu) < cpu_nodes_.size() ? cpu_nodes_[cpu] : 0;
+    }
+
+    /**
+     * @brief 让[addr, addr + len)中尚未分配物理页的内存优先从节点node分配，节点内存不足时仍可使用其它节点。
+     * addr必须按系统页对齐；只有一个节点或者node不存在时什么也不做
+     */
+    void bind_memory(void *addr, size_t len, size_t node) const {
+        if (num_nodes() <= 1 || node >= num_nodes() || len == 0) return;
+        int os_node = nodes_[node].os_node;
+        std::vector<unsigned long> mask(os_node / (8 * sizeof(unsigned long)) + 1, 0);
+        mask[os_node / (8 * sizeof(unsigned long))] |= 1UL << (os_node % (8 * sizeof(unsigned long)));
+        // 失败时内存按首次访问的线程所在节点分配，只影响性能
+        syscall(SYS_mbind, addr, len, MPOL_PREFERRED, mask.data(), mask.size() * 8 * sizeof(unsigned long) + 1, 0);
+    }
+
+    /* 把当前线程限制在节点node的CPU上运行；只有一个节点时什么也不做 */
+    void pin_thread(size_t node) const {
+        if (num_nodes() <= 1 || node >= num_nodes()) return;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : nodes_[node].cpus) {
+            if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+        }
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+   private:
+    struct Node {
+        int os_node;            // 操作系统的节点号
+        std::vector<int> cpus;  // 节点上的CPU编号
+    };
+
+    NumaTopology() {
+        for (int os_node : parse_list(read_file("/sys/devices/system/node/online"))) {
+            auto cpus = parse_list(read_file("/sys/devices/system/node/node" + std::to_string(os_node) + "/cpulist"));
+            // 没有CPU的节点（例如只有内存的设备）不能运行工作线程，也不作为缓冲池的节点
+            if (!cpus.empty()) nodes_.push_back({os_node, std::move(cpus)});
+        }
+        if (nodes_.empty()) {
+            Node node{0, {}};
+            for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); cpu++) {
+                node.cpus.push_back(static_cast<int>(cpu));
+            }
+            nodes_.push_back(std::move(node));
+        }
+        for (size_t i = 0; i < nodes_.size(); i++) {
+            for (int cpu : nodes_[i].cpus) {
+                if (static_cast<size_t>(cpu) >= cpu_nodes_.size()) cpu_nodes_.resize(cpu + 1, 0);
+                cpu_nodes_[cpu] = i;
+            }
+        }
+    }
+
+    static std::string read_file(const std::string &path) {
+        std::ifstream in(path);
+        std::string line;
+        std::getline(in, line);
+        return line;
+    }
+
+    /* 解析"0-3,8-11"格式的编号列表 */
+    static std::vector<int> parse_list(const std::string &list) {
+        std::vector<int> ids;
+        std::stringstream ss(list);
+        std::string range;
+        while (std::getline(ss, range, ',')) {
+            if (range.empty()) continue;
+            size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int id = first; id <= last; id++) ids.push_back(id);
+        }
+        return ids;
+    }
+
+    std::vector<Node> nodes_;
+    std::vector<size_t> cpu_nodes_;     // CPU编号 -> 节点
+};
@@ -0,0 +1,130 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <string>
+
+#include "common/metrics.h"
+
+/**
+ * @brief 一条语句执行期间的性能计数：各阶段耗时、访问的页面、扫描和返回的记录、加锁情况以及写入的日志量。
+ * 各模块只对当前线程的计数器做一次不加锁的累加，语句结束时与开始时的差值即为该语句的计数；
+ * 并行扫描的工作线程和后台线程的计数不计入发起查询的线程
+ */
+struct QueryStats {
+    enum Counter {
+        PAGES_FETCHED,  // 获取页面的次数，包括命中和未命中
+        PAGES_MISSED,   // 获取页面时需要从磁盘读取的次数
+        PAGES_SKIPPED,  // 顺序扫描按区间映射跳过的页面数
+        ROWS_SCANNED,   // 顺序扫描和索引扫描读出的记录数
+        ROWS_RETURNED,  // 返回给客户端的记录数
+        LOCKS_ACQUIRED, // 新获得或升级的锁的个数
+        LOCK_WAITS,     // 加锁时因为冲突而等待的次数
+        LOCK_ABORTS,    // 加锁失败导致事务回滚的次数
+        LOG_BYTES,      // 写入日志缓冲区的字节数
+        TEMP_BYTES,     // 写入临时文件的字节数
+        NUM_COUNTERS
+    };
+
+    enum Phase { PARSE, ANALYZE, PLAN, EXECUTE, NUM_PHASES };
+
+    uint64_t counters[NUM_COUNTERS] = {};
+    uint64_t phase_ns[NUM_PHASES] = {};  // 各阶段的耗时，单位为纳秒
+
+    uint64_t get(Counter counter) const { return counters[counter]; }
+
+    uint64_t total_ns() const {
+        uint64_t total = 0;
+        for (uint64_t ns : phase_ns) total += ns;
+        return total;
+    }
+
+    /**
+     * @brief 当前线程的累计计数，只增不减，使用者按前后两次读取的差值统计
+     */
+    static QueryStats &thread_stats() {
+        static thread_local QueryStats stats;
+        return stats;
+    }
+
+    static void add(Counter counter, uint64_t n = 1) { thread_stats().counters[counter] += n; }
+
+    // 计数器减去start中的计数，得到两次读取之间的增量
+    void subtract(const QueryStats &start) {
+        for (int i = 0; i < NUM_COUNTERS; ++i) {
+            counters[i] -= start.counters[i];
+        }
+    }
+
+    std::string to_string() const {
+        static const char *phase_names[NUM_PHASES] = {"parse", "analyze", "plan", "execute"};
+        static const char *counter_names[NUM_COUNTERS] = {"pages_fetched",  "pages_missed", "pages_skipped",
+                                                          "rows_scanned",   "rows_returned", "locks_acquired",
+                                                          "lock_waits",     "lock_aborts",  "log_bytes",
+                                                          "temp_bytes"};
+        std::string str = "time=" + format_ms(total_ns()) + "ms";
+        for (int i = 0; i < NUM_PHASES; ++i) {
+            str += std::string(" ") + phase_names[i] + "=" + format_ms(phase_ns[i]) + "ms";
+        }
+        for (int i = 0; i < NUM_COUNTERS; ++i) {
+            str += std::string(" ") + counter_names[i] + "=" + std::to_string(counters[i]);
+        }
+        return str;
+    }
+
+   private:
+    static std::string format_ms(uint64_t ns) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.3f", ns / 1e6);
+        return buf;
+    }
+};
+
+/**
+ * @brief 计时一个阶段，析构时把经过的时间累加到stats的对应阶段上，阶段因为异常提前结束时同样计时
+ */
+class PhaseTimer {
+   public:
+    PhaseTimer(QueryStats *stats, QueryStats::Phase phase)
+        : stats_(stats), phase_(phase), start_(std::chrono::steady_clock::now()) {}
+
+    ~PhaseTimer() {
+        auto elapsed = std::chrono::steady_clock::now() - start_;
+        stats_->phase_ns[phase_] += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    }
+
+   private:
+    QueryStats *stats_;
+    QueryStats::Phase phase_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ * @brief 放在可能因加锁失败而抛出异常的函数开头：函数以异常结束时计一次LOCK_ABORTS
+ */
+class LockAbortCounter {
+   public:
+    LockAbortCounter() : exceptions_(std::uncaught_exceptions()) {}
+
+    ~LockAbortCounter() {
+        if (std::uncaught_exceptions() > exceptions_) {
+            QueryStats::add(QueryStats::LOCK_ABORTS);
+            Metrics::instance().add(Metrics::LOCK_ABORTS);
+        }
+    }
+
+   private:
+    int exceptions_;
+};
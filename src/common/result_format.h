@@ -0,0 +1,49 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * 服务端与客户端之间的二进制结果格式，服务端和rucbase_client共用本文件。
+ *
+ * 客户端在连接建立后发送RESULT_BINARY_REQUEST，服务端以'\0'结尾的文本RESULT_BINARY_ACK应答后，
+ * 同一连接上之后的每个响应都由若干帧组成，帧头为RESULT_FRAME_HEADER_SIZE字节：
+ *   uint32 payload长度 | uint8 帧类型(ResultFrameKind) | uint8 是否为该响应的最后一帧
+ * 文本帧的payload是原来的文本响应；二进制帧的payload是若干条完整的消息，消息不会跨帧：
+ *   RESULT_MSG_HEADER: uint16 列数，每列 uint8 类型(ResultColType) | uint16 字段长度 | uint8 列名长度 | 列名
+ *   RESULT_MSG_ROW:    每列 int32 / float 4字节，字符串为 uint16 长度 | 字符(不含结尾的'\0')
+ *   RESULT_MSG_COUNT:  uint64 结果元组个数，表示一次查询的结果结束
+ * 所有整数均按小端字节序存放。表格形式的输出由客户端根据这些消息生成。
+ */
+static constexpr const char *RESULT_BINARY_REQUEST = "set result_format binary";
+static constexpr const char *RESULT_BINARY_ACK = "result format: binary\n";
+static constexpr size_t RESULT_FRAME_HEADER_SIZE = 6;
+
+enum ResultFrameKind : uint8_t { RESULT_FRAME_TEXT = 0, RESULT_FRAME_BINARY = 1 };
+
+enum ResultMessage : uint8_t { RESULT_MSG_HEADER = 'H', RESULT_MSG_ROW = 'R', RESULT_MSG_COUNT = 'C' };
+
+enum ResultColType : uint8_t { RESULT_COL_INT = 0, RESULT_COL_FLOAT = 1, RESULT_COL_STRING = 2 };
+
+inline void encode_frame_header(char *dst, uint32_t payload_len, ResultFrameKind kind, bool last) {
+    memcpy(dst, &payload_len, sizeof(payload_len));
+    dst[4] = static_cast<char>(kind);
+    dst[5] = last ? 1 : 0;
+}
+
+inline void decode_frame_header(const char *src, uint32_t *payload_len, ResultFrameKind *kind, bool *last) {
+    memcpy(payload_len, src, sizeof(*payload_len));
+    *kind = static_cast<ResultFrameKind>(src[4]);
+    *last = src[5] != 0;
+}
@@ -0,0 +1,33 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+/**
+ * 静态跟踪点（USDT）：RMDB_TRACE(name, args...)在代码中放置一个名为rmdb:name的探针，
+ * 可以用bpftrace/perf/bcc在运行中的进程上挂载，例如 bpftrace -e 'usdt:./bin/rmdb:rmdb:read_page_start { ... }'。
+ * 没有挂载时探针只是一条nop指令，参数也只是放在寄存器中，不产生函数调用；参数应当是整数或C字符串指针。
+ * 编译时找不到<sys/sdt.h>（systemtap-sdt-dev）或者定义了RMDB_DISABLE_TRACEPOINTS时探针展开为空。
+ * 现有的跟踪点和对应的bpftrace脚本见scripts/bpftrace
+ */
+#if !defined(RMDB_DISABLE_TRACEPOINTS) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define RMDB_TRACEPOINTS_ENABLED 1
+#endif
+#endif
+
+#ifdef RMDB_TRACEPOINTS_ENABLED
+#define RMDB_TRACE(name, ...) STAP_PROBEV(rmdb, name, ##__VA_ARGS__)
+#else
+#define RMDB_TRACE(name, ...) \
+    do {                      \
+    } while (0)
+#endif
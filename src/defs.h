@@ -37,21 +37,33 @@ struct Rid {
     }
 
     friend bool operator!=(const Rid &x, const Rid &y) { return !(x == y); }
+
+    friend bool operator<(const Rid &x, const Rid &y) {
+        return x.page_no != y.page_no ? x.page_no < y.page_no : x.slot_no < y.slot_no;
+    }
 };
 
 enum ColType {
-    TYPE_INT, TYPE_FLOAT, TYPE_STRING
+    TYPE_INT, TYPE_FLOAT, TYPE_STRING, TYPE_VARCHAR
 };
 
 inline std::string coltype2str(ColType type) {
     std::map<ColType, std::string> m = {
             {TYPE_INT,    "INT"},
             {TYPE_FLOAT,  "FLOAT"},
-            {TYPE_STRING, "STRING"}
+            {TYPE_STRING, "STRING"},
+            {TYPE_VARCHAR, "VARCHAR"}
     };
     return m.at(type);
 }
 
+/* CHAR(n)和VARCHAR(n)字段在内存中都按声明长度存放，可以相互比较，也都接受字符串常量 */
+inline bool is_string_type(ColType type) { return type == TYPE_STRING || type == TYPE_VARCHAR; }
+
+inline bool is_compatible_type(ColType lhs, ColType rhs) {
+    return lhs == rhs || (is_string_type(lhs) && is_string_type(rhs));
+}
+
 class RecScan {
 public:
     virtual ~RecScan() = default;
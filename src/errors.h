@@ -93,6 +93,76 @@ class DatabaseExistsError : public RMDBError {
     DatabaseExistsError(const std::string &db_name) : RMDBError("Database already exists: " + db_name) {}
 };
 
+class InvalidPageSizeError : public RMDBError {
+   public:
+    InvalidPageSizeError(int page_size) : RMDBError("Invalid page size: " + std::to_string(page_size)) {}
+};
+
+class UnknownStorageError : public RMDBError {
+   public:
+    UnknownStorageError(const std::string &storage) : RMDBError("Unknown storage: " + storage) {}
+};
+
+class UnknownCompressionError : public RMDBError {
+   public:
+    UnknownCompressionError(const std::string &compression) : RMDBError("Unknown compression: " + compression) {}
+};
+
+class InvalidEncodingError : public RMDBError {
+   public:
+    InvalidEncodingError(const std::string &msg) : RMDBError("Invalid encoding: " + msg) {}
+};
+
+class UnknownIndexTypeError : public RMDBError {
+   public:
+    UnknownIndexTypeError(const std::string &type) : RMDBError("Unknown index type: " + type) {}
+};
+
+class InvalidPartitionError : public RMDBError {
+   public:
+    InvalidPartitionError(const std::string &msg) : RMDBError("Invalid partitioning: " + msg) {}
+};
+
+class NoPartitionError : public RMDBError {
+   public:
+    NoPartitionError(const std::string &tab_name) : RMDBError("No partition of table " + tab_name + " for the row") {}
+};
+
+class TableBusyError : public RMDBError {
+   public:
+    TableBusyError(const std::string &tab_name)
+        : RMDBError("Table " + tab_name + " has uncommitted changes in the current transaction") {}
+};
+
+class IndexBuildInProgressError : public RMDBError {
+   public:
+    IndexBuildInProgressError(const std::string &tab_name)
+        : RMDBError("Table " + tab_name + " has an index build in progress") {}
+};
+
+class TableInUseError : public RMDBError {
+   public:
+    TableInUseError(const std::string &tab_name)
+        : RMDBError("Table " + tab_name + " is being read by another statement") {}
+};
+
+class InvalidViewError : public RMDBError {
+   public:
+    InvalidViewError(const std::string &msg) : RMDBError("Invalid materialized view: " + msg) {}
+};
+
+class ViewNotWritableError : public RMDBError {
+   public:
+    ViewNotWritableError(const std::string &tab_name)
+        : RMDBError("Materialized view " + tab_name + " can only be changed by REFRESH MATERIALIZED VIEW") {}
+};
+
+class DependentViewError : public RMDBError {
+   public:
+    DependentViewError(const std::string &tab_name, const std::string &view_name)
+        : RMDBError("Table " + tab_name + " is used by materialized view " + view_name) {}
+};
+
 class TableNotFoundError : public RMDBError {
    public:
     TableNotFoundError(const std::string &tab_name) : RMDBError("Table not found: " + tab_name) {}
@@ -143,6 +213,12 @@ class StringOverflowError : public RMDBError {
     StringOverflowError() : RMDBError("String is too long") {}
 };
 
+class InvalidLoadDataError : public RMDBError {
+   public:
+    InvalidLoadDataError(const std::string &file_name, int line_no, const std::string &msg)
+        : RMDBError("Invalid data in " + file_name + " line " + std::to_string(line_no) + ": " + msg) {}
+};
+
 class IncompatibleTypeError : public RMDBError {
    public:
     IncompatibleTypeError(const std::string &lhs, const std::string &rhs)
@@ -154,8 +230,62 @@ class AmbiguousColumnError : public RMDBError {
     AmbiguousColumnError(const std::string &col_name) : RMDBError("Ambiguous column: " + col_name) {}
 };
 
+class GroupByError : public RMDBError {
+   public:
+    GroupByError(const std::string &col_name)
+        : RMDBError("Column " + col_name + " must appear in GROUP BY or be used in an aggregate function") {}
+};
+
+class PreparedStmtNotFoundError : public RMDBError {
+   public:
+    PreparedStmtNotFoundError(const std::string &name) : RMDBError("Prepared statement not found: " + name) {}
+};
+
+class PreparedStmtExistsError : public RMDBError {
+   public:
+    PreparedStmtExistsError(const std::string &name) : RMDBError("Prepared statement already exists: " + name) {}
+};
+
+class ParamCountError : public RMDBError {
+   public:
+    ParamCountError(int expected, int given)
+        : RMDBError("Wrong number of parameters: expected " + std::to_string(expected) + ", got " +
+                    std::to_string(given)) {}
+};
+
+class UnexpectedParamError : public RMDBError {
+   public:
+    UnexpectedParamError() : RMDBError("Parameter placeholder is only allowed in PREPARE") {}
+};
+
+class SubqueryColumnError : public RMDBError {
+   public:
+    SubqueryColumnError() : RMDBError("Subquery in IN must select exactly one column") {}
+};
+
+class UnsupportedSubqueryError : public RMDBError {
+   public:
+    UnsupportedSubqueryError() : RMDBError("Subquery is only allowed in the WHERE clause of SELECT") {}
+};
+
 class PageNotExistError : public RMDBError {
    public:
     PageNotExistError(const std::string &table_name, int page_no)
         : RMDBError("Page " + std::to_string(page_no) + " in table " + table_name + "not exits") {}
-};
\ No newline at end of file
+};
+
+class MemoryLimitError : public RMDBError {
+   public:
+    MemoryLimitError(size_t bytes)
+        : RMDBError("Memory limit exceeded while allocating " + std::to_string(bytes) + " bytes") {}
+};
+
+class ReadOnlyReplicaError : public RMDBError {
+   public:
+    ReadOnlyReplicaError(const std::string &what) : RMDBError("Read-only replica: " + what) {}
+};
+
+class ReplicationError : public RMDBError {
+   public:
+    ReplicationError(const std::string &msg) : RMDBError("Replication error: " + msg) {}
+};
@@ -0,0 +1,192 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "executor_abstract.h"
+
+/**
+ * @brief 分组聚合的计算：每个分组有一个定长的聚合状态，按init()/update()/finalize()三步计算聚合函数。
+ * 分组键是各个分组列取值的拼接，float分组列中的-0.0规整为0.0，使相等的分组键字节相同，可以直接memcmp和哈希。
+ * 输出元组中分组列在前，聚合结果按aggs的顺序在后，字段名为AggItem::name。
+ * 没有NULL值：只有空输入且没有分组列时才会输出不含任何元组的分组，此时除COUNT外的结果都为0
+ */
+class Aggregator {
+   private:
+    /* 一个聚合函数的输入字段以及它在聚合状态中的位置；每个状态以8字节的元组计数开头，
+       SUM/AVG之后是8字节的和（int输入为int64，float输入为double），MIN/MAX之后是当前的最值 */
+    struct Slot {
+        AggType type;
+        bool count_star;            // COUNT(*)，没有输入字段
+        ColMeta in_col;
+        size_t state_offset;
+    };
+
+    std::vector<ColMeta> group_cols_;           // 分组列在输入元组中的字段
+    std::vector<Slot> slots_;
+    size_t key_len_ = 0;
+    size_t state_len_ = 0;
+    std::vector<ColMeta> cols_;                 // 输出元组的字段
+    size_t tuple_len_ = 0;
+
+   public:
+    /**
+     * @param child 产生输入元组的算子，分组列和聚合的字段在它的输出中查找
+     * @param group_cols 分组列
+     * @param aggs 聚合函数
+     */
+    Aggregator(AbstractExecutor &child, const std::vector<TabCol> &group_cols, const std::vector<AggItem> &aggs) {
+        for (auto &group_col : group_cols) {
+            ColMeta col = *child.get_col(child.cols(), group_col);
+            group_cols_.push_back(col);
+            key_len_ += col.len;
+            col.offset = static_cast<int>(tuple_len_);
+            tuple_len_ += col.len;
+            cols_.push_back(col);
+        }
+        for (auto &agg : aggs) {
+            Slot slot;
+            slot.type = agg.type;
+            slot.count_star = agg.col.col_name == "*";
+            if (!slot.count_star) slot.in_col = *child.get_col(child.cols(), agg.col);
+            slot.state_offset = state_len_;
+            state_len_ += sizeof(int64_t);
+            if (agg.type == AGG_SUM || agg.type == AGG_AVG) {
+                state_len_ += sizeof(int64_t);
+            } else if (agg.type == AGG_MIN || agg.type == AGG_MAX) {
+                state_len_ += slot.in_col.len;
+            }
+            slots_.push_back(slot);
+
+            ColMeta col;
+            col.tab_name = "";
+            col.name = agg.name;
+            col.index = false;
+            if (agg.type == AGG_MIN || agg.type == AGG_MAX) {
+                col.type = slot.in_col.type;
+                col.len = slot.in_col.len;
+            } else {
+                col.type = agg.type == AGG_COUNT ? TYPE_INT : (agg.type == AGG_AVG ? TYPE_FLOAT : slot.in_col.type);
+                col.len = 4;
+            }
+            col.offset = static_cast<int>(tuple_len_);
+            tuple_len_ += col.len;
+            cols_.push_back(col);
+        }
+    }
+
+    size_t key_len() const { return key_len_; }
+
+    size_t state_len() const { return state_len_; }
+
+    const std::vector<ColMeta> &cols() const { return cols_; }
+
+    size_t tuple_len() const { return tuple_len_; }
+
+    /* 取出输入元组的分组键，key的长度为key_len() */
+    void key(const char *tuple, char *key) const {
+        size_t offset = 0;
+        for (auto &col : group_cols_) {
+            memcpy(key + offset, tuple + col.offset, col.len);
+            if (col.type == TYPE_FLOAT) {
+                float val;
+                memcpy(&val, key + offset, sizeof(float));
+                if (val == 0.0f) memset(key + offset, 0, sizeof(float));
+            }
+            offset += col.len;
+        }
+    }
+
+    static uint64_t hash(const char *key, size_t len) {
+        uint64_t h = 14695981039346656037ULL;
+        for (size_t i = 0; i < len; i++) {
+            h ^= static_cast<uint8_t>(key[i]);
+            h *= 1099511628211ULL;
+        }
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    /* 初始化一个还没有元组的分组的聚合状态 */
+    void init(char *state) const { memset(state, 0, state_len_); }
+
+    /* 把输入元组累加到分组的聚合状态中 */
+    void update(char *state, const char *tuple) const {
+        for (auto &slot : slots_) {
+            char *st = state + slot.state_offset;
+            int64_t count;
+            memcpy(&count, st, sizeof(int64_t));
+            char *acc = st + sizeof(int64_t);
+            const char *val = slot.count_star ? nullptr : tuple + slot.in_col.offset;
+            if (slot.type == AGG_SUM || slot.type == AGG_AVG) {
+                if (slot.in_col.type == TYPE_INT) {
+                    int64_t sum;
+                    int v;
+                    memcpy(&sum, acc, sizeof(int64_t));
+                    memcpy(&v, val, sizeof(int));
+                    sum += v;
+                    memcpy(acc, &sum, sizeof(int64_t));
+                } else {
+                    double sum;
+                    float v;
+                    memcpy(&sum, acc, sizeof(double));
+                    memcpy(&v, val, sizeof(float));
+                    sum += v;
+                    memcpy(acc, &sum, sizeof(double));
+                }
+            } else if (slot.type == AGG_MIN || slot.type == AGG_MAX) {
+                int cmp = count == 0 ? 0 : AbstractExecutor::compare_value(slot.in_col.type, slot.in_col.len, val, acc);
+                if (count == 0 || (slot.type == AGG_MIN ? cmp < 0 : cmp > 0)) {
+                    memcpy(acc, val, slot.in_col.len);
+                }
+            }
+            count++;
+            memcpy(st, &count, sizeof(int64_t));
+        }
+    }
+
+    /* 由分组键和聚合状态生成输出元组，out的长度为tuple_len() */
+    void finalize(const char *key, const char *state, char *out) const {
+        memcpy(out, key, key_len_);
+        for (size_t i = 0; i < slots_.size(); i++) {
+            const Slot &slot = slots_[i];
+            const ColMeta &col = cols_[group_cols_.size() + i];
+            const char *st = state + slot.state_offset;
+            const char *acc = st + sizeof(int64_t);
+            int64_t count;
+            memcpy(&count, st, sizeof(int64_t));
+            char *dst = out + col.offset;
+            if (slot.type == AGG_COUNT) {
+                int v = static_cast<int>(count);
+                memcpy(dst, &v, sizeof(int));
+            } else if (slot.type == AGG_MIN || slot.type == AGG_MAX) {
+                memcpy(dst, acc, col.len);
+            } else {
+                double sum;
+                if (slot.in_col.type == TYPE_INT) {
+                    int64_t isum;
+                    memcpy(&isum, acc, sizeof(int64_t));
+                    sum = static_cast<double>(isum);
+                    if (slot.type == AGG_SUM) {
+                        int v = static_cast<int>(isum);
+                        memcpy(dst, &v, sizeof(int));
+                        continue;
+                    }
+                } else {
+                    memcpy(&sum, acc, sizeof(double));
+                }
+                float v = static_cast<float>(slot.type == AGG_AVG && count > 0 ? sum / count : sum);
+                memcpy(dst, &v, sizeof(float));
+            }
+        }
+    }
+};
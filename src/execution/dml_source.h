@@ -0,0 +1,67 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "executor_abstract.h"
+
+/**
+ * @brief UPDATE/DELETE要修改的记录的来源。按批次从扫描算子拉取记录，处理完一个批次再取下一个批次，
+ * 内存占用与修改的记录数无关，记录数据直接取自批次，每个页面只访问一次。
+ * 修改会改变扫描本身的结果时（万圣节问题，例如沿B+树索引扫描时删除或移动该索引中的项），
+ * 先把全部rid收集下来，扫描结束后再逐个读取记录并修改
+ */
+class DmlSource {
+   public:
+    /**
+     * @param scan 找出要修改的记录的扫描算子
+     * @param spool 是否先收集全部rid再修改
+     */
+    DmlSource(std::unique_ptr<AbstractExecutor> scan, bool spool, RmFileHandle *fh, Context *context)
+        : scan_(std::move(scan)), spool_(spool), fh_(fh), context_(context) {}
+
+    /**
+     * @brief 对每条要修改的记录调用fn(const Rid &rid, char *rec)，rec是修改前的记录，fn可以在其上构造新记录
+     */
+    template <typename Fn>
+    void for_each(Fn &&fn) {
+        TupleBatch batch;
+        scan_->beginBatch();
+        if (!spool_) {
+            while (scan_->NextBatch(batch)) {
+                for (size_t k = 0; k < batch.size(); ++k) {
+                    fn(batch.rid(k), batch.tuple(k));
+                }
+            }
+            return;
+        }
+
+        std::vector<Rid> rids;
+        while (scan_->NextBatch(batch)) {
+            for (size_t k = 0; k < batch.size(); ++k) {
+                rids.push_back(batch.rid(k));
+            }
+        }
+        scan_.reset();
+        for (auto &rid : rids) {
+            auto rec = fh_->get_record(rid, context_);
+            fn(rid, rec->data);
+        }
+    }
+
+   private:
+    std::unique_ptr<AbstractExecutor> scan_;
+    bool spool_;
+    RmFileHandle *fh_;
+    Context *context_;
+};
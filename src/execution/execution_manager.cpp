@@ -17,26 +17,44 @@ See the Mulan PSL v2 for more details. */
 #include "executor_projection.h"
 #include "executor_seq_scan.h"
 #include "executor_update.h"
+#include "common/tracepoint.h"
 #include "index/ix.h"
+#include "plan_printer.h"
 #include "record_printer.h"
+#include "system/output_log.h"
 
 const char *help_info = "Supported SQL syntax:\n"
                    "  command ;\n"
                    "command:\n"
-                   "  CREATE TABLE table_name (column_name type [, column_name type ...])\n"
+                   "  CREATE TABLE table_name (column_name type [, column_name type ...]) [STORAGE = ROW | PAX]\n"
+                   "      [COMPRESSION = NONE | LZ4] [PARTITION BY partitioning]\n"
                    "  DROP TABLE table_name\n"
-                   "  CREATE INDEX table_name (column_name)\n"
+                   "  CREATE MATERIALIZED VIEW view_name [(column_name, ...)] [REFRESH = IMMEDIATE | DEFERRED]\n"
+                   "      AS SELECT ...\n"
+                   "  REFRESH MATERIALIZED VIEW view_name\n"
+                   "  CREATE INDEX [CONCURRENTLY] table_name (column_name)\n"
                    "  DROP INDEX table_name (column_name)\n"
                    "  INSERT INTO table_name VALUES (value [, value ...])\n"
                    "  DELETE FROM table_name [WHERE where_clause]\n"
                    "  UPDATE table_name SET column_name = value [, column_name = value ...] [WHERE where_clause]\n"
                    "  SELECT selector FROM table_name [WHERE where_clause]\n"
+                   "  LOAD DATA 'file_name' INTO table_name\n"
+                   "  VACUUM table_name\n"
+                   "  ANALYZE [table_name]\n"
+                   "  EXPLAIN [ANALYZE] {INSERT | DELETE | UPDATE | SELECT} ...\n"
+                   "  SHOW BUFFER STATS\n"
+                   "  SHOW METRICS\n"
                    "type:\n"
-                   "  {INT | FLOAT | CHAR(n)}\n"
+                   "  {INT | FLOAT | CHAR(n) | VARCHAR(n)} [ENCODING = NONE | DICT[(1 | 2 | 4)]]\n"
+                   "partitioning:\n"
+                   "  HASH (column_name) PARTITIONS n\n"
+                   "  RANGE (column_name) (PARTITION name VALUES LESS THAN {(value) | MAXVALUE} [, ...])\n"
                    "where_clause:\n"
                    "  condition [AND condition ...]\n"
                    "condition:\n"
                    "  column op {column | value}\n"
+                   "  column [NOT] IN (SELECT ...)    (in SELECT only)\n"
+                   "  [NOT] EXISTS (SELECT ...)       (in SELECT only)\n"
                    "column:\n"
                    "  [table_name.]column_name\n"
                    "op:\n"
@@ -50,7 +68,8 @@ void QlManager::run_mutli_query(std::shared_ptr<Plan> plan, Context *context){
         switch(x->tag) {
             case T_CreateTable:
             {
-                sm_manager_->create_table(x->tab_name_, x->cols_, context);
+                sm_manager_->create_table(x->tab_name_, x->cols_, context, x->storage_, x->partition_,
+                                          x->compression_);
                 break;
             }
             case T_DropTable:
@@ -60,7 +79,13 @@ void QlManager::run_mutli_query(std::shared_ptr<Plan> plan, Context *context){
             }
             case T_CreateIndex:
             {
-                sm_manager_->create_index(x->tab_name_, x->tab_col_names_, context);
+                // 索引列上允许重复的值，例如低基数的状态列
+                if (x->concurrently_) {
+                    sm_manager_->create_index_concurrently(x->tab_name_, x->tab_col_names_, context, false,
+                                                           x->index_type_);
+                } else {
+                    sm_manager_->create_index(x->tab_name_, x->tab_col_names_, context, false, x->index_type_);
+                }
                 break;
             }
             case T_DropIndex:
@@ -75,7 +100,7 @@ void QlManager::run_mutli_query(std::shared_ptr<Plan> plan, Context *context){
     }
 }
 
-// 执行help; show tables; desc table; begin; commit; abort;语句
+// 执行help; show tables; show buffer stats; show metrics; desc table; load data; begin; commit; abort;语句
 void QlManager::run_cmd_utility(std::shared_ptr<Plan> plan, txn_id_t *txn_id, Context *context) {
     if (auto x = std::dynamic_pointer_cast<OtherPlan>(plan)) {
         switch(x->tag) {
@@ -90,11 +115,37 @@ void QlManager::run_cmd_utility(std::shared_ptr<Plan> plan, txn_id_t *txn_id, Co
                 sm_manager_->show_tables(context);
                 break;
             }
+            case T_ShowBufferStats:
+            {
+                sm_manager_->show_buffer_stats(context);
+                break;
+            }
+            case T_ShowMetrics:
+            {
+                sm_manager_->show_metrics(context);
+                break;
+            }
             case T_DescTable:
             {
                 sm_manager_->desc_table(x->tab_name_, context);
                 break;
             }
+            case T_LoadData:
+            {
+                auto load = std::dynamic_pointer_cast<LoadDataPlan>(x);
+                sm_manager_->load_data(load->file_name_, load->tab_name_, context);
+                break;
+            }
+            case T_VacuumTable:
+            {
+                sm_manager_->vacuum_table(x->tab_name_, context);
+                break;
+            }
+            case T_AnalyzeTable:
+            {
+                sm_manager_->analyze_table(x->tab_name_, context);
+                break;
+            }
             case T_Transaction_begin:
             {
                 // 显示开启一个事务
@@ -129,6 +180,12 @@ void QlManager::run_cmd_utility(std::shared_ptr<Plan> plan, txn_id_t *txn_id, Co
                 *txn_id = INVALID_TXN_ID;
                 break;
             }     
+            case T_Prepare:
+            case T_Deallocate:
+            {
+                // 预编译语句在生成计划时已经处理完
+                break;
+            }
             default:
                 throw InternalError("Unexpected field type");
                 break;                        
@@ -147,13 +204,19 @@ void QlManager::select_from(std::unique_ptr<AbstractExecutor> executorTreeRoot,
     }
 
     // Print header into buffer
+    // 客户端协商了二进制结果格式时按原始字节发送字段值，表格由客户端生成
+    bool binary = context->binary_result_;
     RecordPrinter rec_printer(sel_cols.size());
-    rec_printer.print_separator(context);
-    rec_printer.print_record(captions, context);
-    rec_printer.print_separator(context);
+    RecordEncoder rec_encoder;
+    if (binary) {
+        rec_encoder.encode_header(captions, executorTreeRoot->cols(), context);
+    } else {
+        rec_printer.print_separator(context);
+        rec_printer.print_record(captions, context);
+        rec_printer.print_separator(context);
+    }
     // print header into file
-    std::fstream outfile;
-    outfile.open("output.txt", std::ios::out | std::ios::app);
+    OutputBuffer outfile(context->capture_ != nullptr ? &context->capture_->output : nullptr);
     outfile << "|";
     for(int i = 0; i < captions.size(); ++i) {
         outfile << " " << captions[i] << " |";
@@ -162,34 +225,57 @@ void QlManager::select_from(std::unique_ptr<AbstractExecutor> executorTreeRoot,
 
     // Print records
     size_t num_rec = 0;
-    // 执行query_plan
-    for (executorTreeRoot->beginTuple(); !executorTreeRoot->is_end(); executorTreeRoot->nextTuple()) {
-        auto Tuple = executorTreeRoot->Next();
-        std::vector<std::string> columns;
-        for (auto &col : executorTreeRoot->cols()) {
-            std::string col_str;
-            char *rec_buf = Tuple->data + col.offset;
-            if (col.type == TYPE_INT) {
-                col_str = std::to_string(*(int *)rec_buf);
-            } else if (col.type == TYPE_FLOAT) {
-                col_str = std::to_string(*(float *)rec_buf);
-            } else if (col.type == TYPE_STRING) {
-                col_str = std::string((char *)rec_buf, col.len);
-                col_str.resize(strlen(col_str.c_str()));
-            }
-            columns.push_back(col_str);
+    // 执行query_plan，按批次从算子树中取出结果元组
+    TupleBatch batch;
+    bool first_batch = true;
+    // executor_open/executor_close之间是算子树从开始执行到输出最后一条结果的时间，参数为根算子的类型
+    std::string root_type = executorTreeRoot->getType();
+    RMDB_TRACE(executor_open, root_type.c_str());
+    executorTreeRoot->beginBatch();
+    while (executorTreeRoot->NextBatch(batch)) {
+        for (size_t k = 0; k < batch.size(); ++k) {
+            const char *tuple = batch.tuple(k);
+            std::vector<std::string> columns;
+            for (auto &col : executorTreeRoot->cols()) {
+                std::string col_str;
+                const char *rec_buf = tuple + col.offset;
+                if (col.type == TYPE_INT) {
+                    col_str = std::to_string(*(const int *)rec_buf);
+                } else if (col.type == TYPE_FLOAT) {
+                    col_str = std::to_string(*(const float *)rec_buf);
+                } else if (is_string_type(col.type)) {
+                    col_str = std::string(rec_buf, col.len);
+                    col_str.resize(strlen(col_str.c_str()));
+                }
+                columns.push_back(col_str);
+            }
+            // print record into buffer
+            if (binary) {
+                rec_encoder.encode_record(tuple, executorTreeRoot->cols(), context);
+            } else {
+                rec_printer.print_record(columns, context);
+            }
+            // print record into file
+            outfile << "|";
+            for(int i = 0; i < columns.size(); ++i) {
+                outfile << " " << columns[i] << " |";
+            }
+            outfile << "\n";
+            num_rec++;
         }
-        // print record into buffer
-        rec_printer.print_record(columns, context);
-        // print record into file
-        outfile << "|";
-        for(int i = 0; i < columns.size(); ++i) {
-            outfile << " " << columns[i] << " |";
+        // 流式返回时第一批结果生成后立即发送，客户端不必等缓冲区写满才收到第一个字节
+        if (RESULT_STREAMING && first_batch) {
+            context->flush_send();
+            first_batch = false;
         }
-        outfile << "\n";
-        num_rec++;
     }
-    outfile.close();
+    RMDB_TRACE(executor_close, root_type.c_str(), num_rec);
+    outfile.flush();
+    QueryStats::add(QueryStats::ROWS_RETURNED, num_rec);
+    if (binary) {
+        rec_encoder.encode_record_count(num_rec, context);
+        return;
+    }
     // Print footer into buffer
     rec_printer.print_separator(context);
     // Print record count into buffer
@@ -198,5 +284,40 @@ void QlManager::select_from(std::unique_ptr<AbstractExecutor> executorTreeRoot,
 
 // 执行DML语句
 void QlManager::run_dml(std::unique_ptr<AbstractExecutor> exec){
+    std::string type = exec->getType();
+    RMDB_TRACE(executor_open, type.c_str());
     exec->Next();
+    RMDB_TRACE(executor_close, type.c_str(), 0);
+}
+
+/**
+ * @brief 输出explain语句的计划。explain analyze先执行语句，丢弃查询结果，再输出每个算子的执行统计和总的执行时间
+ *
+ * @param root explain analyze带统计节点的算子树，explain时为空
+ * @param op_stats root中的统计节点记录的执行统计
+ */
+void QlManager::explain(std::shared_ptr<ExplainPlan> plan, std::unique_ptr<AbstractExecutor> root,
+                        const std::map<const Plan *, OperatorStats> *op_stats, Context *context) {
+    double time_ms = 0;
+    if (plan->analyze_) {
+        auto start = std::chrono::steady_clock::now();
+        auto dml = std::dynamic_pointer_cast<DMLPlan>(plan->subplan_);
+        if (dml != nullptr && dml->tag == T_select) {
+            TupleBatch batch;
+            root->beginBatch();
+            while (root->NextBatch(batch)) {
+            }
+        } else {
+            root->Next();
+        }
+        time_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    for (auto &line : PlanPrinter(plan->analyze_ ? op_stats : nullptr, sm_manager_).print(plan->subplan_)) {
+        RecordPrinter::print_line(line, context);
+    }
+    if (plan->analyze_) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "Execution time: %.3f ms", time_ms);
+        RecordPrinter::print_line(buf, context);
+    }
 }
\ No newline at end of file
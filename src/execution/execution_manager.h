@@ -12,6 +12,7 @@ See the Mulan PSL v2 for more details. */
 
 #include <cassert>
 #include <cstring>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -23,6 +24,7 @@ See the Mulan PSL v2 for more details. */
 #include "common/common.h"
 #include "optimizer/plan.h"
 #include "executor_abstract.h"
+#include "executor_instrument.h"
 #include "transaction/transaction_manager.h"
 
 
@@ -41,4 +43,7 @@ class QlManager {
                         Context *context);
 
     void run_dml(std::unique_ptr<AbstractExecutor> exec);
+
+    void explain(std::shared_ptr<ExplainPlan> plan, std::unique_ptr<AbstractExecutor> root,
+                 const std::map<const Plan *, OperatorStats> *op_stats, Context *context);
 };
@@ -8,42 +8,125 @@ EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
 MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
 See the Mulan PSL v2 for more details. */
 
+
 #pragma once
+
 #include "execution_defs.h"
 #include "execution_manager.h"
 #include "executor_abstract.h"
 #include "index/ix.h"
+#include "parallel_sort.h"
 #include "system/sm.h"
 
-class SortExecutor : public AbstractExecutor {
+/**
+ * @brief 排序键的保序编码：各键按ix_normalize_key编码，降序的键再按位取反，编码结果只需memcmp比较
+ */
+class SortKey {
    private:
-    std::unique_ptr<AbstractExecutor> prev_;
-    ColMeta cols_;                              // 框架中只支持一个键排序，需要自行修改数据结构支持多个键排序
-    size_t tuple_num;
-    bool is_desc_;
-    std::vector<size_t> used_tuple;
-    std::unique_ptr<RmRecord> current_tuple;
+    std::vector<ColMeta> sort_cols_;            // 排序键在元组中的字段
+    std::vector<bool> is_desc_;                 // 每个排序键是否降序
+    std::vector<ColType> key_types_;
+    std::vector<int> key_lens_;
+    size_t key_len_ = 0;                        // 编码后排序键的长度
+    std::vector<char> raw_key_;
 
    public:
-    SortExecutor(std::unique_ptr<AbstractExecutor> prev, TabCol sel_cols, bool is_desc) {
-        prev_ = std::move(prev);
-        cols_ = prev_->get_col_offset(sel_cols);
-        is_desc_ = is_desc;
-        tuple_num = 0;
-        used_tuple.clear();
+    /**
+     * @param child 产生元组的算子，排序键在它的输出字段中查找
+     * @param sel_cols 排序键，按优先级排列
+     * @param is_desc 每个排序键是否降序
+     */
+    SortKey(AbstractExecutor &child, const std::vector<TabCol> &sel_cols, std::vector<bool> is_desc) {
+        is_desc_ = std::move(is_desc);
+        for (auto &sel_col : sel_cols) {
+            const ColMeta &col = *child.get_col(child.cols(), sel_col);
+            sort_cols_.push_back(col);
+            key_types_.push_back(col.type);
+            key_lens_.push_back(col.len);
+            key_len_ += col.len;
+        }
+        raw_key_.resize(key_len_);
     }
 
-    void beginTuple() override { 
-        
+    size_t len() const { return key_len_; }
+
+    /* 把元组的排序键编码到dst，dst的长度为len() */
+    void encode(const char *tuple, char *dst) {
+        size_t offset = 0;
+        for (auto &col : sort_cols_) {
+            memcpy(raw_key_.data() + offset, tuple + col.offset, col.len);
+            offset += col.len;
+        }
+        ix_normalize_key(raw_key_.data(), dst, key_types_, key_lens_);
+        offset = 0;
+        for (size_t i = 0; i < sort_cols_.size(); i++) {
+            if (is_desc_[i]) {
+                for (int j = 0; j < key_lens_[i]; j++) dst[offset + j] = static_cast<char>(~dst[offset + j]);
+            }
+            offset += key_lens_[i];
+        }
     }
+};
+
+/**
+ * @brief ORDER BY的外部归并排序，支持多个排序键，每个键可以分别指定升序或降序
+ * 每个输入元组前面拼上SortKey编码的排序键，交给ParallelSorter：内存中的条目由工作线程并行排序，
+ * 超过mem_budget字节或者语句的内存记账器拒绝继续预留后写出run，输入结束后并行归并内存中的块或者用败者树归并所有run。
+ * 排序是稳定的：排序键相同的元组按输入的顺序输出
+ */
+class SortExecutor : public BatchExecutor {
+   private:
+    std::unique_ptr<AbstractExecutor> prev_;
+    SortKey key_;
+    size_t key_len_;                            // 编码后排序键的长度
+    size_t tuple_len_;
+    size_t mem_budget_;
+    std::unique_ptr<ParallelSorter> sorter_;    // 每次beginBatch重新创建
 
-    void nextTuple() override {
-        
+   public:
+    SortExecutor(std::unique_ptr<AbstractExecutor> prev, const std::vector<TabCol> &sel_cols,
+                 const std::vector<bool> &is_desc, size_t mem_budget = EXEC_SORT_MEM_SIZE)
+        : prev_(std::move(prev)), key_(*prev_, sel_cols, is_desc) {
+        context_ = prev_->context_;
+        key_len_ = key_.len();
+        tuple_len_ = prev_->tupleLen();
+        mem_budget_ = mem_budget;
     }
 
-    std::unique_ptr<RmRecord> Next() override {
-        return nullptr;
+    size_t tupleLen() const override { return tuple_len_; }
+
+    const std::vector<ColMeta> &cols() const override { return prev_->cols(); }
+
+    std::string getType() override { return "SortExecutor"; }
+
+    ColMeta get_col_offset(const TabCol &target) override { return *get_col(prev_->cols(), target); }
+
+    /**
+     * @brief 读入子节点的全部输出，每个元组追加一个(排序键, 元组)条目，之后结束排序的输入
+     */
+    void beginBatch() override {
+        sorter_.reset();
+        sorter_ = std::make_unique<ParallelSorter>(key_len_, key_len_ + tuple_len_, mem_budget_, mem_tracker());
+        prev_->beginBatch();
+        TupleBatch batch;
+        while (prev_->NextBatch(batch)) {
+            for (size_t k = 0; k < batch.size(); ++k) {
+                const char *tuple = batch.tuple(k);
+                char *entry = sorter_->add();
+                key_.encode(tuple, entry);
+                memcpy(entry + key_len_, tuple, tuple_len_);
+            }
+        }
+        sorter_->finish();
     }
 
-    Rid &rid() override { return _abstract_rid; }
-};
\ No newline at end of file
+    bool NextBatch(TupleBatch &batch) override {
+        batch.reset(&prev_->cols(), tuple_len_);
+        while (sorter_ != nullptr && !batch.full()) {
+            const char *entry = sorter_->next();
+            if (entry == nullptr) break;
+            batch.append(entry + key_len_, Rid{INVALID_PAGE_ID, -1});
+        }
+        return !batch.empty();
+    }
+};
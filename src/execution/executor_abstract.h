@@ -11,6 +11,9 @@ See the Mulan PSL v2 for more details. */
 #pragma once
 
 #include "execution_defs.h"
+#include "predicate.h"
+#include "runtime_filter.h"
+#include "tuple_batch.h"
 #include "common/common.h"
 #include "index/ix.h"
 #include "system/sm.h"
@@ -19,7 +22,9 @@ class AbstractExecutor {
    public:
     Rid _abstract_rid;
 
-    Context *context_;
+    Context *context_ = nullptr;
+
+    bool predicate_locked_ = false;     // 扫描算子是否已经登记过谓词锁
 
     virtual ~AbstractExecutor() = default;
 
@@ -42,8 +47,61 @@ class AbstractExecutor {
 
     virtual std::unique_ptr<RmRecord> Next() = 0;
 
+    /* 返回当前元组的只读视图，用于在不复制数据的情况下计算谓词；
+       默认通过Next()生成一条独立的记录，能够直接访问页面的算子（如扫描算子）应当重写该函数 */
+    virtual RecordView view() { return RecordView(Next()); }
+
+    /* 批量接口：先调用beginBatch()，再反复调用NextBatch()直到返回false；同一次执行中不能与逐行接口混用。
+       默认实现逐行调用beginTuple()/nextTuple()把元组复制到批次中，供没有批量实现的算子使用 */
+    virtual void beginBatch() { beginTuple(); }
+
+    /**
+     * @brief 取出下一批元组，批次按照cols()的格式存放，最多EXEC_BATCH_SIZE个
+     *
+     * @param batch 输出的批次，调用时清空
+     * @return 没有更多元组时返回false，此时batch为空
+     */
+    virtual bool NextBatch(TupleBatch &batch) {
+        batch.reset(&cols(), tupleLen());
+        for (; !is_end() && !batch.full(); nextTuple()) {
+            // view()可能通过Next()在arena中生成临时元组，复制到批次之后立即回退
+            Arena::Mark mark{};
+            if (context_ != nullptr) mark = context_->arena_.mark();
+            {
+                RecordView rec = view();
+                batch.append(rec.data(), rid());
+            }
+            if (context_ != nullptr) context_->arena_.rewind(mark);
+        }
+        return !batch.empty();
+    }
+
     virtual ColMeta get_col_offset(const TabCol &target) { return ColMeta();};
 
+    /**
+     * @brief 哈希连接建立哈希表之后把构建侧的运行时过滤器下推到探测侧，keys是过滤器的哈希键在本算子输出元组中的位置。
+     * 扫描算子保存过滤器，之后的批次在复制元组之前检查；不改变元组格式、也不改变哪些元组参与连接的算子转发给子节点。
+     * 过滤器只在当前这次执行中有效，算子重新开始执行时丢弃
+     *
+     * @return 是否有算子接受了过滤器
+     */
+    virtual bool push_runtime_filter(const std::shared_ptr<const RuntimeFilter> &filter,
+                                     const std::vector<JoinKeyCol> &keys) {
+        return false;
+    }
+
+    /* 分配一条长度为len的输出元组。数据从当前请求的arena中分配，不单独释放，在请求结束或调用者回退arena之前有效；
+       需要跨越多个元组保留记录的算子应当自行复制。没有上下文时单独分配 */
+    std::unique_ptr<RmRecord> make_tuple(size_t len) {
+        if (context_ == nullptr) {
+            return std::make_unique<RmRecord>(static_cast<int>(len));
+        }
+        return std::make_unique<RmRecord>(static_cast<int>(len), &context_->arena_);
+    }
+
+    /* 当前语句的内存记账器，需要大块内存的算子通过MemoryReservation向它申请；没有上下文时为空，不记账 */
+    MemoryTracker *mem_tracker() const { return context_ != nullptr ? &context_->mem_tracker_ : nullptr; }
+
     std::vector<ColMeta>::const_iterator get_col(const std::vector<ColMeta> &rec_cols, const TabCol &target) {
         auto pos = std::find_if(rec_cols.begin(), rec_cols.end(), [&](const ColMeta &col) {
             return col.tab_name == target.tab_name && col.name == target.col_name;
@@ -53,4 +111,103 @@ class AbstractExecutor {
         }
         return pos;
     }
+
+    /* 事务按快照读取时扫描算子读取快照中的记录，不加锁 */
+    bool snapshot_read() const {
+        return context_ != nullptr && context_->txn_ != nullptr && context_->txn_->snapshot_read();
+    }
+
+    /**
+     * @brief 扫描开始前加谓词锁：表级 IS 锁加上编译后的扫描条件，代替表级 S 锁防止幻读。
+     * 锁持有到事务结束，谓词按值复制进锁中；算子重复开始扫描（例如作为嵌套循环连接的内表）时只登记一次；快照读不加锁。
+     * 乐观并发控制的事务不加锁，把扫描条件登记到事务的读集合中，提交时验证
+     */
+    void lock_scan_predicate(RmFileHandle *fh, const Predicate &pred) {
+        if (predicate_locked_ || context_ == nullptr || context_->txn_ == nullptr) {
+            return;
+        }
+        if (context_->txn_->is_optimistic()) {
+            context_->txn_->append_read_predicate(fh, [pred](const char *rec) { return pred.eval(rec); });
+            predicate_locked_ = true;
+            return;
+        }
+        if (context_->lock_mgr_ == nullptr || snapshot_read()) {
+            return;
+        }
+        context_->lock_mgr_->lock_shared_on_predicate(context_->txn_, fh->GetFd(),
+                                                      [pred](const char *rec) { return pred.eval(rec); });
+        predicate_locked_ = true;
+    }
+
+    /* 按照字段类型比较两个字段值，返回值小于0、等于0、大于0分别表示lhs小于、等于、大于rhs */
+    static int compare_value(ColType type, int len, const char *lhs, const char *rhs) {
+        if (type == TYPE_INT) {
+            int a = *(const int *)lhs, b = *(const int *)rhs;
+            return (a < b) ? -1 : ((a > b) ? 1 : 0);
+        } else if (type == TYPE_FLOAT) {
+            float a = *(const float *)lhs, b = *(const float *)rhs;
+            return (a < b) ? -1 : ((a > b) ? 1 : 0);
+        }
+        // 字符串：直接使用字节比较
+        return memcmp(lhs, rhs, len);
+    }
+
+    /* 判断比较结果是否满足比较运算符op */
+    static bool satisfy_op(CompOp op, int cmp) {
+        switch (op) {
+            case OP_EQ: return cmp == 0;
+            case OP_NE: return cmp != 0;
+            case OP_LT: return cmp < 0;
+            case OP_GT: return cmp > 0;
+            case OP_LE: return cmp <= 0;
+            case OP_GE: return cmp >= 0;
+        }
+        return false;
+    }
+};
+
+/**
+ * @brief 只实现了批量接口的算子的基类，逐行接口在NextBatch()取出的批次上实现
+ */
+class BatchExecutor : public AbstractExecutor {
+   public:
+    void beginBatch() override = 0;
+
+    bool NextBatch(TupleBatch &batch) override = 0;
+
+    void beginTuple() override {
+        beginBatch();
+        fill_rows();
+    }
+
+    void nextTuple() override {
+        if (row_end_) return;
+        if (++row_pos_ >= row_batch_.size()) fill_rows();
+    }
+
+    bool is_end() const override { return row_end_; }
+
+    std::unique_ptr<RmRecord> Next() override {
+        if (is_end()) return nullptr;
+        auto out = make_tuple(tupleLen());
+        memcpy(out->data, row_batch_.tuple(row_pos_), tupleLen());
+        return out;
+    }
+
+    RecordView view() override {
+        if (is_end()) return RecordView();
+        return RecordView(row_batch_.tuple(row_pos_), static_cast<int>(tupleLen()));
+    }
+
+    Rid &rid() override { return _abstract_rid; }
+
+   private:
+    void fill_rows() {
+        row_pos_ = 0;
+        row_end_ = !NextBatch(row_batch_);
+    }
+
+    TupleBatch row_batch_;      // 逐行接口当前所在的批次
+    size_t row_pos_ = 0;
+    bool row_end_ = true;
 };
\ No newline at end of file
@@ -0,0 +1,134 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "execution_defs.h"
+#include "execution_manager.h"
+#include "executor_abstract.h"
+#include "index/ix.h"
+#include "system/sm.h"
+
+/**
+ * @brief 分区表上的扫描：依次输出裁剪之后剩下的各分区上的扫描的元组。
+ * 分区与分区表的字段偏移相同，元组原样输出，只把字段换成分区表的字段，上层算子按分区表的表名查找字段。
+ * 没有剩下的分区时直接结束
+ */
+class AppendExecutor : public AbstractExecutor {
+   private:
+    std::vector<std::unique_ptr<AbstractExecutor>> children_;   // 各分区上的扫描
+    std::vector<ColMeta> cols_;         // 分区表的字段
+    size_t len_;
+    size_t cur_ = 0;                    // 当前输出的分区
+    bool batch_started_ = false;        // 批量接口是否已经开始当前分区的扫描
+
+   public:
+    AppendExecutor(std::vector<std::unique_ptr<AbstractExecutor>> children, std::vector<ColMeta> cols,
+                   Context *context) {
+        children_ = std::move(children);
+        cols_ = std::move(cols);
+        len_ = cols_.back().offset + cols_.back().len;
+        context_ = context;
+    }
+
+    size_t tupleLen() const override { return len_; }
+
+    const std::vector<ColMeta> &cols() const override { return cols_; }
+
+    std::string getType() override { return "AppendExecutor"; }
+
+    ColMeta get_col_offset(const TabCol &target) override { return *get_col(cols_, target); }
+
+    void beginTuple() override {
+        cur_ = 0;
+        start_child();
+    }
+
+    void nextTuple() override {
+        if (is_end()) return;
+        children_[cur_]->nextTuple();
+        if (children_[cur_]->is_end()) {
+            ++cur_;
+            start_child();
+        }
+    }
+
+    bool is_end() const override { return cur_ >= children_.size(); }
+
+    std::unique_ptr<RmRecord> Next() override { return is_end() ? nullptr : children_[cur_]->Next(); }
+
+    RecordView view() override { return is_end() ? RecordView() : children_[cur_]->view(); }
+
+    Rid &rid() override { return is_end() ? _abstract_rid : children_[cur_]->rid(); }
+
+    void beginBatch() override {
+        cur_ = 0;
+        batch_started_ = false;
+    }
+
+    bool NextBatch(TupleBatch &batch) override {
+        for (; cur_ < children_.size(); ++cur_, batch_started_ = false) {
+            if (!batch_started_) {
+                children_[cur_]->beginBatch();
+                batch_started_ = true;
+            }
+            if (children_[cur_]->NextBatch(batch)) {
+                batch.set_cols(&cols_);
+                return true;
+            }
+        }
+        batch.reset(&cols_, len_);
+        return false;
+    }
+
+    /* 各分区与分区表的元组格式相同，过滤器下推到每个分区上的扫描 */
+    bool push_runtime_filter(const std::shared_ptr<const RuntimeFilter> &filter,
+                             const std::vector<JoinKeyCol> &keys) override {
+        bool pushed = false;
+        for (auto &child : children_) {
+            pushed = child->push_runtime_filter(filter, keys) || pushed;
+        }
+        return pushed;
+    }
+
+   private:
+    /* 从cur_开始找到第一个有元组的分区 */
+    void start_child() {
+        for (; cur_ < children_.size(); ++cur_) {
+            children_[cur_]->beginTuple();
+            if (!children_[cur_]->is_end()) return;
+        }
+    }
+};
+
+/**
+ * @brief 分区表上的UPDATE和DELETE：裁剪之后剩下的每个分区上有一个UPDATE或DELETE算子，依次执行
+ */
+class AppendDmlExecutor : public AbstractExecutor {
+   private:
+    std::vector<std::unique_ptr<AbstractExecutor>> children_;   // 各分区上的UPDATE或DELETE
+
+   public:
+    AppendDmlExecutor(std::vector<std::unique_ptr<AbstractExecutor>> children, Context *context) {
+        children_ = std::move(children);
+        context_ = context;
+    }
+
+    std::string getType() override { return "AppendDmlExecutor"; }
+
+    std::unique_ptr<RmRecord> Next() override {
+        for (auto &child : children_) {
+            child->Next();
+        }
+        return nullptr;
+    }
+
+    Rid &rid() override { return _abstract_rid; }
+};
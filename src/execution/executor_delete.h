@@ -12,6 +12,8 @@ See the Mulan PSL v2 for more details. */
 #include "execution_defs.h"
 #include "execution_manager.h"
 #include "executor_abstract.h"
+#include "dml_source.h"
+#include "index_writer.h"
 #include "index/ix.h"
 #include "system/sm.h"
 
@@ -20,26 +22,30 @@ class DeleteExecutor : public AbstractExecutor {
     TabMeta tab_;                   // 表的元数据
     std::vector<Condition> conds_;  // delete的条件
     RmFileHandle *fh_;              // 表的数据文件句柄
-    std::vector<Rid> rids_;         // 需要删除的记录的位置
+    std::shared_lock<std::shared_mutex> dml_lock_;  // 执行期间表上不会出现新的索引，见RmFileHandle::lock_dml
+    DmlSource source_;              // 需要删除的记录
     std::string tab_name_;          // 表名称
     SmManager *sm_manager_;
 
    public:
     DeleteExecutor(SmManager *sm_manager, const std::string &tab_name, std::vector<Condition> conds,
-                   std::vector<Rid> rids, Context *context) {
+                   std::unique_ptr<AbstractExecutor> scan, bool spool, Context *context)
+        : source_(std::move(scan), spool, sm_manager->get_table_handle(tab_name), context) {
         sm_manager_ = sm_manager;
         tab_name_ = tab_name;
+        fh_ = sm_manager_->get_table_handle(tab_name);
+        dml_lock_ = fh_->lock_dml();
         tab_ = sm_manager_->db_.get_table(tab_name);
-        fh_ = sm_manager_->fhs_.at(tab_name).get();
         conds_ = conds;
-        rids_ = rids;
         context_ = context;
     }
 
     std::unique_ptr<RmRecord> Next() override {
-        // 1. 迭代执行计划中提供的所有待删除记录的 RID 集合体体。
-        // 这些 RID 通常由底层的扫描算子预先收集。
-        for (auto &rid : rids_) {
+        // 索引句柄和key布局在语句开始时解析一次，各索引的删除攒成批次后按key顺序执行
+        IndexWriter index_writer(sm_manager_, tab_name_, tab_.indexes, context_->txn_);
+
+        // 1. 按批次从扫描算子中取出待删除的记录，边扫描边删除。
+        auto delete_one = [&](const Rid &rid, const char *rec) {
             // ========== 并发控制（关键点：先加锁，再改索引/数据）==========
             // 解释（答辩高频点）：
             // - DELETE 既会修改“表记录”，也会修改“索引”。
@@ -50,32 +56,25 @@ class DeleteExecutor : public AbstractExecutor {
                 context_->lock_mgr_->lock_IX_on_table(context_->txn_, fh_->GetFd());
                 context_->lock_mgr_->lock_exclusive_on_record(context_->txn_, rid, fh_->GetFd());
             }
+            // 多版本并发控制下还要先取得记录的写权：记录被其他事务修改时在修改索引之前回滚
+            fh_->claim_record(rid, context_);
 
-            // 2. 获取旧记录内容体体。
-            // 必须在物理删除前拉取数据，因为我们需要旧数据来构造索引的 Key。
-            auto rec = fh_->get_record(rid, context_);
-
-            // 3. 维护索引：逐个删除该表上的所有索引项体体。
-            for (auto &index : tab_.indexes) {
-                // 定位索引句柄体体
-                auto ih = sm_manager_->ihs_.at(sm_manager_->get_ix_manager()->get_index_name(tab_name_, index.cols)).get();
-                
-                // 组装当前记录在该索引下的复合键体体
-                std::unique_ptr<char[]> key(new char[index.col_tot_len]);
-                int offset = 0;
-                for (int i = 0; i < index.col_num; ++i) {
-                    // 按照索引定义的列顺序，从记录 Buffer 中拷贝数据体体
-                    memcpy(key.get() + offset, rec->data + index.cols[i].offset, index.cols[i].len);
-                    offset += index.cols[i].len;
-                }
-                // 从 B+ 树中物理删除对应的 Entry (Key, RID) 体体
-                ih->delete_entry(key.get(), context_->txn_);
-            }
+            // 2. 收集 rec 在该表所有索引中的 Key，攒满一批后按索引顺序删除。
+            index_writer.remove(rec, rid);
 
-            // 4. 物理删除记录体体。
-            // 在 RmFileHandle 中将该 rid 对应的位图标记设为无效体体。
+            // 3. 物理删除记录。
+            // 在 RmFileHandle 中将该 rid 对应的位图标记设为无效。
             fh_->delete_record(rid, context_);
+            index_writer.end_row();
+        };
+        try {
+            source_.for_each(delete_one);
+        } catch (...) {
+            // 已经删除的记录的索引项也要删除，保持索引与表一致
+            index_writer.flush();
+            throw;
         }
+        index_writer.flush();
         // 按照 DML 算子规约，返回空表示操作执行完毕体体
         return nullptr;
     }
@@ -0,0 +1,213 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "aggregator.h"
+#include "execution_defs.h"
+#include "execution_manager.h"
+#include "executor_abstract.h"
+#include "spill_file.h"
+#include "index/ix.h"
+#include "system/sm.h"
+
+/**
+ * @brief 哈希分组聚合，哈希表使用以分组键为键、线性探测的开放寻址法。
+ * 分组连续存放在groups_中，每个分组是(分组键, 聚合状态)，按第一次出现的顺序输出。
+ * 分组占用的内存超过预算后，已经在哈希表中的分组继续在内存中聚合，其余元组按分组键的哈希值写入
+ * EXEC_HASH_JOIN_FANOUT个临时文件；内存中的分组输出后再逐个分区聚合，分区仍然过大时用下一层的哈希函数再划分，
+ * 最多划分EXEC_HASH_JOIN_MAX_DEPTH层。同一分组的元组总是全部在内存中或者全部在同一个分区中
+ */
+class HashAggregateExecutor : public BatchExecutor {
+   private:
+    /* 一个溢出的分区以及它所在的划分层数 */
+    struct Partition {
+        SpillFile file;
+        int depth;
+    };
+
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    std::unique_ptr<AbstractExecutor> prev_;
+    Aggregator agg_;
+    size_t entry_len_;                          // 每个分组的长度：分组键长度 + 聚合状态长度
+    size_t mem_budget_;                         // 分组在内存中允许占用的字节数
+
+    std::vector<char> groups_;
+    std::vector<uint64_t> hashes_;              // 每个分组的分组键的哈希值
+    std::vector<uint32_t> table_;               // 哈希表的槽位，保存分组的下标，NIL表示空槽
+    uint64_t mask_ = 0;
+
+    int depth_ = 0;                             // 当前这一遍聚合的输入所在的划分层数
+    std::vector<SpillFile> spills_;             // 当前这一遍聚合正在写入的分区，为空表示没有溢出
+    std::vector<Partition> partitions_;         // 尚未聚合的分区
+    size_t out_pos_ = 0;                        // 下一个要输出的分组
+    bool end_ = false;
+    std::vector<char> key_buf_;
+    std::vector<char> io_buf_;
+    MemoryReservation mem_;                     // 内存中的分组和哈希表占用的内存
+
+   public:
+    HashAggregateExecutor(std::unique_ptr<AbstractExecutor> prev, const std::vector<TabCol> &group_cols,
+                          const std::vector<AggItem> &aggs, size_t mem_budget = EXEC_AGG_MEM_SIZE)
+        : prev_(std::move(prev)), agg_(*prev_, group_cols, aggs) {
+        context_ = prev_->context_;
+        entry_len_ = agg_.key_len() + agg_.state_len();
+        mem_budget_ = mem_budget;
+        key_buf_.resize(agg_.key_len());
+        mem_.set_tracker(mem_tracker());
+    }
+
+    ~HashAggregateExecutor() override { clear_spills(); }
+
+    size_t tupleLen() const override { return agg_.tuple_len(); }
+
+    const std::vector<ColMeta> &cols() const override { return agg_.cols(); }
+
+    std::string getType() override { return "HashAggregateExecutor"; }
+
+    ColMeta get_col_offset(const TabCol &target) override { return *get_col(agg_.cols(), target); }
+
+    /**
+     * @brief 读入子节点的全部输出并聚合，内存不足时把新分组的元组写入分区
+     */
+    void beginBatch() override {
+        clear_spills();
+        clear_table();
+        end_ = false;
+        depth_ = 0;
+        prev_->beginBatch();
+        TupleBatch batch;
+        while (prev_->NextBatch(batch)) {
+            aggregate(batch);
+        }
+        finish_pass();
+    }
+
+    /**
+     * @brief 输出内存中的分组，全部输出后聚合下一个分区
+     */
+    bool NextBatch(TupleBatch &batch) override {
+        batch.reset(&agg_.cols(), agg_.tuple_len());
+        while (!batch.full() && !end_) {
+            if (out_pos_ < hashes_.size()) {
+                const char *group = groups_.data() + out_pos_ * entry_len_;
+                agg_.finalize(group, group + agg_.key_len(), batch.append());
+                out_pos_++;
+                continue;
+            }
+            if (partitions_.empty()) {
+                end_ = true;
+                break;
+            }
+            Partition part = std::move(partitions_.back());
+            partitions_.pop_back();
+            clear_table();
+            depth_ = part.depth;
+            part.file.rewind();
+            TupleBatch in;
+            while (part.file.read(&prev_->cols(), prev_->tupleLen(), in, io_buf_)) {
+                aggregate(in);
+            }
+            part.file.remove();
+            finish_pass();
+        }
+        return !batch.empty();
+    }
+
+   private:
+    void aggregate(const TupleBatch &batch) {
+        size_t key_len = agg_.key_len();
+        for (size_t k = 0; k < batch.size(); ++k) {
+            const char *tuple = batch.tuple(k);
+            agg_.key(tuple, key_buf_.data());
+            uint64_t h = Aggregator::hash(key_buf_.data(), key_len);
+            uint64_t pos = h & mask_;
+            uint32_t group = NIL;
+            for (; table_[pos] != NIL; pos = (pos + 1) & mask_) {
+                uint32_t g = table_[pos];
+                if (hashes_[g] == h && memcmp(groups_.data() + g * entry_len_, key_buf_.data(), key_len) == 0) {
+                    group = g;
+                    break;
+                }
+            }
+            if (group == NIL) {
+                if (!spills_.empty()) {
+                    spills_[spill_partition_of(h, depth_, EXEC_HASH_JOIN_FANOUT)].write(tuple, prev_->tupleLen());
+                    continue;
+                }
+                group = new_group(h, pos);
+            }
+            agg_.update(groups_.data() + group * entry_len_ + key_len, tuple);
+        }
+    }
+
+    /* 在槽位pos上插入分组键为key_buf_的新分组；插入后内存超过预算或者语句的内存不足时开始溢出 */
+    uint32_t new_group(uint64_t h, uint64_t pos) {
+        auto group = static_cast<uint32_t>(hashes_.size());
+        groups_.resize(groups_.size() + entry_len_);
+        char *entry = groups_.data() + group * entry_len_;
+        memcpy(entry, key_buf_.data(), agg_.key_len());
+        agg_.init(entry + agg_.key_len());
+        hashes_.push_back(h);
+        table_[pos] = group;
+        if (hashes_.size() * 2 > table_.size()) grow_table();
+        size_t mem = groups_.size() + hashes_.size() * sizeof(uint64_t) + table_.size() * sizeof(uint32_t);
+        bool fits = mem <= mem_budget_ && mem_.reserve(mem);
+        if (!fits && depth_ < EXEC_HASH_JOIN_MAX_DEPTH) {
+            spills_ = SpillFile::create(EXEC_HASH_JOIN_FANOUT);
+        } else if (!fits) {
+            // 达到最大划分层数的分区通常由少量很大的分组组成，再划分也无法变小，直接在内存中聚合
+            mem_.force(mem);
+        }
+        return group;
+    }
+
+    // 槽位数翻倍并用保存的哈希值重新插入所有分组
+    void grow_table() {
+        table_.assign(table_.size() * 2, NIL);
+        mask_ = table_.size() - 1;
+        for (uint32_t g = 0; g < hashes_.size(); g++) {
+            uint64_t pos = hashes_[g] & mask_;
+            while (table_[pos] != NIL) pos = (pos + 1) & mask_;
+            table_[pos] = g;
+        }
+    }
+
+    // 一遍聚合的输入读完后，把这一遍写出的非空分区加入待聚合的分区
+    void finish_pass() {
+        for (auto &spill : spills_) {
+            if (spill.rows == 0) {
+                spill.remove();
+                continue;
+            }
+            spill.finish();
+            partitions_.push_back({std::move(spill), depth_ + 1});
+        }
+        spills_.clear();
+        out_pos_ = 0;
+    }
+
+    void clear_table() {
+        groups_.clear();
+        hashes_.clear();
+        table_.assign(16, NIL);
+        mask_ = table_.size() - 1;
+        out_pos_ = 0;
+        mem_.release();
+    }
+
+    void clear_spills() {
+        for (auto &spill : spills_) spill.remove();
+        spills_.clear();
+        for (auto &part : partitions_) part.file.remove();
+        partitions_.clear();
+    }
+};
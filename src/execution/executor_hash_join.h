@@ -0,0 +1,399 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "execution_defs.h"
+#include "execution_manager.h"
+#include "executor_abstract.h"
+#include "spill_file.h"
+#include "index/ix.h"
+#include "system/sm.h"
+
+/**
+ * @brief 等值连接的哈希连接算子
+ * 开始时交替读取左右儿子，先读完的一侧（较小的输入）在内存中建立哈希表，另一侧逐批探测；
+ * 两侧都超过内存预算或者语句的内存不足时按连接字段的哈希值把两侧全部写入EXEC_HASH_JOIN_FANOUT对临时文件(grace hash join)，
+ * 之后每次取一对分区，在较小的一侧上建哈希表；分区仍然超过预算时用新的哈希函数再划分一次。
+ * 类型和长度相同的等值条件作为哈希键，全部连接条件都在哈希值相同的元组对上用编译后的谓词检查。
+ * 输出的元组与嵌套循环连接相同，左儿子的字段在前；输出的顺序不确定
+ */
+class HashJoinExecutor : public BatchExecutor {
+   private:
+    /* 一对分区以及产生它们的划分层数，每个分区文件保存一侧输入中哈希到该分区的元组 */
+    struct Partition {
+        SpillFile left;
+        SpillFile right;
+        int depth;
+    };
+
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    std::unique_ptr<AbstractExecutor> left_;    // 左儿子节点
+    std::unique_ptr<AbstractExecutor> right_;   // 右儿子节点
+    size_t len_;                                // join后获得的每条记录的长度
+    std::vector<ColMeta> cols_;                 // join后获得的记录的字段
+    std::vector<Condition> fed_conds_;          // join条件
+    Predicate pred_;                            // 编译后的join条件，左侧字段来自左儿子，右侧字段来自右儿子
+    std::vector<JoinKeyCol> left_keys_;         // 哈希键在左儿子元组中的字段
+    std::vector<JoinKeyCol> right_keys_;        // 哈希键在右儿子元组中的字段
+    size_t mem_budget_;                         // 构建侧在内存中允许占用的字节数
+
+    // 哈希表：构建侧的元组连续存放在build_rows_中，同一个桶内的元组用next_按读入顺序串成链表
+    bool build_left_ = false;                   // 构建侧是否为左儿子
+    std::vector<char> build_rows_;
+    std::vector<uint64_t> build_hashes_;
+    std::vector<uint32_t> next_;
+    std::vector<uint32_t> heads_;
+    uint64_t mask_ = 0;
+
+    // 探测侧：先是建表时已经读入内存的批次，然后是儿子节点剩余的输出或者当前分区的文件
+    std::vector<TupleBatch> probe_buffered_;
+    size_t probe_buffered_pos_ = 0;
+    AbstractExecutor *probe_child_ = nullptr;
+    SpillFile probe_file_;
+    TupleBatch probe_batch_;
+    const TupleBatch *probe_ = nullptr;         // 当前探测的批次
+    MemoryReservation mem_;                     // 哈希表以及建表前读入内存的批次占用的内存
+    size_t probe_pos_ = 0;                      // 当前探测的元组在probe_中的位置
+    bool probing_ = false;                      // 当前探测元组的桶链表是否还没有遍历完
+    uint64_t probe_hash_ = 0;
+    uint32_t chain_ = NIL;                      // 桶链表中下一个要检查的构建侧元组
+
+    std::vector<Partition> partitions_;         // 尚未处理的分区
+    bool end_ = false;
+    std::vector<char> io_buf_;
+
+   public:
+    HashJoinExecutor(std::unique_ptr<AbstractExecutor> left, std::unique_ptr<AbstractExecutor> right,
+                     std::vector<Condition> conds, size_t mem_budget = EXEC_HASH_JOIN_MEM_SIZE) {
+        left_ = std::move(left);
+        right_ = std::move(right);
+        context_ = left_->context_;
+        len_ = left_->tupleLen() + right_->tupleLen();
+        cols_ = left_->cols();
+        auto right_cols = right_->cols();
+        for (auto &col : right_cols) {
+            col.offset += left_->tupleLen();
+        }
+        cols_.insert(cols_.end(), right_cols.begin(), right_cols.end());
+        fed_conds_ = std::move(conds);
+        pred_ = Predicate::compile(fed_conds_, left_->cols(), right_->cols());
+        mem_budget_ = mem_budget;
+        mem_.set_tracker(mem_tracker());
+
+        for (auto &cond : fed_conds_) {
+            if (cond.is_rhs_val || cond.op != OP_EQ) continue;
+            auto lhs = get_col(left_->cols(), cond.lhs_col);
+            auto rhs = get_col(right_->cols(), cond.rhs_col);
+            // 字节形式不同的字段可能比较相等，不能作为哈希键，只在谓词中检查
+            if (lhs->type != rhs->type || lhs->len != rhs->len) continue;
+            left_keys_.push_back({lhs->offset, lhs->len, lhs->type});
+            right_keys_.push_back({rhs->offset, rhs->len, rhs->type});
+        }
+    }
+
+    ~HashJoinExecutor() override { clear_spills(); }
+
+    size_t tupleLen() const override { return len_; }
+
+    const std::vector<ColMeta> &cols() const override { return cols_; }
+
+    std::string getType() override { return "HashJoinExecutor"; }
+
+    ColMeta get_col_offset(const TabCol &target) override {
+        auto it = get_col(cols_, target);
+        return *it;
+    }
+
+    /**
+     * @brief 交替读取左右儿子，直到一侧读完或者两侧都超过内存预算，然后建立哈希表或者把两侧划分到磁盘
+     */
+    void beginBatch() override {
+        reset();
+        left_->beginBatch();
+        right_->beginBatch();
+
+        std::vector<TupleBatch> bufs[2];
+        size_t bytes[2] = {0, 0};
+        bool done[2] = {false, false};
+        AbstractExecutor *children[2] = {left_.get(), right_.get()};
+        while (!done[0] && !done[1] && std::min(bytes[0], bytes[1]) <= mem_budget_ &&
+               mem_.reserve(bytes[0] + bytes[1])) {
+            int side = bytes[0] <= bytes[1] ? 0 : 1;
+            bufs[side].emplace_back();
+            if (children[side]->NextBatch(bufs[side].back())) {
+                bytes[side] += bufs[side].back().size() * children[side]->tupleLen();
+            } else {
+                bufs[side].pop_back();
+                done[side] = true;
+            }
+        }
+
+        if (done[0] || done[1]) {
+            int build = done[0] && (!done[1] || bytes[0] <= bytes[1]) ? 0 : 1;
+            if (bufs[build].empty()) {
+                end_ = true;  // 一侧为空，连接结果必然为空
+                return;
+            }
+            build_left_ = build == 0;
+            mem_.force(bytes[0] + bytes[1]);  // 最后读入的一批没有经过预留
+            size_t tuple_len = children[build]->tupleLen();
+            build_rows_.clear();
+            build_rows_.reserve(bytes[build]);
+            for (auto &batch : bufs[build]) {
+                for (size_t k = 0; k < batch.size(); ++k) {
+                    build_rows_.insert(build_rows_.end(), batch.tuple(k), batch.tuple(k) + tuple_len);
+                }
+            }
+            bufs[build].clear();
+            build_table();
+            probe_buffered_ = std::move(bufs[1 - build]);
+            probe_child_ = done[1 - build] ? nullptr : children[1 - build];
+            push_build_filter();
+            return;
+        }
+
+        // 两侧都超过了内存预算或者语句的内存不足，全部划分到磁盘
+        std::vector<SpillFile> parts[2];
+        for (int side = 0; side < 2; side++) {
+            parts[side] = SpillFile::create(EXEC_HASH_JOIN_FANOUT);
+            for (auto &batch : bufs[side]) {
+                spill_batch(batch, side == 0, 0, parts[side]);
+            }
+            bufs[side].clear();
+            TupleBatch batch;
+            while (children[side]->NextBatch(batch)) {
+                spill_batch(batch, side == 0, 0, parts[side]);
+            }
+        }
+        mem_.release();
+        push_partitions(parts[0], parts[1], 0);
+        if (!next_partition()) end_ = true;
+    }
+
+    /**
+     * @brief 用探测侧的元组逐个查找哈希表，输出满足全部连接条件的元组对；当前分区处理完后继续下一个分区
+     */
+    bool NextBatch(TupleBatch &batch) override {
+        batch.reset(&cols_, len_);
+        size_t left_len = left_->tupleLen();
+        size_t right_len = right_->tupleLen();
+        size_t build_len = build_left_ ? left_len : right_len;
+        while (!batch.full() && !end_) {
+            if (!probing_) {
+                if (probe_ == nullptr || probe_pos_ >= probe_->size()) {
+                    probe_ = next_probe_batch();
+                    probe_pos_ = 0;
+                    if (probe_ == nullptr) {
+                        if (!next_partition()) end_ = true;
+                        build_len = build_left_ ? left_len : right_len;
+                        continue;
+                    }
+                }
+                probe_hash_ = hash_join_key(probe_->tuple(probe_pos_), build_left_ ? right_keys_ : left_keys_);
+                chain_ = heads_[probe_hash_ & mask_];
+                probing_ = true;
+            }
+            const char *ptup = probe_->tuple(probe_pos_);
+            for (; chain_ != NIL && !batch.full(); chain_ = next_[chain_]) {
+                if (build_hashes_[chain_] != probe_hash_) continue;
+                const char *btup = build_rows_.data() + static_cast<size_t>(chain_) * build_len;
+                const char *lrec = build_left_ ? btup : ptup;
+                const char *rrec = build_left_ ? ptup : btup;
+                if (!pred_.eval(lrec, rrec)) continue;
+                char *out = batch.append();
+                memcpy(out, lrec, left_len);
+                memcpy(out + left_len, rrec, right_len);
+            }
+            if (chain_ == NIL) {
+                probing_ = false;
+                probe_pos_++;
+            }
+        }
+        return !batch.empty();
+    }
+
+    /**
+     * @brief 过滤器的哈希键都来自同一个儿子时转发给这个儿子：内连接的输出元组必然由两侧各一条元组拼成，
+     * 在某一侧提前排除哈希键不在过滤器构建侧中的元组，连接结果中也只少了上层连接会排除的元组
+     */
+    bool push_runtime_filter(const std::shared_ptr<const RuntimeFilter> &filter,
+                             const std::vector<JoinKeyCol> &keys) override {
+        int left_len = static_cast<int>(left_->tupleLen());
+        bool all_left = true;
+        bool all_right = true;
+        std::vector<JoinKeyCol> right_keys = keys;
+        for (auto &key : right_keys) {
+            all_left = all_left && key.offset + key.len <= left_len;
+            all_right = all_right && key.offset >= left_len;
+            key.offset -= left_len;
+        }
+        if (all_left) return left_->push_runtime_filter(filter, keys);
+        if (all_right) return right_->push_runtime_filter(filter, right_keys);
+        return false;
+    }
+
+   private:
+    /**
+     * @brief 在内存中建好哈希表、探测侧还有没有读入的元组时，用构建侧的哈希值构造运行时过滤器下推到探测侧。
+     * 构建侧太大时过滤器占用的内存多、排除的元组少，不再构造
+     */
+    void push_build_filter() {
+        if (probe_child_ == nullptr || left_keys_.empty() || build_hashes_.size() > EXEC_RUNTIME_FILTER_MAX_ROWS) {
+            return;
+        }
+        auto filter = std::make_shared<RuntimeFilter>(build_hashes_.size());
+        for (uint64_t h : build_hashes_) {
+            filter->add(h);
+        }
+        probe_child_->push_runtime_filter(filter, build_left_ ? right_keys_ : left_keys_);
+    }
+
+    // 清除上一次执行的哈希表、探测状态和临时文件
+    void reset() {
+        clear_spills();
+        build_rows_.clear();
+        build_hashes_.clear();
+        next_.clear();
+        heads_.clear();
+        probe_buffered_.clear();
+        probe_buffered_pos_ = 0;
+        probe_child_ = nullptr;
+        probe_ = nullptr;
+        probe_pos_ = 0;
+        probing_ = false;
+        end_ = false;
+        mem_.release();
+    }
+
+    // 在build_rows_上建立哈希表，桶的个数为不小于元组个数的2的幂次；链表从后往前插入，遍历时按读入顺序
+    void build_table() {
+        size_t tuple_len = build_left_ ? left_->tupleLen() : right_->tupleLen();
+        const auto &keys = build_left_ ? left_keys_ : right_keys_;
+        size_t num_rows = build_rows_.size() / tuple_len;
+        size_t num_buckets = 1;
+        while (num_buckets < num_rows) num_buckets <<= 1;
+        mask_ = num_buckets - 1;
+        heads_.assign(num_buckets, NIL);
+        next_.resize(num_rows);
+        build_hashes_.resize(num_rows);
+        for (size_t i = num_rows; i-- > 0;) {
+            uint64_t h = hash_join_key(build_rows_.data() + i * tuple_len, keys);
+            build_hashes_[i] = h;
+            next_[i] = heads_[h & mask_];
+            heads_[h & mask_] = static_cast<uint32_t>(i);
+        }
+    }
+
+    // 探测侧的下一批元组，探测侧读完时返回nullptr
+    const TupleBatch *next_probe_batch() {
+        if (probe_buffered_pos_ < probe_buffered_.size()) {
+            return &probe_buffered_[probe_buffered_pos_++];
+        }
+        probe_buffered_.clear();
+        probe_buffered_pos_ = 0;
+        if (probe_child_ != nullptr) {
+            if (probe_child_->NextBatch(probe_batch_)) return &probe_batch_;
+            probe_child_ = nullptr;
+        }
+        if (probe_file_.file != nullptr) {
+            AbstractExecutor *child = build_left_ ? right_.get() : left_.get();
+            if (probe_file_.read(&child->cols(), child->tupleLen(), probe_batch_, io_buf_)) return &probe_batch_;
+            probe_file_.remove();
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief 取下一对分区，在较小的一侧上建立哈希表，另一侧作为探测侧；较小的一侧仍然超过预算时再划分一次
+     *
+     * @return 没有剩余的分区时返回false
+     */
+    bool next_partition() {
+        build_rows_.clear();
+        mem_.release();
+        while (!partitions_.empty()) {
+            Partition part = std::move(partitions_.back());
+            partitions_.pop_back();
+            if (part.left.rows == 0 || part.right.rows == 0) {
+                part.left.remove();
+                part.right.remove();
+                continue;
+            }
+            size_t left_bytes = part.left.rows * left_->tupleLen();
+            size_t right_bytes = part.right.rows * right_->tupleLen();
+            bool build_left = left_bytes <= right_bytes;
+            size_t build_bytes = std::min(left_bytes, right_bytes);
+            bool fits = build_bytes <= mem_budget_ && mem_.reserve(build_bytes);
+            if (!fits && part.depth + 1 < EXEC_HASH_JOIN_MAX_DEPTH) {
+                repartition(part);
+                continue;
+            }
+            // 达到最大划分层数的分区通常由大量相同的键组成，再划分也无法变小，直接在内存中建表
+            mem_.force(build_bytes);
+            build_left_ = build_left;
+            SpillFile &build = build_left ? part.left : part.right;
+            size_t tuple_len = build_left ? left_->tupleLen() : right_->tupleLen();
+            build_rows_.resize(build.rows * tuple_len);
+            build.read_all(build_rows_.data(), tuple_len);
+            build.remove();
+            build_table();
+            probe_file_ = std::move(build_left ? part.right : part.left);
+            probe_file_.rewind();
+            return true;
+        }
+        return false;
+    }
+
+    // 用下一层的哈希函数把一对分区重新划分成EXEC_HASH_JOIN_FANOUT对
+    void repartition(Partition &part) {
+        std::vector<SpillFile> parts[2];
+        SpillFile *files[2] = {&part.left, &part.right};
+        AbstractExecutor *children[2] = {left_.get(), right_.get()};
+        for (int side = 0; side < 2; side++) {
+            parts[side] = SpillFile::create(EXEC_HASH_JOIN_FANOUT);
+            files[side]->rewind();
+            TupleBatch batch;
+            while (files[side]->read(&children[side]->cols(), children[side]->tupleLen(), batch, io_buf_)) {
+                spill_batch(batch, side == 0, part.depth + 1, parts[side]);
+            }
+            files[side]->remove();
+        }
+        push_partitions(parts[0], parts[1], part.depth + 1);
+    }
+
+    void push_partitions(std::vector<SpillFile> &left, std::vector<SpillFile> &right, int depth) {
+        for (size_t i = 0; i < left.size(); i++) {
+            left[i].finish();
+            right[i].finish();
+            partitions_.push_back({std::move(left[i]), std::move(right[i]), depth});
+        }
+    }
+
+    // 按第depth层的分区函数把批次中的元组追加到对应的临时文件
+    void spill_batch(const TupleBatch &batch, bool is_left, int depth, std::vector<SpillFile> &parts) {
+        size_t tuple_len = is_left ? left_->tupleLen() : right_->tupleLen();
+        const auto &keys = is_left ? left_keys_ : right_keys_;
+        for (size_t k = 0; k < batch.size(); ++k) {
+            size_t part = spill_partition_of(hash_join_key(batch.tuple(k), keys), depth, EXEC_HASH_JOIN_FANOUT);
+            parts[part].write(batch.tuple(k), tuple_len);
+        }
+    }
+
+    void clear_spills() {
+        for (auto &part : partitions_) {
+            part.left.remove();
+            part.right.remove();
+        }
+        partitions_.clear();
+        probe_file_.remove();
+    }
+};
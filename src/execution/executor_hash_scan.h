@@ -0,0 +1,79 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "executor_index_scan.h"
+
+/**
+ * @brief 哈希索引和LSM索引上的等值扫描：所有索引列都有等值条件时，按拼接出的key一次取出全部rid，
+ * 再逐个读取记录并检查其余条件。这两种索引都没有顺序，输出按rid在索引中的存放顺序排列
+ */
+class HashScanExecutor : public IndexScanExecutor {
+   private:
+    std::vector<Rid> rids_;     // 索引中与key相等的全部rid
+    size_t pos_ = 0;            // 当前rid在rids_中的位置
+
+   public:
+    HashScanExecutor(SmManager *sm_manager, std::string tab_name, std::vector<Condition> conds,
+                     std::vector<std::string> index_col_names, Context *context)
+        : IndexScanExecutor(sm_manager, std::move(tab_name), std::move(conds), std::move(index_col_names), context) {}
+
+    bool is_end() const override { return snapshot_ ? IndexScanExecutor::is_end() : pos_ >= rids_.size(); }
+
+    void beginTuple() override {
+        lock_scan_predicate(fh_, row_pred_);
+        auto hh = sm_manager_->get_point_index_handle(tab_name_, index_meta_);
+
+        std::unique_ptr<char[]> key(new char[index_meta_.col_tot_len]);
+        int offset = 0;
+        for (auto &col : index_meta_.cols) {
+            auto cond = std::find_if(fed_conds_.begin(), fed_conds_.end(), [&](const Condition &c) {
+                return c.is_rhs_val && c.op == OP_EQ && c.lhs_col.tab_name == tab_name_ && c.lhs_col.col_name == col.name;
+            });
+            if (cond == fed_conds_.end()) {
+                throw InternalError("Hash scan requires an equality condition on every index column");
+            }
+            memcpy(key.get() + offset, cond->rhs_val.raw->data, col.len);
+            offset += col.len;
+        }
+        rids_.clear();
+        hh->get_value(key.get(), &rids_, context_ != nullptr ? context_->txn_ : nullptr);
+        pos_ = 0;
+        snapshot_ = false;
+        if (snapshot_read()) {
+            load_snapshot(rids_, false);
+            return;
+        }
+        seek();
+    }
+
+    void nextTuple() override {
+        if (is_end()) return;
+        if (snapshot_) {
+            IndexScanExecutor::nextTuple();
+            return;
+        }
+        pos_++;
+        seek();
+    }
+
+   private:
+    // 从pos_开始找到第一条满足所有条件的记录
+    void seek() {
+        for (; pos_ < rids_.size(); pos_++) {
+            RecordView rec = fh_->get_record_view(rids_[pos_], context_);
+            if (rec.is_valid() && pred_.eval(rec.data())) {
+                rid_ = rids_[pos_];
+                return;
+            }
+        }
+    }
+};
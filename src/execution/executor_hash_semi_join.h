@@ -0,0 +1,185 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "execution_defs.h"
+#include "execution_manager.h"
+#include "executor_abstract.h"
+#include "index/ix.h"
+#include "system/sm.h"
+
+/**
+ * @brief 不相关子查询的哈希半连接和反连接算子
+ * 开始时读完右儿子（子查询），在内存中按连接条件的哈希键建立哈希表；之后逐批读取左儿子，
+ * 只保留在哈希表中有(半连接)或没有(反连接)满足全部条件的元组。输出左儿子的元组，保持左儿子的顺序，
+ * 只修改左儿子批次的选择向量，不复制元组。没有条件时(EXISTS)只读取右儿子的第一批元组，结果对所有左侧元组相同
+ */
+class HashSemiJoinExecutor : public BatchExecutor {
+   private:
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    std::unique_ptr<AbstractExecutor> left_;    // 左儿子节点（外层查询）
+    std::unique_ptr<AbstractExecutor> right_;   // 右儿子节点（子查询）
+    bool anti_;                                 // 是否为反连接
+    std::vector<Condition> fed_conds_;          // 连接条件，左侧字段来自左儿子，右侧字段来自右儿子
+    Predicate pred_;                            // 编译后的连接条件
+    std::vector<JoinKeyCol> left_keys_;         // 哈希键在左儿子元组中的字段
+    std::vector<JoinKeyCol> right_keys_;        // 哈希键在右儿子元组中的字段
+
+    // 哈希表：右儿子的元组连续存放在build_rows_中，同一个桶内的元组用next_串成链表
+    std::vector<char> build_rows_;
+    std::vector<uint64_t> build_hashes_;
+    std::vector<uint32_t> next_;
+    std::vector<uint32_t> heads_;
+    uint64_t mask_ = 0;
+
+    bool pass_all_ = false;                     // 结果与左侧元组无关，左儿子的元组全部输出
+    bool end_ = true;
+
+   public:
+    HashSemiJoinExecutor(std::unique_ptr<AbstractExecutor> left, std::unique_ptr<AbstractExecutor> right,
+                         std::vector<Condition> conds, bool anti) {
+        left_ = std::move(left);
+        right_ = std::move(right);
+        context_ = left_->context_;
+        anti_ = anti;
+        fed_conds_ = std::move(conds);
+        pred_ = Predicate::compile(fed_conds_, left_->cols(), right_->cols());
+        for (auto &cond : fed_conds_) {
+            if (cond.is_rhs_val || cond.op != OP_EQ) continue;
+            auto lhs = get_col(left_->cols(), cond.lhs_col);
+            auto rhs = get_col(right_->cols(), cond.rhs_col);
+            // 字节形式不同的字段可能比较相等，不能作为哈希键，只在谓词中检查
+            if (lhs->type != rhs->type || lhs->len != rhs->len) continue;
+            left_keys_.push_back({lhs->offset, lhs->len, lhs->type});
+            right_keys_.push_back({rhs->offset, rhs->len, rhs->type});
+        }
+    }
+
+    size_t tupleLen() const override { return left_->tupleLen(); }
+
+    const std::vector<ColMeta> &cols() const override { return left_->cols(); }
+
+    std::string getType() override { return anti_ ? "HashAntiJoinExecutor" : "HashSemiJoinExecutor"; }
+
+    ColMeta get_col_offset(const TabCol &target) override { return *get_col(cols(), target); }
+
+    /**
+     * @brief 读完子查询并建立哈希表，子查询的结果已经决定了全部输出时不再读取左儿子
+     */
+    void beginBatch() override {
+        build_rows_.clear();
+        pass_all_ = false;
+        end_ = false;
+        right_->beginBatch();
+        TupleBatch batch;
+        if (fed_conds_.empty()) {
+            // EXISTS有结果时输出全部左侧元组，否则没有输出；NOT EXISTS相反
+            pass_all_ = right_->NextBatch(batch) != anti_;
+            end_ = !pass_all_;
+        } else {
+            while (right_->NextBatch(batch)) {
+                for (size_t k = 0; k < batch.size(); k++) {
+                    build_rows_.insert(build_rows_.end(), batch.tuple(k), batch.tuple(k) + right_->tupleLen());
+                }
+            }
+            // 子查询没有结果时，半连接没有输出，反连接输出全部左侧元组
+            if (build_rows_.empty()) {
+                pass_all_ = anti_;
+                end_ = !anti_;
+            } else {
+                build_table();
+            }
+        }
+        if (!end_) {
+            left_->beginBatch();
+            push_build_filter();
+        }
+    }
+
+    bool NextBatch(TupleBatch &batch) override {
+        batch.reset(&left_->cols(), left_->tupleLen());
+        while (!end_) {
+            if (!left_->NextBatch(batch)) {
+                end_ = true;
+                break;
+            }
+            if (pass_all_) return true;
+            auto &sel = batch.sel();
+            size_t num_kept = 0;
+            for (size_t k = 0; k < sel.size(); k++) {
+                if (has_match(batch.tuple(k)) != anti_) sel[num_kept++] = sel[k];
+            }
+            sel.resize(num_kept);
+            if (!batch.empty()) return true;
+        }
+        return false;
+    }
+
+   private:
+    /* 半连接只输出哈希键在子查询结果中的左侧元组，用子查询结果的哈希值构造运行时过滤器下推到左儿子 */
+    void push_build_filter() {
+        if (anti_ || pass_all_ || left_keys_.empty() || build_hashes_.size() > EXEC_RUNTIME_FILTER_MAX_ROWS) {
+            return;
+        }
+        auto filter = std::make_shared<RuntimeFilter>(build_hashes_.size());
+        for (uint64_t h : build_hashes_) {
+            filter->add(h);
+        }
+        left_->push_runtime_filter(filter, left_keys_);
+    }
+
+    // 两个右侧元组的哈希键字节相同
+    bool same_keys(const char *a, const char *b) const {
+        for (auto &key : right_keys_) {
+            if (memcmp(a + key.offset, b + key.offset, key.len) != 0) return false;
+        }
+        return true;
+    }
+
+    // 在build_rows_上建立哈希表；全部条件都是哈希键时，哈希键相同的元组匹配的左侧元组也相同，只保留第一个
+    void build_table() {
+        size_t tuple_len = right_->tupleLen();
+        bool dedup = right_keys_.size() == fed_conds_.size();
+        size_t num_rows = build_rows_.size() / tuple_len;
+        size_t num_buckets = 1;
+        while (num_buckets < num_rows) num_buckets <<= 1;
+        mask_ = num_buckets - 1;
+        heads_.assign(num_buckets, NIL);
+        next_.clear();
+        build_hashes_.clear();
+        size_t num_kept = 0;
+        for (size_t i = 0; i < num_rows; i++) {
+            const char *rec = build_rows_.data() + i * tuple_len;
+            uint64_t h = hash_join_key(rec, right_keys_);
+            bool duplicate = false;
+            for (uint32_t j = heads_[h & mask_]; dedup && j != NIL && !duplicate; j = next_[j]) {
+                duplicate = build_hashes_[j] == h && same_keys(build_rows_.data() + j * tuple_len, rec);
+            }
+            if (duplicate) continue;
+            memmove(build_rows_.data() + num_kept * tuple_len, rec, tuple_len);
+            build_hashes_.push_back(h);
+            next_.push_back(heads_[h & mask_]);
+            heads_[h & mask_] = static_cast<uint32_t>(num_kept++);
+        }
+        build_rows_.resize(num_kept * tuple_len);
+    }
+
+    // 哈希表中是否有与左侧元组rec满足全部条件的元组
+    bool has_match(const char *rec) const {
+        size_t tuple_len = right_->tupleLen();
+        uint64_t h = hash_join_key(rec, left_keys_);
+        for (uint32_t j = heads_[h & mask_]; j != NIL; j = next_[j]) {
+            if (build_hashes_[j] == h && pred_.eval(rec, build_rows_.data() + j * tuple_len)) return true;
+        }
+        return false;
+    }
+};
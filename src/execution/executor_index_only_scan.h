@@ -0,0 +1,95 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "executor_index_scan.h"
+
+/**
+ * @brief 只读索引的扫描：查询用到的字段都在索引中时，直接用叶子结点中的key构造元组，不再按rid回表读取记录
+ * 输出的元组只包含索引字段，按索引中的顺序紧凑排列；扫描范围和加锁方式与IndexScanExecutor相同
+ */
+class IndexOnlyScanExecutor : public IndexScanExecutor {
+   private:
+    std::vector<char> key_buf_;  // 当前键值对的key，也就是当前输出的元组
+
+   public:
+    IndexOnlyScanExecutor(SmManager *sm_manager, std::string tab_name, std::vector<Condition> conds,
+                          std::vector<std::string> index_col_names, Context *context)
+        : IndexScanExecutor(sm_manager, std::move(tab_name), std::move(conds), std::move(index_col_names), context) {
+        cols_.clear();
+        size_t offset = 0;
+        for (auto col : index_meta_.cols) {
+            col.offset = offset;
+            offset += col.len;
+            cols_.push_back(col);
+        }
+        len_ = offset;
+        key_buf_.resize(len_);
+        // 条件只涉及索引字段，按key中的字段偏移量重新编译
+        pred_ = Predicate::compile(fed_conds_, cols_);
+    }
+
+    void beginTuple() override {
+        if (snapshot_read()) {
+            // 快照中的键可能已不在索引中，按快照读取完整的记录再从中取出索引字段
+            IndexScanExecutor::beginTuple();
+            project();
+            return;
+        }
+        snapshot_ = false;
+        scan_ = open_scan();
+        seek();
+    }
+
+    void nextTuple() override {
+        if (is_end()) return;
+        if (snapshot_) {
+            IndexScanExecutor::nextTuple();
+            project();
+            return;
+        }
+        scan_->next();
+        seek();
+    }
+
+    std::unique_ptr<RmRecord> Next() override {
+        if (is_end()) return nullptr;
+        auto out = make_tuple(len_);
+        memcpy(out->data, key_buf_.data(), len_);
+        return out;
+    }
+
+    RecordView view() override {
+        if (is_end()) return RecordView();
+        return RecordView(key_buf_.data(), static_cast<int>(len_));
+    }
+
+   private:
+    // 按快照读取时从当前记录中取出索引字段
+    void project() {
+        if (is_end()) return;
+        const char *rec = snapshot_rows_[snapshot_pos_].data_.data();
+        for (size_t i = 0; i < cols_.size(); i++) {
+            memcpy(key_buf_.data() + cols_[i].offset, rec + index_meta_.cols[i].offset, cols_[i].len);
+        }
+    }
+
+    // 跳过不满足扫描条件的键值对，条件只涉及索引字段，直接在key上判断
+    void seek() {
+        for (; !scan_->is_end(); scan_->next()) {
+            scan_->key(key_buf_.data());
+            if (pred_.eval(key_buf_.data())) {
+                rid_ = scan_->rid();
+                return;
+            }
+        }
+    }
+};
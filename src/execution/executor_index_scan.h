@@ -10,6 +10,9 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <algorithm>
+#include <limits>
+
 #include "execution_defs.h"
 #include "execution_manager.h"
 #include "executor_abstract.h"
@@ -17,7 +20,7 @@ See the Mulan PSL v2 for more details. */
 #include "system/sm.h"
 
 class IndexScanExecutor : public AbstractExecutor {
-   private:
+   protected:
     std::string tab_name_;                      // 表名称
     TabMeta tab_;                               // 表的元数据
     std::vector<Condition> conds_;              // 扫描条件
@@ -25,12 +28,18 @@ class IndexScanExecutor : public AbstractExecutor {
     std::vector<ColMeta> cols_;                 // 需要读取的字段
     size_t len_;                                // 选取出来的一条记录的长度
     std::vector<Condition> fed_conds_;          // 扫描条件，和conds_字段相同
+    Predicate pred_;                            // 编译后的fed_conds_
+    Predicate row_pred_;                        // 按表的记录编译的fed_conds_，用于谓词锁和快照读
 
     std::vector<std::string> index_col_names_;  // index scan涉及到的索引包含的字段
     IndexMeta index_meta_;                      // index scan涉及到的索引元数据
 
     Rid rid_;
-    std::unique_ptr<RecScan> scan_;
+    std::unique_ptr<IxScan> scan_;
+
+    bool snapshot_ = false;                     // 本次扫描是否按快照读取
+    std::vector<RmSnapshotRecord> snapshot_rows_;   // 按快照读取时物化的扫描结果
+    size_t snapshot_pos_ = 0;                   // 当前记录在snapshot_rows_中的位置
 
     SmManager *sm_manager_;
 
@@ -45,7 +54,7 @@ class IndexScanExecutor : public AbstractExecutor {
         // index_no_ = index_no;
         index_col_names_ = index_col_names; 
         index_meta_ = *(tab_.get_index_meta(index_col_names_));
-        fh_ = sm_manager_->fhs_.at(tab_name_).get();
+        fh_ = sm_manager_->get_table_handle(tab_name_);
         cols_ = tab_.cols;
         len_ = cols_.back().offset + cols_.back().len;
         std::map<CompOp, CompOp> swap_op = {
@@ -62,13 +71,18 @@ class IndexScanExecutor : public AbstractExecutor {
             }
         }
         fed_conds_ = conds_;
+        pred_ = Predicate::compile(fed_conds_, cols_);
+        row_pred_ = pred_;
     }
 
     size_t tupleLen() const override { return len_; }
 
     const std::vector<ColMeta> &cols() const override { return cols_; }
 
-    bool is_end() const override { return scan_ == nullptr || scan_->is_end(); }
+    bool is_end() const override {
+        if (snapshot_) return snapshot_pos_ >= snapshot_rows_.size();
+        return scan_ == nullptr || scan_->is_end();
+    }
 
     ColMeta get_col_offset(const TabCol &target) override {
         auto it = get_col(cols_, target);
@@ -76,85 +90,23 @@ class IndexScanExecutor : public AbstractExecutor {
     }
 
     void beginTuple() override {
-        // ========== 并发控制：防止幻读（保守版：表级 S 锁）==========
-        // 即便是索引扫描，本质上仍是“扫描表的一段范围”，同样可能出现幻读（别的事务插入新记录）。
-        // 这里采取最简单的办法：扫描前对表加 S 锁。
-        if (context_ != nullptr && context_->txn_ != nullptr && context_->lock_mgr_ != nullptr) {
-            context_->lock_mgr_->lock_shared_on_table(context_->txn_, fh_->GetFd());
-        }
-
-        // 1. 获取索引句柄体体。通过 sm_manager 查找预先打开的 B+ 树句柄体体。
-        auto ih = sm_manager_->ihs_.at(sm_manager_->get_ix_manager()->get_index_name(tab_name_, index_col_names_)).get();
-        
-        // 2. 尝试构建等值查询的 Key 体体。
-        // 对于复合索引（多个列），我们需要把各个列的等值常量拼接成一个完整的字节串体体。
-        std::unique_ptr<char[]> key(new char[index_meta_.col_tot_len]);
-        int offset = 0;
-        bool full_match = true;
-        for (size_t i = 0; i < index_meta_.cols.size(); ++i) {
-            const auto &col = index_meta_.cols[i];
-            bool found = false;
-            // 在 WHERE 条件中寻找匹配该列的等值谓词体体
-            for (auto &cond : fed_conds_) {
-                if (cond.is_rhs_val && cond.op == OP_EQ && cond.lhs_col.tab_name == tab_name_ &&
-                    cond.lhs_col.col_name == col.name) {
-                    memcpy(key.get() + offset, cond.rhs_val.raw->data, col.len);
-                    found = true;
-                    break;
-                }
-            }
-            if (!found) {
-                // 如果索引中的某一列没有等值条件，我们无法使用 B+ 树范围查询体体。
-                // 此时退化为全索引扫描（即遍历整个 B+ 树的叶子节点链表）体体。
-                scan_ = std::make_unique<IxScan>(ih, ih->leaf_begin(), ih->leaf_end(), sm_manager_->get_bpm());
-                full_match = false;
-                break;
+        if (snapshot_read()) {
+            std::vector<Rid> rids;
+            for (auto scan = open_scan(); !scan->is_end(); scan->next()) {
+                rids.push_back(scan->rid());
             }
-            offset += col.len;
+            load_snapshot(rids, true);
+            return;
         }
+        snapshot_ = false;
+        scan_ = open_scan();
 
-        // 3. 执行 B+ 树查找体体。
-        // 如果所有索引列都有等值条件，使用 lower_bound 和 upper_bound 确定扫描范围体体。
-        if (full_match) {
-            auto lower = ih->lower_bound(key.get());
-            auto upper = ih->upper_bound(key.get());
-            scan_ = std::make_unique<IxScan>(ih, lower, upper, sm_manager_->get_bpm());
-        }
-
-        // 4. 定义谓词过滤逻辑体体。
-        // 注意：即便索引返回了 rid，我们仍需通过 satisfy 检查那些没被索引覆盖的条件体体。
-        auto satisfy = [&](const Rid &rid) -> bool {
-            auto rec = fh_->get_record(rid, context_);
-            for (auto &cond : fed_conds_) {
-                auto lhs_it = get_col(cols_, cond.lhs_col);
-                char *lhs_ptr = rec->data + lhs_it->offset;
-                char *rhs_ptr = cond.is_rhs_val ? cond.rhs_val.raw->data : (rec->data + get_col(cols_, cond.rhs_col)->offset);
-                int cmp = 0;
-                if (lhs_it->type == TYPE_INT) {
-                    int a = *(int *)lhs_ptr, b = *(int *)rhs_ptr;
-                    cmp = (a < b) ? -1 : ((a > b) ? 1 : 0);
-                } else if (lhs_it->type == TYPE_FLOAT) {
-                    float a = *(float *)lhs_ptr, b = *(float *)rhs_ptr;
-                    cmp = (a < b) ? -1 : ((a > b) ? 1 : 0);
-                } else {
-                    cmp = memcmp(lhs_ptr, rhs_ptr, lhs_it->len);
-                }
-                switch (cond.op) {
-                    case OP_EQ: if (cmp != 0) return false; break;
-                    case OP_NE: if (cmp == 0) return false; break;
-                    case OP_LT: if (!(cmp < 0)) return false; break;
-                    case OP_GT: if (!(cmp > 0)) return false; break;
-                    case OP_LE: if (!(cmp <= 0)) return false; break;
-                    case OP_GE: if (!(cmp >= 0)) return false; break;
-                }
-            }
-            return true;
-        };
-
-        // 5. 移动到扫描范围内的第一个符合所有条件的记录体体
+        // 移动到扫描范围内的第一个符合所有条件的记录体体
+        // 注意：即便索引返回了 rid，我们仍需通过 pred_ 检查那些没被索引覆盖的条件体体。
         for (; !scan_->is_end(); scan_->next()) {
             Rid r = scan_->rid();
-            if (fh_->is_record(r) && satisfy(r)) {
+            RecordView rec = fh_->get_record_view(r, context_);
+            if (rec.is_valid() && pred_.eval(rec.data())) {
                 rid_ = r;
                 break;
             }
@@ -163,40 +115,16 @@ class IndexScanExecutor : public AbstractExecutor {
 
     void nextTuple() override {
         if (is_end()) return;
-
-        // 复用过滤逻辑体体
-        auto satisfy = [&](const Rid &rid) -> bool {
-            auto rec = fh_->get_record(rid, context_);
-            for (auto &cond : fed_conds_) {
-                auto lhs_it = get_col(cols_, cond.lhs_col);
-                char *lhs_ptr = rec->data + lhs_it->offset;
-                char *rhs_ptr = cond.is_rhs_val ? cond.rhs_val.raw->data : (rec->data + get_col(cols_, cond.rhs_col)->offset);
-                int cmp = 0;
-                if (lhs_it->type == TYPE_INT) {
-                    int a = *(int *)lhs_ptr, b = *(int *)rhs_ptr;
-                    cmp = (a < b) ? -1 : ((a > b) ? 1 : 0);
-                } else if (lhs_it->type == TYPE_FLOAT) {
-                    float a = *(float *)lhs_ptr, b = *(float *)rhs_ptr;
-                    cmp = (a < b) ? -1 : ((a > b) ? 1 : 0);
-                } else {
-                    cmp = memcmp(lhs_ptr, rhs_ptr, lhs_it->len);
-                }
-                switch (cond.op) {
-                    case OP_EQ: if (cmp != 0) return false; break;
-                    case OP_NE: if (cmp == 0) return false; break;
-                    case OP_LT: if (!(cmp < 0)) return false; break;
-                    case OP_GT: if (!(cmp > 0)) return false; break;
-                    case OP_LE: if (!(cmp <= 0)) return false; break;
-                    case OP_GE: if (!(cmp >= 0)) return false; break;
-                }
-            }
-            return true;
-        };
+        if (snapshot_) {
+            if (++snapshot_pos_ < snapshot_rows_.size()) rid_ = snapshot_rows_[snapshot_pos_].rid_;
+            return;
+        }
 
         // 在当前索引扫描范围内继续步进体体
         for (scan_->next(); !scan_->is_end(); scan_->next()) {
             Rid r = scan_->rid();
-            if (fh_->is_record(r) && satisfy(r)) {
+            RecordView rec = fh_->get_record_view(r, context_);
+            if (rec.is_valid() && pred_.eval(rec.data())) {
                 rid_ = r;
                 return;
             }
@@ -206,9 +134,174 @@ class IndexScanExecutor : public AbstractExecutor {
     std::unique_ptr<RmRecord> Next() override {
         // 如果 B+ 树扫描器结束，则返回空体体
         if (is_end()) return nullptr;
-        // 否则返回当前 rid 指向的真实数据记录体体
-        return fh_->get_record(rid_, context_);
+        if (snapshot_) {
+            auto out = make_tuple(len_);
+            memcpy(out->data, snapshot_rows_[snapshot_pos_].data_.data(), len_);
+            return out;
+        }
+        // 否则把当前 rid 指向的记录复制到请求的arena中体体
+        RecordView rec = fh_->get_record_view(rid_, context_);
+        if (!rec.is_valid()) {
+            throw RecordNotFoundError(rid_.page_no, rid_.slot_no);
+        }
+        auto out = make_tuple(len_);
+        memcpy(out->data, rec.data(), len_);
+        return out;
+    }
+
+    // 返回当前 rid 指向记录在页面中的只读视图，不复制记录数据体体
+    RecordView view() override {
+        if (is_end()) return RecordView();
+        if (snapshot_) return RecordView(snapshot_rows_[snapshot_pos_].data_.data(), static_cast<int>(len_));
+        return fh_->get_record_view(rid_, context_);
     }
 
     Rid &rid() override { return rid_; }
+
+   protected:
+    /**
+     * @brief 按快照读取索引给出的记录，不加锁。索引反映的是最新的记录：
+     * 快照中的记录就是页面上的记录的直接使用，其余的（扫描开始之后被修改过、或者快照中的键已不在索引中的）从版本链中取出，
+     * 再按扫描条件过滤。版本链中取出的记录加入后按索引键重新排序，保持索引扫描的输出顺序
+     *
+     * @param rids 索引给出的记录号
+     * @param ordered 输出是否需要按索引键排序
+     */
+    void load_snapshot(const std::vector<Rid> &rids, bool ordered) {
+        snapshot_ = true;
+        snapshot_rows_.clear();
+        snapshot_pos_ = 0;
+        ReadView view = context_->txn_->get_read_view();
+        const RmVersionStore &versions = fh_->get_versions();
+        uint64_t pushes = versions.pushes();
+        for (auto &r : rids) {
+            RmSnapshotRecord rec{r, true, std::string()};
+            if (fh_->read_snapshot_record(r, view, &rec.data_) == RmVersionStore::Visibility::CURRENT &&
+                row_pred_.eval(rec.data_.data())) {
+                snapshot_rows_.push_back(std::move(rec));
+            }
+        }
+
+        std::vector<RmSnapshotRecord> changed;
+        versions.collect(view, &changed);
+        if (!changed.empty()) {
+            // 读取期间有新的修改时，已经按页面上的记录输出的记录可能也在changed中
+            std::vector<Rid> seen;
+            if (versions.pushes() != pushes) {
+                for (auto &rec : snapshot_rows_) seen.push_back(rec.rid_);
+                std::sort(seen.begin(), seen.end());
+            }
+            size_t from_index = snapshot_rows_.size();
+            for (auto &rec : changed) {
+                if (rec.exists_ && row_pred_.eval(rec.data_.data()) &&
+                    !std::binary_search(seen.begin(), seen.end(), rec.rid_)) {
+                    snapshot_rows_.push_back(std::move(rec));
+                }
+            }
+            if (ordered && snapshot_rows_.size() > from_index) {
+                std::stable_sort(snapshot_rows_.begin(), snapshot_rows_.end(),
+                                 [&](const RmSnapshotRecord &a, const RmSnapshotRecord &b) {
+                                     for (auto &col : index_meta_.cols) {
+                                         int cmp = compare_value(col.type, col.len, a.data_.data() + col.offset,
+                                                                 b.data_.data() + col.offset);
+                                         if (cmp != 0) return cmp < 0;
+                                     }
+                                     return false;
+                                 });
+            }
+        }
+        if (!snapshot_rows_.empty()) rid_ = snapshot_rows_.front().rid_;
+    }
+
+    // 加谓词锁，并按扫描条件确定索引的扫描范围体体
+    std::unique_ptr<IxScan> open_scan() {
+        // ========== 并发控制：防止幻读（谓词锁）==========
+        // 即便是索引扫描，本质上仍是“扫描表的一段范围”，同样可能出现幻读（别的事务插入新记录）。
+        // 扫描条件包含确定索引范围的条件，登记后相当于锁住了索引上的这段键范围：
+        // 其他事务在范围内插入、删除或修改记录时冲突，范围之外的写入不受影响。
+        lock_scan_predicate(fh_, row_pred_);
+
+        // 1. 获取索引句柄体体。通过 sm_manager 查找预先打开的 B+ 树句柄体体。
+        auto ih = sm_manager_->get_index_handle(tab_name_, index_meta_);
+
+        // 2. 按索引最左边若干个字段上的等值条件，以及紧接着的一个字段上的范围条件确定扫描范围。
+        // 对于复合索引（多个列），我们需要把各个列的常量拼接成一个完整的字节串，范围字段之后的字段
+        // 在下界中填该类型的最小值、在上界中填最大值。
+        std::unique_ptr<char[]> lower_key(new char[index_meta_.col_tot_len]);
+        std::unique_ptr<char[]> upper_key(new char[index_meta_.col_tot_len]);
+        int offset = 0;
+        size_t prefix = 0;
+        for (; prefix < index_meta_.cols.size(); ++prefix) {
+            const auto &col = index_meta_.cols[prefix];
+            // 在 WHERE 条件中寻找匹配该列的等值谓词
+            auto eq = std::find_if(fed_conds_.begin(), fed_conds_.end(), [&](const Condition &cond) {
+                return cond.is_rhs_val && cond.op == OP_EQ && cond.lhs_col.tab_name == tab_name_ &&
+                       cond.lhs_col.col_name == col.name;
+            });
+            if (eq == fed_conds_.end()) break;
+            memcpy(lower_key.get() + offset, eq->rhs_val.raw->data, col.len);
+            memcpy(upper_key.get() + offset, eq->rhs_val.raw->data, col.len);
+            offset += col.len;
+        }
+        if (prefix < index_meta_.cols.size()) {
+            const char *lo = nullptr;
+            const char *hi = nullptr;
+            range_bounds(index_meta_.cols[prefix], &lo, &hi);
+            if (prefix == 0 && lo == nullptr && hi == nullptr) {
+                // 没有可用的条件，退化为全索引扫描（即遍历整个 B+ 树的叶子节点链表）
+                return std::make_unique<IxScan>(ih, ih->leaf_begin(), ih->leaf_end(), sm_manager_->get_bpm());
+            }
+            const auto &col = index_meta_.cols[prefix];
+            if (lo != nullptr && hi != nullptr && compare_value(col.type, col.len, lo, hi) > 0) {
+                // 范围为空
+                Iid begin = ih->leaf_begin();
+                return std::make_unique<IxScan>(ih, begin, begin, sm_manager_->get_bpm());
+            }
+            for (size_t i = prefix; i < index_meta_.cols.size(); ++i) {
+                const auto &rest = index_meta_.cols[i];
+                fill_key_bound(rest, lower_key.get() + offset, false);
+                fill_key_bound(rest, upper_key.get() + offset, true);
+                if (i == prefix && lo != nullptr) memcpy(lower_key.get() + offset, lo, rest.len);
+                if (i == prefix && hi != nullptr) memcpy(upper_key.get() + offset, hi, rest.len);
+                offset += rest.len;
+            }
+        }
+
+        // 3. 使用 lower_bound 和 upper_bound 确定扫描范围，边界上的键值对也在扫描范围内，
+        // 严格不等的条件和其余的条件由 pred_ 排除。
+        auto lower = ih->lower_bound(lower_key.get());
+        auto upper = ih->upper_bound(upper_key.get());
+        return std::make_unique<IxScan>(ih, lower, upper, sm_manager_->get_bpm());
+    }
+
+    // 范围字段上的边界：下界取 >、>= 条件中最大的常量，上界取 <、<= 条件中最小的常量，没有时为nullptr
+    void range_bounds(const ColMeta &col, const char **lo, const char **hi) {
+        for (auto &cond : fed_conds_) {
+            if (!cond.is_rhs_val || cond.lhs_col.tab_name != tab_name_ || cond.lhs_col.col_name != col.name ||
+                cond.rhs_val.type != col.type) {
+                continue;
+            }
+            const char *val = cond.rhs_val.raw->data;
+            if ((cond.op == OP_GT || cond.op == OP_GE) &&
+                (*lo == nullptr || compare_value(col.type, col.len, val, *lo) > 0)) {
+                *lo = val;
+            } else if ((cond.op == OP_LT || cond.op == OP_LE) &&
+                       (*hi == nullptr || compare_value(col.type, col.len, val, *hi) < 0)) {
+                *hi = val;
+            }
+        }
+    }
+
+    // 在key中写入字段类型的最小值或最大值，作为没有条件的字段上的扫描边界
+    static void fill_key_bound(const ColMeta &col, char *dst, bool max) {
+        if (col.type == TYPE_INT) {
+            int val = max ? std::numeric_limits<int>::max() : std::numeric_limits<int>::min();
+            memcpy(dst, &val, sizeof(val));
+        } else if (col.type == TYPE_FLOAT) {
+            float val = max ? std::numeric_limits<float>::infinity() : -std::numeric_limits<float>::infinity();
+            memcpy(dst, &val, sizeof(val));
+        } else {
+            memset(dst, max ? 0xff : 0, col.len);
+        }
+    }
 };
\ No newline at end of file
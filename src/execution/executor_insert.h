@@ -20,30 +20,63 @@ class InsertExecutor : public AbstractExecutor {
     TabMeta tab_;                   // 表的元数据
     std::vector<Value> values_;     // 需要插入的数据
     RmFileHandle *fh_;              // 表的数据文件句柄
+    std::shared_lock<std::shared_mutex> dml_lock_;  // 执行期间表上不会出现新的索引，见RmFileHandle::lock_dml
     std::string tab_name_;          // 表名称
+    std::vector<IxIndexHandle *> ihs_;          // 与tab_.indexes一一对应的B+树索引，其他索引为nullptr
+    std::vector<IxPointIndexHandle *> hhs_;     // 与tab_.indexes一一对应的哈希索引和LSM索引，B+树索引为nullptr
     Rid rid_;                       // 插入的位置，由于系统默认插入时不指定位置，因此当前rid_在插入后才赋值
     SmManager *sm_manager_;
 
    public:
     InsertExecutor(SmManager *sm_manager, const std::string &tab_name, std::vector<Value> values, Context *context) {
         sm_manager_ = sm_manager;
-        tab_ = sm_manager_->db_.get_table(tab_name);
+        tab_name_ = route(tab_name, values);
+        fh_ = sm_manager_->get_table_handle(tab_name_);
+        dml_lock_ = fh_->lock_dml();
+        tab_ = sm_manager_->db_.get_table(tab_name_);
         values_ = values;
-        tab_name_ = tab_name;
         if (values.size() != tab_.cols.size()) {
             throw InvalidValueCountError();
         }
-        fh_ = sm_manager_->fhs_.at(tab_name).get();
+        // 索引句柄在构造时取得一次，插入每条记录时不再按索引名查找
+        for (auto &index : tab_.indexes) {
+            bool point = is_point_index(index.type);
+            ihs_.push_back(point ? nullptr : sm_manager_->get_index_handle(tab_name_, index));
+            hhs_.push_back(point ? sm_manager_->get_point_index_handle(tab_name_, index) : nullptr);
+        }
         context_ = context;
     };
 
+    /* 分区表的记录插入分区键所在的分区，返回实际插入记录的表 */
+    std::string route(const std::string &tab_name, const std::vector<Value> &values) {
+        const TabMeta &tab = sm_manager_->db_.get_table(tab_name);
+        if (!tab.partition.is_partitioned()) {
+            return tab_name;
+        }
+        if (values.size() != tab.cols.size()) {
+            throw InvalidValueCountError();
+        }
+        const ColMeta &col = tab.partition.col;
+        Value key = values[tab.find_col(col.name)];
+        if (!is_compatible_type(col.type, key.type)) {
+            throw IncompatibleTypeError(coltype2str(col.type), coltype2str(key.type));
+        }
+        key.raw = nullptr;
+        key.init_raw(col.len);
+        size_t i = tab.partition.locate(key.raw->data);
+        if (i == tab.partition.size()) {
+            throw NoPartitionError(tab_name);
+        }
+        return tab.partition.table_name(tab_name, i);
+    }
+
     std::unique_ptr<RmRecord> Next() override {
         // Make record buffer
         RmRecord rec(fh_->get_file_hdr().record_size);
         for (size_t i = 0; i < values_.size(); i++) {
             auto &col = tab_.cols[i];
             auto &val = values_[i];
-            if (col.type != val.type) {
+            if (!is_compatible_type(col.type, val.type)) {
                 throw IncompatibleTypeError(coltype2str(col.type), coltype2str(val.type));
             }
             val.init_raw(col.len);
@@ -55,14 +88,17 @@ class InsertExecutor : public AbstractExecutor {
         // Insert into index
         for(size_t i = 0; i < tab_.indexes.size(); ++i) {
             auto& index = tab_.indexes[i];
-            auto ih = sm_manager_->ihs_.at(sm_manager_->get_ix_manager()->get_index_name(tab_name_, index.cols)).get();
-            char* key = new char[index.col_tot_len];
+            std::vector<char> key(index.col_tot_len);
             int offset = 0;
-            for(size_t i = 0; i < index.col_num; ++i) {
-                memcpy(key + offset, rec.data + index.cols[i].offset, index.cols[i].len);
-                offset += index.cols[i].len;
+            for(size_t j = 0; j < index.cols.size(); ++j) {
+                memcpy(key.data() + offset, rec.data + index.cols[j].offset, index.cols[j].len);
+                offset += index.cols[j].len;
+            }
+            if (hhs_[i] != nullptr) {
+                hhs_[i]->insert_entry(key.data(), rid_, context_->txn_);
+            } else {
+                ihs_[i]->insert_entry(key.data(), rid_, context_->txn_);
             }
-            ih->insert_entry(key, rid_, context_->txn_);
         }
         return nullptr;
     }
@@ -0,0 +1,109 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <chrono>
+
+#include "execution_defs.h"
+#include "executor_abstract.h"
+#include "storage/buffer_pool_manager.h"
+
+/* EXPLAIN ANALYZE统计的一个算子的执行情况，时间和页面数包含子节点 */
+struct OperatorStats {
+    uint64_t rows = 0;          // 输出的元组个数
+    uint64_t loops = 0;         // 开始执行的次数，嵌套循环连接的内侧输入每个外侧块执行一次
+    double time_ms = 0;         // 花在该算子及其子节点中的时间
+    uint64_t page_hits = 0;     // 获取页面时命中缓冲池的次数
+    uint64_t page_misses = 0;   // 获取页面时需要从磁盘读取的次数
+};
+
+/**
+ * @brief EXPLAIN ANALYZE中包在每个算子外面的统计节点，把所有调用转发给被统计的算子，
+ * 累计它输出的元组个数、执行次数、时间和当前线程获取页面的次数
+ */
+class InstrumentedExecutor : public AbstractExecutor {
+   private:
+    std::unique_ptr<AbstractExecutor> child_;
+    OperatorStats *stats_;
+
+    // 执行fn，把花费的时间和获取页面的次数计入stats_
+    template <typename Fn>
+    auto measure(Fn &&fn) {
+        struct Scope {
+            OperatorStats *stats;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            BufferPoolStats pages = BufferPoolManager::thread_stats();
+            ~Scope() {
+                const BufferPoolStats &now = BufferPoolManager::thread_stats();
+                stats->time_ms +=
+                    std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                stats->page_hits += now.get(BufferPoolStats::HITS) - pages.get(BufferPoolStats::HITS);
+                stats->page_misses += now.get(BufferPoolStats::MISSES) - pages.get(BufferPoolStats::MISSES);
+            }
+        } scope{stats_};
+        return fn();
+    }
+
+   public:
+    InstrumentedExecutor(std::unique_ptr<AbstractExecutor> child, OperatorStats *stats)
+        : child_(std::move(child)), stats_(stats) {
+        context_ = child_->context_;
+    }
+
+    size_t tupleLen() const override { return child_->tupleLen(); }
+
+    const std::vector<ColMeta> &cols() const override { return child_->cols(); }
+
+    std::string getType() override { return child_->getType(); }
+
+    ColMeta get_col_offset(const TabCol &target) override { return child_->get_col_offset(target); }
+
+    void beginTuple() override {
+        stats_->loops++;
+        measure([&] { child_->beginTuple(); });
+        if (!child_->is_end()) stats_->rows++;
+    }
+
+    void nextTuple() override {
+        measure([&] { child_->nextTuple(); });
+        if (!child_->is_end()) stats_->rows++;
+    }
+
+    bool is_end() const override { return child_->is_end(); }
+
+    std::unique_ptr<RmRecord> Next() override {
+        // insert、delete、update算子只通过一次Next()完成全部修改，算作执行一次
+        if (stats_->loops == 0) stats_->loops = 1;
+        return measure([&] { return child_->Next(); });
+    }
+
+    RecordView view() override {
+        return measure([&] { return child_->view(); });
+    }
+
+    Rid &rid() override { return child_->rid(); }
+
+    void beginBatch() override {
+        stats_->loops++;
+        measure([&] { child_->beginBatch(); });
+    }
+
+    bool NextBatch(TupleBatch &batch) override {
+        bool more = measure([&] { return child_->NextBatch(batch); });
+        stats_->rows += batch.size();
+        return more;
+    }
+
+    bool push_runtime_filter(const std::shared_ptr<const RuntimeFilter> &filter,
+                             const std::vector<JoinKeyCol> &keys) override {
+        return child_->push_runtime_filter(filter, keys);
+    }
+};
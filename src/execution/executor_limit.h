@@ -0,0 +1,80 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "execution_defs.h"
+#include "execution_manager.h"
+#include "executor_abstract.h"
+#include "index/ix.h"
+#include "system/sm.h"
+
+/**
+ * @brief LIMIT：只输出子节点的前limit个元组。
+ * 执行是由上层拉动的，输出够limit个元组之后不再向子节点取元组，下面的扫描和连接也随之停止
+ */
+class LimitExecutor : public AbstractExecutor {
+   private:
+    std::unique_ptr<AbstractExecutor> prev_;
+    size_t limit_;
+    size_t count_ = 0;                              // 已经输出的元组个数
+
+   public:
+    LimitExecutor(std::unique_ptr<AbstractExecutor> prev, size_t limit) {
+        prev_ = std::move(prev);
+        context_ = prev_->context_;
+        limit_ = limit;
+    }
+
+    size_t tupleLen() const override { return prev_->tupleLen(); }
+
+    const std::vector<ColMeta> &cols() const override { return prev_->cols(); }
+
+    std::string getType() override { return "LimitExecutor"; }
+
+    ColMeta get_col_offset(const TabCol &target) override { return prev_->get_col_offset(target); }
+
+    void beginTuple() override {
+        count_ = 0;
+        if (limit_ > 0) prev_->beginTuple();
+    }
+
+    void nextTuple() override {
+        if (is_end()) return;
+        if (++count_ < limit_) prev_->nextTuple();
+    }
+
+    bool is_end() const override { return count_ >= limit_ || prev_->is_end(); }
+
+    std::unique_ptr<RmRecord> Next() override { return is_end() ? nullptr : prev_->Next(); }
+
+    RecordView view() override { return is_end() ? RecordView() : prev_->view(); }
+
+    Rid &rid() override { return prev_->rid(); }
+
+    void beginBatch() override {
+        count_ = 0;
+        if (limit_ > 0) prev_->beginBatch();
+    }
+
+    /**
+     * @brief 子节点的批次直接输出，超过limit的部分从选择向量中截掉
+     */
+    bool NextBatch(TupleBatch &batch) override {
+        if (count_ >= limit_) {
+            batch.reset(&cols(), tupleLen());
+            return false;
+        }
+        if (!prev_->NextBatch(batch)) return false;
+        if (batch.size() > limit_ - count_) batch.sel().resize(limit_ - count_);
+        count_ += batch.size();
+        return true;
+    }
+};
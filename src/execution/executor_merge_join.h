@@ -0,0 +1,160 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "execution_defs.h"
+#include "execution_manager.h"
+#include "executor_abstract.h"
+#include "index/ix.h"
+#include "system/sm.h"
+
+/**
+ * @brief 两侧输入都按连接字段升序排列时使用的归并连接
+ * conds中的第一个条件是归并用的等值条件，左右儿子的输出必须分别按它的左侧字段和右侧字段升序排列，例如连接字段上的索引扫描。
+ * 两侧同时向前推进，遇到相等的键时把右侧键相同的一组元组读入内存，与左侧键相同的每个元组逐个拼接，
+ * 全部连接条件都用编译后的谓词检查。输出顺序与嵌套循环连接相同：左侧元组在外层，右侧元组在内层
+ */
+class MergeJoinExecutor : public BatchExecutor {
+   private:
+    std::unique_ptr<AbstractExecutor> left_;    // 左儿子节点
+    std::unique_ptr<AbstractExecutor> right_;   // 右儿子节点
+    size_t len_;                                // join后获得的每条记录的长度
+    std::vector<ColMeta> cols_;                 // join后获得的记录的字段
+    std::vector<Condition> fed_conds_;          // join条件，第一个为归并条件
+    Predicate pred_;                            // 编译后的join条件
+    ColMeta left_key_;                          // 归并键在左儿子元组中的字段
+    ColMeta right_key_;                         // 归并键在右儿子元组中的字段
+
+    TupleBatch left_batch_;
+    size_t left_pos_ = 0;
+    bool left_end_ = true;
+    TupleBatch right_batch_;
+    size_t right_pos_ = 0;
+    bool right_end_ = true;
+
+    std::vector<char> group_;                   // 右侧键相同的一组元组
+    size_t group_size_ = 0;
+    std::vector<char> group_key_;               // 这一组元组的键
+    bool in_group_ = false;                     // 当前左侧元组的键是否与group_key_相等
+    size_t group_pos_ = 0;                      // 当前左侧元组下一个要拼接的组内元组
+
+   public:
+    MergeJoinExecutor(std::unique_ptr<AbstractExecutor> left, std::unique_ptr<AbstractExecutor> right,
+                      std::vector<Condition> conds) {
+        left_ = std::move(left);
+        right_ = std::move(right);
+        context_ = left_->context_;
+        len_ = left_->tupleLen() + right_->tupleLen();
+        cols_ = left_->cols();
+        auto right_cols = right_->cols();
+        for (auto &col : right_cols) {
+            col.offset += left_->tupleLen();
+        }
+        cols_.insert(cols_.end(), right_cols.begin(), right_cols.end());
+        fed_conds_ = std::move(conds);
+        pred_ = Predicate::compile(fed_conds_, left_->cols(), right_->cols());
+
+        if (fed_conds_.empty() || fed_conds_[0].is_rhs_val || fed_conds_[0].op != OP_EQ) {
+            throw InternalError("Merge join requires an equality condition on two columns");
+        }
+        left_key_ = *get_col(left_->cols(), fed_conds_[0].lhs_col);
+        right_key_ = *get_col(right_->cols(), fed_conds_[0].rhs_col);
+    }
+
+    size_t tupleLen() const override { return len_; }
+
+    const std::vector<ColMeta> &cols() const override { return cols_; }
+
+    std::string getType() override { return "MergeJoinExecutor"; }
+
+    ColMeta get_col_offset(const TabCol &target) override {
+        auto it = get_col(cols_, target);
+        return *it;
+    }
+
+    void beginBatch() override {
+        left_->beginBatch();
+        right_->beginBatch();
+        left_pos_ = 0;
+        left_end_ = !left_->NextBatch(left_batch_);
+        right_pos_ = 0;
+        right_end_ = !right_->NextBatch(right_batch_);
+        in_group_ = false;
+        group_pos_ = 0;
+    }
+
+    bool NextBatch(TupleBatch &batch) override {
+        batch.reset(&cols_, len_);
+        size_t left_len = left_->tupleLen();
+        size_t right_len = right_->tupleLen();
+        while (!batch.full()) {
+            if (in_group_) {
+                const char *lrec = left_batch_.tuple(left_pos_);
+                for (; group_pos_ < group_size_ && !batch.full(); group_pos_++) {
+                    const char *rrec = group_.data() + group_pos_ * right_len;
+                    if (!pred_.eval(lrec, rrec)) continue;
+                    char *out = batch.append();
+                    memcpy(out, lrec, left_len);
+                    memcpy(out + left_len, rrec, right_len);
+                }
+                if (group_pos_ < group_size_) break;
+                // 下一个左侧元组的键相同时继续与这一组拼接
+                advance_left();
+                group_pos_ = 0;
+                in_group_ = !left_end_ && compare_key(left_key(), group_key_.data()) == 0;
+                continue;
+            }
+            if (left_end_ || right_end_) break;
+            int cmp = compare_key(left_key(), right_key());
+            if (cmp < 0) {
+                advance_left();
+            } else if (cmp > 0) {
+                advance_right();
+            } else {
+                // 读入右侧键相同的一组元组
+                group_key_.assign(right_key(), right_key() + right_key_.len);
+                group_.clear();
+                group_size_ = 0;
+                while (!right_end_ && compare_key(right_key(), group_key_.data()) == 0) {
+                    const char *rrec = right_batch_.tuple(right_pos_);
+                    group_.insert(group_.end(), rrec, rrec + right_len);
+                    group_size_++;
+                    advance_right();
+                }
+                in_group_ = true;
+                group_pos_ = 0;
+            }
+        }
+        return !batch.empty();
+    }
+
+   private:
+    const char *left_key() const { return left_batch_.tuple(left_pos_) + left_key_.offset; }
+
+    const char *right_key() const { return right_batch_.tuple(right_pos_) + right_key_.offset; }
+
+    // 按左侧字段的类型比较两个归并键
+    int compare_key(const char *lhs, const char *rhs) const {
+        return compare_value(left_key_.type, left_key_.len, lhs, rhs);
+    }
+
+    void advance_left() {
+        if (++left_pos_ < left_batch_.size()) return;
+        left_pos_ = 0;
+        left_end_ = !left_->NextBatch(left_batch_);
+    }
+
+    void advance_right() {
+        if (++right_pos_ < right_batch_.size()) return;
+        right_pos_ = 0;
+        right_end_ = !right_->NextBatch(right_batch_);
+    }
+};
@@ -23,13 +23,34 @@ class NestedLoopJoinExecutor : public AbstractExecutor {
     std::vector<ColMeta> cols_;                 // join后获得的记录的字段
 
     std::vector<Condition> fed_conds_;          // join条件
+    Predicate pred_;                            // 编译后的join条件，左侧字段来自左儿子，右侧字段来自右儿子
     bool isend;
+    std::vector<char> view_buf_;                // view()拼接出的当前元组，每个元组复用
+
+    // 批量接口的状态。右儿子能缓存时，左侧逐批读取，对左侧批次中的每个元组依次和缓存的每一批计算连接条件；
+    // 否则左侧的元组先装满一个不超过EXEC_NLJ_BLOCK_SIZE的块，每个块只扫描一遍右儿子（分块嵌套循环）
+    TupleBatch left_batch_;
+    bool left_valid_ = false;                   // left_batch_中是否还有没处理完的元组
+    size_t left_pos_ = 0;                       // 正在处理的左侧元组在left_batch_中（分块模式下在当前批次中）的位置
+    bool batch_end_ = false;
+    std::vector<TupleBatch> right_cache_;       // 右儿子的全部输出，超过EXEC_NLJ_CACHE_SIZE时为空，改用分块模式
+    bool right_cached_ = false;
+    size_t right_cache_pos_ = 0;                // 缓存模式下当前左侧元组要读取的下一个右侧批次
+    std::vector<TupleBatch> block_;             // 分块模式下左侧的块，批次在各个块之间复用
+    size_t block_used_ = 0;                     // block_中属于当前块的批次个数，为0表示需要读入下一个块
+    size_t block_pos_ = 0;                      // 正在处理的左侧元组所在的block_批次
+    bool left_done_ = false;                    // 分块模式下左儿子已经读完
+    TupleBatch right_batch_;                    // 分块模式下当前的右侧批次
+    const TupleBatch *right_cur_ = nullptr;     // 正在和左侧元组匹配的右侧批次
+    std::vector<uint32_t> matches_;             // right_cur_中和当前左侧元组匹配的行号
+    size_t match_pos_ = 0;                      // 下一个要输出的匹配
 
    public:
     NestedLoopJoinExecutor(std::unique_ptr<AbstractExecutor> left, std::unique_ptr<AbstractExecutor> right, 
                             std::vector<Condition> conds) {
         left_ = std::move(left);
         right_ = std::move(right);
+        context_ = left_->context_;
         len_ = left_->tupleLen() + right_->tupleLen();
         cols_ = left_->cols();
         auto right_cols = right_->cols();
@@ -40,6 +61,7 @@ class NestedLoopJoinExecutor : public AbstractExecutor {
         cols_.insert(cols_.end(), right_cols.begin(), right_cols.end());
         isend = false;
         fed_conds_ = std::move(conds);
+        pred_ = Predicate::compile(fed_conds_, left_->cols(), right_->cols());
 
     }
 
@@ -65,44 +87,7 @@ class NestedLoopJoinExecutor : public AbstractExecutor {
         // 2. 初始化右子算子。嵌套循环连接的逻辑是：固定左表的一行，遍历右表的所有行。
         right_->beginTuple();
 
-        // 3. 定义连接谓词判断逻辑。
-        // 与单表不同，这里的条件通常涉及两个表的列（如 student.id = grade.student_id）。
-        auto satisfy = [&]() -> bool {
-            if (left_->is_end() || right_->is_end()) return false;
-            auto lrec = left_->Next();
-            auto rrec = right_->Next();
-            for (auto &cond : fed_conds_) {
-                // 关键点：从左、右子算子的元数据中分别定位需要比较的列。
-                auto l_it = left_->get_col(left_->cols(), cond.lhs_col);
-                auto r_it = right_->get_col(right_->cols(), cond.rhs_col);
-                char *lhs_ptr = lrec->data + l_it->offset;
-                char *rhs_ptr = rrec->data + r_it->offset;
-                ColType type = l_it->type;
-                int len = l_it->len;
-                int cmp = 0;
-                if (type == TYPE_INT) {
-                    int a = *(int *)lhs_ptr, b = *(int *)rhs_ptr;
-                    cmp = (a < b) ? -1 : ((a > b) ? 1 : 0);
-                } else if (type == TYPE_FLOAT) {
-                    float a = *(float *)lhs_ptr, b = *(float *)rhs_ptr;
-                    cmp = (a < b) ? -1 : ((a > b) ? 1 : 0);
-                } else {
-                    cmp = memcmp(lhs_ptr, rhs_ptr, len);
-                }
-                // 如果任一连接条件不成立，则该左右元组组合不符合结果。
-                switch (cond.op) {
-                    case OP_EQ: if (cmp != 0) return false; break;
-                    case OP_NE: if (cmp == 0) return false; break;
-                    case OP_LT: if (!(cmp < 0)) return false; break;
-                    case OP_GT: if (!(cmp > 0)) return false; break;
-                    case OP_LE: if (!(cmp <= 0)) return false; break;
-                    case OP_GE: if (!(cmp >= 0)) return false; break;
-                }
-            }
-            return true;
-        };
-
-        // 4. 执行双层循环寻找第一对匹配。
+        // 3. 执行双层循环寻找第一对匹配。
         for (;;) {
             if (left_->is_end()) { isend = true; return; }
             while (!right_->is_end()) {
@@ -120,40 +105,6 @@ class NestedLoopJoinExecutor : public AbstractExecutor {
     void nextTuple() override {
         if (is_end()) return;
 
-        // 定义满足条件的闭包。
-        auto satisfy = [&]() -> bool {
-            if (left_->is_end() || right_->is_end()) return false;
-            auto lrec = left_->Next();
-            auto rrec = right_->Next();
-            for (auto &cond : fed_conds_) {
-                auto l_it = left_->get_col(left_->cols(), cond.lhs_col);
-                auto r_it = right_->get_col(right_->cols(), cond.rhs_col);
-                char *lhs_ptr = lrec->data + l_it->offset;
-                char *rhs_ptr = rrec->data + r_it->offset;
-                ColType type = l_it->type;
-                int len = l_it->len;
-                int cmp = 0;
-                if (type == TYPE_INT) {
-                    int a = *(int *)lhs_ptr, b = *(int *)rhs_ptr;
-                    cmp = (a < b) ? -1 : ((a > b) ? 1 : 0);
-                } else if (type == TYPE_FLOAT) {
-                    float a = *(float *)lhs_ptr, b = *(float *)rhs_ptr;
-                    cmp = (a < b) ? -1 : ((a > b) ? 1 : 0);
-                } else {
-                    cmp = memcmp(lhs_ptr, rhs_ptr, len);
-                }
-                switch (cond.op) {
-                    case OP_EQ: if (cmp != 0) return false; break;
-                    case OP_NE: if (cmp == 0) return false; break;
-                    case OP_LT: if (!(cmp < 0)) return false; break;
-                    case OP_GT: if (!(cmp > 0)) return false; break;
-                    case OP_LE: if (!(cmp <= 0)) return false; break;
-                    case OP_GE: if (!(cmp >= 0)) return false; break;
-                }
-            }
-            return true;
-        };
-
         // 从“右表的下一条”开始寻找下一对匹配组合。
         right_->nextTuple();
         for (;;) {
@@ -172,21 +123,187 @@ class NestedLoopJoinExecutor : public AbstractExecutor {
     std::unique_ptr<RmRecord> Next() override {
         // 1. 结束检查。
         if (is_end()) return nullptr;
-        // 2. 获取当前匹配的左右元组。
-        auto lrec = left_->Next();
-        auto rrec = right_->Next();
-        
-        // 3. 创建拼接后的新元组。长度为左右两表元组长度之和。
-        auto out = std::make_unique<RmRecord>(len_);
-        
-        // 4. 数据拼接。
-        // 将左表记录拷贝到新 Buffer 的起始位置。
-        memcpy(out->data, lrec->data, left_->tupleLen());
-        // 将右表记录拷贝到左表数据之后，实现拼接。
-        memcpy(out->data + left_->tupleLen(), rrec->data, right_->tupleLen());
-        
+        // 2. 创建拼接后的新元组，数据从请求的arena中分配。长度为左右两表元组长度之和。
+        auto out = make_tuple(len_);
+        // 3. 数据拼接。
+        concat(out->data);
         return out;
     }
 
+    // 在复用的缓冲区中拼接当前元组，上层连接算子逐对计算谓词时不再为每一对元组分配内存。
+    RecordView view() override {
+        if (is_end()) return RecordView();
+        view_buf_.resize(len_);
+        concat(view_buf_.data());
+        return RecordView(view_buf_.data(), len_);
+    }
+
+    /**
+     * @brief 初始化批量连接。右儿子的输出不超过EXEC_NLJ_CACHE_SIZE时整体缓存在内存中，所有左侧元组共享，不再重复扫描右表；
+     * 否则按块扫描右表，扫描次数是左侧的块数
+     */
+    void beginBatch() override {
+        left_valid_ = false;
+        batch_end_ = false;
+        right_cur_ = nullptr;
+        block_used_ = 0;
+        left_done_ = false;
+
+        right_cache_.clear();
+        right_cached_ = true;
+        size_t cached_bytes = 0;
+        right_->beginBatch();
+        for (;;) {
+            right_cache_.emplace_back();
+            if (!right_->NextBatch(right_cache_.back())) {
+                right_cache_.pop_back();
+                break;
+            }
+            cached_bytes += right_cache_.back().size() * right_->tupleLen();
+            if (cached_bytes > EXEC_NLJ_CACHE_SIZE) {
+                right_cache_.clear();
+                right_cached_ = false;
+                break;
+            }
+        }
+        if (right_cache_.empty() && right_cached_) {
+            batch_end_ = true;  // 右侧为空，连接结果必然为空
+            return;
+        }
+        left_->beginBatch();
+    }
+
+    /**
+     * @brief 输出下一批连接结果。缓存模式下输出顺序与逐行接口相同：左侧元组在外层，右侧元组在内层；
+     * 分块模式下右侧批次在外层，同一右侧批次内仍按左侧元组的顺序输出
+     */
+    bool NextBatch(TupleBatch &batch) override {
+        batch.reset(&cols_, len_);
+        if (right_cached_) {
+            fill_cached(batch);
+        } else {
+            fill_blocked(batch);
+        }
+        return !batch.empty();
+    }
+
     Rid &rid() override { return _abstract_rid; }
+
+   private:
+    /* 对每个左侧元组，连接条件在缓存的右侧整批元组上逐个条件按列计算，得到匹配的行号后再拼接输出 */
+    void fill_cached(TupleBatch &batch) {
+        while (!batch.full() && !batch_end_) {
+            if (!left_valid_) {
+                if (!left_->NextBatch(left_batch_)) {
+                    batch_end_ = true;
+                    break;
+                }
+                left_valid_ = true;
+                left_pos_ = 0;
+                right_cur_ = nullptr;
+                right_cache_pos_ = 0;
+            }
+            if (left_pos_ >= left_batch_.size()) {
+                left_valid_ = false;
+                continue;
+            }
+            if (right_cur_ == nullptr) {
+                if (right_cache_pos_ == right_cache_.size()) {
+                    // 当前左侧元组已经和右侧的全部元组比较过
+                    left_pos_++;
+                    right_cache_pos_ = 0;
+                    continue;
+                }
+                right_cur_ = &right_cache_[right_cache_pos_++];
+                pred_.match(left_batch_.tuple(left_pos_), *right_cur_, matches_);
+                match_pos_ = 0;
+            }
+            emit_matches(batch, left_batch_.tuple(left_pos_));
+            if (match_pos_ == matches_.size()) right_cur_ = nullptr;
+        }
+    }
+
+    /* 块中的每个左侧元组依次和当前的右侧批次匹配，块中的元组都处理完后再读右侧的下一批，右侧读完后读入下一个块 */
+    void fill_blocked(TupleBatch &batch) {
+        while (!batch.full() && !batch_end_) {
+            if (block_used_ == 0) {
+                if (!load_block()) {
+                    batch_end_ = true;
+                    break;
+                }
+                right_->beginBatch();
+                right_cur_ = nullptr;
+            }
+            if (right_cur_ == nullptr) {
+                if (!right_->NextBatch(right_batch_)) {
+                    block_used_ = 0;    // 当前块已经和右侧的全部元组比较过
+                    continue;
+                }
+                right_cur_ = &right_batch_;
+                block_pos_ = 0;
+                left_pos_ = 0;
+                pred_.match(block_[0].tuple(0), *right_cur_, matches_);
+                match_pos_ = 0;
+            }
+            emit_matches(batch, block_[block_pos_].tuple(left_pos_));
+            if (match_pos_ < matches_.size()) continue;
+            if (++left_pos_ == block_[block_pos_].size()) {
+                left_pos_ = 0;
+                if (++block_pos_ == block_used_) {
+                    right_cur_ = nullptr;
+                    continue;
+                }
+            }
+            pred_.match(block_[block_pos_].tuple(left_pos_), *right_cur_, matches_);
+            match_pos_ = 0;
+        }
+    }
+
+    /* 从左儿子读入下一个块，块中只保存非空的批次；左儿子已经读完时返回false */
+    bool load_block() {
+        block_used_ = 0;
+        size_t block_bytes = 0;
+        while (!left_done_ && block_bytes < EXEC_NLJ_BLOCK_SIZE) {
+            if (block_used_ == block_.size()) block_.emplace_back();
+            if (!left_->NextBatch(block_[block_used_])) {
+                left_done_ = true;
+                break;
+            }
+            if (block_[block_used_].empty()) continue;
+            block_bytes += block_[block_used_].size() * left_->tupleLen();
+            block_used_++;
+        }
+        return block_used_ > 0;
+    }
+
+    /* 把lrec和right_cur_中从match_pos_开始的匹配拼接到批次中，直到匹配用完或批次装满 */
+    void emit_matches(TupleBatch &batch, const char *lrec) {
+        size_t left_len = left_->tupleLen();
+        size_t right_len = right_->tupleLen();
+        for (; match_pos_ < matches_.size() && !batch.full(); match_pos_++) {
+            char *out = batch.append();
+            memcpy(out, lrec, left_len);
+            memcpy(out + left_len, right_cur_->row_data(matches_[match_pos_]), right_len);
+        }
+    }
+
+    // 把当前匹配的左右元组拼接到out中，元组的视图只在拼接期间持有。
+    void concat(char *out) {
+        RecordView lrec = left_->view();
+        RecordView rrec = right_->view();
+        // 将左表记录拷贝到起始位置，右表记录拷贝到左表数据之后。
+        memcpy(out, lrec.data(), left_->tupleLen());
+        memcpy(out + left_->tupleLen(), rrec.data(), right_->tupleLen());
+    }
+
+    // 判断当前左右元组组合是否满足所有连接条件。
+    // 与单表不同，这里的条件通常涉及两个表的列（如 student.id = grade.student_id）。
+    // 谓词直接在子算子的记录视图上计算，视图只在本次判断期间持有，不会跨越内层循环长期固定页面。
+    bool satisfy() {
+        if (left_->is_end() || right_->is_end()) return false;
+        RecordView lrec = left_->view();
+        RecordView rrec = right_->view();
+        if (!lrec.is_valid() || !rrec.is_valid()) return false;
+        return pred_.eval(lrec.data(), rrec.data());
+    }
 };
\ No newline at end of file
@@ -0,0 +1,209 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+
+#include "execution_defs.h"
+#include "execution_manager.h"
+#include "executor_abstract.h"
+#include "executor_seq_scan.h"
+#include "worker_pool.h"
+#include "index/ix.h"
+#include "system/sm.h"
+
+/**
+ * @brief 按morsel并行的顺序扫描：表按EXEC_MORSEL_PAGES个页面划分为morsel，每个morsel作为一个任务交给WorkerPool，
+ * 工作线程在自己的morsel上按批扫描页面并用编译后的谓词过滤，结果批次保存在morsel中；
+ * 调用线程作为gather算子按页面顺序输出各个morsel的结果，因此输出顺序与SeqScanExecutor相同。
+ * 同时分发的morsel不超过线程数的两倍，输出完一个morsel才分发下一个，工作线程从不等待调用线程
+ */
+class ParallelSeqScanExecutor : public BatchExecutor {
+   private:
+    /* 分给一个任务的页面范围及其扫描结果 */
+    struct Morsel {
+        int first_page;
+        int end_page;
+        std::vector<TupleBatch> batches;    // 过滤后的非空批次
+        bool done = false;
+        std::exception_ptr error;
+    };
+
+    std::string tab_name_;              // 表的名称
+    RmFileHandle *fh_;                  // 表的数据文件句柄
+    std::vector<ColMeta> cols_;         // scan后生成的记录的字段
+    size_t len_;                        // scan后生成的每条记录的长度
+    std::vector<Condition> fed_conds_;  // scan的条件
+    Predicate pred_;                    // 编译后的fed_conds_
+    RmBatchFilter pax_filter_;          // PAX格式的表按列检查、有字典编码字段的表按编码检查的过滤函数
+    std::vector<RmZoneRange> zone_ranges_;  // 区间映射字段的取值范围，各任务跳过区间不相交的页面
+    std::shared_ptr<ScanRing> ring_;    // 大表扫描的所有任务共用的环形缓冲区
+    bool snapshot_ = false;             // 是否按快照扫描
+    ReadView view_{};                   // 开始扫描时取出的快照，供工作线程使用
+    SmManager *sm_manager_;
+
+    int next_page_ = 0;                 // 下一个要分发的页面
+    int end_page_ = 0;                  // 开始扫描时表的页面数
+    std::deque<std::unique_ptr<Morsel>> morsels_;   // 已分发、尚未输出完的morsel，按页面顺序排列
+    size_t out_pos_ = 0;                // 队首morsel中下一个要输出的批次
+    std::mutex latch_;                  // 保护morsel的done/error和in_flight_
+    std::condition_variable cv_;
+    size_t in_flight_ = 0;              // 还没有执行完的任务数
+    std::atomic<bool> cancelled_{false};
+
+   public:
+    ParallelSeqScanExecutor(SmManager *sm_manager, std::string tab_name, std::vector<Condition> conds,
+                            Context *context) {
+        sm_manager_ = sm_manager;
+        tab_name_ = std::move(tab_name);
+        TabMeta &tab = sm_manager_->db_.get_table(tab_name_);
+        fh_ = sm_manager_->get_table_handle(tab_name_);
+        cols_ = tab.cols;
+        len_ = cols_.back().offset + cols_.back().len;
+        context_ = context;
+        fed_conds_ = std::move(conds);
+        pred_ = Predicate::compile(fed_conds_, cols_);
+        if (fh_->get_file_hdr().format == RM_FORMAT_PAX) {
+            pax_filter_ = SeqScanExecutor::make_pax_filter(pred_);
+        } else if (fh_->get_file_hdr().num_dict_fields > 0) {
+            pax_filter_ = SeqScanExecutor::make_dict_filter(pred_, fh_);
+        }
+        zone_ranges_ = SeqScanExecutor::make_zone_ranges(pred_, fh_);
+    }
+
+    ~ParallelSeqScanExecutor() override { cancel(); }
+
+    size_t tupleLen() const override { return len_; }
+
+    const std::vector<ColMeta> &cols() const override { return cols_; }
+
+    std::string getType() override { return "ParallelSeqScanExecutor"; }
+
+    ColMeta get_col_offset(const TabCol &target) override { return *get_col(cols_, target); }
+
+    /**
+     * @brief 和SeqScanExecutor一样在调用线程中加谓词锁或者取出快照，然后分发第一批morsel
+     */
+    void beginBatch() override {
+        cancel();
+        lock_scan_predicate(fh_, pred_);
+        snapshot_ = snapshot_read();
+        if (snapshot_) view_ = context_->txn_->get_read_view();
+        BufferPoolManager *bpm = sm_manager_->get_bpm();
+        end_page_ = fh_->get_file_hdr().num_pages;
+        ring_ = static_cast<size_t>(end_page_) > bpm->get_pool_size() / SCAN_RING_THRESHOLD ? bpm->create_scan_ring()
+                                                                                          : nullptr;
+        next_page_ = RM_FIRST_RECORD_PAGE;
+        out_pos_ = 0;
+        dispatch();
+    }
+
+    bool NextBatch(TupleBatch &batch) override {
+        while (!morsels_.empty()) {
+            Morsel &morsel = *morsels_.front();
+            {
+                std::unique_lock<std::mutex> lock(latch_);
+                cv_.wait(lock, [&]() { return morsel.done; });
+            }
+            if (morsel.error) {
+                std::exception_ptr error = morsel.error;
+                cancel();
+                std::rethrow_exception(error);
+            }
+            if (out_pos_ < morsel.batches.size()) {
+                std::swap(batch, morsel.batches[out_pos_++]);
+                return true;
+            }
+            morsels_.pop_front();
+            out_pos_ = 0;
+            dispatch();
+        }
+        batch.reset(&cols_, len_);
+        return false;
+    }
+
+   private:
+    // 分发morsel，直到已分发的morsel达到上限或者所有页面都已分发
+    void dispatch() {
+        size_t max_morsels = 2 * WorkerPool::instance().size();
+        while (morsels_.size() < max_morsels && next_page_ < end_page_) {
+            auto morsel = std::make_unique<Morsel>();
+            morsel->first_page = next_page_;
+            // morsel的边界对齐到EXEC_MORSEL_PAGES的整数倍，与缓冲池按段放置页面的边界一致
+            morsel->end_page = std::min((next_page_ / EXEC_MORSEL_PAGES + 1) * EXEC_MORSEL_PAGES, end_page_);
+            next_page_ = morsel->end_page;
+            Morsel *m = morsel.get();
+            morsels_.push_back(std::move(morsel));
+            {
+                std::lock_guard<std::mutex> lock(latch_);
+                in_flight_++;
+            }
+            // 交给morsel的页面所在节点上的工作线程，页面从该节点的分片中读取
+            BufferPoolManager *bpm = sm_manager_->get_bpm();
+            int node = -1;
+            if (bpm->get_num_nodes() > 1) node = static_cast<int>(bpm->get_page_node({fh_->GetFd(), m->first_page}));
+            WorkerPool::instance().submit([this, m]() { run_morsel(m); }, node);
+        }
+    }
+
+    // 在工作线程中扫描一个morsel
+    void run_morsel(Morsel *morsel) {
+        std::exception_ptr error;
+        try {
+            if (!cancelled_) {
+                scan_morsel(morsel);
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(latch_);
+        morsel->error = error;
+        morsel->done = true;
+        in_flight_--;
+        cv_.notify_all();
+    }
+
+    void scan_morsel(Morsel *morsel) {
+        RmScan scan(fh_, morsel->first_page, morsel->end_page, pax_filter_, ring_, snapshot_ ? &view_ : nullptr,
+                    zone_ranges_);
+        while (!scan.is_end() && !cancelled_) {
+            TupleBatch batch;
+            batch.reset(&cols_, len_);
+            while (!scan.is_end() && !batch.full()) {
+                const auto &slots = scan.batch();
+                size_t pos = scan.batch_pos();
+                size_t n = std::min(slots.size() - pos, batch.capacity() - batch.num_rows());
+                for (size_t i = pos; i < pos + n; i++) {
+                    batch.append(slots[i].data, slots[i].rid);
+                }
+                scan.advance(n);
+            }
+            pred_.filter(batch);
+            if (!batch.empty()) morsel->batches.push_back(std::move(batch));
+        }
+    }
+
+    // 停止分发并等待所有已提交的任务结束，任务引用了本算子的成员
+    void cancel() {
+        cancelled_ = true;
+        {
+            std::unique_lock<std::mutex> lock(latch_);
+            cv_.wait(lock, [&]() { return in_flight_ == 0; });
+        }
+        morsels_.clear();
+        out_pos_ = 0;
+        cancelled_ = false;
+    }
+};
@@ -0,0 +1,359 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <array>
+#include <functional>
+
+#include "execution_defs.h"
+#include "execution_manager.h"
+#include "executor_abstract.h"
+#include "index/ix.h"
+#include "system/sm.h"
+
+/**
+ * @brief 推送式流水线中的一个哈希连接。构建侧（右儿子）是流水线的物化点，开始执行时全部读入内存并建立哈希表；
+ * 探测侧是流水线中拼接到当前位置的行，行中依次是驱动算子的元组和前面各连接的构建侧元组，格式与HashJoinExecutor的输出相同
+ */
+class PipelineJoin {
+   public:
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    /**
+     * @param build 构建侧的算子
+     * @param conds 连接条件，左侧字段来自探测侧的行
+     * @param probe_cols 探测侧的行到本连接为止的字段
+     */
+    PipelineJoin(std::unique_ptr<AbstractExecutor> build, const std::vector<Condition> &conds,
+                 const std::vector<ColMeta> &probe_cols) {
+        build_ = std::move(build);
+        offset_ = probe_cols.back().offset + probe_cols.back().len;
+        len_ = build_->tupleLen();
+        pred_ = Predicate::compile(conds, probe_cols, build_->cols());
+        for (auto &cond : conds) {
+            if (cond.is_rhs_val || cond.op != OP_EQ) continue;
+            auto lhs = build_->get_col(probe_cols, cond.lhs_col);
+            auto rhs = build_->get_col(build_->cols(), cond.rhs_col);
+            // 与HashJoinExecutor相同，字节形式不同的字段不作为哈希键
+            if (lhs->type != rhs->type || lhs->len != rhs->len) continue;
+            probe_keys_.push_back({lhs->offset, lhs->len, lhs->type});
+            build_keys_.push_back({rhs->offset, rhs->len, rhs->type});
+        }
+    }
+
+    /* 构建侧元组在行中的偏移 */
+    size_t offset() const { return offset_; }
+
+    const std::vector<ColMeta> &build_cols() const { return build_->cols(); }
+
+    const std::vector<JoinKeyCol> &probe_keys() const { return probe_keys_; }
+
+    size_t num_rows() const { return hashes_.size(); }
+
+    /**
+     * @brief 读入构建侧的全部元组并建立哈希表，桶的个数为不小于元组个数的2的幂次
+     * @param mem_bytes 前面各连接的哈希表已经在mem中预留的字节数，建好之后加上本连接的
+     * @return 构建侧超过内存预算时返回false，已经读入的元组被丢弃
+     */
+    bool build(MemoryReservation &mem, size_t *mem_bytes, size_t budget) {
+        rows_.clear();
+        TupleBatch batch;
+        build_->beginBatch();
+        while (build_->NextBatch(batch)) {
+            size_t bytes = rows_.size() + batch.size() * len_;
+            if (bytes > budget || !mem.reserve(*mem_bytes + bytes)) {
+                rows_.clear();
+                return false;
+            }
+            for (size_t k = 0; k < batch.size(); ++k) {
+                rows_.insert(rows_.end(), batch.tuple(k), batch.tuple(k) + len_);
+            }
+        }
+        size_t num_rows = rows_.size() / len_;
+        size_t num_buckets = 1;
+        while (num_buckets < num_rows) num_buckets <<= 1;
+        mask_ = num_buckets - 1;
+        heads_.assign(num_buckets, NIL);
+        next_.resize(num_rows);
+        hashes_.resize(num_rows);
+        for (size_t i = num_rows; i-- > 0;) {
+            uint64_t h = hash_join_key(rows_.data() + i * len_, build_keys_);
+            hashes_[i] = h;
+            next_[i] = heads_[h & mask_];
+            heads_[h & mask_] = static_cast<uint32_t>(i);
+        }
+        *mem_bytes += rows_.size();
+        return true;
+    }
+
+    /* 构建侧全部元组哈希键的运行时过滤器，键的位置是probe_keys() */
+    std::shared_ptr<const RuntimeFilter> make_filter() const {
+        auto filter = std::make_shared<RuntimeFilter>(hashes_.size());
+        for (uint64_t h : hashes_) {
+            filter->add(h);
+        }
+        return filter;
+    }
+
+    /* 对构建侧中与行row满足全部连接条件的每个元组调用fn，按读入顺序 */
+    template <class Fn>
+    void for_each_match(const char *row, Fn &&fn) const {
+        uint64_t h = hash_join_key(row, probe_keys_);
+        for (uint32_t i = heads_[h & mask_]; i != NIL; i = next_[i]) {
+            if (hashes_[i] != h) continue;
+            const char *btup = rows_.data() + static_cast<size_t>(i) * len_;
+            if (pred_.eval(row, btup)) fn(btup);
+        }
+    }
+
+    /* 把构建侧的元组拼接到行中 */
+    void append(char *row, const char *btup) const { memcpy(row + offset_, btup, len_); }
+
+   private:
+    std::unique_ptr<AbstractExecutor> build_;   // 构建侧的算子
+    size_t offset_;                             // 构建侧元组在行中的偏移
+    size_t len_;                                // 构建侧元组的长度
+    Predicate pred_;
+    std::vector<JoinKeyCol> probe_keys_;        // 哈希键在探测侧的行中的字段
+    std::vector<JoinKeyCol> build_keys_;        // 哈希键在构建侧元组中的字段
+    std::vector<char> rows_;
+    std::vector<uint64_t> hashes_;
+    std::vector<uint32_t> next_;
+    std::vector<uint32_t> heads_;
+    uint64_t mask_ = 0;
+};
+
+/* 流水线的终点：按投影列从拼接好的行中复制字段，追加到输出缓冲区 */
+struct PipelineProjectSink {
+    std::vector<std::pair<size_t, const ColMeta *>> fields;    // 每个输出字段在行中的偏移和输出字段
+    size_t len;
+    std::vector<char> *out;
+
+    void push(const char *row) {
+        size_t pos = out->size();
+        out->resize(pos + len);
+        char *dst = out->data() + pos;
+        for (auto &[src, col] : fields) {
+            memcpy(dst + col->offset, row + src, col->len);
+        }
+    }
+};
+
+/* 一条流水线的主体，按驱动算子的批次调用，每个批次一次虚函数调用 */
+class PipelineBody {
+   public:
+    virtual ~PipelineBody() = default;
+
+    /**
+     * @brief 从in的第pos个元组开始逐个推过全部连接和投影，输出缓冲区中不少于limit个元组时停止
+     * @return 下一个没有处理的元组的位置
+     */
+    virtual size_t push(const TupleBatch &in, size_t pos, size_t limit, char *row, PipelineProjectSink &sink) = 0;
+};
+
+/**
+ * @brief N个哈希连接融合成的流水线：每个探测侧元组依次探测各连接的哈希表，每个匹配拼接到行中后探测下一个连接，
+ * 最后一个连接的匹配直接投影到输出中。算子之间不传递批次，也没有虚函数调用，连接的层数是模板参数，编译时展开
+ */
+template <size_t N>
+class FusedPipeline : public PipelineBody {
+   public:
+    explicit FusedPipeline(const std::vector<std::unique_ptr<PipelineJoin>> &joins) {
+        for (size_t k = 0; k < N; k++) joins_[k] = joins[k].get();
+    }
+
+    size_t push(const TupleBatch &in, size_t pos, size_t limit, char *row, PipelineProjectSink &sink) override {
+        size_t len = in.tuple_len();
+        size_t limit_bytes = limit * sink.len;
+        for (; pos < in.size() && sink.out->size() < limit_bytes; pos++) {
+            memcpy(row, in.tuple(pos), len);
+            probe<0>(row, sink);
+        }
+        return pos;
+    }
+
+   private:
+    template <size_t K>
+    void probe(char *row, PipelineProjectSink &sink) {
+        if constexpr (K == N) {
+            sink.push(row);
+        } else {
+            const PipelineJoin *join = joins_[K];
+            join->for_each_match(row, [&](const char *btup) {
+                join->append(row, btup);
+                probe<K + 1>(row, sink);
+            });
+        }
+    }
+
+    std::array<const PipelineJoin *, N> joins_;
+};
+
+/* 按连接的个数选择展开后的流水线 */
+template <size_t N = 1>
+std::unique_ptr<PipelineBody> make_fused_pipeline(const std::vector<std::unique_ptr<PipelineJoin>> &joins) {
+    if constexpr (N > EXEC_PIPELINE_MAX_JOINS) {
+        throw InternalError("Too many joins in one pipeline");
+    } else {
+        if (joins.size() == N) return std::make_unique<FusedPipeline<N>>(joins);
+        return make_fused_pipeline<N + 1>(joins);
+    }
+}
+
+/**
+ * @brief 推送式执行的投影-哈希连接链：select的投影之下是左深的哈希连接链时，整条链在一个算子中执行。
+ * 开始执行时依次读完各连接的构建侧并建立哈希表（流水线在物化点断开，构建侧本身仍由普通算子执行），
+ * 之后从驱动算子（最左侧的输入）逐批取出元组，推过FusedPipeline后写入输出缓冲区，按批次交给上层。
+ * 输出的字段和ProjectionExecutor相同，元组的顺序与HashJoinExecutor可能不同（两者都不保证顺序）。
+ * 流水线总在右儿子上建表、没有溢出到磁盘的能力：构建侧超过EXEC_HASH_JOIN_MEM_SIZE或语句的内存不足时，
+ * 改为用make_fallback生成的普通算子树执行整个计划
+ */
+class PipelineExecutor : public BatchExecutor {
+   public:
+    using Fallback = std::function<std::unique_ptr<AbstractExecutor>()>;
+
+    /**
+     * @param source 驱动算子，最左侧的连接的左儿子
+     * @param builds 从下往上各连接的构建侧算子和连接条件
+     * @param sel_cols 投影列
+     * @param make_fallback 生成执行同一个计划的普通算子树
+     */
+    PipelineExecutor(std::unique_ptr<AbstractExecutor> source,
+                     std::vector<std::pair<std::unique_ptr<AbstractExecutor>, std::vector<Condition>>> builds,
+                     const std::vector<TabCol> &sel_cols, Fallback make_fallback) {
+        source_ = std::move(source);
+        context_ = source_->context_;
+        make_fallback_ = std::move(make_fallback);
+        mem_.set_tracker(mem_tracker());
+
+        // 各连接的探测侧是驱动算子的元组加上前面各连接的构建侧元组
+        std::vector<ColMeta> row_cols = source_->cols();
+        for (auto &[build, conds] : builds) {
+            auto join = std::make_unique<PipelineJoin>(std::move(build), conds, row_cols);
+            for (auto col : join->build_cols()) {
+                col.offset += join->offset();
+                row_cols.push_back(col);
+            }
+            joins_.push_back(std::move(join));
+        }
+        row_.resize(row_cols.back().offset + row_cols.back().len);
+
+        size_t curr_offset = 0;
+        for (auto &sel_col : sel_cols) {
+            auto pos = get_col(row_cols, sel_col);
+            ColMeta col = *pos;
+            col.offset = curr_offset;
+            curr_offset += col.len;
+            cols_.push_back(col);
+            src_offsets_.push_back(pos->offset);
+        }
+        len_ = curr_offset;
+        sink_.len = len_;
+        sink_.out = &out_;
+        for (size_t i = 0; i < cols_.size(); i++) {
+            sink_.fields.emplace_back(src_offsets_[i], &cols_[i]);
+        }
+        body_ = make_fused_pipeline(joins_);
+    }
+
+    size_t tupleLen() const override { return len_; }
+
+    const std::vector<ColMeta> &cols() const override { return cols_; }
+
+    std::string getType() override { return "PipelineExecutor"; }
+
+    ColMeta get_col_offset(const TabCol &target) override { return *get_col(cols_, target); }
+
+    void beginBatch() override {
+        end_ = false;
+        fallback_.reset();
+        out_.clear();
+        out_pos_ = 0;
+        in_pos_ = 0;
+        in_.reset(&source_->cols(), source_->tupleLen());
+        mem_.release();
+        size_t mem_bytes = 0;
+        for (auto &join : joins_) {
+            if (!join->build(mem_, &mem_bytes, EXEC_HASH_JOIN_MEM_SIZE)) {
+                mem_.release();
+                fallback_ = make_fallback_();
+                fallback_->beginBatch();
+                return;
+            }
+            if (join->num_rows() == 0) {
+                end_ = true;  // 构建侧为空，连接结果必然为空
+                return;
+            }
+        }
+        source_->beginBatch();
+        push_build_filters();
+    }
+
+    bool NextBatch(TupleBatch &batch) override {
+        if (fallback_ != nullptr) {
+            return fallback_->NextBatch(batch);
+        }
+        batch.reset(&cols_, len_);
+        while (!batch.full()) {
+            if (out_pos_ < out_.size()) {
+                batch.append(out_.data() + out_pos_, Rid{INVALID_PAGE_ID, -1});
+                out_pos_ += len_;
+                continue;
+            }
+            out_.clear();
+            out_pos_ = 0;
+            if (end_) break;
+            if (in_pos_ >= in_.size()) {
+                in_pos_ = 0;
+                if (!source_->NextBatch(in_)) {
+                    end_ = true;
+                    break;
+                }
+            }
+            in_pos_ = body_->push(in_, in_pos_, batch.capacity(), row_.data(), sink_);
+        }
+        return !batch.empty();
+    }
+
+   private:
+    /**
+     * @brief 哈希键都来自驱动算子的连接把构建侧的运行时过滤器下推给驱动算子，
+     * 其它连接的键包含前面连接的构建侧字段，驱动算子的元组上无法检查
+     */
+    void push_build_filters() {
+        size_t source_len = source_->tupleLen();
+        for (auto &join : joins_) {
+            const auto &keys = join->probe_keys();
+            if (keys.empty() || join->num_rows() > EXEC_RUNTIME_FILTER_MAX_ROWS) continue;
+            bool from_source = std::all_of(keys.begin(), keys.end(), [&](const JoinKeyCol &key) {
+                return static_cast<size_t>(key.offset + key.len) <= source_len;
+            });
+            if (from_source) source_->push_runtime_filter(join->make_filter(), keys);
+        }
+    }
+
+    std::unique_ptr<AbstractExecutor> source_;          // 驱动算子
+    std::vector<std::unique_ptr<PipelineJoin>> joins_;  // 从下往上的各个连接
+    std::unique_ptr<PipelineBody> body_;
+    std::vector<ColMeta> cols_;                         // 投影后的字段
+    std::vector<size_t> src_offsets_;                   // 每个投影字段在行中的偏移
+    size_t len_;
+    std::vector<char> row_;                             // 正在拼接的行
+    PipelineProjectSink sink_;
+    std::vector<char> out_;                             // 流水线输出、尚未交给上层的元组
+    size_t out_pos_ = 0;
+    TupleBatch in_;                                     // 驱动算子的当前批次
+    size_t in_pos_ = 0;                                 // in_中下一个要推入流水线的元组
+    bool end_ = false;
+    MemoryReservation mem_;                             // 各连接的哈希表占用的内存
+    Fallback make_fallback_;
+    std::unique_ptr<AbstractExecutor> fallback_;        // 构建侧放不进内存时代替流水线执行
+};
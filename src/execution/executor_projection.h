@@ -21,10 +21,13 @@ class ProjectionExecutor : public AbstractExecutor {
     std::vector<ColMeta> cols_;                     // 需要投影的字段
     size_t len_;                                    // 字段总长度
     std::vector<size_t> sel_idxs_;                  
+    std::vector<char> view_buf_;                    // view()投影出的当前元组，每个元组复用
+    TupleBatch in_batch_;                           // NextBatch()从子节点取出的批次
 
    public:
     ProjectionExecutor(std::unique_ptr<AbstractExecutor> prev, const std::vector<TabCol> &sel_cols) {
         prev_ = std::move(prev);
+        context_ = prev_->context_;
 
         size_t curr_offset = 0;
         auto &prev_cols = prev_->cols();
@@ -63,13 +66,48 @@ class ProjectionExecutor : public AbstractExecutor {
     std::unique_ptr<RmRecord> Next() override {
         // 1. 检查子算子是否还有数据体体
         if (is_end()) return nullptr;
-        // 2. 从子算子获取当前的原始元组体体
-        auto in = prev_->Next();
-        
-        // 3. 创建一个新的、长度为投影后总长度的空元组体体
-        auto out = std::make_unique<RmRecord>(len_);
-        
-        // 4. 执行字段拷贝逻辑体体。
+        // 2. 创建一个新的、长度为投影后总长度的空元组体体，数据从请求的arena中分配
+        auto out = make_tuple(len_);
+        // 3. 从子算子当前元组的视图中拷贝字段，不再复制整条原始元组体体
+        project(out->data);
+        return out;
+    }
+
+    RecordView view() override {
+        if (is_end()) return RecordView();
+        view_buf_.resize(len_);
+        project(view_buf_.data());
+        return RecordView(view_buf_.data(), len_);
+    }
+
+    void beginBatch() override { prev_->beginBatch(); }
+
+    /**
+     * @brief 从子节点取一批元组，按字段逐列复制到输出批次中；只复制选择向量中的元组，输出批次不再带有被过滤的行
+     */
+    bool NextBatch(TupleBatch &batch) override {
+        batch.reset(&cols_, len_);
+        if (!prev_->NextBatch(in_batch_)) return false;
+        for (size_t k = 0; k < in_batch_.size(); ++k) {
+            batch.append(in_batch_.rid(k));
+        }
+        const auto &prev_cols = prev_->cols();
+        for (size_t i = 0; i < sel_idxs_.size(); ++i) {
+            const auto &src_col = prev_cols[sel_idxs_[i]];
+            const auto &dst_col = cols_[i];
+            for (size_t k = 0; k < in_batch_.size(); ++k) {
+                memcpy(batch.row_data(k) + dst_col.offset, in_batch_.tuple(k) + src_col.offset, dst_col.len);
+            }
+        }
+        return true;
+    }
+
+    Rid &rid() override { return _abstract_rid; }
+
+   private:
+    void project(char *out) {
+        RecordView in = prev_->view();
+        // 执行字段拷贝逻辑体体。
         // sel_idxs_ 存储了“投影后的第 i 列对应原始元组的第几个字段”。
         const auto &prev_cols = prev_->cols();
         for (size_t i = 0; i < sel_idxs_.size(); ++i) {
@@ -80,10 +118,7 @@ class ProjectionExecutor : public AbstractExecutor {
             
             // 使用 memcpy 按照字段长度，将数据从原始 Buffer 拷贝到新记录的对应位置体体。
             // 这一步实现了 SQL 中的列筛选（裁剪不需要的列）和列重排（改变输出顺序）。
-            memcpy(out->data + dst_col.offset, in->data + src_col.offset, dst_col.len);
+            memcpy(out + dst_col.offset, in.data() + src_col.offset, dst_col.len);
         }
-        return out;
     }
-
-    Rid &rid() override { return _abstract_rid; }
 };
\ No newline at end of file
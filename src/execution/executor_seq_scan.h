@@ -10,6 +10,9 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <cmath>
+#include <limits>
+
 #include "execution_defs.h"
 #include "execution_manager.h"
 #include "executor_abstract.h"
@@ -24,9 +27,12 @@ class SeqScanExecutor : public AbstractExecutor {
     std::vector<ColMeta> cols_;         // scan后生成的记录的字段
     size_t len_;                        // scan后生成的每条记录的长度
     std::vector<Condition> fed_conds_;  // 同conds_，两个字段相同
+    Predicate pred_;                    // 编译后的fed_conds_
+    // 上层哈希连接下推的运行时过滤器，以及过滤器的哈希键在扫描输出元组中的位置
+    std::vector<std::pair<std::shared_ptr<const RuntimeFilter>, std::vector<JoinKeyCol>>> runtime_filters_;
 
     Rid rid_;
-    std::unique_ptr<RecScan> scan_;     // table_iterator
+    std::unique_ptr<RmScan> scan_;      // table_iterator，按页面批量扫描
 
     SmManager *sm_manager_;
 
@@ -36,13 +42,14 @@ class SeqScanExecutor : public AbstractExecutor {
         tab_name_ = std::move(tab_name);
         conds_ = std::move(conds);
         TabMeta &tab = sm_manager_->db_.get_table(tab_name_);
-        fh_ = sm_manager_->fhs_.at(tab_name_).get();
+        fh_ = sm_manager_->get_table_handle(tab_name_);
         cols_ = tab.cols;
         len_ = cols_.back().offset + cols_.back().len;
 
         context_ = context;
 
         fed_conds_ = conds_;
+        pred_ = Predicate::compile(fed_conds_, cols_);
     }
 
     size_t tupleLen() const override { return len_; }
@@ -61,73 +68,19 @@ class SeqScanExecutor : public AbstractExecutor {
      *
      */
     void beginTuple() override {
-        // ========== 并发控制：防止幻读（保守版：表级 S 锁）==========
+        // ========== 并发控制：防止幻读（谓词锁）==========
         // 解释：
         // - 记录级 S 锁只能保护“已有记录”，无法阻止其他事务插入“新记录”导致第二次扫描出现幻读。
-        // - 最简单的规避幻读办法：在扫描开始时对整张表加 S 锁（与插入/更新/删除的 IX/X 冲突）。
-        // - 这会降低并发度，但能通过 Lab4 bonus 的幻读测试（文档也允许用表锁获得折半分）。
-        if (context_ != nullptr && context_->txn_ != nullptr && context_->lock_mgr_ != nullptr) {
-            context_->lock_mgr_->lock_shared_on_table(context_->txn_, fh_->GetFd());
-        }
-
-        // 1. 初始化扫描器体体。RmScan 是底层记录层的迭代器，用于遍历表中的所有记录。
-        scan_ = std::make_unique<RmScan>(fh_);
-
-        // 2. 定义谓词判断闭包体体 (Lambda)。用于检查给定的记录是否满足 WHERE 条件。
-        auto satisfy = [&](const Rid &rid) -> bool {
-            // 从底层拉取完整的记录数据体体
-            auto rec = fh_->get_record(rid, context_);
-            // 遍历执行计划中的所有条件（AND 关系）
-            for (auto &cond : fed_conds_) {
-                // 获取左侧列的偏移量和元数据体体
-                auto lhs_it = get_col(cols_, cond.lhs_col);
-                char *lhs_ptr = rec->data + lhs_it->offset;
-                char *rhs_ptr = nullptr;
-                ColType type = lhs_it->type;
-                int len = lhs_it->len;
-
-                // 确定右侧操作数的值指针体体
-                if (cond.is_rhs_val) {
-                    // 右侧是常量：在分析阶段已经转换成了原始二进制体体
-                    rhs_ptr = cond.rhs_val.raw->data;
-                } else {
-                    // 右侧是另一列：从当前记录中提取偏移体体
-                    auto rhs_it = get_col(cols_, cond.rhs_col);
-                    rhs_ptr = rec->data + rhs_it->offset;
-                }
-
-                // 执行类型相关的比较逻辑体体
-                int cmp = 0;
-                if (type == TYPE_INT) {
-                    int a = *(int *)lhs_ptr, b = *(int *)rhs_ptr;
-                    cmp = (a < b) ? -1 : ((a > b) ? 1 : 0);
-                } else if (type == TYPE_FLOAT) {
-                    float a = *(float *)lhs_ptr, b = *(float *)rhs_ptr;
-                    cmp = (a < b) ? -1 : ((a > b) ? 1 : 0);
-                } else {
-                    // 字符串：直接使用字节比较体体
-                    cmp = memcmp(lhs_ptr, rhs_ptr, len);
-                }
+        // - 扫描开始时登记扫描条件：其他事务插入/删除/更新满足条件的记录时与之冲突，条件之外的写入照常并发。
+        // - 其他事务尚未提交的、满足条件的写入也会挡住登记，因此扫描不会读到脏数据，无需再逐行加锁。
+        // 1. 加谓词锁并初始化扫描器体体。RmScan 是底层记录层的迭代器，用于遍历表中的所有记录。
+        open_scan();
 
-                // 根据操作符判断比较结果是否成立体体
-                switch (cond.op) {
-                    case OP_EQ: if (cmp != 0) return false; break;
-                    case OP_NE: if (cmp == 0) return false; break;
-                    case OP_LT: if (!(cmp < 0)) return false; break;
-                    case OP_GT: if (!(cmp > 0)) return false; break;
-                    case OP_LE: if (!(cmp <= 0)) return false; break;
-                    case OP_GE: if (!(cmp >= 0)) return false; break;
-                }
-            }
-            return true; // 所有条件均通过
-        };
-
-        // 3. 寻找起始位置。从头开始遍历记录，直到找到第一个满足条件的记录体体
+        // 2. 寻找起始位置。从头开始遍历记录，直到找到第一个满足条件的记录体体
         for (; !scan_->is_end(); scan_->next()) {
-            Rid r = scan_->rid();
-            // 注意：必须检查该 slot 是否真的存有有效记录（位图标记）体体
-            if (fh_->is_record(r) && satisfy(r)) {
-                rid_ = r; // 记录当前找到的符合条件的 rid
+            // 直接在扫描器固定的页面上计算谓词，不复制记录；扫描开始时已经持有谓词锁，无需再逐行加锁体体
+            if (pred_.eval(scan_->record_data())) {
+                rid_ = scan_->rid(); // 记录当前找到的符合条件的 rid
                 break;
             }
         }
@@ -141,45 +94,48 @@ class SeqScanExecutor : public AbstractExecutor {
         // 如果已经到结尾了，直接返回体体
         if (is_end()) return;
 
-        // 复用同样的 satisfy 逻辑体体
-        auto satisfy = [&](const Rid &rid) -> bool {
-            auto rec = fh_->get_record(rid, context_);
-            for (auto &cond : fed_conds_) {
-                auto lhs_it = get_col(cols_, cond.lhs_col);
-                char *lhs_ptr = rec->data + lhs_it->offset;
-                char *rhs_ptr = cond.is_rhs_val ? cond.rhs_val.raw->data : (rec->data + get_col(cols_, cond.rhs_col)->offset);
-                int cmp = 0;
-                if (lhs_it->type == TYPE_INT) {
-                    int a = *(int *)lhs_ptr, b = *(int *)rhs_ptr;
-                    cmp = (a < b) ? -1 : ((a > b) ? 1 : 0);
-                } else if (lhs_it->type == TYPE_FLOAT) {
-                    float a = *(float *)lhs_ptr, b = *(float *)rhs_ptr;
-                    cmp = (a < b) ? -1 : ((a > b) ? 1 : 0);
-                } else {
-                    cmp = memcmp(lhs_ptr, rhs_ptr, lhs_it->len);
-                }
-                switch (cond.op) {
-                    case OP_EQ: if (cmp != 0) return false; break;
-                    case OP_NE: if (cmp == 0) return false; break;
-                    case OP_LT: if (!(cmp < 0)) return false; break;
-                    case OP_GT: if (!(cmp > 0)) return false; break;
-                    case OP_LE: if (!(cmp <= 0)) return false; break;
-                    case OP_GE: if (!(cmp >= 0)) return false; break;
-                }
-            }
-            return true;
-        };
-
         // 从当前位置的“下一条”开始寻找体体
         for (scan_->next(); !scan_->is_end(); scan_->next()) {
-            Rid r = scan_->rid();
-            if (fh_->is_record(r) && satisfy(r)) {
-                rid_ = r; // 更新当前找到的 rid
+            if (pred_.eval(scan_->record_data())) {
+                rid_ = scan_->rid(); // 更新当前找到的 rid
                 return;
             }
         }
     }
 
+    void beginBatch() override {
+        runtime_filters_.clear();
+        open_scan();
+    }
+
+    /**
+     * @brief 把扫描器当前批次中的记录成段复制到batch中，再在整批元组上逐个条件按列过滤；
+     * 有运行时过滤器时只复制哈希键可能在构建侧中的记录。
+     * 返回前释放扫描器固定的页面，调用者在取下一批之前可以修改这些页面（UPDATE/DELETE边扫描边修改）
+     *
+     * @return 扫描结束且没有满足条件的记录时返回false
+     */
+    bool NextBatch(TupleBatch &batch) override {
+        batch.reset(&cols_, len_);
+        while (batch.empty() && !is_end()) {
+            batch.reset(&cols_, len_);
+            while (!scan_->is_end() && !batch.full()) {
+                const auto &slots = scan_->batch();
+                size_t pos = scan_->batch_pos();
+                size_t n = std::min(slots.size() - pos, batch.capacity() - batch.num_rows());
+                for (size_t i = pos; i < pos + n; i++) {
+                    if (runtime_filters_.empty() || pass_runtime_filters(slots[i].data)) {
+                        batch.append(slots[i].data, slots[i].rid);
+                    }
+                }
+                scan_->advance(n);
+            }
+            pred_.filter(batch);
+        }
+        if (scan_ != nullptr) scan_->release_page();
+        return !batch.empty();
+    }
+
     /**
      * @brief 返回下一个满足扫描条件的记录
      *
@@ -188,9 +144,168 @@ class SeqScanExecutor : public AbstractExecutor {
     std::unique_ptr<RmRecord> Next() override {
         // 按照火山模型，如果迭代结束则返回空指针体体
         if (is_end()) return nullptr;
-        // 否则返回当前 rid 指向的记录体体
-        return fh_->get_record(rid_, context_);
+        // 否则复制当前 rid 指向的记录体体，记录离开扫描算子时才复制到请求的arena中
+        auto out = make_tuple(len_);
+        memcpy(out->data, scan_->record_data(), len_);
+        return out;
+    }
+
+    /**
+     * @brief 返回当前记录在页面中的只读视图，不复制记录数据；页面由扫描器固定，视图在 nextTuple() 之前有效
+     *
+     * @return RecordView
+     */
+    RecordView view() override {
+        if (is_end()) return RecordView();
+        return RecordView(scan_->record_data(), len_);
     }
 
     Rid &rid() override { return rid_; }
+
+    /* 只在批量接口中检查，逐行接口不使用下推的过滤器 */
+    bool push_runtime_filter(const std::shared_ptr<const RuntimeFilter> &filter,
+                             const std::vector<JoinKeyCol> &keys) override {
+        runtime_filters_.emplace_back(filter, keys);
+        return true;
+    }
+
+    /**
+     * @brief 为PAX格式的表构建批量过滤函数，每个与常量比较的条件用过滤内核顺序扫描一次对应字段的列存储区，
+     * 得到页面上各个slot的选择位图，各条件的位图按位与后再按批次中的slot检查
+     *
+     * @return 没有可以按列检查的条件时返回空函数
+     */
+    static RmBatchFilter make_pax_filter(const Predicate &pred) {
+        std::vector<CompiledCond> column_conds;
+        for (auto &cond : pred.conds()) {
+            if (cond.rhs_val != nullptr) column_conds.push_back(cond);
+        }
+        if (column_conds.empty()) return nullptr;
+
+        return [column_conds](const RmScan &scan, std::vector<uint8_t> &keep) {
+            const auto &batch = scan.batch();
+            if (batch.empty()) return;
+            thread_local std::vector<char> bm, cond_bm;
+            size_t n = static_cast<size_t>(batch.back().rid.slot_no) + 1;  // batch中的slot按升序排列
+            int bm_size = static_cast<int>((n + BITMAP_WIDTH - 1) / BITMAP_WIDTH);
+            bm.resize(bm_size);
+            cond_bm.resize(bm_size);
+            for (size_t c = 0; c < column_conds.size(); c++) {
+                auto &cond = column_conds[c];
+                char *dst = c == 0 ? bm.data() : cond_bm.data();
+                cond.kernel(scan.column_data(cond.lhs_idx), cond.len, n, cond.rhs_val, cond.len, dst);
+                if (c > 0) Bitmap::intersect(bm.data(), cond_bm.data(), bm_size);
+            }
+            for (size_t i = 0; i < batch.size(); i++) {
+                if (keep[i] && !Bitmap::is_set(bm.data(), batch[i].rid.slot_no)) keep[i] = 0;
+            }
+        };
+    }
+
+    /**
+     * @brief 为有字典编码字段的slotted格式的表构建批量过滤函数：字典编码字段与常量的等值和不等条件
+     * 在每个批次中先把常量换成字典中的编码，再只比较页面中记录数据里的编码，被排除的记录不再解码。
+     * 编码为转义编码的记录存放的是字段的原值，总是保留；常量不在字典中时换成转义编码，等值条件只保留转义编码的记录，
+     * 不等条件保留全部记录。批次开始之后字典中新加入的值只会出现在之后写入的记录中，因此每个批次重新查找编码
+     *
+     * @return 没有可以按编码检查的条件时返回空函数
+     */
+    static RmBatchFilter make_dict_filter(const Predicate &pred, const RmFileHandle *fh) {
+        struct DictCond {
+            int dict_no;
+            bool eq;
+            const char *rhs_val;
+            int len;
+            uint32_t escape;
+            std::shared_ptr<RmRecord> rhs_raw;
+        };
+        const RmFileHdr &file_hdr = fh->get_file_hdr();
+        std::vector<DictCond> dict_conds;
+        for (auto &cond : pred.conds()) {
+            if (cond.rhs_val == nullptr || (cond.op != OP_EQ && cond.op != OP_NE)) continue;
+            for (int d = 0; d < file_hdr.num_dict_fields; d++) {
+                const RmDictField &field = file_hdr.dict_fields[d];
+                if (field.offset == cond.lhs_offset) {
+                    dict_conds.push_back({d, cond.op == OP_EQ, cond.rhs_val, cond.len,
+                                          RmDictionary::escape_code(field.width), cond.rhs_raw});
+                }
+            }
+        }
+        if (dict_conds.empty()) return nullptr;
+
+        const RmDictionary *dict = &fh->get_dictionary();
+        return [dict_conds, dict](const RmScan &scan, std::vector<uint8_t> &keep) {
+            const auto &batch = scan.batch();
+            for (auto &cond : dict_conds) {
+                uint32_t code = dict->lookup(cond.dict_no, cond.rhs_val, cond.len);
+                for (size_t i = 0; i < batch.size(); i++) {
+                    if (!keep[i]) continue;
+                    uint32_t stored = scan.dict_code(i, cond.dict_no);
+                    if (stored != cond.escape && (stored == code) != cond.eq) keep[i] = 0;
+                }
+            }
+        };
+    }
+
+    /**
+     * @brief 把区间映射字段与常量比较的等值和范围条件换成字段的取值范围，扫描器跳过区间与之不相交的页面。
+     * 常量的原始数据与字段类型相同，按字段类型换成double；小于和大于的端点取相邻的double，比较结果不变
+     *
+     * @return 没有可以按区间映射检查的条件时返回空
+     */
+    static std::vector<RmZoneRange> make_zone_ranges(const Predicate &pred, const RmFileHandle *fh) {
+        const RmFileHdr &file_hdr = fh->get_file_hdr();
+        constexpr double inf = std::numeric_limits<double>::infinity();
+        std::vector<RmZoneRange> ranges;
+        for (auto &cond : pred.conds()) {
+            if (cond.rhs_val == nullptr || cond.op == OP_NE) continue;
+            for (int z = 0; z < file_hdr.num_zone_fields; z++) {
+                const RmZoneField &field = file_hdr.zone_fields[z];
+                if (field.offset != cond.lhs_offset) continue;
+                double v = field.type == TYPE_FLOAT ? *reinterpret_cast<const float *>(cond.rhs_val)
+                                                    : *reinterpret_cast<const int *>(cond.rhs_val);
+                switch (cond.op) {
+                    case OP_EQ: ranges.push_back({z, v, v}); break;
+                    case OP_LT: ranges.push_back({z, -inf, std::nextafter(v, -inf)}); break;
+                    case OP_LE: ranges.push_back({z, -inf, v}); break;
+                    case OP_GT: ranges.push_back({z, std::nextafter(v, inf), inf}); break;
+                    case OP_GE: ranges.push_back({z, v, inf}); break;
+                    default: break;
+                }
+            }
+        }
+        return ranges;
+    }
+
+   private:
+    /* 记录的哈希键可能在每个运行时过滤器的构建侧中 */
+    bool pass_runtime_filters(const char *rec) const {
+        for (auto &[filter, keys] : runtime_filters_) {
+            if (!filter->may_contain(hash_join_key(rec, keys))) return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief 加谓词锁并创建批量模式的扫描器，事务按快照读取时不加锁、按快照扫描
+     * 使用批量模式：每个页面只固定一次，页面上的记录直接在页面中读取，不再逐条访问缓冲池；
+     * PAX格式的表在拼装记录之前先按列检查与常量比较的条件，有字典编码字段的表在解码记录之前先比较编码，
+     * 有区间映射字段上的范围条件时跳过区间不相交的页面
+     */
+    void open_scan() {
+        lock_scan_predicate(fh_, pred_);
+        RmBatchFilter filter;
+        if (fh_->get_file_hdr().format == RM_FORMAT_PAX) {
+            filter = make_pax_filter(pred_);
+        } else if (fh_->get_file_hdr().num_dict_fields > 0) {
+            filter = make_dict_filter(pred_, fh_);
+        }
+        std::vector<RmZoneRange> zone_ranges = make_zone_ranges(pred_, fh_);
+        if (snapshot_read()) {
+            ReadView view = context_->txn_->get_read_view();
+            scan_ = std::make_unique<RmScan>(fh_, true, std::move(filter), &view, std::move(zone_ranges));
+        } else {
+            scan_ = std::make_unique<RmScan>(fh_, true, std::move(filter), nullptr, std::move(zone_ranges));
+        }
+    }
 };
\ No newline at end of file
@@ -0,0 +1,99 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "aggregator.h"
+#include "execution_defs.h"
+#include "execution_manager.h"
+#include "executor_abstract.h"
+#include "index/ix.h"
+#include "system/sm.h"
+
+/**
+ * @brief 流式分组聚合：同一分组的元组在输入中连续出现（没有分组列，或者输入按分组列有序）时使用，
+ * 只保存当前分组的聚合状态，分组键变化时输出上一个分组。没有分组列时即使输入为空也输出一个元组
+ */
+class StreamAggregateExecutor : public BatchExecutor {
+   private:
+    std::unique_ptr<AbstractExecutor> prev_;
+    Aggregator agg_;
+    TupleBatch in_batch_;
+    size_t in_pos_ = 0;                         // 下一个要处理的输入元组在in_batch_中的位置
+    std::vector<char> cur_key_;                 // 当前分组的分组键
+    std::vector<char> cur_state_;               // 当前分组的聚合状态
+    bool has_group_ = false;                    // 是否有还没输出的当前分组
+    bool emitted_ = false;                      // 是否已经输出过分组
+    std::vector<char> key_buf_;
+    bool end_ = false;
+
+   public:
+    StreamAggregateExecutor(std::unique_ptr<AbstractExecutor> prev, const std::vector<TabCol> &group_cols,
+                            const std::vector<AggItem> &aggs)
+        : prev_(std::move(prev)), agg_(*prev_, group_cols, aggs) {
+        context_ = prev_->context_;
+        cur_key_.resize(agg_.key_len());
+        cur_state_.resize(agg_.state_len());
+        key_buf_.resize(agg_.key_len());
+    }
+
+    size_t tupleLen() const override { return agg_.tuple_len(); }
+
+    const std::vector<ColMeta> &cols() const override { return agg_.cols(); }
+
+    std::string getType() override { return "StreamAggregateExecutor"; }
+
+    ColMeta get_col_offset(const TabCol &target) override { return *get_col(agg_.cols(), target); }
+
+    void beginBatch() override {
+        in_batch_.reset(&prev_->cols(), prev_->tupleLen());
+        in_pos_ = 0;
+        has_group_ = false;
+        emitted_ = false;
+        end_ = false;
+        prev_->beginBatch();
+    }
+
+    bool NextBatch(TupleBatch &batch) override {
+        batch.reset(&agg_.cols(), agg_.tuple_len());
+        while (!batch.full() && !end_) {
+            if (in_pos_ >= in_batch_.size()) {
+                in_pos_ = 0;
+                if (prev_->NextBatch(in_batch_)) continue;
+                end_ = true;
+                if (has_group_ || (agg_.key_len() == 0 && !emitted_)) {
+                    if (!has_group_) agg_.init(cur_state_.data());
+                    emit(batch);
+                }
+                break;
+            }
+            const char *tuple = in_batch_.tuple(in_pos_);
+            agg_.key(tuple, key_buf_.data());
+            if (has_group_ && memcmp(key_buf_.data(), cur_key_.data(), agg_.key_len()) != 0) {
+                emit(batch);
+            }
+            if (!has_group_) {
+                cur_key_ = key_buf_;
+                agg_.init(cur_state_.data());
+                has_group_ = true;
+            }
+            agg_.update(cur_state_.data(), tuple);
+            in_pos_++;
+        }
+        return !batch.empty();
+    }
+
+   private:
+    void emit(TupleBatch &batch) {
+        agg_.finalize(cur_key_.data(), cur_state_.data(), batch.append());
+        has_group_ = false;
+        emitted_ = true;
+    }
+};
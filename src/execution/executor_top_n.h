@@ -0,0 +1,112 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "execution_defs.h"
+#include "execution_manager.h"
+#include "execution_sort.h"
+#include "executor_abstract.h"
+#include "index/ix.h"
+#include "system/sm.h"
+
+/**
+ * @brief ORDER BY ... LIMIT n：用大小为n的堆只保留排序后的前n个元组，不对全部输入排序，也不写临时文件。
+ * 堆顶是当前保留的元组中排在最后的一个，新元组只有排在它之前时才替换它。
+ * 排序键相同时先输入的元组在前，与SortExecutor的输出顺序一致
+ */
+class TopNExecutor : public BatchExecutor {
+   private:
+    std::unique_ptr<AbstractExecutor> prev_;
+    SortKey key_;
+    size_t key_len_;                            // 编码后排序键的长度
+    size_t tuple_len_;
+    size_t entry_len_;                          // 每个条目的长度：key_len_ + tuple_len_
+    size_t limit_;
+
+    std::vector<char> entries_;                 // 保留的(排序键, 元组)，每个槽位entry_len_字节
+    std::vector<uint64_t> seqs_;                // 每个槽位中元组的输入序号
+    std::vector<uint32_t> heap_;                // 槽位组成的堆，输入结束后按输出顺序排列
+    std::vector<char> key_buf_;                 // 新元组的排序键
+    size_t out_pos_ = 0;                        // 下一个要输出的heap_下标
+
+   public:
+    TopNExecutor(std::unique_ptr<AbstractExecutor> prev, const std::vector<TabCol> &sel_cols,
+                 const std::vector<bool> &is_desc, size_t limit)
+        : prev_(std::move(prev)), key_(*prev_, sel_cols, is_desc) {
+        context_ = prev_->context_;
+        key_len_ = key_.len();
+        tuple_len_ = prev_->tupleLen();
+        entry_len_ = key_len_ + tuple_len_;
+        limit_ = limit;
+        key_buf_.resize(key_len_);
+    }
+
+    size_t tupleLen() const override { return tuple_len_; }
+
+    const std::vector<ColMeta> &cols() const override { return prev_->cols(); }
+
+    std::string getType() override { return "TopNExecutor"; }
+
+    ColMeta get_col_offset(const TabCol &target) override { return *get_col(prev_->cols(), target); }
+
+    /**
+     * @brief 读入子节点的全部输出，只保留前limit个元组，再把它们按输出顺序排好
+     */
+    void beginBatch() override {
+        entries_.clear();
+        seqs_.clear();
+        heap_.clear();
+        out_pos_ = 0;
+        if (limit_ == 0) return;
+
+        auto before = [&](uint32_t a, uint32_t b) {
+            int res = memcmp(entry(a), entry(b), key_len_);
+            return res != 0 ? res < 0 : seqs_[a] < seqs_[b];
+        };
+        uint64_t seq = 0;
+        prev_->beginBatch();
+        TupleBatch batch;
+        while (prev_->NextBatch(batch)) {
+            for (size_t k = 0; k < batch.size(); ++k, ++seq) {
+                key_.encode(batch.tuple(k), key_buf_.data());
+                uint32_t slot;
+                if (heap_.size() < limit_) {
+                    slot = static_cast<uint32_t>(heap_.size());
+                    entries_.resize(entries_.size() + entry_len_);
+                    seqs_.push_back(0);
+                } else {
+                    // 排序键相同时新元组排在堆顶之后，不替换
+                    if (memcmp(key_buf_.data(), entry(heap_.front()), key_len_) >= 0) continue;
+                    std::pop_heap(heap_.begin(), heap_.end(), before);
+                    slot = heap_.back();
+                    heap_.pop_back();
+                }
+                memcpy(entry(slot), key_buf_.data(), key_len_);
+                memcpy(entry(slot) + key_len_, batch.tuple(k), tuple_len_);
+                seqs_[slot] = seq;
+                heap_.push_back(slot);
+                std::push_heap(heap_.begin(), heap_.end(), before);
+            }
+        }
+        std::sort_heap(heap_.begin(), heap_.end(), before);
+    }
+
+    bool NextBatch(TupleBatch &batch) override {
+        batch.reset(&prev_->cols(), tuple_len_);
+        for (; out_pos_ < heap_.size() && !batch.full(); out_pos_++) {
+            batch.append(entry(heap_[out_pos_]) + key_len_, Rid{INVALID_PAGE_ID, -1});
+        }
+        return !batch.empty();
+    }
+
+   private:
+    char *entry(uint32_t slot) { return entries_.data() + static_cast<size_t>(slot) * entry_len_; }
+};
@@ -12,6 +12,8 @@ See the Mulan PSL v2 for more details. */
 #include "execution_defs.h"
 #include "execution_manager.h"
 #include "executor_abstract.h"
+#include "dml_source.h"
+#include "index_writer.h"
 #include "index/ix.h"
 #include "system/sm.h"
 
@@ -20,21 +22,23 @@ class UpdateExecutor : public AbstractExecutor {
     TabMeta tab_;
     std::vector<Condition> conds_;
     RmFileHandle *fh_;
-    std::vector<Rid> rids_;
+    std::shared_lock<std::shared_mutex> dml_lock_;  // 执行期间表上不会出现新的索引，见RmFileHandle::lock_dml
+    DmlSource source_;
     std::string tab_name_;
     std::vector<SetClause> set_clauses_;
     SmManager *sm_manager_;
 
    public:
     UpdateExecutor(SmManager *sm_manager, const std::string &tab_name, std::vector<SetClause> set_clauses,
-                   std::vector<Condition> conds, std::vector<Rid> rids, Context *context) {
+                   std::vector<Condition> conds, std::unique_ptr<AbstractExecutor> scan, bool spool, Context *context)
+        : source_(std::move(scan), spool, sm_manager->get_table_handle(tab_name), context) {
         sm_manager_ = sm_manager;
         tab_name_ = tab_name;
         set_clauses_ = set_clauses;
+        fh_ = sm_manager_->get_table_handle(tab_name);
+        dml_lock_ = fh_->lock_dml();
         tab_ = sm_manager_->db_.get_table(tab_name);
-        fh_ = sm_manager_->fhs_.at(tab_name).get();
         conds_ = conds;
-        rids_ = rids;
         context_ = context;
     }
     std::unique_ptr<RmRecord> Next() override {
@@ -53,9 +57,11 @@ class UpdateExecutor : public AbstractExecutor {
             }
             if (affected) affected_indexes.push_back(index);
         }
+        // 索引句柄和key布局在语句开始时解析一次，各索引的修改攒成批次后按key顺序执行
+        IndexWriter index_writer(sm_manager_, tab_name_, affected_indexes, context_->txn_);
 
-        // 2. 逐条处理待更新记录体体
-        for (auto &rid : rids_) {
+        // 2. 按批次从扫描算子中取出待更新记录，逐条处理
+        auto update_one = [&](const Rid &rid, char *rec) {
             // ========== 并发控制（关键点：先加锁，再改索引/数据）==========
             // 与 DELETE 同理：UPDATE 可能需要“删旧索引键 + 写新索引键 + 更新记录”。
             // 必须先拿到 IX(表) + X(行)，否则一旦在维护索引过程中触发 abort，会导致索引/数据不一致。
@@ -63,28 +69,19 @@ class UpdateExecutor : public AbstractExecutor {
                 context_->lock_mgr_->lock_IX_on_table(context_->txn_, fh_->GetFd());
                 context_->lock_mgr_->lock_exclusive_on_record(context_->txn_, rid, fh_->GetFd());
             }
+            // 多版本并发控制下还要先取得记录的写权：记录被其他事务修改时在修改索引之前回滚
+            fh_->claim_record(rid, context_);
 
-            // 获取更新前的原始记录体体
-            auto rec = fh_->get_record(rid, context_);
-
-            // 3. 维护受影响索引：删除旧键体体。
-            for (auto &index : affected_indexes) {
-                auto ih = sm_manager_->ihs_.at(sm_manager_->get_ix_manager()->get_index_name(tab_name_, index.cols)).get();
-                std::unique_ptr<char[]> old_key(new char[index.col_tot_len]);
-                int offset = 0;
-                for (int i = 0; i < index.col_num; ++i) {
-                    memcpy(old_key.get() + offset, rec->data + index.cols[i].offset, index.cols[i].len);
-                    offset += index.cols[i].len;
-                }
-                ih->delete_entry(old_key.get(), context_->txn_);
-            }
+            // rec 是更新前的原始记录，下面直接在其上构造新记录
+            // 3. 收集受影响索引的旧键，攒满一批后按索引顺序删除。
+            index_writer.remove(rec, rid);
 
             // 4. 应用更新到内存 Buffer 体体。
             for (auto &sc : set_clauses_) {
                 auto it_col = tab_.get_col(sc.lhs.col_name);
                 // 关键点：将 Value 对象的具体值（int/float/string）直接序列化到记录 Buffer 的对应偏移位置体体。
                 // 我们不直接调用 Value::init_raw，因为那会涉及额外的内存分配和潜在的断言失败体体。
-                char *dest = rec->data + it_col->offset;
+                char *dest = rec + it_col->offset;
                 if (it_col->type == TYPE_INT) {
                     memcpy(dest, &sc.rhs.int_val, sizeof(int));
                 } else if (it_col->type == TYPE_FLOAT) {
@@ -98,21 +95,20 @@ class UpdateExecutor : public AbstractExecutor {
             }
 
             // 5. 将修改后的记录写回磁盘体体
-            fh_->update_record(rid, rec->data, context_);
+            fh_->update_record(rid, rec, context_);
 
-            // 6. 维护受影响索引：根据更新后的数据插入新键体体。
-            for (auto &index : affected_indexes) {
-                auto ih = sm_manager_->ihs_.at(sm_manager_->get_ix_manager()->get_index_name(tab_name_, index.cols)).get();
-                std::unique_ptr<char[]> new_key(new char[index.col_tot_len]);
-                int offset = 0;
-                for (int i = 0; i < index.col_num; ++i) {
-                    // 注意：此时 rec->data 已经是更新后的数据了体体
-                    memcpy(new_key.get() + offset, rec->data + index.cols[i].offset, index.cols[i].len);
-                    offset += index.cols[i].len;
-                }
-                ih->insert_entry(new_key.get(), rid, context_->txn_);
-            }
+            // 6. 收集受影响索引的新键（此时 rec 已经是更新后的数据），与旧键一起批量修改索引。
+            index_writer.insert(rec, rid);
+            index_writer.end_row();
+        };
+        try {
+            source_.for_each(update_one);
+        } catch (...) {
+            // 已经更新的记录的索引项也要修改，保持索引与表一致
+            index_writer.flush();
+            throw;
         }
+        index_writer.flush();
         return nullptr;
     }
 
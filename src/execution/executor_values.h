@@ -0,0 +1,82 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "execution_defs.h"
+#include "execution_manager.h"
+#include "executor_abstract.h"
+#include "index/ix.h"
+#include "system/sm.h"
+
+/**
+ * @brief 输出一组给定的元组中满足条件的元组，视图维护时代替基表上的扫描。
+ * 元组不来自数据文件，没有记录号，也不加锁
+ */
+class ValuesExecutor : public AbstractExecutor {
+   private:
+    std::vector<ColMeta> cols_;                             // 元组的字段
+    size_t len_;                                            // 每个元组的长度
+    Predicate pred_;                                        // 编译后的条件
+    std::shared_ptr<const std::vector<std::string>> rows_;  // 全部元组
+    size_t pos_ = 0;                                        // 当前元组在rows_中的位置
+
+   public:
+    ValuesExecutor(std::vector<ColMeta> cols, const std::vector<Condition> &conds,
+                   std::shared_ptr<const std::vector<std::string>> rows, Context *context) {
+        cols_ = std::move(cols);
+        len_ = cols_.back().offset + cols_.back().len;
+        pred_ = Predicate::compile(conds, cols_);
+        rows_ = std::move(rows);
+        pos_ = rows_->size();
+        context_ = context;
+    }
+
+    size_t tupleLen() const override { return len_; }
+
+    const std::vector<ColMeta> &cols() const override { return cols_; }
+
+    std::string getType() override { return "ValuesExecutor"; }
+
+    ColMeta get_col_offset(const TabCol &target) override { return *get_col(cols_, target); }
+
+    void beginTuple() override {
+        pos_ = 0;
+        skip();
+    }
+
+    void nextTuple() override {
+        if (is_end()) return;
+        pos_++;
+        skip();
+    }
+
+    bool is_end() const override { return pos_ >= rows_->size(); }
+
+    std::unique_ptr<RmRecord> Next() override {
+        if (is_end()) return nullptr;
+        auto out = make_tuple(len_);
+        memcpy(out->data, (*rows_)[pos_].data(), len_);
+        return out;
+    }
+
+    RecordView view() override {
+        if (is_end()) return RecordView();
+        return RecordView((*rows_)[pos_].data(), static_cast<int>(len_));
+    }
+
+    Rid &rid() override { return _abstract_rid; }
+
+   private:
+    /* 从pos_开始找到第一个满足条件的元组 */
+    void skip() {
+        while (pos_ < rows_->size() && !pred_.eval((*rows_)[pos_].data())) pos_++;
+    }
+};
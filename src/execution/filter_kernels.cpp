@@ -0,0 +1,345 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "filter_kernels.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#include "errors.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FILTER_KERNELS_X86
+#endif
+
+namespace {
+
+/* 把低位在前的8位比较掩码转换为Bitmap的位序，Bitmap中第0位是字节的最高位 */
+struct BitReverseTable {
+    uint8_t v[256];
+
+    constexpr BitReverseTable() : v() {
+        for (int i = 0; i < 256; i++) {
+            uint8_t r = 0;
+            for (int b = 0; b < 8; b++) {
+                if (i & (1 << b)) r |= static_cast<uint8_t>(0x80u >> b);
+            }
+            v[i] = r;
+        }
+    }
+};
+
+constexpr BitReverseTable kBitReverse;
+
+inline char bitmap_byte(unsigned mask) { return static_cast<char>(kBitReverse.v[mask & 0xffu]); }
+
+template <CompOp OP>
+inline bool test(int c) {
+    switch (OP) {
+        case OP_EQ: return c == 0;
+        case OP_NE: return c != 0;
+        case OP_LT: return c < 0;
+        case OP_GT: return c > 0;
+        case OP_LE: return c <= 0;
+        case OP_GE: return c >= 0;
+    }
+    return false;
+}
+
+/* 与Predicate中相同的三种比较方式 */
+struct IntCmp {
+    static int cmp(const char *a, const char *b, int) {
+        int x, y;
+        memcpy(&x, a, sizeof(int));
+        memcpy(&y, b, sizeof(int));
+        return (x < y) ? -1 : ((x > y) ? 1 : 0);
+    }
+};
+
+struct FloatCmp {
+    static int cmp(const char *a, const char *b, int) {
+        float x, y;
+        memcpy(&x, a, sizeof(float));
+        memcpy(&y, b, sizeof(float));
+        return (x < y) ? -1 : ((x > y) ? 1 : 0);
+    }
+};
+
+struct BytesCmp {
+    static int cmp(const char *a, const char *b, int len) { return memcmp(a, b, len); }
+};
+
+/* 逐个字段比较[from, n)，from是8的倍数；SIMD内核用它处理不足一个向量的尾部 */
+template <typename Cmp, CompOp OP>
+void scalar_range(const char *base, size_t stride, size_t n, const char *val, int len, char *bm, size_t from) {
+    for (size_t i = from; i < n; i += 8) {
+        unsigned mask = 0;
+        size_t end = std::min(n, i + 8);
+        for (size_t j = i; j < end; j++) {
+            if (test<OP>(Cmp::cmp(base + j * stride, val, len))) mask |= 1u << (j - i);
+        }
+        bm[i / 8] = bitmap_byte(mask);
+    }
+}
+
+template <typename Cmp>
+struct ScalarKernel {
+    template <CompOp OP>
+    static void run(const char *base, size_t stride, size_t n, const char *val, int len, char *bm) {
+        scalar_range<Cmp, OP>(base, stride, n, val, len, bm, 0);
+    }
+};
+
+#ifdef FILTER_KERNELS_X86
+
+/* gather按32位有符号偏移量寻址，超出范围时只能逐个比较 */
+inline bool gather_fits(size_t stride, size_t n) {
+    return n * stride <= static_cast<size_t>(std::numeric_limits<int32_t>::max());
+}
+
+/* 浮点比较使用的谓词：等于包括无序的情况，与FloatCmp把NaN视为相等保持一致 */
+template <CompOp OP>
+constexpr int float_pred() {
+    switch (OP) {
+        case OP_EQ: return _CMP_EQ_UQ;
+        case OP_NE: return _CMP_NEQ_OQ;
+        case OP_LT: return _CMP_LT_OQ;
+        case OP_GT: return _CMP_GT_OQ;
+        case OP_LE: return _CMP_NGT_UQ;
+        case OP_GE: return _CMP_NLT_UQ;
+    }
+    return _CMP_EQ_UQ;
+}
+
+template <CompOp OP>
+constexpr int int_pred() {
+    switch (OP) {
+        case OP_EQ: return _MM_CMPINT_EQ;
+        case OP_NE: return _MM_CMPINT_NE;
+        case OP_LT: return _MM_CMPINT_LT;
+        case OP_GT: return _MM_CMPINT_NLE;
+        case OP_LE: return _MM_CMPINT_LE;
+        case OP_GE: return _MM_CMPINT_NLT;
+    }
+    return _MM_CMPINT_EQ;
+}
+
+/* 比较指令的谓词必须是立即数，未开启优化时函数调用不会被当作常量 */
+template <CompOp OP>
+constexpr int kFloatPred = float_pred<OP>();
+
+template <CompOp OP>
+constexpr int kIntPred = int_pred<OP>();
+
+struct IntAvx2 {
+    template <CompOp OP>
+    __attribute__((target("avx2"))) static unsigned mask(__m256i x, __m256i y) {
+        switch (OP) {
+            case OP_EQ: return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(x, y)));
+            case OP_NE: return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(x, y))) ^ 0xffu;
+            case OP_LT: return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(y, x)));
+            case OP_GT: return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(x, y)));
+            case OP_LE: return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(x, y))) ^ 0xffu;
+            case OP_GE: return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(y, x))) ^ 0xffu;
+        }
+        return 0;
+    }
+
+    template <CompOp OP>
+    __attribute__((target("avx2"))) static void run(const char *base, size_t stride, size_t n, const char *val,
+                                                    int len, char *bm) {
+        size_t i = 0;
+        if (gather_fits(stride, n)) {
+            int s = static_cast<int>(stride);
+            __m256i y = _mm256_set1_epi32(*reinterpret_cast<const int *>(val));
+            __m256i idx = _mm256_setr_epi32(0, s, 2 * s, 3 * s, 4 * s, 5 * s, 6 * s, 7 * s);
+            __m256i step = _mm256_set1_epi32(8 * s);
+            for (; i + 8 <= n; i += 8) {
+                __m256i x = stride == sizeof(int)
+                                ? _mm256_loadu_si256(reinterpret_cast<const __m256i *>(base + i * sizeof(int)))
+                                : _mm256_i32gather_epi32(reinterpret_cast<const int *>(base), idx, 1);
+                idx = _mm256_add_epi32(idx, step);
+                bm[i / 8] = bitmap_byte(mask<OP>(x, y));
+            }
+        }
+        scalar_range<IntCmp, OP>(base, stride, n, val, len, bm, i);
+    }
+};
+
+struct FloatAvx2 {
+    template <CompOp OP>
+    __attribute__((target("avx2"))) static void run(const char *base, size_t stride, size_t n, const char *val,
+                                                    int len, char *bm) {
+        size_t i = 0;
+        if (gather_fits(stride, n)) {
+            int s = static_cast<int>(stride);
+            __m256 y = _mm256_set1_ps(*reinterpret_cast<const float *>(val));
+            __m256i idx = _mm256_setr_epi32(0, s, 2 * s, 3 * s, 4 * s, 5 * s, 6 * s, 7 * s);
+            __m256i step = _mm256_set1_epi32(8 * s);
+            for (; i + 8 <= n; i += 8) {
+                __m256 x = stride == sizeof(float)
+                               ? _mm256_loadu_ps(reinterpret_cast<const float *>(base + i * sizeof(float)))
+                               : _mm256_i32gather_ps(reinterpret_cast<const float *>(base), idx, 1);
+                idx = _mm256_add_epi32(idx, step);
+                bm[i / 8] = bitmap_byte(_mm256_movemask_ps(_mm256_cmp_ps(x, y, kFloatPred<OP>)));
+            }
+        }
+        scalar_range<FloatCmp, OP>(base, stride, n, val, len, bm, i);
+    }
+};
+
+/**
+ * 定长字符串逐个字段比较，每次比较32或16个字节，找到第一个不同的字节后按无符号字节比较，
+ * 结果的符号与memcmp相同
+ */
+struct BytesAvx2 {
+    __attribute__((target("avx2"))) static int cmp(const char *a, const char *b, int len) {
+        int i = 0;
+        for (; i + 32 <= len; i += 32) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+            __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+            unsigned eq = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)));
+            if (eq != 0xffffffffu) {
+                int k = i + __builtin_ctz(~eq);
+                return static_cast<uint8_t>(a[k]) - static_cast<uint8_t>(b[k]);
+            }
+        }
+        for (; i + 16 <= len; i += 16) {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+            __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+            unsigned eq = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)));
+            if (eq != 0xffffu) {
+                int k = i + __builtin_ctz(~eq);
+                return static_cast<uint8_t>(a[k]) - static_cast<uint8_t>(b[k]);
+            }
+        }
+        return i < len ? memcmp(a + i, b + i, len - i) : 0;
+    }
+
+    template <CompOp OP>
+    __attribute__((target("avx2"))) static void run(const char *base, size_t stride, size_t n, const char *val,
+                                                    int len, char *bm) {
+        for (size_t i = 0; i < n; i += 8) {
+            unsigned m = 0;
+            size_t end = std::min(n, i + 8);
+            for (size_t j = i; j < end; j++) {
+                if (test<OP>(cmp(base + j * stride, val, len))) m |= 1u << (j - i);
+            }
+            bm[i / 8] = bitmap_byte(m);
+        }
+    }
+};
+
+struct IntAvx512 {
+    template <CompOp OP>
+    __attribute__((target("avx512f"))) static void run(const char *base, size_t stride, size_t n, const char *val,
+                                                       int len, char *bm) {
+        size_t i = 0;
+        if (gather_fits(stride, n)) {
+            int s = static_cast<int>(stride);
+            __m512i y = _mm512_set1_epi32(*reinterpret_cast<const int *>(val));
+            __m512i idx = _mm512_mullo_epi32(
+                _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_epi32(s));
+            __m512i step = _mm512_set1_epi32(16 * s);
+            for (; i + 16 <= n; i += 16) {
+                __m512i x = stride == sizeof(int)
+                                ? _mm512_loadu_si512(base + i * sizeof(int))
+                                : _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), 0xffff, idx, base, 1);
+                idx = _mm512_add_epi32(idx, step);
+                unsigned m = _mm512_cmp_epi32_mask(x, y, kIntPred<OP>);
+                bm[i / 8] = bitmap_byte(m);
+                bm[i / 8 + 1] = bitmap_byte(m >> 8);
+            }
+        }
+        scalar_range<IntCmp, OP>(base, stride, n, val, len, bm, i);
+    }
+};
+
+struct FloatAvx512 {
+    template <CompOp OP>
+    __attribute__((target("avx512f"))) static void run(const char *base, size_t stride, size_t n, const char *val,
+                                                       int len, char *bm) {
+        size_t i = 0;
+        if (gather_fits(stride, n)) {
+            int s = static_cast<int>(stride);
+            __m512 y = _mm512_set1_ps(*reinterpret_cast<const float *>(val));
+            __m512i idx = _mm512_mullo_epi32(
+                _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_epi32(s));
+            __m512i step = _mm512_set1_epi32(16 * s);
+            for (; i + 16 <= n; i += 16) {
+                __m512 x = stride == sizeof(float)
+                               ? _mm512_loadu_ps(base + i * sizeof(float))
+                               : _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xffff, idx, base, 1);
+                idx = _mm512_add_epi32(idx, step);
+                unsigned m = _mm512_cmp_ps_mask(x, y, kFloatPred<OP>);
+                bm[i / 8] = bitmap_byte(m);
+                bm[i / 8 + 1] = bitmap_byte(m >> 8);
+            }
+        }
+        scalar_range<FloatCmp, OP>(base, stride, n, val, len, bm, i);
+    }
+};
+
+#endif
+
+template <typename Impl>
+FilterKernel select_op(CompOp op) {
+    switch (op) {
+        case OP_EQ: return &Impl::template run<OP_EQ>;
+        case OP_NE: return &Impl::template run<OP_NE>;
+        case OP_LT: return &Impl::template run<OP_LT>;
+        case OP_GT: return &Impl::template run<OP_GT>;
+        case OP_LE: return &Impl::template run<OP_LE>;
+        case OP_GE: return &Impl::template run<OP_GE>;
+    }
+    throw InternalError("Unexpected comparison operator");
+}
+
+FilterIsa detect_filter_isa() {
+#ifdef FILTER_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return FILTER_ISA_AVX512;
+    if (__builtin_cpu_supports("avx2")) return FILTER_ISA_AVX2;
+#endif
+    return FILTER_ISA_SCALAR;
+}
+
+}  // namespace
+
+FilterIsa filter_isa() {
+    static const FilterIsa isa = detect_filter_isa();
+    return isa;
+}
+
+FilterKernel filter_kernel(ColType type, CompOp op, FilterIsa isa) {
+    if (isa > filter_isa()) isa = filter_isa();
+    switch (type) {
+        case TYPE_INT:
+#ifdef FILTER_KERNELS_X86
+            if (isa >= FILTER_ISA_AVX512) return select_op<IntAvx512>(op);
+            if (isa >= FILTER_ISA_AVX2) return select_op<IntAvx2>(op);
+#endif
+            return select_op<ScalarKernel<IntCmp>>(op);
+        case TYPE_FLOAT:
+#ifdef FILTER_KERNELS_X86
+            if (isa >= FILTER_ISA_AVX512) return select_op<FloatAvx512>(op);
+            if (isa >= FILTER_ISA_AVX2) return select_op<FloatAvx2>(op);
+#endif
+            return select_op<ScalarKernel<FloatCmp>>(op);
+        default:
+#ifdef FILTER_KERNELS_X86
+            if (isa >= FILTER_ISA_AVX2) return select_op<BytesAvx2>(op);
+#endif
+            return select_op<ScalarKernel<BytesCmp>>(op);
+    }
+}
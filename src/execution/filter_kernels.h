@@ -0,0 +1,35 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <cstddef>
+
+#include "common/common.h"
+#include "defs.h"
+
+/* 过滤内核使用的指令集，运行时按CPU支持的指令选择 */
+enum FilterIsa { FILTER_ISA_SCALAR, FILTER_ISA_AVX2, FILTER_ISA_AVX512 };
+
+/**
+ * @brief 过滤内核：把从base开始、每隔stride字节的n个字段值与常量val比较，len为字段长度，
+ * 第i个字段满足条件时把选择位图bm的第i位置1，否则置0；bm按Bitmap的位序存放，至少有(n+7)/8个字节，不需要预先清零
+ */
+using FilterKernel = void (*)(const char *base, size_t stride, size_t n, const char *val, int len, char *bm);
+
+/* 当前CPU支持的最快的指令集，只检测一次 */
+FilterIsa filter_isa();
+
+/**
+ * @brief 按字段类型和运算符选出过滤内核，比较语义与Predicate::compare_fn相同
+ *
+ * @param isa 使用的指令集，CPU不支持或该类型没有对应实现时退回到较低的指令集
+ */
+FilterKernel filter_kernel(ColType type, CompOp op, FilterIsa isa = filter_isa());
@@ -0,0 +1,121 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "index/ix.h"
+#include "system/sm.h"
+
+/**
+ * @brief UPDATE/DELETE语句的索引维护。语句开始时解析一次各索引的句柄和key布局，
+ * 之后逐行收集要删除和插入的(key, rid)，每攒满EXEC_DML_INDEX_BATCH行，对每个B+树索引按索引顺序排序，
+ * 先批量删除旧key再批量插入新key，相邻的修改落在同一个叶子结点上，不必每行都从根结点下降；哈希索引和LSM索引逐条修改
+ */
+class IndexWriter {
+   public:
+    IndexWriter(SmManager *sm_manager, const std::string &tab_name, const std::vector<IndexMeta> &indexes,
+                Transaction *txn)
+        : txn_(txn) {
+        for (auto &index : indexes) {
+            Target target;
+            target.index = index;
+            if (is_point_index(index.type)) {
+                target.hh = sm_manager->get_point_index_handle(tab_name, index);
+            } else {
+                target.ih = sm_manager->get_index_handle(tab_name, index);
+            }
+            targets_.push_back(std::move(target));
+        }
+    }
+
+    bool empty() const { return targets_.empty(); }
+
+    /* 删除记录rec在各索引中的key */
+    void remove(const char *rec, const Rid &rid) {
+        for (auto &target : targets_) {
+            append_key(target, rec, target.del_keys);
+            target.del_rids.push_back(rid);
+        }
+    }
+
+    /* 插入记录rec在各索引中的key，一行的remove和insert都收集完后调用end_row */
+    void insert(const char *rec, const Rid &rid) {
+        for (auto &target : targets_) {
+            append_key(target, rec, target.ins_keys);
+            target.ins_rids.push_back(rid);
+        }
+    }
+
+    void end_row() {
+        if (++pending_rows_ >= EXEC_DML_INDEX_BATCH) flush();
+    }
+
+    /* 把收集到的修改应用到各个索引上，先删除后插入 */
+    void flush() {
+        for (auto &target : targets_) {
+            int num_del = static_cast<int>(target.del_rids.size());
+            int num_ins = static_cast<int>(target.ins_rids.size());
+            if (target.ih != nullptr) {
+                if (num_del > 0) {
+                    target.ih->sort_entries(target.del_keys.data(), target.del_rids.data(), num_del);
+                    target.ih->delete_entries(target.del_keys.data(), target.del_rids.data(), num_del, txn_);
+                }
+                if (num_ins > 0) {
+                    target.ih->sort_entries(target.ins_keys.data(), target.ins_rids.data(), num_ins);
+                    target.ih->insert_entries(target.ins_keys.data(), target.ins_rids.data(), num_ins, txn_);
+                }
+            } else {
+                int key_len = target.index.col_tot_len;
+                for (int e = 0; e < num_del; e++) {
+                    target.hh->delete_entry(target.del_keys.data() + static_cast<size_t>(e) * key_len,
+                                            target.del_rids[e], txn_);
+                }
+                for (int e = 0; e < num_ins; e++) {
+                    target.hh->insert_entry(target.ins_keys.data() + static_cast<size_t>(e) * key_len,
+                                            target.ins_rids[e], txn_);
+                }
+            }
+            target.del_keys.clear();
+            target.del_rids.clear();
+            target.ins_keys.clear();
+            target.ins_rids.clear();
+        }
+        pending_rows_ = 0;
+    }
+
+   private:
+    struct Target {
+        IndexMeta index;
+        IxIndexHandle *ih = nullptr;        // B+树索引
+        IxPointIndexHandle *hh = nullptr;   // 哈希索引或LSM索引
+        std::vector<char> del_keys;         // 要删除的key，连续存放
+        std::vector<Rid> del_rids;
+        std::vector<char> ins_keys;         // 要插入的key，连续存放
+        std::vector<Rid> ins_rids;
+    };
+
+    // 按索引的字段顺序从记录中拼出key，追加到keys末尾
+    static void append_key(const Target &target, const char *rec, std::vector<char> &keys) {
+        size_t offset = keys.size();
+        keys.resize(offset + target.index.col_tot_len);
+        for (auto &col : target.index.cols) {
+            memcpy(keys.data() + offset, rec + col.offset, col.len);
+            offset += col.len;
+        }
+    }
+
+    Transaction *txn_;
+    std::vector<Target> targets_;
+    size_t pending_rows_ = 0;
+};
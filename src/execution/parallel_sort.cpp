@@ -0,0 +1,357 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "parallel_sort.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "errors.h"
+#include "worker_pool.h"
+
+static constexpr size_t SORT_SAMPLES_PER_PART = 8;     // 内存中归并时每段从每块中采样的分割点候选数
+
+ParallelSorter::ParallelSorter(size_t key_len, size_t entry_len, size_t mem_budget, MemoryTracker *tracker,
+                               size_t parallelism)
+    : key_len_(key_len), entry_len_(entry_len), mem_budget_(mem_budget), mem_(tracker) {
+    assert(key_len_ <= entry_len_ && entry_len_ > 0);
+    parallelism_ = parallelism > 0 ? parallelism : WorkerPool::instance().size();
+    // 预算平分给各个线程，使内存写满之前所有线程都有块可排；块太小时任务的开销超过排序本身
+    size_t chunk_size = std::min(std::max(mem_budget_ / parallelism_, EXEC_SORT_MIN_CHUNK), mem_budget_);
+    chunk_rows_ = std::clamp<size_t>(chunk_size / entry_len_, 1, UINT32_MAX);
+}
+
+/* 任务引用了本对象的成员，等待它们结束后才能析构 */
+ParallelSorter::~ParallelSorter() {
+    std::unique_lock<std::mutex> lock(latch_);
+    cv_.wait(lock, [&]() { return in_flight_ == 0; });
+}
+
+/**
+ * @description: 在工作线程中执行task，异常保存在error_中，由等待任务的调用线程重新抛出
+ */
+template <typename Task>
+void ParallelSorter::submit(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(latch_);
+        in_flight_++;
+    }
+    WorkerPool::instance().submit([this, task]() {
+        std::exception_ptr error;
+        try {
+            task();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(latch_);
+        if (error != nullptr && error_ == nullptr) error_ = error;
+        in_flight_--;
+        cv_.notify_all();
+    });
+}
+
+/* 等待到执行中的任务不超过max_in_flight个，有任务失败时等待所有任务结束后抛出它的异常 */
+void ParallelSorter::wait(size_t max_in_flight) {
+    std::unique_lock<std::mutex> lock(latch_);
+    cv_.wait(lock, [&]() { return in_flight_ <= max_in_flight || (error_ != nullptr && in_flight_ == 0); });
+    if (error_ != nullptr) {
+        std::rethrow_exception(error_);
+    }
+}
+
+/**
+ * @description: 加入一个条目，由调用者在返回的位置填入entry_len字节，在下一次调用add或finish之前有效。
+ * 当前块满时先交给工作线程排序；内存中的条目超过预算或者内存记账器拒绝继续预留时先写出run，
+ * 内存中没有条目时仍然不足则抛出MemoryLimitError
+ * @return {char*} 新条目的位置
+ */
+char *ParallelSorter::add() {
+    assert(!finished_);
+    if (filling_ && chunks_.back()->rows(entry_len_) >= chunk_rows_) {
+        seal();
+    }
+    if (buffered_rows_ > 0 &&
+        (buffered_rows_ * entry_len_ >= mem_budget_ || !mem_.reserve(entry_mem(buffered_rows_ + 1)))) {
+        spill();
+    }
+    if (!mem_.reserve(entry_mem(buffered_rows_ + 1))) {
+        throw MemoryLimitError(entry_mem(1));
+    }
+    if (!filling_) {
+        chunks_.push_back(std::make_unique<Chunk>());
+        filling_ = true;
+        num_chunks_++;
+    }
+    std::vector<char> &data = chunks_.back()->data;
+    size_t base = data.size();
+    data.resize(base + entry_len_);
+    buffered_rows_++;
+    return data.data() + base;
+}
+
+/**
+ * @description: 块内的稳定排序。先把排序键的前8字节按大端读成整数，与下标一起排序，
+ * 前缀不同的条目只比较整数，不访问条目本身；前缀相同时再比较剩余的排序键，排序键相同时按下标
+ */
+void ParallelSorter::sort_chunk(Chunk *chunk) const {
+    size_t n = chunk->rows(entry_len_);
+    size_t prefix_len = std::min<size_t>(key_len_, sizeof(uint64_t));
+    chunk->items.resize(n);
+    const unsigned char *base = reinterpret_cast<const unsigned char *>(chunk->data.data());
+    for (size_t i = 0; i < n; i++) {
+        const unsigned char *key = base + i * entry_len_;
+        uint64_t prefix = 0;
+        for (size_t j = 0; j < sizeof(uint64_t); j++) prefix = (prefix << 8) | (j < prefix_len ? key[j] : 0);
+        chunk->items[i] = {prefix, static_cast<uint32_t>(i)};
+    }
+    const char *data = chunk->data.data();
+    size_t rest = key_len_ - prefix_len;
+    std::sort(chunk->items.begin(), chunk->items.end(), [&](const SortItem &a, const SortItem &b) {
+        if (a.prefix != b.prefix) return a.prefix < b.prefix;
+        if (rest > 0) {
+            int res = memcmp(data + static_cast<size_t>(a.idx) * entry_len_ + prefix_len,
+                             data + static_cast<size_t>(b.idx) * entry_len_ + prefix_len, rest);
+            if (res != 0) return res < 0;
+        }
+        return a.idx < b.idx;
+    });
+}
+
+/* 当前块已经填充完毕，交给工作线程排序；同时排序的块不超过线程数 */
+void ParallelSorter::seal() {
+    filling_ = false;
+    Chunk *chunk = chunks_.back().get();
+    wait(parallelism_ - 1);
+    submit([this, chunk]() { sort_chunk(chunk); });
+}
+
+/**
+ * @description: 等待内存中的块排序完成，按块的顺序把每块写成一个run后释放内存。
+ * 先加入的条目在序号小的run中，归并时排序键相同的条目先输出序号小的run，保证排序稳定。
+ * 写出由调用线程完成，临时文件本身在后台异步写入，写出的字节数计入当前语句
+ */
+void ParallelSorter::spill() {
+    if (filling_) {
+        seal();
+    }
+    wait(0);
+    for (auto &chunk : chunks_) {
+        Run run;
+        run.file = TempStorage::instance().create_file();
+        for (size_t pos = 0; pos < chunk->items.size(); pos++) {
+            run.file->append(entry(*chunk, pos), entry_len_);
+        }
+        run.file->finish_write();
+        runs_.push_back(std::move(run));
+        chunk.reset();
+    }
+    chunks_.clear();
+    buffered_rows_ = 0;
+    mem_.release();
+}
+
+/**
+ * @description: 结束输入。只有一块时由调用线程直接排序；全部在内存中时并行归并各块；
+ * 否则写出剩下的块，打开所有run准备归并
+ */
+void ParallelSorter::finish() {
+    assert(!finished_);
+    finished_ = true;
+    if (runs_.empty()) {
+        if (filling_ && chunks_.size() == 1) {
+            filling_ = false;
+            sort_chunk(chunks_[0].get());
+        } else if (filling_) {
+            seal();
+        }
+        wait(0);
+        if (chunks_.size() <= 1) return;
+        // 输出数组放不下时与内存不足一样写出run，改为从磁盘归并
+        if (mem_.reserve(entry_mem(buffered_rows_) + buffered_rows_ * sizeof(const char *))) {
+            merge_in_memory();
+            return;
+        }
+    }
+    spill();
+    open_runs();
+}
+
+/**
+ * @description: 块chunk中排在分割点s之前的条目数。条目的全局顺序为(排序键, 块号, 块内位置)，
+ * 块号小于s所在块时排序键等于分割点的条目都排在它之前，块号更大时都排在它之后
+ */
+size_t ParallelSorter::split_point(size_t c, const Splitter &s) const {
+    if (c == s.chunk) return s.pos;
+    const Chunk &chunk = *chunks_[c];
+    const char *key = entry(*chunks_[s.chunk], s.pos);
+    size_t lo = 0, hi = chunk.items.size();
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        int res = memcmp(entry(chunk, mid), key, key_len_);
+        if (res < 0 || (res == 0 && c < s.chunk)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * @description: 把内存中已排序的各块归并到output_。从各块中等距采样候选分割点，排序后取分位点把输出分为若干段，
+ * 用二分查找求出每段在各块中的范围，每段由一个工作线程归并到output_中各自的位置，段之间不需要同步
+ */
+void ParallelSorter::merge_in_memory() {
+    size_t num_chunks = chunks_.size();
+    output_.resize(buffered_rows_);
+    size_t parts = std::clamp<size_t>(buffered_rows_ * entry_len_ / EXEC_SORT_MIN_CHUNK, 1, parallelism_);
+
+    auto splitter_less = [&](const Splitter &a, const Splitter &b) {
+        int res = memcmp(entry(*chunks_[a.chunk], a.pos), entry(*chunks_[b.chunk], b.pos), key_len_);
+        if (res != 0) return res < 0;
+        return a.chunk != b.chunk ? a.chunk < b.chunk : a.pos < b.pos;
+    };
+    std::vector<Splitter> samples;
+    size_t samples_per_chunk = parts * SORT_SAMPLES_PER_PART;
+    for (size_t c = 0; c < num_chunks; c++) {
+        size_t rows = chunks_[c]->items.size();
+        for (size_t i = 1; i <= samples_per_chunk && rows > 0; i++) {
+            samples.push_back({c, i * rows / (samples_per_chunk + 1)});
+        }
+    }
+    std::sort(samples.begin(), samples.end(), splitter_less);
+
+    // bounds[p][c]为第p段在块c中的起始位置，最后一行为各块的条目数
+    std::vector<std::vector<size_t>> bounds(parts + 1, std::vector<size_t>(num_chunks, 0));
+    for (size_t p = 1; p < parts; p++) {
+        const Splitter &s = samples[p * samples.size() / parts];
+        for (size_t c = 0; c < num_chunks; c++) {
+            bounds[p][c] = split_point(c, s);
+        }
+    }
+    for (size_t c = 0; c < num_chunks; c++) {
+        bounds[parts][c] = chunks_[c]->items.size();
+    }
+    size_t offset = 0;
+    for (size_t p = 0; p < parts; p++) {
+        const char **out = output_.data() + offset;
+        for (size_t c = 0; c < num_chunks; c++) {
+            offset += bounds[p + 1][c] - bounds[p][c];
+        }
+        if (parts == 1) {
+            merge_part(bounds[0], bounds[1], out);
+        } else {
+            submit([this, begin = bounds[p], end = bounds[p + 1], out]() { merge_part(begin, end, out); });
+        }
+    }
+    wait(0);
+}
+
+/* 用小根堆归并各块中[begin[c], end[c])的条目，排序键相同时先输出块号小的 */
+void ParallelSorter::merge_part(const std::vector<size_t> &begin, const std::vector<size_t> &end,
+                                const char **out) const {
+    std::vector<size_t> pos = begin;
+    auto greater = [&](size_t a, size_t b) {
+        int res = memcmp(entry(*chunks_[a], pos[a]), entry(*chunks_[b], pos[b]), key_len_);
+        return res != 0 ? res > 0 : a > b;
+    };
+    std::vector<size_t> heap;
+    for (size_t c = 0; c < begin.size(); c++) {
+        if (pos[c] < end[c]) heap.push_back(c);
+    }
+    std::make_heap(heap.begin(), heap.end(), greater);
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), greater);
+        size_t c = heap.back();
+        *out++ = entry(*chunks_[c], pos[c]++);
+        if (pos[c] < end[c]) {
+            std::push_heap(heap.begin(), heap.end(), greater);
+        } else {
+            heap.pop_back();
+        }
+    }
+}
+
+/* 为每个run分配读缓冲区并读入第一块，建立败者树 */
+void ParallelSorter::open_runs() {
+    if (runs_.empty()) return;
+    size_t read_size =
+        std::max<size_t>(std::min(mem_budget_ / runs_.size(), EXEC_SORT_READ_SIZE) / entry_len_, 1) * entry_len_;
+    // 归并时内存中只有各run的读缓冲区和临时文件的预读块，它们已经是最小的需求，不能再通过溢出减少
+    mem_.force((read_size + runs_[0].file->get_buffer_size()) * runs_.size());
+    for (auto &run : runs_) {
+        run.file->rewind();
+        run.buf.resize(read_size);
+        run.end = run.file->read(run.buf.data(), run.buf.size());
+        run.pos = 0;
+        run.done = run.end < entry_len_;
+    }
+    tree_.assign(runs_.size(), runs_.size());
+    for (size_t i = runs_.size(); i-- > 0;) {
+        adjust(i);
+    }
+}
+
+/* 移动到run中的下一个条目，缓冲区读完时从文件中继续读入 */
+void ParallelSorter::advance(Run &run) {
+    run.pos += entry_len_;
+    if (run.pos + entry_len_ <= run.end) return;
+    run.end = run.file->read(run.buf.data(), run.buf.size());
+    run.pos = 0;
+    run.done = run.end < entry_len_;
+}
+
+/* run a的当前条目是否应当排在run b之前；runs_.size()表示建树时的哨兵，排在所有run之前；
+   已经读完的run排在最后，排序键相同时先写出的run在前，保证排序稳定 */
+bool ParallelSorter::beats(size_t a, size_t b) const {
+    size_t k = runs_.size();
+    if (a == k) return true;
+    if (b == k) return false;
+    if (runs_[a].done) return false;
+    if (runs_[b].done) return true;
+    int res = memcmp(current(a), current(b), key_len_);
+    return res != 0 ? res < 0 : a < b;
+}
+
+/* run s的当前条目改变后，从它的叶子向上和各结点保存的败者比较，重新确定胜者 */
+void ParallelSorter::adjust(size_t s) {
+    size_t k = runs_.size();
+    for (size_t t = (s + k) / 2; t > 0; t /= 2) {
+        if (beats(tree_[t], s)) std::swap(s, tree_[t]);
+    }
+    tree_[0] = s;
+}
+
+/**
+ * @description: 按排序键的升序取出下一个条目
+ * @return {const char*} 条目，在下一次调用next之前有效；全部取出后返回nullptr
+ */
+const char *ParallelSorter::next() {
+    assert(finished_);
+    if (runs_.empty()) {
+        if (chunks_.empty()) return nullptr;
+        if (chunks_.size() == 1) {
+            const Chunk &chunk = *chunks_[0];
+            return out_pos_ < chunk.items.size() ? entry(chunk, out_pos_++) : nullptr;
+        }
+        return out_pos_ < output_.size() ? output_[out_pos_++] : nullptr;
+    }
+    // 上一次返回的条目在run的缓冲区中，推进run可能覆盖它，因此推迟到这次调用
+    if (last_run_ != SIZE_MAX) {
+        advance(runs_[last_run_]);
+        adjust(last_run_);
+        last_run_ = SIZE_MAX;
+    }
+    size_t winner = tree_[0];
+    if (runs_[winner].done) return nullptr;
+    last_run_ = winner;
+    return current(winner);
+}
@@ -0,0 +1,151 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "common/config.h"
+#include "common/memory_tracker.h"
+#include "storage/temp_storage.h"
+
+/**
+ * @brief 并行外部排序，ORDER BY（SortExecutor）和建B+树索引（SmManager::build_index）共用。
+ * 排序的条目是定长的字节串，前key_len字节为保序编码的排序键，只需memcmp比较，其余字节由调用者解释；排序是稳定的。
+ * 1. 生成run：调用线程把条目追加到当前块中，块满之后交给WorkerPool排序，调用线程继续填充下一块。
+ *    块内按(排序键的前8字节, 下标)排序，前缀相同时再比较剩余的排序键和下标，大多数比较只需比较一个整数；
+ *    内存中的条目超过mem_budget或者内存记账器拒绝继续预留时，等待各块排序完成，每块写成一个临时文件（run）。
+ * 2. 没有写过run时所有块都在内存中：按从各块中采样的分割点把输出划分为若干段，每个工作线程把各块中属于本段的条目
+ *    归并到输出数组的对应位置。
+ * 3. 写过run时，剩下的块也写出，用败者树对所有run做多路归并，受临时文件的读取速度限制，由调用线程完成。
+ * 工作线程只执行排序一块和归并一段这样的独立任务，从不等待调用线程；一个ParallelSorter只能由一个线程调用
+ */
+class ParallelSorter {
+   public:
+    /**
+     * @param key_len 排序键的长度
+     * @param entry_len 条目的长度，不小于key_len
+     * @param mem_budget 内存中条目的总字节数上限，超过后写出run
+     * @param tracker 内存记账器，为空时只受mem_budget限制
+     * @param parallelism 同时执行的任务数上限，决定块的大小和归并的段数；为0时取线程池的线程数。
+     *                    任务从不等待，因此可以大于线程池的线程数，测试用它在单线程的线程池上得到多块的归并
+     */
+    ParallelSorter(size_t key_len, size_t entry_len, size_t mem_budget, MemoryTracker *tracker = nullptr,
+                   size_t parallelism = 0);
+
+    ~ParallelSorter();
+
+    ParallelSorter(const ParallelSorter &) = delete;
+
+    ParallelSorter &operator=(const ParallelSorter &) = delete;
+
+    char *add();
+
+    void finish();
+
+    const char *next();
+
+    /* 写出的run数，全部在内存中排序时为0 */
+    size_t num_runs() const { return runs_.size(); }
+
+    /* 内存中排序的块数，用于测试 */
+    size_t num_chunks() const { return num_chunks_; }
+
+   private:
+    /* 块内排序的元素：排序键前8字节按大端组成的整数和条目在块中的下标 */
+    struct SortItem {
+        uint64_t prefix;
+        uint32_t idx;
+    };
+
+    /* 内存中的一块条目：data按加入的顺序存放条目，排序后items为排序结果 */
+    struct Chunk {
+        std::vector<char> data;
+        std::vector<SortItem> items;
+
+        size_t rows(size_t entry_len) const { return data.size() / entry_len; }
+    };
+
+    /* 一个已排序的run：临时文件以及读取时的缓冲区 */
+    struct Run {
+        std::unique_ptr<TempFile> file;
+        std::vector<char> buf;
+        size_t pos = 0;     // 当前条目在buf中的偏移
+        size_t end = 0;     // buf中有效数据的长度
+        bool done = false;
+    };
+
+    /* 归并时的一个分割点：块chunk中排序后第pos个条目 */
+    struct Splitter {
+        size_t chunk;
+        size_t pos;
+    };
+
+    size_t entry_mem(size_t rows) const { return rows * (entry_len_ + sizeof(SortItem)); }
+
+    const char *entry(const Chunk &chunk, size_t pos) const {
+        return chunk.data.data() + static_cast<size_t>(chunk.items[pos].idx) * entry_len_;
+    }
+
+    void sort_chunk(Chunk *chunk) const;
+
+    void seal();
+
+    void spill();
+
+    void merge_in_memory();
+
+    size_t split_point(size_t c, const Splitter &s) const;
+
+    void merge_part(const std::vector<size_t> &begin, const std::vector<size_t> &end, const char **out) const;
+
+    void open_runs();
+
+    const char *current(size_t run_idx) const { return runs_[run_idx].buf.data() + runs_[run_idx].pos; }
+
+    void advance(Run &run);
+
+    bool beats(size_t a, size_t b) const;
+
+    void adjust(size_t s);
+
+    template <typename Task>
+    void submit(Task task);
+
+    void wait(size_t max_in_flight);
+
+    size_t key_len_;
+    size_t entry_len_;
+    size_t mem_budget_;
+    size_t chunk_rows_;                         // 一块的条目数，块满之后交给工作线程排序
+    size_t parallelism_;                        // 同时执行的任务数上限，默认为线程池的线程数
+
+    std::vector<std::unique_ptr<Chunk>> chunks_;    // 内存中的块，按加入的顺序排列
+    bool filling_ = false;                      // chunks_的最后一块是否还在填充，尚未交给工作线程
+    size_t buffered_rows_ = 0;                  // 内存中的条目数
+    size_t num_chunks_ = 0;
+    std::vector<Run> runs_;
+    std::vector<size_t> tree_;                  // 败者树，tree_[0]为当前胜者，其余结点保存败者
+    size_t last_run_ = SIZE_MAX;                // 上一次next返回的条目所在的run，下次next时推进
+    std::vector<const char *> output_;          // 多块在内存中归并后的输出顺序
+    size_t out_pos_ = 0;                        // 下一个要输出的条目
+    bool finished_ = false;
+    MemoryReservation mem_;                     // 内存中的块、归并的输出数组以及各run的读缓冲区占用的内存
+
+    std::mutex latch_;                          // 保护in_flight_和error_
+    std::condition_variable cv_;
+    size_t in_flight_ = 0;                      // 已提交、还没有执行完的任务数
+    std::exception_ptr error_;                  // 任务中抛出的第一个异常，等待任务结束后在调用线程中重新抛出
+};
@@ -0,0 +1,167 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "plan_printer.h"
+
+#include <cstdio>
+
+namespace {
+
+std::string col_str(const TabCol &col) { return col.tab_name.empty() ? col.col_name : col.tab_name + '.' + col.col_name; }
+
+std::string value_str(const Value &val) {
+    if (val.is_param()) return "?";
+    if (val.type == TYPE_INT) return std::to_string(val.int_val);
+    if (val.type == TYPE_FLOAT) return std::to_string(val.float_val);
+    return "'" + val.str_val + "'";
+}
+
+std::string conds_str(const std::vector<Condition> &conds) {
+    static const char *op_str[] = {"=", "<>", "<", ">", "<=", ">="};
+    std::string str;
+    for (auto &cond : conds) {
+        if (!str.empty()) str += " AND ";
+        str += col_str(cond.lhs_col) + ' ' + op_str[cond.op] + ' ' +
+               (cond.is_rhs_val ? value_str(cond.rhs_val) : col_str(cond.rhs_col));
+    }
+    return str;
+}
+
+std::string cols_str(const std::vector<TabCol> &cols) {
+    std::string str;
+    for (auto &col : cols) {
+        if (!str.empty()) str += ", ";
+        str += col_str(col);
+    }
+    return str;
+}
+
+std::string names_str(const std::vector<std::string> &names) {
+    std::string str;
+    for (auto &name : names) {
+        if (!str.empty()) str += ", ";
+        str += name;
+    }
+    return str;
+}
+
+// 节点的子节点，按执行时的左右顺序排列
+std::vector<std::shared_ptr<Plan>> children(const Plan *plan) {
+    if (auto x = dynamic_cast<const JoinPlan *>(plan)) return {x->left_, x->right_};
+    if (auto x = dynamic_cast<const SemiJoinPlan *>(plan)) return {x->left_, x->right_};
+    if (auto x = dynamic_cast<const ProjectionPlan *>(plan)) return {x->subplan_};
+    if (auto x = dynamic_cast<const SortPlan *>(plan)) return {x->subplan_};
+    if (auto x = dynamic_cast<const AggregatePlan *>(plan)) return {x->subplan_};
+    if (auto x = dynamic_cast<const LimitPlan *>(plan)) return {x->subplan_};
+    if (auto x = dynamic_cast<const DMLPlan *>(plan)) {
+        if (x->subplan_ != nullptr) return {x->subplan_};
+    }
+    return {};
+}
+
+}  // namespace
+
+std::vector<std::string> PlanPrinter::print(const std::shared_ptr<Plan> &plan) {
+    std::vector<std::string> lines;
+    // select语句的DMLPlan只是投影的外壳，从投影开始输出
+    auto dml = std::dynamic_pointer_cast<DMLPlan>(plan);
+    print_node(dml != nullptr && dml->tag == T_select ? dml->subplan_ : plan, 0, lines);
+    return lines;
+}
+
+void PlanPrinter::print_node(const std::shared_ptr<Plan> &plan, int depth, std::vector<std::string> &lines) {
+    std::string line = depth == 0 ? "" : std::string(depth * 2 - 2, ' ') + "-> ";
+    line += describe(plan.get());
+    if (op_stats_ != nullptr) {
+        auto it = op_stats_->find(plan.get());
+        if (it == op_stats_->end() || it->second.loops == 0) {
+            line += " (never executed)";
+        } else {
+            const OperatorStats &stats = it->second;
+            char buf[160];
+            snprintf(buf, sizeof(buf), " (actual rows=%llu loops=%llu time=%.3f ms pages=%llu hits=%llu)",
+                     static_cast<unsigned long long>(stats.rows), static_cast<unsigned long long>(stats.loops),
+                     stats.time_ms, static_cast<unsigned long long>(stats.page_hits + stats.page_misses),
+                     static_cast<unsigned long long>(stats.page_hits));
+            line += buf;
+        }
+    }
+    lines.push_back(std::move(line));
+    for (auto &child : children(plan.get())) {
+        print_node(child, depth + 1, lines);
+    }
+}
+
+std::string PlanPrinter::describe(const Plan *plan) {
+    if (auto x = dynamic_cast<const ScanPlan *>(plan)) {
+        static const std::map<PlanTag, const char *> scan_names = {
+            {T_SeqScan, "SeqScan"},     {T_ParallelSeqScan, "ParallelSeqScan"}, {T_IndexScan, "IndexScan"},
+            {T_IndexOnlyScan, "IndexOnlyScan"}, {T_HashScan, "HashScan"},
+        };
+        std::string str = std::string(scan_names.at(x->tag)) + " on " + x->tab_name_;
+        if (x->tag != T_SeqScan && x->tag != T_ParallelSeqScan) str += " using (" + names_str(x->index_col_names_) + ")";
+        if (!x->conds_.empty()) str += " filter: " + conds_str(x->conds_);
+        if (sm_manager_ != nullptr) {
+            const PartitionMeta &partition = sm_manager_->db_.get_table(x->tab_name_).partition;
+            if (partition.is_partitioned()) {
+                std::vector<std::string> names;
+                for (size_t i : sm_manager_->scan_partitions(x->tab_name_, x->conds_)) {
+                    names.push_back(partition.names[i]);
+                }
+                str += " partitions: " + (names.empty() ? std::string("none") : names_str(names));
+            }
+        }
+        return str;
+    }
+    if (auto x = dynamic_cast<const JoinPlan *>(plan)) {
+        std::string str = x->tag == T_MergeJoin ? "MergeJoin" : x->tag == T_HashJoin ? "HashJoin" : "NestedLoopJoin";
+        if (!x->conds_.empty()) str += " on " + conds_str(x->conds_);
+        return str;
+    }
+    if (auto x = dynamic_cast<const SemiJoinPlan *>(plan)) {
+        std::string str = x->tag == T_AntiJoin ? "HashAntiJoin" : "HashSemiJoin";
+        if (!x->conds_.empty()) str += " on " + conds_str(x->conds_);
+        return str;
+    }
+    if (auto x = dynamic_cast<const ProjectionPlan *>(plan)) {
+        return "Projection: " + cols_str(x->sel_cols_);
+    }
+    if (auto x = dynamic_cast<const SortPlan *>(plan)) {
+        std::string str = "Sort by: ";
+        for (size_t i = 0; i < x->sel_cols_.size(); i++) {
+            if (i > 0) str += ", ";
+            str += col_str(x->sel_cols_[i]) + (x->is_desc_[i] ? " DESC" : "");
+        }
+        if (x->limit_ >= 0) str += " limit " + std::to_string(x->limit_);
+        return str;
+    }
+    if (auto x = dynamic_cast<const AggregatePlan *>(plan)) {
+        std::string str = x->tag == T_StreamAggregate ? "StreamAggregate" : "HashAggregate";
+        if (!x->group_cols_.empty()) str += " group by: " + cols_str(x->group_cols_);
+        std::vector<std::string> aggs;
+        for (auto &agg : x->aggs_) aggs.push_back(agg.name);
+        if (!aggs.empty()) str += " aggs: " + names_str(aggs);
+        return str;
+    }
+    if (auto x = dynamic_cast<const LimitPlan *>(plan)) {
+        return "Limit " + std::to_string(x->limit_);
+    }
+    if (auto x = dynamic_cast<const DMLPlan *>(plan)) {
+        if (x->tag == T_Insert) return "Insert on " + x->tab_name_;
+        if (x->tag == T_Delete) return "Delete on " + x->tab_name_;
+        std::string str = "Update on " + x->tab_name_ + " set: ";
+        for (size_t i = 0; i < x->set_clauses_.size(); i++) {
+            if (i > 0) str += ", ";
+            str += x->set_clauses_[i].lhs.col_name + " = " + value_str(x->set_clauses_[i].rhs);
+        }
+        return str;
+    }
+    return "Unknown";
+}
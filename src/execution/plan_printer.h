@@ -0,0 +1,41 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "executor_instrument.h"
+#include "optimizer/plan.h"
+
+/**
+ * @brief 把查询计划输出为EXPLAIN的文本，每个节点一行，子节点缩进并以"->"开头；
+ * 给出执行统计时在每个节点后面附上对应算子的实际执行情况；给出系统管理器时分区表上的扫描附上裁剪之后剩下的分区
+ */
+class PlanPrinter {
+   public:
+    explicit PlanPrinter(const std::map<const Plan *, OperatorStats> *op_stats = nullptr,
+                         SmManager *sm_manager = nullptr)
+        : op_stats_(op_stats), sm_manager_(sm_manager) {}
+
+    std::vector<std::string> print(const std::shared_ptr<Plan> &plan);
+
+   private:
+    void print_node(const std::shared_ptr<Plan> &plan, int depth, std::vector<std::string> &lines);
+
+    // 节点本身的描述，不含子节点
+    std::string describe(const Plan *plan);
+
+    const std::map<const Plan *, OperatorStats> *op_stats_;
+    SmManager *sm_manager_;
+};
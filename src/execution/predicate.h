@@ -0,0 +1,225 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "common/common.h"
+#include "errors.h"
+#include "filter_kernels.h"
+#include "record/bitmap.h"
+#include "system/sm_meta.h"
+#include "tuple_batch.h"
+
+/* 编译后的比较函数：按照编译时确定的字段类型和运算符比较lhs和rhs指向的字段值，len为字段长度 */
+using CompareFn = bool (*)(const char *lhs, const char *rhs, int len);
+
+/* 编译后的一个比较条件，字段的偏移量、类型和运算符都已经确定 */
+struct CompiledCond {
+    CompareFn fn;
+    CompOp op;                          // 比较运算符
+    FilterKernel kernel;                // 右侧为常量时整批计算的过滤内核，否则为nullptr
+    int lhs_idx;                        // 左侧字段在左侧元组字段中的下标
+    int lhs_offset;
+    int rhs_offset;                     // 右侧为字段时的偏移量
+    int len;                            // 按左侧字段的长度比较
+    const char *rhs_val;                // 右侧为常量时指向常量的原始数据，否则为nullptr
+    std::shared_ptr<RmRecord> rhs_raw;  // 持有常量的原始数据
+
+    const char *rhs(const char *rhs_rec) const { return rhs_val != nullptr ? rhs_val : rhs_rec + rhs_offset; }
+};
+
+/**
+ * @brief 一组AND关系的比较条件在执行前编译成的谓词
+ * 条件中的字段在构造算子时按名称查找一次，之后每个元组只按偏移量取值，
+ * 用编译时按类型和运算符选出的比较函数计算，不再查找字段、分派类型和运算符；
+ * 扫描算子的条件两侧都是同一个元组的字段或常量，连接算子的条件左侧来自左儿子的元组、右侧来自右儿子的元组
+ */
+class Predicate {
+   public:
+    Predicate() = default;
+
+    /**
+     * @brief 编译单表上的条件，条件中的字段都在cols中
+     */
+    static Predicate compile(const std::vector<Condition> &conds, const std::vector<ColMeta> &cols) {
+        return compile(conds, cols, cols);
+    }
+
+    /**
+     * @brief 编译条件，左侧字段在lhs_cols中查找，右侧字段在rhs_cols中查找
+     */
+    static Predicate compile(const std::vector<Condition> &conds, const std::vector<ColMeta> &lhs_cols,
+                             const std::vector<ColMeta> &rhs_cols) {
+        Predicate pred;
+        for (auto &cond : conds) {
+            auto lhs = find_col(lhs_cols, cond.lhs_col);
+            CompiledCond cc;
+            cc.fn = compare_fn(lhs->type, cond.op);
+            cc.op = cond.op;
+            cc.lhs_idx = static_cast<int>(lhs - lhs_cols.begin());
+            cc.lhs_offset = lhs->offset;
+            cc.len = lhs->len;
+            if (cond.is_rhs_val) {
+                cc.rhs_offset = 0;
+                cc.rhs_raw = cond.rhs_val.raw;
+                cc.rhs_val = cc.rhs_raw->data;
+                cc.kernel = filter_kernel(lhs->type, cond.op);
+            } else {
+                cc.rhs_offset = find_col(rhs_cols, cond.rhs_col)->offset;
+                cc.rhs_val = nullptr;
+                cc.kernel = nullptr;
+            }
+            pred.conds_.push_back(std::move(cc));
+        }
+        return pred;
+    }
+
+    bool empty() const { return conds_.empty(); }
+
+    const std::vector<CompiledCond> &conds() const { return conds_; }
+
+    /* 判断单表上的元组是否满足全部条件，rec可以直接指向缓冲池页面 */
+    bool eval(const char *rec) const { return eval(rec, rec); }
+
+    /* 判断左侧元组lhs_rec和右侧元组rhs_rec是否满足全部条件 */
+    bool eval(const char *lhs_rec, const char *rhs_rec) const {
+        for (auto &cond : conds_) {
+            if (!cond.fn(lhs_rec + cond.lhs_offset, cond.rhs(rhs_rec), cond.len)) return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief 在批次上按列计算单表条件，把选择向量压缩为满足全部条件的元组
+     * 选择向量中的元组不少于批次的一半时，与常量比较的条件先用过滤内核在整批元组上算出选择位图，
+     * 各条件的位图按位与后只压缩一次选择向量；其余条件再逐个元组计算
+     */
+    void filter(TupleBatch &batch) const {
+        auto &sel = batch.sel();
+        size_t n = batch.num_rows();
+        bool use_bitmap = false;
+        if (n > 0 && sel.size() * 2 >= n) {
+            thread_local std::vector<char> bm, cond_bm;
+            int bm_size = static_cast<int>((n + BITMAP_WIDTH - 1) / BITMAP_WIDTH);
+            bm.resize(bm_size);
+            cond_bm.resize(bm_size);
+            for (auto &cond : conds_) {
+                if (cond.kernel == nullptr) continue;
+                char *dst = use_bitmap ? cond_bm.data() : bm.data();
+                cond.kernel(batch.row_data(0) + cond.lhs_offset, batch.tuple_len(), n, cond.rhs_val, cond.len, dst);
+                if (use_bitmap) Bitmap::intersect(bm.data(), cond_bm.data(), bm_size);
+                use_bitmap = true;
+            }
+            if (use_bitmap) {
+                size_t keep = 0;
+                for (uint32_t row : sel) {
+                    if (Bitmap::is_set(bm.data(), static_cast<int>(row))) sel[keep++] = row;
+                }
+                sel.resize(keep);
+            }
+        }
+        for (auto &cond : conds_) {
+            if (use_bitmap && cond.kernel != nullptr) continue;
+            size_t keep = 0;
+            for (uint32_t row : sel) {
+                const char *rec = batch.row_data(row);
+                if (cond.fn(rec + cond.lhs_offset, cond.rhs(rec), cond.len)) sel[keep++] = row;
+            }
+            sel.resize(keep);
+        }
+    }
+
+    /**
+     * @brief 计算左侧元组lhs_rec与右侧批次中的哪些元组满足全部连接条件
+     *
+     * @param rows 输出满足条件的右侧元组的行号，按批次中的顺序排列
+     */
+    void match(const char *lhs_rec, const TupleBatch &right, std::vector<uint32_t> &rows) const {
+        rows.assign(right.sel().begin(), right.sel().end());
+        for (auto &cond : conds_) {
+            const char *lval = lhs_rec + cond.lhs_offset;
+            size_t keep = 0;
+            for (uint32_t row : rows) {
+                if (cond.fn(lval, cond.rhs(right.row_data(row)), cond.len)) rows[keep++] = row;
+            }
+            rows.resize(keep);
+        }
+    }
+
+    /* 按照字段类型和运算符选出比较函数 */
+    static CompareFn compare_fn(ColType type, CompOp op) {
+        switch (type) {
+            case TYPE_INT: return select_op<IntCmp>(op);
+            case TYPE_FLOAT: return select_op<FloatCmp>(op);
+            default: return select_op<BytesCmp>(op);
+        }
+    }
+
+   private:
+    struct IntCmp {
+        static int cmp(const char *a, const char *b, int) {
+            int x = *reinterpret_cast<const int *>(a), y = *reinterpret_cast<const int *>(b);
+            return (x < y) ? -1 : ((x > y) ? 1 : 0);
+        }
+    };
+    struct FloatCmp {
+        static int cmp(const char *a, const char *b, int) {
+            float x = *reinterpret_cast<const float *>(a), y = *reinterpret_cast<const float *>(b);
+            return (x < y) ? -1 : ((x > y) ? 1 : 0);
+        }
+    };
+    struct BytesCmp {
+        static int cmp(const char *a, const char *b, int len) { return memcmp(a, b, len); }
+    };
+
+    template <typename Cmp, CompOp OP>
+    static bool compare(const char *lhs, const char *rhs, int len) {
+        int c = Cmp::cmp(lhs, rhs, len);
+        switch (OP) {
+            case OP_EQ: return c == 0;
+            case OP_NE: return c != 0;
+            case OP_LT: return c < 0;
+            case OP_GT: return c > 0;
+            case OP_LE: return c <= 0;
+            case OP_GE: return c >= 0;
+        }
+        return false;
+    }
+
+    template <typename Cmp>
+    static CompareFn select_op(CompOp op) {
+        switch (op) {
+            case OP_EQ: return &compare<Cmp, OP_EQ>;
+            case OP_NE: return &compare<Cmp, OP_NE>;
+            case OP_LT: return &compare<Cmp, OP_LT>;
+            case OP_GT: return &compare<Cmp, OP_GT>;
+            case OP_LE: return &compare<Cmp, OP_LE>;
+            case OP_GE: return &compare<Cmp, OP_GE>;
+        }
+        throw InternalError("Unexpected comparison operator");
+    }
+
+    static std::vector<ColMeta>::const_iterator find_col(const std::vector<ColMeta> &cols, const TabCol &target) {
+        auto pos = std::find_if(cols.begin(), cols.end(), [&](const ColMeta &col) {
+            return col.tab_name == target.tab_name && col.name == target.col_name;
+        });
+        if (pos == cols.end()) {
+            throw ColumnNotFoundError(target.tab_name + '.' + target.col_name);
+        }
+        return pos;
+    }
+
+    std::vector<CompiledCond> conds_;
+};
@@ -0,0 +1,146 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "result_cache.h"
+
+#include <cctype>
+
+#include "system/output_log.h"
+
+namespace {
+
+// 计划中扫描的所有表，包括子查询中的表
+void collect_tables(const std::shared_ptr<Plan> &plan, std::vector<std::string> &tables) {
+    if (plan == nullptr) return;
+    if (auto x = std::dynamic_pointer_cast<ScanPlan>(plan)) {
+        if (std::find(tables.begin(), tables.end(), x->tab_name_) == tables.end()) tables.push_back(x->tab_name_);
+    } else if (auto x = std::dynamic_pointer_cast<JoinPlan>(plan)) {
+        collect_tables(x->left_, tables);
+        collect_tables(x->right_, tables);
+    } else if (auto x = std::dynamic_pointer_cast<SemiJoinPlan>(plan)) {
+        collect_tables(x->left_, tables);
+        collect_tables(x->right_, tables);
+    } else if (auto x = std::dynamic_pointer_cast<ProjectionPlan>(plan)) {
+        collect_tables(x->subplan_, tables);
+    } else if (auto x = std::dynamic_pointer_cast<SortPlan>(plan)) {
+        collect_tables(x->subplan_, tables);
+    } else if (auto x = std::dynamic_pointer_cast<AggregatePlan>(plan)) {
+        collect_tables(x->subplan_, tables);
+    } else if (auto x = std::dynamic_pointer_cast<LimitPlan>(plan)) {
+        collect_tables(x->subplan_, tables);
+    } else if (auto x = std::dynamic_pointer_cast<DMLPlan>(plan)) {
+        collect_tables(x->subplan_, tables);
+    }
+}
+
+}  // namespace
+
+std::string ResultCache::text_key(const char *sql, bool binary) {
+    std::string key = binary ? "B" : "T";
+    bool in_string = false;
+    bool pending_space = false;
+    for (const char *p = sql; *p != '\0'; p++) {
+        if (!in_string && isspace(static_cast<unsigned char>(*p))) {
+            pending_space = true;
+            continue;
+        }
+        if (pending_space && key.size() > 1) key += ' ';
+        pending_space = false;
+        if (*p == '\'') in_string = !in_string;
+        key += *p;
+    }
+    while (key.size() > 1 && (key.back() == ';' || key.back() == ' ')) key.pop_back();
+    return key;
+}
+
+std::string ResultCache::execute_key(const std::string &prepared_sql, const std::vector<Value> &params, bool binary) {
+    std::string key = text_key(prepared_sql.c_str(), binary);
+    for (auto &param : params) {
+        // 参数值之间用'\0'分隔，类型不同的参数不会得到相同的key
+        key += '\0';
+        if (param.type == TYPE_INT) {
+            key += "i" + std::to_string(param.int_val);
+        } else if (param.type == TYPE_FLOAT) {
+            key += 'f';
+            key.append(reinterpret_cast<const char *>(&param.float_val), sizeof(param.float_val));
+        } else {
+            key += "s" + param.str_val;
+        }
+    }
+    return key;
+}
+
+bool ResultCache::cacheable(const std::shared_ptr<Plan> &plan) {
+    auto x = std::dynamic_pointer_cast<DMLPlan>(plan);
+    return x != nullptr && x->tag == T_select;
+}
+
+ResultCache::Snapshot ResultCache::snapshot(const std::shared_ptr<Plan> &plan) {
+    Snapshot snapshot;
+    snapshot.catalog_version = sm_manager_->catalog_version_.load();
+    std::vector<std::string> tables;
+    collect_tables(plan, tables);
+    for (auto &tab_name : tables) {
+        // 分区表的数据在各分区的记录文件中
+        for (auto &name : sm_manager_->partition_tables(tab_name)) {
+            snapshot.tables.emplace_back(name, sm_manager_->get_table_handle(name)->get_version());
+        }
+    }
+    return snapshot;
+}
+
+bool ResultCache::is_valid(const Snapshot &snapshot) {
+    // 元数据没有变化时表和记录文件都没有被删除
+    if (snapshot.catalog_version != sm_manager_->catalog_version_.load()) return false;
+    for (auto &table : snapshot.tables) {
+        RmFileHandle *fh = sm_manager_->find_table_handle(table.first);
+        if (fh == nullptr || fh->get_version() != table.second) return false;
+    }
+    return true;
+}
+
+bool ResultCache::lookup(const std::string &key, Context *context) {
+    ResultCapture capture;
+    {
+        std::lock_guard<std::mutex> lock(latch_);
+        auto it = entries_.find(key);
+        if (it == entries_.end()) return false;
+        if (!is_valid(it->second->snapshot)) {
+            erase(it->second);
+            return false;
+        }
+        lru_.splice(lru_.begin(), lru_, it->second);
+        // 复制一份再发送，发送期间不持有锁
+        capture = it->second->capture;
+    }
+    if (!capture.output.empty()) OutputLog::instance().append(std::move(capture.output));
+    context->replay(capture.chunks);
+    return true;
+}
+
+void ResultCache::insert(const std::string &key, Snapshot snapshot, ResultCapture capture) {
+    size_t bytes = key.size() + capture.output.size();
+    for (auto &chunk : capture.chunks) bytes += chunk.data.size();
+    // 单个结果最多占用容量的1/8，避免一个大结果挤掉其它所有结果
+    if (bytes > capacity_ / 8) return;
+    std::lock_guard<std::mutex> lock(latch_);
+    auto it = entries_.find(key);
+    if (it != entries_.end()) erase(it->second);
+    lru_.push_front({key, std::move(snapshot), std::move(capture), bytes});
+    entries_.emplace(key, lru_.begin());
+    bytes_ += bytes;
+    while (bytes_ > capacity_) erase(std::prev(lru_.end()));
+}
+
+void ResultCache::erase(std::list<Entry>::iterator it) {
+    bytes_ -= it->bytes;
+    entries_.erase(it->key);
+    lru_.erase(it);
+}
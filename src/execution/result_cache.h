@@ -0,0 +1,81 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "analyze/analyze.h"
+#include "common/context.h"
+#include "optimizer/plan.h"
+#include "system/sm.h"
+
+/**
+ * @brief 只读select语句的结果缓存，进程内所有连接共享，默认关闭(容量为0)
+ * @description key为结果格式加规范化之后的语句文本，EXECUTE预编译语句时为PREPARE语句的文本加绑定的参数值；
+ * 缓存的是发送给客户端的结果（按发送时的分块）和写入output.txt的文本，命中时不再解析之后的部分、生成计划或扫描表。
+ * 每个结果记录执行之前元数据的版本和读取的每张表的记录文件版本(RmFileHandle::get_version)，
+ * 查找时任何一个版本发生变化都说明结果可能已经过期。记录文件的版本在修改记录时和修改它的事务提交或回滚时各加一次，
+ * 快照读的语句在读取版本号之后才取快照，结果中没有包含的修改在提交时一定会使它失效。只在单条语句的隐式事务中使用，
+ * 显式事务中的语句照常加锁执行，不会读到其他事务未提交的修改。按LRU淘汰，占用的字节数不超过容量
+ */
+class ResultCache {
+   public:
+    // 执行语句之前读到的版本号
+    struct Snapshot {
+        uint64_t catalog_version = 0;
+        std::vector<std::pair<std::string, uint64_t>> tables;
+    };
+
+    ResultCache(SmManager *sm_manager, size_t capacity) : sm_manager_(sm_manager), capacity_(capacity) {}
+
+    bool enabled() const { return capacity_ > 0; }
+
+    /* 普通语句的key：合并字符串常量之外的连续空白，去掉首尾的空白和末尾的分号 */
+    static std::string text_key(const char *sql, bool binary);
+
+    /* EXECUTE的key：预编译语句的文本加上参数值 */
+    static std::string execute_key(const std::string &prepared_sql, const std::vector<Value> &params, bool binary);
+
+    /* 可以缓存结果的计划：select语句，不包括explain */
+    static bool cacheable(const std::shared_ptr<Plan> &plan);
+
+    Snapshot snapshot(const std::shared_ptr<Plan> &plan);
+
+    /* 命中并且没有过期时重新发送缓存的结果、写入output.txt，返回false时照常执行语句 */
+    bool lookup(const std::string &key, Context *context);
+
+    void insert(const std::string &key, Snapshot snapshot, ResultCapture capture);
+
+   private:
+    struct Entry {
+        std::string key;
+        Snapshot snapshot;
+        ResultCapture capture;
+        size_t bytes;
+    };
+
+    bool is_valid(const Snapshot &snapshot);
+
+    void erase(std::list<Entry>::iterator it);
+
+    SmManager *sm_manager_;
+    size_t capacity_;                           // 缓存的结果最多占用的字节数
+    size_t bytes_ = 0;                          // 当前缓存的结果占用的字节数
+    std::mutex latch_;
+    std::list<Entry> lru_;                      // 最近使用的在前
+    std::unordered_map<std::string, std::list<Entry>::iterator> entries_;
+};
@@ -0,0 +1,77 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "common/common.h"
+#include "common/config.h"
+
+/* 哈希连接的一个连接字段在元组中的位置 */
+struct JoinKeyCol {
+    int offset;
+    int len;
+    ColType type;
+};
+
+/* 计算元组在哈希键上的哈希值，相等的键值得到相同的哈希值 */
+inline uint64_t hash_join_key(const char *rec, const std::vector<JoinKeyCol> &keys) {
+    uint64_t h = 14695981039346656037ULL;
+    for (auto &key : keys) {
+        const char *val = rec + key.offset;
+        float zero = 0.0f;
+        if (key.type == TYPE_FLOAT && *reinterpret_cast<const float *>(val) == 0.0f) {
+            val = reinterpret_cast<const char *>(&zero);  // 0.0和-0.0相等
+        }
+        for (int i = 0; i < key.len; i++) {
+            h ^= static_cast<uint8_t>(val[i]);
+            h *= 1099511628211ULL;
+        }
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/**
+ * @brief 运行时连接过滤器：哈希连接建立哈希表之后，用构建侧各元组哈希键的哈希值构造的Bloom过滤器。
+ * 下推到探测侧的扫描算子，扫描在复制元组之前排除哈希键一定不在构建侧中的记录。
+ * 过滤器分块：一个哈希值的全部比特位落在同一个64位的字中，检查时只读一个字
+ */
+class RuntimeFilter {
+   public:
+    /* 能容纳num_keys个哈希值的空过滤器，每个键约EXEC_RUNTIME_FILTER_BITS_PER_KEY个比特位 */
+    explicit RuntimeFilter(size_t num_keys) {
+        size_t num_words = 1;
+        while (num_words * 64 < num_keys * EXEC_RUNTIME_FILTER_BITS_PER_KEY) num_words <<= 1;
+        words_.assign(num_words, 0);
+        mask_ = num_words - 1;
+    }
+
+    void add(uint64_t hash) { words_[(hash >> 32) & mask_] |= bits(hash); }
+
+    /* 返回false时哈希值一定没有加入过；返回true时可能加入过 */
+    bool may_contain(uint64_t hash) const {
+        uint64_t b = bits(hash);
+        return (words_[(hash >> 32) & mask_] & b) == b;
+    }
+
+   private:
+    /* 哈希值在字中的3个比特位，与选择字的高32位互不重叠 */
+    static uint64_t bits(uint64_t hash) {
+        return (1ULL << (hash & 63)) | (1ULL << ((hash >> 6) & 63)) | (1ULL << ((hash >> 12) & 63));
+    }
+
+    std::vector<uint64_t> words_;
+    uint64_t mask_;
+};
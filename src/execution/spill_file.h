@@ -0,0 +1,88 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "errors.h"
+#include "storage/temp_storage.h"
+#include "tuple_batch.h"
+
+/**
+ * @brief 算子溢出到磁盘的临时文件：定长元组按顺序写入，finish之后从头整批读出。
+ * 文件由TempStorage创建，写入和读出按块进行并与算子的计算重叠；remove()或者析构时关闭，不会留下文件
+ */
+struct SpillFile {
+    std::unique_ptr<TempFile> file;
+    size_t rows = 0;
+
+    /* 创建n个临时文件 */
+    static std::vector<SpillFile> create(int n) {
+        std::vector<SpillFile> spills(n);
+        for (auto &spill : spills) {
+            spill.file = TempStorage::instance().create_file();
+        }
+        return spills;
+    }
+
+    void write(const char *tuple, size_t tuple_len) {
+        file->append(tuple, tuple_len);
+        rows++;
+    }
+
+    /* 写完之后调用，写出剩余的元组并释放写缓冲区 */
+    void finish() { file->finish_write(); }
+
+    /* 回到文件开头，之后从头读出 */
+    void rewind() { file->rewind(); }
+
+    /**
+     * @brief 从文件的当前位置读出至多一批元组
+     *
+     * @param cols 元组的字段
+     * @param io_buf 读文件用的缓冲区，由调用者复用
+     * @return 文件已经读完时返回false
+     */
+    bool read(const std::vector<ColMeta> *cols, size_t tuple_len, TupleBatch &batch, std::vector<char> &io_buf) {
+        batch.reset(cols, tuple_len);
+        io_buf.resize(batch.capacity() * tuple_len);
+        size_t n = file->read(io_buf.data(), io_buf.size()) / tuple_len;
+        for (size_t i = 0; i < n; i++) {
+            batch.append(io_buf.data() + i * tuple_len, Rid{INVALID_PAGE_ID, -1});
+        }
+        return n > 0;
+    }
+
+    /* 读出全部rows个元组到dst */
+    void read_all(char *dst, size_t tuple_len) {
+        file->rewind();
+        if (file->read(dst, rows * tuple_len) != rows * tuple_len) {
+            throw InternalError("Failed to read spill file");
+        }
+    }
+
+    void remove() {
+        file.reset();
+        rows = 0;
+    }
+};
+
+/* 第depth层划分中哈希值h所属的分区，每一层使用不同的哈希函数，使上一层落入同一分区的元组能够继续分开 */
+inline size_t spill_partition_of(uint64_t h, int depth, int fanout) {
+    h += 0x9e3779b97f4a7c15ULL * static_cast<uint64_t>(depth + 1);
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return static_cast<size_t>(h % fanout);
+}
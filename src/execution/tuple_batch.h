@@ -0,0 +1,109 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "common/config.h"
+#include "defs.h"
+#include "system/sm_meta.h"
+
+/**
+ * @brief 批量执行接口在算子之间传递的一批元组
+ * 元组按照输出算子的字段格式(cols)连续存放在一块复用的缓冲区中，最多容纳capacity()个元组；
+ * 选择向量sel_记录批次中仍然有效的行，过滤算子只需要压缩选择向量，不移动元组数据。
+ * 按下标k访问的接口(tuple/rid/value)都是指选择向量中的第k个元组
+ */
+class TupleBatch {
+   public:
+    explicit TupleBatch(size_t capacity = EXEC_BATCH_SIZE) : capacity_(capacity) {}
+
+    /**
+     * @brief 清空批次，之后追加的元组按照cols描述的格式存放
+     *
+     * @param cols 元组的字段，由产生批次的算子持有
+     * @param tuple_len 每个元组的长度
+     */
+    void reset(const std::vector<ColMeta> *cols, size_t tuple_len) {
+        cols_ = cols;
+        tuple_len_ = tuple_len;
+        num_rows_ = 0;
+        sel_.clear();
+        if (data_.size() < capacity_ * tuple_len_) data_.resize(capacity_ * tuple_len_);
+        rids_.resize(capacity_);
+    }
+
+    size_t capacity() const { return capacity_; }
+
+    size_t tuple_len() const { return tuple_len_; }
+
+    const std::vector<ColMeta> &cols() const { return *cols_; }
+
+    /* 不改变批次中的元组，只换成字段偏移相同的另一组字段，例如分区的批次作为分区表的批次输出 */
+    void set_cols(const std::vector<ColMeta> *cols) { cols_ = cols; }
+
+    /* 缓冲区中已经存放的行数，包括被过滤掉的行 */
+    size_t num_rows() const { return num_rows_; }
+
+    bool full() const { return num_rows_ >= capacity_; }
+
+    /**
+     * @brief 在批次末尾追加一行并把它加入选择向量，调用者需保证批次未满
+     *
+     * @return 新行的缓冲区，长度为tuple_len()
+     */
+    char *append(const Rid &rid = Rid{INVALID_PAGE_ID, -1}) {
+        rids_[num_rows_] = rid;
+        sel_.push_back(static_cast<uint32_t>(num_rows_));
+        return row_data(num_rows_++);
+    }
+
+    /* 追加一行并从src复制tuple_len()字节 */
+    char *append(const char *src, const Rid &rid) {
+        char *dst = append(rid);
+        memcpy(dst, src, tuple_len_);
+        return dst;
+    }
+
+    /* 选择向量中有效元组的个数 */
+    size_t size() const { return sel_.size(); }
+
+    bool empty() const { return sel_.empty(); }
+
+    const char *tuple(size_t k) const { return row_data(sel_[k]); }
+
+    char *tuple(size_t k) { return row_data(sel_[k]); }
+
+    const Rid &rid(size_t k) const { return rids_[sel_[k]]; }
+
+    /* 第k个有效元组中第col_idx个字段的值 */
+    const char *value(size_t k, size_t col_idx) const { return tuple(k) + (*cols_)[col_idx].offset; }
+
+    /* 选择向量，保存有效元组所在的行号，过滤时原地压缩 */
+    std::vector<uint32_t> &sel() { return sel_; }
+
+    const std::vector<uint32_t> &sel() const { return sel_; }
+
+    const char *row_data(size_t row) const { return data_.data() + row * tuple_len_; }
+
+    char *row_data(size_t row) { return data_.data() + row * tuple_len_; }
+
+   private:
+    size_t capacity_;
+    const std::vector<ColMeta> *cols_ = nullptr;
+    size_t tuple_len_ = 0;
+    size_t num_rows_ = 0;
+    std::vector<char> data_;        // 按行连续存放的元组
+    std::vector<Rid> rids_;         // 每一行对应的记录号，不来自表的行为无效记录号
+    std::vector<uint32_t> sel_;     // 选择向量
+};
@@ -0,0 +1,71 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "worker_pool.h"
+
+#include <algorithm>
+
+#include "common/config.h"
+#include "common/numa.h"
+
+WorkerPool &WorkerPool::instance() {
+    static WorkerPool pool(EXEC_WORKER_THREADS > 0 ? EXEC_WORKER_THREADS
+                                                   : std::max(1u, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+WorkerPool::WorkerPool(size_t num_threads) : queues_(NumaTopology::instance().num_nodes()) {
+    for (size_t i = 0; i < num_threads; i++) {
+        threads_.emplace_back(&WorkerPool::run, this, i % queues_.size());
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(latch_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto &thread : threads_) {
+        thread.join();
+    }
+}
+
+void WorkerPool::submit(std::function<void()> task, int node) {
+    size_t queue = node >= 0 ? static_cast<size_t>(node) : NumaTopology::instance().current_node();
+    {
+        std::lock_guard<std::mutex> lock(latch_);
+        queues_[queue % queues_.size()].push_back(std::move(task));
+        num_tasks_++;
+    }
+    cv_.notify_one();
+}
+
+/* 绑定在节点node上的工作线程循环取出任务执行，先取本节点的队列；线程池析构时执行完剩余的任务后退出 */
+void WorkerPool::run(size_t node) {
+    NumaTopology::instance().pin_thread(node);
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(latch_);
+            cv_.wait(lock, [&]() { return stop_ || num_tasks_ > 0; });
+            if (num_tasks_ == 0) return;
+            for (size_t i = 0; i < queues_.size(); i++) {
+                auto &queue = queues_[(node + i) % queues_.size()];
+                if (queue.empty()) continue;
+                task = std::move(queue.front());
+                queue.pop_front();
+                break;
+            }
+            num_tasks_--;
+        }
+        task();
+    }
+}
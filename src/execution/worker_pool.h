@@ -0,0 +1,51 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief 查询内并行使用的全局工作线程池，所有查询共用。
+ * 提交的任务不能阻塞等待其它任务，否则线程池被占满时会互相等待；并行算子通过限制同时提交的任务数控制内存。
+ * 有多个NUMA节点时工作线程轮流绑定到各节点，每个节点有自己的任务队列：提交时可以指定任务访问的数据所在的节点，
+ * 工作线程先执行本节点队列中的任务，本节点没有任务时再取其它节点的任务，不会因为数据分布不均而空闲
+ */
+class WorkerPool {
+   public:
+    /* 进程内唯一的线程池，线程数为EXEC_WORKER_THREADS，为0时使用硬件线程数 */
+    static WorkerPool &instance();
+
+    size_t size() const { return threads_.size(); }
+
+    size_t num_nodes() const { return queues_.size(); }
+
+    /* node为任务访问的数据所在的NUMA节点，小于0时放入提交线程所在节点的队列 */
+    void submit(std::function<void()> task, int node = -1);
+
+   private:
+    explicit WorkerPool(size_t num_threads);
+
+    ~WorkerPool();
+
+    void run(size_t node);
+
+    std::vector<std::thread> threads_;
+    std::mutex latch_;
+    std::condition_variable cv_;
+    std::vector<std::deque<std::function<void()>>> queues_;    // 各节点的任务队列
+    size_t num_tasks_ = 0;                                      // 所有队列中的任务数
+    bool stop_ = false;
+};
@@ -10,5 +10,7 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include "ix_hash_index.h"
+#include "ix_lsm_index.h"
 #include "ix_scan.h"
 #include "ix_manager.h"
@@ -21,6 +21,14 @@ constexpr int IX_LEAF_HEADER_PAGE = 1;
 constexpr int IX_INIT_ROOT_PAGE = 2;
 constexpr int IX_INIT_NUM_PAGES = 3;
 constexpr int IX_MAX_COL_LEN = 512;
+constexpr int IX_HASH_INIT_BUCKET_PAGE = 1;   // 哈希索引的初始桶
+constexpr int IX_HASH_INIT_DIR_PAGE = 2;      // 哈希索引的第一个目录页
+
+/* 索引键在结点中的存储格式 */
+enum IxKeyFormat {
+    IX_KEY_RAW = 0,         // 与记录中的字段相同，按列类型逐列比较
+    IX_KEY_NORMALIZED = 1   // 保序编码：整数和浮点数编码为大端的可比较字节，整个key直接用memcmp比较
+};
 
 class IxFileHdr {
 public: 
@@ -37,6 +45,12 @@ public:
     page_id_t first_leaf_;              // 首叶节点对应的页号，在上层IxManager的open函数进行初始化，初始化为root page_no
     page_id_t last_leaf_;               // 尾叶节点对应的页号
     int tot_len_;                       // 记录结构体的整体长度
+    int key_format_ = IX_KEY_RAW;       // 键的存储格式IxKeyFormat，旧的索引文件中没有该字段，视为IX_KEY_RAW
+    // 是否为唯一索引，旧的索引文件中没有该字段，视为唯一索引。非唯一索引在key之后追加Rid作为两个TYPE_INT字段，
+    // 使每个键值对的key各不相同，col_num_、col_types_、col_lens_和col_tot_len_都包含这两个字段
+    int unique_ = 1;
+    // 叶子结点是否使用前缀压缩，只用于按memcmp比较的key，旧的索引文件中没有该字段，视为不压缩
+    int prefix_compress_ = 0;
 
     IxFileHdr() {
         tot_len_ = col_num_ = 0;
@@ -49,9 +63,12 @@ public:
                     tot_len_ = 0;
                 } 
 
+    /* 调用者传入的key的长度，非唯一索引不包括追加的Rid */
+    int user_key_len() const { return unique_ ? col_tot_len_ : col_tot_len_ - static_cast<int>(sizeof(Rid)); }
+
     void update_tot_len() {
         tot_len_ = 0;
-        tot_len_ += sizeof(page_id_t) * 4 + sizeof(int) * 6;
+        tot_len_ += sizeof(page_id_t) * 4 + sizeof(int) * 9;
         tot_len_ += sizeof(ColType) * col_num_ + sizeof(int) * col_num_;
     }
 
@@ -85,6 +102,12 @@ public:
         offset += sizeof(page_id_t);
         memcpy(dest + offset, &last_leaf_, sizeof(page_id_t));
         offset += sizeof(page_id_t);
+        memcpy(dest + offset, &key_format_, sizeof(int));
+        offset += sizeof(int);
+        memcpy(dest + offset, &unique_, sizeof(int));
+        offset += sizeof(int);
+        memcpy(dest + offset, &prefix_compress_, sizeof(int));
+        offset += sizeof(int);
         assert(offset == tot_len_);
     }
 
@@ -100,7 +123,6 @@ public:
         offset += sizeof(page_id_t);
         col_num_ = *reinterpret_cast<const int*>(src + offset);
         offset += sizeof(int);
-        std::cout << col_num_ << "\n";
         for(int i = 0; i < col_num_; ++i) {
             // col_types_[i] = *reinterpret_cast<const ColType*>(src + offset);
             ColType type = *reinterpret_cast<const ColType*>(src + offset);
@@ -123,6 +145,21 @@ public:
         offset += sizeof(page_id_t);
         last_leaf_ = *reinterpret_cast<const page_id_t*>(src + offset);
         offset += sizeof(page_id_t);
+        key_format_ = IX_KEY_RAW;
+        if (offset < tot_len_) {
+            key_format_ = *reinterpret_cast<const int*>(src + offset);
+            offset += sizeof(int);
+        }
+        unique_ = 1;
+        if (offset < tot_len_) {
+            unique_ = *reinterpret_cast<const int*>(src + offset);
+            offset += sizeof(int);
+        }
+        prefix_compress_ = 0;
+        if (offset < tot_len_) {
+            prefix_compress_ = *reinterpret_cast<const int*>(src + offset);
+            offset += sizeof(int);
+        }
         assert(offset == tot_len_);
     }
 };
@@ -133,10 +170,134 @@ public:
     page_id_t parent;               // 父亲节点所在页面的叶号
     int num_key;                    // # current keys (always equals to #child - 1) 已插入的keys数量，key_idx∈[0,num_key)
     bool is_leaf;                   // 是否为叶节点
+    uint16_t prefix_len;            // 前缀压缩的叶子结点中所有key的公共前缀长度，占用is_leaf之后的填充字节
     page_id_t prev_leaf;            // previous leaf node's page_no, effective only when is_leaf is true
     page_id_t next_leaf;            // next leaf node's page_no, effective only when is_leaf is true
 };
 
+static_assert(sizeof(IxPageHdr) == 24, "prefix_len must fit in the padding of IxPageHdr");
+
+/* 可扩展哈希索引的文件头，保存在第IX_FILE_HDR_PAGE页；目录本身保存在dir_pages_记录的页面中 */
+class IxHashFileHdr {
+public:
+    int tot_len_ = 0;                   // 序列化后的整体长度
+    int global_depth_ = 0;              // 目录的全局深度，目录共有2^global_depth_项
+    int col_num_ = 0;                   // 索引包含的字段数量
+    std::vector<ColType> col_types_;    // 字段的类型
+    std::vector<int> col_lens_;         // 字段的长度
+    int col_tot_len_ = 0;               // 索引包含的字段的总长度
+    std::vector<page_id_t> dir_pages_;  // 依次保存目录各部分的页面
+
+    void update_tot_len() {
+        tot_len_ = sizeof(int) * 5 + (sizeof(ColType) + sizeof(int)) * col_num_ + sizeof(page_id_t) * dir_pages_.size();
+    }
+
+    void serialize(char *dest) {
+        int offset = 0;
+        auto put = [&](const void *src, size_t len) {
+            memcpy(dest + offset, src, len);
+            offset += len;
+        };
+        int num_dir_pages = dir_pages_.size();
+        put(&tot_len_, sizeof(int));
+        put(&global_depth_, sizeof(int));
+        put(&col_num_, sizeof(int));
+        put(col_types_.data(), sizeof(ColType) * col_num_);
+        put(col_lens_.data(), sizeof(int) * col_num_);
+        put(&col_tot_len_, sizeof(int));
+        put(&num_dir_pages, sizeof(int));
+        put(dir_pages_.data(), sizeof(page_id_t) * num_dir_pages);
+        assert(offset == tot_len_);
+    }
+
+    void deserialize(const char *src) {
+        int offset = 0;
+        auto get = [&](void *dest, size_t len) {
+            memcpy(dest, src + offset, len);
+            offset += len;
+        };
+        int num_dir_pages;
+        get(&tot_len_, sizeof(int));
+        get(&global_depth_, sizeof(int));
+        get(&col_num_, sizeof(int));
+        col_types_.resize(col_num_);
+        col_lens_.resize(col_num_);
+        get(col_types_.data(), sizeof(ColType) * col_num_);
+        get(col_lens_.data(), sizeof(int) * col_num_);
+        get(&col_tot_len_, sizeof(int));
+        get(&num_dir_pages, sizeof(int));
+        dir_pages_.resize(num_dir_pages);
+        get(dir_pages_.data(), sizeof(page_id_t) * num_dir_pages);
+        assert(offset == tot_len_);
+    }
+};
+
+/* 哈希桶页面的页头，之后依次存放key数组和rid数组；桶装满且无法分裂时通过next_page链接溢出页 */
+struct IxHashBucketHdr {
+    int local_depth;                    // 桶的局部深度，同一条溢出链上的页面相同
+    int num_key;                        // 本页中键值对的数量
+    page_id_t next_page;                // 溢出链中的下一个页面，没有时为IX_NO_PAGE
+    int reserved;
+};
+
+/* LSM索引的文件头，保存在第IX_FILE_HDR_PAGE页；runs_按从新到旧的顺序记录各有序段描述页链的第一页 */
+class IxLsmFileHdr {
+public:
+    int tot_len_ = 0;                   // 序列化后的整体长度
+    int col_num_ = 0;                   // 索引包含的字段数量
+    std::vector<ColType> col_types_;    // 字段的类型
+    std::vector<int> col_lens_;         // 字段的长度
+    int col_tot_len_ = 0;               // 索引包含的字段的总长度
+    std::vector<page_id_t> runs_;       // 各有序段的第一个描述页
+
+    void update_tot_len() {
+        tot_len_ = sizeof(int) * 4 + (sizeof(ColType) + sizeof(int)) * col_num_ + sizeof(page_id_t) * runs_.size();
+    }
+
+    void serialize(char *dest) {
+        int offset = 0;
+        auto put = [&](const void *src, size_t len) {
+            memcpy(dest + offset, src, len);
+            offset += len;
+        };
+        int num_runs = runs_.size();
+        put(&tot_len_, sizeof(int));
+        put(&col_num_, sizeof(int));
+        put(col_types_.data(), sizeof(ColType) * col_num_);
+        put(col_lens_.data(), sizeof(int) * col_num_);
+        put(&col_tot_len_, sizeof(int));
+        put(&num_runs, sizeof(int));
+        put(runs_.data(), sizeof(page_id_t) * num_runs);
+        assert(offset == tot_len_);
+    }
+
+    void deserialize(const char *src) {
+        int offset = 0;
+        auto get = [&](void *dest, size_t len) {
+            memcpy(dest, src + offset, len);
+            offset += len;
+        };
+        int num_runs;
+        get(&tot_len_, sizeof(int));
+        get(&col_num_, sizeof(int));
+        col_types_.resize(col_num_);
+        col_lens_.resize(col_num_);
+        get(col_types_.data(), sizeof(ColType) * col_num_);
+        get(col_lens_.data(), sizeof(int) * col_num_);
+        get(&col_tot_len_, sizeof(int));
+        get(&num_runs, sizeof(int));
+        runs_.resize(num_runs);
+        get(runs_.data(), sizeof(page_id_t) * num_runs);
+        assert(offset == tot_len_);
+    }
+};
+
+/* LSM索引有序段页面的页头。数据页之后存放排好序的条目；描述页之后存放段的目录、栅栏key和Bloom过滤器的一部分 */
+struct IxLsmPageHdr {
+    int count;                          // 数据页中条目的数量，描述页中有效内容的字节数
+    page_id_t next_page;                // 描述页链中的下一个页面，数据页和链的最后一页为IX_NO_PAGE
+};
+
 class Iid {
 public:
     int page_no;
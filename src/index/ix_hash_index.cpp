@@ -0,0 +1,334 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "ix_hash_index.h"
+
+#include <mutex>
+
+IxHashIndexHandle::IxHashIndexHandle(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, int fd)
+    : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager), fd_(fd) {
+    int page_size = disk_manager_->get_page_size();
+    std::vector<char> buf(page_size);
+    disk_manager_->read_page(fd, IX_FILE_HDR_PAGE, buf.data(), page_size);
+    file_hdr_.deserialize(buf.data());
+
+    int key_len = file_hdr_.col_tot_len_;
+    int hdr_len = sizeof(IxHashBucketHdr);
+    bucket_cap_ = (page_size - hdr_len - static_cast<int>(alignof(Rid)) + 1) / (key_len + static_cast<int>(sizeof(Rid)));
+    rid_offset_ = (hdr_len + bucket_cap_ * key_len + alignof(Rid) - 1) / alignof(Rid) * alignof(Rid);
+    assert(bucket_cap_ >= 2);
+
+    // 文件头中目录页列表的长度决定了目录最多能有多少项
+    int entries_per_page = page_size / sizeof(page_id_t);
+    int fixed_len = file_hdr_.tot_len_ - sizeof(page_id_t) * file_hdr_.dir_pages_.size();
+    long long max_entries = static_cast<long long>((page_size - fixed_len) / sizeof(page_id_t)) * entries_per_page;
+    max_depth_ = 0;
+    while (max_depth_ < IX_HASH_MAX_DEPTH && (2LL << max_depth_) <= max_entries) {
+        max_depth_++;
+    }
+
+    int file_size = disk_manager_->get_file_size(disk_manager_->get_file_name(fd));
+    disk_manager_->set_fd2pageno(fd, (file_size + page_size - 1) / page_size);
+
+    // 从目录页中读出目录
+    dir_.resize(1 << file_hdr_.global_depth_);
+    for (size_t i = 0; i < file_hdr_.dir_pages_.size(); ++i) {
+        size_t start = i * entries_per_page;
+        if (start >= dir_.size()) {
+            break;
+        }
+        size_t cnt = std::min(dir_.size() - start, static_cast<size_t>(entries_per_page));
+        Page *page = fetch_page(file_hdr_.dir_pages_[i]);
+        memcpy(dir_.data() + start, page->get_data(), cnt * sizeof(page_id_t));
+        unpin_page(page, false);
+    }
+}
+
+/**
+ * @brief 编码后key的哈希值，目录按低位选桶
+ */
+uint64_t IxHashIndexHandle::hash_key(const char *key) const { return ix_hash_key(key, file_hdr_.col_tot_len_); }
+
+/**
+ * @brief 查找与key相等的所有键值对
+ *
+ * @param key 要查找的key，为记录中的原始格式
+ * @param result 找到的rid追加到result中
+ * @return 是否找到
+ */
+bool IxHashIndexHandle::get_value(const char *key, std::vector<Rid> *result, Transaction *transaction) {
+    char buf[IX_MAX_COL_LEN];
+    ix_normalize_key(key, buf, file_hdr_.col_types_, file_hdr_.col_lens_);
+    int key_len = file_hdr_.col_tot_len_;
+    bool found = false;
+
+    std::shared_lock<std::shared_mutex> lock(latch_);
+    page_id_t page_no = dir_[dir_index(hash_key(buf))];
+    while (page_no != IX_NO_PAGE) {
+        Page *page = fetch_page(page_no);
+        IxHashBucketHdr *hdr = bucket_hdr(page);
+        for (int i = 0; i < hdr->num_key; ++i) {
+            if (memcmp(bucket_key(page, i), buf, key_len) == 0) {
+                result->push_back(*bucket_rid(page, i));
+                found = true;
+            }
+        }
+        page_no = hdr->next_page;
+        unpin_page(page, false);
+    }
+    return found;
+}
+
+/**
+ * @brief 插入键值对，同一个key可以对应多个rid
+ *
+ * @return 插入成功返回true；(key, rid)已经存在时返回false
+ */
+bool IxHashIndexHandle::insert_entry(const char *key, const Rid &value, Transaction *transaction) {
+    char buf[IX_MAX_COL_LEN];
+    ix_normalize_key(key, buf, file_hdr_.col_types_, file_hdr_.col_lens_);
+    int key_len = file_hdr_.col_tot_len_;
+    uint64_t hash = hash_key(buf);
+
+    std::unique_lock<std::shared_mutex> lock(latch_);
+    while (true) {
+        int idx = dir_index(hash);
+        bool has_room = false;
+        page_id_t page_no = dir_[idx];
+        while (page_no != IX_NO_PAGE) {
+            Page *page = fetch_page(page_no);
+            IxHashBucketHdr *hdr = bucket_hdr(page);
+            for (int i = 0; i < hdr->num_key; ++i) {
+                if (*bucket_rid(page, i) == value && memcmp(bucket_key(page, i), buf, key_len) == 0) {
+                    unpin_page(page, false);
+                    return false;
+                }
+            }
+            has_room |= hdr->num_key < bucket_cap_;
+            page_no = hdr->next_page;
+            unpin_page(page, false);
+        }
+        // 桶已满时优先分裂，分裂后目录项可能改变，重新定位桶
+        if (!has_room && split_bucket(idx, buf, hash)) {
+            continue;
+        }
+        append_to_chain(dir_[idx], buf, value);
+        return true;
+    }
+}
+
+/**
+ * @brief 删除键值对。删空的溢出页从链中摘下并释放；桶本身不合并，目录也不收缩
+ *
+ * @return 是否找到并删除了(key, rid)
+ */
+bool IxHashIndexHandle::delete_entry(const char *key, const Rid &value, Transaction *transaction) {
+    char buf[IX_MAX_COL_LEN];
+    ix_normalize_key(key, buf, file_hdr_.col_types_, file_hdr_.col_lens_);
+    int key_len = file_hdr_.col_tot_len_;
+
+    std::unique_lock<std::shared_mutex> lock(latch_);
+    Page *prev = nullptr;
+    page_id_t page_no = dir_[dir_index(hash_key(buf))];
+    while (page_no != IX_NO_PAGE) {
+        Page *page = fetch_page(page_no);
+        IxHashBucketHdr *hdr = bucket_hdr(page);
+        int pos = -1;
+        for (int i = 0; i < hdr->num_key; ++i) {
+            if (*bucket_rid(page, i) == value && memcmp(bucket_key(page, i), buf, key_len) == 0) {
+                pos = i;
+                break;
+            }
+        }
+        if (pos == -1) {
+            if (prev != nullptr) {
+                unpin_page(prev, false);
+            }
+            prev = page;
+            page_no = hdr->next_page;
+            continue;
+        }
+        // 用本页的最后一个键值对填补删除的位置
+        int last = hdr->num_key - 1;
+        if (pos != last) {
+            memcpy(bucket_key(page, pos), bucket_key(page, last), key_len);
+            *bucket_rid(page, pos) = *bucket_rid(page, last);
+        }
+        hdr->num_key--;
+        if (hdr->num_key == 0 && prev != nullptr) {
+            bucket_hdr(prev)->next_page = hdr->next_page;
+            unpin_page(prev, true);
+            unpin_page(page, false);
+            buffer_pool_manager_->deallocate_page(page->get_page_id());
+            return true;
+        }
+        if (hdr->num_key == 0 && hdr->next_page != IX_NO_PAGE) {
+            // 桶的首页删空时把下一个溢出页的内容搬上来，目录仍指向首页
+            Page *next = fetch_page(hdr->next_page);
+            PageId next_id = next->get_page_id();
+            memcpy(page->get_data(), next->get_data(), disk_manager_->get_page_size());
+            unpin_page(next, false);
+            buffer_pool_manager_->deallocate_page(next_id);
+        }
+        unpin_page(page, true);
+        if (prev != nullptr) {
+            unpin_page(prev, false);
+        }
+        return true;
+    }
+    if (prev != nullptr) {
+        unpin_page(prev, false);
+    }
+    return false;
+}
+
+/**
+ * @brief 分配一个新的空桶页面，返回时页面仍被固定
+ */
+Page *IxHashIndexHandle::create_bucket(int local_depth) {
+    PageId page_id = {.fd = fd_, .page_no = INVALID_PAGE_ID};
+    Page *page = buffer_pool_manager_->new_page(&page_id);
+    *bucket_hdr(page) = {.local_depth = local_depth, .num_key = 0, .next_page = IX_NO_PAGE, .reserved = 0};
+    return page;
+}
+
+/**
+ * @brief 把键值对放入以head_no开头的溢出链中第一个有空位的页面，链上的页面都满时在末尾追加溢出页
+ * @param key 编码后的key
+ */
+void IxHashIndexHandle::append_to_chain(page_id_t head_no, const char *key, const Rid &rid) {
+    Page *page = fetch_page(head_no);
+    while (true) {
+        IxHashBucketHdr *hdr = bucket_hdr(page);
+        if (hdr->num_key < bucket_cap_) {
+            memcpy(bucket_key(page, hdr->num_key), key, file_hdr_.col_tot_len_);
+            *bucket_rid(page, hdr->num_key) = rid;
+            hdr->num_key++;
+            unpin_page(page, true);
+            return;
+        }
+        Page *next;
+        if (hdr->next_page == IX_NO_PAGE) {
+            next = create_bucket(hdr->local_depth);
+            hdr->next_page = next->get_page_id().page_no;
+            unpin_page(page, true);
+        } else {
+            next = fetch_page(hdr->next_page);
+            unpin_page(page, false);
+        }
+        page = next;
+    }
+}
+
+/**
+ * @brief 把目录第idx项指向的桶分裂成两个局部深度加一的桶，局部深度等于全局深度时先把目录加倍
+ *
+ * @param key 待插入的key（已编码），hash为它的哈希值
+ * @return 是否进行了分裂。桶中所有key与待插入的key在可用的哈希位上都相同、分裂后仍会全部落在同一个桶中时，
+ * 或者已经达到深度上限时，不分裂，由调用者追加溢出页
+ */
+bool IxHashIndexHandle::split_bucket(int idx, const char *key, uint64_t hash) {
+    int key_len = file_hdr_.col_tot_len_;
+    Page *head = fetch_page(dir_[idx]);
+    int local_depth = bucket_hdr(head)->local_depth;
+    if (local_depth >= max_depth_) {
+        unpin_page(head, false);
+        return false;
+    }
+
+    // 取出溢出链上的所有键值对
+    std::vector<char> keys;
+    std::vector<Rid> rids;
+    std::vector<PageId> overflow;
+    uint64_t usable_bits = ((1ULL << max_depth_) - 1) & ~((1ULL << local_depth) - 1);
+    bool separable = false;
+    for (Page *page = head;;) {
+        IxHashBucketHdr *hdr = bucket_hdr(page);
+        for (int i = 0; i < hdr->num_key; ++i) {
+            const char *k = bucket_key(page, i);
+            keys.insert(keys.end(), k, k + key_len);
+            rids.push_back(*bucket_rid(page, i));
+            separable |= ((hash_key(k) ^ hash) & usable_bits) != 0;
+        }
+        page_id_t next_no = hdr->next_page;
+        if (page != head) {
+            overflow.push_back(page->get_page_id());
+            unpin_page(page, false);
+        }
+        if (next_no == IX_NO_PAGE) {
+            break;
+        }
+        page = fetch_page(next_no);
+    }
+    if (!separable) {
+        unpin_page(head, false);
+        return false;
+    }
+
+    if (local_depth == file_hdr_.global_depth_) {
+        size_t old_size = dir_.size();
+        dir_.resize(old_size * 2);
+        std::copy(dir_.begin(), dir_.begin() + old_size, dir_.begin() + old_size);
+        file_hdr_.global_depth_++;
+    }
+
+    // 原桶保留第local_depth位为0的目录项，新桶接管第local_depth位为1的目录项
+    Page *sibling = create_bucket(local_depth + 1);
+    page_id_t sibling_no = sibling->get_page_id().page_no;
+    *bucket_hdr(head) = {.local_depth = local_depth + 1, .num_key = 0, .next_page = IX_NO_PAGE, .reserved = 0};
+    size_t low_mask = (1ULL << local_depth) - 1;
+    size_t low_bits = idx & low_mask;
+    for (size_t i = 0; i < dir_.size(); ++i) {
+        if ((i & low_mask) == low_bits && ((i >> local_depth) & 1)) {
+            dir_[i] = sibling_no;
+        }
+    }
+    unpin_page(head, true);
+    unpin_page(sibling, true);
+    for (auto &page_id : overflow) {
+        buffer_pool_manager_->deallocate_page(page_id);
+    }
+
+    for (size_t i = 0; i < rids.size(); ++i) {
+        const char *k = keys.data() + i * key_len;
+        append_to_chain(dir_[dir_index(hash_key(k))], k, rids[i]);
+    }
+    return true;
+}
+
+/**
+ * @brief 把内存中的目录写入目录页，目录页不够时分配新页；然后把文件头写回第IX_FILE_HDR_PAGE页
+ */
+void IxHashIndexHandle::flush_directory() {
+    std::unique_lock<std::shared_mutex> lock(latch_);
+    int page_size = disk_manager_->get_page_size();
+    size_t entries_per_page = page_size / sizeof(page_id_t);
+    size_t num_dir_pages = (dir_.size() + entries_per_page - 1) / entries_per_page;
+    for (size_t i = 0; i < num_dir_pages; ++i) {
+        Page *page;
+        if (i < file_hdr_.dir_pages_.size()) {
+            page = fetch_page(file_hdr_.dir_pages_[i]);
+        } else {
+            PageId page_id = {.fd = fd_, .page_no = INVALID_PAGE_ID};
+            page = buffer_pool_manager_->new_page(&page_id);
+            file_hdr_.dir_pages_.push_back(page_id.page_no);
+        }
+        size_t start = i * entries_per_page;
+        size_t cnt = std::min(dir_.size() - start, entries_per_page);
+        memcpy(page->get_data(), dir_.data() + start, cnt * sizeof(page_id_t));
+        unpin_page(page, true);
+    }
+
+    file_hdr_.update_tot_len();
+    assert(file_hdr_.tot_len_ <= page_size);
+    std::vector<char> buf(page_size);
+    file_hdr_.serialize(buf.data());
+    disk_manager_->write_page(fd_, IX_FILE_HDR_PAGE, buf.data(), page_size);
+}
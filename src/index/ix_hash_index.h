@@ -0,0 +1,86 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <shared_mutex>
+#include <vector>
+
+#include "ix_defs.h"
+#include "ix_index_handle.h"
+#include "ix_point_index.h"
+#include "transaction/transaction.h"
+
+/**
+ * @brief 可扩展哈希索引，只支持等值查找
+ * 目录的2^global_depth项指向桶页面，局部深度为d的桶被低d位哈希值相同的2^(global_depth-d)个目录项共享。
+ * 桶满时分裂成两个局部深度加一的桶，必要时把目录加倍；只有桶中的key哈希值全部相同、或者已经达到
+ * IX_HASH_MAX_DEPTH时，分裂无法奏效，才在桶之后链接溢出页。
+ * key按ix_normalize_key编码后存放，相等判断只需memcmp。目录常驻内存，关闭索引时写回目录页
+ */
+class IxHashIndexHandle : public IxPointIndexHandle {
+    friend class IxManager;
+
+   private:
+    DiskManager *disk_manager_;
+    BufferPoolManager *buffer_pool_manager_;
+    int fd_;                                    // 存储哈希索引的文件
+    IxHashFileHdr file_hdr_;
+    std::vector<page_id_t> dir_;                // 目录，第i项为低global_depth位等于i的key所在的桶
+    int bucket_cap_;                            // 每个桶页面最多存放的键值对数量
+    int rid_offset_;                            // 桶页面中rid数组的起始偏移，按Rid对齐
+    int max_depth_;                             // 全局深度的上限，同时受文件头中目录页列表的容量限制
+    std::shared_mutex latch_;                   // 查找加共享锁，插入/删除加排他锁
+
+   public:
+    IxHashIndexHandle(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, int fd);
+
+    int get_fd() const override { return fd_; }
+
+    int get_global_depth() const { return file_hdr_.global_depth_; }
+
+    int get_bucket_capacity() const { return bucket_cap_; }
+
+    bool get_value(const char *key, std::vector<Rid> *result, Transaction *transaction) override;
+
+    bool insert_entry(const char *key, const Rid &value, Transaction *transaction) override;
+
+    bool delete_entry(const char *key, const Rid &value, Transaction *transaction) override;
+
+    void flush() override { flush_directory(); }
+
+    /* 把内存中的目录写入目录页，并更新文件头 */
+    void flush_directory();
+
+   private:
+    uint64_t hash_key(const char *key) const;
+
+    int dir_index(uint64_t hash) const { return static_cast<int>(hash & ((1ULL << file_hdr_.global_depth_) - 1)); }
+
+    IxHashBucketHdr *bucket_hdr(Page *page) const { return reinterpret_cast<IxHashBucketHdr *>(page->get_data()); }
+
+    char *bucket_key(Page *page, int i) const {
+        return page->get_data() + sizeof(IxHashBucketHdr) + i * file_hdr_.col_tot_len_;
+    }
+
+    Rid *bucket_rid(Page *page, int i) const {
+        return reinterpret_cast<Rid *>(page->get_data() + rid_offset_) + i;
+    }
+
+    Page *fetch_page(page_id_t page_no) { return buffer_pool_manager_->fetch_page({.fd = fd_, .page_no = page_no}); }
+
+    void unpin_page(Page *page, bool dirty) { buffer_pool_manager_->unpin_page(page->get_page_id(), dirty); }
+
+    Page *create_bucket(int local_depth);
+
+    void append_to_chain(page_id_t head_no, const char *key, const Rid &rid);
+
+    bool split_bucket(int idx, const char *key, uint64_t hash);
+};
@@ -10,8 +10,147 @@ See the Mulan PSL v2 for more details. */
 
 #include "ix_index_handle.h"
 
+#include <algorithm>
+#include <climits>
+#include <thread>
+
 #include "ix_scan.h"
 
+/**
+ * @brief 根据结点的公共前缀长度确定keys和rids的位置
+ * 没有公共前缀时与不压缩的布局相同；否则页面数据依次为公共前缀、各个key的剩余部分、按Rid对齐的rids，
+ * 剩余部分的个数按slots_for(prefix_len)预留
+ */
+void IxNodeHandle::init_layout() {
+    char *base = page->get_data() + sizeof(IxPageHdr);
+    int prefix = is_compressed() ? prefix_len() : 0;
+    if (prefix == 0) {
+        keys = base;
+        rids = reinterpret_cast<Rid *>(keys + file_hdr->keys_size_);
+        return;
+    }
+    keys = base + prefix;
+    size_t rid_off = prefix + static_cast<size_t>(slots_for(prefix)) * (file_hdr->col_tot_len_ - prefix);
+    rid_off = (rid_off + alignof(Rid) - 1) / alignof(Rid) * alignof(Rid);
+    rids = reinterpret_cast<Rid *>(base + rid_off);
+}
+
+/**
+ * @brief 公共前缀长度为prefix时叶子结点最多能存放的键值对数量（与不压缩时一样包含一个预留的空位）
+ * 可用空间按btree_order_换算，不小于不压缩时的btree_order_+1
+ */
+int IxNodeHandle::slots_for(int prefix) const {
+    int order = file_hdr->btree_order_;
+    if (prefix == 0) return order + 1;
+    int key_len = file_hdr->col_tot_len_;
+    int avail = (order + 1) * (key_len + static_cast<int>(sizeof(Rid)));
+    return (avail - prefix - static_cast<int>(alignof(Rid) - 1)) / (key_len - prefix + static_cast<int>(sizeof(Rid)));
+}
+
+/* 在非空的结点中插入key后的公共前缀长度 */
+int IxNodeHandle::prefix_with(const char *key) const {
+    if (!is_compressed()) return 0;
+    return ix_common_prefix(keys - prefix_len(), key, prefix_len());
+}
+
+/* 插入key后公共前缀会缩短，判断缩短后的结点是否还能放下已有的键值对和key；不压缩的结点总是留有一个空位 */
+bool IxNodeHandle::has_room_for(const char *key) const {
+    if (page_hdr->num_key == 0) return true;
+    return page_hdr->num_key + 1 <= slots_for(prefix_with(key));
+}
+
+/* 插入key后结点是否既不需要拆分也不需要为缩短的前缀腾出位置 */
+bool IxNodeHandle::fits_without_split(const char *key) const {
+    int max_size = page_hdr->num_key == 0 ? get_max_size() : slots_for(prefix_with(key));
+    return page_hdr->num_key + 1 < max_size;
+}
+
+/**
+ * @brief 得到第i个完整的key
+ * @param buf 长度至少为col_tot_len_，只在前缀压缩时使用
+ * @return 不压缩时直接指向结点中的key，否则为拼接出完整key的buf
+ */
+const char *IxNodeHandle::full_key(int i, char *buf) const {
+    int prefix = is_compressed() ? prefix_len() : 0;
+    if (prefix == 0) return get_key(i);
+    memcpy(buf, keys - prefix, prefix);
+    memcpy(buf + prefix, get_key(i), file_hdr->col_tot_len_ - prefix);
+    return buf;
+}
+
+/**
+ * @brief 得到从start开始连续存放的n个完整的key
+ * @return 不压缩时直接指向结点中的key，否则把完整的key依次复制到buf中
+ */
+const char *IxNodeHandle::full_keys(int start, int n, std::vector<char> &buf) const {
+    if (!is_compressed()) return get_key(start);
+    int key_len = file_hdr->col_tot_len_;
+    buf.resize(static_cast<size_t>(n) * key_len);
+    for (int i = 0; i < n; i++) {
+        const char *key = full_key(start + i, buf.data() + static_cast<size_t>(i) * key_len);
+        if (key != buf.data() + static_cast<size_t>(i) * key_len) {
+            memcpy(buf.data() + static_cast<size_t>(i) * key_len, key, key_len);
+        }
+    }
+    return buf.data();
+}
+
+/**
+ * @brief 把前缀压缩的叶子结点中的键值对按新的公共前缀长度重新存放
+ * @param prefix 新的公共前缀长度，必须是结点中所有key的公共前缀
+ * @param src 以该公共前缀开头的完整key，可以指向结点本身的数据
+ */
+void IxNodeHandle::set_prefix(int prefix, const char *src) {
+    assert(is_compressed());
+    int size = get_size();
+    int key_len = file_hdr->col_tot_len_;
+    std::vector<char> old_keys;
+    full_keys(0, size, old_keys);
+    std::vector<Rid> old_rids(rids, rids + size);
+    std::vector<char> head(src, src + prefix);
+    page_hdr->prefix_len = static_cast<uint16_t>(prefix);
+    init_layout();
+    assert(size <= slots_for(prefix));
+    memcpy(keys - prefix, head.data(), prefix);
+    for (int i = 0; i < size; i++) {
+        memcpy(get_key(i), old_keys.data() + static_cast<size_t>(i) * key_len + prefix, key_len - prefix);
+    }
+    std::copy(old_rids.begin(), old_rids.end(), rids);
+}
+
+/* 比较第pos个key与完整的key */
+int IxNodeHandle::compare_at(int pos, const char *key) const {
+    int prefix = is_compressed() ? prefix_len() : 0;
+    if (prefix == 0) return compare_key(get_key(pos), key);
+    int res = memcmp(keys - prefix, key, prefix);
+    if (res != 0) return res;
+    return memcmp(get_key(pos), key + prefix, file_hdr->col_tot_len_ - prefix);
+}
+
+/**
+ * @brief 在前缀压缩的叶子结点中二分查找第一个>=target（upper为true时为>target）的下标
+ * target与公共前缀不同时一定小于或大于结点中所有的key，否则只需比较去掉前缀的部分
+ */
+int IxNodeHandle::search_compressed(const char *target, bool upper) const {
+    int prefix = prefix_len();
+    int size = page_hdr->num_key;
+    int res = memcmp(target, keys - prefix, prefix);
+    if (res != 0) return res < 0 ? 0 : size;
+    int stride = file_hdr->col_tot_len_ - prefix;
+    target += prefix;
+    int lo = 0, hi = size;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        res = memcmp(keys + static_cast<size_t>(mid) * stride, target, stride);
+        if (res < 0 || (upper && res == 0)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
 /**
  * @brief 在当前node中查找第一个>=target的key_idx
  *
@@ -19,16 +158,9 @@ See the Mulan PSL v2 for more details. */
  * @note 返回key index（同时也是rid index），作为slot no
  */
 int IxNodeHandle::lower_bound(const char *target) const {
-    // 顺序查找第一个 >= target 的key
-    int size = page_hdr->num_key;
-    int key_len = file_hdr->col_tot_len_;
-    for (int i = 0; i < size; i++) {
-        char *cur_key = keys + i * key_len;
-        if (ix_compare(cur_key, target, file_hdr->col_types_, file_hdr->col_lens_) >= 0) {
-            return i;
-        }
-    }
-    return size;
+    if (is_compressed() && prefix_len() > 0) return search_compressed(target, false);
+    // 二分查找第一个 >= target 的key
+    return key_search(keys, page_hdr->num_key, target, file_hdr, false);
 }
 
 /**
@@ -38,17 +170,12 @@ int IxNodeHandle::lower_bound(const char *target) const {
  * @note 注意此处的范围从1开始
  */
 int IxNodeHandle::upper_bound(const char *target) const {
-    // 查找第一个 > target 的key
+    // 二分查找第一个 > target 的key
+    if (is_compressed() && prefix_len() > 0) return search_compressed(target, true);
     int size = page_hdr->num_key;
     int start = page_hdr->is_leaf ? 0 : 1;  // 内部结点从1开始
-    int key_len = file_hdr->col_tot_len_;
-    for (int i = start; i < size; i++) {
-        char *cur_key = keys + i * key_len;
-        if (ix_compare(cur_key, target, file_hdr->col_types_, file_hdr->col_lens_) > 0) {
-            return i;
-        }
-    }
-    return size;
+    if (start >= size) return size;
+    return start + key_search(get_key(start), size - start, target, file_hdr, true);
 }
 
 /**
@@ -63,8 +190,7 @@ bool IxNodeHandle::leaf_lookup(const char *key, Rid **value) {
     assert(is_leaf_page());
     int pos = lower_bound(key);
     if (pos < get_size()) {
-        char *cur_key = get_key(pos);
-        if (ix_compare(cur_key, key, file_hdr->col_types_, file_hdr->col_lens_) == 0) {
+        if (compare_at(pos, key) == 0) {
             *value = get_rid(pos);
             return true;
         }
@@ -106,13 +232,29 @@ void IxNodeHandle::insert_pairs(int pos, const char *key, const Rid *rid, int n)
     assert(pos >= 0 && pos <= size);
     if (n == 0) return;
     int key_len = file_hdr->col_tot_len_;
+    if (is_compressed()) {
+        // 插入的key有序，与首尾两个key的公共前缀就是所有插入key的公共前缀；key互不相同，前缀至多col_tot_len_-1
+        const char *last = key + static_cast<size_t>(n - 1) * key_len;
+        int prefix;
+        if (size == 0) {
+            prefix = std::min(ix_common_prefix(key, last, key_len), key_len - 1);
+        } else {
+            prefix = std::min(prefix_with(key), prefix_with(last));
+        }
+        if (size == 0 || prefix != prefix_len()) {
+            set_prefix(prefix, key);
+        }
+        assert(size + n <= slots_for(prefix));
+    }
+    int stride = key_stride();
+    int skip = key_len - stride;
     int tail_cnt = size - pos;
     if (tail_cnt > 0) {
-        memmove(get_key(pos + n), get_key(pos), tail_cnt * key_len);
+        memmove(get_key(pos + n), get_key(pos), tail_cnt * stride);
         memmove(get_rid(pos + n), get_rid(pos), tail_cnt * static_cast<int>(sizeof(Rid)));
     }
     for (int i = 0; i < n; i++) {
-        memcpy(get_key(pos + i), key + i * key_len, key_len);
+        memcpy(get_key(pos + i), key + i * key_len + skip, stride);
         set_rid(pos + i, rid[i]);
     }
     set_size(size + n);
@@ -128,8 +270,7 @@ void IxNodeHandle::insert_pairs(int pos, const char *key, const Rid *rid, int n)
 int IxNodeHandle::insert(const char *key, const Rid &value) {
     int pos = lower_bound(key);
     if (pos < get_size()) {
-        char *cur_key = get_key(pos);
-        if (ix_compare(cur_key, key, file_hdr->col_types_, file_hdr->col_lens_) == 0) {
+        if (compare_at(pos, key) == 0) {
             return get_size();  // 唯一索引：不插入重复键
         }
     }
@@ -145,10 +286,10 @@ int IxNodeHandle::insert(const char *key, const Rid &value) {
 void IxNodeHandle::erase_pair(int pos) {
     int size = get_size();
     assert(pos >= 0 && pos < size);
-    int key_len = file_hdr->col_tot_len_;
+    int stride = key_stride();
     int move_cnt = size - pos - 1;
     if (move_cnt > 0) {
-        memmove(get_key(pos), get_key(pos + 1), move_cnt * key_len);
+        memmove(get_key(pos), get_key(pos + 1), move_cnt * stride);
         memmove(get_rid(pos), get_rid(pos + 1), move_cnt * static_cast<int>(sizeof(Rid)));
     }
     set_size(size - 1);
@@ -163,8 +304,7 @@ void IxNodeHandle::erase_pair(int pos) {
 int IxNodeHandle::remove(const char *key) {
     int pos = lower_bound(key);
     if (pos < get_size()) {
-        char *cur_key = get_key(pos);
-        if (ix_compare(cur_key, key, file_hdr->col_types_, file_hdr->col_lens_) == 0) {
+        if (compare_at(pos, key) == 0) {
             erase_pair(pos);
         }
     }
@@ -175,51 +315,148 @@ IxIndexHandle::IxIndexHandle(DiskManager *disk_manager, BufferPoolManager *buffe
     : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager), fd_(fd) {
     // init file_hdr_
     disk_manager_->read_page(fd, IX_FILE_HDR_PAGE, (char *)&file_hdr_, sizeof(file_hdr_));
-    char* buf = new char[PAGE_SIZE];
-    memset(buf, 0, PAGE_SIZE);
-    disk_manager_->read_page(fd, IX_FILE_HDR_PAGE, buf, PAGE_SIZE);
+    int page_size = disk_manager_->get_page_size();
+    char* buf = new char[page_size];
+    memset(buf, 0, page_size);
+    disk_manager_->read_page(fd, IX_FILE_HDR_PAGE, buf, page_size);
     file_hdr_ = new IxFileHdr();
     file_hdr_->deserialize(buf);
+    key_search_ = ix_key_search_for(file_hdr_);
+    resident_cap_ = buffer_pool_manager_->get_pool_size() / IX_RESIDENT_POOL_SHARE;
     
-    // disk_manager管理的fd对应的文件中，设置从file_hdr_->num_pages开始分配page_no
-    int now_page_no = disk_manager_->get_fd2pageno(fd);
-    disk_manager_->set_fd2pageno(fd, now_page_no + 1);
+    // disk_manager管理的fd对应的文件中，从文件末尾开始分配page_no；结点被删除后释放的页面记录在DiskManager中，优先复用
+    // 关闭索引时所有页面都已写回，因此文件大小就是已经分配的页面个数
+    int file_size = disk_manager_->get_file_size(disk_manager_->get_file_name(fd));
+    disk_manager_->set_fd2pageno(fd, (file_size + page_size - 1) / page_size);
 }
 
 /**
- * @brief 用于查找指定键所在的叶子结点
- * @param key 要查找的目标key值
+ * @brief 用于查找指定键所在的叶子结点，自顶向下对路径上的结点加latch（latch crabbing）
+ * FIND：加孩子结点的读latch后立即释放父结点的读latch，返回的叶子结点持有读latch
+ * INSERT/DELETE：路径上的结点都加写latch并记录在transaction的index_latch_page_set中，
+ * 当某个结点安全（本次修改不会向上传播）时释放它的全部祖先结点以及root_latch_
+ *
+ * @param key 要查找的目标key值，为结点中的存储格式（见to_index_key）
  * @param operation 查找到目标键值对后要进行的操作类型
- * @param transaction 事务参数，如果不需要则默认传入nullptr
- * @return [leaf node] and [root_is_latched] 返回目标叶子结点以及根结点是否加锁
+ * @param transaction 事务参数，查找时可以传入nullptr，插入/删除时不能为空
+ * @return [leaf node] and [root_is_latched] 返回目标叶子结点以及root_latch_是否仍被持有
  * @note need to Unlatch and unpin the leaf node outside!
- * 注意：用了FindLeafPage之后一定要unlatch叶结点，否则下次latch该结点会堵塞！
+ * 注意：FIND之后需要r_unlatch并unpin叶结点；INSERT/DELETE之后需要调用release_latched_pages，
+ * 并在root_is_latched时释放root_latch_
  */
 std::pair<IxNodeHandle *, bool> IxIndexHandle::find_leaf_page(const char *key, Operation operation,
                                                             Transaction *transaction, bool find_first) {
+    root_latch_.lock();
     if (is_empty()) {
+        root_latch_.unlock();
         return std::make_pair(nullptr, false);
     }
+    if (operation == Operation::FIND) {
+        // 上层的内部结点常驻缓冲池，经过它们时不访问缓冲池
+        IxNodeHandle *node = fetch_resident_node(file_hdr_->root_page_);
+        node->page->r_latch();
+        root_latch_.unlock();
+        make_resident(node, 0);
+        for (int depth = 1; !node->is_leaf_page(); depth++) {
+            IxNodeHandle *child = fetch_resident_node(node->internal_lookup(key));
+            child->page->r_latch();
+            make_resident(child, depth);
+            node->page->r_unlatch();
+            unpin_node(node, false);
+            delete node;
+            node = child;
+        }
+        return std::make_pair(node, false);
+    }
     IxNodeHandle *node = fetch_node(file_hdr_->root_page_);
+
+    // 结点的pin由page_set持有，直到release_latched_pages
+    auto page_set = transaction->get_index_latch_page_set();
+    bool root_is_latched = true;
+    node->page->w_latch();
+    if (is_safe(node, key, operation)) {
+        root_latch_.unlock();
+        root_is_latched = false;
+    }
+    page_set->push_back(node->page);
     while (!node->is_leaf_page()) {
-        page_id_t child_no = node->internal_lookup(key);
-        buffer_pool_manager_->unpin_page(node->get_page_id(), false);
-        node = fetch_node(child_no);
+        IxNodeHandle *child = fetch_node(node->internal_lookup(key));
+        child->page->w_latch();
+        if (is_safe(child, key, operation)) {
+            if (root_is_latched) {
+                root_latch_.unlock();
+                root_is_latched = false;
+            }
+            release_latched_pages(transaction, false);
+        }
+        page_set->push_back(child->page);
+        delete node;
+        node = child;
+    }
+    return std::make_pair(node, root_is_latched);
+}
+
+/**
+ * @brief 判断结点在本次插入/删除中是否安全，即修改不会传播到它的父结点，调用时需持有该结点及其父结点的写latch
+ * 插入后不分裂、删除后不合并/重分配，并且结点的第一个key不变（否则maintain_parent会修改父结点）
+ *
+ * @param node 已经加写latch的结点
+ * @param key 要插入/删除的key
+ * @param operation 插入或删除
+ */
+bool IxIndexHandle::is_safe(IxNodeHandle *node, const char *key, Operation operation) {
+    if (node->is_root_page()) {
+        // 根结点的第一个key不需要维护，只有根结点分裂或被删除时才会修改root_page_
+        if (operation == Operation::INSERT) {
+            return node->fits_without_split(key);
+        }
+        return node->get_size() > (node->is_leaf_page() ? 1 : 2);
+    }
+    // 叶子结点在第0个位置插入/删除，或者内部结点沿第0个孩子向下，第一个key都可能改变
+    int pos = node->is_leaf_page() ? node->lower_bound(key) : node->upper_bound(key) - 1;
+    if (pos <= 0) {
+        return false;
+    }
+    if (operation == Operation::INSERT) {
+        return node->fits_without_split(key);
+    }
+    return node->get_size() - 1 >= node->get_min_size();
+}
+
+/**
+ * @brief 释放插入/删除过程中记录在index_latch_page_set中的页面：释放写latch并unpin
+ *
+ * @param transaction 事务指针
+ * @param is_dirty 页面是否被修改
+ */
+void IxIndexHandle::release_latched_pages(Transaction *transaction, bool is_dirty) {
+    auto page_set = transaction->get_index_latch_page_set();
+    while (!page_set->empty()) {
+        Page *page = page_set->front();
+        page_set->pop_front();
+        page->w_unlatch();
+        buffer_pool_manager_->unpin_page(page->get_page_id(), is_dirty);
     }
-    return std::make_pair(node, false);
 }
 
 /**
  * @brief 用于查找指定键在叶子结点中的对应的值result
  *
  * @param key 查找的目标key值
- * @param result 用于存放结果的容器
+ * @param result 用于存放结果的容器，非唯一索引放入所有key相同的rid
  * @param transaction 事务指针
  * @return bool 返回目标键值对是否存在
  */
 bool IxIndexHandle::get_value(const char *key, std::vector<Rid> *result, Transaction *transaction) {
-    std::lock_guard<std::mutex> guard(root_latch_);
-    if (is_empty()) return false;
+    if (!file_hdr_->unique_) {
+        size_t old_size = result->size();
+        for (IxScan scan(this, lower_bound(key), upper_bound(key), buffer_pool_manager_); !scan.is_end(); scan.next()) {
+            result->push_back(scan.rid());
+        }
+        return result->size() > old_size;
+    }
+    char key_buf[IX_MAX_COL_LEN];
+    key = to_index_key(key, key_buf);
     auto [leaf, _] = find_leaf_page(key, Operation::FIND, transaction);
     if (leaf == nullptr) return false;
     Rid *out = nullptr;
@@ -227,18 +464,332 @@ bool IxIndexHandle::get_value(const char *key, std::vector<Rid> *result, Transac
     if (found) {
         result->push_back(*out);
     }
+    leaf->page->r_unlatch();
     buffer_pool_manager_->unpin_page(leaf->get_page_id(), false);
+    delete leaf;
+    return found;
+}
+
+/**
+ * @brief 批量等值查找。keys按升序排列时，所有key在一次自左向右的遍历中完成：记录从根结点到当前叶子的路径，
+ * 路径上的结点保持读latch和pin，下一个key只需从仍然覆盖它的最低祖先向下查找，而不必每次从根结点开始，
+ * 相邻的key落在同一个叶子中时不需要再获取任何页面。查找期间持有根结点的读latch，写操作需等待整批查找结束
+ *
+ * @param keys 连续存放的num_keys个调用者格式的key，应按索引的顺序升序排列；乱序的key仍能正确查找，只是需要从根结点重新查找
+ * @param[out] results 大小被设为num_keys，results[i]为第i个key对应的全部rid
+ * @return 找到的key的数量
+ */
+int IxIndexHandle::get_values(const char *keys, int num_keys, std::vector<std::vector<Rid>> *results,
+                              Transaction *transaction) {
+    results->assign(num_keys, std::vector<Rid>());
+    if (num_keys == 0) return 0;
+    root_latch_.lock();
+    if (is_empty()) {
+        root_latch_.unlock();
+        return 0;
+    }
+    // path[i]的第slots[i]个孩子为path[i+1]，path.back()为当前所在的结点
+    std::vector<IxNodeHandle *> path;
+    std::vector<int> slots;
+    path.push_back(fetch_resident_node(file_hdr_->root_page_));
+    path.back()->page->r_latch();
+    root_latch_.unlock();
+    make_resident(path.back(), 0);
+
+    auto release_to = [&](size_t depth) {
+        while (path.size() > depth) {
+            IxNodeHandle *node = path.back();
+            node->page->r_unlatch();
+            unpin_node(node, false);
+            delete node;
+            path.pop_back();
+        }
+        slots.resize(depth > 0 ? depth - 1 : 0);
+    };
+    auto descend = [&](const char *key) {
+        while (!path.back()->is_leaf_page()) {
+            IxNodeHandle *node = path.back();
+            int idx = key == nullptr ? 0 : std::max(node->upper_bound(key) - 1, 0);
+            IxNodeHandle *child = fetch_resident_node(node->value_at(idx));
+            child->page->r_latch();
+            make_resident(child, path.size());
+            path.push_back(child);
+            slots.push_back(idx);
+        }
+    };
+    // path[depth]的子树中的key都小于路径上它右侧最近的分隔key
+    auto covers = [&](size_t depth, const char *key) {
+        for (size_t j = depth; j-- > 0;) {
+            if (slots[j] + 1 < path[j]->get_size()) {
+                return path[j]->compare_key(key, path[j]->get_key(slots[j] + 1)) < 0;
+            }
+        }
+        return true;
+    };
+    // 移动到下一个叶子：回溯到还有右侧孩子的祖先，再沿最左侧的孩子向下
+    auto next_leaf = [&]() {
+        size_t depth = path.size() - 1;
+        while (depth > 0 && slots[depth - 1] + 1 >= path[depth - 1]->get_size()) depth--;
+        if (depth == 0) return false;
+        int idx = slots[depth - 1] + 1;
+        release_to(depth);
+        IxNodeHandle *child = fetch_resident_node(path.back()->value_at(idx));
+        child->page->r_latch();
+        make_resident(child, path.size());
+        path.push_back(child);
+        slots.push_back(idx);
+        descend(nullptr);
+        return true;
+    };
+
+    int key_len = file_hdr_->user_key_len();
+    int found = 0;
+    char key_buf[IX_MAX_COL_LEN];
+    char prev_buf[IX_MAX_COL_LEN];
+    char entry_buf[IX_MAX_COL_LEN];
+    for (int i = 0; i < num_keys; ++i) {
+        const char *raw = keys + static_cast<size_t>(i) * key_len;
+        // 非唯一索引以最小的rid补全key，从第一个不小于key的键值对开始
+        const char *key = to_index_key(raw, Rid{.page_no = INT_MIN, .slot_no = INT_MIN}, key_buf);
+        if (i > 0) {
+            int cmp = path[0]->compare_key(key, prev_buf);
+            if (cmp == 0) {
+                (*results)[i] = (*results)[i - 1];
+                found += !(*results)[i].empty();
+                continue;
+            }
+            if (cmp < 0) {
+                release_to(1);
+            }
+        }
+        memcpy(prev_buf, key, file_hdr_->col_tot_len_);
+
+        size_t depth = path.size();
+        while (depth > 1 && !covers(depth - 1, key)) depth--;
+        release_to(depth);
+        descend(key);
+
+        IxNodeHandle *leaf = path.back();
+        if (file_hdr_->unique_) {
+            Rid *rid = nullptr;
+            if (leaf->leaf_lookup(key, &rid)) {
+                (*results)[i].push_back(*rid);
+            }
+        } else {
+            // 相同的key可能延续到之后的叶子中
+            int pos = leaf->lower_bound(key);
+            while (true) {
+                if (pos == leaf->get_size()) {
+                    if (!next_leaf()) break;
+                    leaf = path.back();
+                    pos = 0;
+                    continue;
+                }
+                if (memcmp(leaf->full_key(pos, entry_buf), key, key_len) != 0) break;
+                (*results)[i].push_back(*leaf->get_rid(pos));
+                pos++;
+            }
+        }
+        found += !(*results)[i].empty();
+    }
+    release_to(0);
+    return found;
+}
+
+namespace {
+
+// 交错查找中一个槽位上正在进行的查找
+struct IxProbe {
+    enum Stage { START, FETCH_CHILD, LATCH_CHILD };
+
+    int index = -1;                 // key在批中的下标，为-1时槽位空闲
+    const char *key = nullptr;      // 存储格式的key
+    Stage stage = START;
+    IxNodeHandle *node = nullptr;   // 当前结点，持有读latch
+    IxNodeHandle *child = nullptr;  // 已固定、尚未加latch的孩子结点
+    page_id_t child_no = IX_NO_PAGE;
+    int depth = 0;                  // node所在的层，根结点为第0层
+};
+
+// 提示CPU预取结点的页头和键数组的中部，结点内的二分查找最先访问这些位置
+inline void prefetch_node(Page *page, const IxFileHdr *file_hdr) {
+    const char *data = page->get_data();
+    __builtin_prefetch(data);
+    __builtin_prefetch(data + sizeof(IxPageHdr) + file_hdr->keys_size_ / 2);
+}
+
+}  // namespace
+
+/**
+ * @brief 交错的批量等值查找，适用于乱序的一批key（例如按连接探测端的顺序给出的key）。
+ * 一个线程同时推进IX_PROBE_GROUP_SIZE个查找，每个查找每次只前进一层：在当前结点中找到孩子后，
+ * 预取孩子的页面数据就切换到下一个查找，轮回来时孩子已在CPU缓存中；孩子不在缓冲池中时交给预读线程异步读入，
+ * 其它查找继续进行，一轮中所有查找都无法前进时才同步读取。各个查找只持有当前结点的读latch，
+ * 并且所有latch（包括root_latch_）都只尝试获取，获取失败时切换到其它查找，线程持有latch时从不等待latch，
+ * 因此不会与自顶向下加写latch的插入/删除死锁
+ *
+ * @param keys 连续存放的num_keys个调用者格式的key
+ * @param[out] results 大小被设为num_keys，results[i]为第i个key对应的全部rid
+ * @return 找到的key的数量
+ * @note 非唯一索引中相同的key延续到下一个叶子时，该key在整批结束、不再持有任何latch之后用get_value重新查找
+ */
+int IxIndexHandle::probe_values(const char *keys, int num_keys, std::vector<std::vector<Rid>> *results,
+                                Transaction *transaction) {
+    results->assign(num_keys, std::vector<Rid>());
+    if (num_keys == 0) return 0;
+    int key_len = file_hdr_->user_key_len();
+    int group = std::min(IX_PROBE_GROUP_SIZE, num_keys);
+    std::vector<IxProbe> probes(group);
+    std::vector<char> key_bufs(static_cast<size_t>(group) * IX_MAX_COL_LEN);
+    std::vector<int> deferred;
+    char entry_buf[IX_MAX_COL_LEN];
+    int next_key = 0;
+    bool stalled = false;           // 上一轮中是否没有任何查找前进
+
+    auto release = [&](IxNodeHandle *&node, bool latched) {
+        if (latched) node->page->r_unlatch();
+        unpin_node(node, false);
+        delete node;
+        node = nullptr;
+    };
+    // 在持有读latch的叶子中查找，释放叶子并把槽位分配给下一个key
+    auto finish = [&](IxProbe &probe) {
+        IxNodeHandle *leaf = probe.node;
+        if (leaf != nullptr) {
+            auto &result = (*results)[probe.index];
+            if (file_hdr_->unique_) {
+                Rid *rid = nullptr;
+                if (leaf->leaf_lookup(probe.key, &rid)) {
+                    result.push_back(*rid);
+                }
+            } else {
+                int pos = leaf->lower_bound(probe.key);
+                for (; pos < leaf->get_size(); pos++) {
+                    if (memcmp(leaf->full_key(pos, entry_buf), probe.key, key_len) != 0) break;
+                    result.push_back(*leaf->get_rid(pos));
+                }
+                if (pos == leaf->get_size() && leaf->get_next_leaf() != IX_LEAF_HEADER_PAGE) {
+                    result.clear();
+                    deferred.push_back(probe.index);
+                }
+            }
+            release(probe.node, true);
+        }
+        probe.index = -1;
+    };
+    auto assign = [&](IxProbe &probe, size_t slot) {
+        if (next_key >= num_keys) return;
+        probe.index = next_key++;
+        const char *raw = keys + static_cast<size_t>(probe.index) * key_len;
+        char *buf = key_bufs.data() + slot * IX_MAX_COL_LEN;
+        // 非唯一索引以最小的rid补全key，从第一个不小于key的键值对开始
+        probe.key = file_hdr_->unique_ ? to_index_key(raw, buf)
+                                       : to_index_key(raw, Rid{.page_no = INT_MIN, .slot_no = INT_MIN}, buf);
+        probe.stage = IxProbe::START;
+    };
+    // 当前结点已加读latch：到达叶子时完成查找，否则找到孩子并预取，孩子不在缓冲池中时请求异步读入
+    auto descend = [&](IxProbe &probe) {
+        if (probe.node->is_leaf_page()) {
+            finish(probe);
+            return;
+        }
+        probe.child_no = probe.node->internal_lookup(probe.key);
+        probe.child = try_fetch_resident_node(probe.child_no);
+        if (probe.child != nullptr) {
+            prefetch_node(probe.child->page, file_hdr_);
+            probe.stage = IxProbe::LATCH_CHILD;
+        } else {
+            buffer_pool_manager_->prefetch(fd_, probe.child_no, 1);
+            probe.stage = IxProbe::FETCH_CHILD;
+        }
+    };
+    // 推进一个查找，返回是否前进
+    auto step = [&](IxProbe &probe) {
+        switch (probe.stage) {
+            case IxProbe::START: {
+                if (!root_latch_.try_lock()) return false;
+                if (is_empty()) {
+                    root_latch_.unlock();
+                    finish(probe);
+                    return true;
+                }
+                IxNodeHandle *root = fetch_resident_node(file_hdr_->root_page_);
+                if (!root->page->try_r_latch()) {
+                    release(root, false);
+                    root_latch_.unlock();
+                    return false;
+                }
+                root_latch_.unlock();
+                make_resident(root, 0);
+                probe.node = root;
+                probe.depth = 0;
+                descend(probe);
+                return true;
+            }
+            case IxProbe::FETCH_CHILD:
+                probe.child = try_fetch_resident_node(probe.child_no);
+                if (probe.child == nullptr) {
+                    // 其它查找也都无法前进时同步读取，此时只等待磁盘读写，不等待latch
+                    if (!stalled) return false;
+                    probe.child = fetch_resident_node(probe.child_no);
+                }
+                prefetch_node(probe.child->page, file_hdr_);
+                probe.stage = IxProbe::LATCH_CHILD;
+                return true;
+            case IxProbe::LATCH_CHILD:
+                if (!probe.child->page->try_r_latch()) return false;
+                make_resident(probe.child, probe.depth + 1);
+                release(probe.node, true);
+                probe.node = probe.child;
+                probe.child = nullptr;
+                probe.depth++;
+                descend(probe);
+                return true;
+        }
+        return false;
+    };
+
+    for (size_t slot = 0; slot < probes.size(); slot++) {
+        assign(probes[slot], slot);
+    }
+    while (true) {
+        bool active = false;
+        bool progress = false;
+        for (size_t slot = 0; slot < probes.size(); slot++) {
+            IxProbe &probe = probes[slot];
+            if (probe.index < 0) continue;
+            active = true;
+            progress |= step(probe);
+            if (probe.index < 0) {
+                assign(probe, slot);
+            }
+        }
+        if (!active) break;
+        stalled = !progress;
+        if (stalled) {
+            std::this_thread::yield();
+        }
+    }
+
+    for (int i : deferred) {
+        get_value(keys + static_cast<size_t>(i) * key_len, &(*results)[i], transaction);
+    }
+    int found = 0;
+    for (auto &result : *results) {
+        found += !result.empty();
+    }
     return found;
 }
 
 /**
  * @brief  将传入的一个node拆分(Split)成两个结点，在node的右边生成一个新结点new node
  * @param node 需要拆分的结点
+ * @param move_cnt 移到new_node的键值对数量，默认为一半
  * @return 拆分得到的new_node
  * @note need to unpin the new node outside
  * 注意：本函数执行完毕后，原node和new node都需要在函数外面进行unpin
  */
-IxNodeHandle *IxIndexHandle::split(IxNodeHandle *node) {
+IxNodeHandle *IxIndexHandle::split(IxNodeHandle *node, int move_cnt) {
     IxNodeHandle *new_node = create_node();
     // 初始化新节点头部信息
     new_node->page_hdr->is_leaf = node->is_leaf_page();
@@ -248,14 +799,21 @@ IxNodeHandle *IxIndexHandle::split(IxNodeHandle *node) {
     new_node->page_hdr->next_leaf = IX_NO_PAGE;
 
     int old_sz = node->get_size();
-    int move_cnt = old_sz / 2;
+    if (move_cnt < 0) move_cnt = old_sz / 2;
     int start = old_sz - move_cnt;  // 右半部分移动
-    for (int i = 0; i < move_cnt; i++) {
-        memcpy(new_node->get_key(i), node->get_key(start + i), file_hdr_->col_tot_len_);
-        *new_node->get_rid(i) = *node->get_rid(start + i);
-    }
-    new_node->set_size(move_cnt);
+    std::vector<char> key_buf;
+    new_node->insert_pairs(0, node->full_keys(start, move_cnt, key_buf), node->get_rid(start), move_cnt);
     node->set_size(start);
+    if (node->is_compressed() && start > 1) {
+        // 剩下的key范围变小，公共前缀可能变长
+        char first[IX_MAX_COL_LEN], last[IX_MAX_COL_LEN];
+        const char *lo = node->full_key(0, first);
+        int prefix = std::min(ix_common_prefix(lo, node->full_key(start - 1, last), file_hdr_->col_tot_len_),
+                              file_hdr_->col_tot_len_ - 1);
+        if (prefix > node->prefix_len()) {
+            node->set_prefix(prefix, lo);
+        }
+    }
 
     if (node->is_leaf_page()) {
         // 维护叶子双向链表
@@ -300,7 +858,8 @@ void IxIndexHandle::insert_into_parent(IxNodeHandle *old_node, const char *key,
         root->page_hdr->num_key = 0;
         root->page_hdr->parent = IX_NO_PAGE;
         // 左孩子(old)
-        memcpy(root->get_key(0), old_node->get_key(0), file_hdr_->col_tot_len_);
+        char first_key[IX_MAX_COL_LEN];
+        memcpy(root->get_key(0), old_node->full_key(0, first_key), file_hdr_->col_tot_len_);
         root->get_rid(0)->page_no = old_node->get_page_no();
         // 右孩子(new)
         memcpy(root->get_key(1), key, file_hdr_->col_tot_len_);
@@ -331,47 +890,470 @@ void IxIndexHandle::insert_into_parent(IxNodeHandle *old_node, const char *key,
  * @param (key, value) 要插入的键值对
  * @param transaction 事务指针
  * @return page_id_t 插入到的叶结点的page_no
+ * @note 唯一索引中已经存在的key不再插入；非唯一索引只忽略完全相同的(key, rid)
  */
 page_id_t IxIndexHandle::insert_entry(const char *key, const Rid &value, Transaction *transaction) {
-    std::lock_guard<std::mutex> guard(root_latch_);
-    if (is_empty()) {
-        return IX_NO_PAGE;
+    char key_buf[IX_MAX_COL_LEN];
+    key = to_index_key(key, value, key_buf);
+    std::unique_ptr<Transaction> local_txn;
+    if (transaction == nullptr) {
+        // 没有事务时用临时事务记录加锁的页面
+        local_txn = std::make_unique<Transaction>(INVALID_TXN_ID);
+        transaction = local_txn.get();
     }
-    auto [leaf, _] = find_leaf_page(key, Operation::INSERT, transaction);
+    auto [leaf, root_is_latched] = find_leaf_page(key, Operation::INSERT, transaction);
     if (leaf == nullptr) return IX_NO_PAGE;
-    leaf->insert(key, value);
-    if (leaf->get_size() == leaf->get_max_size()) {
-        IxNodeHandle *new_leaf = split(leaf);
-        insert_into_parent(leaf, new_leaf->get_key(0), new_leaf, transaction);
-        buffer_pool_manager_->unpin_page(new_leaf->get_page_id(), true);
+    return insert_into_leaf(leaf, root_is_latched, key, value, transaction);
+}
+
+/**
+ * @brief 把存储格式的key插入find_leaf_page找到的叶子结点，必要时分裂并修改祖先结点，最后释放find_leaf_page加的latch
+ *
+ * @param leaf find_leaf_page返回的叶子结点，函数内负责释放
+ * @param root_is_latched find_leaf_page返回的root_latch_是否仍被持有
+ * @return 插入的叶子结点的页号
+ */
+page_id_t IxIndexHandle::insert_into_leaf(IxNodeHandle *leaf, bool root_is_latched, const char *key, const Rid &value,
+                                          Transaction *transaction) {
+    int pos = leaf->lower_bound(key);
+    IxNodeHandle *new_leaf = nullptr;
+    if (!leaf->has_room_for(key)) {
+        // 压缩的叶子结点中插入不共享公共前缀的key，前缀缩短后放不下，这样的key一定位于结点的一端。
+        // 先拆分再插入，让key所在的一侧只剩get_min_size()-1个键值对，两侧插入后都不少于get_min_size()
+        int min_size = leaf->get_min_size();
+        bool at_front = pos == 0;
+        new_leaf = split(leaf, at_front ? leaf->get_size() - min_size + 1 : min_size - 1);
+        (at_front ? leaf : new_leaf)->insert(key, value);
     } else {
+        leaf->insert(key, value);
+        if (leaf->get_size() == leaf->get_max_size()) {
+            new_leaf = split(leaf);
+        }
+    }
+    if (new_leaf != nullptr) {
+        char first_key[IX_MAX_COL_LEN];
+        insert_into_parent(leaf, new_leaf->full_key(0, first_key), new_leaf, transaction);
+        buffer_pool_manager_->unpin_page(new_leaf->get_page_id(), true);
+        delete new_leaf;
+    }
+    if (pos == 0) {
+        // 插入到了第一个位置，此时find_leaf_page保留了需要修改的祖先结点的latch
         maintain_parent(leaf);
     }
     page_id_t ret = leaf->get_page_no();
-    buffer_pool_manager_->unpin_page(leaf->get_page_id(), true);
+    delete leaf;
+    release_latched_pages(transaction, true);
+    if (root_is_latched) root_latch_.unlock();
     return ret;
 }
 
+/**
+ * @brief 批量插入键值对，keys需要已经按照索引的比较规则升序排列
+ * 若B+树为空，则自底向上构建：先把键值对依次填入叶子结点，再逐层生成内部结点，每个页面只写一次；
+ * 否则由insert_sorted按顺序插入，落在同一个叶子结点上的相邻键值对只从根结点下降一次
+ *
+ * @param keys 连续存放的num_entries个key
+ * @param rids 与keys一一对应的rid
+ * @param num_entries 键值对数量
+ * @param transaction 事务指针
+ * @note 与insert_entry相同，重复的key只保留第一个
+ */
+void IxIndexHandle::insert_entries(const char *keys, const Rid *rids, int num_entries, Transaction *transaction) {
+    if (num_entries <= 0) return;
+    int key_len = file_hdr_->user_key_len();
+    int next = 0;
+    bulk_load(
+        [&](const char **key, Rid *rid) {
+            if (next == num_entries) return false;
+            *key = keys + static_cast<size_t>(next) * key_len;
+            *rid = rids[next];
+            next++;
+            return true;
+        },
+        IX_BULK_FILL_FACTOR, transaction);
+}
+
+/**
+ * @brief 由按升序给出的键值对批量构建B+树
+ * 若B+树为空，则自底向上构建，叶子结点和内部结点按fill_factor填充；否则由insert_sorted按顺序插入
+ *
+ * @param source 依次给出原始格式的键值对，没有更多键值对时返回false；非唯一索引中key相同的键值对需按rid升序给出
+ * @param fill_factor 结点的填充率，实际填充的键值对数量不少于get_min_size()、不多于btree_order_
+ * @param transaction 事务指针
+ */
+void IxIndexHandle::bulk_load(const IxEntrySource &source, double fill_factor, Transaction *transaction) {
+    {
+        std::lock_guard<std::mutex> guard(root_latch_);
+        IxNodeHandle *root = fetch_node(file_hdr_->root_page_);
+        // 根结点是叶子时，正在进行的操作都持有根结点的latch；等它们结束后，新的操作都会阻塞在root_latch_上
+        root->page->w_latch();
+        bool empty_leaf = root->is_leaf_page() && root->get_size() == 0;
+        root->page->w_unlatch();
+        if (empty_leaf) {
+            build_from_sorted(root, source, fill_factor);
+            return;
+        }
+        buffer_pool_manager_->unpin_page(root->get_page_id(), false);
+        delete root;
+    }
+    insert_sorted(source, transaction);
+}
+
+/**
+ * @brief 把按升序给出的键值对逐条插入非空的B+树。一次下降找到的叶子结点安全时（祖先结点的latch都已释放），
+ * 之后落在该叶子内部（不在两端）且插入后不分裂的键值对直接插入这个叶子，不再从根结点下降；
+ * 其余键值对与insert_entry相同，从根结点下降后插入
+ *
+ * @param source 依次给出原始格式的键值对
+ * @param transaction 事务指针
+ */
+void IxIndexHandle::insert_sorted(const IxEntrySource &source, Transaction *transaction) {
+    std::unique_ptr<Transaction> local_txn;
+    if (transaction == nullptr) {
+        local_txn = std::make_unique<Transaction>(INVALID_TXN_ID);
+        transaction = local_txn.get();
+    }
+    char key_buf[IX_MAX_COL_LEN];
+    const char *raw;
+    Rid rid;
+    bool has_next = source(&raw, &rid);
+    while (has_next) {
+        const char *key = to_index_key(raw, rid, key_buf);
+        auto [leaf, root_is_latched] = find_leaf_page(key, Operation::INSERT, transaction);
+        if (leaf == nullptr) {
+            has_next = source(&raw, &rid);
+            continue;
+        }
+        if (root_is_latched || transaction->get_index_latch_page_set()->size() > 1) {
+            insert_into_leaf(leaf, root_is_latched, key, rid, transaction);
+            has_next = source(&raw, &rid);
+            continue;
+        }
+        leaf->insert(key, rid);
+        while ((has_next = source(&raw, &rid))) {
+            key = to_index_key(raw, rid, key_buf);
+            int pos = leaf->lower_bound(key);
+            if (pos == 0 || pos >= leaf->get_size() || !leaf->fits_without_split(key)) break;
+            leaf->insert(key, rid);
+        }
+        delete leaf;
+        release_latched_pages(transaction, true);
+    }
+}
+
+/**
+ * @brief 由排好序的键值对自底向上构建B+树，调用时需持有root_latch_
+ * 叶子结点依次填入cap个键值对，最后一个叶子不足半满时与前一个叶子平分，平分后仍不足半满时并入前一个叶子；
+ * 上面的每一层把孩子平均分配到各个结点中。除根结点外每个结点都不少于get_min_size()
+ *
+ * @param root 当前为空的根结点（叶子结点），作为第一个叶子结点复用，函数内负责unpin
+ * @param source 依次给出原始格式的键值对
+ * @param fill_factor 结点的填充率
+ */
+void IxIndexHandle::build_from_sorted(IxNodeHandle *root, const IxEntrySource &source, double fill_factor) {
+    int key_len = file_hdr_->col_tot_len_;
+    int order = file_hdr_->btree_order_;
+    int min_size = root->get_min_size();
+    // 叶子结点的容量随公共前缀变化，按插入key后的前缀长度计算
+    auto leaf_cap = [&](IxNodeHandle *node, const char *key) {
+        int max_keys = node->slots_for(node->prefix_with(key)) - 1;
+        return std::clamp(static_cast<int>(max_keys * fill_factor), min_size, max_keys);
+    };
+    int cap = std::clamp(static_cast<int>(order * fill_factor), min_size, order);
+
+    // 1. 依次填充叶子结点并串成叶子链表，记录每个结点的页号以及第一个key，用于生成上一层
+    std::vector<page_id_t> level_pages;
+    std::vector<char> level_keys;
+    auto add_to_level = [&](IxNodeHandle *node) {
+        char first_key[IX_MAX_COL_LEN];
+        const char *first = node->full_key(0, first_key);
+        level_pages.push_back(node->get_page_no());
+        level_keys.insert(level_keys.end(), first, first + key_len);
+    };
+    auto init_node = [&](IxNodeHandle *node, bool is_leaf) {
+        node->page_hdr->next_free_page_no = IX_NO_PAGE;
+        node->page_hdr->parent = IX_NO_PAGE;
+        node->page_hdr->is_leaf = is_leaf;
+        node->page_hdr->prev_leaf = is_leaf ? IX_LEAF_HEADER_PAGE : IX_NO_PAGE;
+        node->page_hdr->next_leaf = is_leaf ? IX_LEAF_HEADER_PAGE : IX_NO_PAGE;
+        node->set_size(0);
+    };
+    char key_buf[IX_MAX_COL_LEN];
+    char last_buf[IX_MAX_COL_LEN];
+    const char *raw_key;
+    Rid rid;
+    IxNodeHandle *prev = nullptr;  // 前一个叶子，直到确定最后一个叶子不需要从它借键值对时才写出
+    IxNodeHandle *leaf = root;
+    const char *last_key = nullptr;
+    init_node(leaf, true);
+    while (source(&raw_key, &rid)) {
+        const char *key = to_index_key(raw_key, rid, key_buf);
+        // 去除重复的key
+        if (last_key != nullptr && leaf->compare_key(key, last_key) == 0) continue;
+        if (leaf->get_size() > 0 && leaf->get_size() >= leaf_cap(leaf, key)) {
+            IxNodeHandle *next = create_node();
+            init_node(next, true);
+            next->set_prev_leaf(leaf->get_page_no());
+            leaf->set_next_leaf(next->get_page_no());
+            if (prev != nullptr) {
+                buffer_pool_manager_->unpin_page(prev->get_page_id(), true);
+                delete prev;
+            }
+            add_to_level(leaf);
+            prev = leaf;
+            leaf = next;
+        }
+        leaf->insert_pair(leaf->get_size(), key, rid);
+        memcpy(last_buf, key, key_len);
+        last_key = last_buf;
+    }
+    if (leaf->get_size() == 0) {
+        // 没有键值对，保持空的根结点
+        buffer_pool_manager_->unpin_page(leaf->get_page_id(), true);
+        delete leaf;
+        return;
+    }
+    if (prev != nullptr && leaf->get_size() < min_size) {
+        int total = prev->get_size() + leaf->get_size();
+        if (total / 2 < min_size) {
+            // 平分后仍不足半满，最后一个叶子并入前一个叶子，合并后不超过2 * min_size - 1 <= order
+            std::vector<char> keys;
+            prev->insert_pairs(prev->get_size(), leaf->full_keys(0, leaf->get_size(), keys), leaf->get_rid(0),
+                               leaf->get_size());
+            prev->set_next_leaf(IX_LEAF_HEADER_PAGE);
+            release_node_handle(*leaf);
+            buffer_pool_manager_->unpin_page(leaf->get_page_id(), false);
+            delete leaf;
+            leaf = prev;
+            prev = nullptr;
+            level_pages.pop_back();
+            level_keys.resize(level_keys.size() - key_len);
+        } else {
+            // 从前一个叶子的尾部移动键值对，使两个叶子平分；前缀压缩的叶子可能多于order个键值对，
+            // 最后一个叶子的公共前缀可能变短，最多移到order个
+            int move = std::min(total / 2, order) - leaf->get_size();
+            int start = prev->get_size() - move;
+            std::vector<char> keys;
+            leaf->insert_pairs(0, prev->full_keys(start, move, keys), prev->get_rid(start), move);
+            prev->set_size(start);
+        }
+    }
+    if (prev != nullptr) {
+        buffer_pool_manager_->unpin_page(prev->get_page_id(), true);
+        delete prev;
+    }
+    add_to_level(leaf);
+    file_hdr_->first_leaf_ = level_pages.front();
+    file_hdr_->last_leaf_ = level_pages.back();
+    buffer_pool_manager_->unpin_page(leaf->get_page_id(), true);
+    delete leaf;
+
+    IxNodeHandle *header = fetch_node(IX_LEAF_HEADER_PAGE);
+    header->set_next_leaf(file_hdr_->first_leaf_);
+    header->set_prev_leaf(file_hdr_->last_leaf_);
+    buffer_pool_manager_->unpin_page(header->get_page_id(), true);
+    delete header;
+
+    // 2. 逐层生成内部结点，内部结点的第i个key为第i个孩子的第一个key，直到只剩一个结点作为根结点
+    while (level_pages.size() > 1) {
+        int num_children = static_cast<int>(level_pages.size());
+        // 按cap计算结点数，同时保证平均分配后每个结点都在[min_size, order]之内
+        int num_nodes = std::min((num_children + cap - 1) / cap, std::max(1, num_children / min_size));
+        num_nodes = std::max(num_nodes, (num_children + order - 1) / order);
+        std::vector<page_id_t> parent_pages;
+        std::vector<char> parent_keys(static_cast<size_t>(num_nodes) * key_len);
+        for (int n = 0, child = 0; n < num_nodes; n++) {
+            int cnt = num_children / num_nodes + (n < num_children % num_nodes ? 1 : 0);
+            IxNodeHandle *node = create_node();
+            init_node(node, false);
+            for (int j = 0; j < cnt; j++) {
+                Rid r{};
+                r.page_no = level_pages[child + j];
+                node->set_key(j, level_keys.data() + static_cast<size_t>(child + j) * key_len);
+                node->set_rid(j, r);
+            }
+            node->set_size(cnt);
+            for (int j = 0; j < cnt; j++) {
+                maintain_child(node, j);
+            }
+            memcpy(parent_keys.data() + static_cast<size_t>(n) * key_len, node->get_key(0), key_len);
+            parent_pages.push_back(node->get_page_no());
+            buffer_pool_manager_->unpin_page(node->get_page_id(), true);
+            delete node;
+            child += cnt;
+        }
+        level_pages = std::move(parent_pages);
+        level_keys = std::move(parent_keys);
+    }
+    update_root_page_no(level_pages.front());
+}
+
 /**
  * @brief 用于删除B+树中含有指定key的键值对
  * @param key 要删除的key值
  * @param transaction 事务指针
+ * @note 只用于唯一索引，非唯一索引需要给出rid
  */
 bool IxIndexHandle::delete_entry(const char *key, Transaction *transaction) {
-    std::lock_guard<std::mutex> guard(root_latch_);
-    if (is_empty()) return false;
-    auto [leaf, _] = find_leaf_page(key, Operation::DELETE, transaction);
+    assert(file_hdr_->unique_);
+    char key_buf[IX_MAX_COL_LEN];
+    return erase_entry(to_index_key(key, key_buf), nullptr, transaction);
+}
+
+/**
+ * @brief 删除B+树中的键值对(key, rid)
+ * @param key 要删除的key值
+ * @param rid key对应的记录位置，唯一索引中key对应的rid不同时不删除
+ * @param transaction 事务指针
+ */
+bool IxIndexHandle::delete_entry(const char *key, const Rid &rid, Transaction *transaction) {
+    char key_buf[IX_MAX_COL_LEN];
+    key = to_index_key(key, rid, key_buf);
+    // 非唯一索引的key中已经包含rid
+    return erase_entry(key, file_hdr_->unique_ ? &rid : nullptr, transaction);
+}
+
+/**
+ * @brief 删除存储格式的key对应的键值对
+ * @param key 存储格式的key
+ * @param rid 不为空时只在key对应的rid与之相同时删除
+ * @param transaction 事务指针
+ */
+bool IxIndexHandle::erase_entry(const char *key, const Rid *rid, Transaction *transaction) {
+    std::unique_ptr<Transaction> local_txn;
+    if (transaction == nullptr) {
+        // 没有事务时用临时事务记录加锁的页面
+        local_txn = std::make_unique<Transaction>(INVALID_TXN_ID);
+        transaction = local_txn.get();
+    }
+    auto [leaf, root_is_latched] = find_leaf_page(key, Operation::DELETE, transaction);
     if (leaf == nullptr) return false;
-    int old_sz = leaf->get_size();
-    int new_sz = leaf->remove(key);
-    bool erased = new_sz < old_sz;
+    return erase_from_leaf(leaf, root_is_latched, key, rid, transaction);
+}
+
+/**
+ * @brief 在find_leaf_page找到的叶子结点中删除存储格式的key，必要时合并/重分配并修改祖先结点，最后释放find_leaf_page加的latch
+ *
+ * @param leaf find_leaf_page返回的叶子结点，函数内负责释放
+ * @param root_is_latched find_leaf_page返回的root_latch_是否仍被持有
+ * @param rid 不为空时只在key对应的rid与之相同时删除
+ * @return 是否删除了键值对
+ */
+bool IxIndexHandle::erase_from_leaf(IxNodeHandle *leaf, bool root_is_latched, const char *key, const Rid *rid,
+                                    Transaction *transaction) {
+    int pos = leaf->lower_bound(key);
+    bool erased = remove_from_leaf(leaf, key, rid);
     if (erased) {
-        coalesce_or_redistribute(leaf, transaction, nullptr);
+        int new_sz = leaf->get_size();
+        if (!leaf->is_root_page() && new_sz >= leaf->get_min_size()) {
+            // 删除了第一个key时才需要修改祖先结点，此时find_leaf_page保留了它们的latch
+            if (pos == 0) maintain_parent(leaf);
+        } else {
+            coalesce_or_redistribute(leaf, transaction, &root_is_latched);
+        }
     }
-    buffer_pool_manager_->unpin_page(leaf->get_page_id(), true);
+    delete leaf;
+    release_latched_pages(transaction, erased);
+    if (root_is_latched) root_latch_.unlock();
     return erased;
 }
 
+/**
+ * @brief 只在叶子结点内删除存储格式的key，不处理结点下溢
+ * @param rid 不为空时只在key对应的rid与之相同时删除
+ */
+bool IxIndexHandle::remove_from_leaf(IxNodeHandle *leaf, const char *key, const Rid *rid) {
+    Rid *stored = nullptr;
+    if (rid != nullptr && !(leaf->leaf_lookup(key, &stored) && *stored == *rid)) {
+        return false;
+    }
+    int old_sz = leaf->get_size();
+    return leaf->remove(key) < old_sz;
+}
+
+/**
+ * @brief 批量删除键值对(key, rid)，键值对需要已经按照sort_entries的顺序排列
+ * 一次下降找到的叶子结点安全时，之后落在该叶子内部且删除后不下溢的键值对直接在这个叶子中删除，不再从根结点下降
+ *
+ * @param keys 连续存放的num_entries个原始格式的key
+ * @param rids 与keys一一对应的rid
+ * @param num_entries 键值对数量
+ * @param transaction 事务指针
+ * @return 删除的键值对数量
+ */
+int IxIndexHandle::delete_entries(const char *keys, const Rid *rids, int num_entries, Transaction *transaction) {
+    std::unique_ptr<Transaction> local_txn;
+    if (transaction == nullptr) {
+        local_txn = std::make_unique<Transaction>(INVALID_TXN_ID);
+        transaction = local_txn.get();
+    }
+    int key_len = file_hdr_->user_key_len();
+    // 非唯一索引的key中已经包含rid
+    bool check_rid = file_hdr_->unique_;
+    char key_buf[IX_MAX_COL_LEN];
+    int erased = 0;
+    int i = 0;
+    while (i < num_entries) {
+        const char *key = to_index_key(keys + static_cast<size_t>(i) * key_len, rids[i], key_buf);
+        auto [leaf, root_is_latched] = find_leaf_page(key, Operation::DELETE, transaction);
+        if (leaf == nullptr) break;
+        if (root_is_latched || transaction->get_index_latch_page_set()->size() > 1) {
+            erased += erase_from_leaf(leaf, root_is_latched, key, check_rid ? &rids[i] : nullptr, transaction);
+            i++;
+            continue;
+        }
+        bool dirty = false;
+        while (true) {
+            if (remove_from_leaf(leaf, key, check_rid ? &rids[i] : nullptr)) {
+                erased++;
+                dirty = true;
+            }
+            if (++i == num_entries) break;
+            key = to_index_key(keys + static_cast<size_t>(i) * key_len, rids[i], key_buf);
+            int pos = leaf->lower_bound(key);
+            bool underflow = leaf->is_root_page() ? leaf->get_size() <= 1 : leaf->get_size() <= leaf->get_min_size();
+            if (pos == 0 || pos >= leaf->get_size() || underflow) break;
+        }
+        delete leaf;
+        release_latched_pages(transaction, dirty);
+    }
+    return erased;
+}
+
+/**
+ * @brief 把num_entries个原始格式的键值对按照它们在B+树中的顺序排列，非唯一索引中key相同的按rid排列
+ *
+ * @param keys 连续存放的num_entries个原始格式的key，原地排序
+ * @param rids 与keys一一对应的rid，随keys一起排序
+ */
+void IxIndexHandle::sort_entries(char *keys, Rid *rids, int num_entries) const {
+    int key_len = file_hdr_->user_key_len();
+    int full_len = file_hdr_->col_tot_len_;
+    // 非唯一索引的key由原始key和rid拼接而成，按col_types_逐个字段比较即为B+树中的顺序
+    std::vector<char> full_keys(static_cast<size_t>(num_entries) * full_len);
+    for (int e = 0; e < num_entries; e++) {
+        char *dst = full_keys.data() + static_cast<size_t>(e) * full_len;
+        memcpy(dst, keys + static_cast<size_t>(e) * key_len, key_len);
+        if (full_len > key_len) memcpy(dst + key_len, &rids[e], sizeof(Rid));
+    }
+    std::vector<int> order(num_entries);
+    for (int e = 0; e < num_entries; e++) order[e] = e;
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return ix_compare(full_keys.data() + static_cast<size_t>(a) * full_len,
+                          full_keys.data() + static_cast<size_t>(b) * full_len, file_hdr_->col_types_,
+                          file_hdr_->col_lens_) < 0;
+    });
+    std::vector<char> sorted_keys(static_cast<size_t>(num_entries) * key_len);
+    std::vector<Rid> sorted_rids(num_entries);
+    for (int e = 0; e < num_entries; e++) {
+        memcpy(sorted_keys.data() + static_cast<size_t>(e) * key_len, keys + static_cast<size_t>(order[e]) * key_len,
+               key_len);
+        sorted_rids[e] = rids[order[e]];
+    }
+    memcpy(keys, sorted_keys.data(), sorted_keys.size());
+    std::copy(sorted_rids.begin(), sorted_rids.end(), rids);
+}
+
 /**
  * @brief 用于处理合并和重分配的逻辑，用于删除键值对后调用
  *
@@ -382,15 +1364,15 @@ bool IxIndexHandle::delete_entry(const char *key, Transaction *transaction) {
  * @note User needs to first find the sibling of input page.
  * If sibling's size + input page's size >= 2 * page's minsize, then redistribute.
  * Otherwise, merge(Coalesce).
+ * @note node及其需要修改的祖先结点已由find_leaf_page加写latch，兄弟结点在这里加写latch
  */
 bool IxIndexHandle::coalesce_or_redistribute(IxNodeHandle *node, Transaction *transaction, bool *root_is_latched) {
     // 根结点处理
     if (node->is_root_page()) {
         return adjust_root(node);
     }
-    // 若足够半满，不需要处理
+    // 若足够半满，不需要处理；删除的是内部结点第idx(idx>=1)个孩子，第一个key不变，不需要维护父结点
     if (node->get_size() >= node->get_min_size()) {
-        maintain_parent(node);
         return false;
     }
     // 选择兄弟（优先选取前驱）
@@ -402,18 +1384,27 @@ bool IxIndexHandle::coalesce_or_redistribute(IxNodeHandle *node, Transaction *tr
     } else {
         neighbor = fetch_node(parent->value_at(index + 1));
     }
+    // 持有parent的写latch时，其他线程只能持有兄弟结点而不会再等待本线程持有的结点，因此不会死锁
+    neighbor->page->w_latch();
     if (neighbor->get_size() + node->get_size() >= 2 * node->get_min_size()) {
         // 可重分配
         redistribute(neighbor, node, parent, index);
+        neighbor->page->w_unlatch();
         buffer_pool_manager_->unpin_page(neighbor->get_page_id(), true);
         buffer_pool_manager_->unpin_page(parent->get_page_id(), true);
         maintain_parent(node);
+        delete neighbor;
+        delete parent;
         return false;
     } else {
-        // 合并
+        // 合并，coalesce会交换neighbor和node使neighbor为左结点；node由调用者unpin，这里只unpin兄弟结点
+        IxNodeHandle *sibling = neighbor;
         bool parent_should_delete = coalesce(&neighbor, &node, &parent, index, transaction, root_is_latched);
+        sibling->page->w_unlatch();
         buffer_pool_manager_->unpin_page(parent->get_page_id(), true);
-        buffer_pool_manager_->unpin_page(neighbor->get_page_id(), true);
+        buffer_pool_manager_->unpin_page(sibling->get_page_id(), true);
+        delete sibling;
+        delete parent;
         return parent_should_delete;
     }
 }
@@ -431,18 +1422,10 @@ bool IxIndexHandle::adjust_root(IxNodeHandle *old_root_node) {
         child->set_parent_page_no(IX_NO_PAGE);
         update_root_page_no(child_page_no);
         buffer_pool_manager_->unpin_page(child->get_page_id(), true);
-        buffer_pool_manager_->delete_page(old_root_node->get_page_id());
-        release_node_handle(*old_root_node);
-        return true;
-    }
-    if (old_root_node->is_leaf_page() && old_root_node->get_size() == 0) {
-        update_root_page_no(IX_NO_PAGE);
-        file_hdr_->first_leaf_ = IX_LEAF_HEADER_PAGE;
-        file_hdr_->last_leaf_ = IX_LEAF_HEADER_PAGE;
-        buffer_pool_manager_->delete_page(old_root_node->get_page_id());
         release_node_handle(*old_root_node);
         return true;
     }
+    // 删空的根叶子结点保留下来，与新建的索引相同，之后的插入和批量构建仍然从根结点开始
     return false;
 }
 
@@ -462,21 +1445,22 @@ bool IxIndexHandle::adjust_root(IxNodeHandle *old_root_node) {
  */
 void IxIndexHandle::redistribute(IxNodeHandle *neighbor_node, IxNodeHandle *node, IxNodeHandle *parent, int index) {
     bool neighbor_is_left = index > 0;
+    char key_buf[IX_MAX_COL_LEN];
     if (neighbor_is_left) {
         int nsz = neighbor_node->get_size();
         Rid mv = *neighbor_node->get_rid(nsz - 1);
-        char *mv_key = neighbor_node->get_key(nsz - 1);
+        const char *mv_key = neighbor_node->full_key(nsz - 1, key_buf);
         node->insert_pairs(0, mv_key, &mv, 1);
         neighbor_node->erase_pair(nsz - 1);
-        memcpy(parent->get_key(index), node->get_key(0), file_hdr_->col_tot_len_);
+        memcpy(parent->get_key(index), node->full_key(0, key_buf), file_hdr_->col_tot_len_);
         maintain_child(node, 0);
     } else {
         Rid mv = *neighbor_node->get_rid(0);
-        char *mv_key = neighbor_node->get_key(0);
+        const char *mv_key = neighbor_node->full_key(0, key_buf);
         int tail = node->get_size();
         node->insert_pairs(tail, mv_key, &mv, 1);
         neighbor_node->erase_pair(0);
-        memcpy(parent->get_key(index + 1), neighbor_node->get_key(0), file_hdr_->col_tot_len_);
+        memcpy(parent->get_key(index + 1), neighbor_node->full_key(0, key_buf), file_hdr_->col_tot_len_);
         maintain_child(node, node->get_size() - 1);
     }
 }
@@ -506,10 +1490,8 @@ bool IxIndexHandle::coalesce(IxNodeHandle **neighbor_node, IxNodeHandle **node,
         idx = 1;
     }
     int rsz = right->get_size();
-    for (int i = 0; i < rsz; i++) {
-        Rid r = *right->get_rid(i);
-        left->insert_pairs(left->get_size(), right->get_key(i), &r, 1);
-    }
+    std::vector<char> key_buf;
+    left->insert_pairs(left->get_size(), right->full_keys(0, rsz, key_buf), right->get_rid(0), rsz);
     if (!right->is_leaf_page()) {
         for (int i = 0; i < rsz; i++) {
             maintain_child(left, left->get_size() - 1 - i);
@@ -521,7 +1503,8 @@ bool IxIndexHandle::coalesce(IxNodeHandle **neighbor_node, IxNodeHandle **node,
         erase_leaf(right);
     }
     (*parent)->erase_pair(idx);
-    buffer_pool_manager_->delete_page(right->get_page_id());
+    // node在左边时其第一个key可能已被删除，先维护父结点再递归处理父结点
+    maintain_parent(left);
     release_node_handle(*right);
     bool parent_should_delete = coalesce_or_redistribute(*parent, transaction, root_is_latched);
     *neighbor_node = left;
@@ -529,6 +1512,64 @@ bool IxIndexHandle::coalesce(IxNodeHandle **neighbor_node, IxNodeHandle **node,
     return parent_should_delete;
 }
 
+/**
+ * @brief 把调用者传入的原始key转换为结点中存储的格式
+ *
+ * @param key 原始key，各字段与记录中的格式相同
+ * @param buf 存放编码后key的缓冲区，长度至少为IX_MAX_COL_LEN
+ * @return 存储格式的key：IX_KEY_RAW时就是key本身，否则是buf
+ */
+const char *IxIndexHandle::to_index_key(const char *key, char *buf) const {
+    if (file_hdr_->key_format_ != IX_KEY_NORMALIZED) {
+        return key;
+    }
+    ix_normalize_key(key, buf, file_hdr_->col_types_, file_hdr_->col_lens_);
+    return buf;
+}
+
+/**
+ * @brief 把原始key和rid转换为结点中存储的格式，非唯一索引在key之后追加rid，唯一索引忽略rid
+ */
+const char *IxIndexHandle::to_index_key(const char *key, const Rid &rid, char *buf) const {
+    if (file_hdr_->unique_) {
+        return to_index_key(key, buf);
+    }
+    int key_len = file_hdr_->user_key_len();
+    char composite[IX_MAX_COL_LEN];
+    memcpy(composite, key, key_len);
+    memcpy(composite + key_len, &rid, sizeof(Rid));
+    ix_normalize_key(composite, buf, file_hdr_->col_types_, file_hdr_->col_lens_);
+    return buf;
+}
+
+/**
+ * @brief 得到iid位置的键值对中调用者格式的key，即各字段与记录中的格式相同，非唯一索引不含追加的Rid
+ *
+ * @param out 长度至少为file_hdr_->user_key_len()
+ */
+void IxIndexHandle::get_key(const Iid &iid, char *out) const {
+    IxNodeHandle *node = fetch_node(iid.page_no);
+    node->page->r_latch();
+    if (iid.slot_no >= node->get_size()) {
+        node->page->r_unlatch();
+        buffer_pool_manager_->unpin_page(node->get_page_id(), false);
+        delete node;
+        throw IndexEntryNotFoundError();
+    }
+    char key_buf[IX_MAX_COL_LEN];
+    const char *key = node->full_key(iid.slot_no, key_buf);
+    if (file_hdr_->key_format_ == IX_KEY_NORMALIZED) {
+        char raw[IX_MAX_COL_LEN];
+        ix_denormalize_key(key, raw, file_hdr_->col_types_, file_hdr_->col_lens_);
+        memcpy(out, raw, file_hdr_->user_key_len());
+    } else {
+        memcpy(out, key, file_hdr_->user_key_len());
+    }
+    node->page->r_unlatch();
+    buffer_pool_manager_->unpin_page(node->get_page_id(), false);
+    delete node;
+}
+
 /**
  * @brief 这里把iid转换成了rid，即iid的slot_no作为node的rid_idx(key_idx)
  * node其实就是把slot_no作为键值对数组的下标
@@ -540,11 +1581,18 @@ bool IxIndexHandle::coalesce(IxNodeHandle **neighbor_node, IxNodeHandle **node,
  */
 Rid IxIndexHandle::get_rid(const Iid &iid) const {
     IxNodeHandle *node = fetch_node(iid.page_no);
+    node->page->r_latch();
     if (iid.slot_no >= node->get_size()) {
+        node->page->r_unlatch();
+        buffer_pool_manager_->unpin_page(node->get_page_id(), false);
+        delete node;
         throw IndexEntryNotFoundError();
     }
+    Rid rid = *node->get_rid(iid.slot_no);
+    node->page->r_unlatch();
     buffer_pool_manager_->unpin_page(node->get_page_id(), false);  // unpin it!
-    return *node->get_rid(iid.slot_no);
+    delete node;
+    return rid;
 }
 
 /**
@@ -554,22 +1602,26 @@ Rid IxIndexHandle::get_rid(const Iid &iid) const {
  * @return Iid
  * @note 上层传入的key本来是int类型，通过(const char *)&key进行了转换
  * 可用*(int *)key转换回去
+ * 非唯一索引以最小的rid补全key，得到第一个不小于key的键值对
  */
 Iid IxIndexHandle::lower_bound(const char *key) {
-    if (is_empty()) return leaf_end();
+    char key_buf[IX_MAX_COL_LEN];
+    key = to_index_key(key, Rid{.page_no = INT_MIN, .slot_no = INT_MIN}, key_buf);
     auto [leaf, _] = find_leaf_page(key, Operation::FIND, nullptr);
     if (leaf == nullptr) return leaf_end();
     int pos = leaf->lower_bound(key);
-    if (pos == leaf->get_size()) {
-        page_id_t next = leaf->get_next_leaf();
-        buffer_pool_manager_->unpin_page(leaf->get_page_id(), false);
+    Iid iid = {.page_no = leaf->get_page_no(), .slot_no = pos};
+    page_id_t next = leaf->get_next_leaf();
+    leaf->page->r_unlatch();
+    buffer_pool_manager_->unpin_page(leaf->get_page_id(), false);
+    bool at_end = pos == leaf->get_size();
+    delete leaf;
+    if (at_end) {
         if (next == IX_LEAF_HEADER_PAGE) {
             return leaf_end();
         }
         return Iid{.page_no = next, .slot_no = 0};
     }
-    Iid iid = {.page_no = leaf->get_page_no(), .slot_no = pos};
-    buffer_pool_manager_->unpin_page(leaf->get_page_id(), false);
     return iid;
 }
 
@@ -578,22 +1630,26 @@ Iid IxIndexHandle::lower_bound(const char *key) {
  *
  * @param key
  * @return Iid
+ * @note 非唯一索引以最大的rid补全key，得到第一个大于key的键值对
  */
 Iid IxIndexHandle::upper_bound(const char *key) {
-    if (is_empty()) return leaf_end();
+    char key_buf[IX_MAX_COL_LEN];
+    key = to_index_key(key, Rid{.page_no = INT_MAX, .slot_no = INT_MAX}, key_buf);
     auto [leaf, _] = find_leaf_page(key, Operation::FIND, nullptr);
     if (leaf == nullptr) return leaf_end();
     int pos = leaf->upper_bound(key);
-    if (pos == leaf->get_size()) {
-        page_id_t next = leaf->get_next_leaf();
-        buffer_pool_manager_->unpin_page(leaf->get_page_id(), false);
+    Iid iid = {.page_no = leaf->get_page_no(), .slot_no = pos};
+    page_id_t next = leaf->get_next_leaf();
+    leaf->page->r_unlatch();
+    buffer_pool_manager_->unpin_page(leaf->get_page_id(), false);
+    bool at_end = pos == leaf->get_size();
+    delete leaf;
+    if (at_end) {
         if (next == IX_LEAF_HEADER_PAGE) {
             return leaf_end();
         }
         return Iid{.page_no = next, .slot_no = 0};
     }
-    Iid iid = {.page_no = leaf->get_page_no(), .slot_no = pos};
-    buffer_pool_manager_->unpin_page(leaf->get_page_id(), false);
     return iid;
 }
 
@@ -605,8 +1661,11 @@ Iid IxIndexHandle::upper_bound(const char *key) {
  */
 Iid IxIndexHandle::leaf_end() const {
     IxNodeHandle *node = fetch_node(file_hdr_->last_leaf_);
-    Iid iid = {.page_no = file_hdr_->last_leaf_, .slot_no = node->get_size()};
+    node->page->r_latch();
+    Iid iid = {.page_no = node->get_page_no(), .slot_no = node->get_size()};
+    node->page->r_unlatch();
     buffer_pool_manager_->unpin_page(node->get_page_id(), false);  // unpin it!
+    delete node;
     return iid;
 }
 
@@ -630,11 +1689,136 @@ Iid IxIndexHandle::leaf_begin() const {
  */
 IxNodeHandle *IxIndexHandle::fetch_node(int page_no) const {
     Page *page = buffer_pool_manager_->fetch_page(PageId{fd_, page_no});
-    IxNodeHandle *node = new IxNodeHandle(file_hdr_, page);
+    IxNodeHandle *node = new IxNodeHandle(file_hdr_, page, key_search_);
     
     return node;
 }
 
+/**
+ * @brief 查找时获取结点：常驻的结点直接使用缓存的页面，否则通过缓冲池获取
+ * @note 调用者需持有父结点的读latch（根结点为root_latch_），保证结点在加latch之前不会被删除；用完后用unpin_node释放
+ */
+IxNodeHandle *IxIndexHandle::fetch_resident_node(int page_no) {
+    {
+        std::shared_lock<std::shared_mutex> guard(resident_latch_);
+        auto it = resident_pages_.find(page_no);
+        if (it != resident_pages_.end()) {
+            IxNodeHandle *node = new IxNodeHandle(file_hdr_, it->second, key_search_);
+            node->resident = true;
+            return node;
+        }
+    }
+    return fetch_node(page_no);
+}
+
+/**
+ * @brief 不等待磁盘读写地获取查找经过的结点：常驻的结点直接使用缓存的页面，页面不在缓冲池中时返回nullptr
+ * @note 与fetch_resident_node相同，调用者需持有父结点的读latch
+ */
+IxNodeHandle *IxIndexHandle::try_fetch_resident_node(int page_no) {
+    {
+        std::shared_lock<std::shared_mutex> guard(resident_latch_);
+        auto it = resident_pages_.find(page_no);
+        if (it != resident_pages_.end()) {
+            IxNodeHandle *node = new IxNodeHandle(file_hdr_, it->second, key_search_);
+            node->resident = true;
+            return node;
+        }
+    }
+    Page *page = buffer_pool_manager_->try_fetch_page(PageId{fd_, page_no});
+    return page == nullptr ? nullptr : new IxNodeHandle(file_hdr_, page, key_search_);
+}
+
+/**
+ * @brief 查找经过的第depth层（根结点为第0层）内部结点在上层resident_levels_层之内时，使其常驻：
+ * 句柄持有的pin转交给resident_pages_
+ * @note 调用者需持有node的读latch，此时它不会被删除
+ */
+void IxIndexHandle::make_resident(IxNodeHandle *node, int depth) {
+    if (node->resident || depth >= resident_levels_ || node->is_leaf_page()) return;
+    std::unique_lock<std::shared_mutex> guard(resident_latch_);
+    if (resident_pages_.size() >= resident_cap_ || resident_pages_.count(node->get_page_no()) > 0) return;
+    resident_pages_.emplace(node->get_page_no(), node->page);
+    node->resident = true;
+}
+
+/**
+ * @brief 释放fetch_resident_node得到的结点的pin，常驻的结点只需要标记脏页
+ */
+void IxIndexHandle::unpin_node(IxNodeHandle *node, bool is_dirty) {
+    if (node->resident) {
+        if (is_dirty) {
+            BufferPoolManager::mark_dirty(node->page);
+        }
+        return;
+    }
+    buffer_pool_manager_->unpin_page(node->get_page_id(), is_dirty);
+}
+
+/**
+ * @brief 设置从根结点开始常驻缓冲池的层数，为0时关闭常驻并释放已经常驻的结点
+ */
+void IxIndexHandle::set_resident_levels(int levels) {
+    resident_levels_ = levels;
+    if (levels == 0) {
+        release_resident_pages();
+    }
+}
+
+/**
+ * @brief 释放所有常驻结点的pin，关闭索引之前调用。调用时不能有并发的查找
+ */
+void IxIndexHandle::release_resident_pages() {
+    std::unique_lock<std::shared_mutex> guard(resident_latch_);
+    for (auto &entry : resident_pages_) {
+        buffer_pool_manager_->unpin_page(entry.second->get_page_id(), false);
+    }
+    resident_pages_.clear();
+}
+
+size_t IxIndexHandle::num_resident_pages() {
+    std::shared_lock<std::shared_mutex> guard(resident_latch_);
+    return resident_pages_.size();
+}
+
+/**
+ * @brief 统计树高、叶子结点个数和叶子结点的平均填充率：沿最左侧的路径下降得到树高，再沿叶子链表遍历全部叶子。
+ * 逐个结点加共享latch，并发修改时结果只是近似值
+ */
+IxTreeStats IxIndexHandle::get_tree_stats() const {
+    IxTreeStats stats;
+    if (is_empty()) {
+        return stats;
+    }
+    page_id_t page_no = file_hdr_->root_page_;
+    while (true) {
+        IxNodeHandle *node = fetch_node(page_no);
+        node->page->r_latch();
+        bool leaf = node->is_leaf_page();
+        page_id_t child = leaf ? IX_NO_PAGE : node->value_at(0);
+        node->page->r_unlatch();
+        buffer_pool_manager_->unpin_page(node->get_page_id(), false);
+        delete node;
+        stats.height++;
+        if (leaf) break;
+        page_no = child;
+    }
+    double fill_sum = 0;
+    for (page_no = file_hdr_->first_leaf_; page_no != IX_LEAF_HEADER_PAGE && page_no != IX_NO_PAGE;) {
+        IxNodeHandle *node = fetch_node(page_no);
+        node->page->r_latch();
+        stats.num_leaves++;
+        stats.num_entries += node->get_size();
+        fill_sum += static_cast<double>(node->get_size()) / node->get_max_size();
+        page_no = node->get_next_leaf();
+        node->page->r_unlatch();
+        buffer_pool_manager_->unpin_page(node->get_page_id(), false);
+        delete node;
+    }
+    stats.leaf_fill = stats.num_leaves == 0 ? 0 : fill_sum / stats.num_leaves;
+    return stats;
+}
+
 /**
  * @brief 创建一个新结点
  *
@@ -647,19 +1831,24 @@ IxNodeHandle *IxIndexHandle::fetch_node(int page_no) const {
  */
 IxNodeHandle *IxIndexHandle::create_node() {
     IxNodeHandle *node;
-    file_hdr_->num_pages_++;
+    {
+        std::lock_guard<std::mutex> guard(hdr_latch_);
+        file_hdr_->num_pages_++;
+    }
 
     PageId new_page_id = {.fd = fd_, .page_no = INVALID_PAGE_ID};
     // 从3开始分配page_no，第一次分配之后，new_page_id.page_no=3，file_hdr_.num_pages=4
     Page *page = buffer_pool_manager_->new_page(&new_page_id);
-    node = new IxNodeHandle(file_hdr_, page);
+    node = new IxNodeHandle(file_hdr_, page, key_search_);
     return node;
 }
 
 /**
  * @brief 从node开始更新其父节点的第一个key，一直向上更新直到根节点
+ * 只有node是父结点的第0个孩子时，父结点的第一个key才会改变，才需要继续向上更新
  *
  * @param node
+ * @note 需要修改的祖先结点都已经由调用者加写latch
  */
 void IxIndexHandle::maintain_parent(IxNodeHandle *node) {
     IxNodeHandle *curr = node;
@@ -668,7 +1857,8 @@ void IxIndexHandle::maintain_parent(IxNodeHandle *node) {
         IxNodeHandle *parent = fetch_node(curr->get_parent_page_no());
         int rank = parent->find_child(curr);
         char *parent_key = parent->get_key(rank);
-        char *child_first_key = curr->get_key(0);
+        char key_buf[IX_MAX_COL_LEN];
+        const char *child_first_key = curr->full_key(0, key_buf);
         if (memcmp(parent_key, child_first_key, file_hdr_->col_tot_len_) == 0) {
             assert(buffer_pool_manager_->unpin_page(parent->get_page_id(), true));
             break;
@@ -677,6 +1867,9 @@ void IxIndexHandle::maintain_parent(IxNodeHandle *node) {
         curr = parent;
 
         assert(buffer_pool_manager_->unpin_page(parent->get_page_id(), true));
+        if (rank != 0) {
+            break;
+        }
     }
 }
 
@@ -698,16 +1891,29 @@ void IxIndexHandle::erase_leaf(IxNodeHandle *leaf) {
 }
 
 /**
- * @brief 删除node时，更新file_hdr_.num_pages
+ * @brief 删除node时，更新file_hdr_.num_pages，并释放node所在的页面供之后创建结点时复用
  *
  * @param node
+ * @note node可以仍被固定，页面在最后一次unpin时才被丢弃
  */
 void IxIndexHandle::release_node_handle(IxNodeHandle &node) {
-    file_hdr_->num_pages_--;
+    {
+        std::lock_guard<std::mutex> guard(hdr_latch_);
+        file_hdr_->num_pages_--;
+    }
+    {
+        // 被删除的结点不再常驻，放弃常驻时持有的pin
+        std::unique_lock<std::shared_mutex> guard(resident_latch_);
+        if (resident_pages_.erase(node.get_page_no()) > 0) {
+            buffer_pool_manager_->unpin_page(node.get_page_id(), false);
+        }
+    }
+    buffer_pool_manager_->deallocate_page(node.get_page_id());
 }
 
 /**
  * @brief 将node的第child_idx个孩子结点的父节点置为node
+ * @note 孩子结点的parent字段由其父结点的写latch保护，调用者持有原父结点和node的写latch，因此这里不对孩子加latch
  */
 void IxIndexHandle::maintain_child(IxNodeHandle *node, int child_idx) {
     if (!node->is_leaf_page()) {
@@ -10,13 +10,15 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <functional>
+#include <shared_mutex>
+#include <unordered_map>
+
 #include "ix_defs.h"
 #include "transaction/transaction.h"
 
 enum class Operation { FIND = 0, INSERT, DELETE };  // 三种操作：查找、插入、删除
 
-static const bool binary_search = false;
-
 inline int ix_compare(const char *a, const char *b, ColType type, int col_len) {
     switch (type) {
         case TYPE_INT: {
@@ -30,6 +32,7 @@ inline int ix_compare(const char *a, const char *b, ColType type, int col_len) {
             return (fa < fb) ? -1 : ((fa > fb) ? 1 : 0);
         }
         case TYPE_STRING:
+        case TYPE_VARCHAR:
             return memcmp(a, b, col_len);
         default:
             throw InternalError("Unexpected data type");
@@ -46,6 +49,175 @@ inline int ix_compare(const char* a, const char* b, const std::vector<ColType>&
     return 0;
 }
 
+/**
+ * @brief 把记录中的原始key编码为保序的字节串，编码后的key之间用memcmp比较与ix_compare的结果一致
+ * 整数翻转符号位后按大端存放；浮点数为正时翻转符号位、为负时翻转所有位后按大端存放（-0.0视为0.0）；
+ * 定长字符串本身就可以用memcmp比较，原样复制
+ */
+inline void ix_normalize_key(const char *raw, char *out, const std::vector<ColType> &col_types,
+                             const std::vector<int> &col_lens) {
+    int offset = 0;
+    for (size_t i = 0; i < col_types.size(); ++i) {
+        const char *src = raw + offset;
+        unsigned char *dst = reinterpret_cast<unsigned char *>(out + offset);
+        uint32_t bits = 0;
+        switch (col_types[i]) {
+            case TYPE_INT: {
+                memcpy(&bits, src, sizeof(uint32_t));
+                bits ^= 0x80000000u;
+                break;
+            }
+            case TYPE_FLOAT: {
+                float f;
+                memcpy(&f, src, sizeof(float));
+                if (f == 0.0f) f = 0.0f;
+                memcpy(&bits, &f, sizeof(uint32_t));
+                bits = (bits & 0x80000000u) ? ~bits : (bits ^ 0x80000000u);
+                break;
+            }
+            default:
+                memcpy(dst, src, col_lens[i]);
+                offset += col_lens[i];
+                continue;
+        }
+        dst[0] = static_cast<unsigned char>(bits >> 24);
+        dst[1] = static_cast<unsigned char>(bits >> 16);
+        dst[2] = static_cast<unsigned char>(bits >> 8);
+        dst[3] = static_cast<unsigned char>(bits);
+        offset += col_lens[i];
+    }
+}
+
+/* ix_normalize_key的逆变换，把编码后的key还原为记录中的原始格式 */
+inline void ix_denormalize_key(const char *key, char *out, const std::vector<ColType> &col_types,
+                               const std::vector<int> &col_lens) {
+    int offset = 0;
+    for (size_t i = 0; i < col_types.size(); ++i) {
+        const unsigned char *src = reinterpret_cast<const unsigned char *>(key + offset);
+        char *dst = out + offset;
+        if (col_types[i] != TYPE_INT && col_types[i] != TYPE_FLOAT) {
+            memcpy(dst, src, col_lens[i]);
+            offset += col_lens[i];
+            continue;
+        }
+        uint32_t bits = (static_cast<uint32_t>(src[0]) << 24) | (static_cast<uint32_t>(src[1]) << 16) |
+                        (static_cast<uint32_t>(src[2]) << 8) | static_cast<uint32_t>(src[3]);
+        if (col_types[i] == TYPE_INT) {
+            bits ^= 0x80000000u;
+        } else {
+            bits = (bits & 0x80000000u) ? (bits ^ 0x80000000u) : ~bits;
+        }
+        memcpy(dst, &bits, sizeof(uint32_t));
+        offset += col_lens[i];
+    }
+}
+
+/**
+ * @brief 编码后key的64位FNV-1a哈希，再做一次混合使低位和高位都受到所有字节的影响
+ * 哈希索引用低位选桶，LSM索引的Bloom过滤器由它派生出各个探测位置
+ */
+inline uint64_t ix_hash_key(const char *key, int len) {
+    uint64_t h = 14695981039346656037ULL;
+    for (int i = 0; i < len; ++i) {
+        h ^= static_cast<unsigned char>(key[i]);
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/* a和b的最长公共前缀长度，最多比较n个字节 */
+inline int ix_common_prefix(const char *a, const char *b, int n) {
+    int i = 0;
+    while (i < n && a[i] == b[i]) ++i;
+    return i;
+}
+
+/* 按键的布局特化的比较器，编译期确定比较方式，避免在结点内查找时逐个分派列类型 */
+struct IxIntKeyCmp {
+    static int compare(const char *a, const char *b, const IxFileHdr *) {
+        int ia = *(const int *)a;
+        int ib = *(const int *)b;
+        return (ia < ib) ? -1 : ((ia > ib) ? 1 : 0);
+    }
+};
+
+struct IxFloatKeyCmp {
+    static int compare(const char *a, const char *b, const IxFileHdr *) {
+        float fa = *(const float *)a;
+        float fb = *(const float *)b;
+        return (fa < fb) ? -1 : ((fa > fb) ? 1 : 0);
+    }
+};
+
+struct IxStringKeyCmp {
+    static int compare(const char *a, const char *b, const IxFileHdr *file_hdr) {
+        return memcmp(a, b, file_hdr->col_tot_len_);
+    }
+};
+
+struct IxCompositeKeyCmp {
+    static int compare(const char *a, const char *b, const IxFileHdr *file_hdr) {
+        return ix_compare(a, b, file_hdr->col_types_, file_hdr->col_lens_);
+    }
+};
+
+/**
+ * @brief 二分查找连续存放的n个有序key中第一个>=target（upper为true时为>target）的下标
+ * @return 下标范围为[0,n]，返回n表示不存在
+ */
+template <typename KeyCmp>
+int ix_search_keys(const char *keys, int n, const char *target, const IxFileHdr *file_hdr, bool upper) {
+    int key_len = file_hdr->col_tot_len_;
+    int lo = 0, hi = n;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        int res = KeyCmp::compare(keys + static_cast<size_t>(mid) * key_len, target, file_hdr);
+        if (res < 0 || (upper && res == 0)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* 批量构建时依次给出键值对，没有更多键值对时返回false */
+using IxEntrySource = std::function<bool(const char **key, Rid *rid)>;
+
+using IxKeySearch = int (*)(const char *keys, int n, const char *target, const IxFileHdr *file_hdr, bool upper);
+
+/* 根据索引字段的类型和个数选择结点内的查找函数，打开索引时调用一次 */
+inline IxKeySearch ix_key_search_for(const IxFileHdr *file_hdr) {
+    if (file_hdr->key_format_ == IX_KEY_NORMALIZED) {
+        return ix_search_keys<IxStringKeyCmp>;
+    }
+    if (file_hdr->col_num_ == 1) {
+        switch (file_hdr->col_types_[0]) {
+            case TYPE_INT:
+                return ix_search_keys<IxIntKeyCmp>;
+            case TYPE_FLOAT:
+                return ix_search_keys<IxFloatKeyCmp>;
+            case TYPE_STRING:
+            case TYPE_VARCHAR:
+                return ix_search_keys<IxStringKeyCmp>;
+            default:
+                break;
+        }
+    }
+    return ix_search_keys<IxCompositeKeyCmp>;
+}
+
+/* B+树的形状，由IxIndexHandle::get_tree_stats统计，用于观察分裂、合并、批量构建和前缀压缩的效果 */
+struct IxTreeStats {
+    int height = 0;             // 从根结点到叶子结点的层数，空树为0
+    size_t num_leaves = 0;      // 叶子结点个数
+    size_t num_entries = 0;     // 叶子结点中键值对的总数
+    double leaf_fill = 0;       // 叶子结点中键值对个数与结点容量之比的平均值
+};
+
 /* 管理B+树中的每个节点 */
 class IxNodeHandle {
     friend class IxIndexHandle;
@@ -56,24 +228,50 @@ class IxNodeHandle {
     Page *page;                     // 存储节点的页面
     IxPageHdr *page_hdr;            // page->data的第一部分，指针指向首地址，长度为sizeof(IxPageHdr)
     char *keys;                     // page->data的第二部分，指针指向首地址，长度为file_hdr->keys_size，每个key的长度为file_hdr->col_len
+                                    // 前缀压缩的叶子结点中先存放公共前缀，keys指向其后的各个key去掉前缀的部分
     Rid *rids;                      // page->data的第三部分，指针指向首地址
+    IxKeySearch key_search;         // 结点内的查找函数，由IxIndexHandle按键的布局选择
+    bool resident = false;          // 页面由IxIndexHandle常驻固定，句柄不持有缓冲池的pin，用完后不需要unpin
 
    public:
     IxNodeHandle() = default;
 
-    IxNodeHandle(const IxFileHdr *file_hdr_, Page *page_) : file_hdr(file_hdr_), page(page_) {
+    IxNodeHandle(const IxFileHdr *file_hdr_, Page *page_, IxKeySearch key_search_ = nullptr)
+        : file_hdr(file_hdr_), page(page_), key_search(key_search_ != nullptr ? key_search_ : ix_key_search_for(file_hdr_)) {
         page_hdr = reinterpret_cast<IxPageHdr *>(page->get_data());
-        keys = page->get_data() + sizeof(IxPageHdr);
-        rids = reinterpret_cast<Rid *>(keys + file_hdr->keys_size_);
+        init_layout();
     }
 
     int get_size() { return page_hdr->num_key; }
 
     void set_size(int size) { page_hdr->num_key = size; }
 
-    int get_max_size() { return file_hdr->btree_order_ + 1; }
+    /* 前缀压缩的叶子结点中key变短，同一页面能放下更多键值对 */
+    int get_max_size() const { return is_compressed() ? slots_for(prefix_len()) : file_hdr->btree_order_ + 1; }
+
+    int get_min_size() const { return (file_hdr->btree_order_ + 1) / 2; }
+
+    /* 是否为按前缀压缩存放key的叶子结点 */
+    bool is_compressed() const { return file_hdr->prefix_compress_ && page_hdr->is_leaf; }
+
+    int prefix_len() const { return page_hdr->prefix_len; }
+
+    /* 结点中每个key实际占用的字节数 */
+    int key_stride() const { return is_compressed() ? file_hdr->col_tot_len_ - prefix_len() : file_hdr->col_tot_len_; }
+
+    int slots_for(int prefix) const;
+
+    int prefix_with(const char *key) const;
+
+    bool has_room_for(const char *key) const;
+
+    bool fits_without_split(const char *key) const;
+
+    const char *full_key(int i, char *buf) const;
+
+    const char *full_keys(int start, int n, std::vector<char> &buf) const;
 
-    int get_min_size() { return get_max_size() / 2; }
+    void set_prefix(int prefix, const char *src);
 
     int key_at(int i) { return *(int *)get_key(i); }
 
@@ -100,14 +298,25 @@ class IxNodeHandle {
 
     void set_parent_page_no(page_id_t parent) { page_hdr->parent = parent; }
 
-    char *get_key(int key_idx) const { return keys + key_idx * file_hdr->col_tot_len_; }
+    /* 结点中存储的第key_idx个key，前缀压缩的叶子结点中是去掉公共前缀的部分，需要完整的key时用full_key */
+    char *get_key(int key_idx) const { return keys + key_idx * key_stride(); }
 
     Rid *get_rid(int rid_idx) const { return &rids[rid_idx]; }
 
-    void set_key(int key_idx, const char *key) { memcpy(keys + key_idx * file_hdr->col_tot_len_, key, file_hdr->col_tot_len_); }
+    void set_key(int key_idx, const char *key) { memcpy(get_key(key_idx), key + prefix_len(), key_stride()); }
 
     void set_rid(int rid_idx, const Rid &rid) { rids[rid_idx] = rid; }
 
+    /* 比较两个结点中存储格式的key */
+    int compare_key(const char *a, const char *b) const {
+        if (file_hdr->key_format_ == IX_KEY_NORMALIZED) {
+            return memcmp(a, b, file_hdr->col_tot_len_);
+        }
+        return ix_compare(a, b, file_hdr->col_types_, file_hdr->col_lens_);
+    }
+
+    int compare_at(int pos, const char *key) const;
+
     int lower_bound(const char *target) const;
 
     int upper_bound(const char *target) const;
@@ -155,6 +364,11 @@ class IxNodeHandle {
         assert(rid_idx < page_hdr->num_key);
         return rid_idx;
     }
+
+   private:
+    void init_layout();
+
+    int search_compressed(const char *target, bool upper) const;
 };
 
 /* B+树 */
@@ -167,7 +381,15 @@ class IxIndexHandle {
     BufferPoolManager *buffer_pool_manager_;
     int fd_;                                    // 存储B+树的文件
     IxFileHdr* file_hdr_;                       // 存了root_page，但其初始化为2（第0页存FILE_HDR_PAGE，第1页存LEAF_HEADER_PAGE）
-    std::mutex root_latch_;
+    IxKeySearch key_search_;                    // 结点内的查找函数，打开索引时按键的布局选择
+    std::mutex root_latch_;                     // 保护root_page_：加根结点latch前获取，插入/删除直到根结点安全时才释放
+    std::mutex hdr_latch_;                      // 保护file_hdr_中的页面计数，不同子树上的分裂/合并会并发修改
+    // 常驻缓冲池的上层内部结点：查找经过它们时直接使用缓存的页面，不必访问缓冲池。每个页面由这里持有一个pin，
+    // 只有查找(FIND)会使用和加入常驻结点，插入/删除仍通过缓冲池获取页面，使latch_page_set中的页面都持有自己的pin
+    std::unordered_map<page_id_t, Page *> resident_pages_;
+    std::shared_mutex resident_latch_;          // 保护resident_pages_
+    int resident_levels_ = IX_RESIDENT_LEVELS;  // 从根结点开始常驻的层数，为0时不常驻
+    size_t resident_cap_;                       // 常驻结点的数量上限
 
    public:
     IxIndexHandle(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, int fd);
@@ -175,19 +397,33 @@ class IxIndexHandle {
     // for search
     bool get_value(const char *key, std::vector<Rid> *result, Transaction *transaction);
 
+    int get_values(const char *keys, int num_keys, std::vector<std::vector<Rid>> *results, Transaction *transaction);
+
+    int probe_values(const char *keys, int num_keys, std::vector<std::vector<Rid>> *results, Transaction *transaction);
+
     std::pair<IxNodeHandle *, bool> find_leaf_page(const char *key, Operation operation, Transaction *transaction,
                                                  bool find_first = false);
 
     // for insert
     page_id_t insert_entry(const char *key, const Rid &value, Transaction *transaction);
 
-    IxNodeHandle *split(IxNodeHandle *node);
+    IxNodeHandle *split(IxNodeHandle *node, int move_cnt = -1);
 
     void insert_into_parent(IxNodeHandle *old_node, const char *key, IxNodeHandle *new_node, Transaction *transaction);
 
+    void insert_entries(const char *keys, const Rid *rids, int num_entries, Transaction *transaction);
+
+    void bulk_load(const IxEntrySource &source, double fill_factor, Transaction *transaction);
+
+    void sort_entries(char *keys, Rid *rids, int num_entries) const;
+
     // for delete
     bool delete_entry(const char *key, Transaction *transaction);
 
+    bool delete_entry(const char *key, const Rid &rid, Transaction *transaction);
+
+    int delete_entries(const char *keys, const Rid *rids, int num_entries, Transaction *transaction);
+
     bool coalesce_or_redistribute(IxNodeHandle *node, Transaction *transaction = nullptr,
                                 bool *root_is_latched = nullptr);
     bool adjust_root(IxNodeHandle *old_root_node);
@@ -205,15 +441,51 @@ class IxIndexHandle {
 
     Iid leaf_begin() const;
 
+    void get_key(const Iid &iid, char *out) const;
+
+    bool is_unique() const { return file_hdr_->unique_; }
+
+    int get_fd() const { return fd_; }
+
+    void set_resident_levels(int levels);
+
+    void release_resident_pages();
+
+    size_t num_resident_pages();
+
+    IxTreeStats get_tree_stats() const;
+
    private:
     // 辅助函数
     void update_root_page_no(page_id_t root) { file_hdr_->root_page_ = root; }
 
     bool is_empty() const { return file_hdr_->root_page_ == IX_NO_PAGE; }
 
+    void build_from_sorted(IxNodeHandle *root, const IxEntrySource &source, double fill_factor);
+
+    void insert_sorted(const IxEntrySource &source, Transaction *transaction);
+
+    page_id_t insert_into_leaf(IxNodeHandle *leaf, bool root_is_latched, const char *key, const Rid &value,
+                               Transaction *transaction);
+
+    bool erase_entry(const char *key, const Rid *rid, Transaction *transaction);
+
+    bool erase_from_leaf(IxNodeHandle *leaf, bool root_is_latched, const char *key, const Rid *rid,
+                         Transaction *transaction);
+
+    bool remove_from_leaf(IxNodeHandle *leaf, const char *key, const Rid *rid);
+
     // for get/create node
     IxNodeHandle *fetch_node(int page_no) const;
 
+    IxNodeHandle *fetch_resident_node(int page_no);
+
+    IxNodeHandle *try_fetch_resident_node(int page_no);
+
+    void make_resident(IxNodeHandle *node, int depth);
+
+    void unpin_node(IxNodeHandle *node, bool is_dirty);
+
     IxNodeHandle *create_node();
 
     // for maintain data structure
@@ -225,6 +497,16 @@ class IxIndexHandle {
 
     void maintain_child(IxNodeHandle *node, int child_idx);
 
+    // for latch crabbing
+    bool is_safe(IxNodeHandle *node, const char *key, Operation operation);
+
+    void release_latched_pages(Transaction *transaction, bool is_dirty);
+
+    // for key format
+    const char *to_index_key(const char *key, char *buf) const;
+
+    const char *to_index_key(const char *key, const Rid &rid, char *buf) const;
+
     // for index test
     Rid get_rid(const Iid &iid) const;
 };
\ No newline at end of file
@@ -0,0 +1,566 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "ix_lsm_index.h"
+
+#include <algorithm>
+#include <set>
+
+namespace {
+
+// 每个key在Bloom过滤器中置位的个数，取bits_per_key * ln2时误判率最低
+constexpr int IX_LSM_BLOOM_PROBES = std::max(1, IX_LSM_BLOOM_BITS_PER_KEY * 69 / 100);
+
+/* 由key的哈希值派生出第i个探测位置（双重哈希） */
+size_t bloom_bit(uint64_t hash, int i, size_t num_bits) {
+    uint64_t step = (hash >> 32) | 1;
+    return static_cast<size_t>((hash + static_cast<uint64_t>(i) * step) % num_bits);
+}
+
+}  // namespace
+
+/* 被合并的有序段在最后一个查找结束之后回收页面，此时文件头已经不再引用它 */
+IxLsmIndexHandle::Run::~Run() {
+    if (!retired) {
+        return;
+    }
+    for (page_id_t page_no : data_pages) {
+        buffer_pool_manager->deallocate_page({.fd = fd, .page_no = page_no});
+    }
+    for (page_id_t page_no : desc_pages) {
+        buffer_pool_manager->deallocate_page({.fd = fd, .page_no = page_no});
+    }
+}
+
+IxLsmIndexHandle::IxLsmIndexHandle(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, int fd)
+    : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager), fd_(fd) {
+    int page_size = disk_manager_->get_page_size();
+    std::vector<char> buf(page_size);
+    disk_manager_->read_page(fd, IX_FILE_HDR_PAGE, buf.data(), page_size);
+    file_hdr_.deserialize(buf.data());
+    entry_len_ = file_hdr_.col_tot_len_ + static_cast<int>(sizeof(Rid)) + 1;
+    entries_per_page_ = (page_size - static_cast<int>(sizeof(IxLsmPageHdr))) / entry_len_;
+    assert(entries_per_page_ >= 2);
+
+    int file_size = disk_manager_->get_file_size(disk_manager_->get_file_name(fd));
+    int num_pages = (file_size + page_size - 1) / page_size;
+    disk_manager_->set_fd2pageno(fd, num_pages);
+
+    // 载入文件头引用的有序段。其余页面属于已经被合并的段，或者故障前写了一半、还没被文件头引用的段，可以重新分配
+    std::vector<bool> used(std::max(num_pages, 1), false);
+    used[IX_FILE_HDR_PAGE] = true;
+    for (page_id_t desc_page : file_hdr_.runs_) {
+        auto run = load_run(desc_page);
+        for (auto *pages : {&run->data_pages, &run->desc_pages}) {
+            for (page_id_t page_no : *pages) {
+                if (page_no < num_pages) {
+                    used[page_no] = true;
+                }
+            }
+        }
+        runs_.push_back(std::move(run));
+    }
+    for (int page_no = 0; page_no < num_pages; ++page_no) {
+        if (!used[page_no]) {
+            disk_manager_->deallocate_page(fd, page_no);
+        }
+    }
+    worker_ = std::thread(&IxLsmIndexHandle::run_worker, this);
+}
+
+IxLsmIndexHandle::~IxLsmIndexHandle() { stop_worker(); }
+
+int IxLsmIndexHandle::get_num_runs() {
+    std::shared_lock<std::shared_mutex> lock(latch_);
+    return static_cast<int>(runs_.size());
+}
+
+/**
+ * @brief 查找与key相等的所有键值对。依次查找memtable、immutable和从新到旧的各有序段，
+ * 同一个rid只看最新的条目，最新的条目是删除标记时不返回
+ *
+ * @param key 要查找的key，为记录中的原始格式
+ * @param result 找到的rid追加到result中
+ * @return 是否找到
+ */
+bool IxLsmIndexHandle::get_value(const char *key, std::vector<Rid> *result, Transaction *transaction) {
+    char buf[IX_MAX_COL_LEN];
+    ix_normalize_key(key, buf, file_hdr_.col_types_, file_hdr_.col_lens_);
+    int key_len = file_hdr_.col_tot_len_;
+    bool found = false;
+    std::set<std::pair<int, int>> seen;
+    auto visit = [&](const char *rid_data, bool tombstone) {
+        Rid rid;
+        memcpy(&rid, rid_data, sizeof(Rid));
+        if (seen.emplace(rid.page_no, rid.slot_no).second && !tombstone) {
+            result->push_back(rid);
+            found = true;
+        }
+    };
+
+    // 有序段创建之后不再修改，取得段列表之后不持有latch_，被合并的段在查找结束之前不会回收
+    std::vector<std::shared_ptr<Run>> runs;
+    {
+        std::shared_lock<std::shared_mutex> lock(latch_);
+        std::string lower(buf, key_len);
+        for (const Memtable *table : {&memtable_, &immutable_}) {
+            for (auto it = table->lower_bound(lower); it != table->end() && memcmp(it->first.data(), buf, key_len) == 0;
+                 ++it) {
+                visit(it->first.data() + key_len, it->second);
+            }
+        }
+        runs = runs_;
+    }
+    uint64_t hash = ix_hash_key(buf, key_len);
+    for (auto &run : runs) {
+        if (may_contain(*run, hash)) {
+            search_run(*run, buf, [&](const char *entry) { visit(entry + key_len, entry[entry_len_ - 1] != 0); });
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief 插入键值对，同一个key可以对应多个rid。只写入memtable，不检查(key, rid)是否已经存在，总是返回true
+ */
+bool IxLsmIndexHandle::insert_entry(const char *key, const Rid &value, Transaction *transaction) {
+    put_entry(key, value, false);
+    return true;
+}
+
+/**
+ * @brief 删除键值对。在memtable中写入删除标记，遮住较旧的有序段中的(key, rid)；不检查是否存在，总是返回true
+ */
+bool IxLsmIndexHandle::delete_entry(const char *key, const Rid &value, Transaction *transaction) {
+    put_entry(key, value, true);
+    return true;
+}
+
+/**
+ * @brief 把(key, rid)的最新状态写入memtable。memtable写满时冻结为immutable交给后台线程；
+ * 上一个immutable还没写完时等待，内存中最多保留两个写满的memtable
+ */
+void IxLsmIndexHandle::put_entry(const char *key, const Rid &value, bool tombstone) {
+    int key_len = file_hdr_.col_tot_len_;
+    std::string entry(key_len + sizeof(Rid), '\0');
+    ix_normalize_key(key, entry.data(), file_hdr_.col_types_, file_hdr_.col_lens_);
+    memcpy(entry.data() + key_len, &value, sizeof(Rid));
+
+    std::unique_lock<std::shared_mutex> lock(latch_);
+    flushed_cv_.wait(lock, [&] {
+        return memtable_.size() < static_cast<size_t>(IX_LSM_MEMTABLE_ENTRIES) || immutable_.empty();
+    });
+    memtable_[std::move(entry)] = tombstone;
+    if (memtable_.size() >= static_cast<size_t>(IX_LSM_MEMTABLE_ENTRIES) && immutable_.empty()) {
+        immutable_.swap(memtable_);
+        work_cv_.notify_one();
+    }
+}
+
+/**
+ * @brief 检查点时把immutable和memtable写成有序段，写文件头。与检查点同时进行的插入可能留在memtable中，
+ * 和B+树索引一样由故障恢复重建；关闭索引时已经没有并发的修改，内存中的条目全部落盘
+ */
+void IxLsmIndexHandle::flush() {
+    std::scoped_lock work_lock{work_latch_};
+    flush_immutable();
+    {
+        std::unique_lock<std::shared_mutex> lock(latch_);
+        if (immutable_.empty()) {
+            immutable_.swap(memtable_);
+        }
+    }
+    flush_immutable();
+}
+
+void IxLsmIndexHandle::close() {
+    stop_worker();
+    flush();
+}
+
+/* 后台线程：把冻结的immutable写成有序段，有序段过多时合并 */
+void IxLsmIndexHandle::run_worker() {
+    while (true) {
+        {
+            std::unique_lock<std::shared_mutex> lock(latch_);
+            work_cv_.wait(lock, [&] {
+                return stop_ || !immutable_.empty() || runs_.size() >= static_cast<size_t>(IX_LSM_COMPACT_RUNS);
+            });
+            if (stop_) {
+                return;
+            }
+        }
+        std::scoped_lock work_lock{work_latch_};
+        flush_immutable();
+        while (compact()) {
+        }
+    }
+}
+
+void IxLsmIndexHandle::stop_worker() {
+    {
+        std::unique_lock<std::shared_mutex> lock(latch_);
+        stop_ = true;
+    }
+    work_cv_.notify_all();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+/**
+ * @brief 把immutable写成最新的有序段并写文件头，调用时持有work_latch_。没有更旧的段时删除标记不必写出
+ * @return immutable为空时返回false
+ */
+bool IxLsmIndexHandle::flush_immutable() {
+    {
+        std::shared_lock<std::shared_mutex> lock(latch_);
+        if (immutable_.empty()) {
+            return false;
+        }
+    }
+    if (runs_.size() >= static_cast<size_t>(IX_LSM_MAX_RUNS)) {
+        compact();
+    }
+    // immutable_不为空时插入不会修改它，写有序段期间不持有latch_，查找仍能看到其中的条目
+    bool keep_tombstones = !runs_.empty();
+    std::vector<char> buf(entry_len_);
+    auto it = immutable_.begin();
+    auto run = write_run([&](const char **entry) {
+        while (it != immutable_.end()) {
+            auto cur = it++;
+            if (cur->second && !keep_tombstones) {
+                continue;
+            }
+            memcpy(buf.data(), cur->first.data(), entry_len_ - 1);
+            buf[entry_len_ - 1] = cur->second;
+            *entry = buf.data();
+            return true;
+        }
+        return false;
+    });
+    {
+        std::unique_lock<std::shared_mutex> lock(latch_);
+        if (run != nullptr) {
+            runs_.insert(runs_.begin(), run);
+        }
+        immutable_.clear();
+    }
+    flushed_cv_.notify_all();
+    if (runs_.size() >= static_cast<size_t>(IX_LSM_COMPACT_RUNS)) {
+        work_cv_.notify_one();
+    }
+    write_file_hdr();
+    return true;
+}
+
+/**
+ * @brief 有序段达到IX_LSM_COMPACT_RUNS个时，从最新的段开始选取至少两个段合并，直到下一个段比已选的段加起来还大，
+ * 各段的大小因此大致按倍数递增，每个条目被重写的次数与段数的对数相当。调用时持有work_latch_
+ * @return 是否进行了合并
+ */
+bool IxLsmIndexHandle::compact() {
+    if (runs_.size() < static_cast<size_t>(IX_LSM_COMPACT_RUNS)) {
+        return false;
+    }
+    size_t n = 1;
+    long long merged_entries = runs_[0]->num_entries;
+    while (n < runs_.size() && (n < 2 || runs_[n]->num_entries <= merged_entries)) {
+        merged_entries += runs_[n]->num_entries;
+        n++;
+    }
+    std::vector<std::shared_ptr<Run>> inputs(runs_.begin(), runs_.begin() + n);
+    // 合并包括最旧的段时，删除标记遮住的条目都已经在合并中丢弃，标记本身也不再需要
+    bool keep_tombstones = n < runs_.size();
+
+    struct Cursor {
+        const Run *run;
+        size_t page_idx = 0;
+        int pos = 0;
+        std::vector<char> data;     // 当前数据页的副本
+
+        bool valid() const { return page_idx < run->data_pages.size(); }
+    };
+    int page_size = disk_manager_->get_page_size();
+    auto load = [&](Cursor &cursor) {
+        if (cursor.valid()) {
+            Page *page = fetch_page(cursor.run->data_pages[cursor.page_idx]);
+            memcpy(cursor.data.data(), page->get_data(), page_size);
+            unpin_page(page, false);
+        }
+        cursor.pos = 0;
+    };
+    auto current = [&](Cursor &cursor) { return page_entry(cursor.data.data(), cursor.pos); };
+    auto advance = [&](Cursor &cursor) {
+        if (++cursor.pos == reinterpret_cast<IxLsmPageHdr *>(cursor.data.data())->count) {
+            cursor.page_idx++;
+            load(cursor);
+        }
+    };
+    std::vector<Cursor> cursors;
+    for (auto &input : inputs) {
+        Cursor cursor{input.get()};
+        cursor.data.resize(page_size);
+        load(cursor);
+        cursors.push_back(std::move(cursor));
+    }
+
+    int cmp_len = entry_len_ - 1;
+    std::vector<char> out(entry_len_);
+    auto run = write_run([&](const char **entry) {
+        while (true) {
+            // 相同的(key, rid)取最新的段中的条目，较旧的段中的相同条目一起跳过
+            Cursor *best = nullptr;
+            for (auto &cursor : cursors) {
+                if (cursor.valid() && (best == nullptr || memcmp(current(cursor), current(*best), cmp_len) < 0)) {
+                    best = &cursor;
+                }
+            }
+            if (best == nullptr) {
+                return false;
+            }
+            memcpy(out.data(), current(*best), entry_len_);
+            for (auto &cursor : cursors) {
+                if (cursor.valid() && memcmp(current(cursor), out.data(), cmp_len) == 0) {
+                    advance(cursor);
+                }
+            }
+            if (out[entry_len_ - 1] && !keep_tombstones) {
+                continue;
+            }
+            *entry = out.data();
+            return true;
+        }
+    });
+    {
+        std::unique_lock<std::shared_mutex> lock(latch_);
+        runs_.erase(runs_.begin(), runs_.begin() + n);
+        if (run != nullptr) {
+            runs_.insert(runs_.begin(), run);
+        }
+    }
+    // 文件头不再引用被合并的段之后才能回收它们的页面
+    write_file_hdr();
+    for (auto &input : inputs) {
+        input->retired = true;
+    }
+    return true;
+}
+
+/**
+ * @brief 把next依次给出的条目写成一个有序段：条目装满一个数据页再换下一页，之后写描述页链。
+ * 描述页中依次存放条目数量、数据页数量、Bloom过滤器的字数、各数据页的页号、栅栏key和Bloom过滤器。
+ * 段的全部页面在返回之前写回磁盘，之后文件头才能引用它
+ * @return 没有条目时返回nullptr
+ */
+std::shared_ptr<IxLsmIndexHandle::Run> IxLsmIndexHandle::write_run(const EntrySource &next) {
+    auto run = std::make_shared<Run>(buffer_pool_manager_, fd_);
+    int key_len = file_hdr_.col_tot_len_;
+    int fence_len = entry_len_ - 1;
+    auto finish_page = [&](Page *page) {
+        buffer_pool_manager_->flush_page(page->get_page_id());
+        unpin_page(page, false);
+    };
+
+    std::vector<uint64_t> hashes;
+    Page *page = nullptr;
+    const char *entry;
+    while (next(&entry)) {
+        IxLsmPageHdr *hdr = page != nullptr ? reinterpret_cast<IxLsmPageHdr *>(page->get_data()) : nullptr;
+        if (hdr == nullptr || hdr->count == entries_per_page_) {
+            if (page != nullptr) {
+                finish_page(page);
+            }
+            page = new_page();
+            hdr = reinterpret_cast<IxLsmPageHdr *>(page->get_data());
+            *hdr = {.count = 0, .next_page = IX_NO_PAGE};
+            run->data_pages.push_back(page->get_page_id().page_no);
+            run->fences.insert(run->fences.end(), entry, entry + fence_len);
+        }
+        memcpy(page_entry(page->get_data(), hdr->count), entry, entry_len_);
+        hdr->count++;
+        run->num_entries++;
+        // 同一个key的条目相邻，Bloom过滤器中只需加入一次
+        uint64_t hash = ix_hash_key(entry, key_len);
+        if (hashes.empty() || hashes.back() != hash) {
+            hashes.push_back(hash);
+        }
+    }
+    if (page != nullptr) {
+        finish_page(page);
+    }
+    if (run->num_entries == 0) {
+        return nullptr;
+    }
+
+    size_t num_bits = std::max<size_t>(64, hashes.size() * IX_LSM_BLOOM_BITS_PER_KEY);
+    run->bloom.assign((num_bits + 63) / 64, 0);
+    num_bits = run->bloom.size() * 64;
+    for (uint64_t hash : hashes) {
+        for (int i = 0; i < IX_LSM_BLOOM_PROBES; ++i) {
+            size_t bit = bloom_bit(hash, i, num_bits);
+            run->bloom[bit / 64] |= 1ULL << (bit % 64);
+        }
+    }
+
+    std::vector<char> desc;
+    auto put = [&](const void *src, size_t len) {
+        desc.insert(desc.end(), static_cast<const char *>(src), static_cast<const char *>(src) + len);
+    };
+    int num_data_pages = run->data_pages.size();
+    int num_bloom_words = run->bloom.size();
+    put(&run->num_entries, sizeof(int));
+    put(&num_data_pages, sizeof(int));
+    put(&num_bloom_words, sizeof(int));
+    put(run->data_pages.data(), sizeof(page_id_t) * num_data_pages);
+    put(run->fences.data(), run->fences.size());
+    put(run->bloom.data(), sizeof(uint64_t) * num_bloom_words);
+
+    size_t capacity = disk_manager_->get_page_size() - sizeof(IxLsmPageHdr);
+    page = new_page();
+    run->desc_page = page->get_page_id().page_no;
+    run->desc_pages.push_back(run->desc_page);
+    for (size_t offset = 0;;) {
+        size_t len = std::min(capacity, desc.size() - offset);
+        auto hdr = reinterpret_cast<IxLsmPageHdr *>(page->get_data());
+        *hdr = {.count = static_cast<int>(len), .next_page = IX_NO_PAGE};
+        memcpy(page->get_data() + sizeof(IxLsmPageHdr), desc.data() + offset, len);
+        offset += len;
+        if (offset == desc.size()) {
+            finish_page(page);
+            break;
+        }
+        Page *next_page = new_page();
+        hdr->next_page = next_page->get_page_id().page_no;
+        run->desc_pages.push_back(hdr->next_page);
+        finish_page(page);
+        page = next_page;
+    }
+    return run;
+}
+
+/* 读出描述页链，载入有序段的目录、栅栏key和Bloom过滤器 */
+std::shared_ptr<IxLsmIndexHandle::Run> IxLsmIndexHandle::load_run(page_id_t desc_page) {
+    auto run = std::make_shared<Run>(buffer_pool_manager_, fd_);
+    run->desc_page = desc_page;
+    std::vector<char> desc;
+    for (page_id_t page_no = desc_page; page_no != IX_NO_PAGE;) {
+        Page *page = fetch_page(page_no);
+        auto hdr = reinterpret_cast<IxLsmPageHdr *>(page->get_data());
+        const char *src = page->get_data() + sizeof(IxLsmPageHdr);
+        desc.insert(desc.end(), src, src + hdr->count);
+        run->desc_pages.push_back(page_no);
+        page_no = hdr->next_page;
+        unpin_page(page, false);
+    }
+
+    size_t offset = 0;
+    auto get = [&](void *dest, size_t len) {
+        memcpy(dest, desc.data() + offset, len);
+        offset += len;
+    };
+    int num_data_pages;
+    int num_bloom_words;
+    get(&run->num_entries, sizeof(int));
+    get(&num_data_pages, sizeof(int));
+    get(&num_bloom_words, sizeof(int));
+    run->data_pages.resize(num_data_pages);
+    run->fences.resize(static_cast<size_t>(num_data_pages) * (entry_len_ - 1));
+    run->bloom.resize(num_bloom_words);
+    get(run->data_pages.data(), sizeof(page_id_t) * num_data_pages);
+    get(run->fences.data(), run->fences.size());
+    get(run->bloom.data(), sizeof(uint64_t) * num_bloom_words);
+    assert(offset == desc.size());
+    return run;
+}
+
+/* 把当前的段列表写入文件头，调用时持有work_latch_ */
+void IxLsmIndexHandle::write_file_hdr() {
+    file_hdr_.runs_.clear();
+    for (auto &run : runs_) {
+        file_hdr_.runs_.push_back(run->desc_page);
+    }
+    file_hdr_.update_tot_len();
+    int page_size = disk_manager_->get_page_size();
+    assert(file_hdr_.tot_len_ <= page_size);
+    std::vector<char> buf(page_size);
+    file_hdr_.serialize(buf.data());
+    disk_manager_->write_page(fd_, IX_FILE_HDR_PAGE, buf.data(), page_size);
+}
+
+/* Bloom过滤器判断有序段中是否可能有key的条目，返回false时一定没有 */
+bool IxLsmIndexHandle::may_contain(const Run &run, uint64_t hash) const {
+    size_t num_bits = run.bloom.size() * 64;
+    for (int i = 0; i < IX_LSM_BLOOM_PROBES; ++i) {
+        size_t bit = bloom_bit(hash, i, num_bits);
+        if (!((run.bloom[bit / 64] >> (bit % 64)) & 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 在有序段中找出key的全部条目。按栅栏key二分查找第一个可能包含key的数据页，页内再二分查找，
+ * 之后顺序向后扫描，直到遇到更大的key
+ * @param key 编码后的key
+ */
+void IxLsmIndexHandle::search_run(const Run &run, const char *key,
+                                  const std::function<void(const char *entry)> &visit) {
+    int key_len = file_hdr_.col_tot_len_;
+    int fence_len = entry_len_ - 1;
+    int lo = 0;
+    int hi = run.data_pages.size();
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (memcmp(run.fences.data() + static_cast<size_t>(mid) * fence_len, key, key_len) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    // 第一个栅栏key不小于key的数据页之前的那一页也可能有key的条目
+    size_t start = std::max(lo - 1, 0);
+    for (size_t i = start; i < run.data_pages.size(); ++i) {
+        Page *page = fetch_page(run.data_pages[i]);
+        char *data = page->get_data();
+        int count = reinterpret_cast<IxLsmPageHdr *>(data)->count;
+        int pos = 0;
+        if (i == start) {
+            int right = count;
+            while (pos < right) {
+                int mid = (pos + right) / 2;
+                if (memcmp(page_entry(data, mid), key, key_len) < 0) {
+                    pos = mid + 1;
+                } else {
+                    right = mid;
+                }
+            }
+        }
+        bool done = false;
+        for (; pos < count; ++pos) {
+            const char *entry = page_entry(data, pos);
+            if (memcmp(entry, key, key_len) != 0) {
+                done = true;
+                break;
+            }
+            visit(entry);
+        }
+        unpin_page(page, false);
+        if (done) {
+            return;
+        }
+    }
+}
+
+Page *IxLsmIndexHandle::new_page() {
+    PageId page_id = {.fd = fd_, .page_no = INVALID_PAGE_ID};
+    return buffer_pool_manager_->new_page(&page_id);
+}
@@ -0,0 +1,128 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ix_defs.h"
+#include "ix_index_handle.h"
+#include "ix_point_index.h"
+#include "transaction/transaction.h"
+
+/**
+ * @brief 面向写入的LSM索引，只支持等值查找
+ * 插入和删除只修改内存中的有序表（memtable），删除写入删除标记。memtable达到IX_LSM_MEMTABLE_ENTRIES条时
+ * 冻结为只读的immutable，由后台线程写成一个不可修改的有序段（run），之后插入新的memtable；
+ * 后台线程还没写完上一个immutable时，写满memtable的插入等待。有序段达到IX_LSM_COMPACT_RUNS个时后台线程把
+ * 较新的几个段合并成一个，合并包括最旧的段时丢弃删除标记。
+ * 条目为编码后的key、rid和删除标记，按key和rid的字节序排列，同一个(key, rid)以最新的条目为准。
+ * 每个有序段的栅栏key（各数据页的第一个条目）和按key建立的Bloom过滤器常驻内存，查找依次检查memtable、
+ * immutable和从新到旧的各有序段，Bloom过滤器排除不含该key的段。
+ * 文件头只引用已经落盘的有序段，修改段列表时先写回新段的页面，再写文件头，最后释放被合并的段的页面
+ */
+class IxLsmIndexHandle : public IxPointIndexHandle {
+    friend class IxManager;
+
+   private:
+    /* 一个有序段，创建之后不再修改。被合并之后标记为retired，最后一个持有者释放时回收它的页面 */
+    struct Run {
+        BufferPoolManager *buffer_pool_manager;
+        int fd;
+        page_id_t desc_page = IX_NO_PAGE;       // 描述页链的第一页，记录在文件头中
+        int num_entries = 0;
+        std::vector<page_id_t> data_pages;      // 依次存放条目的数据页
+        std::vector<page_id_t> desc_pages;      // 描述页链上的全部页面
+        std::vector<char> fences;               // 各数据页第一个条目的key和rid
+        std::vector<uint64_t> bloom;            // Bloom过滤器的位数组
+        bool retired = false;
+
+        Run(BufferPoolManager *bpm, int fd) : buffer_pool_manager(bpm), fd(fd) {}
+
+        ~Run();
+    };
+
+    // 编码后的key和rid -> 是否为删除标记
+    using Memtable = std::map<std::string, bool>;
+    // 依次取出有序段的条目，没有更多条目时返回false
+    using EntrySource = std::function<bool(const char **entry)>;
+
+    DiskManager *disk_manager_;
+    BufferPoolManager *buffer_pool_manager_;
+    int fd_;                                    // 存储LSM索引的文件
+    IxLsmFileHdr file_hdr_;
+    int entry_len_;                             // 条目的长度：key、rid和一个字节的删除标记
+    int entries_per_page_;                      // 每个数据页最多存放的条目数量
+    Memtable memtable_;
+    Memtable immutable_;                        // 等待后台线程写成有序段，为空时表示没有
+    std::vector<std::shared_ptr<Run>> runs_;    // 从新到旧排列的有序段
+    std::shared_mutex latch_;                   // 保护memtable_、immutable_和runs_
+    std::condition_variable_any work_cv_;       // 有新的immutable或需要合并时通知后台线程
+    std::condition_variable_any flushed_cv_;    // immutable写完之后通知等待的插入
+    std::mutex work_latch_;                     // 串行化写有序段、合并和写文件头，持有时runs_只会被持有者修改
+    bool stop_ = false;
+    std::thread worker_;
+
+   public:
+    IxLsmIndexHandle(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, int fd);
+
+    ~IxLsmIndexHandle();
+
+    int get_fd() const override { return fd_; }
+
+    int get_num_runs();
+
+    bool get_value(const char *key, std::vector<Rid> *result, Transaction *transaction) override;
+
+    bool insert_entry(const char *key, const Rid &value, Transaction *transaction) override;
+
+    bool delete_entry(const char *key, const Rid &value, Transaction *transaction) override;
+
+    void flush() override;
+
+    void close() override;
+
+   private:
+    void put_entry(const char *key, const Rid &value, bool tombstone);
+
+    void run_worker();
+
+    void stop_worker();
+
+    bool flush_immutable();
+
+    bool compact();
+
+    std::shared_ptr<Run> write_run(const EntrySource &next);
+
+    std::shared_ptr<Run> load_run(page_id_t desc_page);
+
+    void write_file_hdr();
+
+    bool may_contain(const Run &run, uint64_t hash) const;
+
+    void search_run(const Run &run, const char *key, const std::function<void(const char *entry)> &visit);
+
+    Page *fetch_page(page_id_t page_no) { return buffer_pool_manager_->fetch_page({.fd = fd_, .page_no = page_no}); }
+
+    void unpin_page(Page *page, bool dirty) { buffer_pool_manager_->unpin_page(page->get_page_id(), dirty); }
+
+    Page *new_page();
+
+    char *page_entry(char *data, int i) const { return data + sizeof(IxLsmPageHdr) + i * entry_len_; }
+};
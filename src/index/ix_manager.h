@@ -10,12 +10,17 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <algorithm>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include "system/sm_meta.h"
 #include "ix_defs.h"
+#include "ix_hash_index.h"
 #include "ix_index_handle.h"
+#include "ix_lsm_index.h"
 
 class IxManager {
    private:
@@ -54,38 +59,69 @@ class IxManager {
         return disk_manager_->is_file(ix_name);
     }
 
-    void create_index(const std::string &filename, const std::vector<ColMeta>& index_cols) {
+    /**
+     * @brief 创建索引文件
+     * @param key_format 键的存储格式，IX_KEY_NORMALIZED时结点中保存保序编码后的key，比较时只需memcmp
+     * @param unique 是否为唯一索引。非唯一索引在key之后追加Rid以区分重复的key，总是使用保序编码
+     * @param compressed 是否创建页面压缩的索引文件
+     */
+    void create_index(const std::string &filename, const std::vector<ColMeta>& index_cols,
+                      IxKeyFormat key_format = IX_KEY_RAW, bool unique = true, bool compressed = false) {
         std::string ix_name = get_index_name(filename, index_cols);
         // Create index file
-        disk_manager_->create_file(ix_name);
+        disk_manager_->create_file(ix_name, compressed);
         // Open index file
         int fd = disk_manager_->open_file(ix_name);
 
         // Create file header and write to file
-        // Theoretically we have: |page_hdr| + (|attr| + |rid|) * n <= PAGE_SIZE
+        // Theoretically we have: |page_hdr| + (|attr| + |rid|) * n <= page_size
         // but we reserve one slot for convenient inserting and deleting, i.e.
-        // |page_hdr| + (|attr| + |rid|) * (n + 1) <= PAGE_SIZE
+        // |page_hdr| + (|attr| + |rid|) * (n + 1) <= page_size
+        // page_size为当前数据库的页面大小
         int col_tot_len = 0;
         int col_num = index_cols.size();
         for(auto& col: index_cols) {
             col_tot_len += col.len;
         }
+        if (!unique) {
+            col_num += 2;
+            col_tot_len += sizeof(Rid);
+            key_format = IX_KEY_NORMALIZED;
+        }
         if (col_tot_len > IX_MAX_COL_LEN) {
             throw InvalidColLengthError(col_tot_len);
         }
-        // 根据 |page_hdr| + (|attr| + |rid|) * (n + 1) <= PAGE_SIZE 求得n的最大值btree_order
+        // 根据 |page_hdr| + (|attr| + |rid|) * (n + 1) <= page_size 求得n的最大值btree_order
         // 即 n <= btree_order，那么btree_order就是每个结点最多可插入的键值对数量（实际还多留了一个空位，但其不可插入）
-        int btree_order = static_cast<int>((PAGE_SIZE - sizeof(IxPageHdr)) / (col_tot_len + sizeof(Rid)) - 1);
+        int page_size = disk_manager_->get_page_size();
+        int btree_order = static_cast<int>((page_size - sizeof(IxPageHdr)) / (col_tot_len + sizeof(Rid)) - 1);
         assert(btree_order > 2);
 
         // Create file header and write to file
         IxFileHdr* fhdr = new IxFileHdr(IX_NO_PAGE, IX_INIT_NUM_PAGES, IX_INIT_ROOT_PAGE,
                                 col_num, col_tot_len, btree_order, (btree_order + 1) * col_tot_len,
                                 IX_INIT_ROOT_PAGE, IX_INIT_ROOT_PAGE);
-        for(int i = 0; i < col_num; ++i) {
-            fhdr->col_types_.push_back(index_cols[i].type);
-            fhdr->col_lens_.push_back(index_cols[i].len);
+        for(auto& col: index_cols) {
+            fhdr->col_types_.push_back(col.type);
+            fhdr->col_lens_.push_back(col.len);
+        }
+        if (!unique) {
+            // Rid的page_no和slot_no
+            for (int i = 0; i < 2; ++i) {
+                fhdr->col_types_.push_back(TYPE_INT);
+                fhdr->col_lens_.push_back(sizeof(int));
+            }
         }
+        fhdr->key_format_ = key_format;
+        fhdr->unique_ = unique;
+        // 按memcmp比较的key才能把公共前缀提出来单独存放，太短的key压缩后省下的空间不值得重新布局的开销
+        bool memcmp_ordered = key_format == IX_KEY_NORMALIZED;
+        if (!memcmp_ordered) {
+            memcmp_ordered = std::all_of(index_cols.begin(), index_cols.end(), [](const ColMeta &col) {
+                return col.type == TYPE_STRING || col.type == TYPE_VARCHAR;
+            });
+        }
+        fhdr->prefix_compress_ = memcmp_ordered && col_tot_len >= IX_PREFIX_COMPRESS_MIN_LEN;
         fhdr->update_tot_len();
         
         char* data = new char[fhdr->tot_len_];
@@ -93,12 +129,12 @@ class IxManager {
 
         disk_manager_->write_page(fd, IX_FILE_HDR_PAGE, data, fhdr->tot_len_);
 
-        char page_buf[PAGE_SIZE];  // 在内存中初始化page_buf中的内容，然后将其写入磁盘
-        memset(page_buf, 0, PAGE_SIZE);
+        std::vector<char> page_buf_data(page_size);  // 在内存中初始化page_buf中的内容，然后将其写入磁盘
+        char *page_buf = page_buf_data.data();
         // 注意leaf header页号为1，也标记为叶子结点，其前一个/后一个叶子均指向root node
         // Create leaf list header page and write to file
         {
-            memset(page_buf, 0, PAGE_SIZE);
+            memset(page_buf, 0, page_size);
             auto phdr = reinterpret_cast<IxPageHdr *>(page_buf);
             *phdr = {
                 .next_free_page_no = IX_NO_PAGE,
@@ -108,12 +144,12 @@ class IxManager {
                 .prev_leaf = IX_INIT_ROOT_PAGE,
                 .next_leaf = IX_INIT_ROOT_PAGE,
             };
-            disk_manager_->write_page(fd, IX_LEAF_HEADER_PAGE, page_buf, PAGE_SIZE);
+            disk_manager_->write_page(fd, IX_LEAF_HEADER_PAGE, page_buf, page_size);
         }
         // 注意root node页号为2，也标记为叶子结点，其前一个/后一个叶子均指向leaf header
         // Create root node and write to file
         {
-            memset(page_buf, 0, PAGE_SIZE);
+            memset(page_buf, 0, page_size);
             auto phdr = reinterpret_cast<IxPageHdr *>(page_buf);
             *phdr = {
                 .next_free_page_no = IX_NO_PAGE,
@@ -123,8 +159,8 @@ class IxManager {
                 .prev_leaf = IX_LEAF_HEADER_PAGE,
                 .next_leaf = IX_LEAF_HEADER_PAGE,
             };
-            // Must write PAGE_SIZE here in case of future fetch_node()
-            disk_manager_->write_page(fd, IX_INIT_ROOT_PAGE, page_buf, PAGE_SIZE);
+            // Must write the whole page here in case of future fetch_node()
+            disk_manager_->write_page(fd, IX_INIT_ROOT_PAGE, page_buf, page_size);
         }
 
         disk_manager_->set_fd2pageno(fd, IX_INIT_NUM_PAGES - 1);  // DEBUG
@@ -133,6 +169,86 @@ class IxManager {
         disk_manager_->close_file(fd);
     }
 
+    /**
+     * @brief 创建可扩展哈希索引文件：第0页为文件头，第1页为初始的桶（局部深度为0），第2页保存只有一项的目录
+     */
+    void create_hash_index(const std::string &filename, const std::vector<ColMeta>& index_cols, bool compressed = false) {
+        std::string ix_name = get_index_name(filename, index_cols);
+        disk_manager_->create_file(ix_name, compressed);
+        int fd = disk_manager_->open_file(ix_name);
+
+        IxHashFileHdr fhdr;
+        for (auto &col : index_cols) {
+            fhdr.col_types_.push_back(col.type);
+            fhdr.col_lens_.push_back(col.len);
+            fhdr.col_tot_len_ += col.len;
+        }
+        if (fhdr.col_tot_len_ > IX_MAX_COL_LEN) {
+            disk_manager_->close_file(fd);
+            disk_manager_->destroy_file(ix_name);
+            throw InvalidColLengthError(fhdr.col_tot_len_);
+        }
+        fhdr.col_num_ = index_cols.size();
+        fhdr.dir_pages_.push_back(IX_HASH_INIT_DIR_PAGE);
+        fhdr.update_tot_len();
+
+        int page_size = disk_manager_->get_page_size();
+        std::vector<char> page_buf(page_size);
+        fhdr.serialize(page_buf.data());
+        disk_manager_->write_page(fd, IX_FILE_HDR_PAGE, page_buf.data(), page_size);
+
+        memset(page_buf.data(), 0, page_size);
+        *reinterpret_cast<IxHashBucketHdr *>(page_buf.data()) = {
+            .local_depth = 0, .num_key = 0, .next_page = IX_NO_PAGE, .reserved = 0};
+        disk_manager_->write_page(fd, IX_HASH_INIT_BUCKET_PAGE, page_buf.data(), page_size);
+
+        memset(page_buf.data(), 0, page_size);
+        *reinterpret_cast<page_id_t *>(page_buf.data()) = IX_HASH_INIT_BUCKET_PAGE;
+        disk_manager_->write_page(fd, IX_HASH_INIT_DIR_PAGE, page_buf.data(), page_size);
+
+        disk_manager_->close_file(fd);
+    }
+
+    /**
+     * @brief 创建LSM索引文件：只有第0页的文件头，还没有有序段
+     */
+    void create_lsm_index(const std::string &filename, const std::vector<ColMeta>& index_cols, bool compressed = false) {
+        std::string ix_name = get_index_name(filename, index_cols);
+        disk_manager_->create_file(ix_name, compressed);
+        int fd = disk_manager_->open_file(ix_name);
+
+        IxLsmFileHdr fhdr;
+        for (auto &col : index_cols) {
+            fhdr.col_types_.push_back(col.type);
+            fhdr.col_lens_.push_back(col.len);
+            fhdr.col_tot_len_ += col.len;
+        }
+        if (fhdr.col_tot_len_ > IX_MAX_COL_LEN) {
+            disk_manager_->close_file(fd);
+            disk_manager_->destroy_file(ix_name);
+            throw InvalidColLengthError(fhdr.col_tot_len_);
+        }
+        fhdr.col_num_ = index_cols.size();
+        fhdr.update_tot_len();
+
+        int page_size = disk_manager_->get_page_size();
+        std::vector<char> page_buf(page_size);
+        fhdr.serialize(page_buf.data());
+        disk_manager_->write_page(fd, IX_FILE_HDR_PAGE, page_buf.data(), page_size);
+
+        disk_manager_->close_file(fd);
+    }
+
+    /* 创建只支持等值查找的索引文件，type为INDEX_HASH或INDEX_LSM */
+    void create_point_index(const std::string &filename, const std::vector<ColMeta>& index_cols, IndexType type,
+                            bool compressed = false) {
+        if (type == INDEX_LSM) {
+            create_lsm_index(filename, index_cols, compressed);
+        } else {
+            create_hash_index(filename, index_cols, compressed);
+        }
+    }
+
     void destroy_index(const std::string &filename, const std::vector<ColMeta>& index_cols) {
         std::string ix_name = get_index_name(filename, index_cols);
         disk_manager_->destroy_file(ix_name);
@@ -156,12 +272,53 @@ class IxManager {
         return std::make_unique<IxIndexHandle>(disk_manager_, buffer_pool_manager_, fd);
     }
 
-    void close_index(const IxIndexHandle *ih) {
+    std::unique_ptr<IxHashIndexHandle> open_hash_index(const std::string &filename, const std::vector<ColMeta>& index_cols) {
+        std::string ix_name = get_index_name(filename, index_cols);
+        int fd = disk_manager_->open_file(ix_name);
+        return std::make_unique<IxHashIndexHandle>(disk_manager_, buffer_pool_manager_, fd);
+    }
+
+    std::unique_ptr<IxPointIndexHandle> open_point_index(const std::string &filename,
+                                                         const std::vector<ColMeta>& index_cols, IndexType type) {
+        if (type != INDEX_LSM) {
+            return open_hash_index(filename, index_cols);
+        }
+        std::string ix_name = get_index_name(filename, index_cols);
+        int fd = disk_manager_->open_file(ix_name);
+        return std::make_unique<IxLsmIndexHandle>(disk_manager_, buffer_pool_manager_, fd);
+    }
+
+    void close_point_index(IxPointIndexHandle *hh) {
+        hh->close();
+        buffer_pool_manager_->evict_all_pages(hh->get_fd());
+        buffer_pool_manager_->reset_file_stats(hh->get_fd());
+        disk_manager_->close_file(hh->get_fd());
+    }
+
+    void close_index(IxIndexHandle *ih) {
+        ih->release_resident_pages();
         char* data = new char[ih->file_hdr_->tot_len_];
         ih->file_hdr_->serialize(data);
         disk_manager_->write_page(ih->fd_, IX_FILE_HDR_PAGE, data, ih->file_hdr_->tot_len_);
-        // 缓冲区的所有页刷到磁盘，注意这句话必须写在close_file前面
-        buffer_pool_manager_->flush_all_pages(ih->fd_);
+        // 缓冲区的所有页刷到磁盘并移出缓冲池，注意这句话必须写在close_file前面
+        buffer_pool_manager_->evict_all_pages(ih->fd_);
+        buffer_pool_manager_->reset_file_stats(ih->fd_);
         disk_manager_->close_file(ih->fd_);
     }
+
+    /* 检查点把仍在使用的索引的文件头和脏页写回磁盘，索引的修改不写日志 */
+    void flush_index(IxIndexHandle *ih) {
+        std::vector<char> data(ih->file_hdr_->tot_len_);
+        {
+            std::scoped_lock lock{ih->hdr_latch_};
+            ih->file_hdr_->serialize(data.data());
+        }
+        disk_manager_->write_page(ih->fd_, IX_FILE_HDR_PAGE, data.data(), ih->file_hdr_->tot_len_);
+        buffer_pool_manager_->flush_all_pages(ih->fd_, true);
+    }
+
+    void flush_point_index(IxPointIndexHandle *hh) {
+        hh->flush();
+        buffer_pool_manager_->flush_all_pages(hh->get_fd(), true);
+    }
 };
\ No newline at end of file
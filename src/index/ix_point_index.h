@@ -0,0 +1,40 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <vector>
+
+#include "defs.h"
+#include "transaction/transaction.h"
+
+/**
+ * @brief 只支持等值查找的索引（哈希索引、LSM索引）的公共接口
+ * 同一个key可以对应多个rid，key为记录中的原始格式；查询计划对它们都使用HashScan
+ */
+class IxPointIndexHandle {
+   public:
+    virtual ~IxPointIndexHandle() = default;
+
+    virtual int get_fd() const = 0;
+
+    /* 查找与key相等的所有键值对，找到的rid追加到result中，返回是否找到 */
+    virtual bool get_value(const char *key, std::vector<Rid> *result, Transaction *transaction) = 0;
+
+    virtual bool insert_entry(const char *key, const Rid &value, Transaction *transaction) = 0;
+
+    virtual bool delete_entry(const char *key, const Rid &value, Transaction *transaction) = 0;
+
+    /* 把只在内存中的内容写入索引文件的页面并更新文件头，检查点和关闭索引时由IxManager调用 */
+    virtual void flush() = 0;
+
+    /* 关闭索引之前调用，停止索引的后台工作并写回内存中的内容 */
+    virtual void close() { flush(); }
+};
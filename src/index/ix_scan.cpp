@@ -10,22 +10,35 @@ See the Mulan PSL v2 for more details. */
 
 #include "ix_scan.h"
 
+#include "common/query_stats.h"
+
 /**
- * @brief 
- * @todo 加上读锁（需要使用缓冲池得到page）
+ * @brief 移动到下一个键值对，读取叶子结点时加读latch；一次只持有一个叶子的latch，不会与B+树的写操作形成死锁
  */
 void IxScan::next() {
     assert(!is_end());
+    QueryStats::add(QueryStats::ROWS_SCANNED);
     IxNodeHandle *node = ih_->fetch_node(iid_.page_no);
+    node->page->r_latch();
     assert(node->is_leaf_page());
     assert(iid_.slot_no < node->get_size());
+    bool is_last_leaf = iid_.page_no == ih_->file_hdr_->last_leaf_;
+    page_id_t next_leaf = node->get_next_leaf();
+    // 遍历当前叶子时预读叶子链上的下一个结点，使其读取与当前叶子的遍历重叠
+    if (!is_last_leaf && next_leaf != prefetch_page_no_) {
+        bpm_->prefetch(ih_->fd_, next_leaf, 1);
+        prefetch_page_no_ = next_leaf;
+    }
     // increment slot no
     iid_.slot_no++;
-    if (iid_.page_no != ih_->file_hdr_->last_leaf_ && iid_.slot_no == node->get_size()) {
+    if (!is_last_leaf && iid_.slot_no == node->get_size()) {
         // go to next leaf
         iid_.slot_no = 0;
-        iid_.page_no = node->get_next_leaf();
+        iid_.page_no = next_leaf;
     }
+    node->page->r_unlatch();
+    bpm_->unpin_page(node->get_page_id(), false);
+    delete node;
 }
 
 Rid IxScan::rid() const {
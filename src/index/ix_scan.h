@@ -17,12 +17,12 @@ See the Mulan PSL v2 for more details. */
 
 // 用于遍历叶子结点
 // 用于直接遍历叶子结点，而不用findleafpage来得到叶子结点
-// TODO：对page遍历时，要加上读锁
 class IxScan : public RecScan {
     const IxIndexHandle *ih_;
     Iid iid_;  // 初始为lower（用于遍历的指针）
     Iid end_;  // 初始为upper
     BufferPoolManager *bpm_;
+    page_id_t prefetch_page_no_ = IX_NO_PAGE;  // 最近一次请求预读的叶子结点
 
    public:
     IxScan(const IxIndexHandle *ih, const Iid &lower, const Iid &upper, BufferPoolManager *bpm)
@@ -34,5 +34,8 @@ class IxScan : public RecScan {
 
     Rid rid() const override;
 
+    // 当前键值对的key，格式与记录中的字段相同
+    void key(char *out) const { ih_->get_key(iid_, out); }
+
     const Iid &iid() const { return iid_; }
 };
\ No newline at end of file
@@ -0,0 +1,305 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "cost_model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+namespace {
+
+// 没有统计信息时条件的选择率，和每个字段不同值个数的上限
+constexpr double DEFAULT_EQ_SEL = 0.005;
+constexpr double DEFAULT_RANGE_SEL = 1.0 / 3;
+constexpr double DEFAULT_NDV = 200;
+
+bool is_range_op(CompOp op) { return op == OP_LT || op == OP_LE || op == OP_GT || op == OP_GE; }
+
+// 常量按ANALYZE的规则换算成数值，与直方图的边界比较
+double value_key(const Value &val) {
+    if (val.type == TYPE_INT) return val.int_val;
+    if (val.type == TYPE_FLOAT) return val.float_val;
+    return stats_key(val.type, val.str_val.data(), static_cast<int>(val.str_val.size()));
+}
+
+// 字段值小于key的记录所占的比例，在key所在的直方图桶内按线性插值
+double fraction_below(const ColStats &col, double key) {
+    const auto &bounds = col.bounds;
+    if (bounds.size() < 2) {
+        if (col.max <= col.min) return key > col.min ? 1 : 0;
+        return std::clamp((key - col.min) / (col.max - col.min), 0.0, 1.0);
+    }
+    if (key <= bounds.front()) return 0;
+    size_t i = std::upper_bound(bounds.begin(), bounds.end(), key) - bounds.begin();
+    if (i == bounds.size()) return 1;
+    double lo = bounds[i - 1], hi = bounds[i];
+    double within = hi > lo ? (key - lo) / (hi - lo) : 0;
+    return (i - 1 + within) / (bounds.size() - 1);
+}
+
+void collect_tables(const std::shared_ptr<Plan> &plan, std::vector<std::string> &tables) {
+    if (auto scan = std::dynamic_pointer_cast<ScanPlan>(plan)) {
+        tables.push_back(scan->tab_name_);
+    } else if (auto join = std::dynamic_pointer_cast<JoinPlan>(plan)) {
+        collect_tables(join->left_, tables);
+        collect_tables(join->right_, tables);
+    }
+}
+
+}  // namespace
+
+bool CostModel::has_stats(const std::vector<std::string> &tables) {
+    return std::any_of(tables.begin(), tables.end(),
+                       [&](const std::string &tab_name) { return stats(tab_name).analyzed; });
+}
+
+const TabStats &CostModel::stats(const std::string &tab_name) {
+    auto it = stats_.find(tab_name);
+    if (it == stats_.end()) {
+        it = stats_.emplace(tab_name, sm_manager_->get_table_stats(tab_name)).first;
+    }
+    return it->second;
+}
+
+const ColStats *CostModel::col_stats(const TabCol &col) {
+    const TabStats &tab_stats = stats(col.tab_name);
+    if (!tab_stats.analyzed) return nullptr;
+    TabMeta &tab = sm_manager_->db_.get_table(col.tab_name);
+    for (size_t i = 0; i < tab.cols.size() && i < tab_stats.cols.size(); i++) {
+        if (tab.cols[i].name == col.col_name) return &tab_stats.cols[i];
+    }
+    return nullptr;
+}
+
+double CostModel::table_rows(const std::string &tab_name) {
+    const TabStats &tab_stats = stats(tab_name);
+    if (tab_stats.analyzed) return static_cast<double>(tab_stats.num_rows);
+    // 分区表的各分区格式相同，用第一个分区的文件头估计每页的记录数
+    const RmFileHdr &hdr = sm_manager_->get_table_handle(sm_manager_->partition_tables(tab_name)[0])->get_file_hdr();
+    int per_page = hdr.num_records_per_page > 0
+                       ? hdr.num_records_per_page
+                       : std::max(1, sm_manager_->db_.get_page_size() / std::max(1, hdr.record_size));
+    return table_pages(tab_name) * per_page;
+}
+
+double CostModel::table_pages(const std::string &tab_name) {
+    int num_pages = 0;
+    for (auto &name : sm_manager_->partition_tables(tab_name)) {
+        num_pages += std::max(1, sm_manager_->get_table_handle(name)->get_file_hdr().num_pages - 1);
+    }
+    return num_pages;
+}
+
+double CostModel::ndv(const TabCol &col, double rows) {
+    const ColStats *cs = col_stats(col);
+    double distinct = cs != nullptr ? cs->num_distinct : DEFAULT_NDV;
+    return std::max(1.0, std::min(distinct, rows));
+}
+
+double CostModel::selectivity(const Condition &cond) {
+    if (!cond.is_rhs_val) {
+        double distinct = std::max(ndv(cond.lhs_col, table_rows(cond.lhs_col.tab_name)),
+                                   ndv(cond.rhs_col, table_rows(cond.rhs_col.tab_name)));
+        if (cond.op == OP_EQ) return 1 / distinct;
+        if (cond.op == OP_NE) return 1 - 1 / distinct;
+        return DEFAULT_RANGE_SEL;
+    }
+    const ColStats *cs = col_stats(cond.lhs_col);
+    if (cs == nullptr || cond.rhs_val.is_param()) {
+        if (cond.op == OP_EQ) return DEFAULT_EQ_SEL;
+        if (cond.op == OP_NE) return 1 - DEFAULT_EQ_SEL;
+        return DEFAULT_RANGE_SEL;
+    }
+    double key = value_key(cond.rhs_val);
+    double eq = key < cs->min || key > cs->max ? 0 : 1 / std::max(1.0, cs->num_distinct);
+    double below = fraction_below(*cs, key);
+    double sel = 0;
+    switch (cond.op) {
+        case OP_EQ: sel = eq; break;
+        case OP_NE: sel = 1 - eq; break;
+        case OP_LT: sel = below; break;
+        case OP_LE: sel = below + eq; break;
+        case OP_GT: sel = 1 - below - eq; break;
+        case OP_GE: sel = 1 - below; break;
+    }
+    return std::clamp(sel, 0.0, 1.0);
+}
+
+double CostModel::index_scan_cost(const std::string &tab_name, double matched) {
+    // 内部结点通常都在缓冲池中，查找只算读取一个叶子；回表读取的不同页面数按Cardenas公式估计
+    double pages = table_pages(tab_name);
+    double fetched = pages * (1 - std::exp(-matched / pages));
+    return COST_RANDOM_PAGE + fetched * COST_RANDOM_PAGE + matched * 2 * COST_CPU_TUPLE;
+}
+
+bool CostModel::index_selectivity(const IndexMeta &index, const std::vector<Condition> &conds, double *sel) {
+    *sel = 1;
+    size_t prefix = 0;
+    for (; prefix < index.cols.size(); prefix++) {
+        auto eq = std::find_if(conds.begin(), conds.end(), [&](const Condition &cond) {
+            return cond.is_rhs_val && cond.op == OP_EQ && cond.lhs_col.col_name == index.cols[prefix].name;
+        });
+        if (eq == conds.end()) break;
+        *sel *= selectivity(*eq);
+    }
+    if (prefix == index.cols.size()) return true;
+    if (is_point_index(index.type)) return false;
+    // 与IndexScanExecutor相同，只有和字段类型相同的常量能作为范围的边界
+    bool has_range = false;
+    const ColMeta &range_col = index.cols[prefix];
+    for (auto &cond : conds) {
+        if (cond.is_rhs_val && is_range_op(cond.op) && cond.lhs_col.col_name == range_col.name &&
+            cond.rhs_val.type == range_col.type) {
+            *sel *= selectivity(cond);
+            has_range = true;
+        }
+    }
+    return prefix > 0 || has_range;
+}
+
+RelPlan CostModel::best_scan(const std::string &tab_name, const std::vector<Condition> &conds) {
+    double total = table_rows(tab_name);
+    double sel = 1;
+    for (auto &cond : conds) sel *= selectivity(cond);
+    double filter_cost = conds.size() * COST_CPU_OPERATOR;
+
+    RelPlan best;
+    best.rows = std::max(1.0, total * sel);
+    best.plan = std::make_shared<ScanPlan>(T_SeqScan, sm_manager_, tab_name, conds, std::vector<std::string>());
+    best.width = static_cast<double>(std::static_pointer_cast<ScanPlan>(best.plan)->len_);
+    best.cost = table_pages(tab_name) * COST_SEQ_PAGE + total * (COST_CPU_TUPLE + filter_cost);
+
+    TabMeta &tab = sm_manager_->db_.get_table(tab_name);
+    for (auto &index : tab.indexes) {
+        double index_sel;
+        if (!index_selectivity(index, conds, &index_sel)) continue;
+        double matched = total * index_sel;
+        double cost = index_scan_cost(tab_name, matched) + matched * filter_cost;
+        if (cost >= best.cost) continue;
+        std::vector<std::string> index_col_names;
+        for (auto &index_col : index.cols) index_col_names.push_back(index_col.name);
+        best.plan = std::make_shared<ScanPlan>(is_point_index(index.type) ? T_HashScan : T_IndexScan, sm_manager_,
+                                               tab_name, conds, std::move(index_col_names));
+        best.cost = cost;
+    }
+    return best;
+}
+
+bool CostModel::ordered_input(const RelPlan &rel, const TabCol &col, RelPlan *out) {
+    auto scan = std::dynamic_pointer_cast<ScanPlan>(rel.plan);
+    if (scan == nullptr || scan->tab_name_ != col.tab_name) return false;
+    // 分区表上的扫描逐个分区输出，没有顺序
+    if (sm_manager_->db_.get_table(scan->tab_name_).partition.is_partitioned()) return false;
+    if (scan->tag == T_IndexScan) {
+        if (scan->index_col_names_[0] != col.col_name) return false;
+        *out = rel;
+        return true;
+    }
+    if (scan->tag != T_SeqScan) return false;
+    TabMeta &tab = sm_manager_->db_.get_table(scan->tab_name_);
+    for (auto &index : tab.indexes) {
+        if (index.type != INDEX_BTREE || index.cols[0].name != col.col_name) continue;
+        // rel的计划可能已经是动态规划中其他连接的输入，不能直接修改
+        auto ordered = std::make_shared<ScanPlan>(*scan);
+        ordered->tag = T_IndexScan;
+        ordered->index_col_names_.clear();
+        for (auto &index_col : index.cols) ordered->index_col_names_.push_back(index_col.name);
+        double matched = table_rows(scan->tab_name_), index_sel;
+        if (index_selectivity(index, scan->conds_, &index_sel)) matched *= index_sel;
+        out->plan = std::move(ordered);
+        out->rows = rel.rows;
+        out->width = rel.width;
+        out->cost = index_scan_cost(scan->tab_name_, matched) + matched * scan->conds_.size() * COST_CPU_OPERATOR;
+        return true;
+    }
+    return false;
+}
+
+RelPlan CostModel::best_join(const RelPlan &left, const RelPlan &right, std::vector<Condition> conds) {
+    static const std::map<CompOp, CompOp> swap_op = {
+        {OP_EQ, OP_EQ}, {OP_NE, OP_NE}, {OP_LT, OP_GT}, {OP_GT, OP_LT}, {OP_LE, OP_GE}, {OP_GE, OP_LE},
+    };
+    std::vector<std::string> left_tables;
+    collect_tables(left.plan, left_tables);
+    double sel = 1;
+    for (auto &cond : conds) {
+        if (std::find(left_tables.begin(), left_tables.end(), cond.lhs_col.tab_name) == left_tables.end()) {
+            std::swap(cond.lhs_col, cond.rhs_col);
+            cond.op = swap_op.at(cond.op);
+        }
+        // 连接两侧的不同值个数不超过各自的元组个数
+        double distinct = std::max(ndv(cond.lhs_col, left.rows), ndv(cond.rhs_col, right.rows));
+        if (cond.op == OP_EQ) {
+            sel *= 1 / distinct;
+        } else if (cond.op == OP_NE) {
+            sel *= 1 - 1 / distinct;
+        } else {
+            sel *= DEFAULT_RANGE_SEL;
+        }
+    }
+
+    RelPlan best;
+    best.rows = std::max(1.0, left.rows * right.rows * sel);
+    best.width = left.width + right.width;
+    double output_cost = best.rows * COST_CPU_TUPLE;
+    double filter_cost = std::max<size_t>(conds.size(), 1) * COST_CPU_OPERATOR;
+    double left_bytes = left.rows * left.width, right_bytes = right.rows * right.width;
+
+    // 嵌套循环连接：内侧输入放不进缓存时，外侧每个块都要重新扫描一遍内侧输入
+    PlanTag tag = T_NestLoop;
+    best.cost = left.cost + right.cost + left.rows * right.rows * filter_cost + output_cost;
+    if (right_bytes > EXEC_NLJ_CACHE_SIZE) {
+        best.cost += right.cost * (std::ceil(left_bytes / EXEC_NLJ_BLOCK_SIZE) - 1);
+    }
+    std::shared_ptr<Plan> join_left = left.plan, join_right = right.plan;
+    size_t merge_cond = 0;
+
+    for (size_t i = 0; i < conds.size(); i++) {
+        auto &cond = conds[i];
+        if (cond.op != OP_EQ) continue;
+        auto lhs = sm_manager_->db_.get_table(cond.lhs_col.tab_name).get_col(cond.lhs_col.col_name);
+        auto rhs = sm_manager_->db_.get_table(cond.rhs_col.tab_name).get_col(cond.rhs_col.col_name);
+        if (lhs->type != rhs->type || lhs->len != rhs->len) continue;
+
+        // 哈希连接：较小的一侧构建哈希表，超过内存限制时两侧都要分区写出再读回
+        double hash_cost = left.cost + right.cost + (left.rows + right.rows) * COST_CPU_TUPLE +
+                           best.rows * filter_cost + output_cost;
+        if (std::min(left_bytes, right_bytes) > EXEC_HASH_JOIN_MEM_SIZE) {
+            hash_cost += 2 * (left_bytes + right_bytes) / sm_manager_->db_.get_page_size() * COST_SEQ_PAGE;
+        }
+        if (hash_cost < best.cost) {
+            tag = T_HashJoin;
+            best.cost = hash_cost;
+            join_left = left.plan;
+            join_right = right.plan;
+        }
+
+        // 归并连接：两侧都按连接字段有序输出，不需要额外的内存
+        RelPlan ordered_left, ordered_right;
+        if (ordered_input(left, cond.lhs_col, &ordered_left) && ordered_input(right, cond.rhs_col, &ordered_right)) {
+            double merge_cost = ordered_left.cost + ordered_right.cost + (left.rows + right.rows) * COST_CPU_TUPLE +
+                                best.rows * filter_cost + output_cost;
+            if (merge_cost < best.cost) {
+                tag = T_MergeJoin;
+                best.cost = merge_cost;
+                join_left = ordered_left.plan;
+                join_right = ordered_right.plan;
+                merge_cond = i;
+            }
+        }
+    }
+    if (tag == T_MergeJoin) {
+        // 归并条件放在第一个，MergeJoinExecutor按它推进两侧输入
+        std::swap(conds[0], conds[merge_cond]);
+    }
+    best.plan = std::make_shared<JoinPlan>(tag, std::move(join_left), std::move(join_right), std::move(conds));
+    return best;
+}
@@ -0,0 +1,87 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "analyze/analyze.h"
+#include "plan.h"
+#include "system/sm.h"
+
+/* 一个关系（一张表或者若干张表的连接）的计划，以及优化器对它的估计 */
+struct RelPlan {
+    std::shared_ptr<Plan> plan;
+    double rows = 0;    // 输出的元组个数
+    double width = 0;   // 每个元组的字节数
+    double cost = 0;    // 执行代价，单位为顺序读取一个页面的代价
+};
+
+/**
+ * @brief 基于ANALYZE收集的统计信息估计条件的选择率和关系的基数，为扫描和连接选择代价最小的算子。
+ * 代价由I/O（读取的页面数）和CPU（处理的元组数、计算的谓词数）两部分组成；
+ * 没有执行过ANALYZE的表按页面数估计记录数，条件使用默认的选择率
+ */
+class CostModel {
+   public:
+    explicit CostModel(SmManager *sm_manager) : sm_manager_(sm_manager) {}
+
+    /* tables中是否有表执行过ANALYZE，都没有时优化器沿用基于规则的计划 */
+    bool has_stats(const std::vector<std::string> &tables);
+
+    /* 条件的选择率，可以是单表条件或者两张表之间的连接条件 */
+    double selectivity(const Condition &cond);
+
+    /**
+     * @brief 索引扫描能利用的条件的选择率：索引最左边若干个字段上的等值条件，加上紧接着的一个字段上的范围条件，
+     * 哈希索引只能利用全部字段上的等值条件
+     * @return 索引用不上任何条件时返回false
+     */
+    bool index_selectivity(const IndexMeta &index, const std::vector<Condition> &conds, double *sel);
+
+    /* 在顺序扫描和表上各个可用的索引扫描中选择代价最小的扫描方式 */
+    RelPlan best_scan(const std::string &tab_name, const std::vector<Condition> &conds);
+
+    /**
+     * @brief 连接两个关系，在嵌套循环连接、哈希连接和归并连接中选择代价最小的算法
+     * @param conds 连接条件，左侧字段可以来自任意一个关系，生成计划时调整为左侧字段来自left
+     */
+    RelPlan best_join(const RelPlan &left, const RelPlan &right, std::vector<Condition> conds);
+
+   private:
+    const TabStats &stats(const std::string &tab_name);
+
+    /* 字段的统计信息，表没有执行过ANALYZE时返回nullptr */
+    const ColStats *col_stats(const TabCol &col);
+
+    /* 表的记录数，没有统计信息时按数据页面数和每页的记录数估计 */
+    double table_rows(const std::string &tab_name);
+
+    /* 表的数据页面数，不含文件头页 */
+    double table_pages(const std::string &tab_name);
+
+    /* 字段在rows个元组中的不同值个数 */
+    double ndv(const TabCol &col, double rows);
+
+    /* 通过索引读取matched条记录的代价：一次从根到叶子的查找加上回表读取的数据页面 */
+    double index_scan_cost(const std::string &tab_name, double matched);
+
+    /**
+     * @brief rel能否按col升序输出：以col为第一个字段的索引扫描，或者能改为这样的全索引扫描的顺序扫描
+     * @param out 按col有序输出的计划及其代价，需要改变扫描方式时是rel的计划的副本
+     */
+    bool ordered_input(const RelPlan &rel, const TabCol &col, RelPlan *out);
+
+    SmManager *sm_manager_;
+    std::unordered_map<std::string, TabStats> stats_;   // 本次优化用到的统计信息
+};
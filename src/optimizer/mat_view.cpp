@@ -0,0 +1,505 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "mat_view.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <set>
+
+#include "execution/index_writer.h"
+#include "optimizer.h"
+#include "portal.h"
+#include "system/server_log.h"
+
+namespace {
+
+/* 分区表的分区文件名为"表名$分区号"，写集合中的分区归到分区表上 */
+std::string base_table_of(const std::string &tab_name) { return tab_name.substr(0, tab_name.find('$')); }
+
+/* 依次取出算子输出的每个元组 */
+void for_each_tuple(AbstractExecutor *root, const std::function<void(const char *)> &fn) {
+    TupleBatch batch;
+    root->beginBatch();
+    while (root->NextBatch(batch)) {
+        for (size_t k = 0; k < batch.size(); k++) fn(batch.tuple(k));
+    }
+}
+
+/* 把查询输出的元组按视图的字段格式写入out */
+void to_view_row(const std::vector<ColMeta> &out_cols, const std::vector<ColMeta> &view_cols, const char *tuple,
+                 char *out) {
+    for (size_t i = 0; i < view_cols.size(); i++) {
+        memcpy(out + view_cols[i].offset, tuple + out_cols[i].offset, std::min(out_cols[i].len, view_cols[i].len));
+    }
+}
+
+/* 按字段取出分组键，0.0和-0.0相等，归一为0.0；键中有NaN时返回false，NaN与任何值都不相等，无法按等值条件重新计算 */
+bool group_key(const std::vector<ColMeta> &cols, const std::vector<size_t> &key_cols, const char *rec,
+               std::string *key) {
+    key->clear();
+    for (size_t i : key_cols) {
+        const ColMeta &col = cols[i];
+        if (col.type == TYPE_FLOAT) {
+            float v;
+            memcpy(&v, rec + col.offset, sizeof(v));
+            if (std::isnan(v)) return false;
+            if (v == 0.0f) v = 0.0f;
+            key->append(reinterpret_cast<const char *>(&v), sizeof(v));
+        } else {
+            key->append(rec + col.offset, col.len);
+        }
+    }
+    return true;
+}
+
+/* 分组列的值对应的常量 */
+std::shared_ptr<ast::Value> group_literal(const ColMeta &col, const char *val) {
+    if (col.type == TYPE_INT) {
+        int v;
+        memcpy(&v, val, sizeof(v));
+        return std::make_shared<ast::IntLit>(v);
+    }
+    if (col.type == TYPE_FLOAT) {
+        float v;
+        memcpy(&v, val, sizeof(v));
+        return std::make_shared<ast::FloatLit>(v);
+    }
+    return std::make_shared<ast::StringLit>(std::string(val, strnlen(val, col.len)));
+}
+
+/**
+ * @brief 复制计划树，其中基表base_tab上的扫描换成输出rows的ValuesPlan，归并连接换成哈希连接（Values的输出没有顺序）
+ * @param count 累加替换的扫描个数，基表在计划中出现多次时不能只替换一处
+ */
+std::shared_ptr<Plan> replace_scan(const std::shared_ptr<Plan> &plan, const std::string &base_tab,
+                                   const std::shared_ptr<const std::vector<std::string>> &rows, int *count) {
+    if (auto x = std::dynamic_pointer_cast<ScanPlan>(plan)) {
+        if (x->tab_name_ != base_tab) return plan;
+        (*count)++;
+        return std::make_shared<ValuesPlan>(x->tab_name_, x->cols_, x->conds_, rows);
+    } else if (auto x = std::dynamic_pointer_cast<JoinPlan>(plan)) {
+        auto join = std::make_shared<JoinPlan>(*x);
+        join->left_ = replace_scan(x->left_, base_tab, rows, count);
+        join->right_ = replace_scan(x->right_, base_tab, rows, count);
+        if (join->tag == T_MergeJoin) join->tag = T_HashJoin;
+        return join;
+    } else if (auto x = std::dynamic_pointer_cast<SemiJoinPlan>(plan)) {
+        auto join = std::make_shared<SemiJoinPlan>(*x);
+        join->left_ = replace_scan(x->left_, base_tab, rows, count);
+        join->right_ = replace_scan(x->right_, base_tab, rows, count);
+        return join;
+    } else if (auto x = std::dynamic_pointer_cast<ProjectionPlan>(plan)) {
+        auto proj = std::make_shared<ProjectionPlan>(*x);
+        proj->subplan_ = replace_scan(x->subplan_, base_tab, rows, count);
+        return proj;
+    } else if (auto x = std::dynamic_pointer_cast<SortPlan>(plan)) {
+        auto sort = std::make_shared<SortPlan>(*x);
+        sort->subplan_ = replace_scan(x->subplan_, base_tab, rows, count);
+        return sort;
+    } else if (auto x = std::dynamic_pointer_cast<AggregatePlan>(plan)) {
+        auto agg = std::make_shared<AggregatePlan>(*x);
+        agg->subplan_ = replace_scan(x->subplan_, base_tab, rows, count);
+        return agg;
+    } else if (auto x = std::dynamic_pointer_cast<LimitPlan>(plan)) {
+        auto limit = std::make_shared<LimitPlan>(*x);
+        limit->subplan_ = replace_scan(x->subplan_, base_tab, rows, count);
+        return limit;
+    }
+    return plan;
+}
+
+/* 计划树中的聚合节点 */
+std::shared_ptr<AggregatePlan> find_aggregate(const std::shared_ptr<Plan> &plan) {
+    if (auto x = std::dynamic_pointer_cast<AggregatePlan>(plan)) return x;
+    if (auto x = std::dynamic_pointer_cast<ProjectionPlan>(plan)) return find_aggregate(x->subplan_);
+    if (auto x = std::dynamic_pointer_cast<SortPlan>(plan)) return find_aggregate(x->subplan_);
+    if (auto x = std::dynamic_pointer_cast<LimitPlan>(plan)) return find_aggregate(x->subplan_);
+    return nullptr;
+}
+
+/* 视图的定义重新解析为select语句的语法树 */
+std::shared_ptr<ast::SelectStmt> parse_definition(const TabMeta &view) {
+    SqlParser parser;
+    std::shared_ptr<ast::TreeNode> tree;
+    // 定义末尾可能是注释，分号放在下一行
+    std::string sql = view.view.sql + "\n;";
+    if (!parser.parse(sql.c_str(), &tree)) {
+        throw InternalError("Cannot parse definition of materialized view " + view.name);
+    }
+    auto select = std::dynamic_pointer_cast<ast::SelectStmt>(tree);
+    if (select == nullptr) {
+        throw InternalError("Definition of materialized view " + view.name + " is not a select statement");
+    }
+    return select;
+}
+
+/* 视图的字段名：给出了字段列表时按列表命名，否则普通字段沿用字段名，聚合函数命名为"函数名_字段名" */
+std::vector<ColDef> view_col_defs(const ast::CreateMatView &stmt, const Query &query,
+                                  const std::vector<ColMeta> &out_cols) {
+    if (!stmt.col_names.empty() && stmt.col_names.size() != out_cols.size()) {
+        throw InvalidViewError("view has " + std::to_string(stmt.col_names.size()) + " column names but the query has " +
+                               std::to_string(out_cols.size()) + " columns");
+    }
+    static const char *agg_names[] = {"count", "sum", "min", "max", "avg"};
+    std::vector<ColDef> col_defs;
+    for (size_t i = 0; i < out_cols.size(); i++) {
+        ColDef def{.name = out_cols[i].name, .type = out_cols[i].type, .len = out_cols[i].len};
+        if (!stmt.col_names.empty()) {
+            def.name = stmt.col_names[i];
+        } else if (query.cols[i].tab_name.empty()) {
+            for (auto &agg : query.aggs) {
+                if (agg.name != query.cols[i].col_name) continue;
+                def.name = agg_names[agg.type];
+                if (agg.col.col_name != "*") def.name += "_" + agg.col.col_name;
+                break;
+            }
+        }
+        for (auto &prev : col_defs) {
+            if (prev.name == def.name) {
+                throw InvalidViewError("duplicate column name " + def.name + ", give the view a column list");
+            }
+        }
+        col_defs.push_back(std::move(def));
+    }
+    return col_defs;
+}
+
+}  // namespace
+
+MatViewManager::MatViewManager(SmManager *sm_manager, Analyze *analyze, Optimizer *optimizer)
+    : sm_manager_(sm_manager), analyze_(analyze), optimizer_(optimizer),
+      portal_(std::make_unique<Portal>(sm_manager)) {}
+
+MatViewManager::~MatViewManager() = default;
+
+/**
+ * @brief 执行CREATE MATERIALIZED VIEW或REFRESH MATERIALIZED VIEW
+ */
+void MatViewManager::execute(const MatViewPlan &plan, Context *context) {
+    Arena::Mark mark = context->arena_.mark();
+    if (plan.tag == T_CreateMatView) {
+        create(*plan.stmt_, context);
+    } else {
+        refresh(plan.tab_name_, context);
+    }
+    context->arena_.rewind(mark);
+}
+
+/**
+ * @description: 建立视图：执行定义中的查询得到视图的字段，建表之后写入查询结果。
+ *              视图的元数据不随事务回滚，写入的记录属于当前事务
+ */
+void MatViewManager::create(const ast::CreateMatView &stmt, Context *context) {
+    MatViewMeta meta;
+    meta.sql = stmt.definition;
+    if (meta.sql.empty()) {
+        throw InternalError("Materialized view " + stmt.tab_name + " has no definition");
+    }
+    std::string refresh = stmt.refresh;
+    std::transform(refresh.begin(), refresh.end(), refresh.begin(), ::toupper);
+    if (refresh.empty() || refresh == "IMMEDIATE") {
+        meta.refresh = REFRESH_IMMEDIATE;
+    } else if (refresh == "DEFERRED") {
+        meta.refresh = REFRESH_DEFERRED;
+    } else {
+        throw InvalidViewError("unknown refresh mode " + stmt.refresh);
+    }
+
+    std::shared_ptr<Query> query;
+    auto plan = plan_select(stmt.select, context, &query);
+    meta.base_tabs = query->referenced_tables();
+    check_no_pending_writes(meta, context);
+    auto root = make_root(plan, context);
+    sm_manager_->create_mat_view(stmt.tab_name, view_col_defs(stmt, *query, root->cols()), meta, context);
+    insert_rows(sm_manager_->db_.get_table(stmt.tab_name), root.get(), context);
+}
+
+/**
+ * @description: 刷新视图：删除视图中的全部记录，重新执行定义中的查询
+ */
+void MatViewManager::refresh(const std::string &view_name, Context *context) {
+    TabMeta view = sm_manager_->db_.get_table(view_name);
+    check_no_pending_writes(view.view, context);
+    recompute(view, context);
+}
+
+void MatViewManager::recompute(const TabMeta &view, Context *context) {
+    delete_rows(view, [](const char *) { return true; }, context);
+    auto root = make_root(plan_select(parse_definition(view), context), context);
+    insert_rows(view, root.get(), context);
+}
+
+/**
+ * @description: 事务提交之前维护IMMEDIATE视图。写集合中每条记录第一次被修改之前的内容是修改前的记录，
+ *              当前的内容是修改后的记录；维护失败时事务回滚，基表的修改和视图的修改一起撤销
+ */
+void MatViewManager::maintain(Context *context) {
+    Transaction *txn = context->txn_;
+    if (txn == nullptr || !txn->has_writes()) {
+        return;
+    }
+    std::vector<const TabMeta *> views;
+    for (auto &[name, tab] : sm_manager_->db_.get_tables()) {
+        if (tab.view.is_view() && tab.view.refresh == REFRESH_IMMEDIATE) views.push_back(&tab);
+    }
+    if (views.empty()) {
+        return;
+    }
+
+    // 同一条记录可能被修改多次，只取第一次修改之前的内容
+    std::map<std::string, TableDelta> deltas;
+    std::set<std::pair<std::string, Rid>> seen;
+    for (WriteRecord *write : *txn->get_write_set()) {
+        if (!seen.emplace(write->GetTableName(), write->GetRid()).second) continue;
+        std::string tab_name = base_table_of(write->GetTableName());
+        if (!sm_manager_->db_.is_table(tab_name) || sm_manager_->db_.get_table(tab_name).view.is_view()) continue;
+        TableDelta &delta = deltas[tab_name];
+        if (write->GetWriteType() != WType::INSERT_TUPLE) {
+            RmRecord &before = write->GetRecord();
+            delta.old_rows->emplace_back(before.data, before.size);
+        }
+        RmFileHandle *fh = sm_manager_->get_table_handle(write->GetTableName());
+        if (fh->is_record(write->GetRid())) {
+            auto after = fh->get_record(write->GetRid(), nullptr);
+            delta.new_rows->emplace_back(after->data, after->size);
+        }
+    }
+    if (deltas.empty()) {
+        return;
+    }
+
+    Arena::Mark mark = context->arena_.mark();
+    try {
+        for (auto *view : views) {
+            std::vector<std::string> changed;
+            for (auto &base : view->view.base_tabs) {
+                if (deltas.count(base)) changed.push_back(base);
+            }
+            if (changed.empty()) continue;
+            if (changed.size() > 1 || !maintain_incremental(*view, changed[0], deltas[changed[0]], context)) {
+                recompute(*view, context);
+            }
+        }
+    } catch (RMDBError &e) {
+        ServerLog::debug("maintaining materialized views failed: ", e.what());
+        context->arena_.rewind(mark);
+        throw TransactionAbortException(txn->get_transaction_id(), AbortReason::VIEW_MAINTENANCE_FAILURE);
+    }
+    context->arena_.rewind(mark);
+}
+
+/**
+ * @description: 只有基表base_tab发生变化时增量维护视图，基表上的扫描换成修改前后的记录，其它基表照常扫描
+ * @return {bool} 视图不能增量维护时返回false，由调用者重新计算
+ */
+bool MatViewManager::maintain_incremental(const TabMeta &view, const std::string &base_tab, const TableDelta &delta,
+                                          Context *context) {
+    auto select = parse_definition(view);
+    std::shared_ptr<Query> query;
+    auto plan = std::static_pointer_cast<DMLPlan>(plan_select(select, context, &query));
+    if (!query->sublinks.empty()) {
+        return false;
+    }
+
+    if (query->aggs.empty() && query->group_cols.empty()) {
+        // 不带聚合的视图：修改前的记录对应的输出各删除一行，再插入修改后的记录对应的输出
+        int count = 0;
+        auto old_plan = replace_scan(plan->subplan_, base_tab, delta.old_rows, &count);
+        auto new_plan = replace_scan(plan->subplan_, base_tab, delta.new_rows, &count);
+        if (count != 2) {
+            return false;
+        }
+        std::multiset<std::string> old_out;
+        auto old_root = portal_->convert_plan_executor(old_plan, context);
+        std::string row(sm_manager_->get_table_handle(view.name)->get_file_hdr().record_size, '\0');
+        for_each_tuple(old_root.get(), [&](const char *tuple) {
+            to_view_row(old_root->cols(), view.cols, tuple, row.data());
+            old_out.insert(row);
+        });
+        if (!old_out.empty()) {
+            size_t len = row.size();
+            delete_rows(view, [&](const char *rec) {
+                auto pos = old_out.find(std::string(rec, len));
+                if (pos == old_out.end()) return false;
+                old_out.erase(pos);
+                return true;
+            }, context);
+        }
+        auto new_root = portal_->convert_plan_executor(new_plan, context);
+        insert_rows(view, new_root.get(), context);
+        return true;
+    }
+
+    // 带聚合的视图：找出修改前后的记录落在哪些分组，删除这些分组后按分组重新计算。分组列都要出现在视图中
+    if (query->group_cols.empty()) {
+        return false;
+    }
+    std::vector<size_t> view_keys;
+    for (auto &group_col : query->group_cols) {
+        auto pos = std::find_if(query->cols.begin(), query->cols.end(), [&](const TabCol &col) {
+            return col.tab_name == group_col.tab_name && col.col_name == group_col.col_name;
+        });
+        if (pos == query->cols.end()) return false;
+        view_keys.push_back(pos - query->cols.begin());
+    }
+    auto agg = find_aggregate(plan->subplan_);
+    if (agg == nullptr) {
+        return false;
+    }
+    int count = 0;
+    std::shared_ptr<Plan> cores[] = {replace_scan(agg->subplan_, base_tab, delta.old_rows, &count),
+                                     replace_scan(agg->subplan_, base_tab, delta.new_rows, &count)};
+    if (count != 2) {
+        return false;
+    }
+    std::map<std::string, std::vector<std::shared_ptr<ast::Value>>> groups;
+    std::vector<ColMeta> key_cols;
+    for (auto &core : cores) {
+        auto root = portal_->convert_plan_executor(core, context);
+        std::vector<size_t> core_keys;
+        for (auto &group_col : query->group_cols) {
+            core_keys.push_back(root->get_col(root->cols(), group_col) - root->cols().begin());
+        }
+        bool ok = true;
+        std::string key;
+        for_each_tuple(root.get(), [&](const char *tuple) {
+            if (!ok || !group_key(root->cols(), core_keys, tuple, &key)) {
+                ok = false;
+                return;
+            }
+            if (groups.count(key)) return;
+            std::vector<std::shared_ptr<ast::Value>> vals;
+            for (size_t i : core_keys) vals.push_back(group_literal(root->cols()[i], tuple + root->cols()[i].offset));
+            groups.emplace(key, std::move(vals));
+        });
+        if (!ok || groups.size() > MATVIEW_MAX_INCREMENTAL_GROUPS) {
+            return false;
+        }
+    }
+    if (groups.empty()) {
+        return true;
+    }
+
+    delete_rows(view, [&](const char *rec) {
+        std::string key;
+        return group_key(view.cols, view_keys, rec, &key) && groups.count(key) > 0;
+    }, context);
+    for (auto &[key, vals] : groups) {
+        auto group_select = std::make_shared<ast::SelectStmt>(*select);
+        for (size_t i = 0; i < vals.size(); i++) {
+            auto &group_col = query->group_cols[i];
+            group_select->conds.push_back(std::make_shared<ast::BinaryExpr>(
+                std::make_shared<ast::Col>(group_col.tab_name, group_col.col_name), ast::SV_OP_EQ, vals[i]));
+        }
+        auto root = make_root(plan_select(group_select, context), context);
+        insert_rows(view, root.get(), context);
+    }
+    return true;
+}
+
+/* 分析并优化select语句，返回select的计划 */
+std::shared_ptr<Plan> MatViewManager::plan_select(std::shared_ptr<ast::SelectStmt> select, Context *context,
+                                                  std::shared_ptr<Query> *query) {
+    std::shared_ptr<Query> q = analyze_->do_analyze(select);
+    auto plan = optimizer_->plan_query(q, context);
+    if (query != nullptr) *query = std::move(q);
+    return plan;
+}
+
+/* select计划的算子树，输出投影之后的元组 */
+std::unique_ptr<AbstractExecutor> MatViewManager::make_root(const std::shared_ptr<Plan> &plan, Context *context) {
+    auto dml = std::dynamic_pointer_cast<DMLPlan>(plan);
+    if (dml == nullptr || dml->tag != T_select) {
+        throw InternalError("Unexpected plan for materialized view");
+    }
+    return portal_->convert_plan_executor(dml->subplan_, context);
+}
+
+/**
+ * @description: IMMEDIATE视图从基表读出的是已提交的记录和当前事务的修改，而当前事务的修改提交时还会再维护一次，
+ *              基表上有未提交修改时建立或刷新会重复计入这些修改
+ */
+void MatViewManager::check_no_pending_writes(const MatViewMeta &view, Context *context) {
+    if (view.refresh != REFRESH_IMMEDIATE || context->txn_ == nullptr || !context->txn_->has_writes()) {
+        return;
+    }
+    for (WriteRecord *write : *context->txn_->get_write_set()) {
+        std::string tab_name = base_table_of(write->GetTableName());
+        if (std::find(view.base_tabs.begin(), view.base_tabs.end(), tab_name) != view.base_tabs.end()) {
+            throw TableBusyError(tab_name);
+        }
+    }
+}
+
+/* 视图上加表级X锁，视图的内容由当前事务整体改写 */
+static void lock_view(RmFileHandle *fh, Context *context) {
+    if (context->txn_ != nullptr && context->lock_mgr_ != nullptr) {
+        context->lock_mgr_->lock_exclusive_on_table(context->txn_, fh->GetFd());
+    }
+}
+
+/**
+ * @description: 删除视图中满足pred的记录，先扫描出全部记录再删除
+ * @return {size_t} 删除的记录数
+ */
+size_t MatViewManager::delete_rows(const TabMeta &view, const std::function<bool(const char *)> &pred,
+                                   Context *context) {
+    RmFileHandle *fh = sm_manager_->get_table_handle(view.name);
+    auto dml_lock = fh->lock_dml();
+    lock_view(fh, context);
+    std::vector<std::pair<Rid, std::string>> victims;
+    int record_size = fh->get_file_hdr().record_size;
+    for (RmScan scan(fh, true); !scan.is_end(); scan.next_batch()) {
+        for (auto &slot : scan.batch()) {
+            if (pred(slot.data)) victims.emplace_back(slot.rid, std::string(slot.data, record_size));
+        }
+    }
+    const TabMeta &tab = sm_manager_->db_.get_table(view.name);
+    IndexWriter index_writer(sm_manager_, view.name, tab.indexes, context->txn_);
+    try {
+        for (auto &[rid, rec] : victims) {
+            fh->claim_record(rid, context);
+            index_writer.remove(rec.data(), rid);
+            fh->delete_record(rid, context);
+            index_writer.end_row();
+        }
+    } catch (...) {
+        index_writer.flush();
+        throw;
+    }
+    index_writer.flush();
+    return victims.size();
+}
+
+/* 把查询输出的元组写入视图 */
+void MatViewManager::insert_rows(const TabMeta &view, AbstractExecutor *root, Context *context) {
+    RmFileHandle *fh = sm_manager_->get_table_handle(view.name);
+    auto dml_lock = fh->lock_dml();
+    lock_view(fh, context);
+    const TabMeta &tab = sm_manager_->db_.get_table(view.name);
+    IndexWriter index_writer(sm_manager_, view.name, tab.indexes, context->txn_);
+    std::vector<char> row(fh->get_file_hdr().record_size);
+    try {
+        for_each_tuple(root, [&](const char *tuple) {
+            std::fill(row.begin(), row.end(), 0);
+            to_view_row(root->cols(), tab.cols, tuple, row.data());
+            Rid rid = fh->insert_record(row.data(), context);
+            index_writer.insert(row.data(), rid);
+            index_writer.end_row();
+        });
+    } catch (...) {
+        index_writer.flush();
+        throw;
+    }
+    index_writer.flush();
+}
@@ -0,0 +1,75 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "analyze/analyze.h"
+#include "plan.h"
+
+class Optimizer;
+class Portal;
+class AbstractExecutor;
+
+/**
+ * @brief 物化视图的建立、刷新和维护
+ * @description 物化视图是一张普通的表，表的元数据中保存视图的定义（SELECT语句的文本）和刷新方式。
+ * CREATE和REFRESH执行定义中的查询并把结果写入视图；IMMEDIATE视图在修改基表的事务提交之前由maintain维护：
+ * 从事务的写集合中取出各基表修改前后的记录，只有一张基表发生变化的视图按这些记录增量修改，
+ * 不带聚合的视图删除旧记录对应的输出、插入新记录对应的输出；带GROUP BY的视图只重新计算涉及到的分组。
+ * 其它情况（子查询、多张基表同时变化、涉及的分组过多等）重新计算整个视图。视图的修改与基表的修改属于同一个事务
+ */
+class MatViewManager {
+   public:
+    MatViewManager(SmManager *sm_manager, Analyze *analyze, Optimizer *optimizer);
+
+    ~MatViewManager();
+
+    void execute(const MatViewPlan &plan, Context *context);
+
+    void maintain(Context *context);
+
+   private:
+    // 一张基表在事务中修改前和修改后的记录，按基表的记录格式存放
+    struct TableDelta {
+        std::shared_ptr<std::vector<std::string>> old_rows = std::make_shared<std::vector<std::string>>();
+        std::shared_ptr<std::vector<std::string>> new_rows = std::make_shared<std::vector<std::string>>();
+    };
+
+    void create(const ast::CreateMatView &stmt, Context *context);
+
+    void refresh(const std::string &view_name, Context *context);
+
+    void recompute(const TabMeta &view, Context *context);
+
+    bool maintain_incremental(const TabMeta &view, const std::string &base_tab, const TableDelta &delta,
+                              Context *context);
+
+    std::shared_ptr<Plan> plan_select(std::shared_ptr<ast::SelectStmt> select, Context *context,
+                                      std::shared_ptr<Query> *query = nullptr);
+
+    std::unique_ptr<AbstractExecutor> make_root(const std::shared_ptr<Plan> &plan, Context *context);
+
+    void check_no_pending_writes(const MatViewMeta &view, Context *context);
+
+    size_t delete_rows(const TabMeta &view, const std::function<bool(const char *)> &pred, Context *context);
+
+    void insert_rows(const TabMeta &view, AbstractExecutor *root, Context *context);
+
+    SmManager *sm_manager_;
+    Analyze *analyze_;
+    Optimizer *optimizer_;
+    std::unique_ptr<Portal> portal_;    // 把视图定义的计划转换成算子树
+};
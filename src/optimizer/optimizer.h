@@ -20,6 +20,7 @@ See the Mulan PSL v2 for more details. */
 #include "transaction/transaction_manager.h"
 #include "planner.h"
 #include "plan.h"
+#include "plan_cache.h"
 
 class Optimizer {
    private:
@@ -38,9 +39,30 @@ class Optimizer {
         } else if (auto x = std::dynamic_pointer_cast<ast::ShowTables>(query->parse)) {
             // show tables;
             return std::make_shared<OtherPlan>(T_ShowTable, std::string());
+        } else if (auto x = std::dynamic_pointer_cast<ast::ShowBufferStats>(query->parse)) {
+            // show buffer stats;
+            return std::make_shared<OtherPlan>(T_ShowBufferStats, std::string());
+        } else if (auto x = std::dynamic_pointer_cast<ast::ShowMetrics>(query->parse)) {
+            // show metrics;
+            return std::make_shared<OtherPlan>(T_ShowMetrics, std::string());
+        } else if (auto x = std::dynamic_pointer_cast<ast::LoadData>(query->parse)) {
+            // load data 'file' into table;
+            return std::make_shared<LoadDataPlan>(x->file_name, x->tab_name);
         } else if (auto x = std::dynamic_pointer_cast<ast::DescTable>(query->parse)) {
             // desc table;
             return std::make_shared<OtherPlan>(T_DescTable, x->tab_name);
+        } else if (auto x = std::dynamic_pointer_cast<ast::VacuumTable>(query->parse)) {
+            // vacuum table;
+            return std::make_shared<OtherPlan>(T_VacuumTable, x->tab_name);
+        } else if (auto x = std::dynamic_pointer_cast<ast::AnalyzeTable>(query->parse)) {
+            // analyze [table];
+            return std::make_shared<OtherPlan>(T_AnalyzeTable, x->tab_name);
+        } else if (auto x = std::dynamic_pointer_cast<ast::CreateMatView>(query->parse)) {
+            // create materialized view name as select; 执行时再为定义生成计划
+            return std::make_shared<MatViewPlan>(T_CreateMatView, x->tab_name, x);
+        } else if (auto x = std::dynamic_pointer_cast<ast::RefreshMatView>(query->parse)) {
+            // refresh materialized view name;
+            return std::make_shared<MatViewPlan>(T_RefreshMatView, x->tab_name);
         } else if (auto x = std::dynamic_pointer_cast<ast::TxnBegin>(query->parse)) {
             // begin;
             return std::make_shared<OtherPlan>(T_Transaction_begin, std::string());
@@ -53,9 +75,32 @@ class Optimizer {
         } else if (auto x = std::dynamic_pointer_cast<ast::TxnRollback>(query->parse)) {
             // rollback;
             return std::make_shared<OtherPlan>(T_Transaction_rollback, std::string());
+        } else if (auto x = std::dynamic_pointer_cast<ast::PrepareStmt>(query->parse)) {
+            // prepare name as stmt; 计划缓存在连接的预编译语句中
+            plan_cache(context)->prepare(x->name, x->stmt, context);
+            return std::make_shared<OtherPlan>(T_Prepare, std::string());
+        } else if (auto x = std::dynamic_pointer_cast<ast::ExecuteStmt>(query->parse)) {
+            // execute name (params); 直接使用绑定了参数的缓存计划
+            return plan_cache(context)->bind(x->name, query->values, context);
+        } else if (auto x = std::dynamic_pointer_cast<ast::DeallocateStmt>(query->parse)) {
+            // deallocate name;
+            plan_cache(context)->deallocate(x->name);
+            return std::make_shared<OtherPlan>(T_Deallocate, std::string());
+        } else if (auto x = std::dynamic_pointer_cast<ast::ExplainStmt>(query->parse)) {
+            // explain [analyze] stmt;
+            query->parse = x->stmt;
+            return std::make_shared<ExplainPlan>(plan_query(query, context), x->analyze);
         } else {
             return planner_->do_planner(query, context);
         }
     }
 
+   private:
+    static PlanCache *plan_cache(Context *context) {
+        if (context->plan_cache_ == nullptr) {
+            throw InternalError("Prepared statements require a client session");
+        }
+        return context->plan_cache_;
+    }
+
 };
@@ -23,12 +23,17 @@ typedef enum PlanTag{
     T_Invalid = 1,
     T_Help,
     T_ShowTable,
+    T_ShowBufferStats,
+    T_ShowMetrics,
     T_DescTable,
     T_CreateTable,
     T_DropTable,
     T_CreateIndex,
     T_DropIndex,
     T_Insert,
+    T_LoadData,
+    T_VacuumTable,
+    T_AnalyzeTable,
     T_Update,
     T_Delete,
     T_select,
@@ -36,11 +41,27 @@ typedef enum PlanTag{
     T_Transaction_commit,
     T_Transaction_abort,
     T_Transaction_rollback,
+    T_Prepare,
+    T_Deallocate,
+    T_CreateMatView,
+    T_RefreshMatView,
     T_SeqScan,
+    T_ParallelSeqScan,
     T_IndexScan,
+    T_IndexOnlyScan,
+    T_HashScan,
+    T_Values,
     T_NestLoop,
+    T_HashJoin,
+    T_MergeJoin,
+    T_SemiJoin,
+    T_AntiJoin,
+    T_HashAggregate,
+    T_StreamAggregate,
     T_Sort,
-    T_Projection
+    T_Limit,
+    T_Projection,
+    T_Explain
 } PlanTag;
 
 // 查询执行计划
@@ -77,6 +98,29 @@ class ScanPlan : public Plan
     
 };
 
+/**
+ * @brief 一组给定的元组，视图维护时代替基表上的扫描，输出基表修改前后的记录中满足扫描条件的元组。
+ * rows_中每条记录按cols_的格式存放，同一组元组可以被多个计划共享
+ */
+class ValuesPlan : public Plan
+{
+    public:
+        ValuesPlan(std::string tab_name, std::vector<ColMeta> cols, std::vector<Condition> conds,
+                   std::shared_ptr<const std::vector<std::string>> rows)
+        {
+            Plan::tag = T_Values;
+            tab_name_ = std::move(tab_name);
+            cols_ = std::move(cols);
+            conds_ = std::move(conds);
+            rows_ = std::move(rows);
+        }
+        ~ValuesPlan(){}
+        std::string tab_name_;
+        std::vector<ColMeta> cols_;
+        std::vector<Condition> conds_;
+        std::shared_ptr<const std::vector<std::string>> rows_;
+};
+
 class JoinPlan : public Plan
 {
     public:
@@ -100,6 +144,28 @@ class JoinPlan : public Plan
         
 };
 
+/**
+ * @brief where条件中不相关子查询对应的半连接(T_SemiJoin)和反连接(T_AntiJoin)：
+ * 输出left_中在子查询right_的结果里有(半连接)或没有(反连接)匹配元组的元组，字段与left_相同。
+ * IN的conds_为左侧字段等于子查询的输出列，EXISTS没有条件，只判断子查询是否有结果。
+ * right_是子查询完整的计划，不属于外层查询的连接树，处理连接树的优化不会进入right_
+ */
+class SemiJoinPlan : public Plan
+{
+    public:
+        SemiJoinPlan(PlanTag tag, std::shared_ptr<Plan> left, std::shared_ptr<Plan> right, std::vector<Condition> conds)
+        {
+            Plan::tag = tag;
+            left_ = std::move(left);
+            right_ = std::move(right);
+            conds_ = std::move(conds);
+        }
+        ~SemiJoinPlan(){}
+        std::shared_ptr<Plan> left_;
+        std::shared_ptr<Plan> right_;
+        std::vector<Condition> conds_;
+};
+
 class ProjectionPlan : public Plan
 {
     public:
@@ -118,20 +184,54 @@ class ProjectionPlan : public Plan
 class SortPlan : public Plan
 {
     public:
-        SortPlan(PlanTag tag, std::shared_ptr<Plan> subplan, TabCol sel_col, bool is_desc)
+        SortPlan(PlanTag tag, std::shared_ptr<Plan> subplan, std::vector<TabCol> sel_cols, std::vector<bool> is_desc,
+                 int limit = -1)
         {
             Plan::tag = tag;
             subplan_ = std::move(subplan);
-            sel_col_ = sel_col;
-            is_desc_ = is_desc;
+            sel_cols_ = std::move(sel_cols);
+            is_desc_ = std::move(is_desc);
+            limit_ = limit;
         }
         ~SortPlan(){}
         std::shared_ptr<Plan> subplan_;
-        TabCol sel_col_;
-        bool is_desc_;
+        std::vector<TabCol> sel_cols_;      // 排序键，按优先级排列
+        std::vector<bool> is_desc_;         // 每个排序键是否降序
+        int limit_;                         // 只需要排序后的前limit_个元组，-1表示全部
         
 };
 
+class AggregatePlan : public Plan
+{
+    public:
+        AggregatePlan(PlanTag tag, std::shared_ptr<Plan> subplan, std::vector<TabCol> group_cols,
+                      std::vector<AggItem> aggs)
+        {
+            Plan::tag = tag;
+            subplan_ = std::move(subplan);
+            group_cols_ = std::move(group_cols);
+            aggs_ = std::move(aggs);
+        }
+        ~AggregatePlan(){}
+        std::shared_ptr<Plan> subplan_;
+        std::vector<TabCol> group_cols_;    // 分组列
+        std::vector<AggItem> aggs_;         // 聚合函数，输出在分组列之后
+};
+
+class LimitPlan : public Plan
+{
+    public:
+        LimitPlan(PlanTag tag, std::shared_ptr<Plan> subplan, int limit)
+        {
+            Plan::tag = tag;
+            subplan_ = std::move(subplan);
+            limit_ = limit;
+        }
+        ~LimitPlan(){}
+        std::shared_ptr<Plan> subplan_;
+        int limit_;                         // 最多输出的元组个数
+};
+
 // dml语句，包括insert; delete; update; select语句　
 class DMLPlan : public Plan
 {
@@ -159,20 +259,32 @@ class DMLPlan : public Plan
 class DDLPlan : public Plan
 {
     public:
-        DDLPlan(PlanTag tag, std::string tab_name, std::vector<std::string> col_names, std::vector<ColDef> cols)
+        DDLPlan(PlanTag tag, std::string tab_name, std::vector<std::string> col_names, std::vector<ColDef> cols,
+                TabStorage storage = STORAGE_ROW, IndexType index_type = INDEX_BTREE, bool concurrently = false,
+                PartitionDef partition = PartitionDef(), TabCompression compression = COMPRESSION_NONE)
         {
             Plan::tag = tag;
             tab_name_ = std::move(tab_name);
             cols_ = std::move(cols);
             tab_col_names_ = std::move(col_names);
+            storage_ = storage;
+            index_type_ = index_type;
+            concurrently_ = concurrently;
+            partition_ = std::move(partition);
+            compression_ = compression;
         }
         ~DDLPlan(){}
         std::string tab_name_;
         std::vector<std::string> tab_col_names_;
         std::vector<ColDef> cols_;
+        TabStorage storage_;    // create table语句指定的存储方式
+        IndexType index_type_;  // create index语句指定的索引类型
+        bool concurrently_;     // create index concurrently，在线建索引
+        PartitionDef partition_;    // create table语句指定的分区方式
+        TabCompression compression_;    // create table语句指定的页面压缩方式
 };
 
-// help; show tables; desc tables; begin; abort; commit; rollback语句对应的plan
+// help; show tables; desc tables; begin; abort; commit; rollback; prepare; deallocate语句对应的plan
 class OtherPlan : public Plan
 {
     public:
@@ -185,6 +297,46 @@ class OtherPlan : public Plan
         std::string tab_name_;
 };
 
+// explain [analyze]语句对应的plan，subplan_为被解释的语句的计划
+class ExplainPlan : public Plan
+{
+    public:
+        ExplainPlan(std::shared_ptr<Plan> subplan, bool analyze)
+        {
+            Plan::tag = T_Explain;
+            subplan_ = std::move(subplan);
+            analyze_ = analyze;
+        }
+        ~ExplainPlan(){}
+        std::shared_ptr<Plan> subplan_;
+        bool analyze_;      // 是否执行语句并输出每个算子的执行统计
+};
+
+// load data语句对应的plan
+class LoadDataPlan : public OtherPlan
+{
+    public:
+        LoadDataPlan(std::string file_name, std::string tab_name) : OtherPlan(T_LoadData, std::move(tab_name))
+        {
+            file_name_ = std::move(file_name);
+        }
+        ~LoadDataPlan(){}
+        std::string file_name_;
+};
+
+// create materialized view; refresh materialized view语句对应的plan，由MatViewManager执行
+class MatViewPlan : public OtherPlan
+{
+    public:
+        MatViewPlan(PlanTag tag, std::string tab_name, std::shared_ptr<ast::CreateMatView> stmt = nullptr)
+            : OtherPlan(tag, std::move(tab_name))
+        {
+            stmt_ = std::move(stmt);
+        }
+        ~MatViewPlan(){}
+        std::shared_ptr<ast::CreateMatView> stmt_;  // create语句的语法树，refresh语句为空
+};
+
 class plannerInfo{
     public:
     std::shared_ptr<ast::SelectStmt> parse;
@@ -0,0 +1,132 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "plan_cache.h"
+
+#include "optimizer.h"
+
+/**
+ * @brief PREPARE name AS stmt：分析语句并生成执行计划，同一连接中的名字不能重复
+ */
+void PlanCache::prepare(const std::string &name, std::shared_ptr<ast::TreeNode> stmt, Context *context) {
+    if (stmts_.count(name)) {
+        throw PreparedStmtExistsError(name);
+    }
+    PreparedStmt prepared;
+    prepared.sql = context->sql_ != nullptr ? context->sql_ : "";
+    prepared.stmt = std::move(stmt);
+    build(&prepared, context);
+    stmts_.emplace(name, std::move(prepared));
+}
+
+/**
+ * @brief EXECUTE name (params)：把参数绑定到缓存的执行计划中
+ *
+ * @return 绑定了参数的执行计划，下一次bind之前有效
+ */
+std::shared_ptr<Plan> PlanCache::bind(const std::string &name, const std::vector<Value> &params, Context *context) {
+    auto it = stmts_.find(name);
+    if (it == stmts_.end()) {
+        throw PreparedStmtNotFoundError(name);
+    }
+    PreparedStmt &prepared = it->second;
+    if (static_cast<int>(params.size()) != prepared.num_params) {
+        throw ParamCountError(prepared.num_params, static_cast<int>(params.size()));
+    }
+    if (prepared.catalog_version != sm_manager_->catalog_version_.load()) {
+        build(&prepared, context);
+    }
+    for (auto &slot : prepared.slots) {
+        Value val = params[slot.idx];
+        if (slot.coerce) {
+            if (!is_compatible_type(slot.type, val.type)) {
+                throw IncompatibleTypeError(coltype2str(slot.type), coltype2str(val.type));
+            }
+            val.init_raw(slot.len);
+        }
+        val.param_idx = slot.idx;
+        *slot.val = std::move(val);
+    }
+    return prepared.plan;
+}
+
+void PlanCache::deallocate(const std::string &name) {
+    if (stmts_.erase(name) == 0) {
+        throw PreparedStmtNotFoundError(name);
+    }
+}
+
+void PlanCache::build(PreparedStmt *prepared, Context *context) {
+    uint64_t version = sm_manager_->catalog_version_.load();
+    std::shared_ptr<Query> query = analyze_->do_analyze(prepared->stmt, true);
+    int num_params = query->num_params;
+    std::shared_ptr<Plan> plan = optimizer_->plan_query(query, context);
+    std::vector<ParamSlot> slots;
+    collect_params(plan, slots);
+    prepared->plan = std::move(plan);
+    prepared->slots = std::move(slots);
+    prepared->num_params = num_params;
+    prepared->catalog_version = version;
+}
+
+const std::string &PlanCache::source(const std::string &name) const {
+    auto it = stmts_.find(name);
+    if (it == stmts_.end()) {
+        throw PreparedStmtNotFoundError(name);
+    }
+    return it->second.sql;
+}
+
+/**
+ * @brief 收集计划中所有参数占位符的位置，同一个参数可能被复制到扫描和DML节点的多个条件中
+ */
+void PlanCache::collect_params(const std::shared_ptr<Plan> &plan, std::vector<ParamSlot> &slots) {
+    if (auto x = std::dynamic_pointer_cast<DMLPlan>(plan)) {
+        collect_cond_params(x->conds_, slots);
+        if (!x->set_clauses_.empty()) {
+            TabMeta &tab = sm_manager_->db_.get_table(x->tab_name_);
+            for (auto &set_clause : x->set_clauses_) {
+                if (!set_clause.rhs.is_param()) continue;
+                auto col = tab.get_col(set_clause.lhs.col_name);
+                slots.push_back({&set_clause.rhs, set_clause.rhs.param_idx, true, col->type, col->len});
+            }
+        }
+        for (auto &val : x->values_) {
+            if (val.is_param()) slots.push_back({&val, val.param_idx, false, val.type, 0});
+        }
+        collect_params(x->subplan_, slots);
+    } else if (auto x = std::dynamic_pointer_cast<ScanPlan>(plan)) {
+        collect_cond_params(x->conds_, slots);
+        collect_cond_params(x->fed_conds_, slots);
+    } else if (auto x = std::dynamic_pointer_cast<JoinPlan>(plan)) {
+        collect_cond_params(x->conds_, slots);
+        collect_params(x->left_, slots);
+        collect_params(x->right_, slots);
+    } else if (auto x = std::dynamic_pointer_cast<SemiJoinPlan>(plan)) {
+        collect_params(x->left_, slots);
+        collect_params(x->right_, slots);
+    } else if (auto x = std::dynamic_pointer_cast<ProjectionPlan>(plan)) {
+        collect_params(x->subplan_, slots);
+    } else if (auto x = std::dynamic_pointer_cast<SortPlan>(plan)) {
+        collect_params(x->subplan_, slots);
+    } else if (auto x = std::dynamic_pointer_cast<AggregatePlan>(plan)) {
+        collect_params(x->subplan_, slots);
+    } else if (auto x = std::dynamic_pointer_cast<LimitPlan>(plan)) {
+        collect_params(x->subplan_, slots);
+    }
+}
+
+void PlanCache::collect_cond_params(std::vector<Condition> &conds, std::vector<ParamSlot> &slots) {
+    for (auto &cond : conds) {
+        if (!cond.is_rhs_val || !cond.rhs_val.is_param()) continue;
+        auto col = sm_manager_->db_.get_table(cond.lhs_col.tab_name).get_col(cond.lhs_col.col_name);
+        slots.push_back({&cond.rhs_val, cond.rhs_val.param_idx, true, col->type, col->len});
+    }
+}
@@ -0,0 +1,72 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "analyze/analyze.h"
+#include "plan.h"
+
+class Optimizer;
+
+/**
+ * @brief 一个客户端连接中的预编译语句
+ * @description PREPARE时完成语义分析和查询优化并缓存执行计划，记录计划中每个参数占位符所在的Value；
+ * EXECUTE时只把参数值绑定到这些Value中，再由Portal根据计划生成算子树。元数据发生变化后缓存的计划可能
+ * 引用了已经删除的表或索引，下一次EXECUTE时重新生成计划。只在所属连接的工作线程中使用，不需要加锁
+ */
+class PlanCache {
+   public:
+    PlanCache(SmManager *sm_manager, Analyze *analyze, Optimizer *optimizer)
+        : sm_manager_(sm_manager), analyze_(analyze), optimizer_(optimizer) {}
+
+    void prepare(const std::string &name, std::shared_ptr<ast::TreeNode> stmt, Context *context);
+
+    std::shared_ptr<Plan> bind(const std::string &name, const std::vector<Value> &params, Context *context);
+
+    void deallocate(const std::string &name);
+
+    /* PREPARE语句的文本，结果缓存用它和参数值作为EXECUTE的key */
+    const std::string &source(const std::string &name) const;
+
+   private:
+    // 计划中的一个参数占位符
+    struct ParamSlot {
+        Value *val;         // 计划中保存参数值的位置
+        int idx;            // 参数序号
+        bool coerce;        // 是否需要按字段类型检查并生成raw；insert的值由InsertExecutor检查
+        ColType type;       // 参数对应字段的类型
+        int len;            // 参数对应字段的长度
+    };
+
+    struct PreparedStmt {
+        std::string sql;
+        std::shared_ptr<ast::TreeNode> stmt;
+        std::shared_ptr<Plan> plan;
+        std::vector<ParamSlot> slots;
+        int num_params;
+        uint64_t catalog_version;   // 生成计划时的元数据版本
+    };
+
+    void build(PreparedStmt *prepared, Context *context);
+
+    void collect_params(const std::shared_ptr<Plan> &plan, std::vector<ParamSlot> &slots);
+
+    void collect_cond_params(std::vector<Condition> &conds, std::vector<ParamSlot> &slots);
+
+    SmManager *sm_manager_;
+    Analyze *analyze_;
+    Optimizer *optimizer_;
+    std::unordered_map<std::string, PreparedStmt> stmts_;
+};
@@ -10,6 +10,7 @@ See the Mulan PSL v2 for more details. */
 
 #include "planner.h"
 
+#include <algorithm>
 #include <memory>
 
 #include "execution/executor_delete.h"
@@ -19,42 +20,47 @@ See the Mulan PSL v2 for more details. */
 #include "execution/executor_projection.h"
 #include "execution/executor_seq_scan.h"
 #include "execution/executor_update.h"
+#include "execution/worker_pool.h"
 #include "index/ix.h"
 #include "record_printer.h"
 
 // 目前的索引匹配规则为：
-// 1) 优先：完全匹配索引字段，且全部为单点查询(OP_EQ)，不会自动调整where条件的顺序
-// 2) 附加（为 Lab4 bonus 幻读测试准备）：若存在单列索引，并且该列出现在范围谓词中(OP_</<=/>/>=)，也允许走索引扫描。
-//    - 目的：让输出顺序稳定（按索引键有序），否则 SeqScan 会按插入顺序输出，导致 phantom_read_test_4 diff 失败。
+// 1) B+树索引最左边若干个字段上都有等值条件(OP_EQ)，紧接着的一个字段上可以再有范围条件(OP_</<=/>/>=)，
+//    没有等值条件时第一个字段上需要有范围条件；哈希索引需要全部字段都有等值条件，不会自动调整where条件的顺序
+// 2) 有多个可用的索引时，选择CostModel估计的选择率最小的，相同时选择没有用上的字段更少的索引
+//    - 范围扫描按索引键有序输出，否则 SeqScan 会按插入顺序输出（Lab4 bonus 幻读测试依赖这一点）
 bool Planner::get_index_cols(std::string tab_name, std::vector<Condition> curr_conds, std::vector<std::string>& index_col_names) {
     index_col_names.clear();
-    for(auto& cond: curr_conds) {
-        if(cond.is_rhs_val && cond.op == OP_EQ && cond.lhs_col.tab_name.compare(tab_name) == 0)
-            index_col_names.push_back(cond.lhs_col.col_name);
-    }
     TabMeta& tab = sm_manager_->db_.get_table(tab_name);
-    if(tab.is_index(index_col_names)) return true;
-
-    // ====== 附加规则：单列索引的范围查询 ======
-    // 找出所有“该表上、右值为常量、且比较操作符属于范围类”的列名
-    std::unordered_set<std::string> range_cols;
-    for (auto &cond : curr_conds) {
-        if (!cond.is_rhs_val) continue;
-        if (cond.lhs_col.tab_name != tab_name) continue;
-        if (cond.op == OP_LT || cond.op == OP_LE || cond.op == OP_GT || cond.op == OP_GE) {
-            range_cols.insert(cond.lhs_col.col_name);
+    CostModel cost_model(sm_manager_);
+    const IndexMeta *best = nullptr;
+    double best_sel = 0;
+    size_t best_unused = 0;
+    for (auto &index : tab.indexes) {
+        double sel;
+        if (!cost_model.index_selectivity(index, curr_conds, &sel)) continue;
+        size_t unused = index.cols.size() - std::count_if(index.cols.begin(), index.cols.end(), [&](const ColMeta &col) {
+            return std::any_of(curr_conds.begin(), curr_conds.end(), [&](const Condition &cond) {
+                return cond.is_rhs_val && cond.lhs_col.col_name == col.name;
+            });
+        });
+        if (best == nullptr || sel < best_sel || (sel == best_sel && unused < best_unused)) {
+            best = &index;
+            best_sel = sel;
+            best_unused = unused;
         }
     }
-    if (!range_cols.empty()) {
-        for (auto &idx : tab.indexes) {
-            if (idx.col_num == 1 && range_cols.count(idx.cols[0].name) > 0) {
-                index_col_names = {idx.cols[0].name};
-                return true;
-            }
-        }
+    if (best == nullptr) return false;
+    for (auto &col : best->cols) {
+        index_col_names.push_back(col.name);
     }
+    return true;
+}
 
-    return false;
+// get_index_cols选中的索引为哈希索引时使用哈希等值扫描，哈希索引只会在全部字段都有等值条件时被选中
+PlanTag Planner::index_scan_tag(const std::string &tab_name, const std::vector<std::string> &index_col_names) {
+    TabMeta &tab = sm_manager_->db_.get_table(tab_name);
+    return is_point_index(tab.get_index_meta(index_col_names)->type) ? T_HashScan : T_IndexScan;
 }
 
 /**
@@ -71,7 +77,9 @@ std::vector<Condition> pop_conds(std::vector<Condition> &conds, std::string tab_
     std::vector<Condition> solved_conds;
     auto it = conds.begin();
     while (it != conds.end()) {
-        if ((tab_names.compare(it->lhs_col.tab_name) == 0 && it->is_rhs_val) || (it->lhs_col.tab_name.compare(it->rhs_col.tab_name) == 0)) {
+        // 常量条件和比较同一张表的两个字段的条件都只涉及tab_names，在扫描时计算
+        if (tab_names.compare(it->lhs_col.tab_name) == 0 &&
+            (it->is_rhs_val || tab_names.compare(it->rhs_col.tab_name) == 0)) {
             solved_conds.emplace_back(std::move(*it));
             it = conds.erase(it);
         } else {
@@ -81,47 +89,85 @@ std::vector<Condition> pop_conds(std::vector<Condition> &conds, std::string tab_
     return solved_conds;
 }
 
-int push_conds(Condition *cond, std::shared_ptr<Plan> plan)
-{
-    if(auto x = std::dynamic_pointer_cast<ScanPlan>(plan))
-    {
-        if(x->tab_name_.compare(cond->lhs_col.tab_name) == 0) {
-            return 1;
-        } else if(x->tab_name_.compare(cond->rhs_col.tab_name) == 0){
-            return 2;
-        } else {
-            return 0;
-        }
+// 收集计划中扫描的所有表
+static void collect_tables(const std::shared_ptr<Plan> &plan, std::vector<std::string> &tables) {
+    if (auto scan = std::dynamic_pointer_cast<ScanPlan>(plan)) {
+        tables.push_back(scan->tab_name_);
+    } else if (auto join = std::dynamic_pointer_cast<JoinPlan>(plan)) {
+        collect_tables(join->left_, tables);
+        collect_tables(join->right_, tables);
+    } else if (auto proj = std::dynamic_pointer_cast<ProjectionPlan>(plan)) {
+        collect_tables(proj->subplan_, tables);
+    } else if (auto semi = std::dynamic_pointer_cast<SemiJoinPlan>(plan)) {
+        // 子查询中的表不属于外层查询
+        collect_tables(semi->left_, tables);
     }
-    else if(auto x = std::dynamic_pointer_cast<JoinPlan>(plan))
-    {
-        int left_res = push_conds(cond, x->left_);
-        // 条件已经下推到左子节点
-        if(left_res == 3){
-            return 3;
-        }
-        int right_res = push_conds(cond, x->right_);
-        // 条件已经下推到右子节点
-        if(right_res == 3){
-            return 3;
-        }
-        // 左子节点或右子节点有一个没有匹配到条件的列
-        if(left_res == 0 || right_res == 0) {
-            return left_res + right_res;
-        }
-        // 左子节点匹配到条件的右边
-        if(left_res == 2) {
-            // 需要将左右两边的条件变换位置
-            std::map<CompOp, CompOp> swap_op = {
-                {OP_EQ, OP_EQ}, {OP_NE, OP_NE}, {OP_LT, OP_GT}, {OP_GT, OP_LT}, {OP_LE, OP_GE}, {OP_GE, OP_LE},
-            };
-            std::swap(cond->lhs_col, cond->rhs_col);
-            cond->op = swap_op.at(cond->op);
-        }
-        x->conds_.emplace_back(std::move(*cond));
-        return 3;
+}
+
+/**
+ * @brief 把条件放到plan中能计算它的最低的节点：只涉及一张表的条件放到该表的扫描上，
+ * 否则放到同时覆盖两侧字段的最低的连接上，并调整为左侧字段来自左儿子
+ * @return plan没有覆盖条件涉及的所有表时返回false
+ */
+static bool place_cond(const std::shared_ptr<Plan> &plan, Condition &cond) {
+    std::vector<std::string> tables;
+    collect_tables(plan, tables);
+    auto covers = [&](const std::string &tab_name) {
+        return std::find(tables.begin(), tables.end(), tab_name) != tables.end();
+    };
+    if (!covers(cond.lhs_col.tab_name) || (!cond.is_rhs_val && !covers(cond.rhs_col.tab_name))) {
+        return false;
     }
-    return false;
+    if (auto scan = std::dynamic_pointer_cast<ScanPlan>(plan)) {
+        scan->conds_.push_back(cond);
+        scan->fed_conds_.push_back(cond);
+        return true;
+    }
+    auto join = std::dynamic_pointer_cast<JoinPlan>(plan);
+    if (join == nullptr) return false;
+    if (place_cond(join->left_, cond) || place_cond(join->right_, cond)) {
+        return true;
+    }
+    std::vector<std::string> left_tables;
+    collect_tables(join->left_, left_tables);
+    if (std::find(left_tables.begin(), left_tables.end(), cond.lhs_col.tab_name) == left_tables.end()) {
+        std::map<CompOp, CompOp> swap_op = {
+            {OP_EQ, OP_EQ}, {OP_NE, OP_NE}, {OP_LT, OP_GT}, {OP_GT, OP_LT}, {OP_LE, OP_GE}, {OP_GE, OP_LE},
+        };
+        std::swap(cond.lhs_col, cond.rhs_col);
+        cond.op = swap_op.at(cond.op);
+    }
+    join->conds_.push_back(cond);
+    return true;
+}
+
+// 取出连接树中所有连接上的条件
+static void take_join_conds(const std::shared_ptr<Plan> &plan, std::vector<Condition> &conds) {
+    auto join = std::dynamic_pointer_cast<JoinPlan>(plan);
+    if (join == nullptr) return;
+    conds.insert(conds.end(), std::make_move_iterator(join->conds_.begin()),
+                 std::make_move_iterator(join->conds_.end()));
+    join->conds_.clear();
+    take_join_conds(join->left_, conds);
+    take_join_conds(join->right_, conds);
+}
+
+// 把子查询的半连接放在plan中扫描cond左侧字段所在表的节点之上
+static std::shared_ptr<Plan> attach_semi_join(std::shared_ptr<Plan> plan, PlanTag tag, std::shared_ptr<Plan> subplan,
+                                              const Condition &cond) {
+    if (auto join = std::dynamic_pointer_cast<JoinPlan>(plan)) {
+        std::vector<std::string> left_tables;
+        collect_tables(join->left_, left_tables);
+        bool in_left = std::find(left_tables.begin(), left_tables.end(), cond.lhs_col.tab_name) != left_tables.end();
+        auto &child = in_left ? join->left_ : join->right_;
+        child = attach_semi_join(std::move(child), tag, std::move(subplan), cond);
+        return plan;
+    }
+    if (auto semi = std::dynamic_pointer_cast<SemiJoinPlan>(plan)) {
+        semi->left_ = attach_semi_join(std::move(semi->left_), tag, std::move(subplan), cond);
+        return plan;
+    }
+    return std::make_shared<SemiJoinPlan>(tag, std::move(plan), std::move(subplan), std::vector<Condition>{cond});
 }
 
 std::shared_ptr<Plan> pop_scan(int *scantbl, std::string table, std::vector<std::string> &joined_tables, 
@@ -151,36 +197,63 @@ std::shared_ptr<Query> Planner::logical_optimization(std::shared_ptr<Query> quer
 std::shared_ptr<Plan> Planner::physical_optimization(std::shared_ptr<Query> query, Context *context)
 {
     std::shared_ptr<Plan> plan = make_one_rel(query);
-    
-    // 其他物理优化
+
+    // 处理where中的子查询
+    plan = make_sublink_joins(query, std::move(plan), context);
+
+    // 处理group by和聚合函数
+    plan = generate_agg_plan(query, std::move(plan));
 
     // 处理orderby
     plan = generate_sort_plan(query, std::move(plan)); 
 
+    // 处理limit
+    plan = generate_limit_plan(query, std::move(plan));
+
     return plan;
 }
 
 
 
+/**
+ * @brief 把where条件中的不相关子查询转换为哈希半连接(IN/EXISTS)和反连接(NOT IN/NOT EXISTS)，子查询单独生成计划。
+ * IN放在左侧字段所在表的扫描之上，外层表的元组在与其他表连接之前就被过滤；
+ * EXISTS的结果与外层元组无关，放在整个连接树之上，子查询决定结果为空时不会读取外层的表
+ */
+std::shared_ptr<Plan> Planner::make_sublink_joins(std::shared_ptr<Query> query, std::shared_ptr<Plan> plan,
+                                                  Context *context) {
+    for (auto &sublink : query->sublinks) {
+        PlanTag tag = sublink.negated ? T_AntiJoin : T_SemiJoin;
+        std::shared_ptr<Plan> subplan = generate_select_plan(sublink.query, context);
+        if (sublink.is_exists) {
+            plan = std::make_shared<SemiJoinPlan>(tag, std::move(plan), std::move(subplan), std::vector<Condition>());
+            continue;
+        }
+        Condition cond;
+        cond.lhs_col = sublink.lhs_col;
+        cond.op = OP_EQ;
+        cond.is_rhs_val = false;
+        cond.rhs_col = sublink.query->cols[0];
+        plan = attach_semi_join(std::move(plan), tag, std::move(subplan), cond);
+    }
+    return plan;
+}
+
 std::shared_ptr<Plan> Planner::make_one_rel(std::shared_ptr<Query> query)
 {
     auto x = std::dynamic_pointer_cast<ast::SelectStmt>(query->parse);
     std::vector<std::string> tables = query->tables;
+    CostModel cost_model(sm_manager_);
+    if (cost_model.has_stats(tables)) {
+        auto plan = make_cost_based_rel(query, cost_model);
+        push_down_predicates(plan);
+        return plan;
+    }
     // // Scan table , 生成表算子列表tab_nodes
     std::vector<std::shared_ptr<Plan>> table_scan_executors(tables.size());
     for (size_t i = 0; i < tables.size(); i++) {
         auto curr_conds = pop_conds(query->conds, tables[i]);
-        // int index_no = get_indexNo(tables[i], curr_conds);
-        std::vector<std::string> index_col_names;
-        bool index_exist = get_index_cols(tables[i], curr_conds, index_col_names);
-        if (index_exist == false) {  // 该表没有索引
-            index_col_names.clear();
-            table_scan_executors[i] = 
-                std::make_shared<ScanPlan>(T_SeqScan, sm_manager_, tables[i], curr_conds, index_col_names);
-        } else {  // 存在索引
-            table_scan_executors[i] =
-                std::make_shared<ScanPlan>(T_IndexScan, sm_manager_, tables[i], curr_conds, index_col_names);
-        }
+        table_scan_executors[i] = make_scan_plan(tables[i], curr_conds);
     }
     // 只有一个表，不需要join。
     if(tables.size() == 1)
@@ -250,7 +323,8 @@ std::shared_ptr<Plan> Planner::make_one_rel(std::shared_ptr<Query> query)
                 table_join_executors = std::make_shared<JoinPlan>(T_NestLoop, std::move(left_need_to_join_executors), 
                                                                     std::move(table_join_executors), join_conds);
             } else {
-                push_conds(std::move(&(*it)), table_join_executors);
+                // 两张表都已经连接，放到覆盖它们的最低的连接上
+                place_cond(table_join_executors, *it);
             }
             it = conds.erase(it);
         }
@@ -266,11 +340,157 @@ std::shared_ptr<Plan> Planner::make_one_rel(std::shared_ptr<Query> query)
                                                     std::move(table_join_executors), std::vector<Condition>());
         }
     }
+    push_down_predicates(table_join_executors);
+    choose_join_method(table_join_executors);
 
     return table_join_executors;
 
 }
 
+/**
+ * @brief 基于代价选择连接顺序和连接算法：不超过OPT_DP_MAX_TABLES张表时用动态规划枚举连接树，
+ * 每个表的集合只保留代价最小的计划，集合的划分之间没有连接条件时才考虑笛卡尔积；
+ * 表更多时贪心地每次连接代价最小的一对关系
+ */
+std::shared_ptr<Plan> Planner::make_cost_based_rel(std::shared_ptr<Query> query, CostModel &cost_model)
+{
+    const std::vector<std::string> &tables = query->tables;
+    size_t n = tables.size();
+    std::vector<RelPlan> rels;
+    for (auto &tab_name : tables) {
+        rels.push_back(cost_model.best_scan(tab_name, pop_conds(query->conds, tab_name)));
+    }
+    if (n == 1) {
+        return rels[0].plan;
+    }
+    // 剩下的都是两张表之间的连接条件
+    auto conds = std::move(query->conds);
+    auto table_no = [&](const std::string &tab_name) {
+        return static_cast<size_t>(std::find(tables.begin(), tables.end(), tab_name) - tables.begin());
+    };
+    std::vector<std::pair<size_t, size_t>> cond_tables;
+    for (auto &cond : conds) {
+        cond_tables.emplace_back(table_no(cond.lhs_col.tab_name), table_no(cond.rhs_col.tab_name));
+    }
+
+    if (n > OPT_DP_MAX_TABLES) {
+        // owner[i]为第i张表当前所在的关系
+        std::vector<size_t> owner(n);
+        for (size_t i = 0; i < n; i++) owner[i] = i;
+        auto conds_between = [&](size_t a, size_t b) {
+            std::vector<Condition> between;
+            for (size_t k = 0; k < conds.size(); k++) {
+                size_t l = owner[cond_tables[k].first], r = owner[cond_tables[k].second];
+                if ((l == a && r == b) || (l == b && r == a)) between.push_back(conds[k]);
+            }
+            return between;
+        };
+        std::vector<size_t> alive(n);
+        for (size_t i = 0; i < n; i++) alive[i] = i;
+        while (alive.size() > 1) {
+            RelPlan best;
+            size_t best_a = 0, best_b = 0;
+            bool found = false, connected = false;
+            for (size_t x = 0; x < alive.size(); x++) {
+                for (size_t y = 0; y < alive.size(); y++) {
+                    if (x == y) continue;
+                    auto between = conds_between(alive[x], alive[y]);
+                    if (connected && between.empty()) continue;
+                    RelPlan joined = cost_model.best_join(rels[alive[x]], rels[alive[y]], std::move(between));
+                    bool has_conds = !std::static_pointer_cast<JoinPlan>(joined.plan)->conds_.empty();
+                    if (!found || (has_conds && !connected) || joined.cost < best.cost) {
+                        best = std::move(joined);
+                        best_a = alive[x];
+                        best_b = alive[y];
+                        found = true;
+                        connected = connected || has_conds;
+                    }
+                }
+            }
+            rels[best_a] = std::move(best);
+            for (auto &o : owner) {
+                if (o == best_b) o = best_a;
+            }
+            alive.erase(std::find(alive.begin(), alive.end(), best_b));
+        }
+        return rels[alive[0]].plan;
+    }
+
+    size_t full = (size_t(1) << n) - 1;
+    std::vector<RelPlan> best(full + 1);
+    std::vector<bool> found(full + 1, false);
+    for (size_t i = 0; i < n; i++) {
+        best[size_t(1) << i] = std::move(rels[i]);
+        found[size_t(1) << i] = true;
+    }
+    auto conds_between = [&](size_t a, size_t b) {
+        std::vector<Condition> between;
+        for (size_t k = 0; k < conds.size(); k++) {
+            size_t l = size_t(1) << cond_tables[k].first, r = size_t(1) << cond_tables[k].second;
+            if (((l & a) && (r & b)) || ((l & b) && (r & a))) between.push_back(conds[k]);
+        }
+        return between;
+    };
+    for (size_t mask = 1; mask <= full; mask++) {
+        if ((mask & (mask - 1)) == 0) continue;
+        // 第一遍只考虑有连接条件的划分，没有这样的划分时再考虑笛卡尔积
+        for (int pass = 0; pass < 2 && !found[mask]; pass++) {
+            for (size_t sub = (mask - 1) & mask; sub > 0; sub = (sub - 1) & mask) {
+                size_t other = mask ^ sub;
+                if (!found[sub] || !found[other]) continue;
+                auto between = conds_between(sub, other);
+                if (pass == 0 && between.empty()) continue;
+                RelPlan joined = cost_model.best_join(best[sub], best[other], std::move(between));
+                if (!found[mask] || joined.cost < best[mask].cost) {
+                    best[mask] = std::move(joined);
+                    found[mask] = true;
+                }
+            }
+        }
+    }
+    return best[full].plan;
+}
+
+// 单表扫描：表有统计信息时按代价选择扫描方式，否则按get_index_cols的规则选择索引
+std::shared_ptr<Plan> Planner::make_scan_plan(const std::string &tab_name, const std::vector<Condition> &conds)
+{
+    CostModel cost_model(sm_manager_);
+    if (cost_model.has_stats({tab_name})) {
+        return cost_model.best_scan(tab_name, conds).plan;
+    }
+    std::vector<std::string> index_col_names;
+    if (!get_index_cols(tab_name, conds, index_col_names)) {
+        return std::make_shared<ScanPlan>(T_SeqScan, sm_manager_, tab_name, conds, std::vector<std::string>());
+    }
+    return std::make_shared<ScanPlan>(index_scan_tag(tab_name, index_col_names), sm_manager_, tab_name, conds,
+                                      index_col_names);
+}
+
+
+/**
+ * @brief 有分组或聚合函数时在计划上加聚合节点。没有分组列，或者输入是索引扫描且索引的前几个字段恰好是全部分组列时，
+ * 同一组的元组在输入中连续出现，使用流式聚合，否则使用哈希聚合。分区表的各分区依次输出，整体上没有顺序
+ */
+std::shared_ptr<Plan> Planner::generate_agg_plan(std::shared_ptr<Query> query, std::shared_ptr<Plan> plan)
+{
+    if (query->aggs.empty() && query->group_cols.empty()) {
+        return plan;
+    }
+    const auto &group_cols = query->group_cols;
+    bool grouped_input = group_cols.empty();
+    auto scan = std::dynamic_pointer_cast<ScanPlan>(plan);
+    if (scan != nullptr && (scan->tag == T_IndexScan || scan->tag == T_IndexOnlyScan) &&
+        scan->index_col_names_.size() >= group_cols.size() &&
+        !sm_manager_->db_.get_table(scan->tab_name_).partition.is_partitioned()) {
+        grouped_input = std::all_of(group_cols.begin(), group_cols.end(), [&](const TabCol &col) {
+            auto prefix_end = scan->index_col_names_.begin() + group_cols.size();
+            return col.tab_name == scan->tab_name_ &&
+                   std::find(scan->index_col_names_.begin(), prefix_end, col.col_name) != prefix_end;
+        });
+    }
+    return std::make_shared<AggregatePlan>(grouped_input ? T_StreamAggregate : T_HashAggregate, std::move(plan),
+                                           group_cols, query->aggs);
+}
 
 std::shared_ptr<Plan> Planner::generate_sort_plan(std::shared_ptr<Query> query, std::shared_ptr<Plan> plan)
 {
@@ -285,15 +505,250 @@ std::shared_ptr<Plan> Planner::generate_sort_plan(std::shared_ptr<Query> query,
         const auto &sel_tab_cols = sm_manager_->db_.get_table(sel_tab_name).cols;
         all_cols.insert(all_cols.end(), sel_tab_cols.begin(), sel_tab_cols.end());
     }
-    TabCol sel_col;
-    for (auto &col : all_cols) {
-        if(col.name.compare(x->order->cols->col_name) == 0 )
-        sel_col = {.tab_name = col.tab_name, .col_name = col.name};
+    std::vector<TabCol> sel_cols;
+    std::vector<bool> is_desc;
+    for (auto &order : x->order) {
+        TabCol sel_col;
+        for (auto &col : all_cols) {
+            if (col.name.compare(order->cols->col_name) == 0 &&
+                (order->cols->tab_name.empty() || col.tab_name == order->cols->tab_name)) {
+                sel_col = {.tab_name = col.tab_name, .col_name = col.name};
+            }
+        }
+        sel_cols.push_back(sel_col);
+        is_desc.push_back(order->orderby_dir == ast::OrderBy_DESC);
     }
-    return std::make_shared<SortPlan>(T_Sort, std::move(plan), sel_col, 
-                                    x->order->orderby_dir == ast::OrderBy_DESC);
+    return std::make_shared<SortPlan>(T_Sort, std::move(plan), std::move(sel_cols), std::move(is_desc));
 }
 
+/**
+ * @brief 有ORDER BY时由排序节点只保留前limit个元组（Top-N），否则在计划上加一个LIMIT节点
+ */
+std::shared_ptr<Plan> Planner::generate_limit_plan(std::shared_ptr<Query> query, std::shared_ptr<Plan> plan)
+{
+    auto x = std::dynamic_pointer_cast<ast::SelectStmt>(query->parse);
+    if (x->limit < 0) {
+        return plan;
+    }
+    if (auto sort = std::dynamic_pointer_cast<SortPlan>(plan)) {
+        sort->limit_ = x->limit;
+        return plan;
+    }
+    return std::make_shared<LimitPlan>(T_Limit, std::move(plan), x->limit);
+}
+
+
+/**
+ * @brief 谓词下推：把连接上的每个条件重新放到能计算它的最低的算子上，
+ * 只涉及一张表的条件在扫描时过滤，连接条件挂到覆盖其两侧表的最低的连接上，
+ * 保证元组在被连接放大之前就被过滤；同一连接上条件的相对顺序不变
+ */
+void Planner::push_down_predicates(const std::shared_ptr<Plan> &plan) {
+    std::vector<Condition> conds;
+    take_join_conds(plan, conds);
+    for (auto &cond : conds) {
+        place_cond(plan, cond);
+    }
+}
+
+/**
+ * @brief 为连接选择算法：两侧输入都能按某个等值条件的字段有序输出时使用归并连接，
+ * 其余有两个字段相等的条件时使用哈希连接，否则使用嵌套循环连接；需要在make_one_rel下推完所有连接条件之后调用
+ */
+void Planner::choose_join_method(const std::shared_ptr<Plan> &plan) {
+    auto join = std::dynamic_pointer_cast<JoinPlan>(plan);
+    if (join == nullptr) return;
+    choose_join_method(join->left_);
+    choose_join_method(join->right_);
+    for (size_t i = 0; i < join->conds_.size(); i++) {
+        auto &cond = join->conds_[i];
+        if (cond.is_rhs_val || cond.op != OP_EQ) continue;
+        auto lhs = sm_manager_->db_.get_table(cond.lhs_col.tab_name).get_col(cond.lhs_col.col_name);
+        auto rhs = sm_manager_->db_.get_table(cond.rhs_col.tab_name).get_col(cond.rhs_col.col_name);
+        if (lhs->type != rhs->type || lhs->len != rhs->len) continue;
+        if (ordered_on(join->left_, cond.lhs_col, false) && ordered_on(join->right_, cond.rhs_col, false)) {
+            ordered_on(join->left_, cond.lhs_col, true);
+            ordered_on(join->right_, cond.rhs_col, true);
+            // 归并条件放在第一个，MergeJoinExecutor按它推进两侧输入
+            std::swap(join->conds_[0], join->conds_[i]);
+            join->tag = T_MergeJoin;
+            return;
+        }
+    }
+    bool has_equi_cond = std::any_of(join->conds_.begin(), join->conds_.end(),
+                                     [](const Condition &cond) { return !cond.is_rhs_val && cond.op == OP_EQ; });
+    join->tag = has_equi_cond ? T_HashJoin : T_NestLoop;
+}
+
+/**
+ * @brief 判断plan的输出能否按col升序排列：col上的升序排序、以col为第一个字段的B+树索引扫描，
+ * 或者表上有这样的B+树索引的顺序扫描。分区表上的扫描逐个分区输出，没有顺序
+ *
+ * @param apply 为true时把顺序扫描改为该索引上的全索引扫描
+ */
+bool Planner::ordered_on(const std::shared_ptr<Plan> &plan, const TabCol &col, bool apply) {
+    if (auto sort = std::dynamic_pointer_cast<SortPlan>(plan)) {
+        return !sort->is_desc_[0] && sort->sel_cols_[0].tab_name == col.tab_name &&
+               sort->sel_cols_[0].col_name == col.col_name;
+    }
+    auto scan = std::dynamic_pointer_cast<ScanPlan>(plan);
+    if (scan == nullptr || scan->tab_name_ != col.tab_name) return false;
+    if (sm_manager_->db_.get_table(scan->tab_name_).partition.is_partitioned()) return false;
+    if (scan->tag == T_IndexScan || scan->tag == T_IndexOnlyScan) {
+        return scan->index_col_names_[0] == col.col_name;
+    }
+    if (scan->tag != T_SeqScan) return false;
+    TabMeta &tab = sm_manager_->db_.get_table(scan->tab_name_);
+    for (auto &index : tab.indexes) {
+        if (index.type != INDEX_BTREE || index.cols[0].name != col.col_name) continue;
+        if (apply) {
+            scan->index_col_names_.clear();
+            for (auto &index_col : index.cols) {
+                scan->index_col_names_.push_back(index_col.name);
+            }
+            scan->tag = T_IndexScan;
+        }
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief 单表查询用到的字段（选取的列、扫描条件和排序列）都在扫描所用的索引中时，改为只读索引的扫描，
+ * 元组直接由索引的key构造，不再按rid回表读取记录
+ *
+ * @param sel_cols select plan 选取的列
+ * @param plan 物理优化得到的计划，只处理索引扫描以及其上的排序和LIMIT
+ */
+void Planner::use_index_only_scan(const std::vector<TabCol> &sel_cols, const std::shared_ptr<Plan> &plan) {
+    std::shared_ptr<Plan> child = plan;
+    if (auto limit = std::dynamic_pointer_cast<LimitPlan>(child)) child = limit->subplan_;
+    auto sort = std::dynamic_pointer_cast<SortPlan>(child);
+    if (sort != nullptr) child = sort->subplan_;
+    auto scan = std::dynamic_pointer_cast<ScanPlan>(child);
+    if (scan == nullptr || scan->tag != T_IndexScan) return;
+
+    TabMeta &tab = sm_manager_->db_.get_table(scan->tab_name_);
+    const auto &index_cols = tab.get_index_meta(scan->index_col_names_)->cols;
+    auto covered = [&](const TabCol &col) {
+        return col.tab_name == scan->tab_name_ &&
+               std::any_of(index_cols.begin(), index_cols.end(),
+                           [&](const ColMeta &index_col) { return index_col.name == col.col_name; });
+    };
+    if (!std::all_of(sel_cols.begin(), sel_cols.end(), covered)) return;
+    for (auto &cond : scan->conds_) {
+        if (!covered(cond.lhs_col) || (!cond.is_rhs_val && !covered(cond.rhs_col))) return;
+    }
+    if (sort != nullptr && !std::all_of(sort->sel_cols_.begin(), sort->sel_cols_.end(), covered)) return;
+    scan->tag = T_IndexOnlyScan;
+}
+
+/**
+ * @brief 把页面数不少于EXEC_PARALLEL_SCAN_MIN_PAGES的表上的顺序扫描改为按morsel并行的扫描，
+ * 小表分发任务的开销超过并行带来的收益，工作线程池只有一个线程时也不改变计划。
+ * 分区表按全部分区的页面数判断，改为并行扫描之后每个分区分别并行扫描
+ *
+ * @param plan 查询计划，递归处理其中所有的顺序扫描
+ */
+void Planner::use_parallel_scan(const std::shared_ptr<Plan> &plan) {
+    if (auto join = std::dynamic_pointer_cast<JoinPlan>(plan)) {
+        use_parallel_scan(join->left_);
+        use_parallel_scan(join->right_);
+    } else if (auto semi = std::dynamic_pointer_cast<SemiJoinPlan>(plan)) {
+        // 子查询的计划在生成时已经处理过
+        use_parallel_scan(semi->left_);
+    } else if (auto sort = std::dynamic_pointer_cast<SortPlan>(plan)) {
+        use_parallel_scan(sort->subplan_);
+    } else if (auto agg = std::dynamic_pointer_cast<AggregatePlan>(plan)) {
+        use_parallel_scan(agg->subplan_);
+    } else if (auto limit = std::dynamic_pointer_cast<LimitPlan>(plan)) {
+        use_parallel_scan(limit->subplan_);
+    } else if (auto scan = std::dynamic_pointer_cast<ScanPlan>(plan)) {
+        if (scan->tag != T_SeqScan || WorkerPool::instance().size() <= 1) return;
+        int num_pages = 0;
+        for (auto &tab_name : sm_manager_->partition_tables(scan->tab_name_)) {
+            num_pages += sm_manager_->get_table_handle(tab_name)->get_file_hdr().num_pages;
+        }
+        if (num_pages >= EXEC_PARALLEL_SCAN_MIN_PAGES) {
+            scan->tag = T_ParallelSeqScan;
+        }
+    }
+}
+
+/**
+ * @brief 投影下推：把上层算子用到的字段（选取的列、连接条件、排序键、分组列和聚合参数）下推到连接和排序的输入，
+ * 在扫描和下层连接之上加只保留这些字段的投影节点，连接拼接元组、哈希表和排序缓冲区只保存需要的字段
+ *
+ * @param plan 物理优化得到的计划，需要在其他按扫描类型改写计划的优化之后调用
+ * @param needed plan的上层算子用到的字段
+ * @param narrow 上层算子是否复制或保存plan输出的元组(连接和排序)，只有这时才值得多一次投影
+ * @return 下推之后的计划
+ */
+std::shared_ptr<Plan> Planner::push_down_projection(std::shared_ptr<Plan> plan, std::vector<TabCol> needed,
+                                                    bool narrow) {
+    auto add = [](std::vector<TabCol> &cols, const TabCol &col) {
+        // 聚合函数的输出列和COUNT(*)不对应表中的字段
+        if (col.tab_name.empty() || col.col_name == "*") return;
+        if (std::find(cols.begin(), cols.end(), col) == cols.end()) cols.push_back(col);
+    };
+    std::vector<TabCol> child_needed;
+    for (auto &col : needed) add(child_needed, col);
+
+    std::vector<TabCol> output;     // plan输出的字段中上层算子用到的部分
+    bool has_unused = false;        // plan是否输出了上层算子用不到的字段
+    if (auto scan = std::dynamic_pointer_cast<ScanPlan>(plan)) {
+        for (auto &col : scan->cols_) {
+            TabCol tab_col = {.tab_name = col.tab_name, .col_name = col.name};
+            if (std::find(child_needed.begin(), child_needed.end(), tab_col) != child_needed.end()) {
+                output.push_back(tab_col);
+            } else {
+                has_unused = true;
+            }
+        }
+        // 上层算子不读取任何字段时(如COUNT(*))仍然需要保留一个字段来表示元组
+        if (output.empty()) output.push_back({.tab_name = scan->tab_name_, .col_name = scan->cols_[0].name});
+    } else if (auto join = std::dynamic_pointer_cast<JoinPlan>(plan)) {
+        std::vector<TabCol> join_needed = child_needed;
+        for (auto &cond : join->conds_) {
+            add(join_needed, cond.lhs_col);
+            if (!cond.is_rhs_val) add(join_needed, cond.rhs_col);
+        }
+        join->left_ = push_down_projection(join->left_, join_needed, true);
+        join->right_ = push_down_projection(join->right_, join_needed, true);
+        // 只被本层连接条件用到的字段不再向上传递
+        std::vector<std::string> tables;
+        collect_tables(plan, tables);
+        for (auto &col : join_needed) {
+            if (std::find(tables.begin(), tables.end(), col.tab_name) == tables.end()) continue;
+            if (std::find(child_needed.begin(), child_needed.end(), col) != child_needed.end()) {
+                output.push_back(col);
+            } else {
+                has_unused = true;
+            }
+        }
+        // 上层算子不读取本层的任何字段时保留原来的元组
+        if (output.empty()) has_unused = false;
+    } else if (auto semi = std::dynamic_pointer_cast<SemiJoinPlan>(plan)) {
+        // 半连接输出左儿子的元组，由左儿子按上层的需要投影
+        for (auto &cond : semi->conds_) add(child_needed, cond.lhs_col);
+        semi->left_ = push_down_projection(semi->left_, child_needed, narrow);
+        return plan;
+    } else if (auto sort = std::dynamic_pointer_cast<SortPlan>(plan)) {
+        for (auto &col : sort->sel_cols_) add(child_needed, col);
+        sort->subplan_ = push_down_projection(sort->subplan_, child_needed, true);
+    } else if (auto agg = std::dynamic_pointer_cast<AggregatePlan>(plan)) {
+        std::vector<TabCol> agg_needed;
+        for (auto &col : agg->group_cols_) add(agg_needed, col);
+        for (auto &item : agg->aggs_) add(agg_needed, item.col);
+        agg->subplan_ = push_down_projection(agg->subplan_, agg_needed, false);
+    } else if (auto limit = std::dynamic_pointer_cast<LimitPlan>(plan)) {
+        limit->subplan_ = push_down_projection(limit->subplan_, child_needed, false);
+    }
+    if (narrow && has_unused) {
+        return std::make_shared<ProjectionPlan>(T_Projection, std::move(plan), std::move(output));
+    }
+    return plan;
+}
 
 /**
  * @brief select plan 生成
@@ -309,12 +764,92 @@ std::shared_ptr<Plan> Planner::generate_select_plan(std::shared_ptr<Query> query
     //物理优化
     auto sel_cols = query->cols;
     std::shared_ptr<Plan> plannerRoot = physical_optimization(query, context);
+    use_index_only_scan(sel_cols, plannerRoot);
+    use_parallel_scan(plannerRoot);
+    plannerRoot = push_down_projection(std::move(plannerRoot), sel_cols, false);
     plannerRoot = std::make_shared<ProjectionPlan>(T_Projection, std::move(plannerRoot), 
                                                         std::move(sel_cols));
 
     return plannerRoot;
 }
 
+/**
+ * @brief 字段的ENCODING选项转换为字典编码的字节数，0表示不编码。DICT只用于CHAR和VARCHAR字段，不指定字节数时为2
+ */
+int Planner::interp_encoding(const ast::ColDef &col_def) {
+    if (col_def.encoding.empty()) {
+        return 0;
+    }
+    std::string name = col_def.encoding;
+    std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+    if (name == "NONE" && col_def.dict_width == 0) {
+        return 0;
+    }
+    if (name != "DICT") {
+        throw InvalidEncodingError("unknown encoding " + col_def.encoding);
+    }
+    if (col_def.type_len->type != ast::SV_TYPE_STRING && col_def.type_len->type != ast::SV_TYPE_VARCHAR) {
+        throw InvalidEncodingError("column " + col_def.col_name + ": DICT is only for CHAR and VARCHAR");
+    }
+    int width = col_def.dict_width == 0 ? 2 : col_def.dict_width;
+    if (width != 1 && width != 2 && width != 4) {
+        throw InvalidEncodingError("column " + col_def.col_name + ": DICT codes take 1, 2 or 4 bytes");
+    }
+    return width;
+}
+
+/**
+ * @brief 把PARTITION BY子句转换为分区方式：HASH分区的各分区命名为p0, p1, ...；RANGE分区只有最后一个分区的上界可以是MAXVALUE
+ */
+PartitionDef Planner::interp_partition(const ast::PartitionBy &partition) {
+    PartitionDef def;
+    def.col_name = partition.col_name;
+    std::string method = partition.method;
+    std::transform(method.begin(), method.end(), method.begin(), ::toupper);
+    if (method == "HASH") {
+        if (!partition.ranges.empty()) {
+            throw InvalidPartitionError("HASH partitioning takes PARTITIONS n");
+        }
+        if (partition.num_partitions < 1 || partition.num_partitions > MAX_PARTITIONS) {
+            throw InvalidPartitionError("a table takes 1 to " + std::to_string(MAX_PARTITIONS) + " partitions");
+        }
+        def.type = PARTITION_HASH;
+        for (int i = 0; i < partition.num_partitions; ++i) {
+            def.names.push_back("p" + std::to_string(i));
+        }
+        return def;
+    }
+    if (method != "RANGE") {
+        throw InvalidPartitionError("unknown method " + partition.method);
+    }
+    if (partition.ranges.empty()) {
+        throw InvalidPartitionError("RANGE partitioning takes a list of partitions");
+    }
+    def.type = PARTITION_RANGE;
+    for (size_t i = 0; i < partition.ranges.size(); ++i) {
+        auto &range = partition.ranges[i];
+        def.names.push_back(range->name);
+        if (range->bound == nullptr) {
+            if (i + 1 != partition.ranges.size()) {
+                throw InvalidPartitionError("only the last partition can be bounded by MAXVALUE");
+            }
+            continue;
+        }
+        Value bound;
+        if (auto int_lit = std::dynamic_pointer_cast<ast::IntLit>(range->bound)) {
+            bound.set_int(int_lit->val);
+        } else if (auto float_lit = std::dynamic_pointer_cast<ast::FloatLit>(range->bound)) {
+            bound.set_float(float_lit->val);
+        } else if (auto str_lit = std::dynamic_pointer_cast<ast::StringLit>(range->bound)) {
+            bound.set_str(str_lit->val);
+        } else {
+            throw InvalidPartitionError("partition bound must be a constant");
+        }
+        def.bounds.push_back(std::move(bound));
+    }
+    return def;
+}
+
 // 生成DDL语句和DML语句的查询执行计划
 std::shared_ptr<Plan> Planner::do_planner(std::shared_ptr<Query> query, Context *context)
 {
@@ -326,19 +861,65 @@ std::shared_ptr<Plan> Planner::do_planner(std::shared_ptr<Query> query, Context
             if (auto sv_col_def = std::dynamic_pointer_cast<ast::ColDef>(field)) {
                 ColDef col_def = {.name = sv_col_def->col_name,
                                   .type = interp_sv_type(sv_col_def->type_len->type),
-                                  .len = sv_col_def->type_len->len};
+                                  .len = sv_col_def->type_len->len,
+                                  .dict_width = interp_encoding(*sv_col_def)};
                 col_defs.push_back(col_def);
             } else {
                 throw InternalError("Unexpected field type");
             }
         }
-        plannerRoot = std::make_shared<DDLPlan>(T_CreateTable, x->tab_name, std::vector<std::string>(), col_defs);
+        TabStorage storage = STORAGE_ROW;
+        if (!x->storage.empty()) {
+            std::string name = x->storage;
+            std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+            if (name == "PAX") {
+                storage = STORAGE_PAX;
+            } else if (name != "ROW") {
+                throw UnknownStorageError(x->storage);
+            }
+        }
+        TabCompression compression = COMPRESSION_NONE;
+        if (!x->compression.empty()) {
+            std::string name = x->compression;
+            std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+            if (name == "LZ4") {
+                compression = COMPRESSION_LZ4;
+            } else if (name != "NONE") {
+                throw UnknownCompressionError(x->compression);
+            }
+        }
+        if (storage == STORAGE_PAX) {
+            for (auto &col_def : col_defs) {
+                if (col_def.dict_width > 0) {
+                    throw InvalidEncodingError("column " + col_def.name + ": DICT needs ROW storage");
+                }
+            }
+        }
+        PartitionDef partition;
+        if (x->partition != nullptr) {
+            partition = interp_partition(*x->partition);
+        }
+        plannerRoot = std::make_shared<DDLPlan>(T_CreateTable, x->tab_name, std::vector<std::string>(), col_defs,
+                                                storage, INDEX_BTREE, false, std::move(partition), compression);
     } else if (auto x = std::dynamic_pointer_cast<ast::DropTable>(query->parse)) {
         // drop table;
         plannerRoot = std::make_shared<DDLPlan>(T_DropTable, x->tab_name, std::vector<std::string>(), std::vector<ColDef>());
     } else if (auto x = std::dynamic_pointer_cast<ast::CreateIndex>(query->parse)) {
         // create index;
-        plannerRoot = std::make_shared<DDLPlan>(T_CreateIndex, x->tab_name, x->col_names, std::vector<ColDef>());
+        IndexType index_type = INDEX_BTREE;
+        if (!x->method.empty()) {
+            std::string name = x->method;
+            std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+            if (name == "HASH") {
+                index_type = INDEX_HASH;
+            } else if (name == "LSM") {
+                index_type = INDEX_LSM;
+            } else if (name != "BTREE") {
+                throw UnknownIndexTypeError(x->method);
+            }
+        }
+        plannerRoot = std::make_shared<DDLPlan>(T_CreateIndex, x->tab_name, x->col_names, std::vector<ColDef>(),
+                                                STORAGE_ROW, index_type, x->concurrently);
     } else if (auto x = std::dynamic_pointer_cast<ast::DropIndex>(query->parse)) {
         // drop index
         plannerRoot = std::make_shared<DDLPlan>(T_DropIndex, x->tab_name, x->col_names, std::vector<ColDef>());
@@ -348,41 +929,15 @@ std::shared_ptr<Plan> Planner::do_planner(std::shared_ptr<Query> query, Context
                                                     query->values, std::vector<Condition>(), std::vector<SetClause>());
     } else if (auto x = std::dynamic_pointer_cast<ast::DeleteStmt>(query->parse)) {
         // delete;
-        // 生成表扫描方式
-        std::shared_ptr<Plan> table_scan_executors;
         // 只有一张表，不需要进行物理优化了
-        // int index_no = get_indexNo(x->tab_name, query->conds);
-        std::vector<std::string> index_col_names;
-        bool index_exist = get_index_cols(x->tab_name, query->conds, index_col_names);
-        
-        if (index_exist == false) {  // 该表没有索引
-            index_col_names.clear();
-            table_scan_executors = 
-                std::make_shared<ScanPlan>(T_SeqScan, sm_manager_, x->tab_name, query->conds, index_col_names);
-        } else {  // 存在索引
-            table_scan_executors =
-                std::make_shared<ScanPlan>(T_IndexScan, sm_manager_, x->tab_name, query->conds, index_col_names);
-        }
+        std::shared_ptr<Plan> table_scan_executors = make_scan_plan(x->tab_name, query->conds);
 
         plannerRoot = std::make_shared<DMLPlan>(T_Delete, table_scan_executors, x->tab_name,  
                                                 std::vector<Value>(), query->conds, std::vector<SetClause>());
     } else if (auto x = std::dynamic_pointer_cast<ast::UpdateStmt>(query->parse)) {
         // update;
-        // 生成表扫描方式
-        std::shared_ptr<Plan> table_scan_executors;
         // 只有一张表，不需要进行物理优化了
-        // int index_no = get_indexNo(x->tab_name, query->conds);
-        std::vector<std::string> index_col_names;
-        bool index_exist = get_index_cols(x->tab_name, query->conds, index_col_names);
-
-        if (index_exist == false) {  // 该表没有索引
-        index_col_names.clear();
-            table_scan_executors = 
-                std::make_shared<ScanPlan>(T_SeqScan, sm_manager_, x->tab_name, query->conds, index_col_names);
-        } else {  // 存在索引
-            table_scan_executors =
-                std::make_shared<ScanPlan>(T_IndexScan, sm_manager_, x->tab_name, query->conds, index_col_names);
-        }
+        std::shared_ptr<Plan> table_scan_executors = make_scan_plan(x->tab_name, query->conds);
         plannerRoot = std::make_shared<DMLPlan>(T_Update, table_scan_executors, x->tab_name,
                                                      std::vector<Value>(), query->conds, 
                                                      query->set_clauses);
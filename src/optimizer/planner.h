@@ -22,6 +22,7 @@ See the Mulan PSL v2 for more details. */
 #include "system/sm.h"
 #include "common/context.h"
 #include "plan.h"
+#include "cost_model.h"
 #include "parser/parser.h"
 #include "common/common.h"
 #include "analyze/analyze.h"
@@ -42,17 +43,47 @@ class Planner {
 
     std::shared_ptr<Plan> make_one_rel(std::shared_ptr<Query> query);
 
+    std::shared_ptr<Plan> make_cost_based_rel(std::shared_ptr<Query> query, CostModel &cost_model);
+
+    std::shared_ptr<Plan> make_sublink_joins(std::shared_ptr<Query> query, std::shared_ptr<Plan> plan,
+                                             Context *context);
+
+    std::shared_ptr<Plan> make_scan_plan(const std::string &tab_name, const std::vector<Condition> &conds);
+
+    std::shared_ptr<Plan> generate_agg_plan(std::shared_ptr<Query> query, std::shared_ptr<Plan> plan);
+
     std::shared_ptr<Plan> generate_sort_plan(std::shared_ptr<Query> query, std::shared_ptr<Plan> plan);
+
+    std::shared_ptr<Plan> generate_limit_plan(std::shared_ptr<Query> query, std::shared_ptr<Plan> plan);
     
     std::shared_ptr<Plan> generate_select_plan(std::shared_ptr<Query> query, Context *context);
 
+    void push_down_predicates(const std::shared_ptr<Plan> &plan);
+
+    void choose_join_method(const std::shared_ptr<Plan> &plan);
+
+    bool ordered_on(const std::shared_ptr<Plan> &plan, const TabCol &col, bool apply);
+
+    void use_index_only_scan(const std::vector<TabCol> &sel_cols, const std::shared_ptr<Plan> &plan);
+
+    void use_parallel_scan(const std::shared_ptr<Plan> &plan);
+
+    std::shared_ptr<Plan> push_down_projection(std::shared_ptr<Plan> plan, std::vector<TabCol> needed, bool narrow);
+
 
     // int get_indexNo(std::string tab_name, std::vector<Condition> curr_conds);
     bool get_index_cols(std::string tab_name, std::vector<Condition> curr_conds, std::vector<std::string>& index_col_names);
 
+    PlanTag index_scan_tag(const std::string &tab_name, const std::vector<std::string> &index_col_names);
+
+    PartitionDef interp_partition(const ast::PartitionBy &partition);
+
+    int interp_encoding(const ast::ColDef &col_def);
+
     ColType interp_sv_type(ast::SvType sv_type) {
         std::map<ast::SvType, ColType> m = {
-            {ast::SV_TYPE_INT, TYPE_INT}, {ast::SV_TYPE_FLOAT, TYPE_FLOAT}, {ast::SV_TYPE_STRING, TYPE_STRING}};
+            {ast::SV_TYPE_INT, TYPE_INT}, {ast::SV_TYPE_FLOAT, TYPE_FLOAT}, {ast::SV_TYPE_STRING, TYPE_STRING},
+            {ast::SV_TYPE_VARCHAR, TYPE_VARCHAR}};
         return m.at(sv_type);
     }
 };
@@ -19,11 +19,12 @@ enum JoinType {
 namespace ast {
 
 enum SvType {
-    SV_TYPE_INT, SV_TYPE_FLOAT, SV_TYPE_STRING
+    SV_TYPE_INT, SV_TYPE_FLOAT, SV_TYPE_STRING, SV_TYPE_VARCHAR
 };
 
 enum SvCompOp {
-    SV_OP_EQ, SV_OP_NE, SV_OP_LT, SV_OP_GT, SV_OP_LE, SV_OP_GE
+    SV_OP_EQ, SV_OP_NE, SV_OP_LT, SV_OP_GT, SV_OP_LE, SV_OP_GE,
+    SV_OP_IN, SV_OP_NOT_IN, SV_OP_EXISTS, SV_OP_NOT_EXISTS
 };
 
 enum OrderByDir {
@@ -32,6 +33,10 @@ enum OrderByDir {
     OrderBy_DESC
 };
 
+enum SvAggType {
+    SV_AGG_COUNT, SV_AGG_SUM, SV_AGG_MIN, SV_AGG_MAX, SV_AGG_AVG
+};
+
 // Base class for tree nodes
 struct TreeNode {
     virtual ~TreeNode() = default;  // enable polymorphism
@@ -43,6 +48,12 @@ struct Help : public TreeNode {
 struct ShowTables : public TreeNode {
 };
 
+struct ShowBufferStats : public TreeNode {
+};
+
+struct ShowMetrics : public TreeNode {
+};
+
 struct TxnBegin : public TreeNode {
 };
 
@@ -68,17 +79,52 @@ struct Field : public TreeNode {
 struct ColDef : public Field {
     std::string col_name;
     std::shared_ptr<TypeLen> type_len;
+    std::string encoding;       // ENCODING选项，为空表示不编码，由planner检查
+    int dict_width;             // ENCODING = DICT(n)中编码的字节数，不指定时为0
+
+    ColDef(std::string col_name_, std::shared_ptr<TypeLen> type_len_, std::string encoding_ = "",
+           int dict_width_ = 0) :
+            col_name(std::move(col_name_)), type_len(std::move(type_len_)), encoding(std::move(encoding_)),
+            dict_width(dict_width_) {}
+};
 
-    ColDef(std::string col_name_, std::shared_ptr<TypeLen> type_len_) :
-            col_name(std::move(col_name_)), type_len(std::move(type_len_)) {}
+struct Value;
+
+/* RANGE分区中的一个分区：分区键小于bound的记录，bound为空表示MAXVALUE */
+struct RangePartition : public TreeNode {
+    std::string name;
+    std::shared_ptr<Value> bound;
+
+    RangePartition(std::string name_, std::shared_ptr<Value> bound_) :
+            name(std::move(name_)), bound(std::move(bound_)) {}
+};
+
+/* PARTITION BY子句：HASH分区给出分区数，RANGE分区给出各分区的上界 */
+struct PartitionBy : public TreeNode {
+    std::string method;     // RANGE或HASH，由planner检查
+    std::string col_name;
+    int num_partitions;
+    std::vector<std::shared_ptr<RangePartition>> ranges;
+
+    PartitionBy(std::string method_, std::string col_name_, int num_partitions_) :
+            method(std::move(method_)), col_name(std::move(col_name_)), num_partitions(num_partitions_) {}
+
+    PartitionBy(std::string method_, std::string col_name_, std::vector<std::shared_ptr<RangePartition>> ranges_) :
+            method(std::move(method_)), col_name(std::move(col_name_)), num_partitions(0),
+            ranges(std::move(ranges_)) {}
 };
 
 struct CreateTable : public TreeNode {
     std::string tab_name;
     std::vector<std::shared_ptr<Field>> fields;
+    std::string storage;    // STORAGE子句指定的存储方式，为空表示未指定
+    std::string compression;    // COMPRESSION子句指定的页面压缩方式，为空表示未指定
+    std::shared_ptr<PartitionBy> partition;     // 为空表示不分区
 
-    CreateTable(std::string tab_name_, std::vector<std::shared_ptr<Field>> fields_) :
-            tab_name(std::move(tab_name_)), fields(std::move(fields_)) {}
+    CreateTable(std::string tab_name_, std::vector<std::shared_ptr<Field>> fields_, std::string storage_ = "",
+                std::string compression_ = "", std::shared_ptr<PartitionBy> partition_ = nullptr) :
+            tab_name(std::move(tab_name_)), fields(std::move(fields_)), storage(std::move(storage_)),
+            compression(std::move(compression_)), partition(std::move(partition_)) {}
 };
 
 struct DropTable : public TreeNode {
@@ -93,12 +139,29 @@ struct DescTable : public TreeNode {
     DescTable(std::string tab_name_) : tab_name(std::move(tab_name_)) {}
 };
 
+struct VacuumTable : public TreeNode {
+    std::string tab_name;
+
+    VacuumTable(std::string tab_name_) : tab_name(std::move(tab_name_)) {}
+};
+
+// tab_name为空时收集所有表的统计信息
+struct AnalyzeTable : public TreeNode {
+    std::string tab_name;
+
+    AnalyzeTable(std::string tab_name_) : tab_name(std::move(tab_name_)) {}
+};
+
 struct CreateIndex : public TreeNode {
     std::string tab_name;
     std::vector<std::string> col_names;
+    std::string method;     // USING子句指定的索引类型，为空表示未指定
+    bool concurrently;      // CREATE INDEX CONCURRENTLY，建索引期间不阻塞表上的读写
 
-    CreateIndex(std::string tab_name_, std::vector<std::string> col_names_) :
-            tab_name(std::move(tab_name_)), col_names(std::move(col_names_)) {}
+    CreateIndex(std::string tab_name_, std::vector<std::string> col_names_, std::string method_ = "",
+                bool concurrently_ = false) :
+            tab_name(std::move(tab_name_)), col_names(std::move(col_names_)), method(std::move(method_)),
+            concurrently(concurrently_) {}
 };
 
 struct DropIndex : public TreeNode {
@@ -133,6 +196,10 @@ struct StringLit : public Value {
     StringLit(std::string val_) : val(std::move(val_)) {}
 };
 
+// 预编译语句中的参数占位符'?'，执行时绑定实际的值
+struct Placeholder : public Value {
+};
+
 struct Col : public Expr {
     std::string tab_name;
     std::string col_name;
@@ -141,6 +208,23 @@ struct Col : public Expr {
             tab_name(std::move(tab_name_)), col_name(std::move(col_name_)) {}
 };
 
+// select列表中的聚合函数，COUNT(*)的col_name为"*"
+struct AggCol : public Col {
+    SvAggType agg_type;
+
+    AggCol(std::string tab_name_, std::string col_name_, SvAggType agg_type_) :
+            Col(std::move(tab_name_), std::move(col_name_)), agg_type(agg_type_) {}
+};
+
+struct SelectStmt;
+
+// where条件中的子查询，作为IN/NOT IN的右侧或者EXISTS/NOT EXISTS的参数
+struct SubqueryExpr : public Expr {
+    std::shared_ptr<SelectStmt> stmt;
+
+    SubqueryExpr(std::shared_ptr<SelectStmt> stmt_) : stmt(std::move(stmt_)) {}
+};
+
 struct SetClause : public TreeNode {
     std::string col_name;
     std::shared_ptr<Value> val;
@@ -149,6 +233,7 @@ struct SetClause : public TreeNode {
             col_name(std::move(col_name_)), val(std::move(val_)) {}
 };
 
+// EXISTS/NOT EXISTS条件没有左侧字段，lhs为空
 struct BinaryExpr : public TreeNode {
     std::shared_ptr<Col> lhs;
     SvCompOp op;
@@ -174,6 +259,14 @@ struct InsertStmt : public TreeNode {
             tab_name(std::move(tab_name_)), vals(std::move(vals_)) {}
 };
 
+struct LoadData : public TreeNode {
+    std::string file_name;
+    std::string tab_name;
+
+    LoadData(std::string file_name_, std::string tab_name_) :
+            file_name(std::move(file_name_)), tab_name(std::move(tab_name_)) {}
+};
+
 struct DeleteStmt : public TreeNode {
     std::string tab_name;
     std::vector<std::shared_ptr<BinaryExpr>> conds;
@@ -193,6 +286,39 @@ struct UpdateStmt : public TreeNode {
             tab_name(std::move(tab_name_)), set_clauses(std::move(set_clauses_)), conds(std::move(conds_)) {}
 };
 
+// PREPARE name AS stmt
+struct PrepareStmt : public TreeNode {
+    std::string name;
+    std::shared_ptr<TreeNode> stmt;
+
+    PrepareStmt(std::string name_, std::shared_ptr<TreeNode> stmt_) :
+            name(std::move(name_)), stmt(std::move(stmt_)) {}
+};
+
+// EXECUTE name (v1, v2, ...)
+struct ExecuteStmt : public TreeNode {
+    std::string name;
+    std::vector<std::shared_ptr<Value>> vals;
+
+    ExecuteStmt(std::string name_, std::vector<std::shared_ptr<Value>> vals_) :
+            name(std::move(name_)), vals(std::move(vals_)) {}
+};
+
+// DEALLOCATE name
+struct DeallocateStmt : public TreeNode {
+    std::string name;
+
+    DeallocateStmt(std::string name_) : name(std::move(name_)) {}
+};
+
+// EXPLAIN [ANALYZE] stmt，analyze为true时执行语句并统计每个算子的执行情况
+struct ExplainStmt : public TreeNode {
+    std::shared_ptr<TreeNode> stmt;
+    bool analyze;
+
+    ExplainStmt(std::shared_ptr<TreeNode> stmt_, bool analyze_) : stmt(std::move(stmt_)), analyze(analyze_) {}
+};
+
 struct JoinExpr : public TreeNode {
     std::string left;
     std::string right;
@@ -209,28 +335,58 @@ struct SelectStmt : public TreeNode {
     std::vector<std::string> tabs;
     std::vector<std::shared_ptr<BinaryExpr>> conds;
     std::vector<std::shared_ptr<JoinExpr>> jointree;
+    std::vector<std::shared_ptr<Col>> groupby;      // GROUP BY的分组列
 
     
     bool has_sort;
-    std::shared_ptr<OrderBy> order;
+    std::vector<std::shared_ptr<OrderBy>> order;    // ORDER BY的排序键，按优先级排列
+    int limit;                                      // LIMIT的元组个数，没有LIMIT时为-1
 
 
     SelectStmt(std::vector<std::shared_ptr<Col>> cols_,
                std::vector<std::string> tabs_,
                std::vector<std::shared_ptr<BinaryExpr>> conds_,
-               std::shared_ptr<OrderBy> order_) :
+               std::vector<std::shared_ptr<Col>> groupby_,
+               std::vector<std::shared_ptr<OrderBy>> order_,
+               int limit_ = -1) :
             cols(std::move(cols_)), tabs(std::move(tabs_)), conds(std::move(conds_)), 
-            order(std::move(order_)) {
-                has_sort = (bool)order;
+            groupby(std::move(groupby_)), order(std::move(order_)), limit(limit_) {
+                has_sort = !order.empty();
             }
 };
 
+/**
+ * create materialized view语句，col_names为空时视图的字段名由select列表给出，refresh为空表示未指定刷新方式。
+ * 解析器记下select语句在SQL中的起始位置，解析完成后把从这里到语句末尾的文本写入definition，作为视图的定义保存
+ */
+struct CreateMatView : public TreeNode {
+    std::string tab_name;
+    std::vector<std::string> col_names;
+    std::string refresh;
+    std::shared_ptr<SelectStmt> select;
+    int def_line;       // select语句在SQL中的起始行，从1开始
+    int def_column;     // select语句在SQL中的起始列，从1开始
+    std::string definition;
+
+    CreateMatView(std::string tab_name_, std::vector<std::string> col_names_, std::string refresh_,
+                  std::shared_ptr<SelectStmt> select_, int def_line_, int def_column_) :
+            tab_name(std::move(tab_name_)), col_names(std::move(col_names_)), refresh(std::move(refresh_)),
+            select(std::move(select_)), def_line(def_line_), def_column(def_column_) {}
+};
+
+struct RefreshMatView : public TreeNode {
+    std::string tab_name;
+
+    RefreshMatView(std::string tab_name_) : tab_name(std::move(tab_name_)) {}
+};
+
 // Semantic value
 struct SemValue {
     int sv_int;
     float sv_float;
     std::string sv_str;
     OrderByDir sv_orderby_dir;
+    SvAggType sv_agg_type;
     std::vector<std::string> sv_strs;
 
     std::shared_ptr<TreeNode> sv_node;
@@ -257,9 +413,12 @@ struct SemValue {
     std::vector<std::shared_ptr<BinaryExpr>> sv_conds;
 
     std::shared_ptr<OrderBy> sv_orderby;
-};
+    std::vector<std::shared_ptr<OrderBy>> sv_orderbys;
 
-extern std::shared_ptr<ast::TreeNode> parse_tree;
+    std::shared_ptr<PartitionBy> sv_partition;
+    std::shared_ptr<RangePartition> sv_range;
+    std::vector<std::shared_ptr<RangePartition>> sv_ranges;
+};
 
 }
 
@@ -46,6 +46,7 @@ private:
                 {SV_TYPE_INT,    "INT"},
                 {SV_TYPE_FLOAT,  "FLOAT"},
                 {SV_TYPE_STRING, "STRING"},
+                {SV_TYPE_VARCHAR, "VARCHAR"},
         };
         return m.at(type);
     }
@@ -58,6 +59,10 @@ private:
                 {SV_OP_GT, ">"},
                 {SV_OP_LE, "<="},
                 {SV_OP_GE, ">="},
+                {SV_OP_IN, "IN"},
+                {SV_OP_NOT_IN, "NOT_IN"},
+                {SV_OP_EXISTS, "EXISTS"},
+                {SV_OP_NOT_EXISTS, "NOT_EXISTS"},
         };
         return m.at(op);
     }
@@ -79,16 +84,49 @@ private:
             std::cout << "HELP\n";
         } else if (auto x = std::dynamic_pointer_cast<ShowTables>(node)) {
             std::cout << "SHOW_TABLES\n";
+        } else if (auto x = std::dynamic_pointer_cast<ShowBufferStats>(node)) {
+            std::cout << "SHOW_BUFFER_STATS\n";
+        } else if (auto x = std::dynamic_pointer_cast<ShowMetrics>(node)) {
+            std::cout << "SHOW_METRICS\n";
         } else if (auto x = std::dynamic_pointer_cast<CreateTable>(node)) {
             std::cout << "CREATE_TABLE\n";
             print_val(x->tab_name, offset);
             print_node_list(x->fields, offset);
+            if (!x->storage.empty()) {
+                print_val(x->storage, offset);
+            }
+            if (!x->compression.empty()) {
+                print_val(x->compression, offset);
+            }
+            if (x->partition) {
+                print_val(x->partition->method, offset);
+                print_val(x->partition->col_name, offset);
+            }
+        } else if (auto x = std::dynamic_pointer_cast<CreateMatView>(node)) {
+            std::cout << "CREATE_MATERIALIZED_VIEW\n";
+            print_val(x->tab_name, offset);
+            for (auto &col_name : x->col_names) {
+                print_val(col_name, offset);
+            }
+            if (!x->refresh.empty()) {
+                print_val(x->refresh, offset);
+            }
+            print_node(x->select, offset);
+        } else if (auto x = std::dynamic_pointer_cast<RefreshMatView>(node)) {
+            std::cout << "REFRESH_MATERIALIZED_VIEW\n";
+            print_val(x->tab_name, offset);
         } else if (auto x = std::dynamic_pointer_cast<DropTable>(node)) {
             std::cout << "DROP_TABLE\n";
             print_val(x->tab_name, offset);
         } else if (auto x = std::dynamic_pointer_cast<DescTable>(node)) {
             std::cout << "DESC_TABLE\n";
             print_val(x->tab_name, offset);
+        } else if (auto x = std::dynamic_pointer_cast<VacuumTable>(node)) {
+            std::cout << "VACUUM_TABLE\n";
+            print_val(x->tab_name, offset);
+        } else if (auto x = std::dynamic_pointer_cast<AnalyzeTable>(node)) {
+            std::cout << "ANALYZE_TABLE\n";
+            print_val(x->tab_name, offset);
         } else if (auto x = std::dynamic_pointer_cast<CreateIndex>(node)) {
             std::cout << "CREATE_INDEX\n";
             print_val(x->tab_name, offset);
@@ -105,6 +143,9 @@ private:
             std::cout << "COL_DEF\n";
             print_val(x->col_name, offset);
             print_node(x->type_len, offset);
+            if (!x->encoding.empty()) {
+                print_val(x->encoding, offset);
+            }
         } else if (auto x = std::dynamic_pointer_cast<Col>(node)) {
             std::cout << "COL\n";
             print_val(x->tab_name, offset);
@@ -122,19 +163,30 @@ private:
         } else if (auto x = std::dynamic_pointer_cast<StringLit>(node)) {
             std::cout << "STRING_LIT\n";
             print_val(x->val, offset);
+        } else if (auto x = std::dynamic_pointer_cast<Placeholder>(node)) {
+            std::cout << "PLACEHOLDER\n";
+        } else if (auto x = std::dynamic_pointer_cast<SubqueryExpr>(node)) {
+            std::cout << "SUBQUERY\n";
+            print_node(x->stmt, offset);
         } else if (auto x = std::dynamic_pointer_cast<SetClause>(node)) {
             std::cout << "SET_CLAUSE\n";
             print_val(x->col_name, offset);
             print_node(x->val, offset);
         } else if (auto x = std::dynamic_pointer_cast<BinaryExpr>(node)) {
             std::cout << "BINARY_EXPR\n";
-            print_node(x->lhs, offset);
+            if (x->lhs != nullptr) {
+                print_node(x->lhs, offset);
+            }
             print_val(op2str(x->op), offset);
             print_node(x->rhs, offset);
         } else if (auto x = std::dynamic_pointer_cast<InsertStmt>(node)) {
             std::cout << "INSERT\n";
             print_val(x->tab_name, offset);
             print_node_list(x->vals, offset);
+        } else if (auto x = std::dynamic_pointer_cast<LoadData>(node)) {
+            std::cout << "LOAD_DATA\n";
+            print_val(x->file_name, offset);
+            print_val(x->tab_name, offset);
         } else if (auto x = std::dynamic_pointer_cast<DeleteStmt>(node)) {
             std::cout << "DELETE\n";
             print_val(x->tab_name, offset);
@@ -149,6 +201,20 @@ private:
             print_node_list(x->cols, offset);
             print_val_list(x->tabs, offset);
             print_node_list(x->conds, offset);
+        } else if (auto x = std::dynamic_pointer_cast<PrepareStmt>(node)) {
+            std::cout << "PREPARE\n";
+            print_val(x->name, offset);
+            print_node(x->stmt, offset);
+        } else if (auto x = std::dynamic_pointer_cast<ExecuteStmt>(node)) {
+            std::cout << "EXECUTE\n";
+            print_val(x->name, offset);
+            print_node_list(x->vals, offset);
+        } else if (auto x = std::dynamic_pointer_cast<DeallocateStmt>(node)) {
+            std::cout << "DEALLOCATE\n";
+            print_val(x->name, offset);
+        } else if (auto x = std::dynamic_pointer_cast<ExplainStmt>(node)) {
+            std::cout << (x->analyze ? "EXPLAIN_ANALYZE\n" : "EXPLAIN\n");
+            print_node(x->stmt, offset);
         } else if (auto x = std::dynamic_pointer_cast<TxnBegin>(node)) {
             std::cout << "BEGIN\n";
         } else if (auto x = std::dynamic_pointer_cast<TxnCommit>(node)) {
@@ -10,12 +10,40 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ast.h"
 #include "defs.h"
 
-int yyparse();
+/**
+ * @brief 可重入的SQL解析器，词法分析器的状态保存在对象内部而不是全局变量中
+ * @description 每个客户端连接持有一个SqlParser，不同连接可以在多个线程中同时解析；同一个对象不能被并发使用
+ */
+class SqlParser {
+   public:
+    SqlParser();
+    ~SqlParser();
+
+    SqlParser(const SqlParser &) = delete;
+    SqlParser &operator=(const SqlParser &) = delete;
 
-typedef struct yy_buffer_state *YY_BUFFER_STATE;
+    /**
+     * @brief 解析一条SQL语句
+     * @param sql 以'\0'结尾的SQL语句
+     * @param tree 解析成功时返回语法树，exit和空语句返回nullptr
+     * @return 是否解析成功
+     */
+    bool parse(const char *sql, std::shared_ptr<ast::TreeNode> *tree);
 
-YY_BUFFER_STATE yy_scan_string(const char *str);
+    /**
+     * @brief 把一个请求中以';'分隔的多条语句拆开，字符串和注释中的';'不作为分隔符
+     * @param sql 以'\0'结尾的请求
+     * @param stmts 返回每条语句，包含结尾的';'
+     */
+    void split(const char *sql, std::vector<std::string> *stmts);
 
-void yy_delete_buffer(YY_BUFFER_STATE buffer);
+   private:
+    void *scanner_;  // flex的yyscan_t
+};
@@ -34,18 +34,17 @@ int main() {
         "help;",
         "",
     };
+    SqlParser parser;
     for (auto &sql : sqls) {
         std::cout << sql << std::endl;
-        YY_BUFFER_STATE buf = yy_scan_string(sql.c_str());
-        assert(yyparse() == 0);
-        if (ast::parse_tree != nullptr) {
-            ast::TreePrinter::print(ast::parse_tree);
-            yy_delete_buffer(buf);
+        std::shared_ptr<ast::TreeNode> tree;
+        assert(parser.parse(sql.c_str(), &tree));
+        if (tree != nullptr) {
+            ast::TreePrinter::print(tree);
             std::cout << std::endl;
         } else {
             std::cout << "exit/EOF" << std::endl;
         }
     }
-    ast::parse_tree.reset();
     return 0;
 }
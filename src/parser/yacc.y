@@ -1,12 +1,22 @@
+%code requires {
+#include <memory>
+
+// the reentrant scanner handle, same definition as the one generated by flex
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void *yyscan_t;
+#endif
+}
+
 %{
 #include "ast.h"
 #include "yacc.tab.h"
 #include <iostream>
 #include <memory>
 
-int yylex(YYSTYPE *yylval, YYLTYPE *yylloc);
+int yylex(YYSTYPE *yylval, YYLTYPE *yylloc, yyscan_t scanner);
 
-void yyerror(YYLTYPE *locp, const char* s) {
+void yyerror(YYLTYPE *locp, yyscan_t scanner, std::shared_ptr<ast::TreeNode> *tree, const char* s) {
     std::cerr << "Parser Error at line " << locp->first_line << " column " << locp->first_column << ": " << s << std::endl;
 }
 
@@ -15,14 +25,20 @@ using namespace ast;
 
 // request a pure (reentrant) parser
 %define api.pure full
+// the scanner state is passed through the parser instead of living in globals,
+// and the parse tree is returned through the tree argument
+%lex-param {yyscan_t scanner}
+%parse-param {yyscan_t scanner} {std::shared_ptr<ast::TreeNode> *tree}
 // enable location in error handler
 %locations
 // enable verbose syntax error message
 %define parse.error verbose
 
 // keywords
-%token SHOW TABLES CREATE TABLE DROP DESC INSERT INTO VALUES DELETE FROM ASC ORDER BY
-WHERE UPDATE SET SELECT INT CHAR FLOAT INDEX AND JOIN EXIT HELP TXN_BEGIN TXN_COMMIT TXN_ABORT TXN_ROLLBACK ORDER_BY
+%token SHOW TABLES BUFFER STATS METRICS LOAD DATA CREATE TABLE DROP DESC INSERT INTO VALUES DELETE FROM ASC ORDER BY
+WHERE UPDATE SET SELECT INT CHAR VARCHAR FLOAT STORAGE USING VACUUM ANALYZE INDEX CONCURRENTLY AND JOIN EXIT HELP TXN_BEGIN TXN_COMMIT TXN_ABORT TXN_ROLLBACK ORDER_BY LIMIT
+GROUP COUNT SUM MIN MAX AVG PREPARE EXECUTE DEALLOCATE AS EXPLAIN NOT IN EXISTS
+PARTITION PARTITIONS LESS THAN MAXVALUE COMPRESSION ENCODING MATERIALIZED VIEW REFRESH
 // non-keywords
 %token LEQ NEQ GEQ T_EOF
 
@@ -32,7 +48,7 @@ WHERE UPDATE SET SELECT INT CHAR FLOAT INDEX AND JOIN EXIT HELP TXN_BEGIN TXN_CO
 %token <sv_float> VALUE_FLOAT
 
 // specify types for non-terminal symbol
-%type <sv_node> stmt dbStmt ddl dml txnStmt
+%type <sv_node> stmt dbStmt ddl dml txnStmt prepStmt explainStmt selectStmt
 %type <sv_field> field
 %type <sv_fields> fieldList
 %type <sv_type_len> type
@@ -41,36 +57,44 @@ WHERE UPDATE SET SELECT INT CHAR FLOAT INDEX AND JOIN EXIT HELP TXN_BEGIN TXN_CO
 %type <sv_val> value
 %type <sv_vals> valueList
 %type <sv_str> tbName colName
-%type <sv_strs> tableList colNameList
+%type <sv_strs> tableList colNameList optViewCols
 %type <sv_col> col
-%type <sv_cols> colList selector
+%type <sv_col> selItem
+%type <sv_cols> colList selector selList opt_group_clause
+%type <sv_agg_type> aggFunc
 %type <sv_set_clause> setClause
 %type <sv_set_clauses> setClauses
 %type <sv_cond> condition
 %type <sv_conds> whereClause optWhereClause
-%type <sv_orderby>  order_clause opt_order_clause
+%type <sv_orderby>  order_item
+%type <sv_orderbys> order_clause opt_order_clause
 %type <sv_orderby_dir> opt_asc_desc
+%type <sv_int> opt_limit_clause
+%type <sv_str> optStorage optCompression optRefresh
+%type <sv_partition> optPartition
+%type <sv_range> rangePartition
+%type <sv_ranges> rangePartitionList
 
 %%
 start:
         stmt ';'
     {
-        parse_tree = $1;
+        *tree = $1;
         YYACCEPT;
     }
     |   HELP
     {
-        parse_tree = std::make_shared<Help>();
+        *tree = std::make_shared<Help>();
         YYACCEPT;
     }
     |   EXIT
     {
-        parse_tree = nullptr;
+        *tree = nullptr;
         YYACCEPT;
     }
     |   T_EOF
     {
-        parse_tree = nullptr;
+        *tree = nullptr;
         YYACCEPT;
     }
     ;
@@ -80,6 +104,38 @@ stmt:
     |   ddl
     |   dml
     |   txnStmt
+    |   prepStmt
+    |   explainStmt
+    ;
+
+explainStmt:
+        EXPLAIN dml
+    {
+        $$ = std::make_shared<ExplainStmt>($2, false);
+    }
+    |   EXPLAIN ANALYZE dml
+    {
+        $$ = std::make_shared<ExplainStmt>($3, true);
+    }
+    ;
+
+prepStmt:
+        PREPARE IDENTIFIER AS dml
+    {
+        $$ = std::make_shared<PrepareStmt>($2, $4);
+    }
+    |   EXECUTE IDENTIFIER
+    {
+        $$ = std::make_shared<ExecuteStmt>($2, std::vector<std::shared_ptr<Value>>{});
+    }
+    |   EXECUTE IDENTIFIER '(' valueList ')'
+    {
+        $$ = std::make_shared<ExecuteStmt>($2, $4);
+    }
+    |   DEALLOCATE IDENTIFIER
+    {
+        $$ = std::make_shared<DeallocateStmt>($2);
+    }
     ;
 
 txnStmt:
@@ -106,12 +162,20 @@ dbStmt:
     {
         $$ = std::make_shared<ShowTables>();
     }
+    |   SHOW BUFFER STATS
+    {
+        $$ = std::make_shared<ShowBufferStats>();
+    }
+    |   SHOW METRICS
+    {
+        $$ = std::make_shared<ShowMetrics>();
+    }
     ;
 
 ddl:
-        CREATE TABLE tbName '(' fieldList ')'
+        CREATE TABLE tbName '(' fieldList ')' optStorage optCompression optPartition
     {
-        $$ = std::make_shared<CreateTable>($3, $5);
+        $$ = std::make_shared<CreateTable>($3, $5, $7, $8, $9);
     }
     |   DROP TABLE tbName
     {
@@ -121,14 +185,47 @@ ddl:
     {
         $$ = std::make_shared<DescTable>($2);
     }
+    |   VACUUM tbName
+    {
+        $$ = std::make_shared<VacuumTable>($2);
+    }
+    |   ANALYZE tbName
+    {
+        $$ = std::make_shared<AnalyzeTable>($2);
+    }
+    |   ANALYZE
+    {
+        $$ = std::make_shared<AnalyzeTable>("");
+    }
     |   CREATE INDEX tbName '(' colNameList ')'
     {
         $$ = std::make_shared<CreateIndex>($3, $5);
     }
+    |   CREATE INDEX tbName '(' colNameList ')' USING IDENTIFIER
+    {
+        $$ = std::make_shared<CreateIndex>($3, $5, $8);
+    }
+    |   CREATE INDEX CONCURRENTLY tbName '(' colNameList ')'
+    {
+        $$ = std::make_shared<CreateIndex>($4, $6, "", true);
+    }
+    |   CREATE INDEX CONCURRENTLY tbName '(' colNameList ')' USING IDENTIFIER
+    {
+        $$ = std::make_shared<CreateIndex>($4, $6, $9, true);
+    }
     |   DROP INDEX tbName '(' colNameList ')'
     {
         $$ = std::make_shared<DropIndex>($3, $5);
     }
+    |   CREATE MATERIALIZED VIEW tbName optViewCols optRefresh AS selectStmt
+    {
+        $$ = std::make_shared<CreateMatView>($4, $5, $6, std::static_pointer_cast<SelectStmt>($8),
+                                             @8.first_line, @8.first_column);
+    }
+    |   REFRESH MATERIALIZED VIEW tbName
+    {
+        $$ = std::make_shared<RefreshMatView>($4);
+    }
     ;
 
 dml:
@@ -144,9 +241,17 @@ dml:
     {
         $$ = std::make_shared<UpdateStmt>($2, $4, $5);
     }
-    |   SELECT selector FROM tableList optWhereClause opt_order_clause
+    |   LOAD DATA VALUE_STRING INTO tbName
     {
-        $$ = std::make_shared<SelectStmt>($2, $4, $5, $6);
+        $$ = std::make_shared<LoadData>($3, $5);
+    }
+    |   selectStmt
+    ;
+
+selectStmt:
+        SELECT selector FROM tableList optWhereClause opt_group_clause opt_order_clause opt_limit_clause
+    {
+        $$ = std::make_shared<SelectStmt>($2, $4, $5, $6, $7, $8);
     }
     ;
 
@@ -177,6 +282,14 @@ field:
     {
         $$ = std::make_shared<ColDef>($1, $2);
     }
+    |   colName type ENCODING '=' IDENTIFIER
+    {
+        $$ = std::make_shared<ColDef>($1, $2, $5);
+    }
+    |   colName type ENCODING '=' IDENTIFIER '(' VALUE_INT ')'
+    {
+        $$ = std::make_shared<ColDef>($1, $2, $5, $7);
+    }
     ;
 
 type:
@@ -188,6 +301,10 @@ type:
     {
         $$ = std::make_shared<TypeLen>(SV_TYPE_STRING, $3);
     }
+    |   VARCHAR '(' VALUE_INT ')'
+    {
+        $$ = std::make_shared<TypeLen>(SV_TYPE_VARCHAR, $3);
+    }
     |   FLOAT
     {
         $$ = std::make_shared<TypeLen>(SV_TYPE_FLOAT, sizeof(float));
@@ -205,6 +322,91 @@ valueList:
     }
     ;
 
+optStorage:
+        /* epsilon */
+    {
+        $$ = "";
+    }
+    |   STORAGE '=' IDENTIFIER
+    {
+        $$ = $3;
+    }
+    ;
+
+optCompression:
+        /* epsilon */
+    {
+        $$ = "";
+    }
+    |   COMPRESSION '=' IDENTIFIER
+    {
+        $$ = $3;
+    }
+    ;
+
+optViewCols:
+        /* epsilon */
+    {
+        $$ = std::vector<std::string>{};
+    }
+    |   '(' colNameList ')'
+    {
+        $$ = $2;
+    }
+    ;
+
+optRefresh:
+        /* epsilon */
+    {
+        $$ = "";
+    }
+    |   REFRESH '=' IDENTIFIER
+    {
+        $$ = $3;
+    }
+    ;
+
+optPartition:
+        /* epsilon */
+    {
+        $$ = nullptr;
+    }
+    |   PARTITION BY IDENTIFIER '(' colName ')' PARTITIONS VALUE_INT
+    {
+        $$ = std::make_shared<PartitionBy>($3, $5, $8);
+    }
+    |   PARTITION BY IDENTIFIER '(' colName ')' '(' rangePartitionList ')'
+    {
+        $$ = std::make_shared<PartitionBy>($3, $5, $8);
+    }
+    ;
+
+rangePartitionList:
+        rangePartition
+    {
+        $$ = std::vector<std::shared_ptr<RangePartition>>{$1};
+    }
+    |   rangePartitionList ',' rangePartition
+    {
+        $$.push_back($3);
+    }
+    ;
+
+rangePartition:
+        PARTITION IDENTIFIER VALUES LESS THAN '(' value ')'
+    {
+        $$ = std::make_shared<RangePartition>($2, $7);
+    }
+    |   PARTITION IDENTIFIER VALUES LESS THAN '(' MAXVALUE ')'
+    {
+        $$ = std::make_shared<RangePartition>($2, nullptr);
+    }
+    |   PARTITION IDENTIFIER VALUES LESS THAN MAXVALUE
+    {
+        $$ = std::make_shared<RangePartition>($2, nullptr);
+    }
+    ;
+
 value:
         VALUE_INT
     {
@@ -218,6 +420,10 @@ value:
     {
         $$ = std::make_shared<StringLit>($1);
     }
+    |   '?'
+    {
+        $$ = std::make_shared<Placeholder>();
+    }
     ;
 
 condition:
@@ -225,6 +431,26 @@ condition:
     {
         $$ = std::make_shared<BinaryExpr>($1, $2, $3);
     }
+    |   col IN '(' selectStmt ')'
+    {
+        $$ = std::make_shared<BinaryExpr>($1, SV_OP_IN,
+                                          std::make_shared<SubqueryExpr>(std::static_pointer_cast<SelectStmt>($4)));
+    }
+    |   col NOT IN '(' selectStmt ')'
+    {
+        $$ = std::make_shared<BinaryExpr>($1, SV_OP_NOT_IN,
+                                          std::make_shared<SubqueryExpr>(std::static_pointer_cast<SelectStmt>($5)));
+    }
+    |   EXISTS '(' selectStmt ')'
+    {
+        $$ = std::make_shared<BinaryExpr>(nullptr, SV_OP_EXISTS,
+                                          std::make_shared<SubqueryExpr>(std::static_pointer_cast<SelectStmt>($3)));
+    }
+    |   NOT EXISTS '(' selectStmt ')'
+    {
+        $$ = std::make_shared<BinaryExpr>(nullptr, SV_OP_NOT_EXISTS,
+                                          std::make_shared<SubqueryExpr>(std::static_pointer_cast<SelectStmt>($4)));
+    }
     ;
 
 optWhereClause:
@@ -329,7 +555,41 @@ selector:
     {
         $$ = {};
     }
-    |   colList
+    |   selList
+    ;
+
+selList:
+        selItem
+    {
+        $$ = std::vector<std::shared_ptr<Col>>{$1};
+    }
+    |   selList ',' selItem
+    {
+        $$.push_back($3);
+    }
+    ;
+
+selItem:
+        col
+    |   aggFunc '(' col ')'
+    {
+        $$ = std::make_shared<AggCol>($3->tab_name, $3->col_name, $1);
+    }
+    |   COUNT '(' col ')'
+    {
+        $$ = std::make_shared<AggCol>($3->tab_name, $3->col_name, SV_AGG_COUNT);
+    }
+    |   COUNT '(' '*' ')'
+    {
+        $$ = std::make_shared<AggCol>("", "*", SV_AGG_COUNT);
+    }
+    ;
+
+aggFunc:
+        SUM     { $$ = SV_AGG_SUM; }
+    |   MIN     { $$ = SV_AGG_MIN; }
+    |   MAX     { $$ = SV_AGG_MAX; }
+    |   AVG     { $$ = SV_AGG_AVG; }
     ;
 
 tableList:
@@ -347,6 +607,14 @@ tableList:
     }
     ;
 
+opt_group_clause:
+        GROUP BY colList
+    {
+        $$ = $3;
+    }
+    |   /* epsilon */ { /* ignore*/ }
+    ;
+
 opt_order_clause:
     ORDER BY order_clause      
     { 
@@ -356,6 +624,17 @@ opt_order_clause:
     ;
 
 order_clause:
+      order_item
+    {
+        $$ = std::vector<std::shared_ptr<OrderBy>>{$1};
+    }
+    |   order_clause ',' order_item
+    {
+        $$.push_back($3);
+    }
+    ;
+
+order_item:
       col  opt_asc_desc 
     { 
         $$ = std::make_shared<OrderBy>($1, $2);
@@ -368,6 +647,14 @@ opt_asc_desc:
     |       { $$ = OrderBy_DEFAULT; }
     ;    
 
+opt_limit_clause:
+        LIMIT VALUE_INT
+    {
+        $$ = $2;
+    }
+    |   /* epsilon */ { $$ = -1; }
+    ;
+
 tbName: IDENTIFIER;
 
 colName: IDENTIFIER;
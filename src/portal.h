@@ -10,19 +10,36 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <algorithm>
 #include <cerrno>
 #include <cstring>
+#include <map>
 #include <string>
 #include "optimizer/plan.h"
 #include "execution/executor_abstract.h"
+#include "execution/executor_append.h"
 #include "execution/executor_nestedloop_join.h"
+#include "execution/executor_hash_join.h"
+#include "execution/executor_hash_semi_join.h"
+#include "execution/executor_merge_join.h"
+#include "execution/executor_hash_aggregate.h"
+#include "execution/executor_stream_aggregate.h"
 #include "execution/executor_projection.h"
 #include "execution/executor_seq_scan.h"
+#include "execution/executor_parallel_seq_scan.h"
+#include "execution/executor_hash_scan.h"
+#include "execution/executor_index_only_scan.h"
 #include "execution/executor_index_scan.h"
 #include "execution/executor_update.h"
 #include "execution/executor_insert.h"
 #include "execution/executor_delete.h"
 #include "execution/execution_sort.h"
+#include "execution/executor_top_n.h"
+#include "execution/executor_limit.h"
+#include "execution/executor_instrument.h"
+#include "execution/executor_pipeline.h"
+#include "execution/executor_values.h"
+#include "optimizer/mat_view.h"
 #include "common/common.h"
 
 typedef enum portalTag{
@@ -30,7 +47,9 @@ typedef enum portalTag{
     PORTAL_ONE_SELECT,
     PORTAL_DML_WITHOUT_SELECT,
     PORTAL_MULTI_QUERY,
-    PORTAL_CMD_UTILITY
+    PORTAL_CMD_UTILITY,
+    PORTAL_EXPLAIN,
+    PORTAL_MAT_VIEW
 } portalTag;
 
 
@@ -40,6 +59,8 @@ struct PortalStmt {
     std::vector<TabCol> sel_cols;
     std::unique_ptr<AbstractExecutor> root;
     std::shared_ptr<Plan> plan;
+    // EXPLAIN ANALYZE中计划的每个节点对应的算子的执行统计，root中的统计节点指向这里
+    std::shared_ptr<std::map<const Plan *, OperatorStats>> op_stats;
     
     PortalStmt(portalTag tag_, std::vector<TabCol> sel_cols_, std::unique_ptr<AbstractExecutor> root_, std::shared_ptr<Plan> plan_) :
             tag(tag_), sel_cols(std::move(sel_cols_)), root(std::move(root_)), plan(std::move(plan_)) {}
@@ -49,17 +70,36 @@ class Portal
 {
    private:
     SmManager *sm_manager_;
-    
+    MatViewManager *mat_views_;     // 执行物化视图语句，提交事务之前维护视图；为空时不支持物化视图
 
    public:
-    Portal(SmManager *sm_manager) : sm_manager_(sm_manager){}
+    Portal(SmManager *sm_manager, MatViewManager *mat_views = nullptr)
+        : sm_manager_(sm_manager), mat_views_(mat_views) {}
     ~Portal(){}
 
-    // 将查询执行计划转换成对应的算子树
-    std::shared_ptr<PortalStmt> start(std::shared_ptr<Plan> plan, Context *context)
+    /**
+     * @brief 将查询执行计划转换成对应的算子树
+     * @param op_stats 不为空时在每个算子外面包上统计节点，执行统计记录在op_stats中计划节点对应的位置
+     */
+    std::shared_ptr<PortalStmt> start(std::shared_ptr<Plan> plan, Context *context,
+                                      std::map<const Plan *, OperatorStats> *op_stats = nullptr)
     {
         // 这里可以将select进行拆分，例如：一个select，带有return的select等
-        if (auto x = std::dynamic_pointer_cast<OtherPlan>(plan)) {
+        if (auto x = std::dynamic_pointer_cast<ExplainPlan>(plan)) {
+            // explain只输出计划；explain analyze先生成带统计节点的算子树，执行之后和计划一起输出
+            if (!x->analyze_) {
+                return std::make_shared<PortalStmt>(PORTAL_EXPLAIN, std::vector<TabCol>(),
+                                                    std::unique_ptr<AbstractExecutor>(), plan);
+            }
+            auto stats = std::make_shared<std::map<const Plan *, OperatorStats>>();
+            auto inner = start(x->subplan_, context, stats.get());
+            auto portal = std::make_shared<PortalStmt>(PORTAL_EXPLAIN, std::vector<TabCol>(), std::move(inner->root),
+                                                       plan);
+            portal->op_stats = std::move(stats);
+            return portal;
+        } else if (auto x = std::dynamic_pointer_cast<MatViewPlan>(plan)) {
+            return std::make_shared<PortalStmt>(PORTAL_MAT_VIEW, std::vector<TabCol>(), std::unique_ptr<AbstractExecutor>(), plan);
+        } else if (auto x = std::dynamic_pointer_cast<OtherPlan>(plan)) {
             return std::make_shared<PortalStmt>(PORTAL_CMD_UTILITY, std::vector<TabCol>(), std::unique_ptr<AbstractExecutor>(),plan);
         } else if (auto x = std::dynamic_pointer_cast<DDLPlan>(plan)) {
             return std::make_shared<PortalStmt>(PORTAL_MULTI_QUERY, std::vector<TabCol>(), std::unique_ptr<AbstractExecutor>(),plan);
@@ -68,31 +108,53 @@ class Portal
                 case T_select:
                 {
                     std::shared_ptr<ProjectionPlan> p = std::dynamic_pointer_cast<ProjectionPlan>(x->subplan_);
-                    std::unique_ptr<AbstractExecutor> root= convert_plan_executor(p, context);
-                    return std::make_shared<PortalStmt>(PORTAL_ONE_SELECT, std::move(p->sel_cols_), std::move(root), plan);
+                    // EXPLAIN ANALYZE需要每个计划节点各自的统计，不使用流水线
+                    std::unique_ptr<AbstractExecutor> root = op_stats == nullptr ? make_pipeline(p, context) : nullptr;
+                    if (root == nullptr) root = convert_plan_executor(p, context, op_stats);
+                    // 预编译语句的计划会被再次执行，算子只能复制计划中的内容
+                    return std::make_shared<PortalStmt>(PORTAL_ONE_SELECT, p->sel_cols_, std::move(root), plan);
                 }
                     
                 case T_Update:
                 {
-                    std::unique_ptr<AbstractExecutor> scan= convert_plan_executor(x->subplan_, context);
-                    std::vector<Rid> rids;
-                    for (scan->beginTuple(); !scan->is_end(); scan->nextTuple()) {
-                        rids.push_back(scan->rid());
+                    std::unique_ptr<AbstractExecutor> root;
+                    if (sm_manager_->db_.get_table(x->tab_name_).partition.is_partitioned()) {
+                        // 分区表上每个剩下的分区各有一个UPDATE算子
+                        std::vector<std::unique_ptr<AbstractExecutor>> children;
+                        for (auto &part : partition_scans(*x)) {
+                            children.push_back(std::make_unique<UpdateExecutor>(
+                                sm_manager_, part->tab_name_, x->set_clauses_, part->conds_,
+                                make_executor(part, context, nullptr), needs_spool(*x), context));
+                        }
+                        root = std::make_unique<AppendDmlExecutor>(std::move(children), context);
+                    } else {
+                        std::unique_ptr<AbstractExecutor> scan= convert_plan_executor(x->subplan_, context, op_stats);
+                        root =std::make_unique<UpdateExecutor>(sm_manager_, 
+                                                                x->tab_name_, x->set_clauses_, x->conds_, std::move(scan),
+                                                                needs_spool(*x), context);
                     }
-                    std::unique_ptr<AbstractExecutor> root =std::make_unique<UpdateExecutor>(sm_manager_, 
-                                                            x->tab_name_, x->set_clauses_, x->conds_, rids, context);
+                    root = instrument(std::move(root), x.get(), op_stats);
                     return std::make_shared<PortalStmt>(PORTAL_DML_WITHOUT_SELECT, std::vector<TabCol>(), std::move(root), plan);
                 }
                 case T_Delete:
                 {
-                    std::unique_ptr<AbstractExecutor> scan= convert_plan_executor(x->subplan_, context);
-                    std::vector<Rid> rids;
-                    for (scan->beginTuple(); !scan->is_end(); scan->nextTuple()) {
-                        rids.push_back(scan->rid());
-                    }
+                    std::unique_ptr<AbstractExecutor> root;
+                    if (sm_manager_->db_.get_table(x->tab_name_).partition.is_partitioned()) {
+                        // 分区表上每个剩下的分区各有一个DELETE算子
+                        std::vector<std::unique_ptr<AbstractExecutor>> children;
+                        for (auto &part : partition_scans(*x)) {
+                            children.push_back(std::make_unique<DeleteExecutor>(
+                                sm_manager_, part->tab_name_, part->conds_, make_executor(part, context, nullptr),
+                                needs_spool(*x), context));
+                        }
+                        root = std::make_unique<AppendDmlExecutor>(std::move(children), context);
+                    } else {
+                        std::unique_ptr<AbstractExecutor> scan= convert_plan_executor(x->subplan_, context, op_stats);
 
-                    std::unique_ptr<AbstractExecutor> root =
-                        std::make_unique<DeleteExecutor>(sm_manager_, x->tab_name_, x->conds_, rids, context);
+                        root = std::make_unique<DeleteExecutor>(
+                            sm_manager_, x->tab_name_, x->conds_, std::move(scan), needs_spool(*x), context);
+                    }
+                    root = instrument(std::move(root), x.get(), op_stats);
 
                     return std::make_shared<PortalStmt>(PORTAL_DML_WITHOUT_SELECT, std::vector<TabCol>(), std::move(root), plan);
                 }
@@ -101,6 +163,7 @@ class Portal
                 {
                     std::unique_ptr<AbstractExecutor> root =
                             std::make_unique<InsertExecutor>(sm_manager_, x->tab_name_, x->values_, context);
+                    root = instrument(std::move(root), x.get(), op_stats);
             
                     return std::make_shared<PortalStmt>(PORTAL_DML_WITHOUT_SELECT, std::vector<TabCol>(), std::move(root), plan);
                 }
@@ -116,6 +179,54 @@ class Portal
         return nullptr;
     }
 
+    // update/delete沿B+树索引扫描时，删除记录或修改该索引的字段会删除、移动扫描中的索引项，
+    // 需要先收集全部rid再修改；顺序扫描中记录的rid不会改变，哈希索引扫描在开始时已经取出了全部rid，可以边扫描边修改
+    bool needs_spool(const DMLPlan &plan) {
+        auto scan = std::dynamic_pointer_cast<ScanPlan>(plan.subplan_);
+        if (scan == nullptr) return true;
+        if (scan->tag != T_IndexScan && scan->tag != T_IndexOnlyScan) return false;
+        if (plan.tag == T_Delete) return true;
+        for (auto &sc : plan.set_clauses_) {
+            auto &index_cols = scan->index_col_names_;
+            if (std::find(index_cols.begin(), index_cols.end(), sc.lhs.col_name) != index_cols.end()) return true;
+        }
+        return false;
+    }
+
+    // UPDATE/DELETE的扫描计划
+    const ScanPlan &dml_scan(const DMLPlan &plan) {
+        auto scan = std::dynamic_pointer_cast<ScanPlan>(plan.subplan_);
+        if (scan == nullptr) {
+            throw InternalError("Unexpected plan under " + plan.tab_name_);
+        }
+        return *scan;
+    }
+
+    std::vector<std::shared_ptr<ScanPlan>> partition_scans(const DMLPlan &plan) {
+        return partition_scans(dml_scan(plan));
+    }
+
+    // 分区表上的扫描按绑定参数之后的条件裁剪分区，每个剩下的分区上生成一个同样的扫描，条件中分区表的表名换成分区的表名
+    std::vector<std::shared_ptr<ScanPlan>> partition_scans(const ScanPlan &scan) {
+        const PartitionMeta &partition = sm_manager_->db_.get_table(scan.tab_name_).partition;
+        std::vector<std::shared_ptr<ScanPlan>> parts;
+        for (size_t i : sm_manager_->scan_partitions(scan.tab_name_, scan.conds_)) {
+            auto part = std::make_shared<ScanPlan>(scan);
+            part->tab_name_ = partition.table_name(scan.tab_name_, i);
+            part->cols_ = sm_manager_->db_.get_table(part->tab_name_).cols;
+            for (auto *conds : {&part->conds_, &part->fed_conds_}) {
+                for (auto &cond : *conds) {
+                    if (cond.lhs_col.tab_name == scan.tab_name_) cond.lhs_col.tab_name = part->tab_name_;
+                    if (!cond.is_rhs_val && cond.rhs_col.tab_name == scan.tab_name_) {
+                        cond.rhs_col.tab_name = part->tab_name_;
+                    }
+                }
+            }
+            parts.push_back(std::move(part));
+        }
+        return parts;
+    }
+
     // 遍历算子树并执行算子生成执行结果
     void run(std::shared_ptr<PortalStmt> portal, QlManager* ql, txn_id_t *txn_id, Context *context){
         switch(portal->tag) {
@@ -137,9 +248,27 @@ class Portal
             }
             case PORTAL_CMD_UTILITY:
             {
+                // 显式事务的COMMIT在提交之前维护物化视图，维护失败时事务回滚
+                if (portal->plan->tag == T_Transaction_commit && mat_views_ != nullptr) {
+                    mat_views_->maintain(context);
+                }
                 ql->run_cmd_utility(portal->plan, txn_id, context);
                 break;
             }
+            case PORTAL_EXPLAIN:
+            {
+                ql->explain(std::static_pointer_cast<ExplainPlan>(portal->plan), std::move(portal->root),
+                            portal->op_stats.get(), context);
+                break;
+            }
+            case PORTAL_MAT_VIEW:
+            {
+                if (mat_views_ == nullptr) {
+                    throw InternalError("Materialized views are not supported here");
+                }
+                mat_views_->execute(*std::static_pointer_cast<MatViewPlan>(portal->plan), context);
+                break;
+            }
             default:
             {
                 throw InternalError("Unexpected field type");
@@ -151,28 +280,115 @@ class Portal
     void drop(){}
 
 
-    std::unique_ptr<AbstractExecutor> convert_plan_executor(std::shared_ptr<Plan> plan, Context *context)
+    /**
+     * @brief 投影之下是左深的哈希连接链时生成推送式流水线：链上各连接的右儿子是构建侧，
+     * 最左侧的输入是驱动算子，二者仍按普通计划生成算子；不满足条件时返回空，由调用者生成普通算子树
+     */
+    std::unique_ptr<AbstractExecutor> make_pipeline(const std::shared_ptr<ProjectionPlan> &plan, Context *context)
+    {
+        if (!EXEC_PUSH_PIPELINE) return nullptr;
+        std::vector<std::shared_ptr<JoinPlan>> joins;
+        std::shared_ptr<Plan> source = plan->subplan_;
+        for (auto x = std::dynamic_pointer_cast<JoinPlan>(source); x != nullptr && x->tag == T_HashJoin;
+             x = std::dynamic_pointer_cast<JoinPlan>(source)) {
+            joins.push_back(x);
+            source = x->left_;
+        }
+        if (joins.empty() || joins.size() > EXEC_PIPELINE_MAX_JOINS) return nullptr;
+        std::reverse(joins.begin(), joins.end());
+        std::vector<std::pair<std::unique_ptr<AbstractExecutor>, std::vector<Condition>>> builds;
+        for (auto &join : joins) {
+            builds.emplace_back(convert_plan_executor(join->right_, context), join->conds_);
+        }
+        return std::make_unique<PipelineExecutor>(convert_plan_executor(source, context), std::move(builds),
+                                                  plan->sel_cols_,
+                                                  [this, plan, context] { return convert_plan_executor(plan, context); });
+    }
+
+    // 把计划转换成算子，op_stats不为空时在算子外面包上统计节点
+    std::unique_ptr<AbstractExecutor> convert_plan_executor(std::shared_ptr<Plan> plan, Context *context,
+                                                            std::map<const Plan *, OperatorStats> *op_stats = nullptr)
+    {
+        return instrument(make_executor(plan, context, op_stats), plan.get(), op_stats);
+    }
+
+    std::unique_ptr<AbstractExecutor> instrument(std::unique_ptr<AbstractExecutor> executor, const Plan *plan,
+                                                 std::map<const Plan *, OperatorStats> *op_stats)
+    {
+        if (op_stats == nullptr || executor == nullptr) return executor;
+        return std::make_unique<InstrumentedExecutor>(std::move(executor), &(*op_stats)[plan]);
+    }
+
+    std::unique_ptr<AbstractExecutor> make_executor(std::shared_ptr<Plan> plan, Context *context,
+                                                    std::map<const Plan *, OperatorStats> *op_stats)
     {
         if(auto x = std::dynamic_pointer_cast<ProjectionPlan>(plan)){
-            return std::make_unique<ProjectionExecutor>(convert_plan_executor(x->subplan_, context), 
+            return std::make_unique<ProjectionExecutor>(convert_plan_executor(x->subplan_, context, op_stats), 
                                                         x->sel_cols_);
         } else if(auto x = std::dynamic_pointer_cast<ScanPlan>(plan)) {
+            if (sm_manager_->db_.get_table(x->tab_name_).partition.is_partitioned()) {
+                std::vector<std::unique_ptr<AbstractExecutor>> children;
+                for (auto &part : partition_scans(*x)) {
+                    children.push_back(make_executor(part, context, nullptr));
+                }
+                return std::make_unique<AppendExecutor>(std::move(children), x->cols_, context);
+            }
             if(x->tag == T_SeqScan) {
                 return std::make_unique<SeqScanExecutor>(sm_manager_, x->tab_name_, x->conds_, context);
             }
+            else if(x->tag == T_ParallelSeqScan) {
+                return std::make_unique<ParallelSeqScanExecutor>(sm_manager_, x->tab_name_, x->conds_, context);
+            }
+            else if(x->tag == T_HashScan) {
+                return std::make_unique<HashScanExecutor>(sm_manager_, x->tab_name_, x->conds_, x->index_col_names_, context);
+            }
+            else if(x->tag == T_IndexOnlyScan) {
+                return std::make_unique<IndexOnlyScanExecutor>(sm_manager_, x->tab_name_, x->conds_, x->index_col_names_, context);
+            }
             else {
                 return std::make_unique<IndexScanExecutor>(sm_manager_, x->tab_name_, x->conds_, x->index_col_names_, context);
             } 
         } else if(auto x = std::dynamic_pointer_cast<JoinPlan>(plan)) {
-            std::unique_ptr<AbstractExecutor> left = convert_plan_executor(x->left_, context);
-            std::unique_ptr<AbstractExecutor> right = convert_plan_executor(x->right_, context);
+            std::unique_ptr<AbstractExecutor> left = convert_plan_executor(x->left_, context, op_stats);
+            std::unique_ptr<AbstractExecutor> right = convert_plan_executor(x->right_, context, op_stats);
+            if (x->tag == T_MergeJoin) {
+                return std::make_unique<MergeJoinExecutor>(std::move(left), std::move(right), x->conds_);
+            }
+            if (x->tag == T_HashJoin) {
+                return std::make_unique<HashJoinExecutor>(std::move(left), std::move(right), x->conds_);
+            }
             std::unique_ptr<AbstractExecutor> join = std::make_unique<NestedLoopJoinExecutor>(
                                 std::move(left), 
-                                std::move(right), std::move(x->conds_));
+                                std::move(right), x->conds_);
             return join;
+        } else if (auto x = std::dynamic_pointer_cast<SemiJoinPlan>(plan)) {
+            std::unique_ptr<AbstractExecutor> left = convert_plan_executor(x->left_, context, op_stats);
+            std::unique_ptr<AbstractExecutor> right = convert_plan_executor(x->right_, context, op_stats);
+            return std::make_unique<HashSemiJoinExecutor>(std::move(left), std::move(right), x->conds_,
+                                                          x->tag == T_AntiJoin);
+        } else if(auto x = std::dynamic_pointer_cast<AggregatePlan>(plan)) {
+            std::unique_ptr<AbstractExecutor> prev = convert_plan_executor(x->subplan_, context, op_stats);
+            if (x->tag == T_StreamAggregate) {
+                return std::make_unique<StreamAggregateExecutor>(std::move(prev), x->group_cols_, x->aggs_);
+            }
+            return std::make_unique<HashAggregateExecutor>(std::move(prev), x->group_cols_, x->aggs_);
         } else if(auto x = std::dynamic_pointer_cast<SortPlan>(plan)) {
-            return std::make_unique<SortExecutor>(convert_plan_executor(x->subplan_, context), 
-                                            x->sel_col_, x->is_desc_);
+            std::unique_ptr<AbstractExecutor> prev = convert_plan_executor(x->subplan_, context, op_stats);
+            if (x->limit_ < 0) {
+                return std::make_unique<SortExecutor>(std::move(prev), x->sel_cols_, x->is_desc_);
+            }
+            // 前limit个元组能放进排序的内存预算时用堆保留它们，否则完整排序后再截取
+            size_t limit = static_cast<size_t>(x->limit_);
+            if (limit <= EXEC_SORT_MEM_SIZE / std::max<size_t>(prev->tupleLen(), 1)) {
+                return std::make_unique<TopNExecutor>(std::move(prev), x->sel_cols_, x->is_desc_, limit);
+            }
+            return std::make_unique<LimitExecutor>(
+                std::make_unique<SortExecutor>(std::move(prev), x->sel_cols_, x->is_desc_), limit);
+        } else if(auto x = std::dynamic_pointer_cast<ValuesPlan>(plan)) {
+            return std::make_unique<ValuesExecutor>(x->cols_, x->conds_, x->rows_, context);
+        } else if(auto x = std::dynamic_pointer_cast<LimitPlan>(plan)) {
+            return std::make_unique<LimitExecutor>(convert_plan_executor(x->subplan_, context, op_stats),
+                                                   static_cast<size_t>(x->limit_));
         }
         return nullptr;
     }
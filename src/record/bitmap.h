@@ -30,6 +30,13 @@ class Bitmap {
     // 如果pos位是1，则返回true
     static bool is_set(const char *bm, int pos) { return (bm[get_bucket(pos)] & get_bit(pos)) != 0; }
 
+    // 把从dst开始的size个字节与src按位与，用于合并多个过滤条件的选择位图
+    static void intersect(char *dst, const char *src, int size) {
+        for (int i = 0; i < size; i++) {
+            dst[i] &= src[i];
+        }
+    }
+
     /**
      * @brief 找下一个为0 or 1的位
      * @param bit false表示要找下一个为0的位，true表示要找下一个为1的位
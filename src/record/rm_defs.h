@@ -10,33 +10,68 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include "common/arena.h"
 #include "defs.h"
 #include "storage/buffer_pool_manager.h"
 
 constexpr int RM_NO_PAGE = -1;
 constexpr int RM_FILE_HDR_PAGE = 0;
 constexpr int RM_FIRST_RECORD_PAGE = 1;
-constexpr int RM_MAX_RECORD_SIZE = 512;
+constexpr int RM_MAX_RECORD_SIZE = 512;      // 定长格式文件中记录的最大长度
+constexpr int RM_MAX_FIELDS = 64;           // 文件头中记录的字段的最大个数
+constexpr int RM_MAX_ZONE_FIELDS = 4;       // 文件头中记录的区间映射字段的最大个数
+
+/* 表数据文件的页面格式 */
+constexpr int RM_FORMAT_BITMAP = 0;         // 定长记录，页面由bitmap和固定大小的slot组成
+constexpr int RM_FORMAT_SLOTTED = 1;        // 变长记录，页面由slot目录和从页尾向前分配的记录数据组成
+constexpr int RM_FORMAT_PAX = 2;            // 定长记录按列存放，页面由bitmap和每个字段的列存储区组成
+
+/* 字段在记录中的位置。slotted格式记录其中的变长字段，记录在内存中仍按字段的声明长度定长存放，写入页面时去掉变长字段末尾的填充；
+   PAX格式记录全部字段，页面中每个字段的值连续存放 */
+struct RmField {
+    int offset;     // 字段在记录中的偏移
+    int len;        // 字段的声明长度
+};
+
+/* slotted格式中字典编码的字段，记录中存放字段值在表的字典中的编码 */
+struct RmDictField {
+    int offset;     // 字段在记录中的偏移
+    int len;        // 字段的声明长度
+    int width;      // 编码的字节数，1、2或4
+};
+
+/* 维护区间映射（每个页面上的最小值和最大值）的字段，只用于INT和FLOAT字段 */
+struct RmZoneField {
+    int offset;     // 字段在记录中的偏移
+    int type;       // 字段的类型，TYPE_INT或TYPE_FLOAT
+};
 
 /* 文件头，记录表数据文件的元信息，写入磁盘中文件的第0号页面 */
 struct RmFileHdr {
-    int record_size;            // 表中每条记录的大小，由于不包含变长字段，因此当前字段初始化后保持不变
+    int record_size;            // 表中每条记录在内存中的大小，变长字段按声明长度计算，初始化后保持不变
     int num_pages;              // 文件中分配的页面个数（初始化为1）
-    int num_records_per_page;   // 每个页面最多能存储的元组个数
-    int first_free_page_no;     // 文件中当前第一个包含空闲空间的页面号（初始化为-1）
-    int bitmap_size;            // 每个页面bitmap大小
+    int num_records_per_page;   // 每个页面最多能存储的元组个数，slotted格式为0
+    int first_free_page_no;     // 已不再使用，空闲页面由RmFreeSpaceMap维护，保留以兼容文件格式（初始化为-1）
+    int bitmap_size;            // 每个页面bitmap大小，slotted格式为0
+    int format;                 // 页面格式，RM_FORMAT_BITMAP、RM_FORMAT_SLOTTED或RM_FORMAT_PAX，旧文件中为0
+    int num_fields;             // fields中的字段个数，bitmap格式为0
+    RmField fields[RM_MAX_FIELDS];  // 按偏移排序的字段，slotted格式为变长字段，PAX格式为全部字段
+    int num_dict_fields;        // dict_fields中的字段个数，旧文件中为0
+    RmDictField dict_fields[RM_MAX_FIELDS];     // 按偏移排序的字典编码字段，只用于slotted格式，不出现在fields中
+    int num_zone_fields;        // zone_fields中的字段个数，旧文件中为0
+    RmZoneField zone_fields[RM_MAX_ZONE_FIELDS];    // 维护区间映射的字段
 };
 
 /* 表数据文件中每个页面的页头，记录每个页面的元信息 */
 struct RmPageHdr {
-    int next_free_page_no;  // 当前页面满了之后，下一个包含空闲空间的页面号（初始化为-1）
+    int next_free_page_no;  // 已不再使用，保留以兼容文件格式（初始化为-1）
     int num_records;        // 当前页面中当前已经存储的记录个数（初始化为0）
 };
 
 /* 表中的记录 */
 struct RmRecord {
-    char* data;  // 记录的数据
-    int size;    // 记录的大小
+    char* data = nullptr;  // 记录的数据
+    int size = 0;          // 记录的大小
     bool allocated_ = false;    // 是否已经为数据分配空间
 
     RmRecord() = default;
@@ -49,6 +84,12 @@ struct RmRecord {
     };
 
     RmRecord &operator=(const RmRecord& other) {
+        if (this == &other) {
+            return *this;
+        }
+        if (allocated_) {
+            delete[] data;
+        }
         size = other.size;
         data = new char[size];
         memcpy(data, other.data, size);
@@ -69,6 +110,12 @@ struct RmRecord {
         allocated_ = true;
     }
 
+    /* 数据从arena中分配的记录，析构时不释放数据，arena释放这段内存之后记录失效 */
+    RmRecord(int size_, Arena* arena) {
+        size = size_;
+        data = arena->allocate(size_);
+    }
+
     void SetData(char* data_) {
         memcpy(data, data_, size);
     }
@@ -79,6 +126,7 @@ struct RmRecord {
             delete[] data;
         }
         data = new char[size];
+        allocated_ = true;
         memcpy(data, data_ + sizeof(int), size);
     }
 
@@ -90,3 +138,73 @@ struct RmRecord {
         data = nullptr;
     }
 };
+
+/* 表中记录的只读视图：直接指向缓冲池页面中记录所在的slot，视图存活期间页面保持固定并持有共享latch，
+   因此不应长时间持有，也不应在持有期间修改同一页面；需要保留记录内容时调用to_record()复制出来。
+   对于无法直接访问页面的算子，视图也可以持有一条独立的RmRecord */
+class RecordView {
+   public:
+    RecordView() = default;
+
+    RecordView(ReadPageGuard guard, const char *data, int size) : guard_(std::move(guard)), data_(data), size_(size) {}
+
+    /* 不固定页面的视图，由调用者保证视图存活期间data指向的页面保持固定 */
+    RecordView(const char *data, int size) : data_(data), size_(size) {}
+
+    explicit RecordView(std::unique_ptr<RmRecord> record) : record_(std::move(record)) {
+        if (record_ != nullptr) {
+            data_ = record_->data;
+            size_ = record_->size;
+        }
+    }
+
+    RecordView(const RecordView &) = delete;
+    RecordView &operator=(const RecordView &) = delete;
+
+    RecordView(RecordView &&other) noexcept
+        : guard_(std::move(other.guard_)), record_(std::move(other.record_)), data_(other.data_), size_(other.size_) {
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+
+    RecordView &operator=(RecordView &&other) noexcept {
+        if (this != &other) {
+            guard_ = std::move(other.guard_);
+            record_ = std::move(other.record_);
+            data_ = other.data_;
+            size_ = other.size_;
+            other.data_ = nullptr;
+            other.size_ = 0;
+        }
+        return *this;
+    }
+
+    /* 视图是否指向一条记录；slot上没有记录或者算子已经结束时返回false */
+    bool is_valid() const { return data_ != nullptr; }
+
+    const char *data() const { return data_; }
+
+    int size() const { return size_; }
+
+    /* 将记录内容复制到一条新的RmRecord中，元组离开执行流水线时使用 */
+    std::unique_ptr<RmRecord> to_record() const {
+        if (record_ != nullptr) {
+            return std::make_unique<RmRecord>(*record_);
+        }
+        return std::make_unique<RmRecord>(size_, const_cast<char *>(data_));
+    }
+
+    /* 提前释放视图持有的页面 */
+    void release() {
+        guard_.release();
+        record_.reset();
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+   private:
+    ReadPageGuard guard_;
+    std::unique_ptr<RmRecord> record_;
+    const char *data_ = nullptr;
+    int size_ = 0;
+};
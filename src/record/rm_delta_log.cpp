@@ -0,0 +1,68 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "rm_delta_log.h"
+
+/**
+ * @description: 开始收集修改
+ * @return {bool} 表上已经有在建的索引时返回false
+ */
+bool RmDeltaLog::start() {
+    std::scoped_lock lock{latch_};
+    if (active_.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    entries_.clear();
+    active_.store(true, std::memory_order_release);
+    return true;
+}
+
+/**
+ * @description: 追加一条修改，没有在收集时什么也不做
+ * @param {Rid&} rid 被修改的记录
+ * @param {char*} before 修改前的记录，插入时为nullptr
+ * @param {char*} after 修改后的记录，删除时为nullptr
+ * @param {int} len 记录长度
+ */
+void RmDeltaLog::append(const Rid &rid, const char *before, const char *after, int len) {
+    if (!is_active()) {
+        return;
+    }
+    std::scoped_lock lock{latch_};
+    if (!active_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    RmDeltaEntry entry;
+    entry.rid = rid;
+    if (before != nullptr) entry.before.assign(before, len);
+    if (after != nullptr) entry.after.assign(after, len);
+    entries_.push_back(std::move(entry));
+}
+
+/**
+ * @description: 取出目前收集到的修改，之后的修改继续收集
+ */
+std::vector<RmDeltaEntry> RmDeltaLog::take() {
+    std::scoped_lock lock{latch_};
+    std::vector<RmDeltaEntry> entries;
+    entries.swap(entries_);
+    return entries;
+}
+
+/**
+ * @description: 停止收集，并取出剩余的修改
+ */
+std::vector<RmDeltaEntry> RmDeltaLog::stop() {
+    std::scoped_lock lock{latch_};
+    active_.store(false, std::memory_order_release);
+    std::vector<RmDeltaEntry> entries;
+    entries.swap(entries_);
+    return entries;
+}
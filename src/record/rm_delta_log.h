@@ -0,0 +1,49 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "defs.h"
+
+/* 在线建索引期间表上的一次修改：记录号以及修改前后的记录，为空表示修改前或修改后记录不存在 */
+struct RmDeltaEntry {
+    Rid rid;
+    std::string before;
+    std::string after;
+};
+
+/**
+ * @description: 在线建索引时收集表上的修改。建索引的线程在扫描表之前开始收集，插入、删除和更新记录时
+ *              RmFileHandle追加一条修改；扫描建好索引之后取出收集到的修改，按追加的顺序应用到新索引上。
+ *              删除在页面latch内追加，同一个slot上的删除总是排在之后复用这个slot的插入之前。
+ *              没有在建的索引时追加只读一次原子变量
+ */
+class RmDeltaLog {
+   public:
+    bool is_active() const { return active_.load(std::memory_order_acquire); }
+
+    bool start();
+
+    void append(const Rid &rid, const char *before, const char *after, int len);
+
+    std::vector<RmDeltaEntry> take();
+
+    std::vector<RmDeltaEntry> stop();
+
+   private:
+    std::atomic<bool> active_{false};
+    std::mutex latch_;                      // 保护entries_，以及active_的修改
+    std::vector<RmDeltaEntry> entries_;     // 上次取出之后收集到的修改
+};
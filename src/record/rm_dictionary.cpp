@@ -0,0 +1,168 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "rm_dictionary.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+
+#include "errors.h"
+
+/* 字典文件中每个条目的头部 */
+struct RmDictEntryHdr {
+    uint32_t dict_no;   // 字段在dict_fields中的下标
+    uint32_t len;       // 值的长度
+};
+
+/* 去掉末尾0字节之后的长度 */
+static int trimmed_len(const char *value, int len) {
+    while (len > 0 && value[len - 1] == 0) {
+        len--;
+    }
+    return len;
+}
+
+RmDictionary::~RmDictionary() {
+    if (fd_ != -1) {
+        close(fd_);
+    }
+}
+
+/**
+ * @description: 打开数据文件的字典文件并读入全部条目，字典文件不存在时创建。
+ *              故障时正在追加的条目可能不完整，它的编码还没有被使用，截掉它，之后的条目从这里继续追加
+ * @param {string&} path 字典文件的路径
+ * @param {RmFileHdr&} file_hdr 数据文件的文件头，提供字典编码的字段
+ */
+void RmDictionary::open(const std::string &path, const RmFileHdr &file_hdr) {
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ == -1) {
+        throw UnixError();
+    }
+    dicts_.resize(file_hdr.num_dict_fields);
+    for (int i = 0; i < file_hdr.num_dict_fields; i++) {
+        dicts_[i].escape = escape_code(file_hdr.dict_fields[i].width);
+    }
+
+    struct stat st;
+    if (fstat(fd_, &st) == -1) {
+        throw UnixError();
+    }
+    std::vector<char> buf(st.st_size);
+    if (pread(fd_, buf.data(), buf.size(), 0) != static_cast<ssize_t>(buf.size())) {
+        throw UnixError();
+    }
+    size_t pos = 0;
+    while (pos + sizeof(RmDictEntryHdr) <= buf.size()) {
+        RmDictEntryHdr hdr;
+        memcpy(&hdr, buf.data() + pos, sizeof(hdr));
+        if (hdr.dict_no >= dicts_.size() || hdr.len > static_cast<uint32_t>(file_hdr.dict_fields[hdr.dict_no].len) ||
+            pos + sizeof(hdr) + hdr.len > buf.size()) {
+            break;
+        }
+        add(hdr.dict_no, std::string(buf.data() + pos + sizeof(hdr), hdr.len));
+        pos += sizeof(hdr) + hdr.len;
+    }
+    file_end_ = static_cast<off_t>(pos);
+    if (pos != buf.size() && ftruncate(fd_, file_end_) == -1) {
+        throw UnixError();
+    }
+}
+
+/* 把值加入字典，编码为字典中已有值的个数，调用时持有latch_的排他锁或者处于打开阶段 */
+void RmDictionary::add(int dict_no, std::string value) {
+    Dict &dict = dicts_[dict_no];
+    uint32_t code = static_cast<uint32_t>(dict.values.size());
+    dict.values.push_back(value);
+    dict.codes.emplace(std::move(value), code);
+}
+
+/**
+ * @description: 返回字段值的编码，值不在字典中时分配新的编码，先追加到字典文件并落盘。编码已经用完时返回转义编码
+ * @param {int} dict_no 字段在dict_fields中的下标
+ * @param {char*} value 记录中的字段值
+ * @param {int} len 字段的声明长度
+ */
+uint32_t RmDictionary::encode(int dict_no, const char *value, int len) {
+    std::string key(value, trimmed_len(value, len));
+    {
+        std::shared_lock lock{latch_};
+        const Dict &dict = dicts_[dict_no];
+        auto it = dict.codes.find(key);
+        if (it != dict.codes.end()) {
+            return it->second;
+        }
+        if (dict.values.size() >= dict.escape) {
+            return dict.escape;
+        }
+    }
+
+    std::scoped_lock append_lock{append_latch_};
+    // 等待append_latch_期间其它线程可能已经加入了这个值；只有持有append_latch_的线程修改dicts_，读取不需要latch_
+    const Dict &dict = dicts_[dict_no];
+    auto it = dict.codes.find(key);
+    if (it != dict.codes.end()) {
+        return it->second;
+    }
+    if (dict.values.size() >= dict.escape) {
+        return dict.escape;
+    }
+    std::vector<char> entry(sizeof(RmDictEntryHdr) + key.size());
+    RmDictEntryHdr hdr{static_cast<uint32_t>(dict_no), static_cast<uint32_t>(key.size())};
+    memcpy(entry.data(), &hdr, sizeof(hdr));
+    memcpy(entry.data() + sizeof(hdr), key.data(), key.size());
+    if (pwrite(fd_, entry.data(), entry.size(), file_end_) != static_cast<ssize_t>(entry.size()) ||
+        fdatasync(fd_) == -1) {
+        throw UnixError();
+    }
+    file_end_ += static_cast<off_t>(entry.size());
+    uint32_t code = static_cast<uint32_t>(dict.values.size());
+    std::unique_lock lock{latch_};
+    add(dict_no, std::move(key));
+    return code;
+}
+
+/**
+ * @description: 查找字段值的编码，不分配新的编码。值不在字典中时返回转义编码：
+ *              这样的值只可能出现在编码为转义编码的记录中
+ */
+uint32_t RmDictionary::lookup(int dict_no, const char *value, int len) const {
+    std::string key(value, trimmed_len(value, len));
+    std::shared_lock lock{latch_};
+    const Dict &dict = dicts_[dict_no];
+    auto it = dict.codes.find(key);
+    return it != dict.codes.end() ? it->second : dict.escape;
+}
+
+/**
+ * @description: 把编码还原为字段值，末尾补0到字段的声明长度
+ * @param {int} dict_no 字段在dict_fields中的下标
+ * @param {uint32_t} code 不是转义编码的编码
+ * @param {char*} out 还原的字段值
+ * @param {int} len 字段的声明长度
+ */
+void RmDictionary::decode(int dict_no, uint32_t code, char *out, int len) const {
+    std::shared_lock lock{latch_};
+    const Dict &dict = dicts_[dict_no];
+    if (code >= dict.values.size()) {
+        throw InternalError("RmDictionary::decode: code " + std::to_string(code) + " not in dictionary");
+    }
+    const std::string &value = dict.values[code];
+    memcpy(out, value.data(), value.size());
+    memset(out + value.size(), 0, len - value.size());
+}
+
+size_t RmDictionary::size(int dict_no) const {
+    std::shared_lock lock{latch_};
+    return dicts_[dict_no].values.size();
+}
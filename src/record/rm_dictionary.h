@@ -0,0 +1,67 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "rm_defs.h"
+
+/* 表的字典：slotted格式中每个字典编码的字段有一个字典，把字段的值（去掉末尾的0字节）映射为从0开始连续分配的编码。
+   字典保存在数据文件旁的字典文件（文件名+SUFFIX）中，每个条目依次是字段在dict_fields中的下标、值的长度和值。
+   新的值先追加到字典文件并落盘，之后才返回它的编码，因此写入页面的编码在故障之后总能在字典文件中找到。
+   字典只增不减，编码的最大值是转义编码：字段的编码用完之后，新的值编码为转义编码，记录中另外存放字段的原值 */
+class RmDictionary {
+   public:
+    static constexpr const char *SUFFIX = ".dict";
+
+    RmDictionary() = default;
+
+    RmDictionary(const RmDictionary &) = delete;
+
+    RmDictionary &operator=(const RmDictionary &) = delete;
+
+    ~RmDictionary();
+
+    void open(const std::string &path, const RmFileHdr &file_hdr);
+
+    /* 编码为width个字节的字段的转义编码 */
+    static uint32_t escape_code(int width) { return width >= 4 ? UINT32_MAX : (1u << (8 * width)) - 1; }
+
+    uint32_t encode(int dict_no, const char *value, int len);
+
+    uint32_t lookup(int dict_no, const char *value, int len) const;
+
+    void decode(int dict_no, uint32_t code, char *out, int len) const;
+
+    /* 第dict_no个字段的字典中值的个数 */
+    size_t size(int dict_no) const;
+
+   private:
+    struct Dict {
+        std::deque<std::string> values;                   // 按编码排列的值，追加时已有元素的地址不变
+        std::unordered_map<std::string, uint32_t> codes;  // 值到编码的映射
+        uint32_t escape;                                  // 转义编码，也是字典中值的个数上限
+    };
+
+    void add(int dict_no, std::string value);
+
+    int fd_ = -1;                       // 字典文件
+    off_t file_end_ = 0;                // 字典文件中最后一个完整条目的结束位置，新条目追加在这里
+    std::vector<Dict> dicts_;           // 按dict_fields的顺序排列的各字段的字典
+    mutable std::shared_mutex latch_;   // 保护dicts_，追加条目落盘期间不持有，编码和解码不被落盘阻塞
+    std::mutex append_latch_;           // 串行化新值的分配和字典文件的追加
+};
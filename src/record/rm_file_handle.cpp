@@ -10,6 +10,11 @@ See the Mulan PSL v2 for more details. */
 
 #include "rm_file_handle.h"
 
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <unordered_map>
+
 /**
  * @brief 是否需要把一次写操作记录到事务 write_set_ 中？
  *
@@ -21,11 +26,63 @@ See the Mulan PSL v2 for more details. */
  *   - 正常执行：GROWING -> 记录写集合；
  *   - commit/abort 阶段：SHRINKING/ABORTED/COMMITTED -> 不再记录。
  */
+namespace {
+
+// 修改记录的函数返回时（包括抛出异常时）把记录文件的版本号加一，版本号变化之前修改已经完成
+struct VersionBump {
+    std::atomic<uint64_t> &version;
+    ~VersionBump() { version.fetch_add(1, std::memory_order_release); }
+};
+
+}  // namespace
+
 static inline bool should_record_write(Context *context) {
     return context != nullptr && context->txn_ != nullptr &&
            context->txn_->get_state() == TransactionState::GROWING;
 }
 
+/* 多版本并发控制开启时返回修改者的提交时间戳，修改记录之前要把记录原来的内容压入版本链；未开启或回滚时返回nullptr */
+static inline const std::shared_ptr<TxnStamp> *version_stamp(Context *context) {
+    if (!should_record_write(context) || context->txn_->get_stamp() == nullptr) {
+        return nullptr;
+    }
+    return &context->txn_->get_stamp();
+}
+
+/**
+ * 事务的修改先写日志（WAL）：日志追加到日志缓冲区，页面记下日志号，缓冲池写回页面之前先持久化到这条日志。
+ * 调用之前已经追加了对应的写记录，写记录记下日志号，回滚时据此写CLR
+ * @return {lsn_t} 日志号，没有日志管理器时为INVALID_LSN
+ */
+static inline lsn_t write_log(Context *context, LogRecord *log_record, Page *page) {
+    if (context->log_mgr_ == nullptr) {
+        return INVALID_LSN;
+    }
+    lsn_t lsn = context->log_mgr_->append_txn_log(context->txn_, log_record);
+    context->txn_->get_write_set()->back()->SetLsn(lsn);
+    if (page != nullptr) {
+        page->set_page_lsn(lsn);
+    }
+    return lsn;
+}
+
+/**
+ * 删除、更新记录之前取得记录的写权并压入记录原来的内容：记录正被其他尚未结束的事务修改，
+ * 或者快照读的事务的快照开始之后有其他事务修改并提交过这条记录时（先修改者胜出）回滚
+ */
+static inline void claim_version(RmVersionStore &versions, const Rid &rid, const char *before, int len,
+                                 Context *context) {
+    auto stamp = version_stamp(context);
+    if (stamp == nullptr) {
+        return;
+    }
+    Transaction *txn = context->txn_;
+    ReadView view = txn->get_read_view();
+    if (!versions.claim(rid, *stamp, before, len, txn->snapshot_read() ? &view : nullptr)) {
+        throw TransactionAbortException(txn->get_transaction_id(), AbortReason::SERIALIZATION_FAILURE);
+    }
+}
+
 /**
  * @description: 获取当前表中记录号为rid的记录
  * @param {Rid&} rid 记录号，指定记录的位置
@@ -46,8 +103,17 @@ std::unique_ptr<RmRecord> RmFileHandle::get_record(const Rid& rid, Context* cont
         context->lock_mgr_->lock_shared_on_record(context->txn_, rid, fd_);
     }
 
-    // 1. 获取指定记录所在的page handle
-    RmPageHandle page_handle = fetch_page_handle(rid.page_no);
+    if (file_hdr_.format == RM_FORMAT_SLOTTED) {
+        std::unique_ptr<RmRecord> record = std::make_unique<RmRecord>(file_hdr_.record_size);
+        if (!read_slotted_record(rid, record->data)) {
+            throw RecordNotFoundError(rid.page_no, rid.slot_no);
+        }
+        return record;
+    }
+
+    // 1. 获取指定记录所在的page handle，guard离开作用域时自动释放页面
+    ReadPageGuard guard = fetch_page_read(rid.page_no);
+    RmPageHandle page_handle(&file_hdr_, guard.get_page());
     
     // 检查该slot是否有记录
     if (!Bitmap::is_set(page_handle.bitmap, rid.slot_no)) {
@@ -58,15 +124,67 @@ std::unique_ptr<RmRecord> RmFileHandle::get_record(const Rid& rid, Context* cont
     std::unique_ptr<RmRecord> record = std::make_unique<RmRecord>(file_hdr_.record_size);
     
     // 复制记录数据
-    char* slot_data = page_handle.get_slot(rid.slot_no);
-    memcpy(record->data, slot_data, file_hdr_.record_size);
-    
-    // 释放page handle
-    buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), false);
+    page_handle.read_record(rid.slot_no, record->data);
     
     return record;
 }
 
+/**
+ * @description: 获取指定位置记录的只读视图，不复制记录数据，视图存活期间页面保持固定并持有共享latch。
+ *              slotted格式的记录需要解码、PAX格式的记录需要拼装，视图持有解码后的记录
+ * @param {Rid&} rid 记录号，指定记录的位置
+ * @param {Context*} context
+ * @return {RecordView} rid对应记录的视图，slot上没有记录时返回无效的视图
+ */
+RecordView RmFileHandle::get_record_view(const Rid& rid, Context* context) const {
+    // 与get_record相同，读记录前需要持有表级IS锁和行级S锁
+    if (context != nullptr && context->txn_ != nullptr && context->lock_mgr_ != nullptr) {
+        context->lock_mgr_->lock_IS_on_table(context->txn_, fd_);
+        context->lock_mgr_->lock_shared_on_record(context->txn_, rid, fd_);
+    }
+
+    if (file_hdr_.format == RM_FORMAT_SLOTTED) {
+        std::unique_ptr<RmRecord> record = std::make_unique<RmRecord>(file_hdr_.record_size);
+        if (!read_slotted_record(rid, record->data)) {
+            return RecordView();
+        }
+        return RecordView(std::move(record));
+    }
+
+    ReadPageGuard guard = fetch_page_read(rid.page_no);
+    RmPageHandle page_handle(&file_hdr_, guard.get_page());
+    if (!Bitmap::is_set(page_handle.bitmap, rid.slot_no)) {
+        return RecordView();
+    }
+    if (file_hdr_.format == RM_FORMAT_PAX) {
+        std::unique_ptr<RmRecord> record = std::make_unique<RmRecord>(file_hdr_.record_size);
+        page_handle.read_record(rid.slot_no, record->data);
+        return RecordView(std::move(record));
+    }
+    const char* slot_data = page_handle.get_slot(rid.slot_no);
+    return RecordView(std::move(guard), slot_data, file_hdr_.record_size);
+}
+
+/**
+ * @description: 按快照读取记录，不加锁：先读出页面上的记录，再查找版本链
+ * @param {Rid&} rid 记录号
+ * @param {ReadView&} view 快照
+ * @param {string*} out 快照中的记录
+ * @return {Visibility} 快照中的记录是页面上的记录、旧版本还是不存在
+ */
+RmVersionStore::Visibility RmFileHandle::read_snapshot_record(const Rid& rid, const ReadView& view,
+                                                              std::string* out) const {
+    RecordView rec = get_record_view(rid, nullptr);
+    if (rec.is_valid()) {
+        out->assign(rec.data(), file_hdr_.record_size);
+    }
+    auto result = versions_.resolve(rid, view, out);
+    if (result == RmVersionStore::Visibility::CURRENT && !rec.is_valid()) {
+        return RmVersionStore::Visibility::ABSENT;
+    }
+    return result;
+}
+
 /**
  * @description: 在当前表中插入一条记录，不指定插入位置
  * @param {char*} buf 要插入的记录的数据
@@ -74,22 +192,45 @@ std::unique_ptr<RmRecord> RmFileHandle::get_record(const Rid& rid, Context* cont
  * @return {Rid} 插入的记录的记录号（位置）
  */
 Rid RmFileHandle::insert_record(char* buf, Context* context) {
+    VersionBump bump{version_};
     // Todo:
     // 1. 获取当前未满的page handle
     // 2. 在page handle中找到空闲slot位置
     // 3. 将buf复制到空闲slot位置
     // 4. 更新page_handle.page_hdr中的数据结构
-    // 注意考虑插入一条记录后页面已满的情况，需要更新file_hdr_.first_free_page_no
+    // 插入后需要更新页面在空闲空间映射中的桶
     
     // 1. 获取当前未满的page handle
     // ========== 并发控制（Strict 2PL）==========
     // 插入属于写操作：只拿表级 IX（意向排他）即可表达“我要在表里写一些行”。
     // 行级 X 对“新插入的记录”在本实验基础测试中不是必须，但表级 IX 是后续支持更强隔离（如幻读）的一块基础。
+    // 新记录还要与其他事务登记的、新记录满足的扫描条件（谓词锁）冲突，防止对方再次扫描时出现幻读
     if (context != nullptr && context->txn_ != nullptr && context->lock_mgr_ != nullptr) {
         context->lock_mgr_->lock_IX_on_table(context->txn_, fd_);
+        context->lock_mgr_->lock_exclusive_on_tuple(context->txn_, fd_, buf, file_hdr_.record_size);
     }
 
-    RmPageHandle page_handle = create_page_handle();
+    // 从空闲空间映射中选取页面，不同线程的插入可以同时在不同的页面上进行
+    load_free_space_map();
+    load_zone_map();
+    if (file_hdr_.format == RM_FORMAT_SLOTTED) {
+        std::vector<char> data(rm_max_encoded_size(file_hdr_));
+        int len = rm_encode_record(file_hdr_, &dict_, buf, data.data());
+        Rid rid = insert_slotted(data.data(), len, 0, version_stamp(context), buf);
+        delta_log_.append(rid, nullptr, buf, file_hdr_.record_size);
+        record_delta_.fetch_add(1, std::memory_order_relaxed);
+        if (should_record_write(context)) {
+            std::string tab_name = disk_manager_->get_file_name(fd_);
+            context->txn_->append_write_record(WType::INSERT_TUPLE, tab_name, rid);
+            RmRecord value(file_hdr_.record_size, buf);
+            InsertLogRecord log_record(context->txn_->get_transaction_id(), value, rid, oid_);
+            WritePageGuard guard = fetch_page_write(rid.page_no);
+            write_log(context, &log_record, guard.get_page());
+        }
+        return rid;
+    }
+    WritePageGuard guard = create_page_handle();
+    RmPageHandle page_handle(&file_hdr_, guard.get_page());
     
     // 2. 在page handle中找到空闲slot位置
     int slot_no = Bitmap::first_bit(false, page_handle.bitmap, file_hdr_.num_records_per_page);
@@ -99,86 +240,229 @@ Rid RmFileHandle::insert_record(char* buf, Context* context) {
         throw InternalError("No free slot available");
     }
     
-    // 3. 将buf复制到空闲slot位置
-    char* slot_data = page_handle.get_slot(slot_no);
-    memcpy(slot_data, buf, file_hdr_.record_size);
+    // 构造Rid并返回
+    Rid rid = {page_handle.page->get_page_id().page_no, slot_no};
+
+    // 在页面latch内记下插入之前记录不存在，快照读不会看到尚未提交的记录
+    if (auto stamp = version_stamp(context)) {
+        versions_.push(rid, *stamp, nullptr, file_hdr_.record_size);
+    }
+
+    // 3. 将buf复制到空闲slot位置，写入之前扩大页面的区间
+    zone_map_.widen(rid.page_no, buf);
+    page_handle.write_record(slot_no, buf);
     
     // 4. 更新page_handle.page_hdr中的数据结构
     Bitmap::set(page_handle.bitmap, slot_no);
     page_handle.page_hdr->num_records++;
-    
-    // 如果插入后页面已满，需要更新file_hdr_.first_free_page_no
-    if (page_handle.page_hdr->num_records == file_hdr_.num_records_per_page) {
-        file_hdr_.first_free_page_no = page_handle.page_hdr->next_free_page_no;
-    }
-    
-    // 构造Rid并返回
-    Rid rid = {page_handle.page->get_page_id().page_no, slot_no};
+    delta_log_.append(rid, nullptr, buf, file_hdr_.record_size);
+
+    // 释放页面latch之前更新空闲空间映射，其它线程获取到页面latch时看到的映射与页面一致
+    fsm_.update(rid.page_no, page_handle.page_hdr->num_records);
+    record_delta_.fetch_add(1, std::memory_order_relaxed);
 
     // 事务写集合记录（用于 abort 时删除这条新插入的记录）
     if (should_record_write(context)) {
         // tab_name_：这里用 DiskManager 的 fd->path 映射来得到表名（创建/打开表文件时用的就是 tab_name）
         std::string tab_name = disk_manager_->get_file_name(fd_);
-        context->txn_->append_write_record(new WriteRecord(WType::INSERT_TUPLE, tab_name, rid));
+        context->txn_->append_write_record(WType::INSERT_TUPLE, tab_name, rid);
+        RmRecord value(file_hdr_.record_size, buf);
+        InsertLogRecord log_record(context->txn_->get_transaction_id(), value, rid, oid_);
+        write_log(context, &log_record, page_handle.page);
     }
     
-    // 释放page handle（标记为dirty）
-    buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), true);
-    
+    // guard析构时释放page handle（标记为dirty）
     return rid;
 }
 
+/**
+ * @description: 批量插入记录：每个页面只获取一次写保护，依次填满页面上的空闲slot后再移动到下一个空闲页面
+ * @param {char*} buf 连续存放的待插入记录，每条记录的长度为file_hdr_.record_size
+ * @param {int} num_records 记录条数
+ * @param {vector<Rid>*} rids 传出参数，按顺序追加每条记录插入的位置
+ * @param {Context*} context
+ */
+void RmFileHandle::insert_records(const char* buf, int num_records, std::vector<Rid>* rids, Context* context) {
+    VersionBump bump{version_};
+    if (context != nullptr && context->txn_ != nullptr && context->lock_mgr_ != nullptr) {
+        context->lock_mgr_->lock_IX_on_table(context->txn_, fd_);
+        for (int i = 0; i < num_records; ++i) {
+            context->lock_mgr_->lock_exclusive_on_tuple(context->txn_, fd_, buf + i * file_hdr_.record_size,
+                                                        file_hdr_.record_size);
+        }
+    }
+    if (file_hdr_.format == RM_FORMAT_SLOTTED) {
+        insert_records_slotted(buf, num_records, rids, context);
+        record_delta_.fetch_add(num_records, std::memory_order_relaxed);
+        return;
+    }
+    bool record_write = should_record_write(context);
+    std::string tab_name = record_write ? disk_manager_->get_file_name(fd_) : std::string();
+    auto stamp = version_stamp(context);
+
+    load_free_space_map();
+    load_zone_map();
+    int inserted = 0;
+    while (inserted < num_records) {
+        WritePageGuard guard = create_page_handle();
+        RmPageHandle page_handle(&file_hdr_, guard.get_page());
+        page_id_t page_no = page_handle.page->get_page_id().page_no;
+
+        int slot_no = Bitmap::first_bit(false, page_handle.bitmap, file_hdr_.num_records_per_page);
+        while (inserted < num_records && slot_no < file_hdr_.num_records_per_page) {
+            Rid rid = {page_no, slot_no};
+            if (stamp != nullptr) {
+                versions_.push(rid, *stamp, nullptr, file_hdr_.record_size);
+            }
+            const char *record = buf + static_cast<size_t>(inserted) * file_hdr_.record_size;
+            zone_map_.widen(page_no, record);
+            page_handle.write_record(slot_no, record);
+            Bitmap::set(page_handle.bitmap, slot_no);
+            page_handle.page_hdr->num_records++;
+            delta_log_.append(rid, nullptr, record, file_hdr_.record_size);
+            rids->push_back(rid);
+            if (record_write) {
+                context->txn_->append_write_record(WType::INSERT_TUPLE, tab_name, rid);
+                RmRecord value(file_hdr_.record_size, const_cast<char *>(record));
+                InsertLogRecord log_record(context->txn_->get_transaction_id(), value, rid, oid_);
+                write_log(context, &log_record, page_handle.page);
+            }
+            inserted++;
+            slot_no = Bitmap::next_bit(false, page_handle.bitmap, file_hdr_.num_records_per_page, slot_no);
+        }
+
+        fsm_.update(page_no, page_handle.page_hdr->num_records);
+    }
+    record_delta_.fetch_add(num_records, std::memory_order_relaxed);
+}
+
 /**
  * @description: 在当前表中的指定位置插入一条记录
  * @param {Rid&} rid 要插入记录的位置
  * @param {char*} buf 要插入记录的数据
  */
 void RmFileHandle::insert_record(const Rid& rid, char* buf) {
+    VersionBump bump{version_};
     /**
      * @brief 在“指定位置”插入记录（原位插回）
      *
      * 这是事务回滚 DELETE 的关键能力：回滚时必须把旧记录插回原 rid。
      * 如果不原位插回，会产生两个严重问题：
      * 1) RID 改变：索引/上层算子持有的 rid 失效，查询会读不到正确数据；
-     * 2) 空闲链表/位图错乱：可能导致重复插入/覆盖已有记录。
+     * 2) 空闲空间映射/位图错乱：可能导致重复插入/覆盖已有记录。
      */
 
     // 1. page_no 合法性检查
     if (rid.page_no <= RM_FILE_HDR_PAGE || rid.page_no >= file_hdr_.num_pages) {
         throw PageNotExistError(disk_manager_->get_file_name(fd_), rid.page_no);
     }
+    load_zone_map();
+    zone_map_.widen(rid.page_no, buf);
 
-    // 2. fetch 对应页面
-    RmPageHandle page_handle = fetch_page_handle(rid.page_no);
+    if (file_hdr_.format == RM_FORMAT_SLOTTED) {
+        insert_record_slotted(rid, buf);
+        delta_log_.append(rid, nullptr, buf, file_hdr_.record_size);
+        record_delta_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
 
-    // 3. slot 合法性检查
+    // 2. slot 合法性检查
     if (rid.slot_no < 0 || rid.slot_no >= file_hdr_.num_records_per_page) {
-        buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), false);
         throw InternalError("RmFileHandle::insert_record(rid): invalid slot_no");
     }
 
+    // 3. fetch 对应页面（插入可能让页面变满，需要更新空闲空间映射）
+    load_free_space_map();
+    WritePageGuard guard = fetch_page_write(rid.page_no);
+    RmPageHandle page_handle(&file_hdr_, guard.get_page());
+
     // 4. 目标 slot 必须为空，否则等价于“覆盖记录”，这会破坏一致性
     if (Bitmap::is_set(page_handle.bitmap, rid.slot_no)) {
-        buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), false);
         throw InternalError("RmFileHandle::insert_record(rid): slot already occupied");
     }
 
     // 5. 插入记录：写数据 + bitmap 置 1 + num_records++
-    memcpy(page_handle.get_slot(rid.slot_no), buf, file_hdr_.record_size);
+    page_handle.write_record(rid.slot_no, buf);
     Bitmap::set(page_handle.bitmap, rid.slot_no);
     page_handle.page_hdr->num_records++;
+    delta_log_.append(rid, nullptr, buf, file_hdr_.record_size);
 
-    // 6. 如果该页之前是满页（没有空闲 slot），而现在插入后仍可能是满页/非满页：
-    //    这里只处理“页从满->非满”的反向情况不需要；这里是插入，所以只需处理“页从非满->满”：
-    if (page_handle.page_hdr->num_records == file_hdr_.num_records_per_page) {
-        // 如果当前页被 first_free_page_no 指向，需要把 first_free_page_no 前移到 next_free_page_no
-        if (file_hdr_.first_free_page_no == rid.page_no) {
-            file_hdr_.first_free_page_no = page_handle.page_hdr->next_free_page_no;
-        }
+    // 6. 更新页面在空闲空间映射中的桶（页面可能因此变满）
+    fsm_.update(rid.page_no, page_handle.page_hdr->num_records);
+    record_delta_.fetch_add(1, std::memory_order_relaxed);
+
+    // 7. guard析构时释放页面（dirty=true）
+}
+
+/**
+ * @description: 把rid上的记录置为buf：记录不存在时在rid上插入，存在时更新，页面不在文件中时先扩展文件。
+ *              与insert_record、update_record一样加锁、保留旧版本、写日志并记入写集合，重复执行的结果相同。
+ *              备库回放主库的日志时使用，记录号与主库一致
+ * @param {Rid&} rid 记录号
+ * @param {char*} buf 记录的数据
+ * @param {Context*} context
+ */
+void RmFileHandle::put_record(const Rid& rid, char* buf, Context* context) {
+    ensure_page(rid.page_no);
+    if (is_record(rid)) {
+        update_record(rid, buf, context);
+        return;
+    }
+    if (context != nullptr && context->txn_ != nullptr && context->lock_mgr_ != nullptr) {
+        context->lock_mgr_->lock_IX_on_table(context->txn_, fd_);
+        context->lock_mgr_->lock_exclusive_on_record(context->txn_, rid, fd_);
+        context->lock_mgr_->lock_exclusive_on_tuple(context->txn_, fd_, buf, file_hdr_.record_size);
+    }
+    // 插入之前记下记录不存在，快照读不会看到尚未提交的记录
+    if (auto stamp = version_stamp(context)) {
+        versions_.push(rid, *stamp, nullptr, file_hdr_.record_size);
+    }
+    insert_record(rid, buf);
+    if (should_record_write(context)) {
+        std::string tab_name = disk_manager_->get_file_name(fd_);
+        context->txn_->append_write_record(WType::INSERT_TUPLE, tab_name, rid);
+        RmRecord value(file_hdr_.record_size, buf);
+        InsertLogRecord log_record(context->txn_->get_transaction_id(), value, rid, oid_);
+        WritePageGuard guard = fetch_page_write(rid.page_no);
+        write_log(context, &log_record, guard.get_page());
+    }
+}
+
+/**
+ * @description: 删除、更新记录之前先取得记录的写权，冲突时抛出TransactionAbortException。
+ *              执行算子在修改索引之前调用，避免修改了索引之后才因为冲突回滚；之后的delete_record、update_record不会再冲突
+ * @param {Rid&} rid 要删除或更新的记录
+ * @param {Context*} context
+ */
+void RmFileHandle::claim_record(const Rid& rid, Context* context) {
+    if (version_stamp(context) == nullptr) {
+        return;
     }
+    auto before = get_record(rid, nullptr);
+    claim_version(versions_, rid, before->data, file_hdr_.record_size, context);
+}
 
-    // 7. 释放页面（dirty=true）
-    buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), true);
+/**
+ * @description: 乐观并发控制的提交验证：快照view之后其他事务提交的修改是否改变了扫描条件pred选出的记录，
+ *              修改前后的记录满足pred时扫描结果可能已经不同。先从版本链复制出修改过的记录，再读取页面，
+ *              不在持有版本链latch时获取页面latch
+ * @return {bool} 扫描结果没有改变时返回true
+ */
+bool RmFileHandle::validate_scan(const ReadView& view, const std::function<bool(const char*)>& pred) const {
+    std::vector<RmChangedRecord> changed;
+    versions_.collect_changed(view, &changed);
+    for (auto &record : changed) {
+        for (auto &image : record.images_) {
+            if (pred(image.data())) {
+                return false;
+            }
+        }
+        RecordView current = get_record_view(record.rid_, nullptr);
+        if (current.is_valid() && pred(current.data())) {
+            return false;
+        }
+    }
+    return true;
 }
 
 /**
@@ -187,50 +471,67 @@ void RmFileHandle::insert_record(const Rid& rid, char* buf) {
  * @param {Context*} context
  */
 void RmFileHandle::delete_record(const Rid& rid, Context* context) {
+    VersionBump bump{version_};
     // Todo:
     // 1. 获取指定记录所在的page handle
     // 2. 更新page_handle.page_hdr中的数据结构
-    // 注意考虑删除一条记录后页面未满的情况，需要调用release_page_handle()
+    // 删除后页面的空闲空间变多，需要更新空闲空间映射
     
     // 1. 获取指定记录所在的page handle
     // ========== 并发控制（Strict 2PL）==========
-    // 删除属于写操作：表 IX + 行 X
+    // 删除属于写操作：表 IX + 行 X，被删除的记录还要检查谓词锁
     if (context != nullptr && context->txn_ != nullptr && context->lock_mgr_ != nullptr) {
         context->lock_mgr_->lock_IX_on_table(context->txn_, fd_);
         context->lock_mgr_->lock_exclusive_on_record(context->txn_, rid, fd_);
+        if (context->lock_mgr_->tuple_lock_required(context->txn_, fd_)) {
+            auto before = get_record(rid, nullptr);
+            context->lock_mgr_->lock_exclusive_on_tuple(context->txn_, fd_, before->data, file_hdr_.record_size);
+        }
     }
 
-    RmPageHandle page_handle = fetch_page_handle(rid.page_no);
+    // 删除腾出的空间通过空闲空间映射提供给之后的插入
+    load_free_space_map();
+    if (file_hdr_.format == RM_FORMAT_SLOTTED) {
+        delete_record_slotted(rid, context);
+        record_delta_.fetch_sub(1, std::memory_order_relaxed);
+        return;
+    }
+    WritePageGuard guard = fetch_page_write(rid.page_no);
+    RmPageHandle page_handle(&file_hdr_, guard.get_page());
     
     // 检查该slot是否有记录
     if (!Bitmap::is_set(page_handle.bitmap, rid.slot_no)) {
-        buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), false);
         throw RecordNotFoundError(rid.page_no, rid.slot_no);
     }
     
-    // 记录删除前页面是否已满
-    bool was_full = (page_handle.page_hdr->num_records == file_hdr_.num_records_per_page);
-
     // 事务写集合记录（用于 abort 时把旧记录插回）
     if (should_record_write(context)) {
         std::string tab_name = disk_manager_->get_file_name(fd_);
         // DELETE/UPDATE 的 WriteRecord 需要保存 before image
         RmRecord before(file_hdr_.record_size);
-        memcpy(before.data, page_handle.get_slot(rid.slot_no), file_hdr_.record_size);
-        context->txn_->append_write_record(new WriteRecord(WType::DELETE_TUPLE, tab_name, rid, before));
+        page_handle.read_record(rid.slot_no, before.data);
+        claim_version(versions_, rid, before.data, file_hdr_.record_size, context);
+        context->txn_->append_write_record(WType::DELETE_TUPLE, tab_name, rid, &before);
+        DeleteLogRecord log_record(context->txn_->get_transaction_id(), before, rid, oid_);
+        write_log(context, &log_record, page_handle.page);
     }
     
+    // 在线建索引期间在页面latch内记下删除，之后复用这个slot的插入排在它后面
+    if (delta_log_.is_active()) {
+        std::vector<char> before(file_hdr_.record_size);
+        page_handle.read_record(rid.slot_no, before.data());
+        delta_log_.append(rid, before.data(), nullptr, file_hdr_.record_size);
+    }
+
     // 2. 更新page_handle.page_hdr中的数据结构
     Bitmap::reset(page_handle.bitmap, rid.slot_no);
     page_handle.page_hdr->num_records--;
     
-    // 如果删除前页面已满，删除后变为未满，需要调用release_page_handle()
-    if (was_full) {
-        release_page_handle(page_handle);
-    }
+    // 删除前已满的页面重新进入空闲空间映射，并被优先填满
+    fsm_.update(rid.page_no, page_handle.page_hdr->num_records);
+    record_delta_.fetch_sub(1, std::memory_order_relaxed);
     
-    // 释放page handle（标记为dirty）
-    buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), true);
+    // guard析构时释放page handle（标记为dirty）
 }
 
 
@@ -241,6 +542,7 @@ void RmFileHandle::delete_record(const Rid& rid, Context* context) {
  * @param {Context*} context
  */
 void RmFileHandle::update_record(const Rid& rid, char* buf, Context* context) {
+    VersionBump bump{version_};
     // Todo:
     // 1. 获取指定记录所在的page handle
     // 2. 更新记录
@@ -249,16 +551,33 @@ void RmFileHandle::update_record(const Rid& rid, char* buf, Context* context) {
     // ========== 并发控制（Strict 2PL）==========
     // 更新属于写操作：表 IX + 行 X
     // 注意：如果该事务之前在扫描阶段对该行拿过 S 锁，这里会触发 S->X 升级。
+    // 更新前后的记录都要检查谓词锁：记录可能移入或移出其他事务的扫描范围
     if (context != nullptr && context->txn_ != nullptr && context->lock_mgr_ != nullptr) {
         context->lock_mgr_->lock_IX_on_table(context->txn_, fd_);
         context->lock_mgr_->lock_exclusive_on_record(context->txn_, rid, fd_);
+        if (context->lock_mgr_->tuple_lock_required(context->txn_, fd_)) {
+            auto before = get_record(rid, nullptr);
+            context->lock_mgr_->lock_exclusive_on_tuple(context->txn_, fd_, before->data, file_hdr_.record_size);
+        }
+        context->lock_mgr_->lock_exclusive_on_tuple(context->txn_, fd_, buf, file_hdr_.record_size);
+    }
+    // 新的值写入页面之前扩大记录号所在页面的区间，记录移动到其它页面时也按原位置计算
+    load_zone_map();
+    zone_map_.widen(rid.page_no, buf);
+
+    // slotted格式的记录长度可能改变，需要更新空闲空间映射，记录在页面中放不下时移动到其它页面
+    if (file_hdr_.format == RM_FORMAT_SLOTTED) {
+        load_free_space_map();
+        update_record_slotted(rid, buf, context);
+        return;
     }
 
-    RmPageHandle page_handle = fetch_page_handle(rid.page_no);
+    // bitmap格式的更新不改变页面的空闲状态，只需要页面latch
+    WritePageGuard guard = fetch_page_write(rid.page_no);
+    RmPageHandle page_handle(&file_hdr_, guard.get_page());
     
     // 检查该slot是否有记录
     if (!Bitmap::is_set(page_handle.bitmap, rid.slot_no)) {
-        buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), false);
         throw RecordNotFoundError(rid.page_no, rid.slot_no);
     }
 
@@ -266,110 +585,756 @@ void RmFileHandle::update_record(const Rid& rid, char* buf, Context* context) {
     if (should_record_write(context)) {
         std::string tab_name = disk_manager_->get_file_name(fd_);
         RmRecord before(file_hdr_.record_size);
-        memcpy(before.data, page_handle.get_slot(rid.slot_no), file_hdr_.record_size);
-        context->txn_->append_write_record(new WriteRecord(WType::UPDATE_TUPLE, tab_name, rid, before));
+        page_handle.read_record(rid.slot_no, before.data);
+        claim_version(versions_, rid, before.data, file_hdr_.record_size, context);
+        context->txn_->append_write_record(WType::UPDATE_TUPLE, tab_name, rid, &before);
+        RmRecord after(file_hdr_.record_size, buf);
+        UpdateLogRecord log_record(context->txn_->get_transaction_id(), before, after, rid, oid_);
+        write_log(context, &log_record, page_handle.page);
     }
     
+    if (delta_log_.is_active()) {
+        std::vector<char> before(file_hdr_.record_size);
+        page_handle.read_record(rid.slot_no, before.data());
+        delta_log_.append(rid, before.data(), buf, file_hdr_.record_size);
+    }
+
     // 2. 更新记录
-    char* slot_data = page_handle.get_slot(rid.slot_no);
-    memcpy(slot_data, buf, file_hdr_.record_size);
+    page_handle.write_record(rid.slot_no, buf);
     
-    // 释放page handle（标记为dirty）
-    buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), true);
+    // guard析构时释放page handle（标记为dirty）
 }
 
 /**
  * 以下函数为辅助函数，仅提供参考，可以选择完成如下函数，也可以删除如下函数，在单元测试中不涉及如下函数接口的直接调用
 */
 /**
- * @description: 获取指定页面的页面句柄
+ * @description: 检查页面号并从缓冲池获取页面
  * @param {int} page_no 页面号
- * @return {RmPageHandle} 指定页面的句柄
+ * @return {Page*} 已被固定的页面
  */
-RmPageHandle RmFileHandle::fetch_page_handle(int page_no) const {
-    // Todo:
-    // 使用缓冲池获取指定页面，并生成page_handle返回给上层
+static Page *fetch_record_page(BufferPoolManager *bpm, DiskManager *disk_manager, int fd, int page_no,
+                               int num_pages, ScanRing *ring = nullptr) {
     // if page_no is invalid, throw PageNotExistError exception
-    
-    // 检查page_no是否有效
-    if (page_no >= file_hdr_.num_pages) {
-        throw PageNotExistError("", page_no);
+    if (page_no < 0 || page_no >= num_pages) {
+        throw PageNotExistError(disk_manager->get_file_name(fd), page_no);
     }
-    
-    // 使用缓冲池获取指定页面
-    PageId page_id = {fd_, page_no};
-    Page* page = buffer_pool_manager_->fetch_page(page_id);
-    
-    // 生成并返回RmPageHandle
-    return RmPageHandle(&file_hdr_, page);
+    Page *page = bpm->fetch_page(PageId{fd, page_no}, ring);
+    if (page == nullptr) {
+        throw InternalError("RmFileHandle: no free frame in buffer pool");
+    }
+    return page;
 }
 
 /**
- * @description: 创建一个新的page handle
- * @return {RmPageHandle} 新的PageHandle
+ * @description: 整理文件：从文件末尾的页面开始，把页面上的记录依次移动到文件前部页面的空闲位置，
+ *              直到前部页面放不下为止，然后截断文件末尾的空页面，截断的页面号之后重新分配。
+ *              记录移动后记录号发生变化，每移动一条记录调用一次on_move，由调用者维护索引；移动不记入事务的写集合。
+ *              调用者需保证整理期间没有其它事务访问该文件，且文件上没有未提交的修改
+ * @param {RmMoveCallback&} on_move 记录移动后的回调
+ * @return {int} 截断的页面个数
  */
-RmPageHandle RmFileHandle::create_new_page_handle() {
-    // Todo:
-    // 1.使用缓冲池来创建一个新page
-    // 2.更新page handle中的相关信息
-    // 3.更新file_hdr_
-    
+int RmFileHandle::vacuum(const RmMoveCallback& on_move) {
+    load_free_space_map();
+    load_zone_map();
+    int page_size = disk_manager_->get_page_size();
+    bool slotted = file_hdr_.format == RM_FORMAT_SLOTTED;
+
+    // slotted格式的记录数据可能存放在其它页面，按数据所在的页面分组，移走该页面时这些记录也一同移动
+    std::unordered_map<int, std::vector<Rid>> forwarded;
+    if (slotted) {
+        for (int page_no = RM_FIRST_RECORD_PAGE; page_no < file_hdr_.num_pages; page_no++) {
+            ReadPageGuard guard = fetch_page_read(page_no);
+            RmSlottedPage page(guard.get_page(), page_size);
+            for (int slot_no = 0; slot_no < page.num_slots(); slot_no++) {
+                if (page.is_record(slot_no) && page.is_forward(slot_no)) {
+                    forwarded[page.get_forward(slot_no).page_no].push_back(Rid{page_no, slot_no});
+                }
+            }
+        }
+    }
+
+    std::vector<char> record(file_hdr_.record_size);
+    std::vector<char> data(slotted ? rm_max_encoded_size(file_hdr_) : 0);
+    int dst = RM_FIRST_RECORD_PAGE;         // 接收记录的页面，从文件开头向后移动
+    int src = file_hdr_.num_pages - 1;      // 移出记录的页面，从文件末尾向前移动
+    bool full = false;
+    while (src > dst && !full) {
+        std::vector<Rid> rids = forwarded[src];
+        {
+            ReadPageGuard guard = fetch_page_read(src);
+            if (slotted) {
+                RmSlottedPage page(guard.get_page(), page_size);
+                for (int slot_no = 0; slot_no < page.num_slots(); slot_no++) {
+                    if (page.is_record(slot_no)) {
+                        rids.push_back(Rid{src, slot_no});
+                    }
+                }
+            } else {
+                RmPageHandle page_handle(&file_hdr_, guard.get_page());
+                for (int slot_no = Bitmap::first_bit(true, page_handle.bitmap, file_hdr_.num_records_per_page);
+                     slot_no < file_hdr_.num_records_per_page;
+                     slot_no = Bitmap::next_bit(true, page_handle.bitmap, file_hdr_.num_records_per_page, slot_no)) {
+                    rids.push_back(Rid{src, slot_no});
+                }
+            }
+        }
+
+        for (auto& rid : rids) {
+            int len = 0;
+            if (slotted) {
+                // 原位置在更靠后的页面上的记录已经移动过了
+                if (!read_slotted_record(rid, record.data())) {
+                    continue;
+                }
+                len = rm_encode_record(file_hdr_, &dict_, record.data(), data.data());
+            } else {
+                ReadPageGuard guard = fetch_page_read(rid.page_no);
+                RmPageHandle(&file_hdr_, guard.get_page()).read_record(rid.slot_no, record.data());
+            }
+            Rid new_rid{RM_NO_PAGE, -1};
+            for (; dst < src; dst++) {
+                new_rid = move_to_page(dst, record.data(), data.data(), len);
+                if (new_rid.page_no != RM_NO_PAGE) {
+                    break;
+                }
+            }
+            if (new_rid.page_no == RM_NO_PAGE) {
+                full = true;
+                break;
+            }
+            delete_record(rid, nullptr);
+            // 移动记录不改变记录数，抵消delete_record中的计数
+            record_delta_.fetch_add(1, std::memory_order_relaxed);
+            on_move(rid, new_rid, record.data());
+        }
+        if (!full) {
+            src--;
+        }
+    }
+
+    // 截断文件末尾的空页面
+    int num_pages = file_hdr_.num_pages;
+    while (num_pages > RM_FIRST_RECORD_PAGE) {
+        ReadPageGuard guard = fetch_page_read(num_pages - 1);
+        if (get_used_space(guard.get_page()) > 0) {
+            break;
+        }
+        num_pages--;
+    }
+    int num_freed = file_hdr_.num_pages - num_pages;
+    if (num_freed > 0) {
+        truncate_pages(num_pages);
+    }
+    return num_freed;
+}
+
+/**
+ * @description: 故障恢复的重做、回滚以及事务回滚使用：把rid上的记录置为buf，记录不存在时在rid上插入，
+ *              之后页面记下日志号lsn。不加锁、不写日志、不记入写集合，重复执行的结果相同
+ * @param {Rid&} rid 记录号
+ * @param {char*} buf 记录的数据
+ * @param {lsn_t} lsn 描述这次修改的日志，为INVALID_LSN时不修改页面的日志号
+ */
+void RmFileHandle::set_record(const Rid& rid, char* buf, lsn_t lsn) {
+    ensure_page(rid.page_no);
+    if (is_record(rid)) {
+        update_record(rid, buf, nullptr);
+    } else {
+        insert_record(rid, buf);
+    }
+    stamp_page(rid.page_no, lsn);
+}
+
+/**
+ * @description: 同set_record，删除rid上的记录，记录不存在时什么也不做
+ */
+void RmFileHandle::erase_record(const Rid& rid, lsn_t lsn) {
+    ensure_page(rid.page_no);
+    if (is_record(rid)) {
+        delete_record(rid, nullptr);
+    }
+    stamp_page(rid.page_no, lsn);
+}
+
+/**
+ * @description: 故障恢复重做之前读取页面上的日志号，页面上的修改不早于这条日志时不需要重做。
+ *              故障时文件头中的页面个数可能还没有写回，页面不在文件中时先扩展文件
+ * @return {lsn_t} 页面的日志号，从未写过日志的页面为0
+ */
+lsn_t RmFileHandle::get_page_lsn(int page_no) {
+    ensure_page(page_no);
+    ReadPageGuard guard = fetch_page_read(page_no);
+    return guard.get_page()->get_page_lsn();
+}
+
+/**
+ * @description: 把文件头写回磁盘，检查点之后故障恢复从文件头得到文件中的页面个数
+ */
+void RmFileHandle::flush_file_hdr() {
+    RmFileHdr file_hdr;
+    {
+        std::scoped_lock lock{latch_};
+        file_hdr = file_hdr_;
+    }
+    disk_manager_->write_page(fd_, RM_FILE_HDR_PAGE, reinterpret_cast<char *>(&file_hdr), sizeof(file_hdr));
+}
+
+/**
+ * @description: 保证页面page_no在文件中：文件头记录的页面个数不够时扩展文件，扩展出来的页面初始化为空页面
+ * @param {int} page_no 页面号
+ */
+void RmFileHandle::ensure_page(int page_no) {
+    if (page_no < file_hdr_.num_pages) {
+        return;
+    }
+    load_free_space_map();
+    std::scoped_lock lock{latch_};
+    int num_pages = file_hdr_.num_pages;
+    if (page_no < num_pages) {
+        return;
+    }
+    struct stat stat_buf;
+    if (fstat(fd_, &stat_buf) != 0) {
+        throw UnixError();
+    }
+    int page_size = disk_manager_->get_page_size();
+    if (stat_buf.st_size < static_cast<off_t>(page_no + 1) * page_size) {
+        disk_manager_->truncate_file(fd_, page_no + 1);
+    } else if (disk_manager_->get_fd2pageno(fd_) <= page_no) {
+        disk_manager_->set_fd2pageno(fd_, page_no + 1);
+    }
+    file_hdr_.num_pages = page_no + 1;
+    for (int new_page_no = num_pages; new_page_no <= page_no; new_page_no++) {
+        WritePageGuard guard = fetch_page_write(new_page_no);
+        if (file_hdr_.format == RM_FORMAT_SLOTTED) {
+            RmSlottedPage page(guard.get_page(), page_size);
+            if (!page.is_initialized()) {
+                page.init();
+            }
+        }
+        int used = get_used_space(guard.get_page());
+        fsm_.add_page(new_page_no, used);
+        // 故障前已经写回的页面上可能有不再重做的记录，区间未知
+        if (used > 0) {
+            zone_map_.widen_all(new_page_no);
+        }
+    }
+}
+
+void RmFileHandle::stamp_page(int page_no, lsn_t lsn) {
+    if (lsn == INVALID_LSN) {
+        return;
+    }
+    WritePageGuard guard = fetch_page_write(page_no);
+    guard.get_page()->set_page_lsn(lsn);
+}
+
+/**
+ * @description: 获取指定页面并加共享latch
+ * @param {int} page_no 页面号
+ * @return {ReadPageGuard} 指定页面的读保护，离开作用域时自动释放页面
+ */
+ReadPageGuard RmFileHandle::fetch_page_read(int page_no, ScanRing *ring) const {
+    Page *page = fetch_record_page(buffer_pool_manager_, disk_manager_, fd_, page_no, file_hdr_.num_pages, ring);
+    return ReadPageGuard(buffer_pool_manager_, page);
+}
+
+/**
+ * @description: 获取指定页面并加排他latch
+ * @param {int} page_no 页面号
+ * @return {WritePageGuard} 指定页面的写保护，离开作用域时自动释放页面并标记为脏页
+ */
+WritePageGuard RmFileHandle::fetch_page_write(int page_no) const {
+    Page *page = fetch_record_page(buffer_pool_manager_, disk_manager_, fd_, page_no, file_hdr_.num_pages);
+    return WritePageGuard(buffer_pool_manager_, page);
+}
+
+/**
+ * @description: 请求缓冲池异步读入从first_page_no开始的count个页面，超出文件范围的页面会被忽略
+ * @param {int} first_page_no 第一个页面的页面号
+ * @param {int} count 页面个数
+ * @param {shared_ptr<ScanRing>} ring 预读页面装入的环形缓冲区，为空时使用整个缓冲池
+ */
+void RmFileHandle::prefetch_pages(int first_page_no, int count, std::shared_ptr<ScanRing> ring) const {
+    count = std::min(count, file_hdr_.num_pages - first_page_no);
+    if (first_page_no >= 0 && count > 0) {
+        buffer_pool_manager_->prefetch(fd_, first_page_no, count, std::move(ring));
+    }
+}
+
+/**
+ * @description: 打开文件后第一次修改文件之前，扫描所有页面的页头重建空闲空间映射，只执行一次
+ */
+void RmFileHandle::load_free_space_map() {
+    std::call_once(fsm_once_, [this]() {
+        fsm_.reset(get_fsm_capacity());
+        int num_pages = file_hdr_.num_pages;
+        for (int page_no = RM_FIRST_RECORD_PAGE; page_no < num_pages; ++page_no) {
+            if ((page_no - RM_FIRST_RECORD_PAGE) % READ_AHEAD_PAGES == 0) {
+                prefetch_pages(page_no, READ_AHEAD_PAGES);
+            }
+            ReadPageGuard guard = fetch_page_read(page_no);
+            fsm_.update(page_no, get_used_space(guard.get_page()));
+        }
+    });
+}
+
+/**
+ * @description: 区间映射没有从文件中读入时，在第一次修改文件或者按区间扫描之前读出全部记录重建，只执行一次。
+ *              修改记录之前都先调用，重建期间修改文件的线程在这里等待；删除不修改区间，可以与重建同时进行
+ */
+void RmFileHandle::load_zone_map() const {
+    if (!zone_map_.enabled()) {
+        return;
+    }
+    std::call_once(zone_once_, [this]() {
+        if (zone_map_.is_loaded()) {
+            return;
+        }
+        int page_size = disk_manager_->get_page_size();
+        std::vector<char> record(file_hdr_.record_size);
+        int num_pages = file_hdr_.num_pages;
+        for (int page_no = RM_FIRST_RECORD_PAGE; page_no < num_pages; ++page_no) {
+            if ((page_no - RM_FIRST_RECORD_PAGE) % READ_AHEAD_PAGES == 0) {
+                prefetch_pages(page_no, READ_AHEAD_PAGES);
+            }
+            std::vector<Rid> forwarded;
+            {
+                ReadPageGuard guard = fetch_page_read(page_no);
+                if (file_hdr_.format == RM_FORMAT_SLOTTED) {
+                    RmSlottedPage page(guard.get_page(), page_size);
+                    for (int slot_no = 0; slot_no < page.num_slots(); slot_no++) {
+                        if (!page.is_record(slot_no)) {
+                            continue;
+                        }
+                        if (page.is_forward(slot_no)) {
+                            forwarded.push_back(Rid{page_no, slot_no});
+                        } else {
+                            rm_decode_record(file_hdr_, &dict_, page.get_data(slot_no), record.data());
+                            zone_map_.widen(page_no, record.data());
+                        }
+                    }
+                } else {
+                    RmPageHandle page_handle(&file_hdr_, guard.get_page());
+                    for (int slot_no = Bitmap::first_bit(true, page_handle.bitmap, file_hdr_.num_records_per_page);
+                         slot_no < file_hdr_.num_records_per_page;
+                         slot_no = Bitmap::next_bit(true, page_handle.bitmap, file_hdr_.num_records_per_page,
+                                                    slot_no)) {
+                        page_handle.read_record(slot_no, record.data());
+                        zone_map_.widen(page_no, record.data());
+                    }
+                }
+            }
+            // 每次只持有一个页面latch，释放原页面之后再读取已移动的记录
+            for (auto &rid : forwarded) {
+                if (read_slotted_record(rid, record.data())) {
+                    zone_map_.widen(page_no, record.data());
+                }
+            }
+        }
+        zone_map_.set_loaded();
+    });
+}
+
+/**
+ * @description: 创建一个新的page handle，并加入当前线程在空闲空间映射中的分区
+ * @return {WritePageGuard} 新页面的写保护
+ */
+WritePageGuard RmFileHandle::create_new_page_handle() {
+    load_free_space_map();
+    // 持有latch_直到file_hdr_.num_pages包含新页面，其它线程从映射中选到新页面时页面号已经合法
+    std::scoped_lock lock{latch_};
+
     // 1. 使用缓冲池创建一个新page
     PageId page_id = {fd_, INVALID_PAGE_ID};
-    Page* page = buffer_pool_manager_->new_page(&page_id);
-    
-    // 2. 创建page handle
-    RmPageHandle page_handle(&file_hdr_, page);
-    
-    // 初始化page header
-    page_handle.page_hdr->next_free_page_no = RM_NO_PAGE;
-    page_handle.page_hdr->num_records = 0;
+    WritePageGuard guard = buffer_pool_manager_->new_page_guarded(&page_id);
+    if (!guard) {
+        throw InternalError("RmFileHandle: no free frame in buffer pool");
+    }
     
-    // 初始化bitmap
-    Bitmap::init(page_handle.bitmap, file_hdr_.bitmap_size);
+    // 2. 初始化page header和bitmap（slotted格式为slot目录）
+    if (file_hdr_.format == RM_FORMAT_SLOTTED) {
+        RmSlottedPage(guard.get_page(), disk_manager_->get_page_size()).init();
+    } else {
+        RmPageHandle page_handle(&file_hdr_, guard.get_page());
+        page_handle.page_hdr->next_free_page_no = RM_NO_PAGE;
+        page_handle.page_hdr->num_records = 0;
+        Bitmap::init(page_handle.bitmap, file_hdr_.bitmap_size);
+    }
     
-    // 3. 更新file_hdr_
+    // 3. 更新file_hdr_和空闲空间映射
     file_hdr_.num_pages++;
-    file_hdr_.first_free_page_no = page_id.page_no;
+    fsm_.add_page(page_id.page_no, 0);
     
-    return page_handle;
+    return guard;
 }
 
 /**
- * @brief 创建或获取一个空闲的page handle
+ * @brief 从空闲空间映射中选取一个空闲空间不少于needed的页面，没有时创建新页面
  *
- * @return RmPageHandle 返回生成的空闲page handle
- * @note pin the page, remember to unpin it outside!
+ * @param needed 需要的空闲空间，单位与空闲空间映射相同
+ * @return WritePageGuard 返回空闲页面的写保护
  */
-RmPageHandle RmFileHandle::create_page_handle() {
-    // Todo:
-    // 1. 判断file_hdr_中是否还有空闲页
-    //     1.1 没有空闲页：使用缓冲池来创建一个新page；可直接调用create_new_page_handle()
-    //     1.2 有空闲页：直接获取第一个空闲页
-    // 2. 生成page handle并返回给上层
-    
-    // 1. 判断是否有空闲页
-    if (file_hdr_.first_free_page_no == RM_NO_PAGE) {
-        // 1.1 没有空闲页，创建新页面
-        return create_new_page_handle();
+WritePageGuard RmFileHandle::create_page_handle(int needed) {
+    // 映射中的桶只是空闲空间的粗略估计，多次选到放不下的页面后直接创建新页面
+    static constexpr int MAX_PICK_ATTEMPTS = 4;
+    for (int attempt = 0; attempt < MAX_PICK_ATTEMPTS; attempt++) {
+        int page_no = fsm_.pick(needed);
+        if (page_no == RM_NO_PAGE) {
+            break;
+        }
+        WritePageGuard guard = fetch_page_write(page_no);
+        if (get_free_space(guard.get_page()) >= needed) {
+            return guard;
+        }
+        // 选取页面和获取页面latch之间，页面被其它线程填满，更新映射后重新选取
+        fsm_.update(page_no, get_used_space(guard.get_page()));
     }
-    
-    // 1.2 有空闲页，获取第一个空闲页
-    return fetch_page_handle(file_hdr_.first_free_page_no);
+    return create_new_page_handle();
 }
 
 /**
- * @description: 当一个页面从没有空闲空间的状态变为有空闲空间状态时，更新文件头和页头中空闲页面相关的元数据
+ * @description: 空闲空间映射中一个页面的空闲空间总量：bitmap格式为每页的slot个数，slotted格式为页面中可用的字节数
  */
-void RmFileHandle::release_page_handle(RmPageHandle&page_handle) {
-    // Todo:
-    // 当page从已满变成未满，考虑如何更新：
-    // 1. page_handle.page_hdr->next_free_page_no
-    // 2. file_hdr_.first_free_page_no
-    
-    // 1. 更新page_hdr的next_free_page_no，指向原来的第一个空闲页
-    page_handle.page_hdr->next_free_page_no = file_hdr_.first_free_page_no;
-    
-    // 2. 更新file_hdr的first_free_page_no，指向当前页面
-    file_hdr_.first_free_page_no = page_handle.page->get_page_id().page_no;
-}
\ No newline at end of file
+int RmFileHandle::get_fsm_capacity() const {
+    if (file_hdr_.format == RM_FORMAT_SLOTTED) {
+        return RmSlottedPage::capacity(disk_manager_->get_page_size());
+    }
+    return file_hdr_.num_records_per_page;
+}
+
+/**
+ * @description: 页面的空闲空间，单位与空闲空间映射相同，调用时需持有页面latch
+ */
+int RmFileHandle::get_free_space(Page *page) const {
+    return get_fsm_capacity() - get_used_space(page);
+}
+
+/**
+ * @description: 页面已使用的空间，单位与空闲空间映射相同，调用时需持有页面latch
+ */
+int RmFileHandle::get_used_space(Page *page) const {
+    if (file_hdr_.format == RM_FORMAT_SLOTTED) {
+        return RmSlottedPage(page, disk_manager_->get_page_size()).used_space();
+    }
+    return RmPageHandle(&file_hdr_, page).page_hdr->num_records;
+}
+
+/**
+ * @description: 整理文件时把一条记录写入指定页面的空闲位置
+ * @param {int} page_no 页面号
+ * @param {char*} buf 记录数据，bitmap和PAX格式使用
+ * @param {char*} data 编码后的记录数据，slotted格式使用
+ * @param {int} len 编码后的记录长度
+ * @return {Rid} 记录写入的位置，页面放不下时返回{RM_NO_PAGE, -1}
+ */
+Rid RmFileHandle::move_to_page(int page_no, const char* buf, const char* data, int len) {
+    WritePageGuard guard = fetch_page_write(page_no);
+    if (file_hdr_.format == RM_FORMAT_SLOTTED) {
+        RmSlottedPage page(guard.get_page(), disk_manager_->get_page_size());
+        int slot_no = page.insert(data, len, 0);
+        if (slot_no < 0) {
+            return Rid{RM_NO_PAGE, -1};
+        }
+        zone_map_.widen(page_no, buf);
+        fsm_.update(page_no, page.used_space());
+        return Rid{page_no, slot_no};
+    }
+    RmPageHandle page_handle(&file_hdr_, guard.get_page());
+    int slot_no = Bitmap::first_bit(false, page_handle.bitmap, file_hdr_.num_records_per_page);
+    if (slot_no == file_hdr_.num_records_per_page) {
+        return Rid{RM_NO_PAGE, -1};
+    }
+    zone_map_.widen(page_no, buf);
+    page_handle.write_record(slot_no, buf);
+    Bitmap::set(page_handle.bitmap, slot_no);
+    page_handle.page_hdr->num_records++;
+    fsm_.update(page_no, page_handle.page_hdr->num_records);
+    return Rid{page_no, slot_no};
+}
+
+/**
+ * @description: 把文件截断为num_pages个页面：从缓冲池中移除被截断的页面，再截断磁盘文件并更新文件头和空闲空间映射
+ * @param {int} num_pages 截断后文件的页面个数
+ */
+void RmFileHandle::truncate_pages(int num_pages) {
+    std::scoped_lock lock{latch_};
+    for (int page_no = num_pages; page_no < file_hdr_.num_pages; page_no++) {
+        if (!buffer_pool_manager_->delete_page(PageId{fd_, page_no})) {
+            throw InternalError("RmFileHandle::truncate_pages: page is still pinned");
+        }
+    }
+    file_hdr_.num_pages = num_pages;
+    disk_manager_->truncate_file(fd_, num_pages);
+    fsm_.truncate(num_pages);
+    zone_map_.truncate(num_pages);
+}
+
+/**
+ * 以下函数实现slotted格式文件的记录操作。记录以编码后的变长格式存放，slot号在记录的生命周期内保持不变；
+ * 更新后在原页面放不下的记录移动到其它页面，原slot改为存放新位置的Rid。
+ * 每一步最多持有一个页面latch，移动记录时先写入新位置，再修改原slot，最后删除旧位置
+ */
+
+/**
+ * @description: 读取slotted格式文件中的一条记录并解码，记录已移动时读取新位置
+ * @param {Rid&} rid 记录号
+ * @param {char*} out 解码后的记录，长度为file_hdr_.record_size
+ * @return {bool} rid上没有记录时返回false
+ */
+bool RmFileHandle::read_slotted_record(const Rid& rid, char* out) const {
+    int page_size = disk_manager_->get_page_size();
+    Rid target;
+    {
+        ReadPageGuard guard = fetch_page_read(rid.page_no);
+        RmSlottedPage page(guard.get_page(), page_size);
+        if (!page.is_record(rid.slot_no)) {
+            return false;
+        }
+        if (!page.is_forward(rid.slot_no)) {
+            rm_decode_record(file_hdr_, &dict_, page.get_data(rid.slot_no), out);
+            return true;
+        }
+        target = page.get_forward(rid.slot_no);
+    }
+    // 回滚删除时先占住原slot再写入新位置，尚未写入新位置的记录视为不存在
+    if (target.page_no == RM_NO_PAGE) {
+        return false;
+    }
+    ReadPageGuard guard = fetch_page_read(target.page_no);
+    RmSlottedPage page(guard.get_page(), page_size);
+    rm_decode_record(file_hdr_, &dict_, page.get_data(target.slot_no), out);
+    return true;
+}
+
+/**
+ * @description: 把编码后的记录数据写入一个空间足够的页面
+ * @param {char*} data 编码后的记录数据
+ * @param {int} len 数据长度
+ * @param {int} flags slot的标记
+ * @param {shared_ptr<TxnStamp>*} stamp 不为空时在页面latch内记下插入之前记录不存在
+ * @param {char*} record 解码后的记录，不为空时在页面latch内扩大页面的区间；移动过来的记录按原位置计算，为空
+ * @return {Rid} 记录写入的位置
+ */
+Rid RmFileHandle::insert_slotted(const char* data, int len, int flags, const std::shared_ptr<TxnStamp>* stamp,
+                                 const char* record) {
+    WritePageGuard guard = create_page_handle(len + static_cast<int>(sizeof(RmSlot)));
+    RmSlottedPage page(guard.get_page(), disk_manager_->get_page_size());
+    Rid rid{guard.get_page()->get_page_id().page_no, page.insert(data, len, flags)};
+    if (rid.slot_no < 0) {
+        throw InternalError("RmFileHandle: no space for record in page");
+    }
+    if (record != nullptr) {
+        zone_map_.widen(rid.page_no, record);
+    }
+    if (stamp != nullptr) {
+        versions_.push(rid, *stamp, nullptr, file_hdr_.record_size);
+    }
+    fsm_.update(rid.page_no, page.used_space());
+    return rid;
+}
+
+/**
+ * @description: slotted格式的批量插入，每个页面只获取一次写保护，依次写入页面中放得下的记录
+ */
+void RmFileHandle::insert_records_slotted(const char* buf, int num_records, std::vector<Rid>* rids,
+                                          Context* context) {
+    bool record_write = should_record_write(context);
+    std::string tab_name = record_write ? disk_manager_->get_file_name(fd_) : std::string();
+    auto stamp = version_stamp(context);
+    int page_size = disk_manager_->get_page_size();
+
+    load_free_space_map();
+    std::vector<char> data(rm_max_encoded_size(file_hdr_));
+    int inserted = 0;
+    while (inserted < num_records) {
+        const char* record = buf + static_cast<size_t>(inserted) * file_hdr_.record_size;
+        int len = rm_encode_record(file_hdr_, &dict_, record, data.data());
+        WritePageGuard guard = create_page_handle(len + static_cast<int>(sizeof(RmSlot)));
+        RmSlottedPage page(guard.get_page(), page_size);
+        page_id_t page_no = guard.get_page()->get_page_id().page_no;
+
+        int slot_no;
+        while ((slot_no = page.insert(data.data(), len, 0)) >= 0) {
+            Rid rid = {page_no, slot_no};
+            zone_map_.widen(page_no, record);
+            rids->push_back(rid);
+            delta_log_.append(rid, nullptr, record, file_hdr_.record_size);
+            if (stamp != nullptr) {
+                versions_.push(rid, *stamp, nullptr, file_hdr_.record_size);
+            }
+            if (record_write) {
+                context->txn_->append_write_record(WType::INSERT_TUPLE, tab_name, rid);
+                RmRecord value(file_hdr_.record_size, const_cast<char *>(record));
+                InsertLogRecord log_record(context->txn_->get_transaction_id(), value, rid, oid_);
+                write_log(context, &log_record, guard.get_page());
+            }
+            if (++inserted == num_records) {
+                break;
+            }
+            record = buf + static_cast<size_t>(inserted) * file_hdr_.record_size;
+            len = rm_encode_record(file_hdr_, &dict_, record, data.data());
+        }
+        fsm_.update(page_no, page.used_space());
+    }
+}
+
+/**
+ * @description: slotted格式在指定位置插入记录，原页面放不下时记录写入其它页面，原slot存放新位置
+ */
+void RmFileHandle::insert_record_slotted(const Rid& rid, char* buf) {
+    int page_size = disk_manager_->get_page_size();
+    std::vector<char> data(rm_max_encoded_size(file_hdr_));
+    int len = rm_encode_record(file_hdr_, &dict_, buf, data.data());
+
+    load_free_space_map();
+    {
+        WritePageGuard guard = fetch_page_write(rid.page_no);
+        RmSlottedPage page(guard.get_page(), page_size);
+        if (page.is_used(rid.slot_no)) {
+            throw InternalError("RmFileHandle::insert_record(rid): slot already occupied");
+        }
+        if (page.insert_at(rid.slot_no, data.data(), len, 0)) {
+            fsm_.update(rid.page_no, page.used_space());
+            return;
+        }
+        // 先用尚未指向任何位置的Rid占住原slot，避免写入新位置期间被其它插入复用
+        Rid placeholder{RM_NO_PAGE, -1};
+        if (!page.insert_at(rid.slot_no, reinterpret_cast<const char*>(&placeholder), sizeof(Rid),
+                            RM_SLOT_FORWARD)) {
+            throw InternalError("RmFileHandle::insert_record(rid): no space in page");
+        }
+        fsm_.update(rid.page_no, page.used_space());
+    }
+    Rid target = insert_slotted(data.data(), len, RM_SLOT_MOVED);
+    WritePageGuard guard = fetch_page_write(rid.page_no);
+    RmSlottedPage page(guard.get_page(), page_size);
+    page.update(rid.slot_no, reinterpret_cast<const char*>(&target), sizeof(Rid), RM_SLOT_FORWARD);
+}
+
+/**
+ * @description: slotted格式删除记录，记录已移动时同时删除新位置上的数据
+ */
+void RmFileHandle::delete_record_slotted(const Rid& rid, Context* context) {
+    int page_size = disk_manager_->get_page_size();
+    lsn_t lsn = INVALID_LSN;    // 日志号记在记录所在的页面上
+    if (should_record_write(context)) {
+        RmRecord before(file_hdr_.record_size);
+        if (!read_slotted_record(rid, before.data)) {
+            throw RecordNotFoundError(rid.page_no, rid.slot_no);
+        }
+        claim_version(versions_, rid, before.data, file_hdr_.record_size, context);
+        std::string tab_name = disk_manager_->get_file_name(fd_);
+        context->txn_->append_write_record(WType::DELETE_TUPLE, tab_name, rid, &before);
+        DeleteLogRecord log_record(context->txn_->get_transaction_id(), before, rid, oid_);
+        lsn = write_log(context, &log_record, nullptr);
+    }
+    // 在线建索引期间先读出被删除的记录，在原slot的页面latch内记下删除
+    std::vector<char> before;
+    if (delta_log_.is_active()) {
+        before.resize(file_hdr_.record_size);
+        if (!read_slotted_record(rid, before.data())) {
+            throw RecordNotFoundError(rid.page_no, rid.slot_no);
+        }
+    }
+
+    Rid target{RM_NO_PAGE, -1};
+    {
+        WritePageGuard guard = fetch_page_write(rid.page_no);
+        RmSlottedPage page(guard.get_page(), page_size);
+        if (!page.is_record(rid.slot_no)) {
+            throw RecordNotFoundError(rid.page_no, rid.slot_no);
+        }
+        if (!before.empty()) {
+            delta_log_.append(rid, before.data(), nullptr, file_hdr_.record_size);
+        }
+        if (lsn != INVALID_LSN) {
+            guard.get_page()->set_page_lsn(lsn);
+        }
+        if (page.is_forward(rid.slot_no)) {
+            target = page.get_forward(rid.slot_no);
+        }
+        page.erase(rid.slot_no);
+        fsm_.update(rid.page_no, page.used_space());
+    }
+    if (target.page_no != RM_NO_PAGE) {
+        WritePageGuard guard = fetch_page_write(target.page_no);
+        RmSlottedPage page(guard.get_page(), page_size);
+        page.erase(target.slot_no);
+        fsm_.update(target.page_no, page.used_space());
+    }
+}
+
+/**
+ * @description: slotted格式更新记录，优先在记录当前所在的页面内完成，页面放不下时移动到其它页面
+ */
+void RmFileHandle::update_record_slotted(const Rid& rid, char* buf, Context* context) {
+    int page_size = disk_manager_->get_page_size();
+    lsn_t lsn = INVALID_LSN;    // 日志号记在记录所在的页面上
+    if (should_record_write(context)) {
+        RmRecord before(file_hdr_.record_size);
+        if (!read_slotted_record(rid, before.data)) {
+            throw RecordNotFoundError(rid.page_no, rid.slot_no);
+        }
+        claim_version(versions_, rid, before.data, file_hdr_.record_size, context);
+        std::string tab_name = disk_manager_->get_file_name(fd_);
+        context->txn_->append_write_record(WType::UPDATE_TUPLE, tab_name, rid, &before);
+        RmRecord after(file_hdr_.record_size, buf);
+        UpdateLogRecord log_record(context->txn_->get_transaction_id(), before, after, rid, oid_);
+        lsn = write_log(context, &log_record, nullptr);
+    }
+    if (delta_log_.is_active()) {
+        std::vector<char> before(file_hdr_.record_size);
+        if (!read_slotted_record(rid, before.data())) {
+            throw RecordNotFoundError(rid.page_no, rid.slot_no);
+        }
+        delta_log_.append(rid, before.data(), buf, file_hdr_.record_size);
+    }
+    std::vector<char> data(rm_max_encoded_size(file_hdr_));
+    int len = rm_encode_record(file_hdr_, &dict_, buf, data.data());
+
+    // 1. 在记录当前所在的页面内更新
+    Rid old_target{RM_NO_PAGE, -1};
+    {
+        WritePageGuard guard = fetch_page_write(rid.page_no);
+        RmSlottedPage page(guard.get_page(), page_size);
+        if (!page.is_record(rid.slot_no)) {
+            throw RecordNotFoundError(rid.page_no, rid.slot_no);
+        }
+        if (lsn != INVALID_LSN) {
+            guard.get_page()->set_page_lsn(lsn);
+        }
+        if (!page.is_forward(rid.slot_no)) {
+            if (page.update(rid.slot_no, data.data(), len, 0)) {
+                fsm_.update(rid.page_no, page.used_space());
+                return;
+            }
+        } else {
+            old_target = page.get_forward(rid.slot_no);
+        }
+    }
+    if (old_target.page_no != RM_NO_PAGE) {
+        WritePageGuard guard = fetch_page_write(old_target.page_no);
+        RmSlottedPage page(guard.get_page(), page_size);
+        if (page.update(old_target.slot_no, data.data(), len, RM_SLOT_MOVED)) {
+            fsm_.update(old_target.page_no, page.used_space());
+            return;
+        }
+    }
+
+    // 2. 写入新位置，原slot改为指向新位置（记录至少占用sizeof(Rid)字节，总能原地放下），最后删除旧位置
+    Rid target = insert_slotted(data.data(), len, RM_SLOT_MOVED);
+    {
+        WritePageGuard guard = fetch_page_write(rid.page_no);
+        RmSlottedPage page(guard.get_page(), page_size);
+        page.update(rid.slot_no, reinterpret_cast<const char*>(&target), sizeof(Rid), RM_SLOT_FORWARD);
+        fsm_.update(rid.page_no, page.used_space());
+    }
+    if (old_target.page_no != RM_NO_PAGE) {
+        WritePageGuard guard = fetch_page_write(old_target.page_no);
+        RmSlottedPage page(guard.get_page(), page_size);
+        page.erase(old_target.slot_no);
+        fsm_.update(old_target.page_no, page.used_space());
+    }
+}
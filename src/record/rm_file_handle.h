@@ -12,14 +12,28 @@ See the Mulan PSL v2 for more details. */
 
 #include <assert.h>
 
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
 
 #include "bitmap.h"
 #include "common/context.h"
 #include "rm_defs.h"
+#include "rm_delta_log.h"
+#include "rm_dictionary.h"
+#include "rm_free_space_map.h"
+#include "rm_slotted_page.h"
+#include "rm_version_store.h"
+#include "rm_zone_map.h"
 
 class RmManager;
 
+/* 整理文件时每移动一条记录调用一次：原记录号、新记录号以及记录数据 */
+using RmMoveCallback = std::function<void(const Rid &old_rid, const Rid &new_rid, const char *record)>;
+
 /* 对表数据文件中的页面进行封装 */
 struct RmPageHandle {
     const RmFileHdr *file_hdr;  // 当前页面所在文件的文件头指针
@@ -34,10 +48,39 @@ struct RmPageHandle {
         slots = bitmap + file_hdr->bitmap_size;
     }
 
-    // 返回指定slot_no的slot存储收地址
+    // 返回指定slot_no的slot存储收地址，仅用于按行存放的bitmap格式
     char* get_slot(int slot_no) const {
         return slots + slot_no * file_hdr->record_size;  // slots的首地址 + slot个数 * 每个slot的大小(每个record的大小)
     }
+
+    // 返回PAX格式页面中第field_no个字段的列存储区首地址，第slot_no条记录的该字段位于首地址 + slot_no * 字段长度
+    char* get_column(int field_no) const {
+        return slots + file_hdr->num_records_per_page * file_hdr->fields[field_no].offset;
+    }
+
+    // 把slot_no上的记录复制到out中，PAX格式从各字段的列存储区拼装
+    void read_record(int slot_no, char* out) const {
+        if (file_hdr->format != RM_FORMAT_PAX) {
+            memcpy(out, get_slot(slot_no), file_hdr->record_size);
+            return;
+        }
+        for (int i = 0; i < file_hdr->num_fields; i++) {
+            const RmField& field = file_hdr->fields[i];
+            memcpy(out + field.offset, get_column(i) + slot_no * field.len, field.len);
+        }
+    }
+
+    // 把buf中的记录写入slot_no，PAX格式把各字段分别写入列存储区
+    void write_record(int slot_no, const char* buf) const {
+        if (file_hdr->format != RM_FORMAT_PAX) {
+            memcpy(get_slot(slot_no), buf, file_hdr->record_size);
+            return;
+        }
+        for (int i = 0; i < file_hdr->num_fields; i++) {
+            const RmField& field = file_hdr->fields[i];
+            memcpy(get_column(i) + slot_no * field.len, buf + field.offset, field.len);
+        }
+    }
 };
 
 /* 每个RmFileHandle对应一个表的数据文件，里面有多个page，每个page的数据封装在RmPageHandle中 */
@@ -49,7 +92,19 @@ class RmFileHandle {
     DiskManager *disk_manager_;
     BufferPoolManager *buffer_pool_manager_;
     int fd_;        // 打开文件后产生的文件句柄
+    oid_t oid_ = 0;     // 表的oid，写入日志代替表名
     RmFileHdr file_hdr_;    // 文件头，维护当前表文件的元数据
+    std::mutex latch_;      // 保护新页面的创建和file_hdr_.num_pages的增长
+    RmFreeSpaceMap fsm_;    // 空闲空间映射，插入时从中选取有空闲slot的页面
+    std::once_flag fsm_once_;   // 空闲空间映射在第一次修改文件之前重建
+    std::atomic<int64_t> record_delta_{0};  // 插入的记录数减去删除的记录数，用于在ANALYZE之间维护表的记录数
+    std::atomic<uint64_t> version_{0};      // 每次插入、删除或更新记录之后以及修改过记录的事务提交或回滚时加一，结果缓存据此判断缓存的结果是否失效
+    RmVersionStore versions_;               // 记录的旧版本，供快照读使用
+    RmDeltaLog delta_log_;                  // 在线建索引期间收集表上的修改
+    RmDictionary dict_;                     // 字典编码字段的字典，没有这样的字段时不打开字典文件
+    mutable RmZoneMap zone_map_;            // 各页面上区间映射字段的取值范围，没有这样的字段时不打开区间映射文件
+    mutable std::once_flag zone_once_;      // 区间映射没有从文件中读入时，在第一次修改文件或者按区间扫描之前重建
+    std::shared_mutex dml_latch_;           // DML语句执行期间共享持有，在线建索引切换到新索引时排他持有
 
    public:
     RmFileHandle(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, int fd)
@@ -60,33 +115,131 @@ class RmFileHandle {
         disk_manager_->read_page(fd, RM_FILE_HDR_PAGE, (char *)&file_hdr_, sizeof(file_hdr_));
         // disk_manager管理的fd对应的文件中，设置从file_hdr_.num_pages开始分配page_no
         disk_manager_->set_fd2pageno(fd, file_hdr_.num_pages);
+        if (file_hdr_.num_dict_fields > 0) {
+            dict_.open(disk_manager_->get_file_name(fd) + RmDictionary::SUFFIX, file_hdr_);
+        }
+        if (file_hdr_.num_zone_fields > 0) {
+            zone_map_.open(disk_manager_->get_file_name(fd) + RmZoneMap::SUFFIX, file_hdr_);
+        }
     }
 
-    RmFileHdr get_file_hdr() { return file_hdr_; }
+    const RmFileHdr &get_file_hdr() const { return file_hdr_; }
+
+    /* 字典编码字段的字典 */
+    const RmDictionary &get_dictionary() const { return dict_; }
+
+    /* 上次调用take_record_delta之后插入的记录数减去删除的记录数 */
+    int64_t get_record_delta() const { return record_delta_.load(std::memory_order_relaxed); }
+
+    /* 返回并清零记录数的变化量，ANALYZE重新统计记录数或者把变化量合并到统计信息中时调用 */
+    int64_t take_record_delta() { return record_delta_.exchange(0, std::memory_order_relaxed); }
+
+    /* 记录文件的版本号，两次读到的版本号相同说明其间没有修改过记录 */
+    uint64_t get_version() const { return version_.load(std::memory_order_acquire); }
+
+    /* 修改过记录的事务提交或回滚时调用：执行期间读到的版本号可能包含了还不可见的修改 */
+    void bump_version() { version_.fetch_add(1, std::memory_order_release); }
+
     int GetFd() { return fd_; }
 
-    /* 判断指定位置上是否已经存在一条记录，通过Bitmap来判断 */
+    /* 表的oid，打开表文件之后由SmManager设置 */
+    oid_t get_oid() const { return oid_; }
+    void set_oid(oid_t oid) { oid_ = oid; }
+
+    /* 记录的旧版本，快照读在读出页面上的记录之后查找 */
+    const RmVersionStore &get_versions() const { return versions_; }
+    RmVersionStore &get_versions() { return versions_; }
+
+    /* 在线建索引期间收集的修改 */
+    RmDeltaLog &get_delta_log() { return delta_log_; }
+
+    /* DML语句从取得表的元数据到维护完索引一直持有，期间表上不会出现新的索引 */
+    std::shared_lock<std::shared_mutex> lock_dml() { return std::shared_lock<std::shared_mutex>(dml_latch_); }
+
+    /* 在线建索引等待已经开始的DML语句结束，之后开始的DML语句等到新索引可见后再取得表的元数据 */
+    std::unique_lock<std::shared_mutex> block_dml() { return std::unique_lock<std::shared_mutex>(dml_latch_); }
+
+    /* 判断指定位置上是否已经存在一条记录，bitmap格式通过Bitmap来判断，slotted格式通过slot目录来判断 */
     bool is_record(const Rid &rid) const {
-        RmPageHandle page_handle = fetch_page_handle(rid.page_no);
+        ReadPageGuard guard = fetch_page_read(rid.page_no);
+        if (file_hdr_.format == RM_FORMAT_SLOTTED) {
+            return RmSlottedPage(guard.get_page(), disk_manager_->get_page_size()).is_record(rid.slot_no);
+        }
+        RmPageHandle page_handle(&file_hdr_, guard.get_page());
         return Bitmap::is_set(page_handle.bitmap, rid.slot_no);  // page的slot_no位置上是否有record
     }
 
     std::unique_ptr<RmRecord> get_record(const Rid &rid, Context *context) const;
 
+    RecordView get_record_view(const Rid &rid, Context *context) const;
+
+    RmVersionStore::Visibility read_snapshot_record(const Rid &rid, const ReadView &view, std::string *out) const;
+
     Rid insert_record(char *buf, Context *context);
 
     void insert_record(const Rid &rid, char *buf);
 
+    void put_record(const Rid &rid, char *buf, Context *context);
+
+    void insert_records(const char *buf, int num_records, std::vector<Rid> *rids, Context *context);
+
+    void claim_record(const Rid &rid, Context *context);
+
+    bool validate_scan(const ReadView &view, const std::function<bool(const char *)> &pred) const;
+
     void delete_record(const Rid &rid, Context *context);
 
     void update_record(const Rid &rid, char *buf, Context *context);
 
-    RmPageHandle create_new_page_handle();
+    int vacuum(const RmMoveCallback &on_move);
+
+    void set_record(const Rid &rid, char *buf, lsn_t lsn);
+
+    void erase_record(const Rid &rid, lsn_t lsn);
+
+    lsn_t get_page_lsn(int page_no);
+
+    void flush_file_hdr();
+
+    WritePageGuard create_new_page_handle();
 
-    RmPageHandle fetch_page_handle(int page_no) const;
+    ReadPageGuard fetch_page_read(int page_no, ScanRing *ring = nullptr) const;
+
+    WritePageGuard fetch_page_write(int page_no) const;
+
+    void prefetch_pages(int first_page_no, int count, std::shared_ptr<ScanRing> ring = nullptr) const;
 
    private:
-    RmPageHandle create_page_handle();
+    void load_free_space_map();
+
+    void load_zone_map() const;
+
+    WritePageGuard create_page_handle(int needed = 1);
+
+    int get_fsm_capacity() const;
+
+    int get_free_space(Page *page) const;
+
+    int get_used_space(Page *page) const;
+
+    Rid move_to_page(int page_no, const char *buf, const char *data, int len);
+
+    void truncate_pages(int num_pages);
+
+    void ensure_page(int page_no);
+
+    void stamp_page(int page_no, lsn_t lsn);
+
+    bool read_slotted_record(const Rid &rid, char *out) const;
+
+    Rid insert_slotted(const char *data, int len, int flags, const std::shared_ptr<TxnStamp> *stamp = nullptr,
+                       const char *record = nullptr);
+
+    void insert_records_slotted(const char *buf, int num_records, std::vector<Rid> *rids, Context *context);
+
+    void insert_record_slotted(const Rid &rid, char *buf);
+
+    void delete_record_slotted(const Rid &rid, Context *context);
 
-    void release_page_handle(RmPageHandle &page_handle);
+    void update_record_slotted(const Rid &rid, char *buf, Context *context);
 };
\ No newline at end of file
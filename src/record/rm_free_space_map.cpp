@@ -0,0 +1,169 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "rm_free_space_map.h"
+
+#include <functional>
+#include <thread>
+
+#include "rm_defs.h"
+
+/**
+ * @description: 清空映射
+ * @param {int} capacity 一个页面的空闲空间总量
+ * @param {int} num_partitions 分区个数
+ */
+void RmFreeSpaceMap::reset(int capacity, int num_partitions) {
+    std::scoped_lock lock{latch_};
+    capacity_ = capacity < 1 ? 1 : capacity;
+    num_partitions_ = num_partitions < 1 ? 1 : num_partitions;
+    entries_.clear();
+    free_pages_.assign(static_cast<size_t>(num_partitions_) * NUM_BUCKETS, std::set<int>());
+}
+
+/**
+ * @description: 页面中已使用的空间发生变化后更新页面所在的桶，不在映射中的页面按页面号划分分区
+ * @param {int} page_no 页面号
+ * @param {int} used 页面中已使用的空间
+ */
+void RmFreeSpaceMap::update(int page_no, int used) {
+    int bucket = bucket_of(used);
+    std::scoped_lock lock{latch_};
+    if (page_no < static_cast<int>(entries_.size()) && entries_[page_no].bucket == bucket) {
+        return;
+    }
+    int partition = page_no < static_cast<int>(entries_.size()) && entries_[page_no].bucket >= 0
+                        ? entries_[page_no].partition
+                        : page_no % num_partitions_;
+    move_page(page_no, partition, bucket);
+}
+
+/**
+ * @description: 把当前线程新建的页面加入当前线程的分区
+ * @param {int} page_no 页面号
+ * @param {int} used 页面中已使用的空间
+ */
+void RmFreeSpaceMap::add_page(int page_no, int used) {
+    int bucket = bucket_of(used);
+    std::scoped_lock lock{latch_};
+    move_page(page_no, local_partition(num_partitions_), bucket);
+}
+
+/**
+ * @description: 文件截断后从映射中移除页面号不小于num_pages的页面
+ * @param {int} num_pages 截断后文件的页面个数
+ */
+void RmFreeSpaceMap::truncate(int num_pages) {
+    std::scoped_lock lock{latch_};
+    for (int page_no = num_pages; page_no < static_cast<int>(entries_.size()); ++page_no) {
+        const Entry &entry = entries_[page_no];
+        if (entry.bucket > 0) {
+            free_pages_[entry.partition * NUM_BUCKETS + entry.bucket].erase(page_no);
+        }
+    }
+    if (num_pages < static_cast<int>(entries_.size())) {
+        entries_.resize(num_pages);
+    }
+}
+
+/**
+ * @description: 选取一个空闲空间不少于needed的页面：先在当前线程的分区中查找，找不到时再查找其它分区。
+ *              只查找空闲空间下限不少于needed的桶，needed超过所有桶的下限时查找最空的桶，由调用者检查页面的实际空间
+ * @param {int} needed 需要的空闲空间
+ * @return {int} 页面号，没有空闲页面时返回RM_NO_PAGE
+ */
+int RmFreeSpaceMap::pick(int needed) {
+    std::scoped_lock lock{latch_};
+    int first_bucket = 1;
+    while (first_bucket < NUM_BUCKETS - 1 && min_free(first_bucket) < needed) {
+        first_bucket++;
+    }
+    int local = local_partition(num_partitions_);
+    for (int i = 0; i < num_partitions_; ++i) {
+        int partition = (local + i) % num_partitions_;
+        for (int bucket = first_bucket; bucket < NUM_BUCKETS; ++bucket) {
+            const std::set<int> &pages = free_pages_[partition * NUM_BUCKETS + bucket];
+            if (!pages.empty()) {
+                return *pages.begin();
+            }
+        }
+    }
+    return RM_NO_PAGE;
+}
+
+/**
+ * @description: 获取页面所在的桶
+ * @param {int} page_no 页面号
+ * @return {int} 桶号，页面不在映射中时返回-1
+ */
+int RmFreeSpaceMap::get_bucket(int page_no) {
+    std::scoped_lock lock{latch_};
+    return page_no < static_cast<int>(entries_.size()) ? entries_[page_no].bucket : -1;
+}
+
+/**
+ * @description: 获取有空闲空间的页面个数
+ */
+size_t RmFreeSpaceMap::get_num_free_pages() {
+    std::scoped_lock lock{latch_};
+    size_t count = 0;
+    for (size_t i = 0; i < free_pages_.size(); ++i) {
+        if (i % NUM_BUCKETS != 0) {
+            count += free_pages_[i].size();
+        }
+    }
+    return count;
+}
+
+/**
+ * @description: 当前线程优先使用的分区
+ * @param {int} num_partitions 分区个数
+ */
+int RmFreeSpaceMap::local_partition(int num_partitions) {
+    return static_cast<int>(std::hash<std::thread::id>()(std::this_thread::get_id()) % num_partitions);
+}
+
+/**
+ * @description: 根据空闲空间的比例计算桶号，桶0表示页面已满
+ * @param {int} used 页面中已使用的空间
+ */
+int RmFreeSpaceMap::bucket_of(int used) const {
+    int num_free = capacity_ - used;
+    if (num_free <= 0) {
+        return 0;
+    }
+    return 1 + static_cast<int>(static_cast<int64_t>(num_free - 1) * (NUM_BUCKETS - 1) / capacity_);
+}
+
+/**
+ * @description: 桶中页面的空闲空间下限
+ * @param {int} bucket 桶号，不为0
+ */
+int RmFreeSpaceMap::min_free(int bucket) const {
+    return static_cast<int>((static_cast<int64_t>(bucket - 1) * capacity_ + NUM_BUCKETS - 2) / (NUM_BUCKETS - 1)) + 1;
+}
+
+/**
+ * @description: 把页面移动到指定分区的指定桶中，调用时需持有latch_
+ */
+void RmFreeSpaceMap::move_page(int page_no, int partition, int bucket) {
+    if (page_no >= static_cast<int>(entries_.size())) {
+        entries_.resize(page_no + 1);
+    }
+    Entry &entry = entries_[page_no];
+    if (entry.bucket > 0) {
+        free_pages_[entry.partition * NUM_BUCKETS + entry.bucket].erase(page_no);
+    }
+    entry.bucket = static_cast<int8_t>(bucket);
+    entry.partition = static_cast<int8_t>(partition);
+    if (bucket > 0) {
+        free_pages_[partition * NUM_BUCKETS + bucket].insert(page_no);
+    }
+}
@@ -0,0 +1,67 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include "common/config.h"
+
+/**
+ * @description: 表数据文件的空闲空间映射。按页面的空闲空间比例把页面分为NUM_BUCKETS个桶：
+ *              桶0为已满的页面，桶1到桶NUM_BUCKETS-1的空闲空间依次增多。
+ *              页面被划分到若干分区中，每个线程优先从自己的分区中选取页面，
+ *              使并发的插入落在不同的页面上；分区内优先选取空闲空间最少的页面，删除后腾出空间的页面会被优先填满。
+ *              空闲空间的单位由文件格式决定：bitmap格式为slot个数，slotted格式为字节数。
+ *              只在内存中维护，打开文件后第一次修改之前由RmFileHandle扫描页头重建
+ */
+class RmFreeSpaceMap {
+   public:
+    static constexpr int NUM_BUCKETS = 16;
+
+    RmFreeSpaceMap() = default;
+
+    void reset(int capacity, int num_partitions = RM_FSM_PARTITIONS);
+
+    void update(int page_no, int used);
+
+    void add_page(int page_no, int used);
+
+    void truncate(int num_pages);
+
+    int pick(int needed = 1);
+
+    int get_bucket(int page_no);
+
+    size_t get_num_free_pages();
+
+    static int local_partition(int num_partitions);
+
+   private:
+    struct Entry {
+        int8_t bucket = -1;     // 页面所在的桶，-1表示页面不在映射中
+        int8_t partition = 0;   // 页面所属的分区
+    };
+
+    int bucket_of(int used) const;
+
+    int min_free(int bucket) const;
+
+    void move_page(int page_no, int partition, int bucket);
+
+    int capacity_ = 1;              // 一个页面的空闲空间总量
+    int num_partitions_ = 1;
+    std::vector<Entry> entries_;                    // 以页面号为下标
+    std::vector<std::set<int>> free_pages_;         // 第partition * NUM_BUCKETS + bucket项为该分区该桶中的页面，桶0不记录
+    std::mutex latch_;
+};
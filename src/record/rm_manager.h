@@ -11,6 +11,10 @@ See the Mulan PSL v2 for more details. */
 #pragma once
 
 #include <assert.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
 
 #include "bitmap.h"
 #include "rm_defs.h"
@@ -30,23 +34,79 @@ class RmManager {
      * @description: 创建表的数据文件并初始化相关信息
      * @param {string&} filename 要创建的文件名称
      * @param {int} record_size 表中记录的大小
+     * @param {int} format 页面格式
+     * @param {vector<RmField>&} fields 按偏移排序的字段：slotted格式为变长字段，PAX格式为覆盖整条记录的全部字段
+     * @param {bool} compressed 是否创建页面压缩的文件
+     * @param {vector<RmDictField>&} dict_fields 按偏移排序的字典编码字段，只用于slotted格式，不能出现在fields中
+     * @param {vector<RmZoneField>&} zone_fields 维护区间映射的INT和FLOAT字段
      */ 
-    void create_file(const std::string& filename, int record_size) {
-        if (record_size < 1 || record_size > RM_MAX_RECORD_SIZE) {
-            throw InvalidRecordSizeError(record_size);
-        }
-        disk_manager_->create_file(filename);
-        int fd = disk_manager_->open_file(filename);
-
-        // 初始化file header
+    void create_file(const std::string& filename, int record_size, int format = RM_FORMAT_BITMAP,
+                     const std::vector<RmField>& fields = {}, bool compressed = false,
+                     const std::vector<RmDictField>& dict_fields = {},
+                     const std::vector<RmZoneField>& zone_fields = {}) {
+        int page_size = disk_manager_->get_page_size();
         RmFileHdr file_hdr{};
         file_hdr.record_size = record_size;
         file_hdr.num_pages = 1;
         file_hdr.first_free_page_no = RM_NO_PAGE;
-        // We have: sizeof(hdr) + (n + 7) / 8 + n * record_size <= PAGE_SIZE
-        file_hdr.num_records_per_page =
-            (BITMAP_WIDTH * (PAGE_SIZE - 1 - (int)sizeof(RmFileHdr)) + 1) / (1 + record_size * BITMAP_WIDTH);
-        file_hdr.bitmap_size = (file_hdr.num_records_per_page + BITMAP_WIDTH - 1) / BITMAP_WIDTH;
+        file_hdr.format = format;
+        if (static_cast<int>(fields.size()) > RM_MAX_FIELDS) {
+            throw InvalidRecordSizeError(record_size);
+        }
+        file_hdr.num_fields = static_cast<int>(fields.size());
+        std::copy(fields.begin(), fields.end(), file_hdr.fields);
+        if (static_cast<int>(dict_fields.size()) > RM_MAX_FIELDS ||
+            (!dict_fields.empty() && format != RM_FORMAT_SLOTTED)) {
+            throw InvalidRecordSizeError(record_size);
+        }
+        for (const RmDictField& field : dict_fields) {
+            if (field.width != 1 && field.width != 2 && field.width != 4) {
+                throw InvalidRecordSizeError(record_size);
+            }
+        }
+        file_hdr.num_dict_fields = static_cast<int>(dict_fields.size());
+        std::copy(dict_fields.begin(), dict_fields.end(), file_hdr.dict_fields);
+        if (static_cast<int>(zone_fields.size()) > RM_MAX_ZONE_FIELDS) {
+            throw InvalidRecordSizeError(record_size);
+        }
+        for (const RmZoneField& field : zone_fields) {
+            if ((field.type != TYPE_INT && field.type != TYPE_FLOAT) || field.offset < 0 ||
+                field.offset + 4 > record_size) {
+                throw InvalidRecordSizeError(record_size);
+            }
+        }
+        file_hdr.num_zone_fields = static_cast<int>(zone_fields.size());
+        std::copy(zone_fields.begin(), zone_fields.end(), file_hdr.zone_fields);
+        if (format == RM_FORMAT_SLOTTED) {
+            // slotted格式的记录长度只受页面大小限制，编码后最长的记录必须能放进一个空页面
+            if (record_size < 1 ||
+                rm_max_encoded_size(file_hdr) + (int)sizeof(RmSlot) > RmSlottedPage::capacity(page_size)) {
+                throw InvalidRecordSizeError(record_size);
+            }
+        } else {
+            if (record_size < 1 || record_size > RM_MAX_RECORD_SIZE) {
+                throw InvalidRecordSizeError(record_size);
+            }
+            // PAX格式只存放字段中的字节，字段必须依次覆盖整条记录
+            int covered = 0;
+            for (const RmField& field : fields) {
+                if (format != RM_FORMAT_PAX || field.offset != covered || field.len < 1) {
+                    throw InvalidRecordSizeError(record_size);
+                }
+                covered += field.len;
+            }
+            if (format == RM_FORMAT_PAX && covered != record_size) {
+                throw InvalidRecordSizeError(record_size);
+            }
+            // PAX格式的每个页面与bitmap格式存放同样多的记录，只是按字段分组排列
+            // We have: sizeof(hdr) + (n + 7) / 8 + n * record_size <= page_size，page_size为当前数据库的页面大小
+            file_hdr.num_records_per_page =
+                (BITMAP_WIDTH * (page_size - 1 - (int)sizeof(RmPageHdr) - (int)Page::OFFSET_PAGE_HDR) + 1) /
+                (1 + record_size * BITMAP_WIDTH);
+            file_hdr.bitmap_size = (file_hdr.num_records_per_page + BITMAP_WIDTH - 1) / BITMAP_WIDTH;
+        }
+        disk_manager_->create_file(filename, compressed);
+        int fd = disk_manager_->open_file(filename);
 
         // 将file header写入磁盘文件（名为file name，文件描述符为fd）中的第0页
         // head page直接写入磁盘，没有经过缓冲区的NewPage，那么也就不需要FlushPage
@@ -55,10 +115,18 @@ class RmManager {
     }
 
     /**
-     * @description: 删除表的数据文件
+     * @description: 删除表的数据文件及其字典文件、区间映射文件
      * @param {string&} filename 要删除的文件名称
      */    
-    void destroy_file(const std::string& filename) { disk_manager_->destroy_file(filename); }
+    void destroy_file(const std::string& filename) {
+        disk_manager_->destroy_file(filename);
+        for (const char* suffix : {RmDictionary::SUFFIX, RmZoneMap::SUFFIX}) {
+            std::string path = filename + suffix;
+            if (disk_manager_->is_file(path) && unlink(path.c_str()) == -1) {
+                throw UnixError();
+            }
+        }
+    }
 
     // 注意这里打开文件，创建并返回了record file handle的指针
     /**
@@ -77,8 +145,11 @@ class RmManager {
     void close_file(const RmFileHandle* file_handle) {
         disk_manager_->write_page(file_handle->fd_, RM_FILE_HDR_PAGE, (char *)&file_handle->file_hdr_,
                                   sizeof(file_handle->file_hdr_));
-        // 缓冲区的所有页刷到磁盘，注意这句话必须写在close_file前面
-        buffer_pool_manager_->flush_all_pages(file_handle->fd_);
+        // 缓冲区的所有页刷到磁盘并移出缓冲池，注意这句话必须写在close_file前面
+        buffer_pool_manager_->evict_all_pages(file_handle->fd_);
+        buffer_pool_manager_->reset_file_stats(file_handle->fd_);
+        // 页面都已写回，区间映射与磁盘上的记录一致
+        file_handle->zone_map_.save(file_handle->file_hdr_.num_pages);
         disk_manager_->close_file(file_handle->fd_);
     }
 };
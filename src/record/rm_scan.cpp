@@ -11,20 +11,73 @@ See the Mulan PSL v2 for more details. */
 #include "rm_scan.h"
 #include "rm_file_handle.h"
 
+#include "common/query_stats.h"
+
 /**
  * @brief 初始化file_handle和rid
  * @param file_handle
+ * @param batch_mode 是否按页面批量扫描
+ * @param filter PAX格式批量扫描时在拼装记录之前、slotted格式在解码记录之前调用的过滤函数，bitmap格式忽略
+ * @param view 不为空时按快照扫描，只用于批量模式
+ * @param zone_ranges 区间映射字段的取值范围，跳过区间不相交的页面
  */
-RmScan::RmScan(const RmFileHandle *file_handle) : file_handle_(file_handle) {
+RmScan::RmScan(const RmFileHandle *file_handle, bool batch_mode, RmBatchFilter filter, const ReadView *view,
+               std::vector<RmZoneRange> zone_ranges)
+    : file_handle_(file_handle),
+      prefetch_page_no_(RM_FIRST_RECORD_PAGE),
+      batch_mode_(batch_mode),
+      filter_(std::move(filter)),
+      snapshot_(view != nullptr),
+      view_(view != nullptr ? *view : ReadView{}),
+      zone_ranges_(std::move(zone_ranges)) {
     // Todo:
     // 初始化file_handle和rid（指向第一个存放了记录的位置）
+    if (!zone_ranges_.empty()) {
+        file_handle_->load_zone_map();
+    }
     
+    // 扫描的页面数超过缓冲池的1/SCAN_RING_THRESHOLD时，只在环形缓冲区中替换页面，避免把热点页面挤出缓冲池
+    BufferPoolManager *bpm = file_handle_->buffer_pool_manager_;
+    if (static_cast<size_t>(file_handle_->file_hdr_.num_pages) > bpm->get_pool_size() / SCAN_RING_THRESHOLD) {
+        ring_ = bpm->create_scan_ring();
+    }
+
     // 从第一个记录页开始
     rid_.page_no = RM_FIRST_RECORD_PAGE;
     rid_.slot_no = -1;
     
     // 找到第一个存放了记录的位置
-    next();
+    if (batch_mode_) {
+        rid_.page_no = RM_FIRST_RECORD_PAGE - 1;
+        next_batch();
+    } else {
+        next();
+    }
+}
+
+/**
+ * @brief 只扫描[first_page_no, end_page_no)中页面的批量扫描器，并行扫描把表按页面范围分给多个线程，每个线程使用一个
+ * @param ring 大表扫描共用的环形缓冲区，可以为空
+ * @param view 不为空时按快照扫描
+ * @param zone_ranges 区间映射字段的取值范围，跳过区间不相交的页面
+ */
+RmScan::RmScan(const RmFileHandle *file_handle, int first_page_no, int end_page_no, RmBatchFilter filter,
+               std::shared_ptr<ScanRing> ring, const ReadView *view, std::vector<RmZoneRange> zone_ranges)
+    : file_handle_(file_handle),
+      prefetch_page_no_(first_page_no),
+      end_page_no_(end_page_no),
+      ring_(std::move(ring)),
+      batch_mode_(true),
+      filter_(std::move(filter)),
+      snapshot_(view != nullptr),
+      view_(view != nullptr ? *view : ReadView{}),
+      zone_ranges_(std::move(zone_ranges)) {
+    if (!zone_ranges_.empty()) {
+        file_handle_->load_zone_map();
+    }
+    rid_.page_no = first_page_no - 1;
+    rid_.slot_no = -1;
+    next_batch();
 }
 
 /**
@@ -34,23 +87,50 @@ void RmScan::next() {
     // Todo:
     // 找到文件中下一个存放了记录的非空闲位置，用rid_来指向这个位置
     
+    // 批量模式下先在当前批次内移动，批次用完后才访问下一个页面
+    if (batch_mode_) {
+        if (++batch_pos_ < batch_.size()) {
+            rid_ = batch_[batch_pos_].rid;
+        } else {
+            next_batch();
+        }
+        return;
+    }
+
     // 获取文件头信息
     const RmFileHdr& file_hdr = file_handle_->file_hdr_;
     
     // 从当前位置的下一个slot开始查找
     while (rid_.page_no < file_hdr.num_pages) {
-        // 获取当前页面的page handle
-        RmPageHandle page_handle = file_handle_->fetch_page_handle(rid_.page_no);
-        
-        // 在当前页面中找下一个有记录的slot
-        rid_.slot_no = Bitmap::next_bit(true, page_handle.bitmap, 
-                                        file_hdr.num_records_per_page, rid_.slot_no);
-        
-        // 释放page handle
-        file_handle_->buffer_pool_manager_->unpin_page(page_handle.page->get_page_id(), false);
+        if (rid_.slot_no == -1 && skip_page(rid_.page_no)) {
+            rid_.page_no++;
+            continue;
+        }
+        prefetch(rid_.page_no);
+
+        // 获取当前页面的page handle，查找完毕后立即释放
+        int num_slots = file_hdr.num_records_per_page;
+        {
+            ReadPageGuard guard = file_handle_->fetch_page_read(rid_.page_no, ring_.get());
+            if (file_hdr.format == RM_FORMAT_SLOTTED) {
+                // slotted格式跳过从其它页面移动过来的记录，它们通过原位置返回
+                RmSlottedPage page(guard.get_page(), file_handle_->disk_manager_->get_page_size());
+                num_slots = page.num_slots();
+                do {
+                    rid_.slot_no++;
+                } while (rid_.slot_no < num_slots && !page.is_record(rid_.slot_no));
+            } else {
+                RmPageHandle page_handle(&file_hdr, guard.get_page());
+
+                // 在当前页面中找下一个有记录的slot
+                rid_.slot_no = Bitmap::next_bit(true, page_handle.bitmap,
+                                                file_hdr.num_records_per_page, rid_.slot_no);
+            }
+        }
         
         // 如果在当前页面找到了有记录的slot，返回
-        if (rid_.slot_no < file_hdr.num_records_per_page) {
+        if (rid_.slot_no < num_slots) {
+            QueryStats::add(QueryStats::ROWS_SCANNED);
             return;
         }
         
@@ -64,6 +144,283 @@ void RmScan::next() {
     rid_.slot_no = -1;
 }
 
+/**
+ * @brief 批量模式下一次跳过当前批次中的n条记录，调用者已经直接读取了batch()中的这些记录
+ */
+void RmScan::advance(size_t n) {
+    batch_pos_ += n;
+    if (batch_pos_ < batch_.size()) {
+        rid_ = batch_[batch_pos_].rid;
+    } else {
+        next_batch();
+    }
+}
+
+/**
+ * @brief 批量模式下释放当前页面，固定下一个存有记录的页面，并把该页面上所有记录作为新的批次
+ * @return 是否找到了新的批次，返回false表示扫描结束
+ */
+bool RmScan::next_batch() {
+    const RmFileHdr& file_hdr = file_handle_->file_hdr_;
+
+    batch_guard_.release();
+    batch_.clear();
+    batch_pos_ = 0;
+    for (int page_no = rid_.page_no + 1; page_no < end_page(); page_no++) {
+        if (skip_page(page_no)) {
+            continue;
+        }
+        prefetch(page_no);
+
+        snapshot_records_.clear();
+        if (file_hdr.format == RM_FORMAT_SLOTTED) {
+            fill_slotted_batch(page_no);
+            if (snapshot_) {
+                file_handle_->versions_.collect_page(page_no, view_, &snapshot_records_);
+                merge_snapshot();
+            }
+            if (!batch_.empty()) {
+                QueryStats::add(QueryStats::ROWS_SCANNED, batch_.size());
+                rid_ = batch_.front().rid;
+                return true;
+            }
+            continue;
+        }
+
+        ReadPageGuard guard = file_handle_->fetch_page_read(page_no, ring_.get());
+        RmPageHandle page_handle(&file_hdr, guard.get_page());
+        for (int slot_no = Bitmap::first_bit(true, page_handle.bitmap, file_hdr.num_records_per_page);
+             slot_no < file_hdr.num_records_per_page;
+             slot_no = Bitmap::next_bit(true, page_handle.bitmap, file_hdr.num_records_per_page, slot_no)) {
+            batch_.push_back({Rid{page_no, slot_no}, page_handle.get_slot(slot_no)});
+        }
+        // 持有页面latch时查找版本链，修改者在页面写latch内压入版本，两者看到的是同一时刻的页面
+        if (snapshot_) {
+            file_handle_->versions_.collect_page(page_no, view_, &snapshot_records_);
+        }
+        if (!batch_.empty() || !snapshot_records_.empty()) {
+            batch_guard_ = std::move(guard);
+            if (file_hdr.format == RM_FORMAT_PAX) {
+                assemble_pax_batch();
+            }
+            merge_snapshot();
+            if (batch_.empty()) {
+                batch_guard_.release();
+                continue;
+            }
+            QueryStats::add(QueryStats::ROWS_SCANNED, batch_.size());
+            rid_ = batch_.front().rid;
+            return true;
+        }
+    }
+
+    // 到达文件末尾
+    rid_.page_no = RM_NO_PAGE;
+    rid_.slot_no = -1;
+    return false;
+}
+
+/**
+ * @brief 批量模式下把当前批次中从batch_pos()开始的记录复制到batch_buf_中，然后释放当前页面。
+ * 调用者在取下一个批次之前可以修改该页面，例如UPDATE/DELETE边扫描边修改已经取走的记录；
+ * slotted和PAX格式的记录已经在batch_buf_中，不需要复制
+ */
+void RmScan::release_page() {
+    if (!batch_guard_) {
+        return;
+    }
+    size_t record_size = file_handle_->file_hdr_.record_size;
+    batch_buf_.resize(batch_.size() * record_size);
+    for (size_t i = batch_pos_; i < batch_.size(); i++) {
+        char *dst = batch_buf_.data() + i * record_size;
+        memcpy(dst, batch_[i].data, record_size);
+        batch_[i].data = dst;
+    }
+    batch_guard_.release();
+}
+
+/**
+ * @brief 返回当前批次所在页面中第field_no个字段的列存储区，仅在PAX格式的过滤函数中有效
+ * @param field_no 字段在文件头fields中的下标
+ */
+const char *RmScan::column_data(int field_no) const {
+    return RmPageHandle(&file_handle_->file_hdr_, batch_guard_.get_page()).get_column(field_no);
+}
+
+/**
+ * @brief 返回当前批次中第i条记录的第dict_no个字典编码字段的编码，仅在slotted格式的过滤函数中有效。
+ * 已移动到其它页面的记录在过滤时还没有读出，返回转义编码，过滤函数总是保留它
+ * @param i 记录在batch()中的下标
+ * @param dict_no 字段在文件头dict_fields中的下标
+ */
+uint32_t RmScan::dict_code(size_t i, int dict_no) const {
+    const RmFileHdr &file_hdr = file_handle_->file_hdr_;
+    if (batch_[i].data == nullptr) {
+        return RmDictionary::escape_code(file_hdr.dict_fields[dict_no].width);
+    }
+    return rm_dict_code(file_hdr, batch_[i].data, dict_no);
+}
+
+/**
+ * @brief 在PAX格式的页面上先调用过滤函数，再按列把保留下来的记录拼装到batch_buf_中，之后释放页面
+ */
+void RmScan::assemble_pax_batch() {
+    const RmFileHdr& file_hdr = file_handle_->file_hdr_;
+    // 过滤函数按页面上的列判断，页面上有记录要换成快照中的版本时不能使用
+    if (filter_ && snapshot_records_.empty()) {
+        std::vector<uint8_t> keep(batch_.size(), 1);
+        filter_(*this, keep);
+        size_t count = 0;
+        for (size_t i = 0; i < batch_.size(); i++) {
+            if (keep[i]) {
+                batch_[count++] = batch_[i];
+            }
+        }
+        batch_.resize(count);
+    }
+
+    // 逐个字段拼装，每次顺序读取一个字段的列存储区
+    batch_buf_.resize(batch_.size() * file_hdr.record_size);
+    for (int i = 0; i < file_hdr.num_fields; i++) {
+        const RmField& field = file_hdr.fields[i];
+        const char *column = column_data(i);
+        char *out = batch_buf_.data() + field.offset;
+        for (size_t j = 0; j < batch_.size(); j++) {
+            memcpy(out + j * file_hdr.record_size, column + batch_[j].rid.slot_no * field.len, field.len);
+        }
+    }
+    for (size_t j = 0; j < batch_.size(); j++) {
+        batch_[j].data = batch_buf_.data() + j * file_hdr.record_size;
+    }
+    batch_guard_.release();
+}
+
+/**
+ * @brief 按快照扫描时把当前批次中的记录换成snapshot_records_中快照的版本：快照中不存在的记录从批次中去掉，
+ * 页面上已被删除、快照中仍然存在的记录按slot的顺序加入批次
+ */
+void RmScan::merge_snapshot() {
+    if (snapshot_records_.empty()) {
+        return;
+    }
+    std::vector<RmScanSlot> merged;
+    merged.reserve(batch_.size() + snapshot_records_.size());
+    size_t i = 0;
+    for (auto &record : snapshot_records_) {
+        for (; i < batch_.size() && batch_[i].rid < record.rid_; i++) {
+            merged.push_back(batch_[i]);
+        }
+        if (i < batch_.size() && batch_[i].rid == record.rid_) {
+            i++;
+        }
+        if (record.exists_) {
+            merged.push_back({record.rid_, record.data_.data()});
+        }
+    }
+    merged.insert(merged.end(), batch_.begin() + i, batch_.end());
+    batch_ = std::move(merged);
+}
+
+/**
+ * @brief 把slotted格式页面上的所有记录解码到batch_buf_中作为新的批次，已移动的记录在释放页面后从新位置读取。
+ * 有过滤函数时先在页面中的记录数据上调用它，只解码保留下来的记录。按快照扫描时之后再换成快照中的版本，
+ * 被排除的记录在快照中有其它版本时仍会加入批次，所以过滤函数不必区分快照
+ * @param page_no 页面号
+ */
+void RmScan::fill_slotted_batch(int page_no) {
+    const RmFileHdr& file_hdr = file_handle_->file_hdr_;
+    std::vector<size_t> forwarded;
+    {
+        ReadPageGuard guard = file_handle_->fetch_page_read(page_no, ring_.get());
+        RmSlottedPage page(guard.get_page(), file_handle_->disk_manager_->get_page_size());
+        for (int slot_no = 0; slot_no < page.num_slots(); slot_no++) {
+            if (page.is_record(slot_no)) {
+                batch_.push_back({Rid{page_no, slot_no}, page.is_forward(slot_no) ? nullptr : page.get_data(slot_no)});
+            }
+        }
+        if (filter_ && !batch_.empty()) {
+            std::vector<uint8_t> keep(batch_.size(), 1);
+            filter_(*this, keep);
+            size_t count = 0;
+            for (size_t i = 0; i < batch_.size(); i++) {
+                if (keep[i]) {
+                    batch_[count++] = batch_[i];
+                }
+            }
+            batch_.resize(count);
+        }
+        batch_buf_.resize(batch_.size() * file_hdr.record_size);
+        for (size_t i = 0; i < batch_.size(); i++) {
+            if (batch_[i].data == nullptr) {
+                forwarded.push_back(i);
+            } else {
+                rm_decode_record(file_hdr, &file_handle_->dict_, batch_[i].data,
+                                 batch_buf_.data() + i * file_hdr.record_size);
+            }
+        }
+    }
+
+    // 每次只持有一个页面latch；读取新位置时记录已被删除的，从批次中去掉
+    std::vector<bool> removed(batch_.size(), false);
+    for (size_t i : forwarded) {
+        removed[i] = !file_handle_->read_slotted_record(batch_[i].rid, batch_buf_.data() + i * file_hdr.record_size);
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < batch_.size(); i++) {
+        if (removed[i]) {
+            continue;
+        }
+        if (count != i) {
+            memmove(batch_buf_.data() + count * file_hdr.record_size, batch_buf_.data() + i * file_hdr.record_size,
+                    file_hdr.record_size);
+        }
+        batch_[count++].rid = batch_[i].rid;
+    }
+    batch_.resize(count);
+    for (size_t i = 0; i < batch_.size(); i++) {
+        batch_[i].data = batch_buf_.data() + i * file_hdr.record_size;
+    }
+}
+
+/**
+ * @brief 扫描进入上一个预读窗口的后半段时请求预读下一个窗口，使磁盘读取与扫描重叠。
+ * 有取值范围时窗口中被跳过的页面不预读，只预读其余页面组成的各个连续段
+ * @param page_no 当前扫描到的页面
+ */
+void RmScan::prefetch(int page_no) {
+    int end = end_page();
+    if (page_no + READ_AHEAD_PAGES / 2 >= prefetch_page_no_ && prefetch_page_no_ < end) {
+        int window_end = std::min(prefetch_page_no_ + READ_AHEAD_PAGES, end);
+        if (zone_ranges_.empty()) {
+            file_handle_->prefetch_pages(prefetch_page_no_, window_end - prefetch_page_no_, ring_);
+        } else {
+            int first = prefetch_page_no_;
+            for (int p = prefetch_page_no_; p <= window_end; p++) {
+                if (p < window_end && file_handle_->zone_map_.may_match(p, zone_ranges_)) {
+                    continue;
+                }
+                if (p > first) {
+                    file_handle_->prefetch_pages(first, p - first, ring_);
+                }
+                first = p + 1;
+            }
+        }
+        prefetch_page_no_ += READ_AHEAD_PAGES;
+    }
+}
+
+/* 页面的区间与扫描的取值范围不相交，页面上的记录和它们的旧版本都不满足扫描条件 */
+bool RmScan::skip_page(int page_no) const {
+    if (zone_ranges_.empty() || file_handle_->zone_map_.may_match(page_no, zone_ranges_)) {
+        return false;
+    }
+    QueryStats::add(QueryStats::PAGES_SKIPPED);
+    return true;
+}
+
+/* 扫描范围的结束页面，不超过文件当前的页面数 */
+int RmScan::end_page() const { return std::min(end_page_no_, file_handle_->file_hdr_.num_pages); }
+
 /**
  * @brief ​ 判断是否到达文件末尾
  */
@@ -10,19 +10,96 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <cstdint>
+#include <functional>
+#include <vector>
+
 #include "rm_defs.h"
+#include "rm_version_store.h"
+#include "rm_zone_map.h"
 
 class RmFileHandle;
+class RmScan;
+
+/* 批量扫描的过滤函数，把不需要返回的记录在keep中置0，keep与batch()一一对应：PAX格式在拼装记录之前按列检查当前批次，
+   slotted格式在解码记录之前检查页面中记录数据里的字典编码。只用于提前排除记录，调用者仍需在返回的记录上检查完整的条件 */
+using RmBatchFilter = std::function<void(const RmScan &scan, std::vector<uint8_t> &keep)>;
 
+/* 批量扫描返回的一条记录：记录号以及指向页面中对应slot的指针，slotted格式的文件指向扫描器中解码后的记录 */
+struct RmScanSlot {
+    Rid rid;
+    const char *data;
+};
+
+/* 表数据文件的顺序扫描器。
+   批量模式下扫描器一次固定一个页面，把页面上所有存有记录的slot作为一批返回，整批处理完之后才移动到下一个页面，
+   批内的next()不再访问缓冲池；当前批次的页面在移动到下一批或扫描结束之前一直保持固定并持有共享latch。
+   slotted格式的文件在取批次时先调用过滤函数，再把保留下来的记录解码到batch_buf_中，不再保持页面固定；
+   PAX格式的文件先在页面的列存储区上调用过滤函数，再只把保留下来的记录拼装到batch_buf_中。
+   批量模式下可以按快照扫描：每个页面上的记录读出之后查找版本链，换成快照中的版本，快照中存在但已被删除的记录也一并返回。
+   给出区间映射字段的取值范围时，跳过区间与取值范围不相交的页面，既不读取也不预读；与过滤函数一样只用于提前排除记录 */
 class RmScan : public RecScan {
     const RmFileHandle *file_handle_;
     Rid rid_;
+    int prefetch_page_no_;  // 下一个尚未请求预读的页面
+    int end_page_no_ = INT32_MAX;     // 批量模式下只扫描这个页面之前的页面
+    std::shared_ptr<ScanRing> ring_;  // 大表扫描使用的环形缓冲区，小表扫描为空
+
+    bool batch_mode_;                  // 是否按页面批量扫描
+    ReadPageGuard batch_guard_;        // 当前批次所在的页面
+    std::vector<RmScanSlot> batch_;    // 当前页面上存有记录的slot
+    size_t batch_pos_ = 0;             // rid_在batch_中的位置
+    std::vector<char> batch_buf_;      // slotted和PAX格式下当前批次解码后的记录，release_page()后存放复制出的记录
+    RmBatchFilter filter_;             // PAX和slotted格式批量扫描的过滤函数，可以为空
+    bool snapshot_ = false;            // 是否按快照扫描
+    ReadView view_{};                  // 扫描的快照
+    std::vector<RmSnapshotRecord> snapshot_records_;  // 当前页面上快照中的记录不是页面上的记录的记录号及其快照中的内容
+    std::vector<RmZoneRange> zone_ranges_;            // 扫描条件给出的区间映射字段的取值范围，为空时扫描全部页面
 public:
-    RmScan(const RmFileHandle *file_handle);
+    RmScan(const RmFileHandle *file_handle, bool batch_mode = false, RmBatchFilter filter = nullptr,
+           const ReadView *view = nullptr, std::vector<RmZoneRange> zone_ranges = {});
+
+    RmScan(const RmFileHandle *file_handle, int first_page_no, int end_page_no, RmBatchFilter filter,
+           std::shared_ptr<ScanRing> ring, const ReadView *view = nullptr,
+           std::vector<RmZoneRange> zone_ranges = {});
 
     void next() override;
 
     bool is_end() const override;
 
     Rid rid() const override;
+
+    bool next_batch();
+
+    /* 当前批次的全部记录，仅在批量模式下有效 */
+    const std::vector<RmScanSlot> &batch() const { return batch_; }
+
+    /* 把当前批次中尚未取走的记录复制出来并释放页面，之后直到取下一个批次都不持有页面latch */
+    void release_page();
+
+    /* 当前记录在batch()中的位置，仅在批量模式下有效 */
+    size_t batch_pos() const { return batch_pos_; }
+
+    /* 在当前批次内向后移动n条记录，移出当前批次时取下一批，仅在批量模式下有效 */
+    void advance(size_t n);
+
+    /* 当前记录在页面中的数据，仅在批量模式下有效 */
+    const char *record_data() const { return batch_[batch_pos_].data; }
+
+    const char *column_data(int field_no) const;
+
+    uint32_t dict_code(size_t i, int dict_no) const;
+
+private:
+    int end_page() const;
+
+    void prefetch(int page_no);
+
+    bool skip_page(int page_no) const;
+
+    void fill_slotted_batch(int page_no);
+
+    void assemble_pax_batch();
+
+    void merge_snapshot();
 };
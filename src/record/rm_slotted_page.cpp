@@ -0,0 +1,284 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "rm_slotted_page.h"
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+/**
+ * @description: 初始化新分配的页面
+ */
+void RmSlottedPage::init() {
+    page_hdr_->next_free_page_no = RM_NO_PAGE;
+    page_hdr_->num_records = 0;
+    hdr_->num_slots = 0;
+    hdr_->free_offset = end_;
+    hdr_->garbage = 0;
+}
+
+/**
+ * @description: 获取已移动记录的新位置
+ * @param {int} slot_no 带有RM_SLOT_FORWARD标记的slot
+ */
+Rid RmSlottedPage::get_forward(int slot_no) const {
+    Rid rid;
+    memcpy(&rid, get_data(slot_no), sizeof(Rid));
+    return rid;
+}
+
+/**
+ * @description: 插入一条记录，优先复用空的slot
+ * @param {char*} data 记录数据
+ * @param {int} len 记录数据的长度
+ * @param {int} flags slot的标记
+ * @return {int} 记录的slot号，页面空间不足时返回-1
+ */
+int RmSlottedPage::insert(const char *data, int len, int flags) {
+    int slot_no = 0;
+    while (slot_no < hdr_->num_slots && slots_[slot_no].offset != 0) {
+        slot_no++;
+    }
+    if (!insert_at(slot_no, data, len, flags)) {
+        return -1;
+    }
+    return slot_no;
+}
+
+/**
+ * @description: 在指定的空slot上插入一条记录，slot号超出目录时扩展目录
+ * @return {bool} 页面空间不足时返回false
+ */
+bool RmSlottedPage::insert_at(int slot_no, const char *data, int len, int flags) {
+    assert(!is_used(slot_no));
+    int num_new_slots = std::max(0, slot_no + 1 - hdr_->num_slots);
+    int needed = len + num_new_slots * static_cast<int>(sizeof(RmSlot));
+    if (free_space() < needed) {
+        return false;
+    }
+    if (hdr_->free_offset - header_end() < needed) {
+        compact();
+    }
+    for (int i = hdr_->num_slots; i <= slot_no; i++) {
+        slots_[i] = RmSlot{0, 0};
+    }
+    hdr_->num_slots += num_new_slots;
+    allocate(slot_no, data, len, flags);
+    page_hdr_->num_records++;
+    return true;
+}
+
+/**
+ * @description: 替换slot上的记录数据，新数据不长于旧数据时原地覆盖，否则在页面内重新分配
+ * @return {bool} 页面空间不足时返回false，slot保持不变
+ */
+bool RmSlottedPage::update(int slot_no, const char *data, int len, int flags) {
+    int old_len = get_length(slot_no);
+    if (len <= old_len) {
+        memcpy(base_ + slots_[slot_no].offset, data, len);
+        hdr_->garbage += old_len - len;
+        slots_[slot_no].length = len | flags;
+        return true;
+    }
+    if (free_space() + old_len < len) {
+        return false;
+    }
+    // 旧数据成为空洞，整理页面时不再保留
+    hdr_->garbage += old_len;
+    slots_[slot_no].offset = 0;
+    if (hdr_->free_offset - header_end() < len) {
+        compact();
+    }
+    allocate(slot_no, data, len, flags);
+    return true;
+}
+
+/**
+ * @description: 删除slot上的记录，并去掉目录末尾空的slot
+ */
+void RmSlottedPage::erase(int slot_no) {
+    hdr_->garbage += get_length(slot_no);
+    slots_[slot_no] = RmSlot{0, 0};
+    page_hdr_->num_records--;
+    while (hdr_->num_slots > 0 && slots_[hdr_->num_slots - 1].offset == 0) {
+        hdr_->num_slots--;
+    }
+}
+
+/**
+ * @description: 从数据区的起始位置分配空间并写入记录，调用者需保证连续的空闲空间足够
+ */
+void RmSlottedPage::allocate(int slot_no, const char *data, int len, int flags) {
+    hdr_->free_offset -= len;
+    memcpy(base_ + hdr_->free_offset, data, len);
+    slots_[slot_no] = RmSlot{hdr_->free_offset, len | flags};
+}
+
+/**
+ * @description: 把所有记录紧密排列到页尾，回收数据区中的空洞
+ */
+void RmSlottedPage::compact() {
+    std::vector<char> buf(end_);
+    int pos = end_;
+    for (int i = 0; i < hdr_->num_slots; i++) {
+        if (slots_[i].offset != 0) {
+            int len = get_length(i);
+            pos -= len;
+            memcpy(buf.data() + pos, base_ + slots_[i].offset, len);
+            slots_[i].offset = pos;
+        }
+    }
+    memcpy(base_ + pos, buf.data() + pos, end_ - pos);
+    hdr_->free_offset = pos;
+    hdr_->garbage = 0;
+}
+
+/**
+ * @description: 一条记录编码后的最大长度：字典编码的字段最长时是转义编码加上字段的原值
+ */
+int rm_max_encoded_size(const RmFileHdr &file_hdr) {
+    int size = file_hdr.record_size + file_hdr.num_fields * static_cast<int>(sizeof(uint16_t));
+    for (int i = 0; i < file_hdr.num_dict_fields; i++) {
+        size += file_hdr.dict_fields[i].width + static_cast<int>(sizeof(uint16_t));
+    }
+    return std::max(size, RM_SLOT_MIN_SIZE);
+}
+
+/**
+ * @description: 页面中的记录数据里第dict_no个字典编码字段的编码
+ * @param {RmFileHdr&} file_hdr 文件头，提供字典编码的字段
+ * @param {char*} data 页面中的记录数据
+ * @param {int} dict_no 字段在dict_fields中的下标
+ */
+uint32_t rm_dict_code(const RmFileHdr &file_hdr, const char *data, int dict_no) {
+    int pos = 0;
+    for (int i = 0; i < dict_no; i++) {
+        pos += file_hdr.dict_fields[i].width;
+    }
+    uint32_t code = 0;
+    memcpy(&code, data + pos, file_hdr.dict_fields[dict_no].width);
+    return code;
+}
+
+/* 按偏移依次访问变长字段和字典编码字段，两者都按偏移排序且互不重叠 */
+struct RmFieldCursor {
+    const RmFileHdr &file_hdr;
+    int var_no = 0;
+    int dict_no = 0;
+
+    bool done() const { return var_no == file_hdr.num_fields && dict_no == file_hdr.num_dict_fields; }
+
+    bool is_dict() const {
+        if (var_no == file_hdr.num_fields) {
+            return true;
+        }
+        return dict_no < file_hdr.num_dict_fields &&
+               file_hdr.dict_fields[dict_no].offset < file_hdr.fields[var_no].offset;
+    }
+
+    int offset() const { return is_dict() ? file_hdr.dict_fields[dict_no].offset : file_hdr.fields[var_no].offset; }
+
+    int len() const { return is_dict() ? file_hdr.dict_fields[dict_no].len : file_hdr.fields[var_no].len; }
+};
+
+/**
+ * @description: 把定长的记录编码为写入页面的格式：开头依次是字典编码字段的编码，之后定长字段原样复制，
+ *              变长字段去掉末尾的0字节，并在前面加上2字节的实际长度；字典编码的字段不再出现，编码为转义编码时按变长字段存放
+ * @param {RmFileHdr&} file_hdr 文件头，提供记录长度、变长字段和字典编码的字段
+ * @param {RmDictionary*} dict 表的字典，没有字典编码的字段时可以为空
+ * @param {char*} record 定长的记录
+ * @param {char*} out 编码结果，长度至少为rm_max_encoded_size(file_hdr)
+ * @return {int} 编码结果的长度
+ */
+int rm_encode_record(const RmFileHdr &file_hdr, RmDictionary *dict, const char *record, char *out) {
+    int pos = 0;
+    uint32_t codes[RM_MAX_FIELDS];
+    for (int i = 0; i < file_hdr.num_dict_fields; i++) {
+        const RmDictField &field = file_hdr.dict_fields[i];
+        codes[i] = dict->encode(i, record + field.offset, field.len);
+        memcpy(out + pos, &codes[i], field.width);
+        pos += field.width;
+    }
+    int cur = 0;
+    for (RmFieldCursor it{file_hdr}; !it.done();) {
+        int offset = it.offset();
+        int field_len = it.len();
+        memcpy(out + pos, record + cur, offset - cur);
+        pos += offset - cur;
+        cur = offset + field_len;
+        if (it.is_dict()) {
+            bool coded = codes[it.dict_no] != RmDictionary::escape_code(file_hdr.dict_fields[it.dict_no].width);
+            it.dict_no++;
+            if (coded) {
+                continue;
+            }
+        } else {
+            it.var_no++;
+        }
+        int len = field_len;
+        while (len > 0 && record[offset + len - 1] == 0) {
+            len--;
+        }
+        uint16_t stored = static_cast<uint16_t>(len);
+        memcpy(out + pos, &stored, sizeof(stored));
+        pos += sizeof(stored);
+        memcpy(out + pos, record + offset, len);
+        pos += len;
+    }
+    memcpy(out + pos, record + cur, file_hdr.record_size - cur);
+    pos += file_hdr.record_size - cur;
+    if (pos < RM_SLOT_MIN_SIZE) {
+        memset(out + pos, 0, RM_SLOT_MIN_SIZE - pos);
+        pos = RM_SLOT_MIN_SIZE;
+    }
+    return pos;
+}
+
+/**
+ * @description: 把页面中的记录数据解码为定长的记录，变长字段末尾补0，字典编码的字段从字典中还原
+ * @param {RmFileHdr&} file_hdr 文件头，提供记录长度、变长字段和字典编码的字段
+ * @param {RmDictionary*} dict 表的字典，没有字典编码的字段时可以为空
+ * @param {char*} data 页面中的记录数据
+ * @param {char*} record 解码结果，长度为file_hdr.record_size
+ */
+void rm_decode_record(const RmFileHdr &file_hdr, const RmDictionary *dict, const char *data, char *record) {
+    int pos = 0;
+    uint32_t codes[RM_MAX_FIELDS];
+    for (int i = 0; i < file_hdr.num_dict_fields; i++) {
+        codes[i] = 0;
+        memcpy(&codes[i], data + pos, file_hdr.dict_fields[i].width);
+        pos += file_hdr.dict_fields[i].width;
+    }
+    int cur = 0;
+    for (RmFieldCursor it{file_hdr}; !it.done();) {
+        int offset = it.offset();
+        int field_len = it.len();
+        memcpy(record + cur, data + pos, offset - cur);
+        pos += offset - cur;
+        cur = offset + field_len;
+        if (it.is_dict()) {
+            int dict_no = it.dict_no++;
+            if (codes[dict_no] != RmDictionary::escape_code(file_hdr.dict_fields[dict_no].width)) {
+                dict->decode(dict_no, codes[dict_no], record + offset, field_len);
+                continue;
+            }
+        } else {
+            it.var_no++;
+        }
+        uint16_t stored;
+        memcpy(&stored, data + pos, sizeof(stored));
+        pos += sizeof(stored);
+        memcpy(record + offset, data + pos, stored);
+        memset(record + offset + stored, 0, field_len - stored);
+        pos += stored;
+    }
+    memcpy(record + cur, data + pos, file_hdr.record_size - cur);
+}
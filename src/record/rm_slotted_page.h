@@ -0,0 +1,113 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <cstdint>
+
+#include "rm_defs.h"
+#include "rm_dictionary.h"
+
+/* slotted格式页面中紧跟在RmPageHdr之后的页头 */
+struct RmSlottedPageHdr {
+    int num_slots;      // slot目录的项数，目录末尾不保留空的slot
+    int free_offset;    // 记录数据区的起始位置，记录数据从页尾向前分配
+    int garbage;        // 删除或缩短记录后留在数据区中的空洞字节数，整理页面后回收
+};
+
+/* slot目录中的一项，offset为0表示空的slot */
+struct RmSlot {
+    int offset;         // 记录数据相对页头的偏移
+    int length;         // 低位为记录数据的长度，高位为RM_SLOT_FORWARD等标记
+};
+
+constexpr int RM_SLOT_FORWARD = 0x40000000;     // 记录已移动到其它页面，数据为移动后的Rid
+constexpr int RM_SLOT_MOVED = 0x20000000;       // 从其它页面移动过来的记录，扫描时跳过，通过原位置访问
+constexpr int RM_SLOT_LENGTH_MASK = 0x00ffffff;
+constexpr int RM_SLOT_MIN_SIZE = sizeof(Rid);   // 每条记录至少占用的字节数，保证记录移动后原位置能够存放Rid
+
+/**
+ * @description: 对slotted格式页面的封装。记录的slot号在记录的生命周期内保持不变，整理页面只移动数据区中的记录。
+ *              调用者需持有页面的latch，修改页面时需持有排他latch
+ */
+class RmSlottedPage {
+   public:
+    RmSlottedPage(Page *page, int page_size)
+        : base_(page->get_data() + Page::OFFSET_PAGE_HDR),
+          page_hdr_(reinterpret_cast<RmPageHdr *>(base_)),
+          hdr_(reinterpret_cast<RmSlottedPageHdr *>(base_ + sizeof(RmPageHdr))),
+          slots_(reinterpret_cast<RmSlot *>(base_ + sizeof(RmPageHdr) + sizeof(RmSlottedPageHdr))),
+          end_(page_size - static_cast<int>(Page::OFFSET_PAGE_HDR)) {}
+
+    /* 页面中可用于slot目录和记录数据的字节数 */
+    static int capacity(int page_size) {
+        return page_size - static_cast<int>(Page::OFFSET_PAGE_HDR + sizeof(RmPageHdr) + sizeof(RmSlottedPageHdr));
+    }
+
+    void init();
+
+    /* 页面已经初始化过：文件扩展出来、还没有写入的页面全为0 */
+    bool is_initialized() const { return hdr_->free_offset != 0; }
+
+    int num_slots() const { return hdr_->num_slots; }
+
+    int num_records() const { return page_hdr_->num_records; }
+
+    bool is_used(int slot_no) const { return slot_no >= 0 && slot_no < hdr_->num_slots && slots_[slot_no].offset != 0; }
+
+    /* slot上存有一条可以通过该slot号访问的记录（包括已移动到其它页面的记录） */
+    bool is_record(int slot_no) const { return is_used(slot_no) && !(slots_[slot_no].length & RM_SLOT_MOVED); }
+
+    bool is_forward(int slot_no) const { return (slots_[slot_no].length & RM_SLOT_FORWARD) != 0; }
+
+    Rid get_forward(int slot_no) const;
+
+    const char *get_data(int slot_no) const { return base_ + slots_[slot_no].offset; }
+
+    int get_length(int slot_no) const { return slots_[slot_no].length & RM_SLOT_LENGTH_MASK; }
+
+    /* 整理页面后可用的空闲字节数 */
+    int free_space() const { return hdr_->free_offset - header_end() + hdr_->garbage; }
+
+    int used_space() const {
+        return end_ - static_cast<int>(sizeof(RmPageHdr) + sizeof(RmSlottedPageHdr)) - free_space();
+    }
+
+    int insert(const char *data, int len, int flags);
+
+    bool insert_at(int slot_no, const char *data, int len, int flags);
+
+    bool update(int slot_no, const char *data, int len, int flags);
+
+    void erase(int slot_no);
+
+   private:
+    int header_end() const {
+        return static_cast<int>(sizeof(RmPageHdr) + sizeof(RmSlottedPageHdr) + hdr_->num_slots * sizeof(RmSlot));
+    }
+
+    void allocate(int slot_no, const char *data, int len, int flags);
+
+    void compact();
+
+    char *base_;
+    RmPageHdr *page_hdr_;
+    RmSlottedPageHdr *hdr_;
+    RmSlot *slots_;
+    int end_;           // 数据区的结束位置，即页面末尾相对页头的偏移
+};
+
+int rm_max_encoded_size(const RmFileHdr &file_hdr);
+
+uint32_t rm_dict_code(const RmFileHdr &file_hdr, const char *data, int dict_no);
+
+int rm_encode_record(const RmFileHdr &file_hdr, RmDictionary *dict, const char *record, char *out);
+
+void rm_decode_record(const RmFileHdr &file_hdr, const RmDictionary *dict, const char *data, char *record);
@@ -0,0 +1,192 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "rm_version_store.h"
+
+#include <algorithm>
+#include <climits>
+#include <mutex>
+
+/**
+ * @description: 修改记录之前压入记录原来的内容
+ * @param {Rid&} rid 被修改的记录
+ * @param {shared_ptr<TxnStamp>&} stamp 修改者的提交时间戳
+ * @param {char*} before 记录原来的内容，插入时为nullptr
+ * @param {int} len 记录的长度
+ */
+void RmVersionStore::push(const Rid &rid, const std::shared_ptr<TxnStamp> &stamp, const char *before, int len) {
+    std::unique_lock lock{latch_};
+    auto &chain = chains_[rid];
+    if (chain.empty()) {
+        num_chains_.fetch_add(1, std::memory_order_release);
+    } else if (chain.back().stamp_ == stamp) {
+        // 同一个事务再次修改：其他事务只会看到它第一次修改之前的内容，已经在链上
+        return;
+    }
+    chain.push_back({stamp, before != nullptr, before != nullptr ? std::string(before, len) : std::string()});
+    pushes_.fetch_add(1, std::memory_order_release);
+}
+
+/**
+ * @description: 删除、更新记录之前取得记录的写权并压入记录原来的内容（先修改者胜出）：
+ *              记录的版本属于尚未结束的其他事务，或者快照view之后有其他事务修改并提交过这条记录时冲突，不压入版本
+ * @return {bool} 没有冲突时返回true，事务已经取得写权时直接返回true
+ * @param {ReadView*} view 修改者读取的快照，不按快照读取时为nullptr
+ */
+bool RmVersionStore::claim(const Rid &rid, const std::shared_ptr<TxnStamp> &stamp, const char *before, int len,
+                           const ReadView *view) {
+    std::unique_lock lock{latch_};
+    auto it = chains_.find(rid);
+    if (it != chains_.end()) {
+        auto &chain = it->second;
+        if (!chain.empty() && chain.back().stamp_ == stamp) {
+            return true;
+        }
+        for (auto &version : chain) {
+            timestamp_t ts = version.stamp_->finish_ts();
+            if (ts == TxnStamp::ACTIVE) {
+                return false;
+            }
+            if (view != nullptr && !view->sees(*version.stamp_) && !version.stamp_->is_aborted()) {
+                return false;
+            }
+        }
+    }
+    auto &chain = chains_[rid];
+    if (chain.empty()) {
+        num_chains_.fetch_add(1, std::memory_order_release);
+    }
+    chain.push_back({stamp, true, std::string(before, len)});
+    pushes_.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+/**
+ * @description: 从最新的版本往前找到快照中的记录
+ * @param {const string**} out 快照中的记录为旧版本时指向该版本的内容
+ */
+RmVersionStore::Visibility RmVersionStore::resolve_chain(const Chain &chain, const ReadView &view,
+                                                         const std::string **out) {
+    Visibility result = Visibility::CURRENT;
+    for (auto it = chain.rbegin(); it != chain.rend() && !view.sees(*it->stamp_); ++it) {
+        result = it->exists_ ? Visibility::OLD : Visibility::ABSENT;
+        *out = &it->before_;
+    }
+    return result;
+}
+
+/**
+ * @description: 调用者已经读出记录在页面上的内容，判断快照中的记录是否就是它
+ * @return {Visibility} 为OLD时快照中的记录写入out
+ */
+RmVersionStore::Visibility RmVersionStore::resolve(const Rid &rid, const ReadView &view, std::string *out) const {
+    if (empty()) {
+        return Visibility::CURRENT;
+    }
+    std::shared_lock lock{latch_};
+    auto it = chains_.find(rid);
+    if (it == chains_.end()) {
+        return Visibility::CURRENT;
+    }
+    const std::string *old = nullptr;
+    Visibility result = resolve_chain(it->second, view, &old);
+    if (result == Visibility::OLD) {
+        *out = *old;
+    }
+    return result;
+}
+
+void RmVersionStore::collect_range(std::map<Rid, Chain>::const_iterator begin,
+                                   std::map<Rid, Chain>::const_iterator end, const ReadView &view,
+                                   std::vector<RmSnapshotRecord> *out) const {
+    for (auto it = begin; it != end; ++it) {
+        const std::string *old = nullptr;
+        Visibility result = resolve_chain(it->second, view, &old);
+        if (result != Visibility::CURRENT) {
+            out->push_back({it->first, result == Visibility::OLD, result == Visibility::OLD ? *old : std::string()});
+        }
+    }
+}
+
+/**
+ * @description: 找出快照中的记录不是页面上的记录的全部记录号，以及它们在快照中的内容，按记录号排序
+ */
+void RmVersionStore::collect(const ReadView &view, std::vector<RmSnapshotRecord> *out) const {
+    if (empty()) {
+        return;
+    }
+    std::shared_lock lock{latch_};
+    collect_range(chains_.begin(), chains_.end(), view, out);
+}
+
+/**
+ * @description: 同collect，只找出页面page_no上的记录
+ */
+void RmVersionStore::collect_page(int page_no, const ReadView &view, std::vector<RmSnapshotRecord> *out) const {
+    if (empty()) {
+        return;
+    }
+    std::shared_lock lock{latch_};
+    collect_range(chains_.lower_bound(Rid{page_no, INT_MIN}), chains_.lower_bound(Rid{page_no + 1, INT_MIN}), view,
+                  out);
+}
+
+/**
+ * @description: 找出快照view之后有其他事务提交过修改的全部记录，以及快照之后这些记录先后存在过的内容（不含页面上的最新内容），
+ *              用于乐观并发控制的提交验证
+ */
+void RmVersionStore::collect_changed(const ReadView &view, std::vector<RmChangedRecord> *out) const {
+    if (empty()) {
+        return;
+    }
+    std::shared_lock lock{latch_};
+    for (auto &[rid, chain] : chains_) {
+        bool committed = std::any_of(chain.begin(), chain.end(), [&](const RmVersion &version) {
+            return !view.sees(*version.stamp_) && !version.stamp_->is_aborted() &&
+                   version.stamp_->finish_ts() != TxnStamp::ACTIVE;
+        });
+        if (!committed) {
+            continue;
+        }
+        RmChangedRecord changed{rid, {}};
+        for (auto &version : chain) {
+            if (version.exists_ && !view.sees(*version.stamp_)) {
+                changed.images_.push_back(version.before_);
+            }
+        }
+        out->push_back(std::move(changed));
+    }
+}
+
+/**
+ * @description: 所有活跃的快照都能看到事务stamp的修改之后回收版本：
+ *              回滚的事务只删除它自己的版本，提交的事务删除它的版本以及更早的版本，快照读不会再找到比可见版本更早的版本
+ * @param {Rid&} rid 事务修改过的记录
+ * @param {TxnStamp*} stamp 已经结束的事务
+ */
+void RmVersionStore::prune(const Rid &rid, const TxnStamp *stamp) {
+    std::unique_lock lock{latch_};
+    auto it = chains_.find(rid);
+    if (it == chains_.end()) {
+        return;
+    }
+    auto &chain = it->second;
+    auto mine = [&](const RmVersion &version) { return version.stamp_.get() == stamp; };
+    if (stamp->is_aborted()) {
+        chain.erase(std::remove_if(chain.begin(), chain.end(), mine), chain.end());
+    } else {
+        auto last = std::find_if(chain.rbegin(), chain.rend(), mine);
+        chain.erase(chain.begin(), last.base());
+    }
+    if (chain.empty()) {
+        chains_.erase(it);
+        num_chains_.fetch_sub(1, std::memory_order_release);
+    }
+}
@@ -0,0 +1,88 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include "defs.h"
+#include "transaction/txn_defs.h"
+
+/* 记录的一个旧版本：事务stamp_修改记录之前的内容，exists_为false表示修改之前记录不存在（插入产生的版本） */
+struct RmVersion {
+    std::shared_ptr<TxnStamp> stamp_;
+    bool exists_;
+    std::string before_;
+};
+
+/* 快照之后其他事务提交过修改的一条记录，images_为这些修改之前记录存在时的各个内容 */
+struct RmChangedRecord {
+    Rid rid_;
+    std::vector<std::string> images_;
+};
+
+/* 快照中的一条记录，exists_为false表示记录在快照中不存在 */
+struct RmSnapshotRecord {
+    Rid rid_;
+    bool exists_;
+    std::string data_;
+};
+
+/**
+ * @description: 表数据文件的undo存储。记录被修改之前，修改者把记录原来的内容连同自己的TxnStamp压入该记录的版本链，
+ *              页面上始终是最新的内容。快照读先读页面上的记录，再从最新的版本往前找：
+ *              第一个对快照可见的修改之后的状态就是快照中的记录，没有不可见的版本时页面上的记录就是快照中的记录。
+ *              版本在修改页面之前压入（bitmap和PAX格式在页面写latch内），所以先读页面、后查版本链的读者总能还原快照；
+ *              所有活跃快照都能看到的版本由TransactionManager在事务结束后回收。只在内存中维护
+ */
+class RmVersionStore {
+   public:
+    enum class Visibility { CURRENT, OLD, ABSENT };   // 快照中的记录：页面上的记录、旧版本、不存在
+
+    /* 没有任何版本，快照读可以直接使用页面上的记录 */
+    bool empty() const { return num_chains_.load(std::memory_order_acquire) == 0; }
+
+    /* 压入过的版本数，两次读到的值相同说明其间没有新的修改 */
+    uint64_t pushes() const { return pushes_.load(std::memory_order_acquire); }
+
+    void push(const Rid &rid, const std::shared_ptr<TxnStamp> &stamp, const char *before, int len);
+
+    bool claim(const Rid &rid, const std::shared_ptr<TxnStamp> &stamp, const char *before, int len,
+               const ReadView *view);
+
+    Visibility resolve(const Rid &rid, const ReadView &view, std::string *out) const;
+
+    void collect(const ReadView &view, std::vector<RmSnapshotRecord> *out) const;
+
+    void collect_page(int page_no, const ReadView &view, std::vector<RmSnapshotRecord> *out) const;
+
+    void collect_changed(const ReadView &view, std::vector<RmChangedRecord> *out) const;
+
+    void prune(const Rid &rid, const TxnStamp *stamp);
+
+   private:
+    using Chain = std::vector<RmVersion>;   // 按修改的先后顺序排列，最新的版本在末尾
+
+    static Visibility resolve_chain(const Chain &chain, const ReadView &view, const std::string **out);
+
+    void collect_range(std::map<Rid, Chain>::const_iterator begin, std::map<Rid, Chain>::const_iterator end,
+                       const ReadView &view, std::vector<RmSnapshotRecord> *out) const;
+
+    mutable std::shared_mutex latch_;
+    std::map<Rid, Chain> chains_;           // 按记录号排序，顺序扫描按页面取出一段
+    std::atomic<size_t> num_chains_{0};
+    std::atomic<uint64_t> pushes_{0};
+};
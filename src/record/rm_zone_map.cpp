@@ -0,0 +1,202 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "rm_zone_map.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "errors.h"
+
+static constexpr uint32_t RM_ZONE_MAGIC = 0x454e4f5a;  // "ZONE"
+static constexpr double RM_ZONE_INF = std::numeric_limits<double>::infinity();
+
+/* 区间映射文件的文件头，之后依次是各页面各字段的最小值和最大值 */
+struct RmZoneFileHdr {
+    uint32_t magic;
+    uint32_t clean;     // 关闭数据文件时写完区间之后置1，打开之后置0
+    int32_t num_fields;
+    int32_t num_pages;  // 写回时数据文件的页面个数
+};
+
+RmZoneMap::~RmZoneMap() {
+    if (fd_ != -1) {
+        close(fd_);
+    }
+}
+
+/**
+ * @description: 打开数据文件的区间映射文件，文件完整且与数据文件一致时读入各页面的区间，否则映射保持未载入状态。
+ *              之后把文件标记为不完整并落盘，关闭数据文件之前发生故障时下次打开会重建区间映射
+ * @param {string&} path 区间映射文件的路径
+ * @param {RmFileHdr&} file_hdr 数据文件的文件头，提供区间映射字段和页面个数
+ */
+void RmZoneMap::open(const std::string &path, const RmFileHdr &file_hdr) {
+    fields_.assign(file_hdr.zone_fields, file_hdr.zone_fields + file_hdr.num_zone_fields);
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ == -1) {
+        throw UnixError();
+    }
+    struct stat st;
+    if (fstat(fd_, &st) == -1) {
+        throw UnixError();
+    }
+    RmZoneFileHdr hdr{};
+    if (st.st_size >= static_cast<off_t>(sizeof(hdr)) && pread(fd_, &hdr, sizeof(hdr), 0) == sizeof(hdr) &&
+        hdr.magic == RM_ZONE_MAGIC && hdr.clean == 1 && hdr.num_fields == static_cast<int32_t>(fields_.size()) &&
+        hdr.num_pages == file_hdr.num_pages) {
+        size_t bytes = static_cast<size_t>(hdr.num_pages) * fields_.size() * 2 * sizeof(double);
+        if (st.st_size == static_cast<off_t>(sizeof(hdr) + bytes)) {
+            bounds_.resize(bytes / sizeof(double));
+            if (pread(fd_, bounds_.data(), bytes, sizeof(hdr)) != static_cast<ssize_t>(bytes)) {
+                throw UnixError();
+            }
+            set_loaded();
+        }
+    }
+    // 新建的数据文件还没有记录页面，不需要重建
+    if (file_hdr.num_pages <= RM_FIRST_RECORD_PAGE) {
+        set_loaded();
+    }
+    write_hdr(false, file_hdr.num_pages);
+}
+
+/**
+ * @description: 关闭数据文件时写回全部区间，落盘之后再标记为完整。映射没有载入时不写回，文件保持不完整
+ * @param {int} num_pages 数据文件的页面个数
+ */
+void RmZoneMap::save(int num_pages) const {
+    if (fd_ == -1 || !is_loaded()) {
+        return;
+    }
+    RmZoneFileHdr hdr{RM_ZONE_MAGIC, 0, static_cast<int32_t>(fields_.size()), num_pages};
+    std::vector<char> buf(sizeof(hdr) + static_cast<size_t>(num_pages) * fields_.size() * 2 * sizeof(double));
+    memcpy(buf.data(), &hdr, sizeof(hdr));
+    {
+        std::shared_lock lock{latch_};
+        double *out = reinterpret_cast<double *>(buf.data() + sizeof(hdr));
+        size_t count = (buf.size() - sizeof(hdr)) / sizeof(double);
+        for (size_t i = 0; i < count; i++) {
+            out[i] = i < bounds_.size() ? bounds_[i] : (i % 2 == 0 ? RM_ZONE_INF : -RM_ZONE_INF);
+        }
+    }
+    if (pwrite(fd_, buf.data(), buf.size(), 0) != static_cast<ssize_t>(buf.size()) ||
+        ftruncate(fd_, static_cast<off_t>(buf.size())) == -1 || fdatasync(fd_) == -1) {
+        throw UnixError();
+    }
+    write_hdr(true, num_pages);
+}
+
+/* 写入文件头并落盘 */
+void RmZoneMap::write_hdr(bool clean, int num_pages) const {
+    RmZoneFileHdr hdr{RM_ZONE_MAGIC, clean ? 1u : 0u, static_cast<int32_t>(fields_.size()), num_pages};
+    if (pwrite(fd_, &hdr, sizeof(hdr), 0) != sizeof(hdr) || fdatasync(fd_) == -1) {
+        throw UnixError();
+    }
+}
+
+/* 记录中第zone_no个区间映射字段的值 */
+double RmZoneMap::value(int zone_no, const char *record) const {
+    const RmZoneField &field = fields_[zone_no];
+    if (field.type == TYPE_FLOAT) {
+        float v;
+        memcpy(&v, record + field.offset, sizeof(v));
+        return v;
+    }
+    int v;
+    memcpy(&v, record + field.offset, sizeof(v));
+    return v;
+}
+
+/* 页面的区间，页面还没有区间时先补上空区间，调用时持有latch_的排他锁 */
+double *RmZoneMap::page_bounds(int page_no) {
+    size_t n = fields_.size();
+    size_t need = (static_cast<size_t>(page_no) + 1) * n * 2;
+    while (bounds_.size() < need) {
+        bounds_.push_back(RM_ZONE_INF);
+        bounds_.push_back(-RM_ZONE_INF);
+    }
+    return bounds_.data() + static_cast<size_t>(page_no) * n * 2;
+}
+
+/**
+ * @description: 扩大页面的区间使其包含记录中各区间映射字段的值，在记录对其它线程可见之前调用
+ * @param {int} page_no 记录号所在的页面，slotted格式中已移动到其它页面的记录仍按原位置计算
+ * @param {char*} record 解码后的记录
+ */
+void RmZoneMap::widen(int page_no, const char *record) {
+    if (fields_.empty()) {
+        return;
+    }
+    size_t n = fields_.size();
+    std::unique_lock lock{latch_};
+    double *bounds = page_bounds(page_no);
+    for (size_t i = 0; i < n; i++) {
+        double v = value(static_cast<int>(i), record);
+        if (std::isnan(v)) {
+            // NaN与任何值比较都不分大小，等值条件总是满足，区间扩大为全部取值
+            bounds[2 * i] = -RM_ZONE_INF;
+            bounds[2 * i + 1] = RM_ZONE_INF;
+            continue;
+        }
+        bounds[2 * i] = std::min(bounds[2 * i], v);
+        bounds[2 * i + 1] = std::max(bounds[2 * i + 1], v);
+    }
+}
+
+/**
+ * @description: 把页面的区间扩大为全部取值，页面上的记录没有经过widen写入时使用，例如故障恢复时扩展文件遇到的已有页面
+ */
+void RmZoneMap::widen_all(int page_no) {
+    if (fields_.empty()) {
+        return;
+    }
+    size_t n = fields_.size();
+    std::unique_lock lock{latch_};
+    double *bounds = page_bounds(page_no);
+    for (size_t i = 0; i < n; i++) {
+        bounds[2 * i] = -RM_ZONE_INF;
+        bounds[2 * i + 1] = RM_ZONE_INF;
+    }
+}
+
+/**
+ * @description: 判断页面上是否可能有记录满足全部取值范围
+ * @return {bool} 返回false时页面上的记录和它们的旧版本一定不满足
+ */
+bool RmZoneMap::may_match(int page_no, const std::vector<RmZoneRange> &ranges) const {
+    size_t n = fields_.size();
+    std::shared_lock lock{latch_};
+    size_t base = static_cast<size_t>(page_no) * n * 2;
+    if (base >= bounds_.size()) {
+        return false;
+    }
+    for (auto &range : ranges) {
+        const double *bounds = bounds_.data() + base + 2 * range.zone_no;
+        if (bounds[1] < range.lo || bounds[0] > range.hi) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @description: 数据文件截断为num_pages个页面之后去掉被截断页面的区间，这些页面号重新分配时从空区间开始
+ */
+void RmZoneMap::truncate(int num_pages) {
+    std::unique_lock lock{latch_};
+    bounds_.resize(std::min(bounds_.size(), static_cast<size_t>(num_pages) * fields_.size() * 2));
+}
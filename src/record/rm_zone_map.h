@@ -0,0 +1,76 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <atomic>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include "rm_defs.h"
+
+/* 扫描条件给出的一个区间映射字段的取值范围[lo, hi]，开区间的端点换成相邻的浮点数 */
+struct RmZoneRange {
+    int zone_no;    // 字段在zone_fields中的下标
+    double lo;
+    double hi;
+};
+
+/* 表的区间映射（zone map）：每个页面上各区间映射字段的最小值和最大值，扫描时跳过取值范围与扫描条件不相交的页面。
+   区间按记录号所在的页面维护，只扩大不缩小：插入和更新在记录对其它线程可见之前扩大区间，删除不修改区间，
+   因此页面上的记录（以及版本链中的旧版本）总在页面的区间之内；没有写入过记录的页面区间为空，扫描总是跳过。
+   区间映射保存在数据文件旁的区间映射文件（文件名+SUFFIX）中，只在关闭数据文件时写回并标记为完整，打开之后立即标记为不完整。
+   打开时文件不完整（上次没有正常关闭）或者不存在，映射处于未载入状态，由RmFileHandle在第一次使用之前扫描全部页面重建 */
+class RmZoneMap {
+   public:
+    static constexpr const char *SUFFIX = ".zone";
+
+    RmZoneMap() = default;
+
+    RmZoneMap(const RmZoneMap &) = delete;
+
+    RmZoneMap &operator=(const RmZoneMap &) = delete;
+
+    ~RmZoneMap();
+
+    void open(const std::string &path, const RmFileHdr &file_hdr);
+
+    void save(int num_pages) const;
+
+    /* 文件头中有区间映射字段 */
+    bool enabled() const { return !fields_.empty(); }
+
+    /* 区间是否已经从文件中读入或者重建完成 */
+    bool is_loaded() const { return loaded_.load(std::memory_order_acquire); }
+
+    void set_loaded() { loaded_.store(true, std::memory_order_release); }
+
+    void widen(int page_no, const char *record);
+
+    void widen_all(int page_no);
+
+    bool may_match(int page_no, const std::vector<RmZoneRange> &ranges) const;
+
+    void truncate(int num_pages);
+
+   private:
+    double value(int zone_no, const char *record) const;
+
+    double *page_bounds(int page_no);
+
+    void write_hdr(bool clean, int num_pages) const;
+
+    int fd_ = -1;                       // 区间映射文件
+    std::vector<RmZoneField> fields_;   // 区间映射字段
+    std::vector<double> bounds_;        // 第page_no个页面第i个字段的最小值和最大值位于2 * (page_no * 字段个数 + i)和其后一个位置
+    mutable std::shared_mutex latch_;   // 保护bounds_
+    std::atomic<bool> loaded_{false};
+};
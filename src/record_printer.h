@@ -15,8 +15,11 @@ See the Mulan PSL v2 for more details. */
 #include <iomanip>
 #include <string>
 #include <sstream>
+#include <vector>
 #include "common/context.h"
 #include "common/config.h"
+#include "common/result_format.h"
+#include "system/sm_meta.h"
 
 #define RECORD_COUNT_LENGTH 40
 
@@ -31,23 +34,9 @@ public:
     void print_separator(Context *context) const {
         for (size_t i = 0; i < num_cols; i++) {
             // std::cout << '+' << std::string(COL_WIDTH + 2, '-');
-            std::string str = "+" + std::string(COL_WIDTH + 2, '-');
-            if(context->ellipsis_ == false && *context->offset_ + RECORD_COUNT_LENGTH + str.length() < BUFFER_LENGTH) {
-                memcpy(context->data_send_ + *(context->offset_), str.c_str(), str.length());
-                *(context->offset_) = *(context->offset_) + str.length();
-            }
-            else {
-                context->ellipsis_ = true;
-            }
-        }
-        std::string str = "+\n";
-        if(context->ellipsis_ == false && *context->offset_ + RECORD_COUNT_LENGTH + str.length() < BUFFER_LENGTH) {
-            memcpy(context->data_send_ + *(context->offset_), str.c_str(), str.length());
-            *(context->offset_) = *(context->offset_) + str.length();
-        }
-        else {
-            context->ellipsis_ = true;
+            append("+" + std::string(COL_WIDTH + 2, '-'), context);
         }
+        append("+\n", context);
     }
 
     void print_record(const std::vector<std::string> &rec_str, Context *context) const {
@@ -59,22 +48,15 @@ public:
             // std::cout << "| " << std::setw(COL_WIDTH) << col << ' ';
             std::stringstream ss;
             ss << "| " << std::setw(COL_WIDTH) << col << " ";
-            if(context->ellipsis_ == false && *context->offset_ + RECORD_COUNT_LENGTH + ss.str().length() < BUFFER_LENGTH) {
-                memcpy(context->data_send_ + *(context->offset_), ss.str().c_str(), ss.str().length());
-                *(context->offset_) = *(context->offset_) + ss.str().length();
-            }
-            else {
-                context->ellipsis_ = true;
-            }
+            append(ss.str(), context);
         }
         // std::cout << "|\n";
-        std::string str = "|\n";
-        if(context->ellipsis_ == false && *context->offset_ + RECORD_COUNT_LENGTH + str.length() < BUFFER_LENGTH) {
-            memcpy(context->data_send_ + *(context->offset_), str.c_str(), str.length());
-            *(context->offset_) = *(context->offset_) + str.length();
-        }
+        append("|\n", context);
     }
 
+    /* 输出一行不按表格排列的文本，如EXPLAIN的计划 */
+    static void print_line(const std::string &line, Context *context) { append(line + '\n', context); }
+
     static void print_record_count(size_t num_rec, Context *context) {
         // std::cout << "Total record(s): " << num_rec << '\n';
         std::string str = "";
@@ -85,4 +67,103 @@ public:
         memcpy(context->data_send_ + *(context->offset_), str.c_str(), str.length());
         *(context->offset_) = *(context->offset_) + str.length();
     }
+
+private:
+    /**
+     * @brief 把str追加到返回给客户端的结果中，缓冲区放不下时流式模式下先把已有的结果发送出去，
+     * 否则截断之后的所有结果，最后由print_record_count输出省略号；缓冲区始终为记录数留出RECORD_COUNT_LENGTH字节
+     */
+    static void append(const std::string &str, Context *context) {
+        if (context->ellipsis_) return;
+        if (*context->offset_ + RECORD_COUNT_LENGTH + str.length() >= BUFFER_LENGTH &&
+            !(RESULT_STREAMING && context->flush_send())) {
+            context->ellipsis_ = true;
+            return;
+        }
+        memcpy(context->data_send_ + *(context->offset_), str.c_str(), str.length());
+        *(context->offset_) = *(context->offset_) + str.length();
+    }
+};
+
+/**
+ * @brief 按common/result_format.h中的二进制格式把查询结果写入返回给客户端的缓冲区，
+ * 字段值按原始字节写出，不在服务端格式化为字符串，表格形式的输出由客户端生成
+ */
+class RecordEncoder {
+    std::vector<char> msg_;         // 正在编码的一条消息，整条写入缓冲区，不会跨帧
+public:
+    /**
+     * @brief 写出列名和字段类型；缓冲区中已有的文本结果先作为文本帧发送出去
+     */
+    void encode_header(const std::vector<std::string> &captions, const std::vector<ColMeta> &cols,
+                       Context *context) {
+        if (context->send_kind_ != RESULT_FRAME_BINARY) {
+            if (*context->offset_ > 0) context->flush_send();
+            context->send_kind_ = RESULT_FRAME_BINARY;
+        }
+        msg_.clear();
+        msg_.push_back(static_cast<char>(RESULT_MSG_HEADER));
+        put<uint16_t>(cols.size());
+        for (size_t i = 0; i < cols.size(); i++) {
+            ResultColType type = cols[i].type == TYPE_INT     ? RESULT_COL_INT
+                                 : cols[i].type == TYPE_FLOAT ? RESULT_COL_FLOAT
+                                                              : RESULT_COL_STRING;
+            msg_.push_back(static_cast<char>(type));
+            put<uint16_t>(cols[i].len);
+            size_t name_len = std::min<size_t>(captions[i].size(), UINT8_MAX);
+            msg_.push_back(static_cast<char>(name_len));
+            msg_.insert(msg_.end(), captions[i].begin(), captions[i].begin() + name_len);
+        }
+        append(context);
+    }
+
+    void encode_record(const char *tuple, const std::vector<ColMeta> &cols, Context *context) {
+        msg_.clear();
+        msg_.push_back(static_cast<char>(RESULT_MSG_ROW));
+        for (auto &col : cols) {
+            const char *field = tuple + col.offset;
+            if (is_string_type(col.type)) {
+                // 定长字符串以'\0'补齐，只发送有效部分
+                uint16_t len = strnlen(field, col.len);
+                put<uint16_t>(len);
+                msg_.insert(msg_.end(), field, field + len);
+            } else {
+                msg_.insert(msg_.end(), field, field + col.len);
+            }
+        }
+        append(context);
+    }
+
+    void encode_record_count(size_t num_rec, Context *context) {
+        msg_.clear();
+        msg_.push_back(static_cast<char>(RESULT_MSG_COUNT));
+        put<uint64_t>(num_rec);
+        append(context);
+    }
+
+private:
+    template <typename T>
+    void put(T value) {
+        const char *bytes = reinterpret_cast<const char *>(&value);
+        msg_.insert(msg_.end(), bytes, bytes + sizeof(T));
+    }
+
+    // 缓冲区放不下整条消息时先把已有的消息作为一帧发送出去，比缓冲区还长的消息单独作为一帧发送；
+    // 客户端断开后丢弃之后的结果
+    void append(Context *context) {
+        if (context->ellipsis_) return;
+        if (*context->offset_ + msg_.size() >= BUFFER_LENGTH) {
+            bool sent = context->flush_send();
+            if (sent && msg_.size() >= BUFFER_LENGTH) {
+                if (!context->send_frame(msg_.data(), msg_.size())) context->ellipsis_ = true;
+                return;
+            }
+            if (!sent) {
+                context->ellipsis_ = true;
+                return;
+            }
+        }
+        memcpy(context->data_send_ + *(context->offset_), msg_.data(), msg_.size());
+        *(context->offset_) = *(context->offset_) + msg_.size();
+    }
 };
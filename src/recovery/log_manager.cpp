@@ -10,19 +10,280 @@ See the Mulan PSL v2 for more details. */
 
 #include <cstring>
 #include "log_manager.h"
+#include "common/metrics.h"
+#include "common/query_stats.h"
+#include "common/tracepoint.h"
+#include "transaction/transaction.h"
 
 /**
- * @description: 添加日志记录到日志缓冲区中，并返回日志记录号
+ * @description: 添加日志记录到日志缓冲区中，并返回日志记录号。对状态字做一次CAS同时预留缓冲区空间和日志号，
+ *              缓冲区和日志文件中的日志按日志号排列；预留之后在latch之外序列化日志，不同的追加者并行复制
  * @param {LogRecord*} log_record 要写入缓冲区的日志记录
  * @return {lsn_t} 返回该日志的日志记录号
  */
 lsn_t LogManager::add_log_to_buffer(LogRecord* log_record) {
-  
+    int len = static_cast<int>(log_record->log_tot_len_);
+    QueryStats::add(QueryStats::LOG_BYTES, len);
+    uint64_t state = state_.load(std::memory_order_acquire);
+    while (true) {
+        int buffer = state_buffer(state);
+        int offset = state_offset(state);
+        lsn_t lsn = state_lsn(state);
+        if (offset + len <= LOG_BUFFER_SIZE) {
+            if (!state_.compare_exchange_weak(state, make_state(buffer, offset + len, lsn + 1),
+                                              std::memory_order_acq_rel)) {
+                continue;
+            }
+            log_record->lsn_ = lsn;
+            log_record->serialize(buffers_[buffer].buffer_ + offset);
+            buffers_[buffer].copied_.fetch_add(len, std::memory_order_release);
+            // 缓冲区刚超过一半时唤醒刷日志线程，漏掉的唤醒最迟在FLUSH_TIMEOUT之后补上
+            if (offset < LOG_BUFFER_SIZE / 2 && offset + len >= LOG_BUFFER_SIZE / 2 && flusher_running_) {
+                flush_cv_.notify_one();
+            }
+            return lsn;
+        }
+        // 当前缓冲区放不下：等待另一个缓冲区写完，然后封存当前缓冲区并切换过去
+        {
+            std::unique_lock<std::mutex> lock(latch_);
+            if (sealed_ != -1 && !flusher_running_) {
+                write_sealed(lock);
+            }
+            persist_cv_.wait(lock, [&] { return sealed_ == -1 || state_.load() != state; });
+            if (state_.load() == state) {
+                seal(state);
+            }
+        }
+        state = state_.load(std::memory_order_acquire);
+    }
 }
 
 /**
- * @description: 把日志缓冲区的内容刷到磁盘中，由于目前只设置了一个缓冲区，因此需要阻塞其他日志操作
+ * @description: 追加事务txn的一条日志：事务的第一条日志之前先写begin日志，日志按prev_lsn_串成事务的日志链
+ * @return {lsn_t} 该日志的日志记录号
+ */
+lsn_t LogManager::append_txn_log(Transaction* txn, LogRecord* log_record) {
+    if (txn->get_prev_lsn() == INVALID_LSN && log_record->log_type_ != LogType::begin) {
+        // 分配begin日志的日志号之前记下它的下界，检查点取得活跃事务表时不会漏掉正在写第一条日志的事务
+        txn->set_first_lsn(get_next_lsn());
+        BeginLogRecord begin_log(txn->get_transaction_id());
+        txn->set_prev_lsn(add_log_to_buffer(&begin_log));
+    }
+    log_record->log_tid_ = txn->get_transaction_id();
+    log_record->prev_lsn_ = txn->get_prev_lsn();
+    lsn_t lsn = add_log_to_buffer(log_record);
+    txn->set_prev_lsn(lsn);
+    return lsn;
+}
+
+/**
+ * @description: 故障恢复之后、追加任何日志之前设置下一个日志号，之后的日志号接在恢复时读到的日志之后
+ * @param {lsn_t} lsn 下一条日志的日志号，不小于1
+ * @param {off_t} persist_end 恢复时读到的日志在日志文件中的末尾，之后的日志写在这里
+ */
+void LogManager::set_next_lsn(lsn_t lsn, off_t persist_end) {
+    std::unique_lock<std::mutex> lock(latch_);
+    state_.store(make_state(0, 0, lsn));
+    buffers_[0].first_lsn_ = lsn;
+    persist_lsn_.store(lsn - 1);
+    persist_end_ = persist_end;
+    request_lsn_ = INVALID_LSN;
+    segments_.clear();
+    last_segment_offset_ = -1;
+}
+
+/**
+ * @description: 找到日志号为lsn的日志所在的分段，故障恢复从分段的开头扫描，跳过其中lsn之前的日志
+ * @return {bool} 日志已经写入磁盘并且找到分段时返回true
+ * @param {lsn_t*} segment_lsn 分段中第一条日志的日志号
+ * @param {off_t*} offset 分段在日志文件中的位置
+ */
+bool LogManager::locate(lsn_t lsn, lsn_t *segment_lsn, off_t *offset) {
+    std::unique_lock<std::mutex> lock(latch_);
+    if (lsn > persist_lsn_.load()) {
+        return false;
+    }
+    auto it = segments_.upper_bound(lsn);
+    if (it == segments_.begin()) {
+        return false;
+    }
+    --it;
+    *segment_lsn = it->first;
+    *offset = it->second;
+    return true;
+}
+
+/**
+ * @description: 检查点之后不再需要lsn所在分段之前的分段
+ */
+void LogManager::discard_before(lsn_t lsn) {
+    std::unique_lock<std::mutex> lock(latch_);
+    auto it = segments_.upper_bound(lsn);
+    if (it != segments_.begin()) {
+        segments_.erase(segments_.begin(), std::prev(it));
+    }
+}
+
+/**
+ * @description: 取得已经持久化的日志的末尾，日志发送线程从日志文件中读取并发送这之前的内容
+ * @return {off_t} 已经持久化的日志在日志文件中的末尾
+ * @param {lsn_t*} persist_lsn 末尾之前最后一条日志的日志号
+ */
+off_t LogManager::get_persist_end(lsn_t *persist_lsn) {
+    std::unique_lock<std::mutex> lock(latch_);
+    *persist_lsn = persist_lsn_.load();
+    return persist_end_;
+}
+
+/**
+ * @description: 等待日志号为lsn的日志持久化，不主动刷盘，由提交的事务或刷日志线程的定时刷盘推进
+ * @return {bool} 超时之前日志已经持久化时返回true
+ */
+bool LogManager::wait_persist(lsn_t lsn, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(latch_);
+    return persist_cv_.wait_for(lock, timeout, [&] { return persist_lsn_.load() >= lsn; });
+}
+
+/**
+ * @description: 把日志缓冲区的内容刷到磁盘中，等待已经追加的日志全部持久化
  */
 void LogManager::flush_log_to_disk() {
+    flush_to(state_lsn(state_.load()) - 1);
+}
+
+/**
+ * @description: 等待日志号不超过lsn的日志全部持久化。刷日志线程运行时把请求交给它，与同时等待的其他事务共用一次刷盘
+ * @param {lsn_t} lsn 需要持久化的最后一条日志
+ */
+void LogManager::flush_to(lsn_t lsn) {
+    // 页面上的日志号可能来自之前的运行，不会超过已经分配的日志号
+    lsn = std::min(lsn, state_lsn(state_.load()) - 1);
+    if (lsn <= persist_lsn_.load(std::memory_order_acquire)) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(latch_);
+    if (!flusher_running_) {
+        flush_current(lock, lsn);
+        return;
+    }
+    request_lsn_ = std::max(request_lsn_, lsn);
+    flush_cv_.notify_one();
+    persist_cv_.wait(lock, [&] { return persist_lsn_.load() >= lsn; });
+}
+
+/**
+ * @description: 在latch内封存状态字state对应的当前缓冲区并切换到另一个缓冲区，另一个缓冲区必须已经写完
+ * @return {bool} 封存成功时返回true；当前缓冲区为空，或者状态字已经被其他追加者改变时返回false
+ */
+bool LogManager::seal(uint64_t state) {
+    int buffer = state_buffer(state);
+    if (state_offset(state) == 0 ||
+        !state_.compare_exchange_strong(state, make_state(1 - buffer, 0, state_lsn(state)))) {
+        return false;
+    }
+    buffers_[buffer].offset_ = state_offset(state);
+    buffers_[buffer].last_lsn_ = state_lsn(state) - 1;
+    buffers_[1 - buffer].first_lsn_ = state_lsn(state);
+    sealed_ = buffer;
+    flush_cv_.notify_one();
+    return true;
+}
+
+/**
+ * @description: 在latch内把封存的缓冲区用一次write加一次fdatasync写入磁盘，之后唤醒所有等待者。
+ *              先等待预留了这个缓冲区的追加者复制完成，它们在封存之前已经预留，很快就会完成
+ */
+void LogManager::write_sealed(std::unique_lock<std::mutex> &lock) {
+    (void)lock;
+    LogBuffer &buffer = buffers_[sealed_];
+    while (buffer.copied_.load(std::memory_order_acquire) < buffer.offset_) {
+        std::this_thread::yield();
+    }
+    off_t offset;
+    {
+        LatencyTimer timer(Metrics::instance().histogram(Metrics::LOG_FLUSH_LATENCY));
+        RMDB_TRACE(log_flush_start, buffer.offset_, buffer.last_lsn_);
+        offset = disk_manager_->write_log(buffer.buffer_, buffer.offset_);
+        disk_manager_->sync_log();
+        RMDB_TRACE(log_flush_done, buffer.offset_, buffer.last_lsn_);
+    }
+    Metrics::instance().add(Metrics::LOG_BYTES, buffer.offset_);
+    if (last_segment_offset_ < 0 || offset - last_segment_offset_ >= LOG_BUFFER_SIZE) {
+        segments_.emplace(buffer.first_lsn_, offset);
+        last_segment_offset_ = offset;
+    }
+    persist_end_ = offset + buffer.offset_;
+    buffer.offset_ = 0;
+    buffer.copied_.store(0, std::memory_order_relaxed);
+    persist_lsn_.store(buffer.last_lsn_, std::memory_order_release);
+    sealed_ = -1;
+    persist_cv_.notify_all();
+}
+
+/**
+ * @description: 在latch内持久化日志号不超过lsn的日志：先写完已经封存的缓冲区，仍不够时封存当前缓冲区再写
+ */
+void LogManager::flush_current(std::unique_lock<std::mutex> &lock, lsn_t lsn) {
+    while (persist_lsn_.load() < lsn) {
+        if (sealed_ == -1) {
+            seal(state_.load());
+        }
+        if (sealed_ != -1) {
+            write_sealed(lock);
+        }
+    }
+}
+
+/**
+ * @description: 启动后台刷日志线程，之后提交的事务通过组提交持久化日志
+ * @param {size_t} group_commit_timeout_us 第一个等待者到达之后，再等待多少微秒让更多的提交进入同一次刷盘
+ */
+void LogManager::start_flusher(size_t group_commit_timeout_us) {
+    std::unique_lock<std::mutex> lock(latch_);
+    if (flusher_running_) {
+        return;
+    }
+    group_commit_timeout_ = std::chrono::microseconds(group_commit_timeout_us);
+    stop_flusher_ = false;
+    flusher_running_ = true;
+    flusher_ = std::thread(&LogManager::flusher_loop, this);
+}
+
+/**
+ * @description: 停止后台刷日志线程，线程退出之前把缓冲区中剩余的日志写入磁盘
+ */
+void LogManager::stop_flusher() {
+    {
+        std::unique_lock<std::mutex> lock(latch_);
+        if (!flusher_running_) {
+            return;
+        }
+        stop_flusher_ = true;
+    }
+    flush_cv_.notify_one();
+    flusher_.join();
+}
 
+void LogManager::flusher_loop() {
+    std::unique_lock<std::mutex> lock(latch_);
+    auto half_full = [&] { return state_offset(state_.load()) >= LOG_BUFFER_SIZE / 2; };
+    while (!stop_flusher_) {
+        flush_cv_.wait_for(lock, FLUSH_TIMEOUT, [&] {
+            return stop_flusher_ || sealed_ != -1 || request_lsn_ > persist_lsn_.load() || half_full();
+        });
+        // 先写已经封存的缓冲区，让等待切换缓冲区的追加者尽快继续
+        if (sealed_ != -1) {
+            write_sealed(lock);
+            continue;
+        }
+        // 等待一小段时间，让同时提交的其他事务把commit日志追加进来，缓冲区过半时不再等待
+        if (group_commit_timeout_.count() > 0 && !stop_flusher_ && request_lsn_ > persist_lsn_.load() &&
+            !half_full()) {
+            flush_cv_.wait_for(lock, group_commit_timeout_,
+                               [&] { return stop_flusher_ || sealed_ != -1 || half_full(); });
+        }
+        flush_current(lock, state_lsn(state_.load()) - 1);
+    }
+    flush_current(lock, state_lsn(state_.load()) - 1);
+    flusher_running_ = false;
 }
@@ -10,11 +10,19 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 #include <iostream>
 #include "log_defs.h"
 #include "common/config.h"
+#include "common/memory_tracker.h"
 #include "record/rm_defs.h"
 
 /* 日志记录对应操作的类型 */
@@ -24,7 +32,10 @@ enum LogType: int {
     DELETE,
     begin,
     commit,
-    ABORT
+    ABORT,
+    CLR,
+    BEGIN_CHECKPOINT,
+    END_CHECKPOINT
 };
 static std::string LogTypeStr[] = {
     "UPDATE",
@@ -32,7 +43,10 @@ static std::string LogTypeStr[] = {
     "DELETE",
     "BEGIN",
     "COMMIT",
-    "ABORT"
+    "ABORT",
+    "CLR",
+    "BEGIN_CHECKPOINT",
+    "END_CHECKPOINT"
 };
 
 class LogRecord {
@@ -43,6 +57,8 @@ public:
     txn_id_t log_tid_;         /* 创建当前日志的事务ID */
     lsn_t prev_lsn_;           /* 事务创建的前一条日志记录的lsn，用于undo */
 
+    virtual ~LogRecord() = default;
+
     // 把日志记录序列化到dest中
     virtual void serialize (char* dest) const {
         memcpy(dest + OFFSET_LOG_TYPE, &log_type_, sizeof(LogType));
@@ -97,20 +113,121 @@ public:
     }
 };
 
-/**
- * TODO: commit操作的日志记录
-*/
 class CommitLogRecord: public LogRecord {
-
+public:
+    CommitLogRecord() {
+        log_type_ = LogType::commit;
+        lsn_ = INVALID_LSN;
+        log_tot_len_ = LOG_HEADER_SIZE;
+        log_tid_ = INVALID_TXN_ID;
+        prev_lsn_ = INVALID_LSN;
+    }
+    CommitLogRecord(txn_id_t txn_id) : CommitLogRecord() {
+        log_tid_ = txn_id;
+    }
+    // 序列化Commit日志记录到dest中
+    void serialize(char* dest) const override {
+        LogRecord::serialize(dest);
+    }
+    // 从src中反序列化出一条Commit日志记录
+    void deserialize(const char* src) override {
+        LogRecord::deserialize(src);
+    }
+    virtual void format_print() override {
+        std::cout << "log type in son_function: " << LogTypeStr[log_type_] << "\n";
+        LogRecord::format_print();
+    }
 };
 
-/**
- * TODO: abort操作的日志记录
-*/
 class AbortLogRecord: public LogRecord {
-
+public:
+    AbortLogRecord() {
+        log_type_ = LogType::ABORT;
+        lsn_ = INVALID_LSN;
+        log_tot_len_ = LOG_HEADER_SIZE;
+        log_tid_ = INVALID_TXN_ID;
+        prev_lsn_ = INVALID_LSN;
+    }
+    AbortLogRecord(txn_id_t txn_id) : AbortLogRecord() {
+        log_tid_ = txn_id;
+    }
+    // 序列化Abort日志记录到dest中
+    void serialize(char* dest) const override {
+        LogRecord::serialize(dest);
+    }
+    // 从src中反序列化出一条Abort日志记录
+    void deserialize(const char* src) override {
+        LogRecord::deserialize(src);
+    }
+    virtual void format_print() override {
+        std::cout << "log type in son_function: " << LogTypeStr[log_type_] << "\n";
+        LogRecord::format_print();
+    }
 };
 
+/* 日志中的整数使用变长编码（每字节7位，最高位表示之后还有字节），记录号和长度通常只占一两个字节 */
+static inline int varint_size(uint32_t value) {
+    int size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+static inline char* put_varint(char* dest, uint32_t value) {
+    while (value >= 0x80) {
+        *dest++ = static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    *dest++ = static_cast<char>(value);
+    return dest;
+}
+
+static inline const char* get_varint(const char* src, uint32_t* value) {
+    uint32_t result = 0;
+    int shift = 0;
+    while (static_cast<uint8_t>(*src) & 0x80) {
+        result |= static_cast<uint32_t>(static_cast<uint8_t>(*src++) & 0x7f) << shift;
+        shift += 7;
+    }
+    result |= static_cast<uint32_t>(static_cast<uint8_t>(*src++)) << shift;
+    *value = result;
+    return src;
+}
+
+/* 修改记录的日志共有的部分：表的oid、记录号，以及一条完整的记录 */
+static inline int record_log_size(const Rid& rid, const RmRecord& value) {
+    return sizeof(oid_t) + varint_size(rid.page_no) + varint_size(rid.slot_no) + varint_size(value.size) + value.size;
+}
+
+static inline char* put_record_log(char* dest, oid_t oid, const Rid& rid, const RmRecord& value) {
+    memcpy(dest, &oid, sizeof(oid_t));
+    dest = put_varint(dest + sizeof(oid_t), rid.page_no);
+    dest = put_varint(dest, rid.slot_no);
+    dest = put_varint(dest, value.size);
+    memcpy(dest, value.data, value.size);
+    return dest + value.size;
+}
+
+static inline const char* get_record_log(const char* src, oid_t* oid, Rid* rid, RmRecord* value) {
+    uint32_t page_no, slot_no, size;
+    memcpy(oid, src, sizeof(oid_t));
+    src = get_varint(src + sizeof(oid_t), &page_no);
+    src = get_varint(src, &slot_no);
+    src = get_varint(src, &size);
+    rid->page_no = static_cast<int>(page_no);
+    rid->slot_no = static_cast<int>(slot_no);
+    if (value->allocated_) {
+        delete[] value->data;
+    }
+    value->size = static_cast<int>(size);
+    value->data = new char[size];
+    value->allocated_ = true;
+    memcpy(value->data, src, size);
+    return src + size;
+}
+
 class InsertLogRecord: public LogRecord {
 public:
     InsertLogRecord() {
@@ -119,77 +236,412 @@ public:
         log_tot_len_ = LOG_HEADER_SIZE;
         log_tid_ = INVALID_TXN_ID;
         prev_lsn_ = INVALID_LSN;
-        table_name_ = nullptr;
+        oid_ = 0;
     }
-    InsertLogRecord(txn_id_t txn_id, RmRecord& insert_value, Rid& rid, std::string table_name) 
+    InsertLogRecord(txn_id_t txn_id, const RmRecord& insert_value, const Rid& rid, oid_t oid)
         : InsertLogRecord() {
         log_tid_ = txn_id;
         insert_value_ = insert_value;
         rid_ = rid;
-        log_tot_len_ += sizeof(int);
-        log_tot_len_ += insert_value_.size;
-        log_tot_len_ += sizeof(Rid);
-        table_name_size_ = table_name.length();
-        table_name_ = new char[table_name_size_];
-        memcpy(table_name_, table_name.c_str(), table_name_size_);
-        log_tot_len_ += sizeof(size_t) + table_name_size_;
+        oid_ = oid;
+        log_tot_len_ += record_log_size(rid_, insert_value_);
     }
 
     // 把insert日志记录序列化到dest中
     void serialize(char* dest) const override {
         LogRecord::serialize(dest);
-        int offset = OFFSET_LOG_DATA;
-        memcpy(dest + offset, &insert_value_.size, sizeof(int));
-        offset += sizeof(int);
-        memcpy(dest + offset, insert_value_.data, insert_value_.size);
-        offset += insert_value_.size;
-        memcpy(dest + offset, &rid_, sizeof(Rid));
-        offset += sizeof(Rid);
-        memcpy(dest + offset, &table_name_size_, sizeof(size_t));
-        offset += sizeof(size_t);
-        memcpy(dest + offset, table_name_, table_name_size_);
+        put_record_log(dest + OFFSET_LOG_DATA, oid_, rid_, insert_value_);
     }
     // 从src中反序列化出一条Insert日志记录
     void deserialize(const char* src) override {
-        LogRecord::deserialize(src);  
-        insert_value_.Deserialize(src + OFFSET_LOG_DATA);
-        int offset = OFFSET_LOG_DATA + insert_value_.size + sizeof(int);
-        rid_ = *reinterpret_cast<const Rid*>(src + offset);
-        offset += sizeof(Rid);
-        table_name_size_ = *reinterpret_cast<const size_t*>(src + offset);
-        offset += sizeof(size_t);
-        table_name_ = new char[table_name_size_];
-        memcpy(table_name_, src + offset, table_name_size_);
+        LogRecord::deserialize(src);
+        get_record_log(src + OFFSET_LOG_DATA, &oid_, &rid_, &insert_value_);
     }
     void format_print() override {
         printf("insert record\n");
         LogRecord::format_print();
         printf("insert_value: %s\n", insert_value_.data);
         printf("insert rid: %d, %d\n", rid_.page_no, rid_.slot_no);
-        printf("table name: %s\n", table_name_);
+        printf("table oid: %d\n", oid_);
     }
 
     RmRecord insert_value_;     // 插入的记录
     Rid rid_;                   // 记录插入的位置
-    char* table_name_;          // 插入记录的表名称
-    size_t table_name_size_;    // 表名称的大小
+    oid_t oid_;                 // 插入记录的表
 };
 
-/**
- * TODO: delete操作的日志记录
-*/
 class DeleteLogRecord: public LogRecord {
+public:
+    DeleteLogRecord() {
+        log_type_ = LogType::DELETE;
+        lsn_ = INVALID_LSN;
+        log_tot_len_ = LOG_HEADER_SIZE;
+        log_tid_ = INVALID_TXN_ID;
+        prev_lsn_ = INVALID_LSN;
+        oid_ = 0;
+    }
+    DeleteLogRecord(txn_id_t txn_id, const RmRecord& delete_value, const Rid& rid, oid_t oid)
+        : DeleteLogRecord() {
+        log_tid_ = txn_id;
+        delete_value_ = delete_value;
+        rid_ = rid;
+        oid_ = oid;
+        log_tot_len_ += record_log_size(rid_, delete_value_);
+    }
+
+    // 把delete日志记录序列化到dest中
+    void serialize(char* dest) const override {
+        LogRecord::serialize(dest);
+        put_record_log(dest + OFFSET_LOG_DATA, oid_, rid_, delete_value_);
+    }
+    // 从src中反序列化出一条Delete日志记录
+    void deserialize(const char* src) override {
+        LogRecord::deserialize(src);
+        get_record_log(src + OFFSET_LOG_DATA, &oid_, &rid_, &delete_value_);
+    }
+    void format_print() override {
+        printf("delete record\n");
+        LogRecord::format_print();
+        printf("delete_value: %s\n", delete_value_.data);
+        printf("delete rid: %d, %d\n", rid_.page_no, rid_.slot_no);
+        printf("table oid: %d\n", oid_);
+    }
 
+    RmRecord delete_value_;     // 删除的记录
+    Rid rid_;                   // 被删除记录的位置
+    oid_t oid_;                 // 删除记录的表
 };
 
-/**
- * TODO: update操作的日志记录
-*/
+/* update日志中的一段修改：记录中从offset开始的len个字节 */
+struct UpdateLogRange {
+    int offset;
+    int len;
+};
+
+/* update日志只记录修改过的字节：比较更新前后的记录，间隔很小的两段修改合并为一段，
+   每段依次存放与上一段末尾的距离、长度、更新前和更新后的内容 */
 class UpdateLogRecord: public LogRecord {
+public:
+    static constexpr int MERGE_GAP = 4;     // 相隔不超过这么多字节的两段修改合并，省下一段的编码
+
+    UpdateLogRecord() {
+        log_type_ = LogType::UPDATE;
+        lsn_ = INVALID_LSN;
+        log_tot_len_ = LOG_HEADER_SIZE;
+        log_tid_ = INVALID_TXN_ID;
+        prev_lsn_ = INVALID_LSN;
+        oid_ = 0;
+        record_size_ = 0;
+    }
+    UpdateLogRecord(txn_id_t txn_id, const RmRecord& before_value, const RmRecord& after_value, const Rid& rid,
+                    oid_t oid)
+        : UpdateLogRecord() {
+        log_tid_ = txn_id;
+        rid_ = rid;
+        oid_ = oid;
+        record_size_ = after_value.size;
+        int pos = 0;
+        while (pos < record_size_) {
+            if (before_value.data[pos] == after_value.data[pos]) {
+                pos++;
+                continue;
+            }
+            // 向后找到最后一个不同的字节，直到连续相同的字节超过MERGE_GAP
+            int last = pos;
+            for (int i = pos + 1; i < record_size_ && i - last <= MERGE_GAP; ++i) {
+                if (before_value.data[i] != after_value.data[i]) {
+                    last = i;
+                }
+            }
+            int end = last + 1;
+            ranges_.push_back({pos, end - pos});
+            before_.append(before_value.data + pos, end - pos);
+            after_.append(after_value.data + pos, end - pos);
+            pos = end;
+        }
+        log_tot_len_ += sizeof(oid_t) + varint_size(rid_.page_no) + varint_size(rid_.slot_no) +
+                        varint_size(record_size_) + varint_size(ranges_.size());
+        int prev_end = 0;
+        for (auto& range : ranges_) {
+            log_tot_len_ += varint_size(range.offset - prev_end) + varint_size(range.len) + 2 * range.len;
+            prev_end = range.offset + range.len;
+        }
+    }
+
+    // 把update日志记录序列化到dest中
+    void serialize(char* dest) const override {
+        LogRecord::serialize(dest);
+        char* pos = dest + OFFSET_LOG_DATA;
+        memcpy(pos, &oid_, sizeof(oid_t));
+        pos = put_varint(pos + sizeof(oid_t), rid_.page_no);
+        pos = put_varint(pos, rid_.slot_no);
+        pos = put_varint(pos, record_size_);
+        pos = put_varint(pos, ranges_.size());
+        int prev_end = 0;
+        int data_offset = 0;
+        for (auto& range : ranges_) {
+            pos = put_varint(pos, range.offset - prev_end);
+            pos = put_varint(pos, range.len);
+            memcpy(pos, before_.data() + data_offset, range.len);
+            pos += range.len;
+            memcpy(pos, after_.data() + data_offset, range.len);
+            pos += range.len;
+            prev_end = range.offset + range.len;
+            data_offset += range.len;
+        }
+    }
+    // 从src中反序列化出一条Update日志记录
+    void deserialize(const char* src) override {
+        LogRecord::deserialize(src);
+        const char* pos = src + OFFSET_LOG_DATA;
+        uint32_t page_no, slot_no, record_size, num_ranges;
+        memcpy(&oid_, pos, sizeof(oid_t));
+        pos = get_varint(pos + sizeof(oid_t), &page_no);
+        pos = get_varint(pos, &slot_no);
+        pos = get_varint(pos, &record_size);
+        pos = get_varint(pos, &num_ranges);
+        rid_ = Rid{static_cast<int>(page_no), static_cast<int>(slot_no)};
+        record_size_ = static_cast<int>(record_size);
+        ranges_.clear();
+        before_.clear();
+        after_.clear();
+        int prev_end = 0;
+        for (uint32_t i = 0; i < num_ranges; ++i) {
+            uint32_t gap, len;
+            pos = get_varint(pos, &gap);
+            pos = get_varint(pos, &len);
+            ranges_.push_back({prev_end + static_cast<int>(gap), static_cast<int>(len)});
+            before_.append(pos, len);
+            pos += len;
+            after_.append(pos, len);
+            pos += len;
+            prev_end = ranges_.back().offset + ranges_.back().len;
+        }
+    }
+    void format_print() override {
+        printf("update record\n");
+        LogRecord::format_print();
+        printf("changed ranges: %zu\n", ranges_.size());
+        printf("update rid: %d, %d\n", rid_.page_no, rid_.slot_no);
+        printf("table oid: %d\n", oid_);
+    }
+
+    /* 把修改后（after为true）或修改前的内容写入记录record */
+    void apply(char* record, bool after) const {
+        const std::string& data = after ? after_ : before_;
+        int data_offset = 0;
+        for (auto& range : ranges_) {
+            memcpy(record + range.offset, data.data() + data_offset, range.len);
+            data_offset += range.len;
+        }
+    }
+
+    Rid rid_;                               // 被更新记录的位置
+    oid_t oid_;                             // 更新记录的表
+    int record_size_;                       // 记录的长度
+    std::vector<UpdateLogRange> ranges_;    // 修改过的各段，按offset排列
+    std::string before_;                    // 各段更新前的内容，依次相连
+    std::string after_;                     // 各段更新后的内容，依次相连
+};
+
+/* 补偿日志（CLR）：回滚事务的一条修改时写入，描述回滚所做的修改，只需要重做、不会被回滚。
+   undo_type_为被回滚的日志的类型：回滚INSERT删除rid上的记录，回滚DELETE和UPDATE把rid上的记录置为value_。
+   undo_next_lsn_为该事务下一条需要回滚的日志，故障恢复的回滚遇到CLR时直接跳到这里，已经回滚的修改不会回滚第二次 */
+class CompensationLogRecord: public LogRecord {
+public:
+    CompensationLogRecord() {
+        log_type_ = LogType::CLR;
+        lsn_ = INVALID_LSN;
+        log_tot_len_ = LOG_HEADER_SIZE;
+        log_tid_ = INVALID_TXN_ID;
+        prev_lsn_ = INVALID_LSN;
+        undo_type_ = LogType::INSERT;
+        undo_next_lsn_ = INVALID_LSN;
+        oid_ = 0;
+    }
+    CompensationLogRecord(txn_id_t txn_id, LogType undo_type, const RmRecord& value, const Rid& rid, oid_t oid,
+                          lsn_t undo_next_lsn)
+        : CompensationLogRecord() {
+        log_tid_ = txn_id;
+        undo_type_ = undo_type;
+        undo_next_lsn_ = undo_next_lsn;
+        value_ = value;
+        rid_ = rid;
+        oid_ = oid;
+        log_tot_len_ += sizeof(uint8_t) + sizeof(lsn_t) + record_log_size(rid_, value_);
+    }
+
+    // 把CLR序列化到dest中
+    void serialize(char* dest) const override {
+        LogRecord::serialize(dest);
+        char* pos = dest + OFFSET_LOG_DATA;
+        *pos = static_cast<char>(undo_type_);
+        memcpy(pos + sizeof(uint8_t), &undo_next_lsn_, sizeof(lsn_t));
+        put_record_log(pos + sizeof(uint8_t) + sizeof(lsn_t), oid_, rid_, value_);
+    }
+    // 从src中反序列化出一条CLR
+    void deserialize(const char* src) override {
+        LogRecord::deserialize(src);
+        const char* pos = src + OFFSET_LOG_DATA;
+        undo_type_ = static_cast<LogType>(*pos);
+        memcpy(&undo_next_lsn_, pos + sizeof(uint8_t), sizeof(lsn_t));
+        get_record_log(pos + sizeof(uint8_t) + sizeof(lsn_t), &oid_, &rid_, &value_);
+    }
+    void format_print() override {
+        printf("compensation record\n");
+        LogRecord::format_print();
+        printf("undo type: %s\n", LogTypeStr[undo_type_].c_str());
+        printf("undo next lsn: %d\n", undo_next_lsn_);
+        printf("clr rid: %d, %d\n", rid_.page_no, rid_.slot_no);
+        printf("table oid: %d\n", oid_);
+    }
+
+    LogType undo_type_;         // 被回滚的日志的类型
+    lsn_t undo_next_lsn_;       // 该事务下一条需要回滚的日志，没有时为INVALID_LSN
+    RmRecord value_;            // 回滚DELETE、UPDATE时rid上恢复的记录
+    Rid rid_;                   // 被回滚的记录的位置
+    oid_t oid_;                 // 记录所在的表
+};
+
+/* 检查点开始日志：之后取得活跃事务表和脏页表，故障恢复的分析从不晚于它的位置开始 */
+class BeginCheckpointLogRecord: public LogRecord {
+public:
+    BeginCheckpointLogRecord() {
+        log_type_ = LogType::BEGIN_CHECKPOINT;
+        lsn_ = INVALID_LSN;
+        log_tot_len_ = LOG_HEADER_SIZE;
+        log_tid_ = INVALID_TXN_ID;
+        prev_lsn_ = INVALID_LSN;
+    }
+    void serialize(char* dest) const override {
+        LogRecord::serialize(dest);
+    }
+    void deserialize(const char* src) override {
+        LogRecord::deserialize(src);
+    }
+};
+
+/* 检查点中的一个脏页：oid为页面所在的表，rec_lsn为页面上尚未写回的最早修改的日志号 */
+struct CheckpointDirtyPage {
+    oid_t oid;
+    page_id_t page_no;
+    lsn_t rec_lsn;
+};
 
+/* 检查点中的一个活跃事务：first_lsn为事务第一条日志的日志号的下界 */
+struct CheckpointActiveTxn {
+    txn_id_t txn_id;
+    lsn_t first_lsn;
 };
 
-/* 日志缓冲区，只有一个buffer，因此需要阻塞地去把日志写入缓冲区中 */
+/* 检查点结束日志：记录检查点开始之后取得的脏页表和活跃事务表（模糊检查点，期间事务照常执行） */
+class EndCheckpointLogRecord: public LogRecord {
+public:
+    EndCheckpointLogRecord() {
+        log_type_ = LogType::END_CHECKPOINT;
+        lsn_ = INVALID_LSN;
+        log_tot_len_ = LOG_HEADER_SIZE;
+        log_tid_ = INVALID_TXN_ID;
+        prev_lsn_ = INVALID_LSN;
+        begin_lsn_ = INVALID_LSN;
+    }
+    EndCheckpointLogRecord(lsn_t begin_lsn) : EndCheckpointLogRecord() { begin_lsn_ = begin_lsn; }
+
+    // 加入脏页和活跃事务之后计算日志长度
+    void update_length() {
+        log_tot_len_ = LOG_HEADER_SIZE + sizeof(lsn_t);
+        log_tot_len_ += sizeof(int) + dirty_pages_.size() * sizeof(CheckpointDirtyPage);
+        log_tot_len_ += sizeof(int) + active_txns_.size() * sizeof(CheckpointActiveTxn);
+    }
+
+    void serialize(char* dest) const override {
+        LogRecord::serialize(dest);
+        int offset = OFFSET_LOG_DATA;
+        memcpy(dest + offset, &begin_lsn_, sizeof(lsn_t));
+        offset += sizeof(lsn_t);
+        int num_pages = static_cast<int>(dirty_pages_.size());
+        memcpy(dest + offset, &num_pages, sizeof(int));
+        offset += sizeof(int);
+        memcpy(dest + offset, dirty_pages_.data(), num_pages * sizeof(CheckpointDirtyPage));
+        offset += num_pages * sizeof(CheckpointDirtyPage);
+        int num_txns = static_cast<int>(active_txns_.size());
+        memcpy(dest + offset, &num_txns, sizeof(int));
+        offset += sizeof(int);
+        memcpy(dest + offset, active_txns_.data(), num_txns * sizeof(CheckpointActiveTxn));
+    }
+    void deserialize(const char* src) override {
+        LogRecord::deserialize(src);
+        int offset = OFFSET_LOG_DATA;
+        begin_lsn_ = *reinterpret_cast<const lsn_t*>(src + offset);
+        offset += sizeof(lsn_t);
+        int num_pages = *reinterpret_cast<const int*>(src + offset);
+        offset += sizeof(int);
+        dirty_pages_.resize(num_pages);
+        memcpy(dirty_pages_.data(), src + offset, num_pages * sizeof(CheckpointDirtyPage));
+        offset += num_pages * sizeof(CheckpointDirtyPage);
+        int num_txns = *reinterpret_cast<const int*>(src + offset);
+        offset += sizeof(int);
+        active_txns_.resize(num_txns);
+        memcpy(active_txns_.data(), src + offset, num_txns * sizeof(CheckpointActiveTxn));
+    }
+
+    lsn_t begin_lsn_;                                   // 对应的检查点开始日志
+    std::vector<CheckpointDirtyPage> dirty_pages_;      // 脏页表
+    std::vector<CheckpointActiveTxn> active_txns_;      // 活跃事务表
+};
+
+/* 按日志类型创建一条空的日志记录，之后从日志中反序列化 */
+static inline std::unique_ptr<LogRecord> make_log_record(LogType type) {
+    switch (type) {
+        case LogType::UPDATE: return std::make_unique<UpdateLogRecord>();
+        case LogType::INSERT: return std::make_unique<InsertLogRecord>();
+        case LogType::DELETE: return std::make_unique<DeleteLogRecord>();
+        case LogType::begin: return std::make_unique<BeginLogRecord>();
+        case LogType::commit: return std::make_unique<CommitLogRecord>();
+        case LogType::ABORT: return std::make_unique<AbortLogRecord>();
+        case LogType::CLR: return std::make_unique<CompensationLogRecord>();
+        case LogType::BEGIN_CHECKPOINT: return std::make_unique<BeginCheckpointLogRecord>();
+        case LogType::END_CHECKPOINT: return std::make_unique<EndCheckpointLogRecord>();
+    }
+    return nullptr;
+}
+
+/**
+ * @description: 取得修改记录的日志（INSERT、DELETE、UPDATE和CLR）所修改的表和记录
+ * @return {bool} 不是修改记录的日志时返回false
+ */
+static inline bool log_target(const LogRecord *record, oid_t *oid, Rid *rid) {
+    switch (record->log_type_) {
+        case LogType::INSERT: {
+            auto log = static_cast<const InsertLogRecord *>(record);
+            *oid = log->oid_;
+            *rid = log->rid_;
+            return true;
+        }
+        case LogType::DELETE: {
+            auto log = static_cast<const DeleteLogRecord *>(record);
+            *oid = log->oid_;
+            *rid = log->rid_;
+            return true;
+        }
+        case LogType::UPDATE: {
+            auto log = static_cast<const UpdateLogRecord *>(record);
+            *oid = log->oid_;
+            *rid = log->rid_;
+            return true;
+        }
+        case LogType::CLR: {
+            auto log = static_cast<const CompensationLogRecord *>(record);
+            *oid = log->oid_;
+            *rid = log->rid_;
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+/* 日志缓冲区。LogManager使用两个缓冲区轮流接收日志，recovery用一个缓冲区读入日志 */
 
 class LogBuffer {
 public:
@@ -205,23 +657,105 @@ public:
     }
 
     char buffer_[LOG_BUFFER_SIZE+1];
-    int offset_;    // 写入log的offset
+    int offset_;    // 写入log的offset，LogManager中为缓冲区封存时的日志长度
+    std::atomic<int> copied_{0};    // 已经复制完成的字节数，等于offset_时封存的缓冲区可以写入磁盘
+    lsn_t last_lsn_ = INVALID_LSN;  // 封存时缓冲区中最后一条日志的日志号
+    lsn_t first_lsn_ = 0;           // 缓冲区中第一条日志的日志号，缓冲区成为当前缓冲区时确定
 };
 
-/* 日志管理器，负责把日志写入日志缓冲区，以及把日志缓冲区中的内容写入磁盘中 */
+class Transaction;
+
+/**
+ * 日志管理器，负责把日志写入日志缓冲区，以及把日志缓冲区中的内容写入磁盘中。
+ * 双缓冲：追加日志时对同时记录当前缓冲区、缓冲区内偏移和下一个日志号的状态字做一次CAS，预留空间和日志号，
+ * 之后各线程并行地把日志序列化到自己预留的位置；当前缓冲区放不下时把它封存并切换到另一个缓冲区，
+ * 刷日志线程把封存的缓冲区写入磁盘，同时新的日志写入另一个缓冲区，追加日志不需要任何全局的latch。
+ * 组提交：提交的事务把commit日志追加到缓冲区后调用flush_to等待，刷日志线程封存当前缓冲区，
+ * 用一次write加一次fdatasync写入磁盘，之后唤醒持久化位置已经覆盖其日志的所有等待者。
+ * 刷日志线程在有事务等待、缓冲区超过一半或者距上次刷盘超过FLUSH_TIMEOUT时刷盘；没有启动刷日志线程时调用者自己刷盘
+ */
 class LogManager {
 public:
-    LogManager(DiskManager* disk_manager) { disk_manager_ = disk_manager; }
-    
+    LogManager(DiskManager* disk_manager) {
+        disk_manager_ = disk_manager;
+        buffers_[0].first_lsn_ = state_lsn(state_.load());
+        MemoryTracker::subsystem(MemoryTracker::LOG_BUFFER).consume(sizeof(buffers_));
+    }
+
+    ~LogManager() {
+        stop_flusher();
+        MemoryTracker::subsystem(MemoryTracker::LOG_BUFFER).release(sizeof(buffers_));
+    }
+
     lsn_t add_log_to_buffer(LogRecord* log_record);
+
+    lsn_t append_txn_log(Transaction* txn, LogRecord* log_record);
+
     void flush_log_to_disk();
 
-    LogBuffer* get_log_buffer() { return &log_buffer_; }
+    void flush_to(lsn_t lsn);
+
+    void start_flusher(size_t group_commit_timeout_us = LOG_GROUP_COMMIT_TIMEOUT_US);
+
+    void stop_flusher();
+
+    /* 已经持久化到磁盘中的最后一条日志的日志号 */
+    lsn_t get_persist_lsn() { return persist_lsn_.load(std::memory_order_acquire); }
+
+    /* 下一条日志的日志号 */
+    lsn_t get_next_lsn() { return state_lsn(state_.load()); }
+
+    void set_next_lsn(lsn_t lsn, off_t persist_end);
+
+    bool locate(lsn_t lsn, lsn_t *segment_lsn, off_t *offset);
+
+    void discard_before(lsn_t lsn);
 
-private:    
-    std::atomic<lsn_t> global_lsn_{0};  // 全局lsn，递增，用于为每条记录分发lsn
-    std::mutex latch_;                  // 用于对log_buffer_的互斥访问
-    LogBuffer log_buffer_;              // 日志缓冲区
-    lsn_t persist_lsn_;                 // 记录已经持久化到磁盘中的最后一条日志的日志号
+    off_t get_persist_end(lsn_t *persist_lsn);
+
+    bool wait_persist(lsn_t lsn, std::chrono::milliseconds timeout);
+
+    /* 复制：备库还需要的第一条日志，检查点不丢弃它所在的分段和之后的日志；没有备库时为INT32_MAX */
+    lsn_t get_retain_lsn() { return retain_lsn_.load(std::memory_order_acquire); }
+
+    void set_retain_lsn(lsn_t lsn) { retain_lsn_.store(lsn, std::memory_order_release); }
+
+private:
+    /* 状态字：最高位为当前缓冲区，第32到62位为当前缓冲区中已经预留的长度，低32位为下一个日志号 */
+    static int state_buffer(uint64_t state) { return static_cast<int>(state >> 63); }
+    static int state_offset(uint64_t state) { return static_cast<int>((state >> 32) & 0x7fffffff); }
+    static lsn_t state_lsn(uint64_t state) { return static_cast<lsn_t>(state & 0xffffffff); }
+    static uint64_t make_state(int buffer, int offset, lsn_t lsn) {
+        return (static_cast<uint64_t>(buffer) << 63) | (static_cast<uint64_t>(offset) << 32) |
+               static_cast<uint32_t>(lsn);
+    }
+
+    bool seal(uint64_t state);
+
+    void write_sealed(std::unique_lock<std::mutex> &lock);
+
+    void flush_current(std::unique_lock<std::mutex> &lock, lsn_t lsn);
+
+    void flusher_loop();
+
+    // 日志号从1开始，页面上的日志号为0表示页面从未写过日志
+    std::atomic<uint64_t> state_{make_state(0, 0, 1)};  // 当前缓冲区、缓冲区中已经预留的长度和下一个日志号，追加日志时CAS更新
+    LogBuffer buffers_[2];              // 两个日志缓冲区，一个接收日志时另一个可以写入磁盘
+    int sealed_ = -1;                   // 已经封存、尚未写入磁盘的缓冲区，没有时为-1，由latch_保护
+    std::mutex latch_;                  // 保护封存的缓冲区和刷盘，以及下面的条件变量，追加日志不需要获取
+    std::atomic<lsn_t> persist_lsn_{0}; // 记录已经持久化到磁盘中的最后一条日志的日志号
+    off_t persist_end_ = 0;             // 已经持久化的日志在日志文件中的末尾，由latch_保护，日志发送线程只发送它之前的内容
+    std::atomic<lsn_t> retain_lsn_{INT32_MAX};  // 备库还需要的第一条日志
+    // 日志文件中的分段：段中第一条日志的日志号到段在文件中的位置，相邻的段至少相隔LOG_BUFFER_SIZE字节，由latch_保护。
+    // 检查点据此找到故障恢复开始扫描的位置
+    std::map<lsn_t, off_t> segments_;
+    off_t last_segment_offset_ = -1;    // 最后一个分段的位置
+    lsn_t request_lsn_ = INVALID_LSN;   // 等待者要求持久化到的最大日志号
+    std::condition_variable flush_cv_;      // 唤醒刷日志线程
+    std::condition_variable persist_cv_;    // 刷盘完成后唤醒等待的事务，以及等待另一个缓冲区写完的追加者
+    std::thread flusher_;
+    std::atomic<bool> flusher_running_{false};
+    bool stop_flusher_ = false;
+    std::chrono::microseconds group_commit_timeout_{0};     // 第一个等待者到达后再等待多久，让更多的提交进入同一次刷盘
     DiskManager* disk_manager_;
-}; 
+};
@@ -10,23 +10,543 @@ See the Mulan PSL v2 for more details. */
 
 #include "log_recovery.h"
 
+#include <algorithm>
+#include <exception>
+#include <queue>
+
+/**
+ * @description: update日志只记录修改过的字节：读出rid上现在的记录，写入修改后（after为true）或修改前的内容
+ * @return {bool} rid上没有记录时返回false
+ */
+static bool apply_update(const UpdateLogRecord *log, RmFileHandle *fh, const Rid &rid, bool after, RmRecord *image) {
+    if (!fh->is_record(rid)) {
+        return false;
+    }
+    *image = *fh->get_record(rid, nullptr);
+    log->apply(image->data, after);
+    return true;
+}
+
+/**
+ * @description: 取得日志文件中[offset, offset + size)处的日志，不在buffer_中时读入：
+ *              顺序扫描时从offset开始读入，逆序回滚时读入以这段日志结尾的一段
+ * @return {const char*} 日志在buffer_中的位置，超过日志文件末尾时返回nullptr
+ */
+const char *RecoveryManager::read_log(off_t offset, int size, bool backward) {
+    if (buffer_start_ < 0 || offset < buffer_start_ || offset + size > buffer_start_ + buffer_.offset_) {
+        off_t start = backward ? std::max<off_t>(scan_offset_, offset + size - LOG_BUFFER_SIZE) : offset;
+        int len = disk_manager_->read_log(buffer_.buffer_, LOG_BUFFER_SIZE, start);
+        buffer_start_ = start;
+        buffer_.offset_ = std::max(len, 0);
+        if (offset + size > buffer_start_ + buffer_.offset_) {
+            return nullptr;
+        }
+    }
+    return buffer_.buffer_ + (offset - buffer_start_);
+}
+
+/**
+ * @description: 读出analyze扫描到的日志号为lsn的日志
+ */
+std::unique_ptr<LogRecord> RecoveryManager::read_record(lsn_t lsn, bool backward) {
+    size_t i = static_cast<size_t>(lsn - first_lsn_);
+    const char *src = read_log(offsets_[i], static_cast<int>(offsets_[i + 1] - offsets_[i]), backward);
+    auto record = make_log_record(*reinterpret_cast<const LogType *>(src + OFFSET_LOG_TYPE));
+    record->deserialize(src);
+    return record;
+}
+
+/**
+ * @description: 脏页表中加入一个页面，已经在脏页表中时保留较小的recLSN
+ */
+void RecoveryManager::mark_dirty(oid_t oid, page_id_t page_no, lsn_t rec_lsn) {
+    auto [it, inserted] = dirty_pages_[oid].emplace(page_no, rec_lsn);
+    if (!inserted) {
+        it->second = std::min(it->second, rec_lsn);
+    }
+}
+
+/**
+ * @description: oid对应的表的记录文件，表已经删除时返回nullptr
+ */
+RmFileHandle *RecoveryManager::table_file(oid_t oid) const {
+    const TabMeta *tab = sm_manager_->db_.find_table(oid);
+    return tab != nullptr ? sm_manager_->find_table_handle(tab->name) : nullptr;
+}
+
 /**
- * @description: analyze阶段，需要获得脏页表（DPT）和未完成的事务列表（ATT）
+ * @description: analyze阶段处理一条日志：更新未完成的事务，检查点之后修改过的页面加入脏页表
+ * @param {lsn_t} checkpoint_lsn 主记录指向的检查点开始日志，没有检查点时为INVALID_LSN
+ */
+void RecoveryManager::analyze_record(LogRecord *record, lsn_t checkpoint_lsn) {
+    oid_t oid;
+    Rid rid;
+    switch (record->log_type_) {
+        case LogType::commit:
+        case LogType::ABORT:
+            active_txns_.erase(record->log_tid_);
+            break;
+        case LogType::END_CHECKPOINT: {
+            // 检查点时的脏页在之前的日志中可能没有扫描到，以检查点记下的recLSN为准
+            auto end = static_cast<EndCheckpointLogRecord *>(record);
+            if (end->begin_lsn_ == checkpoint_lsn) {
+                for (auto &page : end->dirty_pages_) {
+                    mark_dirty(page.oid, page.page_no, page.rec_lsn);
+                }
+            }
+            break;
+        }
+        case LogType::BEGIN_CHECKPOINT:
+            break;
+        default:
+            active_txns_[record->log_tid_] = record->lsn_;
+            if (log_target(record, &oid, &rid)) {
+                // 检查点之前的修改已经写回，或者在检查点的脏页表中
+                if (checkpoint_lsn == INVALID_LSN || record->lsn_ > checkpoint_lsn) {
+                    mark_dirty(oid, rid.page_no, record->lsn_);
+                }
+                auto it = max_pages_.emplace(oid, rid.page_no).first;
+                it->second = std::max(it->second, rid.page_no);
+                touched_tables_.insert(oid);
+            }
+            break;
+    }
+}
+
+/**
+ * @description: analyze阶段，需要获得脏页表（DPT）和未完成的事务列表（ATT）。
+ *              从主记录指向的位置顺序扫描日志，日志头不合法、日志号不连续或者超过文件末尾时认为日志到此结束，
+ *              截掉之后不完整的日志；之后的日志号和事务ID接在扫描到的日志之后
  */
 void RecoveryManager::analyze() {
- 
+    LogMasterRecord master{};
+    bool has_master = disk_manager_->read_log_master(reinterpret_cast<char *>(&master), sizeof(master)) ==
+                          static_cast<int>(sizeof(master)) &&
+                      master.magic_ == LOG_MASTER_MAGIC;
+    if (!has_master) {
+        master = LogMasterRecord{LOG_MASTER_MAGIC, INVALID_LSN, INVALID_LSN, 0};
+    }
+    scan_offset_ = master.scan_offset_;
+    first_lsn_ = INVALID_LSN;
+    offsets_.clear();
+    active_txns_.clear();
+    dirty_pages_.clear();
+    max_pages_.clear();
+    touched_tables_.clear();
+
+    off_t offset = scan_offset_;
+    lsn_t next_lsn = master.scan_lsn_;
+    txn_id_t max_txn_id = INVALID_TXN_ID;
+    while (true) {
+        const char *src = read_log(offset, LOG_HEADER_SIZE, false);
+        if (src == nullptr) {
+            break;
+        }
+        int type = *reinterpret_cast<const int *>(src + OFFSET_LOG_TYPE);
+        lsn_t lsn = *reinterpret_cast<const lsn_t *>(src + OFFSET_LSN);
+        uint32_t len = *reinterpret_cast<const uint32_t *>(src + OFFSET_LOG_TOT_LEN);
+        if (len < static_cast<uint32_t>(LOG_HEADER_SIZE) || len > static_cast<uint32_t>(LOG_BUFFER_SIZE) ||
+            type < LogType::UPDATE || type > LogType::END_CHECKPOINT || lsn < 0 ||
+            (next_lsn != INVALID_LSN && lsn != next_lsn)) {
+            break;
+        }
+        src = read_log(offset, static_cast<int>(len), false);
+        if (src == nullptr) {
+            break;
+        }
+        auto record = make_log_record(static_cast<LogType>(type));
+        record->deserialize(src);
+        if (first_lsn_ == INVALID_LSN) {
+            first_lsn_ = lsn;
+        }
+        offsets_.push_back(offset);
+        analyze_record(record.get(), has_master ? master.checkpoint_lsn_ : INVALID_LSN);
+        if (record->log_type_ == LogType::END_CHECKPOINT) {
+            for (auto &txn : static_cast<EndCheckpointLogRecord *>(record.get())->active_txns_) {
+                max_txn_id = std::max(max_txn_id, txn.txn_id);
+            }
+        }
+        max_txn_id = std::max(max_txn_id, record->log_tid_);
+        next_lsn = lsn + 1;
+        offset += len;
+    }
+    offsets_.push_back(offset);
+    disk_manager_->truncate_log(offset);
+
+    log_manager_->set_next_lsn(std::max<lsn_t>(next_lsn, 1), offset);
+    txn_manager_->set_next_txn_id(max_txn_id + 1);
+}
+
+/**
+ * @description: 重做一条修改记录的日志，重做之后页面记下这条日志的日志号
+ */
+static void redo_record(LogRecord *record, RmFileHandle *fh, const Rid &rid, lsn_t lsn) {
+    switch (record->log_type_) {
+        case LogType::INSERT:
+            fh->set_record(rid, static_cast<InsertLogRecord *>(record)->insert_value_.data, lsn);
+            break;
+        case LogType::DELETE:
+            fh->erase_record(rid, lsn);
+            break;
+        case LogType::UPDATE: {
+            RmRecord image;
+            if (apply_update(static_cast<UpdateLogRecord *>(record), fh, rid, true, &image)) {
+                fh->set_record(rid, image.data, lsn);
+            }
+            break;
+        }
+        default: {
+            auto clr = static_cast<CompensationLogRecord *>(record);
+            if (clr->undo_type_ == LogType::INSERT) {
+                fh->erase_record(rid, lsn);
+            } else {
+                fh->set_record(rid, clr->value_.data, lsn);
+            }
+            break;
+        }
+    }
+}
+
+/**
+ * @description: 重做所有未落盘的操作。先把文件扩展到日志中出现过的最大页面：故障时文件头中的页面个数可能还没有写回，
+ *              重做时新分配的页面不能与日志中的页面冲突。之后从脏页表中最小的recLSN开始，
+ *              页面在脏页表中、recLSN不晚于这条日志并且页面的日志号早于这条日志时重做。
+ *              日志按LOG_BUFFER_SIZE分段读入，处理一段的同时异步读入下一段；每段中的日志按页面分组，
+ *              页面按哈希分给num_threads个线程，同一页面上的日志按日志号顺序重做，不同页面并行重做
+ * @param {size_t} num_threads 重做线程数
+ */
+void RecoveryManager::redo(size_t num_threads) {
+    for (auto &[oid, page_no] : max_pages_) {
+        RmFileHandle *fh = table_file(oid);
+        if (fh != nullptr) {
+            fh->get_page_lsn(page_no);
+        }
+    }
+    if (first_lsn_ == INVALID_LSN) {
+        return;
+    }
+    size_t num_records = offsets_.size() - 1;
+    lsn_t redo_lsn = first_lsn_ + static_cast<lsn_t>(num_records);
+    for (auto &[oid, pages] : dirty_pages_) {
+        for (auto &[page_no, rec_lsn] : pages) {
+            redo_lsn = std::min(redo_lsn, rec_lsn);
+        }
+    }
+    redo_lsn = std::max(redo_lsn, first_lsn_);
+
+    // 从第begin条日志开始的一段：完整地落在一个缓冲区中的日志
+    auto chunk_end = [&](size_t begin) {
+        auto it = std::upper_bound(offsets_.begin() + begin, offsets_.end(), offsets_[begin] + LOG_BUFFER_SIZE);
+        return static_cast<size_t>(it - offsets_.begin()) - 1;
+    };
+    auto io = disk_manager_->create_async_io(2);
+    LogBuffer *buffers[2] = {&buffer_, &read_ahead_};
+    auto read_chunk = [&](int buffer, size_t begin, size_t end) {
+        disk_manager_->async_read_log(io.get(), buffers[buffer]->buffer_, static_cast<int>(offsets_[end] - offsets_[begin]),
+                                      offsets_[begin], buffer);
+        io->submit();
+    };
+    buffer_start_ = -1;
+    size_t begin = static_cast<size_t>(redo_lsn - first_lsn_);
+    size_t end = begin < num_records ? chunk_end(begin) : begin;
+    int current = 0;
+    if (begin < end) {
+        read_chunk(current, begin, end);
+    }
+    std::vector<IoCompletion> completions;
+    while (begin < end) {
+        completions.clear();
+        io->wait(&completions, 1);
+        if (completions.front().result != static_cast<int>(offsets_[end] - offsets_[begin])) {
+            throw InternalError("RecoveryManager::redo: short read of the log");
+        }
+        size_t next_begin = end;
+        size_t next_end = next_begin < num_records ? chunk_end(next_begin) : next_begin;
+        if (next_begin < next_end) {
+            read_chunk(1 - current, next_begin, next_end);
+        }
+        redo_chunk(buffers[current]->buffer_, begin, end, num_threads);
+        begin = next_begin;
+        end = next_end;
+        current = 1 - current;
+    }
 }
 
 /**
- * @description: 重做所有未落盘的操作
+ * @description: 重做读入chunk中的第begin到第end条（不含）日志：先按页面分组并预读这些页面，再分给各线程重做
  */
-void RecoveryManager::redo() {
+void RecoveryManager::redo_chunk(const char *chunk, size_t begin, size_t end, size_t num_threads) {
+    std::vector<std::unique_ptr<LogRecord>> records(end - begin);
+    std::vector<Rid> rids(end - begin);
+    std::map<std::pair<int, page_id_t>, RedoLogsInPage> pages;     // 按文件和页号排序，页号连续的页面合并预读
+    oid_t oid;
+    for (size_t i = begin; i < end; ++i) {
+        const char *src = chunk + (offsets_[i] - offsets_[begin]);
+        LogType type = *reinterpret_cast<const LogType *>(src + OFFSET_LOG_TYPE);
+        if (type != LogType::INSERT && type != LogType::DELETE && type != LogType::UPDATE && type != LogType::CLR) {
+            continue;
+        }
+        auto record = make_log_record(type);
+        record->deserialize(src);
+        Rid &rid = rids[i - begin];
+        log_target(record.get(), &oid, &rid);
+        RmFileHandle *fh = table_file(oid);
+        if (fh == nullptr) {
+            continue;
+        }
+        auto &dirty = dirty_pages_[oid];
+        auto page = dirty.find(rid.page_no);
+        if (page == dirty.end() || page->second > record->lsn_) {
+            continue;
+        }
+        auto &logs = pages[{fh->GetFd(), rid.page_no}];
+        logs.table_file_ = fh;
+        logs.page_no_ = rid.page_no;
+        logs.redo_logs_.push_back(record->lsn_);
+        records[i - begin] = std::move(record);
+    }
+    if (pages.empty()) {
+        return;
+    }
 
+    for (auto it = pages.begin(); it != pages.end();) {
+        auto first = it;
+        int count = 1;
+        while (++it != pages.end() && it->first.first == first->first.first &&
+               it->first.second == first->first.second + count) {
+            count++;
+        }
+        buffer_pool_manager_->prefetch(first->first.first, first->first.second, count);
+    }
+
+    num_threads = std::max<size_t>(1, std::min(num_threads, pages.size()));
+    std::vector<std::vector<RedoLogsInPage *>> work(num_threads);
+    for (auto &[page_id, logs] : pages) {
+        size_t hash = std::hash<int>()(page_id.first) * 31 + std::hash<page_id_t>()(page_id.second);
+        work[hash % num_threads].push_back(&logs);
+    }
+    auto redo_pages = [&](const std::vector<RedoLogsInPage *> &list) {
+        for (RedoLogsInPage *logs : list) {
+            lsn_t page_lsn = logs->table_file_->get_page_lsn(logs->page_no_);
+            for (lsn_t lsn : logs->redo_logs_) {
+                if (lsn > page_lsn) {
+                    size_t i = static_cast<size_t>(lsn - first_lsn_) - begin;
+                    redo_record(records[i].get(), logs->table_file_, rids[i], lsn);
+                    page_lsn = lsn;
+                }
+            }
+        }
+    };
+    if (num_threads == 1) {
+        redo_pages(work[0]);
+        return;
+    }
+    std::vector<std::thread> threads;
+    std::vector<std::exception_ptr> errors(num_threads);
+    for (size_t t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t] {
+            try {
+                redo_pages(work[t]);
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (auto &error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
 }
 
 /**
- * @description: 回滚未完成的事务
+ * @description: 回滚未完成的事务。每次回滚所有未完成事务中日志号最大的一条修改：先写CLR，再恢复记录，页面记下CLR的日志号；
+ *              遇到CLR时跳到它的undo_next_lsn_，之前已经回滚的修改不再回滚。事务回滚完成后写abort日志。
+ *              之后重建日志中出现过的表的索引（索引的修改不写日志），写回全部页面并做一次检查点
  */
 void RecoveryManager::undo() {
+    lsn_t end_lsn = first_lsn_ + static_cast<lsn_t>(offsets_.size() - 1);
+    auto in_log = [&](lsn_t lsn) { return first_lsn_ != INVALID_LSN && lsn >= first_lsn_ && lsn < end_lsn; };
+
+    std::priority_queue<std::pair<lsn_t, txn_id_t>> next;
+    for (auto &[txn_id, last_lsn] : active_txns_) {
+        next.emplace(last_lsn, txn_id);
+    }
+    oid_t oid;
+    Rid rid;
+    while (!next.empty()) {
+        auto [lsn, txn_id] = next.top();
+        next.pop();
+        auto record = read_record(lsn, true);
+        lsn_t undo_next = INVALID_LSN;
+        if (record->log_type_ == LogType::CLR) {
+            undo_next = static_cast<CompensationLogRecord *>(record.get())->undo_next_lsn_;
+        } else if (log_target(record.get(), &oid, &rid)) {
+            // 回滚DELETE和UPDATE需要完整的修改前的记录：update日志只有修改过的字节，与rid上现在的记录合成
+            RmFileHandle *fh = table_file(oid);
+            RmRecord image;
+            bool restore = record->log_type_ != LogType::INSERT;
+            if (record->log_type_ == LogType::DELETE) {
+                image = static_cast<DeleteLogRecord *>(record.get())->delete_value_;
+            } else if (record->log_type_ == LogType::UPDATE) {
+                restore = fh != nullptr &&
+                          apply_update(static_cast<UpdateLogRecord *>(record.get()), fh, rid, false, &image);
+            }
+            if (record->log_type_ == LogType::INSERT || restore) {
+                CompensationLogRecord clr(txn_id, record->log_type_, image, rid, oid, record->prev_lsn_);
+                clr.prev_lsn_ = active_txns_[txn_id];
+                lsn_t clr_lsn = log_manager_->add_log_to_buffer(&clr);
+                active_txns_[txn_id] = clr_lsn;
+                if (fh != nullptr) {
+                    if (record->log_type_ == LogType::INSERT) {
+                        fh->erase_record(rid, clr_lsn);
+                    } else {
+                        fh->set_record(rid, image.data, clr_lsn);
+                    }
+                }
+            }
+            undo_next = record->prev_lsn_;
+        }
+        if (in_log(undo_next)) {
+            next.emplace(undo_next, txn_id);
+        } else {
+            AbortLogRecord abort_log(txn_id);
+            abort_log.prev_lsn_ = active_txns_[txn_id];
+            log_manager_->add_log_to_buffer(&abort_log);
+        }
+    }
+    active_txns_.clear();
+    log_manager_->flush_log_to_disk();
+
+    rebuild_indexes();
+    checkpoint(true);
+}
+
+/**
+ * @description: 重建日志中出现过的表的全部索引，索引与恢复之后的表一致
+ */
+void RecoveryManager::rebuild_indexes() {
+    for (oid_t oid : touched_tables_) {
+        const TabMeta *tab = sm_manager_->db_.find_table(oid);
+        if (tab == nullptr) {
+            continue;
+        }
+        const std::string tab_name = tab->name;
+        std::vector<IndexMeta> indexes = tab->indexes;
+        for (auto &index : indexes) {
+            std::vector<std::string> col_names;
+            for (auto &col : index.cols) {
+                col_names.push_back(col.name);
+            }
+            bool unique = false;
+            if (!is_point_index(index.type)) {
+                unique = sm_manager_->get_index_handle(tab_name, index)->is_unique();
+            }
+            sm_manager_->drop_index(tab_name, index.cols, nullptr);
+            sm_manager_->create_index(tab_name, col_names, nullptr, unique, index.type);
+        }
+    }
+    touched_tables_.clear();
+}
+
+/**
+ * @description: 模糊检查点：写检查点开始日志，取得活跃事务表，写回索引和文件头，取得脏页表，写入检查点结束日志。
+ *              检查点结束日志持久化之后更新主记录，故障恢复从脏页的最小recLSN、活跃事务的第一条日志和检查点开始日志中
+ *              最早的一条所在的分段开始扫描，之前的日志丢弃；复制的备库还需要的日志保留
+ * @param {bool} flush_data 先写回表的全部脏页，故障恢复结束和关闭数据库时为true
+ */
+void RecoveryManager::checkpoint(bool flush_data) {
+    BeginCheckpointLogRecord begin_log;
+    lsn_t begin_lsn = log_manager_->add_log_to_buffer(&begin_log);
+
+    std::vector<std::pair<txn_id_t, lsn_t>> active_txns;
+    txn_manager_->get_active_transactions(&active_txns);
+    std::unordered_map<oid_t, std::vector<std::pair<page_id_t, lsn_t>>> dirty_pages;
+    sm_manager_->flush_for_checkpoint(&dirty_pages, flush_data);
+    // 检查点之前写回的页面和文件头持久化之后，之前的日志才可以丢弃
+    disk_manager_->sync_all_files();
+
+    EndCheckpointLogRecord end_log(begin_lsn);
+    lsn_t restart_lsn = begin_lsn;
+    for (auto &[oid, pages] : dirty_pages) {
+        for (auto &[page_no, rec_lsn] : pages) {
+            end_log.dirty_pages_.push_back({oid, page_no, rec_lsn});
+            restart_lsn = std::min(restart_lsn, rec_lsn);
+        }
+    }
+    for (auto &[txn_id, first_lsn] : active_txns) {
+        end_log.active_txns_.push_back({txn_id, first_lsn});
+        restart_lsn = std::min(restart_lsn, first_lsn);
+    }
+    end_log.update_length();
+    if (end_log.log_tot_len_ > static_cast<uint32_t>(LOG_BUFFER_SIZE)) {
+        // 脏页太多，一条日志放不下：放弃这次检查点，主记录仍然指向上一个检查点
+        return;
+    }
+    log_manager_->add_log_to_buffer(&end_log);
+    log_manager_->flush_log_to_disk();
 
-}
\ No newline at end of file
+    lsn_t scan_lsn;
+    off_t scan_offset;
+    if (!log_manager_->locate(restart_lsn, &scan_lsn, &scan_offset)) {
+        return;
+    }
+    LogMasterRecord master{LOG_MASTER_MAGIC, begin_lsn, scan_lsn, scan_offset};
+    disk_manager_->write_log_master(reinterpret_cast<const char *>(&master), sizeof(master));
+    // 备库还没有确认的日志保留到确认之后再丢弃
+    lsn_t retain_lsn = std::min(restart_lsn, log_manager_->get_retain_lsn());
+    if (retain_lsn < restart_lsn && !log_manager_->locate(retain_lsn, &scan_lsn, &scan_offset)) {
+        return;
+    }
+    disk_manager_->discard_log(scan_offset);
+    log_manager_->discard_before(retain_lsn);
+}
+
+/**
+ * @description: 启动后台检查点线程，每隔interval_ms毫秒做一次检查点，限制故障恢复需要扫描的日志
+ * @param {size_t} interval_ms 检查点的间隔，为0时不启动
+ */
+void RecoveryManager::start_checkpointer(size_t interval_ms) {
+    std::unique_lock<std::mutex> lock(checkpointer_latch_);
+    if (checkpointer_running_ || interval_ms == 0) {
+        return;
+    }
+    checkpoint_interval_ = std::chrono::milliseconds(interval_ms);
+    stop_checkpointer_ = false;
+    checkpointer_running_ = true;
+    checkpointer_ = std::thread(&RecoveryManager::checkpointer_loop, this);
+}
+
+/**
+ * @description: 停止后台检查点线程，等待正在进行的检查点完成
+ */
+void RecoveryManager::stop_checkpointer() {
+    {
+        std::unique_lock<std::mutex> lock(checkpointer_latch_);
+        if (!checkpointer_running_) {
+            return;
+        }
+        stop_checkpointer_ = true;
+    }
+    checkpointer_cv_.notify_one();
+    checkpointer_.join();
+    checkpointer_running_ = false;
+}
+
+void RecoveryManager::checkpointer_loop() {
+    std::unique_lock<std::mutex> lock(checkpointer_latch_);
+    while (!checkpointer_cv_.wait_for(lock, checkpoint_interval_, [&] { return stop_checkpointer_; })) {
+        lock.unlock();
+        try {
+            checkpoint();
+            // 同时记录缓冲池中的页面，非正常关闭后重启也能预热缓冲池
+            sm_manager_->dump_buffer_pool();
+        } catch (RMDBError &e) {
+            std::cerr << "checkpoint failed: " << e.what() << std::endl;
+        }
+        lock.lock();
+    }
+}
@@ -10,33 +10,104 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <condition_variable>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
 #include <unordered_map>
 #include "log_manager.h"
 #include "storage/disk_manager.h"
 #include "system/sm_manager.h"
+#include "transaction/transaction_manager.h"
 
 class RedoLogsInPage {
 public:
-    RedoLogsInPage() { table_file_ = nullptr; }
+    RedoLogsInPage() { table_file_ = nullptr; page_no_ = INVALID_PAGE_ID; }
     RmFileHandle* table_file_;
+    page_id_t page_no_;
     std::vector<lsn_t> redo_logs_;   // 在该page上需要redo的操作的lsn
 };
 
+/* 主记录：指向最后一个完成的检查点，故障恢复从日志文件中scan_offset_处、日志号为scan_lsn_的日志开始扫描 */
+struct LogMasterRecord {
+    uint32_t magic_;
+    lsn_t checkpoint_lsn_;      // 检查点开始日志的日志号
+    lsn_t scan_lsn_;            // 开始扫描的日志，不晚于检查点时脏页的recLSN和活跃事务的第一条日志
+    off_t scan_offset_;         // 开始扫描的日志在日志文件中的位置
+};
+
+static constexpr uint32_t LOG_MASTER_MAGIC = 0x524d4c4d;
+
+/**
+ * ARIES故障恢复：analyze从主记录指向的位置顺序扫描日志，截掉末尾不完整的日志，得到脏页表和未完成的事务；
+ * redo从脏页表中最小的recLSN开始重做页面上还没有的修改（包括CLR），恢复故障时的状态；
+ * undo按日志号从大到小回滚未完成的事务，每回滚一条修改写一条CLR，恢复过程中再次故障时不会重复回滚。
+ * 模糊检查点：写检查点开始日志之后取得活跃事务表和脏页表，写入检查点结束日志，期间事务照常执行；
+ * 之后更新主记录，并丢弃故障恢复不再需要的日志
+ */
 class RecoveryManager {
 public:
-    RecoveryManager(DiskManager* disk_manager, BufferPoolManager* buffer_pool_manager, SmManager* sm_manager) {
+    RecoveryManager(DiskManager* disk_manager, BufferPoolManager* buffer_pool_manager, SmManager* sm_manager,
+                    LogManager* log_manager, TransactionManager* txn_manager) {
         disk_manager_ = disk_manager;
         buffer_pool_manager_ = buffer_pool_manager;
         sm_manager_ = sm_manager;
+        log_manager_ = log_manager;
+        txn_manager_ = txn_manager;
     }
 
+    ~RecoveryManager() { stop_checkpointer(); }
+
     void analyze();
-    void redo();
+    void redo(size_t num_threads = REDO_THREADS);
     void undo();
+
+    void checkpoint(bool flush_data = false);
+
+    void start_checkpointer(size_t interval_ms = CHECKPOINT_INTERVAL_MS);
+
+    void stop_checkpointer();
+
 private:
+    const char* read_log(off_t offset, int size, bool backward);
+
+    std::unique_ptr<LogRecord> read_record(lsn_t lsn, bool backward);
+
+    void analyze_record(LogRecord* record, lsn_t checkpoint_lsn);
+
+    void mark_dirty(oid_t oid, page_id_t page_no, lsn_t rec_lsn);
+
+    RmFileHandle* table_file(oid_t oid) const;
+
+    void redo_chunk(const char* chunk, size_t begin, size_t end, size_t num_threads);
+
+    void rebuild_indexes();
+
+    void checkpointer_loop();
+
     LogBuffer buffer_;                                              // 读入日志
+    LogBuffer read_ahead_;                                          // 重做时预读下一段日志
+    off_t buffer_start_ = -1;                                       // buffer_中的日志在日志文件中的位置
     DiskManager* disk_manager_;                                     // 用来读写文件
     BufferPoolManager* buffer_pool_manager_;                        // 对页面进行读写
     SmManager* sm_manager_;                                         // 访问数据库元数据
-};
\ No newline at end of file
+    LogManager* log_manager_;                                       // 回滚时写CLR，以及写检查点日志
+    TransactionManager* txn_manager_;                               // 检查点取得活跃事务表
+
+    off_t scan_offset_ = 0;                                         // 开始扫描的位置
+    lsn_t first_lsn_ = INVALID_LSN;                                 // 扫描到的第一条日志
+    std::vector<off_t> offsets_;                                    // 扫描到的每条日志的位置，最后一项为有效日志的末尾
+    std::unordered_map<txn_id_t, lsn_t> active_txns_;               // 未完成的事务和它最后一条日志
+    std::unordered_map<oid_t, std::unordered_map<page_id_t, lsn_t>> dirty_pages_;   // 表的oid到脏页及其recLSN
+    std::unordered_map<oid_t, page_id_t> max_pages_;                // 日志中出现过的每张表的最大页面号
+    std::set<oid_t> touched_tables_;                                // 日志中出现过的表，故障恢复之后重建索引
+
+    std::thread checkpointer_;
+    std::mutex checkpointer_latch_;                                 // 保护stop_checkpointer_和下面的条件变量
+    std::condition_variable checkpointer_cv_;
+    bool checkpointer_running_ = false;
+    bool stop_checkpointer_ = false;
+    std::chrono::milliseconds checkpoint_interval_{0};
+};
@@ -0,0 +1,631 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "replication.h"
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "common/metrics.h"
+#include "execution/index_writer.h"
+#include "system/server_log.h"
+
+/* 两次心跳之间最多允许错过的个数，超过时认为对方已经失去连接 */
+static constexpr int REPLICATION_MISSED_HEARTBEATS = 3;
+
+static int64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ * @description: 在timeout_ms毫秒之内从fd收满len字节
+ * @return {bool} 超时、连接关闭或出错时返回false
+ */
+static bool recv_full(int fd, void *buf, size_t len, int timeout_ms) {
+    char *pos = static_cast<char *>(buf);
+    while (len > 0) {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        int ret = poll(&pfd, 1, timeout_ms);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            return false;
+        }
+        ssize_t n = recv(fd, pos, len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        pos += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static bool send_full(int fd, const void *buf, size_t len) {
+    const char *pos = static_cast<const char *>(buf);
+    while (len > 0) {
+        ssize_t n = send(fd, pos, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        pos += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+/* 发送超过这么久仍然阻塞时放弃连接，停止复制时服务线程不会一直阻塞在发送上 */
+static void set_send_timeout(int fd) {
+    struct timeval tv;
+    int timeout_ms = REPLICATION_HEARTBEAT_MS * REPLICATION_MISSED_HEARTBEATS;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    int nodelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+}
+
+/**
+ * @description: 在复制端口上监听，启动接受备库连接的线程
+ * @param {int} port 复制端口
+ */
+void LogShipper::start(int port) {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        throw UnixError();
+    }
+    int reuse = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (bind(listen_fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0 || listen(listen_fd_, 8) < 0) {
+        UnixError error;
+        close(listen_fd_);
+        listen_fd_ = -1;
+        throw error;
+    }
+    Metrics::instance().set(Metrics::REPLICATION_ROLE, Metrics::PRIMARY);
+    running_ = true;
+    acceptor_ = std::thread(&LogShipper::accept_loop, this);
+    ServerLog::info("Shipping the log to replicas on port ", port);
+}
+
+/**
+ * @description: 停止接受新的备库并断开所有备库，等待服务线程退出。日志管理器中保留的日志号不变，
+ *              关闭数据库时的检查点同样不丢弃备库还需要的日志
+ */
+void LogShipper::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    acceptor_.join();
+    reap_replicas(true);
+    close(listen_fd_);
+    listen_fd_ = -1;
+}
+
+void LogShipper::accept_loop() {
+    Metrics &metrics = Metrics::instance();
+    while (running_) {
+        metrics.set(Metrics::PRIMARY_LSN, log_manager_->get_persist_lsn());
+        reap_replicas(false);
+        struct pollfd pfd = {listen_fd_, POLLIN, 0};
+        if (poll(&pfd, 1, REPLICATION_HEARTBEAT_MS) <= 0) {
+            continue;
+        }
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        set_send_timeout(fd);
+        auto replica = std::make_unique<Replica>();
+        replica->fd_ = fd;
+        replica->retain_lsn_ = INT32_MAX;
+        Replica *raw = replica.get();
+        {
+            std::unique_lock<std::mutex> lock(latch_);
+            replicas_.push_back(std::move(replica));
+        }
+        raw->thread_ = std::thread(&LogShipper::serve, this, raw);
+    }
+}
+
+/**
+ * @description: 回收已经断开的备库（all为true时等待全部备库断开），更新日志管理器中保留的日志号和复制状态
+ */
+void LogShipper::reap_replicas(bool all) {
+    std::list<std::unique_ptr<Replica>> finished;
+    {
+        std::unique_lock<std::mutex> lock(latch_);
+        for (auto it = replicas_.begin(); it != replicas_.end();) {
+            if (all || (*it)->done_) {
+                finished.push_back(std::move(*it));
+                it = replicas_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (auto &replica : finished) {
+        if (replica->thread_.joinable()) {
+            replica->thread_.join();
+        }
+    }
+    if (!finished.empty() && !all) {
+        set_retain_lsn(nullptr, INVALID_LSN);
+    }
+}
+
+/**
+ * @description: 设置一个备库还需要的第一条日志（replica为空时只重新计算），所有备库中最小的一个交给日志管理器
+ */
+void LogShipper::set_retain_lsn(Replica *replica, lsn_t lsn) {
+    std::unique_lock<std::mutex> lock(latch_);
+    if (replica != nullptr) {
+        replica->retain_lsn_ = lsn;
+    }
+    lsn_t retain_lsn = INT32_MAX;
+    int64_t connected = 0;
+    for (auto &r : replicas_) {
+        if (!r->done_) {
+            retain_lsn = std::min(retain_lsn, r->retain_lsn_);
+            connected++;
+        }
+    }
+    log_manager_->set_retain_lsn(retain_lsn);
+    Metrics::instance().set(Metrics::REPLICAS, connected);
+    Metrics::instance().set(Metrics::REPLICATED_LSN, connected > 0 ? retain_lsn : 0);
+}
+
+/**
+ * @description: 找到日志号为start_lsn的日志在日志文件中的位置：从它所在分段的开头逐条跳过之前的日志
+ * @return {bool} 日志已经丢弃或者备库比主库还新时返回false，原因写入error
+ */
+bool LogShipper::find_start(lsn_t start_lsn, off_t *offset, std::string *error) {
+    lsn_t persist_lsn;
+    off_t persist_end = log_manager_->get_persist_end(&persist_lsn);
+    if (start_lsn == persist_lsn + 1) {
+        *offset = persist_end;
+        return true;
+    }
+    lsn_t lsn;
+    if (start_lsn > persist_lsn + 1 || !log_manager_->locate(start_lsn, &lsn, offset)) {
+        *error = start_lsn > persist_lsn + 1
+                     ? "replica asks for lsn " + std::to_string(start_lsn) + " beyond the primary's log"
+                     : "log from lsn " + std::to_string(start_lsn) + " has been discarded, copy the primary again";
+        return false;
+    }
+    char header[LOG_HEADER_SIZE];
+    while (lsn < start_lsn) {
+        if (disk_manager_->read_log(header, LOG_HEADER_SIZE, *offset) != LOG_HEADER_SIZE ||
+            *reinterpret_cast<const lsn_t *>(header + OFFSET_LSN) != lsn) {
+            *error = "cannot find lsn " + std::to_string(start_lsn) + " in the log";
+            return false;
+        }
+        *offset += *reinterpret_cast<const uint32_t *>(header + OFFSET_LOG_TOT_LEN);
+        lsn++;
+    }
+    return true;
+}
+
+bool LogShipper::send_frame(int fd, ReplicationFrameType type, lsn_t persist_lsn, const char *data, uint32_t len) {
+    ReplicationFrameHeader header{type, len, persist_lsn, now_us()};
+    return send_full(fd, &header, sizeof(header)) && (len == 0 || send_full(fd, data, len));
+}
+
+/**
+ * @description: 服务一个备库：收到起始日志号之后，循环发送已经持久化、还没有发送的日志，
+ *              没有新的日志时发送心跳，并读入备库的确认。备库断开或停止复制时返回
+ */
+void LogShipper::serve(Replica *replica) {
+    int fd = replica->fd_;
+    int timeout_ms = REPLICATION_HEARTBEAT_MS * REPLICATION_MISSED_HEARTBEATS;
+    ReplicationHello hello;
+    if (recv_full(fd, &hello, sizeof(hello), timeout_ms) && hello.magic_ == REPLICATION_MAGIC) {
+        // 先保留起始日志号之后的日志，再查找它的位置，期间的检查点不会丢弃这些日志
+        set_retain_lsn(replica, hello.start_lsn_);
+        off_t offset;
+        std::string error;
+        if (!find_start(hello.start_lsn_, &offset, &error)) {
+            ServerLog::warn("Replica rejected: ", error);
+            send_frame(fd, REPLICATION_ERROR, log_manager_->get_persist_lsn(), error.data(),
+                       static_cast<uint32_t>(error.size()));
+        } else {
+            ServerLog::info("Replica connected, shipping the log from lsn ", hello.start_lsn_);
+            std::vector<char> buffer(LOG_BUFFER_SIZE);
+            bool connected = true;
+            while (running_ && connected) {
+                lsn_t persist_lsn;
+                off_t persist_end = log_manager_->get_persist_end(&persist_lsn);
+                if (offset < persist_end) {
+                    int len = static_cast<int>(std::min<off_t>(persist_end - offset, LOG_BUFFER_SIZE));
+                    if (disk_manager_->read_log(buffer.data(), len, offset) != len) {
+                        ServerLog::error("Replication: short read of the log at offset ", offset);
+                        break;
+                    }
+                    connected = send_frame(fd, REPLICATION_DATA, persist_lsn, buffer.data(), len);
+                    offset += len;
+                } else if (!log_manager_->wait_persist(persist_lsn + 1,
+                                                       std::chrono::milliseconds(REPLICATION_HEARTBEAT_MS))) {
+                    connected = send_frame(fd, REPLICATION_HEARTBEAT, persist_lsn, nullptr, 0);
+                }
+                // 读入已经到达的确认，备库关闭连接时recv返回0
+                struct pollfd pfd = {fd, POLLIN, 0};
+                while (connected && poll(&pfd, 1, 0) > 0) {
+                    ReplicationAck ack;
+                    connected = recv_full(fd, &ack, sizeof(ack), timeout_ms);
+                    if (connected) {
+                        set_retain_lsn(replica, ack.resume_lsn_);
+                    }
+                }
+            }
+            ServerLog::info("Replica disconnected");
+        }
+    }
+    close(fd);
+    replica->done_ = true;
+    set_retain_lsn(nullptr, INVALID_LSN);
+}
+
+/* 备库上记录回放位置的文件 */
+struct ReplicaState {
+    uint32_t magic_;
+    lsn_t resume_lsn_;      // 重新连接时从这条主库日志开始接收
+    lsn_t replayed_lsn_;    // 日志号不超过它的事务已经回放并提交
+};
+
+/**
+ * @description: 启动回放线程
+ * @param {string&} primary 主库的复制地址，格式为host:port
+ * @param {lsn_t} seed_lsn 没有回放位置文件时（第一次启动）从这条主库日志开始接收，即复制的数据库中日志的末尾
+ */
+void ReplicaApplier::start(const std::string &primary, lsn_t seed_lsn) {
+    size_t colon = primary.rfind(':');
+    if (colon == std::string::npos || colon == 0 || colon + 1 == primary.size()) {
+        throw ReplicationError("primary address should be host:port, got " + primary);
+    }
+    host_ = primary.substr(0, colon);
+    port_ = primary.substr(colon + 1);
+    load_state(seed_lsn);
+    Metrics::instance().set(Metrics::REPLICATION_ROLE, Metrics::REPLICA);
+    Metrics::instance().set(Metrics::REPLICATED_LSN, replayed_lsn_);
+    running_ = true;
+    thread_ = std::thread(&ReplicaApplier::run, this);
+    ServerLog::info("Replicating from ", primary, " at lsn ", next_lsn_);
+}
+
+void ReplicaApplier::stop() {
+    {
+        std::unique_lock<std::mutex> lock(latch_);
+        if (!running_.exchange(false) && !thread_.joinable()) {
+            return;
+        }
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+/**
+ * @description: 回放线程：连接主库并接收日志，连接断开之后每隔REPLICATION_HEARTBEAT_MS重新连接。
+ *              主库拒绝复制或者回放失败时停止复制，备库继续以最后回放的状态提供只读查询
+ */
+void ReplicaApplier::run() {
+    Metrics &metrics = Metrics::instance();
+    while (running_) {
+        int fd = connect_primary();
+        if (fd >= 0) {
+            try {
+                stream(fd);
+            } catch (RMDBError &e) {
+                ServerLog::error("Replication stopped: ", e.what());
+                running_ = false;
+            }
+            close(fd);
+            metrics.set(Metrics::REPLICAS, 0);
+            // 断开期间主库可能继续提交，复制延迟从最后一次收到主库的消息开始计算
+            if (metrics.get(Metrics::REPLICA_BEHIND_SINCE_US) == 0) {
+                metrics.set(Metrics::REPLICA_BEHIND_SINCE_US, last_send_time_us_);
+            }
+        }
+        std::unique_lock<std::mutex> lock(latch_);
+        cv_.wait_for(lock, std::chrono::milliseconds(REPLICATION_HEARTBEAT_MS), [&] { return !running_; });
+    }
+}
+
+int ReplicaApplier::connect_primary() {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *result = nullptr;
+    if (getaddrinfo(host_.c_str(), port_.c_str(), &hints, &result) != 0) {
+        return -1;
+    }
+    int fd = -1;
+    for (struct addrinfo *ai = result; ai != nullptr && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(result);
+    if (fd >= 0) {
+        set_send_timeout(fd);
+    }
+    return fd;
+}
+
+/**
+ * @description: 在一个连接上接收并回放主库的日志。每次重新连接都从回放位置开始，丢弃上次连接中缓存的事务
+ */
+void ReplicaApplier::stream(int fd) {
+    Metrics &metrics = Metrics::instance();
+    next_lsn_ = resume_lsn();
+    pending_.clear();
+    partial_.clear();
+    ReplicationHello hello{REPLICATION_MAGIC, next_lsn_};
+    if (!send_full(fd, &hello, sizeof(hello))) {
+        return;
+    }
+    metrics.set(Metrics::REPLICAS, 1);
+    int timeout_ms = REPLICATION_HEARTBEAT_MS * REPLICATION_MISSED_HEARTBEATS;
+    lsn_t acked_lsn = next_lsn_;
+    std::vector<char> data;
+    std::vector<PendingTxn> committed;
+    while (running_) {
+        ReplicationFrameHeader header;
+        if (!recv_full(fd, &header, sizeof(header), timeout_ms)) {
+            return;
+        }
+        data.resize(header.len_);
+        if (header.len_ > 0 && !recv_full(fd, data.data(), header.len_, timeout_ms)) {
+            return;
+        }
+        if (header.type_ == REPLICATION_ERROR) {
+            throw ReplicationError("primary refused: " + std::string(data.begin(), data.end()));
+        }
+        last_send_time_us_ = header.send_time_us_;
+        metrics.set(Metrics::PRIMARY_LSN, header.persist_lsn_);
+        if (header.type_ == REPLICATION_DATA) {
+            receive(data.data(), data.size(), &committed);
+            if (!committed.empty()) {
+                replay(committed);
+                committed.clear();
+            }
+        }
+        lsn_t resume = resume_lsn();
+        if (resume != acked_lsn) {
+            save_state();
+            ReplicationAck ack{resume};
+            if (!send_full(fd, &ack, sizeof(ack))) {
+                return;
+            }
+            acked_lsn = resume;
+        }
+        metrics.set(Metrics::REPLICATED_LSN, next_lsn_ - 1);
+        metrics.set(Metrics::REPLICA_BEHIND_SINCE_US, next_lsn_ > header.persist_lsn_ ? 0 : header.send_time_us_);
+    }
+}
+
+/**
+ * @description: 处理收到的一段日志：拼上之前不完整的日志后逐条解析，修改记录的日志按事务缓存，
+ *              commit日志把事务移入committed，abort日志丢弃事务。日志号必须从next_lsn_开始连续
+ */
+void ReplicaApplier::receive(const char *data, size_t len, std::vector<PendingTxn> *committed) {
+    partial_.append(data, len);
+    size_t pos = 0;
+    while (partial_.size() - pos >= static_cast<size_t>(LOG_HEADER_SIZE)) {
+        const char *src = partial_.data() + pos;
+        int type = *reinterpret_cast<const int *>(src + OFFSET_LOG_TYPE);
+        lsn_t lsn = *reinterpret_cast<const lsn_t *>(src + OFFSET_LSN);
+        uint32_t tot_len = *reinterpret_cast<const uint32_t *>(src + OFFSET_LOG_TOT_LEN);
+        if (tot_len < static_cast<uint32_t>(LOG_HEADER_SIZE) || tot_len > static_cast<uint32_t>(LOG_BUFFER_SIZE) ||
+            type < LogType::UPDATE || type > LogType::END_CHECKPOINT || lsn != next_lsn_) {
+            throw ReplicationError("unexpected log record at lsn " + std::to_string(next_lsn_));
+        }
+        if (partial_.size() - pos < tot_len) {
+            break;
+        }
+        auto record = make_log_record(static_cast<LogType>(type));
+        record->deserialize(src);
+        pos += tot_len;
+        next_lsn_ = lsn + 1;
+
+        txn_id_t txn_id = record->log_tid_;
+        switch (record->log_type_) {
+            case LogType::commit: {
+                auto it = pending_.find(txn_id);
+                if (it != pending_.end()) {
+                    // 重新连接之后再次收到的、已经回放过的事务不再回放
+                    if (lsn > replayed_lsn_) {
+                        committed->push_back(std::move(it->second));
+                    }
+                    pending_.erase(it);
+                }
+                break;
+            }
+            case LogType::ABORT:
+                pending_.erase(txn_id);
+                break;
+            case LogType::BEGIN_CHECKPOINT:
+            case LogType::END_CHECKPOINT:
+                break;
+            default: {
+                PendingTxn &txn = pending_[txn_id];
+                if (txn.first_lsn_ == INVALID_LSN) {
+                    txn.first_lsn_ = lsn;
+                }
+                if (record->log_type_ != LogType::begin) {
+                    txn.records_.push_back(std::move(record));
+                }
+                break;
+            }
+        }
+    }
+    partial_.erase(0, pos);
+}
+
+/**
+ * @description: 把committed中的事务按提交顺序合并为一个备库上的事务回放并提交，之后推进回放位置。
+ *              回放失败时回滚备库上的事务并抛出异常，回放位置不变
+ */
+void ReplicaApplier::replay(std::vector<PendingTxn> &committed) {
+    Transaction *txn = txn_manager_->begin(nullptr, log_manager_);
+    Context context(nullptr, log_manager_, txn);
+    try {
+        std::unordered_map<oid_t, std::unique_ptr<IndexWriter>> writers;
+        for (auto &pending : committed) {
+            for (auto &record : pending.records_) {
+                replay_record(record.get(), &context, &writers);
+            }
+        }
+        txn_manager_->commit(txn, log_manager_);
+    } catch (RMDBError &e) {
+        txn_manager_->abort(txn, log_manager_);
+        throw ReplicationError(std::string("replay failed: ") + e.what());
+    } catch (TransactionAbortException &e) {
+        txn_manager_->abort(txn, log_manager_);
+        throw ReplicationError("replay failed: " + e.GetInfo());
+    }
+    replayed_lsn_ = next_lsn_ - 1;
+}
+
+/**
+ * @description: 回放一条修改记录的日志：把rid上的记录置为日志中修改之后的状态，并修改索引中的key。
+ *              表在备库上不存在（主库上之后新建的表）时跳过
+ */
+void ReplicaApplier::replay_record(LogRecord *record, Context *context,
+                                   std::unordered_map<oid_t, std::unique_ptr<IndexWriter>> *writers) {
+    oid_t oid;
+    Rid rid;
+    if (!log_target(record, &oid, &rid)) {
+        return;
+    }
+    const TabMeta *tab = sm_manager_->db_.find_table(oid);
+    if (tab == nullptr) {
+        return;
+    }
+    RmFileHandle *fh = sm_manager_->find_table_handle(tab->name);
+    auto &writer = (*writers)[oid];
+    if (writer == nullptr) {
+        writer = std::make_unique<IndexWriter>(sm_manager_, tab->name, tab->indexes, context->txn_);
+    }
+    std::unique_ptr<RmRecord> before;
+    if (rid.page_no < fh->get_file_hdr().num_pages && fh->is_record(rid)) {
+        before = fh->get_record(rid, nullptr);
+    }
+    // 回放之后rid上的记录，为nullptr时删除
+    char *after = nullptr;
+    RmRecord image;
+    switch (record->log_type_) {
+        case LogType::INSERT:
+            after = static_cast<InsertLogRecord *>(record)->insert_value_.data;
+            break;
+        case LogType::DELETE:
+            break;
+        case LogType::UPDATE:
+            if (before == nullptr) {
+                return;
+            }
+            image = *before;
+            static_cast<UpdateLogRecord *>(record)->apply(image.data, true);
+            after = image.data;
+            break;
+        default: {
+            auto clr = static_cast<CompensationLogRecord *>(record);
+            if (clr->undo_type_ != LogType::INSERT) {
+                after = clr->value_.data;
+            }
+            break;
+        }
+    }
+    if (before != nullptr) {
+        writer->remove(before->data, rid);
+    }
+    if (after != nullptr) {
+        fh->put_record(rid, after, context);
+        writer->insert(after, rid);
+    } else if (before != nullptr) {
+        fh->delete_record(rid, context);
+    }
+    // 同一个事务可能多次修改同一条记录，每条日志的索引修改立即生效
+    writer->flush();
+}
+
+/* 重新连接时开始接收的日志：尚未提交的事务中最早的一条，没有时为下一条要接收的日志 */
+lsn_t ReplicaApplier::resume_lsn() const {
+    lsn_t lsn = next_lsn_;
+    for (auto &[txn_id, txn] : pending_) {
+        lsn = std::min(lsn, txn.first_lsn_);
+    }
+    return lsn;
+}
+
+/**
+ * @description: 读入回放位置。第一次启动时没有回放位置文件，从seed_lsn开始接收并立即写入回放位置：
+ *              之后备库自己的日志会越过seed_lsn，重新启动时不能再由日志的末尾推断主库的位置
+ */
+void ReplicaApplier::load_state(lsn_t seed_lsn) {
+    ReplicaState state{};
+    int fd = open(REPLICA_STATE_FILE_NAME.c_str(), O_RDONLY);
+    bool has_state = false;
+    if (fd >= 0) {
+        has_state = read(fd, &state, sizeof(state)) == static_cast<ssize_t>(sizeof(state)) &&
+                    state.magic_ == REPLICATION_MAGIC;
+        close(fd);
+    }
+    if (has_state) {
+        next_lsn_ = state.resume_lsn_;
+        replayed_lsn_ = state.replayed_lsn_;
+        return;
+    }
+    next_lsn_ = seed_lsn;
+    replayed_lsn_ = seed_lsn - 1;
+    save_state();
+}
+
+/**
+ * @description: 持久化回放位置：先写入临时文件并同步，再原子地替换原来的文件。
+ *              在回放的事务提交（日志持久化）之后调用，故障时最多重新回放已经提交的最后一批事务，回放的结果相同
+ */
+void ReplicaApplier::save_state() {
+    ReplicaState state{REPLICATION_MAGIC, resume_lsn(), replayed_lsn_};
+    std::string tmp_name = REPLICA_STATE_FILE_NAME + ".tmp";
+    int fd = open(tmp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        throw UnixError();
+    }
+    bool ok = write(fd, &state, sizeof(state)) == static_cast<ssize_t>(sizeof(state)) && fsync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmp_name.c_str(), REPLICA_STATE_FILE_NAME.c_str()) != 0) {
+        throw UnixError();
+    }
+}
@@ -0,0 +1,157 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "log_manager.h"
+#include "storage/disk_manager.h"
+#include "system/sm_manager.h"
+#include "transaction/transaction_manager.h"
+
+class IndexWriter;
+
+static constexpr uint32_t REPLICATION_MAGIC = 0x524d5250;
+
+/* 备库连接主库之后发送的第一条消息：从主库日志号为start_lsn_的日志开始接收 */
+struct ReplicationHello {
+    uint32_t magic_;
+    lsn_t start_lsn_;
+};
+
+/* 主库发给备库的消息：DATA之后是日志文件中连续的一段日志，ERROR之后是错误信息，HEARTBEAT没有内容 */
+enum ReplicationFrameType : uint32_t { REPLICATION_DATA = 0, REPLICATION_HEARTBEAT, REPLICATION_ERROR };
+
+struct ReplicationFrameHeader {
+    uint32_t type_;
+    uint32_t len_;              // 消息头之后的内容的长度
+    lsn_t persist_lsn_;         // 发送时主库持久化到的日志号
+    int64_t send_time_us_;      // 发送时主库的时间（system_clock的微秒数），备库据此计算复制延迟
+};
+
+/* 备库回放之后的确认：备库重新连接时从resume_lsn_开始接收，主库保留它之后的日志 */
+struct ReplicationAck {
+    lsn_t resume_lsn_;
+};
+
+/**
+ * 主库的日志发送：监听复制端口，每个连接上来的备库由一个线程服务。备库发送想要的第一条日志的日志号，
+ * 线程在日志管理器的分段中找到它在日志文件中的位置，之后把已经持久化的日志原样从日志文件中读出发送，
+ * 没有新的日志时每隔REPLICATION_HEARTBEAT_MS发送心跳。尚未持久化的日志不发送，主库故障恢复时截掉的日志不会出现在备库上。
+ * 各备库确认的日志号中最小的一个交给日志管理器，检查点不丢弃备库还需要的日志
+ */
+class LogShipper {
+public:
+    LogShipper(DiskManager* disk_manager, LogManager* log_manager)
+        : disk_manager_(disk_manager), log_manager_(log_manager) {}
+
+    ~LogShipper() { stop(); }
+
+    void start(int port);
+
+    void stop();
+
+private:
+    struct Replica {
+        int fd_;
+        lsn_t retain_lsn_;                  // 备库还需要的第一条日志
+        std::thread thread_;
+        std::atomic<bool> done_{false};
+    };
+
+    void accept_loop();
+
+    void serve(Replica* replica);
+
+    bool find_start(lsn_t start_lsn, off_t* offset, std::string* error);
+
+    bool send_frame(int fd, ReplicationFrameType type, lsn_t persist_lsn, const char* data, uint32_t len);
+
+    void set_retain_lsn(Replica* replica, lsn_t lsn);
+
+    void reap_replicas(bool all);
+
+    DiskManager* disk_manager_;
+    LogManager* log_manager_;
+    int listen_fd_ = -1;
+    std::thread acceptor_;
+    std::atomic<bool> running_{false};
+    std::mutex latch_;                          // 保护replicas_和各备库的retain_lsn_
+    std::list<std::unique_ptr<Replica>> replicas_;
+};
+
+/**
+ * 备库的日志回放：连接主库，从上次回放到的位置接收主库的日志，按日志号顺序处理。
+ * 一个事务的修改先缓存起来，收到它的commit日志之后才回放，回滚的事务直接丢弃；一次收到的日志中提交的事务
+ * 按提交顺序合并为备库上的一个事务回放并提交，只刷一次盘，快照读看到的总是主库上提交顺序的一个前缀。
+ * 回放与故障恢复的重做一样按(oid, rid)把记录置为日志中的状态，表的记录号与主库一致，并同时维护备库上的索引。
+ * 回放的事务写备库自己的日志，备库故障后照常恢复；回放的位置记在REPLICA_STATE_FILE_NAME中，
+ * 重新连接时从尚未提交的事务中最早的一条日志开始接收，日志号不超过已回放位置的commit日志不再回放
+ */
+class ReplicaApplier {
+public:
+    ReplicaApplier(SmManager* sm_manager, TransactionManager* txn_manager, LogManager* log_manager)
+        : sm_manager_(sm_manager), txn_manager_(txn_manager), log_manager_(log_manager) {}
+
+    ~ReplicaApplier() { stop(); }
+
+    void start(const std::string& primary, lsn_t seed_lsn);
+
+    void stop();
+
+private:
+    /* 尚未提交的一个主库事务 */
+    struct PendingTxn {
+        lsn_t first_lsn_ = INVALID_LSN;                     // 收到的该事务的第一条日志
+        std::vector<std::unique_ptr<LogRecord>> records_;   // 修改记录的日志，按日志号排列
+    };
+
+    void run();
+
+    int connect_primary();
+
+    void stream(int fd);
+
+    void receive(const char* data, size_t len, std::vector<PendingTxn>* committed);
+
+    void replay(std::vector<PendingTxn>& committed);
+
+    void replay_record(LogRecord* record, Context* context,
+                       std::unordered_map<oid_t, std::unique_ptr<IndexWriter>>* writers);
+
+    lsn_t resume_lsn() const;
+
+    void load_state(lsn_t seed_lsn);
+
+    void save_state();
+
+    SmManager* sm_manager_;
+    TransactionManager* txn_manager_;
+    LogManager* log_manager_;
+    std::string host_;
+    std::string port_;
+    lsn_t next_lsn_ = INVALID_LSN;                      // 下一条要接收的主库日志
+    lsn_t replayed_lsn_ = INVALID_LSN;                  // 已经回放并在备库上提交的位置
+    std::unordered_map<txn_id_t, PendingTxn> pending_;  // 尚未提交的主库事务
+    std::string partial_;                               // 收到的末尾不完整的日志
+    int64_t last_send_time_us_ = 0;                     // 最近收到的消息在主库上发送的时间
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    std::mutex latch_;                                  // 重新连接之前的等待，stop时立即唤醒
+    std::condition_variable cv_;
+};
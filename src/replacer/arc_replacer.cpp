@@ -0,0 +1,169 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "arc_replacer.h"
+
+#include <algorithm>
+
+bool ARCReplacer::GhostList::erase(int64_t page_key) {
+    auto it = map_.find(page_key);
+    if (it == map_.end()) {
+        return false;
+    }
+    list_.erase(it->second);
+    map_.erase(it);
+    return true;
+}
+
+void ARCReplacer::GhostList::push(int64_t page_key, size_t max_size) {
+    list_.push_front(page_key);
+    map_[page_key] = list_.begin();
+    while (list_.size() > max_size) {
+        map_.erase(list_.back());
+        list_.pop_back();
+    }
+}
+
+ARCReplacer::ARCReplacer(size_t num_pages) : frames_(num_pages), max_size_(num_pages) {}
+
+ARCReplacer::~ARCReplacer() = default;
+
+/**
+ * @description: 修改帧所在的层级，同时维护T1/T2的帧数，调用时帧不能处于可淘汰状态
+ */
+void ARCReplacer::set_tier(FrameInfo &info, Tier tier) {
+    if (info.tier_ == Tier::RECENT) t1_count_--;
+    if (info.tier_ == Tier::FREQUENT) t2_count_--;
+    info.tier_ = tier;
+    if (tier == Tier::RECENT) t1_count_++;
+    if (tier == Tier::FREQUENT) t2_count_++;
+}
+
+/**
+ * @description: 使用ARC策略删除一个victim frame，并返回该frame的id。
+ *              T1超过目标大小时从T1淘汰，否则从T2淘汰，被淘汰的页面记入对应的B1/B2
+ * @param {frame_id_t*} frame_id 被移除的frame的id，如果没有frame被移除返回nullptr
+ * @return {bool} 如果成功淘汰了一个页面则返回true，否则返回false
+ */
+bool ARCReplacer::victim(frame_id_t *frame_id) {
+    std::scoped_lock lock{latch_};
+    if (t1_.empty() && t2_.empty()) {
+        return false;
+    }
+    bool from_t1 = !t1_.empty() && (t1_count_ > target_t1_ || t2_.empty());
+    auto &candidates = from_t1 ? t1_ : t2_;
+    *frame_id = candidates.back();
+    candidates.pop_back();
+
+    FrameInfo &info = frames_[*frame_id];
+    info.evictable_ = false;
+    if (info.page_key_ >= 0) {
+        (from_t1 ? b1_ : b2_).push(info.page_key_, max_size_);
+    }
+    info.page_key_ = -1;
+    set_tier(info, Tier::NONE);
+    return true;
+}
+
+/**
+ * @description: 固定指定的frame，即该页面无法被淘汰。T1中的页面再次被访问时提升到T2
+ * @param {frame_id_t} 需要固定的frame的id
+ */
+void ARCReplacer::pin(frame_id_t frame_id) {
+    if (frame_id < 0 || static_cast<size_t>(frame_id) >= max_size_) {
+        return;
+    }
+    std::scoped_lock lock{latch_};
+    FrameInfo &info = frames_[frame_id];
+    if (info.evictable_) {
+        (info.tier_ == Tier::FREQUENT ? t2_ : t1_).erase(info.pos_);
+        info.evictable_ = false;
+    }
+    if (info.tier_ == Tier::NONE) {
+        // 没有通过record_load装入的帧，本次pin视为第一次访问
+        set_tier(info, Tier::RECENT);
+    } else if (info.fresh_) {
+        info.fresh_ = false;
+    } else if (info.tier_ == Tier::RECENT) {
+        set_tier(info, Tier::FREQUENT);
+    }
+}
+
+/**
+ * @description: 取消固定一个frame，代表该页面可以被淘汰
+ * @param {frame_id_t} frame_id 取消固定的frame的id
+ */
+void ARCReplacer::unpin(frame_id_t frame_id) {
+    if (frame_id < 0 || static_cast<size_t>(frame_id) >= max_size_) {
+        return;
+    }
+    std::scoped_lock lock{latch_};
+    FrameInfo &info = frames_[frame_id];
+    if (info.evictable_) {
+        return;
+    }
+    if (info.tier_ == Tier::NONE) {
+        set_tier(info, Tier::RECENT);
+    }
+    info.fresh_ = false;
+    auto &candidates = info.tier_ == Tier::FREQUENT ? t2_ : t1_;
+    candidates.push_front(frame_id);
+    info.pos_ = candidates.begin();
+    info.evictable_ = true;
+}
+
+/**
+ * @description: 记录帧中装入了新的页面。页面命中B1说明T1过小，命中B2说明T2过小，据此调整T1的目标大小
+ * @param {frame_id_t} frame_id 装入页面的帧
+ * @param {int64_t} page_key 页面的标识
+ */
+void ARCReplacer::record_load(frame_id_t frame_id, int64_t page_key) {
+    if (frame_id < 0 || static_cast<size_t>(frame_id) >= max_size_) {
+        return;
+    }
+    std::scoped_lock lock{latch_};
+    FrameInfo &info = frames_[frame_id];
+    if (info.evictable_) {
+        (info.tier_ == Tier::FREQUENT ? t2_ : t1_).erase(info.pos_);
+        info.evictable_ = false;
+    }
+    size_t b1_size = b1_.list_.size();
+    size_t b2_size = b2_.list_.size();
+    if (b1_.erase(page_key)) {
+        target_t1_ = std::min(max_size_, target_t1_ + std::max<size_t>(b2_size / b1_size, 1));
+        set_tier(info, Tier::FREQUENT);
+    } else if (b2_.erase(page_key)) {
+        size_t delta = std::max<size_t>(b1_size / b2_size, 1);
+        target_t1_ = target_t1_ > delta ? target_t1_ - delta : 0;
+        set_tier(info, Tier::FREQUENT);
+    } else {
+        set_tier(info, Tier::RECENT);
+    }
+    info.page_key_ = page_key;
+    info.fresh_ = true;
+}
+
+/**
+ * @description: 按淘汰顺序列出可以被淘汰的帧：先是只被访问过一次的T1，再是T2，各自从最早被释放的帧开始
+ * @param {vector<frame_id_t>*} frames 可以被淘汰的帧
+ */
+void ARCReplacer::eviction_order(std::vector<frame_id_t> *frames) {
+    std::scoped_lock lock{latch_};
+    frames->assign(t1_.rbegin(), t1_.rend());
+    frames->insert(frames->end(), t2_.rbegin(), t2_.rend());
+}
+
+/**
+ * @description: 获取当前replacer中可以被淘汰的页面数量
+ */
+size_t ARCReplacer::Size() {
+    std::scoped_lock lock{latch_};
+    return t1_.size() + t2_.size();
+}
@@ -0,0 +1,82 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "common/config.h"
+#include "replacer/replacer.h"
+
+/*
+ARCReplacer实现了ARC（Adaptive Replacement Cache）替换策略
+T1存放只被访问过一次的页面所在的帧，T2存放被访问过至少两次的页面所在的帧；B1/B2记录最近从T1/T2淘汰的页面。
+被淘汰的页面再次被装入时，根据它命中B1还是B2调整T1的目标大小，使缓存在“近期性”和“频率”之间自适应，
+大范围扫描只会冲刷T1，不会挤掉T2中的热点页面
+*/
+class ARCReplacer : public Replacer {
+   public:
+    /**
+     * @description: 创建一个新的ARCReplacer
+     * @param {size_t} num_pages ARCReplacer最多需要存储的page数量，frame id需小于该值
+     */
+    explicit ARCReplacer(size_t num_pages);
+
+    ~ARCReplacer();
+
+    bool victim(frame_id_t *frame_id);
+
+    void pin(frame_id_t frame_id);
+
+    void unpin(frame_id_t frame_id);
+
+    void record_load(frame_id_t frame_id, int64_t page_key);
+
+    void eviction_order(std::vector<frame_id_t> *frames);
+
+    size_t Size();
+
+   private:
+    /* 帧所在的层级：未装入页面、T1、T2 */
+    enum class Tier { NONE, RECENT, FREQUENT };
+
+    struct FrameInfo {
+        Tier tier_ = Tier::NONE;
+        bool evictable_ = false;    // 是否在t1_/t2_中等待淘汰
+        bool fresh_ = false;        // 页面刚装入，下一次pin属于装入过程而不是一次命中
+        int64_t page_key_ = -1;     // 帧中页面的标识，-1表示未知
+        std::list<frame_id_t>::iterator pos_;
+    };
+
+    /* 被淘汰页面的历史记录（B1/B2），首部为最近淘汰的页面 */
+    struct GhostList {
+        std::list<int64_t> list_;
+        std::unordered_map<int64_t, std::list<int64_t>::iterator> map_;
+
+        bool erase(int64_t page_key);
+        void push(int64_t page_key, size_t max_size);
+    };
+
+    void set_tier(FrameInfo &info, Tier tier);
+
+    std::mutex latch_;                  // 互斥锁
+    std::vector<FrameInfo> frames_;     // 每个帧的信息
+    std::list<frame_id_t> t1_;          // T1中可淘汰的帧，首部为最近被释放的帧
+    std::list<frame_id_t> t2_;          // T2中可淘汰的帧，首部为最近被释放的帧
+    size_t t1_count_ = 0;               // T1中的帧数（包括被固定的帧）
+    size_t t2_count_ = 0;               // T2中的帧数（包括被固定的帧）
+    GhostList b1_;
+    GhostList b2_;
+    size_t target_t1_ = 0;              // T1的目标大小，即ARC中的参数p
+    size_t max_size_;                   // 最大容量（与缓冲池的容量相同）
+};
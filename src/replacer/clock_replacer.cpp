@@ -0,0 +1,92 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "clock_replacer.h"
+
+ClockReplacer::ClockReplacer(size_t num_pages) : max_size_(num_pages) {
+    states_ = std::make_unique<std::atomic<uint8_t>[]>(max_size_);
+    for (size_t i = 0; i < max_size_; ++i) {
+        states_[i].store(PINNED, std::memory_order_relaxed);
+    }
+}
+
+ClockReplacer::~ClockReplacer() = default;
+
+/**
+ * @description: 使用CLOCK策略删除一个victim frame，并返回该frame的id。
+ *              时钟指针依次检查各帧，引用位为1的帧清除引用位获得第二次机会，引用位为0的帧被淘汰
+ * @param {frame_id_t*} frame_id 被移除的frame的id，如果没有frame被移除返回nullptr
+ * @return {bool} 如果成功淘汰了一个页面则返回true，否则返回false
+ */
+bool ClockReplacer::victim(frame_id_t *frame_id) {
+    std::scoped_lock lock{hand_latch_};
+    // 每个帧最多被检查两次：第一次清除引用位，第二次淘汰；并发的pin可能让检查落空，因此再多转一圈
+    for (size_t step = 0; step < 3 * max_size_ && size_.load() > 0; ++step) {
+        size_t pos = hand_;
+        hand_ = (hand_ + 1) % max_size_;
+        uint8_t state = states_[pos].load();
+        if (state == REFERENCED) {
+            states_[pos].compare_exchange_strong(state, UNREFERENCED);
+        } else if (state == UNREFERENCED && states_[pos].compare_exchange_strong(state, PINNED)) {
+            size_--;
+            *frame_id = static_cast<frame_id_t>(pos);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @description: 固定指定的frame，即该页面无法被淘汰
+ * @param {frame_id_t} 需要固定的frame的id
+ */
+void ClockReplacer::pin(frame_id_t frame_id) {
+    if (frame_id < 0 || static_cast<size_t>(frame_id) >= max_size_) {
+        return;
+    }
+    if (states_[frame_id].exchange(PINNED) != PINNED) {
+        size_--;
+    }
+}
+
+/**
+ * @description: 取消固定一个frame，代表该页面可以被淘汰，同时设置其引用位
+ * @param {frame_id_t} frame_id 取消固定的frame的id
+ */
+void ClockReplacer::unpin(frame_id_t frame_id) {
+    if (frame_id < 0 || static_cast<size_t>(frame_id) >= max_size_) {
+        return;
+    }
+    if (states_[frame_id].exchange(REFERENCED) == PINNED) {
+        size_++;
+    }
+}
+
+/**
+ * @description: 按淘汰顺序列出可以被淘汰的帧：从时钟指针开始，先是引用位为0的帧，再是引用位为1的帧
+ * @param {vector<frame_id_t>*} frames 可以被淘汰的帧
+ */
+void ClockReplacer::eviction_order(std::vector<frame_id_t> *frames) {
+    std::scoped_lock lock{hand_latch_};
+    frames->clear();
+    for (uint8_t state : {UNREFERENCED, REFERENCED}) {
+        for (size_t step = 0; step < max_size_; ++step) {
+            size_t pos = (hand_ + step) % max_size_;
+            if (states_[pos].load() == state) {
+                frames->push_back(static_cast<frame_id_t>(pos));
+            }
+        }
+    }
+}
+
+/**
+ * @description: 获取当前replacer中可以被淘汰的页面数量
+ */
+size_t ClockReplacer::Size() { return size_.load(); }
@@ -0,0 +1,54 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "common/config.h"
+#include "replacer/replacer.h"
+
+/*
+ClockReplacer实现了CLOCK（二次机会）替换策略
+每个帧对应一个原子状态，pin/unpin只修改该状态，无需加锁；只有victim移动时钟指针时需要加锁
+*/
+class ClockReplacer : public Replacer {
+   public:
+    /**
+     * @description: 创建一个新的ClockReplacer
+     * @param {size_t} num_pages ClockReplacer最多需要存储的page数量，frame id需小于该值
+     */
+    explicit ClockReplacer(size_t num_pages);
+
+    ~ClockReplacer();
+
+    bool victim(frame_id_t *frame_id);
+
+    void pin(frame_id_t frame_id);
+
+    void unpin(frame_id_t frame_id);
+
+    void eviction_order(std::vector<frame_id_t> *frames);
+
+    size_t Size();
+
+   private:
+    /* 帧在时钟中的状态：不可淘汰、可淘汰且引用位为0、可淘汰且引用位为1 */
+    enum FrameState : uint8_t { PINNED = 0, UNREFERENCED, REFERENCED };
+
+    std::unique_ptr<std::atomic<uint8_t>[]> states_;    // 每个帧的状态
+    std::atomic<size_t> size_{0};   // 可以被淘汰的帧的个数
+    std::mutex hand_latch_;         // 保护时钟指针
+    size_t hand_ = 0;               // 时钟指针，指向下一个被检查的帧
+    size_t max_size_;               // 最大容量（与缓冲池的容量相同）
+};
@@ -0,0 +1,108 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "lru_k_replacer.h"
+
+LRUKReplacer::LRUKReplacer(size_t num_pages, size_t k)
+    : history_(num_pages), evictable_(num_pages, false), k_(k == 0 ? 1 : k), max_size_(num_pages) {}
+
+LRUKReplacer::~LRUKReplacer() = default;
+
+/**
+ * @description: 记录一次对帧的访问，只保留最近K次访问的时间戳
+ * @param {frame_id_t} frame_id 被访问的帧
+ */
+void LRUKReplacer::record_access(frame_id_t frame_id) {
+    auto &history = history_[frame_id];
+    history.push_back(current_timestamp_++);
+    if (history.size() > k_) {
+        history.pop_front();
+    }
+}
+
+/**
+ * @description: 使用LRU-K策略删除一个victim frame，并返回该frame的id
+ * @param {frame_id_t*} frame_id 被移除的frame的id，如果没有frame被移除返回nullptr
+ * @return {bool} 如果成功淘汰了一个页面则返回true，否则返回false
+ */
+bool LRUKReplacer::victim(frame_id_t *frame_id) {
+    std::scoped_lock lock{latch_};
+    // 优先淘汰后向K距离为无穷大的帧
+    auto &candidates = young_set_.empty() ? old_set_ : young_set_;
+    if (candidates.empty()) {
+        return false;
+    }
+    *frame_id = candidates.begin()->second;
+    candidates.erase(candidates.begin());
+    // 帧将装入新的页面，清除其访问历史
+    history_[*frame_id].clear();
+    evictable_[*frame_id] = false;
+    return true;
+}
+
+/**
+ * @description: 固定指定的frame，即该页面无法被淘汰，并记录一次访问
+ * @param {frame_id_t} 需要固定的frame的id
+ */
+void LRUKReplacer::pin(frame_id_t frame_id) {
+    if (frame_id < 0 || static_cast<size_t>(frame_id) >= max_size_) {
+        return;
+    }
+    std::scoped_lock lock{latch_};
+    if (evictable_[frame_id]) {
+        auto &candidates = history_[frame_id].size() < k_ ? young_set_ : old_set_;
+        candidates.erase(get_key(frame_id));
+        evictable_[frame_id] = false;
+    }
+    record_access(frame_id);
+}
+
+/**
+ * @description: 取消固定一个frame，代表该页面可以被淘汰
+ * @param {frame_id_t} frame_id 取消固定的frame的id
+ */
+void LRUKReplacer::unpin(frame_id_t frame_id) {
+    if (frame_id < 0 || static_cast<size_t>(frame_id) >= max_size_) {
+        return;
+    }
+    std::scoped_lock lock{latch_};
+    if (evictable_[frame_id]) {
+        return;
+    }
+    // 没有经过pin就直接加入的帧，以加入的时刻作为一次访问
+    if (history_[frame_id].empty()) {
+        record_access(frame_id);
+    }
+    auto &candidates = history_[frame_id].size() < k_ ? young_set_ : old_set_;
+    candidates.insert(get_key(frame_id));
+    evictable_[frame_id] = true;
+}
+
+/**
+ * @description: 按淘汰顺序列出可以被淘汰的帧：先是访问次数不足K次的帧，再是访问次数达到K次的帧，各自按访问时间排列
+ * @param {vector<frame_id_t>*} frames 可以被淘汰的帧
+ */
+void LRUKReplacer::eviction_order(std::vector<frame_id_t> *frames) {
+    std::scoped_lock lock{latch_};
+    frames->clear();
+    for (auto *candidates : {&young_set_, &old_set_}) {
+        for (auto &entry : *candidates) {
+            frames->push_back(entry.second);
+        }
+    }
+}
+
+/**
+ * @description: 获取当前replacer中可以被淘汰的页面数量
+ */
+size_t LRUKReplacer::Size() {
+    std::scoped_lock lock{latch_};
+    return young_set_.size() + old_set_.size();
+}
@@ -0,0 +1,61 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "common/config.h"
+#include "replacer/replacer.h"
+
+/*
+LRUKReplacer实现了LRU-K替换策略
+淘汰后向K距离（当前时刻与倒数第K次访问的时间差）最大的帧；访问次数不足K次的帧后向K距离视为无穷大，
+这些帧之间按最早一次访问的时间先后淘汰。只被顺序扫描访问一次的页面因此会先于热点页面被淘汰
+*/
+class LRUKReplacer : public Replacer {
+   public:
+    /**
+     * @description: 创建一个新的LRUKReplacer
+     * @param {size_t} num_pages LRUKReplacer最多需要存储的page数量，frame id需小于该值
+     * @param {size_t} k 参与计算后向K距离的访问次数
+     */
+    explicit LRUKReplacer(size_t num_pages, size_t k = LRUK_REPLACER_K);
+
+    ~LRUKReplacer();
+
+    bool victim(frame_id_t *frame_id);
+
+    void pin(frame_id_t frame_id);
+
+    void unpin(frame_id_t frame_id);
+
+    void eviction_order(std::vector<frame_id_t> *frames);
+
+    size_t Size();
+
+   private:
+    void record_access(frame_id_t frame_id);
+
+    std::pair<size_t, frame_id_t> get_key(frame_id_t frame_id) { return {history_[frame_id].front(), frame_id}; }
+
+    std::mutex latch_;                          // 互斥锁
+    std::vector<std::deque<size_t>> history_;   // 每个帧最近K次访问的时间戳，首部为最早的一次
+    std::vector<bool> evictable_;               // 帧是否可以被淘汰
+    std::set<std::pair<size_t, frame_id_t>> young_set_;    // 访问次数不足K次的可淘汰帧，按最早访问时间排序
+    std::set<std::pair<size_t, frame_id_t>> old_set_;      // 访问次数达到K次的可淘汰帧，按倒数第K次访问时间排序
+    size_t current_timestamp_ = 0;  // 逻辑时钟，每次访问加一
+    size_t k_;
+    size_t max_size_;   // 最大容量（与缓冲池的容量相同）
+};
@@ -95,6 +95,15 @@ void LRUReplacer::unpin(frame_id_t frame_id) {
     LRUhash_[frame_id] = LRUlist_.begin();
 }
 
+/**
+ * @description: 按淘汰顺序列出可以被淘汰的帧，第一个是下一个被淘汰的帧，最后一个是最近被访问的帧
+ * @param {vector<frame_id_t>*} frames 可以被淘汰的帧
+ */
+void LRUReplacer::eviction_order(std::vector<frame_id_t> *frames) {
+    std::scoped_lock lock{latch_};
+    frames->assign(LRUlist_.rbegin(), LRUlist_.rend());
+}
+
 /**
  * @description: 获取当前replacer中可以被淘汰的页面数量
  */
@@ -37,6 +37,8 @@ class LRUReplacer : public Replacer {
 
     void unpin(frame_id_t frame_id);
 
+    void eviction_order(std::vector<frame_id_t> *frames);
+
     size_t Size();
 
    private:
@@ -10,6 +10,9 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <cstdint>
+#include <vector>
+
 #include "common/config.h"
 
 /**
@@ -39,6 +42,21 @@ class Replacer {
      */
     virtual void unpin(frame_id_t frame_id) = 0;
 
+    /**
+     * Records that a new page has been loaded into a frame. Policies that remember evicted pages (e.g. ARC)
+     * use it to recognize a page coming back; the default implementation ignores it.
+     * @param frame_id the id of the frame the page was loaded into
+     * @param page_key a key identifying the page
+     */
+    virtual void record_load(frame_id_t frame_id, int64_t page_key) {}
+
+    /**
+     * Lists the frames that can be victimized, from the next victim to the most recently used one. The buffer
+     * pool records this order to restore it after a restart; the default implementation lists nothing.
+     * @param[out] frames the frames in eviction order
+     */
+    virtual void eviction_order(std::vector<frame_id_t> *frames) {}
+
     /** @return the number of elements in the replacer that can be victimized */
     virtual size_t Size() = 0;
 };
@@ -8,214 +8,694 @@ EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
 MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
 See the Mulan PSL v2 for more details. */
 
+#include <fcntl.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <stdio.h>
 #include <readline/history.h>
 #include <readline/readline.h>
-#include <setjmp.h>
 #include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/un.h>
 #include <unistd.h>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_set>
+#include <vector>
 
 #include "errors.h"
 #include "optimizer/optimizer.h"
 #include "recovery/log_recovery.h"
+#include "recovery/replication.h"
 #include "optimizer/plan.h"
 #include "optimizer/planner.h"
 #include "portal.h"
 #include "analyze/analyze.h"
+#include "execution/result_cache.h"
+#include "common/metrics.h"
+#include "execution/plan_printer.h"
+#include "system/output_log.h"
+#include "system/server_log.h"
+#include "system/slow_query_log.h"
+#include "storage/temp_storage.h"
 
 #define SOCK_PORT 8765
-#define MAX_CONN_LIMIT 8
 
-static bool should_exit = false;
+static volatile sig_atomic_t should_exit = false;
+
+/**
+ * @description: 读取正整数类型的环境变量，用于在启动时覆盖config.h中的默认配置
+ * @return {size_t} 环境变量的值，未设置或不合法时返回default_value
+ * @param {const char*} name 环境变量名
+ * @param {size_t} default_value 默认值
+ */
+static size_t get_env_size(const char *name, size_t default_value) {
+    const char *value = getenv(name);
+    if (value == nullptr || *value == '\0') {
+        return default_value;
+    }
+    char *end = nullptr;
+    long long result = strtoll(value, &end, 10);
+    if (*end != '\0' || result <= 0) {
+        ServerLog::warn("Ignore invalid ", name, "=", value);
+        return default_value;
+    }
+    return static_cast<size_t>(result);
+}
+
+/**
+ * @description: 读取字符串类型的环境变量，用于在启动时覆盖config.h中的默认配置
+ * @return {string} 环境变量的值，未设置时返回default_value
+ * @param {const char*} name 环境变量名
+ * @param {string&} default_value 默认值
+ */
+static std::string get_env_string(const char *name, const std::string &default_value) {
+    const char *value = getenv(name);
+    if (value == nullptr || *value == '\0') {
+        return default_value;
+    }
+    return value;
+}
 
 // 构建全局所需的管理器对象
 auto disk_manager = std::make_unique<DiskManager>();
-auto buffer_pool_manager = std::make_unique<BufferPoolManager>(BUFFER_POOL_SIZE, disk_manager.get());
+// 缓冲池的帧数、分片数、替换策略和分片分布的NUMA节点数可通过环境变量RMDB_BUFFER_POOL_SIZE、RMDB_BUFFER_POOL_SHARDS、
+// RMDB_REPLACER、RMDB_NUMA_NODES在启动时指定，缓冲池占用的内存为帧数乘以数据库的页面大小
+auto buffer_pool_manager = std::make_unique<BufferPoolManager>(
+    get_env_size("RMDB_BUFFER_POOL_SIZE", BUFFER_POOL_SIZE), disk_manager.get(),
+    get_env_size("RMDB_BUFFER_POOL_SHARDS", BUFFER_POOL_SHARDS), get_env_string("RMDB_REPLACER", REPLACER_TYPE),
+    get_env_size("RMDB_NUMA_NODES", NUMA_NODES));
 auto rm_manager = std::make_unique<RmManager>(disk_manager.get(), buffer_pool_manager.get());
 auto ix_manager = std::make_unique<IxManager>(disk_manager.get(), buffer_pool_manager.get());
 auto sm_manager = std::make_unique<SmManager>(disk_manager.get(), buffer_pool_manager.get(), rm_manager.get(), ix_manager.get());
-auto lock_manager = std::make_unique<LockManager>();
-auto txn_manager = std::make_unique<TransactionManager>(lock_manager.get(), sm_manager.get());
+auto lock_manager = std::make_unique<LockManager>(get_env_string("RMDB_LOCK_WAIT_POLICY", LOCK_WAIT_POLICY));
+// 事务的默认隔离级别可通过环境变量RMDB_ISOLATION_LEVEL指定，REPEATABLE_READ、READ_COMMITTED的事务按快照读取；
+// RMDB_READ_ONLY_SNAPSHOT为0时单条只读语句的事务同样加锁读取；RMDB_CONCURRENCY_MODE为OCC时事务使用乐观并发控制，不加锁
+auto txn_manager = std::make_unique<TransactionManager>(
+    lock_manager.get(), sm_manager.get(), get_env_string("RMDB_ISOLATION_LEVEL", ISOLATION_LEVEL),
+    get_env_size("RMDB_READ_ONLY_SNAPSHOT", READ_ONLY_SNAPSHOT) != 0,
+    get_env_string("RMDB_CONCURRENCY_MODE", CONCURRENCY_MODE) == "OCC" ? ConcurrencyMode::OPTIMISTIC
+                                                                       : ConcurrencyMode::TWO_PHASE_LOCKING);
 auto ql_manager = std::make_unique<QlManager>(sm_manager.get(), txn_manager.get());
 auto log_manager = std::make_unique<LogManager>(disk_manager.get());
-auto recovery = std::make_unique<RecoveryManager>(disk_manager.get(), buffer_pool_manager.get(), sm_manager.get());
+auto recovery = std::make_unique<RecoveryManager>(disk_manager.get(), buffer_pool_manager.get(), sm_manager.get(),
+                                                   log_manager.get(), txn_manager.get());
+// 复制：环境变量RMDB_REPLICATION_PORT不为0时作为主库在该端口上向备库发送日志，
+// RMDB_REPLICA_OF=host:port时作为该主库的只读备库，回放主库的日志并只执行不修改数据的语句
+auto log_shipper = std::make_unique<LogShipper>(disk_manager.get(), log_manager.get());
+auto replica_applier = std::make_unique<ReplicaApplier>(sm_manager.get(), txn_manager.get(), log_manager.get());
+static bool is_primary = false;
+static bool is_replica = false;
 auto planner = std::make_unique<Planner>(sm_manager.get());
 auto optimizer = std::make_unique<Optimizer>(sm_manager.get(), planner.get());
-auto portal = std::make_unique<Portal>(sm_manager.get());
 auto analyze = std::make_unique<Analyze>(sm_manager.get());
-pthread_mutex_t *buffer_mutex;
-pthread_mutex_t *sockfd_mutex;
+auto mat_views = std::make_unique<MatViewManager>(sm_manager.get(), analyze.get(), optimizer.get());
+auto portal = std::make_unique<Portal>(sm_manager.get(), mat_views.get());
+// 只读select语句的结果缓存默认关闭，可通过环境变量RMDB_RESULT_CACHE_SIZE指定缓存的字节数
+auto result_cache = std::make_unique<ResultCache>(sm_manager.get(),
+                                                  get_env_size("RMDB_RESULT_CACHE_SIZE", RESULT_CACHE_SIZE));
+// 每条语句的执行内存上限，启动时可通过环境变量RMDB_QUERY_MEM_LIMIT指定，0表示只受全局内存限制
+static size_t query_mem_limit = EXEC_QUERY_MEM_LIMIT;
+// 用于唤醒epoll_wait的eventfd：收到SIGINT时，以及有连接开始等待不完整的请求时
+static int wakeup_fd = -1;
+static void wake_event_loop() {
+    if (wakeup_fd != -1) {
+        uint64_t one = 1;
+        ssize_t ret = write(wakeup_fd, &one, sizeof(one));
+        (void)ret;
+    }
+}
 
-static jmp_buf jmpbuf;
 void sigint_handler(int signo) {
     should_exit = true;
-    log_manager->flush_log_to_disk();
     std::cout << "The Server receive Crtl+C, will been closed\n";
-    longjmp(jmpbuf, 1);
+    wake_event_loop();
+}
+
+/**
+ * @description: 按复制的角色检查语句能否执行。备库上修改数据或表结构的语句会与回放冲突，
+ *              加锁读取的显式事务会读到正在回放、尚未提交的修改；主库发送日志时vacuum移动记录不写日志，备库无法跟上
+ */
+static void check_replication(const std::shared_ptr<Plan> &plan) {
+    if (is_primary && plan->tag == T_VacuumTable) {
+        throw ReplicationError("vacuum is not allowed while shipping the log to replicas");
+    }
+    if (!is_replica) {
+        return;
+    }
+    std::shared_ptr<Plan> target = plan;
+    if (auto x = std::dynamic_pointer_cast<ExplainPlan>(plan)) {
+        if (!x->analyze_) {
+            return;
+        }
+        target = x->subplan_;
+    }
+    switch (target->tag) {
+        case T_CreateTable:
+        case T_DropTable:
+        case T_CreateIndex:
+        case T_DropIndex:
+        case T_Insert:
+        case T_Update:
+        case T_Delete:
+        case T_LoadData:
+        case T_VacuumTable:
+        case T_CreateMatView:
+        case T_RefreshMatView:
+            throw ReadOnlyReplicaError("statement modifies data");
+        case T_Transaction_begin:
+            if (txn_manager->get_isolation_level() == IsolationLevel::SERIALIZABLE &&
+                txn_manager->get_concurrency_mode() != ConcurrencyMode::OPTIMISTIC) {
+                throw ReadOnlyReplicaError("serializable transactions read with locks, use snapshot isolation");
+            }
+            break;
+        default:
+            break;
+    }
 }
 
-// 判断当前正在执行的是显式事务还是单条SQL语句的事务，并更新事务ID
-void SetTransaction(txn_id_t *txn_id, Context *context) {
-    context->txn_ = txn_manager->get_transaction(*txn_id);
-    if(context->txn_ == nullptr || context->txn_->get_state() == TransactionState::COMMITTED ||
-        context->txn_->get_state() == TransactionState::ABORTED) {
+// 连接上是否有正在执行的显式事务
+static Transaction *GetExplicitTransaction(txn_id_t txn_id) {
+    Transaction *txn = txn_manager->get_transaction(txn_id);
+    if (txn == nullptr || txn->get_state() == TransactionState::COMMITTED ||
+        txn->get_state() == TransactionState::ABORTED) {
+        return nullptr;
+    }
+    return txn;
+}
+
+// 判断当前正在执行的是显式事务还是单条SQL语句的事务，并更新事务ID。
+// 单条只读语句的隐式事务走快速路径，不进入全局事务表，连接上不记录它的事务ID
+void SetTransaction(txn_id_t *txn_id, Context *context, bool read_only) {
+    context->txn_ = GetExplicitTransaction(*txn_id);
+    if (context->txn_ != nullptr) {
+        txn_manager->begin_statement(context->txn_);
+    } else if (read_only && txn_manager->read_only_enabled()) {
+        context->txn_ = txn_manager->begin_read_only();
+    } else {
         context->txn_ = txn_manager->begin(nullptr, context->log_mgr_);
         *txn_id = context->txn_->get_transaction_id();
         context->txn_->set_txn_mode(false);
     }
+    // 乐观并发控制的事务完全不经过锁管理器
+    if (context->txn_->is_optimistic()) {
+        context->lock_mgr_ = nullptr;
+    }
 }
 
-void *client_handler(void *sock_fd) {
-    int fd = *((int *)sock_fd);
-    pthread_mutex_unlock(sockfd_mutex);
 
-    int i_recvBytes;
-    // 接收客户端发送的请求
-    char data_recv[BUFFER_LENGTH];
+// 一个客户端连接的状态。连接上的请求由工作线程逐个处理，EPOLLONESHOT保证同一时刻只有一个工作线程处理同一个连接
+struct Session {
+    int fd;
+    // 记录客户端当前正在执行的事务ID
+    txn_id_t txn_id = INVALID_TXN_ID;
+    // 客户端是否协商了二进制结果格式
+    bool binary_result = false;
     // 需要返回给客户端的结果
-    char *data_send = new char[BUFFER_LENGTH];
+    std::unique_ptr<char[]> data_send{new char[BUFFER_LENGTH]};
     // 需要返回给客户端的结果的长度
     int offset = 0;
-    // 记录客户端当前正在执行的事务ID
-    txn_id_t txn_id = INVALID_TXN_ID;
-
-    std::string output = "establish client connection, sockfd: " + std::to_string(fd) + "\n";
-    std::cout << output;
-
-    while (true) {
-        std::cout << "Waiting for request..." << std::endl;
-        memset(data_recv, 0, BUFFER_LENGTH);
-
-        i_recvBytes = read(fd, data_recv, BUFFER_LENGTH);
+    // 已经收到、还没有收全的请求
+    std::string pending;
+    // 客户端是否发送过以'\0'结尾的请求，这样的客户端可以流水线发送请求，末尾不完整的请求要等后续数据到达
+    bool nul_terminated = false;
+    // 末尾不以'\0'结尾的数据等待后续数据的截止时间，没有在等待时为time_point::max()
+    std::chrono::steady_clock::time_point fragment_deadline = std::chrono::steady_clock::time_point::max();
+    // 等待超时，末尾不完整的数据作为一条完整的请求执行
+    bool fragment_expired = false;
+    // 等待超时过一次的客户端一次发送一条请求，之后不以'\0'结尾的数据不再等待
+    bool legacy = false;
+    // 连接私有的SQL解析器，不同连接的解析和语义分析可以并行
+    SqlParser parser;
+    // 连接中的预编译语句
+    PlanCache plan_cache{sm_manager.get(), analyze.get(), optimizer.get()};
+
+    explicit Session(int fd_) : fd(fd_) {}
+};
+
+/**
+ * @description: 事务需要回滚：把abort信息返回给客户端并写入output.txt文件中，回滚事务并清空连接缓存的事务ID
+ */
+static void abort_transaction(Session *session, Context *context, TransactionAbortException &e) {
+    std::string str = "abort\n";
+    context->send_kind_ = RESULT_FRAME_TEXT;
+    memcpy(session->data_send.get(), str.c_str(), str.length());
+    session->data_send[str.length()] = '\0';
+    session->offset = str.length();
+
+    // 回滚事务
+    txn_manager->abort(context->txn_, log_manager.get());
+    // 重要：abort 内部会销毁事务对象。这里必须清空 context->txn_，避免后续误用悬垂指针。
+    context->txn_ = nullptr;
+    // 同时清空该连接缓存的 txn_id，让下一条语句走 SetTransaction 创建新事务。
+    session->txn_id = INVALID_TXN_ID;
+    ServerLog::debug(e.GetInfo());
+
+    OutputLog::instance().append(str);
+}
 
-        if (i_recvBytes == 0) {
-            std::cout << "Maybe the client has closed" << std::endl;
-            break;
+/* 按执行计划确定语句在运行指标中的类型 */
+static Metrics::StatementType statement_type(const std::shared_ptr<Plan> &plan) {
+    if (auto x = std::dynamic_pointer_cast<DMLPlan>(plan)) {
+        switch (x->tag) {
+            case T_select: return Metrics::SELECT;
+            case T_Insert: return Metrics::INSERT;
+            case T_Update: return Metrics::UPDATE;
+            case T_Delete: return Metrics::DELETE;
+            default: break;
         }
-        if (i_recvBytes == -1) {
-            std::cout << "Client read error!" << std::endl;
-            break;
-        }
-        
-        printf("i_recvBytes: %d \n ", i_recvBytes);
+    } else if (std::dynamic_pointer_cast<DDLPlan>(plan) != nullptr) {
+        return Metrics::DDL;
+    }
+    return Metrics::UTILITY;
+}
 
-        if (strcmp(data_recv, "exit") == 0) {
-            std::cout << "Client exit." << std::endl;
-            break;
-        }
-        if (strcmp(data_recv, "crash") == 0) {
-            std::cout << "Server crash" << std::endl;
-            exit(1);
-        }
+/**
+ * @description: 语句结束时计算它的性能计数并计入运行指标，耗时超过阈值的语句连同执行计划写入慢查询日志
+ * @param {Context*} context 语句的上下文，计数保存在context->stats_中
+ * @param {QueryStats&} start_stats 语句开始时当前线程的计数
+ * @param {BufferPoolStats&} start_pages 语句开始时当前线程获取页面的次数
+ * @param {shared_ptr<Plan>&} plan 语句的执行计划，没有生成计划时为空
+ * @param {bool} served 结果是否来自结果缓存
+ */
+static void finish_query_stats(Context *context, const QueryStats &start_stats, const BufferPoolStats &start_pages,
+                               const std::shared_ptr<Plan> &plan, bool served) {
+    QueryStats &stats = context->stats_;
+    std::copy(std::begin(QueryStats::thread_stats().counters), std::end(QueryStats::thread_stats().counters),
+              stats.counters);
+    stats.subtract(start_stats);
+    // 页面计数由缓冲池的线程计数器给出
+    const BufferPoolStats &pages = BufferPoolManager::thread_stats();
+    uint64_t misses = pages.get(BufferPoolStats::MISSES) - start_pages.get(BufferPoolStats::MISSES);
+    uint64_t hits = pages.get(BufferPoolStats::HITS) - start_pages.get(BufferPoolStats::HITS);
+    stats.counters[QueryStats::PAGES_FETCHED] = hits + misses;
+    stats.counters[QueryStats::PAGES_MISSED] = misses;
+    // 解析或语义分析失败的语句不计入，命中结果缓存的只能是select
+    if (plan != nullptr || served) {
+        Metrics::instance().statement(served ? Metrics::SELECT : statement_type(plan)).record(stats.total_ns());
+    }
+    SlowQueryLog &slow_log = SlowQueryLog::instance();
+    if (slow_log.is_slow(stats.total_ns())) {
+        slow_log.write(context->sql_, stats, plan != nullptr ? PlanPrinter().print(plan) : std::vector<std::string>());
+    }
+}
+
+/**
+ * @description: 执行一条语句，结果留在连接的data_send中，由调用者发送给客户端；单条语句的隐式事务在返回之前提交
+ * @return {std::unique_ptr<Context>} 语句的上下文，用于发送缓冲区中剩余的结果
+ * @param {Session*} session 语句所在的连接
+ * @param {const char*} sql 以'\0'结尾的一条语句
+ */
+static std::unique_ptr<Context> execute_statement(Session *session, const char *sql) {
+    int fd = session->fd;
+    char *data_send = session->data_send.get();
+    int &offset = session->offset;
+
+    // 开启事务，初始化系统所需的上下文信息（包括事务对象指针、锁管理器指针、日志管理器指针、存放结果的buffer、记录结果长度的变量）
+    // Context只在本次请求内使用，请求结束时释放，其中的arena_一并释放本次查询的中间元组
+    // 查询结果超过data_send的长度时分块发送给客户端，最后一块和结束符'\0'在请求结束时发送
+    auto context_holder = std::make_unique<Context>(lock_manager.get(), log_manager.get(), nullptr, data_send, &offset,
+                                                    fd);
+    Context *context = context_holder.get();
+    context->binary_result_ = session->binary_result;
+    context->plan_cache_ = &session->plan_cache;
+    context->sql_ = sql;
+    context->mem_tracker_.set_limit(query_mem_limit);
+    // 各模块累加当前线程的计数器，语句结束时与这里的值相减得到本条语句的计数
+    QueryStats *stats = &context->stats_;
+    QueryStats start_stats = QueryStats::thread_stats();
+    BufferPoolStats start_pages = BufferPoolManager::thread_stats();
+    std::shared_ptr<Plan> plan;
+    // 结果缓存只用于单条语句的隐式事务，命中时不再解析语句、不开启事务；EXECUTE的key包含参数值，在语义分析之后查找
+    bool use_result_cache = result_cache->enabled() && GetExplicitTransaction(session->txn_id) == nullptr;
+    bool served = false;
+    if (use_result_cache) {
+        PhaseTimer timer(stats, QueryStats::EXECUTE);
+        served = result_cache->lookup(ResultCache::text_key(sql, session->binary_result), context);
+    }
+    ResultCapture capture;
 
-        std::cout << "Read from client " << fd << ": " << data_recv << std::endl;
-
-        memset(data_send, '\0', BUFFER_LENGTH);
-        offset = 0;
-
-        // 开启事务，初始化系统所需的上下文信息（包括事务对象指针、锁管理器指针、日志管理器指针、存放结果的buffer、记录结果长度的变量）
-        Context *context = new Context(lock_manager.get(), log_manager.get(), nullptr, data_send, &offset);
-        // Lab 3 need to remove transaction part
-        // Lab 4 need to restart transaction
-        // Lab4 要求：为每个客户端请求绑定一个 Transaction 对象（隐式事务/显式事务都基于它）
-        SetTransaction(&txn_id, context);
-
-        // 用于判断是否已经调用了yy_delete_buffer来删除buf
-        bool finish_analyze = false;
-        pthread_mutex_lock(buffer_mutex);
-        YY_BUFFER_STATE buf = yy_scan_string(data_recv);
-        if (yyparse() == 0) {
-            if (ast::parse_tree != nullptr) {
-                try {
-                    // analyze and rewrite
-                    std::shared_ptr<Query> query = analyze->do_analyze(ast::parse_tree);
-                    yy_delete_buffer(buf);
-                    finish_analyze = true;
-                    pthread_mutex_unlock(buffer_mutex);
+    std::shared_ptr<ast::TreeNode> parse_tree;
+    bool parsed = false;
+    if (!served) {
+        PhaseTimer timer(stats, QueryStats::PARSE);
+        parsed = session->parser.parse(sql, &parse_tree);
+    }
+    if (parsed) {
+        if (parse_tree != nullptr) {
+            // Lab 3 need to remove transaction part
+            // Lab 4 need to restart transaction
+            // Lab4 要求：为每个客户端请求绑定一个 Transaction 对象（隐式事务/显式事务都基于它），
+            // 解析之后才知道语句是否只读
+            SetTransaction(&session->txn_id, context, std::dynamic_pointer_cast<ast::SelectStmt>(parse_tree) != nullptr);
+            try {
+                // analyze and rewrite
+                std::shared_ptr<Query> query;
+                {
+                    PhaseTimer timer(stats, QueryStats::ANALYZE);
+                    query = analyze->do_analyze(parse_tree);
+                }
+                std::string cache_key;
+                if (use_result_cache) {
+                    auto x = std::dynamic_pointer_cast<ast::ExecuteStmt>(parse_tree);
+                    cache_key = x == nullptr ? ResultCache::text_key(sql, session->binary_result)
+                                             : ResultCache::execute_key(session->plan_cache.source(x->name),
+                                                                        query->values, session->binary_result);
+                    served = x != nullptr && result_cache->lookup(cache_key, context);
+                }
+                if (!served) {
                     // 优化器
-                    std::shared_ptr<Plan> plan = optimizer->plan_query(query, context);
+                    {
+                        PhaseTimer timer(stats, QueryStats::PLAN);
+                        plan = optimizer->plan_query(query, context);
+                    }
+                    check_replication(plan);
+                    PhaseTimer timer(stats, QueryStats::EXECUTE);
+                    // 在执行之前读取版本号，执行期间发生的修改会使缓存的结果失效
+                    bool store = use_result_cache && ResultCache::cacheable(plan);
+                    ResultCache::Snapshot snapshot;
+                    if (store) {
+                        snapshot = result_cache->snapshot(plan);
+                        // 快照读的语句读取版本号之后再取快照，之后提交的修改会增加版本号
+                        txn_manager->refresh_snapshot(context->txn_);
+                        context->capture_ = &capture;
+                    }
                     // portal
                     std::shared_ptr<PortalStmt> portalStmt = portal->start(plan, context);
-                    portal->run(portalStmt, ql_manager.get(), &txn_id, context);
+                    portal->run(portalStmt, ql_manager.get(), &session->txn_id, context);
                     portal->drop();
-                } catch (TransactionAbortException &e) {
-                    // 事务需要回滚，需要把abort信息返回给客户端并写入output.txt文件中
-                    std::string str = "abort\n";
-                    memcpy(data_send, str.c_str(), str.length());
-                    data_send[str.length()] = '\0';
-                    offset = str.length();
-
-                    // 回滚事务
-                    txn_manager->abort(context->txn_, log_manager.get());
-                    // 重要：abort 内部会销毁事务对象。这里必须清空 context->txn_，避免后续误用悬垂指针。
-                    context->txn_ = nullptr;
-                    // 同时清空该连接缓存的 txn_id，让下一条语句走 SetTransaction 创建新事务。
-                    txn_id = INVALID_TXN_ID;
-                    std::cout << e.GetInfo() << std::endl;
-
-                    std::fstream outfile;
-                    outfile.open("output.txt", std::ios::out | std::ios::app);
-                    outfile << str;
-                    outfile.close();
-                } catch (RMDBError &e) {
-                    // 遇到异常，需要打印failure到output.txt文件中，并发异常信息返回给客户端
-                    std::cerr << e.what() << std::endl;
-
-                    memcpy(data_send, e.what(), e.get_msg_len());
-                    data_send[e.get_msg_len()] = '\n';
-                    data_send[e.get_msg_len() + 1] = '\0';
-                    offset = e.get_msg_len() + 1;
-
-                    // 将报错信息写入output.txt
-                    std::fstream outfile;
-                    outfile.open("output.txt",std::ios::out | std::ios::app);
-                    outfile << "failure\n";
-                    outfile.close();
+                    // 客户端中途断开时结果不完整，不能缓存
+                    if (store) {
+                        context->finish_capture();
+                        if (context->client_fd_ >= 0) {
+                            result_cache->insert(cache_key, std::move(snapshot), std::move(capture));
+                        }
+                    }
                 }
+            } catch (TransactionAbortException &e) {
+                abort_transaction(session, context, e);
+            } catch (RMDBError &e) {
+                // 遇到异常，需要打印failure到output.txt文件中，并发异常信息返回给客户端
+                ServerLog::debug(e.what());
+
+                context->send_kind_ = RESULT_FRAME_TEXT;
+                memcpy(data_send, e.what(), e.get_msg_len());
+                data_send[e.get_msg_len()] = '\n';
+                data_send[e.get_msg_len() + 1] = '\0';
+                offset = e.get_msg_len() + 1;
+
+                // 将报错信息写入output.txt
+                OutputLog::instance().append("failure\n");
             }
         }
-        if(finish_analyze == false) {
-            yy_delete_buffer(buf);
-            pthread_mutex_unlock(buffer_mutex);
-        }
-        // future TODO: 格式化 sql_handler.result, 传给客户端
-        // send result with fixed format, use protobuf in the future
-        if (write(fd, data_send, offset + 1) == -1) {
-            break;
-        }
-        // 如果是单条语句，需要按照一个完整的事务来执行，所以执行完当前语句后，自动提交事务
-        // 关键语义：
-        // - 显式事务（begin; ... commit/abort;）：txn_mode_ == true，由用户手动结束，不在这里自动提交。
-        // - 隐式事务（单条 SQL）：txn_mode_ == false，执行完一句就 commit，避免脏数据留在未提交状态。
-        if (context->txn_ != nullptr && context->txn_->get_txn_mode() == false) {
+    }
+    context->capture_ = nullptr;
+    // 如果是单条语句，需要按照一个完整的事务来执行，所以执行完当前语句后，自动提交事务
+    // 关键语义：
+    // - 显式事务（begin; ... commit/abort;）：txn_mode_ == true，由用户手动结束，不在这里自动提交。
+    // - 隐式事务（单条 SQL）：txn_mode_ == false，执行完一句就 commit，避免脏数据留在未提交状态。
+    // - 乐观并发控制的事务可能在提交时验证失败，此时回滚事务并返回abort
+    if (context->txn_ != nullptr && context->txn_->get_txn_mode() == false) {
+        PhaseTimer timer(stats, QueryStats::EXECUTE);
+        try {
+            // 提交之前把本条语句对基表的修改同步到IMMEDIATE物化视图
+            mat_views->maintain(context);
             txn_manager->commit(context->txn_, context->log_mgr_);
             // commit 会销毁事务对象，清空悬垂指针并重置 txn_id
             context->txn_ = nullptr;
-            txn_id = INVALID_TXN_ID;
+            session->txn_id = INVALID_TXN_ID;
+        } catch (TransactionAbortException &e) {
+            abort_transaction(session, context, e);
         }
     }
+    finish_query_stats(context, start_stats, start_pages, plan, served);
+    return context_holder;
+}
+
+/**
+ * @description: 执行一条请求并把结果返回给客户端
+ * @return {bool} 是否保留连接，客户端退出或发送失败时返回false
+ * @param {Session*} session 请求所在的连接
+ * @param {const char*} data_recv 以'\0'结尾的请求
+ */
+static bool handle_request(Session *session, const char *data_recv) {
+    int fd = session->fd;
+    if (strcmp(data_recv, "exit") == 0) {
+        ServerLog::debug("Client ", fd, " exit");
+        return false;
+    }
+    if (strcmp(data_recv, "crash") == 0) {
+        ServerLog::info("Server crash");
+        // 崩溃之前已经返回给客户端的结果需要留在output.txt中
+        OutputLog::instance().flush();
+        exit(1);
+    }
+    if (strcmp(data_recv, RESULT_BINARY_REQUEST) == 0) {
+        // 客户端协商二进制结果格式，应答本身仍使用以'\0'结尾的文本格式，之后的响应按帧发送
+        session->binary_result = true;
+        return write(fd, RESULT_BINARY_ACK, strlen(RESULT_BINARY_ACK) + 1) != -1;
+    }
 
-    // Clear
-    std::cout << "Terminating current client_connection..." << std::endl;
-    close(fd);           // close a file descriptor.
-    pthread_exit(NULL);  // terminate calling thread!
+    ServerLog::debug("Read from client ", fd, ": ", data_recv);
+
+    char *data_send = session->data_send.get();
+    memset(data_send, '\0', BUFFER_LENGTH);
+    session->offset = 0;
+
+    // 一个请求中可以有多条以';'分隔的语句，按顺序逐条执行，每条语句与单独发送时一样拥有自己的上下文和隐式事务，
+    // 所有语句的结果连接成一个响应返回
+    std::vector<std::string> stmts;
+    session->parser.split(data_recv, &stmts);
+    if (stmts.size() <= 1) {
+        return execute_statement(session, data_recv)->finish_send();
+    }
+    std::unique_ptr<Context> context;
+    for (auto &stmt : stmts) {
+        // 每条语句的结果从缓冲区开头写起，前一条语句的结果先发送出去
+        if (context != nullptr && session->offset > 0) {
+            if (!context->flush_send()) {
+                return false;
+            }
+            memset(data_send, '\0', BUFFER_LENGTH);
+        }
+        context = execute_statement(session, stmt.c_str());
+    }
+    return context->finish_send();
 }
 
-void start_server() {
-    // init mutex
-    buffer_mutex = (pthread_mutex_t *)malloc(sizeof(pthread_mutex_t));
-    sockfd_mutex = (pthread_mutex_t *)malloc(sizeof(pthread_mutex_t));
-    pthread_mutex_init(buffer_mutex, nullptr);
-    pthread_mutex_init(sockfd_mutex, nullptr);
-
-    int sockfd_server;
-    int fd_temp;
+/**
+ * @description: 读取连接上已经到达的数据，执行其中所有完整的请求。末尾不完整的数据需要等待后续数据时
+ *              设置fragment_deadline，由事件循环在截止时间之前没有数据到达时再次提交这个连接
+ * @return {bool} 是否保留连接
+ * @param {Session*} session 可读的连接，或者等待后续数据超时的连接
+ */
+static bool serve_session(Session *session) {
+    bool more = false;
+    if (!session->fragment_expired) {
+        char data_recv[BUFFER_LENGTH];
+        ssize_t i_recvBytes = read(session->fd, data_recv, BUFFER_LENGTH);
+        if (i_recvBytes == 0) {
+            ServerLog::debug("Client ", session->fd, " closed the connection");
+            return false;
+        }
+        if (i_recvBytes == -1) {
+            if (errno == EINTR || errno == EAGAIN) return true;
+            ServerLog::warn("Read error on client ", session->fd, ": ", strerror(errno));
+            return false;
+        }
+        ServerLog::debug("Received ", i_recvBytes, " bytes from client ", session->fd);
+
+        // 请求以'\0'结尾，客户端可以不等响应连续发送多个请求，响应按请求的顺序返回；
+        // 从未发送过'\0'的客户端一次发送一条请求，末尾不以'\0'结尾的数据在一段时间内没有后续数据到达时仍作为一条完整的请求
+        session->pending.append(data_recv, i_recvBytes);
+        if (memchr(data_recv, '\0', i_recvBytes) != nullptr) {
+            session->nul_terminated = true;
+        }
+        more = i_recvBytes == BUFFER_LENGTH || session->nul_terminated;
+    } else {
+        session->legacy = true;
+    }
+    size_t start = 0;
+    while (start < session->pending.size()) {
+        size_t end = session->pending.find('\0', start);
+        if (end == std::string::npos) {
+            if (more) break;
+            // 较大的第一个请求可能分多次到达，不占用工作线程，重新注册到epoll中等待后续数据
+            if (!session->legacy) {
+                session->fragment_deadline =
+                    std::chrono::steady_clock::now() + std::chrono::milliseconds(SERVER_FRAGMENT_WAIT_MS);
+                break;
+            }
+            end = session->pending.size();
+        }
+        std::string request = session->pending.substr(start, end - start);
+        start = end + 1;
+        if (request.empty()) continue;
+        if (!handle_request(session, request.c_str())) return false;
+    }
+    session->pending.erase(0, std::min(start, session->pending.size()));
+    session->fragment_expired = false;
+    return true;
+}
+
+/**
+ * @brief 处理客户端请求的固定大小的线程池，连接数与线程数无关；
+ * 事件循环把可读的连接交给线程池，处理完已经到达的请求后重新注册到epoll中。
+ * 等待不完整请求的后续数据的连接同样注册到epoll中并登记截止时间，事件循环按最早的截止时间设置epoll_wait的超时，
+ * 到期时取消注册并把连接交给线程池，把已经收到的数据作为一条完整的请求执行
+ */
+class SessionPool {
+   public:
+    SessionPool(size_t num_threads, int epoll_fd) : epoll_fd_(epoll_fd) {
+        for (size_t i = 0; i < num_threads; i++) {
+            threads_.emplace_back(&SessionPool::run, this);
+        }
+    }
+
+    ~SessionPool() {
+        {
+            std::lock_guard<std::mutex> lock(latch_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto &thread : threads_) {
+            thread.join();
+        }
+        for (auto *session : sessions_) {
+            close(session->fd);
+            delete session;
+        }
+    }
+
+    void add(int fd) {
+        auto *session = new Session(fd);
+        {
+            std::lock_guard<std::mutex> lock(latch_);
+            sessions_.insert(session);
+        }
+        ServerLog::debug("Establish client connection, sockfd: ", fd);
+        arm(session, EPOLL_CTL_ADD);
+    }
+
+    /* 连接上有数据到达，等待后续数据的连接不再等待 */
+    void submit(Session *session) {
+        {
+            std::lock_guard<std::mutex> lock(latch_);
+            cancel_deadline(session);
+            ready_.push_back(session);
+        }
+        cv_.notify_one();
+    }
+
+    /* 距离最早的截止时间的毫秒数，作为epoll_wait的超时；没有连接在等待时为-1 */
+    int next_timeout_ms() {
+        std::lock_guard<std::mutex> lock(latch_);
+        if (deadlines_.empty()) return -1;
+        auto wait = deadlines_.begin()->first - std::chrono::steady_clock::now();
+        auto ms = std::chrono::ceil<std::chrono::milliseconds>(wait).count();
+        return static_cast<int>(std::max<decltype(ms)>(ms, 0));
+    }
+
+    /* 把已经到截止时间的连接交给线程池，取消它们在epoll中的注册，保证同一时刻只有一个工作线程处理同一个连接 */
+    void expire_deadlines() {
+        size_t num_expired = 0;
+        {
+            std::lock_guard<std::mutex> lock(latch_);
+            auto now = std::chrono::steady_clock::now();
+            while (!deadlines_.empty() && deadlines_.begin()->first <= now) {
+                Session *session = deadlines_.begin()->second;
+                deadlines_.erase(deadlines_.begin());
+                struct epoll_event event {};
+                epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, session->fd, &event);
+                session->fragment_deadline = std::chrono::steady_clock::time_point::max();
+                session->fragment_expired = true;
+                ready_.push_back(session);
+                num_expired++;
+            }
+        }
+        for (size_t i = 0; i < num_expired; i++) {
+            cv_.notify_one();
+        }
+    }
+
+   private:
+    void arm(Session *session, int op) {
+        struct epoll_event event {};
+        event.events = EPOLLIN | EPOLLONESHOT;
+        event.data.ptr = session;
+        epoll_ctl(epoll_fd_, op, session->fd, &event);
+    }
+
+    /* 调用时需持有latch_ */
+    void cancel_deadline(Session *session) {
+        if (session->fragment_deadline == std::chrono::steady_clock::time_point::max()) return;
+        deadlines_.erase({session->fragment_deadline, session});
+        session->fragment_deadline = std::chrono::steady_clock::time_point::max();
+    }
+
+    void run() {
+        for (;;) {
+            Session *session;
+            {
+                std::unique_lock<std::mutex> lock(latch_);
+                cv_.wait(lock, [&]() { return stop_ || !ready_.empty(); });
+                if (stop_) return;
+                session = ready_.front();
+                ready_.pop_front();
+            }
+            if (serve_session(session)) {
+                ServerLog::debug("Waiting for request on client ", session->fd);
+                if (session->fragment_deadline == std::chrono::steady_clock::time_point::max()) {
+                    arm(session, EPOLL_CTL_MOD);
+                    continue;
+                }
+                // 在latch_内登记截止时间并注册：数据到达时submit能找到并取消它，到期时expire_deadlines取消的是这次注册
+                {
+                    std::lock_guard<std::mutex> lock(latch_);
+                    deadlines_.emplace(session->fragment_deadline, session);
+                    arm(session, EPOLL_CTL_MOD);
+                }
+                // 事件循环可能正阻塞在更长的超时上
+                wake_event_loop();
+                continue;
+            }
+            ServerLog::debug("Terminating client connection ", session->fd);
+            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, session->fd, nullptr);
+            {
+                std::lock_guard<std::mutex> lock(latch_);
+                sessions_.erase(session);
+            }
+            close(session->fd);
+            delete session;
+        }
+    }
+
+    int epoll_fd_;
+    std::vector<std::thread> threads_;
+    std::mutex latch_;
+    std::condition_variable cv_;
+    std::deque<Session *> ready_;               // 有数据到达或者等待超时、等待处理的连接
+    std::set<std::pair<std::chrono::steady_clock::time_point, Session *>> deadlines_;  // 等待后续数据的连接，按截止时间排序
+    std::unordered_set<Session *> sessions_;    // 所有打开的连接，关闭服务端时释放
+    bool stop_ = false;
+};
+
+/**
+ * @description: 在SOCK_PORT上监听TCP连接，失败时退出进程
+ * @return {int} 非阻塞的监听socket
+ */
+static int listen_tcp() {
     struct sockaddr_in s_addr_in {};
 
     // 初始化连接
-    sockfd_server = socket(AF_INET, SOCK_STREAM, 0);  // ipv4,TCP
+    int sockfd_server = socket(AF_INET, SOCK_STREAM, 0);  // ipv4,TCP
     assert(sockfd_server != -1);
     int val = 1;
     setsockopt(sockfd_server, SOL_SOCKET, SO_REUSEADDR, &val, sizeof(val));
@@ -225,53 +705,168 @@ void start_server() {
     s_addr_in.sin_family = AF_INET;
     s_addr_in.sin_addr.s_addr = htonl(INADDR_ANY);
     s_addr_in.sin_port = htons(SOCK_PORT);
-    fd_temp = bind(sockfd_server, (struct sockaddr *)(&s_addr_in), sizeof(s_addr_in));
+    int fd_temp = bind(sockfd_server, (struct sockaddr *)(&s_addr_in), sizeof(s_addr_in));
     if (fd_temp == -1) {
-        std::cout << "Bind error!" << std::endl;
+        ServerLog::error("Bind error: ", strerror(errno));
         exit(1);
     }
 
-    fd_temp = listen(sockfd_server, MAX_CONN_LIMIT);
+    fd_temp = listen(sockfd_server, SERVER_LISTEN_BACKLOG);
     if (fd_temp == -1) {
-        std::cout << "Listen error!" << std::endl;
+        ServerLog::error("Listen error: ", strerror(errno));
         exit(1);
     }
+    // 监听socket为非阻塞的，每次事件到达时接受所有排队的连接；客户端socket保持阻塞，发送结果时由TCP流量控制限速
+    fcntl(sockfd_server, F_SETFL, fcntl(sockfd_server, F_GETFL) | O_NONBLOCK);
+    return sockfd_server;
+}
 
-    while (!should_exit) {
-        std::cout << "Waiting for new connection..." << std::endl;
-        pthread_t thread_id;
-        struct sockaddr_in s_addr_client {};
-        int client_length = sizeof(s_addr_client);
+/**
+ * @description: 在path上监听Unix domain socket连接，同一台机器上的客户端（rucbase_client -s path）不经过TCP协议栈。
+ *              TCP端口已经绑定成功，说明没有其它服务端在运行，path上残留的文件是上次异常退出留下的，先删除。
+ *              失败时只输出警告，服务端仍然通过TCP服务
+ * @return {int} 非阻塞的监听socket，失败时返回-1
+ * @param {string&} path socket文件的路径
+ */
+static int listen_unix(const std::string &path) {
+    struct sockaddr_un s_addr_un {};
+    if (path.size() >= sizeof(s_addr_un.sun_path)) {
+        ServerLog::warn("Unix socket path too long: ", path);
+        return -1;
+    }
+    int sockfd_server = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sockfd_server == -1) {
+        ServerLog::warn("Unix socket error: ", strerror(errno));
+        return -1;
+    }
+    s_addr_un.sun_family = AF_UNIX;
+    memcpy(s_addr_un.sun_path, path.c_str(), path.size() + 1);
+    unlink(path.c_str());
+    if (bind(sockfd_server, (struct sockaddr *)(&s_addr_un), sizeof(s_addr_un)) == -1 ||
+        listen(sockfd_server, SERVER_LISTEN_BACKLOG) == -1) {
+        ServerLog::warn("Listen on unix socket ", path, " error: ", strerror(errno));
+        close(sockfd_server);
+        return -1;
+    }
+    fcntl(sockfd_server, F_SETFL, fcntl(sockfd_server, F_GETFL) | O_NONBLOCK);
+    ServerLog::info("Listening on unix socket ", path);
+    return sockfd_server;
+}
 
-        if (setjmp(jmpbuf)) {
-            std::cout << "Break from Server Listen Loop\n";
+void start_server() {
+    int sockfd_server = listen_tcp();
+    // Unix domain socket的路径可通过环境变量RMDB_UNIX_SOCKET指定，OFF表示只监听TCP
+    std::string unix_path = get_env_string("RMDB_UNIX_SOCKET", SERVER_UNIX_SOCKET);
+    int sockfd_unix = unix_path == "OFF" ? -1 : listen_unix(unix_path);
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wakeup_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    assert(epoll_fd != -1 && wakeup_fd != -1);
+    struct epoll_event listen_event {};
+    listen_event.events = EPOLLIN;
+    listen_event.data.ptr = &sockfd_server;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sockfd_server, &listen_event);
+    if (sockfd_unix != -1) {
+        struct epoll_event unix_event {};
+        unix_event.events = EPOLLIN;
+        unix_event.data.ptr = &sockfd_unix;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sockfd_unix, &unix_event);
+    }
+    struct epoll_event wakeup_event {};
+    wakeup_event.events = EPOLLIN;
+    wakeup_event.data.ptr = &wakeup_fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wakeup_fd, &wakeup_event);
+
+    // 工作线程屏蔽SIGINT，由事件循环所在的线程处理
+    sigset_t sigint_set, old_set;
+    sigemptyset(&sigint_set);
+    sigaddset(&sigint_set, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &sigint_set, &old_set);
+    auto pool = std::make_unique<SessionPool>(SERVER_WORKER_THREADS, epoll_fd);
+    pthread_sigmask(SIG_SETMASK, &old_set, nullptr);
+
+    ServerLog::info("Waiting for new connection...");
+    struct epoll_event events[SERVER_EPOLL_EVENTS];
+    while (!should_exit) {
+        int num_events = epoll_wait(epoll_fd, events, SERVER_EPOLL_EVENTS, pool->next_timeout_ms());
+        if (num_events == -1) {
+            if (errno == EINTR) continue;
+            ServerLog::error("Epoll error: ", strerror(errno));
             break;
         }
-
-        // Block here. Until server accepts a new connection.
-        pthread_mutex_lock(sockfd_mutex);
-        int sockfd = accept(sockfd_server, (struct sockaddr *)(&s_addr_client), (socklen_t *)(&client_length));
-        if (sockfd == -1) {
-            std::cout << "Accept error!" << std::endl;
-            continue;  // ignore current socket ,continue while loop.
-        }
-        
-        // 和客户端建立连接，并开启一个线程负责处理客户端请求
-        if (pthread_create(&thread_id, nullptr, &client_handler, (void *)(&sockfd)) != 0) {
-            std::cout << "Create thread fail!" << std::endl;
-            break;  // break while loop
+        for (int i = 0; i < num_events; i++) {
+            if (events[i].data.ptr == &wakeup_fd) {
+                uint64_t count;
+                ssize_t ret = read(wakeup_fd, &count, sizeof(count));
+                (void)ret;
+                continue;
+            }
+            if (events[i].data.ptr != &sockfd_server && events[i].data.ptr != &sockfd_unix) {
+                // 连接上有请求到达，交给工作线程处理
+                pool->submit(static_cast<Session *>(events[i].data.ptr));
+                continue;
+            }
+            // 两种连接接受之后的处理完全相同，由同一个连接池服务
+            bool is_tcp = events[i].data.ptr == &sockfd_server;
+            int listen_fd = is_tcp ? sockfd_server : sockfd_unix;
+            while (true) {
+                int sockfd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+                if (sockfd == -1) {
+                    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                        ServerLog::warn("Accept error: ", strerror(errno));
+                    }
+                    break;
+                }
+                // 流式返回的结果分多次写出，关闭Nagle算法，避免最后一块结果等待客户端的延迟确认
+                if (is_tcp) {
+                    int nodelay = 1;
+                    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+                }
+                pool->add(sockfd);
+            }
         }
-
+        // 先处理本轮的事件：截止时间之前到达的数据已经取消了等待
+        pool->expire_deadlines();
     }
+    ServerLog::info("Break from Server Listen Loop");
+    pool.reset();
+    close(epoll_fd);
+    int closing_fd = wakeup_fd;
+    wakeup_fd = -1;
+    close(closing_fd);
 
     // Clear
-    std::cout << " Try to close all client-connection.\n";
+    ServerLog::info("Try to close all client-connection.");
     int ret = shutdown(sockfd_server, SHUT_WR);  // shut down the all or part of a full-duplex connection.
-    if(ret == -1) { printf("%s\n", strerror(errno)); }
+    if(ret == -1) { ServerLog::warn("Shutdown error: ", strerror(errno)); }
+    if (sockfd_unix != -1) {
+        close(sockfd_unix);
+        unlink(unix_path.c_str());
+    }
 //    assert(ret != -1);
+    // 关闭数据库前停止后台刷脏线程，避免其写回已关闭的文件
+    buffer_pool_manager->stop_page_cleaner();
+    // 写完output.txt中排队的结果，close_db会离开数据库目录
+    OutputLog::instance().stop();
+    SlowQueryLog::instance().stop();
+    // 先断开复制，回放线程不再修改数据；主库的检查点照常保留备库还需要的日志
+    log_shipper->stop();
+    replica_applier->stop();
+    // 停止检查点线程，写回全部页面并做最后一次检查点，下次启动时故障恢复只需要扫描这个检查点
+    recovery->stop_checkpointer();
+    recovery->checkpoint(true);
+    // 记录缓冲池中的页面，下次启动时预热
+    try {
+        sm_manager->dump_buffer_pool();
+    } catch (RMDBError &e) {
+        ServerLog::warn("Failed to dump buffer pool: ", e.what());
+    }
+    // 停止刷日志线程，缓冲区中剩余的日志在线程退出前写入磁盘，之后关闭数据库写回的页面不再需要等待日志
+    log_manager->stop_flusher();
     sm_manager->close_db();
-    std::cout << " DB has been closed.\n";
-    std::cout << "Server shuts down." << std::endl;
+    ServerLog::info("DB has been closed.");
+    ServerLog::info("Server shuts down.");
+    ServerLog::instance().stop();
 }
 
 int main(int argc, char **argv) {
@@ -294,24 +889,100 @@ int main(int argc, char **argv) {
                      "Welcome to RMDB!\n"
                      "Type 'help;' for help.\n"
                      "\n";
+        // 启动运行日志的后台写线程，日志级别可通过环境变量RMDB_LOG_LEVEL指定，DEBUG级别输出每个请求的收发
+        std::string log_level_name = get_env_string("RMDB_LOG_LEVEL", SERVER_LOG_LEVEL);
+        LogLevel log_level = LogLevel::INFO;
+        if (!ServerLog::parse_level(log_level_name, &log_level)) {
+            ServerLog::warn("Ignore invalid RMDB_LOG_LEVEL=", log_level_name);
+        }
+        ServerLog::instance().start(log_level);
+        // 全局内存限制和每条语句的内存上限（字节）可通过环境变量RMDB_MEMORY_LIMIT、RMDB_QUERY_MEM_LIMIT指定，
+        // 排序、哈希连接和哈希聚合超过限制时溢出到磁盘，无法溢出时语句失败
+        MemoryTracker::global().set_limit(get_env_size("RMDB_MEMORY_LIMIT", MEMORY_LIMIT));
+        query_mem_limit = get_env_size("RMDB_QUERY_MEM_LIMIT", EXEC_QUERY_MEM_LIMIT);
+        // 数据文件是否以O_DIRECT模式打开可通过环境变量RMDB_DIRECT_IO指定，需在打开数据库之前设置
+        disk_manager->set_direct_io(get_env_size("RMDB_DIRECT_IO", ENABLE_DIRECT_IO) != 0);
+
         // Database name is passed by args
         std::string db_name = argv[1];
         if (!sm_manager->is_dir(db_name)) {
-            // Database not found, create a new one
-            sm_manager->create_db(db_name);
+            // Database not found, create a new one. 新数据库的页面大小可通过环境变量RMDB_PAGE_SIZE指定，已有的数据库使用创建时的页面大小
+            sm_manager->create_db(db_name, get_env_size("RMDB_PAGE_SIZE", PAGE_SIZE));
         }
         // Open database
         sm_manager->open_db(db_name);
 
-        // recovery database
-        recovery->analyze();
-        recovery->redo();
-        recovery->undo();
+        // 缓冲池写回数据页之前先持久化对应的日志（WAL），故障恢复回滚时写回的页面同样需要先持久化CLR
+        buffer_pool_manager->set_log_flusher([](lsn_t lsn) { log_manager->flush_to(lsn); });
+
+        // recovery database，重做的线程数可通过环境变量RMDB_REDO_THREADS指定。
+        // 各阶段的耗时由show metrics输出并写入运行日志，用于评估检查点间隔等配置对恢复时间的影响
+        auto recovery_phase = [](Metrics::Gauge gauge, const std::function<void()> &phase) {
+            auto start = std::chrono::steady_clock::now();
+            phase();
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            Metrics::instance().set(gauge, std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+        };
+        recovery_phase(Metrics::RECOVERY_ANALYZE_US, [] { recovery->analyze(); });
+        // 复制的数据库第一次作为备库启动时，从主库日志的末尾（故障恢复写入日志之前）开始接收
+        lsn_t replica_seed_lsn = log_manager->get_next_lsn();
+        recovery_phase(Metrics::RECOVERY_REDO_US,
+                       [] { recovery->redo(get_env_size("RMDB_REDO_THREADS", REDO_THREADS)); });
+        recovery_phase(Metrics::RECOVERY_UNDO_US, [] { recovery->undo(); });
+        Metrics &metrics = Metrics::instance();
+        ServerLog::info("Recovery finished: analyze ", metrics.get(Metrics::RECOVERY_ANALYZE_US) / 1000, " ms, redo ",
+                        metrics.get(Metrics::RECOVERY_REDO_US) / 1000, " ms, undo ",
+                        metrics.get(Metrics::RECOVERY_UNDO_US) / 1000, " ms");
+        // 在后台按上次关闭或检查点时记录的页面预热缓冲池，可通过环境变量RMDB_POOL_WARM_UP=0关闭
+        if (get_env_size("RMDB_POOL_WARM_UP", POOL_WARM_UP) != 0) {
+            try {
+                sm_manager->restore_buffer_pool();
+            } catch (RMDBError &e) {
+                ServerLog::warn("Failed to warm up buffer pool: ", e.what());
+            }
+        }
+
+        // 启动后台刷日志线程，提交的事务通过组提交持久化日志。
+        // 刷日志线程在第一个提交到达之后再等待的微秒数可通过环境变量RMDB_LOG_GROUP_COMMIT_TIMEOUT_US指定
+        log_manager->start_flusher(get_env_size("RMDB_LOG_GROUP_COMMIT_TIMEOUT_US", LOG_GROUP_COMMIT_TIMEOUT_US));
+        // 启动后台检查点线程，检查点的间隔毫秒数可通过环境变量RMDB_CHECKPOINT_INTERVAL_MS指定
+        recovery->start_checkpointer(get_env_size("RMDB_CHECKPOINT_INTERVAL_MS", CHECKPOINT_INTERVAL_MS));
+
+        // 启动复制，两者都设置时只作为备库：备库上的日志与主库不同，不能再发给下一级备库
+        std::string replica_of = get_env_string("RMDB_REPLICA_OF", REPLICA_OF);
+        int replication_port = static_cast<int>(get_env_size("RMDB_REPLICATION_PORT", REPLICATION_PORT));
+        if (replica_of != "OFF") {
+            if (!txn_manager->read_only_enabled()) {
+                throw ReplicationError("a replica serves snapshot reads, RMDB_READ_ONLY_SNAPSHOT must not be 0");
+            }
+            if (replication_port != 0) {
+                ServerLog::warn("Ignore RMDB_REPLICATION_PORT on a replica, replicas cannot be chained");
+            }
+            replica_applier->start(replica_of, replica_seed_lsn);
+            is_replica = true;
+        } else if (replication_port != 0) {
+            log_shipper->start(replication_port);
+            is_primary = true;
+        }
+
+        // 启动output.txt的后台写线程，文件位于数据库目录下
+        OutputLog::instance().start("output.txt");
+        // 打开慢查询日志，记录的耗时阈值（毫秒）可通过环境变量RMDB_SLOW_QUERY_MS指定，0表示不记录
+        SlowQueryLog::instance().start(SLOW_QUERY_LOG_NAME, get_env_size("RMDB_SLOW_QUERY_MS", SLOW_QUERY_THRESHOLD_MS));
+
+        // 启动后台刷脏线程，保持缓冲池中一定比例的帧是干净的；异步读写后端可通过环境变量RMDB_IO_BACKEND指定
+        disk_manager->set_io_backend(get_env_string("RMDB_IO_BACKEND", IO_BACKEND));
+        // 算子溢出和外部排序的临时文件与数据文件使用相同的后端，所在目录可通过环境变量RMDB_TEMP_DIR指定
+        TempStorage::instance().set_io_backend(disk_manager->get_io_backend());
+        TempStorage::instance().set_dir(get_env_string("RMDB_TEMP_DIR", TEMP_DIR));
+        buffer_pool_manager->start_page_cleaner(
+            get_env_size("RMDB_PAGE_CLEANER_CLEAN_PERCENT", PAGE_CLEANER_CLEAN_PERCENT));
         
         // 开启服务端，开始接受客户端连接
         start_server();
     } catch (RMDBError &e) {
-        std::cerr << e.what() << std::endl;
+        ServerLog::error(e.what());
+        ServerLog::instance().stop();
         exit(1);
     }
     return 0;
@@ -0,0 +1,219 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "storage/async_io.h"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "errors.h"
+
+/**
+ * @description: 创建异步读写对象。backend为"io_uring"时尝试使用io_uring，内核不支持时退回同步实现
+ * @return {unique_ptr<AsyncIo>} 新创建的异步读写对象
+ * @param {string&} backend 后端名称，可选"io_uring"、"sync"
+ * @param {unsigned} queue_depth 同时进行的读写请求的最大个数
+ */
+std::unique_ptr<AsyncIo> AsyncIo::create(const std::string &backend, unsigned queue_depth) {
+    if (backend == "io_uring") {
+        try {
+            return std::make_unique<IoUring>(queue_depth);
+        } catch (UnixError &) {
+        }
+    }
+    return std::make_unique<SyncIo>();
+}
+
+void SyncIo::prep_read(int fd, char *buf, size_t len, off_t offset, uint64_t tag) {
+    requests_.push_back({false, fd, buf, len, offset, tag});
+}
+
+void SyncIo::prep_write(int fd, const char *buf, size_t len, off_t offset, uint64_t tag) {
+    requests_.push_back({true, fd, const_cast<char *>(buf), len, offset, tag});
+}
+
+void SyncIo::submit() {
+    for (auto &request : requests_) {
+        ssize_t ret = request.is_write ? pwrite(request.fd, request.buf, request.len, request.offset)
+                                       : pread(request.fd, request.buf, request.len, request.offset);
+        completions_.push_back({request.tag, ret < 0 ? -errno : static_cast<int>(ret)});
+    }
+    requests_.clear();
+}
+
+size_t SyncIo::wait(std::vector<IoCompletion> *completions, size_t min_complete) {
+    if (completions_.size() < min_complete) {
+        submit();
+    }
+    size_t count = completions_.size();
+    completions->insert(completions->end(), completions_.begin(), completions_.end());
+    completions_.clear();
+    return count;
+}
+
+IoUring::IoUring(unsigned queue_depth) : queue_depth_(queue_depth) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring_fd_ = static_cast<int>(syscall(__NR_io_uring_setup, queue_depth, &params));
+    if (ring_fd_ < 0) {
+        throw UnixError();
+    }
+    queue_depth_ = params.sq_entries;
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+    sq_ptr_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                   IORING_OFF_SQ_RING);
+    if (sq_ptr_ == MAP_FAILED) {
+        sq_ptr_ = nullptr;
+        close(ring_fd_);
+        throw UnixError();
+    }
+    if (single_mmap) {
+        cq_ptr_ = sq_ptr_;
+    } else {
+        cq_ptr_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                       IORING_OFF_CQ_RING);
+    }
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes = cq_ptr_ == MAP_FAILED ? MAP_FAILED
+                                       : mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                              ring_fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        if (cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_) munmap(cq_ptr_, cq_ring_size_);
+        munmap(sq_ptr_, sq_ring_size_);
+        close(ring_fd_);
+        throw UnixError();
+    }
+    sqes_ = static_cast<struct io_uring_sqe *>(sqes);
+
+    char *sq = static_cast<char *>(sq_ptr_);
+    sq_head_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sq_mask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    char *cq = static_cast<char *>(cq_ptr_);
+    cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cq_mask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+}
+
+IoUring::~IoUring() {
+    // 等待已提交的请求完成，避免内核在缓冲区被释放后继续读写
+    while (num_queued_ + num_inflight_ > 0) {
+        try {
+            enter(1);
+        } catch (UnixError &) {
+            break;
+        }
+        reap();
+    }
+    munmap(sqes_, sqes_size_);
+    if (cq_ptr_ != sq_ptr_) {
+        munmap(cq_ptr_, cq_ring_size_);
+    }
+    munmap(sq_ptr_, sq_ring_size_);
+    close(ring_fd_);
+}
+
+void IoUring::prep_read(int fd, char *buf, size_t len, off_t offset, uint64_t tag) {
+    prep(IORING_OP_READ, fd, buf, len, offset, tag);
+}
+
+void IoUring::prep_write(int fd, const char *buf, size_t len, off_t offset, uint64_t tag) {
+    prep(IORING_OP_WRITE, fd, const_cast<char *>(buf), len, offset, tag);
+}
+
+/**
+ * @description: 把一个请求放入提交队列。同时进行的请求已达到队列深度时，先提交已准备的请求并等待一个请求完成
+ */
+void IoUring::prep(uint8_t opcode, int fd, char *buf, size_t len, off_t offset, uint64_t tag) {
+    while (num_queued_ + num_inflight_ >= queue_depth_) {
+        enter(1);
+        reap();
+    }
+    unsigned tail = *sq_tail_;
+    unsigned index = tail & *sq_mask_;
+    struct io_uring_sqe *sqe = &sqes_[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buf);
+    sqe->len = static_cast<uint32_t>(len);
+    sqe->off = static_cast<uint64_t>(offset);
+    sqe->user_data = tag;
+    sq_array_[index] = index;
+    // 内核读取sq_tail_之前，请求的内容必须已经写入
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    num_queued_++;
+}
+
+void IoUring::submit() {
+    if (num_queued_ > 0) {
+        enter(0);
+    }
+}
+
+size_t IoUring::wait(std::vector<IoCompletion> *completions, size_t min_complete) {
+    reap();
+    while (completions_.size() < min_complete && num_queued_ + num_inflight_ > 0) {
+        enter(1);
+        reap();
+    }
+    size_t count = completions_.size();
+    completions->insert(completions->end(), completions_.begin(), completions_.end());
+    completions_.clear();
+    return count;
+}
+
+/**
+ * @description: 提交已准备的请求，并等待至少min_complete个请求完成
+ */
+void IoUring::enter(unsigned min_complete) {
+    unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+    while (true) {
+        int ret = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd_, num_queued_, min_complete, flags, nullptr, 0));
+        if (ret >= 0) {
+            num_queued_ -= static_cast<unsigned>(ret);
+            num_inflight_ += static_cast<unsigned>(ret);
+            if (num_queued_ == 0 || min_complete > 0) {
+                return;
+            }
+        } else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            throw UnixError();
+        }
+    }
+}
+
+/**
+ * @description: 从完成队列中取出所有已完成的请求
+ */
+void IoUring::reap() {
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        struct io_uring_cqe *cqe = &cqes_[head & *cq_mask_];
+        completions_.push_back({cqe->user_data, cqe->res});
+        num_inflight_--;
+        head++;
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,134 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @description: 一次异步读写的完成结果
+ */
+struct IoCompletion {
+    uint64_t tag;  // 提交请求时指定的标识
+    int result;    // 成功时为读写的字节数，失败时为-errno
+};
+
+/**
+ * @description: 异步读写接口。调用者先用prep_read/prep_write准备若干请求，再调用submit一次性提交，
+ * 之后通过wait收集完成结果。一个AsyncIo对象只能由一个线程使用，需要并发读写的线程各自创建AsyncIo对象
+ */
+class AsyncIo {
+   public:
+    virtual ~AsyncIo() = default;
+
+    virtual void prep_read(int fd, char *buf, size_t len, off_t offset, uint64_t tag) = 0;
+
+    virtual void prep_write(int fd, const char *buf, size_t len, off_t offset, uint64_t tag) = 0;
+
+    virtual void submit() = 0;
+
+    /**
+     * @description: 放入一个已经同步完成的请求的结果，之后与其它请求的结果一起由wait取走
+     */
+    virtual void complete(uint64_t tag, int result) = 0;
+
+    virtual size_t wait(std::vector<IoCompletion> *completions, size_t min_complete) = 0;
+
+    virtual size_t get_num_pending() const = 0;
+
+    static std::unique_ptr<AsyncIo> create(const std::string &backend, unsigned queue_depth);
+};
+
+/**
+ * @description: 同步实现，在submit时依次执行pread/pwrite，用于不支持io_uring的环境
+ */
+class SyncIo : public AsyncIo {
+   public:
+    void prep_read(int fd, char *buf, size_t len, off_t offset, uint64_t tag) override;
+
+    void prep_write(int fd, const char *buf, size_t len, off_t offset, uint64_t tag) override;
+
+    void submit() override;
+
+    void complete(uint64_t tag, int result) override { completions_.push_back({tag, result}); }
+
+    size_t wait(std::vector<IoCompletion> *completions, size_t min_complete) override;
+
+    size_t get_num_pending() const override { return requests_.size() + completions_.size(); }
+
+   private:
+    struct IoRequest {
+        bool is_write;
+        int fd;
+        char *buf;
+        size_t len;
+        off_t offset;
+        uint64_t tag;
+    };
+    std::vector<IoRequest> requests_;        // 已准备、尚未提交的请求
+    std::deque<IoCompletion> completions_;   // 已完成、尚未被wait取走的结果
+};
+
+/**
+ * @description: 基于io_uring的实现，直接通过系统调用使用内核的提交队列和完成队列，多个请求可以同时在设备上执行
+ */
+class IoUring : public AsyncIo {
+   public:
+    explicit IoUring(unsigned queue_depth);
+
+    ~IoUring() override;
+
+    void prep_read(int fd, char *buf, size_t len, off_t offset, uint64_t tag) override;
+
+    void prep_write(int fd, const char *buf, size_t len, off_t offset, uint64_t tag) override;
+
+    void submit() override;
+
+    void complete(uint64_t tag, int result) override { completions_.push_back({tag, result}); }
+
+    size_t wait(std::vector<IoCompletion> *completions, size_t min_complete) override;
+
+    size_t get_num_pending() const override { return num_queued_ + num_inflight_ + completions_.size(); }
+
+   private:
+    void prep(uint8_t opcode, int fd, char *buf, size_t len, off_t offset, uint64_t tag);
+
+    void enter(unsigned min_complete);
+
+    void reap();
+
+    int ring_fd_ = -1;
+    unsigned queue_depth_;
+    unsigned num_queued_ = 0;    // 已放入提交队列、尚未提交给内核的请求数
+    unsigned num_inflight_ = 0;  // 已提交给内核、尚未收到完成结果的请求数
+    std::deque<IoCompletion> completions_;
+
+    // 内核共享的提交队列和完成队列
+    void *sq_ptr_ = nullptr;
+    size_t sq_ring_size_ = 0;
+    void *cq_ptr_ = nullptr;
+    size_t cq_ring_size_ = 0;
+    struct io_uring_sqe *sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+    unsigned *sq_head_;
+    unsigned *sq_tail_;
+    unsigned *sq_mask_;
+    unsigned *sq_array_;
+    unsigned *cq_head_;
+    unsigned *cq_tail_;
+    unsigned *cq_mask_;
+    struct io_uring_cqe *cqes_;
+};
@@ -10,114 +10,431 @@ See the Mulan PSL v2 for more details. */
 
 #include "buffer_pool_manager.h"
 
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "common/memory_tracker.h"
+#include "common/numa.h"
+#include "common/tracepoint.h"
+
+/**
+ * @description: 根据名称创建替换器，未知的名称使用LRU替换策略
+ * @return {Replacer*} 新创建的替换器
+ * @param {string&} replacer_type 替换策略的名称，可选"LRU"、"CLOCK"、"LRU-K"、"ARC"
+ * @param {size_t} num_pages 替换器需要管理的帧的个数
+ */
+static Replacer *create_replacer(const std::string &replacer_type, size_t num_pages) {
+    if (replacer_type == "CLOCK") {
+        return new ClockReplacer(num_pages);
+    } else if (replacer_type == "LRU-K") {
+        return new LRUKReplacer(num_pages, LRUK_REPLACER_K);
+    } else if (replacer_type == "ARC") {
+        return new ARCReplacer(num_pages);
+    }
+    return new LRUReplacer(num_pages);
+}
+
 /**
- * @description: 从free_list或replacer中得到可淘汰帧页的 *frame_id
+ * @param {size_t} num_nodes 分片分布的NUMA节点数，0表示本机的全部节点；超过本机节点数的节点只划分分片，不绑定内存
+ */
+BufferPoolManager::BufferPoolManager(size_t pool_size, DiskManager *disk_manager, size_t num_shards,
+                                     const std::string &replacer_type, size_t num_nodes)
+    : pool_size_(pool_size), page_size_(disk_manager->get_page_size()), replacer_type_(replacer_type),
+      disk_manager_(disk_manager) {
+    // 页面只能放在其所属的分片中，分片过小会导致某个分片先于整个缓冲池被占满，因此保证每个分片不少于MIN_FRAMES_PER_SHARD帧
+    num_shards = std::max<size_t>(1, std::min(num_shards, pool_size_ / MIN_FRAMES_PER_SHARD));
+    // 每个节点至少有一个分片，分片数取为节点数的整数倍
+    num_nodes_ = std::min(num_nodes == 0 ? NumaTopology::instance().num_nodes() : num_nodes, num_shards);
+    shards_per_node_ = num_shards / num_nodes_;
+    num_shards = shards_per_node_ * num_nodes_;
+    size_t frame_offset = 0;
+    for (size_t i = 0; i < num_shards; ++i) {
+        auto shard = std::make_unique<BufferPoolShard>();
+        shard->pool_size_ = pool_size_ / num_shards + (i < pool_size_ % num_shards ? 1 : 0);
+        shard->frame_offset_ = frame_offset;
+        shard->shard_no_ = i;
+        shard->node_ = i / shards_per_node_;
+        frame_offset += shard->pool_size_;
+        shard->replacer_ = create_replacer(replacer_type, shard->pool_size_);
+        shard->io_pending_.assign(shard->pool_size_, false);
+        // 初始化时，所有的page都在free_list_中
+        for (size_t j = 0; j < shard->pool_size_; ++j) {
+            shard->free_list_.emplace_back(static_cast<frame_id_t>(j));  // static_cast转换数据类型
+        }
+        shards_.push_back(std::move(shard));
+    }
+    // 为buffer pool分配页面元数据数组和帧数据区，各分片的部分绑定到所属的节点
+    allocate_pages();
+    allocate_frames();
+}
+
+BufferPoolManager::~BufferPoolManager() {
+    stop_prefetcher();
+    stop_page_cleaner();
+    for (auto &shard : shards_) {
+        delete shard->replacer_;
+    }
+    for (size_t i = 0; i < pool_size_; ++i) {
+        pages_[i].~Page();
+    }
+    munmap(pages_, pages_size_);
+    MemoryTracker::subsystem(MemoryTracker::BUFFER_POOL).release(frame_data_size_);
+    munmap(frame_data_, frame_data_size_);
+}
+
+/**
+ * @description: 映射页面元数据数组，按节点绑定之后再构造Page对象，使每个Page从所属分片的节点的内存中分配
+ */
+void BufferPoolManager::allocate_pages() {
+    size_t sys_page_size = sysconf(_SC_PAGESIZE);
+    pages_size_ = (pool_size_ * sizeof(Page) + sys_page_size - 1) / sys_page_size * sys_page_size;
+    void *pages = mmap(nullptr, pages_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pages == MAP_FAILED) {
+        throw UnixError();
+    }
+    pages_ = static_cast<Page *>(pages);
+    bind_to_nodes(static_cast<char *>(pages), pages_size_, sizeof(Page), sys_page_size);
+    for (size_t i = 0; i < pool_size_; ++i) {
+        new (&pages_[i]) Page();
+    }
+}
+
+/**
+ * @description: 把按帧排列的一块内存中各节点的分片所在的部分绑定到该节点，在第一次访问这块内存之前调用。
+ *              节点之间的边界向下对齐到align，跨边界的一个对齐单位属于后一个节点；只有一个节点时什么也不做
+ * @param {char*} base 内存的起始地址，按align对齐
+ * @param {size_t} size 内存的字节数
+ * @param {size_t} frame_bytes 每个帧在这块内存中占用的字节数
+ * @param {size_t} align 绑定的对齐单位，普通页或者大页的大小
+ */
+void BufferPoolManager::bind_to_nodes(char *base, size_t size, size_t frame_bytes, size_t align) {
+    if (num_nodes_ == 1) return;
+    for (size_t node = 0; node < num_nodes_; ++node) {
+        size_t begin = shards_[node * shards_per_node_]->frame_offset_ * frame_bytes / align * align;
+        size_t end = node + 1 < num_nodes_
+                         ? shards_[(node + 1) * shards_per_node_]->frame_offset_ * frame_bytes / align * align
+                         : size;
+        if (end > begin) {
+            NumaTopology::instance().bind_memory(base + begin, end - begin, node);
+        }
+    }
+}
+
+/**
+ * @description: 按当前的页面大小分配一块连续的帧数据区，并让每个Page指向自己的帧。帧数据区按2MB取整后优先用MAP_HUGETLB映射大页，
+ *              系统没有预留大页时退回普通映射并建议内核使用透明大页，以减少TLB缺失；mmap返回的地址总是按PAGE_SIZE对齐，可用于O_DIRECT
+ */
+void BufferPoolManager::allocate_frames() {
+    frame_data_size_ = (pool_size_ * page_size_ + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    void *frame_data = mmap(nullptr, frame_data_size_, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    huge_pages_ = frame_data != MAP_FAILED;
+    if (!huge_pages_) {
+        frame_data = mmap(nullptr, frame_data_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (frame_data == MAP_FAILED) {
+            throw UnixError();
+        }
+        madvise(frame_data, frame_data_size_, MADV_HUGEPAGE);
+    }
+    frame_data_ = static_cast<char *>(frame_data);
+    bind_to_nodes(frame_data_, frame_data_size_, page_size_, huge_pages_ ? HUGE_PAGE_SIZE : sysconf(_SC_PAGESIZE));
+    // 缓冲池的大小在启动时确定，不能因为内存限制而失败，照常记账使其它可以溢出的使用者更早溢出
+    MemoryTracker::subsystem(MemoryTracker::BUFFER_POOL).consume(frame_data_size_);
+    for (size_t i = 0; i < pool_size_; ++i) {
+        pages_[i].data_ = frame_data_ + i * page_size_;
+    }
+}
+
+/**
+ * @description: 修改帧的大小以适应新打开的数据库的页面大小，重新分配帧数据区。缓冲池中残留的已关闭文件的页面被丢弃；
+ *              仍有页面被固定或未写回时说明缓冲池正在使用，抛出异常。调用时不能有其它线程在使用缓冲池
+ * @param {int} page_size 新的页面大小，应与DiskManager的页面大小一致
+ */
+void BufferPoolManager::set_page_size(int page_size) {
+    if (page_size == page_size_) {
+        return;
+    }
+    for (auto &shard : shards_) {
+        std::scoped_lock lock{shard->latch_};
+        if (!shard->dirty_pages_.empty() || !shard->writing_back_.empty()) {
+            throw InternalError("BufferPoolManager::set_page_size: buffer pool is in use");
+        }
+        for (auto &[page_id, frame_id] : shard->page_table_) {
+            if (get_frame(*shard, frame_id)->pin_count_ > 0 || shard->io_pending_[frame_id]) {
+                throw InternalError("BufferPoolManager::set_page_size: buffer pool is in use");
+            }
+        }
+        for (auto &[page_id, frame_id] : shard->page_table_) {
+            shard->replacer_->pin(frame_id);
+            get_frame(*shard, frame_id)->id_.page_no = INVALID_PAGE_ID;
+            shard->free_list_.push_back(frame_id);
+        }
+        shard->page_table_.clear();
+    }
+    MemoryTracker::subsystem(MemoryTracker::BUFFER_POOL).release(frame_data_size_);
+    munmap(frame_data_, frame_data_size_);
+    page_size_ = page_size;
+    allocate_frames();
+}
+
+/**
+ * @description: 从分片的free_list或replacer中得到可淘汰帧页的 *frame_id，调用时需持有分片的latch。
+ *              指定了环形缓冲区且环在该分片中的帧已用满时，优先复用环中最早装入的帧；
+ *              该帧已被其它线程使用（被固定、被修改或换成了别的页面）时不再复用，转而按常规方式查找
  * @return {bool} true: 可替换帧查找成功 , false: 可替换帧查找失败
+ * @param {BufferPoolShard&} shard 目标分片
  * @param {frame_id_t*} frame_id 帧页id指针,返回成功找到的可替换帧id
+ * @param {ScanRing*} ring 顺序扫描使用的环形缓冲区，为nullptr时使用整个分片
  */
-bool BufferPoolManager::find_victim_page(frame_id_t* frame_id) {
-    // Todo:
-    // 1 使用BufferPoolManager::free_list_判断缓冲池是否已满需要淘汰页面
-    // 1.1 未满获得frame
-    // 1.2 已满使用lru_replacer中的方法选择淘汰页面
-    
+bool BufferPoolManager::find_victim_page(BufferPoolShard &shard, frame_id_t* frame_id, ScanRing *ring) {
+    if (ring != nullptr && ring->frames_[shard.shard_no_].size() >= ring->frames_per_shard_) {
+        auto [ring_frame_id, ring_page_id] = ring->frames_[shard.shard_no_].front();
+        ring->frames_[shard.shard_no_].pop_front();
+        Page *page = get_frame(shard, ring_frame_id);
+        if (page->id_ == ring_page_id && page->pin_count_ == 0 && !page->is_dirty_ &&
+            !shard.io_pending_[ring_frame_id]) {
+            shard.replacer_->pin(ring_frame_id);
+            *frame_id = ring_frame_id;
+            return true;
+        }
+    }
+
     // 首先检查free_list是否有空闲帧
-    if (!free_list_.empty()) {
-        *frame_id = free_list_.front();
-        free_list_.pop_front();
+    if (!shard.free_list_.empty()) {
+        *frame_id = shard.free_list_.front();
+        shard.free_list_.pop_front();
         return true;
     }
     
     // 如果free_list为空，使用replacer选择淘汰页面
-    return replacer_->victim(frame_id);
+    return shard.replacer_->victim(frame_id);
 }
 
 /**
- * @description: 更新页面数据, 如果为脏页则需写入磁盘，再更新为新页面，更新page元数据(data, is_dirty, page_id)和page table
+ * @description: 把帧的归属从旧页面切换到新页面，更新page元数据(is_dirty, page_id)和page table，并把帧标记为正在读写。
+ *              调用时需持有分片的latch；旧页面的脏数据不在此处写回，而是由调用者释放latch后写回，
+ *              写回完成前旧页面记录在writing_back_中，防止其它线程从磁盘读到过期数据
+ * @return {bool} 旧页面是否为脏页，需要由调用者写回磁盘
+ * @param {BufferPoolShard&} shard 帧所在的分片
  * @param {Page*} page 写回页指针
  * @param {PageId} new_page_id 新的page_id
  * @param {frame_id_t} new_frame_id 新的帧frame_id
  */
-void BufferPoolManager::update_page(Page *page, PageId new_page_id, frame_id_t new_frame_id) {
-    // Todo:
-    // 1 如果是脏页，写回磁盘，并且把dirty置为false
-    // 2 更新page table
-    // 3 重置page的data，更新page id
-    
-    // 1. 如果是脏页，写回磁盘
-    if (page->is_dirty_) {
-        disk_manager_->write_page(page->get_page_id().fd, page->get_page_id().page_no, 
-                                  page->get_data(), PAGE_SIZE);
-        page->is_dirty_ = false;
-    }
-    
-    // 2. 更新page table - 删除旧的映射
+bool BufferPoolManager::update_page(BufferPoolShard &shard, Page *page, PageId new_page_id, frame_id_t new_frame_id) {
+    bool write_back = false;
+    // 1. 删除旧页面的映射，若是脏页则登记为正在写回
     if (page->get_page_id().page_no != INVALID_PAGE_ID) {
-        page_table_.erase(page->get_page_id());
+        shard.page_table_.erase(page->get_page_id());
+        record_stat(shard, page->id_.fd, BufferPoolStats::EVICTIONS);
+        if (page->is_dirty_) {
+            shard.writing_back_.insert(page->get_page_id());
+            shard.dirty_pages_.erase(page->get_page_id());
+            record_stat(shard, page->id_.fd, BufferPoolStats::DIRTY_WRITES);
+            write_back = true;
+        }
     }
-    
-    // 3. 重置page的data，更新page id
-    page->reset_memory();
+    page->is_dirty_ = false;
+
+    // 2. 更新page id和page table，帧中的数据在读写完成前不可用
     page->id_ = new_page_id;
-    
-    // 更新page table - 添加新的映射
-    if (new_page_id.page_no != INVALID_PAGE_ID) {
-        page_table_[new_page_id] = new_frame_id;
+    shard.page_table_[new_page_id] = new_frame_id;
+    shard.io_pending_[new_frame_id] = true;
+    shard.replacer_->record_load(new_frame_id, new_page_id.Get());
+    return write_back;
+}
+
+/**
+ * @description: 帧上的磁盘读写完成，唤醒等待该帧或等待旧页面写回的线程，调用时需持有分片的latch
+ * @param {BufferPoolShard&} shard 帧所在的分片
+ * @param {PageId} victim_page_id 被淘汰的旧页面
+ * @param {bool} write_back 旧页面是否进行了写回
+ * @param {frame_id_t} frame_id 完成读写的帧
+ */
+void BufferPoolManager::finish_page_io(BufferPoolShard &shard, PageId victim_page_id, bool write_back,
+                                       frame_id_t frame_id) {
+    if (write_back) {
+        shard.writing_back_.erase(victim_page_id);
+    }
+    shard.io_pending_[frame_id] = false;
+    shard.io_cv_.notify_all();
+}
+
+/**
+ * @description: 帧上的磁盘读写失败，撤销帧与新页面的映射，调用时需持有分片的latch。
+ *              若还有其它线程在等待该帧，由最后一个释放pin的线程把帧放回free_list_
+ * @param {BufferPoolShard&} shard 帧所在的分片
+ * @param {PageId} victim_page_id 被淘汰的旧页面
+ * @param {bool} write_back 旧页面是否进行了写回
+ * @param {frame_id_t} frame_id 读写失败的帧
+ */
+void BufferPoolManager::abort_page_io(BufferPoolShard &shard, PageId victim_page_id, bool write_back,
+                                      frame_id_t frame_id) {
+    Page *page = get_frame(shard, frame_id);
+    shard.page_table_.erase(page->id_);
+    page->id_.page_no = INVALID_PAGE_ID;
+    page->is_dirty_ = false;
+    page->rec_lsn_.store(INVALID_LSN);
+    finish_page_io(shard, victim_page_id, write_back, frame_id);
+    unpin_frame(shard, frame_id);
+}
+
+/**
+ * @description: 释放一次对帧的固定，调用时需持有分片的latch。已失去页面归属的帧直接放回free_list_，
+ *              页面已被释放的帧在最后一次解除固定时丢弃其内容
+ * @param {BufferPoolShard&} shard 帧所在的分片
+ * @param {frame_id_t} frame_id 目标帧
+ */
+void BufferPoolManager::unpin_frame(BufferPoolShard &shard, frame_id_t frame_id) {
+    Page *page = get_frame(shard, frame_id);
+    if (--page->pin_count_ > 0) {
+        return;
     }
+    if (page->id_.page_no == INVALID_PAGE_ID) {
+        shard.free_list_.push_back(frame_id);
+    } else if (shard.deallocated_.erase(page->id_)) {
+        discard_frame(shard, frame_id);
+    } else {
+        shard.replacer_->unpin(frame_id);
+    }
+}
+
+/**
+ * @description: 丢弃未被固定的帧中的页面，不写回脏数据，并在磁盘文件中释放该页面，调用时需持有分片的latch
+ * @param {BufferPoolShard&} shard 帧所在的分片
+ * @param {frame_id_t} frame_id 目标帧
+ */
+void BufferPoolManager::discard_frame(BufferPoolShard &shard, frame_id_t frame_id) {
+    Page *page = get_frame(shard, frame_id);
+    PageId page_id = page->id_;
+    shard.page_table_.erase(page_id);
+    shard.dirty_pages_.erase(page_id);
+    shard.replacer_->pin(frame_id);
+    page->id_.page_no = INVALID_PAGE_ID;
+    page->is_dirty_ = false;
+    page->reset_memory(page_size_);
+    shard.free_list_.push_back(frame_id);
+    // 页面已经离开缓冲池，之后复用该页号的新页面不会与旧内容冲突
+    disk_manager_->deallocate_page(page_id.fd, page_id.page_no);
 }
 
 /**
  * @description: 从buffer pool获取需要的页。
  *              如果页表中存在page_id（说明该page在缓冲池中），并且pin_count++。
  *              如果页表不存在page_id（说明该page在磁盘中），则找缓冲池victim page，将其替换为磁盘中读取的page，pin_count置1。
+ *              淘汰页的写回和目标页的读取都在释放分片latch后进行
  * @return {Page*} 若获得了需要的页则将其返回，否则返回nullptr
  * @param {PageId} page_id 需要获取的页的PageId
+ * @param {ScanRing*} ring 顺序扫描使用的环形缓冲区，目标页不在缓冲池中时装入环中的帧
  */
-Page* BufferPoolManager::fetch_page(PageId page_id) {
-    //Todo:
-    // 1.     从page_table_中搜寻目标页
-    // 1.1    若目标页有被page_table_记录，则将其所在frame固定(pin)，并返回目标页。
-    // 1.2    否则，尝试调用find_victim_page获得一个可用的frame，若失败则返回nullptr
-    // 2.     若获得的可用frame存储的为dirty page，则须调用updata_page将page写回到磁盘
-    // 3.     调用disk_manager_的read_page读取目标页到frame
-    // 4.     固定目标页，更新pin_count_
-    // 5.     返回目标页
-    
-    std::scoped_lock lock{latch_};
-    
+Page* BufferPoolManager::fetch_page(PageId page_id, ScanRing *ring) {
+    BufferPoolShard &shard = get_shard(page_id);
+    std::unique_lock lock{shard.latch_};
+
+    // 等待其它线程对目标页的磁盘读写完成，等待的时间计入统计
+    auto wait_page_io = [&](auto pred) {
+        auto start = std::chrono::steady_clock::now();
+        shard.io_cv_.wait(lock, pred);
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        record_stat(shard, page_id.fd, BufferPoolStats::PIN_WAIT_NS, elapsed.count());
+    };
+
     // 1. 从page_table_中搜寻目标页
-    auto it = page_table_.find(page_id);
-    if (it != page_table_.end()) {
-        // 1.1 目标页在缓冲池中
+    while (true) {
+        // 目标页刚被淘汰、脏数据还未写回，此时从磁盘读取会读到过期数据，需等待写回完成
+        if (shard.writing_back_.count(page_id)) {
+            wait_page_io([&] { return !shard.writing_back_.count(page_id); });
+            continue;
+        }
+        auto it = shard.page_table_.find(page_id);
+        if (it == shard.page_table_.end()) {
+            break;
+        }
+        // 1.1 目标页在缓冲池中，固定该页面
         frame_id_t frame_id = it->second;
-        Page* page = &pages_[frame_id];
-        
-        // 固定该页面
+        Page* page = get_frame(shard, frame_id);
         page->pin_count_++;
-        replacer_->pin(frame_id);
-        
-        return page;
+        shard.replacer_->pin(frame_id);
+        // 其它线程正在把目标页读入该帧，帧已被固定不会被淘汰，等待读取完成即可
+        if (shard.io_pending_[frame_id]) {
+            wait_page_io([&] { return !shard.io_pending_[frame_id]; });
+        }
+        if (page->id_ == page_id) {
+            record_stat(shard, page_id.fd, BufferPoolStats::HITS);
+            thread_stats().counters[BufferPoolStats::HITS]++;
+            return page;
+        }
+        // 读取失败，帧已失去页面归属，释放固定后重新查找
+        unpin_frame(shard, frame_id);
     }
-    
-    // 1.2 目标页不在缓冲池中，需要从磁盘读取
+
+    // 1.2 目标页不在缓冲池中，尝试获得一个可用的frame
+    record_stat(shard, page_id.fd, BufferPoolStats::MISSES);
+    thread_stats().counters[BufferPoolStats::MISSES]++;
+    // page_miss_start到page_miss_done之间是一次未命中的全部耗时：找淘汰页、写回脏页和读入目标页
+    RMDB_TRACE(page_miss_start, page_id.fd, page_id.page_no);
     frame_id_t frame_id;
-    if (!find_victim_page(&frame_id)) {
+    if (!find_victim_page(shard, &frame_id, ring)) {
         // 无法获得可用的frame
         return nullptr;
     }
-    
-    // 2. 获得可用的frame，更新该frame中的page
-    Page* page = &pages_[frame_id];
-    update_page(page, page_id, frame_id);
-    
-    // 3. 从磁盘读取目标页到frame
-    disk_manager_->read_page(page_id.fd, page_id.page_no, page->get_data(), PAGE_SIZE);
-    
-    // 4. 固定目标页，更新pin_count_
+    if (ring != nullptr) {
+        ring->frames_[shard.shard_no_].emplace_back(frame_id, page_id);
+    }
+
+    // 2. 把frame切换到目标页，固定目标页
+    Page* page = get_frame(shard, frame_id);
+    PageId victim_page_id = page->id_;
+    bool write_back = update_page(shard, page, page_id, frame_id);
     page->pin_count_ = 1;
-    replacer_->pin(frame_id);
-    
-    // 5. 返回目标页
+    shard.replacer_->pin(frame_id);
+    RMDB_TRACE(page_evict, victim_page_id.fd, victim_page_id.page_no, write_back);
+
+    // 3. 释放latch后写回淘汰页、从磁盘读取目标页；前台需要写回脏页说明刷脏落后了，唤醒后台刷脏线程
+    lock.unlock();
+    if (write_back) {
+        cleaner_cv_.notify_one();
+    }
+    try {
+        if (write_back) {
+            lsn_t lsn = flush_log_for(page);
+            disk_manager_->write_page(victim_page_id.fd, victim_page_id.page_no, page->get_data(), page_size_);
+            page->clear_rec_lsn(lsn);
+        }
+        disk_manager_->read_page(page_id.fd, page_id.page_no, page->get_data(), page_size_);
+    } catch (...) {
+        lock.lock();
+        abort_page_io(shard, victim_page_id, write_back, frame_id);
+        throw;
+    }
+    lock.lock();
+    finish_page_io(shard, victim_page_id, write_back, frame_id);
+    RMDB_TRACE(page_miss_done, page_id.fd, page_id.page_no, write_back);
+
+    // 4. 返回目标页
+    return page;
+}
+
+/**
+ * @description: 不等待磁盘读写地获取页面：目标页已在缓冲池中并且数据可用时固定并返回，否则返回nullptr，不读取页面。
+ *              交错的索引查找用它判断孩子结点是否需要异步读入
+ * @return {Page*} 固定的页面，页面不在缓冲池中或正在读写时返回nullptr
+ * @param {PageId} page_id 需要获取的页的PageId
+ */
+Page* BufferPoolManager::try_fetch_page(PageId page_id) {
+    BufferPoolShard &shard = get_shard(page_id);
+    std::scoped_lock lock{shard.latch_};
+    auto it = shard.page_table_.find(page_id);
+    if (it == shard.page_table_.end() || shard.io_pending_[it->second]) {
+        return nullptr;
+    }
+    frame_id_t frame_id = it->second;
+    Page* page = get_frame(shard, frame_id);
+    page->pin_count_++;
+    shard.replacer_->pin(frame_id);
+    record_stat(shard, page_id.fd, BufferPoolStats::HITS);
+    thread_stats().counters[BufferPoolStats::HITS]++;
     return page;
 }
 
@@ -128,81 +445,94 @@ Page* BufferPoolManager::fetch_page(PageId page_id) {
  * @param {bool} is_dirty 若目标page应该被标记为dirty则为true，否则为false
  */
 bool BufferPoolManager::unpin_page(PageId page_id, bool is_dirty) {
-    // Todo:
-    // 0. lock latch
-    // 1. 尝试在page_table_中搜寻page_id对应的页P
-    // 1.1 P在页表中不存在 return false
-    // 1.2 P在页表中存在，获取其pin_count_
-    // 2.1 若pin_count_已经等于0，则返回false
-    // 2.2 若pin_count_大于0，则pin_count_自减一
-    // 2.2.1 若自减后等于0，则调用replacer_的Unpin
-    // 3 根据参数is_dirty，更改P的is_dirty_
-    
-    std::scoped_lock lock{latch_};
+    BufferPoolShard &shard = get_shard(page_id);
+    std::scoped_lock lock{shard.latch_};
     
     // 1. 尝试在page_table_中搜寻page_id对应的页P
-    auto it = page_table_.find(page_id);
-    if (it == page_table_.end()) {
+    auto it = shard.page_table_.find(page_id);
+    if (it == shard.page_table_.end()) {
         // 1.1 P在页表中不存在
         return false;
     }
     
     // 1.2 P在页表中存在
     frame_id_t frame_id = it->second;
-    Page* page = &pages_[frame_id];
+    Page* page = get_frame(shard, frame_id);
     
     // 2.1 若pin_count_已经等于0，则返回false
     if (page->pin_count_ <= 0) {
         return false;
     }
     
-    // 2.2 pin_count_自减一
-    page->pin_count_--;
-    
-    // 2.2.1 若自减后等于0，则调用replacer_的Unpin
-    if (page->pin_count_ == 0) {
-        replacer_->unpin(frame_id);
-    }
-    
-    // 3. 根据参数is_dirty，更改P的is_dirty_
+    // 2.2 根据参数is_dirty，更改P的is_dirty_。必须在解除固定之前标记：已被释放的页面在最后一次解除固定时
+    //     被丢弃，之后不能再把它加入脏页集合
     if (is_dirty) {
         page->is_dirty_ = true;
+        shard.dirty_pages_.insert(page_id);
     }
     
+    // 3. pin_count_自减一，若自减后等于0，则调用replacer_的Unpin
+    unpin_frame(shard, frame_id);
+    
     return true;
 }
 
 /**
- * @description: 将目标页写回磁盘，不考虑当前页面是否正在被使用
+ * @description: 将目标页写回磁盘，不考虑当前页面是否正在被使用。写回期间固定该页并释放分片latch，
+ *              持有页面的共享latch，等待正在修改该页的线程完成；调用者不能持有该页的排他latch
  * @return {bool} 成功则返回true，否则返回false(只有page_table_中没有目标页时)
  * @param {PageId} page_id 目标页的page_id，不能为INVALID_PAGE_ID
  */
 bool BufferPoolManager::flush_page(PageId page_id) {
-    // Todo:
-    // 0. lock latch
-    // 1. 查找页表,尝试获取目标页P
-    // 1.1 目标页P没有被page_table_记录 ，返回false
-    // 2. 无论P是否为脏都将其写回磁盘。
-    // 3. 更新P的is_dirty_
-    
-    std::scoped_lock lock{latch_};
+    BufferPoolShard &shard = get_shard(page_id);
+    std::unique_lock lock{shard.latch_};
     
-    // 1. 查找页表，尝试获取目标页P
-    auto it = page_table_.find(page_id);
-    if (it == page_table_.end()) {
-        // 1.1 目标页P没有被page_table_记录
-        return false;
+    // 1. 查找页表，尝试获取目标页P，P正在读写时等待其完成
+    frame_id_t frame_id;
+    while (true) {
+        auto it = shard.page_table_.find(page_id);
+        if (it == shard.page_table_.end()) {
+            // 1.1 目标页P没有被page_table_记录
+            return false;
+        }
+        frame_id = it->second;
+        if (!shard.io_pending_[frame_id]) {
+            break;
+        }
+        shard.io_cv_.wait(lock);
     }
+    Page* page = get_frame(shard, frame_id);
+    page->pin_count_++;
+    shard.replacer_->pin(frame_id);
     
-    // 获取目标页
-    frame_id_t frame_id = it->second;
-    Page* page = &pages_[frame_id];
-    
-    // 2. 无论P是否为脏都将其写回磁盘
-    disk_manager_->write_page(page_id.fd, page_id.page_no, page->get_data(), PAGE_SIZE);
-    
-    // 3. 更新P的is_dirty_
+    // 2. 先清除P的is_dirty_，写回期间再次被修改的页面会重新被标记为脏页
+    bool was_dirty = page->is_dirty_;
     page->is_dirty_ = false;
+    shard.dirty_pages_.erase(page_id);
+    if (was_dirty) {
+        record_stat(shard, page_id.fd, BufferPoolStats::DIRTY_WRITES);
+    }
+    
+    // 3. 无论P是否为脏都将其写回磁盘
+    lock.unlock();
+    page->r_latch();
+    try {
+        lsn_t lsn = flush_log_for(page);
+        disk_manager_->write_page(page_id.fd, page_id.page_no, page->get_data(), page_size_);
+        page->clear_rec_lsn(lsn);
+        page->r_unlatch();
+    } catch (...) {
+        page->r_unlatch();
+        lock.lock();
+        page->is_dirty_ = page->is_dirty_ || was_dirty;
+        if (page->is_dirty_) {
+            shard.dirty_pages_.insert(page_id);
+        }
+        unpin_frame(shard, frame_id);
+        throw;
+    }
+    lock.lock();
+    unpin_frame(shard, frame_id);
     
     return true;
 }
@@ -213,32 +543,46 @@ bool BufferPoolManager::flush_page(PageId page_id) {
  * @param {PageId*} page_id 当成功创建一个新的page时存储其page_id
  */
 Page* BufferPoolManager::new_page(PageId* page_id) {
-    // 1.   获得一个可用的frame，若无法获得则返回nullptr
-    // 2.   在fd对应的文件分配一个新的page_id
-    // 3.   将frame的数据写回磁盘
-    // 4.   固定frame，更新pin_count_
-    // 5.   返回获得的page
-    
-    std::scoped_lock lock{latch_};
+    // 1. 在fd对应的文件分配一个新的page_id，新页面所在的分片由page_id决定
+    PageId new_page_id = {page_id->fd, disk_manager_->allocate_page(page_id->fd)};
+    BufferPoolShard &shard = get_shard(new_page_id);
+    std::unique_lock lock{shard.latch_};
     
-    // 1. 获得一个可用的frame
+    // 2. 获得一个可用的frame
     frame_id_t frame_id;
-    if (!find_victim_page(&frame_id)) {
-        // 无法获得可用的frame
+    if (!find_victim_page(shard, &frame_id)) {
+        // 无法获得可用的frame，撤销刚才分配的页号
+        lock.unlock();
+        disk_manager_->cancel_allocate_page(new_page_id.fd, new_page_id.page_no);
         return nullptr;
     }
     
-    // 2. 在fd对应的文件分配一个新的page_id
-    page_id_t new_page_no = disk_manager_->allocate_page(page_id->fd);
-    PageId new_page_id = {page_id->fd, new_page_no};
-    
-    // 3. 将旧frame的数据写回磁盘（如果是脏页）
-    Page* page = &pages_[frame_id];
-    update_page(page, new_page_id, frame_id);
-    
-    // 4. 固定frame，更新pin_count_
+    // 3. 把frame切换到新页面，固定frame，更新pin_count_
+    Page* page = get_frame(shard, frame_id);
+    PageId victim_page_id = page->id_;
+    bool write_back = update_page(shard, page, new_page_id, frame_id);
     page->pin_count_ = 1;
-    replacer_->pin(frame_id);
+    shard.replacer_->pin(frame_id);
+    
+    // 4. 释放latch后将旧frame的数据写回磁盘（如果是脏页），并重置page的data
+    lock.unlock();
+    if (write_back) {
+        cleaner_cv_.notify_one();
+    }
+    try {
+        if (write_back) {
+            lsn_t lsn = flush_log_for(page);
+            disk_manager_->write_page(victim_page_id.fd, victim_page_id.page_no, page->get_data(), page_size_);
+            page->clear_rec_lsn(lsn);
+        }
+    } catch (...) {
+        lock.lock();
+        abort_page_io(shard, victim_page_id, write_back, frame_id);
+        throw;
+    }
+    page->reset_memory(page_size_);
+    lock.lock();
+    finish_page_io(shard, victim_page_id, write_back, frame_id);
     
     // 传出新页面的page_id
     *page_id = new_page_id;
@@ -253,60 +597,792 @@ Page* BufferPoolManager::new_page(PageId* page_id) {
  * @param {PageId} page_id 目标页
  */
 bool BufferPoolManager::delete_page(PageId page_id) {
-    // 1.   在page_table_中查找目标页，若不存在返回true
-    // 2.   若目标页的pin_count不为0，则返回false
-    // 3.   将目标页数据写回磁盘，从页表中删除目标页，重置其元数据，将其加入free_list_，返回true
-    
-    std::scoped_lock lock{latch_};
+    BufferPoolShard &shard = get_shard(page_id);
+    std::unique_lock lock{shard.latch_};
     
-    // 1. 在page_table_中查找目标页
-    auto it = page_table_.find(page_id);
-    if (it == page_table_.end()) {
-        // 目标页不在缓冲池中
-        return true;
+    // 1. 在page_table_中查找目标页，目标页正在读写时等待其完成
+    frame_id_t frame_id;
+    while (true) {
+        auto it = shard.page_table_.find(page_id);
+        if (it == shard.page_table_.end()) {
+            // 目标页不在缓冲池中
+            return true;
+        }
+        frame_id = it->second;
+        if (!shard.io_pending_[frame_id]) {
+            break;
+        }
+        shard.io_cv_.wait(lock);
     }
     
     // 2. 若目标页的pin_count不为0，则返回false
-    frame_id_t frame_id = it->second;
-    Page* page = &pages_[frame_id];
-    
+    Page* page = get_frame(shard, frame_id);
     if (page->pin_count_ != 0) {
         return false;
     }
     
-    // 3. 将目标页数据写回磁盘
-    if (page->is_dirty_) {
-        disk_manager_->write_page(page_id.fd, page_id.page_no, page->get_data(), PAGE_SIZE);
-        page->is_dirty_ = false;
+    // 3. 从页表和replacer中删除目标页，脏页登记为正在写回
+    bool write_back = page->is_dirty_;
+    shard.page_table_.erase(page_id);
+    shard.dirty_pages_.erase(page_id);
+    shard.replacer_->pin(frame_id);
+    page->id_.page_no = INVALID_PAGE_ID;
+    page->is_dirty_ = false;
+    if (write_back) {
+        shard.writing_back_.insert(page_id);
+        shard.io_pending_[frame_id] = true;
+        record_stat(shard, page_id.fd, BufferPoolStats::DIRTY_WRITES);
+        
+        // 释放latch后将目标页数据写回磁盘
+        lock.unlock();
+        try {
+            lsn_t lsn = flush_log_for(page);
+            disk_manager_->write_page(page_id.fd, page_id.page_no, page->get_data(), page_size_);
+            page->clear_rec_lsn(lsn);
+        } catch (...) {
+            lock.lock();
+            finish_page_io(shard, page_id, write_back, frame_id);
+            page->rec_lsn_.store(INVALID_LSN);
+            shard.free_list_.push_back(frame_id);
+            throw;
+        }
+        lock.lock();
+        finish_page_io(shard, page_id, write_back, frame_id);
     }
     
-    // 从页表中删除目标页
-    page_table_.erase(it);
-    
-    // 重置其元数据
-    page->reset_memory();
-    page->id_.page_no = INVALID_PAGE_ID;
+    // 4. 重置其元数据，将其加入free_list_
+    page->reset_memory(page_size_);
     page->pin_count_ = 0;
-    
-    // 将其加入free_list_
-    free_list_.push_back(frame_id);
+    shard.free_list_.push_back(frame_id);
     
     return true;
 }
 
 /**
- * @description: 将buffer_pool中的所有页写回到磁盘
+ * @description: 释放不再使用的页面，如B+树合并后被删除的结点。页面的内容被直接丢弃而不写回，
+ *              页号交给DiskManager供之后分配新页面时复用。页面仍被固定时，在最后一次解除固定时再丢弃
+ * @param {PageId} page_id 要释放的页面
+ */
+void BufferPoolManager::deallocate_page(PageId page_id) {
+    BufferPoolShard &shard = get_shard(page_id);
+    std::unique_lock lock{shard.latch_};
+    while (true) {
+        // 等待页面正在进行的写回或读取完成，避免磁盘上的旧内容在页号被复用后才写入
+        if (shard.writing_back_.count(page_id)) {
+            shard.io_cv_.wait(lock);
+            continue;
+        }
+        auto it = shard.page_table_.find(page_id);
+        if (it == shard.page_table_.end()) {
+            disk_manager_->deallocate_page(page_id.fd, page_id.page_no);
+            return;
+        }
+        frame_id_t frame_id = it->second;
+        if (shard.io_pending_[frame_id]) {
+            shard.io_cv_.wait(lock);
+            continue;
+        }
+        if (get_frame(shard, frame_id)->pin_count_ > 0) {
+            shard.deallocated_.insert(page_id);
+        } else {
+            discard_frame(shard, frame_id);
+        }
+        return;
+    }
+}
+
+/**
+ * @description: 将buffer_pool中的所有页写回到磁盘。先固定所有分片中该文件的页面，再按页号排序，
+ *              页号连续的页面用一次系统调用写回。写回期间持有这些页面的共享latch：每段只等待第一个页面的latch，
+ *              此时不持有其他页面的latch，之后的页面latch被占用时就在此处分段，不会与按树的顺序加latch的线程死锁
  * @param {int} fd 文件句柄
+ * @param {bool} dirty_only 只写回脏页，检查点写回仍在使用的文件时为true。检查点持有catalog_latch_，
+ *                          此时不等待页面latch，正在被修改的页面留作脏页，由下一次检查点或刷脏写回
  */
-void BufferPoolManager::flush_all_pages(int fd) {
-    std::scoped_lock lock{latch_};
-    
-    // 遍历page_table_，找到所有fd对应的页面并刷新到磁盘
-    for (auto& [page_id, frame_id] : page_table_) {
-        if (page_id.fd == fd) {
-            Page* page = &pages_[frame_id];
-            disk_manager_->write_page(page_id.fd, page_id.page_no, page->get_data(), PAGE_SIZE);
+void BufferPoolManager::flush_all_pages(int fd, bool dirty_only) {
+    // 文件即将关闭，丢弃该文件上尚未执行的预读，并等待正在进行的预读完成
+    if (!dirty_only) {
+        cancel_prefetch(fd);
+    }
+
+    struct FlushFrame {
+        page_id_t page_no;
+        BufferPoolShard *shard;
+        frame_id_t frame_id;
+        bool was_dirty;
+        bool written;
+    };
+    std::vector<FlushFrame> frames;
+    for (auto &shard_ptr : shards_) {
+        BufferPoolShard &shard = *shard_ptr;
+        std::unique_lock lock{shard.latch_};
+
+        // 等待该文件上正在进行的读写完成
+        shard.io_cv_.wait(lock, [&] {
+            for (auto &[page_id, frame_id] : shard.page_table_) {
+                if (page_id.fd == fd && shard.io_pending_[frame_id]) return false;
+            }
+            for (auto &page_id : shard.writing_back_) {
+                if (page_id.fd == fd) return false;
+            }
+            return true;
+        });
+
+        // 固定分片中所有fd对应的页面，全部分片处理完毕后统一写回
+        for (auto &[page_id, frame_id] : shard.page_table_) {
+            if (page_id.fd == fd) {
+                Page* page = get_frame(shard, frame_id);
+                if (dirty_only && !page->is_dirty_) {
+                    continue;
+                }
+                page->pin_count_++;
+                shard.replacer_->pin(frame_id);
+                frames.push_back({page_id.page_no, &shard, frame_id, page->is_dirty_, false});
+                page->is_dirty_ = false;
+                shard.dirty_pages_.erase(page_id);
+            }
+        }
+    }
+
+    // 没有写回的脏页（latch被占用或写回失败）重新标记为脏页
+    auto unpin_frames = [&]() {
+        for (auto &frame : frames) {
+            std::scoped_lock lock{frame.shard->latch_};
+            Page *page = get_frame(*frame.shard, frame.frame_id);
+            if (frame.was_dirty && !frame.written) {
+                page->is_dirty_ = true;
+                frame.shard->dirty_pages_.insert(page->id_);
+            } else if (frame.was_dirty) {
+                record_stat(*frame.shard, fd, BufferPoolStats::DIRTY_WRITES);
+            }
+            unpin_frame(*frame.shard, frame.frame_id);
+        }
+    };
+    std::sort(frames.begin(), frames.end(),
+              [](const FlushFrame &a, const FlushFrame &b) { return a.page_no < b.page_no; });
+    for (size_t begin = 0; begin < frames.size();) {
+        size_t end = begin;
+        while (end < frames.size() && (end == begin || frames[end].page_no == frames[end - 1].page_no + 1)) {
+            Page *page = get_frame(*frames[end].shard, frames[end].frame_id);
+            if (end == begin && !dirty_only) {
+                page->r_latch();
+            } else if (!page->try_r_latch()) {
+                break;
+            }
+            ++end;
+        }
+        if (end == begin) {
+            ++begin;
+            continue;
+        }
+        try {
+            std::vector<const char *> buffers;
+            std::vector<lsn_t> lsns;
+            for (size_t i = begin; i < end; ++i) {
+                Page *page = get_frame(*frames[i].shard, frames[i].frame_id);
+                lsns.push_back(flush_log_for(page));
+                buffers.push_back(page->get_data());
+            }
+            disk_manager_->write_pages(fd, frames[begin].page_no, buffers);
+            for (size_t i = begin; i < end; ++i) {
+                get_frame(*frames[i].shard, frames[i].frame_id)->clear_rec_lsn(lsns[i - begin]);
+                frames[i].written = true;
+            }
+        } catch (...) {
+            for (size_t i = begin; i < end; ++i) {
+                get_frame(*frames[i].shard, frames[i].frame_id)->r_unlatch();
+            }
+            unpin_frames();
+            throw;
+        }
+        for (size_t i = begin; i < end; ++i) {
+            get_frame(*frames[i].shard, frames[i].frame_id)->r_unlatch();
+        }
+        begin = end;
+    }
+    unpin_frames();
+}
+
+/**
+ * @description: 写回文件的所有页面并把它们移出缓冲池，在关闭文件之前调用。关闭后新打开的文件可能复用同一个fd，
+ *              该文件的页面不能再以这个fd留在页表中，因此文件还有被固定的页面或写回之后又被修改的页面时抛出异常，
+ *              不能关闭文件
+ * @param {int} fd 文件句柄
+ */
+void BufferPoolManager::evict_all_pages(int fd) {
+    flush_all_pages(fd);
+    for (auto &shard_ptr : shards_) {
+        BufferPoolShard &shard = *shard_ptr;
+        std::scoped_lock lock{shard.latch_};
+        std::vector<frame_id_t> frames;
+        for (auto &[page_id, frame_id] : shard.page_table_) {
+            if (page_id.fd == fd) {
+                Page *page = get_frame(shard, frame_id);
+                if (page->pin_count_ > 0) {
+                    throw InternalError("BufferPoolManager::evict_all_pages: page " + std::to_string(page_id.page_no) +
+                                        " of the file is still pinned");
+                }
+                // 写回之后又被修改的页面说明文件仍在使用，丢弃它会丢失修改
+                if (page->is_dirty_) {
+                    throw InternalError("BufferPoolManager::evict_all_pages: page " + std::to_string(page_id.page_no) +
+                                        " of the file was modified while closing it");
+                }
+                frames.push_back(frame_id);
+            }
+        }
+        for (frame_id_t frame_id : frames) {
+            Page *page = get_frame(shard, frame_id);
+            shard.page_table_.erase(page->id_);
+            shard.dirty_pages_.erase(page->id_);
+            shard.deallocated_.erase(page->id_);
+            shard.replacer_->pin(frame_id);
+            page->id_.page_no = INVALID_PAGE_ID;
+            page->reset_memory(page_size_);
+            shard.free_list_.push_back(frame_id);
+        }
+    }
+}
+
+/**
+ * @description: 获取页面并加共享latch，返回的保护对象析构时自动解除latch和固定
+ * @return {ReadPageGuard} 页面的读保护，缓冲池没有可用帧时返回无效的保护对象
+ * @param {PageId} page_id 需要获取的页的PageId
+ * @param {ScanRing*} ring 顺序扫描使用的环形缓冲区
+ */
+ReadPageGuard BufferPoolManager::fetch_page_read(PageId page_id, ScanRing *ring) {
+    return ReadPageGuard(this, fetch_page(page_id, ring));
+}
+
+/**
+ * @description: 获取页面并加排他latch，返回的保护对象析构时自动解除latch，并以脏页方式解除固定
+ * @return {WritePageGuard} 页面的写保护，缓冲池没有可用帧时返回无效的保护对象
+ * @param {PageId} page_id 需要获取的页的PageId
+ */
+WritePageGuard BufferPoolManager::fetch_page_write(PageId page_id) {
+    return WritePageGuard(this, fetch_page(page_id));
+}
+
+/**
+ * @description: 创建一个新的page并加排他latch
+ * @return {WritePageGuard} 新页面的写保护，创建失败时返回无效的保护对象
+ * @param {PageId*} page_id 当成功创建一个新的page时存储其page_id
+ */
+WritePageGuard BufferPoolManager::new_page_guarded(PageId* page_id) {
+    return WritePageGuard(this, new_page(page_id));
+}
+
+/**
+ * @description: 为大表顺序扫描创建环形缓冲区，环的帧数按分片平均划分，每个分片至少一帧
+ * @return {shared_ptr<ScanRing>} 新创建的环形缓冲区
+ * @param {size_t} num_frames 环最多占用的帧数
+ */
+std::shared_ptr<ScanRing> BufferPoolManager::create_scan_ring(size_t num_frames) {
+    return std::make_shared<ScanRing>(shards_.size(), std::max<size_t>(1, num_frames / shards_.size()));
+}
+
+/**
+ * @description: 获取缓冲池中脏页的个数
+ */
+size_t BufferPoolManager::get_num_dirty_pages() {
+    size_t num_dirty_pages = 0;
+    for (auto &shard : shards_) {
+        std::scoped_lock lock{shard->latch_};
+        num_dirty_pages += shard->dirty_pages_.size();
+    }
+    return num_dirty_pages;
+}
+
+/**
+ * @description: 获取缓冲池中文件fd的页面被固定的总次数，删除表之前据此判断文件是否仍在被读取
+ * @param {int} fd 文件句柄
+ */
+size_t BufferPoolManager::get_num_pins(int fd) {
+    size_t num_pins = 0;
+    for (auto &shard : shards_) {
+        std::scoped_lock lock{shard->latch_};
+        for (auto &[page_id, frame_id] : shard->page_table_) {
+            if (page_id.fd == fd) {
+                num_pins += get_frame(*shard, frame_id)->pin_count_;
+            }
+        }
+    }
+    return num_pins;
+}
+
+/**
+ * @description: 检查点使用的脏页表：缓冲池中尚未写回磁盘的修改所在的页面及其recLSN。
+ *              被淘汰的页面在写回完成之前已经不在页表中，先等待分片中正在进行的写回结束，再在latch内收集
+ * @param {vector<pair<PageId, lsn_t>>*} dirty_pages 收集到的页面和recLSN
+ */
+void BufferPoolManager::get_dirty_page_table(std::vector<std::pair<PageId, lsn_t>> *dirty_pages) {
+    for (auto &shard_ptr : shards_) {
+        BufferPoolShard &shard = *shard_ptr;
+        std::unique_lock lock{shard.latch_};
+        shard.io_cv_.wait(lock, [&] { return shard.writing_back_.empty(); });
+        for (auto &[page_id, frame_id] : shard.page_table_) {
+            lsn_t rec_lsn = get_frame(shard, frame_id)->get_rec_lsn();
+            if (rec_lsn != INVALID_LSN && !shard.io_pending_[frame_id]) {
+                dirty_pages->emplace_back(page_id, rec_lsn);
+            }
+        }
+    }
+}
+
+/**
+ * @description: 获取整个缓冲池的统计信息，即各分片统计信息之和
+ */
+BufferPoolStats BufferPoolManager::get_stats() {
+    BufferPoolStats stats;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        stats.merge(get_shard_stats(i));
+    }
+    return stats;
+}
+
+/**
+ * @description: 获取一个分片的统计信息，计数器不需要latch即可读取，当前页面数和脏页数在持有latch时读取
+ * @param {size_t} shard_no 分片在shards_中的下标
+ */
+BufferPoolStats BufferPoolManager::get_shard_stats(size_t shard_no) {
+    BufferPoolShard &shard = *shards_.at(shard_no);
+    BufferPoolStats stats;
+    for (int i = 0; i < BufferPoolStats::NUM_COUNTERS; ++i) {
+        stats.counters[i] = shard.counters_[i].load(std::memory_order_relaxed);
+    }
+    std::scoped_lock lock{shard.latch_};
+    stats.resident_pages = shard.page_table_.size();
+    stats.dirty_pages = shard.dirty_pages_.size();
+    return stats;
+}
+
+/**
+ * @description: 按文件汇总各分片的统计信息，包括当前在缓冲池中有页面的文件和有统计计数的文件
+ * @return {map<int, BufferPoolStats>} 文件句柄到该文件统计信息的映射
+ */
+std::map<int, BufferPoolStats> BufferPoolManager::get_file_stats() {
+    std::map<int, BufferPoolStats> file_stats;
+    for (auto &shard : shards_) {
+        std::scoped_lock lock{shard->latch_};
+        for (auto &[fd, stats] : shard->file_stats_) {
+            file_stats[fd].merge(stats);
+        }
+        for (auto &[page_id, frame_id] : shard->page_table_) {
+            file_stats[page_id.fd].resident_pages++;
+        }
+        for (auto &page_id : shard->dirty_pages_) {
+            file_stats[page_id.fd].dirty_pages++;
+        }
+    }
+    return file_stats;
+}
+
+/**
+ * @description: 清除文件的统计计数，在关闭文件时调用，避免文件句柄被复用后新文件继承旧文件的统计
+ * @param {int} fd 文件句柄
+ */
+void BufferPoolManager::reset_file_stats(int fd) {
+    for (auto &shard : shards_) {
+        std::scoped_lock lock{shard->latch_};
+        shard->file_stats_.erase(fd);
+    }
+}
+
+/**
+ * @description: 启动后台刷脏线程，重复启动时只更新clean_percent
+ * @param {size_t} clean_percent 每个分片中需要保持干净的帧所占的百分比
+ */
+void BufferPoolManager::start_page_cleaner(size_t clean_percent) {
+    std::scoped_lock lock{cleaner_latch_};
+    clean_percent_ = std::min<size_t>(clean_percent, 100);
+    if (cleaner_running_) {
+        return;
+    }
+    cleaner_running_ = true;
+    cleaner_thread_ = std::thread(&BufferPoolManager::run_page_cleaner, this);
+}
+
+/**
+ * @description: 停止后台刷脏线程，等待其退出
+ */
+void BufferPoolManager::stop_page_cleaner() {
+    {
+        std::scoped_lock lock{cleaner_latch_};
+        if (!cleaner_running_) {
+            return;
+        }
+        cleaner_running_ = false;
+    }
+    cleaner_cv_.notify_all();
+    cleaner_thread_.join();
+}
+
+/**
+ * @description: 后台刷脏线程的主循环，每隔PAGE_CLEANER_INTERVAL_MS或被前台的同步写回唤醒时检查一遍所有分片
+ */
+void BufferPoolManager::run_page_cleaner() {
+    // 一批脏页的写回同时提交，使用io_uring后端时这些写回可以同时在设备上进行
+    std::unique_ptr<AsyncIo> io = disk_manager_->create_async_io(PAGE_CLEANER_BATCH_SIZE);
+    std::unique_lock lock{cleaner_latch_};
+    while (cleaner_running_) {
+        cleaner_cv_.wait_for(lock, std::chrono::milliseconds(PAGE_CLEANER_INTERVAL_MS));
+        if (!cleaner_running_) {
+            break;
+        }
+        lock.unlock();
+        for (auto &shard : shards_) {
+            clean_shard(*shard, io.get());
+        }
+        lock.lock();
+    }
+}
+
+/**
+ * @description: 当分片中脏页过多时，按页面顺序写回一批未被固定的脏页。
+ *              写回期间固定这些页面，使其不会被淘汰；同时持有页面的共享latch，保证写回的是一致的页面内容。
+ *              脏页按页号而不是树的加latch顺序选出，因此只尝试加latch，正在被修改的页面放回脏页集合等下一轮写回
+ * @param {BufferPoolShard&} shard 目标分片
+ * @param {AsyncIo*} io 刷脏线程的异步读写对象
+ */
+void BufferPoolManager::clean_shard(BufferPoolShard &shard, AsyncIo *io) {
+    std::vector<frame_id_t> frames;
+    {
+        std::scoped_lock lock{shard.latch_};
+        size_t max_dirty = shard.pool_size_ - shard.pool_size_ * clean_percent_ / 100;
+        if (shard.dirty_pages_.size() <= max_dirty) {
+            return;
+        }
+        size_t num_to_clean = std::min<size_t>(shard.dirty_pages_.size() - max_dirty, PAGE_CLEANER_BATCH_SIZE);
+        for (auto it = shard.dirty_pages_.begin(); it != shard.dirty_pages_.end() && frames.size() < num_to_clean;) {
+            frame_id_t frame_id = shard.page_table_.at(*it);
+            Page *page = get_frame(shard, frame_id);
+            // 只写回当前没有被使用的冷页面，正在被使用的页面很可能马上再次被修改
+            if (page->pin_count_ > 0 || shard.io_pending_[frame_id]) {
+                ++it;
+                continue;
+            }
+            page->pin_count_++;
+            shard.replacer_->pin(frame_id);
             page->is_dirty_ = false;
+            frames.push_back(frame_id);
+            it = shard.dirty_pages_.erase(it);
+        }
+    }
+
+    // 持有各页面的共享latch直到这一批写回全部完成，不等待被其他线程加了排他latch的页面
+    std::vector<frame_id_t> contended;
+    for (auto it = frames.begin(); it != frames.end();) {
+        if (get_frame(shard, *it)->try_r_latch()) {
+            ++it;
+        } else {
+            contended.push_back(*it);
+            it = frames.erase(it);
+        }
+    }
+    if (!contended.empty()) {
+        std::scoped_lock lock{shard.latch_};
+        for (frame_id_t frame_id : contended) {
+            Page *page = get_frame(shard, frame_id);
+            page->is_dirty_ = true;
+            shard.dirty_pages_.insert(page->id_);
+            unpin_frame(shard, frame_id);
+        }
+    }
+    // 写回失败的页面重新标记为脏页，之后由淘汰或下一轮刷脏再次写回
+    std::unordered_set<frame_id_t> written;
+    std::vector<IoCompletion> completions;
+    std::vector<lsn_t> lsns(frames.size(), INVALID_LSN);
+    try {
+        for (size_t i = 0; i < frames.size(); ++i) {
+            frame_id_t frame_id = frames[i];
+            Page *page = get_frame(shard, frame_id);
+            lsns[i] = flush_log_for(page);
+            disk_manager_->async_write_page(io, page->id_.fd, page->id_.page_no, page->get_data(), page_size_,
+                                            frame_id);
+        }
+        io->submit();
+        io->wait(&completions, frames.size());
+    } catch (RMDBError &) {
+    }
+    for (auto &completion : completions) {
+        if (completion.result == page_size_) {
+            written.insert(static_cast<frame_id_t>(completion.tag));
+        }
+    }
+    for (frame_id_t frame_id : frames) {
+        get_frame(shard, frame_id)->r_unlatch();
+    }
+
+    std::scoped_lock lock{shard.latch_};
+    for (size_t i = 0; i < frames.size(); ++i) {
+        Page *page = get_frame(shard, frames[i]);
+        if (!written.count(frames[i])) {
+            page->is_dirty_ = true;
+            shard.dirty_pages_.insert(page->id_);
+        } else {
+            page->clear_rec_lsn(lsns[i]);
+            record_stat(shard, page->id_.fd, BufferPoolStats::DIRTY_WRITES);
+        }
+        unpin_frame(shard, frames[i]);
+    }
+}
+
+/**
+ * @description: 请求把文件中从first_page_no开始的count个页面异步读入缓冲池，请求交给预读线程后立即返回。
+ *              预读只是性能上的提示：已在缓冲池中的页面会被跳过，缓冲池没有可用帧、请求队列已满或读取失败时放弃预读
+ * @param {int} fd 文件句柄
+ * @param {page_id_t} first_page_no 第一个需要预读的页面
+ * @param {int} count 需要预读的页面个数
+ * @param {shared_ptr<ScanRing>} ring 预读页面装入的环形缓冲区，为空时使用整个缓冲池
+ */
+void BufferPoolManager::prefetch(int fd, page_id_t first_page_no, int count, std::shared_ptr<ScanRing> ring) {
+    if (count <= 0) {
+        return;
+    }
+    {
+        std::scoped_lock lock{prefetch_latch_};
+        if (prefetch_queue_.size() >= PREFETCH_QUEUE_SIZE) {
+            return;
+        }
+        prefetch_queue_.push_back({fd, first_page_no, count, std::move(ring)});
+        if (!prefetch_running_) {
+            prefetch_running_ = true;
+            prefetch_thread_ = std::thread(&BufferPoolManager::run_prefetcher, this);
+        }
+    }
+    prefetch_cv_.notify_all();
+}
+
+/**
+ * @description: 列出缓冲池中的页面，从最先被淘汰的页面到最近使用的页面，被固定的页面排在最后。
+ *              各分片按替换器的淘汰顺序排列，合并时按页面在各自分片中的相对位置交错
+ * @param {vector<PageId>*} pages 缓冲池中的页面
+ */
+void BufferPoolManager::get_resident_pages(std::vector<PageId> *pages) {
+    std::vector<std::pair<double, PageId>> ranked;
+    std::vector<frame_id_t> order;
+    for (auto &shard_ptr : shards_) {
+        BufferPoolShard &shard = *shard_ptr;
+        std::scoped_lock lock{shard.latch_};
+        shard.replacer_->eviction_order(&order);
+        for (frame_id_t frame_id = 0; frame_id < static_cast<frame_id_t>(shard.pool_size_); ++frame_id) {
+            if (get_frame(shard, frame_id)->pin_count_ > 0) {
+                order.push_back(frame_id);
+            }
+        }
+        for (size_t i = 0; i < order.size(); ++i) {
+            Page *page = get_frame(shard, order[i]);
+            if (page->id_.page_no == INVALID_PAGE_ID || shard.io_pending_[order[i]]) {
+                continue;
+            }
+            ranked.emplace_back(static_cast<double>(i + 1) / order.size(), page->id_);
+        }
+    }
+    std::stable_sort(ranked.begin(), ranked.end(),
+                     [](const auto &a, const auto &b) { return a.first < b.first; });
+    pages->clear();
+    for (auto &entry : ranked) {
+        pages->push_back(entry.second);
+    }
+}
+
+/**
+ * @description: 在后台预热缓冲池：把页面按文件和页号排序，页号连续的页面合并成一个预读请求，由预读线程依次读入，
+ *              最后按给出的顺序访问一遍读入的页面，使替换器中的顺序与记录时一致。预热请求不受预读队列长度的限制，
+ *              预热期间顺序扫描的预读提示可能因队列已满被放弃
+ * @param {vector<PageId>} pages 需要预热的页面，从最先被淘汰的到最近使用的；超过缓冲池大小时只预热最近使用的部分
+ */
+void BufferPoolManager::warm_up(std::vector<PageId> pages) {
+    if (pages.size() > pool_size_) {
+        pages.erase(pages.begin(), pages.end() - pool_size_);
+    }
+    if (pages.empty()) {
+        return;
+    }
+    auto order = std::make_shared<std::vector<PageId>>(pages);
+    std::sort(pages.begin(), pages.end());
+    pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+    {
+        std::scoped_lock lock{prefetch_latch_};
+        for (size_t begin = 0; begin < pages.size();) {
+            size_t end = begin + 1;
+            while (end < pages.size() && end - begin < static_cast<size_t>(POOL_WARM_UP_BATCH_PAGES) &&
+                   pages[end].fd == pages[begin].fd && pages[end].page_no == pages[end - 1].page_no + 1) {
+                ++end;
+            }
+            prefetch_queue_.push_back({pages[begin].fd, pages[begin].page_no, static_cast<int>(end - begin), nullptr});
+            begin = end;
+        }
+        prefetch_queue_.push_back({-1, INVALID_PAGE_ID, 0, nullptr, std::move(order)});
+        if (!prefetch_running_) {
+            prefetch_running_ = true;
+            prefetch_thread_ = std::thread(&BufferPoolManager::run_prefetcher, this);
+        }
+    }
+    prefetch_cv_.notify_all();
+}
+
+/**
+ * @description: 按顺序访问在缓冲池中且没有被固定的页面，使它们在替换器中依次成为最近使用的页面；不读取页面，也不计入命中统计
+ * @param {vector<PageId>&} pages 需要访问的页面
+ */
+void BufferPoolManager::touch_pages(const std::vector<PageId> &pages) {
+    for (auto &page_id : pages) {
+        BufferPoolShard &shard = get_shard(page_id);
+        std::scoped_lock lock{shard.latch_};
+        auto it = shard.page_table_.find(page_id);
+        if (it == shard.page_table_.end() || shard.io_pending_[it->second] ||
+            get_frame(shard, it->second)->pin_count_ > 0) {
+            continue;
+        }
+        shard.replacer_->pin(it->second);
+        shard.replacer_->unpin(it->second);
+    }
+}
+
+/**
+ * @description: 预读线程的主循环，依次执行队列中的预读请求
+ */
+void BufferPoolManager::run_prefetcher() {
+    std::unique_lock lock{prefetch_latch_};
+    while (true) {
+        prefetch_cv_.wait(lock, [&] { return !prefetch_running_ || !prefetch_queue_.empty(); });
+        if (!prefetch_running_) {
+            break;
+        }
+        PrefetchRequest request = prefetch_queue_.front();
+        prefetch_queue_.pop_front();
+        prefetch_fd_ = request.fd;
+        lock.unlock();
+        if (request.touch != nullptr) {
+            touch_pages(*request.touch);
+        } else {
+            load_pages(request.fd, request.first_page_no, request.count, request.ring.get());
+        }
+        lock.lock();
+        prefetch_fd_ = -1;
+        prefetch_cv_.notify_all();
+    }
+}
+
+/**
+ * @description: 停止预读线程，丢弃尚未执行的预读请求
+ */
+void BufferPoolManager::stop_prefetcher() {
+    {
+        std::scoped_lock lock{prefetch_latch_};
+        if (!prefetch_running_) {
+            return;
+        }
+        prefetch_running_ = false;
+        prefetch_queue_.clear();
+    }
+    prefetch_cv_.notify_all();
+    prefetch_thread_.join();
+}
+
+/**
+ * @description: 丢弃指定文件上尚未执行的预读请求，并等待该文件上正在进行的预读完成
+ * @param {int} fd 文件句柄
+ */
+void BufferPoolManager::cancel_prefetch(int fd) {
+    std::unique_lock lock{prefetch_latch_};
+    prefetch_queue_.erase(std::remove_if(prefetch_queue_.begin(), prefetch_queue_.end(),
+                                         [fd](const PrefetchRequest &request) { return request.fd == fd; }),
+                          prefetch_queue_.end());
+    prefetch_cv_.wait(lock, [&] { return prefetch_fd_ != fd; });
+}
+
+/**
+ * @description: 同步地把连续的多个页面读入缓冲池。先在各分片中为不在缓冲池中的页面占用帧并固定，
+ *              释放latch后写回被淘汰的脏页，再把页号连续的页面用一次系统调用读入各自的帧，最后解除固定。
+ *              读取期间帧被标记为正在读写，其它线程访问这些页面时会等待读取完成，而不会重复读取
+ * @param {int} fd 文件句柄
+ * @param {page_id_t} first_page_no 第一个页面的页号
+ * @param {int} count 页面个数
+ * @param {ScanRing*} ring 页面装入的环形缓冲区
+ */
+void BufferPoolManager::load_pages(int fd, page_id_t first_page_no, int count, ScanRing *ring) {
+    struct PrefetchFrame {
+        BufferPoolShard *shard = nullptr;  // 为nullptr时表示该页面不需要读取
+        frame_id_t frame_id = INVALID_FRAME_ID;
+        PageId victim_page_id;
+        bool write_back = false;
+    };
+    std::vector<PrefetchFrame> frames(count);
+
+    // 1. 为不在缓冲池中的页面占用帧，缓冲池没有可用帧时不再继续预读
+    for (int i = 0; i < count; ++i) {
+        PageId page_id = {fd, first_page_no + i};
+        BufferPoolShard &shard = get_shard(page_id);
+        std::scoped_lock lock{shard.latch_};
+        if (shard.page_table_.count(page_id) || shard.writing_back_.count(page_id)) {
+            continue;
+        }
+        frame_id_t frame_id;
+        if (!find_victim_page(shard, &frame_id, ring)) {
+            break;
+        }
+        if (ring != nullptr) {
+            ring->frames_[shard.shard_no_].emplace_back(frame_id, page_id);
+        }
+        Page *page = get_frame(shard, frame_id);
+        frames[i].shard = &shard;
+        frames[i].frame_id = frame_id;
+        frames[i].victim_page_id = page->id_;
+        frames[i].write_back = update_page(shard, page, page_id, frame_id);
+        page->pin_count_ = 1;
+        shard.replacer_->pin(frame_id);
+        record_stat(shard, fd, BufferPoolStats::PREFETCHED);
+    }
+
+    auto finish = [&](PrefetchFrame &frame, bool success) {
+        std::scoped_lock lock{frame.shard->latch_};
+        if (success) {
+            finish_page_io(*frame.shard, frame.victim_page_id, frame.write_back, frame.frame_id);
+            unpin_frame(*frame.shard, frame.frame_id);
+        } else {
+            abort_page_io(*frame.shard, frame.victim_page_id, frame.write_back, frame.frame_id);
+        }
+        frame.shard = nullptr;
+    };
+
+    // 2. 写回被淘汰的脏页，写回失败的帧放弃预读
+    for (auto &frame : frames) {
+        if (frame.shard == nullptr || !frame.write_back) {
+            continue;
+        }
+        Page *page = get_frame(*frame.shard, frame.frame_id);
+        try {
+            lsn_t lsn = flush_log_for(page);
+            disk_manager_->write_page(frame.victim_page_id.fd, frame.victim_page_id.page_no, page->get_data(),
+                                      page_size_);
+            page->clear_rec_lsn(lsn);
+        } catch (RMDBError &) {
+            finish(frame, false);
         }
     }
-}
\ No newline at end of file
+
+    // 3. 按页号连续的区间批量读取
+    for (int begin = 0; begin < count;) {
+        if (frames[begin].shard == nullptr) {
+            ++begin;
+            continue;
+        }
+        int end = begin;
+        std::vector<char *> buffers;
+        while (end < count && frames[end].shard != nullptr) {
+            buffers.push_back(get_frame(*frames[end].shard, frames[end].frame_id)->get_data());
+            ++end;
+        }
+        bool success = true;
+        try {
+            disk_manager_->read_pages(fd, first_page_no + begin, buffers);
+        } catch (RMDBError &) {
+            success = false;
+        }
+        for (int i = begin; i < end; ++i) {
+            finish(frames[i], success);
+        }
+        begin = end;
+    }
+}
@@ -12,50 +12,151 @@ See the Mulan PSL v2 for more details. */
 #include <fcntl.h>
 #include <unistd.h>
 
+#include <atomic>
 #include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "disk_manager.h"
 #include "errors.h"
 #include "page.h"
+#include "page_guard.h"
+#include "replacer/arc_replacer.h"
+#include "replacer/clock_replacer.h"
+#include "replacer/lru_k_replacer.h"
 #include "replacer/lru_replacer.h"
 #include "replacer/replacer.h"
 
+/**
+ * @description: 大表顺序扫描使用的环形缓冲区。扫描读入的页面只在环中的帧之间循环替换，
+ * 不会把缓冲池中的热点页面挤出去。环按缓冲池分片划分，每个分片中的部分只在持有该分片latch时访问，
+ * 由BufferPoolManager::create_scan_ring创建
+ */
+class ScanRing {
+    friend class BufferPoolManager;
+
+   public:
+    ScanRing(size_t num_shards, size_t frames_per_shard) : frames_per_shard_(frames_per_shard), frames_(num_shards) {}
+
+   private:
+    size_t frames_per_shard_;  // 环在每个分片中最多占用的帧数
+    std::vector<std::deque<std::pair<frame_id_t, PageId>>> frames_;  // 各分片中环占用的帧及装入时的页面，按装入顺序排列
+};
+
+/**
+ * @description: 缓冲池的统计信息，可以是一个分片、一个文件或整个缓冲池的统计，
+ * 由BufferPoolManager::get_stats、get_shard_stats和get_file_stats汇总得到
+ */
+struct BufferPoolStats {
+    enum Counter {
+        HITS,           // 获取页面时页面已在缓冲池中的次数
+        MISSES,         // 获取页面时需要从磁盘读取的次数
+        EVICTIONS,      // 淘汰帧中已有页面的次数
+        DIRTY_WRITES,   // 把脏页写回磁盘的次数，包括淘汰、刷脏线程和flush
+        PREFETCHED,     // 预读读入的页面个数
+        PIN_WAIT_NS,    // 获取页面时等待其它线程对该页面的磁盘读写完成的总时间，单位为纳秒
+        NUM_COUNTERS
+    };
+
+    uint64_t counters[NUM_COUNTERS] = {};
+    size_t resident_pages = 0;  // 当前在缓冲池中的页面个数
+    size_t dirty_pages = 0;     // 当前在缓冲池中的脏页个数
+
+    uint64_t get(Counter counter) const { return counters[counter]; }
+
+    // 命中率，没有获取过页面时为0
+    double hit_ratio() const {
+        uint64_t accesses = counters[HITS] + counters[MISSES];
+        return accesses == 0 ? 0 : static_cast<double>(counters[HITS]) / accesses;
+    }
+
+    void merge(const BufferPoolStats &other) {
+        for (int i = 0; i < NUM_COUNTERS; ++i) {
+            counters[i] += other.counters[i];
+        }
+        resident_pages += other.resident_pages;
+        dirty_pages += other.dirty_pages;
+    }
+};
+
 class BufferPoolManager {
    private:
+    /**
+     * @description: 缓冲池分片。页面按PageIdHash划分到各个分片，每个分片拥有独立的页表、空闲链表、替换器和latch，
+     * 不同分片上的页面操作互不阻塞。分片内的帧号为分片内的局部编号，对应pages_[frame_offset_ + frame_id]。
+     * 有多个NUMA节点时分片平均分给各节点，分片的帧和页面元数据从所属节点的内存中分配；
+     * 文件的页面按NUMA_EXTENT_PAGES页一段轮流放到各节点的分片中，同一段内再按PageIdHash选择分片
+     */
+    struct BufferPoolShard {
+        size_t pool_size_;          // 分片中帧的个数
+        size_t frame_offset_;       // 分片的第一个帧在pages_中的下标
+        size_t shard_no_;           // 分片在shards_中的下标
+        size_t node_;               // 分片所属的NUMA节点
+        std::unordered_map<PageId, frame_id_t, PageIdHash> page_table_; // 页面到分片内帧号的映射
+        std::list<frame_id_t> free_list_;   // 分片内空闲帧编号的链表
+        Replacer *replacer_;                // 分片内的置换策略，由构造函数的replacer_type指定
+        std::vector<bool> io_pending_;      // 帧是否正在进行磁盘读写，为true时帧中的数据尚不可用
+        std::unordered_set<PageId, PageIdHash> writing_back_;  // 已被淘汰、但脏数据还未写回磁盘的页面
+        std::set<PageId> dirty_pages_;      // 分片中的脏页，按页面顺序排列，供后台刷脏线程按顺序写回
+        std::unordered_set<PageId, PageIdHash> deallocated_;  // 已被释放、但仍被固定的页面，解除固定后丢弃
+        std::mutex latch_;                  // 用于分片内共享数据结构的并发控制，磁盘读写时不持有
+        std::condition_variable io_cv_;     // 用于等待分片内的磁盘读写完成
+        // 分片的统计计数器，在持有latch时更新，读取时不需要latch；各文件的计数器只在持有latch时访问
+        std::atomic<uint64_t> counters_[BufferPoolStats::NUM_COUNTERS]{};
+        std::unordered_map<int, BufferPoolStats> file_stats_;
+    };
+
     size_t pool_size_;      // buffer_pool中可容纳页面的个数，即帧的个数
-    Page *pages_;           // buffer_pool中的Page对象数组，在构造空间中申请内存空间，在析构函数中释放，大小为BUFFER_POOL_SIZE
-    std::unordered_map<PageId, frame_id_t, PageIdHash> page_table_; // 帧号和页面号的映射哈希表，用于根据页面的PageId定位该页面的帧编号
-    std::list<frame_id_t> free_list_;   // 空闲帧编号的链表
+    int page_size_;         // 每个帧的大小，与DiskManager的页面大小一致
+    Page *pages_;           // buffer_pool中的Page对象数组，只保存页面元数据，在构造函数中按节点映射内存，在析构函数中释放，大小为pool_size_
+    size_t pages_size_;     // pages_映射的字节数
+    char *frame_data_;      // 所有帧的页面数据，按PAGE_SIZE对齐的连续内存，尽量使用2MB大页，第i帧的数据位于frame_data_ + i * page_size_
+    size_t frame_data_size_;  // frame_data_映射的字节数
+    bool huge_pages_;       // frame_data_是否成功使用了MAP_HUGETLB大页
+    std::vector<std::unique_ptr<BufferPoolShard>> shards_;  // 缓冲池的各个分片，同一节点的分片相邻
+    size_t num_nodes_;          // 分片分布的NUMA节点数
+    size_t shards_per_node_;    // 每个节点的分片数
+    std::string replacer_type_;  // 各分片使用的置换策略
     DiskManager *disk_manager_;
-    Replacer *replacer_;    // buffer_pool的置换策略，当前赛题中为LRU置换策略
-    std::mutex latch_;      // 用于共享数据结构的并发控制
+    std::function<void(lsn_t)> log_flusher_;    // 写回页面之前持久化日志，为空时不写日志
+
+    // 后台刷脏线程：定期把未被固定的脏页提前写回，使每个分片中至少有clean_percent_%的帧是干净的
+    std::thread cleaner_thread_;
+    std::mutex cleaner_latch_;
+    std::condition_variable cleaner_cv_;
+    bool cleaner_running_ = false;
+    size_t clean_percent_ = PAGE_CLEANER_CLEAN_PERCENT;
+
+    // 预读线程：异步地把顺序扫描即将访问的页面读入缓冲池，第一次调用prefetch时启动
+    struct PrefetchRequest {
+        int fd;
+        page_id_t first_page_no;
+        int count;
+        std::shared_ptr<ScanRing> ring;  // 预读的页面装入的环形缓冲区，为空时使用整个缓冲池
+        std::shared_ptr<std::vector<PageId>> touch;  // 不为空时不读取页面，而是按顺序访问这些页面（预热的最后一步）
+    };
+    std::thread prefetch_thread_;
+    std::mutex prefetch_latch_;
+    std::condition_variable prefetch_cv_;
+    std::deque<PrefetchRequest> prefetch_queue_;
+    bool prefetch_running_ = false;
+    int prefetch_fd_ = -1;  // 预读线程正在读取的文件，没有正在进行的预读时为-1
 
    public:
-    BufferPoolManager(size_t pool_size, DiskManager *disk_manager)
-        : pool_size_(pool_size), disk_manager_(disk_manager) {
-        // 为buffer pool分配一块连续的内存空间
-        pages_ = new Page[pool_size_];
-        // 可以被Replacer改变
-        if (REPLACER_TYPE.compare("LRU"))
-            replacer_ = new LRUReplacer(pool_size_);
-        else if (REPLACER_TYPE.compare("CLOCK"))
-            replacer_ = new LRUReplacer(pool_size_);
-        else {
-            replacer_ = new LRUReplacer(pool_size_);
-        }
-        // 初始化时，所有的page都在free_list_中
-        for (size_t i = 0; i < pool_size_; ++i) {
-            free_list_.emplace_back(static_cast<frame_id_t>(i));  // static_cast转换数据类型
-        }
-    }
+    BufferPoolManager(size_t pool_size, DiskManager *disk_manager, size_t num_shards = BUFFER_POOL_SHARDS,
+                      const std::string &replacer_type = REPLACER_TYPE, size_t num_nodes = NUMA_NODES);
 
-    ~BufferPoolManager() {
-        delete[] pages_;
-        delete replacer_;
-    }
+    ~BufferPoolManager();
 
     /**
      * @description: 将目标页面标记为脏页
@@ -63,8 +164,73 @@ class BufferPoolManager {
      */
     static void mark_dirty(Page* page) { page->is_dirty_ = true; }
 
+    size_t get_pool_size() const { return pool_size_; }
+
+    int get_page_size() const { return page_size_; }
+
+    void set_page_size(int page_size);
+
+    size_t get_num_shards() const { return shards_.size(); }
+
+    size_t get_shard_pool_size(size_t shard_no) const { return shards_.at(shard_no)->pool_size_; }
+
+    size_t get_num_nodes() const { return num_nodes_; }
+
+    size_t get_shard_node(size_t shard_no) const { return shards_.at(shard_no)->node_; }
+
+    /* 页面所在分片所属的NUMA节点，并行扫描把页面交给该节点上的工作线程 */
+    size_t get_page_node(const PageId &page_id) const {
+        return (static_cast<size_t>(page_id.fd) + static_cast<size_t>(page_id.page_no) / NUMA_EXTENT_PAGES) %
+               num_nodes_;
+    }
+
+    bool is_huge_page_backed() const { return huge_pages_; }
+
+    const std::string &get_replacer_type() const { return replacer_type_; }
+
+    size_t get_num_dirty_pages();
+
+    size_t get_num_pins(int fd);
+
+    BufferPoolStats get_stats();
+
+    BufferPoolStats get_shard_stats(size_t shard_no);
+
+    std::map<int, BufferPoolStats> get_file_stats();
+
+    void reset_file_stats(int fd);
+
+    /**
+     * @description: 当前线程获取页面时的命中和未命中次数，EXPLAIN ANALYZE按算子执行前后的差值统计算子访问的页面；
+     * 只累加HITS和MISSES，并行扫描的工作线程访问的页面不计入发起查询的线程
+     */
+    static BufferPoolStats &thread_stats() {
+        static thread_local BufferPoolStats stats;
+        return stats;
+    }
+
+    /**
+     * @description: 设置写回页面之前持久化日志的回调（WAL）：写回修改过的数据页之前，描述这些修改的日志必须已经落盘
+     * @param {function<void(lsn_t)>} log_flusher 持久化日志号不超过参数的全部日志
+     */
+    void set_log_flusher(std::function<void(lsn_t)> log_flusher) { log_flusher_ = std::move(log_flusher); }
+
+    void start_page_cleaner(size_t clean_percent = PAGE_CLEANER_CLEAN_PERCENT);
+
+    void stop_page_cleaner();
+
+    void prefetch(int fd, page_id_t first_page_no, int count, std::shared_ptr<ScanRing> ring = nullptr);
+
+    std::shared_ptr<ScanRing> create_scan_ring(size_t num_frames = SCAN_RING_SIZE);
+
+    void get_resident_pages(std::vector<PageId> *pages);
+
+    void warm_up(std::vector<PageId> pages);
+
    public: 
-    Page* fetch_page(PageId page_id);
+    Page* fetch_page(PageId page_id, ScanRing *ring = nullptr);
+
+    Page* try_fetch_page(PageId page_id);
 
     bool unpin_page(PageId page_id, bool is_dirty);
 
@@ -74,10 +240,73 @@ class BufferPoolManager {
 
     bool delete_page(PageId page_id);
 
-    void flush_all_pages(int fd);
+    void deallocate_page(PageId page_id);
+
+    void flush_all_pages(int fd, bool dirty_only = false);
+
+    void evict_all_pages(int fd);
+
+    ReadPageGuard fetch_page_read(PageId page_id, ScanRing *ring = nullptr);
+
+    WritePageGuard fetch_page_write(PageId page_id);
+
+    WritePageGuard new_page_guarded(PageId* page_id);
+
+    void get_dirty_page_table(std::vector<std::pair<PageId, lsn_t>> *dirty_pages);
 
    private:
-    bool find_victim_page(frame_id_t* frame_id);
+    void allocate_pages();
+
+    void allocate_frames();
+
+    void bind_to_nodes(char *base, size_t size, size_t frame_bytes, size_t align);
+
+    BufferPoolShard &get_shard(const PageId &page_id) {
+        if (num_nodes_ == 1) return *shards_[PageIdHash()(page_id) % shards_.size()];
+        return *shards_[get_page_node(page_id) * shards_per_node_ + PageIdHash()(page_id) % shards_per_node_];
+    }
+
+    Page *get_frame(BufferPoolShard &shard, frame_id_t frame_id) { return &pages_[shard.frame_offset_ + frame_id]; }
+
+    // 累加分片和文件的统计计数器，调用时需持有分片的latch
+    void record_stat(BufferPoolShard &shard, int fd, BufferPoolStats::Counter counter, uint64_t value = 1) {
+        shard.counters_[counter].fetch_add(value, std::memory_order_relaxed);
+        shard.file_stats_[fd].counters[counter] += value;
+    }
+
+    bool find_victim_page(BufferPoolShard &shard, frame_id_t* frame_id, ScanRing *ring = nullptr);
+
+    bool update_page(BufferPoolShard &shard, Page* page, PageId new_page_id, frame_id_t new_frame_id);
+
+    void finish_page_io(BufferPoolShard &shard, PageId victim_page_id, bool write_back, frame_id_t frame_id);
+
+    void abort_page_io(BufferPoolShard &shard, PageId victim_page_id, bool write_back, frame_id_t frame_id);
+
+    /* 写回页面之前先持久化页面上的修改对应的日志，调用时不能持有分片的latch；返回持久化时页面的日志号，
+       写回完成后传给Page::clear_rec_lsn */
+    lsn_t flush_log_for(Page *page) {
+        lsn_t lsn = page->get_wal_lsn();
+        if (log_flusher_ != nullptr && lsn != INVALID_LSN) {
+            log_flusher_(lsn);
+        }
+        return lsn;
+    }
+
+    void unpin_frame(BufferPoolShard &shard, frame_id_t frame_id);
+
+    void discard_frame(BufferPoolShard &shard, frame_id_t frame_id);
+
+    void run_page_cleaner();
+
+    void clean_shard(BufferPoolShard &shard, AsyncIo *io);
+
+    void run_prefetcher();
+
+    void stop_prefetcher();
+
+    void cancel_prefetch(int fd);
+
+    void load_pages(int fd, page_id_t first_page_no, int count, ScanRing *ring);
 
-    void update_page(Page* page, PageId new_page_id, frame_id_t new_frame_id);
+    void touch_pages(const std::vector<PageId> &pages);
 };
\ No newline at end of file
@@ -11,11 +11,39 @@ See the Mulan PSL v2 for more details. */
 #include "storage/disk_manager.h"
 
 #include <assert.h>    // for assert
+#include <stdlib.h>    // for aligned_alloc
 #include <string.h>    // for memset
+#include <limits.h>    // for IOV_MAX
+#include <algorithm>
 #include <sys/stat.h>  // for stat
-#include <unistd.h>    // for lseek
+#include <sys/uio.h>   // for preadv/pwritev
+#include <unistd.h>    // for pread/pwrite
 
 #include "defs.h"
+#include "common/tracepoint.h"
+#include "storage/page_compressor.h"
+
+/**
+ * @description: 判断缓冲区能否直接用于O_DIRECT读写，即地址和长度都按PAGE_SIZE对齐。
+ *              数据库的页面大小总是PAGE_SIZE的整数倍，因此按PAGE_SIZE对齐即可
+ */
+static bool is_direct_io_aligned(const void *buf, size_t len) {
+    return reinterpret_cast<uintptr_t>(buf) % PAGE_SIZE == 0 && len % PAGE_SIZE == 0;
+}
+
+/**
+ * @description: O_DIRECT文件上未对齐的读写使用的中转缓冲区，大小为一个页面
+ */
+struct DirectIoBuffer {
+    char *data;
+    explicit DirectIoBuffer(int page_size) : data(static_cast<char *>(aligned_alloc(PAGE_SIZE, page_size))) {
+        if (data == nullptr) {
+            throw InternalError("DiskManager: failed to allocate direct I/O buffer");
+        }
+        memset(data, 0, page_size);
+    }
+    ~DirectIoBuffer() { free(data); }
+};
 
 DiskManager::DiskManager() { memset(fd2pageno_, 0, MAX_FD * (sizeof(std::atomic<page_id_t>) / sizeof(char))); }
 
@@ -28,23 +56,56 @@ DiskManager::DiskManager() { memset(fd2pageno_, 0, MAX_FD * (sizeof(std::atomic<
  */
 void DiskManager::write_page(int fd, page_id_t page_no, const char *offset, int num_bytes) {
     // Todo:
-    // 1.lseek()定位到文件头，通过(fd,page_no)可以定位指定页面及其在磁盘文件中的偏移量
-    // 2.调用write()函数
+    // 1.通过(fd,page_no)可以定位指定页面及其在磁盘文件中的偏移量
+    // 2.调用pwrite()函数
     // 注意write返回值与num_bytes不等时 throw InternalError("DiskManager::write_page Error");
     
     // 计算页面在文件中的偏移量
-    off_t offset_pos = static_cast<off_t>(page_no) * PAGE_SIZE;
-    
-    // 定位到指定位置
-    if (lseek(fd, offset_pos, SEEK_SET) == -1) {
-        throw UnixError();
+    off_t offset_pos = static_cast<off_t>(page_no) * page_size_;
+    RMDB_TRACE(write_page_start, fd, page_no);
+
+    // 压缩文件：只写页面开头时读出整个页面，覆盖开头的num_bytes个字节后重新压缩写入
+    if (CompressedFile *file = fd2compressed_[fd].get()) {
+        if (num_bytes < page_size_) {
+            std::scoped_lock lock{file->rmw_latch};
+            std::vector<char> page(page_size_, 0);
+            bool exists;
+            {
+                std::scoped_lock map_lock{file->latch};
+                exists = static_cast<size_t>(page_no) < file->slots.size();
+            }
+            if (exists) {
+                read_compressed_page(fd, page_no, page.data(), page_size_);
+            }
+            memcpy(page.data(), offset, num_bytes);
+            write_compressed_pages(fd, page_no, {page.data()});
+        } else {
+            write_compressed_pages(fd, page_no, {offset});
+        }
+        RMDB_TRACE(write_page_done, fd, page_no);
+        return;
     }
     
-    // 写入数据
-    ssize_t bytes_written = write(fd, offset, num_bytes);
+    // O_DIRECT文件上未对齐的写入（如只写文件头）：读出整个页面，覆盖开头的num_bytes个字节后写回整个页面
+    if (fd2direct_[fd] && !is_direct_io_aligned(offset, num_bytes)) {
+        DirectIoBuffer buf(page_size_);
+        if (num_bytes < page_size_ && pread(fd, buf.data, page_size_, offset_pos) < 0) {
+            throw InternalError("DiskManager::write_page Error");
+        }
+        memcpy(buf.data, offset, num_bytes);
+        if (pwrite(fd, buf.data, page_size_, offset_pos) != page_size_) {
+            throw InternalError("DiskManager::write_page Error");
+        }
+        RMDB_TRACE(write_page_done, fd, page_no);
+        return;
+    }
+
+    // 使用pwrite在指定位置写入数据，不改变共享的文件偏移，多个线程可以同时写同一个文件
+    ssize_t bytes_written = pwrite(fd, offset, num_bytes, offset_pos);
     if (bytes_written != num_bytes) {
         throw InternalError("DiskManager::write_page Error");
     }
+    RMDB_TRACE(write_page_done, fd, page_no);
 }
 
 /**
@@ -56,37 +117,586 @@ void DiskManager::write_page(int fd, page_id_t page_no, const char *offset, int
  */
 void DiskManager::read_page(int fd, page_id_t page_no, char *offset, int num_bytes) {
     // Todo:
-    // 1.lseek()定位到文件头，通过(fd,page_no)可以定位指定页面及其在磁盘文件中的偏移量
-    // 2.调用read()函数
+    // 1.通过(fd,page_no)可以定位指定页面及其在磁盘文件中的偏移量
+    // 2.调用pread()函数
     // 注意read返回值与num_bytes不等时，throw InternalError("DiskManager::read_page Error");
     
     // 计算页面在文件中的偏移量
-    off_t offset_pos = static_cast<off_t>(page_no) * PAGE_SIZE;
-    
-    // 定位到指定位置
-    if (lseek(fd, offset_pos, SEEK_SET) == -1) {
-        throw UnixError();
+    off_t offset_pos = static_cast<off_t>(page_no) * page_size_;
+    RMDB_TRACE(read_page_start, fd, page_no);
+
+    if (fd2compressed_[fd] != nullptr) {
+        read_compressed_page(fd, page_no, offset, num_bytes);
+        RMDB_TRACE(read_page_done, fd, page_no);
+        return;
     }
     
-    // 读取数据
-    ssize_t bytes_read = read(fd, offset, num_bytes);
+    // O_DIRECT文件上未对齐的读取：把整个页面读入中转缓冲区后复制需要的部分
+    if (fd2direct_[fd] && !is_direct_io_aligned(offset, num_bytes)) {
+        DirectIoBuffer buf(page_size_);
+        if (pread(fd, buf.data, page_size_, offset_pos) < num_bytes) {
+            throw InternalError("DiskManager::read_page Error");
+        }
+        memcpy(offset, buf.data, num_bytes);
+        RMDB_TRACE(read_page_done, fd, page_no);
+        return;
+    }
+
+    // 使用pread从指定位置读取数据，不改变共享的文件偏移，多个线程可以同时读同一个文件
+    ssize_t bytes_read = pread(fd, offset, num_bytes, offset_pos);
     if (bytes_read != num_bytes) {
         throw InternalError("DiskManager::read_page Error");
     }
+    RMDB_TRACE(read_page_done, fd, page_no);
+}
+
+/**
+ * @description: 把文件中从first_page_no开始的连续多个页面读入内存，一次系统调用读取多个页面，用于预读
+ * @param {int} fd 磁盘文件的文件句柄
+ * @param {page_id_t} first_page_no 第一个页面的编号
+ * @param {vector<char*>&} pages 各页面数据的存放位置，每个位置的大小为页面大小
+ */
+void DiskManager::read_pages(int fd, page_id_t first_page_no, const std::vector<char *> &pages) {
+    if (fd2compressed_[fd] != nullptr) {
+        read_compressed_pages(fd, first_page_no, pages);
+        return;
+    }
+    if (fd2direct_[fd] && !std::all_of(pages.begin(), pages.end(),
+                                       [this](const char *page) { return is_direct_io_aligned(page, page_size_); })) {
+        for (size_t i = 0; i < pages.size(); ++i) {
+            read_page(fd, first_page_no + i, pages[i], page_size_);
+        }
+        return;
+    }
+    std::vector<struct iovec> iov(pages.size());
+    for (size_t i = 0; i < pages.size(); ++i) {
+        iov[i].iov_base = pages[i];
+        iov[i].iov_len = page_size_;
+    }
+    // 单次preadv的iovec个数不能超过IOV_MAX
+    for (size_t i = 0; i < iov.size(); i += IOV_MAX) {
+        int iovcnt = static_cast<int>(std::min<size_t>(IOV_MAX, iov.size() - i));
+        off_t offset_pos = static_cast<off_t>(first_page_no + i) * page_size_;
+        ssize_t bytes_read = preadv(fd, &iov[i], iovcnt, offset_pos);
+        if (bytes_read != static_cast<ssize_t>(iovcnt) * page_size_) {
+            throw InternalError("DiskManager::read_pages Error");
+        }
+    }
+}
+
+/**
+ * @description: 把内存中的多个页面写入文件中从first_page_no开始的连续页面，一次系统调用写入多个页面
+ * @param {int} fd 磁盘文件的文件句柄
+ * @param {page_id_t} first_page_no 第一个页面的编号
+ * @param {vector<const char*>&} pages 各页面的数据，每个页面的大小为页面大小
+ */
+void DiskManager::write_pages(int fd, page_id_t first_page_no, const std::vector<const char *> &pages) {
+    if (fd2compressed_[fd] != nullptr) {
+        write_compressed_pages(fd, first_page_no, pages);
+        return;
+    }
+    if (fd2direct_[fd] && !std::all_of(pages.begin(), pages.end(),
+                                       [this](const char *page) { return is_direct_io_aligned(page, page_size_); })) {
+        for (size_t i = 0; i < pages.size(); ++i) {
+            write_page(fd, first_page_no + i, pages[i], page_size_);
+        }
+        return;
+    }
+    std::vector<struct iovec> iov(pages.size());
+    for (size_t i = 0; i < pages.size(); ++i) {
+        iov[i].iov_base = const_cast<char *>(pages[i]);
+        iov[i].iov_len = page_size_;
+    }
+    for (size_t i = 0; i < iov.size(); i += IOV_MAX) {
+        int iovcnt = static_cast<int>(std::min<size_t>(IOV_MAX, iov.size() - i));
+        off_t offset_pos = static_cast<off_t>(first_page_no + i) * page_size_;
+        ssize_t bytes_written = pwritev(fd, &iov[i], iovcnt, offset_pos);
+        if (bytes_written != static_cast<ssize_t>(iovcnt) * page_size_) {
+            throw InternalError("DiskManager::write_pages Error");
+        }
+    }
 }
 
 /**
- * @description: 分配一个新的页号
+ * @description: 分配一个新的页号。优先复用文件中页号最小的已释放页面，使数据尽量紧凑；
+ *              没有可复用的页面时在文件末尾分配，并以PAGE_EXTENT_SIZE个页面为单位用fallocate预分配磁盘空间，
+ *              避免文件每增长一个页面就修改一次文件系统元数据
  * @return {page_id_t} 分配的新页号
  * @param {int} fd 指定文件的文件句柄
  */
 page_id_t DiskManager::allocate_page(int fd) {
-    // 简单的自增分配策略，指定文件的页面编号加1
     assert(fd >= 0 && fd < MAX_FD);
-    return fd2pageno_[fd]++;
+    std::scoped_lock lock{alloc_latch_};
+    auto it = free_pages_.find(fd);
+    if (it != free_pages_.end() && !it->second.empty()) {
+        page_id_t page_no = *it->second.begin();
+        it->second.erase(it->second.begin());
+        return page_no;
+    }
+    page_id_t page_no = fd2pageno_[fd]++;
+    if (page_no >= fd2prealloc_[fd] && fd2compressed_[fd] == nullptr) {
+        // 预分配失败（如文件系统不支持）不影响正确性，页面写入时文件仍会正常增长。
+        // 压缩文件中页面的位置由映射表决定，不按页号预分配
+        off_t offset = static_cast<off_t>(page_no) * page_size_;
+        if (fallocate(fd, FALLOC_FL_KEEP_SIZE, offset, static_cast<off_t>(PAGE_EXTENT_SIZE) * page_size_) == 0) {
+            fd2prealloc_[fd] = page_no + PAGE_EXTENT_SIZE;
+        }
+    }
+    return page_no;
+}
+
+/**
+ * @description: 撤销一次页号分配，用于分配页号后缓冲池没有可用帧的情况。
+ *              page_no仍是文件最后分配的页号时直接回退，否则把它作为已释放的页面留待复用
+ * @param {int} fd 指定文件的文件句柄
+ * @param {page_id_t} page_no 要撤销的页号
+ */
+void DiskManager::cancel_allocate_page(int fd, page_id_t page_no) {
+    assert(fd >= 0 && fd < MAX_FD);
+    std::scoped_lock lock{alloc_latch_};
+    page_id_t expected = page_no + 1;
+    if (!fd2pageno_[fd].compare_exchange_strong(expected, page_no)) {
+        free_pages_[fd].insert(page_no);
+    }
+}
+
+/**
+ * @description: 释放文件中的一个页面，之后的allocate_page可以复用该页号。调用者需保证页面已不再被使用，
+ *              且缓冲池中已没有该页面
+ * @param {int} fd 指定文件的文件句柄
+ * @param {page_id_t} page_no 要释放的页号
+ */
+void DiskManager::deallocate_page(int fd, page_id_t page_no) {
+    assert(fd >= 0 && fd < MAX_FD);
+    std::scoped_lock lock{alloc_latch_};
+    free_pages_[fd].insert(page_no);
+}
+
+/**
+ * @description: 把文件截断为num_pages个页面，之后从num_pages开始重新分配页号。
+ *              调用者需保证被截断的页面已不再被使用，且缓冲池中已没有这些页面
+ * @param {int} fd 指定文件的文件句柄
+ * @param {int} num_pages 截断后文件的页面个数
+ */
+void DiskManager::truncate_file(int fd, int num_pages) {
+    assert(fd >= 0 && fd < MAX_FD);
+    if (CompressedFile *file = fd2compressed_[fd].get()) {
+        // 压缩文件截断映射表，被截断页面的槽在映射表同步到磁盘之后复用，文件末尾空闲的单元届时截掉
+        std::scoped_lock lock{file->latch};
+        for (size_t page_no = num_pages; page_no < file->slots.size(); ++page_no) {
+            const PageSlot &slot = file->slots[page_no];
+            if (slot.len > 0) {
+                file->pending_free.emplace_back(slot.unit, slot_units(slot));
+            }
+        }
+        if (file->slots.size() > static_cast<size_t>(num_pages)) {
+            file->slots.resize(num_pages);
+        }
+        if (ftruncate(file->map_fd, PMAP_HEADER_SIZE + static_cast<off_t>(num_pages) * sizeof(PageSlot)) == -1) {
+            throw UnixError();
+        }
+    } else if (ftruncate(fd, static_cast<off_t>(num_pages) * page_size_) == -1) {
+        throw UnixError();
+    }
+    set_fd2pageno(fd, num_pages);
+    std::scoped_lock lock{alloc_latch_};
+    fd2prealloc_[fd] = num_pages;
+}
+
+/**
+ * @description: 设置文件已经分配的页面个数。不小于start_page_no的已释放页面会在文件末尾重新分配，
+ *              从空闲页面中移除，避免同一页号被分配两次
+ * @param {int} fd 文件对应的文件句柄
+ * @param {int} start_page_no 已经分配的页面个数，即文件接下来从start_page_no开始分配页面编号
+ */
+void DiskManager::set_fd2pageno(int fd, int start_page_no) {
+    assert(fd >= 0 && fd < MAX_FD);
+    std::scoped_lock lock{alloc_latch_};
+    fd2pageno_[fd] = start_page_no;
+    auto it = free_pages_.find(fd);
+    if (it != free_pages_.end()) {
+        it->second.erase(it->second.lower_bound(start_page_no), it->second.end());
+    }
+}
+
+/**
+ * @description: 获得文件中已释放、可以复用的页面个数
+ * @param {int} fd 指定文件的文件句柄
+ */
+size_t DiskManager::get_num_free_pages(int fd) {
+    std::scoped_lock lock{alloc_latch_};
+    auto it = free_pages_.find(fd);
+    return it == free_pages_.end() ? 0 : it->second.size();
+}
+
+/**
+ * @description: 打开文件时读取其空闲页面文件。空闲页面文件的格式为：magic、是否正常关闭的标记、位图的字节数，
+ *              随后是已释放页面的位图。文件打开期间标记被清除，数据库异常退出后再次打开时，
+ *              空闲页面文件可能已过时，复用其中的页面可能覆盖正在使用的页面，因此丢弃它（只会浪费这些页面）。
+ *              调用时需持有files_latch_
+ * @param {int} fd 文件句柄
+ * @param {string&} path 文件路径
+ */
+void DiskManager::load_free_pages(int fd, const std::string &path) {
+    std::string fsm_path = path + FSM_SUFFIX;
+    std::set<page_id_t> free_pages;
+    int fsm_fd = open(fsm_path.c_str(), O_RDWR);
+    if (fsm_fd == -1) {
+        // 从未释放过页面的文件没有空闲页面文件
+        return;
+    }
+    uint32_t header[3];
+    if (pread(fsm_fd, header, sizeof(header), 0) == sizeof(header) && header[0] == FSM_MAGIC && header[1] == 1) {
+        std::vector<unsigned char> bitmap(header[2]);
+        if (pread(fsm_fd, bitmap.data(), bitmap.size(), sizeof(header)) == static_cast<ssize_t>(bitmap.size())) {
+            for (size_t i = 0; i < bitmap.size() * 8; ++i) {
+                if (bitmap[i / 8] & (1 << (i % 8))) {
+                    free_pages.insert(static_cast<page_id_t>(i));
+                }
+            }
+        }
+    }
+    // 清除正常关闭的标记，直到文件再次正常关闭
+    uint32_t opened[3] = {FSM_MAGIC, 0, 0};
+    ssize_t ret = pwrite(fsm_fd, opened, sizeof(opened), 0);
+    close(fsm_fd);
+    if (ret != sizeof(opened)) {
+        throw UnixError();
+    }
+    std::scoped_lock lock{alloc_latch_};
+    free_pages_[fd] = std::move(free_pages);
+}
+
+/**
+ * @description: 关闭文件时把已释放的页面保存到空闲页面文件中，并标记为正常关闭，调用时需持有files_latch_
+ * @param {int} fd 文件句柄
+ * @param {string&} path 文件路径
+ */
+void DiskManager::save_free_pages(int fd, const std::string &path) {
+    std::set<page_id_t> free_pages;
+    {
+        std::scoped_lock lock{alloc_latch_};
+        auto it = free_pages_.find(fd);
+        if (it != free_pages_.end()) {
+            free_pages = std::move(it->second);
+            free_pages_.erase(it);
+        }
+        fd2prealloc_[fd] = 0;
+    }
+    std::string fsm_path = path + FSM_SUFFIX;
+    if (free_pages.empty() && !is_file(fsm_path)) {
+        return;
+    }
+    std::vector<unsigned char> bitmap(free_pages.empty() ? 0 : *free_pages.rbegin() / 8 + 1, 0);
+    for (page_id_t page_no : free_pages) {
+        bitmap[page_no / 8] |= 1 << (page_no % 8);
+    }
+    uint32_t header[3] = {FSM_MAGIC, 1, static_cast<uint32_t>(bitmap.size())};
+    int fsm_fd = open(fsm_path.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    if (fsm_fd == -1) {
+        throw UnixError();
+    }
+    // 先写位图再写标记，写位图的过程中异常退出，下次打开时空闲页面文件不会被使用
+    bool ok = pwrite(fsm_fd, bitmap.data(), bitmap.size(), sizeof(header)) == static_cast<ssize_t>(bitmap.size()) &&
+              fsync(fsm_fd) == 0 && pwrite(fsm_fd, header, sizeof(header), 0) == sizeof(header);
+    close(fsm_fd);
+    if (!ok) {
+        throw UnixError();
+    }
+}
+
+/**
+ * @description: 打开压缩文件时读入映射表。映射表文件的开头是magic、页面大小和单元大小，
+ *              随后按页号依次是各页面的槽。映射表没有引用的单元都可以复用，包括故障前写入了数据、
+ *              但还没来得及写入映射表的槽。调用时需持有files_latch_
+ * @param {int} fd 文件句柄
+ * @param {string&} path 文件路径
+ */
+void DiskManager::load_page_map(int fd, const std::string &path) {
+    std::string map_path = path + PMAP_SUFFIX;
+    int map_fd = open(map_path.c_str(), O_RDWR);
+    if (map_fd == -1) {
+        throw UnixError();
+    }
+    auto file = std::make_unique<CompressedFile>();
+    file->map_fd = map_fd;
+    struct stat stat_buf;
+    uint32_t header[4];
+    bool ok = fstat(map_fd, &stat_buf) == 0 && pread(map_fd, header, sizeof(header), 0) == sizeof(header) &&
+              header[0] == PMAP_MAGIC && header[1] == static_cast<uint32_t>(page_size_) &&
+              header[2] == static_cast<uint32_t>(COMPRESSED_PAGE_UNIT);
+    if (ok) {
+        // 末尾只写了一部分的槽（故障时）忽略，对应的页面从未写入过
+        size_t num_slots = (stat_buf.st_size - PMAP_HEADER_SIZE) / sizeof(PageSlot);
+        file->slots.resize(num_slots);
+        ssize_t size = static_cast<ssize_t>(num_slots * sizeof(PageSlot));
+        ok = pread(map_fd, file->slots.data(), size, PMAP_HEADER_SIZE) == size;
+    }
+    std::vector<std::pair<uint32_t, uint32_t>> used;
+    for (const PageSlot &slot : file->slots) {
+        if (slot.len > static_cast<uint32_t>(page_size_)) {
+            ok = false;
+        } else if (slot.len > 0) {
+            used.emplace_back(slot.unit, slot_units(slot));
+        }
+    }
+    if (!ok) {
+        close(map_fd);
+        throw InternalError("DiskManager: invalid page map " + map_path);
+    }
+    std::sort(used.begin(), used.end());
+    for (auto &[unit, num_units] : used) {
+        if (unit > file->end_unit) {
+            file->free_units.emplace(file->end_unit, unit - file->end_unit);
+        }
+        file->end_unit = std::max(file->end_unit, unit + num_units);
+    }
+    fd2compressed_[fd] = std::move(file);
+}
+
+/**
+ * @description: 在压缩文件中分配连续的num_units个单元，优先复用最靠前的足够大的空闲区间，
+ *              没有时在文件末尾分配。调用时需持有file.latch
+ * @return {uint32_t} 分配的第一个单元
+ */
+uint32_t DiskManager::allocate_units(CompressedFile &file, uint32_t num_units) {
+    for (auto it = file.free_units.begin(); it != file.free_units.end(); ++it) {
+        if (it->second >= num_units) {
+            uint32_t unit = it->first;
+            if (it->second > num_units) {
+                file.free_units.emplace(unit + num_units, it->second - num_units);
+            }
+            file.free_units.erase(it);
+            return unit;
+        }
+    }
+    uint32_t unit = file.end_unit;
+    file.end_unit += num_units;
+    return unit;
+}
+
+/**
+ * @description: 压缩一个页面。压缩后至少节省一个单元时保存压缩结果，否则原样保存
+ * @return {int} buf中的字节数，为页面大小时表示没有压缩
+ * @param {char*} page 页面数据
+ * @param {char*} buf 结果的存放位置，大小为页面大小
+ */
+int DiskManager::compress_page(const char *page, char *buf) {
+    int len = lz4_compress(page, page_size_, buf, page_size_ - COMPRESSED_PAGE_UNIT);
+    if (len == 0) {
+        memcpy(buf, page, page_size_);
+        len = page_size_;
+    }
+    return len;
+}
+
+/**
+ * @description: 把一个槽中的数据还原为页面，只需要页面的开头时取出前num_bytes个字节
+ */
+void DiskManager::decompress_page(const char *data, const PageSlot &slot, char *offset, int num_bytes) {
+    if (slot.len == static_cast<uint32_t>(page_size_)) {
+        memcpy(offset, data, num_bytes);
+        return;
+    }
+    if (num_bytes == page_size_) {
+        if (!lz4_decompress(data, slot.len, offset, page_size_)) {
+            throw InternalError("DiskManager: corrupted compressed page");
+        }
+        return;
+    }
+    std::vector<char> page(page_size_);
+    if (!lz4_decompress(data, slot.len, page.data(), page_size_)) {
+        throw InternalError("DiskManager: corrupted compressed page");
+    }
+    memcpy(offset, page.data(), num_bytes);
+}
+
+/**
+ * @description: 读取压缩文件中的一个页面，只读取槽中的压缩数据。读取期间页面被重写、
+ *              旧的槽被复用时，映射表中的槽已经改变，重新读取
+ */
+void DiskManager::read_compressed_page(int fd, page_id_t page_no, char *offset, int num_bytes) {
+    CompressedFile &file = *fd2compressed_[fd];
+    std::vector<char> buf(page_size_);
+    PageSlot slot;
+    while (true) {
+        {
+            std::scoped_lock lock{file.latch};
+            if (page_no < 0 || static_cast<size_t>(page_no) >= file.slots.size()) {
+                throw InternalError("DiskManager::read_page Error");
+            }
+            slot = file.slots[page_no];
+        }
+        if (slot.len == 0) {
+            // 与未压缩的文件中间的空洞一样，没有写入过的页面读出全0
+            memset(offset, 0, num_bytes);
+            return;
+        }
+        off_t offset_pos = static_cast<off_t>(slot.unit) * COMPRESSED_PAGE_UNIT;
+        if (pread(fd, buf.data(), slot.len, offset_pos) != static_cast<ssize_t>(slot.len)) {
+            throw InternalError("DiskManager::read_page Error");
+        }
+        std::scoped_lock lock{file.latch};
+        const PageSlot &current = file.slots[page_no];
+        if (current.unit == slot.unit && current.len == slot.len) {
+            break;
+        }
+    }
+    decompress_page(buf.data(), slot, offset, num_bytes);
+}
+
+/**
+ * @description: 读取压缩文件中连续的多个页面。顺序写入的页面的槽在文件中通常也是连续的，
+ *              相邻的槽用一次pread读取，顺序扫描读取的字节数约为未压缩时除以压缩比
+ */
+void DiskManager::read_compressed_pages(int fd, page_id_t first_page_no, const std::vector<char *> &pages) {
+    CompressedFile &file = *fd2compressed_[fd];
+    std::vector<PageSlot> slots;
+    {
+        std::scoped_lock lock{file.latch};
+        if (first_page_no >= 0 && static_cast<size_t>(first_page_no) + pages.size() <= file.slots.size()) {
+            slots.assign(file.slots.begin() + first_page_no, file.slots.begin() + first_page_no + pages.size());
+        }
+    }
+    if (slots.empty() || std::any_of(slots.begin(), slots.end(), [](const PageSlot &slot) { return slot.len == 0; })) {
+        for (size_t i = 0; i < pages.size(); ++i) {
+            read_compressed_page(fd, first_page_no + i, pages[i], page_size_);
+        }
+        return;
+    }
+    std::vector<char> buf;
+    for (size_t begin = 0, end; begin < slots.size(); begin = end) {
+        uint32_t next_unit = slots[begin].unit + slot_units(slots[begin]);
+        for (end = begin + 1; end < slots.size() && slots[end].unit == next_unit; ++end) {
+            next_unit += slot_units(slots[end]);
+        }
+        size_t size = static_cast<size_t>(slots[end - 1].unit - slots[begin].unit) * COMPRESSED_PAGE_UNIT +
+                      slots[end - 1].len;
+        buf.resize(size);
+        off_t offset_pos = static_cast<off_t>(slots[begin].unit) * COMPRESSED_PAGE_UNIT;
+        if (pread(fd, buf.data(), size, offset_pos) != static_cast<ssize_t>(size)) {
+            throw InternalError("DiskManager::read_pages Error");
+        }
+        for (size_t i = begin; i < end; ++i) {
+            size_t pos = static_cast<size_t>(slots[i].unit - slots[begin].unit) * COMPRESSED_PAGE_UNIT;
+            decompress_page(buf.data() + pos, slots[i], pages[i], page_size_);
+        }
+    }
+    // 读取期间被重写的页面单独重新读取
+    std::vector<size_t> changed;
+    {
+        std::scoped_lock lock{file.latch};
+        for (size_t i = 0; i < slots.size(); ++i) {
+            const PageSlot &current = file.slots[first_page_no + i];
+            if (current.unit != slots[i].unit || current.len != slots[i].len) {
+                changed.push_back(i);
+            }
+        }
+    }
+    for (size_t i : changed) {
+        read_compressed_page(fd, first_page_no + i, pages[i], page_size_);
+    }
 }
 
-void DiskManager::deallocate_page(__attribute__((unused)) page_id_t page_id) {}
+/**
+ * @description: 把多个页面压缩后写入压缩文件中从first_page_no开始的连续页面。各页面的槽连续分配，
+ *              用一次pwrite写入，再一次写入它们在映射表中的槽。新的槽总是另外分配，
+ *              写入过程中故障时映射表仍引用完好的旧槽；旧槽在映射表同步到磁盘之后才能复用
+ */
+void DiskManager::write_compressed_pages(int fd, page_id_t first_page_no, const std::vector<const char *> &pages) {
+    CompressedFile &file = *fd2compressed_[fd];
+    std::vector<char> buf(pages.size() * page_size_, 0);
+    std::vector<PageSlot> slots(pages.size());
+    uint32_t num_units = 0;
+    for (size_t i = 0; i < pages.size(); ++i) {
+        slots[i].unit = num_units;
+        slots[i].len = compress_page(pages[i], buf.data() + static_cast<size_t>(num_units) * COMPRESSED_PAGE_UNIT);
+        num_units += slot_units(slots[i]);
+    }
+    uint32_t first_unit;
+    {
+        std::scoped_lock lock{file.latch};
+        first_unit = allocate_units(file, num_units);
+    }
+    ssize_t size = static_cast<ssize_t>(num_units) * COMPRESSED_PAGE_UNIT;
+    if (pwrite(fd, buf.data(), size, static_cast<off_t>(first_unit) * COMPRESSED_PAGE_UNIT) != size) {
+        std::scoped_lock lock{file.latch};
+        file.pending_free.emplace_back(first_unit, num_units);
+        throw InternalError("DiskManager::write_page Error");
+    }
+    for (PageSlot &slot : slots) {
+        slot.unit += first_unit;
+    }
+    std::scoped_lock lock{file.latch};
+    ssize_t map_size = static_cast<ssize_t>(slots.size() * sizeof(PageSlot));
+    off_t map_pos = PMAP_HEADER_SIZE + static_cast<off_t>(first_page_no) * sizeof(PageSlot);
+    if (pwrite(file.map_fd, slots.data(), map_size, map_pos) != map_size) {
+        file.pending_free.emplace_back(first_unit, num_units);
+        throw InternalError("DiskManager::write_page Error");
+    }
+    if (file.slots.size() < first_page_no + slots.size()) {
+        file.slots.resize(first_page_no + slots.size(), PageSlot{0, 0});
+    }
+    for (size_t i = 0; i < slots.size(); ++i) {
+        PageSlot &old = file.slots[first_page_no + i];
+        if (old.len > 0) {
+            file.pending_free.emplace_back(old.unit, slot_units(old));
+        }
+        old = slots[i];
+    }
+}
+
+/**
+ * @description: 映射表同步到磁盘之后复用released中的单元，并截掉文件末尾空闲的单元
+ */
+void DiskManager::reclaim_units(int fd, CompressedFile &file,
+                                const std::vector<std::pair<uint32_t, uint32_t>> &released) {
+    std::scoped_lock lock{file.latch};
+    for (auto [unit, num_units] : released) {
+        // 与前后相邻的空闲区间合并
+        auto next = file.free_units.lower_bound(unit);
+        if (next != file.free_units.end() && unit + num_units == next->first) {
+            num_units += next->second;
+            next = file.free_units.erase(next);
+        }
+        if (next != file.free_units.begin() && std::prev(next)->first + std::prev(next)->second == unit) {
+            std::prev(next)->second += num_units;
+        } else {
+            file.free_units.emplace(unit, num_units);
+        }
+    }
+    uint32_t end_unit = file.end_unit;
+    while (!file.free_units.empty()) {
+        auto last = std::prev(file.free_units.end());
+        if (last->first + last->second != file.end_unit) {
+            break;
+        }
+        file.end_unit = last->first;
+        file.free_units.erase(last);
+    }
+    if (file.end_unit < end_unit) {
+        // 截断失败不影响正确性，末尾的单元之后仍会被重新分配
+        int ret = ftruncate(fd, static_cast<off_t>(file.end_unit) * COMPRESSED_PAGE_UNIT);
+        (void)ret;
+    }
+}
+
+/**
+ * @description: 获得压缩文件中页面数据占用的字节数，未压缩的文件返回0
+ * @param {int} fd 文件句柄
+ */
+size_t DiskManager::get_compressed_size(int fd) {
+    CompressedFile *file = fd2compressed_[fd].get();
+    if (file == nullptr) {
+        return 0;
+    }
+    std::scoped_lock lock{file->latch};
+    size_t size = 0;
+    for (const PageSlot &slot : file->slots) {
+        size += static_cast<size_t>(slot_units(slot)) * COMPRESSED_PAGE_UNIT;
+    }
+    return size;
+}
 
 bool DiskManager::is_dir(const std::string& path) {
     struct stat st;
@@ -123,8 +733,9 @@ bool DiskManager::is_file(const std::string &path) {
  * @description: 用于创建指定路径文件
  * @return {*}
  * @param {string} &path
+ * @param {bool} compressed 是否创建压缩文件，压缩文件同时创建它的映射表文件
  */
-void DiskManager::create_file(const std::string &path) {
+void DiskManager::create_file(const std::string &path, bool compressed) {
     // Todo:
     // 调用open()函数，使用O_CREAT模式
     // 注意不能重复创建相同文件
@@ -144,6 +755,26 @@ void DiskManager::create_file(const std::string &path) {
     if (close(fd) == -1) {
         throw UnixError();
     }
+
+    // 是否压缩由映射表文件是否存在决定，创建未压缩的文件时删除残留的映射表文件
+    std::string map_path = path + PMAP_SUFFIX;
+    if (!compressed) {
+        if (is_file(map_path) && unlink(map_path.c_str()) == -1) {
+            throw UnixError();
+        }
+        return;
+    }
+    uint32_t header[4] = {PMAP_MAGIC, static_cast<uint32_t>(page_size_), static_cast<uint32_t>(COMPRESSED_PAGE_UNIT),
+                          0};
+    int map_fd = open(map_path.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (map_fd == -1) {
+        throw UnixError();
+    }
+    bool ok = pwrite(map_fd, header, sizeof(header), 0) == sizeof(header);
+    close(map_fd);
+    if (!ok) {
+        throw UnixError();
+    }
 }
 
 /**
@@ -161,14 +792,21 @@ void DiskManager::destroy_file(const std::string &path) {
     }
     
     // 检查文件是否在打开列表中
+    std::scoped_lock lock{files_latch_};
     if (path2fd_.count(path)) {
         throw FileNotClosedError(path);
     }
     
-    // 删除文件
+    // 删除文件及其空闲页面文件、映射表文件
     if (unlink(path.c_str()) == -1) {
         throw UnixError();
     }
+    for (const char *suffix : {FSM_SUFFIX, PMAP_SUFFIX}) {
+        std::string sidecar_path = path + suffix;
+        if (is_file(sidecar_path) && unlink(sidecar_path.c_str()) == -1) {
+            throw UnixError();
+        }
+    }
 }
 
 
@@ -182,7 +820,8 @@ int DiskManager::open_file(const std::string &path) {
     // 调用open()函数，使用O_RDWR模式
     // 注意不能重复打开相同文件，并且需要更新文件打开列表
     
-    // 检查文件是否已经打开
+    // 检查文件是否已经打开，同一文件被并发打开时只会打开一次
+    std::scoped_lock lock{files_latch_};
     if (path2fd_.count(path)) {
         return path2fd_[path];
     }
@@ -192,15 +831,40 @@ int DiskManager::open_file(const std::string &path) {
         throw FileNotFoundError(path);
     }
     
-    // 打开文件
-    int fd = open(path.c_str(), O_RDWR);
+    // 打开文件。O_DIRECT模式下数据文件绕过页缓存打开，文件系统不支持O_DIRECT时退回普通模式；
+    // 日志文件总是普通模式，压缩文件中槽的长度不按页面对齐，也使用普通模式
+    int fd = -1;
+    bool compressed = path != LOG_FILE_NAME && is_file(path + PMAP_SUFFIX);
+    bool direct = direct_io_ && path != LOG_FILE_NAME && !compressed;
+    if (direct) {
+        fd = open(path.c_str(), O_RDWR | O_DIRECT);
+        direct = fd != -1;
+    }
+    if (fd == -1) {
+        fd = open(path.c_str(), O_RDWR);
+    }
     if (fd == -1) {
         throw UnixError();
     }
+    // 按文件描述符索引的数组只有MAX_FD项，打开的文件太多时拒绝打开
+    if (fd >= MAX_FD) {
+        close(fd);
+        throw InternalError("DiskManager::open_file: too many open files");
+    }
     
-    // 更新文件打开列表
+    // 读入压缩文件的映射表，更新文件打开列表，读入文件的空闲页面
+    if (compressed) {
+        try {
+            load_page_map(fd, path);
+        } catch (RMDBError &) {
+            close(fd);
+            throw;
+        }
+    }
     path2fd_[path] = fd;
     fd2path_[fd] = path;
+    fd2direct_[fd] = direct;
+    load_free_pages(fd, path);
     
     return fd;
 }
@@ -215,12 +879,25 @@ void DiskManager::close_file(int fd) {
     // 注意不能关闭未打开的文件，并且需要更新文件打开列表
     
     // 检查文件是否已打开
+    std::scoped_lock lock{files_latch_};
     if (!fd2path_.count(fd)) {
         throw FileNotOpenError(fd);
     }
     
-    // 获取文件路径
+    // 获取文件路径，保存文件的空闲页面
     std::string path = fd2path_[fd];
+    save_free_pages(fd, path);
+
+    // 压缩文件关闭前同步数据和映射表，再次打开时映射表没有引用的旧槽会被直接复用；同步后截掉文件末尾空闲的单元
+    bool synced = true;
+    if (CompressedFile *file = fd2compressed_[fd].get()) {
+        synced = fdatasync(fd) == 0 && fdatasync(file->map_fd) == 0;
+        if (synced) {
+            reclaim_units(fd, *file, std::vector<std::pair<uint32_t, uint32_t>>(file->pending_free));
+        }
+        close(file->map_fd);
+        fd2compressed_[fd].reset();
+    }
     
     // 关闭文件
     if (close(fd) == -1) {
@@ -228,8 +905,12 @@ void DiskManager::close_file(int fd) {
     }
     
     // 更新文件打开列表
+    fd2direct_[fd] = false;
     fd2path_.erase(fd);
     path2fd_.erase(path);
+    if (!synced) {
+        throw InternalError("DiskManager::close_file: failed to sync " + path);
+    }
 }
 
 
@@ -250,6 +931,7 @@ int DiskManager::get_file_size(const std::string &file_name) {
  * @param {int} fd 文件句柄
  */
 std::string DiskManager::get_file_name(int fd) {
+    std::scoped_lock lock{files_latch_};
     if (!fd2path_.count(fd)) {
         throw FileNotOpenError(fd);
     }
@@ -262,10 +944,14 @@ std::string DiskManager::get_file_name(int fd) {
  * @param {string} &file_name 文件名
  */
 int DiskManager::get_file_fd(const std::string &file_name) {
-    if (!path2fd_.count(file_name)) {
-        return open_file(file_name);
+    {
+        std::scoped_lock lock{files_latch_};
+        auto it = path2fd_.find(file_name);
+        if (it != path2fd_.end()) {
+            return it->second;
+        }
     }
-    return path2fd_[file_name];
+    return open_file(file_name);
 }
 
 
@@ -274,41 +960,253 @@ int DiskManager::get_file_fd(const std::string &file_name) {
  * @return {int} 返回读取的数据量，若为-1说明读取数据的起始位置超过了文件大小
  * @param {char} *log_data 读取内容到log_data中
  * @param {int} size 读取的数据量大小
- * @param {int} offset 读取的内容在文件中的位置
+ * @param {off_t} offset 读取的内容在文件中的位置
  */
-int DiskManager::read_log(char *log_data, int size, int offset) {
+int DiskManager::read_log(char *log_data, int size, off_t offset) {
     // read log file from the previous end
-    if (log_fd_ == -1) {
-        log_fd_ = open_file(LOG_FILE_NAME);
+    {
+        std::scoped_lock lock{log_latch_};
+        if (log_fd_ == -1) {
+            log_fd_ = open_file(LOG_FILE_NAME);
+        }
     }
-    int file_size = get_file_size(LOG_FILE_NAME);
+    struct stat stat_buf;
+    if (fstat(log_fd_, &stat_buf) != 0) {
+        throw UnixError();
+    }
+    off_t file_size = stat_buf.st_size;
     if (offset > file_size) {
         return -1;
     }
 
-    size = std::min(size, file_size - offset);
+    size = static_cast<int>(std::min<off_t>(size, file_size - offset));
     if(size == 0) return 0;
-    lseek(log_fd_, offset, SEEK_SET);
-    ssize_t bytes_read = read(log_fd_, log_data, size);
-    assert(bytes_read == size);
+    ssize_t bytes_read = pread(log_fd_, log_data, size, offset);
+    if (bytes_read != size) {
+        throw UnixError();
+    }
     return bytes_read;
 }
 
 
 /**
  * @description: 写日志内容
+ * @return {off_t} 日志内容在日志文件中的起始位置
  * @param {char} *log_data 要写入的日志内容
  * @param {int} size 要写入的内容大小
  */
-void DiskManager::write_log(char *log_data, int size) {
+off_t DiskManager::write_log(char *log_data, int size) {
+    // write from the file_end
+    off_t offset = reserve_log_space(size);
+    ssize_t bytes_write = pwrite(log_fd_, log_data, size, offset);
+    if (bytes_write != size) {
+        throw UnixError();
+    }
+    return offset;
+}
+
+/**
+ * @description: 把已经写入日志文件的内容持久化到磁盘，只同步数据，不等待文件的元数据
+ */
+void DiskManager::sync_log() {
+    if (log_fd_ == -1) {
+        return;
+    }
+    if (fdatasync(log_fd_) != 0) {
+        throw UnixError();
+    }
+}
+
+/**
+ * @description: 在日志文件末尾为一次追加预留空间，同步和异步的日志追加都通过它确定写入位置，互不覆盖
+ * @return {off_t} 预留空间在日志文件中的起始位置
+ * @param {int} size 追加的内容大小
+ */
+off_t DiskManager::reserve_log_space(int size) {
+    std::scoped_lock lock{log_latch_};
     if (log_fd_ == -1) {
         log_fd_ = open_file(LOG_FILE_NAME);
     }
+    if (log_end_ < 0) {
+        log_end_ = lseek(log_fd_, 0, SEEK_END);
+        if (log_end_ < 0) {
+            throw UnixError();
+        }
+    }
+    off_t offset = log_end_;
+    log_end_ += size;
+    return offset;
+}
 
-    // write from the file_end
-    lseek(log_fd_, 0, SEEK_END);
-    ssize_t bytes_write = write(log_fd_, log_data, size);
-    if (bytes_write != size) {
+/**
+ * @description: 截断日志文件末尾不完整的日志（故障时只写了一部分的日志），之后的追加从size处开始
+ * @param {off_t} size 日志文件中完整日志的长度
+ */
+void DiskManager::truncate_log(off_t size) {
+    std::scoped_lock lock{log_latch_};
+    if (log_fd_ == -1) {
+        log_fd_ = open_file(LOG_FILE_NAME);
+    }
+    if (ftruncate(log_fd_, size) != 0 || fdatasync(log_fd_) != 0) {
         throw UnixError();
     }
-}
\ No newline at end of file
+    log_end_ = size;
+}
+
+/**
+ * @description: 丢弃日志文件中end之前的内容（检查点之后故障恢复不再需要的日志）。按文件系统块打洞释放磁盘空间，
+ *              文件长度和之后日志的位置都不变，文件系统不支持打洞时保留这些日志
+ * @param {off_t} end 需要保留的第一条日志在日志文件中的位置
+ */
+void DiskManager::discard_log(off_t end) {
+    std::scoped_lock lock{log_latch_};
+    if (log_fd_ == -1) {
+        return;
+    }
+    struct stat stat_buf;
+    if (fstat(log_fd_, &stat_buf) != 0) {
+        throw UnixError();
+    }
+    off_t block_size = std::max<off_t>(stat_buf.st_blksize, 1);
+    end -= end % block_size;
+    if (end > 0) {
+        fallocate(log_fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, 0, end);
+    }
+}
+
+/**
+ * @description: 持久化主记录（最近一次检查点的位置）：先写入临时文件并同步，再原子地替换原来的主记录，
+ *              故障时要么是旧的主记录，要么是新的主记录
+ * @param {char} *data 主记录的内容
+ * @param {int} size 主记录的大小
+ */
+void DiskManager::write_log_master(const char *data, int size) {
+    std::string tmp_name = LOG_MASTER_FILE_NAME + ".tmp";
+    int fd = open(tmp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        throw UnixError();
+    }
+    bool ok = write(fd, data, size) == size && fsync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmp_name.c_str(), LOG_MASTER_FILE_NAME.c_str()) != 0) {
+        throw UnixError();
+    }
+}
+
+/**
+ * @description: 读取主记录
+ * @return {int} 读取的数据量，还没有做过检查点时返回-1
+ * @param {char} *data 读取内容到data中
+ * @param {int} size 主记录的大小
+ */
+int DiskManager::read_log_master(char *data, int size) {
+    int fd = open(LOG_MASTER_FILE_NAME.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t bytes_read = read(fd, data, size);
+    close(fd);
+    return static_cast<int>(bytes_read);
+}
+
+/**
+ * @description: 把所有打开的文件已经写入的内容持久化到磁盘，检查点确认脏页已经写回之前调用。
+ *              压缩文件同时同步映射表，同步之前被替换的旧槽从此可以复用
+ */
+void DiskManager::sync_all_files() {
+    std::scoped_lock lock{files_latch_};
+    for (auto &[fd, path] : fd2path_) {
+        CompressedFile *file = fd2compressed_[fd].get();
+        std::vector<std::pair<uint32_t, uint32_t>> released;
+        if (file != nullptr) {
+            std::scoped_lock file_lock{file->latch};
+            released.swap(file->pending_free);
+        }
+        if (fdatasync(fd) != 0 || (file != nullptr && fdatasync(file->map_fd) != 0)) {
+            throw UnixError();
+        }
+        if (file != nullptr) {
+            reclaim_units(fd, *file, released);
+        }
+    }
+}
+
+/**
+ * @description: 准备一个异步的页面读取请求，需调用io->submit()提交，完成结果通过io->wait()获得
+ * @param {AsyncIo*} io 异步读写对象
+ * @param {int} fd 磁盘文件的文件句柄
+ * @param {page_id_t} page_no 指定的页面编号
+ * @param {char} *offset 读取的内容写入到offset中，请求完成前不能释放
+ * @param {int} num_bytes 读取的数据量大小
+ * @param {uint64_t} tag 请求的标识，原样出现在完成结果中
+ */
+void DiskManager::async_read_page(AsyncIo *io, int fd, page_id_t page_no, char *offset, int num_bytes,
+                                  uint64_t tag) {
+    // 压缩文件中槽的位置和长度要查映射表，同步读取后直接放入完成结果
+    if (fd2compressed_[fd] != nullptr) {
+        int result = num_bytes;
+        try {
+            read_page(fd, page_no, offset, num_bytes);
+        } catch (RMDBError &) {
+            result = -EIO;
+        }
+        io->complete(tag, result);
+        return;
+    }
+    io->prep_read(fd, offset, num_bytes, static_cast<off_t>(page_no) * page_size_, tag);
+}
+
+/**
+ * @description: 准备一个异步的页面写入请求
+ * @param {AsyncIo*} io 异步读写对象
+ * @param {int} fd 磁盘文件的文件句柄
+ * @param {page_id_t} page_no 写入目标页面的page_id
+ * @param {char} *offset 要写入磁盘的数据，请求完成前不能修改
+ * @param {int} num_bytes 要写入磁盘的数据大小
+ * @param {uint64_t} tag 请求的标识
+ */
+void DiskManager::async_write_page(AsyncIo *io, int fd, page_id_t page_no, const char *offset, int num_bytes,
+                                   uint64_t tag) {
+    // 压缩文件的槽在写入时才分配，同步写入后直接放入完成结果
+    if (fd2compressed_[fd] != nullptr) {
+        int result = num_bytes;
+        try {
+            write_page(fd, page_no, offset, num_bytes);
+        } catch (RMDBError &) {
+            result = -EIO;
+        }
+        io->complete(tag, result);
+        return;
+    }
+    io->prep_write(fd, offset, num_bytes, static_cast<off_t>(page_no) * page_size_, tag);
+}
+
+/**
+ * @description: 准备一个异步的日志追加请求，写入位置在准备请求时就已确定
+ * @param {AsyncIo*} io 异步读写对象
+ * @param {char} *log_data 要写入的日志内容，请求完成前不能修改
+ * @param {int} size 要写入的内容大小
+ * @param {uint64_t} tag 请求的标识
+ */
+void DiskManager::async_write_log(AsyncIo *io, char *log_data, int size, uint64_t tag) {
+    off_t offset = reserve_log_space(size);
+    io->prep_write(log_fd_, log_data, size, offset, tag);
+}
+
+/**
+ * @description: 准备一个异步的日志读取请求，故障恢复重做时在处理当前一段日志的同时读入下一段
+ * @param {AsyncIo*} io 异步读写对象
+ * @param {char} *log_data 读取内容到log_data中，请求完成前不能访问
+ * @param {int} size 读取的数据量大小，不能超过日志文件的末尾
+ * @param {off_t} offset 读取的内容在文件中的位置
+ * @param {uint64_t} tag 请求的标识
+ */
+void DiskManager::async_read_log(AsyncIo *io, char *log_data, int size, off_t offset, uint64_t tag) {
+    {
+        std::scoped_lock lock{log_latch_};
+        if (log_fd_ == -1) {
+            log_fd_ = open_file(LOG_FILE_NAME);
+        }
+    }
+    io->prep_read(log_fd_, log_data, size, offset, tag);
+}
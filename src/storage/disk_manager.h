@@ -17,11 +17,17 @@ See the Mulan PSL v2 for more details. */
 #include <atomic>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "common/config.h"
 #include "errors.h"  
+#include "storage/async_io.h"
 
 /**
  * @description: DiskManager的作用主要是根据上层的需要对磁盘文件进行操作
@@ -36,9 +42,35 @@ class DiskManager {
 
     void read_page(int fd, page_id_t page_no, char *offset, int num_bytes);
 
+    void read_pages(int fd, page_id_t first_page_no, const std::vector<char *> &pages);
+
+    void write_pages(int fd, page_id_t first_page_no, const std::vector<const char *> &pages);
+
+    void set_direct_io(bool direct_io) { direct_io_ = direct_io; }
+
+    /**
+     * @description: 设置页面大小，由SmManager在打开数据库时按db.meta中记录的值设置，需在打开数据文件之前调用
+     * @param {int} page_size 页面大小，必须是PAGE_SIZE的整数倍
+     */
+    void set_page_size(int page_size) { page_size_ = page_size; }
+
+    int get_page_size() const { return page_size_; }
+
+    bool is_direct_io(int fd) const { return fd2direct_[fd]; }
+
+    bool is_compressed(int fd) const { return fd2compressed_[fd] != nullptr; }
+
+    size_t get_compressed_size(int fd);
+
     page_id_t allocate_page(int fd);
 
-    void deallocate_page(page_id_t page_id);
+    void cancel_allocate_page(int fd, page_id_t page_no);
+
+    void deallocate_page(int fd, page_id_t page_no);
+
+    void truncate_file(int fd, int num_pages);
+
+    size_t get_num_free_pages(int fd);
 
     /*目录操作*/
     bool is_dir(const std::string &path);
@@ -50,7 +82,7 @@ class DiskManager {
     /*文件操作*/
     bool is_file(const std::string &path);
 
-    void create_file(const std::string &path);
+    void create_file(const std::string &path, bool compressed = false);
 
     void destroy_file(const std::string &path);
 
@@ -65,11 +97,46 @@ class DiskManager {
     int get_file_fd(const std::string &file_name);
 
     /*日志操作*/
-    int read_log(char *log_data, int size, int offset);
+    int read_log(char *log_data, int size, off_t offset);
+
+    off_t write_log(char *log_data, int size);
+
+    void sync_log();
+
+    off_t reserve_log_space(int size);
+
+    void truncate_log(off_t size);
+
+    void discard_log(off_t end);
+
+    void write_log_master(const char *data, int size);
+
+    int read_log_master(char *data, int size);
+
+    void sync_all_files();
+
+    void SetLogFd(int log_fd) {
+        std::scoped_lock lock{log_latch_};
+        log_fd_ = log_fd;
+        log_end_ = -1;
+    }
+
+    /*异步读写*/
+    void set_io_backend(const std::string &io_backend) { io_backend_ = io_backend; }
 
-    void write_log(char *log_data, int size);
+    const std::string &get_io_backend() const { return io_backend_; }
 
-    void SetLogFd(int log_fd) { log_fd_ = log_fd; }
+    std::unique_ptr<AsyncIo> create_async_io(unsigned queue_depth = ASYNC_IO_QUEUE_DEPTH) const {
+        return AsyncIo::create(io_backend_, queue_depth);
+    }
+
+    void async_read_page(AsyncIo *io, int fd, page_id_t page_no, char *offset, int num_bytes, uint64_t tag);
+
+    void async_write_page(AsyncIo *io, int fd, page_id_t page_no, const char *offset, int num_bytes, uint64_t tag);
+
+    void async_write_log(AsyncIo *io, char *log_data, int size, uint64_t tag);
+
+    void async_read_log(AsyncIo *io, char *log_data, int size, off_t offset, uint64_t tag);
 
     int GetLogFd() { return log_fd_; }
 
@@ -78,7 +145,7 @@ class DiskManager {
      * @param {int} fd 文件对应的文件句柄
      * @param {int} start_page_no 已经分配的页面个数，即文件接下来从start_page_no开始分配页面编号
      */
-    void set_fd2pageno(int fd, int start_page_no) { fd2pageno_[fd] = start_page_no; }
+    void set_fd2pageno(int fd, int start_page_no);
 
     /**
      * @description: 获得文件目前已分配的页面个数，即如果文件要分配一个新页面，需要从fd2pagenp_[fd]开始分配
@@ -90,10 +157,75 @@ class DiskManager {
     static constexpr int MAX_FD = 8192;
 
    private:
-    // 文件打开列表，用于记录文件是否被打开
+    // 文件打开列表，用于记录文件是否被打开，由files_latch_保护
     std::unordered_map<std::string, int> path2fd_;  //<Page文件磁盘路径,Page fd>哈希表
     std::unordered_map<int, std::string> fd2path_;  //<Page fd,Page文件磁盘路径>哈希表
+    std::mutex files_latch_;                        // 保护文件打开列表，页面读写不需要获取
+
+    int page_size_ = PAGE_SIZE;                     // 当前数据库的页面大小，页面page_no位于文件中page_no * page_size_处
+
+    // O_DIRECT模式：之后打开的数据文件绕过操作系统页缓存，日志文件不受影响。
+    // 直接读写要求缓冲区地址和长度按PAGE_SIZE对齐，缓冲池的帧满足该要求，其它读写经过对齐的中转缓冲区
+    bool direct_io_ = ENABLE_DIRECT_IO;
+    bool fd2direct_[MAX_FD]{};                      // 文件是否以O_DIRECT模式打开
+
+    // 页面分配：已释放的页面记录在free_pages_中，优先复用；文件关闭时保存到空闲页面文件(文件名+FSM_SUFFIX)中
+    std::unordered_map<int, std::set<page_id_t>> free_pages_;  //<Page fd,文件中已释放、可以复用的页面>
+    page_id_t fd2prealloc_[MAX_FD]{};                           // 文件中已经用fallocate预分配了磁盘空间的页面个数
+    std::mutex alloc_latch_;                                    // 保护free_pages_和fd2prealloc_，需在files_latch_之后获取
+
+    static constexpr const char *FSM_SUFFIX = ".fsm";
+    static constexpr uint32_t FSM_MAGIC = 0x4d534652;
+
+    void load_free_pages(int fd, const std::string &path);
+
+    void save_free_pages(int fd, const std::string &path);
+
+    // 页面压缩：压缩文件中的页面压缩后存放在由若干COMPRESSED_PAGE_UNIT字节组成的变长槽中，
+    // 页号到槽的映射保存在映射文件(文件名+PMAP_SUFFIX)中。缓冲池中的页面总是未压缩的，压缩只发生在页面读写时
+    struct PageSlot {
+        uint32_t unit;  // 槽在文件中的起始单元
+        uint32_t len;   // 页面压缩后的字节数，为页面大小时未压缩，为0时页面没有写入过
+    };
+    struct CompressedFile {
+        int map_fd;
+        std::vector<PageSlot> slots;                            // 按页号索引的映射表
+        std::map<uint32_t, uint32_t> free_units;                // 可以复用的单元区间，<起始单元,单元个数>
+        std::vector<std::pair<uint32_t, uint32_t>> pending_free;  // 已释放、映射表同步到磁盘之前不能复用的单元区间
+        uint32_t end_unit = 0;                                  // 文件中已经使用的单元个数
+        std::mutex latch;                                       // 保护以上成员，不在持有期间读写页面数据
+        std::mutex rmw_latch;                                   // 串行化只写页面开头的写入（读出、修改、写回）
+    };
+
+    static constexpr const char *PMAP_SUFFIX = ".pmap";
+    static constexpr uint32_t PMAP_MAGIC = 0x50414d50;
+    static constexpr off_t PMAP_HEADER_SIZE = 16;
+
+    uint32_t slot_units(const PageSlot &slot) const {
+        return (slot.len + COMPRESSED_PAGE_UNIT - 1) / COMPRESSED_PAGE_UNIT;
+    }
+
+    void load_page_map(int fd, const std::string &path);
+
+    uint32_t allocate_units(CompressedFile &file, uint32_t num_units);
+
+    int compress_page(const char *page, char *buf);
+
+    void decompress_page(const char *data, const PageSlot &slot, char *offset, int num_bytes);
+
+    void read_compressed_page(int fd, page_id_t page_no, char *offset, int num_bytes);
+
+    void read_compressed_pages(int fd, page_id_t first_page_no, const std::vector<char *> &pages);
+
+    void write_compressed_pages(int fd, page_id_t first_page_no, const std::vector<const char *> &pages);
+
+    void reclaim_units(int fd, CompressedFile &file, const std::vector<std::pair<uint32_t, uint32_t>> &released);
+
+    std::unique_ptr<CompressedFile> fd2compressed_[MAX_FD];  // 压缩文件的映射表，未压缩的文件为空
 
     int log_fd_ = -1;                             // WAL日志文件的文件句柄，默认为-1，代表未打开日志文件
+    off_t log_end_ = -1;                          // 日志文件中下一次追加的位置，为-1时表示尚未从文件大小初始化
+    std::mutex log_latch_;                        // 保护log_fd_的打开和log_end_
+    std::string io_backend_ = IO_BACKEND;         // create_async_io使用的异步读写后端
     std::atomic<page_id_t> fd2pageno_[MAX_FD]{};  // 文件中已经分配的页面个数，初始值为0
 };
\ No newline at end of file
@@ -10,6 +10,10 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <atomic>
+#include <cstring>
+#include <shared_mutex>
+
 #include "common/config.h"
 
 /**
@@ -21,7 +25,7 @@ struct PageId {
 
     friend bool operator==(const PageId &x, const PageId &y) { return x.fd == y.fd && x.page_no == y.page_no; }
     bool operator<(const PageId& x) const {
-        if(fd < x.fd) return true;
+        if (fd != x.fd) return fd < x.fd;
         return page_no < x.page_no;
     }
 
@@ -46,14 +50,15 @@ struct std::hash<PageId> {
 
 /**
  * @description: Page类声明, Page是RMDB数据块的单位、是负责数据操作Record模块的操作对象，
- * Page对象在磁盘上有文件存储, 若在Buffer中则有帧偏移, 并非特指Buffer或Disk上的数据
+ * Page对象在磁盘上有文件存储, 若在Buffer中则有帧偏移, 并非特指Buffer或Disk上的数据。
+ * Page只保存页面的元数据，页面数据位于BufferPoolManager按PAGE_SIZE对齐分配的连续内存中，大小为数据库的页面大小，由data_指向
  */
 class Page {
     friend class BufferPoolManager;
 
    public:
     
-    Page() { reset_memory(); }
+    Page() = default;
 
     ~Page() = default;
 
@@ -69,22 +74,68 @@ class Page {
 
     inline lsn_t get_page_lsn() { return *reinterpret_cast<lsn_t *>(get_data() + OFFSET_LSN) ; }
 
-    inline void set_page_lsn(lsn_t page_lsn) { memcpy(get_data() + OFFSET_LSN, &page_lsn, sizeof(lsn_t)); }
+    /* 写日志的页面（记录文件的数据页）修改后调用，同时记下缓冲池写回页面之前日志需要持久化到的位置 */
+    inline void set_page_lsn(lsn_t page_lsn) {
+        memcpy(get_data() + OFFSET_LSN, &page_lsn, sizeof(lsn_t));
+        wal_lsn_.store(page_lsn, std::memory_order_release);
+        lsn_t clean = INVALID_LSN;
+        rec_lsn_.compare_exchange_strong(clean, page_lsn);
+    }
+
+    /* 缓冲池写回页面之前日志必须持久化到的日志号，没有写过日志的页面为INVALID_LSN */
+    inline lsn_t get_wal_lsn() const { return wal_lsn_.load(std::memory_order_acquire); }
+
+    /* 页面上尚未写回磁盘的最早一次修改的日志号（检查点脏页表中的recLSN），页面上的修改都已写回时为INVALID_LSN */
+    inline lsn_t get_rec_lsn() const { return rec_lsn_.load(std::memory_order_acquire); }
+
+    /* 页面读写latch：读取页面内容前加共享latch，修改页面内容前加排他latch；调用者需已经固定(pin)该页面 */
+    inline void r_latch() { latch_.lock_shared(); }
+
+    inline void r_unlatch() { latch_.unlock_shared(); }
+
+    /* 不等待地尝试加共享latch，页面被其它线程加排他latch时返回false */
+    inline bool try_r_latch() { return latch_.try_lock_shared(); }
+
+    inline void w_latch() { latch_.lock(); }
+
+    inline void w_unlatch() { latch_.unlock(); }
 
    private:
-    void reset_memory() { memset(data_, OFFSET_PAGE_START, PAGE_SIZE); }  // 将data_的PAGE_SIZE个字节填充为0
+    void reset_memory(size_t page_size) {   // 将data_的page_size个字节填充为0
+        memset(data_, OFFSET_PAGE_START, page_size);
+        rec_lsn_.store(INVALID_LSN, std::memory_order_release);
+    }
+
+    /* 页面写回磁盘之后调用，写回时页面的日志号为written_lsn。写回期间页面又被修改时，
+       不能确定这些修改是否已经写回，recLSN保守地设为written_lsn之后的第一个日志号 */
+    void clear_rec_lsn(lsn_t written_lsn) {
+        rec_lsn_.store(INVALID_LSN);
+        if (wal_lsn_.load() != written_lsn) {
+            lsn_t clean = INVALID_LSN;
+            rec_lsn_.compare_exchange_strong(clean, written_lsn == INVALID_LSN ? 0 : written_lsn + 1);
+        }
+    }
 
     /** page的唯一标识符 */
     PageId id_;
 
     /** The actual data that is stored within a page.
-     *  该页面在bufferPool中的偏移地址
+     *  该页面在bufferPool中的偏移地址，指向BufferPoolManager的帧数据区中对应的帧
      */
-    char data_[PAGE_SIZE] = {};
+    char *data_ = nullptr;
 
     /** 脏页判断 */
     bool is_dirty_ = false;
 
     /** The pin count of this page. */
     int pin_count_ = 0;
+
+    /** 保护页面内容的读写latch，与缓冲池的latch相互独立 */
+    std::shared_mutex latch_;
+
+    /** 页面最近一次修改对应的日志号，只在内存中维护；帧装入其他页面后保留旧值，只会多刷一次日志 */
+    std::atomic<lsn_t> wal_lsn_{INVALID_LSN};
+
+    /** 页面第一次被修改时的日志号，写回磁盘后清除，检查点据此记录脏页表，故障恢复从最小的recLSN开始重做 */
+    std::atomic<lsn_t> rec_lsn_{INVALID_LSN};
 };
\ No newline at end of file
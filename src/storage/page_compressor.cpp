@@ -0,0 +1,177 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "storage/page_compressor.h"
+
+#include <cstdint>
+#include <cstring>
+
+// LZ4块格式：由若干序列组成，每个序列是一个token（高4位为字面量长度，低4位为匹配长度减4）、
+// 字面量长度的扩展字节、字面量、2字节小端的匹配距离、匹配长度的扩展字节；最后一个序列只有字面量。
+// 格式要求最后5个字节总是字面量，最后一个匹配的开始位置距离块的末尾至少12个字节
+static constexpr int LZ4_MIN_MATCH = 4;
+static constexpr int LZ4_LAST_LITERALS = 5;
+static constexpr int LZ4_MF_LIMIT = 12;
+static constexpr int LZ4_MAX_DISTANCE = 65535;
+static constexpr int LZ4_HASH_BITS = 12;
+
+static uint32_t read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t hash4(uint32_t v) { return (v * 2654435761u) >> (32 - LZ4_HASH_BITS); }
+
+/* 写入长度超过15的部分：若干个255，最后是一个小于255的字节 */
+static uint8_t *put_length(uint8_t *op, size_t len) {
+    for (; len >= 255; len -= 255) {
+        *op++ = 255;
+    }
+    *op++ = static_cast<uint8_t>(len);
+    return op;
+}
+
+/* 写入一个序列，match_len为0时是只有字面量的最后一个序列。dst放不下时返回nullptr */
+static uint8_t *put_sequence(uint8_t *op, const uint8_t *oend, const uint8_t *literals, size_t lit_len,
+                             size_t offset, size_t match_len) {
+    // 最坏情况下的长度：token、两个长度的扩展字节、字面量和匹配距离
+    size_t need = 1 + (lit_len / 255 + 1) + lit_len + 2 + (match_len / 255 + 1);
+    if (need > static_cast<size_t>(oend - op)) {
+        return nullptr;
+    }
+    size_t code_len = match_len == 0 ? 0 : match_len - LZ4_MIN_MATCH;
+    *op++ = static_cast<uint8_t>((lit_len < 15 ? lit_len : 15) << 4 | (code_len < 15 ? code_len : 15));
+    if (lit_len >= 15) {
+        op = put_length(op, lit_len - 15);
+    }
+    memcpy(op, literals, lit_len);
+    op += lit_len;
+    if (match_len == 0) {
+        return op;
+    }
+    *op++ = static_cast<uint8_t>(offset);
+    *op++ = static_cast<uint8_t>(offset >> 8);
+    if (code_len >= 15) {
+        op = put_length(op, code_len - 15);
+    }
+    return op;
+}
+
+int lz4_compress(const char *src, int src_len, char *dst, int dst_capacity) {
+    const uint8_t *base = reinterpret_cast<const uint8_t *>(src);
+    const uint8_t *ip = base;
+    const uint8_t *anchor = base;
+    const uint8_t *iend = base + src_len;
+    uint8_t *op = reinterpret_cast<uint8_t *>(dst);
+    const uint8_t *oend = op + dst_capacity;
+
+    if (src_len > LZ4_MF_LIMIT) {
+        const uint8_t *mflimit = iend - LZ4_MF_LIMIT;
+        const uint8_t *matchlimit = iend - LZ4_LAST_LITERALS;
+        int table[1 << LZ4_HASH_BITS];
+        memset(table, -1, sizeof(table));
+        while (ip < mflimit) {
+            uint32_t seq = read32(ip);
+            uint32_t h = hash4(seq);
+            int ref = table[h];
+            table[h] = static_cast<int>(ip - base);
+            if (ref < 0 || ip - (base + ref) > LZ4_MAX_DISTANCE || read32(base + ref) != seq) {
+                ++ip;
+                continue;
+            }
+            const uint8_t *match = base + ref;
+            // 向前扩展匹配，少输出几个字面量
+            while (ip > anchor && match > base && ip[-1] == match[-1]) {
+                --ip;
+                --match;
+            }
+            const uint8_t *mend = ip + LZ4_MIN_MATCH;
+            const uint8_t *mref = match + LZ4_MIN_MATCH;
+            while (mend < matchlimit && *mend == *mref) {
+                ++mend;
+                ++mref;
+            }
+            op = put_sequence(op, oend, anchor, ip - anchor, ip - match, mend - ip);
+            if (op == nullptr) {
+                return 0;
+            }
+            ip = mend;
+            anchor = ip;
+        }
+    }
+    op = put_sequence(op, oend, anchor, iend - anchor, 0, 0);
+    if (op == nullptr) {
+        return 0;
+    }
+    return static_cast<int>(op - reinterpret_cast<uint8_t *>(dst));
+}
+
+bool lz4_decompress(const char *src, int src_len, char *dst, int dst_len) {
+    const uint8_t *ip = reinterpret_cast<const uint8_t *>(src);
+    const uint8_t *iend = ip + src_len;
+    uint8_t *op = reinterpret_cast<uint8_t *>(dst);
+    uint8_t *ostart = op;
+    uint8_t *oend = op + dst_len;
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        size_t lit_len = token >> 4;
+        if (lit_len == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) {
+                    return false;
+                }
+                b = *ip++;
+                lit_len += b;
+            } while (b == 255);
+        }
+        if (lit_len > static_cast<size_t>(iend - ip) || lit_len > static_cast<size_t>(oend - op)) {
+            return false;
+        }
+        memcpy(op, ip, lit_len);
+        op += lit_len;
+        ip += lit_len;
+        if (ip == iend) {
+            // 最后一个序列只有字面量
+            return op == oend;
+        }
+        if (iend - ip < 2) {
+            return false;
+        }
+        size_t offset = ip[0] | static_cast<size_t>(ip[1]) << 8;
+        ip += 2;
+        if (offset == 0 || offset > static_cast<size_t>(op - ostart)) {
+            return false;
+        }
+        size_t match_len = token & 15;
+        if (match_len == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) {
+                    return false;
+                }
+                b = *ip++;
+                match_len += b;
+            } while (b == 255);
+        }
+        match_len += LZ4_MIN_MATCH;
+        if (match_len > static_cast<size_t>(oend - op)) {
+            return false;
+        }
+        // 匹配可能与输出重叠（距离小于长度），逐字节复制
+        const uint8_t *match = op - offset;
+        for (size_t i = 0; i < match_len; ++i) {
+            op[i] = match[i];
+        }
+        op += match_len;
+    }
+    return false;
+}
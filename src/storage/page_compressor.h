@@ -0,0 +1,36 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+/**
+ * @description: 页面压缩使用的LZ4块格式编解码。压缩是贪心的单遍哈希匹配，速度优先；
+ * 输出与LZ4块格式兼容，一个页面压缩为一个块
+ */
+
+/**
+ * @description: 压缩src中的src_len个字节
+ * @return {int} 压缩后的字节数，结果放不进dst_capacity个字节时返回0
+ * @param {char*} src 要压缩的数据
+ * @param {int} src_len 要压缩的数据大小
+ * @param {char*} dst 压缩结果的存放位置
+ * @param {int} dst_capacity dst的大小
+ */
+int lz4_compress(const char *src, int src_len, char *dst, int dst_capacity);
+
+/**
+ * @description: 解压一个块，块中的数据被截断或损坏时返回false，不会越界读写
+ * @return {bool} 解压成功且恰好得到dst_len个字节时返回true
+ * @param {char*} src 压缩的数据
+ * @param {int} src_len 压缩的数据大小
+ * @param {char*} dst 解压结果的存放位置
+ * @param {int} dst_len 解压后的数据大小
+ */
+bool lz4_decompress(const char *src, int src_len, char *dst, int dst_len);
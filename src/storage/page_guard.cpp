@@ -0,0 +1,77 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "page_guard.h"
+
+#include <utility>
+
+#include "buffer_pool_manager.h"
+
+ReadPageGuard::ReadPageGuard(BufferPoolManager *bpm, Page *page) : bpm_(bpm), page_(page) {
+    if (page_ != nullptr) {
+        page_->r_latch();
+    }
+}
+
+ReadPageGuard::ReadPageGuard(ReadPageGuard &&other) noexcept
+    : bpm_(std::exchange(other.bpm_, nullptr)), page_(std::exchange(other.page_, nullptr)) {}
+
+ReadPageGuard &ReadPageGuard::operator=(ReadPageGuard &&other) noexcept {
+    if (this != &other) {
+        release();
+        bpm_ = std::exchange(other.bpm_, nullptr);
+        page_ = std::exchange(other.page_, nullptr);
+    }
+    return *this;
+}
+
+/**
+ * @description: 释放共享latch并unpin页面，之后保护对象失效
+ */
+void ReadPageGuard::release() {
+    if (page_ == nullptr) {
+        return;
+    }
+    page_->r_unlatch();
+    bpm_->unpin_page(page_->get_page_id(), false);
+    page_ = nullptr;
+    bpm_ = nullptr;
+}
+
+WritePageGuard::WritePageGuard(BufferPoolManager *bpm, Page *page) : bpm_(bpm), page_(page) {
+    if (page_ != nullptr) {
+        page_->w_latch();
+    }
+}
+
+WritePageGuard::WritePageGuard(WritePageGuard &&other) noexcept
+    : bpm_(std::exchange(other.bpm_, nullptr)), page_(std::exchange(other.page_, nullptr)) {}
+
+WritePageGuard &WritePageGuard::operator=(WritePageGuard &&other) noexcept {
+    if (this != &other) {
+        release();
+        bpm_ = std::exchange(other.bpm_, nullptr);
+        page_ = std::exchange(other.page_, nullptr);
+    }
+    return *this;
+}
+
+/**
+ * @description: 释放排他latch并以脏页方式unpin页面，之后保护对象失效
+ */
+void WritePageGuard::release() {
+    if (page_ == nullptr) {
+        return;
+    }
+    page_->w_unlatch();
+    bpm_->unpin_page(page_->get_page_id(), true);
+    page_ = nullptr;
+    bpm_ = nullptr;
+}
@@ -0,0 +1,89 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "page.h"
+
+class BufferPoolManager;
+
+/**
+ * @description: 页面读保护，持有页面的一次固定(pin)和共享latch。
+ *              析构或调用release()时自动释放latch并以非脏页方式unpin；只能移动，不能拷贝
+ */
+class ReadPageGuard {
+   public:
+    ReadPageGuard() = default;
+
+    /**
+     * @param {BufferPoolManager*} bpm 页面所在的缓冲池
+     * @param {Page*} page 已被固定的页面，为nullptr时得到一个无效的保护对象
+     */
+    ReadPageGuard(BufferPoolManager *bpm, Page *page);
+
+    ReadPageGuard(const ReadPageGuard &) = delete;
+    ReadPageGuard &operator=(const ReadPageGuard &) = delete;
+
+    ReadPageGuard(ReadPageGuard &&other) noexcept;
+    ReadPageGuard &operator=(ReadPageGuard &&other) noexcept;
+
+    ~ReadPageGuard() { release(); }
+
+    void release();
+
+    explicit operator bool() const { return page_ != nullptr; }
+
+    Page *get_page() const { return page_; }
+
+    PageId get_page_id() const { return page_->get_page_id(); }
+
+    const char *get_data() const { return page_->get_data(); }
+
+   private:
+    BufferPoolManager *bpm_ = nullptr;
+    Page *page_ = nullptr;
+};
+
+/**
+ * @description: 页面写保护，持有页面的一次固定(pin)和排他latch。
+ *              析构或调用release()时自动释放latch并以脏页方式unpin；只能移动，不能拷贝
+ */
+class WritePageGuard {
+   public:
+    WritePageGuard() = default;
+
+    /**
+     * @param {BufferPoolManager*} bpm 页面所在的缓冲池
+     * @param {Page*} page 已被固定的页面，为nullptr时得到一个无效的保护对象
+     */
+    WritePageGuard(BufferPoolManager *bpm, Page *page);
+
+    WritePageGuard(const WritePageGuard &) = delete;
+    WritePageGuard &operator=(const WritePageGuard &) = delete;
+
+    WritePageGuard(WritePageGuard &&other) noexcept;
+    WritePageGuard &operator=(WritePageGuard &&other) noexcept;
+
+    ~WritePageGuard() { release(); }
+
+    void release();
+
+    explicit operator bool() const { return page_ != nullptr; }
+
+    Page *get_page() const { return page_; }
+
+    PageId get_page_id() const { return page_->get_page_id(); }
+
+    char *get_data() const { return page_->get_data(); }
+
+   private:
+    BufferPoolManager *bpm_ = nullptr;
+    Page *page_ = nullptr;
+};
@@ -0,0 +1,204 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "storage/temp_storage.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include "common/query_stats.h"
+#include "errors.h"
+
+/**
+ * @description: 在临时目录下创建一个临时文件并立即删除它的目录项，文件只通过返回的对象访问
+ * @return {unique_ptr<TempFile>} 新创建的空文件
+ * @param {size_t} block_size 每次读写的字节数
+ */
+std::unique_ptr<TempFile> TempStorage::create_file(size_t block_size) {
+    std::string path = dir_ + "/rmdb_temp.XXXXXX";
+    std::vector<char> name(path.begin(), path.end());
+    name.push_back('\0');
+    int fd = mkstemp(name.data());
+    if (fd < 0) {
+        throw UnixError();
+    }
+    unlink(name.data());
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    num_files_++;
+    return std::unique_ptr<TempFile>(new TempFile(this, fd, block_size, io_backend_));
+}
+
+TempFile::TempFile(TempStorage *storage, int fd, size_t block_size, const std::string &io_backend)
+    : storage_(storage), fd_(fd), block_size_(block_size), io_backend_(io_backend) {}
+
+/* 等待仍在进行的读写完成后才能释放它们使用的块缓冲区 */
+TempFile::~TempFile() {
+    try {
+        wait_all();
+    } catch (RMDBError &) {
+    }
+    close(fd_);
+    storage_->num_files_--;
+}
+
+AsyncIo *TempFile::io() {
+    if (io_ == nullptr) {
+        io_ = AsyncIo::create(io_backend_, TEMP_IO_BUFFERS);
+    }
+    return io_.get();
+}
+
+void TempFile::alloc_blocks() {
+    if (!blocks_.empty()) return;
+    blocks_.resize(TEMP_IO_BUFFERS);
+    for (auto &block : blocks_) {
+        block.data.resize(block_size_);
+    }
+    cur_ = 0;
+}
+
+/**
+ * @description: 追加数据。当前块写满后异步写出，继续填充下一块；下一块还在写出时先等待它完成
+ */
+void TempFile::append(const char *data, size_t len) {
+    assert(!reading_);
+    alloc_blocks();
+    while (len > 0) {
+        Block &block = blocks_[cur_];
+        wait_block(cur_);
+        size_t n = std::min(len, block_size_ - block.len);
+        memcpy(block.data.data() + block.len, data, n);
+        block.len += n;
+        data += n;
+        len -= n;
+        size_ += n;
+        if (block.len == block_size_) {
+            write_block(cur_);
+            cur_ = (cur_ + 1) % blocks_.size();
+        }
+    }
+}
+
+/**
+ * @description: 写出最后一个不满的块并等待所有写入完成，之后释放块缓冲区。
+ * 写完的文件在读取之前不再占用缓冲区，同时写入很多个文件时只有正在写的文件占用内存
+ */
+void TempFile::finish_write() {
+    if (reading_ || blocks_.empty()) return;
+    if (blocks_[cur_].len > 0 && !blocks_[cur_].pending) {
+        write_block(cur_);
+    }
+    wait_all();
+    std::vector<Block>().swap(blocks_);
+}
+
+/**
+ * @description: 结束写入，从文件开头开始读取，并为所有块缓冲区发出预读
+ */
+void TempFile::rewind() {
+    finish_write();
+    wait_all();
+    reading_ = true;
+    alloc_blocks();
+    cur_ = 0;
+    io_offset_ = 0;
+    pos_ = 0;
+    for (size_t i = 0; i < blocks_.size(); i++) {
+        read_block(i);
+    }
+}
+
+/**
+ * @description: 从当前位置顺序读出至多len字节；读完一个块后立即为它发出下一块的预读
+ * @return {size_t} 读出的字节数，小于len说明已经读到文件末尾
+ */
+size_t TempFile::read(char *dst, size_t len) {
+    assert(reading_);
+    size_t done = 0;
+    while (done < len) {
+        Block &block = blocks_[cur_];
+        wait_block(cur_);
+        if (pos_ == block.len) {
+            if (block.len == 0) break;
+            read_block(cur_);
+            cur_ = (cur_ + 1) % blocks_.size();
+            pos_ = 0;
+            continue;
+        }
+        size_t n = std::min(len - done, block.len - pos_);
+        memcpy(dst + done, block.data.data() + pos_, n);
+        pos_ += n;
+        done += n;
+    }
+    return done;
+}
+
+void TempFile::write_block(size_t i) {
+    Block &block = blocks_[i];
+    io()->prep_write(fd_, block.data.data(), block.len, io_offset_, i);
+    io()->submit();
+    block.pending = true;
+    io_offset_ += block.len;
+    storage_->bytes_written_ += block.len;
+    QueryStats::add(QueryStats::TEMP_BYTES, block.len);
+}
+
+/* 预读io_offset_开始的一块，文件已经全部发出预读时块的长度为0，表示文件结束 */
+void TempFile::read_block(size_t i) {
+    Block &block = blocks_[i];
+    block.len = std::min(block_size_, size_ - static_cast<size_t>(io_offset_));
+    if (block.len == 0) return;
+    io()->prep_read(fd_, block.data.data(), block.len, io_offset_, i);
+    io()->submit();
+    block.pending = true;
+    io_offset_ += block.len;
+}
+
+/**
+ * @description: 等待块i上的读写完成。同时收到的其它块的结果一并处理，全部处理完之后再报告错误，
+ * 保证pending标记与实际仍在进行的读写一致
+ */
+void TempFile::wait_block(size_t i) {
+    while (blocks_[i].pending) {
+        completions_.clear();
+        io_->wait(&completions_, 1);
+        int error = 0;
+        bool short_io = false;
+        for (auto &completion : completions_) {
+            Block &block = blocks_[completion.tag];
+            block.pending = false;
+            if (completion.result < 0) {
+                error = -completion.result;
+            } else if (static_cast<size_t>(completion.result) != block.len) {
+                short_io = true;
+            }
+            if (!reading_) block.len = 0;
+        }
+        if (error != 0) {
+            errno = error;
+            throw UnixError();
+        }
+        if (short_io) {
+            throw InternalError("Short read or write on temp file");
+        }
+    }
+}
+
+void TempFile::wait_all() {
+    for (size_t i = 0; i < blocks_.size(); i++) {
+        wait_block(i);
+    }
+}
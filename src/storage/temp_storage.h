@@ -0,0 +1,118 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/config.h"
+#include "storage/async_io.h"
+
+class TempStorage;
+
+/**
+ * @description: 一个临时文件，用于算子溢出的分区、排序的run等只在一条语句内使用的中间结果。
+ * 先顺序追加写入，rewind之后从头顺序读出，可以多次rewind重新读取。读写以块为单位直接对文件描述符进行，不经过缓冲池：
+ * 写满的块交给AsyncIo异步写出，调用者同时填充下一块；读取时提前读入后面的块，共TEMP_IO_BUFFERS个块轮流使用。
+ * 文件创建后立即从目录中删除，对象析构时关闭，语句正常结束、出错中止或者进程崩溃都不会留下文件。
+ * 一个TempFile只能由一个线程使用
+ */
+class TempFile {
+    friend class TempStorage;
+
+   public:
+    ~TempFile();
+
+    TempFile(const TempFile &) = delete;
+
+    TempFile &operator=(const TempFile &) = delete;
+
+    void append(const char *data, size_t len);
+
+    void finish_write();
+
+    void rewind();
+
+    size_t read(char *dst, size_t len);
+
+    /* 已经追加的字节数 */
+    size_t size() const { return size_; }
+
+    /* 读写时块缓冲区占用的内存 */
+    size_t get_buffer_size() const { return block_size_ * TEMP_IO_BUFFERS; }
+
+   private:
+    /* 一个块缓冲区：写入时len为已填充的字节数，读取时为读入的字节数；pending表示上面有尚未完成的读写 */
+    struct Block {
+        std::vector<char> data;
+        size_t len = 0;
+        bool pending = false;
+    };
+
+    TempFile(TempStorage *storage, int fd, size_t block_size, const std::string &io_backend);
+
+    AsyncIo *io();
+
+    void alloc_blocks();
+
+    void write_block(size_t i);
+
+    void read_block(size_t i);
+
+    void wait_block(size_t i);
+
+    void wait_all();
+
+    TempStorage *storage_;
+    int fd_;
+    size_t block_size_;
+    std::string io_backend_;
+    std::unique_ptr<AsyncIo> io_;               // 第一次读写时创建
+    std::vector<Block> blocks_;                 // 块缓冲区，不读写时释放
+    size_t cur_ = 0;                            // 正在填充或者读取的块
+    size_t pos_ = 0;                            // 读取时当前块中下一个字节的位置
+    size_t size_ = 0;
+    off_t io_offset_ = 0;                       // 写入时下一块写到的偏移，读取时下一块预读的偏移
+    bool reading_ = false;
+    std::vector<IoCompletion> completions_;
+};
+
+/**
+ * @description: 临时文件的管理者，与DiskManager一样位于存储层：决定临时文件所在的目录和使用的异步读写后端，
+ * 并统计当前打开的临时文件数和写入的字节数。目录和后端在服务启动时设置
+ */
+class TempStorage {
+    friend class TempFile;
+
+   public:
+    static TempStorage &instance() {
+        static TempStorage storage;
+        return storage;
+    }
+
+    void set_dir(const std::string &dir) { dir_ = dir; }
+
+    void set_io_backend(const std::string &io_backend) { io_backend_ = io_backend; }
+
+    std::unique_ptr<TempFile> create_file(size_t block_size = TEMP_BLOCK_SIZE);
+
+    size_t get_num_files() const { return num_files_.load(); }
+
+    uint64_t get_bytes_written() const { return bytes_written_.load(); }
+
+   private:
+    std::string dir_ = TEMP_DIR;
+    std::string io_backend_ = IO_BACKEND;
+    std::atomic<size_t> num_files_{0};
+    std::atomic<uint64_t> bytes_written_{0};
+};
@@ -0,0 +1,151 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "output_log.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <vector>
+
+#include "common/config.h"
+#include "errors.h"
+
+OutputLog &OutputLog::instance() {
+    static OutputLog log;
+    return log;
+}
+
+void OutputLog::start(const std::string &path) {
+    std::lock_guard<std::mutex> lock(latch_);
+    if (writer_.joinable()) return;
+    fd_ = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd_ < 0) {
+        throw UnixError();
+    }
+    stop_ = false;
+    writer_ = std::thread(&OutputLog::run, this);
+    running_ = true;
+}
+
+void OutputLog::stop() {
+    {
+        std::lock_guard<std::mutex> lock(latch_);
+        if (!writer_.joinable()) return;
+        // 之后追加的文本同步写入，后台线程写完队列中剩余的文本后退出
+        running_ = false;
+        stop_ = true;
+    }
+    cv_.notify_one();
+    writer_.join();
+    close(fd_);
+    fd_ = -1;
+}
+
+void OutputLog::append(std::string text) {
+    if (text.empty()) return;
+    if (!running_) {
+        // 没有后台线程时(如单元测试)按原来的方式追加到当前目录下的output.txt
+        Node node;
+        node.text = std::move(text);
+        std::lock_guard<std::mutex> lock(latch_);
+        int fd = open("output.txt", O_WRONLY | O_APPEND | O_CREAT, 0644);
+        if (fd < 0) return;
+        write_nodes(&node, fd, false);
+        close(fd);
+        return;
+    }
+    push(new Node{std::move(text)});
+}
+
+void OutputLog::flush() {
+    if (!running_) return;
+    bool flushed = false;
+    push(new Node{std::string(), nullptr, &flushed});
+    std::unique_lock<std::mutex> lock(latch_);
+    flushed_cv_.wait(lock, [&]() { return flushed; });
+}
+
+void OutputLog::push(Node *node) {
+    node->next = head_.load(std::memory_order_relaxed);
+    while (!head_.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+    // 队列由空变为非空时唤醒后台线程；错过的唤醒最多延迟OUTPUT_LOG_FLUSH_MS
+    if (node->next == nullptr) cv_.notify_one();
+}
+
+/* 后台线程每次取走栈中的全部结点，按追加顺序合并写入文件，停止时写完剩余的结点后退出 */
+void OutputLog::run() {
+    for (;;) {
+        Node *head = head_.exchange(nullptr, std::memory_order_acquire);
+        if (head == nullptr) {
+            std::unique_lock<std::mutex> lock(latch_);
+            if (stop_ && head_.load() == nullptr) return;
+            cv_.wait_for(lock, std::chrono::milliseconds(OUTPUT_LOG_FLUSH_MS),
+                         [&]() { return stop_ || head_.load() != nullptr; });
+            continue;
+        }
+        // 栈顶是最后追加的结点，反转为追加顺序
+        Node *ordered = nullptr;
+        while (head != nullptr) {
+            Node *next = head->next;
+            head->next = ordered;
+            ordered = head;
+            head = next;
+        }
+        write_nodes(ordered, fd_, true);
+    }
+}
+
+/* 合并相邻的文本后一次写入fd，遇到flush()的标记时先写出之前的文本再通知等待者；owned表示结点由push()分配 */
+void OutputLog::write_nodes(Node *head, int fd, bool owned) {
+    std::string buf;
+    auto write_buf = [&]() {
+        size_t written = 0;
+        while (written < buf.size()) {
+            ssize_t n = write(fd, buf.data() + written, buf.size() - written);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            written += n;
+        }
+        buf.clear();
+    };
+    while (head != nullptr) {
+        Node *next = head->next;
+        if (head->flushed != nullptr) {
+            write_buf();
+            {
+                std::lock_guard<std::mutex> lock(latch_);
+                *head->flushed = true;
+            }
+            flushed_cv_.notify_all();
+        } else {
+            buf += head->text;
+        }
+        if (owned) delete head;
+        head = next;
+    }
+    write_buf();
+}
+
+OutputBuffer &OutputBuffer::operator<<(std::string_view text) {
+    buf_.append(text);
+    if (capture_ != nullptr) capture_->append(text);
+    if (buf_.size() >= OUTPUT_LOG_CHUNK_SIZE) flush();
+    return *this;
+}
+
+void OutputBuffer::flush() {
+    if (buf_.empty()) return;
+    OutputLog::instance().append(std::move(buf_));
+    buf_.clear();
+}
@@ -0,0 +1,87 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+/**
+ * @brief output.txt的结果日志，进程内唯一。
+ * 执行语句的线程把要写入的文本无锁地压入队列后立即返回，由后台线程合并后写入始终打开的文件，
+ * 查询在持有锁期间不再打开、写入和关闭文件；start之前追加的文本直接同步写入文件
+ */
+class OutputLog {
+   public:
+    static OutputLog &instance();
+
+    /* 打开path(相对数据库目录)并启动后台写线程 */
+    void start(const std::string &path);
+
+    /* 写完已经追加的所有文本后停止后台写线程并关闭文件，关闭数据库和进程退出前调用 */
+    void stop();
+
+    void append(std::string text);
+
+    /* 阻塞到此前追加的文本都已写入文件 */
+    void flush();
+
+   private:
+    struct Node {
+        std::string text;
+        Node *next = nullptr;
+        bool *flushed = nullptr;    // 非空时为flush()的标记，写完之前的文本后置为true
+    };
+
+    OutputLog() = default;
+
+    ~OutputLog() { stop(); }
+
+    void push(Node *node);
+
+    void run();
+
+    void write_nodes(Node *head, int fd, bool owned);
+
+    std::atomic<Node *> head_{nullptr};     // 无锁栈，后台线程一次取走全部结点再按追加顺序写入
+    std::mutex latch_;                      // 只用于后台线程休眠和flush()等待
+    std::condition_variable cv_;
+    std::condition_variable flushed_cv_;
+    std::thread writer_;
+    std::atomic<bool> running_{false};      // 后台线程是否在运行，否则append()同步写入
+    int fd_ = -1;
+    bool stop_ = false;
+};
+
+/**
+ * @brief 一条语句写入output.txt的文本先放在本地缓冲区中，超过OUTPUT_LOG_CHUNK_SIZE或析构时整块交给OutputLog，
+ * 语句执行中途抛出异常时已经生成的部分同样会写入
+ */
+class OutputBuffer {
+   public:
+    /* capture不为空时写入的文本同时追加到capture中，用于结果缓存 */
+    explicit OutputBuffer(std::string *capture = nullptr) : capture_(capture) {}
+
+    ~OutputBuffer() { flush(); }
+
+    OutputBuffer &operator<<(std::string_view text);
+
+    OutputBuffer &operator<<(char c) { return *this << std::string_view(&c, 1); }
+
+    void flush();
+
+   private:
+    std::string buf_;
+    std::string *capture_;
+};
@@ -0,0 +1,118 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "server_log.h"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <ctime>
+#include <vector>
+
+#include "common/config.h"
+
+namespace {
+
+// 把text全部写到标准输出，写入失败时放弃
+void write_stdout(const std::string &text) {
+    size_t written = 0;
+    while (written < text.size()) {
+        ssize_t n = ::write(STDOUT_FILENO, text.data() + written, text.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        written += n;
+    }
+}
+
+}  // namespace
+
+ServerLog &ServerLog::instance() {
+    static ServerLog log;
+    return log;
+}
+
+void ServerLog::start(LogLevel level) {
+    level_ = level;
+    std::lock_guard<std::mutex> lock(latch_);
+    if (running_) return;
+    stop_ = false;
+    running_ = true;
+    writer_ = std::thread(&ServerLog::run, this);
+}
+
+void ServerLog::stop() {
+    {
+        std::lock_guard<std::mutex> lock(latch_);
+        if (!running_) return;
+        stop_ = true;
+    }
+    cv_.notify_one();
+    writer_.join();
+}
+
+bool ServerLog::parse_level(const std::string &name, LogLevel *level) {
+    static const char *names[] = {"DEBUG", "INFO", "WARN", "ERROR", "OFF"};
+    for (int i = 0; i <= static_cast<int>(LogLevel::OFF); ++i) {
+        if (name == names[i]) {
+            *level = static_cast<LogLevel>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ServerLog::write(LogLevel level, const std::string &msg) {
+    static const char *tags[] = {"DEBUG", "INFO", "WARN", "ERROR"};
+    char time_buf[32];
+    time_t now = time(nullptr);
+    struct tm tm_now;
+    localtime_r(&now, &tm_now);
+    strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", &tm_now);
+    std::string line = std::string(time_buf) + " [" + tags[static_cast<int>(level)] + "] " + msg + '\n';
+
+    std::unique_lock<std::mutex> lock(latch_);
+    if (!running_) {
+        lock.unlock();
+        write_stdout(line);
+        return;
+    }
+    if (queue_.size() >= SERVER_LOG_QUEUE_SIZE) {
+        dropped_++;
+        return;
+    }
+    queue_.push_back(std::move(line));
+    if (queue_.size() == 1) {
+        cv_.notify_one();
+    }
+}
+
+void ServerLog::run() {
+    std::unique_lock<std::mutex> lock(latch_);
+    while (true) {
+        cv_.wait(lock, [&] { return stop_ || !queue_.empty(); });
+        if (queue_.empty() && stop_) break;
+        // 一次取走全部消息，在latch之外合并写出
+        std::deque<std::string> lines;
+        lines.swap(queue_);
+        size_t dropped = dropped_;
+        dropped_ = 0;
+        lock.unlock();
+        std::string text;
+        for (auto &line : lines) {
+            text += line;
+        }
+        if (dropped > 0) {
+            text += "[WARN] " + std::to_string(dropped) + " log messages dropped\n";
+        }
+        write_stdout(text);
+        lock.lock();
+    }
+    running_ = false;
+}
@@ -0,0 +1,81 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+enum class LogLevel { DEBUG, INFO, WARN, ERROR, OFF };
+
+/**
+ * @brief 服务端运行日志，进程内唯一。低于当前级别的消息在格式化之前就被丢弃；
+ * 其余消息加上时间和级别后放入队列，由后台线程写到标准输出，start之前的消息直接同步写出。
+ * 队列中积压的消息超过SERVER_LOG_QUEUE_SIZE条时丢弃新消息，并在之后写出丢弃的条数
+ */
+class ServerLog {
+   public:
+    static ServerLog &instance();
+
+    /* 设置日志级别并启动后台写线程 */
+    void start(LogLevel level);
+
+    /* 写完队列中的消息后停止后台写线程，之后的消息同步写出 */
+    void stop();
+
+    bool enabled(LogLevel level) const { return level >= level_.load(std::memory_order_relaxed); }
+
+    void write(LogLevel level, const std::string &msg);
+
+    /* 解析"DEBUG"、"INFO"、"WARN"、"ERROR"、"OFF"，不合法时返回false */
+    static bool parse_level(const std::string &name, LogLevel *level);
+
+    template <typename... Args>
+    static void debug(const Args &...args) { log(LogLevel::DEBUG, args...); }
+
+    template <typename... Args>
+    static void info(const Args &...args) { log(LogLevel::INFO, args...); }
+
+    template <typename... Args>
+    static void warn(const Args &...args) { log(LogLevel::WARN, args...); }
+
+    template <typename... Args>
+    static void error(const Args &...args) { log(LogLevel::ERROR, args...); }
+
+   private:
+    ServerLog() = default;
+
+    ~ServerLog() { stop(); }
+
+    template <typename... Args>
+    static void log(LogLevel level, const Args &...args) {
+        ServerLog &server_log = instance();
+        if (!server_log.enabled(level)) return;
+        std::ostringstream os;
+        (os << ... << args);
+        server_log.write(level, os.str());
+    }
+
+    void run();
+
+    std::atomic<LogLevel> level_{LogLevel::INFO};
+    std::mutex latch_;                  // 保护下面的队列和状态
+    std::condition_variable cv_;
+    std::deque<std::string> queue_;
+    size_t dropped_ = 0;                // 队列满时丢弃的消息数
+    std::thread writer_;
+    bool running_ = false;
+    bool stop_ = false;
+};
@@ -0,0 +1,68 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "slow_query_log.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <ctime>
+
+#include "errors.h"
+
+SlowQueryLog &SlowQueryLog::instance() {
+    static SlowQueryLog log;
+    return log;
+}
+
+void SlowQueryLog::start(const std::string &path, size_t threshold_ms) {
+    std::lock_guard<std::mutex> lock(latch_);
+    if (fd_ >= 0 || threshold_ms == 0) return;
+    fd_ = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd_ < 0) {
+        throw UnixError();
+    }
+    threshold_ns_ = static_cast<uint64_t>(threshold_ms) * 1000000;
+}
+
+void SlowQueryLog::stop() {
+    std::lock_guard<std::mutex> lock(latch_);
+    threshold_ns_ = 0;
+    if (fd_ < 0) return;
+    close(fd_);
+    fd_ = -1;
+}
+
+void SlowQueryLog::write(const std::string &sql, const QueryStats &stats, const std::vector<std::string> &plan) {
+    char time_buf[32];
+    time_t now = time(nullptr);
+    struct tm tm_now;
+    localtime_r(&now, &tm_now);
+    strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", &tm_now);
+
+    // 一条慢查询占多行：时间和计数、语句，最后是缩进的执行计划，条目之间空一行
+    std::string entry = std::string("# ") + time_buf + ' ' + stats.to_string() + '\n' + sql + '\n';
+    for (auto &line : plan) {
+        entry += "  " + line + '\n';
+    }
+    entry += '\n';
+
+    std::lock_guard<std::mutex> lock(latch_);
+    if (fd_ < 0) return;
+    size_t written = 0;
+    while (written < entry.size()) {
+        ssize_t n = ::write(fd_, entry.data() + written, entry.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        // 写入失败时丢弃这条记录，慢查询日志不影响语句的执行
+        if (n <= 0) return;
+        written += n;
+    }
+}
@@ -0,0 +1,51 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "common/query_stats.h"
+
+/**
+ * @brief 慢查询日志，进程内唯一。耗时超过阈值的语句连同它的性能计数和执行计划追加到日志文件中，
+ * 慢查询很少，每条直接在锁内写入文件；未启动或阈值为0时不记录
+ */
+class SlowQueryLog {
+   public:
+    static SlowQueryLog &instance();
+
+    /* 打开path(相对数据库目录)，之后耗时超过threshold_ms毫秒的语句写入该文件，threshold_ms为0时不打开文件 */
+    void start(const std::string &path, size_t threshold_ms);
+
+    void stop();
+
+    /* 语句的总耗时是否需要记录，未启动时始终返回false */
+    bool is_slow(uint64_t total_ns) const {
+        uint64_t threshold = threshold_ns_.load(std::memory_order_relaxed);
+        return threshold != 0 && total_ns >= threshold;
+    }
+
+    /* 写入一条慢查询，plan为执行计划的各行，DDL等没有计划的语句为空 */
+    void write(const std::string &sql, const QueryStats &stats, const std::vector<std::string> &plan);
+
+   private:
+    SlowQueryLog() = default;
+
+    ~SlowQueryLog() { stop(); }
+
+    std::mutex latch_;                          // 保护文件的打开、关闭和写入
+    std::atomic<uint64_t> threshold_ns_{0};     // 记录的耗时阈值，单位为纳秒，0表示不记录
+    int fd_ = -1;
+};
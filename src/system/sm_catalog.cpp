@@ -0,0 +1,445 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "sm_catalog.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <vector>
+
+#include "errors.h"
+
+static constexpr int CATALOG_ENTRY_HEADER = 2 * sizeof(uint32_t) + sizeof(uint8_t);   // 长度、校验和、类型
+
+/* 条目的校验和（FNV-1a），用来发现末尾写了一半的条目 */
+static uint32_t catalog_checksum(uint8_t type, const char *data, size_t size) {
+    uint32_t hash = 2166136261u;
+    hash = (hash ^ type) * 16777619u;
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ static_cast<uint8_t>(data[i])) * 16777619u;
+    }
+    return hash;
+}
+
+/* 把元数据按二进制追加到字符串中 */
+class CatalogWriter {
+   public:
+    explicit CatalogWriter(std::string *out) : out_(out) {}
+
+    template <typename T>
+    void put(T value) {
+        out_->append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    void put(const std::string &value) {
+        put<uint32_t>(static_cast<uint32_t>(value.size()));
+        out_->append(value);
+    }
+
+    void put(const ColMeta &col) {
+        put(col.tab_name);
+        put(col.name);
+        put<int32_t>(col.type);
+        put<int32_t>(col.len);
+        put<int32_t>(col.offset);
+        put<uint8_t>(col.index);
+    }
+
+    void put(const TabMeta &tab) {
+        put(tab.name);
+        put<oid_t>(tab.oid);
+        put<uint32_t>(static_cast<uint32_t>(tab.cols.size()));
+        for (auto &col : tab.cols) {
+            put(col);
+        }
+        put<uint32_t>(static_cast<uint32_t>(tab.indexes.size()));
+        for (auto &index : tab.indexes) {
+            put(index.tab_name);
+            put<uint8_t>(index.type);
+            put<int32_t>(index.col_tot_len);
+            put<uint32_t>(static_cast<uint32_t>(index.cols.size()));
+            for (auto &col : index.cols) {
+                put(col);
+            }
+        }
+        put<uint8_t>(tab.stats.analyzed);
+        put<int64_t>(tab.stats.num_rows);
+        put<int32_t>(tab.stats.num_pages);
+        put<uint32_t>(static_cast<uint32_t>(tab.stats.cols.size()));
+        for (auto &col : tab.stats.cols) {
+            put<double>(col.num_distinct);
+            put<double>(col.min);
+            put<double>(col.max);
+            put<uint32_t>(static_cast<uint32_t>(col.bounds.size()));
+            for (double bound : col.bounds) {
+                put<double>(bound);
+            }
+        }
+        // 分区方式在条目的最后，旧版本写入的条目没有这一部分
+        put<uint8_t>(tab.partition.type);
+        if (tab.partition.is_partitioned()) {
+            put(tab.partition.col);
+            put<uint32_t>(static_cast<uint32_t>(tab.partition.size()));
+            for (size_t i = 0; i < tab.partition.size(); ++i) {
+                put(tab.partition.names[i]);
+                put(tab.partition.bounds[i]);
+            }
+        }
+        // 物化视图的定义在分区方式之后，不是物化视图的表没有这一部分
+        if (tab.view.is_view()) {
+            put(tab.view.sql);
+            put<uint8_t>(tab.view.refresh);
+            put<uint32_t>(static_cast<uint32_t>(tab.view.base_tabs.size()));
+            for (auto &base : tab.view.base_tabs) {
+                put(base);
+            }
+        }
+    }
+
+   private:
+    std::string *out_;
+};
+
+/* 从条目的内容中读出元数据，内容不完整时抛出异常 */
+class CatalogReader {
+   public:
+    CatalogReader(const char *data, size_t size) : pos_(data), end_(data + size) {}
+
+    template <typename T>
+    T get() {
+        T value;
+        take(&value, sizeof(T));
+        return value;
+    }
+
+    void get(std::string *value) {
+        uint32_t size = get<uint32_t>();
+        if (static_cast<size_t>(end_ - pos_) < size) {
+            throw InternalError("SmCatalog: truncated entry");
+        }
+        value->assign(pos_, size);
+        pos_ += size;
+    }
+
+    void get(ColMeta *col) {
+        get(&col->tab_name);
+        get(&col->name);
+        col->type = static_cast<ColType>(get<int32_t>());
+        col->len = get<int32_t>();
+        col->offset = get<int32_t>();
+        col->index = get<uint8_t>() != 0;
+    }
+
+    void get(TabMeta *tab) {
+        get(&tab->name);
+        tab->oid = get<oid_t>();
+        tab->cols.resize(get<uint32_t>());
+        for (auto &col : tab->cols) {
+            get(&col);
+        }
+        tab->indexes.resize(get<uint32_t>());
+        for (auto &index : tab->indexes) {
+            get(&index.tab_name);
+            index.type = static_cast<IndexType>(get<uint8_t>());
+            index.col_tot_len = get<int32_t>();
+            index.cols.resize(get<uint32_t>());
+            index.col_num = static_cast<int>(index.cols.size());
+            for (auto &col : index.cols) {
+                get(&col);
+            }
+        }
+        tab->index_cols();
+        tab->stats.analyzed = get<uint8_t>() != 0;
+        tab->stats.num_rows = get<int64_t>();
+        tab->stats.num_pages = get<int32_t>();
+        tab->stats.cols.resize(get<uint32_t>());
+        for (auto &col : tab->stats.cols) {
+            col.num_distinct = get<double>();
+            col.min = get<double>();
+            col.max = get<double>();
+            col.bounds.resize(get<uint32_t>());
+            for (double &bound : col.bounds) {
+                bound = get<double>();
+            }
+        }
+        tab->partition = PartitionMeta();
+        tab->view = MatViewMeta();
+        if (pos_ == end_) {
+            return;
+        }
+        tab->partition.type = static_cast<PartitionType>(get<uint8_t>());
+        if (tab->partition.is_partitioned()) {
+            get(&tab->partition.col);
+            uint32_t n = get<uint32_t>();
+            tab->partition.names.resize(n);
+            tab->partition.bounds.resize(n);
+            for (uint32_t i = 0; i < n; ++i) {
+                get(&tab->partition.names[i]);
+                get(&tab->partition.bounds[i]);
+            }
+        }
+        if (pos_ == end_) {
+            return;
+        }
+        get(&tab->view.sql);
+        tab->view.refresh = static_cast<ViewRefresh>(get<uint8_t>());
+        tab->view.base_tabs.resize(get<uint32_t>());
+        for (auto &base : tab->view.base_tabs) {
+            get(&base);
+        }
+    }
+
+   private:
+    void take(void *dest, size_t size) {
+        if (static_cast<size_t>(end_ - pos_) < size) {
+            throw InternalError("SmCatalog: truncated entry");
+        }
+        memcpy(dest, pos_, size);
+        pos_ += size;
+    }
+
+    const char *pos_;
+    const char *end_;
+};
+
+/* 一个完整的条目：长度、校验和、类型和内容 */
+static std::string make_entry(CatalogEntryType type, const std::string &payload) {
+    std::string entry;
+    uint32_t size = static_cast<uint32_t>(payload.size());
+    uint32_t checksum = catalog_checksum(static_cast<uint8_t>(type), payload.data(), payload.size());
+    entry.append(reinterpret_cast<const char *>(&size), sizeof(size));
+    entry.append(reinterpret_cast<const char *>(&checksum), sizeof(checksum));
+    entry.push_back(static_cast<char>(type));
+    entry.append(payload);
+    return entry;
+}
+
+static std::string table_payload(const TabMeta &tab) {
+    std::string payload;
+    CatalogWriter(&payload).put(tab);
+    return payload;
+}
+
+static void write_all(int fd, const std::string &data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = write(fd, data.data() + written, data.size() - written);
+        if (n < 0) {
+            throw UnixError();
+        }
+        written += static_cast<size_t>(n);
+    }
+}
+
+/**
+ * @description: 当前目录中是否有二进制的元数据文件，没有时由旧版本的db.meta迁移
+ */
+bool SmCatalog::exists() {
+    struct stat st;
+    return stat(CATALOG_FILE_NAME.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+/**
+ * @description: 在当前目录中创建元数据文件，写入db的全部元数据
+ */
+void SmCatalog::create(const DbMeta &db) {
+    std::unordered_map<std::string, size_t> live_sizes;
+    size_t live_bytes = 0;
+    write_snapshot(CATALOG_FILE_NAME, db, &live_sizes, &live_bytes);
+}
+
+/**
+ * @description: 先写入临时文件并持久化，再替换path，替换之前故障时原文件不受影响
+ */
+void SmCatalog::write_snapshot(const std::string &path, const DbMeta &db,
+                               std::unordered_map<std::string, size_t> *live_sizes, size_t *live_bytes) {
+    std::string data;
+    std::string payload;
+    CatalogWriter writer(&payload);
+    writer.put(db.name_);
+    writer.put<int32_t>(db.page_size_);
+    data += make_entry(CatalogEntryType::DATABASE, payload);
+    live_sizes->clear();
+    for (auto &[tab_name, tab] : db.tabs_) {
+        std::string entry = make_entry(CatalogEntryType::TABLE, table_payload(tab));
+        live_sizes->emplace(tab_name, entry.size());
+        data += entry;
+    }
+    *live_bytes = data.size();
+
+    std::string tmp_name = path + ".tmp";
+    int fd = ::open(tmp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        throw UnixError();
+    }
+    try {
+        write_all(fd, data);
+        if (fsync(fd) != 0) {
+            throw UnixError();
+        }
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+    if (rename(tmp_name.c_str(), path.c_str()) != 0) {
+        throw UnixError();
+    }
+}
+
+/**
+ * @description: 打开当前目录中的元数据文件，重放全部条目得到db。末尾校验失败的条目是故障时写了一半的，截掉
+ * @param {DbMeta*} db 读出的元数据，之后压缩时写入新文件的也是它
+ */
+void SmCatalog::open(DbMeta *db) {
+    close();
+    fd_ = ::open(CATALOG_FILE_NAME.c_str(), O_RDWR);
+    if (fd_ < 0) {
+        throw FileNotFoundError(CATALOG_FILE_NAME);
+    }
+    struct stat st;
+    if (fstat(fd_, &st) != 0) {
+        throw UnixError();
+    }
+    std::vector<char> data(st.st_size);
+    if (pread(fd_, data.data(), data.size(), 0) != static_cast<ssize_t>(data.size())) {
+        throw UnixError();
+    }
+
+    db->clear_tables();
+    db->page_size_ = PAGE_SIZE;
+    live_sizes_.clear();
+    live_bytes_ = 0;
+    size_t pos = 0;
+    while (data.size() - pos >= static_cast<size_t>(CATALOG_ENTRY_HEADER)) {
+        uint32_t size, checksum;
+        memcpy(&size, data.data() + pos, sizeof(size));
+        memcpy(&checksum, data.data() + pos + sizeof(size), sizeof(checksum));
+        uint8_t type = static_cast<uint8_t>(data[pos + 2 * sizeof(uint32_t)]);
+        const char *payload = data.data() + pos + CATALOG_ENTRY_HEADER;
+        size_t entry_size = CATALOG_ENTRY_HEADER + static_cast<size_t>(size);
+        if (data.size() - pos < entry_size || catalog_checksum(type, payload, size) != checksum) {
+            break;
+        }
+        CatalogReader reader(payload, size);
+        switch (static_cast<CatalogEntryType>(type)) {
+            case CatalogEntryType::DATABASE:
+                reader.get(&db->name_);
+                db->page_size_ = reader.get<int32_t>();
+                live_bytes_ += entry_size;
+                break;
+            case CatalogEntryType::TABLE: {
+                TabMeta tab;
+                reader.get(&tab);
+                live_bytes_ -= live_sizes_[tab.name];
+                live_sizes_[tab.name] = entry_size;
+                live_bytes_ += entry_size;
+                db->SetTabMeta(tab.name, tab);
+                break;
+            }
+            case CatalogEntryType::DROP_TABLE: {
+                std::string tab_name;
+                reader.get(&tab_name);
+                auto it = live_sizes_.find(tab_name);
+                if (it != live_sizes_.end()) {
+                    live_bytes_ -= it->second;
+                    live_sizes_.erase(it);
+                }
+                db->erase_table(tab_name);
+                break;
+            }
+            default:
+                throw InternalError("SmCatalog: unknown entry type");
+        }
+        pos += entry_size;
+    }
+    size_ = static_cast<off_t>(pos);
+    if (size_ < st.st_size && ftruncate(fd_, size_) != 0) {
+        throw UnixError();
+    }
+    db_ = db;
+}
+
+void SmCatalog::close() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    db_ = nullptr;
+}
+
+/**
+ * @description: 追加一张表的元数据，覆盖这张表之前的条目。创建表、修改索引和统计信息之后调用
+ */
+void SmCatalog::put_table(const TabMeta &tab) {
+    std::string payload = table_payload(tab);
+    append(CatalogEntryType::TABLE, payload);
+    size_t entry_size = CATALOG_ENTRY_HEADER + payload.size();
+    auto [it, inserted] = live_sizes_.emplace(tab.name, entry_size);
+    if (!inserted) {
+        live_bytes_ -= it->second;
+        it->second = entry_size;
+    }
+    live_bytes_ += entry_size;
+}
+
+/**
+ * @description: 追加删除一张表的条目
+ */
+void SmCatalog::drop_table(const std::string &tab_name) {
+    std::string payload;
+    CatalogWriter(&payload).put(tab_name);
+    append(CatalogEntryType::DROP_TABLE, payload);
+    auto it = live_sizes_.find(tab_name);
+    if (it != live_sizes_.end()) {
+        live_bytes_ -= it->second;
+        live_sizes_.erase(it);
+    }
+}
+
+/**
+ * @description: 把db的全部元数据写入新文件并替换原文件，之前被覆盖和删除的条目不再保留
+ */
+void SmCatalog::rewrite(const DbMeta &db) {
+    ::close(fd_);
+    fd_ = -1;
+    write_snapshot(CATALOG_FILE_NAME, db, &live_sizes_, &live_bytes_);
+    fd_ = ::open(CATALOG_FILE_NAME.c_str(), O_RDWR);
+    if (fd_ < 0) {
+        throw UnixError();
+    }
+    size_ = static_cast<off_t>(live_bytes_);
+    db_ = &db;
+}
+
+/**
+ * @description: 在文件末尾写入一个条目并持久化，写入之后DDL的修改才算完成。
+ *              无效的条目超过CATALOG_COMPACT_BYTES并且多于有效的条目时改为压缩文件：
+ *              调用者已经修改了内存中的元数据，新文件中已经包含这个条目
+ */
+void SmCatalog::append(CatalogEntryType type, const std::string &payload) {
+    if (fd_ < 0) {
+        throw InternalError("SmCatalog: catalog is not open");
+    }
+    size_t dead_bytes = static_cast<size_t>(size_) - live_bytes_;
+    if (db_ != nullptr && dead_bytes > CATALOG_COMPACT_BYTES && dead_bytes > live_bytes_) {
+        rewrite(*db_);
+        return;
+    }
+    std::string entry = make_entry(type, payload);
+    ssize_t n = pwrite(fd_, entry.data(), entry.size(), size_);
+    if (n != static_cast<ssize_t>(entry.size()) || fdatasync(fd_) != 0) {
+        throw UnixError();
+    }
+    size_ += static_cast<off_t>(entry.size());
+}
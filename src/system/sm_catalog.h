@@ -0,0 +1,64 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <sys/types.h>
+
+#include <string>
+#include <unordered_map>
+
+#include "sm_meta.h"
+
+/* 元数据文件中的条目类型 */
+enum class CatalogEntryType : uint8_t {
+    DATABASE = 1,   // 数据库名称和页面大小
+    TABLE,          // 一张表的完整元数据，覆盖之前同名的条目
+    DROP_TABLE,     // 删除一张表
+};
+
+/**
+ * @description: 二进制的元数据文件，由一串条目组成，每个条目依次为长度、校验和、类型和内容。
+ *              一次DDL只追加它修改的那张表的条目并持久化，不重写整个目录；打开数据库时按顺序重放全部条目，
+ *              后面的条目覆盖前面的，末尾写了一半的条目被截掉。被覆盖和删除的条目超过有效条目时
+ *              把当前的元数据写入新文件并替换原文件
+ */
+class SmCatalog {
+   public:
+    SmCatalog() = default;
+
+    ~SmCatalog() { close(); }
+
+    static bool exists();
+
+    static void create(const DbMeta &db);
+
+    void open(DbMeta *db);
+
+    void close();
+
+    void put_table(const TabMeta &tab);
+
+    void drop_table(const std::string &tab_name);
+
+    void rewrite(const DbMeta &db);
+
+   private:
+    static void write_snapshot(const std::string &path, const DbMeta &db,
+                               std::unordered_map<std::string, size_t> *live_sizes, size_t *live_bytes);
+
+    void append(CatalogEntryType type, const std::string &payload);
+
+    int fd_ = -1;                                           // 元数据文件
+    off_t size_ = 0;                                        // 文件中有效条目的末尾
+    std::unordered_map<std::string, size_t> live_sizes_;   // 每张表当前有效的条目的大小
+    size_t live_bytes_ = 0;                                 // 有效条目的总大小
+    const DbMeta *db_ = nullptr;                            // 压缩时写入的元数据
+};
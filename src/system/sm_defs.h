@@ -11,3 +11,21 @@ See the Mulan PSL v2 for more details. */
 
 #include "defs.h"
 #include <string>
+
+/* 表的存储方式：ROW按行存放记录，PAX在每个页面内按列存放记录 */
+enum TabStorage { STORAGE_ROW, STORAGE_PAX };
+
+/* 表的页面压缩：LZ4压缩后表和它的索引的页面在磁盘上以LZ4块格式存放，缓冲池中仍是未压缩的页面 */
+enum TabCompression { COMPRESSION_NONE, COMPRESSION_LZ4 };
+
+/* 索引的类型：BTREE支持范围查询和有序扫描，HASH为可扩展哈希，LSM把写入攒在内存中批量写成有序段，后两者只支持等值查找 */
+enum IndexType { INDEX_BTREE, INDEX_HASH, INDEX_LSM };
+
+/* 只支持等值查找的索引，查询计划使用HashScan */
+inline bool is_point_index(IndexType type) { return type == INDEX_HASH || type == INDEX_LSM; }
+
+/* 表的分区方式：RANGE按分区键所在的范围，HASH按分区键的哈希值把记录分到各个分区 */
+enum PartitionType { PARTITION_NONE, PARTITION_RANGE, PARTITION_HASH };
+
+/* 物化视图的刷新方式：IMMEDIATE在修改基表的事务提交时增量维护，DEFERRED只在REFRESH MATERIALIZED VIEW时重新计算 */
+enum ViewRefresh { REFRESH_IMMEDIATE, REFRESH_DEFERRED };
@@ -13,9 +13,18 @@ See the Mulan PSL v2 for more details. */
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
 #include <fstream>
+#include <functional>
 
+#include "common/memory_tracker.h"
+#include "common/metrics.h"
+#include "execution/parallel_sort.h"
 #include "index/ix.h"
+#include "output_log.h"
 #include "record/rm.h"
 #include "record_printer.h"
 
@@ -32,8 +41,12 @@ bool SmManager::is_dir(const std::string& db_name) {
 /**
  * @description: 创建数据库，所有的数据库相关文件都放在数据库同名文件夹下
  * @param {string&} db_name 数据库名称
+ * @param {int} page_size 数据库的页面大小，记录在db.meta中，必须是不小于PAGE_SIZE、不大于MAX_PAGE_SIZE的2的幂
  */
-void SmManager::create_db(const std::string& db_name) {
+void SmManager::create_db(const std::string& db_name, int page_size) {
+    if (page_size < PAGE_SIZE || page_size > MAX_PAGE_SIZE || (page_size & (page_size - 1)) != 0) {
+        throw InvalidPageSizeError(page_size);
+    }
     if (is_dir(db_name)) {
         throw DatabaseExistsError(db_name);
     }
@@ -48,12 +61,10 @@ void SmManager::create_db(const std::string& db_name) {
     //创建系统目录
     DbMeta *new_db = new DbMeta();
     new_db->name_ = db_name;
+    new_db->page_size_ = page_size;
 
-    // 注意，此处ofstream会在当前目录创建(如果没有此文件先创建)和打开一个名为DB_META_NAME的文件
-    std::ofstream ofs(DB_META_NAME);
-
-    // 将new_db中的信息，按照定义好的operator<<操作符，写入到ofs打开的DB_META_NAME文件中
-    ofs << *new_db;  // 注意：此处重载了操作符<<
+    // 在当前目录创建二进制的元数据文件，写入数据库名称和页面大小
+    SmCatalog::create(*new_db);
 
     delete new_db;
 
@@ -94,56 +105,166 @@ void SmManager::open_db(const std::string& db_name) {
     if (chdir(db_name.c_str()) < 0) {
         throw UnixError();
     }
-    // 3. 读取元数据文件 (db.meta)。
+    // 3. 读取元数据文件 (db.catalog)。
     // 这个文件存储了当前数据库里有哪些表，每张表有哪些列，以及每张表上有哪些索引。
-    {
+    // 旧版本创建的数据库只有文本格式的 db.meta，读出之后转换成二进制的元数据文件
+    if (!SmCatalog::exists()) {
         std::ifstream ifs(DB_META_NAME);
         if (!ifs.good()) {
-            throw FileNotFoundError(DB_META_NAME);
+            throw FileNotFoundError(CATALOG_FILE_NAME);
         }
         // 使用重载的 >> 运算符，将文件内容反序列化到 db_ 成员变量中
         ifs >> db_;
+        SmCatalog::create(db_);
     }
-    // 4. 加载所有表的记录文件句柄 (fhs_)。
-    // 系统启动时需要把磁盘上的文件打开，获取句柄后存入内存哈希表，以便后续增删改查算子能直接使用。
-    fhs_.clear();
-    for (auto &entry : db_.tabs_) {
-        const std::string &tab_name = entry.first;
-        // rm_manager_ 负责打开记录文件并返回一个文件句柄
-        fhs_.emplace(tab_name, rm_manager_->open_file(tab_name));
+    catalog_.open(&db_);
+    // 按数据库记录的页面大小读写磁盘文件和划分缓冲池的帧，需在打开任何数据文件之前设置
+    disk_manager_->set_page_size(db_.page_size_);
+    buffer_pool_manager_->set_page_size(db_.page_size_);
+    // 4. 表和索引的文件在第一次访问时才打开（get_table_handle等），启动时间与表和索引的个数无关。
+    // 旧版本创建的表没有oid，日志中用oid标识表，写任何日志之前分配
+    {
+        std::unique_lock handles_lock{handles_latch_};
+        fhs_.clear();
+        ihs_.clear();
+        hhs_.clear();
     }
-    // 5. 加载所有索引的文件句柄 (ihs_)。
-    // 索引也是以文件形式存储的，我们需要根据 TabMeta 记录的索引信息逐一打开。
-    ihs_.clear();
+    bool assigned = false;
     for (auto &entry : db_.tabs_) {
-        auto &tab = entry.second;
-        for (auto &index_meta : tab.indexes) {
-            // 根据表名和列名列表，通过 ix_manager 计算出索引在磁盘上的文件名
-            auto ih = ix_manager_->open_index(tab.name, index_meta.cols);
-            std::string ix_name = ix_manager_->get_index_name(tab.name, index_meta.cols);
-            // 将索引句柄存入哈希表，key 是索引文件名
-            ihs_.emplace(ix_name, std::move(ih));
+        if (entry.second.oid == 0) {
+            entry.second.oid = db_.next_oid();
+            assigned = true;
+        }
+    }
+    if (assigned) {
+        db_.index_tables();
+        flush_meta();
+    }
+}
+
+/**
+ * @description: 取得表的记录文件句柄，第一次访问时打开文件。打开之后直到删除表或关闭数据库都不会关闭：
+ *              句柄中有记录的旧版本和记录数的变化量，锁管理器也按文件描述符区分不同的表
+ * @return {RmFileHandle*} 表不存在时返回nullptr
+ * @param {string&} tab_name 表名称
+ */
+RmFileHandle* SmManager::find_table_handle(const std::string& tab_name) {
+    {
+        std::shared_lock handles_lock{handles_latch_};
+        auto it = fhs_.find(tab_name);
+        if (it != fhs_.end()) {
+            return it->second.get();
+        }
+    }
+    std::unique_lock handles_lock{handles_latch_};
+    auto it = fhs_.find(tab_name);
+    if (it != fhs_.end()) {
+        return it->second.get();
+    }
+    if (!db_.is_table(tab_name)) {
+        return nullptr;
+    }
+    auto fh = rm_manager_->open_file(tab_name);
+    fh->set_oid(db_.get_table(tab_name).oid);
+    return fhs_.emplace(tab_name, std::move(fh)).first->second.get();
+}
+
+/**
+ * @description: 取得表的记录文件句柄，第一次访问时打开文件
+ * @param {string&} tab_name 表名称，表不存在时抛出TableNotFoundError
+ */
+RmFileHandle* SmManager::get_table_handle(const std::string& tab_name) {
+    RmFileHandle* fh = find_table_handle(tab_name);
+    if (fh == nullptr) {
+        throw TableNotFoundError(tab_name);
+    }
+    return fh;
+}
+
+/**
+ * @description: 取得表tab_name上B+树索引index的句柄，第一次访问时打开索引文件并读入文件头
+ */
+IxIndexHandle* SmManager::get_index_handle(const std::string& tab_name, const IndexMeta& index) {
+    std::string ix_name = ix_manager_->get_index_name(tab_name, index.cols);
+    {
+        std::shared_lock handles_lock{handles_latch_};
+        auto it = ihs_.find(ix_name);
+        if (it != ihs_.end()) {
+            return it->second.get();
         }
     }
+    std::unique_lock handles_lock{handles_latch_};
+    auto it = ihs_.find(ix_name);
+    if (it == ihs_.end()) {
+        it = ihs_.emplace(ix_name, ix_manager_->open_index(tab_name, index.cols)).first;
+    }
+    return it->second.get();
 }
 
 /**
- * @description: 把数据库相关的元数据刷入磁盘中
+ * @description: 取得表tab_name上哈希索引或LSM索引index的句柄，第一次访问时打开索引文件
+ */
+IxPointIndexHandle* SmManager::get_point_index_handle(const std::string& tab_name, const IndexMeta& index) {
+    std::string ix_name = ix_manager_->get_index_name(tab_name, index.cols);
+    {
+        std::shared_lock handles_lock{handles_latch_};
+        auto it = hhs_.find(ix_name);
+        if (it != hhs_.end()) {
+            return it->second.get();
+        }
+    }
+    std::unique_lock handles_lock{handles_latch_};
+    auto it = hhs_.find(ix_name);
+    if (it == hhs_.end()) {
+        it = hhs_.emplace(ix_name, ix_manager_->open_point_index(tab_name, index.cols, index.type)).first;
+    }
+    return it->second.get();
+}
+
+/**
+ * @description: 把数据库的全部元数据重新写入元数据文件，之前被覆盖的条目不再保留
  */
 void SmManager::flush_meta() {
-    // 默认清空文件并重新写入当前的 db_ 结构。
-    // 这是保证内存中的元数据变更（如新建表、删索引）能够持久化到磁盘的唯一手段。
-    std::ofstream ofs(DB_META_NAME);
-    ofs << db_;
+    catalog_version_++;
+    catalog_.rewrite(db_);
+}
+
+/**
+ * @description: 把一张表的元数据追加到元数据文件中，只写这张表，DDL的代价与数据库中表的个数无关
+ * @param {string&} tab_name 元数据被修改的表
+ */
+void SmManager::flush_table(const std::string& tab_name) {
+    catalog_version_++;
+    catalog_.put_table(db_.get_table(tab_name));
 }
 
 /**
  * @description: 关闭数据库并把数据落盘
  */
 void SmManager::close_db() {
-    // 1. 将最新的元数据写回 db.meta 文件体体
-    flush_meta();
-    // 2. 依次关闭所有打开的表文件句柄。
+    std::scoped_lock catalog_lock{catalog_latch_};
+    std::unique_lock handles_lock{handles_latch_};
+    // 1. 把上次ANALYZE之后记录数的变化合并到统计信息中，统计信息变化的表写回 db.catalog 文件
+    //    分区表的统计信息在分区表上，合并各分区记录数的变化
+    for (auto &entry : db_.tabs_) {
+        TabStats &stats = entry.second.stats;
+        if (!stats.analyzed) {
+            continue;
+        }
+        int64_t delta = 0;
+        for (auto &name : partition_tables(entry.first)) {
+            auto fh = fhs_.find(name);
+            if (fh != fhs_.end()) {
+                delta += fh->second->take_record_delta();
+            }
+        }
+        if (delta != 0) {
+            stats.num_rows = std::max<int64_t>(stats.num_rows + delta, 0);
+            flush_table(entry.first);
+        }
+    }
+    catalog_.close();
+    // 2. 依次关闭所有打开的表文件句柄，没有访问过的表没有打开。
     // close_file 会将记录文件的 header 信息刷盘，并确保 BufferPool 里的脏页全部写入磁盘。
     for (auto &entry : fhs_) {
         rm_manager_->close_file(entry.second.get());
@@ -155,9 +276,13 @@ void SmManager::close_db() {
         ix_manager_->close_index(entry.second.get());
     }
     ihs_.clear();
+    for (auto &entry : hhs_) {
+        ix_manager_->close_point_index(entry.second.get());
+    }
+    hhs_.clear();
     // 4. 清空内存中 db_ 结构体，标志当前没有打开任何数据库
     db_.name_.clear();
-    db_.tabs_.clear();
+    db_.clear_tables();
     // 5. 退出数据库文件夹，回到父目录。
     // 这一步与 open_db 时的 chdir 对称，防止系统在后续操作中路径错乱。
     if (chdir("..") < 0) {
@@ -165,13 +290,166 @@ void SmManager::close_db() {
     }
 }
 
+/**
+ * @description: 检查点在catalog_latch_内写回全部索引和表的文件头，以及索引的脏页，并取得表的脏页表。
+ *              索引的修改不写日志，检查点之后故障恢复重建日志中出现过的表的索引，其他索引与检查点时一致
+ * @param {unordered_map<oid_t, vector<pair<page_id_t, lsn_t>>>*} dirty_pages 表的oid和表中的脏页，以及脏页的recLSN
+ * @param {bool} flush_data 先写回表的全部脏页，故障恢复结束和关闭数据库时为true
+ */
+void SmManager::flush_for_checkpoint(
+    std::unordered_map<oid_t, std::vector<std::pair<page_id_t, lsn_t>>>* dirty_pages, bool flush_data) {
+    std::scoped_lock catalog_lock{catalog_latch_};
+    // 没有打开的表和索引没有脏页，文件头也与磁盘上的一致
+    std::shared_lock handles_lock{handles_latch_};
+    if (flush_data) {
+        for (auto &entry : fhs_) {
+            buffer_pool_manager_->flush_all_pages(entry.second->GetFd(), true);
+        }
+    }
+    for (auto &entry : ihs_) {
+        ix_manager_->flush_index(entry.second.get());
+    }
+    for (auto &entry : hhs_) {
+        ix_manager_->flush_point_index(entry.second.get());
+    }
+    std::unordered_map<int, oid_t> oid_of_fd;
+    for (auto &entry : fhs_) {
+        entry.second->flush_file_hdr();
+        oid_of_fd.emplace(entry.second->GetFd(), entry.second->get_oid());
+    }
+    std::vector<std::pair<PageId, lsn_t>> pages;
+    buffer_pool_manager_->get_dirty_page_table(&pages);
+    for (auto &[page_id, rec_lsn] : pages) {
+        auto it = oid_of_fd.find(page_id.fd);
+        if (it != oid_of_fd.end()) {
+            (*dirty_pages)[it->second].emplace_back(page_id.page_no, rec_lsn);
+        }
+    }
+}
+
+static constexpr uint32_t POOL_DUMP_MAGIC = 0x4c4f4f50;  // "POOL"
+
+/**
+ * @description: 把缓冲池中的页面按淘汰顺序写入db.pool，下次启动时restore_buffer_pool据此预热缓冲池。
+ *              文件中先是页面所在文件的文件名表，再是各页面的文件序号和页号，从最先被淘汰的页面开始；
+ *              先写入临时文件再改名，写入中途发生故障时保留上一次的记录
+ */
+void SmManager::dump_buffer_pool() {
+    std::vector<PageId> pages;
+    buffer_pool_manager_->get_resident_pages(&pages);
+    std::vector<std::string> files;
+    std::vector<std::pair<uint32_t, page_id_t>> entries;
+    {
+        // 记录期间打开的表和索引不会被关闭；取得页面列表之后才关闭的文件找不到文件名，跳过其中的页面
+        std::shared_lock handles_lock{handles_latch_};
+        std::unordered_map<int, uint32_t> file_nos;
+        for (auto &page_id : pages) {
+            auto it = file_nos.find(page_id.fd);
+            if (it == file_nos.end()) {
+                uint32_t file_no = UINT32_MAX;
+                try {
+                    files.push_back(disk_manager_->get_file_name(page_id.fd));
+                    file_no = files.size() - 1;
+                } catch (FileNotOpenError &) {
+                }
+                it = file_nos.emplace(page_id.fd, file_no).first;
+            }
+            if (it->second != UINT32_MAX) {
+                entries.emplace_back(it->second, page_id.page_no);
+            }
+        }
+    }
+    std::string tmp_name = POOL_DUMP_FILE_NAME + ".tmp";
+    std::ofstream ofs(tmp_name, std::ios::binary | std::ios::trunc);
+    auto put = [&](const void *data, size_t len) { ofs.write(static_cast<const char *>(data), len); };
+    uint32_t num_files = files.size();
+    uint32_t num_pages = entries.size();
+    put(&POOL_DUMP_MAGIC, sizeof(POOL_DUMP_MAGIC));
+    put(&num_files, sizeof(num_files));
+    for (auto &file : files) {
+        uint32_t len = file.size();
+        put(&len, sizeof(len));
+        put(file.data(), len);
+    }
+    put(&num_pages, sizeof(num_pages));
+    for (auto &[file_no, page_no] : entries) {
+        put(&file_no, sizeof(file_no));
+        put(&page_no, sizeof(page_no));
+    }
+    ofs.close();
+    if (!ofs.good() || rename(tmp_name.c_str(), POOL_DUMP_FILE_NAME.c_str()) != 0) {
+        throw UnixError();
+    }
+}
+
+/**
+ * @description: 读取db.pool，在后台预热缓冲池。记录中的文件按元数据找到对应的表或索引并打开句柄，
+ *              之后被删除的表和索引、以及超出文件当前页面个数的页面被跳过；没有记录或记录不完整时什么也不做
+ */
+void SmManager::restore_buffer_pool() {
+    std::ifstream ifs(POOL_DUMP_FILE_NAME, std::ios::binary);
+    auto get = [&](void *data, size_t len) { return static_cast<bool>(ifs.read(static_cast<char *>(data), len)); };
+    uint32_t magic = 0;
+    uint32_t num_files = 0;
+    if (!ifs.good() || !get(&magic, sizeof(magic)) || magic != POOL_DUMP_MAGIC || !get(&num_files, sizeof(num_files))) {
+        return;
+    }
+    // 表的数据文件与表同名，索引文件名由表名和索引列组成
+    std::unordered_map<std::string, std::function<void()>> openers;
+    for (auto &entry : db_.tabs_) {
+        const std::string &tab_name = entry.first;
+        openers[tab_name] = [this, tab_name] { get_table_handle(tab_name); };
+        for (auto &index : entry.second.indexes) {
+            openers[ix_manager_->get_index_name(tab_name, index.cols)] = [this, tab_name, index] {
+                if (is_point_index(index.type)) {
+                    get_point_index_handle(tab_name, index);
+                } else {
+                    get_index_handle(tab_name, index);
+                }
+            };
+        }
+    }
+    std::vector<int> fds(num_files, -1);
+    for (uint32_t i = 0; i < num_files; i++) {
+        uint32_t len = 0;
+        if (!get(&len, sizeof(len)) || len > PATH_MAX) {
+            return;
+        }
+        std::string file(len, '\0');
+        if (!get(file.data(), len)) {
+            return;
+        }
+        auto it = openers.find(file);
+        if (it != openers.end()) {
+            it->second();
+            fds[i] = disk_manager_->get_file_fd(file);
+        }
+    }
+    uint32_t num_pages = 0;
+    if (!get(&num_pages, sizeof(num_pages))) {
+        return;
+    }
+    std::vector<PageId> pages;
+    for (uint32_t i = 0; i < num_pages; i++) {
+        uint32_t file_no = 0;
+        page_id_t page_no = 0;
+        if (!get(&file_no, sizeof(file_no)) || !get(&page_no, sizeof(page_no))) {
+            break;
+        }
+        if (file_no < num_files && fds[file_no] != -1 && page_no >= 0 &&
+            page_no < disk_manager_->get_fd2pageno(fds[file_no])) {
+            pages.push_back(PageId{fds[file_no], page_no});
+        }
+    }
+    buffer_pool_manager_->warm_up(std::move(pages));
+}
+
 /**
  * @description: 显示所有的表,通过测试需要将其结果写入到output.txt,详情看题目文档
  * @param {Context*} context 
  */
 void SmManager::show_tables(Context* context) {
-    std::fstream outfile;
-    outfile.open("output.txt", std::ios::out | std::ios::app);
+    OutputBuffer outfile;
     outfile << "| Tables |\n";
     RecordPrinter printer(1);
     printer.print_separator(context);
@@ -179,11 +457,14 @@ void SmManager::show_tables(Context* context) {
     printer.print_separator(context);
     for (auto &entry : db_.tabs_) {
         auto &tab = entry.second;
+        // 分区是内部表，只显示分区表
+        if (PartitionMeta::is_partition(tab.name)) {
+            continue;
+        }
         printer.print_record({tab.name}, context);
         outfile << "| " << tab.name << " |\n";
     }
     printer.print_separator(context);
-    outfile.close();
 }
 
 /**
@@ -210,19 +491,306 @@ void SmManager::desc_table(const std::string& tab_name, Context* context) {
 }
 
 /**
- * @description: 创建表
+ * @description: 把缓冲池统计信息格式化为show buffer stats输出中的各列
+ * @return {vector<string>} 当前页面数、脏页数、命中、未命中、命中率、淘汰、脏页写回、预读和等待时间
+ * @param {BufferPoolStats&} stats 统计信息
+ */
+static std::vector<std::string> format_buffer_stats(const BufferPoolStats& stats) {
+    char hit_ratio[16];
+    snprintf(hit_ratio, sizeof(hit_ratio), "%.2f%%", stats.hit_ratio() * 100);
+    char pin_wait_ms[32];
+    snprintf(pin_wait_ms, sizeof(pin_wait_ms), "%.3f", stats.get(BufferPoolStats::PIN_WAIT_NS) / 1e6);
+    return {std::to_string(stats.resident_pages),
+            std::to_string(stats.dirty_pages),
+            std::to_string(stats.get(BufferPoolStats::HITS)),
+            std::to_string(stats.get(BufferPoolStats::MISSES)),
+            hit_ratio,
+            std::to_string(stats.get(BufferPoolStats::EVICTIONS)),
+            std::to_string(stats.get(BufferPoolStats::DIRTY_WRITES)),
+            std::to_string(stats.get(BufferPoolStats::PREFETCHED)),
+            pin_wait_ms};
+}
+
+/**
+ * @description: 显示缓冲池的统计信息：先按分片列出，最后一行为整个缓冲池的合计；再按文件列出，文件以表名或索引文件名标识
+ * @param {Context*} context 
+ */
+void SmManager::show_buffer_stats(Context* context) {
+    const std::vector<std::string> stat_captions = {"Resident",  "Dirty",        "Hits",       "Misses",       "Hit Ratio",
+                                                    "Evictions", "Dirty Writes", "Prefetched", "Pin Wait(ms)"};
+
+    // 各分片的统计
+    std::vector<std::string> captions = {"Shard", "Node", "Replacer", "Frames"};
+    captions.insert(captions.end(), stat_captions.begin(), stat_captions.end());
+    RecordPrinter shard_printer(captions.size());
+    shard_printer.print_separator(context);
+    shard_printer.print_record(captions, context);
+    shard_printer.print_separator(context);
+    BufferPoolStats total;
+    for (size_t i = 0; i < buffer_pool_manager_->get_num_shards(); ++i) {
+        BufferPoolStats stats = buffer_pool_manager_->get_shard_stats(i);
+        total.merge(stats);
+        std::vector<std::string> rec = {std::to_string(i), std::to_string(buffer_pool_manager_->get_shard_node(i)),
+                                        buffer_pool_manager_->get_replacer_type(),
+                                        std::to_string(buffer_pool_manager_->get_shard_pool_size(i))};
+        auto fields = format_buffer_stats(stats);
+        rec.insert(rec.end(), fields.begin(), fields.end());
+        shard_printer.print_record(rec, context);
+    }
+    std::vector<std::string> total_rec = {"Total", std::to_string(buffer_pool_manager_->get_num_nodes()),
+                                          buffer_pool_manager_->get_replacer_type(),
+                                          std::to_string(buffer_pool_manager_->get_pool_size())};
+    auto total_fields = format_buffer_stats(total);
+    total_rec.insert(total_rec.end(), total_fields.begin(), total_fields.end());
+    shard_printer.print_record(total_rec, context);
+    shard_printer.print_separator(context);
+
+    // 各文件的统计，已经关闭的文件残留在缓冲池中的页面显示为(closed)
+    captions = {"File", "Fd"};
+    captions.insert(captions.end(), stat_captions.begin(), stat_captions.end());
+    RecordPrinter file_printer(captions.size());
+    file_printer.print_separator(context);
+    file_printer.print_record(captions, context);
+    file_printer.print_separator(context);
+    for (auto& [fd, stats] : buffer_pool_manager_->get_file_stats()) {
+        std::string file_name;
+        try {
+            file_name = disk_manager_->get_file_name(fd);
+        } catch (FileNotOpenError&) {
+            file_name = "(closed)";
+        }
+        std::vector<std::string> rec = {file_name, std::to_string(fd)};
+        auto fields = format_buffer_stats(stats);
+        rec.insert(rec.end(), fields.begin(), fields.end());
+        file_printer.print_record(rec, context);
+    }
+    file_printer.print_separator(context);
+}
+
+/**
+ * @description: 把延迟直方图格式化为show metrics输出中的各列，延迟的单位为毫秒
+ * @return {vector<string>} 次数、每秒次数、平均值、P50、P99、P999和最大值
+ * @param {LatencyHistogram&} histogram 直方图
+ * @param {double} uptime 进程启动以来的秒数
+ */
+static std::vector<std::string> format_latency(const LatencyHistogram& histogram, double uptime) {
+    auto ms = [](double ns) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.3f", ns / 1e6);
+        return std::string(buf);
+    };
+    char rate[32];
+    snprintf(rate, sizeof(rate), "%.2f", uptime > 0 ? histogram.count() / uptime : 0);
+    return {std::to_string(histogram.count()),
+            rate,
+            ms(histogram.mean()),
+            ms(histogram.percentile(50)),
+            ms(histogram.percentile(99)),
+            ms(histogram.percentile(99.9)),
+            ms(histogram.max())};
+}
+
+/**
+ * @description: 显示进程启动以来的运行指标：先按语句类型列出语句数和延迟，再列出提交、加锁等待和刷日志的延迟，
+ * 然后是事务回滚次数、写入的日志字节数、启动时故障恢复各阶段的耗时（rec开头的三项）和缓冲池的命中情况，最后是全局以及各子系统的内存占用（字节）
+ * @param {Context*} context 
+ */
+void SmManager::show_metrics(Context* context) {
+    Metrics& metrics = Metrics::instance();
+    double uptime = metrics.uptime_seconds();
+
+    std::vector<std::string> captions = {"Metric",   "Count",    "Rate(/s)", "Mean(ms)",
+                                         "P50(ms)", "P99(ms)", "P999(ms)", "Max(ms)"};
+    RecordPrinter latency_printer(captions.size());
+    latency_printer.print_separator(context);
+    latency_printer.print_record(captions, context);
+    latency_printer.print_separator(context);
+    auto print_latency = [&](const std::string& name, const LatencyHistogram& histogram) {
+        std::vector<std::string> rec = {name};
+        auto fields = format_latency(histogram, uptime);
+        rec.insert(rec.end(), fields.begin(), fields.end());
+        latency_printer.print_record(rec, context);
+    };
+    for (int i = 0; i < Metrics::NUM_STATEMENT_TYPES; ++i) {
+        auto type = static_cast<Metrics::StatementType>(i);
+        print_latency(Metrics::statement_name(type), metrics.statement(type));
+    }
+    print_latency("commit", metrics.histogram(Metrics::COMMIT_LATENCY));
+    print_latency("lock wait", metrics.histogram(Metrics::LOCK_WAIT));
+    print_latency("log flush", metrics.histogram(Metrics::LOG_FLUSH_LATENCY));
+    latency_printer.print_separator(context);
+
+    BufferPoolStats buffer_stats = buffer_pool_manager_->get_stats();
+    char uptime_str[32];
+    snprintf(uptime_str, sizeof(uptime_str), "%.1f", uptime);
+    char hit_ratio[16];
+    snprintf(hit_ratio, sizeof(hit_ratio), "%.2f%%", buffer_stats.hit_ratio() * 100);
+    auto us_to_ms = [](int64_t us) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.3f", us / 1e3);
+        return std::string(buf);
+    };
+    std::vector<std::vector<std::string>> counters = {
+        {"uptime(s)", uptime_str},
+        {"txn aborts", std::to_string(metrics.get(Metrics::TXN_ABORTS))},
+        {"lock aborts", std::to_string(metrics.get(Metrics::LOCK_ABORTS))},
+        {"log bytes", std::to_string(metrics.get(Metrics::LOG_BYTES))},
+        {"rec analyze(ms)", us_to_ms(metrics.get(Metrics::RECOVERY_ANALYZE_US))},
+        {"rec redo(ms)", us_to_ms(metrics.get(Metrics::RECOVERY_REDO_US))},
+        {"rec undo(ms)", us_to_ms(metrics.get(Metrics::RECOVERY_UNDO_US))},
+        {"buffer hits", std::to_string(buffer_stats.get(BufferPoolStats::HITS))},
+        {"buffer misses", std::to_string(buffer_stats.get(BufferPoolStats::MISSES))},
+        {"buffer hit ratio", hit_ratio}};
+    // 复制的状态：备库的复制延迟为回放到的日志在主库上发送之后经过的时间，已经追上主库时为0
+    auto role = static_cast<Metrics::ReplicationRole>(metrics.get(Metrics::REPLICATION_ROLE));
+    if (role == Metrics::PRIMARY) {
+        counters.push_back({"replication role", "primary"});
+        counters.push_back({"replicas", std::to_string(metrics.get(Metrics::REPLICAS))});
+        counters.push_back({"replica min lsn", std::to_string(metrics.get(Metrics::REPLICATED_LSN))});
+        counters.push_back({"persist lsn", std::to_string(metrics.get(Metrics::PRIMARY_LSN))});
+    } else if (role == Metrics::REPLICA) {
+        int64_t behind_since = metrics.get(Metrics::REPLICA_BEHIND_SINCE_US);
+        int64_t now = std::chrono::duration_cast<std::chrono::microseconds>(
+                          std::chrono::system_clock::now().time_since_epoch())
+                          .count();
+        int64_t lag_ms = behind_since == 0 ? 0 : std::max<int64_t>(now - behind_since, 0) / 1000;
+        counters.push_back({"replication role", "replica"});
+        counters.push_back({"primary connected", metrics.get(Metrics::REPLICAS) != 0 ? "yes" : "no"});
+        counters.push_back({"replayed lsn", std::to_string(metrics.get(Metrics::REPLICATED_LSN))});
+        counters.push_back({"primary lsn", std::to_string(metrics.get(Metrics::PRIMARY_LSN))});
+        counters.push_back({"replication lag(ms)", std::to_string(lag_ms)});
+    }
+    RecordPrinter counter_printer(2);
+    counter_printer.print_separator(context);
+    counter_printer.print_record({"Counter", "Value"}, context);
+    counter_printer.print_separator(context);
+    for (auto& rec : counters) {
+        counter_printer.print_record(rec, context);
+    }
+    counter_printer.print_separator(context);
+
+    auto limit_str = [](size_t limit) { return limit == 0 ? std::string("unlimited") : std::to_string(limit); };
+    RecordPrinter memory_printer(4);
+    memory_printer.print_separator(context);
+    memory_printer.print_record({"Memory", "Used", "Peak", "Limit"}, context);
+    memory_printer.print_separator(context);
+    MemoryTracker& global = MemoryTracker::global();
+    memory_printer.print_record(
+        {"total", std::to_string(global.used()), std::to_string(global.peak()), limit_str(global.limit())}, context);
+    for (int i = 0; i < MemoryTracker::NUM_SUBSYSTEMS; ++i) {
+        auto subsystem = static_cast<MemoryTracker::Subsystem>(i);
+        MemoryTracker& tracker = MemoryTracker::subsystem(subsystem);
+        memory_printer.print_record({MemoryTracker::subsystem_name(subsystem), std::to_string(tracker.used()),
+                                     std::to_string(tracker.peak()), limit_str(tracker.limit())},
+                                    context);
+    }
+    memory_printer.print_separator(context);
+}
+
+/**
+ * @description: 按分区方式的定义构造表tab的分区元数据，检查分区键、分区个数和RANGE分区的上界
+ */
+static PartitionMeta make_partition_meta(TabMeta& tab, const PartitionDef& def) {
+    PartitionMeta meta;
+    meta.type = def.type;
+    meta.col = *tab.get_col(def.col_name);
+    if (def.names.empty() || def.names.size() > static_cast<size_t>(MAX_PARTITIONS)) {
+        throw InvalidPartitionError("a table takes 1 to " + std::to_string(MAX_PARTITIONS) + " partitions");
+    }
+    for (size_t i = 0; i < def.names.size(); ++i) {
+        if (std::find(def.names.begin(), def.names.begin() + i, def.names[i]) != def.names.begin() + i) {
+            throw InvalidPartitionError("duplicate partition " + def.names[i]);
+        }
+    }
+    meta.names = def.names;
+    meta.bounds.resize(def.names.size());
+    for (size_t i = 0; i < def.bounds.size(); ++i) {
+        Value bound = def.bounds[i];
+        if (!is_compatible_type(meta.col.type, bound.type)) {
+            throw IncompatibleTypeError(coltype2str(meta.col.type), coltype2str(bound.type));
+        }
+        bound.init_raw(meta.col.len);
+        meta.bounds[i].assign(bound.raw->data, meta.col.len);
+        if (i > 0 && meta.compare(meta.bounds[i - 1].data(), meta.bounds[i].data()) >= 0) {
+            throw InvalidPartitionError("partition bounds must be strictly increasing");
+        }
+    }
+    return meta;
+}
+
+/**
+ * @description: 创建表。分区表的每个分区创建为一张内部表，分区表本身只有元数据
  * @param {string&} tab_name 表的名称
  * @param {vector<ColDef>&} col_defs 表的字段
  * @param {Context*} context 
+ * @param {TabStorage} storage 表的存储方式，分区表的各分区都使用这种方式
+ * @param {PartitionDef&} partition 表的分区方式
+ * @param {TabCompression} compression 表的页面压缩方式，表上的索引使用同样的方式，分区表的各分区都使用这种方式
  */
-void SmManager::create_table(const std::string& tab_name, const std::vector<ColDef>& col_defs, Context* context) {
+void SmManager::create_table(const std::string& tab_name, const std::vector<ColDef>& col_defs, Context* context,
+                             TabStorage storage, const PartitionDef& partition, TabCompression compression) {
+    std::scoped_lock catalog_lock{catalog_latch_};
     if (db_.is_table(tab_name)) {
         throw TableExistsError(tab_name);
     }
-    // Create table meta
+    TabMeta tab = make_table_meta(tab_name, col_defs);
+    if (partition.type != PARTITION_NONE) {
+        tab.partition = make_partition_meta(tab, partition);
+        for (size_t i = 0; i < tab.partition.size(); ++i) {
+            if (db_.is_table(tab.partition.table_name(tab_name, i))) {
+                throw TableExistsError(tab.partition.table_name(tab_name, i));
+            }
+        }
+        // 分区先于分区表写入元数据文件，中途故障时留下的分区不会出现在SHOW TABLES中
+        for (size_t i = 0; i < tab.partition.size(); ++i) {
+            std::string part_name = tab.partition.table_name(tab_name, i);
+            TabMeta part = make_table_meta(part_name, col_defs);
+            create_table_file(part, col_defs, storage, compression);
+            db_.SetTabMeta(part_name, part);
+            flush_table(part_name);
+        }
+        tab.oid = db_.next_oid();
+    } else {
+        create_table_file(tab, col_defs, storage, compression);
+    }
+    db_.SetTabMeta(tab_name, tab);
+    flush_table(tab_name);
+}
+
+/**
+ * @description: 创建物化视图的表，视图的内容由调用者在之后插入。物化视图不分区，按行存放
+ * @param {string&} tab_name 视图的名称
+ * @param {vector<ColDef>&} col_defs 视图的字段，与定义中select列表的输出一一对应
+ * @param {MatViewMeta&} view 视图的定义
+ * @param {Context*} context
+ */
+void SmManager::create_mat_view(const std::string& tab_name, const std::vector<ColDef>& col_defs,
+                                const MatViewMeta& view, Context* context) {
+    std::scoped_lock catalog_lock{catalog_latch_};
+    if (db_.is_table(tab_name)) {
+        throw TableExistsError(tab_name);
+    }
+    // 定义经过语义分析之后基表可能已被删除
+    for (auto& base : view.base_tabs) {
+        if (!db_.is_table(base)) {
+            throw TableNotFoundError(base);
+        }
+    }
+    TabMeta tab = make_table_meta(tab_name, col_defs);
+    tab.view = view;
+    create_table_file(tab, col_defs, STORAGE_ROW, COMPRESSION_NONE);
+    db_.SetTabMeta(tab_name, tab);
+    flush_table(tab_name);
+}
+
+/**
+ * @description: 按字段定义构造表的元数据，并分配oid
+ */
+TabMeta SmManager::make_table_meta(const std::string& tab_name, const std::vector<ColDef>& col_defs) {
     int curr_offset = 0;
     TabMeta tab;
     tab.name = tab_name;
+    tab.oid = db_.next_oid();
     for (auto &col_def : col_defs) {
         ColMeta col = {.tab_name = tab_name,
                        .name = col_def.name,
@@ -233,54 +801,135 @@ void SmManager::create_table(const std::string& tab_name, const std::vector<ColD
         curr_offset += col_def.len;
         tab.cols.push_back(col);
     }
-    // Create & open record file
-    int record_size = curr_offset;  // record_size就是col meta所占的大小（表的元数据也是以记录的形式进行存储的）
-    rm_manager_->create_file(tab_name, record_size);
-    db_.tabs_[tab_name] = tab;
-    // fhs_[tab_name] = rm_manager_->open_file(tab_name);
-    fhs_.emplace(tab_name, rm_manager_->open_file(tab_name));
+    tab.index_cols();
+    return tab;
+}
 
-    flush_meta();
+/**
+ * @description: 创建表的数据文件。压缩方式记录在数据文件上（映射表文件），字典编码的字段记录在数据文件的文件头中，
+ *              都不写入表的元数据。前RM_MAX_ZONE_FIELDS个INT和FLOAT字段维护区间映射，按范围扫描时跳过不相交的页面
+ */
+void SmManager::create_table_file(const TabMeta& tab, const std::vector<ColDef>& col_defs, TabStorage storage,
+                                  TabCompression compression) {
+    bool compressed = compression == COMPRESSION_LZ4;
+    int record_size = 0;  // record_size就是col meta所占的大小（表的元数据也是以记录的形式进行存储的）
+    std::vector<RmZoneField> zone_fields;
+    for (auto &col : tab.cols) {
+        record_size += col.len;
+        if ((col.type == TYPE_INT || col.type == TYPE_FLOAT) && zone_fields.size() < RM_MAX_ZONE_FIELDS) {
+            zone_fields.push_back(RmZoneField{col.offset, col.type});
+        }
+    }
+    if (storage == STORAGE_PAX) {
+        // PAX格式的每个字段在页面内单独存放，VARCHAR字段按定长存放
+        std::vector<RmField> fields;
+        for (auto &col : tab.cols) {
+            fields.push_back(RmField{col.offset, col.len});
+        }
+        rm_manager_->create_file(tab.name, record_size, RM_FORMAT_PAX, fields, compressed, {}, zone_fields);
+    } else {
+        // 有VARCHAR字段或字典编码字段的表使用slotted格式，写入页面时去掉VARCHAR字段末尾的填充，字典编码的字段只写入编码
+        std::vector<RmField> var_fields;
+        std::vector<RmDictField> dict_fields;
+        for (size_t i = 0; i < tab.cols.size(); i++) {
+            const ColMeta &col = tab.cols[i];
+            if (col_defs[i].dict_width > 0) {
+                dict_fields.push_back(RmDictField{col.offset, col.len, col_defs[i].dict_width});
+            } else if (col.type == TYPE_VARCHAR) {
+                var_fields.push_back(RmField{col.offset, col.len});
+            }
+        }
+        int format = var_fields.empty() && dict_fields.empty() ? RM_FORMAT_BITMAP : RM_FORMAT_SLOTTED;
+        rm_manager_->create_file(tab.name, record_size, format, var_fields, compressed, dict_fields, zone_fields);
+    }
 }
 
 /**
- * @description: 删除表
+ * @description: 删除表。分区表连同它的各个分区一起删除
  * @param {string&} tab_name 表的名称
  * @param {Context*} context
  */
 void SmManager::drop_table(const std::string& tab_name, Context* context) {
+    std::scoped_lock catalog_lock{catalog_latch_};
     // 1. 检查表是否存在体
     if (!db_.is_table(tab_name)) {
         throw TableNotFoundError(tab_name);
     }
-    // 2. 级联删除索引。
+    // 被物化视图引用的表不能删除，先删除视图
+    for (auto& entry : db_.get_tables()) {
+        auto& base_tabs = entry.second.view.base_tabs;
+        if (std::find(base_tabs.begin(), base_tabs.end(), tab_name) != base_tabs.end()) {
+            throw DependentViewError(tab_name, entry.first);
+        }
+    }
+    // 表上有在建的索引时不能删除，建索引的线程还在使用表的数据文件。
+    // 不加锁的只读查询固定着表或索引的页面时也不能删除：关闭文件会失败，而此前索引文件已经被删除。
+    // B+树句柄自己固定着常驻的结点，超出这部分的固定才是查询留下的
+    std::vector<std::string> tab_names = partition_tables(tab_name);
+    {
+        std::shared_lock handles_lock{handles_latch_};
+        for (auto &name : tab_names) {
+            auto it_fh = fhs_.find(name);
+            if (it_fh != fhs_.end() && it_fh->second->get_delta_log().is_active()) {
+                throw IndexBuildInProgressError(tab_name);
+            }
+            if (it_fh != fhs_.end() && buffer_pool_manager_->get_num_pins(it_fh->second->GetFd()) > 0) {
+                throw TableInUseError(tab_name);
+            }
+            for (auto &index_meta : db_.get_table(name).indexes) {
+                std::string ix_name = ix_manager_->get_index_name(name, index_meta.cols);
+                auto it_ih = ihs_.find(ix_name);
+                if (it_ih != ihs_.end() && buffer_pool_manager_->get_num_pins(it_ih->second->get_fd()) >
+                                               it_ih->second->num_resident_pages()) {
+                    throw TableInUseError(tab_name);
+                }
+                auto it_hh = hhs_.find(ix_name);
+                if (it_hh != hhs_.end() && buffer_pool_manager_->get_num_pins(it_hh->second->get_fd()) > 0) {
+                    throw TableInUseError(tab_name);
+                }
+            }
+        }
+    }
+    // 2. 删除索引和记录文件，再更新内存中的数据库元数据，将该表的信息彻底移除，并同步到 db.meta 文件
+    for (auto &name : tab_names) {
+        drop_table_files(db_.get_table(name));
+        if (name != tab_name) {
+            db_.erase_table(name);
+            catalog_.drop_table(name);
+        }
+    }
+    db_.erase_table(tab_name);
+    catalog_version_++;
+    catalog_.drop_table(tab_name);
+}
+
+/**
+ * @description: 删除表的索引文件和记录文件
+ */
+void SmManager::drop_table_files(const TabMeta& tab) {
+    // 级联删除索引。
     // 在删除表之前，必须先清理该表上的所有索引，否则会留下孤立的索引文件。
-    TabMeta &tab = db_.get_table(tab_name);
     for (auto &index_meta : tab.indexes) {
         // 先根据索引定义的列，计算出它在磁盘的文件名
-        std::string ix_name = ix_manager_->get_index_name(tab_name, index_meta.cols);
-        auto it_ih = ihs_.find(ix_name);
-        // 如果该索引目前被打开了，先关闭它的句柄并从 ihs_ 缓存中移除
-        if (it_ih != ihs_.end()) {
-            ix_manager_->close_index(it_ih->second.get());
-            ihs_.erase(it_ih);
-        }
+        std::string ix_name = ix_manager_->get_index_name(tab.name, index_meta.cols);
+        // 如果该索引目前被打开了，先关闭它的句柄并从 ihs_/hhs_ 缓存中移除
+        close_index_file(ix_name);
         // 物理删除磁盘上的 .idx 文件
-        ix_manager_->destroy_index(tab_name, index_meta.cols);
+        ix_manager_->destroy_index(tab.name, index_meta.cols);
     }
-    // 3. 删除记录文件。
+    // 删除记录文件。
     // 同样，先在缓存中查找是否有打开的句柄 (fhs_)
-    auto it_fh = fhs_.find(tab_name);
-    if (it_fh != fhs_.end()) {
-        // 关闭并从句柄池中移除，避免后续对已删除文件的非法引用
-        rm_manager_->close_file(it_fh->second.get());
-        fhs_.erase(it_fh);
+    {
+        std::unique_lock handles_lock{handles_latch_};
+        auto it_fh = fhs_.find(tab.name);
+        if (it_fh != fhs_.end()) {
+            // 关闭并从句柄池中移除，避免后续对已删除文件的非法引用
+            rm_manager_->close_file(it_fh->second.get());
+            fhs_.erase(it_fh);
+        }
     }
     // 物理删除磁盘上的记录文件（通常无后缀名）
-    rm_manager_->destroy_file(tab_name);
-    // 4. 更新内存中的数据库元数据，将该表的信息彻底移除，并同步到 db.meta 文件
-    db_.tabs_.erase(tab_name);
-    flush_meta();
+    rm_manager_->destroy_file(tab.name);
 }
 
 /**
@@ -288,8 +937,13 @@ void SmManager::drop_table(const std::string& tab_name, Context* context) {
  * @param {string&} tab_name 表的名称
  * @param {vector<string>&} col_names 索引包含的字段名称
  * @param {Context*} context
+ * @param {bool} unique 是否为唯一索引。唯一索引中重复的key只保留第一个；非唯一索引保存所有键值对，
+ *        每个键值对的key之后追加rid，并使用保序编码，结点内比较只需一次memcmp
+ * @param {IndexType} type 索引类型，哈希索引总是保存所有键值对，unique对其无效
  */
-void SmManager::create_index(const std::string& tab_name, const std::vector<std::string>& col_names, Context* context) {
+void SmManager::create_index(const std::string& tab_name, const std::vector<std::string>& col_names, Context* context,
+                             bool unique, IndexType type) {
+    std::scoped_lock catalog_lock{catalog_latch_};
     // 1. 基础校验：表必须存在
     if (!db_.is_table(tab_name)) {
         throw TableNotFoundError(tab_name);
@@ -299,28 +953,200 @@ void SmManager::create_index(const std::string& tab_name, const std::vector<std:
     if (tab.is_index(col_names)) {
         throw IndexExistsError(tab_name, col_names);
     }
+    if (!tab.partition.is_partitioned()) {
+        create_index_file(tab_name, col_names, context, unique, type);
+        return;
+    }
+    // 分区表在每个分区上建一个同样的索引，一个分区失败时删除已经建好的索引
+    IndexMeta index_meta = make_index_meta(tab, col_names, type);
+    std::vector<std::string> part_names = partition_tables(tab_name);
+    size_t built = 0;
+    try {
+        for (; built < part_names.size(); ++built) {
+            create_index_file(part_names[built], col_names, context, unique, type);
+        }
+    } catch (...) {
+        for (size_t i = 0; i < built; ++i) {
+            drop_index_file(part_names[i], col_names);
+            erase_index_meta(db_.get_table(part_names[i]), col_names);
+            flush_table(part_names[i]);
+        }
+        throw;
+    }
+    mark_index_cols(tab, index_meta);
+    tab.indexes.push_back(index_meta);
+    flush_table(tab_name);
+}
+
+/**
+ * @description: 在表的数据文件上创建索引文件，为已有的记录建立索引，并把索引加入表的元数据
+ */
+void SmManager::create_index_file(const std::string& tab_name, const std::vector<std::string>& col_names,
+                                  Context* context, bool unique, IndexType type) {
+    TabMeta &tab = db_.get_table(tab_name);
+    RmFileHandle *fh = get_table_handle(tab_name);
+    if (fh->get_delta_log().is_active()) {
+        throw IndexBuildInProgressError(tab_name);
+    }
     // 3. 构建索引元数据体体 (IndexMeta)
-    IndexMeta index_meta;
-    index_meta.tab_name = tab_name;
-    index_meta.col_tot_len = 0;
-    index_meta.col_num = static_cast<int>(col_names.size());
-    index_meta.cols.clear();
-    for (auto &name : col_names) {
-        // 定位列的详细信息（类型、长度等），索引需要知道如何存储和比较这些列
-        auto it = tab.get_col(name);
-        index_meta.cols.push_back(*it);
-        index_meta.col_tot_len += it->len;
-        // 标记该列“存在索引”，这样 desc table 时能展示 YES
-        it->index = true;
+    IndexMeta index_meta = make_index_meta(tab, col_names, type);
+    Transaction *txn = (context != nullptr) ? context->txn_ : nullptr;
+    // 压缩的表上的索引也压缩
+    bool compressed = disk_manager_->is_compressed(fh->GetFd());
+    if (is_point_index(type)) {
+        // 哈希索引和LSM索引逐条插入表中已有记录的键值对
+        ix_manager_->create_point_index(tab_name, index_meta.cols, type, compressed);
+        mark_index_cols(tab, index_meta);
+        tab.indexes.push_back(index_meta);
+        build_index(fh, index_meta, nullptr, get_point_index_handle(tab_name, index_meta), txn);
+        flush_table(tab_name);
+        return;
     }
     // 4. 物理创建索引文件。ix_manager 负责初始化 B+ 树的根节点和 header。
-    ix_manager_->create_index(tab_name, index_meta.cols);
+    //    多列索引使用保序编码的key，结点内比较只需一次memcmp，而不必逐列按类型比较
+    ix_manager_->create_index(tab_name, index_meta.cols, index_meta.cols.size() > 1 ? IX_KEY_NORMALIZED : IX_KEY_RAW,
+                              unique, compressed);
     // 5. 将索引信息加入到表的元数据中，并打开它以便立即可用
+    mark_index_cols(tab, index_meta);
     tab.indexes.push_back(index_meta);
-    std::string ix_name = ix_manager_->get_index_name(tab_name, col_names);
-    ihs_.emplace(ix_name, ix_manager_->open_index(tab_name, col_names));
-    // 6. 元数据变更落盘体体
-    flush_meta();
+    // 6. 为表中已有的记录建立索引
+    build_index(fh, index_meta, get_index_handle(tab_name, index_meta), nullptr, txn);
+    // 7. 元数据变更落盘体体
+    flush_table(tab_name);
+}
+
+/**
+ * @description: 在线创建索引，建索引期间表上的查询和DML照常执行。
+ *              1. 在catalog_latch_内创建索引文件，并让表的数据文件开始收集修改；
+ *              2. 不持有任何latch，扫描表并构建索引，再把扫描期间收集到的修改应用到索引上，
+ *                 重复几轮直到一轮应用的修改足够少；
+ *              3. 等待已经开始的DML语句结束并阻塞新的DML语句，应用剩余的修改，停止收集，
+ *                 然后把索引加入表的元数据。之后开始的DML语句在取得表的元数据时看到新索引，由它们维护索引。
+ *              新索引加入元数据之前不会被查询使用。故障时没有完成的索引不在元数据中，留下的索引文件在下次建索引时删除
+ * @param {string&} tab_name 表的名称
+ * @param {vector<string>&} col_names 索引包含的字段名称
+ * @param {Context*} context
+ * @param {bool} unique 是否为唯一索引，同create_index
+ * @param {IndexType} type 索引类型
+ */
+void SmManager::create_index_concurrently(const std::string& tab_name, const std::vector<std::string>& col_names,
+                                          Context* context, bool unique, IndexType type) {
+    // 分区表依次在线创建每个分区上的索引，全部完成之后再把索引加入分区表的元数据
+    std::vector<std::string> part_names;
+    {
+        std::scoped_lock catalog_lock{catalog_latch_};
+        if (db_.is_table(tab_name) && db_.get_table(tab_name).partition.is_partitioned()) {
+            if (db_.get_table(tab_name).is_index(col_names)) {
+                throw IndexExistsError(tab_name, col_names);
+            }
+            part_names = partition_tables(tab_name);
+        }
+    }
+    if (!part_names.empty()) {
+        size_t built = 0;
+        try {
+            for (; built < part_names.size(); ++built) {
+                create_index_concurrently(part_names[built], col_names, context, unique, type);
+            }
+        } catch (...) {
+            std::scoped_lock catalog_lock{catalog_latch_};
+            for (size_t i = 0; i < built; ++i) {
+                if (db_.is_table(part_names[i])) {
+                    drop_index_file(part_names[i], col_names);
+                    erase_index_meta(db_.get_table(part_names[i]), col_names);
+                    flush_table(part_names[i]);
+                }
+            }
+            throw;
+        }
+        std::scoped_lock catalog_lock{catalog_latch_};
+        if (!db_.is_table(tab_name)) {
+            throw TableNotFoundError(tab_name);
+        }
+        TabMeta &tab = db_.get_table(tab_name);
+        IndexMeta index_meta = make_index_meta(tab, col_names, type);
+        mark_index_cols(tab, index_meta);
+        tab.indexes.push_back(index_meta);
+        flush_table(tab_name);
+        return;
+    }
+
+    IndexMeta index_meta;
+    RmFileHandle *fh;
+    std::unique_ptr<IxIndexHandle> ih;
+    std::unique_ptr<IxPointIndexHandle> hh;
+    {
+        std::scoped_lock catalog_lock{catalog_latch_};
+        if (!db_.is_table(tab_name)) {
+            throw TableNotFoundError(tab_name);
+        }
+        TabMeta &tab = db_.get_table(tab_name);
+        if (tab.is_index(col_names)) {
+            throw IndexExistsError(tab_name, col_names);
+        }
+        fh = get_table_handle(tab_name);
+        index_meta = make_index_meta(tab, col_names, type);
+        if (ix_manager_->exists(tab_name, index_meta.cols)) {
+            ix_manager_->destroy_index(tab_name, index_meta.cols);
+        }
+        if (!fh->get_delta_log().start()) {
+            throw IndexBuildInProgressError(tab_name);
+        }
+        // 索引文件在元数据中可见之前不放入ihs_/hhs_，检查点不会写回构建了一半的索引
+        try {
+            bool compressed = disk_manager_->is_compressed(fh->GetFd());
+            if (is_point_index(type)) {
+                ix_manager_->create_point_index(tab_name, index_meta.cols, type, compressed);
+                hh = ix_manager_->open_point_index(tab_name, index_meta.cols, type);
+            } else {
+                ix_manager_->create_index(tab_name, index_meta.cols,
+                                          index_meta.cols.size() > 1 ? IX_KEY_NORMALIZED : IX_KEY_RAW, unique,
+                                          compressed);
+                ih = ix_manager_->open_index(tab_name, index_meta.cols);
+            }
+        } catch (...) {
+            fh->get_delta_log().stop();
+            throw;
+        }
+    }
+
+    Transaction *txn = (context != nullptr) ? context->txn_ : nullptr;
+    std::unique_lock<std::shared_mutex> dml_lock;
+    try {
+        build_index(fh, index_meta, ih.get(), hh.get(), txn);
+        for (int round = 0; round < IX_ONLINE_CATCHUP_ROUNDS; round++) {
+            auto entries = fh->get_delta_log().take();
+            apply_index_delta(index_meta, ih.get(), hh.get(), entries, txn);
+            if (entries.size() <= IX_ONLINE_SWITCH_DELTA) break;
+        }
+        dml_lock = fh->block_dml();
+        apply_index_delta(index_meta, ih.get(), hh.get(), fh->get_delta_log().stop(), txn);
+    } catch (...) {
+        std::scoped_lock catalog_lock{catalog_latch_};
+        fh->get_delta_log().stop();
+        if (ih != nullptr) {
+            ix_manager_->close_index(ih.get());
+        } else if (hh != nullptr) {
+            ix_manager_->close_point_index(hh.get());
+        }
+        ix_manager_->destroy_index(tab_name, index_meta.cols);
+        throw;
+    }
+
+    std::scoped_lock catalog_lock{catalog_latch_};
+    TabMeta &tab = db_.get_table(tab_name);
+    mark_index_cols(tab, index_meta);
+    tab.indexes.push_back(index_meta);
+    {
+        std::unique_lock handles_lock{handles_latch_};
+        std::string ix_name = ix_manager_->get_index_name(tab_name, index_meta.cols);
+        if (ih != nullptr) {
+            ihs_.emplace(ix_name, std::move(ih));
+        } else {
+            hhs_.emplace(ix_name, std::move(hh));
+        }
+    }
+    flush_table(tab_name);
 }
 
 /**
@@ -330,6 +1156,7 @@ void SmManager::create_index(const std::string& tab_name, const std::vector<std:
  * @param {Context*} context
  */
 void SmManager::drop_index(const std::string& tab_name, const std::vector<std::string>& col_names, Context* context) {
+    std::scoped_lock catalog_lock{catalog_latch_};
     // 1. 校验表是否存在
     if (!db_.is_table(tab_name)) {
         throw TableNotFoundError(tab_name);
@@ -339,17 +1166,59 @@ void SmManager::drop_index(const std::string& tab_name, const std::vector<std::s
     if (!tab.is_index(col_names)) {
         throw IndexNotFoundError(tab_name, col_names);
     }
-    // 3. 释放资源。先找到内存中打开的索引句柄体体
-    std::string ix_name = ix_manager_->get_index_name(tab_name, col_names);
-    auto it_ih = ihs_.find(ix_name);
-    if (it_ih != ihs_.end()) {
-        // 关闭并销毁内存句柄
-        ix_manager_->close_index(it_ih->second.get());
-        ihs_.erase(it_ih);
+    // 3. 释放资源并删除索引文件，分区表删除每个分区上的索引
+    for (auto &name : partition_tables(tab_name)) {
+        drop_index_file(name, col_names);
+        if (name != tab_name) {
+            erase_index_meta(db_.get_table(name), col_names);
+            flush_table(name);
+        }
+    }
+    // 4. 更新元数据并同步体体
+    erase_index_meta(tab, col_names);
+    flush_table(tab_name);
+}
+
+/**
+ * @description: 删除索引 (重载版本，直接接收 ColMeta 列表)
+ */
+void SmManager::drop_index(const std::string& tab_name, const std::vector<ColMeta>& cols, Context* context) {
+    std::scoped_lock catalog_lock{catalog_latch_};
+    // 逻辑与上述版本基本一致体体
+    if (!db_.is_table(tab_name)) {
+        throw TableNotFoundError(tab_name);
+    }
+    TabMeta &tab = db_.get_table(tab_name);
+    std::vector<std::string> col_names;
+    for (auto &col : cols) {
+        col_names.push_back(col.name);
+    }
+    for (auto &name : partition_tables(tab_name)) {
+        drop_index_file(name, col_names);
+        if (name != tab_name) {
+            erase_index_meta(db_.get_table(name), col_names);
+            flush_table(name);
+        }
     }
+    erase_index_meta(tab, col_names);
+    flush_table(tab_name);
+}
+
+/**
+ * @description: 关闭并删除表上字段为col_names的索引文件
+ */
+void SmManager::drop_index_file(const std::string& tab_name, const std::vector<std::string>& col_names) {
+    // 先找到内存中打开的索引句柄，关闭并销毁内存句柄
+    std::string ix_name = ix_manager_->get_index_name(tab_name, col_names);
+    close_index_file(ix_name);
     // 物理删除磁盘上的 .idx 文件
     ix_manager_->destroy_index(tab_name, col_names);
-    // 4. 更新元数据：将列上的索引标记设为 false，并从 TabMeta 的索引列表中移除该项体体体体
+}
+
+/**
+ * @description: 从表的元数据中去掉字段为col_names的索引，并将列上的索引标记设为 false
+ */
+void SmManager::erase_index_meta(TabMeta& tab, const std::vector<std::string>& col_names) {
     for (auto &name : col_names) {
         auto it_col = tab.get_col(name);
         it_col->index = false;
@@ -366,40 +1235,553 @@ void SmManager::drop_index(const std::string& tab_name, const std::vector<std::s
             else { ++it; }
         } else { ++it; }
     }
-    // 5. 同步元数据体体
-    flush_meta();
 }
 
 /**
- * @description: 删除索引 (重载版本，直接接收 ColMeta 列表)
+ * @description: 把CSV文件中的一行拆分成字段，去掉字段两端的空白和引号
  */
-void SmManager::drop_index(const std::string& tab_name, const std::vector<ColMeta>& cols, Context* context) {
-    // 逻辑与上述版本基本一致体体
+static std::vector<std::string> split_csv_line(const std::string& line) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t end = line.find(',', start);
+        std::string field = line.substr(start, end == std::string::npos ? std::string::npos : end - start);
+        size_t first = field.find_first_not_of(" \t\r");
+        size_t last = field.find_last_not_of(" \t\r");
+        field = (first == std::string::npos) ? std::string() : field.substr(first, last - first + 1);
+        if (field.size() >= 2 && (field.front() == '\'' || field.front() == '"') && field.back() == field.front()) {
+            field = field.substr(1, field.size() - 2);
+        }
+        fields.push_back(std::move(field));
+        if (end == std::string::npos) break;
+        start = end + 1;
+    }
+    return fields;
+}
+
+/**
+ * @description: 把CSV文件中的记录批量导入表中
+ * 文件每行一条记录，字段按照表中列的顺序以逗号分隔；若第一行的各字段恰好是列名，则作为表头跳过。
+ * 记录通过RmFileHandle::insert_records按页面批量写入；索引在导入结束时统一维护：
+ * 所有键值对排序后交给IxIndexHandle::insert_entries，空索引直接自底向上构建；哈希索引不需要排序，逐条插入
+ * @param {string&} file_name 数据文件路径，相对路径相对于数据库目录
+ * @param {string&} tab_name 表名称
+ * @param {Context*} context
+ */
+void SmManager::load_data(const std::string& file_name, const std::string& tab_name, Context* context) {
     if (!db_.is_table(tab_name)) {
         throw TableNotFoundError(tab_name);
     }
-    TabMeta &tab = db_.get_table(tab_name);
-    std::string ix_name = ix_manager_->get_index_name(tab_name, cols);
+    std::ifstream ifs(file_name);
+    if (!ifs.is_open()) {
+        throw FileNotFoundError(file_name);
+    }
+    TabMeta& tab = db_.get_table(tab_name);
+    Transaction* txn = (context != nullptr) ? context->txn_ : nullptr;
+
+    // 每张表（分区表的每个分区）上的导入：记录按批写入，每个索引收集本次导入的全部键值对
+    struct Loader {
+        std::string tab_name;
+        RmFileHandle* fh;
+        std::shared_lock<std::shared_mutex> dml_lock;   // 导入结束时才维护索引，期间不能切换到在线创建的新索引
+        TabMeta* tab;
+        std::vector<IxIndexHandle*> ihs;
+        std::vector<std::vector<char>> index_keys;
+        std::vector<std::vector<Rid>> index_rids;
+        std::vector<char> batch;
+        int batch_records = 0;
+    };
+    std::vector<Loader> loaders(tab.partition.is_partitioned() ? tab.partition.size() : 1);
+    std::vector<std::string> part_names = partition_tables(tab_name);
+    for (size_t p = 0; p < loaders.size(); p++) {
+        Loader& loader = loaders[p];
+        loader.tab_name = part_names[p];
+        loader.fh = get_table_handle(loader.tab_name);
+        loader.dml_lock = loader.fh->lock_dml();
+        loader.tab = &db_.get_table(loader.tab_name);
+        loader.index_keys.resize(loader.tab->indexes.size());
+        loader.index_rids.resize(loader.tab->indexes.size());
+        for (auto& index : loader.tab->indexes) {
+            loader.ihs.push_back(is_point_index(index.type) ? nullptr : get_index_handle(loader.tab_name, index));
+        }
+    }
+    int record_size = loaders[0].fh->get_file_hdr().record_size;
+
+    // 把一批解析好的记录写入表中，并把它们的索引键追加到index_keys中
+    std::vector<Rid> rids;
+    auto flush_batch = [&](Loader& loader) {
+        if (loader.batch_records == 0) return;
+        rids.clear();
+        loader.fh->insert_records(loader.batch.data(), loader.batch_records, &rids, context);
+        for (size_t i = 0; i < loader.tab->indexes.size(); i++) {
+            auto& index = loader.tab->indexes[i];
+            for (int r = 0; r < loader.batch_records; r++) {
+                const char* rec = loader.batch.data() + static_cast<size_t>(r) * record_size;
+                for (auto& col : index.cols) {
+                    loader.index_keys[i].insert(loader.index_keys[i].end(), rec + col.offset,
+                                                rec + col.offset + col.len);
+                }
+                loader.index_rids[i].push_back(rids[r]);
+            }
+        }
+        loader.batch.clear();
+        loader.batch_records = 0;
+    };
+
+    // 对每个索引的键值对排序后批量插入
+    auto build_indexes = [&]() {
+        for (auto& loader : loaders) {
+            for (size_t i = 0; i < loader.tab->indexes.size(); i++) {
+                auto& index_keys = loader.index_keys[i];
+                auto& index_rids = loader.index_rids[i];
+                int key_len = loader.tab->indexes[i].col_tot_len;
+                int num_entries = static_cast<int>(index_rids.size());
+                if (num_entries == 0) continue;
+                const char* keys = index_keys.data();
+                if (loader.ihs[i] == nullptr) {
+                    for (int e = 0; e < num_entries; e++) {
+                        insert_index_entry(loader.tab_name, loader.tab->indexes[i],
+                                           keys + static_cast<size_t>(e) * key_len, index_rids[e], txn);
+                    }
+                    std::vector<char>().swap(index_keys);
+                    std::vector<Rid>().swap(index_rids);
+                    continue;
+                }
+                // 非唯一索引中key相同的键值对按rid升序排列
+                loader.ihs[i]->sort_entries(index_keys.data(), index_rids.data(), num_entries);
+                loader.ihs[i]->insert_entries(index_keys.data(), index_rids.data(), num_entries, txn);
+                std::vector<char>().swap(index_keys);
+                std::vector<Rid>().swap(index_rids);
+            }
+        }
+    };
+
+    std::vector<char> row(record_size);
+    try {
+        std::string line;
+        int line_no = 0;
+        while (std::getline(ifs, line)) {
+            line_no++;
+            if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+            std::vector<std::string> fields = split_csv_line(line);
+            if (fields.size() != tab.cols.size()) {
+                throw InvalidLoadDataError(file_name, line_no, "expected " + std::to_string(tab.cols.size()) +
+                                                                   " fields, got " + std::to_string(fields.size()));
+            }
+            if (line_no == 1) {
+                bool is_header = true;
+                for (size_t c = 0; c < fields.size(); c++) {
+                    if (fields[c] != tab.cols[c].name) {
+                        is_header = false;
+                        break;
+                    }
+                }
+                if (is_header) continue;
+            }
+
+            char* rec = row.data();
+            memset(rec, 0, record_size);
+            for (size_t c = 0; c < fields.size(); c++) {
+                auto& col = tab.cols[c];
+                const std::string& field = fields[c];
+                char* end = nullptr;
+                if (col.type == TYPE_INT) {
+                    long v = strtol(field.c_str(), &end, 10);
+                    if (field.empty() || *end != '\0' || v < INT32_MIN || v > INT32_MAX) {
+                        throw InvalidLoadDataError(file_name, line_no, "invalid INT value '" + field + "'");
+                    }
+                    int iv = static_cast<int>(v);
+                    memcpy(rec + col.offset, &iv, sizeof(int));
+                } else if (col.type == TYPE_FLOAT) {
+                    float fv = strtof(field.c_str(), &end);
+                    if (field.empty() || *end != '\0') {
+                        throw InvalidLoadDataError(file_name, line_no, "invalid FLOAT value '" + field + "'");
+                    }
+                    memcpy(rec + col.offset, &fv, sizeof(float));
+                } else {
+                    if (static_cast<int>(field.size()) > col.len) {
+                        throw StringOverflowError();
+                    }
+                    memcpy(rec + col.offset, field.data(), field.size());
+                }
+            }
+            // 分区表的记录按分区键放入所在分区的批次
+            size_t p = 0;
+            if (tab.partition.is_partitioned()) {
+                p = tab.partition.route(rec);
+                if (p == tab.partition.size()) {
+                    throw InvalidLoadDataError(file_name, line_no, "no partition for the row");
+                }
+            }
+            Loader& loader = loaders[p];
+            loader.batch.insert(loader.batch.end(), rec, rec + record_size);
+            if (++loader.batch_records == LOAD_DATA_BATCH_SIZE) {
+                flush_batch(loader);
+            }
+        }
+        for (auto& loader : loaders) {
+            flush_batch(loader);
+        }
+    } catch (...) {
+        // 已经写入表中的记录仍需要维护索引，保持表和索引一致
+        for (auto& loader : loaders) {
+            loader.batch.clear();
+            loader.batch_records = 0;
+        }
+        build_indexes();
+        throw;
+    }
+    build_indexes();
+}
+
+/**
+ * @description: 整理表的数据文件：把文件末尾页面上的记录移动到前部页面的空闲位置并截断文件，
+ * 大量删除之后的顺序扫描不再遍历空页面。整理期间持有表级X锁，其它事务在当前事务结束之前不能访问该表；
+ * 记录移动后在每个索引中删除原记录号并插入新记录号
+ * @param {string&} tab_name 表名称
+ * @param {Context*} context
+ */
+void SmManager::vacuum_table(const std::string& tab_name, Context* context) {
+    if (!db_.is_table(tab_name)) {
+        throw TableNotFoundError(tab_name);
+    }
+    TabMeta& tab = db_.get_table(tab_name);
+    // 分区表依次整理每个分区
+    if (tab.partition.is_partitioned()) {
+        for (auto& name : partition_tables(tab_name)) {
+            vacuum_table(name, context);
+        }
+        return;
+    }
+    RmFileHandle* fh = get_table_handle(tab_name);
+    Transaction* txn = (context != nullptr) ? context->txn_ : nullptr;
+    if (txn != nullptr && context->lock_mgr_ != nullptr) {
+        context->lock_mgr_->lock_exclusive_on_table(txn, fh->GetFd());
+    }
+    // 记录移动不记入写集合，当前事务之前对该表的修改回滚时会找不到原来的记录号
+    if (txn != nullptr) {
+        for (auto write_record : *txn->get_write_set()) {
+            if (write_record->GetTableName() == tab_name) {
+                throw TableBusyError(tab_name);
+            }
+        }
+    }
+    // 快照读不加锁，版本链按记录号查找，还有未回收的旧版本时不能移动记录
+    if (!fh->get_versions().empty()) {
+        throw TableBusyError(tab_name);
+    }
+    // 在线建索引按记录号收集表上的修改，整理文件移动的记录不会被收集
+    if (fh->get_delta_log().is_active()) {
+        throw IndexBuildInProgressError(tab_name);
+    }
+
+    std::vector<char> key;
+    fh->vacuum([&](const Rid& old_rid, const Rid& new_rid, const char* rec) {
+        for (size_t i = 0; i < tab.indexes.size(); i++) {
+            key.clear();
+            for (auto& col : tab.indexes[i].cols) {
+                key.insert(key.end(), rec + col.offset, rec + col.offset + col.len);
+            }
+            delete_index_entry(tab_name, tab.indexes[i], key.data(), old_rid, txn);
+            insert_index_entry(tab_name, tab.indexes[i], key.data(), new_rid, txn);
+        }
+    });
+}
+
+/**
+ * @description: 收集表的统计信息并写入元数据：记录数、页面数，以及每个字段的不同值个数、最小值、最大值和等深直方图。
+ * 收集期间持有表级S锁，之后的插入和删除由数据文件中的计数器累加到记录数上
+ * 分区表扫描全部分区，统计信息记在分区表上
+ * @param {string&} tab_name 表名称，为空时收集所有表的统计信息
+ * @param {Context*} context
+ */
+void SmManager::analyze_table(const std::string& tab_name, Context* context) {
+    std::vector<std::string> tab_names;
+    if (tab_name.empty()) {
+        for (auto& entry : db_.tabs_) {
+            if (!PartitionMeta::is_partition(entry.first)) {
+                tab_names.push_back(entry.first);
+            }
+        }
+    } else if (!db_.is_table(tab_name)) {
+        throw TableNotFoundError(tab_name);
+    } else {
+        tab_names.push_back(tab_name);
+    }
+    Transaction* txn = (context != nullptr) ? context->txn_ : nullptr;
+    for (auto& name : tab_names) {
+        TabMeta& tab = db_.get_table(name);
+        TabStatsCollector collector(tab.cols);
+        int num_pages = 0;
+        for (auto& part : partition_tables(name)) {
+            RmFileHandle* fh = get_table_handle(part);
+            if (txn != nullptr && context->lock_mgr_ != nullptr) {
+                context->lock_mgr_->lock_shared_on_table(txn, fh->GetFd());
+            }
+            for (RmScan scan(fh, true); !scan.is_end(); scan.next_batch()) {
+                for (auto& slot : scan.batch()) {
+                    collector.add(slot.data);
+                }
+            }
+            // 表级S锁阻止了其它事务的修改，扫描得到的记录数就是当前的记录数
+            fh->take_record_delta();
+            num_pages += fh->get_file_hdr().num_pages;
+        }
+        tab.stats = collector.finish(num_pages);
+        flush_table(name);
+    }
+}
+
+/**
+ * @description: 获取表的统计信息，记录数包含ANALYZE之后插入和删除的记录，页面数为数据文件当前的页面数，
+ * 分区表为各分区之和
+ * @return {TabStats} 统计信息的副本，表没有执行过ANALYZE时analyzed为false
+ * @param {string&} tab_name 表名称
+ */
+TabStats SmManager::get_table_stats(const std::string& tab_name) {
+    TabStats stats = db_.get_table(tab_name).stats;
+    if (stats.analyzed) {
+        int64_t delta = 0;
+        int num_pages = 0;
+        for (auto& part : partition_tables(tab_name)) {
+            RmFileHandle* fh = get_table_handle(part);
+            delta += fh->get_record_delta();
+            num_pages += fh->get_file_hdr().num_pages;
+        }
+        stats.num_rows = std::max<int64_t>(stats.num_rows + delta, 0);
+        stats.num_pages = num_pages;
+    }
+    return stats;
+}
+
+/**
+ * @description: 表的数据实际所在的表
+ * @return {vector<string>} 分区表为各分区的内部表名称，按分区的顺序排列；其他表为表本身
+ * @param {string&} tab_name 表名称
+ */
+std::vector<std::string> SmManager::partition_tables(const std::string& tab_name) {
+    const PartitionMeta& partition = db_.get_table(tab_name).partition;
+    if (!partition.is_partitioned()) {
+        return {tab_name};
+    }
+    std::vector<std::string> names;
+    for (size_t i = 0; i < partition.size(); ++i) {
+        names.push_back(partition.table_name(tab_name, i));
+    }
+    return names;
+}
+
+/**
+ * @description: 分区裁剪：根据分区键与常量比较的条件，找出满足条件的记录可能所在的分区。
+ * HASH分区只能用等值条件确定一个分区；RANGE分区的等值条件确定一个分区，范围条件确定一段连续的分区。
+ * 与分区键类型不同或者超出字段长度的常量不参与裁剪
+ * @return {vector<size_t>} 分区的下标，按分区的顺序排列
+ * @param {string&} tab_name 分区表名称
+ * @param {vector<Condition>&} conds 查询条件，各条件之间为AND
+ */
+std::vector<size_t> SmManager::scan_partitions(const std::string& tab_name, const std::vector<Condition>& conds) {
+    const PartitionMeta& partition = db_.get_table(tab_name).partition;
+    // lo和hi之间（不含hi）的分区可能有满足条件的记录
+    size_t lo = 0, hi = partition.size();
+    for (auto& cond : conds) {
+        if (!cond.is_rhs_val || cond.lhs_col.tab_name != tab_name || cond.lhs_col.col_name != partition.col.name ||
+            !is_compatible_type(partition.col.type, cond.rhs_val.type)) {
+            continue;
+        }
+        if (is_string_type(partition.col.type) && static_cast<int>(cond.rhs_val.str_val.size()) > partition.col.len) {
+            continue;
+        }
+        Value val = cond.rhs_val;
+        val.raw = nullptr;
+        val.init_raw(partition.col.len);
+        const char* key = val.raw->data;
+        size_t pos = partition.locate(key);
+        if (partition.type == PARTITION_HASH) {
+            if (cond.op == OP_EQ) {
+                lo = std::max(lo, pos);
+                hi = std::min(hi, pos + 1);
+            }
+            continue;
+        }
+        switch (cond.op) {
+            case OP_EQ:
+                lo = std::max(lo, pos);
+                hi = std::min(hi, pos + 1);
+                break;
+            case OP_LT:
+            case OP_LE:
+                // 上界不含，小于key的记录最多在key所在的分区
+                hi = std::min(hi, pos + 1);
+                break;
+            case OP_GT:
+            case OP_GE:
+                lo = std::max(lo, pos);
+                break;
+            default:
+                break;
+        }
+    }
+    std::vector<size_t> parts;
+    for (size_t i = lo; i < hi; ++i) {
+        parts.push_back(i);
+    }
+    return parts;
+}
+
+/**
+ * @description: 按字段名称构造表tab上的索引元数据
+ */
+IndexMeta SmManager::make_index_meta(TabMeta& tab, const std::vector<std::string>& col_names, IndexType type) {
+    IndexMeta index_meta;
+    index_meta.tab_name = tab.name;
+    index_meta.col_tot_len = 0;
+    index_meta.col_num = static_cast<int>(col_names.size());
+    index_meta.type = type;
+    for (auto &name : col_names) {
+        // 定位列的详细信息（类型、长度等），索引需要知道如何存储和比较这些列
+        auto it = tab.get_col(name);
+        index_meta.cols.push_back(*it);
+        index_meta.col_tot_len += it->len;
+    }
+    return index_meta;
+}
+
+/**
+ * @description: 标记索引包含的列“存在索引”，这样 desc table 时能展示 YES
+ */
+void SmManager::mark_index_cols(TabMeta& tab, const IndexMeta& index) {
+    for (auto &col : index.cols) {
+        tab.get_col(col.name)->index = true;
+    }
+}
+
+/**
+ * @description: 扫描表中已有的记录，填充刚创建的空索引。哈希索引和LSM索引逐条插入；
+ *              B+树索引把扫描得到的键值对用ParallelSorter并行外部排序后自底向上构建，叶子结点按IX_BULK_FILL_FACTOR填充，为之后的插入留出空间。
+ *              扫描按rid升序产生键值对，稳定排序后key相同的键值对仍按rid升序排列
+ * @param {RmFileHandle*} fh 表的数据文件
+ * @param {IndexMeta&} index 索引的元数据
+ * @param {IxIndexHandle*} ih B+树索引，哈希索引和LSM索引时为nullptr
+ * @param {IxPointIndexHandle*} hh 哈希索引或LSM索引，B+树索引时为nullptr
+ * @param {Transaction*} txn
+ */
+void SmManager::build_index(RmFileHandle* fh, const IndexMeta& index, IxIndexHandle* ih, IxPointIndexHandle* hh,
+                            Transaction* txn) {
+    std::vector<char> key(index.col_tot_len);
+    auto make_key = [&](const char *rec) {
+        int offset = 0;
+        for (auto &col : index.cols) {
+            memcpy(key.data() + offset, rec + col.offset, col.len);
+            offset += col.len;
+        }
+    };
+    if (hh != nullptr) {
+        for (RmScan scan(fh, true); !scan.is_end(); scan.next_batch()) {
+            for (auto &slot : scan.batch()) {
+                make_key(slot.data);
+                hh->insert_entry(key.data(), slot.rid, txn);
+            }
+        }
+        return;
+    }
+    std::vector<ColType> col_types;
+    std::vector<int> col_lens;
+    for (auto &col : index.cols) {
+        col_types.push_back(col.type);
+        col_lens.push_back(col.len);
+    }
+    // 排序的条目为(保序编码的key, 原始key, rid)，按编码后的key排序，相同的key保持扫描的顺序
+    size_t key_len = index.col_tot_len;
+    ParallelSorter sorter(key_len, 2 * key_len + sizeof(Rid), IX_SORT_RUN_SIZE);
+    for (RmScan scan(fh, true); !scan.is_end(); scan.next_batch()) {
+        for (auto &slot : scan.batch()) {
+            make_key(slot.data);
+            char *entry = sorter.add();
+            ix_normalize_key(key.data(), entry, col_types, col_lens);
+            memcpy(entry + key_len, key.data(), key_len);
+            memcpy(entry + 2 * key_len, &slot.rid, sizeof(Rid));
+        }
+    }
+    sorter.finish();
+    ih->bulk_load(
+        [&](const char **key, Rid *rid) {
+            const char *entry = sorter.next();
+            if (entry == nullptr) return false;
+            *key = entry + key_len;
+            memcpy(rid, entry + 2 * key_len, sizeof(Rid));
+            return true;
+        },
+        IX_BULK_FILL_FACTOR, txn);
+}
+
+/**
+ * @description: 把在线建索引期间收集到的修改按顺序应用到索引上：删除修改前的key，插入修改后的key。
+ *              扫描可能已经看到了某条修改之后的记录，插入之前先删除同样的键值对，同一个键值对不会出现两次
+ */
+void SmManager::apply_index_delta(const IndexMeta& index, IxIndexHandle* ih, IxPointIndexHandle* hh,
+                                  const std::vector<RmDeltaEntry>& entries, Transaction* txn) {
+    std::vector<char> key(index.col_tot_len);
+    auto make_key = [&](const std::string &rec) {
+        int offset = 0;
+        for (auto &col : index.cols) {
+            memcpy(key.data() + offset, rec.data() + col.offset, col.len);
+            offset += col.len;
+        }
+    };
+    for (auto &entry : entries) {
+        if (!entry.before.empty()) {
+            make_key(entry.before);
+            if (hh != nullptr) {
+                hh->delete_entry(key.data(), entry.rid, txn);
+            } else {
+                ih->delete_entry(key.data(), entry.rid, txn);
+            }
+        }
+        if (!entry.after.empty()) {
+            make_key(entry.after);
+            if (hh != nullptr) {
+                hh->delete_entry(key.data(), entry.rid, txn);
+                hh->insert_entry(key.data(), entry.rid, txn);
+            } else {
+                ih->delete_entry(key.data(), entry.rid, txn);
+                ih->insert_entry(key.data(), entry.rid, txn);
+            }
+        }
+    }
+}
+
+void SmManager::insert_index_entry(const std::string& tab_name, const IndexMeta& index, const char* key,
+                                   const Rid& rid, Transaction* txn) {
+    if (is_point_index(index.type)) {
+        get_point_index_handle(tab_name, index)->insert_entry(key, rid, txn);
+    } else {
+        get_index_handle(tab_name, index)->insert_entry(key, rid, txn);
+    }
+}
+
+void SmManager::delete_index_entry(const std::string& tab_name, const IndexMeta& index, const char* key,
+                                   const Rid& rid, Transaction* txn) {
+    if (is_point_index(index.type)) {
+        get_point_index_handle(tab_name, index)->delete_entry(key, rid, txn);
+    } else {
+        get_index_handle(tab_name, index)->delete_entry(key, rid, txn);
+    }
+}
+
+/**
+ * @description: 关闭一个已经打开的索引文件并移除它的句柄，各种索引都适用
+ * @param {string&} ix_name 索引文件名
+ */
+void SmManager::close_index_file(const std::string& ix_name) {
+    std::unique_lock handles_lock{handles_latch_};
     auto it_ih = ihs_.find(ix_name);
     if (it_ih != ihs_.end()) {
         ix_manager_->close_index(it_ih->second.get());
         ihs_.erase(it_ih);
     }
-    ix_manager_->destroy_index(tab_name, cols);
-    for (auto &col : cols) {
-        auto it_col = tab.get_col(col.name);
-        it_col->index = false;
+    auto it_hh = hhs_.find(ix_name);
+    if (it_hh != hhs_.end()) {
+        ix_manager_->close_point_index(it_hh->second.get());
+        hhs_.erase(it_hh);
     }
-    auto it = tab.indexes.begin();
-    while (it != tab.indexes.end()) {
-        if (it->col_num == (int)cols.size()) {
-            bool match = true;
-            for (int i = 0; i < it->col_num; ++i) {
-                if (it->cols[i].name != cols[i].name) { match = false; break; }
-            }
-            if (match) { it = tab.indexes.erase(it); break; }
-            else { ++it; }
-        } else { ++it; }
-    }
-    flush_meta();
-}
\ No newline at end of file
+}
@@ -10,10 +10,16 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+
 #include "index/ix.h"
 #include "record/rm_file_handle.h"
+#include "sm_catalog.h"
 #include "sm_defs.h"
 #include "sm_meta.h"
+#include "common/common.h"
 #include "common/context.h"
 
 class Context;
@@ -22,19 +28,33 @@ struct ColDef {
     std::string name;  // Column name
     ColType type;      // Type of column
     int len;           // Length of column
+    int dict_width = 0;     // 字典编码的字节数，0表示不使用字典编码
+};
+
+/* CREATE TABLE ... PARTITION BY指定的分区方式 */
+struct PartitionDef {
+    PartitionType type = PARTITION_NONE;
+    std::string col_name;               // 分区键
+    std::vector<std::string> names;     // 各分区的名称
+    std::vector<Value> bounds;          // RANGE分区各分区的上界（不含），比names少一个时最后一个分区为MAXVALUE
 };
 
 /* 系统管理器，负责元数据管理和DDL语句的执行 */
 class SmManager {
    public:
     DbMeta db_;             // 当前打开的数据库的元数据
-    std::unordered_map<std::string, std::unique_ptr<RmFileHandle>> fhs_;    // file name -> record file handle, 当前数据库中每张表的数据文件
-    std::unordered_map<std::string, std::unique_ptr<IxIndexHandle>> ihs_;   // file name -> index file handle, 当前数据库中每个索引的文件
+    std::atomic<uint64_t> catalog_version_{0};  // 元数据版本，每次修改元数据时加一，预编译语句据此判断缓存的计划是否失效
    private:
+    std::unordered_map<std::string, std::unique_ptr<RmFileHandle>> fhs_;    // file name -> record file handle, 已经打开的表的数据文件
+    std::unordered_map<std::string, std::unique_ptr<IxIndexHandle>> ihs_;   // file name -> index file handle, 已经打开的B+树索引的文件
+    std::unordered_map<std::string, std::unique_ptr<IxPointIndexHandle>> hhs_;  // file name -> 已经打开的哈希索引和LSM索引的文件
+    std::shared_mutex handles_latch_;   // 保护fhs_、ihs_和hhs_，第一次访问时打开文件与其他查找并发
+    std::mutex catalog_latch_;  // DDL与检查点互斥，检查点遍历文件句柄时句柄不会被关闭
     DiskManager* disk_manager_;
     BufferPoolManager* buffer_pool_manager_;
     RmManager* rm_manager_;
     IxManager* ix_manager_;
+    SmCatalog catalog_;         // 元数据文件，DDL只追加被修改的表的条目
 
    public:
     SmManager(DiskManager* disk_manager, BufferPoolManager* buffer_pool_manager, RmManager* rm_manager,
@@ -54,7 +74,7 @@ class SmManager {
 
     bool is_dir(const std::string& db_name);
 
-    void create_db(const std::string& db_name);
+    void create_db(const std::string& db_name, int page_size = PAGE_SIZE);
 
     void drop_db(const std::string& db_name);
 
@@ -62,19 +82,97 @@ class SmManager {
 
     void close_db();
 
+    RmFileHandle* find_table_handle(const std::string& tab_name);
+
+    RmFileHandle* get_table_handle(const std::string& tab_name);
+
+    IxIndexHandle* get_index_handle(const std::string& tab_name, const IndexMeta& index);
+
+    IxPointIndexHandle* get_point_index_handle(const std::string& tab_name, const IndexMeta& index);
+
     void flush_meta();
 
+    void flush_table(const std::string& tab_name);
+
+    void flush_for_checkpoint(std::unordered_map<oid_t, std::vector<std::pair<page_id_t, lsn_t>>>* dirty_pages,
+                              bool flush_data = false);
+
+    void dump_buffer_pool();
+
+    void restore_buffer_pool();
+
     void show_tables(Context* context);
 
     void desc_table(const std::string& tab_name, Context* context);
 
-    void create_table(const std::string& tab_name, const std::vector<ColDef>& col_defs, Context* context);
+    void show_buffer_stats(Context* context);
+
+    void show_metrics(Context* context);
+
+    void create_table(const std::string& tab_name, const std::vector<ColDef>& col_defs, Context* context,
+                      TabStorage storage = STORAGE_ROW, const PartitionDef& partition = PartitionDef(),
+                      TabCompression compression = COMPRESSION_NONE);
+
+    void create_mat_view(const std::string& tab_name, const std::vector<ColDef>& col_defs, const MatViewMeta& view,
+                         Context* context);
 
     void drop_table(const std::string& tab_name, Context* context);
 
-    void create_index(const std::string& tab_name, const std::vector<std::string>& col_names, Context* context);
+    void create_index(const std::string& tab_name, const std::vector<std::string>& col_names, Context* context,
+                      bool unique = true, IndexType type = INDEX_BTREE);
+
+    void create_index_concurrently(const std::string& tab_name, const std::vector<std::string>& col_names,
+                                   Context* context, bool unique = true, IndexType type = INDEX_BTREE);
 
     void drop_index(const std::string& tab_name, const std::vector<std::string>& col_names, Context* context);
     
     void drop_index(const std::string& tab_name, const std::vector<ColMeta>& col_names, Context* context);
+
+    void load_data(const std::string& file_name, const std::string& tab_name, Context* context);
+
+    void vacuum_table(const std::string& tab_name, Context* context);
+
+    void analyze_table(const std::string& tab_name, Context* context);
+
+    TabStats get_table_stats(const std::string& tab_name);
+
+    /* 表的数据实际所在的表：分区表为它的各个分区，其他表为表本身 */
+    std::vector<std::string> partition_tables(const std::string& tab_name);
+
+    /* 分区表上满足conds的记录可能所在的分区，按分区的顺序排列 */
+    std::vector<size_t> scan_partitions(const std::string& tab_name, const std::vector<Condition>& conds);
+
+    /* 在表的一个索引中插入/删除键值对，按索引类型交给B+树或哈希索引 */
+    void insert_index_entry(const std::string& tab_name, const IndexMeta& index, const char* key, const Rid& rid,
+                            Transaction* txn);
+
+    void delete_index_entry(const std::string& tab_name, const IndexMeta& index, const char* key, const Rid& rid,
+                            Transaction* txn);
+
+   private:
+    TabMeta make_table_meta(const std::string& tab_name, const std::vector<ColDef>& col_defs);
+
+    void create_table_file(const TabMeta& tab, const std::vector<ColDef>& col_defs, TabStorage storage,
+                           TabCompression compression);
+
+    void drop_table_files(const TabMeta& tab);
+
+    void create_index_file(const std::string& tab_name, const std::vector<std::string>& col_names, Context* context,
+                           bool unique, IndexType type);
+
+    void drop_index_file(const std::string& tab_name, const std::vector<std::string>& col_names);
+
+    void erase_index_meta(TabMeta& tab, const std::vector<std::string>& col_names);
+
+    IndexMeta make_index_meta(TabMeta& tab, const std::vector<std::string>& col_names, IndexType type);
+
+    void mark_index_cols(TabMeta& tab, const IndexMeta& index);
+
+    void build_index(RmFileHandle* fh, const IndexMeta& index, IxIndexHandle* ih, IxPointIndexHandle* hh,
+                     Transaction* txn);
+
+    void apply_index_delta(const IndexMeta& index, IxIndexHandle* ih, IxPointIndexHandle* hh,
+                           const std::vector<RmDeltaEntry>& entries, Transaction* txn);
+
+    void close_index_file(const std::string& ix_name);
 };
\ No newline at end of file
@@ -11,13 +11,16 @@ See the Mulan PSL v2 for more details. */
 #pragma once
 
 #include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <map>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "errors.h"
 #include "sm_defs.h"
+#include "sm_stats.h"
 
 /* 字段元数据 */
 struct ColMeta {
@@ -45,8 +48,15 @@ struct IndexMeta {
     int col_tot_len;                // 索引字段长度总和
     int col_num;                    // 索引字段数量
     std::vector<ColMeta> cols;      // 索引包含的字段
+    IndexType type = INDEX_BTREE;   // 索引类型
 
+    // 哈希索引和LSM索引在表名之前多输出一个$HASH或$LSM（不是合法的表名），B+树索引的格式与旧的元数据文件相同
     friend std::ostream &operator<<(std::ostream &os, const IndexMeta &index) {
+        if (index.type == INDEX_HASH) {
+            os << "$HASH ";
+        } else if (index.type == INDEX_LSM) {
+            os << "$LSM ";
+        }
         os << index.tab_name << " " << index.col_tot_len << " " << index.col_num;
         for(auto& col: index.cols) {
             os << "\n" << col;
@@ -55,7 +65,13 @@ struct IndexMeta {
     }
 
     friend std::istream &operator>>(std::istream &is, IndexMeta &index) {
-        is >> index.tab_name >> index.col_tot_len >> index.col_num;
+        is >> index.tab_name;
+        index.type = INDEX_BTREE;
+        if (index.tab_name == "$HASH" || index.tab_name == "$LSM") {
+            index.type = index.tab_name == "$HASH" ? INDEX_HASH : INDEX_LSM;
+            is >> index.tab_name;
+        }
+        is >> index.col_tot_len >> index.col_num;
         for(int i = 0; i < index.col_num; ++i) {
             ColMeta col;
             is >> col;
@@ -65,23 +81,127 @@ struct IndexMeta {
     }
 };
 
+/**
+ * 分区表的分区方式。每个分区是一张名为"表名$分区名"的内部表（SQL中的表名不能含有$），有自己的数据文件和一组
+ * 与分区表相同的索引，日志、锁和故障恢复都按分区进行。分区表本身没有数据文件：插入的记录按分区键路由到分区，
+ * 扫描跳过条件排除的分区，各分区的结果依次输出
+ */
+struct PartitionMeta {
+    PartitionType type = PARTITION_NONE;
+    ColMeta col;                        // 分区键
+    std::vector<std::string> names;     // 各分区的名称，RANGE分区按上界递增排列
+    std::vector<std::string> bounds;    // RANGE分区的上界（不含），为分区键格式的col.len个字节，为空表示MAXVALUE
+
+    bool is_partitioned() const { return type != PARTITION_NONE; }
+
+    size_t size() const { return names.size(); }
+
+    /* 第i个分区的内部表的名称 */
+    std::string table_name(const std::string &tab_name, size_t i) const { return tab_name + '$' + names[i]; }
+
+    /* 表是否为某张分区表的一个分区 */
+    static bool is_partition(const std::string &tab_name) { return tab_name.find('$') != std::string::npos; }
+
+    /* 按分区键的类型比较两个key，返回值小于0、等于0、大于0分别表示lhs小于、等于、大于rhs */
+    int compare(const char *lhs, const char *rhs) const {
+        if (col.type == TYPE_INT) {
+            int a = *reinterpret_cast<const int *>(lhs), b = *reinterpret_cast<const int *>(rhs);
+            return (a < b) ? -1 : ((a > b) ? 1 : 0);
+        }
+        if (col.type == TYPE_FLOAT) {
+            float a = *reinterpret_cast<const float *>(lhs), b = *reinterpret_cast<const float *>(rhs);
+            return (a < b) ? -1 : ((a > b) ? 1 : 0);
+        }
+        return memcmp(lhs, rhs, col.len);
+    }
+
+    /* 分区键的哈希值（FNV-1a），决定HASH分区中已有记录所在的分区，不能随版本改变 */
+    uint64_t hash(const char *key) const {
+        uint64_t hash = 14695981039346656037ULL;
+        for (int i = 0; i < col.len; ++i) {
+            hash = (hash ^ static_cast<uint8_t>(key[i])) * 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    /* 分区键为key的记录所在的分区，没有RANGE分区的范围包含key时返回size() */
+    size_t locate(const char *key) const {
+        if (type == PARTITION_HASH) {
+            return static_cast<size_t>(hash(key) % size());
+        }
+        // 第一个上界大于key的分区
+        size_t lo = 0, hi = size();
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (bounds[mid].empty() || compare(key, bounds[mid].data()) < 0) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        return lo;
+    }
+
+    /* 记录rec所在的分区 */
+    size_t route(const char *rec) const { return locate(rec + col.offset); }
+};
+
+/**
+ * 物化视图的定义。物化视图以一张普通的表保存select语句的结果，只能由视图维护修改，可以建索引、直接查询。
+ * base_tabs是定义中引用的表（包括子查询中的表），这些表上的修改在提交时应用到视图上，被视图引用的表不能删除
+ */
+struct MatViewMeta {
+    std::string sql;                        // 定义视图的select语句，不是物化视图时为空
+    ViewRefresh refresh = REFRESH_IMMEDIATE;
+    std::vector<std::string> base_tabs;
+
+    bool is_view() const { return !sql.empty(); }
+};
+
 /* 表元数据 */
 struct TabMeta {
     std::string name;                   // 表名称
+    oid_t oid = 0;                      // 表的编号，日志中用它代替表名
     std::vector<ColMeta> cols;          // 表包含的字段
     std::vector<IndexMeta> indexes;     // 表上建立的索引
+    TabStats stats;                     // ANALYZE收集的统计信息
+    PartitionMeta partition;            // 分区方式，不是分区表时为PARTITION_NONE
+    MatViewMeta view;                   // 物化视图的定义，不是物化视图时为空
+    std::unordered_map<std::string, size_t> col_pos_;   // 字段名称到字段在cols中的位置，由index_cols建立
 
     TabMeta(){}
 
     TabMeta(const TabMeta &other) {
         name = other.name;
+        oid = other.oid;
         for(auto col : other.cols) cols.push_back(col);
+        stats = other.stats;
+        partition = other.partition;
+        view = other.view;
+        col_pos_ = other.col_pos_;
+    }
+
+    /* 建立字段名称的哈希索引，之后按名称查找字段为O(1)。cols确定之后调用 */
+    void index_cols() {
+        col_pos_.clear();
+        for (size_t i = 0; i < cols.size(); ++i) {
+            col_pos_.emplace(cols[i].name, i);
+        }
+    }
+
+    /* 名为col_name的字段在cols中的位置，不存在时返回cols.size()。没有建立哈希索引时逐个比较 */
+    size_t find_col(const std::string &col_name) const {
+        if (col_pos_.size() == cols.size()) {
+            auto pos = col_pos_.find(col_name);
+            return pos != col_pos_.end() ? pos->second : cols.size();
+        }
+        auto pos = std::find_if(cols.begin(), cols.end(), [&](const ColMeta &col) { return col.name == col_name; });
+        return static_cast<size_t>(pos - cols.begin());
     }
 
     /* 判断当前表中是否存在名为col_name的字段 */
     bool is_col(const std::string &col_name) const {
-        auto pos = std::find_if(cols.begin(), cols.end(), [&](const ColMeta &col) { return col.name == col_name; });
-        return pos != cols.end();
+        return find_col(col_name) < cols.size();
     }
 
     /* 判断当前表上是否建有指定索引，索引包含的字段为col_names */
@@ -117,15 +237,15 @@ struct TabMeta {
 
     /* 根据字段名称获取字段元数据 */
     std::vector<ColMeta>::iterator get_col(const std::string &col_name) {
-        auto pos = std::find_if(cols.begin(), cols.end(), [&](const ColMeta &col) { return col.name == col_name; });
-        if (pos == cols.end()) {
+        size_t pos = find_col(col_name);
+        if (pos == cols.size()) {
             throw ColumnNotFoundError(col_name);
         }
-        return pos;
+        return cols.begin() + pos;
     }
 
     friend std::ostream &operator<<(std::ostream &os, const TabMeta &tab) {
-        os << tab.name << '\n' << tab.cols.size() << '\n';
+        os << tab.name << '\n' << "OID " << tab.oid << '\n' << tab.cols.size() << '\n';
         for (auto &col : tab.cols) {
             os << col << '\n';  // col是ColMeta类型，然后调用重载的ColMeta的操作符<<
         }
@@ -133,12 +253,22 @@ struct TabMeta {
         for (auto &index : tab.indexes) {
             os << index << "\n";
         }
+        if (tab.stats.analyzed) {
+            os << tab.stats << "\n";
+        }
         return os;
     }
 
     friend std::istream &operator>>(std::istream &is, TabMeta &tab) {
         size_t n;
-        is >> tab.name >> n;
+        is >> tab.name >> std::ws;
+        // 没有记录oid的表由旧版本创建，打开数据库时再分配
+        tab.oid = 0;
+        if (is.peek() == 'O') {
+            std::string key;
+            is >> key >> tab.oid;
+        }
+        is >> n;
         for (size_t i = 0; i < n; i++) {
             ColMeta col;
             is >> col;
@@ -150,6 +280,10 @@ struct TabMeta {
             is >> index;
             tab.indexes.push_back(index);
         }
+        if ((is >> std::ws).peek() == '$') {
+            is >> tab.stats;
+        }
+        tab.index_cols();
         return is;
     }
 };
@@ -158,34 +292,108 @@ struct TabMeta {
 /* 数据库元数据 */
 class DbMeta {
     friend class SmManager;
+    friend class SmCatalog;
 
    private:
     std::string name_;                      // 数据库名称
+    int page_size_ = PAGE_SIZE;             // 数据库的页面大小，在创建数据库时确定
     std::map<std::string, TabMeta> tabs_;   // 数据库中包含的表
+    std::unordered_map<std::string, TabMeta *> tab_index_;   // 表名到tabs_中的表，按名称查找为O(1)
+    std::vector<TabMeta *> oid_index_;                       // 以oid为下标的表，没有对应的表时为nullptr
+
+    /* tabs_修改之后重建两个索引，std::map中元素的地址在其他元素插入和删除时不变 */
+    void index_tables() {
+        tab_index_.clear();
+        oid_index_.clear();
+        for (auto &entry : tabs_) {
+            index_table(&entry.second);
+        }
+    }
+
+    void index_table(TabMeta *tab) {
+        tab_index_[tab->name] = tab;
+        if (tab->oid != 0) {
+            if (oid_index_.size() <= tab->oid) {
+                oid_index_.resize(tab->oid + 1, nullptr);
+            }
+            oid_index_[tab->oid] = tab;
+        }
+    }
 
    public:
-    // DbMeta(std::string name) : name_(name) {}
+    DbMeta() = default;
+
+    DbMeta(const DbMeta &other) : name_(other.name_), page_size_(other.page_size_), tabs_(other.tabs_) {
+        index_tables();
+    }
+
+    DbMeta &operator=(const DbMeta &other) {
+        name_ = other.name_;
+        page_size_ = other.page_size_;
+        tabs_ = other.tabs_;
+        index_tables();
+        return *this;
+    }
+
+    int get_page_size() const { return page_size_; }
+
+    /* 分配给新表的oid：比已有的表的oid都大，从1开始 */
+    oid_t next_oid() const {
+        oid_t oid = 0;
+        for (auto &entry : tabs_) {
+            oid = std::max(oid, entry.second.oid);
+        }
+        return oid + 1;
+    }
+
+    /* 数据库中全部表的元数据 */
+    const std::map<std::string, TabMeta> &get_tables() const { return tabs_; }
 
     /* 判断数据库中是否存在指定名称的表 */
-    bool is_table(const std::string &tab_name) const { return tabs_.find(tab_name) != tabs_.end(); }
+    bool is_table(const std::string &tab_name) const { return tab_index_.find(tab_name) != tab_index_.end(); }
 
     void SetTabMeta(const std::string &tab_name, const TabMeta &meta) {
-        tabs_[tab_name] = meta;
+        TabMeta &tab = tabs_[tab_name];
+        tab = meta;
+        index_table(&tab);
     }
 
-    /* 获取指定名称表的元数据 */
-    TabMeta &get_table(const std::string &tab_name) {
+    /* 删除一张表的元数据 */
+    void erase_table(const std::string &tab_name) {
         auto pos = tabs_.find(tab_name);
         if (pos == tabs_.end()) {
+            return;
+        }
+        tab_index_.erase(tab_name);
+        if (pos->second.oid < oid_index_.size()) {
+            oid_index_[pos->second.oid] = nullptr;
+        }
+        tabs_.erase(pos);
+    }
+
+    /* 删除全部表的元数据 */
+    void clear_tables() {
+        tabs_.clear();
+        tab_index_.clear();
+        oid_index_.clear();
+    }
+
+    /* 获取指定名称表的元数据 */
+    TabMeta &get_table(const std::string &tab_name) {
+        auto pos = tab_index_.find(tab_name);
+        if (pos == tab_index_.end()) {
             throw TableNotFoundError(tab_name);
         }
 
-        return pos->second;
+        return *pos->second;
     }
 
+    /* 获取oid对应的表的元数据，表不存在时返回nullptr */
+    TabMeta *find_table(oid_t oid) const { return oid < oid_index_.size() ? oid_index_[oid] : nullptr; }
+
     // 重载操作符 <<
     friend std::ostream &operator<<(std::ostream &os, const DbMeta &db_meta) {
-        os << db_meta.name_ << '\n' << db_meta.tabs_.size() << '\n';
+        os << db_meta.name_ << '\n' << "PAGE_SIZE " << db_meta.page_size_ << '\n' << db_meta.tabs_.size() << '\n';
         for (auto &entry : db_meta.tabs_) {
             os << entry.second << '\n';
         }
@@ -194,11 +402,18 @@ class DbMeta {
 
     friend std::istream &operator>>(std::istream &is, DbMeta &db_meta) {
         size_t n;
-        is >> db_meta.name_ >> n;
+        is >> db_meta.name_ >> std::ws;
+        // 没有记录页面大小的db.meta由旧版本创建，使用默认的页面大小
+        db_meta.page_size_ = PAGE_SIZE;
+        if (is.peek() == 'P') {
+            std::string key;
+            is >> key >> db_meta.page_size_;
+        }
+        is >> n;
         for (size_t i = 0; i < n; i++) {
             TabMeta tab;
             is >> tab;
-            db_meta.tabs_[tab.name] = tab;
+            db_meta.SetTabMeta(tab.name, tab);
         }
         return is;
     }
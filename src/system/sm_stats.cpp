@@ -0,0 +1,126 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "sm_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "sm_meta.h"
+
+double stats_key(ColType type, const char *data, int len) {
+    if (type == TYPE_INT) {
+        int value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+    if (type == TYPE_FLOAT) {
+        float value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+    // 6个字节不超过double的精度，换算后相同前缀的字符串相等
+    double key = 0;
+    for (int i = 0; i < 6; i++) {
+        key = key * 256 + (i < len ? static_cast<unsigned char>(data[i]) : 0);
+    }
+    return key;
+}
+
+void HyperLogLog::add(uint64_t hash) {
+    // 高位选择寄存器，其余位中第一个1的位置越靠后，说明见过的不同值越多
+    size_t index = hash >> (64 - STATS_HLL_PRECISION);
+    uint64_t rest = hash << STATS_HLL_PRECISION;
+    uint8_t rank = rest == 0 ? 64 - STATS_HLL_PRECISION + 1 : __builtin_clzll(rest) + 1;
+    registers_[index] = std::max(registers_[index], rank);
+}
+
+double HyperLogLog::estimate() const {
+    double m = static_cast<double>(registers_.size());
+    double sum = 0;
+    int zeros = 0;
+    for (uint8_t rank : registers_) {
+        sum += std::ldexp(1.0, -rank);
+        zeros += rank == 0;
+    }
+    double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    // 不同值较少时使用线性计数修正
+    if (estimate <= 2.5 * m && zeros > 0) {
+        estimate = m * std::log(m / zeros);
+    }
+    return estimate;
+}
+
+static uint64_t stats_hash(const char *data, int len) {
+    uint64_t h = 14695981039346656037ULL;
+    for (int i = 0; i < len; ++i) {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+TabStatsCollector::TabStatsCollector(const std::vector<ColMeta> &cols)
+    : cols_(cols), hlls_(cols.size()), mins_(cols.size()), maxs_(cols.size()), samples_(cols.size()) {}
+
+void TabStatsCollector::add(const char *record) {
+    // 蓄水池抽样：第n条记录以STATS_SAMPLE_ROWS / n的概率替换一个样本
+    int64_t sample_slot = num_rows_;
+    if (num_rows_ >= STATS_SAMPLE_ROWS) {
+        sample_slot = static_cast<int64_t>(rng_() % static_cast<uint64_t>(num_rows_ + 1));
+    }
+    for (size_t i = 0; i < cols_.size(); i++) {
+        const ColMeta &col = cols_[i];
+        const char *data = record + col.offset;
+        double key = stats_key(col.type, data, col.len);
+        hlls_[i].add(stats_hash(data, col.len));
+        if (num_rows_ == 0 || key < mins_[i]) mins_[i] = key;
+        if (num_rows_ == 0 || key > maxs_[i]) maxs_[i] = key;
+        if (num_rows_ < STATS_SAMPLE_ROWS) {
+            samples_[i].push_back(key);
+        } else if (sample_slot < STATS_SAMPLE_ROWS) {
+            samples_[i][sample_slot] = key;
+        }
+    }
+    num_rows_++;
+}
+
+TabStats TabStatsCollector::finish(int num_pages) {
+    TabStats stats;
+    stats.analyzed = true;
+    stats.num_rows = num_rows_;
+    stats.num_pages = num_pages;
+    stats.cols.resize(cols_.size());
+    for (size_t i = 0; i < cols_.size(); i++) {
+        ColStats &col = stats.cols[i];
+        if (num_rows_ == 0) {
+            continue;
+        }
+        col.num_distinct = std::min(std::max(hlls_[i].estimate(), 1.0), static_cast<double>(num_rows_));
+        col.min = mins_[i];
+        col.max = maxs_[i];
+        // 样本排序后等间隔取边界，首尾替换为全表的最小值和最大值
+        std::vector<double> &sample = samples_[i];
+        std::sort(sample.begin(), sample.end());
+        int num_buckets = std::min<int>(STATS_HISTOGRAM_BUCKETS, static_cast<int>(sample.size()));
+        for (int b = 0; b <= num_buckets; b++) {
+            col.bounds.push_back(sample[(sample.size() - 1) * b / num_buckets]);
+        }
+        col.bounds.front() = col.min;
+        col.bounds.back() = col.max;
+    }
+    return stats;
+}
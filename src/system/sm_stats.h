@@ -0,0 +1,117 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "common/config.h"
+#include "defs.h"
+
+struct ColMeta;
+
+/* 字段统计信息。字符串字段按前几个字节换算成数值，所有类型的最小值、最大值和直方图都用double表示 */
+struct ColStats {
+    double num_distinct = 0;        // 不同值个数的估计
+    double min = 0;                 // 最小值
+    double max = 0;                 // 最大值
+    std::vector<double> bounds;     // 等深直方图的桶边界，相邻两个边界之间的记录数大致相同；没有记录时为空
+
+    friend std::ostream &operator<<(std::ostream &os, const ColStats &col) {
+        os << col.num_distinct << ' ' << col.min << ' ' << col.max << ' ' << col.bounds.size();
+        for (double bound : col.bounds) {
+            os << ' ' << bound;
+        }
+        return os;
+    }
+
+    friend std::istream &operator>>(std::istream &is, ColStats &col) {
+        size_t n;
+        is >> col.num_distinct >> col.min >> col.max >> n;
+        col.bounds.resize(n);
+        for (auto &bound : col.bounds) {
+            is >> bound;
+        }
+        return is;
+    }
+};
+
+/* 表的统计信息，由ANALYZE收集，与表的元数据保存在一起 */
+struct TabStats {
+    bool analyzed = false;          // 是否执行过ANALYZE
+    int64_t num_rows = 0;           // 记录数，ANALYZE之后的插入和删除由RmFileHandle中的计数器累加
+    int num_pages = 0;              // 收集时数据文件的页面数
+    std::vector<ColStats> cols;     // 与TabMeta::cols一一对应
+
+    // 以$STATS开头（不是合法的表名），没有执行过ANALYZE的表不输出，格式与旧的元数据文件相同
+    friend std::ostream &operator<<(std::ostream &os, const TabStats &stats) {
+        auto precision = os.precision(17);
+        os << "$STATS " << stats.num_rows << ' ' << stats.num_pages << ' ' << stats.cols.size();
+        for (auto &col : stats.cols) {
+            os << '\n' << col;
+        }
+        os.precision(precision);
+        return os;
+    }
+
+    friend std::istream &operator>>(std::istream &is, TabStats &stats) {
+        std::string tag;
+        size_t n;
+        is >> tag >> stats.num_rows >> stats.num_pages >> n;
+        stats.cols.resize(n);
+        for (auto &col : stats.cols) {
+            is >> col;
+        }
+        stats.analyzed = true;
+        return is;
+    }
+};
+
+/* 把字段值换算成统计信息使用的数值：数值类型取原值，字符串取前6个字节按大端序组成的整数，保持字符串的字典序 */
+double stats_key(ColType type, const char *data, int len);
+
+/* HyperLogLog：用固定数量的寄存器估计不同值的个数，标准误差约为1.04 / sqrt(寄存器个数) */
+class HyperLogLog {
+   public:
+    HyperLogLog() : registers_(1 << STATS_HLL_PRECISION, 0) {}
+
+    void add(uint64_t hash);
+
+    double estimate() const;
+
+   private:
+    std::vector<uint8_t> registers_;
+};
+
+/**
+ * @brief 扫描一遍表收集统计信息。记录数、不同值个数、最小值和最大值基于全部记录，
+ * 直方图基于蓄水池抽样得到的最多STATS_SAMPLE_ROWS条记录
+ */
+class TabStatsCollector {
+   public:
+    explicit TabStatsCollector(const std::vector<ColMeta> &cols);
+
+    void add(const char *record);
+
+    TabStats finish(int num_pages);
+
+   private:
+    const std::vector<ColMeta> &cols_;
+    int64_t num_rows_ = 0;
+    std::vector<HyperLogLog> hlls_;
+    std::vector<double> mins_;
+    std::vector<double> maxs_;
+    std::vector<std::vector<double>> samples_;  // 每个字段的样本值，下标相同的样本来自同一条记录
+    std::mt19937_64 rng_{0};                    // 固定种子，相同的数据得到相同的统计信息
+};
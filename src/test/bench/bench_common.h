@@ -7,10 +7,10 @@ THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
 EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
 MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
 See the Mulan PSL v2 for more details. */
-#include "ast.h"
 
-namespace ast {
+#pragma once
 
-std::shared_ptr<TreeNode> parse_tree;
+#include <string>
 
-}
+/* rmdb_bench各个源文件共用的设置，main在运行基准之前创建BENCH_DB_NAME目录，结束后删除 */
+inline const std::string BENCH_DB_NAME = "rmdb_bench_db";      // 存放基准测试文件的目录
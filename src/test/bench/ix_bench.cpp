@@ -0,0 +1,344 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+/**
+ * B+树的基准：点查询、顺序和随机插入、删除、不同长度的范围扫描，以及不同读写比例和线程数的混合负载。
+ * 每个基准分别使用INT、(INT, INT)和CHAR(16)三种key，除ops/s之外还给出抽样的p50/p99延迟、树高和叶子结点的平均填充率，
+ * 用于比较分裂、合并、批量构建和前缀压缩等修改对树的形状和性能的影响
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_common.h"
+#include "benchmark/benchmark.h"
+#include "index/ix.h"
+
+namespace {
+
+constexpr int BENCH_IX_NUM_KEYS = 100000;               // 点查询、范围扫描和混合负载的索引中的key个数
+constexpr int BENCH_IX_DELETE_BATCH = 10000;            // 删除基准每次重新插入的key个数
+constexpr int BENCH_IX_CHAR_LEN = 16;
+constexpr int BENCH_IX_SAMPLE_EVERY = 8;                // 每隔多少次操作记录一次延迟
+
+/* 基准使用的key类型 */
+enum IxBenchKey { IX_BENCH_INT, IX_BENCH_COMPOSITE, IX_BENCH_CHAR };
+
+const char *key_name(IxBenchKey kind) {
+    switch (kind) {
+        case IX_BENCH_INT:
+            return "int";
+        case IX_BENCH_COMPOSITE:
+            return "composite";
+        default:
+            return "char";
+    }
+}
+
+std::vector<ColMeta> key_cols(IxBenchKey kind) {
+    switch (kind) {
+        case IX_BENCH_INT:
+            return {{"bench", "k", TYPE_INT, sizeof(int), 0, true}};
+        case IX_BENCH_COMPOSITE:
+            return {{"bench", "k1", TYPE_INT, sizeof(int), 0, true},
+                    {"bench", "k2", TYPE_INT, sizeof(int), sizeof(int), true}};
+        default:
+            return {{"bench", "k", TYPE_STRING, BENCH_IX_CHAR_LEN, 0, true}};
+    }
+}
+
+/* 把非负整数k编码为对应类型的key，编码保持k的顺序 */
+void make_key(IxBenchKey kind, int k, char *key) {
+    switch (kind) {
+        case IX_BENCH_INT:
+            memcpy(key, &k, sizeof(int));
+            break;
+        case IX_BENCH_COMPOSITE: {
+            int cols[2] = {k >> 10, k & 1023};
+            memcpy(key, cols, sizeof(cols));
+            break;
+        }
+        default: {
+            char str[BENCH_IX_CHAR_LEN + 1];
+            snprintf(str, sizeof(str), "%010d", k);
+            memset(key, 0, BENCH_IX_CHAR_LEN);
+            memcpy(key, str, strlen(str));
+            break;
+        }
+    }
+}
+
+/* 第i个随机插入的key：乘以奇数在模2^31下是一一映射，不会产生重复的key */
+int scatter(int i) { return static_cast<int>((static_cast<uint32_t>(i) * 2654435761u) & 0x7fffffff); }
+
+/* 一个B+树索引文件和它使用的缓冲池 */
+struct IxFile {
+    std::unique_ptr<DiskManager> disk_manager;
+    std::unique_ptr<BufferPoolManager> bpm;
+    std::unique_ptr<IxManager> ix_manager;
+    std::unique_ptr<IxIndexHandle> ih;
+    std::string file_name;
+    std::vector<ColMeta> cols;
+
+    IxFile(IxBenchKey kind, const std::string &name) : file_name(BENCH_DB_NAME + "/" + name), cols(key_cols(kind)) {
+        disk_manager = std::make_unique<DiskManager>();
+        bpm = std::make_unique<BufferPoolManager>(BUFFER_POOL_SIZE, disk_manager.get());
+        ix_manager = std::make_unique<IxManager>(disk_manager.get(), bpm.get());
+        if (ix_manager->exists(file_name, cols)) {
+            ix_manager->destroy_index(file_name, cols);
+        }
+        ix_manager->create_index(file_name, cols, cols.size() > 1 ? IX_KEY_NORMALIZED : IX_KEY_RAW);
+        ih = ix_manager->open_index(file_name, cols);
+    }
+
+    ~IxFile() {
+        ix_manager->close_index(ih.get());
+        ix_manager->destroy_index(file_name, cols);
+    }
+};
+
+/* 点查询和范围扫描共用的索引，按随机顺序插入key 0..BENCH_IX_NUM_KEYS-1；不析构，进程退出时测试目录已经删除 */
+template <IxBenchKey Kind>
+IxFile &loaded_index() {
+    static IxFile *file = [] {
+        auto *f = new IxFile(Kind, std::string("bench_ix_") + key_name(Kind));
+        std::vector<int> keys(BENCH_IX_NUM_KEYS);
+        for (int i = 0; i < BENCH_IX_NUM_KEYS; i++) {
+            keys[i] = i;
+        }
+        std::shuffle(keys.begin(), keys.end(), std::mt19937(1));
+        char key[IX_MAX_COL_LEN];
+        for (int k : keys) {
+            make_key(Kind, k, key);
+            f->ih->insert_entry(key, Rid{k, 0}, nullptr);
+        }
+        return f;
+    }();
+    return *file;
+}
+
+/* 每隔BENCH_IX_SAMPLE_EVERY次操作记录一次延迟，结束时给出p50/p99（微秒），多线程时取各线程的平均值 */
+class LatencySampler {
+   public:
+    LatencySampler() { samples_.reserve(1 << 16); }
+
+    bool sampling() { return ++count_ % BENCH_IX_SAMPLE_EVERY == 0; }
+
+    void add(std::chrono::steady_clock::time_point start) {
+        samples_.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    void report(benchmark::State &state) {
+        if (samples_.empty()) return;
+        std::sort(samples_.begin(), samples_.end());
+        auto at = [this](double q) { return samples_[static_cast<size_t>(q * (samples_.size() - 1))]; };
+        state.counters["p50_us"] = benchmark::Counter(at(0.5), benchmark::Counter::kAvgThreads);
+        state.counters["p99_us"] = benchmark::Counter(at(0.99), benchmark::Counter::kAvgThreads);
+    }
+
+   private:
+    size_t count_ = 0;
+    std::vector<double> samples_;
+};
+
+/* 执行一次操作，需要抽样时记录它的延迟 */
+template <typename Op>
+void timed(LatencySampler &sampler, Op &&op) {
+    if (sampler.sampling()) {
+        auto start = std::chrono::steady_clock::now();
+        op();
+        sampler.add(start);
+    } else {
+        op();
+    }
+}
+
+/* 由一个线程给出树的形状，多线程基准中只有一个线程设置，汇总时不会重复累加 */
+void report_tree(benchmark::State &state, const IxIndexHandle *ih) {
+    if (state.thread_index() != 0) return;
+    IxTreeStats stats = ih->get_tree_stats();
+    state.counters["height"] = stats.height;
+    state.counters["leaf_fill"] = stats.leaf_fill;
+}
+
+/* 随机的点查询 */
+template <IxBenchKey Kind>
+void BM_IxPointLookup(benchmark::State &state) {
+    IxFile &file = loaded_index<Kind>();
+    std::mt19937 rng(state.thread_index() * 7919 + 1);
+    std::uniform_int_distribution<int> dist(0, BENCH_IX_NUM_KEYS - 1);
+    LatencySampler sampler;
+    char key[IX_MAX_COL_LEN];
+    std::vector<Rid> result;
+    for (auto _ : state) {
+        make_key(Kind, dist(rng), key);
+        result.clear();
+        timed(sampler, [&] { benchmark::DoNotOptimize(file.ih->get_value(key, &result, nullptr)); });
+    }
+    state.SetItemsProcessed(state.iterations());
+    sampler.report(state);
+    report_tree(state, file.ih.get());
+}
+BENCHMARK_TEMPLATE(BM_IxPointLookup, IX_BENCH_INT);
+BENCHMARK_TEMPLATE(BM_IxPointLookup, IX_BENCH_COMPOSITE);
+BENCHMARK_TEMPLATE(BM_IxPointLookup, IX_BENCH_CHAR);
+
+/* 向空索引插入，state.range(0)为0时插入递增的key，为1时插入随机的key */
+template <IxBenchKey Kind>
+void BM_IxInsert(benchmark::State &state) {
+    IxFile file(Kind, std::string("bench_ix_insert_") + key_name(Kind));
+    bool random = state.range(0) != 0;
+    LatencySampler sampler;
+    char key[IX_MAX_COL_LEN];
+    int i = 0;
+    for (auto _ : state) {
+        int k = random ? scatter(i) : i;
+        i++;
+        make_key(Kind, k, key);
+        timed(sampler, [&] { file.ih->insert_entry(key, Rid{k, 0}, nullptr); });
+    }
+    state.SetItemsProcessed(state.iterations());
+    sampler.report(state);
+    report_tree(state, file.ih.get());
+}
+BENCHMARK_TEMPLATE(BM_IxInsert, IX_BENCH_INT)->ArgName("random")->Arg(0)->Arg(1);
+BENCHMARK_TEMPLATE(BM_IxInsert, IX_BENCH_COMPOSITE)->ArgName("random")->Arg(0)->Arg(1);
+BENCHMARK_TEMPLATE(BM_IxInsert, IX_BENCH_CHAR)->ArgName("random")->Arg(0)->Arg(1);
+
+/**
+ * 按随机顺序删除：索引中始终保留BENCH_IX_NUM_KEYS个不删除的key，另外BENCH_IX_DELETE_BATCH个key删完之后暂停计时重新插入。
+ * 树高和填充率反映合并和重分配之后的形状
+ */
+template <IxBenchKey Kind>
+void BM_IxDelete(benchmark::State &state) {
+    IxFile file(Kind, std::string("bench_ix_delete_") + key_name(Kind));
+    char key[IX_MAX_COL_LEN];
+    for (int i = 0; i < BENCH_IX_NUM_KEYS; i++) {
+        int k = scatter(2 * i);
+        make_key(Kind, k, key);
+        file.ih->insert_entry(key, Rid{k, 0}, nullptr);
+    }
+    std::vector<int> keys(BENCH_IX_DELETE_BATCH);
+    for (int i = 0; i < BENCH_IX_DELETE_BATCH; i++) {
+        keys[i] = scatter(2 * i + 1);
+    }
+    std::mt19937 rng(1);
+    LatencySampler sampler;
+    size_t pos = keys.size();
+    for (auto _ : state) {
+        if (pos == keys.size()) {
+            state.PauseTiming();
+            for (int k : keys) {
+                make_key(Kind, k, key);
+                file.ih->insert_entry(key, Rid{k, 0}, nullptr);
+            }
+            std::shuffle(keys.begin(), keys.end(), rng);
+            pos = 0;
+            state.ResumeTiming();
+        }
+        int k = keys[pos++];
+        make_key(Kind, k, key);
+        timed(sampler, [&] { file.ih->delete_entry(key, Rid{k, 0}, nullptr); });
+    }
+    state.SetItemsProcessed(state.iterations());
+    sampler.report(state);
+    report_tree(state, file.ih.get());
+}
+BENCHMARK_TEMPLATE(BM_IxDelete, IX_BENCH_INT);
+BENCHMARK_TEMPLATE(BM_IxDelete, IX_BENCH_COMPOSITE);
+BENCHMARK_TEMPLATE(BM_IxDelete, IX_BENCH_CHAR);
+
+/* 从随机位置开始扫描state.range(0)个key，items_per_second为每秒扫描的key数 */
+template <IxBenchKey Kind>
+void BM_IxRangeScan(benchmark::State &state) {
+    IxFile &file = loaded_index<Kind>();
+    int length = static_cast<int>(state.range(0));
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> dist(0, BENCH_IX_NUM_KEYS - length);
+    LatencySampler sampler;
+    char lower[IX_MAX_COL_LEN];
+    char upper[IX_MAX_COL_LEN];
+    for (auto _ : state) {
+        int lo = dist(rng);
+        make_key(Kind, lo, lower);
+        make_key(Kind, lo + length - 1, upper);
+        timed(sampler, [&] {
+            int64_t sum = 0;
+            IxScan scan(file.ih.get(), file.ih->lower_bound(lower), file.ih->upper_bound(upper), file.bpm.get());
+            for (; !scan.is_end(); scan.next()) {
+                sum += scan.rid().page_no;
+            }
+            benchmark::DoNotOptimize(sum);
+        });
+    }
+    state.SetItemsProcessed(state.iterations() * length);
+    sampler.report(state);
+    report_tree(state, file.ih.get());
+}
+BENCHMARK_TEMPLATE(BM_IxRangeScan, IX_BENCH_INT)->ArgName("length")->RangeMultiplier(10)->Range(10, 10000);
+BENCHMARK_TEMPLATE(BM_IxRangeScan, IX_BENCH_COMPOSITE)->ArgName("length")->RangeMultiplier(10)->Range(10, 10000);
+BENCHMARK_TEMPLATE(BM_IxRangeScan, IX_BENCH_CHAR)->ArgName("length")->RangeMultiplier(10)->Range(10, 10000);
+
+/**
+ * 混合负载：state.range(0)%的操作为点查询，其余为写操作，写操作随机删除或插入一个key，索引大小基本不变。
+ * 所有线程和读写比例共用一个索引，线程数由ThreadRange给出
+ */
+template <IxBenchKey Kind>
+void BM_IxMixed(benchmark::State &state) {
+    static IxFile *file = [] {
+        auto *f = new IxFile(Kind, std::string("bench_ix_mixed_") + key_name(Kind));
+        char key[IX_MAX_COL_LEN];
+        for (int i = 0; i < BENCH_IX_NUM_KEYS; i += 2) {
+            int k = scatter(i) % BENCH_IX_NUM_KEYS;
+            make_key(Kind, k, key);
+            f->ih->insert_entry(key, Rid{k, 0}, nullptr);
+        }
+        return f;
+    }();
+    int read_percent = static_cast<int>(state.range(0));
+    std::mt19937 rng(state.thread_index() * 7919 + 1);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::uniform_int_distribution<int> dist(0, BENCH_IX_NUM_KEYS - 1);
+    LatencySampler sampler;
+    char key[IX_MAX_COL_LEN];
+    std::vector<Rid> result;
+    for (auto _ : state) {
+        int k = dist(rng);
+        make_key(Kind, k, key);
+        bool read = percent(rng) < read_percent;
+        timed(sampler, [&] {
+            if (read) {
+                result.clear();
+                file->ih->get_value(key, &result, nullptr);
+            } else if (k & 1) {
+                file->ih->delete_entry(key, Rid{k, 0}, nullptr);
+            } else {
+                file->ih->insert_entry(key, Rid{k, 0}, nullptr);
+            }
+        });
+    }
+    state.SetItemsProcessed(state.iterations());
+    sampler.report(state);
+    report_tree(state, file->ih.get());
+}
+BENCHMARK_TEMPLATE(BM_IxMixed, IX_BENCH_INT)->ArgName("read_percent")->Arg(100)->Arg(95)->Arg(50)
+    ->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_IxMixed, IX_BENCH_COMPOSITE)->ArgName("read_percent")->Arg(100)->Arg(95)->Arg(50)
+    ->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_IxMixed, IX_BENCH_CHAR)->ArgName("read_percent")->Arg(100)->Arg(95)->Arg(50)
+    ->ThreadRange(1, 64)->UseRealTime();
+
+}  // namespace
@@ -0,0 +1,311 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+/**
+ * 存储层热点路径的微基准：缓冲池的fetch_page/unpin_page、各替换策略的victim/pin/unpin、
+ * DiskManager的顺序和随机读写，以及RmFileHandle的插入、读取和扫描，B+树的基准见ix_bench.cpp。
+ * 默认把结果以JSON格式写入rmdb_bench.json，命令行指定--benchmark_out时使用指定的文件，便于比较不同版本的结果
+ */
+
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_common.h"
+#include "benchmark/benchmark.h"
+#include "record/rm.h"
+#include "replacer/arc_replacer.h"
+#include "replacer/clock_replacer.h"
+#include "replacer/lru_k_replacer.h"
+#include "replacer/lru_replacer.h"
+#include "storage/buffer_pool_manager.h"
+
+namespace {
+
+constexpr size_t BENCH_POOL_SIZE = 1024;                // 缓冲池的帧数
+constexpr int BENCH_HOT_PAGES = 256;                    // 常驻缓冲池的热页面个数
+constexpr int BENCH_COLD_PAGES = 16 * 1024;             // 远大于缓冲池的冷页面个数，访问冷页面基本都不命中
+constexpr int BENCH_DISK_PAGES = 4096;                  // DiskManager读写的文件的页面个数
+constexpr int BENCH_RECORD_SIZE = 64;
+constexpr int BENCH_NUM_RECORDS = 100000;               // 读取和扫描的表中的记录数
+
+/* 缓冲池基准共用的文件：前BENCH_HOT_PAGES个页面为热页面，其余为冷页面，所有线程和命中率共用一份。
+   各基准共用的环境在第一次使用时创建，不析构，进程退出时测试目录已经删除 */
+struct PoolEnv {
+    std::unique_ptr<DiskManager> disk_manager;
+    std::unique_ptr<BufferPoolManager> bpm;
+    int fd = -1;
+
+    PoolEnv() {
+        disk_manager = std::make_unique<DiskManager>();
+        bpm = std::make_unique<BufferPoolManager>(BENCH_POOL_SIZE, disk_manager.get());
+        std::string file_name = BENCH_DB_NAME + "/bench_pool";
+        if (disk_manager->is_file(file_name)) {
+            disk_manager->destroy_file(file_name);
+        }
+        disk_manager->create_file(file_name);
+        fd = disk_manager->open_file(file_name);
+        for (int i = 0; i < BENCH_HOT_PAGES + BENCH_COLD_PAGES; i++) {
+            PageId page_id{fd, INVALID_PAGE_ID};
+            Page *page = bpm->new_page(&page_id);
+            memset(page->get_data(), i & 0xff, disk_manager->get_page_size());
+            bpm->unpin_page(page_id, true);
+        }
+        bpm->flush_all_pages(fd);
+    }
+
+    static PoolEnv &get() {
+        static PoolEnv *env = new PoolEnv();
+        return *env;
+    }
+};
+
+/**
+ * fetch_page/unpin_page：以state.range(0)%的概率访问热页面，否则访问随机的冷页面。
+ * 冷页面的访问会淘汰部分热页面，实际命中率由缓冲池的统计信息给出
+ */
+void BM_FetchUnpin(benchmark::State &state) {
+    PoolEnv &env = PoolEnv::get();
+    int hit_percent = static_cast<int>(state.range(0));
+    std::mt19937 rng(state.thread_index() * 7919 + 1);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::uniform_int_distribution<int> hot(0, BENCH_HOT_PAGES - 1);
+    std::uniform_int_distribution<int> cold(BENCH_HOT_PAGES, BENCH_HOT_PAGES + BENCH_COLD_PAGES - 1);
+    BufferPoolStats before;
+    if (state.thread_index() == 0) {
+        // 预热：把热页面读入缓冲池
+        for (int i = 0; i < BENCH_HOT_PAGES; i++) {
+            PageId page_id{env.fd, i};
+            env.bpm->fetch_page(page_id);
+            env.bpm->unpin_page(page_id, false);
+        }
+        before = env.bpm->get_stats();
+    }
+    for (auto _ : state) {
+        PageId page_id{env.fd, percent(rng) < hit_percent ? hot(rng) : cold(rng)};
+        Page *page = env.bpm->fetch_page(page_id);
+        benchmark::DoNotOptimize(page->get_data()[0]);
+        env.bpm->unpin_page(page_id, false);
+    }
+    state.SetItemsProcessed(state.iterations());
+    if (state.thread_index() == 0) {
+        BufferPoolStats after = env.bpm->get_stats();
+        uint64_t hits = after.get(BufferPoolStats::HITS) - before.get(BufferPoolStats::HITS);
+        uint64_t misses = after.get(BufferPoolStats::MISSES) - before.get(BufferPoolStats::MISSES);
+        state.counters["hit_ratio"] = hits + misses == 0 ? 0 : static_cast<double>(hits) / (hits + misses);
+    }
+}
+BENCHMARK(BM_FetchUnpin)->ArgName("hit_percent")->Arg(100)->Arg(90)->Arg(50)->ThreadRange(1, 64)->UseRealTime();
+
+/* victim：淘汰一个帧，再把它作为新读入的页面放回替换器 */
+template <typename ReplacerType>
+void BM_ReplacerVictim(benchmark::State &state) {
+    ReplacerType replacer(BENCH_POOL_SIZE);
+    for (size_t i = 0; i < BENCH_POOL_SIZE; i++) {
+        replacer.unpin(static_cast<frame_id_t>(i));
+    }
+    for (auto _ : state) {
+        frame_id_t frame_id;
+        replacer.victim(&frame_id);
+        replacer.record_load(frame_id, frame_id);
+        replacer.unpin(frame_id);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_ReplacerVictim, LRUReplacer);
+BENCHMARK_TEMPLATE(BM_ReplacerVictim, ClockReplacer);
+BENCHMARK_TEMPLATE(BM_ReplacerVictim, LRUKReplacer);
+BENCHMARK_TEMPLATE(BM_ReplacerVictim, ARCReplacer);
+
+/* pin/unpin：命中缓冲池时固定和释放一个随机的帧 */
+template <typename ReplacerType>
+void BM_ReplacerPinUnpin(benchmark::State &state) {
+    ReplacerType replacer(BENCH_POOL_SIZE);
+    for (size_t i = 0; i < BENCH_POOL_SIZE; i++) {
+        replacer.unpin(static_cast<frame_id_t>(i));
+    }
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<frame_id_t> frame(0, BENCH_POOL_SIZE - 1);
+    for (auto _ : state) {
+        frame_id_t frame_id = frame(rng);
+        replacer.pin(frame_id);
+        replacer.unpin(frame_id);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_ReplacerPinUnpin, LRUReplacer);
+BENCHMARK_TEMPLATE(BM_ReplacerPinUnpin, ClockReplacer);
+BENCHMARK_TEMPLATE(BM_ReplacerPinUnpin, LRUKReplacer);
+BENCHMARK_TEMPLATE(BM_ReplacerPinUnpin, ARCReplacer);
+
+/* DiskManager基准共用的文件，创建时写满BENCH_DISK_PAGES个页面 */
+struct DiskEnv {
+    std::unique_ptr<DiskManager> disk_manager;
+    int fd = -1;
+    std::vector<char> page;
+
+    DiskEnv() {
+        disk_manager = std::make_unique<DiskManager>();
+        page.assign(disk_manager->get_page_size(), 'x');
+        std::string file_name = BENCH_DB_NAME + "/bench_disk";
+        if (disk_manager->is_file(file_name)) {
+            disk_manager->destroy_file(file_name);
+        }
+        disk_manager->create_file(file_name);
+        fd = disk_manager->open_file(file_name);
+        for (int i = 0; i < BENCH_DISK_PAGES; i++) {
+            disk_manager->write_page(fd, i, page.data(), disk_manager->get_page_size());
+        }
+    }
+
+    static DiskEnv &get() {
+        static DiskEnv *env = new DiskEnv();
+        return *env;
+    }
+};
+
+/* 顺序或随机地读写页面，state.range(0)为0时顺序访问，为1时随机访问 */
+template <bool Write>
+void BM_DiskPage(benchmark::State &state) {
+    DiskEnv &env = DiskEnv::get();
+    bool random = state.range(0) != 0;
+    int page_size = env.disk_manager->get_page_size();
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> page_no(0, BENCH_DISK_PAGES - 1);
+    int next = 0;
+    for (auto _ : state) {
+        int target = random ? page_no(rng) : next;
+        next = (next + 1) % BENCH_DISK_PAGES;
+        if (Write) {
+            env.disk_manager->write_page(env.fd, target, env.page.data(), page_size);
+        } else {
+            env.disk_manager->read_page(env.fd, target, env.page.data(), page_size);
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * page_size);
+}
+BENCHMARK_TEMPLATE(BM_DiskPage, false)->Name("BM_DiskRead")->ArgName("random")->Arg(0)->Arg(1);
+BENCHMARK_TEMPLATE(BM_DiskPage, true)->Name("BM_DiskWrite")->ArgName("random")->Arg(0)->Arg(1);
+
+/* 记录文件基准共用的表，创建时插入BENCH_NUM_RECORDS条记录 */
+struct RecordEnv {
+    std::unique_ptr<DiskManager> disk_manager;
+    std::unique_ptr<BufferPoolManager> bpm;
+    std::unique_ptr<RmManager> rm_manager;
+    std::unique_ptr<RmFileHandle> fh;
+    std::vector<Rid> rids;
+
+    RecordEnv() {
+        disk_manager = std::make_unique<DiskManager>();
+        bpm = std::make_unique<BufferPoolManager>(BUFFER_POOL_SIZE, disk_manager.get());
+        rm_manager = std::make_unique<RmManager>(disk_manager.get(), bpm.get());
+        std::string file_name = BENCH_DB_NAME + "/bench_table";
+        if (disk_manager->is_file(file_name)) {
+            disk_manager->destroy_file(file_name);
+        }
+        rm_manager->create_file(file_name, BENCH_RECORD_SIZE);
+        fh = rm_manager->open_file(file_name);
+        std::vector<char> rec(BENCH_RECORD_SIZE);
+        for (int i = 0; i < BENCH_NUM_RECORDS; i++) {
+            memcpy(rec.data(), &i, sizeof(i));
+            rids.push_back(fh->insert_record(rec.data(), nullptr));
+        }
+    }
+
+    static RecordEnv &get() {
+        static RecordEnv *env = new RecordEnv();
+        return *env;
+    }
+};
+
+/* 插入记录，插入的记录写入单独的表，不影响读取和扫描的表 */
+void BM_RmInsert(benchmark::State &state) {
+    auto disk_manager = std::make_unique<DiskManager>();
+    auto bpm = std::make_unique<BufferPoolManager>(BUFFER_POOL_SIZE, disk_manager.get());
+    RmManager rm_manager(disk_manager.get(), bpm.get());
+    std::string file_name = BENCH_DB_NAME + "/bench_insert";
+    if (disk_manager->is_file(file_name)) {
+        disk_manager->destroy_file(file_name);
+    }
+    rm_manager.create_file(file_name, BENCH_RECORD_SIZE);
+    auto fh = rm_manager.open_file(file_name);
+    std::vector<char> rec(BENCH_RECORD_SIZE, 'r');
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(fh->insert_record(rec.data(), nullptr));
+    }
+    state.SetItemsProcessed(state.iterations());
+    rm_manager.close_file(fh.get());
+    disk_manager->destroy_file(file_name);
+}
+BENCHMARK(BM_RmInsert);
+
+/* 按随机的记录号读取记录 */
+void BM_RmGet(benchmark::State &state) {
+    RecordEnv &env = RecordEnv::get();
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<size_t> pos(0, env.rids.size() - 1);
+    for (auto _ : state) {
+        auto rec = env.fh->get_record(env.rids[pos(rng)], nullptr);
+        benchmark::DoNotOptimize(rec->data[0]);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RmGet);
+
+/* 批量模式顺序扫描整张表，每次迭代扫描一遍 */
+void BM_RmScan(benchmark::State &state) {
+    RecordEnv &env = RecordEnv::get();
+    for (auto _ : state) {
+        int64_t sum = 0;
+        for (RmScan scan(env.fh.get(), true); !scan.is_end(); scan.next_batch()) {
+            for (auto &slot : scan.batch()) {
+                sum += slot.data[0];
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * BENCH_NUM_RECORDS);
+}
+BENCHMARK(BM_RmScan)->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    // 没有指定输出文件时把JSON格式的结果写入rmdb_bench.json
+    std::vector<char *> args(argv, argv + argc);
+    bool has_out = false;
+    for (int i = 1; i < argc; i++) {
+        has_out |= strncmp(argv[i], "--benchmark_out=", strlen("--benchmark_out=")) == 0;
+    }
+    std::string out_arg = "--benchmark_out=rmdb_bench.json";
+    std::string format_arg = "--benchmark_out_format=json";
+    if (!has_out) {
+        args.push_back(out_arg.data());
+        args.push_back(format_arg.data());
+    }
+    int num_args = static_cast<int>(args.size());
+    benchmark::Initialize(&num_args, args.data());
+    if (benchmark::ReportUnrecognizedArguments(num_args, args.data())) {
+        return 1;
+    }
+
+    DiskManager disk_manager;
+    if (disk_manager.is_dir(BENCH_DB_NAME)) {
+        disk_manager.destroy_dir(BENCH_DB_NAME);
+    }
+    disk_manager.create_dir(BENCH_DB_NAME);
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    disk_manager.destroy_dir(BENCH_DB_NAME);
+    return 0;
+}
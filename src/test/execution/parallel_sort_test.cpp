@@ -0,0 +1,95 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include <cstring>
+#include <random>
+
+#include "gtest/gtest.h"
+#include "execution/parallel_sort.h"
+
+/* 条目为(排序键, 序号)：排序键的最后4字节是大端编码的键值，之前的字节都相同，长键的比较必须越过前8字节 */
+static const size_t ENTRY_LEN = 64;
+static const uint32_t SCALE = 100000;
+static const size_t PARALLELISM = 8;
+
+static void fill_entry(char *entry, size_t key_len, uint32_t key, uint32_t seq) {
+    memset(entry, 0x7f, key_len - sizeof(key));
+    for (size_t b = 0; b < sizeof(key); b++) {
+        entry[key_len - sizeof(key) + b] = static_cast<char>(key >> (8 * (sizeof(key) - 1 - b)));
+    }
+    memcpy(entry + key_len, &seq, sizeof(seq));
+}
+
+/**
+ * @brief 按给定的键长、不同键值的个数和内存预算排序SCALE个条目，检查输出按排序键有序、排序键相同的条目保持加入的顺序，
+ * 并取得内存中的块数和写出的run数
+ */
+static void sort_and_check(size_t key_len, uint32_t num_keys, size_t budget, size_t *num_chunks, size_t *num_runs) {
+    ParallelSorter sorter(key_len, ENTRY_LEN, budget, nullptr, PARALLELISM);
+    std::default_random_engine rng(2024);
+    std::uniform_int_distribution<uint32_t> dist(0, num_keys - 1);
+    for (uint32_t i = 0; i < SCALE; i++) {
+        fill_entry(sorter.add(), key_len, dist(rng), i);
+    }
+    sorter.finish();
+    *num_chunks = sorter.num_chunks();
+    *num_runs = sorter.num_runs();
+
+    // next返回的条目在下一次调用之前有效，写出run时它位于会被覆盖的读缓冲区中，上一个条目需要复制出来
+    uint32_t count = 0;
+    char last[ENTRY_LEN];
+    uint32_t last_seq = 0;
+    while (const char *entry = sorter.next()) {
+        uint32_t seq;
+        memcpy(&seq, entry + key_len, sizeof(seq));
+        if (count > 0) {
+            int cmp = memcmp(last, entry, key_len);
+            ASSERT_LE(cmp, 0);
+            if (cmp == 0) {
+                ASSERT_LT(last_seq, seq);
+            }
+        }
+        memcpy(last, entry, ENTRY_LEN);
+        last_seq = seq;
+        count++;
+    }
+    ASSERT_EQ(count, SCALE);
+    ASSERT_EQ(sorter.next(), nullptr);
+}
+
+/**
+ * @brief 全部在内存中时分成多块，由按分割点划分的多段并行归并。键值很少时相同的键跨越多块，分割点落在相同的键中间，
+ * 归并之后仍按加入的顺序输出；分别测试短于、等于和长于8字节前缀的排序键
+ */
+TEST(ParallelSorterTest, InMemoryMergeIsStable) {
+    for (size_t key_len : {4, 8, 20}) {
+        for (uint32_t num_keys : {1u, 50u, SCALE}) {
+            size_t num_chunks;
+            size_t num_runs;
+            sort_and_check(key_len, num_keys, ENTRY_LEN * SCALE * 2, &num_chunks, &num_runs);
+            EXPECT_EQ(num_runs, 0u);
+            EXPECT_GT(num_chunks, 2u);
+        }
+    }
+}
+
+/**
+ * @brief 内存预算只能容纳5000个条目时写出多个run，由败者树归并，相同键的条目在不同run之间保持加入的顺序
+ */
+TEST(ParallelSorterTest, SpilledMergeIsStable) {
+    for (size_t key_len : {4, 8, 20}) {
+        for (uint32_t num_keys : {1u, 50u, SCALE}) {
+            size_t num_chunks;
+            size_t num_runs;
+            sort_and_check(key_len, num_keys, ENTRY_LEN * 5000, &num_chunks, &num_runs);
+            EXPECT_GT(num_runs, 1u);
+        }
+    }
+}
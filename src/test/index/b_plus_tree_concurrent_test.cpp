@@ -55,10 +55,8 @@ class BPlusTreeConcurrentTest : public ::testing::Test {
         }
         sm_->create_db(TEST_DB_NAME);
         assert(disk_manager_->is_dir(TEST_DB_NAME));
-        // 进入测试目录
-        if (chdir(TEST_DB_NAME.c_str()) < 0) {
-            throw UnixError();
-        }
+        // 进入测试目录，create_table和create_index需要打开db.catalog
+        sm_->open_db(TEST_DB_NAME);
         // 如果测试文件存在，则先删除原文件（最后留下来的文件存的是最后一个测试点的数据）
         if (ix_manager_->exists(TEST_FILE_NAME, TEST_COL)) {
             ix_manager_->destroy_index(TEST_FILE_NAME, TEST_COL);
@@ -68,6 +66,11 @@ class BPlusTreeConcurrentTest : public ::testing::Test {
         coldef.push_back({"col2", TYPE_INT, 4});
         sm_->create_table(TEST_FILE_NAME, coldef, nullptr);
         sm_->create_index(TEST_FILE_NAME, TEST_COL, nullptr);
+        // 关闭SmManager打开的表和索引文件，之后只通过ih_访问索引
+        sm_->close_db();
+        if (chdir(TEST_DB_NAME.c_str()) < 0) {
+            throw UnixError();
+        }
         assert(ix_manager_->exists(TEST_FILE_NAME, TEST_COL));
         // 打开测试文件
         ih_ = ix_manager_->open_index(TEST_FILE_NAME, TEST_COL);
@@ -462,4 +465,110 @@ TEST_F(BPlusTreeConcurrentTest, MixScaleTest) {
         scan.next();
     }
     EXPECT_EQ(size, keys.size() - delete_keys.size());
-}
\ No newline at end of file
+}
+/**
+ * @brief 线程数从1逐步增加到16，每轮并发插入并查找scale个新的key，输出每轮的吞吐量
+ * 每个线程只处理自己的一段key，用于观察latch crabbing下读写操作随线程数的扩展情况
+ */
+TEST_F(BPlusTreeConcurrentTest, ThroughputScaleTest) {
+    const int64_t scale = 16000;
+    const int order = 64;
+    const std::vector<int> thread_nums = {1, 2, 4, 8, 16};
+
+    assert(order > 2 && order <= ih_->file_hdr_->btree_order_);
+    ih_->file_hdr_->btree_order_ = order;
+
+    int64_t next_key = 1;
+    for (int thread_num : thread_nums) {
+        // 本轮的key按线程分段，每段内部打乱顺序
+        std::vector<std::vector<int64_t>> thread_keys(thread_num);
+        auto rng = std::default_random_engine{};
+        for (int64_t i = 0; i < scale; i++) {
+            thread_keys[i * thread_num / scale].push_back(next_key + i);
+        }
+        for (auto &keys : thread_keys) {
+            std::shuffle(keys.begin(), keys.end(), rng);
+        }
+        next_key += scale;
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (int i = 0; i < thread_num; i++) {
+            threads.emplace_back(InsertHelper, ih_.get(), std::cref(thread_keys[i]), i);
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        // 每个key一次插入、一次查找
+        printf("threads=%d ops=%ld time=%.3fs throughput=%.0f ops/s\n", thread_num, 2 * scale, seconds,
+               2 * scale / seconds);
+    }
+
+    // 所有轮次插入的key都在叶子链上且有序
+    int64_t current_key = 1;
+    IxScan scan(ih_.get(), ih_->leaf_begin(), ih_->leaf_end(), buffer_pool_manager_.get());
+    while (!scan.is_end()) {
+        auto rid = scan.rid();
+        EXPECT_EQ(rid.slot_no, current_key);
+        current_key++;
+        scan.next();
+    }
+    EXPECT_EQ(current_key, next_key);
+}
+
+/**
+ * @brief 交错查找与并发插入同时进行：查找线程只尝试获取latch，插入引起的分裂不会使查找死锁或漏掉已有的key
+ */
+TEST_F(BPlusTreeConcurrentTest, InterleavedProbeTest) {
+    const int64_t scale = 5000;
+    const int thread_num = 4;
+    const int order = 16;
+
+    assert(order > 2 && order <= ih_->file_hdr_->btree_order_);
+    ih_->file_hdr_->btree_order_ = order;
+
+    std::vector<int64_t> keys;
+    for (int64_t key = 1; key <= scale; key++) {
+        keys.push_back(key);
+    }
+    InsertHelper(ih_.get(), keys);
+
+    // 插入线程各插入一段新的key，查找线程反复交错查找已有的key
+    std::vector<std::vector<int64_t>> insert_keys(thread_num);
+    for (int64_t i = 0; i < 3 * scale; i++) {
+        insert_keys[i % thread_num].push_back(scale + 1 + i);
+    }
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_num; i++) {
+        threads.emplace_back(InsertHelper, ih_.get(), std::cref(insert_keys[i]), i);
+        threads.emplace_back([&, i]() {
+            Transaction transaction(0);
+            std::vector<int32_t> probe_keys(keys.begin(), keys.end());
+            auto rng = std::default_random_engine(i);
+            for (int round = 0; round < 4; round++) {
+                std::shuffle(probe_keys.begin(), probe_keys.end(), rng);
+                std::vector<std::vector<Rid>> results;
+                int found = ih_->probe_values((const char *)probe_keys.data(), probe_keys.size(), &results,
+                                              &transaction);
+                EXPECT_EQ(found, scale);
+                for (size_t j = 0; j < probe_keys.size(); j++) {
+                    ASSERT_EQ(results[j].size(), 1);
+                    EXPECT_EQ(results[j][0].slot_no, probe_keys[j]);
+                }
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    int64_t current_key = 1;
+    IxScan scan(ih_.get(), ih_->leaf_begin(), ih_->leaf_end(), buffer_pool_manager_.get());
+    while (!scan.is_end()) {
+        EXPECT_EQ(scan.rid().slot_no, current_key);
+        current_key++;
+        scan.next();
+    }
+    EXPECT_EQ(current_key, 4 * scale + 1);
+}
@@ -1,6 +1,9 @@
 #include <algorithm>
 #include <cstdio>
+#include <functional>
+#include <map>
 #include <random>  // for std::default_random_engine
+#include <set>
 
 #include "gtest/gtest.h"
 
@@ -8,6 +11,7 @@
 #include "index/ix.h"
 #undef private  // for use private variables in "ix.h"
 
+#include "execution/parallel_sort.h"
 #include "storage/buffer_pool_manager.h"
 #include "system/sm.h"
 #include "record/rm.h"
@@ -53,10 +57,8 @@ class BPlusTreeTests : public ::testing::Test {
         }
         sm_->create_db(TEST_DB_NAME);
         assert(disk_manager_->is_dir(TEST_DB_NAME));
-        // 进入测试目录
-        if (chdir(TEST_DB_NAME.c_str()) < 0) {
-            throw UnixError();
-        }
+        // 进入测试目录，create_table和create_index需要打开db.catalog
+        sm_->open_db(TEST_DB_NAME);
         // 如果测试文件存在，则先删除原文件（最后留下来的文件存的是最后一个测试点的数据）
         if (ix_manager_->exists(TEST_FILE_NAME, TEST_COL)) {
             ix_manager_->destroy_index(TEST_FILE_NAME, TEST_COL);
@@ -66,6 +68,11 @@ class BPlusTreeTests : public ::testing::Test {
         coldef.push_back({"col2", TYPE_INT, 4});
         sm_->create_table(TEST_FILE_NAME, coldef, nullptr);
         sm_->create_index(TEST_FILE_NAME, TEST_COL, nullptr);
+        // 关闭SmManager打开的表和索引文件，之后只通过ih_访问索引
+        sm_->close_db();
+        if (chdir(TEST_DB_NAME.c_str()) < 0) {
+            throw UnixError();
+        }
         assert(ix_manager_->exists(TEST_FILE_NAME, TEST_COL));
         // 打开测试文件
         ih_ = ix_manager_->open_index(TEST_FILE_NAME, TEST_COL);
@@ -491,4 +498,467 @@ TEST_F(BPlusTreeTests, LargeScaleTest) {
     }
     std::cout << "Insert keys count: " << add_cnt << '\n' << "Delete keys count: " << del_cnt << '\n';
     check_all(ih_.get(), mock);
-}
\ No newline at end of file
+}
+/**
+ * @brief 空树上用insert_entries自底向上构建B+树，随后的删除、插入以及非空树上的批量插入都保持树结构正确
+ */
+TEST_F(BPlusTreeTests, BulkLoadTest) {
+    const int order = 32;
+    const int scale = 5000;
+
+    assert(order > 2 && order <= ih_->file_hdr_->btree_order_);
+    ih_->file_hdr_->btree_order_ = order;
+
+    // 已排序的键值对，包含一个重复的key，只保留第一个
+    std::multimap<int, Rid> mock;
+    std::vector<int> keys;
+    std::vector<Rid> rids;
+    for (int key = 0; key < scale; key++) {
+        keys.push_back(key * 2);
+        rids.push_back(Rid{.page_no = key, .slot_no = key * 2});
+        mock.insert(std::make_pair(key * 2, rids.back()));
+        if (key == scale / 2) {
+            keys.push_back(key * 2);
+            rids.push_back(Rid{.page_no = -1, .slot_no = -1});
+        }
+    }
+    ih_->insert_entries((const char *)keys.data(), rids.data(), static_cast<int>(keys.size()), txn_.get());
+    check_all(ih_.get(), mock);
+
+    // 根结点以外的结点都不少于最小键值对数量
+    std::function<void(int)> check_size = [&](int page_no) {
+        IxNodeHandle *node = ih_->fetch_node(page_no);
+        if (!node->is_root_page()) {
+            ASSERT_GE(node->get_size(), node->get_min_size());
+        }
+        ASSERT_LT(node->get_size(), node->get_max_size());
+        if (!node->is_leaf_page()) {
+            for (int i = 0; i < node->get_size(); i++) {
+                check_size(node->value_at(i));
+            }
+        }
+        buffer_pool_manager_->unpin_page(node->get_page_id(), false);
+    };
+    check_size(ih_->file_hdr_->root_page_);
+
+    // 删除一半的key，再逐条插入奇数key
+    for (int key = 0; key < scale; key += 2) {
+        int k = key * 2;
+        ASSERT_TRUE(ih_->delete_entry((const char *)&k, txn_.get()));
+        mock.erase(k);
+    }
+    for (int key = 1; key < scale; key += 4) {
+        Rid rid = {.page_no = key, .slot_no = key};
+        ih_->insert_entry((const char *)&key, rid, txn_.get());
+        mock.insert(std::make_pair(key, rid));
+    }
+    check_all(ih_.get(), mock);
+
+    // 非空树上的批量插入按顺序逐条插入
+    keys.clear();
+    rids.clear();
+    for (int key = 3; key < scale; key += 4) {
+        keys.push_back(key);
+        rids.push_back(Rid{.page_no = key, .slot_no = key});
+        mock.insert(std::make_pair(key, rids.back()));
+    }
+    ih_->insert_entries((const char *)keys.data(), rids.data(), static_cast<int>(keys.size()), txn_.get());
+    check_all(ih_.get(), mock);
+}
+
+/**
+ * @brief 乱序的键值对经外部排序（多个排好序的run归并）后按填充率自底向上构建B+树，
+ * 重复的key只保留最先加入的一个，除根结点外每个结点都不少于min_size，
+ * 除最后一个叶子外每个叶子都不超过fill_factor * order（最后一个叶子可能并入了不足半满的尾部）
+ */
+TEST_F(BPlusTreeTests, ExternalSortBulkLoadTest) {
+    const int order = 40;
+    const int scale = 20000;
+    const double fill_factor = 0.7;
+
+    assert(order > 2 && order <= ih_->file_hdr_->btree_order_);
+    ih_->file_hdr_->btree_order_ = order;
+
+    // 条目为(保序编码的key, key, rid)，内存预算只能容纳1000个条目，迫使排序产生多个run
+    size_t key_len = sizeof(int);
+    size_t entry_len = 2 * key_len + sizeof(Rid);
+    ParallelSorter sorter(key_len, entry_len, entry_len * 1000);
+    std::multimap<int, Rid> mock;
+    std::default_random_engine rng(2024);
+    std::uniform_int_distribution<int> dist(0, scale * 2);
+    for (int i = 0; i < scale; i++) {
+        int key = dist(rng);
+        Rid rid = {.page_no = i, .slot_no = key};
+        char *entry = sorter.add();
+        ix_normalize_key((const char *)&key, entry, ih_->file_hdr_->col_types_, ih_->file_hdr_->col_lens_);
+        memcpy(entry + key_len, &key, key_len);
+        memcpy(entry + 2 * key_len, &rid, sizeof(Rid));
+        if (mock.count(key) == 0) {
+            mock.insert(std::make_pair(key, rid));
+        }
+    }
+    sorter.finish();
+    ASSERT_GT(sorter.num_runs(), 1);
+    ih_->bulk_load(
+        [&](const char **key, Rid *rid) {
+            const char *entry = sorter.next();
+            if (entry == nullptr) return false;
+            *key = entry + key_len;
+            memcpy(rid, entry + 2 * key_len, sizeof(Rid));
+            return true;
+        },
+        fill_factor, txn_.get());
+    check_all(ih_.get(), mock);
+
+    int cap = static_cast<int>(order * fill_factor);
+    std::function<void(int)> check_size = [&](int page_no) {
+        IxNodeHandle *node = ih_->fetch_node(page_no);
+        if (!node->is_root_page()) {
+            ASSERT_GE(node->get_size(), node->get_min_size());
+        }
+        if (node->is_leaf_page()) {
+            ASSERT_LE(node->get_size(), node->get_next_leaf() == IX_LEAF_HEADER_PAGE ? order : cap);
+        } else {
+            ASSERT_LE(node->get_size(), order);
+            for (int i = 0; i < node->get_size(); i++) {
+                check_size(node->value_at(i));
+            }
+        }
+        buffer_pool_manager_->unpin_page(node->get_page_id(), false);
+        delete node;
+    };
+    check_size(ih_->file_hdr_->root_page_);
+
+    // 叶子结点按填充率写满，只有最后两个叶子可能少于cap
+    int num_leaves = 0;
+    for (int page_no = ih_->file_hdr_->first_leaf_; page_no != IX_LEAF_HEADER_PAGE;) {
+        IxNodeHandle *leaf = ih_->fetch_node(page_no);
+        num_leaves++;
+        page_no = leaf->get_next_leaf();
+        buffer_pool_manager_->unpin_page(leaf->get_page_id(), false);
+        delete leaf;
+    }
+    ASSERT_LE(num_leaves, static_cast<int>(mock.size()) / cap + 2);
+
+    // 构建后的树仍支持逐条插入和删除
+    for (int key = 1; key < scale * 2; key += 7) {
+        if (mock.count(key) != 0) {
+            ASSERT_TRUE(ih_->delete_entry((const char *)&key, txn_.get()));
+            mock.erase(key);
+        } else {
+            Rid rid = {.page_no = key, .slot_no = key};
+            ih_->insert_entry((const char *)&key, rid, txn_.get());
+            mock.insert(std::make_pair(key, rid));
+        }
+    }
+    check_all(ih_.get(), mock);
+}
+
+/**
+ * @brief 非唯一索引保存key相同的所有键值对，查找、范围扫描和按(key, rid)删除都覆盖重复的key
+ */
+TEST_F(BPlusTreeTests, NonUniqueIndexTest) {
+    std::vector<ColMeta> cols = {{.tab_name = "table3", .name = "status", .type = TYPE_INT, .len = 4, .offset = 0}};
+    ix_manager_->create_index("table3", cols, IX_KEY_RAW, false);
+    auto ih = ix_manager_->open_index("table3", cols);
+    ASSERT_FALSE(ih->is_unique());
+    ASSERT_EQ(ih->file_hdr_->key_format_, IX_KEY_NORMALIZED);
+    ih->file_hdr_->btree_order_ = 16;
+
+    // 只有少量不同的key，每个key对应大量的rid
+    const int num_keys = 7;
+    const int scale = 3000;
+    std::default_random_engine rng(25);
+    std::map<int, std::set<std::pair<int, int>>> mock;
+    for (int i = 0; i < scale; i++) {
+        int key = static_cast<int>(rng() % num_keys) - 3;
+        Rid rid = {.page_no = static_cast<int>(rng() % 100), .slot_no = i};
+        ih->insert_entry((const char *)&key, rid, txn_.get());
+        mock[key].insert({rid.page_no, rid.slot_no});
+    }
+
+    // 每个key的所有rid按rid升序返回，lower_bound和upper_bound之间恰好是这些键值对
+    auto check = [&]() {
+        for (int key = -4; key <= num_keys - 3; key++) {
+            std::vector<Rid> result;
+            bool found = ih->get_value((const char *)&key, &result, txn_.get());
+            auto &expect = mock[key];
+            ASSERT_EQ(found, !expect.empty());
+            ASSERT_EQ(result.size(), expect.size());
+            auto it = expect.begin();
+            for (IxScan scan(ih.get(), ih->lower_bound((const char *)&key), ih->upper_bound((const char *)&key),
+                             buffer_pool_manager_.get());
+                 !scan.is_end(); scan.next(), it++) {
+                ASSERT_EQ(scan.rid(), (Rid{.page_no = it->first, .slot_no = it->second}));
+                // 叶子结点中的key还原为调用者格式，不含追加的rid
+                int stored;
+                scan.key((char *)&stored);
+                ASSERT_EQ(stored, key);
+            }
+            ASSERT_EQ(it, expect.end());
+        }
+        // 一次批量查找所有key（包括重复的key），同一个key的键值对跨越多个叶子
+        std::vector<int> batch;
+        for (int key = -4; key <= num_keys - 3; key++) {
+            batch.push_back(key);
+            batch.push_back(key);
+        }
+        std::vector<std::vector<Rid>> results;
+        ih->get_values((const char *)batch.data(), batch.size(), &results, txn_.get());
+        for (size_t i = 0; i < batch.size(); i++) {
+            std::vector<Rid> expect;
+            ih->get_value((const char *)&batch[i], &expect, txn_.get());
+            ASSERT_EQ(results[i], expect);
+        }
+    };
+    check();
+
+    // 删除只移除rid相同的键值对
+    for (int i = 0; i < scale; i += 3) {
+        int key = static_cast<int>(i % num_keys) - 3;
+        if (mock[key].empty()) continue;
+        auto victim = *mock[key].begin();
+        Rid rid = {.page_no = victim.first, .slot_no = victim.second};
+        Rid other = {.page_no = -1, .slot_no = -1};
+        ASSERT_FALSE(ih->delete_entry((const char *)&key, other, txn_.get()));
+        ASSERT_TRUE(ih->delete_entry((const char *)&key, rid, txn_.get()));
+        mock[key].erase(victim);
+    }
+    check();
+    ix_manager_->close_index(ih.get());
+}
+
+/**
+ * @brief 字符串key的公共前缀只在叶子结点中存放一次，叶子结点能放下多于btree_order_个键值对；
+ * 插入不共享公共前缀的key、拆分、合并和重分配之后，查找、顺序扫描以及父结点中的key都保持正确
+ */
+TEST_F(BPlusTreeTests, PrefixCompressionTest) {
+    const int key_len = 32;
+    std::vector<ColMeta> cols = {{.tab_name = "table4", .name = "name", .type = TYPE_STRING, .len = key_len, .offset = 0}};
+    ix_manager_->create_index("table4", cols);
+    auto ih = ix_manager_->open_index("table4", cols);
+    ASSERT_TRUE(ih->file_hdr_->prefix_compress_);
+    int order = ih->file_hdr_->btree_order_;
+
+    // 大部分key共享很长的前缀，少量key的开头不同，插入时会缩短叶子结点的公共前缀
+    const int scale = 20000;
+    std::vector<std::string> keys;
+    for (int i = 0; i < scale; i++) {
+        char buf[key_len + 1] = {};
+        if (i % 500 == 0) {
+            snprintf(buf, sizeof(buf), "%c%d", 'a' + i / 500 % 26, i);
+        } else {
+            snprintf(buf, sizeof(buf), "customer_account_%08d", i * 7);
+        }
+        keys.emplace_back(buf, key_len);
+    }
+    std::default_random_engine rng(26);
+    std::shuffle(keys.begin(), keys.end(), rng);
+    std::map<std::string, Rid> mock;
+    for (int i = 0; i < scale; i++) {
+        Rid rid = {.page_no = i, .slot_no = i % 100};
+        ih->insert_entry(keys[i].data(), rid, txn_.get());
+        mock[keys[i]] = rid;
+    }
+
+    std::function<void(int)> check_node = [&](int page_no) {
+        IxNodeHandle *node = ih->fetch_node(page_no);
+        if (!node->is_root_page()) {
+            ASSERT_GE(node->get_size(), node->get_min_size());
+        }
+        ASSERT_LT(node->get_size(), node->get_max_size());
+        if (!node->is_leaf_page()) {
+            for (int i = 0; i < node->get_size(); i++) {
+                IxNodeHandle *child = ih->fetch_node(node->value_at(i));
+                char buf[key_len];
+                ASSERT_EQ(memcmp(node->get_key(i), child->full_key(0, buf), key_len), 0);
+                ASSERT_EQ(child->get_parent_page_no(), node->get_page_no());
+                buffer_pool_manager_->unpin_page(child->get_page_id(), false);
+                delete child;
+                check_node(node->value_at(i));
+            }
+        }
+        buffer_pool_manager_->unpin_page(node->get_page_id(), false);
+        delete node;
+    };
+    auto check = [&]() {
+        check_node(ih->file_hdr_->root_page_);
+        auto it = mock.begin();
+        for (IxScan scan(ih.get(), ih->leaf_begin(), ih->leaf_end(), buffer_pool_manager_.get()); !scan.is_end();
+             scan.next(), it++) {
+            ASSERT_NE(it, mock.end());
+            ASSERT_EQ(scan.rid(), it->second);
+        }
+        ASSERT_EQ(it, mock.end());
+        for (auto &[key, rid] : mock) {
+            std::vector<Rid> result;
+            ASSERT_TRUE(ih->get_value(key.data(), &result, txn_.get()));
+            ASSERT_EQ(result[0], rid);
+        }
+    };
+    check();
+
+    // 不压缩时每个叶子最多btree_order_个键值对
+    int num_leaves = 0;
+    for (int page_no = ih->file_hdr_->first_leaf_; page_no != IX_LEAF_HEADER_PAGE;) {
+        IxNodeHandle *leaf = ih->fetch_node(page_no);
+        num_leaves++;
+        page_no = leaf->get_next_leaf();
+        buffer_pool_manager_->unpin_page(leaf->get_page_id(), false);
+        delete leaf;
+    }
+    ASSERT_LT(num_leaves, scale / order);
+
+    // 删除大部分key后重新插入一部分
+    for (int i = 0; i < scale; i++) {
+        if (i % 3 == 0) continue;
+        ASSERT_TRUE(ih->delete_entry(keys[i].data(), txn_.get()));
+        mock.erase(keys[i]);
+    }
+    check();
+    for (int i = 1; i < scale; i += 6) {
+        Rid rid = {.page_no = i, .slot_no = 0};
+        ih->insert_entry(keys[i].data(), rid, txn_.get());
+        mock[keys[i]] = rid;
+    }
+    check();
+    ix_manager_->close_index(ih.get());
+}
+
+/**
+ * @brief 上层内部结点常驻缓冲池后，每次查找少获取resident_levels_个页面；删除使常驻结点被合并释放后，
+ * 查找仍然正确，关闭常驻后缓冲池中不残留pin
+ */
+TEST_F(BPlusTreeTests, ResidentUpperLevelsTest) {
+    const int scale = 10000;
+    ih_->file_hdr_->btree_order_ = 16;
+    ih_->resident_cap_ = 1024;
+    std::multimap<int, Rid> mock;
+    for (int key = 0; key < scale; key++) {
+        Rid rid = {.page_no = key, .slot_no = 0};
+        ih_->insert_entry((const char *)&key, rid, txn_.get());
+        mock.insert({key, rid});
+    }
+    auto fetches = [&]() {
+        auto stats = buffer_pool_manager_->get_stats();
+        return stats.get(BufferPoolStats::HITS) + stats.get(BufferPoolStats::MISSES);
+    };
+    auto lookup_all = [&]() {
+        uint64_t start = fetches();
+        for (int key = 0; key < scale; key += 7) {
+            std::vector<Rid> rids;
+            EXPECT_TRUE(ih_->get_value((const char *)&key, &rids, txn_.get()));
+            EXPECT_EQ(rids, (std::vector<Rid>{Rid{.page_no = key, .slot_no = 0}}));
+        }
+        return fetches() - start;
+    };
+
+    // 树至少有三层，根结点和第二层全部常驻
+    lookup_all();
+    ASSERT_GT(ih_->num_resident_pages(), 1);
+    uint64_t resident_fetches = lookup_all();
+    ih_->set_resident_levels(0);
+    ASSERT_EQ(ih_->num_resident_pages(), 0);
+    uint64_t plain_fetches = lookup_all();
+    EXPECT_EQ(plain_fetches - resident_fetches, 2 * ((scale + 6) / 7));
+
+    // 删除大部分key，常驻的内部结点在合并中被释放
+    ih_->set_resident_levels(2);
+    lookup_all();
+    for (int key = 0; key < scale; key++) {
+        if (key % 7 == 0) continue;
+        ASSERT_TRUE(ih_->delete_entry((const char *)&key, txn_.get()));
+        mock.erase(key);
+    }
+    lookup_all();
+    check_all(ih_.get(), mock);
+
+    ih_->release_resident_pages();
+    for (size_t i = 0; i < buffer_pool_manager_->get_pool_size(); i++) {
+        ASSERT_EQ(buffer_pool_manager_->pages_[i].pin_count_, 0);
+    }
+}
+
+/**
+ * @brief 批量维护：一批乱序的键值对经sort_entries排序后，delete_entries和insert_entries在同一个叶子内连续修改，
+ * 跨叶子、拆分和合并时退回逐条处理，结果与逐条删除、插入相同
+ */
+TEST_F(BPlusTreeTests, BatchMaintenanceTest) {
+    const int scale = 20000;
+    const int batch = 1500;
+    ih_->file_hdr_->btree_order_ = 16;
+    std::multimap<int, Rid> mock;
+    for (int key = 0; key < scale; key += 2) {
+        Rid rid = {.page_no = key, .slot_no = 0};
+        ih_->insert_entry((const char *)&key, rid, txn_.get());
+        mock.insert({key, rid});
+    }
+
+    std::default_random_engine rng(42);
+    for (int round = 0; round < 8; round++) {
+        // 删除一批已存在的key，其中夹杂不存在的key
+        std::vector<int> keys;
+        std::vector<Rid> rids;
+        std::set<int> picked;
+        for (int i = 0; i < batch; i++) {
+            int key = static_cast<int>(rng() % scale);
+            if (!picked.insert(key).second) continue;
+            auto it = mock.find(key);
+            keys.push_back(key);
+            rids.push_back(it == mock.end() ? Rid{.page_no = key, .slot_no = 0} : it->second);
+        }
+        ih_->sort_entries((char *)keys.data(), rids.data(), keys.size());
+        ASSERT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+        int expect_erased = 0;
+        for (int key : keys) expect_erased += mock.erase(key);
+        ASSERT_EQ(ih_->delete_entries((const char *)keys.data(), rids.data(), keys.size(), txn_.get()),
+                  expect_erased);
+        check_all(ih_.get(), mock);
+
+        // 插入一批不存在的key
+        keys.clear();
+        rids.clear();
+        for (int i = 0; i < batch; i++) {
+            int key = static_cast<int>(rng() % scale);
+            if (mock.count(key)) continue;
+            Rid rid = {.page_no = key, .slot_no = round};
+            keys.push_back(key);
+            rids.push_back(rid);
+            mock.insert({key, rid});
+        }
+        ih_->sort_entries((char *)keys.data(), rids.data(), keys.size());
+        ih_->insert_entries((const char *)keys.data(), rids.data(), keys.size(), txn_.get());
+        check_all(ih_.get(), mock);
+    }
+}
+
+/**
+ * @brief 删除全部键值对之后树中只剩空的根叶子结点，重新插入的键值对都能查到
+ */
+TEST_F(BPlusTreeTests, DeleteAllAndReinsertTest) {
+    const int scale = 2000;
+    ih_->file_hdr_->btree_order_ = 8;
+    std::multimap<int, Rid> mock;
+    for (int round = 0; round < 2; round++) {
+        for (int key = 0; key < scale; key++) {
+            Rid rid = {.page_no = key, .slot_no = round};
+            ih_->insert_entry((const char *)&key, rid, txn_.get());
+            mock.insert({key, rid});
+        }
+        check_all(ih_.get(), mock);
+        IxTreeStats stats = ih_->get_tree_stats();
+        ASSERT_GT(stats.height, 1);
+        ASSERT_EQ(stats.num_entries, static_cast<size_t>(scale));
+
+        for (int key = 0; key < scale; key++) {
+            ASSERT_TRUE(ih_->delete_entry((const char *)&key, mock.find(key)->second, txn_.get()));
+        }
+        mock.clear();
+        check_all(ih_.get(), mock);
+        stats = ih_->get_tree_stats();
+        ASSERT_EQ(stats.height, 1);
+        ASSERT_EQ(stats.num_leaves, 1u);
+        ASSERT_EQ(stats.num_entries, 0u);
+        ASSERT_EQ(ih_->leaf_begin(), ih_->leaf_end());
+    }
+}
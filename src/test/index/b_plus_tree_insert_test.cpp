@@ -53,10 +53,8 @@ class BPlusTreeTests : public ::testing::Test {
         }
         sm_->create_db(TEST_DB_NAME);
         assert(disk_manager_->is_dir(TEST_DB_NAME));
-        // 进入测试目录
-        if (chdir(TEST_DB_NAME.c_str()) < 0) {
-            throw UnixError();
-        }
+        // 进入测试目录，create_table和create_index需要打开db.catalog
+        sm_->open_db(TEST_DB_NAME);
         // 如果测试文件存在，则先删除原文件（最后留下来的文件存的是最后一个测试点的数据）
         if (ix_manager_->exists(TEST_FILE_NAME, TEST_COL)) {
             ix_manager_->destroy_index(TEST_FILE_NAME, TEST_COL);
@@ -66,6 +64,11 @@ class BPlusTreeTests : public ::testing::Test {
         coldef.push_back({"col2", TYPE_INT, 4});
         sm_->create_table(TEST_FILE_NAME, coldef, nullptr);
         sm_->create_index(TEST_FILE_NAME, TEST_COL, nullptr);
+        // 关闭SmManager打开的表和索引文件，之后只通过ih_访问索引
+        sm_->close_db();
+        if (chdir(TEST_DB_NAME.c_str()) < 0) {
+            throw UnixError();
+        }
         assert(ix_manager_->exists(TEST_FILE_NAME, TEST_COL));
         // 打开测试文件
         ih_ = ix_manager_->open_index(TEST_FILE_NAME, TEST_COL);
@@ -412,4 +415,235 @@ TEST_F(BPlusTreeTests, LargeScaleTest) {
         scan.next();
     }
     EXPECT_EQ(current_key, keys.size() + 1);
-}
\ No newline at end of file
+}
+/**
+ * @brief 批量查找与逐个get_value结果相同，有序的一批key复用路径上的结点，获取的页面远少于逐个查找；
+ * 乱序和重复的key也能正确查找
+ */
+TEST_F(BPlusTreeTests, BatchProbeTest) {
+    const int scale = 10000;
+    ih_->file_hdr_->btree_order_ = 16;
+    for (int key = 0; key < scale; key += 2) {
+        ASSERT_NE(ih_->insert_entry((const char *)&key, Rid{.page_no = key, .slot_no = 1}, txn_.get()), INVALID_PAGE_ID);
+    }
+
+    auto probe_all = [&](const std::vector<int> &keys) {
+        std::vector<std::vector<Rid>> results;
+        int found = ih_->get_values((const char *)keys.data(), keys.size(), &results, txn_.get());
+        ASSERT_EQ(results.size(), keys.size());
+        int expect_found = 0;
+        for (size_t i = 0; i < keys.size(); i++) {
+            std::vector<Rid> expect;
+            expect_found += ih_->get_value((const char *)&keys[i], &expect, txn_.get());
+            ASSERT_EQ(results[i], expect) << "key " << keys[i];
+        }
+        ASSERT_EQ(found, expect_found);
+    };
+
+    // 有序的一批key，一半不存在
+    std::vector<int> sorted;
+    for (int key = -5; key < scale + 5; key++) sorted.push_back(key);
+    probe_all(sorted);
+    // 重复和乱序的key
+    std::vector<int> mixed = {7, 8, 8, 8, 3000, 2, 9998, 9998, 0, -1, 4000, 4001, 4002};
+    probe_all(mixed);
+    probe_all({});
+
+    auto fetches = [&]() {
+        auto stats = buffer_pool_manager_->get_stats();
+        return stats.get(BufferPoolStats::HITS) + stats.get(BufferPoolStats::MISSES);
+    };
+    std::vector<std::vector<Rid>> results;
+    uint64_t start = fetches();
+    ih_->get_values((const char *)sorted.data(), sorted.size(), &results, txn_.get());
+    uint64_t batch_fetches = fetches() - start;
+    start = fetches();
+    for (int key : sorted) {
+        std::vector<Rid> rids;
+        ih_->get_value((const char *)&key, &rids, txn_.get());
+    }
+    uint64_t single_fetches = fetches() - start;
+    EXPECT_LT(batch_fetches * 4, single_fetches);
+}
+
+/**
+ * @brief 交错查找与逐个get_value结果相同：乱序、重复和不存在的key，缓冲池放不下整棵树时孩子结点需要异步读入
+ */
+TEST_F(BPlusTreeTests, InterleavedProbeTest) {
+    const int scale = 10000;
+    ih_->file_hdr_->btree_order_ = 16;
+    for (int key = 0; key < scale; key += 2) {
+        ASSERT_NE(ih_->insert_entry((const char *)&key, Rid{.page_no = key, .slot_no = 1}, txn_.get()), INVALID_PAGE_ID);
+    }
+
+    auto probe_all = [&](const std::vector<int> &keys) {
+        std::vector<std::vector<Rid>> results;
+        int found = ih_->probe_values((const char *)keys.data(), keys.size(), &results, txn_.get());
+        ASSERT_EQ(results.size(), keys.size());
+        int expect_found = 0;
+        for (size_t i = 0; i < keys.size(); i++) {
+            std::vector<Rid> expect;
+            expect_found += ih_->get_value((const char *)&keys[i], &expect, txn_.get());
+            ASSERT_EQ(results[i], expect) << "key " << keys[i];
+        }
+        ASSERT_EQ(found, expect_found);
+    };
+
+    std::vector<int> shuffled;
+    for (int key = -5; key < scale + 5; key++) shuffled.push_back(key);
+    std::shuffle(shuffled.begin(), shuffled.end(), std::default_random_engine(11));
+    probe_all(shuffled);
+    probe_all({7, 8, 8, 8, 3000, 2, 9998, 9998, 0, -1});
+    probe_all({4000});
+    probe_all({});
+}
+
+/**
+ * @brief 各种键布局（int、float、定长字符串、多列组合）下，结点内的二分查找与顺序查找结果一致
+ */
+TEST(BPlusTreeNodeSearchTest, SpecializedSearchTest) {
+    std::vector<std::vector<std::pair<ColType, int>>> layouts = {
+        {{TYPE_INT, 4}}, {{TYPE_FLOAT, 4}}, {{TYPE_STRING, 8}}, {{TYPE_INT, 4}, {TYPE_STRING, 4}}};
+    std::default_random_engine rng(7);
+    for (auto &layout : layouts) {
+        IxFileHdr file_hdr;
+        file_hdr.col_num_ = static_cast<int>(layout.size());
+        file_hdr.col_tot_len_ = 0;
+        for (auto &[type, len] : layout) {
+            file_hdr.col_types_.push_back(type);
+            file_hdr.col_lens_.push_back(len);
+            file_hdr.col_tot_len_ += len;
+        }
+        const int num_keys = 200;
+        file_hdr.btree_order_ = num_keys;
+        file_hdr.keys_size_ = (num_keys + 1) * file_hdr.col_tot_len_;
+
+        // 生成一个key：每一列取[0,50)中的随机值，字符串列用两位数字补齐
+        auto make_key = [&](char *key) {
+            int offset = 0;
+            for (auto &[type, len] : layout) {
+                int v = static_cast<int>(rng() % 50);
+                if (type == TYPE_INT) {
+                    memcpy(key + offset, &v, sizeof(int));
+                } else if (type == TYPE_FLOAT) {
+                    float f = v - 25.5f;
+                    memcpy(key + offset, &f, sizeof(float));
+                } else {
+                    memset(key + offset, 0, len);
+                    snprintf(key + offset, len, "%02d", v);
+                }
+                offset += len;
+            }
+        };
+        auto cmp = [&](const char *a, const char *b) {
+            return ix_compare(a, b, file_hdr.col_types_, file_hdr.col_lens_);
+        };
+
+        // 构造一个有序的叶子结点
+        int key_len = file_hdr.col_tot_len_;
+        std::vector<std::vector<char>> sorted(num_keys, std::vector<char>(key_len));
+        for (auto &key : sorted) make_key(key.data());
+        std::sort(sorted.begin(), sorted.end(),
+                  [&](const std::vector<char> &a, const std::vector<char> &b) { return cmp(a.data(), b.data()) < 0; });
+        std::vector<char> buf(PAGE_SIZE, 0);
+        Page page;
+        page.data_ = buf.data();
+        IxNodeHandle node(&file_hdr, &page);
+        node.page_hdr->is_leaf = true;
+        for (int i = 0; i < num_keys; i++) {
+            node.set_key(i, sorted[i].data());
+        }
+        node.set_size(num_keys);
+
+        std::vector<char> target(key_len);
+        for (int round = 0; round < 500; round++) {
+            make_key(target.data());
+            int lower = 0, upper = 0;
+            while (lower < num_keys && cmp(node.get_key(lower), target.data()) < 0) lower++;
+            while (upper < num_keys && cmp(node.get_key(upper), target.data()) <= 0) upper++;
+            ASSERT_EQ(node.lower_bound(target.data()), lower);
+            ASSERT_EQ(node.upper_bound(target.data()), upper);
+        }
+        page.data_ = nullptr;
+    }
+}
+
+/**
+ * @brief 保序编码的key在B+树中的顺序与逐列比较的顺序一致，包括负数和浮点数
+ */
+TEST_F(BPlusTreeTests, NormalizedKeyTest) {
+    std::vector<ColMeta> cols = {{.tab_name = "table2", .name = "a", .type = TYPE_INT, .len = 4, .offset = 0},
+                                 {.tab_name = "table2", .name = "b", .type = TYPE_FLOAT, .len = 4, .offset = 4}};
+    ix_manager_->create_index("table2", cols, IX_KEY_NORMALIZED);
+    auto ih = ix_manager_->open_index("table2", cols);
+    ASSERT_EQ(ih->file_hdr_->key_format_, IX_KEY_NORMALIZED);
+    ih->file_hdr_->btree_order_ = 16;
+
+    // 第一列只取少量不同的值，使得第二列参与比较
+    std::default_random_engine rng(11);
+    std::vector<std::vector<char>> keys;
+    for (int i = 0; i < 2000; i++) {
+        std::vector<char> key(8);
+        int a = static_cast<int>(rng() % 21) - 10;
+        float b = (static_cast<int>(rng() % 20001) - 10000) / 7.0f;
+        if (i % 100 == 0) b = (i % 200 == 0) ? -0.0f : 0.0f;
+        memcpy(key.data(), &a, sizeof(int));
+        memcpy(key.data() + 4, &b, sizeof(float));
+        keys.push_back(key);
+    }
+    auto cmp = [&](const std::vector<char> &x, const std::vector<char> &y) {
+        return ix_compare(x.data(), y.data(), ih->file_hdr_->col_types_, ih->file_hdr_->col_lens_) < 0;
+    };
+    // 编码后memcmp的结果与ix_compare一致
+    for (size_t i = 0; i + 1 < keys.size(); i++) {
+        char x[8], y[8];
+        ix_normalize_key(keys[i].data(), x, ih->file_hdr_->col_types_, ih->file_hdr_->col_lens_);
+        ix_normalize_key(keys[i + 1].data(), y, ih->file_hdr_->col_types_, ih->file_hdr_->col_lens_);
+        int expect = ix_compare(keys[i].data(), keys[i + 1].data(), ih->file_hdr_->col_types_, ih->file_hdr_->col_lens_);
+        int res = memcmp(x, y, 8);
+        ASSERT_EQ((res > 0) - (res < 0), expect);
+        // 解码后还原为原始格式，-0.0还原为0.0
+        char raw[8];
+        ix_denormalize_key(x, raw, ih->file_hdr_->col_types_, ih->file_hdr_->col_lens_);
+        float b;
+        memcpy(&b, keys[i].data() + 4, sizeof(float));
+        if (b == 0.0f) b = 0.0f;
+        ASSERT_EQ(memcmp(raw, keys[i].data(), 4), 0);
+        ASSERT_EQ(memcmp(raw + 4, &b, sizeof(float)), 0);
+    }
+
+    std::vector<std::vector<char>> uniq;
+    for (size_t i = 0; i < keys.size(); i++) {
+        Rid rid = {.page_no = 0, .slot_no = static_cast<int>(i)};
+        ih->insert_entry(keys[i].data(), rid, txn_.get());
+        uniq.push_back(keys[i]);
+    }
+    std::stable_sort(uniq.begin(), uniq.end(), cmp);
+    uniq.erase(std::unique(uniq.begin(), uniq.end(),
+                           [&](const std::vector<char> &x, const std::vector<char> &y) { return !cmp(x, y) && !cmp(y, x); }),
+               uniq.end());
+
+    // 顺序扫描得到的key与按ix_compare排序的结果一致，并且都能查到
+    IxScan scan(ih.get(), ih->leaf_begin(), ih->leaf_end(), buffer_pool_manager_.get());
+    size_t pos = 0;
+    while (!scan.is_end()) {
+        ASSERT_LT(pos, uniq.size());
+        Rid rid = scan.rid();
+        ASSERT_FALSE(cmp(keys[rid.slot_no], uniq[pos]) || cmp(uniq[pos], keys[rid.slot_no]));
+        std::vector<Rid> result;
+        ASSERT_TRUE(ih->get_value(uniq[pos].data(), &result, txn_.get()));
+        ASSERT_EQ(result[0], rid);
+        pos++;
+        scan.next();
+    }
+    ASSERT_EQ(pos, uniq.size());
+
+    // lower_bound与upper_bound使用原始格式的key
+    const std::vector<char> &mid = uniq[uniq.size() / 2];
+    Iid lower = ih->lower_bound(mid.data());
+    Iid upper = ih->upper_bound(mid.data());
+    Rid lower_rid = ih->get_rid(lower);
+    ASSERT_FALSE(cmp(keys[lower_rid.slot_no], mid) || cmp(mid, keys[lower_rid.slot_no]));
+    ASSERT_NE(lower, upper);
+    ix_manager_->close_index(ih.get());
+}
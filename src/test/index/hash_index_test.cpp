@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <random>
+
+#include "gtest/gtest.h"
+
+#define private public
+#include "index/ix.h"
+#undef private
+
+#include "storage/buffer_pool_manager.h"
+#include "system/sm.h"
+#include "record/rm.h"
+
+const std::string TEST_DB_NAME = "HashIndexTest_db";
+const std::string TEST_FILE_NAME = "table1";
+
+class HashIndexTests : public ::testing::Test {
+   public:
+    std::unique_ptr<DiskManager> disk_manager_;
+    std::unique_ptr<BufferPoolManager> buffer_pool_manager_;
+    std::unique_ptr<IxManager> ix_manager_;
+    std::unique_ptr<RmManager> rm_;
+    std::unique_ptr<SmManager> sm_;
+    std::unique_ptr<Transaction> txn_;
+    std::vector<ColMeta> cols_;
+    std::unique_ptr<IxHashIndexHandle> hh_;
+
+    void SetUp() override {
+        ::testing::Test::SetUp();
+        disk_manager_ = std::make_unique<DiskManager>();
+        buffer_pool_manager_ = std::make_unique<BufferPoolManager>(200, disk_manager_.get());
+        ix_manager_ = std::make_unique<IxManager>(disk_manager_.get(), buffer_pool_manager_.get());
+        rm_ = std::make_unique<RmManager>(disk_manager_.get(), buffer_pool_manager_.get());
+        sm_ = std::make_unique<SmManager>(disk_manager_.get(), buffer_pool_manager_.get(), rm_.get(), ix_manager_.get());
+        txn_ = std::make_unique<Transaction>(0);
+        if (disk_manager_->is_dir(TEST_DB_NAME)) {
+            std::string cmd = "rm -rf " + TEST_DB_NAME;
+            if (system(cmd.c_str()) < 0) {
+                throw UnixError();
+            }
+        }
+        sm_->create_db(TEST_DB_NAME);
+        if (chdir(TEST_DB_NAME.c_str()) < 0) {
+            throw UnixError();
+        }
+    }
+
+    void TearDown() override {
+        if (hh_ != nullptr) {
+            ix_manager_->close_point_index(hh_.get());
+            hh_.reset();
+        }
+        if (chdir("..") < 0) {
+            throw UnixError();
+        }
+    }
+
+    void create(const std::vector<ColMeta> &cols) {
+        cols_ = cols;
+        ix_manager_->create_hash_index(TEST_FILE_NAME, cols_);
+        hh_ = ix_manager_->open_hash_index(TEST_FILE_NAME, cols_);
+    }
+
+    void reopen() {
+        ix_manager_->close_point_index(hh_.get());
+        hh_ = ix_manager_->open_hash_index(TEST_FILE_NAME, cols_);
+    }
+
+    std::vector<Rid> lookup(const char *key) {
+        std::vector<Rid> rids;
+        hh_->get_value(key, &rids, txn_.get());
+        std::sort(rids.begin(), rids.end(), [](const Rid &a, const Rid &b) {
+            return a.page_no != b.page_no ? a.page_no < b.page_no : a.slot_no < b.slot_no;
+        });
+        return rids;
+    }
+};
+
+/**
+ * @brief 大量插入使目录加倍和桶分裂，每个key带两个rid；删除一半后重新打开索引，目录从目录页中恢复
+ */
+TEST_F(HashIndexTests, InsertLookupDeleteReopen) {
+    create({ColMeta{.tab_name = TEST_FILE_NAME, .name = "col1", .type = TYPE_INT, .len = 4, .offset = 0}});
+    const int scale = 20000;
+    std::vector<int> keys(scale);
+    for (int i = 0; i < scale; i++) keys[i] = i * 7 - scale;
+    std::shuffle(keys.begin(), keys.end(), std::default_random_engine(11));
+    for (int k : keys) {
+        ASSERT_TRUE(hh_->insert_entry(reinterpret_cast<const char *>(&k), Rid{k, 1}, txn_.get()));
+        ASSERT_TRUE(hh_->insert_entry(reinterpret_cast<const char *>(&k), Rid{k, 2}, txn_.get()));
+    }
+    // 重复的(key, rid)不会再次插入
+    ASSERT_FALSE(hh_->insert_entry(reinterpret_cast<const char *>(&keys[0]), Rid{keys[0], 1}, txn_.get()));
+    int min_depth = 0;
+    while ((hh_->get_bucket_capacity() << min_depth) < 2 * scale) min_depth++;
+    EXPECT_GE(hh_->get_global_depth(), min_depth);
+
+    for (int k : keys) {
+        auto rids = lookup(reinterpret_cast<const char *>(&k));
+        ASSERT_EQ(rids, (std::vector<Rid>{Rid{k, 1}, Rid{k, 2}}));
+    }
+    int missing = scale * 7;
+    EXPECT_TRUE(lookup(reinterpret_cast<const char *>(&missing)).empty());
+
+    for (int i = 0; i < scale; i += 2) {
+        ASSERT_TRUE(hh_->delete_entry(reinterpret_cast<const char *>(&keys[i]), Rid{keys[i], 1}, txn_.get()));
+        ASSERT_FALSE(hh_->delete_entry(reinterpret_cast<const char *>(&keys[i]), Rid{keys[i], 1}, txn_.get()));
+    }
+    int depth = hh_->get_global_depth();
+    reopen();
+    EXPECT_EQ(hh_->get_global_depth(), depth);
+    for (int i = 0; i < scale; i++) {
+        int k = keys[i];
+        auto rids = lookup(reinterpret_cast<const char *>(&k));
+        if (i % 2 == 0) {
+            ASSERT_EQ(rids, (std::vector<Rid>{Rid{k, 2}}));
+        } else {
+            ASSERT_EQ(rids, (std::vector<Rid>{Rid{k, 1}, Rid{k, 2}}));
+        }
+    }
+}
+
+/**
+ * @brief 同一个key的键值对超过桶的容量时分裂无法分开它们，应链接溢出页而不是不断加倍目录；
+ * 删除后溢出页被释放，其它key仍然可以正常插入和查找
+ */
+TEST_F(HashIndexTests, OverflowChain) {
+    create({ColMeta{.tab_name = TEST_FILE_NAME, .name = "col1", .type = TYPE_STRING, .len = 16, .offset = 0}});
+    char hot[16] = "hot_key";
+    int cnt = hh_->get_bucket_capacity() * 3 + 5;
+    for (int i = 0; i < cnt; i++) {
+        ASSERT_TRUE(hh_->insert_entry(hot, Rid{1, i}, txn_.get()));
+    }
+    EXPECT_EQ(hh_->get_global_depth(), 0);
+    ASSERT_EQ(static_cast<int>(lookup(hot).size()), cnt);
+
+    // 其它key使桶分裂，热点key的溢出链整体移动到其中一个桶
+    char key[16];
+    for (int i = 0; i < 2000; i++) {
+        memset(key, 0, sizeof(key));
+        snprintf(key, sizeof(key), "key_%d", i);
+        ASSERT_TRUE(hh_->insert_entry(key, Rid{2, i}, txn_.get()));
+    }
+    EXPECT_GT(hh_->get_global_depth(), 0);
+    EXPECT_LE(hh_->get_global_depth(), IX_HASH_MAX_DEPTH);
+    ASSERT_EQ(static_cast<int>(lookup(hot).size()), cnt);
+
+    size_t free_pages = disk_manager_->get_num_free_pages(hh_->get_fd());
+    for (int i = 0; i < cnt; i++) {
+        ASSERT_TRUE(hh_->delete_entry(hot, Rid{1, i}, txn_.get()));
+    }
+    EXPECT_TRUE(lookup(hot).empty());
+    EXPECT_GT(disk_manager_->get_num_free_pages(hh_->get_fd()), free_pages);
+
+    reopen();
+    for (int i = 0; i < 2000; i++) {
+        memset(key, 0, sizeof(key));
+        snprintf(key, sizeof(key), "key_%d", i);
+        ASSERT_EQ(lookup(key), (std::vector<Rid>{Rid{2, i}}));
+    }
+}
+
+/**
+ * @brief 多列key按所有列的值判断相等
+ */
+TEST_F(HashIndexTests, MultiColumnKey) {
+    create({ColMeta{.tab_name = TEST_FILE_NAME, .name = "col1", .type = TYPE_INT, .len = 4, .offset = 0},
+            ColMeta{.tab_name = TEST_FILE_NAME, .name = "col2", .type = TYPE_FLOAT, .len = 4, .offset = 4}});
+    char key[8];
+    for (int i = 0; i < 3000; i++) {
+        int a = i % 100;
+        float b = static_cast<float>(i / 100) + 0.5f;
+        memcpy(key, &a, 4);
+        memcpy(key + 4, &b, 4);
+        ASSERT_TRUE(hh_->insert_entry(key, Rid{i, 0}, txn_.get()));
+    }
+    for (int i = 0; i < 3000; i++) {
+        int a = i % 100;
+        float b = static_cast<float>(i / 100) + 0.5f;
+        memcpy(key, &a, 4);
+        memcpy(key + 4, &b, 4);
+        ASSERT_EQ(lookup(key), (std::vector<Rid>{Rid{i, 0}}));
+    }
+}
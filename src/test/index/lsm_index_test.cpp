@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#define private public
+#include "index/ix.h"
+#undef private
+
+#include "storage/buffer_pool_manager.h"
+#include "system/sm.h"
+#include "record/rm.h"
+
+const std::string TEST_DB_NAME = "LsmIndexTest_db";
+const std::string TEST_FILE_NAME = "table1";
+
+class LsmIndexTests : public ::testing::Test {
+   public:
+    std::unique_ptr<DiskManager> disk_manager_;
+    std::unique_ptr<BufferPoolManager> buffer_pool_manager_;
+    std::unique_ptr<IxManager> ix_manager_;
+    std::unique_ptr<RmManager> rm_;
+    std::unique_ptr<SmManager> sm_;
+    std::unique_ptr<Transaction> txn_;
+    std::vector<ColMeta> cols_;
+    std::unique_ptr<IxLsmIndexHandle> lh_;
+
+    void SetUp() override {
+        ::testing::Test::SetUp();
+        disk_manager_ = std::make_unique<DiskManager>();
+        buffer_pool_manager_ = std::make_unique<BufferPoolManager>(200, disk_manager_.get());
+        ix_manager_ = std::make_unique<IxManager>(disk_manager_.get(), buffer_pool_manager_.get());
+        rm_ = std::make_unique<RmManager>(disk_manager_.get(), buffer_pool_manager_.get());
+        sm_ = std::make_unique<SmManager>(disk_manager_.get(), buffer_pool_manager_.get(), rm_.get(), ix_manager_.get());
+        txn_ = std::make_unique<Transaction>(0);
+        if (disk_manager_->is_dir(TEST_DB_NAME)) {
+            std::string cmd = "rm -rf " + TEST_DB_NAME;
+            if (system(cmd.c_str()) < 0) {
+                throw UnixError();
+            }
+        }
+        sm_->create_db(TEST_DB_NAME);
+        if (chdir(TEST_DB_NAME.c_str()) < 0) {
+            throw UnixError();
+        }
+    }
+
+    void TearDown() override {
+        if (lh_ != nullptr) {
+            ix_manager_->close_point_index(lh_.get());
+            lh_.reset();
+        }
+        if (chdir("..") < 0) {
+            throw UnixError();
+        }
+    }
+
+    void open() {
+        auto handle = ix_manager_->open_point_index(TEST_FILE_NAME, cols_, INDEX_LSM);
+        lh_.reset(static_cast<IxLsmIndexHandle *>(handle.release()));
+    }
+
+    void create(const std::vector<ColMeta> &cols) {
+        cols_ = cols;
+        ix_manager_->create_point_index(TEST_FILE_NAME, cols_, INDEX_LSM);
+        open();
+    }
+
+    void reopen() {
+        ix_manager_->close_point_index(lh_.get());
+        lh_.reset();
+        open();
+    }
+
+    std::vector<Rid> lookup(const char *key) {
+        std::vector<Rid> rids;
+        lh_->get_value(key, &rids, txn_.get());
+        std::sort(rids.begin(), rids.end(), [](const Rid &a, const Rid &b) {
+            return a.page_no != b.page_no ? a.page_no < b.page_no : a.slot_no < b.slot_no;
+        });
+        return rids;
+    }
+};
+
+/**
+ * @brief 插入的条目超过多个memtable，写成多个有序段并在后台合并，每个key带两个rid；
+ * 删除一半后重新打开索引，有序段从文件头中恢复，被合并的段的页面可以重新分配
+ */
+TEST_F(LsmIndexTests, InsertLookupDeleteReopen) {
+    create({ColMeta{.tab_name = TEST_FILE_NAME, .name = "col1", .type = TYPE_INT, .len = 4, .offset = 0}});
+    const int scale = 50000;
+    std::vector<int> keys(scale);
+    for (int i = 0; i < scale; i++) keys[i] = i * 7 - scale;
+    std::shuffle(keys.begin(), keys.end(), std::default_random_engine(11));
+    for (int k : keys) {
+        ASSERT_TRUE(lh_->insert_entry(reinterpret_cast<const char *>(&k), Rid{k, 1}, txn_.get()));
+        ASSERT_TRUE(lh_->insert_entry(reinterpret_cast<const char *>(&k), Rid{k, 2}, txn_.get()));
+    }
+    for (int k : keys) {
+        auto rids = lookup(reinterpret_cast<const char *>(&k));
+        ASSERT_EQ(rids, (std::vector<Rid>{Rid{k, 1}, Rid{k, 2}}));
+    }
+    int missing = scale * 7;
+    EXPECT_TRUE(lookup(reinterpret_cast<const char *>(&missing)).empty());
+
+    for (int i = 0; i < scale; i += 2) {
+        ASSERT_TRUE(lh_->delete_entry(reinterpret_cast<const char *>(&keys[i]), Rid{keys[i], 1}, txn_.get()));
+    }
+    reopen();
+    EXPECT_GT(lh_->get_num_runs(), 0);
+    EXPECT_LE(lh_->get_num_runs(), IX_LSM_MAX_RUNS);
+    EXPECT_GT(disk_manager_->get_num_free_pages(lh_->get_fd()), 0u);
+    for (int i = 0; i < scale; i++) {
+        int k = keys[i];
+        auto rids = lookup(reinterpret_cast<const char *>(&k));
+        if (i % 2 == 0) {
+            ASSERT_EQ(rids, (std::vector<Rid>{Rid{k, 2}}));
+        } else {
+            ASSERT_EQ(rids, (std::vector<Rid>{Rid{k, 1}, Rid{k, 2}}));
+        }
+    }
+}
+
+/**
+ * @brief 删除标记遮住较旧的有序段中的同一个(key, rid)，之后重新插入的条目又遮住删除标记；
+ * 合并所有段之后删除标记被丢弃，结果不变
+ */
+TEST_F(LsmIndexTests, TombstonesAcrossRuns) {
+    create({ColMeta{.tab_name = TEST_FILE_NAME, .name = "col1", .type = TYPE_STRING, .len = 16, .offset = 0}});
+    char key[16];
+    auto make_key = [&](int i) {
+        memset(key, 0, sizeof(key));
+        snprintf(key, sizeof(key), "key_%d", i);
+        return key;
+    };
+    for (int i = 0; i < 1000; i++) {
+        lh_->insert_entry(make_key(i), Rid{1, i}, txn_.get());
+    }
+    lh_->flush();
+    for (int i = 0; i < 1000; i += 2) {
+        lh_->delete_entry(make_key(i), Rid{1, i}, txn_.get());
+    }
+    lh_->flush();
+    for (int i = 0; i < 1000; i += 4) {
+        lh_->insert_entry(make_key(i), Rid{1, i}, txn_.get());
+    }
+    lh_->flush();
+    ASSERT_EQ(lh_->get_num_runs(), 3);
+    auto check = [&] {
+        for (int i = 0; i < 1000; i++) {
+            auto rids = lookup(make_key(i));
+            if (i % 2 == 0 && i % 4 != 0) {
+                ASSERT_TRUE(rids.empty()) << i;
+            } else {
+                ASSERT_EQ(rids, (std::vector<Rid>{Rid{1, i}})) << i;
+            }
+        }
+    };
+    check();
+
+    // 最新的段比其它段加起来还大，下一次合并包括全部的段
+    for (int i = 1000; i < 3000; i++) {
+        lh_->insert_entry(make_key(i), Rid{1, i}, txn_.get());
+    }
+    lh_->flush();
+    {
+        std::scoped_lock work_lock{lh_->work_latch_};
+        while (lh_->compact()) {
+        }
+    }
+    ASSERT_EQ(lh_->get_num_runs(), 1);
+    EXPECT_EQ(lh_->runs_[0]->num_entries, 3000 - 250);
+    for (int i = 1000; i < 3000; i++) {
+        ASSERT_EQ(lookup(make_key(i)), (std::vector<Rid>{Rid{1, i}}));
+    }
+    check();
+    reopen();
+    check();
+}
+
+/**
+ * @brief 多个线程并发插入，同时有线程查找已经插入的key，memtable的冻结、有序段的写出和合并与查找交错进行
+ */
+TEST_F(LsmIndexTests, ConcurrentInsertLookup) {
+    create({ColMeta{.tab_name = TEST_FILE_NAME, .name = "col1", .type = TYPE_INT, .len = 4, .offset = 0}});
+    const int num_threads = 4;
+    const int per_thread = 20000;
+    std::atomic<int> done{0};
+    std::atomic<bool> failed{false};
+    std::vector<std::atomic<int>> progress(num_threads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < per_thread; i++) {
+                int k = i * num_threads + t;
+                lh_->insert_entry(reinterpret_cast<const char *>(&k), Rid{k, t}, txn_.get());
+                progress[t].store(i + 1);
+            }
+            done++;
+        });
+    }
+    threads.emplace_back([&] {
+        std::default_random_engine rng(7);
+        while (done.load() < num_threads) {
+            int t = rng() % num_threads;
+            int n = progress[t].load();
+            if (n == 0) continue;
+            int k = static_cast<int>(rng() % n) * num_threads + t;
+            std::vector<Rid> rids;
+            lh_->get_value(reinterpret_cast<const char *>(&k), &rids, txn_.get());
+            if (rids != std::vector<Rid>{Rid{k, t}}) failed = true;
+        }
+    });
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    EXPECT_FALSE(failed.load());
+    for (int k = 0; k < num_threads * per_thread; k++) {
+        ASSERT_EQ(lookup(reinterpret_cast<const char *>(&k)), (std::vector<Rid>{Rid{k, k % num_threads}}));
+    }
+}
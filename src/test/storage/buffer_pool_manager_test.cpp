@@ -95,6 +95,8 @@ TEST_F(BufferPoolManagerTest, SimpleTest) {
     // Scenario: The buffer pool is empty. We should be able to create a new page.
     ASSERT_NE(nullptr, page0);
     EXPECT_EQ(0, tmp_page_id.page_no);
+    // 帧按PAGE_SIZE对齐，可直接用于O_DIRECT读写
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(page0->get_data()) % PAGE_SIZE);
 
     // Scenario: Once we have a page, we should be able to read and write content.
     snprintf(page0->get_data(), sizeof(page0->get_data()), "Hello");
@@ -427,3 +429,692 @@ TEST_F(BufferPoolManagerTest, ConcurrencyTest) {
 
     disk_manager_->close_file(fd);
 }
+
+
+/**
+ * @brief 分片缓冲池并发测试（单文件），多个线程同时新建、淘汰、读取页面
+ * @note 生成测试文件sharded_concurrency_test
+ */
+TEST_F(BufferPoolManagerTest, ShardedConcurrencyTest) {
+    const int num_threads = 8;
+    const int pages_per_thread = 200;
+    const size_t buffer_pool_size = 512;
+    const size_t num_shards = 8;
+
+    const std::string filename = "sharded_concurrency_test";
+    auto disk_manager = BufferPoolManagerTest::disk_manager_.get();
+    disk_manager_->create_file(filename);
+    int fd = disk_manager_->open_file(filename);
+
+    auto bpm = std::make_unique<BufferPoolManager>(buffer_pool_size, disk_manager, num_shards);
+    EXPECT_EQ(num_shards, bpm->get_num_shards());
+    // 缓冲池过小时分片数会被限制，保证单个分片不会过早被占满
+    EXPECT_EQ(1, BufferPoolManager(10, disk_manager, num_shards).get_num_shards());
+
+    std::vector<std::thread> threads;
+    for (int tid = 0; tid < num_threads; tid++) {
+        threads.push_back(std::thread([&bpm, fd]() {
+            std::vector<PageId> page_ids;
+            for (int i = 0; i < pages_per_thread; i++) {
+                PageId page_id = {.fd = fd, .page_no = INVALID_PAGE_ID};
+                auto *page = bpm->new_page(&page_id);
+                while (page == nullptr) {
+                    page = bpm->new_page(&page_id);
+                }
+                strcpy(page->get_data(), std::to_string(page_id.page_no).c_str());
+                EXPECT_EQ(true, bpm->unpin_page(page_id, true));
+                page_ids.push_back(page_id);
+            }
+            // 总页面数超过缓冲池大小，部分页面需要从磁盘重新读入
+            for (int round = 0; round < 3; round++) {
+                for (auto &page_id : page_ids) {
+                    auto *page = bpm->fetch_page(page_id);
+                    while (page == nullptr) {
+                        page = bpm->fetch_page(page_id);
+                    }
+                    EXPECT_EQ(0, std::strcmp(std::to_string(page_id.page_no).c_str(), page->get_data()));
+                    EXPECT_EQ(true, bpm->unpin_page(page_id, false));
+                }
+            }
+        }));
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    bpm->flush_all_pages(fd);
+    disk_manager_->close_file(fd);
+}
+
+/**
+ * @brief 使用不同替换策略的缓冲池在页面被反复淘汰后仍能读到正确的数据
+ * @note 生成测试文件replacer_type_test
+ */
+TEST_F(BufferPoolManagerTest, ReplacerTypeTest) {
+    const int scale = 500;
+    const size_t buffer_pool_size = 20;
+    auto disk_manager = BufferPoolManagerTest::disk_manager_.get();
+
+    for (const std::string replacer_type : {"LRU", "CLOCK", "LRU-K", "ARC"}) {
+        const std::string filename = "replacer_type_test_" + replacer_type;
+        disk_manager_->create_file(filename);
+        int fd = disk_manager_->open_file(filename);
+        auto bpm = std::make_unique<BufferPoolManager>(buffer_pool_size, disk_manager, 1, replacer_type);
+
+        std::vector<PageId> page_ids;
+        for (int i = 0; i < scale; i++) {
+            PageId page_id = {.fd = fd, .page_no = INVALID_PAGE_ID};
+            auto *page = bpm->new_page(&page_id);
+            ASSERT_NE(nullptr, page);
+            strcpy(page->get_data(), std::to_string(page_id.page_no).c_str());
+            EXPECT_EQ(true, bpm->unpin_page(page_id, true));
+            page_ids.push_back(page_id);
+        }
+        // 热点页面和顺序扫描交替访问
+        for (int i = 0; i < scale; i++) {
+            for (auto &page_id : {page_ids[i % 5], page_ids[i]}) {
+                auto *page = bpm->fetch_page(page_id);
+                ASSERT_NE(nullptr, page);
+                EXPECT_EQ(0, strcmp(std::to_string(page_id.page_no).c_str(), page->get_data()));
+                EXPECT_EQ(true, bpm->unpin_page(page_id, false));
+            }
+        }
+        bpm->flush_all_pages(fd);
+        disk_manager_->close_file(fd);
+    }
+}
+
+/**
+ * @brief 页面保护对象在析构时自动解除latch和固定，写保护会把页面标记为脏页
+ * @note 生成测试文件page_guard_test
+ */
+TEST_F(BufferPoolManagerTest, PageGuardTest) {
+    const std::string filename = "page_guard_test";
+    const size_t buffer_pool_size = 2;
+    auto disk_manager = BufferPoolManagerTest::disk_manager_.get();
+    disk_manager_->create_file(filename);
+    int fd = disk_manager_->open_file(filename);
+    auto bpm = std::make_unique<BufferPoolManager>(buffer_pool_size, disk_manager);
+
+    PageId page_id = {.fd = fd, .page_no = INVALID_PAGE_ID};
+    {
+        WritePageGuard guard = bpm->new_page_guarded(&page_id);
+        ASSERT_TRUE(static_cast<bool>(guard));
+        strcpy(guard.get_data(), "guarded");
+        // 被固定的页面无法删除
+        EXPECT_EQ(false, bpm->delete_page(page_id));
+    }
+
+    {
+        // 多个读保护可以同时持有同一个页面，移动后原对象失效
+        ReadPageGuard guard1 = bpm->fetch_page_read(page_id);
+        ReadPageGuard guard2 = bpm->fetch_page_read(page_id);
+        EXPECT_EQ(0, strcmp(guard1.get_data(), "guarded"));
+        ReadPageGuard moved = std::move(guard2);
+        EXPECT_FALSE(static_cast<bool>(guard2));
+        EXPECT_EQ(0, strcmp(moved.get_data(), "guarded"));
+        guard1.release();
+        EXPECT_FALSE(static_cast<bool>(guard1));
+    }
+
+    // 用其它页面把目标页挤出缓冲池，写保护设置的脏页标记保证数据被写回磁盘
+    for (int i = 0; i < 4; i++) {
+        PageId other_page_id = {.fd = fd, .page_no = INVALID_PAGE_ID};
+        WritePageGuard guard = bpm->new_page_guarded(&other_page_id);
+        ASSERT_TRUE(static_cast<bool>(guard));
+    }
+    {
+        ReadPageGuard guard = bpm->fetch_page_read(page_id);
+        ASSERT_TRUE(static_cast<bool>(guard));
+        EXPECT_EQ(0, strcmp(guard.get_data(), "guarded"));
+    }
+    EXPECT_EQ(true, bpm->delete_page(page_id));
+
+    bpm->flush_all_pages(fd);
+    disk_manager_->close_file(fd);
+}
+
+/**
+ * @brief 后台刷脏线程把未被固定的脏页提前写回，保持一定比例的帧是干净的
+ * @note 生成测试文件page_cleaner_test
+ */
+TEST_F(BufferPoolManagerTest, PageCleanerTest) {
+    const std::string filename = "page_cleaner_test";
+    const size_t buffer_pool_size = 100;
+    auto disk_manager = BufferPoolManagerTest::disk_manager_.get();
+    disk_manager_->create_file(filename);
+    int fd = disk_manager_->open_file(filename);
+    // 刷脏线程批量提交写回，内核不支持io_uring时退回同步读写
+    disk_manager_->set_io_backend("io_uring");
+    auto bpm = std::make_unique<BufferPoolManager>(buffer_pool_size, disk_manager, 1);
+
+    // 被固定的页面不会被写回
+    PageId pinned_page_id = {.fd = fd, .page_no = INVALID_PAGE_ID};
+    ASSERT_NE(nullptr, bpm->new_page(&pinned_page_id));
+    EXPECT_EQ(true, bpm->unpin_page(pinned_page_id, true));
+    ASSERT_NE(nullptr, bpm->fetch_page(pinned_page_id));
+
+    std::vector<PageId> page_ids;
+    for (size_t i = 1; i < buffer_pool_size; i++) {
+        PageId page_id = {.fd = fd, .page_no = INVALID_PAGE_ID};
+        auto *page = bpm->new_page(&page_id);
+        ASSERT_NE(nullptr, page);
+        strcpy(page->get_data(), std::to_string(page_id.page_no).c_str());
+        EXPECT_EQ(true, bpm->unpin_page(page_id, true));
+        page_ids.push_back(page_id);
+    }
+    EXPECT_EQ(buffer_pool_size, bpm->get_num_dirty_pages());
+
+    bpm->start_page_cleaner(50);
+    for (int i = 0; i < 100 && bpm->get_num_dirty_pages() > buffer_pool_size / 2; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    bpm->stop_page_cleaner();
+    EXPECT_EQ(buffer_pool_size / 2, bpm->get_num_dirty_pages());
+
+    // 刷脏按页面顺序进行，最靠前的未固定页面已经写回磁盘
+    char buf[PAGE_SIZE];
+    disk_manager_->read_page(fd, page_ids[0].page_no, buf, PAGE_SIZE);
+    EXPECT_EQ(0, strcmp(std::to_string(page_ids[0].page_no).c_str(), buf));
+
+    EXPECT_EQ(true, bpm->unpin_page(pinned_page_id, false));
+    bpm->flush_all_pages(fd);
+    EXPECT_EQ(0, bpm->get_num_dirty_pages());
+    disk_manager_->close_file(fd);
+}
+
+/**
+ * @brief 测试预读：预读的页面与同步读取的页面内容一致，预读之后的访问命中缓冲池，缓冲池中已有的页面不会被预读覆盖
+ * @note 生成测试文件prefetch_test
+ */
+TEST_F(BufferPoolManagerTest, PrefetchTest) {
+    const std::string filename = "prefetch_test";
+    const int num_pages = 64;
+    auto disk_manager = BufferPoolManagerTest::disk_manager_.get();
+    disk_manager_->create_file(filename);
+    int fd = disk_manager_->open_file(filename);
+    auto bpm = std::make_unique<BufferPoolManager>(num_pages * 2, disk_manager, 2);
+
+    // 写入num_pages个页面后全部移出缓冲池
+    for (int i = 0; i < num_pages; i++) {
+        PageId page_id = {.fd = fd, .page_no = INVALID_PAGE_ID};
+        auto *page = bpm->new_page(&page_id);
+        ASSERT_NE(nullptr, page);
+        ASSERT_EQ(i, page_id.page_no);
+        strcpy(page->get_data(), std::to_string(i).c_str());
+        EXPECT_EQ(true, bpm->unpin_page(page_id, true));
+    }
+    bpm->flush_all_pages(fd);
+    for (int i = 0; i < num_pages; i++) {
+        EXPECT_EQ(true, bpm->delete_page({fd, i}));
+    }
+
+    // 预读与同步读取同时进行
+    bpm->prefetch(fd, 0, num_pages);
+    for (int i = 0; i < num_pages; i++) {
+        auto *page = bpm->fetch_page({fd, i});
+        ASSERT_NE(nullptr, page);
+        EXPECT_EQ(0, strcmp(std::to_string(i).c_str(), page->get_data()));
+        EXPECT_EQ(true, bpm->unpin_page({fd, i}, false));
+    }
+    for (int i = 0; i < num_pages; i++) {
+        EXPECT_EQ(true, bpm->delete_page({fd, i}));
+    }
+
+    // 缓冲池中被修改的页面不会被预读覆盖
+    auto *dirty_page = bpm->fetch_page({fd, 0});
+    ASSERT_NE(nullptr, dirty_page);
+    strcpy(dirty_page->get_data(), "dirty");
+    EXPECT_EQ(true, bpm->unpin_page({fd, 0}, true));
+
+    // 预读完成后直接修改磁盘上的数据，之后的访问读到的是预读进缓冲池的内容
+    bpm->prefetch(fd, 0, num_pages);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    char buf[PAGE_SIZE] = "overwritten";
+    for (int i = 0; i < num_pages; i++) {
+        disk_manager_->write_page(fd, i, buf, PAGE_SIZE);
+    }
+    for (int i = 0; i < num_pages; i++) {
+        auto *page = bpm->fetch_page({fd, i});
+        ASSERT_NE(nullptr, page);
+        EXPECT_EQ(0, strcmp(i == 0 ? "dirty" : std::to_string(i).c_str(), page->get_data()));
+        EXPECT_EQ(true, bpm->unpin_page({fd, i}, false));
+    }
+
+    // 超出文件末尾的预读被忽略
+    bpm->prefetch(fd, num_pages, num_pages);
+    bpm->flush_all_pages(fd);
+    disk_manager_->close_file(fd);
+}
+
+/**
+ * @brief 测试顺序扫描的环形缓冲区：扫描读入的页面只在环中的帧之间替换，不会挤出缓冲池中已有的页面
+ * @note 生成测试文件scan_ring_test
+ */
+TEST_F(BufferPoolManagerTest, ScanRingTest) {
+    const std::string filename = "scan_ring_test";
+    const int buffer_pool_size = 128;
+    const int num_hot_pages = 64;
+    const int num_scan_pages = 512;
+    auto disk_manager = BufferPoolManagerTest::disk_manager_.get();
+    disk_manager_->create_file(filename);
+    int fd = disk_manager_->open_file(filename);
+    auto bpm = std::make_unique<BufferPoolManager>(buffer_pool_size, disk_manager, 1);
+
+    // 前num_hot_pages个页面作为热点页面留在缓冲池中，其余页面写回磁盘后移出缓冲池
+    for (int i = 0; i < num_hot_pages + num_scan_pages; i++) {
+        PageId page_id = {.fd = fd, .page_no = INVALID_PAGE_ID};
+        auto *page = bpm->new_page(&page_id);
+        ASSERT_NE(nullptr, page);
+        strcpy(page->get_data(), std::to_string(i).c_str());
+        EXPECT_EQ(true, bpm->unpin_page(page_id, true));
+        if (i >= num_hot_pages) {
+            EXPECT_EQ(true, bpm->flush_page(page_id));
+            EXPECT_EQ(true, bpm->delete_page(page_id));
+        }
+    }
+    bpm->flush_all_pages(fd);
+
+    // 通过环形缓冲区扫描所有冷页面
+    auto ring = bpm->create_scan_ring(8);
+    for (int i = num_hot_pages; i < num_hot_pages + num_scan_pages; i++) {
+        auto *page = bpm->fetch_page({fd, i}, ring.get());
+        ASSERT_NE(nullptr, page);
+        EXPECT_EQ(0, strcmp(std::to_string(i).c_str(), page->get_data()));
+        EXPECT_EQ(true, bpm->unpin_page({fd, i}, false));
+    }
+
+    // 修改磁盘上的热点页面，热点页面仍在缓冲池中，读到的是缓冲池中的内容
+    char buf[PAGE_SIZE] = "overwritten";
+    for (int i = 0; i < num_hot_pages; i++) {
+        disk_manager_->write_page(fd, i, buf, PAGE_SIZE);
+    }
+    for (int i = 0; i < num_hot_pages; i++) {
+        auto *page = bpm->fetch_page({fd, i});
+        ASSERT_NE(nullptr, page);
+        EXPECT_EQ(0, strcmp(std::to_string(i).c_str(), page->get_data()));
+        EXPECT_EQ(true, bpm->unpin_page({fd, i}, false));
+    }
+    disk_manager_->close_file(fd);
+}
+
+/**
+ * @brief 测试释放页面：未被固定的页面立即丢弃，被固定的页面在最后一次解除固定时丢弃，之后新页面复用其页号
+ * @note 生成测试文件deallocate_page_test
+ */
+TEST_F(BufferPoolManagerTest, DeallocatePageTest) {
+    const std::string filename = "deallocate_page_test";
+    auto disk_manager = BufferPoolManagerTest::disk_manager_.get();
+    disk_manager_->create_file(filename);
+    int fd = disk_manager_->open_file(filename);
+    auto bpm = std::make_unique<BufferPoolManager>(16, disk_manager, 1);
+
+    PageId page_ids[3];
+    for (auto &page_id : page_ids) {
+        page_id = {.fd = fd, .page_no = INVALID_PAGE_ID};
+        auto *page = bpm->new_page(&page_id);
+        ASSERT_NE(nullptr, page);
+        strcpy(page->get_data(), "old");
+    }
+    EXPECT_EQ(true, bpm->unpin_page(page_ids[0], true));
+
+    // 未被固定的页面立即被丢弃，不写回脏数据
+    bpm->deallocate_page(page_ids[0]);
+    EXPECT_EQ(1, disk_manager_->get_num_free_pages(fd));
+    EXPECT_EQ(0, bpm->get_num_dirty_pages());
+
+    // 被固定的页面在解除固定后才被释放，解除固定时标记的脏页不会留在脏页集合中
+    bpm->deallocate_page(page_ids[1]);
+    EXPECT_EQ(1, disk_manager_->get_num_free_pages(fd));
+    EXPECT_EQ(true, bpm->unpin_page(page_ids[1], true));
+    EXPECT_EQ(2, disk_manager_->get_num_free_pages(fd));
+    EXPECT_EQ(0, bpm->get_num_dirty_pages());
+
+    // 新页面复用释放的页号，内容被清空
+    for (int i = 0; i < 2; i++) {
+        PageId page_id = {.fd = fd, .page_no = INVALID_PAGE_ID};
+        auto *page = bpm->new_page(&page_id);
+        ASSERT_NE(nullptr, page);
+        EXPECT_EQ(page_ids[i].page_no, page_id.page_no);
+        EXPECT_EQ(0, page->get_data()[0]);
+        EXPECT_EQ(true, bpm->unpin_page(page_id, true));
+    }
+    EXPECT_EQ(0, disk_manager_->get_num_free_pages(fd));
+
+    EXPECT_EQ(true, bpm->unpin_page(page_ids[2], true));
+    bpm->flush_all_pages(fd);
+    disk_manager_->close_file(fd);
+}
+
+/**
+ * @brief 测试关闭文件前移出缓冲池：页面写回磁盘后离开页表，之后从磁盘重新读入；文件还有被固定的页面时抛出异常
+ * @note 生成测试文件evict_all_pages_test
+ */
+TEST_F(BufferPoolManagerTest, EvictAllPagesTest) {
+    const std::string filename = "evict_all_pages_test";
+    const int num_pages = 8;
+    auto disk_manager = BufferPoolManagerTest::disk_manager_.get();
+    disk_manager_->create_file(filename);
+    int fd = disk_manager_->open_file(filename);
+    auto bpm = std::make_unique<BufferPoolManager>(16, disk_manager, 1);
+
+    for (int i = 0; i < num_pages; i++) {
+        PageId page_id = {.fd = fd, .page_no = INVALID_PAGE_ID};
+        auto *page = bpm->new_page(&page_id);
+        ASSERT_NE(nullptr, page);
+        strcpy(page->get_data(), std::to_string(i).c_str());
+        EXPECT_EQ(true, bpm->unpin_page(page_id, true));
+    }
+    ASSERT_NE(nullptr, bpm->fetch_page({fd, 0}));
+    EXPECT_EQ(1, bpm->get_num_pins(fd));
+
+    // 被固定的页面不能移出，它会以将要被复用的fd留在页表中
+    EXPECT_THROW(bpm->evict_all_pages(fd), InternalError);
+    EXPECT_EQ(0, bpm->get_num_dirty_pages());
+    char buf[PAGE_SIZE];
+    for (int i = 0; i < num_pages; i++) {
+        disk_manager_->read_page(fd, i, buf, PAGE_SIZE);
+        EXPECT_EQ(0, strcmp(std::to_string(i).c_str(), buf));
+    }
+    EXPECT_EQ(true, bpm->unpin_page({fd, 0}, false));
+    EXPECT_EQ(0, bpm->get_num_pins(fd));
+    bpm->evict_all_pages(fd);
+    EXPECT_EQ(0, bpm->get_stats().resident_pages);
+
+    // 移出的页面不再命中缓冲池，读到的是磁盘上修改后的内容
+    strcpy(buf, "overwritten");
+    disk_manager_->write_page(fd, 1, buf, PAGE_SIZE);
+    auto *page = bpm->fetch_page({fd, 1});
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(0, strcmp("overwritten", page->get_data()));
+    EXPECT_EQ(true, bpm->unpin_page({fd, 1}, false));
+    bpm->flush_all_pages(fd);
+    disk_manager_->close_file(fd);
+}
+
+/**
+ * @brief 测试检查点写回：正在被修改（持有排他latch）的页面不写回，留作脏页，latch释放后再次写回
+ * @note 生成测试文件flush_latched_page_test
+ */
+TEST_F(BufferPoolManagerTest, FlushLatchedPageTest) {
+    const std::string filename = "flush_latched_page_test";
+    const int num_pages = 4;
+    auto disk_manager = BufferPoolManagerTest::disk_manager_.get();
+    disk_manager_->create_file(filename);
+    int fd = disk_manager_->open_file(filename);
+    auto bpm = std::make_unique<BufferPoolManager>(16, disk_manager, 1);
+
+    for (int i = 0; i < num_pages; i++) {
+        PageId page_id = {.fd = fd, .page_no = INVALID_PAGE_ID};
+        auto *page = bpm->new_page(&page_id);
+        ASSERT_NE(nullptr, page);
+        strcpy(page->get_data(), std::to_string(i).c_str());
+        EXPECT_EQ(true, bpm->unpin_page(page_id, true));
+    }
+    char buf[PAGE_SIZE];
+    {
+        WritePageGuard guard = bpm->fetch_page_write({fd, 1});
+        ASSERT_TRUE(static_cast<bool>(guard));
+        strcpy(guard.get_data(), "torn");
+        bpm->flush_all_pages(fd, true);
+        EXPECT_EQ(1, bpm->get_num_dirty_pages());
+        disk_manager_->read_page(fd, 1, buf, PAGE_SIZE);
+        EXPECT_NE(0, strcmp("torn", buf));
+        disk_manager_->read_page(fd, 2, buf, PAGE_SIZE);
+        EXPECT_EQ(0, strcmp("2", buf));
+    }
+    bpm->flush_all_pages(fd, true);
+    EXPECT_EQ(0, bpm->get_num_dirty_pages());
+    disk_manager_->read_page(fd, 1, buf, PAGE_SIZE);
+    EXPECT_EQ(0, strcmp("torn", buf));
+    bpm->flush_all_pages(fd);
+    disk_manager_->close_file(fd);
+}
+
+/**
+ * @brief 测试缓冲池统计：命中、未命中、淘汰和脏页写回按分片和文件分别计数
+ */
+TEST_F(BufferPoolManagerTest, StatsTest) {
+    const std::string filenames[2] = {"stats_test_0", "stats_test_1"};
+    auto disk_manager = BufferPoolManagerTest::disk_manager_.get();
+    int fds[2];
+    for (int i = 0; i < 2; i++) {
+        disk_manager_->create_file(filenames[i]);
+        fds[i] = disk_manager_->open_file(filenames[i]);
+    }
+    const size_t buffer_pool_size = 8;
+    auto bpm = std::make_unique<BufferPoolManager>(buffer_pool_size, disk_manager, 1);
+
+    // 在第一个文件中创建并修改和缓冲池同样多的页面
+    std::vector<PageId> page_ids;
+    for (size_t i = 0; i < buffer_pool_size; i++) {
+        PageId page_id = {.fd = fds[0], .page_no = INVALID_PAGE_ID};
+        ASSERT_NE(nullptr, bpm->new_page(&page_id));
+        EXPECT_EQ(true, bpm->unpin_page(page_id, true));
+        page_ids.push_back(page_id);
+    }
+    for (auto &page_id : page_ids) {
+        ASSERT_NE(nullptr, bpm->fetch_page(page_id));
+        EXPECT_EQ(true, bpm->unpin_page(page_id, false));
+    }
+    BufferPoolStats stats = bpm->get_stats();
+    EXPECT_EQ(buffer_pool_size, stats.get(BufferPoolStats::HITS));
+    EXPECT_EQ(0, stats.get(BufferPoolStats::MISSES));
+    EXPECT_EQ(0, stats.get(BufferPoolStats::EVICTIONS));
+    EXPECT_EQ(buffer_pool_size, stats.resident_pages);
+    EXPECT_EQ(buffer_pool_size, stats.dirty_pages);
+    EXPECT_DOUBLE_EQ(1.0, stats.hit_ratio());
+
+    // 第二个文件的页面淘汰第一个文件的脏页
+    for (size_t i = 0; i < buffer_pool_size / 2; i++) {
+        PageId page_id = {.fd = fds[1], .page_no = INVALID_PAGE_ID};
+        ASSERT_NE(nullptr, bpm->new_page(&page_id));
+        EXPECT_EQ(true, bpm->unpin_page(page_id, false));
+    }
+    // 重新读取被淘汰的页面
+    ASSERT_NE(nullptr, bpm->fetch_page(page_ids[0]));
+    EXPECT_EQ(true, bpm->unpin_page(page_ids[0], false));
+
+    stats = bpm->get_stats();
+    EXPECT_EQ(buffer_pool_size, stats.get(BufferPoolStats::HITS));
+    EXPECT_EQ(1, stats.get(BufferPoolStats::MISSES));
+    EXPECT_EQ(buffer_pool_size / 2 + 1, stats.get(BufferPoolStats::EVICTIONS));
+    EXPECT_EQ(buffer_pool_size / 2 + 1, stats.get(BufferPoolStats::DIRTY_WRITES));
+
+    auto file_stats = bpm->get_file_stats();
+    ASSERT_EQ(2, file_stats.size());
+    EXPECT_EQ(buffer_pool_size, file_stats[fds[0]].get(BufferPoolStats::HITS));
+    EXPECT_EQ(1, file_stats[fds[0]].get(BufferPoolStats::MISSES));
+    EXPECT_EQ(buffer_pool_size / 2 + 1, file_stats[fds[0]].get(BufferPoolStats::EVICTIONS));
+    EXPECT_EQ(buffer_pool_size / 2, file_stats[fds[0]].resident_pages);
+    EXPECT_EQ(0, file_stats[fds[1]].get(BufferPoolStats::EVICTIONS));
+    EXPECT_EQ(buffer_pool_size / 2, file_stats[fds[1]].resident_pages);
+    EXPECT_EQ(0, file_stats[fds[1]].dirty_pages);
+
+    // 各分片的统计之和等于整个缓冲池的统计
+    BufferPoolStats sum;
+    for (size_t i = 0; i < bpm->get_num_shards(); i++) {
+        sum.merge(bpm->get_shard_stats(i));
+    }
+    for (int i = 0; i < BufferPoolStats::NUM_COUNTERS; i++) {
+        EXPECT_EQ(stats.counters[i], sum.counters[i]);
+    }
+
+    // 刷盘时写回剩余的脏页，关闭文件后清除该文件的计数
+    bpm->flush_all_pages(fds[0]);
+    EXPECT_EQ(buffer_pool_size, bpm->get_stats().get(BufferPoolStats::DIRTY_WRITES));
+    bpm->reset_file_stats(fds[0]);
+    file_stats = bpm->get_file_stats();
+    EXPECT_EQ(0, file_stats[fds[0]].get(BufferPoolStats::HITS));
+    EXPECT_EQ(buffer_pool_size / 2, file_stats[fds[0]].resident_pages);
+
+    for (int i = 0; i < 2; i++) {
+        bpm->flush_all_pages(fds[i]);
+        disk_manager_->close_file(fds[i]);
+    }
+}
+
+/**
+ * @brief 测试修改页面大小：帧按新的页面大小读写整个页面，已关闭文件残留的页面被丢弃，缓冲池正在使用时不能修改
+ */
+TEST_F(BufferPoolManagerTest, PageSizeTest) {
+    const std::string filename = "page_size_test";
+    auto disk_manager = BufferPoolManagerTest::disk_manager_.get();
+    auto bpm = std::make_unique<BufferPoolManager>(16, disk_manager, 1);
+    EXPECT_EQ(PAGE_SIZE, bpm->get_page_size());
+
+    // 缓冲池中有未写回的页面时不能修改页面大小
+    disk_manager_->create_file(filename);
+    int fd = disk_manager_->open_file(filename);
+    PageId page_id = {.fd = fd, .page_no = INVALID_PAGE_ID};
+    ASSERT_NE(nullptr, bpm->new_page(&page_id));
+    EXPECT_EQ(true, bpm->unpin_page(page_id, true));
+    EXPECT_THROW(bpm->set_page_size(4 * PAGE_SIZE), InternalError);
+    bpm->flush_all_pages(fd);
+    disk_manager_->close_file(fd);
+    disk_manager_->destroy_file(filename);
+
+    const int page_size = 4 * PAGE_SIZE;
+    disk_manager_->set_page_size(page_size);
+    bpm->set_page_size(page_size);
+    EXPECT_EQ(page_size, bpm->get_page_size());
+    EXPECT_EQ(0, bpm->get_stats().resident_pages);
+
+    disk_manager_->create_file(filename);
+    fd = disk_manager_->open_file(filename);
+    disk_manager_->set_fd2pageno(fd, 0);
+    const int num_pages = 32;
+    for (int i = 0; i < num_pages; i++) {
+        page_id = {.fd = fd, .page_no = INVALID_PAGE_ID};
+        auto *page = bpm->new_page(&page_id);
+        ASSERT_NE(nullptr, page);
+        EXPECT_EQ(i, page_id.page_no);
+        EXPECT_EQ(0, reinterpret_cast<uintptr_t>(page->get_data()) % PAGE_SIZE);
+        memset(page->get_data(), 'a' + i % 26, page_size);
+        EXPECT_EQ(true, bpm->unpin_page(page_id, true));
+    }
+    // 重新读取被淘汰的页面，页面的每个字节都正确
+    for (int i = 0; i < num_pages; i++) {
+        auto *page = bpm->fetch_page({fd, i});
+        ASSERT_NE(nullptr, page);
+        EXPECT_EQ('a' + i % 26, page->get_data()[0]);
+        EXPECT_EQ('a' + i % 26, page->get_data()[page_size - 1]);
+        EXPECT_EQ(true, bpm->unpin_page({fd, i}, false));
+    }
+    bpm->flush_all_pages(fd);
+    EXPECT_EQ(num_pages * page_size, disk_manager_->get_file_size(filename));
+    disk_manager_->close_file(fd);
+    disk_manager_->destroy_file(filename);
+    disk_manager_->set_page_size(PAGE_SIZE);
+}
+
+/**
+ * @brief 测试缓冲池预热：记录的页面按淘汰顺序排列，另一个缓冲池按记录预热后访问这些页面全部命中，淘汰顺序也与记录时一致
+ * @note 生成测试文件warm_up_test
+ */
+TEST_F(BufferPoolManagerTest, WarmUpTest) {
+    const std::string filename = "warm_up_test";
+    const int buffer_pool_size = 64;
+    const int num_pages = 256;
+    auto disk_manager = BufferPoolManagerTest::disk_manager_.get();
+    disk_manager_->create_file(filename);
+    int fd = disk_manager_->open_file(filename);
+    auto bpm = std::make_unique<BufferPoolManager>(buffer_pool_size, disk_manager, 1);
+    for (int i = 0; i < num_pages; i++) {
+        PageId page_id = {.fd = fd, .page_no = INVALID_PAGE_ID};
+        auto *page = bpm->new_page(&page_id);
+        ASSERT_NE(nullptr, page);
+        strcpy(page->get_data(), std::to_string(i).c_str());
+        EXPECT_EQ(true, bpm->unpin_page(page_id, true));
+    }
+    // 乱序访问一组页面，它们成为缓冲池中最近使用的页面
+    std::vector<PageId> hot;
+    for (int i = 0; i < buffer_pool_size / 2; i++) {
+        hot.push_back({fd, (i * 37) % num_pages});
+    }
+    for (auto &page_id : hot) {
+        ASSERT_NE(nullptr, bpm->fetch_page(page_id));
+        EXPECT_EQ(true, bpm->unpin_page(page_id, false));
+    }
+    std::vector<PageId> resident;
+    bpm->get_resident_pages(&resident);
+    ASSERT_EQ(buffer_pool_size, resident.size());
+    EXPECT_EQ(hot, std::vector<PageId>(resident.end() - hot.size(), resident.end()));
+    bpm->flush_all_pages(fd);
+    bpm.reset();
+
+    auto warm = std::make_unique<BufferPoolManager>(buffer_pool_size, disk_manager, 1);
+    warm->warm_up(resident);
+    std::vector<PageId> restored;
+    for (int i = 0; i < 200 && restored != resident; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        warm->get_resident_pages(&restored);
+    }
+    EXPECT_EQ(resident, restored);
+    for (auto &page_id : resident) {
+        auto *page = warm->fetch_page(page_id);
+        ASSERT_NE(nullptr, page);
+        EXPECT_EQ(0, strcmp(std::to_string(page_id.page_no).c_str(), page->get_data()));
+        EXPECT_EQ(true, warm->unpin_page(page_id, false));
+    }
+    auto stats = warm->get_stats();
+    EXPECT_EQ(0, stats.get(BufferPoolStats::MISSES));
+    EXPECT_EQ(resident.size(), stats.get(BufferPoolStats::PREFETCHED));
+    warm.reset();
+    disk_manager_->close_file(fd);
+}
+
+/**
+ * @brief 测试分片分布在多个NUMA节点上时，每段NUMA_EXTENT_PAGES个页面都放在同一个节点的分片中，相邻的段轮流放在各节点；
+ * 本机节点数少于指定的节点数时只划分分片，页面的读写不受影响
+ */
+TEST_F(BufferPoolManagerTest, NumaShardTest) {
+    const std::string filename = "numa_shard_test";
+    const size_t buffer_pool_size = 1024;
+    const int num_nodes = 2;
+    auto disk_manager = BufferPoolManagerTest::disk_manager_.get();
+    disk_manager_->create_file(filename);
+    int fd = disk_manager_->open_file(filename);
+    auto bpm = std::make_unique<BufferPoolManager>(buffer_pool_size, disk_manager, 7, "LRU", num_nodes);
+    ASSERT_EQ(num_nodes, bpm->get_num_nodes());
+    ASSERT_EQ(6, bpm->get_num_shards());
+    size_t frames = 0;
+    for (size_t i = 0; i < bpm->get_num_shards(); i++) {
+        EXPECT_EQ(i / 3, bpm->get_shard_node(i));
+        frames += bpm->get_shard_pool_size(i);
+    }
+    EXPECT_EQ(buffer_pool_size, frames);
+
+    const int num_extents = 4;
+    for (int i = 0; i < num_extents * NUMA_EXTENT_PAGES; i++) {
+        PageId page_id = {.fd = fd, .page_no = INVALID_PAGE_ID};
+        auto *page = bpm->new_page(&page_id);
+        ASSERT_NE(nullptr, page);
+        snprintf(page->get_data(), PAGE_SIZE, "%d", i);
+        EXPECT_EQ(true, bpm->unpin_page(page_id, true));
+    }
+    std::vector<size_t> node_pages(num_nodes, 0);
+    for (size_t i = 0; i < bpm->get_num_shards(); i++) {
+        node_pages[bpm->get_shard_node(i)] += bpm->get_shard_stats(i).resident_pages;
+    }
+    EXPECT_EQ(std::vector<size_t>(num_nodes, num_extents / num_nodes * NUMA_EXTENT_PAGES), node_pages);
+    for (int extent = 0; extent < num_extents; extent++) {
+        size_t node = bpm->get_page_node({fd, extent * NUMA_EXTENT_PAGES});
+        EXPECT_NE(node, bpm->get_page_node({fd, (extent + 1) * NUMA_EXTENT_PAGES}));
+        for (int i = 1; i < NUMA_EXTENT_PAGES; i++) {
+            EXPECT_EQ(node, bpm->get_page_node({fd, extent * NUMA_EXTENT_PAGES + i}));
+        }
+    }
+
+    bpm->flush_all_pages(fd);
+    bpm.reset();
+    bpm = std::make_unique<BufferPoolManager>(buffer_pool_size, disk_manager, 7, "LRU", num_nodes);
+    for (int i = 0; i < num_extents * NUMA_EXTENT_PAGES; i++) {
+        auto *page = bpm->fetch_page({fd, i});
+        ASSERT_NE(nullptr, page);
+        EXPECT_EQ(std::to_string(i), page->get_data());
+        EXPECT_EQ(true, bpm->unpin_page({fd, i}, false));
+    }
+    bpm.reset();
+    disk_manager_->close_file(fd);
+}
@@ -1,7 +1,9 @@
 #include "storage/disk_manager.h"
 
 #include <cassert>
+#include <cstdlib>
 #include <cstring>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -147,3 +149,353 @@ TEST_F(DiskManagerTest, PageOperation) {
     disk_manager_->destroy_file(filename);
     EXPECT_EQ(disk_manager_->is_file(filename), false);
 }
+
+/**
+ * @brief 测试多线程并发打开同一文件、并发读写同一文件的不同页面，以及多页面的批量读写
+ */
+TEST_F(DiskManagerTest, ConcurrentPageOperation) {
+    const std::string filename = "ConcurrentPageOperationTestFile";
+    const int num_threads = 8;
+    if (disk_manager_->is_file(filename)) {
+        disk_manager_->destroy_file(filename);
+    }
+    disk_manager_->create_file(filename);
+
+    // 并发打开同一文件得到同一个文件句柄
+    std::vector<int> fds(num_threads);
+    std::vector<std::thread> threads;
+    for (int tid = 0; tid < num_threads; tid++) {
+        threads.emplace_back([&, tid]() { fds[tid] = disk_manager_->get_file_fd(filename); });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+    int fd = fds[0];
+    for (int tid = 0; tid < num_threads; tid++) {
+        EXPECT_EQ(fd, fds[tid]);
+    }
+
+    // 每个线程交错写入并读取各自的页面
+    for (int tid = 0; tid < num_threads; tid++) {
+        threads.emplace_back([&, tid]() {
+            char buf[PAGE_SIZE];
+            char data[PAGE_SIZE];
+            for (int page_no = tid; page_no < MAX_PAGES; page_no += num_threads) {
+                std::memset(data, page_no, PAGE_SIZE);
+                disk_manager_->write_page(fd, page_no, data, PAGE_SIZE);
+                disk_manager_->read_page(fd, page_no, buf, PAGE_SIZE);
+                EXPECT_EQ(std::memcmp(buf, data, PAGE_SIZE), 0);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    // 一次读取全部页面
+    std::vector<std::vector<char>> pages(MAX_PAGES, std::vector<char>(PAGE_SIZE));
+    std::vector<char *> read_buffers;
+    for (auto &page : pages) {
+        read_buffers.push_back(page.data());
+    }
+    disk_manager_->read_pages(fd, 0, read_buffers);
+    for (int page_no = 0; page_no < MAX_PAGES; page_no++) {
+        EXPECT_EQ(std::vector<char>(PAGE_SIZE, static_cast<char>(page_no)), pages[page_no]);
+    }
+
+    // 一次写入后半部分页面
+    std::vector<const char *> write_buffers;
+    for (int page_no = MAX_PAGES / 2; page_no < MAX_PAGES; page_no++) {
+        std::memset(pages[page_no].data(), 0x5a, PAGE_SIZE);
+        write_buffers.push_back(pages[page_no].data());
+    }
+    disk_manager_->write_pages(fd, MAX_PAGES / 2, write_buffers);
+    char buf[PAGE_SIZE];
+    disk_manager_->read_page(fd, MAX_PAGES - 1, buf, PAGE_SIZE);
+    EXPECT_EQ(std::vector<char>(PAGE_SIZE, 0x5a), std::vector<char>(buf, buf + PAGE_SIZE));
+
+    // 读取超出文件末尾的页面失败
+    EXPECT_THROW(disk_manager_->read_pages(fd, MAX_PAGES - 1, {buf, buf}), InternalError);
+
+    disk_manager_->close_file(fd);
+    disk_manager_->destroy_file(filename);
+}
+
+/**
+ * @brief 测试异步读写：各后端批量写入、读取页面以及追加日志的结果一致
+ */
+TEST_F(DiskManagerTest, AsyncPageOperation) {
+    const std::string filename = "AsyncPageOperationTestFile";
+    for (const std::string backend : {"sync", "io_uring"}) {
+        if (disk_manager_->is_file(filename)) {
+            disk_manager_->destroy_file(filename);
+        }
+        disk_manager_->create_file(filename);
+        int fd = disk_manager_->open_file(filename);
+        disk_manager_->set_io_backend(backend);
+        auto io = disk_manager_->create_async_io(16);
+
+        // 一次提交MAX_PAGES个写请求，超过队列深度的请求在准备时自动提交
+        std::vector<std::vector<char>> pages(MAX_PAGES, std::vector<char>(PAGE_SIZE));
+        for (int page_no = 0; page_no < MAX_PAGES; page_no++) {
+            std::memset(pages[page_no].data(), page_no, PAGE_SIZE);
+            disk_manager_->async_write_page(io.get(), fd, page_no, pages[page_no].data(), PAGE_SIZE, page_no);
+        }
+        io->submit();
+        std::vector<IoCompletion> completions;
+        io->wait(&completions, MAX_PAGES);
+        ASSERT_EQ(MAX_PAGES, completions.size());
+        for (auto &completion : completions) {
+            EXPECT_EQ(PAGE_SIZE, completion.result);
+        }
+        EXPECT_EQ(0, io->get_num_pending());
+
+        // 异步读取并校验
+        std::vector<std::vector<char>> bufs(MAX_PAGES, std::vector<char>(PAGE_SIZE));
+        for (int page_no = 0; page_no < MAX_PAGES; page_no++) {
+            disk_manager_->async_read_page(io.get(), fd, page_no, bufs[page_no].data(), PAGE_SIZE, page_no);
+        }
+        io->submit();
+        completions.clear();
+        io->wait(&completions, MAX_PAGES);
+        ASSERT_EQ(MAX_PAGES, completions.size());
+        for (auto &completion : completions) {
+            EXPECT_EQ(PAGE_SIZE, completion.result);
+            EXPECT_EQ(pages[completion.tag], bufs[completion.tag]);
+        }
+
+        // 读取超出文件末尾的页面只能读到0个字节
+        char buf[PAGE_SIZE];
+        disk_manager_->async_read_page(io.get(), fd, MAX_PAGES, buf, PAGE_SIZE, 0);
+        io->submit();
+        completions.clear();
+        io->wait(&completions, 1);
+        ASSERT_EQ(1, completions.size());
+        EXPECT_EQ(0, completions[0].result);
+
+        disk_manager_->close_file(fd);
+        disk_manager_->destroy_file(filename);
+    }
+
+    // 同步与异步追加的日志按追加顺序排列
+    if (disk_manager_->is_file(LOG_FILE_NAME)) {
+        disk_manager_->destroy_file(LOG_FILE_NAME);
+    }
+    disk_manager_->create_file(LOG_FILE_NAME);
+    disk_manager_->set_io_backend("io_uring");
+    auto io = disk_manager_->create_async_io();
+    char first[] = "first;";
+    char second[] = "second;";
+    char third[] = "third;";
+    disk_manager_->write_log(first, strlen(first));
+    disk_manager_->async_write_log(io.get(), second, strlen(second), 0);
+    io->submit();
+    disk_manager_->write_log(third, strlen(third));
+    std::vector<IoCompletion> completions;
+    io->wait(&completions, 1);
+    char log[64] = {0};
+    EXPECT_EQ(19, disk_manager_->read_log(log, sizeof(log), 0));
+    EXPECT_STREQ("first;second;third;", log);
+    disk_manager_->close_file(disk_manager_->GetLogFd());
+    disk_manager_->destroy_file(LOG_FILE_NAME);
+}
+
+/**
+ * @brief 测试页面释放与复用：释放的页面优先被分配，正常关闭后再次打开仍可复用，异常退出后不会复用
+ */
+TEST_F(DiskManagerTest, FreePageReuse) {
+    const std::string filename = "FreePageReuseTestFile";
+    if (disk_manager_->is_file(filename)) {
+        disk_manager_->destroy_file(filename);
+    }
+    disk_manager_->create_file(filename);
+    int fd = disk_manager_->open_file(filename);
+    disk_manager_->set_fd2pageno(fd, 0);
+    for (int page_no = 0; page_no < MAX_PAGES; page_no++) {
+        EXPECT_EQ(page_no, disk_manager_->allocate_page(fd));
+    }
+
+    // 优先复用页号最小的已释放页面
+    disk_manager_->deallocate_page(fd, 7);
+    disk_manager_->deallocate_page(fd, 3);
+    EXPECT_EQ(2, disk_manager_->get_num_free_pages(fd));
+    EXPECT_EQ(3, disk_manager_->allocate_page(fd));
+    EXPECT_EQ(7, disk_manager_->allocate_page(fd));
+    EXPECT_EQ(MAX_PAGES, disk_manager_->allocate_page(fd));
+
+    // 撤销的分配：最后分配的页号直接回退，其它页号留待复用
+    disk_manager_->cancel_allocate_page(fd, MAX_PAGES);
+    EXPECT_EQ(MAX_PAGES, disk_manager_->get_fd2pageno(fd));
+    disk_manager_->cancel_allocate_page(fd, 3);
+    EXPECT_EQ(3, disk_manager_->allocate_page(fd));
+
+    // 正常关闭后再次打开，释放的页面仍可复用
+    disk_manager_->deallocate_page(fd, 5);
+    disk_manager_->deallocate_page(fd, 100);
+    disk_manager_->close_file(fd);
+    EXPECT_EQ(true, disk_manager_->is_file(filename + ".fsm"));
+    fd = disk_manager_->open_file(filename);
+    EXPECT_EQ(2, disk_manager_->get_num_free_pages(fd));
+    // 文件末尾之后的已释放页面不再记为空闲，之后会从文件末尾重新分配
+    disk_manager_->set_fd2pageno(fd, 50);
+    EXPECT_EQ(1, disk_manager_->get_num_free_pages(fd));
+    EXPECT_EQ(5, disk_manager_->allocate_page(fd));
+    EXPECT_EQ(50, disk_manager_->allocate_page(fd));
+
+    // 未正常关闭时空闲页面文件被丢弃
+    auto other_disk_manager = std::make_unique<DiskManager>();
+    int other_fd = other_disk_manager->open_file(filename);
+    EXPECT_EQ(0, other_disk_manager->get_num_free_pages(other_fd));
+    other_disk_manager->close_file(other_fd);
+    disk_manager_->close_file(fd);
+
+    // 删除文件时一并删除空闲页面文件
+    disk_manager_->destroy_file(filename);
+    EXPECT_EQ(false, disk_manager_->is_file(filename + ".fsm"));
+}
+
+/**
+ * @brief 测试O_DIRECT模式下的页面读写：对齐的缓冲区直接读写，未对齐的缓冲区和只读写部分页面的操作经过中转缓冲区
+ */
+TEST_F(DiskManagerTest, DirectIoPageOperation) {
+    const std::string filename = "DirectIoTestFile";
+    if (disk_manager_->is_file(filename)) {
+        disk_manager_->destroy_file(filename);
+    }
+    disk_manager_->create_file(filename);
+    disk_manager_->set_direct_io(true);
+    int fd = disk_manager_->open_file(filename);
+    disk_manager_->set_direct_io(false);
+    // 文件系统不支持O_DIRECT时文件以普通模式打开，以下读写的结果应相同
+
+    // 只写页面开头的部分字节（如文件头），再分别读出部分和整个页面
+    char hdr[100];
+    rand_buf(hdr, sizeof(hdr));
+    disk_manager_->write_page(fd, 0, hdr, sizeof(hdr));
+    char hdr_buf[100];
+    disk_manager_->read_page(fd, 0, hdr_buf, sizeof(hdr_buf));
+    EXPECT_EQ(0, memcmp(hdr, hdr_buf, sizeof(hdr)));
+
+    // 按PAGE_SIZE对齐的缓冲区与未对齐的缓冲区交替写入多个页面
+    const int num_pages = 8;
+    char *aligned = static_cast<char *>(aligned_alloc(PAGE_SIZE, PAGE_SIZE * num_pages));
+    std::vector<char> unaligned(PAGE_SIZE * num_pages + 1);
+    std::vector<const char *> write_buffers;
+    for (int i = 0; i < num_pages; i++) {
+        char *page = i % 2 == 0 ? aligned + i * PAGE_SIZE : unaligned.data() + 1 + i * PAGE_SIZE;
+        rand_buf(page, PAGE_SIZE);
+        write_buffers.push_back(page);
+    }
+    disk_manager_->write_pages(fd, 1, write_buffers);
+
+    // 部分写入第0页不影响之后的页面
+    disk_manager_->write_page(fd, 0, hdr, sizeof(hdr));
+
+    std::vector<char *> read_buffers;
+    std::vector<std::vector<char>> bufs(num_pages, std::vector<char>(PAGE_SIZE + 1));
+    for (int i = 0; i < num_pages; i++) {
+        read_buffers.push_back(bufs[i].data() + 1);
+    }
+    disk_manager_->read_pages(fd, 1, read_buffers);
+    for (int i = 0; i < num_pages; i++) {
+        EXPECT_EQ(0, memcmp(write_buffers[i], read_buffers[i], PAGE_SIZE));
+    }
+    char *page_buf = static_cast<char *>(aligned_alloc(PAGE_SIZE, PAGE_SIZE));
+    disk_manager_->read_page(fd, num_pages, page_buf, PAGE_SIZE);
+    EXPECT_EQ(0, memcmp(write_buffers[num_pages - 1], page_buf, PAGE_SIZE));
+    disk_manager_->read_page(fd, 0, page_buf, PAGE_SIZE);
+    EXPECT_EQ(0, memcmp(hdr, page_buf, sizeof(hdr)));
+
+    free(page_buf);
+    free(aligned);
+    disk_manager_->close_file(fd);
+    disk_manager_->destroy_file(filename);
+}
+
+/**
+ * @brief 测试页面压缩的文件：读写的结果与未压缩的文件相同，可压缩的页面在磁盘上占用更少的空间，
+ *        重新打开后映射表仍然有效，被替换的槽在同步之后复用
+ */
+TEST_F(DiskManagerTest, CompressedPageOperation) {
+    const std::string filename = "CompressedPageTestFile";
+    if (disk_manager_->is_file(filename)) {
+        disk_manager_->destroy_file(filename);
+    }
+    disk_manager_->create_file(filename, true);
+    EXPECT_EQ(true, disk_manager_->is_file(filename + ".pmap"));
+    int fd = disk_manager_->open_file(filename);
+    EXPECT_EQ(true, disk_manager_->is_compressed(fd));
+
+    // 只写页面开头的文件头，之后的写入不影响文件头以外的部分
+    char hdr[100];
+    rand_buf(hdr, sizeof(hdr));
+    disk_manager_->write_page(fd, 0, hdr, sizeof(hdr));
+
+    // 一半页面是可压缩的数据，一半是随机数据（原样保存）
+    std::vector<std::vector<char>> pages(MAX_PAGES, std::vector<char>(PAGE_SIZE));
+    std::vector<const char *> write_buffers;
+    for (int page_no = 1; page_no < MAX_PAGES; page_no++) {
+        auto &page = pages[page_no];
+        if (page_no % 2 == 0) {
+            for (int i = 0; i < PAGE_SIZE; i++) {
+                page[i] = "row-"[i % 4] + (i / 256) % 8;
+            }
+        } else {
+            rand_buf(page.data(), PAGE_SIZE);
+        }
+        write_buffers.push_back(page.data());
+    }
+    disk_manager_->write_pages(fd, 1, write_buffers);
+    size_t size = disk_manager_->get_compressed_size(fd);
+    EXPECT_LT(size, static_cast<size_t>(MAX_PAGES) * PAGE_SIZE * 3 / 4);
+
+    std::vector<std::vector<char>> bufs(MAX_PAGES, std::vector<char>(PAGE_SIZE));
+    std::vector<char *> read_buffers;
+    for (int page_no = 1; page_no < MAX_PAGES; page_no++) {
+        read_buffers.push_back(bufs[page_no].data());
+    }
+    disk_manager_->read_pages(fd, 1, read_buffers);
+    for (int page_no = 1; page_no < MAX_PAGES; page_no++) {
+        EXPECT_EQ(pages[page_no], bufs[page_no]);
+    }
+    char buf[PAGE_SIZE];
+    disk_manager_->read_page(fd, 0, buf, sizeof(hdr));
+    EXPECT_EQ(0, memcmp(hdr, buf, sizeof(hdr)));
+    EXPECT_THROW(disk_manager_->read_page(fd, MAX_PAGES, buf, PAGE_SIZE), InternalError);
+
+    // 重写页面分配新的槽，旧槽在同步之后复用，文件占用的空间不会持续增长
+    for (int round = 0; round < 4; round++) {
+        disk_manager_->write_pages(fd, 1, write_buffers);
+        disk_manager_->sync_all_files();
+    }
+    EXPECT_LE(disk_manager_->get_file_size(filename), static_cast<int>(size * 2 + PAGE_SIZE));
+
+    // 异步读写退回同步读写，结果照常出现在完成结果中
+    auto io = disk_manager_->create_async_io(16);
+    disk_manager_->async_write_page(io.get(), fd, 2, pages[3].data(), PAGE_SIZE, 2);
+    disk_manager_->async_read_page(io.get(), fd, 2, buf, PAGE_SIZE, 3);
+    io->submit();
+    std::vector<IoCompletion> completions;
+    io->wait(&completions, 2);
+    ASSERT_EQ(2, completions.size());
+    EXPECT_EQ(PAGE_SIZE, completions[0].result);
+    EXPECT_EQ(PAGE_SIZE, completions[1].result);
+    EXPECT_EQ(0, memcmp(pages[3].data(), buf, PAGE_SIZE));
+
+    // 重新打开后按映射表读出同样的页面；截断后被截断的页面不能再读取
+    disk_manager_->close_file(fd);
+    fd = disk_manager_->open_file(filename);
+    EXPECT_EQ(true, disk_manager_->is_compressed(fd));
+    disk_manager_->read_page(fd, MAX_PAGES - 1, buf, PAGE_SIZE);
+    EXPECT_EQ(0, memcmp(pages[MAX_PAGES - 1].data(), buf, PAGE_SIZE));
+    disk_manager_->truncate_file(fd, 2);
+    EXPECT_THROW(disk_manager_->read_page(fd, 2, buf, PAGE_SIZE), InternalError);
+    disk_manager_->read_page(fd, 0, buf, sizeof(hdr));
+    EXPECT_EQ(0, memcmp(hdr, buf, sizeof(hdr)));
+
+    // 删除文件时一并删除映射表文件
+    disk_manager_->close_file(fd);
+    disk_manager_->destroy_file(filename);
+    EXPECT_EQ(false, disk_manager_->is_file(filename + ".pmap"));
+}
@@ -8,6 +8,7 @@
 #include <cstring>
 #include <ctime>
 #include <iostream>
+#include <thread>
 #include <unordered_map>
 
 #include "gtest/gtest.h"
@@ -39,10 +40,11 @@ void check_equal(const RmFileHandle *file_handle,
         auto rec = file_handle->get_record(rid, context);
         assert(memcmp(mock_buf, rec->data, file_handle->file_hdr_.record_size) == 0);
     }
-    // Randomly get record
+    // Randomly get record，slotted格式的页面没有固定的slot个数
+    int max_slots = file_handle->file_hdr_.num_records_per_page > 0 ? file_handle->file_hdr_.num_records_per_page : 64;
     for (int i = 0; i < 10; i++) {
         Rid rid = {.page_no = 1 + rand() % (file_handle->file_hdr_.num_pages - 1),
-                   .slot_no = rand() % file_handle->file_hdr_.num_records_per_page};
+                   .slot_no = rand() % max_slots};
         bool mock_exist = mock.count(rid) > 0;
         bool rm_exist = file_handle->is_record(rid);
         assert(rm_exist == mock_exist);
@@ -56,6 +58,17 @@ void check_equal(const RmFileHandle *file_handle,
         num_records++;
     }
     assert(num_records == mock.size());
+    // Test batched RM scan
+    num_records = 0;
+    for (RmScan scan(file_handle, true); !scan.is_end(); scan.next_batch()) {
+        assert(!scan.batch().empty());
+        for (auto &slot : scan.batch()) {
+            assert(slot.rid.page_no == scan.batch().front().rid.page_no);
+            assert(memcmp(slot.data, mock.at(slot.rid).c_str(), file_handle->file_hdr_.record_size) == 0);
+            num_records++;
+        }
+    }
+    assert(num_records == mock.size());
 }
 
 // std::cout can call this, for example: std::cout << rid
@@ -223,4 +236,872 @@ TEST(RecordManagerTest, MultipleFilesTest) {
         std::string filename = filenames[i];
         rm_manager->destroy_file(filename);
     }
-}
\ No newline at end of file
+}
+/**
+ * @brief 测试页面大小不是默认值时的record文件：每页可容纳的记录数按页面大小计算，关闭后重新打开记录不变
+ */
+TEST(RecordManagerTest, PageSizeTest) {
+    srand((unsigned)time(nullptr));
+
+    char *result = new char[BUFFER_LENGTH];
+    int offset = 0;
+    Context *context = new Context(nullptr, nullptr, nullptr, result, &offset);
+
+    const int page_size = 4 * PAGE_SIZE;
+    auto disk_manager = std::make_unique<DiskManager>();
+    disk_manager->set_page_size(page_size);
+    auto buffer_pool_manager = std::make_unique<BufferPoolManager>(256, disk_manager.get());
+    auto rm_manager = std::make_unique<RmManager>(disk_manager.get(), buffer_pool_manager.get());
+    EXPECT_EQ(page_size, buffer_pool_manager->get_page_size());
+
+    std::string filename = "page_size.txt";
+    if (disk_manager->is_file(filename)) {
+        disk_manager->destroy_file(filename);
+    }
+    int record_size = 100;
+    rm_manager->create_file(filename, record_size);
+    auto file_handle = rm_manager->open_file(filename);
+    int max_bytes = file_handle->file_hdr_.record_size * file_handle->file_hdr_.num_records_per_page +
+                    file_handle->file_hdr_.bitmap_size + (int)sizeof(RmPageHdr);
+    EXPECT_LE(max_bytes, page_size);
+    EXPECT_GT(max_bytes, PAGE_SIZE);
+
+    // 插入的记录占满多个页面
+    std::unordered_map<Rid, std::string, rid_hash_t, rid_equal_t> mock;
+    std::vector<char> write_buf(record_size);
+    for (int i = 0; i < file_handle->file_hdr_.num_records_per_page * 3; i++) {
+        rand_buf(record_size, write_buf.data());
+        Rid rid = file_handle->insert_record(write_buf.data(), context);
+        mock[rid] = std::string(write_buf.data(), record_size);
+    }
+    EXPECT_EQ(4, file_handle->file_hdr_.num_pages);
+    rm_manager->close_file(file_handle.get());
+    EXPECT_EQ(4 * page_size, disk_manager->get_file_size(filename));
+
+    file_handle = rm_manager->open_file(filename);
+    check_equal(file_handle.get(), mock);
+    rm_manager->close_file(file_handle.get());
+    rm_manager->destroy_file(filename);
+}
+
+/**
+ * @brief 测试记录视图：视图直接指向页面中的记录，不复制数据；slot上没有记录时视图无效
+ */
+TEST(RecordManagerTest, RecordViewTest) {
+    srand((unsigned)time(nullptr));
+
+    char *result = new char[BUFFER_LENGTH];
+    int offset = 0;
+    Context *context = new Context(nullptr, nullptr, nullptr, result, &offset);
+
+    auto disk_manager = std::make_unique<DiskManager>();
+    auto buffer_pool_manager = std::make_unique<BufferPoolManager>(256, disk_manager.get());
+    auto rm_manager = std::make_unique<RmManager>(disk_manager.get(), buffer_pool_manager.get());
+
+    std::string filename = "record_view.txt";
+    if (disk_manager->is_file(filename)) {
+        disk_manager->destroy_file(filename);
+    }
+    int record_size = 64;
+    rm_manager->create_file(filename, record_size);
+    auto file_handle = rm_manager->open_file(filename);
+
+    std::unordered_map<Rid, std::string, rid_hash_t, rid_equal_t> mock;
+    std::vector<char> write_buf(record_size);
+    for (int i = 0; i < file_handle->file_hdr_.num_records_per_page * 2; i++) {
+        rand_buf(record_size, write_buf.data());
+        Rid rid = file_handle->insert_record(write_buf.data(), context);
+        mock[rid] = std::string(write_buf.data(), record_size);
+    }
+
+    for (auto &entry : mock) {
+        RecordView view = file_handle->get_record_view(entry.first, context);
+        ASSERT_TRUE(view.is_valid());
+        EXPECT_EQ(record_size, view.size());
+        EXPECT_EQ(0, memcmp(view.data(), entry.second.c_str(), record_size));
+        // 同一条记录的视图指向页面中的同一位置
+        RecordView again = file_handle->get_record_view(entry.first, context);
+        EXPECT_EQ(view.data(), again.data());
+    }
+
+    // 移动视图后原视图失效，to_record复制出的记录与视图内容相同且不再指向页面
+    Rid rid = mock.begin()->first;
+    RecordView view = file_handle->get_record_view(rid, context);
+    const char *data = view.data();
+    RecordView moved = std::move(view);
+    EXPECT_FALSE(view.is_valid());
+    EXPECT_EQ(data, moved.data());
+    auto rec = moved.to_record();
+    EXPECT_NE(data, rec->data);
+    EXPECT_EQ(0, memcmp(rec->data, mock.at(rid).c_str(), record_size));
+    moved.release();
+    EXPECT_FALSE(moved.is_valid());
+
+    // 独立记录构成的视图
+    RecordView owned(std::make_unique<RmRecord>(record_size, rec->data));
+    ASSERT_TRUE(owned.is_valid());
+    EXPECT_EQ(0, memcmp(owned.data(), rec->data, record_size));
+    EXPECT_FALSE(RecordView(nullptr).is_valid());
+
+    // 删除记录后视图无效
+    file_handle->delete_record(rid, context);
+    EXPECT_FALSE(file_handle->get_record_view(rid, context).is_valid());
+
+    rm_manager->close_file(file_handle.get());
+    rm_manager->destroy_file(filename);
+}
+
+/**
+ * @brief 测试批量扫描：每个页面只访问一次缓冲池，逐条next()与按批次遍历得到的记录相同
+ */
+TEST(RecordManagerTest, BatchScanTest) {
+    srand((unsigned)time(nullptr));
+
+    char *result = new char[BUFFER_LENGTH];
+    int offset = 0;
+    Context *context = new Context(nullptr, nullptr, nullptr, result, &offset);
+
+    auto disk_manager = std::make_unique<DiskManager>();
+    auto buffer_pool_manager = std::make_unique<BufferPoolManager>(256, disk_manager.get());
+    auto rm_manager = std::make_unique<RmManager>(disk_manager.get(), buffer_pool_manager.get());
+
+    std::string filename = "batch_scan.txt";
+    if (disk_manager->is_file(filename)) {
+        disk_manager->destroy_file(filename);
+    }
+    int record_size = 64;
+    rm_manager->create_file(filename, record_size);
+    auto file_handle = rm_manager->open_file(filename);
+
+    std::unordered_map<Rid, std::string, rid_hash_t, rid_equal_t> mock;
+    std::vector<char> write_buf(record_size);
+    int num_records_per_page = file_handle->file_hdr_.num_records_per_page;
+    for (int i = 0; i < num_records_per_page * 4; i++) {
+        rand_buf(record_size, write_buf.data());
+        Rid rid = file_handle->insert_record(write_buf.data(), context);
+        mock[rid] = std::string(write_buf.data(), record_size);
+    }
+    // 删除第二个页面上的全部记录以及其它页面上的部分记录，批量扫描应当跳过空页面
+    for (int slot_no = 0; slot_no < num_records_per_page; slot_no++) {
+        Rid rid{RM_FIRST_RECORD_PAGE + 1, slot_no};
+        file_handle->delete_record(rid, context);
+        mock.erase(rid);
+    }
+    for (int page_no : {RM_FIRST_RECORD_PAGE, RM_FIRST_RECORD_PAGE + 2, RM_FIRST_RECORD_PAGE + 3}) {
+        for (int slot_no = 0; slot_no < num_records_per_page; slot_no += 3) {
+            Rid rid{page_no, slot_no};
+            file_handle->delete_record(rid, context);
+            mock.erase(rid);
+        }
+    }
+
+    auto fetches = [&]() {
+        auto stats = buffer_pool_manager->get_file_stats()[file_handle->GetFd()];
+        return stats.get(BufferPoolStats::HITS) + stats.get(BufferPoolStats::MISSES);
+    };
+
+    // 逐条next()：每个页面只访问一次缓冲池，扫描过的记录计入当前线程的ROWS_SCANNED
+    uint64_t before = fetches();
+    uint64_t scanned_before = QueryStats::thread_stats().get(QueryStats::ROWS_SCANNED);
+    size_t num_records = 0;
+    for (RmScan scan(file_handle.get(), true); !scan.is_end(); scan.next()) {
+        ASSERT_GT(mock.count(scan.rid()), 0);
+        EXPECT_EQ(0, memcmp(scan.record_data(), mock.at(scan.rid()).c_str(), record_size));
+        num_records++;
+    }
+    EXPECT_EQ(mock.size(), num_records);
+    EXPECT_EQ(static_cast<uint64_t>(file_handle->file_hdr_.num_pages - RM_FIRST_RECORD_PAGE), fetches() - before);
+    EXPECT_EQ(mock.size(), QueryStats::thread_stats().get(QueryStats::ROWS_SCANNED) - scanned_before);
+
+    // 按批次遍历
+    num_records = 0;
+    int num_batches = 0;
+    for (RmScan scan(file_handle.get(), true); !scan.is_end(); scan.next_batch()) {
+        EXPECT_NE(RM_FIRST_RECORD_PAGE + 1, scan.rid().page_no);
+        for (auto &slot : scan.batch()) {
+            EXPECT_EQ(0, memcmp(slot.data, mock.at(slot.rid).c_str(), record_size));
+        }
+        num_records += scan.batch().size();
+        num_batches++;
+    }
+    EXPECT_EQ(mock.size(), num_records);
+    EXPECT_EQ(3, num_batches);
+
+    rm_manager->close_file(file_handle.get());
+    rm_manager->destroy_file(filename);
+}
+
+/**
+ * @brief 测试批量插入：先填满已有页面中的空闲slot，再按顺序写入新页面，结果与逐条插入一致
+ */
+TEST(RecordManagerTest, BulkInsertTest) {
+    srand((unsigned)time(nullptr));
+
+    char *result = new char[BUFFER_LENGTH];
+    int offset = 0;
+    Context *context = new Context(nullptr, nullptr, nullptr, result, &offset);
+
+    auto disk_manager = std::make_unique<DiskManager>();
+    auto buffer_pool_manager = std::make_unique<BufferPoolManager>(256, disk_manager.get());
+    auto rm_manager = std::make_unique<RmManager>(disk_manager.get(), buffer_pool_manager.get());
+
+    std::string filename = "bulk_insert.txt";
+    if (disk_manager->is_file(filename)) {
+        disk_manager->destroy_file(filename);
+    }
+    int record_size = 48;
+    rm_manager->create_file(filename, record_size);
+    auto file_handle = rm_manager->open_file(filename);
+    int num_records_per_page = file_handle->file_hdr_.num_records_per_page;
+
+    // 逐条插入一页半的记录，然后在第一页上留出空位
+    std::unordered_map<Rid, std::string, rid_hash_t, rid_equal_t> mock;
+    std::vector<char> write_buf(record_size);
+    for (int i = 0; i < num_records_per_page * 3 / 2; i++) {
+        rand_buf(record_size, write_buf.data());
+        Rid rid = file_handle->insert_record(write_buf.data(), context);
+        mock[rid] = std::string(write_buf.data(), record_size);
+    }
+    for (int slot_no = 0; slot_no < num_records_per_page; slot_no += 2) {
+        Rid rid{RM_FIRST_RECORD_PAGE, slot_no};
+        file_handle->delete_record(rid, context);
+        mock.erase(rid);
+    }
+
+    // 批量插入三页的记录
+    int num_records = num_records_per_page * 3;
+    std::vector<char> buf(static_cast<size_t>(num_records) * record_size);
+    rand_buf(static_cast<int>(buf.size()), buf.data());
+    std::vector<Rid> rids;
+    file_handle->insert_records(buf.data(), num_records, &rids, context);
+    ASSERT_EQ(num_records, static_cast<int>(rids.size()));
+    for (int i = 0; i < num_records; i++) {
+        ASSERT_EQ(0, mock.count(rids[i]));
+        mock[rids[i]] = std::string(buf.data() + static_cast<size_t>(i) * record_size, record_size);
+    }
+    check_equal(file_handle.get(), mock);
+
+    // 所有页面都已经填满，只有最后一页可能留有空位
+    EXPECT_EQ(RM_FIRST_RECORD_PAGE + 4, file_handle->file_hdr_.num_pages);
+    for (int page_no = RM_FIRST_RECORD_PAGE; page_no < file_handle->file_hdr_.num_pages - 1; page_no++) {
+        ReadPageGuard guard = file_handle->fetch_page_read(page_no);
+        RmPageHandle page_handle(&file_handle->file_hdr_, guard.get_page());
+        EXPECT_EQ(num_records_per_page, page_handle.page_hdr->num_records);
+    }
+
+    rm_manager->close_file(file_handle.get());
+    rm_manager->destroy_file(filename);
+}
+
+/**
+ * @brief 测试空闲空间映射：删除后腾出空间的页面被优先填满，重新打开文件后映射由页头重建，并发插入的记录互不覆盖
+ */
+TEST(RecordManagerTest, FreeSpaceMapTest) {
+    srand((unsigned)time(nullptr));
+
+    char *result = new char[BUFFER_LENGTH];
+    int offset = 0;
+    Context *context = new Context(nullptr, nullptr, nullptr, result, &offset);
+
+    auto disk_manager = std::make_unique<DiskManager>();
+    auto buffer_pool_manager = std::make_unique<BufferPoolManager>(256, disk_manager.get());
+    auto rm_manager = std::make_unique<RmManager>(disk_manager.get(), buffer_pool_manager.get());
+
+    std::string filename = "free_space_map.txt";
+    if (disk_manager->is_file(filename)) {
+        disk_manager->destroy_file(filename);
+    }
+    int record_size = 48;
+    rm_manager->create_file(filename, record_size);
+    auto file_handle = rm_manager->open_file(filename);
+    int num_records_per_page = file_handle->file_hdr_.num_records_per_page;
+
+    // 填满三个页面
+    std::unordered_map<Rid, std::string, rid_hash_t, rid_equal_t> mock;
+    std::vector<char> write_buf(record_size);
+    for (int i = 0; i < num_records_per_page * 3; i++) {
+        rand_buf(record_size, write_buf.data());
+        Rid rid = file_handle->insert_record(write_buf.data(), context);
+        mock[rid] = std::string(write_buf.data(), record_size);
+    }
+    EXPECT_EQ(RM_FIRST_RECORD_PAGE + 3, file_handle->file_hdr_.num_pages);
+    EXPECT_EQ(0u, file_handle->fsm_.get_num_free_pages());
+
+    // 第一页删除一半记录，第二页删除一条记录
+    for (int slot_no = 0; slot_no < num_records_per_page; slot_no += 2) {
+        Rid rid{RM_FIRST_RECORD_PAGE, slot_no};
+        file_handle->delete_record(rid, context);
+        mock.erase(rid);
+    }
+    Rid deleted{RM_FIRST_RECORD_PAGE + 1, 3};
+    file_handle->delete_record(deleted, context);
+    mock.erase(deleted);
+    EXPECT_GT(file_handle->fsm_.get_bucket(RM_FIRST_RECORD_PAGE), file_handle->fsm_.get_bucket(RM_FIRST_RECORD_PAGE + 1));
+    EXPECT_EQ(1, file_handle->fsm_.get_bucket(RM_FIRST_RECORD_PAGE + 1));
+    EXPECT_EQ(0, file_handle->fsm_.get_bucket(RM_FIRST_RECORD_PAGE + 2));
+
+    // 空闲空间最少的页面被优先填满，不创建新页面
+    rand_buf(record_size, write_buf.data());
+    Rid rid = file_handle->insert_record(write_buf.data(), context);
+    mock[rid] = std::string(write_buf.data(), record_size);
+    EXPECT_EQ(deleted.page_no, rid.page_no);
+    EXPECT_EQ(deleted.slot_no, rid.slot_no);
+    rm_manager->close_file(file_handle.get());
+
+    // 重新打开文件，第一次插入前由页头重建映射
+    file_handle = rm_manager->open_file(filename);
+    rand_buf(record_size, write_buf.data());
+    rid = file_handle->insert_record(write_buf.data(), context);
+    mock[rid] = std::string(write_buf.data(), record_size);
+    EXPECT_EQ(RM_FIRST_RECORD_PAGE, rid.page_no);
+    EXPECT_EQ(1u, file_handle->fsm_.get_num_free_pages());
+    EXPECT_EQ(RM_FIRST_RECORD_PAGE + 3, file_handle->file_hdr_.num_pages);
+
+    // 多个线程并发插入
+    const int num_threads = 4;
+    const int num_per_thread = num_records_per_page * 2;
+    std::vector<std::vector<std::pair<Rid, std::string>>> inserted(num_threads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+        threads.emplace_back([&, t]() {
+            std::vector<char> buf(record_size);
+            for (int i = 0; i < num_per_thread; i++) {
+                for (int j = 0; j < record_size; j++) {
+                    buf[j] = static_cast<char>(t * 31 + i * 7 + j);
+                }
+                Rid r = file_handle->insert_record(buf.data(), nullptr);
+                inserted[t].emplace_back(r, std::string(buf.data(), record_size));
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (auto &records : inserted) {
+        for (auto &entry : records) {
+            ASSERT_EQ(0, mock.count(entry.first));
+            mock[entry.first] = entry.second;
+        }
+    }
+    check_equal(file_handle.get(), mock);
+    int num_full_pages = static_cast<int>(mock.size()) / num_records_per_page;
+    EXPECT_GE(file_handle->file_hdr_.num_pages, RM_FIRST_RECORD_PAGE + num_full_pages);
+    EXPECT_LE(file_handle->file_hdr_.num_pages, RM_FIRST_RECORD_PAGE + num_full_pages + num_threads + 1);
+
+    rm_manager->close_file(file_handle.get());
+    rm_manager->destroy_file(filename);
+}
+
+/**
+ * @brief 生成一条含变长字段的随机记录：定长部分随机，变长字段写入随机长度的非0字节，其余部分补0
+ */
+static void rand_var_record(const std::vector<RmField> &var_fields, int record_size, char *out) {
+    rand_buf(record_size, out);
+    for (auto &field : var_fields) {
+        int len = rand() % (field.len + 1);
+        for (int i = 0; i < field.len; i++) {
+            out[field.offset + i] = i < len ? static_cast<char>(1 + rand() % 255) : 0;
+        }
+    }
+}
+
+/**
+ * @brief 测试slotted格式：变长记录按实际长度存放，更新后放不下的记录移动到其它页面并保持rid不变，删除后的空间被复用
+ */
+TEST(RecordManagerTest, SlottedPageTest) {
+    srand((unsigned)time(nullptr));
+
+    char *result = new char[BUFFER_LENGTH];
+    int offset = 0;
+    Context *context = new Context(nullptr, nullptr, nullptr, result, &offset);
+
+    auto disk_manager = std::make_unique<DiskManager>();
+    auto buffer_pool_manager = std::make_unique<BufferPoolManager>(256, disk_manager.get());
+    auto rm_manager = std::make_unique<RmManager>(disk_manager.get(), buffer_pool_manager.get());
+
+    std::string filename = "slotted_page.txt";
+    if (disk_manager->is_file(filename)) {
+        disk_manager->destroy_file(filename);
+    }
+    // 字段依次为 INT, VARCHAR(200), INT, VARCHAR(100)
+    std::vector<RmField> var_fields = {{4, 200}, {208, 100}};
+    int record_size = 312;
+    rm_manager->create_file(filename, record_size, RM_FORMAT_SLOTTED, var_fields);
+    auto file_handle = rm_manager->open_file(filename);
+    EXPECT_EQ(RM_FORMAT_SLOTTED, file_handle->file_hdr_.format);
+    EXPECT_EQ(2, file_handle->file_hdr_.num_fields);
+
+    // 插入的记录平均只占声明长度的一半左右，页面个数明显少于定长格式
+    std::unordered_map<Rid, std::string, rid_hash_t, rid_equal_t> mock;
+    std::vector<char> write_buf(record_size);
+    const int num_records = 2000;
+    for (int i = 0; i < num_records; i++) {
+        rand_var_record(var_fields, record_size, write_buf.data());
+        Rid rid = file_handle->insert_record(write_buf.data(), context);
+        ASSERT_EQ(0, mock.count(rid));
+        mock[rid] = std::string(write_buf.data(), record_size);
+    }
+    check_equal(file_handle.get(), mock);
+    int bitmap_records_per_page = (PAGE_SIZE - (int)sizeof(RmPageHdr)) / record_size;
+    EXPECT_LT(file_handle->file_hdr_.num_pages, num_records / bitmap_records_per_page * 3 / 4);
+
+    // 把第一个页面上的记录依次更新到最长，页面放不下之后记录移动到其它页面
+    for (int i = 0; i < record_size; i++) {
+        write_buf[i] = static_cast<char>(1 + i % 200);
+    }
+    bool forwarded = false;
+    for (int slot_no = 0; !forwarded; slot_no++) {
+        Rid rid{RM_FIRST_RECORD_PAGE, slot_no};
+        ASSERT_TRUE(file_handle->is_record(rid));
+        file_handle->update_record(rid, write_buf.data(), context);
+        mock[rid] = std::string(write_buf.data(), record_size);
+        ReadPageGuard guard = file_handle->fetch_page_read(rid.page_no);
+        forwarded = RmSlottedPage(guard.get_page(), PAGE_SIZE).is_forward(slot_no);
+    }
+    check_equal(file_handle.get(), mock);
+
+    // 随机删除和更新，更新后的记录长度随机变化
+    std::vector<Rid> rids;
+    for (auto &entry : mock) {
+        rids.push_back(entry.first);
+    }
+    for (size_t i = 0; i < rids.size(); i++) {
+        if (rand() % 3 == 0) {
+            file_handle->delete_record(rids[i], context);
+            mock.erase(rids[i]);
+        } else if (rand() % 2 == 0) {
+            rand_var_record(var_fields, record_size, write_buf.data());
+            file_handle->update_record(rids[i], write_buf.data(), context);
+            mock[rids[i]] = std::string(write_buf.data(), record_size);
+        }
+    }
+    check_equal(file_handle.get(), mock);
+
+    // 在删除的位置上重新插入原记录（事务回滚删除时的操作）
+    Rid restored = rids[0];
+    if (mock.count(restored) == 0) {
+        rand_var_record(var_fields, record_size, write_buf.data());
+        file_handle->insert_record(restored, write_buf.data());
+        mock[restored] = std::string(write_buf.data(), record_size);
+    }
+    EXPECT_TRUE(file_handle->is_record(restored));
+
+    // 删除腾出的空间被复用，重新插入同样多的记录不需要太多新页面
+    int num_pages = file_handle->file_hdr_.num_pages;
+    int num_deleted = num_records + 1 - static_cast<int>(mock.size());
+    for (int i = 0; i < num_deleted; i++) {
+        rand_var_record(var_fields, record_size, write_buf.data());
+        Rid rid = file_handle->insert_record(write_buf.data(), context);
+        ASSERT_EQ(0, mock.count(rid));
+        mock[rid] = std::string(write_buf.data(), record_size);
+    }
+    EXPECT_LE(file_handle->file_hdr_.num_pages, num_pages + num_pages / 4);
+    check_equal(file_handle.get(), mock);
+
+    // 重新打开文件
+    rm_manager->close_file(file_handle.get());
+    file_handle = rm_manager->open_file(filename);
+    EXPECT_EQ(RM_FORMAT_SLOTTED, file_handle->file_hdr_.format);
+    check_equal(file_handle.get(), mock);
+
+    rm_manager->close_file(file_handle.get());
+    rm_manager->destroy_file(filename);
+}
+
+/**
+ * @brief 测试PAX格式：页面内按列存放的记录读写结果与行格式一致，批量扫描的过滤函数在拼装记录之前排除记录
+ */
+TEST(RecordManagerTest, PaxTest) {
+    srand((unsigned)time(nullptr));
+
+    char *result = new char[BUFFER_LENGTH];
+    int offset = 0;
+    Context *context = new Context(nullptr, nullptr, nullptr, result, &offset);
+
+    auto disk_manager = std::make_unique<DiskManager>();
+    auto buffer_pool_manager = std::make_unique<BufferPoolManager>(256, disk_manager.get());
+    auto rm_manager = std::make_unique<RmManager>(disk_manager.get(), buffer_pool_manager.get());
+
+    std::string filename = "pax_page.txt";
+    if (disk_manager->is_file(filename)) {
+        disk_manager->destroy_file(filename);
+    }
+    // 字段依次为 INT, CHAR(20), FLOAT, CHAR(7)
+    std::vector<RmField> fields = {{0, 4}, {4, 20}, {24, 4}, {28, 7}};
+    int record_size = 35;
+    // 字段没有覆盖整条记录时拒绝创建
+    EXPECT_THROW(rm_manager->create_file(filename, record_size, RM_FORMAT_PAX, {{0, 4}, {8, 27}}),
+                 InvalidRecordSizeError);
+    rm_manager->create_file(filename, record_size, RM_FORMAT_PAX, fields);
+    auto file_handle = rm_manager->open_file(filename);
+    EXPECT_EQ(RM_FORMAT_PAX, file_handle->file_hdr_.format);
+    EXPECT_EQ(4, file_handle->file_hdr_.num_fields);
+
+    std::unordered_map<Rid, std::string, rid_hash_t, rid_equal_t> mock;
+    std::vector<char> write_buf(record_size);
+    auto rand_record = [&](int key) {
+        for (int i = 0; i < record_size; i++) {
+            write_buf[i] = static_cast<char>(rand() % 256);
+        }
+        memcpy(write_buf.data(), &key, sizeof(int));
+    };
+    for (int i = 0; i < 3000; i++) {
+        rand_record(i);
+        Rid rid = file_handle->insert_record(write_buf.data(), context);
+        ASSERT_EQ(0, mock.count(rid));
+        mock[rid] = std::string(write_buf.data(), record_size);
+    }
+    // 批量插入
+    const int num_batch = 500;
+    std::vector<char> batch_buf(num_batch * record_size);
+    for (int i = 0; i < num_batch; i++) {
+        rand_record(3000 + i);
+        memcpy(batch_buf.data() + i * record_size, write_buf.data(), record_size);
+    }
+    std::vector<Rid> batch_rids;
+    file_handle->insert_records(batch_buf.data(), num_batch, &batch_rids, context);
+    ASSERT_EQ(num_batch, (int)batch_rids.size());
+    for (int i = 0; i < num_batch; i++) {
+        ASSERT_EQ(0, mock.count(batch_rids[i]));
+        mock[batch_rids[i]] = std::string(batch_buf.data() + i * record_size, record_size);
+    }
+    check_equal(file_handle.get(), mock);
+
+    // 随机删除和更新
+    std::vector<Rid> rids;
+    for (auto &entry : mock) {
+        rids.push_back(entry.first);
+    }
+    for (auto &rid : rids) {
+        if (rand() % 3 == 0) {
+            file_handle->delete_record(rid, context);
+            mock.erase(rid);
+        } else if (rand() % 2 == 0) {
+            int key;
+            memcpy(&key, mock[rid].data(), sizeof(int));
+            rand_record(key);
+            file_handle->update_record(rid, write_buf.data(), context);
+            mock[rid] = std::string(write_buf.data(), record_size);
+        }
+    }
+    check_equal(file_handle.get(), mock);
+
+    // 过滤函数只读取第一个字段的列存储区，保留偶数的记录
+    auto filter = [](const RmScan &scan, std::vector<uint8_t> &keep) {
+        const char *column = scan.column_data(0);
+        for (size_t i = 0; i < scan.batch().size(); i++) {
+            int key;
+            memcpy(&key, column + scan.batch()[i].rid.slot_no * sizeof(int), sizeof(int));
+            keep[i] = key % 2 == 0;
+        }
+    };
+    size_t expected = 0;
+    for (auto &entry : mock) {
+        int key;
+        memcpy(&key, entry.second.data(), sizeof(int));
+        expected += key % 2 == 0;
+    }
+    size_t num_records = 0;
+    for (RmScan scan(file_handle.get(), true, filter); !scan.is_end(); scan.next_batch()) {
+        ASSERT_FALSE(scan.batch().empty());
+        for (auto &slot : scan.batch()) {
+            ASSERT_EQ(0, memcmp(slot.data, mock.at(slot.rid).c_str(), record_size));
+            int key;
+            memcpy(&key, slot.data, sizeof(int));
+            EXPECT_EQ(0, key % 2);
+            num_records++;
+        }
+    }
+    EXPECT_EQ(expected, num_records);
+
+    // 重新打开文件
+    rm_manager->close_file(file_handle.get());
+    file_handle = rm_manager->open_file(filename);
+    EXPECT_EQ(RM_FORMAT_PAX, file_handle->file_hdr_.format);
+    check_equal(file_handle.get(), mock);
+
+    rm_manager->close_file(file_handle.get());
+    rm_manager->destroy_file(filename);
+}
+
+/**
+ * @brief 测试整理文件：大量删除之后记录被移动到文件前部的页面，文件末尾的空页面被截断，新页面从截断位置重新分配
+ */
+TEST(RecordManagerTest, VacuumTest) {
+    srand((unsigned)time(nullptr));
+
+    char *result = new char[BUFFER_LENGTH];
+    int offset = 0;
+    Context *context = new Context(nullptr, nullptr, nullptr, result, &offset);
+
+    auto disk_manager = std::make_unique<DiskManager>();
+    auto buffer_pool_manager = std::make_unique<BufferPoolManager>(256, disk_manager.get());
+    auto rm_manager = std::make_unique<RmManager>(disk_manager.get(), buffer_pool_manager.get());
+
+    // 依次测试bitmap格式和slotted格式，slotted格式的字段依次为 INT, VARCHAR(200), INT, VARCHAR(100)
+    std::vector<RmField> var_fields = {{4, 200}, {208, 100}};
+    for (int format : {RM_FORMAT_BITMAP, RM_FORMAT_SLOTTED}) {
+        std::string filename = "vacuum.txt";
+        if (disk_manager->is_file(filename)) {
+            disk_manager->destroy_file(filename);
+        }
+        int record_size = 312;
+        if (format == RM_FORMAT_SLOTTED) {
+            rm_manager->create_file(filename, record_size, RM_FORMAT_SLOTTED, var_fields);
+        } else {
+            rm_manager->create_file(filename, record_size);
+        }
+        auto file_handle = rm_manager->open_file(filename);
+
+        std::unordered_map<Rid, std::string, rid_hash_t, rid_equal_t> mock;
+        std::vector<char> write_buf(record_size);
+        auto rand_record = [&]() {
+            if (format == RM_FORMAT_SLOTTED) {
+                rand_var_record(var_fields, record_size, write_buf.data());
+            } else {
+                for (int i = 0; i < record_size; i++) {
+                    write_buf[i] = static_cast<char>(rand() % 256);
+                }
+            }
+        };
+        for (int i = 0; i < 3000; i++) {
+            rand_record();
+            Rid rid = file_handle->insert_record(write_buf.data(), context);
+            mock[rid] = std::string(write_buf.data(), record_size);
+        }
+        // slotted格式下把部分记录更新到最长，使一些记录移动到其它页面
+        if (format == RM_FORMAT_SLOTTED) {
+            for (int i = 0; i < record_size; i++) {
+                write_buf[i] = static_cast<char>(1 + i % 200);
+            }
+            for (auto &entry : mock) {
+                if (rand() % 10 == 0) {
+                    file_handle->update_record(entry.first, write_buf.data(), context);
+                    entry.second = std::string(write_buf.data(), record_size);
+                }
+            }
+        }
+        // 随机删除九成的记录
+        std::vector<Rid> rids;
+        for (auto &entry : mock) {
+            rids.push_back(entry.first);
+        }
+        for (auto &rid : rids) {
+            if (rand() % 10 != 0) {
+                file_handle->delete_record(rid, context);
+                mock.erase(rid);
+            }
+        }
+        int num_pages = file_handle->file_hdr_.num_pages;
+
+        size_t num_moved = 0;
+        int num_freed = file_handle->vacuum([&](const Rid &old_rid, const Rid &new_rid, const char *record) {
+            ASSERT_EQ(1, mock.count(old_rid));
+            ASSERT_EQ(0, mock.count(new_rid));
+            ASSERT_EQ(0, memcmp(record, mock[old_rid].c_str(), record_size));
+            mock[new_rid] = mock[old_rid];
+            mock.erase(old_rid);
+            num_moved++;
+        });
+        EXPECT_GT(num_moved, 0u);
+        EXPECT_EQ(num_pages - num_freed, file_handle->file_hdr_.num_pages);
+        EXPECT_LT(file_handle->file_hdr_.num_pages, num_pages / 4);
+        EXPECT_EQ(file_handle->file_hdr_.num_pages * PAGE_SIZE, disk_manager->get_file_size(filename));
+        check_equal(file_handle.get(), mock);
+        // 插入和删除累计的记录数变化量不受更新和整理的影响
+        EXPECT_EQ(static_cast<int64_t>(mock.size()), file_handle->get_record_delta());
+        EXPECT_EQ(static_cast<int64_t>(mock.size()), file_handle->take_record_delta());
+        EXPECT_EQ(0, file_handle->get_record_delta());
+
+        // 截断后新页面从文件末尾继续分配
+        for (int i = 0; i < 1000; i++) {
+            rand_record();
+            Rid rid = file_handle->insert_record(write_buf.data(), context);
+            ASSERT_EQ(0, mock.count(rid));
+            ASSERT_LT(rid.page_no, file_handle->file_hdr_.num_pages);
+            mock[rid] = std::string(write_buf.data(), record_size);
+        }
+        check_equal(file_handle.get(), mock);
+
+        // 重新打开文件
+        rm_manager->close_file(file_handle.get());
+        file_handle = rm_manager->open_file(filename);
+        check_equal(file_handle.get(), mock);
+
+        rm_manager->close_file(file_handle.get());
+        rm_manager->destroy_file(filename);
+    }
+}
+
+/**
+ * @brief 测试字典编码：字段值换成字典中的编码写入页面，编码用完之后的新值按原值存放；
+ * 过滤函数只比较页面中的编码，重新打开文件后字典从字典文件中读出
+ */
+TEST(RecordManagerTest, DictEncodingTest) {
+    srand((unsigned)time(nullptr));
+
+    char *result = new char[BUFFER_LENGTH];
+    int offset = 0;
+    Context *context = new Context(nullptr, nullptr, nullptr, result, &offset);
+
+    auto disk_manager = std::make_unique<DiskManager>();
+    auto buffer_pool_manager = std::make_unique<BufferPoolManager>(256, disk_manager.get());
+    auto rm_manager = std::make_unique<RmManager>(disk_manager.get(), buffer_pool_manager.get());
+
+    std::string filename = "dict_encoding.txt";
+    if (disk_manager->is_file(filename)) {
+        rm_manager->destroy_file(filename);
+    }
+    // 字段依次为 INT, CHAR(16)（1字节编码）, VARCHAR(40)
+    std::vector<RmField> var_fields = {{20, 40}};
+    std::vector<RmDictField> dict_fields = {{4, 16, 1}};
+    int record_size = 60;
+    rm_manager->create_file(filename, record_size, RM_FORMAT_SLOTTED, var_fields, false, dict_fields);
+    auto file_handle = rm_manager->open_file(filename);
+    EXPECT_EQ(1, file_handle->file_hdr_.num_dict_fields);
+    EXPECT_TRUE(disk_manager->is_file(filename + RmDictionary::SUFFIX));
+
+    // 300个不同的值，1字节的编码只能表示255个，其余的值按原值存放
+    auto make_record = [&](int i, char *buf) {
+        memset(buf, 0, record_size);
+        memcpy(buf, &i, sizeof(i));
+        snprintf(buf + 4, 16, "name_%d", i % 300);
+        snprintf(buf + 20, 40, "value_%d", rand() % 100000);
+    };
+    std::unordered_map<Rid, std::string, rid_hash_t, rid_equal_t> mock;
+    std::vector<char> write_buf(record_size);
+    for (int i = 0; i < 1200; i++) {
+        make_record(i, write_buf.data());
+        Rid rid = file_handle->insert_record(write_buf.data(), context);
+        mock[rid] = std::string(write_buf.data(), record_size);
+    }
+    EXPECT_EQ(255u, file_handle->get_dictionary().size(0));
+    check_equal(file_handle.get(), mock);
+
+    // 按编码过滤：保留编码相同和转义编码的记录，结果中仍包含全部满足条件的记录
+    auto count_matches = [&](const char *name) {
+        char key[16] = {};
+        snprintf(key, sizeof(key), "%s", name);
+        const RmDictionary *dict = &file_handle->get_dictionary();
+        uint32_t escape = RmDictionary::escape_code(1);
+        RmBatchFilter filter = [dict, key, escape](const RmScan &scan, std::vector<uint8_t> &keep) {
+            uint32_t code = dict->lookup(0, key, 16);
+            for (size_t i = 0; i < scan.batch().size(); i++) {
+                uint32_t stored = scan.dict_code(i, 0);
+                if (stored != escape && stored != code) keep[i] = 0;
+            }
+        };
+        size_t kept = 0, matched = 0;
+        for (RmScan scan(file_handle.get(), true, filter); !scan.is_end(); scan.next_batch()) {
+            for (auto &slot : scan.batch()) {
+                kept++;
+                matched += strncmp(slot.data + 4, key, 16) == 0;
+            }
+        }
+        EXPECT_LT(kept, mock.size() / 2);
+        return matched;
+    };
+    EXPECT_EQ(4u, count_matches("name_7"));
+    EXPECT_EQ(4u, count_matches("name_299"));
+    EXPECT_EQ(0u, count_matches("none"));
+
+    // 更新后重新打开文件
+    for (auto &entry : mock) {
+        if (rand() % 2 == 0) {
+            make_record(rand() % 1000, write_buf.data());
+            file_handle->update_record(entry.first, write_buf.data(), context);
+            entry.second = std::string(write_buf.data(), record_size);
+        }
+    }
+    rm_manager->close_file(file_handle.get());
+    file_handle = rm_manager->open_file(filename);
+    EXPECT_EQ(255u, file_handle->get_dictionary().size(0));
+    check_equal(file_handle.get(), mock);
+
+    rm_manager->close_file(file_handle.get());
+    file_handle.reset();
+    rm_manager->destroy_file(filename);
+    EXPECT_FALSE(disk_manager->is_file(filename + RmDictionary::SUFFIX));
+}
+
+TEST(RecordManagerTest, ZoneMapTest) {
+    char *result = new char[BUFFER_LENGTH];
+    int offset = 0;
+    Context *context = new Context(nullptr, nullptr, nullptr, result, &offset);
+
+    auto disk_manager = std::make_unique<DiskManager>();
+    auto buffer_pool_manager = std::make_unique<BufferPoolManager>(256, disk_manager.get());
+    auto rm_manager = std::make_unique<RmManager>(disk_manager.get(), buffer_pool_manager.get());
+
+    std::string filename = "zone_map.txt";
+    if (disk_manager->is_file(filename)) {
+        rm_manager->destroy_file(filename);
+    }
+    // 字段依次为 INT ts, FLOAT val, CHAR(24)
+    int record_size = 32;
+    std::vector<RmZoneField> zone_fields = {{0, TYPE_INT}, {4, TYPE_FLOAT}};
+    rm_manager->create_file(filename, record_size, RM_FORMAT_BITMAP, {}, false, {}, zone_fields);
+    auto file_handle = rm_manager->open_file(filename);
+    EXPECT_TRUE(disk_manager->is_file(filename + RmZoneMap::SUFFIX));
+
+    // ts按插入顺序递增，只有最后几个页面上有ts >= 4500的记录
+    std::vector<char> write_buf(record_size);
+    auto make_record = [&](int ts, float val) {
+        memset(write_buf.data(), 0, record_size);
+        memcpy(write_buf.data(), &ts, sizeof(ts));
+        memcpy(write_buf.data() + 4, &val, sizeof(val));
+    };
+    std::vector<Rid> rids;
+    for (int ts = 0; ts < 5000; ts++) {
+        make_record(ts, static_cast<float>(ts % 100));
+        rids.push_back(file_handle->insert_record(write_buf.data(), context));
+    }
+    auto count = [&](const std::vector<RmZoneRange> &ranges, int lo, int hi, int *pages) {
+        size_t matched = 0;
+        *pages = 0;
+        for (RmScan scan(file_handle.get(), true, nullptr, nullptr, ranges); !scan.is_end(); scan.next_batch()) {
+            (*pages)++;
+            for (auto &slot : scan.batch()) {
+                int ts;
+                memcpy(&ts, slot.data, sizeof(ts));
+                matched += ts >= lo && ts <= hi;
+            }
+        }
+        return matched;
+    };
+    int num_pages = file_handle->file_hdr_.num_pages - RM_FIRST_RECORD_PAGE;
+    int pages;
+    EXPECT_EQ(500u, count({{0, 4500, 1e9}}, 4500, INT32_MAX, &pages));
+    EXPECT_LT(pages, num_pages / 5);
+    EXPECT_EQ(1u, count({{0, 1234, 1234}}, 1234, 1234, &pages));
+    EXPECT_EQ(1, pages);
+    // FLOAT字段的取值范围覆盖所有页面，不跳过
+    EXPECT_EQ(5000u, count({{1, 0, 99}}, 0, INT32_MAX, &pages));
+    EXPECT_EQ(num_pages, pages);
+
+    // 更新后的值扩大第一个页面的区间，删除不缩小区间
+    make_record(100000, 0);
+    file_handle->update_record(rids[0], write_buf.data(), context);
+    file_handle->delete_record(rids[4999], context);
+    EXPECT_EQ(1u, count({{0, 99999, 1e9}}, 99999, INT32_MAX, &pages));
+    EXPECT_EQ(1, pages);
+
+    // 正常关闭后读入区间映射文件，文件不完整时第一次按区间扫描之前重建
+    rm_manager->close_file(file_handle.get());
+    file_handle = rm_manager->open_file(filename);
+    EXPECT_TRUE(file_handle->zone_map_.is_loaded());
+    EXPECT_EQ(500u, count({{0, 4500, 1e9}}, 4500, INT32_MAX, &pages));
+    rm_manager->close_file(file_handle.get());
+    file_handle.reset();
+    ASSERT_EQ(0, truncate((filename + RmZoneMap::SUFFIX).c_str(), 0));
+    file_handle = rm_manager->open_file(filename);
+    EXPECT_FALSE(file_handle->zone_map_.is_loaded());
+    EXPECT_EQ(500u, count({{0, 4500, 1e9}}, 4500, INT32_MAX, &pages));
+    EXPECT_LT(pages, num_pages / 5);
+    EXPECT_EQ(1u, count({{0, 99999, 1e9}}, 99999, INT32_MAX, &pages));
+
+    rm_manager->close_file(file_handle.get());
+    file_handle.reset();
+    rm_manager->destroy_file(filename);
+    EXPECT_FALSE(disk_manager->is_file(filename + RmZoneMap::SUFFIX));
+}
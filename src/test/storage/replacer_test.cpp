@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "replacer/arc_replacer.h"
+#include "replacer/clock_replacer.h"
+#include "replacer/lru_k_replacer.h"
+#include "replacer/lru_replacer.h"
+
+/**
+ * @brief 测试ClockReplacer的基本功能：引用位为1的帧获得第二次机会
+ */
+TEST(ReplacerTest, ClockSimpleTest) {
+    ClockReplacer clock_replacer(7);
+
+    for (int i = 1; i <= 6; i++) {
+        clock_replacer.unpin(i);
+    }
+    clock_replacer.unpin(1);
+    EXPECT_EQ(6, clock_replacer.Size());
+
+    // 第一圈清除所有引用位，之后按时钟顺序淘汰
+    int value;
+    EXPECT_EQ(true, clock_replacer.victim(&value));
+    EXPECT_EQ(1, value);
+    EXPECT_EQ(true, clock_replacer.victim(&value));
+    EXPECT_EQ(2, value);
+
+    clock_replacer.pin(3);
+    clock_replacer.pin(4);
+    EXPECT_EQ(2, clock_replacer.Size());
+
+    // 4重新设置了引用位，先淘汰5
+    clock_replacer.unpin(4);
+    EXPECT_EQ(true, clock_replacer.victim(&value));
+    EXPECT_EQ(5, value);
+    EXPECT_EQ(true, clock_replacer.victim(&value));
+    EXPECT_EQ(6, value);
+    EXPECT_EQ(true, clock_replacer.victim(&value));
+    EXPECT_EQ(4, value);
+    EXPECT_EQ(false, clock_replacer.victim(&value));
+    EXPECT_EQ(0, clock_replacer.Size());
+}
+
+/**
+ * @brief 并发地pin/unpin后，ClockReplacer淘汰的恰好是所有未被固定的帧
+ */
+TEST(ReplacerTest, ClockConcurrencyTest) {
+    const int num_threads = 5;
+    const int value_size = 1000;
+    ClockReplacer clock_replacer(value_size);
+    std::vector<std::thread> threads;
+    for (int tid = 0; tid < num_threads; tid++) {
+        threads.push_back(std::thread([tid, &clock_replacer]() {
+            int share = value_size / num_threads;
+            for (int i = tid * share; i < (tid + 1) * share; i++) {
+                clock_replacer.unpin(i);
+                if (i % 2 == 0) {
+                    clock_replacer.pin(i);
+                }
+            }
+        }));
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(value_size / 2, clock_replacer.Size());
+    std::vector<int> out_values;
+    int result;
+    while (clock_replacer.victim(&result)) {
+        EXPECT_EQ(1, result % 2);
+        out_values.push_back(result);
+    }
+    EXPECT_EQ(value_size / 2, out_values.size());
+}
+
+/**
+ * @brief 测试LRUKReplacer：访问不足K次的帧优先淘汰，之后按倒数第K次访问时间淘汰
+ */
+TEST(ReplacerTest, LRUKSimpleTest) {
+    LRUKReplacer lru_k_replacer(7, 2);
+
+    // 帧1、2被访问两次，帧3、4只被访问一次
+    for (int i : {1, 2, 3, 4, 1, 2}) {
+        lru_k_replacer.pin(i);
+        lru_k_replacer.unpin(i);
+    }
+    EXPECT_EQ(4, lru_k_replacer.Size());
+
+    int value;
+    EXPECT_EQ(true, lru_k_replacer.victim(&value));
+    EXPECT_EQ(3, value);
+    EXPECT_EQ(true, lru_k_replacer.victim(&value));
+    EXPECT_EQ(4, value);
+
+    // 帧1的倒数第二次访问更早
+    EXPECT_EQ(true, lru_k_replacer.victim(&value));
+    EXPECT_EQ(1, value);
+
+    // 被固定的帧不会被淘汰
+    lru_k_replacer.pin(2);
+    EXPECT_EQ(false, lru_k_replacer.victim(&value));
+    lru_k_replacer.unpin(2);
+    EXPECT_EQ(true, lru_k_replacer.victim(&value));
+    EXPECT_EQ(2, value);
+    EXPECT_EQ(0, lru_k_replacer.Size());
+}
+
+/**
+ * @brief 测试ARCReplacer的抗扫描能力：被访问过两次的热点页面不会被一次性扫描挤出
+ */
+TEST(ReplacerTest, ARCScanResistanceTest) {
+    const int num_frames = 8;
+    ARCReplacer arc_replacer(num_frames);
+
+    // 帧0~3装入热点页面并被访问两次，进入T2
+    for (int i = 0; i < 4; i++) {
+        arc_replacer.record_load(i, 1000 + i);
+        arc_replacer.pin(i);
+        arc_replacer.unpin(i);
+        arc_replacer.pin(i);
+        arc_replacer.unpin(i);
+    }
+    // 帧4~7装入只被访问一次的扫描页面，留在T1
+    for (int i = 4; i < num_frames; i++) {
+        arc_replacer.record_load(i, 2000 + i);
+        arc_replacer.pin(i);
+        arc_replacer.unpin(i);
+    }
+    EXPECT_EQ(num_frames, arc_replacer.Size());
+
+    // 持续扫描新页面时，淘汰的总是T1中的帧
+    std::vector<int64_t> page_keys(num_frames);
+    int value;
+    for (int round = 0; round < 20; round++) {
+        EXPECT_EQ(true, arc_replacer.victim(&value));
+        EXPECT_GE(value, 4);
+        page_keys[value] = 3000 + round;
+        arc_replacer.record_load(value, page_keys[value]);
+        arc_replacer.pin(value);
+        arc_replacer.unpin(value);
+    }
+
+    // 被淘汰的页面再次被装入（命中B1）后直接进入T2，之后的扫描不会再淘汰它
+    EXPECT_EQ(true, arc_replacer.victim(&value));
+    int hot_frame = value;
+    arc_replacer.record_load(hot_frame, page_keys[hot_frame]);
+    arc_replacer.pin(hot_frame);
+    EXPECT_EQ(num_frames - 1, arc_replacer.Size());
+    arc_replacer.unpin(hot_frame);
+    for (int round = 0; round < 10; round++) {
+        EXPECT_EQ(true, arc_replacer.victim(&value));
+        EXPECT_GE(value, 4);
+        EXPECT_NE(hot_frame, value);
+        arc_replacer.record_load(value, 4000 + round);
+        arc_replacer.pin(value);
+        arc_replacer.unpin(value);
+    }
+
+    for (int i = 0; i < num_frames; i++) {
+        EXPECT_EQ(true, arc_replacer.victim(&value));
+    }
+    EXPECT_EQ(false, arc_replacer.victim(&value));
+}
+
+/**
+ * @brief 各替换策略都能淘汰全部未被固定的帧，且每个帧只被淘汰一次
+ */
+TEST(ReplacerTest, MixTest) {
+    const int value_size = 1000;
+    std::vector<std::unique_ptr<Replacer>> replacers;
+    replacers.emplace_back(new ClockReplacer(value_size));
+    replacers.emplace_back(new LRUKReplacer(value_size, 2));
+    replacers.emplace_back(new ARCReplacer(value_size));
+
+    std::vector<int> value(value_size);
+    for (int i = 0; i < value_size; i++) {
+        value[i] = i;
+    }
+    auto rng = std::default_random_engine{};
+    std::shuffle(value.begin(), value.end(), rng);
+
+    for (auto &replacer : replacers) {
+        for (int i = 0; i < value_size; i++) {
+            replacer->pin(value[i]);
+            replacer->unpin(value[i]);
+        }
+        for (int i = 0; i < value_size; i += 3) {
+            replacer->pin(value[i]);
+        }
+        std::vector<int> out_values;
+        int result;
+        while (replacer->victim(&result)) {
+            out_values.push_back(result);
+        }
+        std::vector<int> expected;
+        for (int i = 0; i < value_size; i++) {
+            if (i % 3 != 0) {
+                expected.push_back(value[i]);
+            }
+        }
+        std::sort(expected.begin(), expected.end());
+        std::sort(out_values.begin(), out_values.end());
+        EXPECT_EQ(expected, out_values);
+        EXPECT_EQ(0, replacer->Size());
+    }
+}
+
+/**
+ * @brief 各种替换器列出的淘汰顺序与依次调用victim淘汰的顺序一致
+ */
+TEST(ReplacerTest, EvictionOrderTest) {
+    const int value_size = 64;
+    std::vector<std::unique_ptr<Replacer>> replacers;
+    replacers.emplace_back(new LRUReplacer(value_size));
+    replacers.emplace_back(new ClockReplacer(value_size));
+    replacers.emplace_back(new LRUKReplacer(value_size, 2));
+    replacers.emplace_back(new ARCReplacer(value_size));
+
+    std::vector<int> value(value_size);
+    for (int i = 0; i < value_size; i++) {
+        value[i] = i;
+    }
+    std::shuffle(value.begin(), value.end(), std::default_random_engine{});
+
+    for (auto &replacer : replacers) {
+        for (int v : value) {
+            replacer->pin(v);
+            replacer->unpin(v);
+        }
+        // 部分帧再访问一次，其中一些保持固定
+        for (int i = 0; i < value_size; i += 5) {
+            replacer->pin(value[i]);
+            if (i % 2 == 0) {
+                replacer->unpin(value[i]);
+            }
+        }
+        std::vector<frame_id_t> order;
+        replacer->eviction_order(&order);
+        std::vector<frame_id_t> victims;
+        int result;
+        while (replacer->victim(&result)) {
+            victims.push_back(result);
+        }
+        EXPECT_EQ(victims, order);
+    }
+}
@@ -0,0 +1,107 @@
+/* Copyright (c) 2023 Renmin University of China
+RMDB is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+        http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <random>
+
+#include "gtest/gtest.h"
+#include "storage/temp_storage.h"
+
+const std::string TEST_DIR_NAME = "TempStorageTest_dir";
+
+class TempStorageTest : public ::testing::Test {
+   public:
+    void SetUp() override {
+        ::testing::Test::SetUp();
+        std::string cmd = "rm -rf " + TEST_DIR_NAME;
+        ASSERT_GE(system(cmd.c_str()), 0);
+        ASSERT_EQ(0, mkdir(TEST_DIR_NAME.c_str(), S_IRWXU));
+        TempStorage::instance().set_dir(TEST_DIR_NAME);
+    }
+
+    void TearDown() override {
+        TempStorage::instance().set_dir(TEMP_DIR);
+        TempStorage::instance().set_io_backend(IO_BACKEND);
+    }
+
+    /* 临时目录下的目录项个数，不含.和.. */
+    int num_dir_entries() {
+        DIR *dir = opendir(TEST_DIR_NAME.c_str());
+        int n = 0;
+        while (dirent *entry = readdir(dir)) {
+            if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) n++;
+        }
+        closedir(dir);
+        return n;
+    }
+};
+
+/**
+ * @brief 测试各后端下以不同长度追加、跨越多个块的数据能按原样读出，可以多次rewind重新读取；
+ * 文件创建后目录中没有它的目录项，对象析构后不再计入打开的临时文件
+ */
+TEST_F(TempStorageTest, AppendRewindRead) {
+    for (const std::string backend : {"sync", "io_uring"}) {
+        TempStorage::instance().set_io_backend(backend);
+        size_t files_before = TempStorage::instance().get_num_files();
+        auto file = TempStorage::instance().create_file(1000);
+        EXPECT_EQ(files_before + 1, TempStorage::instance().get_num_files());
+        EXPECT_EQ(0, num_dir_entries());
+
+        std::default_random_engine rng(2024);
+        std::vector<char> expect;
+        while (expect.size() < 50000) {
+            std::vector<char> piece(rng() % 3000 + 1);
+            for (auto &c : piece) c = static_cast<char>(rng());
+            file->append(piece.data(), piece.size());
+            expect.insert(expect.end(), piece.begin(), piece.end());
+        }
+        EXPECT_EQ(expect.size(), file->size());
+
+        for (int pass = 0; pass < 2; pass++) {
+            file->rewind();
+            std::vector<char> actual;
+            std::vector<char> buf(1777);
+            size_t n;
+            while ((n = file->read(buf.data(), buf.size())) > 0) {
+                actual.insert(actual.end(), buf.begin(), buf.begin() + n);
+                if (n < buf.size()) break;
+            }
+            EXPECT_EQ(0u, file->read(buf.data(), buf.size()));
+            ASSERT_EQ(expect, actual);
+        }
+
+        file.reset();
+        EXPECT_EQ(files_before, TempStorage::instance().get_num_files());
+    }
+}
+
+/**
+ * @brief 测试一次读出整个文件，以及空文件和恰好写满整数个块的文件
+ */
+TEST_F(TempStorageTest, WholeFileAndEdgeSizes) {
+    for (size_t len : {size_t(0), size_t(4096), size_t(4096 * 3), size_t(10000)}) {
+        auto file = TempStorage::instance().create_file(4096);
+        std::vector<char> expect(len);
+        for (size_t i = 0; i < len; i++) expect[i] = static_cast<char>(i * 31);
+        file->append(expect.data(), expect.size());
+        file->finish_write();
+        uint64_t written = TempStorage::instance().get_bytes_written();
+        file->rewind();
+        std::vector<char> actual(len + 10);
+        ASSERT_EQ(len, file->read(actual.data(), actual.size()));
+        actual.resize(len);
+        EXPECT_EQ(expect, actual);
+        EXPECT_EQ(written, TempStorage::instance().get_bytes_written());
+    }
+    EXPECT_EQ(0, num_dir_entries());
+}
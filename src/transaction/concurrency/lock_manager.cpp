@@ -9,128 +9,321 @@ MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
 See the Mulan PSL v2 for more details. */
 
 #include "lock_manager.h"
+#include <algorithm>
+#include <functional>
+#include <map>
 #include <optional>
+#include <set>
+
+#include "common/memory_tracker.h"
+#include "common/metrics.h"
+#include "common/query_stats.h"
+#include "common/tracepoint.h"
 
 /**
- * 这里实现 Lab4 要求的两阶段封锁(2PL) + no-wait 死锁预防。
+ * 这里实现 Lab4 要求的两阶段封锁(2PL) + 死锁处理。
  *
  * 核心约束（背诵版）：
  * 1) 2PL：事务在 GROWING 阶段可以申请锁；一旦进入 SHRINKING 阶段，禁止再申请任何锁。
- * 2) no-wait：如果当前锁请求与“已授予(granted)”的锁不相容，则不等待，直接让当前事务回滚（抛 TransactionAbortException）。
+ * 2) 冲突处理（wait_policy_）：
+ *    - no-wait（默认）：如果当前锁请求与“已授予(granted)”的锁不相容，则不等待，直接让当前事务回滚（抛 TransactionAbortException）；
+ *    - wait-die / wound-wait：按事务开始时间戳决定等待还是回滚，等待关系只能从老指向年轻（或反之），不会成环；
+ *    - detection：总是等待，后台线程在等待图中找环并回滚环中最年轻的事务。
+ *    任何等待最长 LOCK_WAIT_TIMEOUT_MS：持锁的事务可能正空闲在客户端一侧，而等锁的语句占着服务端的工作线程。
  * 3) 多粒度锁：表锁(意向锁/表级S/X) 与 行锁(记录S/X) 共同工作。
  */
 
-bool LockManager::compatible_with_granted(const LockRequestQueue &rq, txn_id_t self, LockMode requested) const {
-    auto compat = [](LockMode a, LockMode b) -> bool {
-        // 多粒度锁相容矩阵（简化版，满足本实验）：
-        // IS 兼容 IS/IX/S/SIX；不兼容 X
-        // IX 兼容 IS/IX；不兼容 S/SIX/X
-        // S  兼容 IS/S；不兼容 IX/SIX/X
-        // SIX兼容 IS；不兼容 IX/S/SIX/X
-        // X  不兼容任何
-        if (a == LockMode::EXLUCSIVE || b == LockMode::EXLUCSIVE) return false;
-        if (a == LockMode::S_IX || b == LockMode::S_IX) {
-            LockMode other = (a == LockMode::S_IX) ? b : a;
-            return other == LockMode::INTENTION_SHARED;
-        }
-        if (a == LockMode::SHARED || b == LockMode::SHARED) {
-            LockMode other = (a == LockMode::SHARED) ? b : a;
-            return other == LockMode::SHARED || other == LockMode::INTENTION_SHARED;
-        }
-        if (a == LockMode::INTENTION_EXCLUSIVE || b == LockMode::INTENTION_EXCLUSIVE) {
-            LockMode other = (a == LockMode::INTENTION_EXCLUSIVE) ? b : a;
-            return other == LockMode::INTENTION_EXCLUSIVE || other == LockMode::INTENTION_SHARED;
-        }
-        return true; // IS vs IS
-    };
+std::chrono::milliseconds cycle_detection_interval = std::chrono::milliseconds(50);
+
+LockManager::LockManager(const std::string &wait_policy) {
+    if (wait_policy == "WAIT_DIE") {
+        wait_policy_ = WaitPolicy::WAIT_DIE;
+    } else if (wait_policy == "WOUND_WAIT") {
+        wait_policy_ = WaitPolicy::WOUND_WAIT;
+    } else if (wait_policy == "DETECTION") {
+        wait_policy_ = WaitPolicy::DETECTION;
+    } else {
+        wait_policy_ = WaitPolicy::NO_WAIT;
+    }
+    if (wait_policy_ == WaitPolicy::DETECTION) {
+        detector_running_ = true;
+        detector_thread_ = std::thread(&LockManager::run_cycle_detection, this);
+    }
+}
+
+LockManager::~LockManager() {
+    {
+        std::scoped_lock lock{detector_latch_};
+        if (!detector_running_) {
+            return;
+        }
+        detector_running_ = false;
+    }
+    detector_cv_.notify_all();
+    detector_thread_.join();
+}
+
+LockManager::LockTablePartition &LockManager::partition_of(const LockDataId &lock_data_id) {
+    // 行锁 ID 的低位是 slot_no，同一页上的记录会集中到少数分区；乘法散列后取高位打散
+    uint64_t h = static_cast<uint64_t>(std::hash<LockDataId>()(lock_data_id)) * 0x9E3779B97F4A7C15ULL;
+    return partitions_[(h >> 32) % LOCK_TABLE_PARTITIONS];
+}
+
+bool LockManager::compatible(LockMode a, LockMode b) {
+    // 多粒度锁相容矩阵（简化版，满足本实验）：
+    // IS 兼容 IS/IX/S/SIX；不兼容 X
+    // IX 兼容 IS/IX；不兼容 S/SIX/X
+    // S  兼容 IS/S；不兼容 IX/SIX/X
+    // SIX兼容 IS；不兼容 IX/S/SIX/X
+    // X  不兼容任何
+    if (a == LockMode::EXLUCSIVE || b == LockMode::EXLUCSIVE) return false;
+    if (a == LockMode::S_IX || b == LockMode::S_IX) {
+        LockMode other = (a == LockMode::S_IX) ? b : a;
+        return other == LockMode::INTENTION_SHARED;
+    }
+    if (a == LockMode::SHARED || b == LockMode::SHARED) {
+        LockMode other = (a == LockMode::SHARED) ? b : a;
+        return other == LockMode::SHARED || other == LockMode::INTENTION_SHARED;
+    }
+    if (a == LockMode::INTENTION_EXCLUSIVE || b == LockMode::INTENTION_EXCLUSIVE) {
+        LockMode other = (a == LockMode::INTENTION_EXCLUSIVE) ? b : a;
+        return other == LockMode::INTENTION_EXCLUSIVE || other == LockMode::INTENTION_SHARED;
+    }
+    return true; // IS vs IS
+}
 
+std::vector<const LockManager::LockRequest *> LockManager::blockers(const LockRequestQueue &rq, txn_id_t self,
+                                                                    LockMode requested) const {
+    std::vector<const LockRequest *> result;
+    bool upgrading = rq.upgrading_ == self;
+    bool before_self = true;
     for (const auto &req : rq.request_queue_) {
-        if (!req.granted_) continue;
-        if (req.txn_id_ == self) continue;
-        if (!compat(requested, req.lock_mode_)) return false;
+        if (req.txn_id_ == self) {
+            before_self = false;
+            continue;
+        }
+        LockMode other = req.lock_mode_;
+        if (!req.granted_) {
+            // 升级优先于所有等待者；新请求按先来后到排在先到的等待者之后，避免写锁被源源不断的读锁饿死
+            if (upgrading || !before_self) continue;
+        } else if (rq.upgrading_ == req.txn_id_ && !upgrading) {
+            // 正在等待升级的持有者按升级后的锁模式阻塞新请求
+            other = rq.upgrade_mode_;
+        }
+        if (!compatible(requested, other)) {
+            result.push_back(&req);
+        }
     }
-    return true;
+    return result;
 }
 
-bool LockManager::lock_internal(Transaction *txn, const LockDataId &lock_data_id, LockMode mode) {
-    // 无事务上下文：不加锁（例如系统内部的 undo_ctx）
-    if (txn == nullptr) return true;
+void LockManager::wait_with_policy(std::unique_lock<std::mutex> &lk, std::condition_variable &cv, Transaction *txn,
+                                   AbortReason conflict_reason,
+                                   const std::function<std::vector<Transaction *>()> &blockers) {
+    txn_id_t self = txn->get_transaction_id();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(LOCK_WAIT_TIMEOUT_MS);
+    std::optional<LatencyTimer> wait_timer;    // 第一次等待时开始计时，返回或抛出异常时记录等待的时间
+    // 发生冲突时触发lock_conflict，开始等待时触发lock_wait_start，等待以获得锁(granted=1)或回滚(granted=0)结束时触发lock_wait_done
+    struct WaitProbe {
+        txn_id_t txn_id;
+        bool waiting = false;
+        bool granted = false;
+        ~WaitProbe() {
+            if (waiting) RMDB_TRACE(lock_wait_done, txn_id, granted);
+        }
+    } probe{self};
+    while (true) {
+        auto blocking = blockers();
+        if (blocking.empty()) {
+            probe.granted = true;
+            return;
+        }
+        if (!probe.waiting) RMDB_TRACE(lock_conflict, self, static_cast<int>(wait_policy_));
+        if (wait_policy_ == WaitPolicy::NO_WAIT) {
+            throw TransactionAbortException(self, conflict_reason);
+        }
+        if (txn->abort_requested()) {
+            throw TransactionAbortException(self, wait_policy_ == WaitPolicy::DETECTION
+                                                      ? AbortReason::DEADLOCK_DETECTION
+                                                      : AbortReason::DEADLOCK_PREVENTION);
+        }
+        // 阻塞者在等待期间会变化，每次被唤醒都重新按时间戳判定
+        for (auto *other : blocking) {
+            bool blocker_older = other->get_start_ts() < txn->get_start_ts();
+            if (wait_policy_ == WaitPolicy::WAIT_DIE && blocker_older) {
+                throw TransactionAbortException(self, AbortReason::DEADLOCK_PREVENTION);
+            }
+            if (wait_policy_ == WaitPolicy::WOUND_WAIT && !blocker_older) {
+                other->request_abort();
+            }
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            throw TransactionAbortException(self, AbortReason::LOCK_WAIT_TIMEOUT);
+        }
+        // 一次加锁请求被唤醒多次仍只计一次等待
+        if (!wait_timer.has_value()) {
+            QueryStats::add(QueryStats::LOCK_WAITS);
+            wait_timer.emplace(Metrics::instance().histogram(Metrics::LOCK_WAIT));
+            probe.waiting = true;
+            RMDB_TRACE(lock_wait_start, self);
+        }
+        // 被伤害或被选为牺牲者的事务可能正等在别的队列上，按检测间隔醒来检查 abort_requested
+        cv.wait_for(lk, std::min<std::chrono::steady_clock::duration>(deadline - now, cycle_detection_interval));
+    }
+}
 
-    // 2PL：shrinking 阶段禁止再申请任何锁
-    if (txn->get_state() == TransactionState::SHRINKING) {
-        throw TransactionAbortException(txn->get_transaction_id(), AbortReason::LOCK_ON_SHIRINKING);
+void LockManager::wait_for_grant(std::unique_lock<std::mutex> &lk, LockRequestQueue &rq, Transaction *txn,
+                                 LockMode mode, AbortReason conflict_reason) {
+    wait_with_policy(lk, rq.cv_, txn, conflict_reason, [&]() {
+        std::vector<Transaction *> txns;
+        for (auto *req : blockers(rq, txn->get_transaction_id(), mode)) {
+            txns.push_back(req->txn_);
+        }
+        return txns;
+    });
+}
+
+LockManager::PredicateLockTable &LockManager::predicate_table_of(int tab_fd) {
+    std::scoped_lock lock{predicate_latch_};
+    auto &pt = predicate_tables_[tab_fd];
+    if (pt == nullptr) {
+        pt = std::make_unique<PredicateLockTable>();
     }
+    return *pt;
+}
 
-    std::unique_lock<std::mutex> lk(latch_);
-    auto &rq = lock_table_[lock_data_id];
+std::vector<Transaction *> LockManager::predicate_blockers(const PredicateLockTable &pt, txn_id_t self,
+                                                           const TuplePredicate *pred, const char *tuple) const {
+    std::vector<Transaction *> result;
+    if (pred != nullptr) {
+        // 扫描条件与其他事务写过的、满足条件的记录冲突：这些记录的修改尚未提交，扫描到或扫描不到都可能出错
+        for (const auto &[txn_id, writer] : pt.writers_) {
+            if (txn_id == self) continue;
+            bool hit = writer.escalated_ ||
+                       std::any_of(writer.tuples_.begin(), writer.tuples_.end(),
+                                   [&](const std::string &t) { return (*pred)(t.data()); });
+            if (hit) result.push_back(writer.txn_);
+        }
+    } else {
+        // 写入的记录与其他事务登记的、记录满足的扫描条件冲突：该事务再次扫描会看到不同的结果
+        for (const auto &reader : pt.readers_) {
+            if (reader.txn_->get_transaction_id() == self) continue;
+            if (reader.pred_(tuple)) result.push_back(reader.txn_);
+        }
+    }
+    return result;
+}
+
+void LockManager::wait_for_predicate(std::unique_lock<std::mutex> &lk, PredicateLockTable &pt, Transaction *txn,
+                                     const TuplePredicate *pred, const char *tuple) {
+    if (predicate_blockers(pt, txn->get_transaction_id(), pred, tuple).empty()) {
+        return;
+    }
+    LockAbortCounter abort_counter;
+    auto waiter = pt.waiters_.insert(pt.waiters_.end(), {txn, pred, tuple});
+    try {
+        wait_with_policy(lk, pt.cv_, txn, AbortReason::DEADLOCK_PREVENTION,
+                         [&]() { return predicate_blockers(pt, txn->get_transaction_id(), pred, tuple); });
+    } catch (TransactionAbortException &) {
+        pt.waiters_.erase(waiter);
+        throw;
+    }
+    pt.waiters_.erase(waiter);
+}
 
-    // ========= 升级/包含关系判定小工具 =========
+/**
+ * @description: 同一事务在同一对象上已经持有cur时再申请req，返回需要持有的锁模式，不支持的组合返回空
+ */
+std::optional<LockManager::LockMode> LockManager::combine_mode(LockDataType type, LockMode cur, LockMode req) {
+    // ========= 升级/包含关系判定 =========
     // 说明：同一事务可能在同一对象上先申请“弱锁”，后续又申请“强锁/组合锁”。
     // - 行级：S -> X（UPDATE/DELETE 常见：扫描阶段先读后写）
     // - 表级（多粒度）：IS/IX/S/SIX/X 之间存在升级与“组合”关系
     //   例如：先写表（IX）后读表（S），等价于 SIX（S + IX）。
-    auto combine_mode = [&](LockMode cur, LockMode req) -> std::optional<LockMode> {
-        // 任何场景：已持有 X，后续任何请求都满足
-        if (cur == LockMode::EXLUCSIVE) return cur;
-        // 任何场景：请求 IS，总是被“当前已持有锁”蕴含
-        if (req == LockMode::INTENTION_SHARED) return cur;
-
-        // 行级只会出现 S/X（实验中 record 不使用 IS/IX/SIX）
-        if (lock_data_id.type_ == LockDataType::RECORD) {
-            if (cur == req) return cur;
-            if (cur == LockMode::SHARED && req == LockMode::EXLUCSIVE) return LockMode::EXLUCSIVE;
-            // 例如：cur==X 上面已提前 return；cur==S req==S 已处理；其它都视为不支持
-            return std::nullopt;
-        }
-
-        // ===== 表级：多粒度锁升级矩阵（覆盖本实验所需场景）=====
-        // 目标：保证“单事务先写后读/先读后写”不会因为锁升级缺失而错误 abort。
+    // 任何场景：已持有 X，后续任何请求都满足
+    if (cur == LockMode::EXLUCSIVE) return cur;
+    // 任何场景：请求 IS，总是被“当前已持有锁”蕴含
+    if (req == LockMode::INTENTION_SHARED) return cur;
+
+    // 行级只会出现 S/X（实验中 record 不使用 IS/IX/SIX）
+    if (type == LockDataType::RECORD) {
         if (cur == req) return cur;
+        if (cur == LockMode::SHARED && req == LockMode::EXLUCSIVE) return LockMode::EXLUCSIVE;
+        // 例如：cur==X 上面已提前 return；cur==S req==S 已处理；其它都视为不支持
+        return std::nullopt;
+    }
 
-        // IS -> S / IX / SIX / X（X 可视为最强）
-        if (cur == LockMode::INTENTION_SHARED) {
-            if (req == LockMode::SHARED) return LockMode::SHARED;
-            if (req == LockMode::INTENTION_EXCLUSIVE) return LockMode::INTENTION_EXCLUSIVE;  // 已有专门分支也没关系
-            if (req == LockMode::S_IX) return LockMode::S_IX;
-            if (req == LockMode::EXLUCSIVE) return LockMode::EXLUCSIVE;
-        }
+    // ===== 表级：多粒度锁升级矩阵（覆盖本实验所需场景）=====
+    // 目标：保证“单事务先写后读/先读后写”不会因为锁升级缺失而错误 abort。
+    if (cur == req) return cur;
 
-        // IX -> SIX / X
-        if (cur == LockMode::INTENTION_EXCLUSIVE) {
-            if (req == LockMode::SHARED) return LockMode::S_IX;      // 关键：IX + S => SIX
-            if (req == LockMode::S_IX) return LockMode::S_IX;
-            if (req == LockMode::EXLUCSIVE) return LockMode::EXLUCSIVE;
-            // req==IX：cur==req 已处理
-        }
+    // IS -> S / IX / SIX / X（X 可视为最强）
+    if (cur == LockMode::INTENTION_SHARED) {
+        if (req == LockMode::SHARED) return LockMode::SHARED;
+        if (req == LockMode::INTENTION_EXCLUSIVE) return LockMode::INTENTION_EXCLUSIVE;  // 已有专门分支也没关系
+        if (req == LockMode::S_IX) return LockMode::S_IX;
+        if (req == LockMode::EXLUCSIVE) return LockMode::EXLUCSIVE;
+    }
 
-        // S -> SIX / X
-        if (cur == LockMode::SHARED) {
-            if (req == LockMode::INTENTION_EXCLUSIVE) return LockMode::S_IX; // 关键：S + IX => SIX
-            if (req == LockMode::S_IX) return LockMode::S_IX;
-            if (req == LockMode::EXLUCSIVE) return LockMode::EXLUCSIVE;
-        }
+    // IX -> SIX / X
+    if (cur == LockMode::INTENTION_EXCLUSIVE) {
+        if (req == LockMode::SHARED) return LockMode::S_IX;      // 关键：IX + S => SIX
+        if (req == LockMode::S_IX) return LockMode::S_IX;
+        if (req == LockMode::EXLUCSIVE) return LockMode::EXLUCSIVE;
+        // req==IX：cur==req 已处理
+    }
 
-        // SIX -> X
-        if (cur == LockMode::S_IX) {
-            if (req == LockMode::SHARED) return LockMode::S_IX;
-            if (req == LockMode::INTENTION_EXCLUSIVE) return LockMode::S_IX;
-            if (req == LockMode::EXLUCSIVE) return LockMode::EXLUCSIVE;
-        }
+    // S -> SIX / X
+    if (cur == LockMode::SHARED) {
+        if (req == LockMode::INTENTION_EXCLUSIVE) return LockMode::S_IX; // 关键：S + IX => SIX
+        if (req == LockMode::S_IX) return LockMode::S_IX;
+        if (req == LockMode::EXLUCSIVE) return LockMode::EXLUCSIVE;
+    }
 
-        return std::nullopt;
-    };
+    // SIX -> X
+    if (cur == LockMode::S_IX) {
+        if (req == LockMode::SHARED) return LockMode::S_IX;
+        if (req == LockMode::INTENTION_EXCLUSIVE) return LockMode::S_IX;
+        if (req == LockMode::EXLUCSIVE) return LockMode::EXLUCSIVE;
+    }
+
+    return std::nullopt;
+}
+
+bool LockManager::lock_internal(Transaction *txn, const LockDataId &lock_data_id, LockMode mode) {
+    // 无事务上下文：不加锁（例如系统内部的 undo_ctx）
+    if (txn == nullptr) return true;
+    LockAbortCounter abort_counter;
+
+    // 2PL：shrinking 阶段禁止再申请任何锁
+    if (txn->get_state() == TransactionState::SHRINKING) {
+        throw TransactionAbortException(txn->get_transaction_id(), AbortReason::LOCK_ON_SHIRINKING);
+    }
+    // 已被更老的事务伤害（wound-wait）或被选为死锁牺牲者：在下一次加锁时回滚
+    if (txn->abort_requested()) {
+        throw TransactionAbortException(txn->get_transaction_id(), wait_policy_ == WaitPolicy::DETECTION
+                                                                       ? AbortReason::DEADLOCK_DETECTION
+                                                                       : AbortReason::DEADLOCK_PREVENTION);
+    }
+
+    auto &part = partition_of(lock_data_id);
+    std::unique_lock<std::mutex> lk(part.latch_);
+    auto [qit, inserted] = part.lock_table_.try_emplace(lock_data_id);
+    auto &rq = qit->second;
+    if (inserted) MemoryTracker::subsystem(MemoryTracker::LOCK_TABLE).consume(QUEUE_MEM);
 
     // 1) 重入/升级：查找该事务是否已经在队列中
     for (auto it = rq.request_queue_.begin(); it != rq.request_queue_.end(); ++it) {
         if (it->txn_id_ != txn->get_transaction_id()) continue;
 
         if (!it->granted_) {
-            // no-wait 下我们不会有“等待中的本事务请求”，理论上不会出现；出现就直接 abort，避免状态机走飞。
+            // 一个事务同一时刻只执行一条语句，不会有“等待中的本事务请求”，理论上不会出现；出现就直接 abort，避免状态机走飞。
             throw TransactionAbortException(txn->get_transaction_id(), AbortReason::DEADLOCK_PREVENTION);
         }
 
         auto cur = it->lock_mode_;
-        auto new_mode_opt = combine_mode(cur, mode);
+        auto new_mode_opt = combine_mode(lock_data_id.type_, cur, mode);
         if (!new_mode_opt.has_value()) {
             // 不支持的升级（例如 record 上出现 IX/SIX），或升级关系未定义
             throw TransactionAbortException(txn->get_transaction_id(), AbortReason::UPGRADE_CONFLICT);
@@ -142,23 +335,53 @@ bool LockManager::lock_internal(Transaction *txn, const LockDataId &lock_data_id
             return true;
         }
 
-        // 升级需要与“其它事务已授予锁”相容，否则 no-wait 直接 abort
-        if (!compatible_with_granted(rq, txn->get_transaction_id(), new_mode)) {
-            throw TransactionAbortException(txn->get_transaction_id(), AbortReason::UPGRADE_CONFLICT);
+        // 升级需要与“其它事务已授予锁”相容，否则按策略等待或 abort
+        if (rq.upgrading_ != INVALID_TXN_ID) {
+            // 两个事务同时等待升级必然互相等待，不能直接升级时后来者 abort
+            for (const auto &other : rq.request_queue_) {
+                if (other.granted_ && other.txn_id_ != txn->get_transaction_id() &&
+                    !compatible(new_mode, other.lock_mode_)) {
+                    throw TransactionAbortException(txn->get_transaction_id(), AbortReason::UPGRADE_CONFLICT);
+                }
+            }
+        } else {
+            rq.upgrading_ = txn->get_transaction_id();
+            rq.upgrade_mode_ = new_mode;
+            try {
+                wait_for_grant(lk, rq, txn, new_mode, AbortReason::UPGRADE_CONFLICT);
+            } catch (TransactionAbortException &) {
+                // 放弃升级后被它挡住的新请求可能可以授予了
+                rq.upgrading_ = INVALID_TXN_ID;
+                rq.cv_.notify_all();
+                throw;
+            }
+            rq.upgrading_ = INVALID_TXN_ID;
         }
 
         it->lock_mode_ = new_mode;
+        QueryStats::add(QueryStats::LOCKS_ACQUIRED);
         return true;
     }
 
-    // 2) 新请求：检查与其他已授予锁相容性
-    if (!compatible_with_granted(rq, txn->get_transaction_id(), mode)) {
-        throw TransactionAbortException(txn->get_transaction_id(), AbortReason::DEADLOCK_PREVENTION);
+    // 2) 新请求：检查与其他已授予锁及先到的等待者是否相容，不相容时按策略等待或 abort
+    auto req = rq.request_queue_.emplace(rq.request_queue_.end(), txn, mode);
+    try {
+        wait_for_grant(lk, rq, txn, mode, AbortReason::DEADLOCK_PREVENTION);
+    } catch (TransactionAbortException &) {
+        rq.request_queue_.erase(req);
+        // 超时的同时持有者可能恰好全部释放，队列为空时回收；否则排在后面的等待者可能可以授予了
+        if (rq.request_queue_.empty()) {
+            part.lock_table_.erase(lock_data_id);
+            MemoryTracker::subsystem(MemoryTracker::LOCK_TABLE).release(QUEUE_MEM);
+        } else {
+            rq.cv_.notify_all();
+        }
+        throw;
     }
 
-    // 3) 直接授予（no-wait，不进入等待队列）
-    rq.request_queue_.emplace_back(txn->get_transaction_id(), mode);
-    rq.request_queue_.back().granted_ = true;
+    // 3) 授予
+    req->granted_ = true;
+    QueryStats::add(QueryStats::LOCKS_ACQUIRED);
 
     // 4) 记录到事务 lock_set_，便于 commit/abort 统一释放
     txn->get_lock_set()->insert(lock_data_id);
@@ -174,9 +397,10 @@ bool LockManager::lock_internal(Transaction *txn, const LockDataId &lock_data_id
  * @param {int} tab_fd
  */
 bool LockManager::lock_shared_on_record(Transaction* txn, const Rid& rid, int tab_fd) {
-    // 行锁：S
+    // 行锁：S；持有的表锁已经蕴含 S 时不再加行锁
+    if (txn == nullptr || table_lock_covers(txn, tab_fd, LockMode::SHARED)) return true;
     LockDataId lid(tab_fd, rid, LockDataType::RECORD);
-    return lock_internal(txn, lid, LockMode::SHARED);
+    return lock_row(txn, lid, LockMode::SHARED);
 }
 
 /**
@@ -187,9 +411,10 @@ bool LockManager::lock_shared_on_record(Transaction* txn, const Rid& rid, int ta
  * @param {int} tab_fd 记录所在的表的fd
  */
 bool LockManager::lock_exclusive_on_record(Transaction* txn, const Rid& rid, int tab_fd) {
-    // 行锁：X（可能触发从 S 升级到 X）
+    // 行锁：X（可能触发从 S 升级到 X）；持有表级 X 锁时不再加行锁
+    if (txn == nullptr || table_lock_covers(txn, tab_fd, LockMode::EXLUCSIVE)) return true;
     LockDataId lid(tab_fd, rid, LockDataType::RECORD);
-    return lock_internal(txn, lid, LockMode::EXLUCSIVE);
+    return lock_row(txn, lid, LockMode::EXLUCSIVE);
 }
 
 /**
@@ -199,8 +424,7 @@ bool LockManager::lock_exclusive_on_record(Transaction* txn, const Rid& rid, int
  * @param {int} tab_fd 目标表的fd
  */
 bool LockManager::lock_shared_on_table(Transaction* txn, int tab_fd) {
-    LockDataId lid(tab_fd, LockDataType::TABLE);
-    return lock_internal(txn, lid, LockMode::SHARED);
+    return lock_table(txn, tab_fd, LockMode::SHARED);
 }
 
 /**
@@ -210,8 +434,7 @@ bool LockManager::lock_shared_on_table(Transaction* txn, int tab_fd) {
  * @param {int} tab_fd 目标表的fd
  */
 bool LockManager::lock_exclusive_on_table(Transaction* txn, int tab_fd) {
-    LockDataId lid(tab_fd, LockDataType::TABLE);
-    return lock_internal(txn, lid, LockMode::EXLUCSIVE);
+    return lock_table(txn, tab_fd, LockMode::EXLUCSIVE);
 }
 
 /**
@@ -221,8 +444,7 @@ bool LockManager::lock_exclusive_on_table(Transaction* txn, int tab_fd) {
  * @param {int} tab_fd 目标表的fd
  */
 bool LockManager::lock_IS_on_table(Transaction* txn, int tab_fd) {
-    LockDataId lid(tab_fd, LockDataType::TABLE);
-    return lock_internal(txn, lid, LockMode::INTENTION_SHARED);
+    return lock_table(txn, tab_fd, LockMode::INTENTION_SHARED);
 }
 
 /**
@@ -232,8 +454,225 @@ bool LockManager::lock_IS_on_table(Transaction* txn, int tab_fd) {
  * @param {int} tab_fd 目标表的fd
  */
 bool LockManager::lock_IX_on_table(Transaction* txn, int tab_fd) {
+    return lock_table(txn, tab_fd, LockMode::INTENTION_EXCLUSIVE);
+}
+
+/**
+ * @description: 事务持有的表锁是否已经蕴含 mode。被要求回滚的事务总是走完整的加锁路径，在那里回滚
+ */
+bool LockManager::table_lock_covers(Transaction *txn, int tab_fd, LockMode mode) {
+    if (txn->abort_requested()) return false;
+    auto &table_locks = txn->get_table_locks();
+    auto it = table_locks.find(tab_fd);
+    if (it == table_locks.end()) return false;
+    const TableLockState &state = it->second;
+    switch (mode) {
+        case LockMode::INTENTION_SHARED: return state.intention_shared_;
+        case LockMode::INTENTION_EXCLUSIVE: return state.intention_exclusive_;
+        case LockMode::SHARED: return state.shared_;
+        case LockMode::S_IX: return state.shared_ && state.intention_exclusive_;
+        case LockMode::EXLUCSIVE: return state.exclusive_;
+    }
+    return false;
+}
+
+/**
+ * @description: 在事务的表锁缓存中记下新授予的表锁 mode，与已经记下的锁模式合并
+ */
+void LockManager::note_table_lock(Transaction *txn, int tab_fd, LockMode mode) {
+    TableLockState &state = txn->get_table_locks()[tab_fd];
+    state.intention_shared_ = true;
+    if (mode == LockMode::INTENTION_EXCLUSIVE || mode == LockMode::S_IX || mode == LockMode::EXLUCSIVE) {
+        state.intention_exclusive_ = true;
+    }
+    if (mode == LockMode::SHARED || mode == LockMode::S_IX || mode == LockMode::EXLUCSIVE) {
+        state.shared_ = true;
+    }
+    if (mode == LockMode::EXLUCSIVE) {
+        state.exclusive_ = true;
+    }
+}
+
+/**
+ * @description: 申请表锁，已经持有蕴含 mode 的表锁时直接返回，不访问锁表
+ */
+bool LockManager::lock_table(Transaction *txn, int tab_fd, LockMode mode) {
+    if (txn == nullptr || table_lock_covers(txn, tab_fd, mode)) return true;
     LockDataId lid(tab_fd, LockDataType::TABLE);
-    return lock_internal(txn, lid, LockMode::INTENTION_EXCLUSIVE);
+    lock_internal(txn, lid, mode);
+    note_table_lock(txn, tab_fd, mode);
+    return true;
+}
+
+/**
+ * @description: 申请行锁并计数，事务在该表上的行锁达到阈值时尝试升级为表锁
+ */
+bool LockManager::lock_row(Transaction *txn, const LockDataId &lock_data_id, LockMode mode) {
+    size_t held = txn->get_lock_set()->size();
+    lock_internal(txn, lock_data_id, mode);
+    if (txn->get_lock_set()->size() == held) {
+        // 已经持有该行锁（重入或 S 升级为 X），行锁个数不变
+        return true;
+    }
+    TableLockState &state = txn->get_table_locks()[lock_data_id.fd_];
+    if (++state.row_locks_ >= state.escalate_at_) {
+        escalate(txn, lock_data_id.fd_, mode);
+    }
+    return true;
+}
+
+/**
+ * @description: 把事务在表上的行锁升级为表锁：行锁为 X 时升级为表级 X，否则为表级 S（已持有 IX 时为 SIX），
+ *              然后释放被表锁蕴含的行锁。升级不等待：与其他事务的锁冲突时保留行锁，行锁再增加一个阈值后再尝试
+ * @param {Transaction*} txn 要升级锁的事务
+ * @param {int} tab_fd 目标表的fd
+ * @param {LockMode} row_mode 触发升级的行锁模式
+ */
+void LockManager::escalate(Transaction *txn, int tab_fd, LockMode row_mode) {
+    LockDataId table_id(tab_fd, LockDataType::TABLE);
+    LockMode new_mode = row_mode;
+    bool granted = false;
+    {
+        auto &part = partition_of(table_id);
+        std::unique_lock<std::mutex> lk(part.latch_);
+        auto qit = part.lock_table_.find(table_id);
+        if (qit != part.lock_table_.end() && qit->second.upgrading_ == INVALID_TXN_ID) {
+            auto &rq = qit->second;
+            for (auto &req : rq.request_queue_) {
+                if (req.txn_id_ != txn->get_transaction_id() || !req.granted_) continue;
+                auto combined = combine_mode(LockDataType::TABLE, req.lock_mode_, row_mode);
+                if (!combined.has_value()) break;
+                new_mode = combined.value();
+                // 按升级的规则判断冲突：只看其他事务已授予的锁
+                rq.upgrading_ = req.txn_id_;
+                granted = blockers(rq, req.txn_id_, new_mode).empty();
+                rq.upgrading_ = INVALID_TXN_ID;
+                if (granted) {
+                    req.lock_mode_ = new_mode;
+                }
+                break;
+            }
+        }
+    }
+    TableLockState &state = txn->get_table_locks()[tab_fd];
+    if (!granted) {
+        state.escalate_at_ = state.row_locks_ + LOCK_ESCALATION_THRESHOLD;
+        return;
+    }
+    note_table_lock(txn, tab_fd, new_mode);
+    state.row_locks_ = release_row_locks(txn, tab_fd, new_mode == LockMode::EXLUCSIVE);
+    state.escalate_at_ = state.row_locks_ + LOCK_ESCALATION_THRESHOLD;
+}
+
+/**
+ * @description: 升级为表锁之后释放事务在表上被表锁蕴含的行锁。仍持有覆盖它们的表锁，不进入 SHRINKING 阶段
+ * @return {size_t} 保留的行锁个数
+ * @param {bool} all 表锁为 X 时释放全部行锁，否则只释放行级 S 锁
+ */
+size_t LockManager::release_row_locks(Transaction *txn, int tab_fd, bool all) {
+    auto lock_set = txn->get_lock_set();
+    size_t kept = 0;
+    for (auto it = lock_set->begin(); it != lock_set->end();) {
+        if (it->type_ != LockDataType::RECORD || it->fd_ != tab_fd) {
+            ++it;
+            continue;
+        }
+        auto &part = partition_of(*it);
+        std::unique_lock<std::mutex> lk(part.latch_);
+        auto qit = part.lock_table_.find(*it);
+        if (qit == part.lock_table_.end()) {
+            it = lock_set->erase(it);
+            continue;
+        }
+        auto &rq = qit->second;
+        auto req = std::find_if(rq.request_queue_.begin(), rq.request_queue_.end(),
+                                [&](const LockRequest &r) { return r.txn_id_ == txn->get_transaction_id(); });
+        if (req != rq.request_queue_.end() && !all && req->lock_mode_ == LockMode::EXLUCSIVE) {
+            kept++;
+            ++it;
+            continue;
+        }
+        if (req != rq.request_queue_.end()) {
+            rq.request_queue_.erase(req);
+        }
+        if (rq.request_queue_.empty()) {
+            part.lock_table_.erase(qit);
+            MemoryTracker::subsystem(MemoryTracker::LOCK_TABLE).release(QUEUE_MEM);
+        } else {
+            rq.cv_.notify_all();
+        }
+        it = lock_set->erase(it);
+    }
+    return kept;
+}
+
+/**
+ * @description: 登记扫描条件（谓词锁），代替表级 S 锁防止幻读：
+ *              其他事务之后写入满足条件的记录会冲突，而写入范围之外的记录可以与扫描并发进行
+ * @return {bool} 返回加锁是否成功
+ * @param {Transaction*} txn 要申请锁的事务对象指针
+ * @param {int} tab_fd 目标表的fd
+ * @param {TuplePredicate} pred 扫描条件，锁持有到事务结束，不能引用扫描算子的状态
+ */
+bool LockManager::lock_shared_on_predicate(Transaction* txn, int tab_fd, TuplePredicate pred) {
+    if (txn == nullptr) return true;
+    lock_IS_on_table(txn, tab_fd);
+    auto &pt = predicate_table_of(tab_fd);
+    std::unique_lock<std::mutex> lk(pt.latch_);
+    wait_for_predicate(lk, pt, txn, &pred, nullptr);
+    pt.readers_.push_back({txn, std::move(pred)});
+    QueryStats::add(QueryStats::LOCKS_ACQUIRED);
+    txn->get_lock_set()->insert(LockDataId(tab_fd, LockDataType::PREDICATE));
+    return true;
+}
+
+/**
+ * @description: 写入记录前检查其他事务登记的扫描条件，并记下该记录供之后的扫描检查
+ * @return {bool} 返回加锁是否成功
+ * @param {Transaction*} txn 要申请锁的事务对象指针
+ * @param {int} tab_fd 目标表的fd
+ * @param {char*} record 写入的记录
+ * @param {int} size 记录的长度
+ */
+bool LockManager::lock_exclusive_on_tuple(Transaction* txn, int tab_fd, const char *record, int size) {
+    if (txn == nullptr) return true;
+    auto &pt = predicate_table_of(tab_fd);
+    std::unique_lock<std::mutex> lk(pt.latch_);
+    wait_for_predicate(lk, pt, txn, nullptr, record);
+    auto &writer = pt.writers_[txn->get_transaction_id()];
+    if (writer.txn_ == nullptr) {
+        writer.txn_ = txn;
+        txn->get_lock_set()->insert(LockDataId(tab_fd, LockDataType::PREDICATE));
+    }
+    if (!writer.escalated_) {
+        if (writer.tuples_.size() < static_cast<size_t>(PREDICATE_LOCK_MAX_TUPLES)) {
+            writer.tuples_.emplace_back(record, size);
+        } else {
+            writer.escalated_ = true;
+            std::vector<std::string>().swap(writer.tuples_);
+        }
+    }
+    return true;
+}
+
+/**
+ * @description: 删除、更新记录前是否需要读出旧记录调用 lock_exclusive_on_tuple
+ * @return {bool} 需要时返回true
+ * @param {Transaction*} txn 要申请锁的事务对象指针
+ * @param {int} tab_fd 目标表的fd
+ */
+bool LockManager::tuple_lock_required(Transaction* txn, int tab_fd) {
+    if (txn == nullptr) return false;
+    auto &pt = predicate_table_of(tab_fd);
+    std::scoped_lock lock{pt.latch_};
+    auto it = pt.writers_.find(txn->get_transaction_id());
+    if (it == pt.writers_.end() || !it->second.escalated_) {
+        return true;
+    }
+    // 已经与所有扫描冲突，之后登记的扫描一定会被挡住，只需检查已登记的扫描
+    return std::any_of(pt.readers_.begin(), pt.readers_.end(), [&](const PredicateLockTable::Reader &reader) {
+        return reader.txn_ != txn;
+    });
 }
 
 /**
@@ -245,9 +684,24 @@ bool LockManager::lock_IX_on_table(Transaction* txn, int tab_fd) {
 bool LockManager::unlock(Transaction* txn, LockDataId lock_data_id) {
     if (txn == nullptr) return true;
 
-    std::unique_lock<std::mutex> lk(latch_);
-    auto it = lock_table_.find(lock_data_id);
-    if (it == lock_table_.end()) {
+    if (lock_data_id.type_ == LockDataType::PREDICATE) {
+        auto &pt = predicate_table_of(lock_data_id.fd_);
+        std::unique_lock<std::mutex> lk(pt.latch_);
+        pt.readers_.remove_if([&](const PredicateLockTable::Reader &reader) { return reader.txn_ == txn; });
+        pt.writers_.erase(txn->get_transaction_id());
+        pt.cv_.notify_all();
+        lk.unlock();
+        txn->get_lock_set()->erase(lock_data_id);
+        if (txn->get_state() == TransactionState::GROWING) {
+            txn->set_state(TransactionState::SHRINKING);
+        }
+        return true;
+    }
+
+    auto &part = partition_of(lock_data_id);
+    std::unique_lock<std::mutex> lk(part.latch_);
+    auto it = part.lock_table_.find(lock_data_id);
+    if (it == part.lock_table_.end()) {
         // 解一个不存在的锁：视为幂等成功（更利于上层“释放全部锁”的简单实现）
         return true;
     }
@@ -262,13 +716,19 @@ bool LockManager::unlock(Transaction* txn, LockDataId lock_data_id) {
         }
     }
 
-    // no-wait 策略下没有阻塞队列需要唤醒，但我们仍然维护锁表大小，避免泄漏
+    // 队列为空时删除以免锁表无限增长，否则唤醒等待该数据项的事务
     if (rq.request_queue_.empty()) {
-        lock_table_.erase(it);
+        part.lock_table_.erase(it);
+        MemoryTracker::subsystem(MemoryTracker::LOCK_TABLE).release(QUEUE_MEM);
+    } else {
+        rq.cv_.notify_all();
     }
 
-    // 从事务 lock_set_ 中删除该锁
+    // 从事务 lock_set_ 中删除该锁，表锁缓存中不再蕴含该表上的锁
     txn->get_lock_set()->erase(lock_data_id);
+    if (lock_data_id.type_ == LockDataType::TABLE) {
+        txn->get_table_locks().erase(lock_data_id.fd_);
+    }
 
     // 释放锁意味着事务进入 SHRINKING（严格 2PL：一旦释放任何锁就进入 shrinking）
     // 注意：事务管理器在 commit/abort 前会主动设置 SHRINKING，这里再设置是幂等的。
@@ -277,4 +737,101 @@ bool LockManager::unlock(Transaction* txn, LockDataId lock_data_id) {
     }
 
     return true;
-}
\ No newline at end of file
+}
+void LockManager::run_cycle_detection() {
+    std::unique_lock<std::mutex> lk(detector_latch_);
+    while (detector_running_) {
+        detector_cv_.wait_for(lk, cycle_detection_interval);
+        if (!detector_running_) {
+            break;
+        }
+        lk.unlock();
+        break_cycles();
+        lk.lock();
+    }
+}
+
+void LockManager::break_cycles() {
+    // 按分区顺序持有全部分区和谓词锁的 latch，得到等待图的一致快照；加锁路径同一时刻只持有其中一个，不会与这里死锁
+    std::vector<std::unique_lock<std::mutex>> latches;
+    latches.reserve(LOCK_TABLE_PARTITIONS);
+    for (auto &part : partitions_) {
+        latches.emplace_back(part.latch_);
+    }
+
+    // 等待者 -> 挡住它的持有者和先到的等待者；std::map/std::set 保证按事务ID从小到大搜索，结果确定
+    std::map<txn_id_t, std::set<txn_id_t>> waits_for;
+    std::unordered_map<txn_id_t, Transaction *> txns;
+    std::unordered_map<txn_id_t, std::condition_variable *> waiting_on;
+    for (auto &part : partitions_) {
+        for (auto &[lock_data_id, rq] : part.lock_table_) {
+            for (auto &waiter : rq.request_queue_) {
+                LockMode mode = waiter.lock_mode_;
+                if (waiter.granted_) {
+                    if (rq.upgrading_ != waiter.txn_id_) continue;
+                    mode = rq.upgrade_mode_;
+                }
+                txns[waiter.txn_id_] = waiter.txn_;
+                waiting_on[waiter.txn_id_] = &rq.cv_;
+                for (auto *blocker : blockers(rq, waiter.txn_id_, mode)) {
+                    waits_for[waiter.txn_id_].insert(blocker->txn_id_);
+                }
+            }
+        }
+    }
+    // 等待谓词锁的事务 -> 挡住它的事务
+    std::unique_lock<std::mutex> predicate_lock(predicate_latch_);
+    for (auto &[tab_fd, pt] : predicate_tables_) {
+        latches.emplace_back(pt->latch_);
+        for (auto &waiter : pt->waiters_) {
+            txn_id_t self = waiter.txn_->get_transaction_id();
+            txns[self] = waiter.txn_;
+            waiting_on[self] = &pt->cv_;
+            for (auto *blocker : predicate_blockers(*pt, self, waiter.pred_, waiter.tuple_)) {
+                txns[blocker->get_transaction_id()] = blocker;
+                waits_for[self].insert(blocker->get_transaction_id());
+            }
+        }
+    }
+
+    // 在等待图中做深度优先搜索，找到环就回滚其中事务ID最大（最年轻）的事务，并从图中删除它后继续找
+    while (true) {
+        std::unordered_map<txn_id_t, int> color;  // 0 未访问，1 在搜索栈上，2 已完成
+        std::vector<txn_id_t> stack;
+        txn_id_t victim = INVALID_TXN_ID;
+        std::function<bool(txn_id_t)> dfs = [&](txn_id_t u) -> bool {
+            color[u] = 1;
+            stack.push_back(u);
+            auto it = waits_for.find(u);
+            if (it != waits_for.end()) {
+                for (txn_id_t v : it->second) {
+                    if (color[v] == 1) {
+                        // 栈上从 v 到 u 的部分就是环
+                        for (auto sit = stack.rbegin(); sit != stack.rend(); ++sit) {
+                            victim = std::max(victim, *sit);
+                            if (*sit == v) break;
+                        }
+                        return true;
+                    }
+                    if (color[v] == 0 && dfs(v)) return true;
+                }
+            }
+            color[u] = 2;
+            stack.pop_back();
+            return false;
+        };
+        bool found = false;
+        for (auto &[u, _] : waits_for) {
+            if (color[u] == 0 && dfs(u)) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            break;
+        }
+        txns[victim]->request_abort();
+        waiting_on[victim]->notify_all();
+        waits_for.erase(victim);
+    }
+}
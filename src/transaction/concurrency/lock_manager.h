@@ -12,6 +12,9 @@ See the Mulan PSL v2 for more details. */
 
 #include <mutex>
 #include <condition_variable>
+#include <functional>
+#include <optional>
+#include <thread>
 #include "transaction/transaction.h"
 
 static const std::string GroupLockModeStr[10] = {"NON_LOCK", "IS", "IX", "S", "X", "SIX"};
@@ -26,9 +29,10 @@ class LockManager {
     /* 事务的加锁申请 */
     class LockRequest {
     public:
-        LockRequest(txn_id_t txn_id, LockMode lock_mode)
-            : txn_id_(txn_id), lock_mode_(lock_mode), granted_(false) {}
+        LockRequest(Transaction *txn, LockMode lock_mode)
+            : txn_(txn), txn_id_(txn->get_transaction_id()), lock_mode_(lock_mode), granted_(false) {}
 
+        Transaction *txn_;      // 申请加锁的事务，请求留在队列中期间事务对象一定有效
         txn_id_t txn_id_;   // 申请加锁的事务ID
         LockMode lock_mode_;    // 事务申请加锁的类型
         bool granted_;          // 该事务是否已经被赋予锁
@@ -40,12 +44,30 @@ class LockManager {
         std::list<LockRequest> request_queue_;  // 加锁队列
         std::condition_variable cv_;            // 条件变量，用于唤醒正在等待加锁的申请，在no-wait策略下无需使用
         GroupLockMode group_lock_mode_ = GroupLockMode::NON_LOCK;   // 加锁队列的锁模式
+        txn_id_t upgrading_ = INVALID_TXN_ID;   // 正在等待升级已持有锁的事务，同一时刻只允许一个
+        LockMode upgrade_mode_ = LockMode::SHARED;  // upgrading_ 等待升级到的锁模式
     };
 
 public:
-    LockManager() {}
+    /* 锁冲突时的处理策略 */
+    enum class WaitPolicy {
+        NO_WAIT,        // 不等待，申请锁的事务直接回滚
+        WAIT_DIE,       // 比所有冲突持有者都老的事务等待，否则回滚
+        WOUND_WAIT,     // 更老的事务使冲突的年轻持有者回滚后等待，年轻的事务直接等待
+        DETECTION       // 直接等待，由后台线程每隔 cycle_detection_interval 检测等待图中的环
+    };
+
+    /**
+     * @param wait_policy 锁冲突的处理策略，可选"NO_WAIT"、"WAIT_DIE"、"WOUND_WAIT"、"DETECTION"，未知的名称使用NO_WAIT
+     */
+    explicit LockManager(const std::string &wait_policy = LOCK_WAIT_POLICY);
+
+    ~LockManager();
+
+    WaitPolicy get_wait_policy() const { return wait_policy_; }
 
-    ~LockManager() {}
+    /* 谓词锁中扫描登记的条件，参数为表中一条完整记录的数据 */
+    using TuplePredicate = std::function<bool(const char *record)>;
 
     bool lock_shared_on_record(Transaction* txn, const Rid& rid, int tab_fd);
 
@@ -59,21 +81,136 @@ public:
 
     bool lock_IX_on_table(Transaction* txn, int tab_fd);
 
+    /**
+     * @brief 扫描开始前加表级 IS 锁并登记扫描条件，与其他事务写过的满足条件的记录冲突，代替表级 S 锁防止幻读
+     */
+    bool lock_shared_on_predicate(Transaction* txn, int tab_fd, TuplePredicate pred);
+
+    /**
+     * @brief 写入一条记录（插入的新记录，删除、更新前后的记录）前调用，与其他事务登记的、记录满足的扫描条件冲突
+     */
+    bool lock_exclusive_on_tuple(Transaction* txn, int tab_fd, const char *record, int size);
+
+    /**
+     * @brief 删除、更新之前是否需要读出旧记录调用 lock_exclusive_on_tuple：
+     *        事务在该表上记下的记录超过 PREDICATE_LOCK_MAX_TUPLES 后与所有扫描冲突，只需检查其他事务已登记的扫描条件
+     */
+    bool tuple_lock_required(Transaction* txn, int tab_fd);
+
     bool unlock(Transaction* txn, LockDataId lock_data_id);
 
 private:
-    std::mutex latch_;      // 用于锁表的并发
-    std::unordered_map<LockDataId, LockRequestQueue> lock_table_;   // 全局锁表
+    /* 一张表上的谓词锁 */
+    struct PredicateLockTable {
+        struct Reader {
+            Transaction *txn_;
+            TuplePredicate pred_;
+        };
+        struct Writer {
+            Transaction *txn_ = nullptr;
+            std::vector<std::string> tuples_;   // 事务写过的记录
+            bool escalated_ = false;            // tuples_ 放不下，视为写过表中所有记录
+        };
+        struct Waiter {
+            Transaction *txn_;
+            const TuplePredicate *pred_;        // 等待登记的扫描条件，等待写入记录时为nullptr
+            const char *tuple_;                 // 等待写入的记录
+        };
+
+        std::mutex latch_;
+        std::condition_variable cv_;
+        std::list<Reader> readers_;
+        std::unordered_map<txn_id_t, Writer> writers_;
+        std::list<Waiter> waiters_;             // 供死锁检测构造等待图
+    };
+
+    std::mutex predicate_latch_;    // 用于 predicate_tables_ 的并发
+    std::unordered_map<int, std::unique_ptr<PredicateLockTable>> predicate_tables_;   // 表的fd -> 表上的谓词锁
+
+    /** @brief 返回表上的谓词锁，第一次访问时创建 */
+    PredicateLockTable &predicate_table_of(int tab_fd);
+
+    /** @brief 返回挡住 self 登记扫描条件 pred（pred 为空时为写入记录 tuple）的其他事务 */
+    std::vector<Transaction *> predicate_blockers(const PredicateLockTable &pt, txn_id_t self,
+                                                  const TuplePredicate *pred, const char *tuple) const;
+
+    /** @brief 在 pt 上按 wait_policy_ 等待直到没有挡住的事务 */
+    void wait_for_predicate(std::unique_lock<std::mutex> &lk, PredicateLockTable &pt, Transaction *txn,
+                            const TuplePredicate *pred, const char *tuple);
+
+    /* 锁表的一个分区：LockDataId 按哈希分到各分区，分区之间的加锁互不阻塞 */
+    struct alignas(64) LockTablePartition {
+        std::mutex latch_;      // 用于该分区锁表的并发
+        std::unordered_map<LockDataId, LockRequestQueue> lock_table_;   // 该分区的锁表，队列为空即删除
+    };
+
+    LockTablePartition partitions_[LOCK_TABLE_PARTITIONS];  // 全局锁表
+
+    // 锁表中一个数据项的请求队列大约占用的内存：哈希表结点、桶指针以及队列中的第一个请求，计入LOCK_TABLE
+    static constexpr size_t QUEUE_MEM =
+        sizeof(std::pair<const LockDataId, LockRequestQueue>) + sizeof(LockRequest) + 4 * sizeof(void *);
+
+    /** @brief 返回 lock_data_id 所在的锁表分区 */
+    LockTablePartition &partition_of(const LockDataId &lock_data_id);
+
+    WaitPolicy wait_policy_;
+
+    std::thread detector_thread_;           // 死锁检测线程，只在 DETECTION 策略下运行
+    std::mutex detector_latch_;
+    std::condition_variable detector_cv_;
+    bool detector_running_ = false;
 
     /**
-     * @brief 内部通用加锁逻辑（2PL + no-wait）
+     * @brief 内部通用加锁逻辑（2PL）
      *
      * 设计要点：
      * - 只在 member function 内实现/调用，便于访问 LockMode/LockRequestQueue 等私有结构体；
-     * - no-wait：冲突直接抛 TransactionAbortException（rmdb.cpp 会捕获并触发回滚、输出 abort）。
+     * - 冲突时按 wait_policy_ 处理：no-wait 直接抛 TransactionAbortException（rmdb.cpp 会捕获并触发回滚、输出 abort），
+     *   其余策略在队列的 cv_ 上等待。
      */
     bool lock_internal(Transaction *txn, const LockDataId &lock_data_id, LockMode mode);
 
-    /** @brief 判断 requested 是否与“队列里其他事务已授予的锁”相容 */
-    bool compatible_with_granted(const LockRequestQueue &rq, txn_id_t self, LockMode requested) const;
+    /** @brief 同一事务在同一对象上已经持有 cur 时再申请 req，返回需要持有的锁模式 */
+    static std::optional<LockMode> combine_mode(LockDataType type, LockMode cur, LockMode req);
+
+    /** @brief 事务的表锁缓存中该表上的锁是否已经蕴含 mode */
+    static bool table_lock_covers(Transaction *txn, int tab_fd, LockMode mode);
+
+    static void note_table_lock(Transaction *txn, int tab_fd, LockMode mode);
+
+    bool lock_table(Transaction *txn, int tab_fd, LockMode mode);
+
+    bool lock_row(Transaction *txn, const LockDataId &lock_data_id, LockMode mode);
+
+    /** @brief 事务在表上的行锁达到 LOCK_ESCALATION_THRESHOLD 时尝试升级为表锁 */
+    void escalate(Transaction *txn, int tab_fd, LockMode row_mode);
+
+    size_t release_row_locks(Transaction *txn, int tab_fd, bool all);
+
+    /**
+     * @brief 按 wait_policy_ 等待，直到 mode 可以授予；需要回滚时抛 TransactionAbortException
+     * @param conflict_reason no-wait 策略下回滚的原因
+     */
+    void wait_for_grant(std::unique_lock<std::mutex> &lk, LockRequestQueue &rq, Transaction *txn, LockMode mode,
+                        AbortReason conflict_reason);
+
+    /**
+     * @brief wait_for_grant 和 wait_for_predicate 共用的等待逻辑：blockers 返回当前挡住 txn 的事务，为空时返回
+     */
+    void wait_with_policy(std::unique_lock<std::mutex> &lk, std::condition_variable &cv, Transaction *txn,
+                          AbortReason conflict_reason, const std::function<std::vector<Transaction *>()> &blockers);
+
+    /** @brief 两种锁模式是否相容 */
+    static bool compatible(LockMode a, LockMode b);
+
+    /**
+     * @brief 返回挡住 self 以 requested 模式加锁的请求：不相容的已授予锁，对新请求还包括正在升级的持有者和先到的等待者
+     */
+    std::vector<const LockRequest *> blockers(const LockRequestQueue &rq, txn_id_t self, LockMode requested) const;
+
+    /** @brief 死锁检测线程的主循环 */
+    void run_cycle_detection();
+
+    /** @brief 在整张锁表的等待图中找环，每个环选最年轻的事务作为牺牲者 */
+    void break_cycles();
 };
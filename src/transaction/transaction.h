@@ -12,27 +12,57 @@ See the Mulan PSL v2 for more details. */
 
 #include <atomic>
 #include <deque>
+#include <functional>
 #include <string>
 #include <thread>
 #include <memory>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "txn_defs.h"
 
+class RmFileHandle;
+
 class Transaction {
    public:
-    explicit Transaction(txn_id_t txn_id, IsolationLevel isolation_level = IsolationLevel::SERIALIZABLE)
-        : state_(TransactionState::DEFAULT), isolation_level_(isolation_level), txn_id_(txn_id) {
-        write_set_ = std::make_shared<std::deque<WriteRecord *>>();
-        lock_set_ = std::make_shared<std::unordered_set<LockDataId>>();
-        index_latch_page_set_ = std::make_shared<std::deque<Page *>>();
-        index_deleted_page_set_ = std::make_shared<std::deque<Page*>>();
+    /* 写集合、锁集等在第一次使用时才分配，只读事务不会用到它们 */
+    explicit Transaction(txn_id_t txn_id, IsolationLevel isolation_level = IsolationLevel::SERIALIZABLE,
+                         bool read_only = false)
+        : state_(TransactionState::DEFAULT), isolation_level_(isolation_level), read_only_(read_only),
+          txn_id_(txn_id) {
         prev_lsn_ = INVALID_LSN;
         thread_id_ = std::this_thread::get_id();
     }
 
     ~Transaction() = default;
 
+    /**
+     * @brief 复用已经结束的事务对象开始新事务：清空写集合、锁集等但保留它们已经分配的空间
+     */
+    void reset(txn_id_t txn_id, IsolationLevel isolation_level, bool read_only) {
+        txn_mode_ = false;
+        state_ = TransactionState::DEFAULT;
+        isolation_level_ = isolation_level;
+        read_only_ = read_only;
+        optimistic_ = false;
+        thread_id_ = std::this_thread::get_id();
+        prev_lsn_ = INVALID_LSN;
+        first_lsn_.store(INVALID_LSN, std::memory_order_relaxed);
+        txn_id_ = txn_id;
+        start_ts_ = INVALID_TIMESTAMP;
+        read_ts_ = INVALID_TIMESTAMP;
+        abort_requested_.store(false, std::memory_order_relaxed);
+        stamp_.reset();
+        num_write_records_ = 0;
+        if (write_set_ != nullptr) write_set_->clear();
+        if (lock_set_ != nullptr) lock_set_->clear();
+        if (index_latch_page_set_ != nullptr) index_latch_page_set_->clear();
+        if (index_deleted_page_set_ != nullptr) index_deleted_page_set_->clear();
+        table_locks_.clear();
+        read_set_.clear();
+    }
+
     inline txn_id_t get_transaction_id() { return txn_id_; }
 
     inline std::thread::id get_thread_id() { return thread_id_; }
@@ -45,34 +75,107 @@ class Transaction {
 
     inline IsolationLevel get_isolation_level() { return isolation_level_; }
 
+    /* 只读事务不进入全局事务表、不加锁、不写日志，不能执行写操作 */
+    inline bool is_read_only() { return read_only_; }
+
+    /* 乐观并发控制的事务不加锁：按快照读取，写操作直接修改记录并取得写权，提交时验证读集合 */
+    inline bool is_optimistic() { return optimistic_; }
+    inline void set_optimistic(bool optimistic) { optimistic_ = optimistic; }
+
+    /* 只读事务、乐观并发控制的事务以及REPEATABLE_READ、READ_COMMITTED的事务按快照读取，读操作不加锁 */
+    inline bool snapshot_read() {
+        return read_only_ || optimistic_ || isolation_level_ == IsolationLevel::REPEATABLE_READ ||
+               isolation_level_ == IsolationLevel::READ_COMMITTED;
+    }
+    /* 快照的时间戳：REPEATABLE_READ为事务的开始时间戳，READ_COMMITTED在每条语句开始时重新取 */
+    inline void set_read_ts(timestamp_t read_ts) { read_ts_ = read_ts; }
+    inline timestamp_t get_read_ts() { return read_ts_; }
+    inline ReadView get_read_view() { return ReadView{read_ts_, txn_id_}; }
+
+    /* 多版本并发控制开启时事务写入的版本共用的提交时间戳，未开启时为空，写操作不保留旧版本 */
+    inline const std::shared_ptr<TxnStamp> &get_stamp() { return stamp_; }
+    inline void set_stamp(std::shared_ptr<TxnStamp> stamp) { stamp_ = std::move(stamp); }
+
     inline TransactionState get_state() { return state_; }
     inline void set_state(TransactionState state) { state_ = state; }
 
     inline lsn_t get_prev_lsn() { return prev_lsn_; }
     inline void set_prev_lsn(lsn_t prev_lsn) { prev_lsn_ = prev_lsn; }
 
-    inline std::shared_ptr<std::deque<WriteRecord *>> get_write_set() { return write_set_; }  
-    inline void append_write_record(WriteRecord* write_record) { write_set_->push_back(write_record); }
+    /* 事务第一条日志的日志号的下界，还没有写日志时为INVALID_LSN；检查点在其他线程中读取 */
+    inline lsn_t get_first_lsn() { return first_lsn_.load(); }
+    inline void set_first_lsn(lsn_t first_lsn) { first_lsn_.store(first_lsn); }
+
+    inline std::shared_ptr<std::deque<WriteRecord *>> get_write_set() { return lazy(write_set_); }
+
+    /* 追加一条写记录，写记录对象由事务持有并随事务对象复用，before为nullptr表示插入操作 */
+    inline void append_write_record(WType wtype, const std::string &tab_name, const Rid &rid,
+                                    const RmRecord *before = nullptr) {
+        if (num_write_records_ == write_records_.size()) {
+            write_records_.emplace_back();
+        }
+        WriteRecord *write_record = &write_records_[num_write_records_++];
+        write_record->assign(wtype, tab_name, rid, before);
+        lazy(write_set_)->push_back(write_record);
+    }
+
+    inline std::shared_ptr<std::deque<Page*>> get_index_deleted_page_set() { return lazy(index_deleted_page_set_); }
+    inline void append_index_deleted_page(Page* page) { lazy(index_deleted_page_set_)->push_back(page); }
+
+    inline std::shared_ptr<std::deque<Page*>> get_index_latch_page_set() { return lazy(index_latch_page_set_); }
+    inline void append_index_latch_page_set(Page* page) { lazy(index_latch_page_set_)->push_back(page); }
 
-    inline std::shared_ptr<std::deque<Page*>> get_index_deleted_page_set() { return index_deleted_page_set_; }
-    inline void append_index_deleted_page(Page* page) { index_deleted_page_set_->push_back(page); }
+    inline std::shared_ptr<std::unordered_set<LockDataId>> get_lock_set() { return lazy(lock_set_); }
 
-    inline std::shared_ptr<std::deque<Page*>> get_index_latch_page_set() { return index_latch_page_set_; }
-    inline void append_index_latch_page_set(Page* page) { index_latch_page_set_->push_back(page); }
+    /* 事务在各张表上持有的锁，键为表的fd，由LockManager维护，释放全部锁时清空 */
+    inline std::unordered_map<int, TableLockState> &get_table_locks() { return table_locks_; }
+
+    /* 乐观并发控制的事务扫描过的表和扫描条件，提交时检查快照之后其他事务的修改是否改变了扫描结果 */
+    using ReadPredicate = std::pair<RmFileHandle *, std::function<bool(const char *)>>;
+    inline const std::vector<ReadPredicate> &get_read_set() { return read_set_; }
+    inline void append_read_predicate(RmFileHandle *fh, std::function<bool(const char *)> pred) {
+        read_set_.emplace_back(fh, std::move(pred));
+    }
 
-    inline std::shared_ptr<std::unordered_set<LockDataId>> get_lock_set() { return lock_set_; }
+    /* 事务对象保留的写记录对象个数，复用事务对象时这些空间不会释放 */
+    inline size_t write_record_capacity() { return write_records_.size(); }
+
+    /* 是否写过数据，没有写过时提交不需要刷日志和回收版本 */
+    inline bool has_writes() { return write_set_ != nullptr && !write_set_->empty(); }
+
+    /* 其他线程要求该事务回滚（wound-wait 中被更老的事务伤害，或被死锁检测选为牺牲者），事务在下一次加锁或等锁时回滚 */
+    inline void request_abort() { abort_requested_.store(true, std::memory_order_release); }
+    inline bool abort_requested() { return abort_requested_.load(std::memory_order_acquire); }
 
    private:
+    template <typename T>
+    static const std::shared_ptr<T> &lazy(std::shared_ptr<T> &set) {
+        if (set == nullptr) {
+            set = std::make_shared<T>();
+        }
+        return set;
+    }
+
     bool txn_mode_;                   // 用于标识当前事务为显式事务还是单条SQL语句的隐式事务
     TransactionState state_;          // 事务状态
     IsolationLevel isolation_level_;  // 事务的隔离级别，默认隔离级别为可串行化
+    bool read_only_;                  // 是否为只读事务
+    bool optimistic_ = false;         // 是否使用乐观并发控制
     std::thread::id thread_id_;       // 当前事务对应的线程id
     lsn_t prev_lsn_;                  // 当前事务执行的最后一条操作对应的lsn，用于系统故障恢复
+    std::atomic<lsn_t> first_lsn_{INVALID_LSN};     // 事务第一条日志的日志号的下界，检查点据此确定需要保留的日志
     txn_id_t txn_id_;                 // 事务的ID，唯一标识符
     timestamp_t start_ts_;            // 事务的开始时间戳
+    timestamp_t read_ts_ = INVALID_TIMESTAMP;   // 快照读的时间戳
+    std::atomic<bool> abort_requested_{false};  // 是否已被其他事务要求回滚
+    std::shared_ptr<TxnStamp> stamp_;           // 事务写入的版本的提交时间戳
 
     std::shared_ptr<std::deque<WriteRecord *>> write_set_;  // 事务包含的所有写操作
+    std::deque<WriteRecord> write_records_;     // write_set_中的写记录对象，deque扩展时已有元素的地址不变
+    size_t num_write_records_ = 0;              // write_records_中当前事务使用的个数
     std::shared_ptr<std::unordered_set<LockDataId>> lock_set_;  // 事务申请的所有锁
+    std::unordered_map<int, TableLockState> table_locks_;       // 事务在各张表上持有的锁
     std::shared_ptr<std::deque<Page*>> index_latch_page_set_;          // 维护事务执行过程中加锁的索引页面
     std::shared_ptr<std::deque<Page*>> index_deleted_page_set_;    // 维护事务执行过程中删除的索引页面
+    std::vector<ReadPredicate> read_set_;       // 乐观并发控制的读集合
 };
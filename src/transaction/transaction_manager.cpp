@@ -12,10 +12,17 @@ See the Mulan PSL v2 for more details. */
 #include "record/rm_file_handle.h"
 #include "system/sm_manager.h"
 #include "common/context.h"
+#include "common/memory_tracker.h"
+#include "common/metrics.h"
 
 #include <algorithm>
+#include <unordered_set>
 
-std::unordered_map<txn_id_t, Transaction *> TransactionManager::txn_map = {};
+// 每个线程保留的已结束的事务对象，开始新事务时复用，不再为每条语句分配事务对象和它的各个集合
+static thread_local std::vector<std::unique_ptr<Transaction>> txn_pool;
+
+// 全局事务表中一个活跃事务大约占用的内存：事务对象以及哈希表结点，计入TXN_TABLE
+static constexpr size_t TXN_MEM = sizeof(Transaction) + sizeof(std::pair<const txn_id_t, Transaction *>) + 4 * sizeof(void *);
 
 /**
  * @brief 释放事务持有的全部锁（2PL 下通常在 commit/abort 阶段一次性释放）。
@@ -40,24 +47,46 @@ static void release_all_locks(TransactionManager *txn_mgr, Transaction *txn) {
         lock_mgr->unlock(txn, lid);
     }
     txn->get_lock_set()->clear();
+    txn->get_table_locks().clear();
 }
 
 /**
- * @brief 清理 write_set_ 中的 WriteRecord*，避免内存泄漏。
+ * @brief 清空 write_set_。
  *
- * 事务写集合里用的是裸指针（WriteRecord*），因此 commit/abort 结束时必须 delete。
+ * 写集合里的 WriteRecord* 指向事务对象持有的写记录，随事务对象复用，这里不释放。
  * 我们在这里集中清理，确保：
  * - commit：不需要回滚，只清理；
  * - abort：先回滚再清理。
  */
 static void cleanup_write_set(Transaction *txn) {
     if (txn == nullptr) return;
-    auto ws = txn->get_write_set();
-    if (!ws) return;
-    for (auto *wr : *ws) {
-        delete wr;
+    if (!txn->has_writes()) return;
+    txn->get_write_set()->clear();
+}
+
+/**
+ * @description: 从当前线程的事务对象池中取出一个事务对象，池为空时新建
+ */
+Transaction *TransactionManager::acquire_transaction(txn_id_t txn_id, IsolationLevel isolation_level,
+                                                     bool read_only) {
+    if (txn_pool.empty()) {
+        return new Transaction(txn_id, isolation_level, read_only);
+    }
+    Transaction *txn = txn_pool.back().release();
+    txn_pool.pop_back();
+    txn->reset(txn_id, isolation_level, read_only);
+    return txn;
+}
+
+/**
+ * @description: 事务结束后把事务对象放回当前线程的事务对象池；池已满或者事务保留了过多写记录时释放
+ */
+void TransactionManager::release_transaction(Transaction *txn) {
+    if (txn_pool.size() >= TXN_POOL_SIZE || txn->write_record_capacity() > TXN_POOL_MAX_WRITES) {
+        delete txn;
+        return;
     }
-    ws->clear();
+    txn_pool.emplace_back(txn);
 }
 
 /**
@@ -81,14 +110,27 @@ Transaction * TransactionManager::begin(Transaction* txn, LogManager* log_manage
 
     // 2) 新事务：分配事务ID + 构造 Transaction 对象
     txn_id_t txn_id = next_txn_id_.fetch_add(1);
-    auto *new_txn = new Transaction(txn_id);
+    auto *new_txn = acquire_transaction(txn_id, isolation_level_, false);
     new_txn->set_state(TransactionState::GROWING);
-    new_txn->set_start_ts(next_timestamp_.fetch_add(1));
+    if (mvcc_enabled_) {
+        new_txn->set_stamp(std::make_shared<TxnStamp>(txn_id));
+    }
+    new_txn->set_optimistic(concurrency_mode_ == ConcurrencyMode::OPTIMISTIC);
+
+    if (new_txn->snapshot_read()) {
+        register_snapshot(new_txn);
+        new_txn->set_start_ts(new_txn->get_read_ts());
+    } else {
+        new_txn->set_start_ts(next_timestamp_.fetch_add(1));
+    }
 
-    // 3) 插入全局事务表（txn_map 是跨线程共享结构，需要互斥保护）
+    // 3) 插入全局事务表（跨线程共享结构，只需要互斥保护事务ID所在的分区）
     {
-        std::unique_lock<std::mutex> lock(latch_);
-        TransactionManager::txn_map.emplace(txn_id, new_txn);
+        auto &part = partition_of(txn_id);
+        std::unique_lock<std::mutex> lock(part.latch_);
+        if (part.txns_.emplace(txn_id, new_txn).second) {
+            MemoryTracker::subsystem(MemoryTracker::TXN_TABLE).consume(TXN_MEM);
+        }
     }
 
     // 4) WAL：本实验的事务测试不强依赖日志内容，但需要保证 log_mgr 不为空时能正常落盘。
@@ -98,6 +140,65 @@ Transaction * TransactionManager::begin(Transaction* txn, LogManager* log_manage
     return new_txn;
 }
 
+/**
+ * @description: 开始单条只读语句的事务：按语句开始时的快照读取，不进入全局事务表、不加锁、不分配写集合，提交时不写日志。
+ *              严格两阶段封锁下事务按提交的先后顺序串行化，已提交事务的快照就是这个顺序的一个前缀，可串行化的隔离级别下同样成立
+ * @return {Transaction*} 只读事务的指针，由commit或abort释放
+ */
+Transaction *TransactionManager::begin_read_only() {
+    auto *txn = acquire_transaction(INVALID_TXN_ID, isolation_level_, true);
+    txn->set_state(TransactionState::GROWING);
+    txn->set_txn_mode(false);
+    register_snapshot(txn);
+    txn->set_start_ts(txn->get_read_ts());
+    return txn;
+}
+
+/**
+ * @description: 显式事务中的一条语句开始执行，READ_COMMITTED的事务换用新的快照
+ */
+void TransactionManager::begin_statement(Transaction *txn) {
+    // 乐观并发控制的事务按开始时的快照验证读集合，不更换快照
+    if (txn->get_isolation_level() != IsolationLevel::READ_COMMITTED || txn->is_read_only() || txn->is_optimistic()) {
+        return;
+    }
+    unregister_snapshot(txn);
+    register_snapshot(txn);
+}
+
+/**
+ * @description: 还没有读取任何数据的快照读事务换用新的快照。结果缓存在执行语句之前读取表的版本号之后调用：
+ *              读取版本号之前提交的修改都在新快照中可见，之后提交的事务会在提交时增加版本号，使缓存的结果失效
+ */
+void TransactionManager::refresh_snapshot(Transaction *txn) {
+    if (!txn->snapshot_read()) {
+        return;
+    }
+    unregister_snapshot(txn);
+    register_snapshot(txn);
+    if (txn->is_read_only()) {
+        txn->set_start_ts(txn->get_read_ts());
+    }
+}
+
+/**
+ * @description: 为快照读的事务分配快照时间戳并登记为活跃快照。时间戳在snapshot_latch_内分配，
+ *              回收版本时在同一个latch内取最小的活跃快照时间戳，不会漏掉刚取得时间戳的事务
+ */
+void TransactionManager::register_snapshot(Transaction *txn) {
+    std::unique_lock<std::mutex> lock(snapshot_latch_);
+    txn->set_read_ts(next_timestamp_.fetch_add(1));
+    snapshots_.insert(txn->get_read_ts());
+}
+
+void TransactionManager::unregister_snapshot(Transaction *txn) {
+    if (!txn->snapshot_read()) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(snapshot_latch_);
+    snapshots_.erase(snapshots_.find(txn->get_read_ts()));
+}
+
 /**
  * @description: 事务的提交方法
  * @param {Transaction*} txn 需要提交的事务
@@ -112,32 +213,69 @@ void TransactionManager::commit(Transaction* txn, LogManager* log_manager) {
     // 5. 更新事务状态
     if (txn == nullptr) return;
 
+    // 只读事务没有锁和写集合，也不在全局事务表中，注销快照即可
+    if (txn->is_read_only()) {
+        unregister_snapshot(txn);
+        txn->set_state(TransactionState::COMMITTED);
+        release_transaction(txn);
+        collect_garbage();
+        return;
+    }
+
+    auto commit_start = std::chrono::steady_clock::now();
+
     // 1) 本系统的写操作是“写穿”（执行时已写入 buffer/page），提交阶段无需额外 apply。
     //    真正关键是：释放锁 + 刷日志 + 清理 write_set。
 
+    // 乐观并发控制的写事务先验证读集合，通过后写commit日志并分配提交时间戳，验证失败时抛出异常，由调用者回滚事务
+    bool validated = txn->is_optimistic() && txn->has_writes();
+    if (validated) {
+        validate(txn, log_manager);
+    }
+
     // 5) 状态先进入 SHRINKING（严格 2PL：释放锁意味着进入 shrinking；之后标记 committed）
     txn->set_state(TransactionState::SHRINKING);
 
-    // 2 & 3) 释放锁并清空锁集
-    release_all_locks(this, txn);
+    // 4) WAL：写过日志的事务追加commit日志，等待日志持久化之后才让其他事务看到修改、释放锁。
+    //    等待的事务由刷日志线程统一刷盘（组提交），同时提交的事务共用一次fdatasync
+    if (log_manager != nullptr && txn->get_prev_lsn() != INVALID_LSN) {
+        if (!validated) {
+            CommitLogRecord commit_log;
+            log_manager->append_txn_log(txn, &commit_log);
+        }
+        log_manager->flush_to(txn->get_prev_lsn());
+    }
 
-    // 4) WAL 刷盘：保证 commit 语义可持久（本实验测试中也会依赖 output 的稳定性）
-    if (log_manager != nullptr) {
-        log_manager->flush_log_to_disk();
+    // 提交时间戳在释放锁之前分配：之后修改同一记录的事务的时间戳一定更大
+    if (txn->get_stamp() != nullptr && txn->get_stamp()->finish_ts() == TxnStamp::ACTIVE) {
+        txn->get_stamp()->finish(false, [this] { return next_timestamp_.fetch_add(1); });
     }
+    bump_table_versions(txn);
+
+    // 2 & 3) 释放锁并清空锁集
+    release_all_locks(this, txn);
 
     // 清理写集合（避免泄漏）
+    retire_versions(txn);
     cleanup_write_set(txn);
+    unregister_snapshot(txn);
 
     txn->set_state(TransactionState::COMMITTED);
 
-    // 提交后可以从全局事务表移除，避免 txn_map 无限增长。
+    // 提交后可以从全局事务表移除，避免全局事务表无限增长。
     // 注意：rmdb.cpp::SetTransaction 会检查 COMMITTED/ABORTED 然后创建新事务，因此移除是安全的。
     {
-        std::unique_lock<std::mutex> lock(latch_);
-        TransactionManager::txn_map.erase(txn->get_transaction_id());
+        auto &part = partition_of(txn->get_transaction_id());
+        std::unique_lock<std::mutex> lock(part.latch_);
+        if (part.txns_.erase(txn->get_transaction_id()) > 0) {
+            MemoryTracker::subsystem(MemoryTracker::TXN_TABLE).release(TXN_MEM);
+        }
     }
-    delete txn;
+    release_transaction(txn);
+    collect_garbage();
+    auto elapsed = std::chrono::steady_clock::now() - commit_start;
+    Metrics::instance().histogram(Metrics::COMMIT_LATENCY)
+        .record(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
 }
 
 /**
@@ -153,6 +291,15 @@ void TransactionManager::abort(Transaction * txn, LogManager *log_manager) {
     // 4. 把事务日志刷入磁盘中
     // 5. 更新事务状态
     if (txn == nullptr) return;
+    Metrics::instance().add(Metrics::TXN_ABORTS);
+
+    if (txn->is_read_only()) {
+        unregister_snapshot(txn);
+        txn->set_state(TransactionState::ABORTED);
+        release_transaction(txn);
+        collect_garbage();
+        return;
+    }
 
     // 事务进入 ABORTED/SHRINKING：从这一步开始我们不应该再把“回滚产生的写”记入 write_set_。
     // 因此我们先标记为 SHRINKING（或 ABORTED），下层如果有“写集合记录逻辑”应当以此为判断条件。
@@ -160,62 +307,177 @@ void TransactionManager::abort(Transaction * txn, LogManager *log_manager) {
 
     // 1) 回滚写集合：必须“逆序”执行（后写先撤销），否则会破坏一致性。
     //    例如：先 UPDATE 再 DELETE 同一条记录，回滚时必须先撤销 DELETE（恢复记录），再撤销 UPDATE（恢复旧值）。
+    //    每撤销一条修改之前先写一条CLR，撤销之后页面记下CLR的日志号；故障恢复重做CLR，并从CLR的undo_next_lsn_继续回滚，
+    //    已经撤销的修改不会撤销第二次。存储层的撤销操作按“置为”语义实现，重复执行的结果相同
     auto ws = txn->get_write_set();
     if (ws != nullptr) {
-        // 这里构造一个“无事务”的 Context 来调用存储层接口：
-        // - txn_ = nullptr：避免在 undo 时再次 append_write_record（否则无限增长/递归）。
-        // - lock_mgr/log_mgr 仍可传入，便于后续扩展（例如 undo 也需要写 CLR 日志）。
-        Context undo_ctx(lock_manager_, log_manager, nullptr);
-
         for (auto it = ws->rbegin(); it != ws->rend(); ++it) {
             WriteRecord *wr = *it;
             if (wr == nullptr) continue;
 
             const std::string &tab_name = wr->GetTableName();
-            RmFileHandle *fh = sm_manager_->fhs_.at(tab_name).get();
-
-            // 统一说明（答辩高频点）：
-            // - INSERT 的 undo：删除这条新插入的记录（把位图 bit 置 0）
-            // - DELETE 的 undo：把旧记录插回原 rid（必须原位插回，否则 rid 会变化，索引/外键等都会错）
-            // - UPDATE 的 undo：用 before image 覆盖回去（update_record）
+            RmFileHandle *fh = sm_manager_->get_table_handle(tab_name);
+            LogType undo_type;
             switch (wr->GetWriteType()) {
-                case WType::INSERT_TUPLE: {
-                    fh->delete_record(wr->GetRid(), &undo_ctx);
-                    break;
-                }
-                case WType::DELETE_TUPLE: {
-                    // 关键：原位插回（需要实现 RmFileHandle::insert_record(const Rid&, char*)）
-                    fh->insert_record(wr->GetRid(), wr->GetRecord().data);
-                    break;
-                }
-                case WType::UPDATE_TUPLE: {
-                    fh->update_record(wr->GetRid(), wr->GetRecord().data, &undo_ctx);
-                    break;
-                }
+                case WType::INSERT_TUPLE: undo_type = LogType::INSERT; break;
+                case WType::DELETE_TUPLE: undo_type = LogType::DELETE; break;
+                case WType::UPDATE_TUPLE: undo_type = LogType::UPDATE; break;
                 default: {
                     throw InternalError("TransactionManager::abort: unknown write type");
                 }
             }
+
+            lsn_t clr_lsn = INVALID_LSN;
+            if (log_manager != nullptr && wr->GetLsn() != INVALID_LSN) {
+                auto next = std::next(it);
+                lsn_t undo_next = next != ws->rend() ? (*next)->GetLsn() : INVALID_LSN;
+                RmRecord empty(0);
+                CompensationLogRecord clr(txn->get_transaction_id(), undo_type,
+                                          undo_type == LogType::INSERT ? empty : wr->GetRecord(), wr->GetRid(),
+                                          fh->get_oid(), undo_next);
+                clr_lsn = log_manager->append_txn_log(txn, &clr);
+            }
+
+            // - INSERT 的 undo：删除这条新插入的记录
+            // - DELETE 的 undo：把旧记录插回原 rid（必须原位插回，否则 rid 会变化，索引/外键等都会错）
+            // - UPDATE 的 undo：用 before image 覆盖回去
+            if (undo_type == LogType::INSERT) {
+                fh->erase_record(wr->GetRid(), clr_lsn);
+            } else {
+                fh->set_record(wr->GetRid(), wr->GetRecord().data, clr_lsn);
+            }
         }
     }
 
+    // 回滚完成后记录已经恢复，回滚的修改对之后开始的快照相当于可见
+    if (txn->get_stamp() != nullptr) {
+        txn->get_stamp()->finish(true, [this] { return next_timestamp_.fetch_add(1); });
+    }
+    bump_table_versions(txn);
+
     // 2 & 3) 释放锁并清理锁集
     release_all_locks(this, txn);
 
-    // 4) 刷日志
-    if (log_manager != nullptr) {
-        log_manager->flush_log_to_disk();
+    // 4) 写abort日志：回滚的事务不需要等待日志持久化
+    if (log_manager != nullptr && txn->get_prev_lsn() != INVALID_LSN) {
+        AbortLogRecord abort_log;
+        log_manager->append_txn_log(txn, &abort_log);
     }
 
     // 清理写集合
+    retire_versions(txn);
     cleanup_write_set(txn);
+    unregister_snapshot(txn);
 
     txn->set_state(TransactionState::ABORTED);
 
-    // 从全局事务表移除，释放事务对象
+    // 从全局事务表移除，回收事务对象
+    {
+        auto &part = partition_of(txn->get_transaction_id());
+        std::unique_lock<std::mutex> lock(part.latch_);
+        if (part.txns_.erase(txn->get_transaction_id()) > 0) {
+            MemoryTracker::subsystem(MemoryTracker::TXN_TABLE).release(TXN_MEM);
+        }
+    }
+    release_transaction(txn);
+    collect_garbage();
+}
+
+/**
+ * @description: 检查点取得活跃事务表：已经写过日志、还没有结束的事务，以及它们第一条日志的日志号的下界
+ * @param {vector<pair<txn_id_t, lsn_t>>*} active_txns 事务ID和第一条日志的日志号
+ */
+void TransactionManager::get_active_transactions(std::vector<std::pair<txn_id_t, lsn_t>> *active_txns) {
+    for (auto &part : txn_table_) {
+        std::unique_lock<std::mutex> lock(part.latch_);
+        for (auto &[txn_id, txn] : part.txns_) {
+            lsn_t first_lsn = txn->get_first_lsn();
+            if (first_lsn != INVALID_LSN) {
+                active_txns->emplace_back(txn_id, first_lsn);
+            }
+        }
+    }
+}
+
+/**
+ * @description: 乐观并发控制的提交验证：快照之后提交的事务没有改变事务扫描过的记录时，写commit日志并分配提交时间戳。
+ *              验证和分配时间戳在validation_latch_内逐个进行，事务按验证的先后顺序串行化，commit日志也按这个顺序写入；
+ *              写写冲突已经在取得记录的写权时检查过，这里只需要检查读集合。等待日志持久化在latch之外进行
+ * @param {Transaction*} txn 有写操作的乐观并发控制的事务
+ * @param {LogManager*} log_manager 日志管理器指针
+ */
+void TransactionManager::validate(Transaction *txn, LogManager *log_manager) {
+    std::unique_lock<std::mutex> lock(validation_latch_);
+    ReadView view = txn->get_read_view();
+    for (auto &[fh, pred] : txn->get_read_set()) {
+        if (!fh->validate_scan(view, pred)) {
+            throw TransactionAbortException(txn->get_transaction_id(), AbortReason::SERIALIZATION_FAILURE);
+        }
+    }
+    if (log_manager != nullptr && txn->get_prev_lsn() != INVALID_LSN) {
+        CommitLogRecord commit_log;
+        log_manager->append_txn_log(txn, &commit_log);
+    }
+    txn->get_stamp()->finish(false, [this] { return next_timestamp_.fetch_add(1); });
+}
+
+/**
+ * @description: 事务结束后把它写入的版本加入待回收队列，记录号来自写集合
+ */
+void TransactionManager::retire_versions(Transaction *txn) {
+    if (txn->get_stamp() == nullptr || !txn->has_writes()) {
+        return;
+    }
+    RetiredVersions retired{txn->get_stamp(), {}};
+    retired.rids_.reserve(txn->get_write_set()->size());
+    for (auto *wr : *txn->get_write_set()) {
+        retired.rids_.emplace_back(wr->GetTableName(), wr->GetRid());
+    }
+    std::unique_lock<std::mutex> lock(gc_latch_);
+    retired_.push_back(std::move(retired));
+}
+
+/**
+ * @description: 事务提交或回滚时把写过的表的版本号加一，在分配结束时间戳之后调用。执行期间的修改已经增加过版本号，
+ *              但快照读的语句执行时看不到还没有提交的修改，它在修改之后读到的版本号不能说明结果包含了这些修改
+ */
+void TransactionManager::bump_table_versions(Transaction *txn) {
+    if (!txn->has_writes()) {
+        return;
+    }
+    std::unordered_set<std::string> tables;
+    for (auto *wr : *txn->get_write_set()) {
+        if (tables.insert(wr->GetTableName()).second) {
+            RmFileHandle *fh = sm_manager_->find_table_handle(wr->GetTableName());
+            if (fh != nullptr) {
+                fh->bump_version();
+            }
+        }
+    }
+}
+
+/**
+ * @description: 回收所有活跃快照都能看到的版本：事务的结束时间戳小于最小的活跃快照时间戳。
+ *              之后取得的快照时间戳更大，同样能看到这些修改
+ */
+void TransactionManager::collect_garbage() {
+    std::unique_lock<std::mutex> gc_lock(gc_latch_);
+    if (retired_.empty()) {
+        return;
+    }
+    timestamp_t min_ts;
     {
-        std::unique_lock<std::mutex> lock(latch_);
-        TransactionManager::txn_map.erase(txn->get_transaction_id());
+        std::unique_lock<std::mutex> lock(snapshot_latch_);
+        min_ts = snapshots_.empty() ? next_timestamp_.load() : *snapshots_.begin();
+    }
+    while (!retired_.empty() && retired_.front().stamp_->finish_ts() < min_ts) {
+        auto &retired = retired_.front();
+        for (auto &[tab_name, rid] : retired.rids_) {
+            RmFileHandle *fh = sm_manager_->find_table_handle(tab_name);
+            if (fh != nullptr) {
+                fh->get_versions().prune(rid, retired.stamp_.get());
+            }
+        }
+        retired_.pop_front();
     }
-    delete txn;
 }
\ No newline at end of file
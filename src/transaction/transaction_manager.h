@@ -11,6 +11,8 @@ See the Mulan PSL v2 for more details. */
 #pragma once
 
 #include <atomic>
+#include <deque>
+#include <set>
 #include <unordered_map>
 
 #include "transaction.h"
@@ -18,22 +20,46 @@ See the Mulan PSL v2 for more details. */
 #include "concurrency/lock_manager.h"
 #include "system/sm_manager.h"
 
-/* 系统采用的并发控制算法，当前题目中要求两阶段封锁并发控制算法 */
-enum class ConcurrencyMode { TWO_PHASE_LOCKING = 0, BASIC_TO };
+/* 系统采用的并发控制算法，当前题目中要求两阶段封锁并发控制算法；
+   OPTIMISTIC的事务不加锁，按快照读取，写操作取得记录的写权，提交时验证读集合 */
+enum class ConcurrencyMode { TWO_PHASE_LOCKING = 0, BASIC_TO, OPTIMISTIC };
 
 class TransactionManager{
 public:
     explicit TransactionManager(LockManager *lock_manager, SmManager *sm_manager,
+                             const std::string &isolation_level = ISOLATION_LEVEL,
+                             bool read_only_snapshot = READ_ONLY_SNAPSHOT,
                              ConcurrencyMode concurrency_mode = ConcurrencyMode::TWO_PHASE_LOCKING) {
         sm_manager_ = sm_manager;
         lock_manager_ = lock_manager;
         concurrency_mode_ = concurrency_mode;
+        if (isolation_level == "REPEATABLE_READ") {
+            isolation_level_ = IsolationLevel::REPEATABLE_READ;
+        } else if (isolation_level == "READ_COMMITTED") {
+            isolation_level_ = IsolationLevel::READ_COMMITTED;
+        } else {
+            isolation_level_ = IsolationLevel::SERIALIZABLE;
+        }
+        read_only_snapshot_ = read_only_snapshot;
+        // 可串行化的事务不读快照，全部事务都是可串行化并且没有只读事务时写操作不需要保留旧版本；
+        // 乐观并发控制的事务总是按快照读取，并通过版本链取得写权、验证读集合
+        mvcc_enabled_ = isolation_level_ != IsolationLevel::SERIALIZABLE || read_only_snapshot_ ||
+                        concurrency_mode_ == ConcurrencyMode::OPTIMISTIC;
     }
     
     ~TransactionManager() = default;
 
     Transaction* begin(Transaction* txn, LogManager* log_manager);
 
+    /* 单条只读语句的事务是否走快速路径 */
+    bool read_only_enabled() const { return read_only_snapshot_; }
+
+    Transaction* begin_read_only();
+
+    void begin_statement(Transaction* txn);
+
+    void refresh_snapshot(Transaction* txn);
+
     void commit(Transaction* txn, LogManager* log_manager);
 
     void abort(Transaction* txn, LogManager* log_manager);
@@ -44,6 +70,8 @@ public:
 
     LockManager* get_lock_manager() { return lock_manager_; }
 
+    IsolationLevel get_isolation_level() { return isolation_level_; }
+
     /**
      * @description: 获取事务ID为txn_id的事务对象
      * @return {Transaction*} 事务对象的指针
@@ -52,11 +80,12 @@ public:
     Transaction* get_transaction(txn_id_t txn_id) {
         if(txn_id == INVALID_TXN_ID) return nullptr;
         
-        std::unique_lock<std::mutex> lock(latch_);
-        auto it = TransactionManager::txn_map.find(txn_id);
-        if (it == TransactionManager::txn_map.end()) {
+        auto &part = partition_of(txn_id);
+        std::unique_lock<std::mutex> lock(part.latch_);
+        auto it = part.txns_.find(txn_id);
+        if (it == part.txns_.end()) {
             // 重要语义（Lab4 高频点）：
-            // - txn_id 可能来自客户端缓存（rmdb.cpp 的 txn_id 变量），但事务对象可能已在 commit/abort 时被释放并从 txn_map 移除。
+            // - txn_id 可能来自客户端缓存（rmdb.cpp 的 txn_id 变量），但事务对象可能已在 commit/abort 时被回收并从全局事务表移除。
             // - 因此这里必须“可返回 nullptr”，让上层逻辑（SetTransaction）创建一个新事务，而不是 assert 崩溃。
             return nullptr;
         }
@@ -71,13 +100,54 @@ public:
         return res;
     }
 
-    static std::unordered_map<txn_id_t, Transaction *> txn_map;     // 全局事务表，存放事务ID与事务对象的映射关系
+    void get_active_transactions(std::vector<std::pair<txn_id_t, lsn_t>> *active_txns);
+
+    /* 故障恢复之后设置下一个事务ID，新事务的ID不会与日志中的事务重复 */
+    void set_next_txn_id(txn_id_t txn_id) { next_txn_id_.store(txn_id); }
 
 private:
-    ConcurrencyMode concurrency_mode_;      // 事务使用的并发控制算法，目前只需要考虑2PL
+    /* 全局事务表的一个分区：事务ID按取模分到各分区，分区之间的插入、删除和查找互不阻塞 */
+    struct alignas(64) TxnTablePartition {
+        std::mutex latch_;      // 用于该分区的并发
+        std::unordered_map<txn_id_t, Transaction *> txns_;  // 事务ID与事务对象的映射关系
+    };
+
+    TxnTablePartition &partition_of(txn_id_t txn_id) { return txn_table_[txn_id % TXN_TABLE_PARTITIONS]; }
+
+    Transaction *acquire_transaction(txn_id_t txn_id, IsolationLevel isolation_level, bool read_only);
+
+    void release_transaction(Transaction *txn);
+
+    /* 已经结束的事务写入的版本，等待所有活跃的快照都能看到之后回收 */
+    struct RetiredVersions {
+        std::shared_ptr<TxnStamp> stamp_;
+        std::vector<std::pair<std::string, Rid>> rids_;     // 表名和记录号
+    };
+
+    void register_snapshot(Transaction *txn);
+
+    void unregister_snapshot(Transaction *txn);
+
+    void validate(Transaction *txn, LogManager *log_manager);
+
+    void retire_versions(Transaction *txn);
+
+    void bump_table_versions(Transaction *txn);
+
+    void collect_garbage();
+
+    ConcurrencyMode concurrency_mode_;      // 事务使用的并发控制算法，2PL或乐观并发控制
+    IsolationLevel isolation_level_;        // 新事务的隔离级别
+    bool read_only_snapshot_;               // 单条只读语句是否按快照读取、不加锁
+    bool mvcc_enabled_;                     // 写操作是否保留旧版本供快照读使用
     std::atomic<txn_id_t> next_txn_id_{0};  // 用于分发事务ID
     std::atomic<timestamp_t> next_timestamp_{0};    // 用于分发事务时间戳
-    std::mutex latch_;  // 用于txn_map的并发
+    TxnTablePartition txn_table_[TXN_TABLE_PARTITIONS];    // 全局事务表，存放事务ID与事务对象的映射关系
+    std::mutex snapshot_latch_;     // 用于snapshots_的并发，快照时间戳在latch内分配
+    std::multiset<timestamp_t> snapshots_;  // 活跃快照的时间戳，最小的一个决定哪些版本可以回收
+    std::mutex validation_latch_;   // 乐观并发控制的事务逐个验证并分配提交时间戳
+    std::mutex gc_latch_;   // 用于retired_的并发
+    std::deque<RetiredVersions> retired_;   // 按事务结束的先后顺序排列
     SmManager *sm_manager_;
     LockManager *lock_manager_;
 };
\ No newline at end of file
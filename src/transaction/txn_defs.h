@@ -11,6 +11,7 @@ See the Mulan PSL v2 for more details. */
 #pragma once
 
 #include <atomic>
+#include <thread>
 
 #include "common/config.h"
 #include "defs.h"
@@ -22,6 +23,63 @@ enum class TransactionState { DEFAULT, GROWING, SHRINKING, COMMITTED, ABORTED };
 /* 系统的隔离级别，当前赛题中为可串行化隔离级别 */
 enum class IsolationLevel { READ_UNCOMMITTED, REPEATABLE_READ, READ_COMMITTED, SERIALIZABLE };
 
+/**
+ * @brief 多版本并发控制中一个事务写入的全部版本共用的提交时间戳。
+ * 事务提交时只写一次commit_ts_，版本链上属于该事务的版本一起变为可见；回滚的事务的版本对其他事务永远不可见
+ */
+class TxnStamp {
+   public:
+    static constexpr timestamp_t ACTIVE = INVALID_TIMESTAMP;    // 事务尚未结束
+    static constexpr timestamp_t COMMITTING = -2;               // 事务正在取提交时间戳
+
+    explicit TxnStamp(txn_id_t txn_id) : txn_id_(txn_id) {}
+
+    txn_id_t get_txn_id() const { return txn_id_; }
+
+    /**
+     * @brief 事务提交或回滚完成时调用一次：先标记为COMMITTING再取时间戳，
+     * 开始时间戳比结束时间戳大的读者一定能看到COMMITTING或者结束时间戳，同一个读者对版本的可见性判断不会随时间改变
+     */
+    template <typename NextTs>
+    void finish(bool aborted, NextTs &&next_ts) {
+        aborted_.store(aborted, std::memory_order_relaxed);
+        commit_ts_.store(COMMITTING);
+        commit_ts_.store(next_ts());
+    }
+
+    bool is_aborted() const { return aborted_.load(std::memory_order_acquire); }
+
+    /* 事务结束（提交或回滚完成）时的时间戳，尚未结束时返回ACTIVE */
+    timestamp_t finish_ts() const {
+        timestamp_t ts;
+        while ((ts = commit_ts_.load()) == COMMITTING) {
+            std::this_thread::yield();
+        }
+        return ts;
+    }
+
+    /* 事务是否在read_ts之前已经提交或回滚完成。回滚完成后记录已经恢复为修改之前的内容，修改对之后的读者相当于可见 */
+    bool finished_before(timestamp_t read_ts) const {
+        timestamp_t ts = finish_ts();
+        return ts != ACTIVE && ts < read_ts;
+    }
+
+   private:
+    txn_id_t txn_id_;
+    std::atomic<timestamp_t> commit_ts_{ACTIVE};
+    std::atomic<bool> aborted_{false};
+};
+
+/* 快照读看到的数据库状态：read_ts_之前提交的事务的修改，以及事务txn_id_自己的修改 */
+struct ReadView {
+    timestamp_t read_ts_;
+    txn_id_t txn_id_;
+
+    bool sees(const TxnStamp &stamp) const {
+        return stamp.get_txn_id() == txn_id_ || stamp.finished_before(read_ts_);
+    }
+};
+
 /* 事务写操作类型，包括插入、删除、更新三种操作 */
 enum class WType { INSERT_TUPLE = 0, DELETE_TUPLE, UPDATE_TUPLE};
 
@@ -50,6 +108,26 @@ class WriteRecord {
 
     ~WriteRecord() = default;
 
+    /* 复用写记录对象：表名和记录的空间在长度足够时原地覆盖，before为nullptr表示插入操作 */
+    void assign(WType wtype, const std::string &tab_name, const Rid &rid, const RmRecord *before) {
+        wtype_ = wtype;
+        tab_name_.assign(tab_name);
+        rid_ = rid;
+        lsn_ = INVALID_LSN;
+        if (before == nullptr) {
+            return;
+        }
+        if (!record_.allocated_ || record_.size != before->size) {
+            if (record_.allocated_) {
+                delete[] record_.data;
+            }
+            record_.data = new char[before->size];
+            record_.size = before->size;
+            record_.allocated_ = true;
+        }
+        memcpy(record_.data, before->data, before->size);
+    }
+
     inline RmRecord &GetRecord() { return record_; }
 
     inline Rid &GetRid() { return rid_; }
@@ -58,24 +136,42 @@ class WriteRecord {
 
     inline std::string &GetTableName() { return tab_name_; }
 
+    /* 写操作对应的日志号，回滚时写入的CLR据此串起事务中下一条需要回滚的日志 */
+    inline lsn_t GetLsn() const { return lsn_; }
+    inline void SetLsn(lsn_t lsn) { lsn_ = lsn; }
+
    private:
     WType wtype_;
     std::string tab_name_;
     Rid rid_;
     RmRecord record_;
+    lsn_t lsn_ = INVALID_LSN;
+};
+
+/**
+ * @brief 事务在一张表上已经持有的表锁所蕴含的锁模式，以及持有的行锁个数。
+ * LockManager据此跳过已经持有的意向锁的重复申请，行锁过多时升级为表锁
+ */
+struct TableLockState {
+    bool intention_shared_ = false;     // 持有的表锁蕴含IS
+    bool intention_exclusive_ = false;  // 蕴含IX
+    bool shared_ = false;               // 蕴含S，读表中的记录不再需要行锁
+    bool exclusive_ = false;            // 蕴含X，读写表中的记录都不再需要行锁
+    size_t row_locks_ = 0;              // 持有的行锁个数
+    size_t escalate_at_ = LOCK_ESCALATION_THRESHOLD;    // 行锁个数达到该值时尝试升级，升级失败后推迟到下一个阈值
 };
 
-/* 多粒度锁，加锁对象的类型，包括记录和表 */
-enum class LockDataType { TABLE = 0, RECORD = 1 };
+/* 多粒度锁，加锁对象的类型，包括记录和表；PREDICATE 标识事务在该表上的谓词锁 */
+enum class LockDataType { TABLE = 0, RECORD = 1, PREDICATE = 2 };
 
 /**
  * @description: 加锁对象的唯一标识
  */
 class LockDataId {
    public:
-    /* 表级锁 */
+    /* 表级锁、谓词锁 */
     LockDataId(int fd, LockDataType type) {
-        assert(type == LockDataType::TABLE);
+        assert(type == LockDataType::TABLE || type == LockDataType::PREDICATE);
         fd_ = fd;
         type_ = type;
         rid_.page_no = -1;
@@ -94,6 +190,8 @@ class LockDataId {
         if (type_ == LockDataType::TABLE) {
             // fd_
             return static_cast<int64_t>(fd_);
+        } else if (type_ == LockDataType::PREDICATE) {
+            return (static_cast<int64_t>(1) << 62) | static_cast<int64_t>(fd_);
         } else {
             // fd_, rid_.page_no, rid.slot_no
             return ((static_cast<int64_t>(type_)) << 63) | ((static_cast<int64_t>(fd_)) << 31) |
@@ -117,7 +215,8 @@ struct std::hash<LockDataId> {
 };
 
 /* 事务回滚原因 */
-enum class AbortReason { LOCK_ON_SHIRINKING = 0, UPGRADE_CONFLICT, DEADLOCK_PREVENTION };
+enum class AbortReason { LOCK_ON_SHIRINKING = 0, UPGRADE_CONFLICT, DEADLOCK_PREVENTION, DEADLOCK_DETECTION, LOCK_WAIT_TIMEOUT,
+                         SERIALIZATION_FAILURE, VIEW_MAINTENANCE_FAILURE };
 
 /* 事务回滚异常，在rmdb.cpp中进行处理 */
 class TransactionAbortException : public std::exception {
@@ -146,6 +245,24 @@ class TransactionAbortException : public std::exception {
                 return "Transaction " + std::to_string(txn_id_) + " aborted for deadlock prevention\n";
             } break;
 
+            case AbortReason::DEADLOCK_DETECTION: {
+                return "Transaction " + std::to_string(txn_id_) + " aborted to break a deadlock\n";
+            } break;
+
+            case AbortReason::LOCK_WAIT_TIMEOUT: {
+                return "Transaction " + std::to_string(txn_id_) + " aborted because a lock wait timed out\n";
+            } break;
+
+            case AbortReason::SERIALIZATION_FAILURE: {
+                return "Transaction " + std::to_string(txn_id_) +
+                       " aborted because the record was modified after its snapshot was taken\n";
+            } break;
+
+            case AbortReason::VIEW_MAINTENANCE_FAILURE: {
+                return "Transaction " + std::to_string(txn_id_) +
+                       " aborted because a materialized view could not be maintained\n";
+            } break;
+
             default: {
                 return "Transaction aborted\n";
             } break;